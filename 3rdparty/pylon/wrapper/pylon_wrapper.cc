@@ -32,6 +32,7 @@ struct genicam_device
   PylonCameraType* camera;
   PylonGrabberType* grabber;
   std::vector<void*> vecHandles;
+  std::vector<unsigned char*> vecBuffers;
   std::vector<void*> vecReservedHandles;
   int triggerMode;
 };
@@ -403,6 +404,7 @@ GENICAM_WAPI(int) genicam_register_framebuffers(genicam_device* device, unsigned
   try
     {
       device->vecHandles.resize(count,0);
+      device->vecBuffers.resize(count,0);
 
       // Create an image buffer
       unsigned uiImageSize = (unsigned)device->camera->PayloadSize();
@@ -420,7 +422,8 @@ GENICAM_WAPI(int) genicam_register_framebuffers(genicam_device* device, unsigned
       // queuing the buffer
       for (int i = 0; i < count; ++i)
         {
-          device->vecHandles[i] = device->grabber->RegisterBuffer(buffer + i*uiImageSize, uiImageSize);
+          device->vecBuffers[i] = buffer + i*uiImageSize;
+          device->vecHandles[i] = device->grabber->RegisterBuffer(device->vecBuffers[i], uiImageSize);
           device->grabber->QueueBuffer(device->vecHandles[i], 0);
         }
     }
@@ -450,6 +453,7 @@ GENICAM_WAPI(int) genicam_deregister_framebuffers(genicam_device* device)
         }
 
       device->vecHandles.clear();
+      device->vecBuffers.clear();
       device->vecReservedHandles.clear();
 
       device->grabber->FinishGrab();
@@ -503,13 +507,16 @@ GENICAM_WAPI(int) genicam_grab_frame(genicam_device* device, unsigned char** buf
           //Get an item from the grabber's output queue
           if (device->grabber->RetrieveResult(grabResult))
             {
-              device->vecReservedHandles.push_back(grabResult.Handle());
               if (!grabResult.Succeeded())
                 {
+                  // The caller never sees the buffer. Give it back to
+                  // the grabber right away.
+                  device->grabber->QueueBuffer(grabResult.Handle(), 0);
                   set_error(std::string("Failed to grab frame. ") +
                             grabResult.GetErrorDescription().c_str());
                   return 2;
                 }
+              device->vecReservedHandles.push_back(grabResult.Handle());
             }
           else
             {
@@ -550,6 +557,34 @@ GENICAM_WAPI(int) genicam_requeue_buffers(genicam_device* device)
   return 0;
 }
 
+GENICAM_WAPI(int) genicam_requeue_buffer(genicam_device* device, unsigned char* buffer)
+{
+  try
+    {
+      for (unsigned int i = 0; i < device->vecBuffers.size(); ++i)
+        {
+          if (device->vecBuffers[i] != buffer)
+            continue;
+          std::vector<void*>::iterator it = std::find(device->vecReservedHandles.begin(),
+                                                      device->vecReservedHandles.end(),
+                                                      device->vecHandles[i]);
+          if (it == device->vecReservedHandles.end())
+            break;
+          device->vecReservedHandles.erase(it);
+          device->grabber->QueueBuffer(device->vecHandles[i], 0);
+          return 0;
+        }
+    }
+  catch (GenICam::GenericException& e)
+    {
+      set_error("Failed to requeue buffer.", e);
+      return 1;
+    }
+
+  set_error("The buffer is not waiting to be requeued.");
+  return 1;
+}
+
 GENICAM_WAPI(int) genicam_start_capture(genicam_device* device)
 {
   print_values(device);
@@ -0,0 +1,85 @@
+/* This file is part of Into.
+ * Copyright (C) Intopii 2013.
+ * All rights reserved.
+ *
+ * Licensees holding a commercial Into license may use this file in
+ * accordance with the commercial license agreement. Please see
+ * LICENSE.commercial for commercial licensing terms.
+ *
+ * Alternatively, this file may be used under the terms of the GNU
+ * Affero General Public License version 3 as published by the Free
+ * Software Foundation. In addition, Intopii gives you special rights
+ * to use Into as a part of open source software projects. Please
+ * refer to LICENSE.AGPL3 for details.
+ */
+
+
+#include "PiiAllocationCounter.h"
+
+#ifdef PII_COUNT_ALLOCATIONS
+
+#include <cstdlib>
+#include <new>
+
+#ifdef PII_CXX11
+#  define PII_NEW_THROW_SPEC
+#  define PII_NEW_NOTHROW_SPEC noexcept
+#else
+#  define PII_NEW_THROW_SPEC throw (std::bad_alloc)
+#  define PII_NEW_NOTHROW_SPEC throw ()
+#endif
+
+static PII_THREAD_LOCAL quint64 iAllocationCount = 0;
+
+static inline void* countedAlloc(std::size_t size) throw ()
+{
+  ++iAllocationCount;
+  return std::malloc(size != 0 ? size : 1);
+}
+
+PII_DECL_EXPORT void* operator new (std::size_t size) PII_NEW_THROW_SPEC
+{
+  void* ptr = countedAlloc(size);
+  if (ptr == 0)
+    throw std::bad_alloc();
+  return ptr;
+}
+
+PII_DECL_EXPORT void* operator new[] (std::size_t size) PII_NEW_THROW_SPEC
+{
+  void* ptr = countedAlloc(size);
+  if (ptr == 0)
+    throw std::bad_alloc();
+  return ptr;
+}
+
+PII_DECL_EXPORT void* operator new (std::size_t size, const std::nothrow_t&) PII_NEW_NOTHROW_SPEC
+{
+  return countedAlloc(size);
+}
+
+PII_DECL_EXPORT void* operator new[] (std::size_t size, const std::nothrow_t&) PII_NEW_NOTHROW_SPEC
+{
+  return countedAlloc(size);
+}
+
+PII_DECL_EXPORT void operator delete (void* ptr) PII_NEW_NOTHROW_SPEC { std::free(ptr); }
+PII_DECL_EXPORT void operator delete[] (void* ptr) PII_NEW_NOTHROW_SPEC { std::free(ptr); }
+PII_DECL_EXPORT void operator delete (void* ptr, const std::nothrow_t&) PII_NEW_NOTHROW_SPEC { std::free(ptr); }
+PII_DECL_EXPORT void operator delete[] (void* ptr, const std::nothrow_t&) PII_NEW_NOTHROW_SPEC { std::free(ptr); }
+
+namespace Pii
+{
+  bool isAllocationCountingEnabled() { return true; }
+  quint64 allocationCount() { return iAllocationCount; }
+}
+
+#else
+
+namespace Pii
+{
+  bool isAllocationCountingEnabled() { return false; }
+  quint64 allocationCount() { return 0; }
+}
+
+#endif
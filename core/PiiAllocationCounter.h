@@ -0,0 +1,51 @@
+/* This file is part of Into.
+ * Copyright (C) Intopii 2013.
+ * All rights reserved.
+ *
+ * Licensees holding a commercial Into license may use this file in
+ * accordance with the commercial license agreement. Please see
+ * LICENSE.commercial for commercial licensing terms.
+ *
+ * Alternatively, this file may be used under the terms of the GNU
+ * Affero General Public License version 3 as published by the Free
+ * Software Foundation. In addition, Intopii gives you special rights
+ * to use Into as a part of open source software projects. Please
+ * refer to LICENSE.AGPL3 for details.
+ */
+
+
+#ifndef _PIIALLOCATIONCOUNTER_H
+#define _PIIALLOCATIONCOUNTER_H
+
+#include "PiiGlobal.h"
+
+namespace Pii
+{
+  /**
+   * Returns `true` if Into was built with allocation counting, and
+   * `false` otherwise. Allocation counting is enabled by building
+   * the core library with `qmake ENABLE=allocationcount`, which
+   * replaces the global `operator new` and `operator delete` with
+   * versions that count every allocation. The replacement costs a
+   * thread-local increment per allocation and is meant for debug
+   * builds only.
+   */
+  PII_CORE_EXPORT bool isAllocationCountingEnabled();
+
+  /**
+   * Returns the number of heap allocations made through `operator
+   * new` in the calling thread since the thread was started. If
+   * allocation counting is not enabled, returns zero. The difference
+   * of two successive calls gives the number of allocations made in
+   * between.
+   *
+   * ~~~(c++)
+   * quint64 iStart = Pii::allocationCount();
+   * process();
+   * quint64 iAllocations = Pii::allocationCount() - iStart;
+   * ~~~
+   */
+  PII_CORE_EXPORT quint64 allocationCount();
+}
+
+#endif //_PIIALLOCATIONCOUNTER_H
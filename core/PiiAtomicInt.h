@@ -39,6 +39,12 @@ struct PiiAtomicIntImpl
   int operator= (const PiiAtomicIntImpl& other) { return i = other.i; }
   int load() const { return i; }
   void store(int val) { i = val; }
+  bool compare_exchange_strong(int& expected, int val)
+  {
+    if (i == expected) { i = val; return true; }
+    expected = i;
+    return false;
+  }
   int operator++ () { return ++i; }
   int operator++ (int) { return i++; }
   int operator+= (int val) { return i += val; }
@@ -66,6 +72,21 @@ public:
   int deref() { return --_value; }
   int load() const { return _value.load(); }
   void store(int value) { _value.store(value); }
+#  ifdef PII_CXX11
+  int loadAcquire() const { return _value.load(std::memory_order_acquire); }
+  void storeRelease(int value) { _value.store(value, std::memory_order_release); }
+  int loadRelaxed() const { return _value.load(std::memory_order_relaxed); }
+  void storeRelaxed(int value) { _value.store(value, std::memory_order_relaxed); }
+#  else
+  int loadAcquire() const { return _value.load(); }
+  void storeRelease(int value) { _value.store(value); }
+  int loadRelaxed() const { return _value.load(); }
+  void storeRelaxed(int value) { _value.store(value); }
+#  endif
+  bool testAndSetOrdered(int expectedValue, int newValue)
+  {
+    return _value.compare_exchange_strong(expectedValue, newValue);
+  }
 
   int operator++ () { return ++_value; }
   int operator++ (int) { return _value++; }
@@ -112,6 +133,33 @@ public:
 #endif
   }
 
+  int loadAcquire() const
+  {
+#if QT_VERSION >= 0x050000
+    return _value.loadAcquire();
+#else
+    return const_cast<QAtomicInt&>(_value).fetchAndAddAcquire(0);
+#endif
+  }
+
+  void storeRelease(int value)
+  {
+#if QT_VERSION >= 0x050000
+    _value.storeRelease(value);
+#else
+    _value.fetchAndStoreRelease(value);
+#endif
+  }
+
+  // Qt's plain load() and store() have relaxed semantics.
+  int loadRelaxed() const { return load(); }
+  void storeRelaxed(int value) { store(value); }
+
+  bool testAndSetOrdered(int expectedValue, int newValue)
+  {
+    return _value.testAndSetOrdered(expectedValue, newValue);
+  }
+
   int operator++ () { return _value.fetchAndAddOrdered(1) + 1; }
   int operator++ (int) { return _value.fetchAndAddOrdered(1); }
   int operator-- () { return _value.fetchAndAddOrdered(-1) - 1; }
@@ -0,0 +1,164 @@
+/* This file is part of Into.
+ * Copyright (C) Intopii 2013.
+ * All rights reserved.
+ *
+ * Licensees holding a commercial Into license may use this file in
+ * accordance with the commercial license agreement. Please see
+ * LICENSE.commercial for commercial licensing terms.
+ *
+ * Alternatively, this file may be used under the terms of the GNU
+ * Affero General Public License version 3 as published by the Free
+ * Software Foundation. In addition, Intopii gives you special rights
+ * to use Into as a part of open source software projects. Please
+ * refer to LICENSE.AGPL3 for details.
+ */
+
+#include "PiiCpu.h"
+#include "PiiAtomicInt.h"
+
+#include <cstdlib>
+#include <cstring>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#  define PII_CPU_X86
+#elif defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+#  define PII_CPU_X86
+#  include <intrin.h>
+#  include <immintrin.h>
+#endif
+
+namespace Pii
+{
+  namespace
+  {
+    int detectFeatures()
+    {
+      int iFeatures = NoCpuFeatures;
+#if defined(PII_CPU_X86) && defined(_MSC_VER)
+      int aInfo[4];
+      __cpuid(aInfo, 0);
+      const int iMaxLeaf = aInfo[0];
+      __cpuid(aInfo, 1);
+      if (aInfo[3] & (1 << 26)) iFeatures |= Sse2CpuFeature;
+      if (aInfo[2] & (1 << 19)) iFeatures |= Sse41CpuFeature;
+      if (aInfo[2] & (1 << 23)) iFeatures |= PopcntCpuFeature;
+      // AVX needs OS support for the YMM state (OSXSAVE + XCR0) and
+      // AVX-512 for the opmask and ZMM states.
+      const bool bOsXsave = (aInfo[2] & (1 << 27)) != 0;
+      const unsigned iXcr0 = bOsXsave ? unsigned(_xgetbv(0)) : 0u;
+      const bool bOsAvx = (aInfo[2] & (1 << 28)) != 0 && (iXcr0 & 6) == 6;
+      const bool bOsAvx512 = bOsAvx && (iXcr0 & 0xe6) == 0xe6;
+      if (bOsAvx)
+        {
+          iFeatures |= AvxCpuFeature;
+          if (aInfo[2] & (1 << 12)) iFeatures |= FmaCpuFeature;
+        }
+      if (bOsAvx && iMaxLeaf >= 7)
+        {
+          __cpuidex(aInfo, 7, 0);
+          if (aInfo[1] & (1 << 5)) iFeatures |= Avx2CpuFeature;
+          if (bOsAvx512 && (aInfo[1] & (1 << 16)))
+            {
+              iFeatures |= Avx512FCpuFeature;
+              if (aInfo[1] & (1 << 30)) iFeatures |= Avx512BwCpuFeature;
+              if (aInfo[2] & (1 << 14)) iFeatures |= Avx512VpopcntdqCpuFeature;
+            }
+        }
+#elif defined(PII_CPU_X86)
+      // GCC and Clang check OS support for AVX states themselves.
+      __builtin_cpu_init();
+      if (__builtin_cpu_supports("sse2")) iFeatures |= Sse2CpuFeature;
+      if (__builtin_cpu_supports("sse4.1")) iFeatures |= Sse41CpuFeature;
+      if (__builtin_cpu_supports("popcnt")) iFeatures |= PopcntCpuFeature;
+      if (__builtin_cpu_supports("avx")) iFeatures |= AvxCpuFeature;
+      if (__builtin_cpu_supports("avx2")) iFeatures |= Avx2CpuFeature;
+      if (__builtin_cpu_supports("fma")) iFeatures |= FmaCpuFeature;
+      if (__builtin_cpu_supports("avx512f"))
+        {
+          iFeatures |= Avx512FCpuFeature;
+          if (__builtin_cpu_supports("avx512bw")) iFeatures |= Avx512BwCpuFeature;
+          if (__builtin_cpu_supports("avx512vpopcntdq")) iFeatures |= Avx512VpopcntdqCpuFeature;
+        }
+#elif defined(__aarch64__) || defined(_M_ARM64) || defined(__ARM_NEON) || defined(__ARM_NEON__)
+      // NEON is mandatory on 64-bit ARM. On 32-bit ARM, NEON code is
+      // only compiled if the compiler targets NEON anyway.
+      iFeatures |= NeonCpuFeature;
+#endif
+      return iFeatures;
+    }
+
+    int initialMask()
+    {
+      const char* pNames = std::getenv("PII_CPU_FEATURES");
+      return pNames != 0 ? parseCpuFeatures(pNames) : int(AllCpuFeatures);
+    }
+
+    PiiAtomicInt& featureMask()
+    {
+      static PiiAtomicInt iMask(initialMask());
+      return iMask;
+    }
+
+    struct FeatureName
+    {
+      const char* pName;
+      int iFeature;
+    };
+
+    const FeatureName featureNames[] =
+      {
+        { "none", NoCpuFeatures },
+        { "sse2", Sse2CpuFeature },
+        { "sse4.1", Sse41CpuFeature },
+        { "popcnt", PopcntCpuFeature },
+        { "avx", AvxCpuFeature },
+        { "avx2", Avx2CpuFeature },
+        { "fma", FmaCpuFeature },
+        { "avx512f", Avx512FCpuFeature },
+        { "avx512bw", Avx512BwCpuFeature },
+        { "avx512vpopcntdq", Avx512VpopcntdqCpuFeature },
+        { "neon", NeonCpuFeature }
+      };
+  }
+
+  int detectedCpuFeatures()
+  {
+    static const int iFeatures = detectFeatures();
+    return iFeatures;
+  }
+
+  int cpuFeatures()
+  {
+    return detectedCpuFeatures() & featureMask().load();
+  }
+
+  void setCpuFeatureMask(int mask)
+  {
+    featureMask().store(mask);
+  }
+
+  int cpuFeatureMask()
+  {
+    return featureMask().load();
+  }
+
+  int parseCpuFeatures(const char* names)
+  {
+    int iFeatures = NoCpuFeatures;
+    const char* p = names;
+    while (*p != 0)
+      {
+        while (*p == ' ') ++p;
+        const char* pEnd = p;
+        while (*pEnd != 0 && *pEnd != ',' && *pEnd != ' ') ++pEnd;
+        const std::size_t iLength = std::size_t(pEnd - p);
+        for (std::size_t i=0; i<sizeof(featureNames)/sizeof(featureNames[0]); ++i)
+          if (std::strlen(featureNames[i].pName) == iLength &&
+              std::strncmp(featureNames[i].pName, p, iLength) == 0)
+            iFeatures |= featureNames[i].iFeature;
+        while (*pEnd == ' ') ++pEnd;
+        p = *pEnd == ',' ? pEnd + 1 : pEnd;
+      }
+    return iFeatures;
+  }
+}
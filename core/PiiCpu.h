@@ -0,0 +1,318 @@
+/* This file is part of Into.
+ * Copyright (C) Intopii 2013.
+ * All rights reserved.
+ *
+ * Licensees holding a commercial Into license may use this file in
+ * accordance with the commercial license agreement. Please see
+ * LICENSE.commercial for commercial licensing terms.
+ *
+ * Alternatively, this file may be used under the terms of the GNU
+ * Affero General Public License version 3 as published by the Free
+ * Software Foundation. In addition, Intopii gives you special rights
+ * to use Into as a part of open source software projects. Please
+ * refer to LICENSE.AGPL3 for details.
+ */
+
+#ifndef _PIICPU_H
+#define _PIICPU_H
+
+#include "PiiGlobal.h"
+
+/**
+ * @file
+ *
+ * Run-time detection of CPU features and selection of optimized
+ * kernels. A single binary can contain kernels compiled for different
+ * instruction sets (with `__attribute__((target("avx2")))` on GCC and
+ * Clang, for example). The best kernel supported by the processor is
+ * chosen when the kernel is called.
+ *
+ * The set of features used for choosing kernels can be restricted
+ * for benchmarking and testing, either with [setCpuFeatureMask()] or
+ * by listing the allowed features in the `PII_CPU_FEATURES`
+ * environment variable before the program is started:
+ *
+ * ~~~
+ * # Compare AVX2 kernels to SSE2 ones
+ * PII_CPU_FEATURES=sse2 ./benchmark
+ * # Run the generic C++ code only
+ * PII_CPU_FEATURES=none ./benchmark
+ * ~~~
+ */
+
+namespace Pii
+{
+  /**
+   * CPU features that can be detected at run time.
+   *
+   * - `Sse2CpuFeature` - SSE2 (x86)
+   * - `Sse41CpuFeature` - SSE4.1 (x86)
+   * - `PopcntCpuFeature` - the POPCNT instruction (x86)
+   * - `AvxCpuFeature` - AVX, with OS support for the YMM state (x86)
+   * - `Avx2CpuFeature` - AVX2 (x86)
+   * - `FmaCpuFeature` - fused multiply-add (x86)
+   * - `Avx512FCpuFeature` - AVX-512 Foundation, with OS support for
+   * the ZMM and opmask states (x86)
+   * - `Avx512BwCpuFeature` - AVX-512 byte and word instructions (x86)
+   * - `Avx512VpopcntdqCpuFeature` - AVX-512 vector population count
+   * (x86)
+   * - `NeonCpuFeature` - NEON (ARM). Always present on 64-bit ARM.
+   */
+  enum CpuFeature
+    {
+      NoCpuFeatures = 0,
+      Sse2CpuFeature = 0x1,
+      Sse41CpuFeature = 0x2,
+      PopcntCpuFeature = 0x4,
+      AvxCpuFeature = 0x8,
+      Avx2CpuFeature = 0x10,
+      FmaCpuFeature = 0x20,
+      Avx512FCpuFeature = 0x40,
+      Avx512BwCpuFeature = 0x80,
+      Avx512VpopcntdqCpuFeature = 0x100,
+      NeonCpuFeature = 0x1000,
+      AllCpuFeatures = 0xffff
+    };
+
+  /**
+   * Returns the features supported by the processor and the
+   * operating system as a bitwise combination of [CpuFeature]
+   * values. The features are detected once, on the first call.
+   */
+  PII_CORE_EXPORT int detectedCpuFeatures();
+
+  /**
+   * Returns the features optimized code is allowed to use. This is
+   * the bitwise AND of [detectedCpuFeatures()] and
+   * [cpuFeatureMask()].
+   */
+  PII_CORE_EXPORT int cpuFeatures();
+
+  /**
+   * Returns `true` if all features in *features* can be used.
+   *
+   * ~~~(c++)
+   * if (Pii::hasCpuFeatures(Pii::Avx2CpuFeature | Pii::FmaCpuFeature))
+   *   sumAvx2(data, size);
+   * ~~~
+   */
+  inline bool hasCpuFeatures(int features) { return (cpuFeatures() & features) == features; }
+
+  /**
+   * Restricts the features returned by [cpuFeatures()] to *mask*.
+   * Use `AllCpuFeatures` to remove the restriction, or
+   * `NoCpuFeatures` to run generic code only. The initial mask is
+   * read from the `PII_CPU_FEATURES` environment variable, which is a
+   * comma-separated list of feature names (sse2, sse4.1, popcnt, avx,
+   * avx2, fma, avx512f, avx512bw, avx512vpopcntdq, neon) or "none".
+   * If the variable is not set, all features are allowed.
+   *
+   * This function is intended for benchmarking and testing. Kernels
+   * that are running while the mask changes are not affected.
+   */
+  PII_CORE_EXPORT void setCpuFeatureMask(int mask);
+
+  /**
+   * Returns the current feature mask.
+   */
+  PII_CORE_EXPORT int cpuFeatureMask();
+
+  /**
+   * Converts a comma-separated list of feature names to a bitwise
+   * combination of [CpuFeature] values. Unknown names are ignored.
+   * See [setCpuFeatureMask()] for the names.
+   */
+  PII_CORE_EXPORT int parseCpuFeatures(const char* names);
+}
+
+/**
+ * @def PII_X86_SIMD
+ *
+ * Defined if the compiler can generate x86 SIMD instructions for
+ * individual functions. `<immintrin.h>` is included, and
+ * [PII_CPU_TARGET] enables instruction sets beyond the compiler's
+ * defaults.
+ *
+ * @def PII_NEON_SIMD
+ *
+ * Defined if NEON is enabled at compile time. `<arm_neon.h>` is
+ * included.
+ *
+ * @def PII_NEON64_SIMD
+ *
+ * Defined together with `PII_NEON_SIMD` on 64-bit ARM, whose NEON
+ * has double-precision vectors and horizontal additions.
+ *
+ * @def PII_CPU_TARGET(ISA)
+ *
+ * Marks a function as compiled for the instruction set *ISA* (a
+ * comma-separated list such as "avx2" or "avx,fma"). Such a function
+ * must only be called if [Pii::hasCpuFeatures()] says the features
+ * are available.
+ *
+ * ~~~(c++)
+ * #ifdef PII_X86_SIMD
+ * PII_CPU_TARGET("avx2") void sumRowAvx2(const float* row, int length, float* sum);
+ * #endif
+ * ~~~
+ */
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#  define PII_X86_SIMD
+#  define PII_CPU_TARGET(ISA) __attribute__((target(ISA)))
+#  include <immintrin.h>
+#elif defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+// MSVC allows all intrinsics everywhere.
+#  define PII_X86_SIMD
+#  define PII_CPU_TARGET(ISA)
+#  include <immintrin.h>
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#  define PII_NEON_SIMD
+#  ifdef __aarch64__
+#    define PII_NEON64_SIMD
+#  endif
+#  define PII_CPU_TARGET(ISA)
+#  include <arm_neon.h>
+#else
+#  define PII_CPU_TARGET(ISA)
+#endif
+
+namespace Pii
+{
+  /**
+   * The widest SIMD instruction set a kernel can use. Kernels that
+   * come in 128-bit and 256-bit versions switch on [simdLevel()]
+   * instead of testing the features one by one.
+   *
+   * - `NoSimd` - generic C++ code only
+   * - `Sse2Simd` - SSE2 (x86)
+   * - `Avx2Simd` - AVX2 (x86)
+   * - `NeonSimd` - NEON (ARM)
+   */
+  enum SimdLevel { NoSimd, Sse2Simd, Avx2Simd, NeonSimd };
+
+  /**
+   * Returns the best [SimdLevel] allowed by [cpuFeatures()]. Kernels
+   * that need other features, such as FMA, should be chosen with
+   * PiiCpuDispatcher.
+   */
+  inline SimdLevel simdLevel()
+  {
+#if defined(PII_X86_SIMD)
+    if (hasCpuFeatures(Avx2CpuFeature))
+      return Avx2Simd;
+    if (hasCpuFeatures(Sse2CpuFeature))
+      return Sse2Simd;
+    return NoSimd;
+#elif defined(PII_NEON_SIMD)
+    return hasCpuFeatures(NeonCpuFeature) ? NeonSimd : NoSimd;
+#else
+    return NoSimd;
+#endif
+  }
+}
+
+/**
+ * A table of kernel functions compiled for different instruction
+ * sets. Each kernel is registered together with the CPU features it
+ * needs, and [function()] returns the last registered kernel whose
+ * features are all available. Kernels should thus be added in the
+ * order of increasing preference. If none of them can be used, the
+ * generic kernel given in the constructor is returned.
+ *
+ * Tables are usually created once as function-local statics:
+ *
+ * ~~~(c++)
+ * typedef void (*SumFunction)(const float*, int, float*);
+ *
+ * float sum(const PiiMatrix<float>& matrix)
+ * {
+ *   static const PiiCpuDispatcher<SumFunction> sumRow =
+ *     PiiCpuDispatcher<SumFunction>(sumRowGeneric)
+ *     .add(Pii::Sse2CpuFeature, sumRowSse2)
+ *     .add(Pii::Avx2CpuFeature | Pii::FmaCpuFeature, sumRowAvx2)
+ *     .add(Pii::NeonCpuFeature, sumRowNeon);
+ *
+ *   // Choose once, not for every row
+ *   SumFunction pSumRow = sumRow.function();
+ *   float fSum = 0;
+ *   for (int r=0; r<matrix.rows(); ++r)
+ *     pSumRow(matrix[r], matrix.columns(), &fSum);
+ *   return fSum;
+ * }
+ * ~~~
+ *
+ * The choice is not cached because the feature mask may change.
+ * Selecting a kernel is cheap, but it should still not be done in
+ * inner loops.
+ */
+template <class Function> class PiiCpuDispatcher
+{
+public:
+  enum { MaxKernelCount = 8 };
+
+  /**
+   * Creates a table whose fallback kernel is *generic*.
+   */
+  PiiCpuDispatcher(Function generic) :
+    _iKernelCount(0),
+    _pGeneric(generic)
+  {}
+
+  /**
+   * Adds *function* to the table. The function will be used if
+   * all of *features* are available and no kernel added later can be
+   * used. Null functions are ignored, which makes it possible to
+   * register kernels that were not compiled in on the current
+   * platform. At most `MaxKernelCount` kernels can be added.
+   *
+   * @return a reference to this table
+   */
+  PiiCpuDispatcher& add(int features, Function function)
+  {
+    if (function != 0 && _iKernelCount < MaxKernelCount)
+      {
+        _aKernels[_iKernelCount].iFeatures = features;
+        _aKernels[_iKernelCount].pFunction = function;
+        ++_iKernelCount;
+      }
+    return *this;
+  }
+
+  /**
+   * Returns the best kernel for the current CPU and feature mask.
+   */
+  Function function() const
+  {
+    const int iFeatures = Pii::cpuFeatures();
+    for (int i=_iKernelCount; i--; )
+      if ((iFeatures & _aKernels[i].iFeatures) == _aKernels[i].iFeatures)
+        return _aKernels[i].pFunction;
+    return _pGeneric;
+  }
+
+  /**
+   * Returns the CPU features required by the kernel [function()]
+   * currently returns. Useful in benchmark reports.
+   */
+  int features() const
+  {
+    const int iFeatures = Pii::cpuFeatures();
+    for (int i=_iKernelCount; i--; )
+      if ((iFeatures & _aKernels[i].iFeatures) == _aKernels[i].iFeatures)
+        return _aKernels[i].iFeatures;
+    return Pii::NoCpuFeatures;
+  }
+
+private:
+  struct Kernel
+  {
+    int iFeatures;
+    Function pFunction;
+  };
+
+  Kernel _aKernels[MaxKernelCount];
+  int _iKernelCount;
+  Function _pGeneric;
+};
+
+#endif //_PIICPU_H
@@ -0,0 +1,289 @@
+/* This file is part of Into.
+ * Copyright (C) Intopii 2013.
+ * All rights reserved.
+ *
+ * Licensees holding a commercial Into license may use this file in
+ * accordance with the commercial license agreement. Please see
+ * LICENSE.commercial for commercial licensing terms.
+ *
+ * Alternatively, this file may be used under the terms of the GNU
+ * Affero General Public License version 3 as published by the Free
+ * Software Foundation. In addition, Intopii gives you special rights
+ * to use Into as a part of open source software projects. Please
+ * refer to LICENSE.AGPL3 for details.
+ */
+
+#ifndef _PIIFASTMATH_H
+#define _PIIFASTMATH_H
+
+#include <QtGlobal>
+#include <limits>
+
+namespace Pii
+{
+  /// @hide
+  namespace FastMath
+  {
+    union FloatBits { float value; qint32 bits; };
+    union DoubleBits { double value; qint64 bits; };
+
+    inline qint32 floatBits(float value) { FloatBits u; u.value = value; return u.bits; }
+    inline float bitsToFloat(qint32 bits) { FloatBits u; u.bits = bits; return u.value; }
+    inline qint64 doubleBits(double value) { DoubleBits u; u.value = value; return u.bits; }
+    inline double bitsToDouble(qint64 bits) { DoubleBits u; u.bits = bits; return u.value; }
+
+    // Branch-free selection. The compiler won't if-convert a
+    // conditional if one of its operands is a floating-point
+    // expression that might trap.
+    inline float select(bool condition, float a, float b)
+    {
+      const qint32 iMask = -qint32(condition);
+      return bitsToFloat((floatBits(a) & iMask) | (floatBits(b) & ~iMask));
+    }
+    inline double select(bool condition, double a, double b)
+    {
+      const qint64 iMask = -qint64(condition);
+      return bitsToDouble((doubleBits(a) & iMask) | (doubleBits(b) & ~iMask));
+    }
+
+    // Flips the sign of value if the lowest bit of flip is set.
+    inline float flipSign(float value, int flip)
+    {
+      return bitsToFloat(floatBits(value) ^ qint32(quint32(flip) << 31));
+    }
+    inline double flipSign(double value, int flip)
+    {
+      return bitsToDouble(doubleBits(value) ^ qint64(quint64(flip) << 63));
+    }
+
+    inline int signBit(float value) { return int(quint32(floatBits(value)) >> 31); }
+    inline int signBit(double value) { return int(quint64(doubleBits(value)) >> 63); }
+
+    // Rounds to the nearest integer without a function call or a
+    // branch. Adding 1.5 * 2^23 (2^52) pushes the fraction out of
+    // the mantissa, whose low bits are then the rounded integer.
+    // Valid for |value| < 2^22.
+    inline int roundToInt(float value)
+    {
+      return floatBits(value + 12582912.0f) - 0x4b400000;
+    }
+    inline int roundToInt(double value)
+    {
+      return int(doubleBits(value + 6755399441055744.0) - Q_INT64_C(0x4338000000000000));
+    }
+
+    // 2^n for n in [-252, 254]. The scaling is done in two halves so
+    // that the extreme exponents don't overflow the exponent field.
+    inline float scale(float value, int n)
+    {
+      const int iHalf = n >> 1;
+      return value * bitsToFloat((iHalf + 127) << 23) * bitsToFloat((n - iHalf + 127) << 23);
+    }
+
+    inline double scale(double value, int n)
+    {
+      const int iHalf = n >> 1;
+      return value *
+        bitsToDouble(qint64(iHalf + 1023) << 52) *
+        bitsToDouble(qint64(n - iHalf + 1023) << 52);
+    }
+
+    // Reduces x to [-pi/4, pi/4]. Returns the octant.
+    inline int reduceAngle(float& x)
+    {
+      // The reduction is done in double precision. Otherwise the
+      // error would grow with the magnitude of x.
+      int j = int(x * 1.27323954473516f); // 4/pi
+      j = (j + 1) & ~1;
+      const double y = double(j);
+      x = float(((double(x) - y * 7.85398125648498535156e-1) - y * 3.77489470793079817668e-8) -
+                y * 2.69515142907905952645e-15);
+      return j;
+    }
+
+    inline int reduceAngle(double& x)
+    {
+      int j = int(x * 1.27323954473516268615); // 4/pi
+      j = (j + 1) & ~1;
+      const double y = double(j);
+      x = ((x - y * 7.85398125648498535156e-1) - y * 3.77489470793079817668e-8) - y * 2.69515142907905952645e-15;
+      return j;
+    }
+
+    inline float sinPolynomial(float x, float z)
+    {
+      return ((-1.9515295891e-4f * z + 8.3321608736e-3f) * z - 1.6666654611e-1f) * z * x + x;
+    }
+
+    inline float cosPolynomial(float z)
+    {
+      return ((2.443315711809948e-5f * z - 1.388731625493765e-3f) * z + 4.166664568298827e-2f) * z * z -
+        0.5f * z + 1.0f;
+    }
+
+    inline double sinPolynomial(double x, double z)
+    {
+      return x + x * z *
+        (((((1.58962301576546568060e-10 * z - 2.50507477628578072866e-8) * z +
+            2.75573136213857245213e-6) * z - 1.98412698295895385996e-4) * z +
+          8.33333333332211858878e-3) * z - 1.66666666666666307295e-1);
+    }
+
+    inline double cosPolynomial(double z)
+    {
+      return 1.0 - 0.5 * z + z * z *
+        (((((-1.13585365213876817300e-11 * z + 2.08757008419747316778e-9) * z -
+            2.75573141792967388112e-7) * z + 2.48015872888517045348e-5) * z -
+          1.38888888888730564116e-3) * z + 4.16666666666665929218e-2);
+    }
+
+    // sin() is odd and cos() even. The offset shifts the octant
+    // by pi/2 for cos().
+    template <class T> inline T sinCos(T x, int offset)
+    {
+      const int iSign = offset == 0 ? signBit(x) : 0;
+      x = flipSign(x, signBit(x));
+      const int j = reduceAngle(x) + offset;
+      const T z = x * x;
+      const T result = select((j & 2) != 0, cosPolynomial(z), sinPolynomial(x, z));
+      return flipSign(result, ((j >> 2) ^ iSign) & 1);
+    }
+  }
+  /// @endhide
+
+  /**
+   * @group fastmath Fast approximations
+   *
+   * Polynomial approximations to transcendental functions. The
+   * functions contain no branches or library calls, which makes it
+   * possible for the compiler to inline them into loops and to
+   * vectorize the loops. The maximum error is given in units in the
+   * last place (ULP) relative to the correctly rounded result. The
+   * result of a NaN input is unspecified, and denormal results are
+   * flushed to zero.
+   *
+   * The matrix versions declared in PiiMath.h are evaluated row by
+   * row through raw pointers when assigned to a PiiMatrix. Thus,
+   * `PiiMatrix<float>(Pii::fastExp(mat))` runs as a tight loop over
+   * each row.
+   */
+
+  /**
+   * Returns \(e^x\). The maximum error is 1 ULP. Inputs below -87.3
+   * return zero, and inputs above 88.7 return infinity.
+   */
+  inline float fastExp(float x)
+  {
+    const float fX = FastMath::select(x < -88.0f, -88.0f, FastMath::select(x > 89.0f, 89.0f, x));
+    const int n = FastMath::roundToInt(fX * 1.44269504088896341f); // log2(e)
+    const float r = (fX - float(n) * 0.693359375f) + float(n) * 2.12194440e-4f;
+    const float p = ((((((1.9875691500e-4f * r + 1.3981999507e-3f) * r +
+                         8.3334519073e-3f) * r + 4.1665795894e-2f) * r +
+                       1.6666665459e-1f) * r + 5.0000001201e-1f) * r * r + r) + 1.0f;
+    const float result = FastMath::scale(p, n);
+    return FastMath::select(x < -87.33654f, 0.0f,
+                            FastMath::select(x > 88.72283f, std::numeric_limits<float>::infinity(), result));
+  }
+
+  /**
+   * Returns \(e^x\). The maximum error is 2 ULP. Inputs below -708.39
+   * return zero, and inputs above 709.78 return infinity.
+   */
+  inline double fastExp(double x)
+  {
+    const double dX = FastMath::select(x < -708.5, -708.5, FastMath::select(x > 710.0, 710.0, x));
+    const int n = FastMath::roundToInt(dX * 1.4426950408889634073599); // log2(e)
+    const double r = (dX - double(n) * 6.93145751953125e-1) - double(n) * 1.42860682030941723212e-6;
+    const double z = r * r;
+    const double px = r * ((1.26177193074810590878e-4 * z + 3.02994407707441961300e-2) * z +
+                           9.99999999999999999910e-1);
+    const double qx = ((3.00198505138664455042e-6 * z + 2.52448340349684104192e-3) * z +
+                       2.27265548208155028766e-1) * z + 2.00000000000000000009e0;
+    const double result = FastMath::scale(1.0 + 2.0 * px / (qx - px), n);
+    return FastMath::select(x < -708.39641853226408, 0.0,
+                            FastMath::select(x > 709.78271289338397, std::numeric_limits<double>::infinity(), result));
+  }
+
+  /**
+   * Returns the natural logarithm of *x*. The maximum error is 1 ULP
+   * for normal positive inputs. Returns `-inf` for zero and NaN for
+   * negative inputs.
+   */
+  inline float fastLog(float x)
+  {
+    const qint32 iBits = FastMath::floatBits(x);
+    // Split x to m * 2^e, with m in [sqrt(1/2), sqrt(2)).
+    const qint32 iOffset = iBits - 0x3f3504f3; // sqrt(1/2)
+    const int e = iOffset >> 23;
+    const float f = FastMath::bitsToFloat(iBits - (e << 23)) - 1.0f;
+    const float z = f * f;
+    float y = ((((((((7.0376836292e-2f * f - 1.1514610310e-1f) * f +
+                     1.1676998740e-1f) * f - 1.2420140846e-1f) * f +
+                   1.4249322787e-1f) * f - 1.6668057665e-1f) * f +
+                 2.0000714765e-1f) * f - 2.4999993993e-1f) * f +
+               3.3333331174e-1f) * f * z;
+    const float fE = float(e);
+    y += -2.12194440e-4f * fE - 0.5f * z;
+    const float result = (f + y) + 0.693359375f * fE;
+    typedef std::numeric_limits<float> Limits;
+    return FastMath::select(x > 0, FastMath::select(x < Limits::infinity(), result, x),
+                            FastMath::select(x == 0, -Limits::infinity(), Limits::quiet_NaN()));
+  }
+
+  /**
+   * Returns the natural logarithm of *x*. The maximum error is 1 ULP
+   * for normal positive inputs. Returns `-inf` for zero and NaN for
+   * negative inputs.
+   */
+  inline double fastLog(double x)
+  {
+    const qint64 iBits = FastMath::doubleBits(x);
+    const qint64 iOffset = iBits - Q_INT64_C(0x3fe6a09e667f3bcd); // sqrt(1/2)
+    const int e = int(iOffset >> 52);
+    const double f = FastMath::bitsToDouble(iBits - (qint64(e) << 52)) - 1.0;
+    const double z = f * f;
+    const double p = ((((1.01875663804580931796e-4 * f + 4.97494994976747001425e-1) * f +
+                        4.70579119878881725854e0) * f + 1.44989225341610930846e1) * f +
+                      1.79368678507819816313e1) * f + 7.70838733755885391666e0;
+    const double q = ((((f + 1.12873587189167450590e1) * f + 4.52279145837532221105e1) * f +
+                       8.29875266912776603211e1) * f + 7.11544750618563894466e1) * f +
+      2.31251620126765340583e1;
+    const double dE = double(e);
+    const double y = f * (z * p / q) - dE * 2.121944400546905827679e-4 - 0.5 * z;
+    const double result = (f + y) + dE * 0.693359375;
+    typedef std::numeric_limits<double> Limits;
+    return FastMath::select(x > 0, FastMath::select(x < Limits::infinity(), result, x),
+                            FastMath::select(x == 0, -Limits::infinity(), Limits::quiet_NaN()));
+  }
+
+  /**
+   * Returns the sine of *x* (in radians). The maximum error is 2 ULP
+   * for \(|x| < 10^6\). Accuracy degrades with larger arguments.
+   */
+  inline float fastSin(float x) { return FastMath::sinCos(x, 0); }
+  /**
+   * Returns the sine of *x* (in radians). The maximum error is 2 ULP
+   * for \(|x| < 10^8\).
+   */
+  inline double fastSin(double x) { return FastMath::sinCos(x, 0); }
+
+  /**
+   * Returns the cosine of *x* (in radians). The maximum error is 2
+   * ULP for \(|x| < 10^6\).
+   */
+  inline float fastCos(float x) { return FastMath::sinCos(x, 2); }
+  /**
+   * Returns the cosine of *x* (in radians). The maximum error is 2
+   * ULP for \(|x| < 10^8\).
+   */
+  inline double fastCos(double x) { return FastMath::sinCos(x, 2); }
+
+  /**
+   * Returns the tangent of *x* (in radians). The maximum error is 4
+   * ULP in the same ranges as [fastSin()].
+   */
+  inline float fastTan(float x) { return fastSin(x) / fastCos(x); }
+  inline double fastTan(double x) { return fastSin(x) / fastCos(x); }
+}
+
+#endif //_PIIFASTMATH_H
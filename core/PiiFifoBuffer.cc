@@ -14,18 +14,26 @@
  */
 
 #include "PiiFifoBuffer.h"
-#include <QMutexLocker>
 #include <cstdlib>
+#include <cstring>
+
+static uint roundToPowerOfTwo(qint64 size)
+{
+  uint uiCapacity = 1;
+  while (uiCapacity < size && uiCapacity < (1u << 30))
+    uiCapacity <<= 1;
+  return uiCapacity;
+}
 
 PiiFifoBuffer::Data::Data(qint64 size) :
-  iSize(size),
-  iReadStart(0),
-  iWriteStart(0),
-  iFreeSpace(size),
+  uiCapacity(roundToPowerOfTwo(size)),
+  uiMask(uiCapacity - 1),
+  pBuffer((char*)std::malloc(uiCapacity)),
+  iWritePos(0),
+  iReadPos(0),
   iReadTotal(0),
-  pBuffer((char*)std::malloc(size)),
   ulWaitTime(100),
-  bWriteFinished(false)
+  iWriteFinished(0)
 {
 }
 
@@ -41,48 +49,69 @@ PiiFifoBuffer::~PiiFifoBuffer()
   delete d;
 }
 
+qint64 PiiFifoBuffer::capacity() const
+{
+  return d->uiCapacity;
+}
+
+// Called by the reader. The write position is acquired so that the
+// data written before it is visible.
+uint PiiFifoBuffer::readableBytes() const
+{
+  return uint(d->iWritePos.loadAcquire()) - uint(d->iReadPos.loadRelaxed());
+}
+
+// Called by the writer.
+uint PiiFifoBuffer::writableBytes() const
+{
+  return d->uiCapacity - (uint(d->iWritePos.loadRelaxed()) - uint(d->iReadPos.loadAcquire()));
+}
+
+bool PiiFifoBuffer::waitForData()
+{
+  // If writing has not been finished, and wait time is set, we need
+  // to wait a bit. A wake-up may be left over from an earlier write,
+  // so the caller must check the buffer again.
+  if (d->iWriteFinished.loadAcquire() == 0 && d->ulWaitTime > 0 &&
+      d->dataWritten.wait(d->ulWaitTime))
+    return true;
+  return readableBytes() > 0;
+}
+
+bool PiiFifoBuffer::waitForSpace()
+{
+  if (d->ulWaitTime > 0 && d->dataRead.wait(d->ulWaitTime))
+    return true;
+  return writableBytes() > 0;
+}
+
 bool PiiFifoBuffer::atEnd() const
 {
-  return (d->iSize - d->iFreeSpace) == 0 && d->bWriteFinished;
+  return readableBytes() == 0 && d->iWriteFinished.loadAcquire() != 0;
 }
 
 qint64 PiiFifoBuffer::pos() const
 {
-  //qDebug("Pos: %d", (int)(d->iReadTotal - QIODevice::bytesAvailable()));
   return d->iReadTotal - QIODevice::bytesAvailable();
 }
 
 bool PiiFifoBuffer::seek(qint64 position)
 {
-  d->bufferLock.lock();
-  //qDebug("Seek to: %d, current: %d", (int)position, (int)pos());
   // Cannot seek back beyond the unget buffer
   if (position < pos())
-    {
-      d->bufferLock.unlock();
-      return false;
-    }
+    return false;
 
   QIODevice::seek(position);
-  //qDebug("Pos after QIODevice::seek: %d", (int)pos());
   qint64 diff = position - d->iReadTotal;
   if (diff > 0)
-    {
-      //qDebug("Discarding %d bytes", (int)diff);
-      return readBytes(0, diff) == diff;
-    }
-  d->bufferLock.unlock();
+    return readBytes(0, diff) == diff;
   return true;
 }
 
 qint64 PiiFifoBuffer::bytesAvailable () const
 {
-  /*qDebug("Bytes available: %d (unget buffer: %d)",
-         (int)(d->iSize-d->iFreeSpace+QIODevice::bytesAvailable()),
-         (int)QIODevice::bytesAvailable());
-  */
-  // My free space + the size of the unget buffer
-  return d->iSize - d->iFreeSpace + QIODevice::bytesAvailable();
+  // Unread bytes in the ring + the size of the unget buffer
+  return qint64(readableBytes()) + QIODevice::bytesAvailable();
 }
 
 void PiiFifoBuffer::setWaitTime(unsigned long readWaitTime) { d->ulWaitTime = readWaitTime; }
@@ -93,28 +122,75 @@ bool PiiFifoBuffer::isSequential() const { return true; }
 bool PiiFifoBuffer::reset()
 {
   QIODevice::reset();
-  QMutexLocker lock(&d->bufferLock);
-  d->iReadStart = d->iWriteStart = d->iReadTotal = 0;
-  d->iFreeSpace = d->iSize;
-  d->bWriteFinished = false;
+  d->iReadPos.store(0);
+  d->iWritePos.store(0);
+  d->iReadTotal = 0;
+  d->iWriteFinished.storeRelease(0);
   return true;
 }
 
 void PiiFifoBuffer::finishWriting()
 {
-  QMutexLocker lock(&d->bufferLock);
-  d->bWriteFinished = true;
+  d->iWriteFinished.storeRelease(1);
   // Wake a waiting reader
   d->dataWritten.wakeOne();
 }
 
+const char* PiiFifoBuffer::readSpan(qint64* size)
+{
+  uint uiAvailable;
+  while ((uiAvailable = readableBytes()) == 0)
+    {
+      if (!waitForData())
+        {
+          *size = 0;
+          return d->pBuffer;
+        }
+    }
+  const uint uiStart = uint(d->iReadPos.loadRelaxed()) & d->uiMask;
+  *size = qMin(uiAvailable, d->uiCapacity - uiStart);
+  return d->pBuffer + uiStart;
+}
+
+void PiiFifoBuffer::commitRead(qint64 size)
+{
+  if (size <= 0)
+    return;
+  d->iReadPos.storeRelease(int(uint(d->iReadPos.loadRelaxed()) + uint(size)));
+  d->iReadTotal += size;
+  // Wake up any pending write operation
+  d->dataRead.wakeOne();
+}
+
+char* PiiFifoBuffer::writeSpan(qint64* size)
+{
+  uint uiFree;
+  while ((uiFree = writableBytes()) == 0)
+    {
+      if (!waitForSpace())
+        {
+          *size = 0;
+          return d->pBuffer;
+        }
+    }
+  const uint uiStart = uint(d->iWritePos.loadRelaxed()) & d->uiMask;
+  *size = qMin(uiFree, d->uiCapacity - uiStart);
+  return d->pBuffer + uiStart;
+}
+
+void PiiFifoBuffer::commitWrite(qint64 size)
+{
+  if (size <= 0)
+    return;
+  d->iWritePos.storeRelease(int(uint(d->iWritePos.loadRelaxed()) + uint(size)));
+  // Wake up any pending read operation
+  d->dataWritten.wakeOne();
+}
+
 qint64 PiiFifoBuffer::readData(char * data, qint64 maxSize)
 {
-  //qDebug("PiiFifoBuffer::readData(0x%x, %d)", (int)data, (int)maxSize);
   if (maxSize == 0)
     return 0;
-
-  d->bufferLock.lock();
   return readBytes(data, maxSize);
 }
 
@@ -125,121 +201,49 @@ qint64 PiiFifoBuffer::readBytes(char * data, qint64 maxSize)
   // Read until everything was received
   while (bytesRemaining > 0)
     {
-      // If no data is available, we must wait
-      if (d->iSize - d->iFreeSpace == 0)
+      qint64 len = 0;
+      const char* pSpan = readSpan(&len);
+      // No more data is available -> return. This happens if writing
+      // is finished or new data comes too late.
+      if (len == 0)
+        break;
+      if (len > bytesRemaining)
+        len = bytesRemaining;
+      if (data)
         {
-          // If writing has not been finished, and wait time is set, we need to wait a bit
-          if (!d->bWriteFinished && d->ulWaitTime > 0)
-            d->dataWritten.wait(&d->bufferLock, d->ulWaitTime);
-          // No more data is available -> return
-          // This happens if writing is finished or new data comes too late
-          if (d->iSize - d->iFreeSpace == 0)
-            {
-              /*qDebug("Read wait exited with no signal! "
-                     "remaining: %d, maxSize: %d, bytes available: %d",
-                     (int)bytesRemaining, (int)maxSize, (int)(d->iSize - d->iFreeSpace));
-              */
-              d->bufferLock.unlock();
-              return maxSize - bytesRemaining;
-            }
+          ::memcpy(data, pSpan, len);
+          data += len;
         }
-      // Read as much as possible
-      // Len must be larger than zero because new data has arrived
-      qint64 len = bytesRemaining < (d->iSize - d->iFreeSpace) ? bytesRemaining : (d->iSize - d->iFreeSpace);
-
-      //qDebug("Reading %d bytes", (int)len);
-      qint64 end = d->iReadStart + len;
-      //printf("len = %d, freeSpace = %d, start = %d, end = %d\n", len, d->iFreeSpace, d->iReadStart, end);
-      // The buffer is addressed circularly.
-      if (end <= d->iSize)  // We can read the whole part at once
-        {
-          if (data)
-            ::memcpy(data, d->pBuffer + d->iReadStart, len);
-          d->iReadStart += len;
-          if (d->iReadStart >= d->iSize)
-            d->iReadStart -= d->iSize;
-        }
-      else // We must read both at the end and at the beginning
-        {
-          qint64 firstPieceLen = d->iSize - d->iReadStart;
-          if (data)
-            {
-              ::memcpy(data, d->pBuffer + d->iReadStart, firstPieceLen);
-              ::memcpy(data + firstPieceLen, d->pBuffer, len-firstPieceLen);
-            }
-          d->iReadStart = len-firstPieceLen;
-        }
-      d->iFreeSpace += len;
-      data += len;
+      commitRead(len);
       bytesRemaining -= len;
-      d->iReadTotal += len;
-
-      // Wake up any pending write operation
-      d->dataRead.wakeOne();
     }
 
-  d->bufferLock.unlock();
-  return maxSize;
+  return maxSize - bytesRemaining;
 }
 
 qint64 PiiFifoBuffer::writeData(const char * data, qint64 maxSize)
 {
-  //qDebug("PiiFifoBuffer::writeData(0x%x, %d)", (int)data, (int)maxSize);
   if (maxSize == 0)
     return 0;
 
-  d->bufferLock.lock();
-
   // Analogous to readData
   qint64 bytesRemaining = maxSize;
 
   // Write in pieces until everything is completed
   while (bytesRemaining > 0)
     {
-      // Write as much as possible
-      // Can't write yet. Wait for a while
-      if (d->iFreeSpace == 0)
-        {
-          //qDebug("Cannot write yet. Waiting for %ld msec.", d->ulWaitTime);
-          // This is signalled whenever new data arrives
-          bool dataRead = d->ulWaitTime > 0 && d->dataRead.wait(&d->bufferLock, d->ulWaitTime);
-          if (!dataRead)
-            {
-              /*qDebug("Write wait exited with no signal! "
-                     "remaining: %d, maxSize: %d, free space: %d",
-                     (int)bytesRemaining, (int)maxSize, (int)d->iFreeSpace);
-              */
-              d->bufferLock.unlock();
-              return maxSize - bytesRemaining;
-            }
-        }
-      qint64 len = bytesRemaining < d->iFreeSpace ? bytesRemaining : d->iFreeSpace;
-
-      //qDebug("Writing %d bytes", (int)len);
-      qint64 end = d->iWriteStart + len;
-      //printf("len = %d, freeSpace = %d, start = %d, end = %d\n", len, d->iFreeSpace, d->iWriteStart, end);
-      if (end <= d->iSize)
-        {
-          ::memcpy(d->pBuffer + d->iWriteStart, data, len);
-          d->iWriteStart += len;
-          if (d->iWriteStart >= d->iSize)
-            d->iWriteStart -= d->iSize;
-        }
-      else
-        {
-          qint64 firstPieceLen = d->iSize - d->iWriteStart;
-          ::memcpy(d->pBuffer + d->iWriteStart, data, firstPieceLen);
-          ::memcpy(d->pBuffer, data + firstPieceLen, len-firstPieceLen);
-          d->iWriteStart = len-firstPieceLen;
-        }
-      d->iFreeSpace -= len;
+      qint64 len = 0;
+      char* pSpan = writeSpan(&len);
+      // Can't write. The reader didn't make room in time.
+      if (len == 0)
+        break;
+      if (len > bytesRemaining)
+        len = bytesRemaining;
+      ::memcpy(pSpan, data, len);
+      commitWrite(len);
       data += len;
       bytesRemaining -= len;
-
-      // Wake up any pending read operation
-      d->dataWritten.wakeOne();
     }
 
-  d->bufferLock.unlock();
-  return maxSize;
+  return maxSize - bytesRemaining;
 }
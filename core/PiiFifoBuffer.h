@@ -17,9 +17,9 @@
 #define _PIIFIFOBUFFER_H
 
 #include <QIODevice>
-#include <QMutex>
-#include <QWaitCondition>
 #include "PiiGlobal.h"
+#include "PiiAtomicInt.h"
+#include "PiiWaitCondition.h"
 
 /**
  * A first in first out I/O device. PiiFifoBuffer is a thread-safe
@@ -28,6 +28,23 @@
  * a replacement to QBuffer in situations where the amount of incoming
  * data is unlimited.
  *
+ * The buffer is a lock-free ring for one writer and one reader
+ * thread. Neither side takes a lock unless it needs to wait for the
+ * other one. To avoid copying the data twice, the reader and the
+ * writer can also access the ring directly:
+ *
+ * ~~~(c++)
+ * // Writer
+ * qint64 iSize = 0;
+ * char* pSpan = fifo.writeSpan(&iSize);
+ * iSize = encoder.encode(pSpan, iSize);
+ * fifo.commitWrite(iSize);
+ *
+ * // Reader
+ * const char* pData = fifo.readSpan(&iSize);
+ * socket.write(pData, iSize);
+ * fifo.commitRead(iSize);
+ * ~~~
  */
 class PII_CORE_EXPORT PiiFifoBuffer : public QIODevice
 {
@@ -37,12 +54,55 @@ public:
   /**
    * Creates a new fifo buffer.
    *
-   * @param size the number of bytes to reserve for the memory buffer
+   * @param size the number of bytes to reserve for the memory buffer.
+   * The size will be rounded up to the next power of two, at most
+   * 2^30.
    */
   PiiFifoBuffer(qint64 size);
 
   ~PiiFifoBuffer();
 
+  /**
+   * Returns the number of bytes the buffer can hold.
+   */
+  qint64 capacity() const;
+
+  /**
+   * Returns a pointer to the next contiguous block of unread data and
+   * stores its length to *size*. Since the ring may wrap around, the
+   * block may be shorter than [bytesAvailable()]. If the buffer is
+   * empty, waits at most [waitTime()] milliseconds for data, like
+   * [readData()]. If no data arrives, *size* will be set to zero.
+   *
+   * The data stays in the buffer until [commitRead()] is called. The
+   * span functions bypass the internal buffer of QIODevice. Don't mix
+   * them with `read()` or `peek()` unless the QIODevice buffer is
+   * empty.
+   */
+  const char* readSpan(qint64* size);
+
+  /**
+   * Marks *size* bytes returned by [readSpan()] as read. *size* must
+   * not exceed the length of the span.
+   */
+  void commitRead(qint64 size);
+
+  /**
+   * Returns a pointer to the next contiguous block of free space and
+   * stores its length to *size*. If the buffer is full, waits at most
+   * [waitTime()] milliseconds. If no space becomes free, *size* will
+   * be set to zero. The data written to the span becomes visible to
+   * the reader only after [commitWrite()].
+   */
+  char* writeSpan(qint64* size);
+
+  /**
+   * Makes *size* bytes written to the span returned by [writeSpan()]
+   * available to the reader. *size* must not exceed the length of the
+   * span.
+   */
+  void commitWrite(qint64 size);
+
   /**
    * Sets the number of millisecond a reader/writer will halted if no
    * data is available for reading or there is no free space for
@@ -59,7 +119,8 @@ public:
 
   /**
    * Moves both reading and writing position to the beginning of the
-   * buffer.
+   * buffer. This function must not be called while another thread is
+   * reading or writing.
    */
   bool reset();
 
@@ -118,17 +179,25 @@ protected:
 
 private:
   qint64 readBytes(char * data, qint64 maxSize);
+  uint readableBytes() const;
+  uint writableBytes() const;
+  bool waitForData();
+  bool waitForSpace();
 
   class Data
   {
   public:
     Data(qint64 size);
-    qint64 iSize, iReadStart, iWriteStart, iFreeSpace, iReadTotal;
+    uint uiCapacity, uiMask;
     char* pBuffer;
+    // The total number of bytes written and read, modulo 2^32. Only
+    // the writer changes iWritePos and only the reader iReadPos.
+    PiiAtomicInt iWritePos, iReadPos;
+    // Owned by the reader.
+    qint64 iReadTotal;
     unsigned long ulWaitTime;
-    QMutex bufferLock;
-    QWaitCondition dataWritten, dataRead;
-    bool bWriteFinished;
+    PiiWaitCondition dataWritten, dataRead;
+    PiiAtomicInt iWriteFinished;
   } *d;
 };
 
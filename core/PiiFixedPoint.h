@@ -22,7 +22,9 @@
  */
 template <class T> struct PiiFixedPointTraits;
 template <> struct PiiFixedPointTraits<char> { typedef short WiderType; };
+template <> struct PiiFixedPointTraits<unsigned char> { typedef unsigned short WiderType; };
 template <> struct PiiFixedPointTraits<short> { typedef int WiderType; };
+template <> struct PiiFixedPointTraits<unsigned short> { typedef unsigned int WiderType; };
 // Both int and long are 32 bits on PC
 template <> struct PiiFixedPointTraits<int> { typedef long long WiderType; };
 template <> struct PiiFixedPointTraits<long> { typedef long long WiderType; };
@@ -70,22 +72,45 @@ public:
    * Initialize the fixed point number with a floating point value.
    * This may result in rounding errors.
    */
-  PiiFixedPoint(double value) : _value(value * (1 << decimals)) {}
+  PiiFixedPoint(double value) : _value(T(value * (1 << decimals) + (value < 0 ? -0.5 : 0.5))) {}
+
+  /**
+   * Creates a fixed point number out of its internal representation.
+   */
+  static PiiFixedPoint fromRawValue(T value) { return PiiFixedPoint(value, 0); }
+  /**
+   * Returns the internal representation of the number, i.e. the
+   * value multiplied by \(2^{decimals}\).
+   */
+  T rawValue() const { return _value; }
+  /**
+   * Returns the number of decimal bits.
+   */
+  static int decimalBits() { return decimals; }
 
   operator float () const { return (float)_value / (1 << decimals); }
   operator double () const { return (double)_value / (1 << decimals); }
 
   void operator+= (const PiiFixedPoint& other) { _value += other._value; }
   void operator-= (const PiiFixedPoint& other) { _value -= other._value; }
-  void operator*= (const PiiFixedPoint& other) { _value = T(PiiFixedPointTraits<T>::WiderType(_value * other._value) >> decimals); }
-  void operator/= (const PiiFixedPoint& other) { _value = (_value / other._value) << decimal; }
+  void operator*= (const PiiFixedPoint& other) { _value = multiply(_value, other._value); }
+  void operator/= (const PiiFixedPoint& other) { _value = divide(_value, other._value); }
 
-  PiiFixedPoint operator+ (const PiiFixedPoint& other) { return PiiFixedPoint(_value + other_value, 0); }
-  PiiFixedPoint operator- (const PiiFixedPoint& other) { return PiiFixedPoint(_value - other_value, 0); }
-  PiiFixedPoint operator* (const PiiFixedPoint& other) { return PiiFixedPoint(T(PiiFixedPointTraits<T>::WiderType(_value * other_value) >> decimals), 0); }
-  PiiFixedPoint operator/ (const PiiFixedPoint& other) { return PiiFixedPoint(_value / other_value); }
+  PiiFixedPoint operator+ (const PiiFixedPoint& other) const { return PiiFixedPoint(T(_value + other._value), 0); }
+  PiiFixedPoint operator- (const PiiFixedPoint& other) const { return PiiFixedPoint(T(_value - other._value), 0); }
+  PiiFixedPoint operator* (const PiiFixedPoint& other) const { return PiiFixedPoint(multiply(_value, other._value), 0); }
+  PiiFixedPoint operator/ (const PiiFixedPoint& other) const { return PiiFixedPoint(divide(_value, other._value), 0); }
+
+  bool operator== (const PiiFixedPoint& other) const { return _value == other._value; }
+  bool operator!= (const PiiFixedPoint& other) const { return _value != other._value; }
+  bool operator< (const PiiFixedPoint& other) const { return _value < other._value; }
+  bool operator> (const PiiFixedPoint& other) const { return _value > other._value; }
 
 private:
+  typedef typename PiiFixedPointTraits<T>::WiderType WiderType;
+  static T multiply(T a, T b) { return T((WiderType(a) * WiderType(b)) >> decimals); }
+  static T divide(T a, T b) { return T((WiderType(a) << decimals) / b); }
+
   T _value;
 };
 
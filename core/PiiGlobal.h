@@ -88,6 +88,16 @@
 namespace std { template <class T> T declval(); }
 #endif
 
+// Storage class specifier for thread-local variables. Only POD types
+// can be declared thread-local in a portable way.
+#if defined(PII_CXX11)
+#  define PII_THREAD_LOCAL thread_local
+#elif defined(_MSC_VER)
+#  define PII_THREAD_LOCAL __declspec(thread)
+#else
+#  define PII_THREAD_LOCAL __thread
+#endif
+
 #define PII_TYPEMAP(NAME) namespace NAME
 #define PII_MAP_PUT_DEFAULT(TYPE) template <class _T_> struct Mapper { typedef TYPE Type; }
 #define PII_MAP_PUT_NO_DEFAULT template <class _T_> struct Mapper
@@ -121,12 +121,12 @@ public:
   /**
    * Returns a pointer to the beginning of the heap data.
    */
-  T* data() { return _array._d(); }
+  T* data() { return _array.data(); }
 
   /**
    * Returns const a pointer to the beginning of the heap data.
    */
-  const T* data() const { return _array._d(); }
+  const T* data() const { return _array.data(); }
 
   /**
    * Returns a reference to the item at *index*.
@@ -138,6 +138,11 @@ public:
    */
   difference_type operator- (const PiiUnaryFunctionIterator& other) const { return _iterator - other._iterator; }
 
+  /// Returns the transformed iterator.
+  Iterator iterator() const { return _iterator; }
+  /// Returns the transformation function.
+  UnaryFunction function() const { return _func; }
+
 private:
   Iterator _iterator;
   UnaryFunction _func;
@@ -270,6 +275,13 @@ public:
    */
   difference_type operator- (const PiiBinaryFunctionIterator& other) const { return _iterator1 - other._iterator1; }
 
+  /// Returns the iterator that provides the first argument.
+  Iterator1 iterator1() const { return _iterator1; }
+  /// Returns the iterator that provides the second argument.
+  Iterator2 iterator2() const { return _iterator2; }
+  /// Returns the transformation function.
+  BinaryFunction function() const { return _func; }
+
 private:
   Iterator1 _iterator1;
   Iterator2 _iterator2;
@@ -0,0 +1,127 @@
+/* This file is part of Into.
+ * Copyright (C) Intopii 2013.
+ * All rights reserved.
+ *
+ * Licensees holding a commercial Into license may use this file in
+ * accordance with the commercial license agreement. Please see
+ * LICENSE.commercial for commercial licensing terms.
+ *
+ * Alternatively, this file may be used under the terms of the GNU
+ * Affero General Public License version 3 as published by the Free
+ * Software Foundation. In addition, Intopii gives you special rights
+ * to use Into as a part of open source software projects. Please
+ * refer to LICENSE.AGPL3 for details.
+ */
+
+#ifndef _PIILATESTVALUE_H
+#define _PIILATESTVALUE_H
+
+#include "PiiGlobal.h"
+#include "PiiAtomicInt.h"
+
+#include <QThread>
+
+/**
+ * A slot that holds the latest value published by a writer and lets
+ * any number of readers fetch it without locking. Readers never block
+ * the writer, and the writer never blocks readers.
+ *
+ * The value is stored in a small ring of *slotCount* slots. The
+ * writer fills a slot that is neither current nor being read, and
+ * then publishes it. A reader pins the current slot, checks that it
+ * is still current, and copies the value. If the writer published a
+ * new value in between, the reader retries. Unlike a plain seqlock,
+ * this lets *T* be a reference-counted type such as PiiVariant,
+ * because a slot is never overwritten while someone copies it.
+ *
+ * Only one thread may call [store()] at a time. The writer waits only
+ * if `slotCount - 1` readers have been preempted in the middle of
+ * a copy at the same time.
+ *
+ * ~~~(c++)
+ * PiiLatestValue<PiiVariant> latest;
+ * // Producer thread
+ * latest.store(PiiVariant(image));
+ * // Any number of monitoring threads
+ * PiiVariant obj(latest.load());
+ * ~~~
+ */
+template <class T, int slotCount = 4> class PiiLatestValue
+{
+public:
+  PiiLatestValue() : _iCurrent(0), _iVersion(0) {}
+
+  /**
+   * Returns a copy of the latest value. If nothing has been stored, a
+   * default-constructed `T` will be returned.
+   */
+  T load() const
+  {
+    forever
+      {
+        const int iSlot = _iCurrent.loadAcquire();
+        Slot& slot = _aSlots[iSlot];
+        // Ordered increment: either the writer sees the pin, or we
+        // see that the slot is no longer current.
+        ++slot.iReaders;
+        if (_iCurrent.loadAcquire() == iSlot)
+          {
+            T value(slot.value);
+            --slot.iReaders;
+            return value;
+          }
+        --slot.iReaders;
+      }
+  }
+
+  /**
+   * Publishes *value* as the latest value.
+   */
+  void store(const T& value)
+  {
+    const int iCurrent = _iCurrent.loadRelaxed();
+    int iSlot = freeSlot(iCurrent);
+    _aSlots[iSlot].value = value;
+    _iCurrent.testAndSetOrdered(iCurrent, iSlot);
+    _iVersion.storeRelease(_iVersion.loadRelaxed() + 1);
+    // Release the previous value unless it is being read.
+    Slot& previous = _aSlots[iCurrent];
+    if (previous.iReaders.load() == 0)
+      previous.value = T();
+  }
+
+  /**
+   * Returns the number of times [store()] has been called. Pollers can
+   * use this value to detect changes without copying the value.
+   */
+  int version() const { return _iVersion.loadAcquire(); }
+
+private:
+  struct Slot
+  {
+    PiiAtomicInt iReaders;
+    T value;
+  };
+
+  int freeSlot(int current) const
+  {
+    forever
+      {
+        for (int i=1; i<slotCount; ++i)
+          {
+            const int iSlot = (current + i) % slotCount;
+            if (_aSlots[iSlot].iReaders.load() == 0)
+              return iSlot;
+          }
+        QThread::yieldCurrentThread();
+      }
+  }
+
+  mutable Slot _aSlots[slotCount];
+  PiiAtomicInt _iCurrent;
+  PiiAtomicInt _iVersion;
+
+  PII_DISABLE_COPY(PiiLatestValue);
+};
+
+#endif //_PIILATESTVALUE_H
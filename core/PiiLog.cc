@@ -19,7 +19,16 @@
 #include <QRegExp>
 #include <QStringList>
 #include <QMutex>
+#include <QThread>
+#include <QThreadStorage>
+#include <QVector>
 #include <cstdlib>
+#include <cstring>
+#include <ctime>
+
+#include "PiiAtomicInt.h"
+#include "PiiAsyncCall.h"
+#include "PiiWaitCondition.h"
 
 namespace PiiLog
 {
@@ -28,6 +37,185 @@ namespace PiiLog
   static QString strLogFile;
   static qint64 iMaxFileSize = 1024*1024;
   static int iMaxArchivedFiles = 5;
+  static int iQueueCapacity = 1024;
+  static int iRateLimit = 0;
+  static PiiAtomicInt iDroppedMessages;
+
+  // A queued log message. The body is formatted by the logging
+  // thread, the log line by the writer.
+  struct Record
+  {
+    qint64 iTime;
+    QtMsgType level;
+    char module[32];
+    QString strMessage;
+  };
+
+  // A single-producer, single-consumer ring of log records. The
+  // owning thread pushes, the writer (under ringMutex) pops.
+  class Ring
+  {
+  public:
+    Ring(int capacity) : vecRecords(capacity), iMask(capacity-1), bOrphaned(0) {}
+
+    bool push(const char* module, QtMsgType level, const QString& message)
+    {
+      const unsigned int iHead = unsigned(iHead_.load());
+      if (iHead - unsigned(iTail_.loadAcquire()) > iMask)
+        return false;
+      Record& record = vecRecords[iHead & iMask];
+      record.iTime = QDateTime::currentMSecsSinceEpoch();
+      record.level = level;
+      qstrncpy(record.module, module, sizeof(record.module));
+      record.strMessage = message;
+      iHead_.storeRelease(int(iHead + 1));
+      return true;
+    }
+
+    bool pop(Record& record)
+    {
+      const unsigned int iTail = unsigned(iTail_.load());
+      if (iTail == unsigned(iHead_.loadAcquire()))
+        return false;
+      Record& source = vecRecords[iTail & iMask];
+      record.iTime = source.iTime;
+      record.level = source.level;
+      std::memcpy(record.module, source.module, sizeof(record.module));
+      record.strMessage.swap(source.strMessage);
+      source.strMessage.clear();
+      iTail_.storeRelease(int(iTail + 1));
+      return true;
+    }
+
+    QVector<Record> vecRecords;
+    const unsigned int iMask;
+    PiiAtomicInt iHead_, iTail_;
+    // Set when the owning thread exits.
+    PiiAtomicInt bOrphaned;
+  };
+
+  // Owned by QThreadStorage. Marks the ring orphaned at thread exit
+  // so that the writer can delete it once it is empty.
+  struct RingHolder
+  {
+    RingHolder(Ring* ring) : pRing(ring) {}
+    ~RingHolder() { pRing->bOrphaned.storeRelease(1); }
+    Ring* pRing;
+  };
+
+  // Recursive because a message handler may log while the rings are
+  // being drained.
+  static QMutex ringMutex(QMutex::Recursive);
+  static QList<Ring*> lstRings;
+
+  static void outputMessage(QtMsgType level, const QString& message);
+  static void outputLine(const char* module, QtMsgType level, qint64 time, const QString& message);
+
+  // Writes out all queued messages. Only one thread drains at a time.
+  static void drainRings()
+  {
+    static int iReportedDrops = 0;
+    QMutexLocker lock(&ringMutex);
+    Record record;
+    for (int i=0; i<lstRings.size(); ++i)
+      {
+        Ring* pRing = lstRings[i];
+        const bool bOrphaned = pRing->bOrphaned.loadAcquire() != 0;
+        while (pRing->pop(record))
+          outputLine(record.module, record.level, record.iTime, record.strMessage);
+        if (bOrphaned)
+          {
+            delete pRing;
+            lstRings.removeAt(i--);
+          }
+      }
+    const int iDrops = iDroppedMessages.load();
+    if (iDrops != iReportedDrops)
+      {
+        outputMessage(QtWarningMsg, QString("PiiLog: %1 messages dropped.").arg(iDrops - iReportedDrops));
+        iReportedDrops = iDrops;
+      }
+  }
+
+  // The background thread that drains the rings. The object lives
+  // as long as the program so that logging threads never see it
+  // deleted.
+  class Writer
+  {
+  public:
+    Writer() : bRunning(false), pThread(0) {}
+    ~Writer() { stop(); }
+
+    void start()
+    {
+      bRunning = true;
+      pThread = Pii::createAsyncCall(this, &Writer::run);
+      pThread->start();
+    }
+
+    void stop()
+    {
+      if (pThread == 0)
+        return;
+      bRunning = false;
+      wakeCondition.wakeOne();
+      pThread->wait();
+      delete pThread;
+      pThread = 0;
+      drainRings();
+    }
+
+    void run()
+    {
+      while (bRunning)
+        {
+          wakeCondition.wait(100);
+          drainRings();
+        }
+    }
+
+    volatile bool bRunning;
+    PiiWaitCondition wakeCondition;
+    QThread* pThread;
+  };
+
+  static Writer writer;
+  static volatile bool bAsynchronous = false;
+
+  static Ring* threadRing()
+  {
+    static QThreadStorage<RingHolder*> rings;
+    if (!rings.hasLocalData())
+      {
+        Ring* pRing = new Ring(iQueueCapacity);
+        QMutexLocker lock(&ringMutex);
+        lstRings << pRing;
+        rings.setLocalData(new RingHolder(pRing));
+      }
+    return rings.localData()->pRing;
+  }
+
+  struct RateSlot
+  {
+    PiiAtomicInt iSecond, iCount;
+  };
+
+  static bool isRateLimited(const char* format, const QString& message)
+  {
+    enum { SlotCount = 256 };
+    static RateSlot aSlots[SlotCount];
+    if (iRateLimit <= 0)
+      return false;
+    // Preformatted messages all share the same format.
+    const uint uiKey = std::strcmp(format, "%s") == 0 ?
+      qHash(message) : uint(quintptr(format) >> 2);
+    RateSlot& slot = aSlots[uiKey % SlotCount];
+    const int iNow = int(std::time(0));
+    const int iSecond = slot.iSecond.load();
+    if (iSecond != iNow && slot.iSecond.testAndSetOrdered(iSecond, iNow))
+      slot.iCount.store(0);
+    return ++slot.iCount > iRateLimit;
+  }
 
   static void rotateLog()
   {
@@ -125,69 +313,146 @@ namespace PiiLog
   {
     return iMaxArchivedFiles;
   }
-}
 
-static void outputMessage(QtMsgType level, const QString& message)
-{
+  void setAsynchronous(bool asynchronous)
+  {
+    if (asynchronous == bAsynchronous)
+      return;
+    bAsynchronous = asynchronous;
+    if (asynchronous)
+      writer.start();
+    else
+      writer.stop();
+  }
+
+  bool isAsynchronous()
+  {
+    return bAsynchronous;
+  }
+
+  void setQueueCapacity(int capacity)
+  {
+    int iCapacity = 1;
+    while (iCapacity < capacity)
+      iCapacity <<= 1;
+    iQueueCapacity = iCapacity;
+  }
+
+  int queueCapacity()
+  {
+    return iQueueCapacity;
+  }
+
+  void setRateLimit(int messagesPerSecond)
+  {
+    iRateLimit = messagesPerSecond;
+  }
+
+  int rateLimit()
+  {
+    return iRateLimit;
+  }
+
+  int droppedMessageCount()
+  {
+    return iDroppedMessages.load();
+  }
+
+  void flush()
+  {
+    if (bAsynchronous)
+      drainRings();
+  }
+
+  static void outputMessage(QtMsgType level, const QString& message)
+  {
 #if QT_VERSION < 0x050000
-  qt_message_output(level, message.toLocal8Bit().constData());
+    qt_message_output(level, message.toLocal8Bit().constData());
 #else
-  qt_message_output(level, QMessageLogContext(), message);
+    qt_message_output(level, QMessageLogContext(), message);
 #endif
+  }
+
+  static void outputLine(const char* module, QtMsgType level, qint64 time, const QString& strMessage)
+  {
+    // PENDING should use Pii::replaceVariables() here (DRY)
+    // Plain strings because the writer may still run during static
+    // destruction.
+    static const char* const aTypes[] = { "Debug", "Warning", "Critical", "Fatal" };
+    static const char* const pDefaultDateFormat = "yyyy-MM-dd hh:mm";
+
+    if (strMessageFormat.isEmpty())
+      {
+        outputMessage(level, strMessage);
+        return;
+      }
+
+    QString strLogLine(strMessageFormat);
+    QRegExp reVariable("\\$((\\w+)|\\{(\\w+)\\}|\\{(\\w+) ([^}]+)\\})");
+    QStringList lstVariables = QStringList() << "time" << "type" << "module" << "message";
+    int index = 0;
+    while ((index = reVariable.indexIn(strLogLine, index)) != -1)
+      {
+        QString strVarName, strParams, strReplacement;
+
+        if (!reVariable.cap(2).isEmpty()) // no curly braces
+          strVarName = reVariable.cap(2);
+        else if (!reVariable.cap(3).isEmpty()) // curly braces
+          strVarName = reVariable.cap(3);
+        else // name with parameters
+          {
+            strVarName = reVariable.cap(4);
+            strParams = reVariable.cap(5);
+          }
+        switch (lstVariables.indexOf(strVarName))
+          {
+          case 0: // time
+            strReplacement = QDateTime::fromMSecsSinceEpoch(time).toString(strParams.isEmpty() ? QString(pDefaultDateFormat) : strParams);
+            break;
+          case 1: // type
+            strReplacement = QString(aTypes[qBound(0, int(level), 3)]).left(strParams.isEmpty() ? -1 : strParams.toInt());
+            break;
+          case 2: // module
+            strReplacement = module;
+            break;
+          case 3: // message
+            strReplacement = strMessage;
+            break;
+          }
+        strLogLine.replace(index, reVariable.matchedLength(), strReplacement);
+        index += strReplacement.size();
+      }
+    outputMessage(level, strLogLine);
+  }
 }
 
 void piiLogv(const char* module, QtMsgType level, const char* msg, va_list argp)
 {
-  // PENDING should use Pii::replaceVariables() here (DRY)
-  static const QString aTypes[] = { "Debug", "Warning", "Critical", "Fatal" };
-  static const QString strDefaultDateFormat("yyyy-MM-dd hh:mm");
-
   if (PiiLog::pLogMessageFilter != 0 && !(*PiiLog::pLogMessageFilter)(module, level))
     return;
 
   QString strMessage;
   if (msg != 0)
-    strMessage.vsprintf(msg, argp);
+    {
+      strMessage.vsprintf(msg, argp);
+      if (level != QtFatalMsg && PiiLog::isRateLimited(msg, strMessage))
+        {
+          ++PiiLog::iDroppedMessages;
+          return;
+        }
+    }
 
-  if (PiiLog::strMessageFormat.isEmpty())
-    outputMessage(level, strMessage);
-  else
+  if (PiiLog::bAsynchronous)
     {
-      QString strLogLine(PiiLog::strMessageFormat);
-      QRegExp reVariable("\\$((\\w+)|\\{(\\w+)\\}|\\{(\\w+) ([^}]+)\\})");
-      QStringList lstVariables = QStringList() << "time" << "type" << "module" << "message";
-      int index = 0;
-      while ((index = reVariable.indexIn(strLogLine, index)) != -1)
+      if (level != QtFatalMsg)
         {
-          QString strVarName, strParams, strReplacement;
-
-          if (!reVariable.cap(2).isEmpty()) // no curly braces
-            strVarName = reVariable.cap(2);
-          else if (!reVariable.cap(3).isEmpty()) // curly braces
-            strVarName = reVariable.cap(3);
-          else // name with parameters
-            {
-              strVarName = reVariable.cap(4);
-              strParams = reVariable.cap(5);
-            }
-          switch (lstVariables.indexOf(strVarName))
-            {
-            case 0: // time
-              strReplacement = QDateTime::currentDateTime().toString(strParams.isEmpty() ? strDefaultDateFormat : strParams);
-              break;
-            case 1: // type
-              strReplacement = aTypes[qBound(0, int(level), 3)].left(strParams.isEmpty() ? -1 : strParams.toInt());
-              break;
-            case 2: // module
-              strReplacement = module;
-              break;
-            case 3: // message
-              strReplacement = strMessage;
-              break;
-            }
-          strLogLine.replace(index, reVariable.matchedLength(), strReplacement);
-          index += strReplacement.size();
+          if (PiiLog::threadRing()->push(module, level, strMessage))
+            PiiLog::writer.wakeCondition.wakeOne();
+          else
+            ++PiiLog::iDroppedMessages;
+          return;
         }
-      outputMessage(level, strLogLine);
+      PiiLog::flush();
     }
+  PiiLog::outputLine(module, level, QDateTime::currentMSecsSinceEpoch(), strMessage);
 }
@@ -246,6 +246,76 @@ namespace PiiLog
    * Returns the maximum number of log files to be stored.
    */
   PII_CORE_EXPORT int maxArchivedFiles();
+
+  /**
+   * Turns asynchronous logging on or off. In asynchronous mode,
+   * piiLogv() filters and formats the message body in the calling
+   * thread and puts it into a ring buffer owned by the thread. A
+   * single background thread formats the log lines and passes them
+   * to Qt's message handler (e.g. writeToFile()). The caller never
+   * blocks on I/O. If the ring buffer of a thread is full, the
+   * message is dropped and counted in droppedMessageCount().
+   *
+   * Messages from different threads may be written out in a slightly
+   * different order than they were logged. Fatal messages are always
+   * written synchronously after flushing the queues.
+   *
+   * Turning asynchronous logging off flushes all pending messages.
+   * Asynchronous logging is off by default.
+   *
+   * ~~~(c++)
+   * PiiLog::setLogFile("/var/log/my.log");
+   * qInstallMsgHandler(PiiLog::writeToFile);
+   * PiiLog::setAsynchronous(true);
+   * ~~~
+   */
+  PII_CORE_EXPORT void setAsynchronous(bool asynchronous);
+
+  /**
+   * Returns `true` if asynchronous logging is enabled.
+   */
+  PII_CORE_EXPORT bool isAsynchronous();
+
+  /**
+   * Sets the number of messages each thread can queue in
+   * asynchronous mode. The value is rounded up to the next power of
+   * two and applies to threads that log their first message after
+   * the call. The default is 1024.
+   */
+  PII_CORE_EXPORT void setQueueCapacity(int capacity);
+
+  /**
+   * Returns the per-thread queue capacity.
+   */
+  PII_CORE_EXPORT int queueCapacity();
+
+  /**
+   * Limits the number of messages a single call site can log in a
+   * second. Call sites are identified by their format string; for
+   * messages logged as a QString, the message text is used instead.
+   * Messages that exceed the limit are dropped and counted in
+   * droppedMessageCount(). Limits are tracked per hash bucket, so
+   * distinct call sites may occasionally share a limit. Zero (the
+   * default) disables rate limiting.
+   */
+  PII_CORE_EXPORT void setRateLimit(int messagesPerSecond);
+
+  /**
+   * Returns the per-call-site rate limit.
+   */
+  PII_CORE_EXPORT int rateLimit();
+
+  /**
+   * Returns the number of messages dropped because a queue was full
+   * or a call site exceeded its [rate limit](setRateLimit()).
+   */
+  PII_CORE_EXPORT int droppedMessageCount();
+
+  /**
+   * Writes out all queued messages in the calling thread. Does
+   * nothing if asynchronous logging is disabled.
+   */
+  PII_CORE_EXPORT void flush();
 }
 
 /// @endgroup
@@ -501,9 +501,7 @@ namespace Pii
   template <class U, class Matrix> U var(const Matrix& mat, U* average)
   {
     U avg = mean<U>(mat);
-    U sum(0);
-    for (typename Matrix::const_iterator i = mat.begin(); i != mat.end(); ++i)
-      sum += square(U(*i) - avg);
+    U sum = accumulateRows<U>(mat, SquaredDifference<typename Matrix::value_type,U>(avg));
     if (average != 0)
       *average = avg;
     return sum != 0 ? (sum / (mat.rows() * mat.columns())) : 0;
@@ -621,22 +619,39 @@ namespace Pii
                                       int* minR, int* minC,
                                       int* maxR, int* maxC)
   {
+    typedef typename Matrix::value_type T;
     if (mat.isEmpty())
       return;
-    typename Matrix::const_iterator minIt = mat.begin(), maxIt = mat.begin();
-    for (typename Matrix::const_iterator it = mat.begin(); it != mat.end(); ++it)
+    // Find the extrema of each row with a branch-free loop and only
+    // locate them if they change.
+    const int iRows = mat.rows(), iColumns = mat.columns();
+    T minValue(*mat.rowBegin(0)), maxValue(minValue);
+    int iMinRow = 0, iMaxRow = 0;
+    for (int r=0; r<iRows; ++r)
       {
-        if (*it < *minIt)
-          minIt = it;
-        else if (*it > *maxIt)
-          maxIt = it;
+        typename Matrix::const_row_iterator row = mat.rowBegin(r);
+        T rowMin(*row), rowMax(rowMin);
+        for (int c=0; c<iColumns; ++c, ++row)
+          {
+            const T value = *row;
+            rowMin = value < rowMin ? value : rowMin;
+            rowMax = value > rowMax ? value : rowMax;
+          }
+        if (rowMin < minValue)
+          minValue = rowMin, iMinRow = r;
+        if (rowMax > maxValue)
+          maxValue = rowMax, iMaxRow = r;
       }
-    *minimum = *minIt;
-    *maximum = *maxIt;
-    if (minR) *minR = minIt.row();
-    if (minC) *minC = minIt.column();
-    if (maxR) *maxR = maxIt.row();
-    if (maxC) *maxC = maxIt.column();
+    *minimum = minValue;
+    *maximum = maxValue;
+    if (minR) *minR = iMinRow;
+    if (maxR) *maxR = iMaxRow;
+    if (minC)
+      *minC = int(std::distance(mat.rowBegin(iMinRow),
+                                std::find(mat.rowBegin(iMinRow), mat.rowEnd(iMinRow), minValue)));
+    if (maxC)
+      *maxC = int(std::distance(mat.rowBegin(iMaxRow),
+                                std::find(mat.rowBegin(iMaxRow), mat.rowEnd(iMaxRow), maxValue)));
   }
 
   template <class T> PiiMatrix<T> diff(const PiiMatrix<T>& mat, int step, int order, MatrixDirection direction)
@@ -23,6 +23,8 @@
 #include "PiiHeap.h"
 #include "PiiMatrixValue.h"
 #include "PiiPreprocessor.h"
+#include "PiiMatrixProduct.h"
+#include "PiiFastMath.h"
 
 #include <cstdlib>
 #include <complex>
@@ -947,16 +949,212 @@ namespace Pii
   template <class InputIterator, class OutputIterator>
   void fastMovingAverage(InputIterator input, int n, OutputIterator output, int windowSize);
 
+  /// @hide
+  // Rows longer than this are summed pairwise. The rounding error
+  // grows with the logarithm of the length instead of linearly.
+  enum { PairwiseSumBlockSize = 256 };
+
+  template <class U, class Iterator, class UnaryFunction>
+  U accumulateN(Iterator begin, int n, UnaryFunction function)
+  {
+    U sum(0);
+    for (; n > 0; --n, ++begin)
+      sum += U(function(*begin));
+    return sum;
+  }
+
+  // Contiguous rows. Four independent accumulators break the
+  // dependency chain between additions, and let the compiler keep
+  // partial sums in separate SIMD lanes.
+  template <class U, class T, class UnaryFunction>
+  U accumulateN(const T* begin, int n, UnaryFunction function)
+  {
+    if (n > PairwiseSumBlockSize)
+      {
+        const int iHalf = n / 2;
+        return accumulateN<U>(begin, iHalf, function) +
+          accumulateN<U>(begin + iHalf, n - iHalf, function);
+      }
+    U sum0(0), sum1(0), sum2(0), sum3(0);
+    int i = 0;
+    for (; i+4 <= n; i += 4)
+      {
+        sum0 += U(function(begin[i]));
+        sum1 += U(function(begin[i+1]));
+        sum2 += U(function(begin[i+2]));
+        sum3 += U(function(begin[i+3]));
+      }
+    for (; i<n; ++i)
+      sum0 += U(function(begin[i]));
+    return (sum0 + sum1) + (sum2 + sum3);
+  }
+
+  // Sums function(x) over all elements row by row. Row sums are
+  // combined pairwise.
+  template <class U, class Matrix, class UnaryFunction>
+  U accumulateRows(const Matrix& mat, int firstRow, int rows, UnaryFunction function)
+  {
+    if (rows == 1)
+      return accumulateN<U>(mat.rowBegin(firstRow), mat.columns(), function);
+    else if (rows <= 0)
+      return U(0);
+    const int iHalf = rows / 2;
+    return accumulateRows<U>(mat, firstRow, iHalf, function) +
+      accumulateRows<U>(mat, firstRow + iHalf, rows - iHalf, function);
+  }
+
+  template <class U, class Matrix, class UnaryFunction>
+  inline U accumulateRows(const Matrix& mat, UnaryFunction function)
+  {
+    return accumulateRows<U>(mat, 0, mat.rows(), function);
+  }
+
+  template <class T, class U> struct SquaredDifference : public Pii::UnaryFunction<T,U>
+  {
+    SquaredDifference(U center) : center(center) {}
+    U operator() (const T& value) const { U diff = U(value) - center; return diff*diff; }
+    U center;
+  };
+  /// @endhide
+
   /**
    * Returns the sum of all entries in a matrix. Returns the value as
    * a (possibly) different type, denoted by the template parameter
-   * `U`.
+   * `U`. Rows are summed with independent partial sums, and long
+   * rows as well as the row sums are added pairwise. With
+   * floating-point types, rounding errors are much smaller than in
+   * naive summation.
    */
   template <class T, class Matrix> inline T sum(const Matrix& mat)
   {
-    return Pii::accumulate(mat.begin(), mat.end(),
-                           std::plus<T>(),
-                           T(0));
+    return accumulateRows<T>(mat, Identity<typename Matrix::value_type>());
+  }
+
+  /**
+   * Minimum, maximum, sum and sum of squares of a set of values. See
+   * [summaryStatistics()].
+   */
+  template <class T, class U> struct SummaryStatistics
+  {
+    SummaryStatistics() :
+      minimum(Numeric<T>::maxValue()), maximum(Numeric<T>::minValue()),
+      sum(0), sumOfSquares(0), count(0)
+    {}
+
+    /// Adds the statistics of *other* to this.
+    void merge(const SummaryStatistics& other)
+    {
+      if (other.minimum < minimum) minimum = other.minimum;
+      if (other.maximum > maximum) maximum = other.maximum;
+      sum += other.sum;
+      sumOfSquares += other.sumOfSquares;
+      count += other.count;
+    }
+
+    /// Returns the mean, or zero if there are no values.
+    U mean() const { return count > 0 ? sum / U(count) : U(0); }
+    /**
+     * Returns the variance calculated from the sum of squares. If the
+     * mean is large compared to the standard deviation, this loses
+     * precision. Use [var()] in such cases.
+     */
+    U var() const
+    {
+      if (count == 0)
+        return U(0);
+      const U avg = mean();
+      const U variance = sumOfSquares / U(count) - avg*avg;
+      return variance > 0 ? variance : U(0);
+    }
+
+    T minimum;
+    T maximum;
+    U sum;
+    U sumOfSquares;
+    qint64 count;
+  };
+
+  /// @hide
+  template <class T, class U, class Iterator>
+  void summarizeN(Iterator begin, int n, SummaryStatistics<T,U>& stats)
+  {
+    if (n > PairwiseSumBlockSize)
+      {
+        const int iHalf = n / 2;
+        SummaryStatistics<T,U> second;
+        summarizeN(begin, iHalf, stats);
+        std::advance(begin, iHalf);
+        summarizeN(begin, n - iHalf, second);
+        stats.merge(second);
+        return;
+      }
+    // Conditional moves compile to SIMD min/max instructions.
+    T minimum(stats.minimum), maximum(stats.maximum);
+    U sum0(0), sum1(0), sumSq0(0), sumSq1(0);
+    int i = 0;
+    for (; i+2 <= n; i += 2, ++begin)
+      {
+        const T value0 = *begin, value1 = *++begin;
+        minimum = value0 < minimum ? value0 : minimum;
+        maximum = value0 > maximum ? value0 : maximum;
+        minimum = value1 < minimum ? value1 : minimum;
+        maximum = value1 > maximum ? value1 : maximum;
+        sum0 += U(value0);
+        sum1 += U(value1);
+        sumSq0 += U(value0) * U(value0);
+        sumSq1 += U(value1) * U(value1);
+      }
+    if (i < n)
+      {
+        const T value = *begin;
+        minimum = value < minimum ? value : minimum;
+        maximum = value > maximum ? value : maximum;
+        sum0 += U(value);
+        sumSq0 += U(value) * U(value);
+      }
+    stats.minimum = minimum;
+    stats.maximum = maximum;
+    stats.sum += sum0 + sum1;
+    stats.sumOfSquares += sumSq0 + sumSq1;
+    stats.count += n;
+  }
+
+  template <class T, class U, class Matrix>
+  void summarizeRows(const Matrix& mat, int firstRow, int rows, SummaryStatistics<T,U>& stats)
+  {
+    if (rows == 1)
+      summarizeN(mat.rowBegin(firstRow), mat.columns(), stats);
+    else if (rows > 1)
+      {
+        const int iHalf = rows / 2;
+        SummaryStatistics<T,U> second;
+        summarizeRows(mat, firstRow, iHalf, stats);
+        summarizeRows(mat, firstRow + iHalf, rows - iHalf, second);
+        stats.merge(second);
+      }
+  }
+  /// @endhide
+
+  /**
+   * Calculates the minimum, the maximum, the sum and the sum of
+   * squares of all elements in *mat* in a single pass. The sums are
+   * calculated as type `U`. If you need more than one of these
+   * values, this is faster than calling [minMax()], [sum()] and
+   * [var()] separately.
+   *
+   * ~~~(c++)
+   * PiiMatrix<unsigned char> image(...);
+   * Pii::SummaryStatistics<unsigned char,double> stats(Pii::summaryStatistics<double>(image));
+   * double dMean = stats.mean();
+   * ~~~
+   */
+  template <class U, class Matrix>
+  SummaryStatistics<typename Matrix::value_type, U> summaryStatistics(const Matrix& mat)
+  {
+    SummaryStatistics<typename Matrix::value_type, U> stats;
+    if (mat.columns() > 0)
+      summarizeRows(mat, 0, mat.rows(), stats);
+    return stats;
   }
 
   /**
@@ -2383,7 +2581,9 @@ namespace Pii
 }
 
 /**
- * Matrix multiplication. Returns *mat1* * *mat2*.
+ * Matrix multiplication. Returns *mat1* * *mat2*. Large `float` and
+ * `double` products are calculated with the cache-blocked, parallel
+ * [Pii::multiplyMatrices()].
  *
  * @exception PiiMathException& if matrix sizes don't match
  */
@@ -2402,6 +2602,8 @@ operator* (const PiiConceptualMatrix<Matrix1>& mat1,
 
   typedef PII_COMBINE_TYPES(typename Matrix1::value_type, typename Matrix2::value_type) T;
   PiiMatrix<T, Matrix1::staticRows, Matrix2::staticColumns> result(PiiMatrix<T>::uninitialized(iRows1, iCols2));
+  if (Pii::multiplyLarge(m1, m2, result))
+    return result;
   for (int r=0; r<iRows1; ++r)
     {
       T* pRow = result[r];
@@ -2545,6 +2747,18 @@ namespace Pii
    */
   PII_MATH_MATRIX_TRANSFORM(exp, Exp);
 
+  /**
+   * Returns the base *e* exponential of all elements in *mat* using a
+   * fast approximation.
+   */
+  PII_MATH_MATRIX_TRANSFORM(fastExp, FastExp);
+
+  /**
+   * Returns the natural logarithm of all elements in *mat* using a
+   * fast approximation.
+   */
+  PII_MATH_MATRIX_TRANSFORM(fastLog, FastLog);
+
   /**
    * Rounds all values in a matrix to the closest integer. Returns a
    * new matrix that has the same type as the input.
@@ -2740,17 +2954,12 @@ namespace Pii
    * denote the elements of `mat` and N is the total number of
    * entries.
    *
-   * ! Sum is not calculated with double but with the datatype
-   * given by the absolute value functor, which in most cases is
-   * the same as the matrix element type. Possible overflow
-   * issue.
+   * The sum is calculated as a `double`.
    */
   template <class Matrix> inline double norm1(const Matrix& mat)
   {
     typedef typename Matrix::value_type T;
-    return forEach(mat.begin(), mat.end(),
-                   createForEachFunction(Abs<T>(), std::plus<typename Abs<T>::result_type>(), 0))();
-    //return sum<T>(abs(mat));
+    return accumulateRows<double>(mat, Abs<T>());
   }
 
   /// @internal
@@ -2769,9 +2978,7 @@ namespace Pii
   {
     static double calculate(const Matrix& matrix)
     {
-      return sqrt(forEach(matrix.begin(), matrix.end(),
-                          createForEachFunction(Square<typename Matrix::value_type>(),
-                                                std::plus<double>(), 0))());
+      return sqrt(accumulateRows<double>(matrix, Square<typename Matrix::value_type>()));
     }
   };
 
@@ -2910,6 +3117,24 @@ namespace Pii
    */
   PII_MATH_MATRIX_TRANSFORM(tan, Tan);
 
+  /**
+   * Calculates the sine of all elements in a matrix using a fast
+   * approximation.
+   */
+  PII_MATH_MATRIX_TRANSFORM(fastSin, FastSin);
+
+  /**
+   * Calculates the cosine of all elements in a matrix using a fast
+   * approximation.
+   */
+  PII_MATH_MATRIX_TRANSFORM(fastCos, FastCos);
+
+  /**
+   * Calculates the tangent of all elements in a matrix using a fast
+   * approximation.
+   */
+  PII_MATH_MATRIX_TRANSFORM(fastTan, FastTan);
+
   /**
    * Calculates the arcus tangent of all elements in a matrix.
    */
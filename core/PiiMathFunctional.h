@@ -269,6 +269,43 @@ namespace Pii
     float operator() (float value) const { return tan(value); }
   };
 
+/// @hide
+#define PII_FAST_MATH_FUNCTION(CLASS, FUNCTION) \
+  template <class T> struct CLASS : public Pii::UnaryFunction<T,double> \
+  { \
+    double operator() (const T& value) const { return FUNCTION(double(value)); } \
+  }; \
+  template <> struct CLASS<float> : public Pii::UnaryFunction<float> \
+  { \
+    float operator() (float value) const { return FUNCTION(value); } \
+  }
+/// @endhide
+
+  /**
+   * A unary function that returns \(e^x\) using [fastExp()]. The
+   * result type is `float` for `float` input and `double` otherwise.
+   */
+  PII_FAST_MATH_FUNCTION(FastExp, fastExp);
+  /**
+   * A unary function that returns the natural logarithm using
+   * [fastLog()].
+   */
+  PII_FAST_MATH_FUNCTION(FastLog, fastLog);
+  /**
+   * A unary function that returns `sin`(x) using [fastSin()].
+   */
+  PII_FAST_MATH_FUNCTION(FastSin, fastSin);
+  /**
+   * A unary function that returns `cos`(x) using [fastCos()].
+   */
+  PII_FAST_MATH_FUNCTION(FastCos, fastCos);
+  /**
+   * A unary function that returns `tan`(x) using [fastTan()].
+   */
+  PII_FAST_MATH_FUNCTION(FastTan, fastTan);
+
+#undef PII_FAST_MATH_FUNCTION
+
   /**
    * A unary function that returns `tan`(x).
    */
@@ -0,0 +1,297 @@
+/* This file is part of Into.
+ * Copyright (C) Intopii 2013.
+ * All rights reserved.
+ *
+ * Licensees holding a commercial Into license may use this file in
+ * accordance with the commercial license agreement. Please see
+ * LICENSE.commercial for commercial licensing terms.
+ *
+ * Alternatively, this file may be used under the terms of the GNU
+ * Affero General Public License version 3 as published by the Free
+ * Software Foundation. In addition, Intopii gives you special rights
+ * to use Into as a part of open source software projects. Please
+ * refer to LICENSE.AGPL3 for details.
+ */
+
+#include "PiiMatrixProduct.h"
+#include "PiiParallel.h"
+#include "PiiInvalidArgumentException.h"
+
+#include <vector>
+
+#ifdef PII_USE_CBLAS
+extern "C"
+{
+#  include <cblas.h>
+}
+#endif
+
+namespace Pii
+{
+  namespace
+  {
+    // The size of the register block: the kernel keeps an MR-by-NR
+    // tile of the result in local variables.
+    enum { MR = 4, NR = 8 };
+
+    // Cache block sizes. An mc-by-kc block of the first matrix stays
+    // in L2 cache, a kc-by-nc panel of the second one in L3 cache.
+    template <class T> struct BlockSize;
+    template <> struct BlockSize<float> { enum { mc = 128, kc = 384, nc = 2048 }; };
+    template <> struct BlockSize<double> { enum { mc = 96, kc = 256, nc = 1024 }; };
+
+    template <class T> inline T* rowAt(T* data, std::size_t stride, int row)
+    {
+      return reinterpret_cast<T*>(reinterpret_cast<char*>(data) + stride * row);
+    }
+
+    // Packs a rows-by-depth block of a into strips of MR rows. Within
+    // a strip, the MR elements of each column are stored
+    // consecutively. Missing rows of the last strip are zeros.
+    template <class T> void packRows(const PiiMatrix<T>& a, int firstRow, int rows,
+                                     int firstColumn, int depth, T* buffer)
+    {
+      for (int i=0; i<rows; i+=MR)
+        {
+          const int iStripRows = qMin(int(MR), rows - i);
+          const T* pRows[MR];
+          for (int r=0; r<iStripRows; ++r)
+            pRows[r] = a.row(firstRow + i + r) + firstColumn;
+          for (int k=0; k<depth; ++k, buffer += MR)
+            {
+              int r = 0;
+              for (; r<iStripRows; ++r)
+                buffer[r] = pRows[r][k];
+              for (; r<MR; ++r)
+                buffer[r] = 0;
+            }
+        }
+    }
+
+    // Packs a depth-by-columns panel of b into strips of NR columns.
+    template <class T> void packColumns(const PiiMatrix<T>& b, int firstRow, int depth,
+                                        int firstColumn, int columns, T* buffer)
+    {
+      for (int j=0; j<columns; j+=NR)
+        {
+          const int iStripColumns = qMin(int(NR), columns - j);
+          for (int k=0; k<depth; ++k, buffer += NR)
+            {
+              const T* pRow = b.row(firstRow + k) + firstColumn + j;
+              int c = 0;
+              for (; c<iStripColumns; ++c)
+                buffer[c] = pRow[c];
+              for (; c<NR; ++c)
+                buffer[c] = 0;
+            }
+        }
+    }
+
+    // Multiplies a packed strip of MR rows by a packed strip of NR
+    // columns and stores the valid part of the tile to result. The
+    // fixed-size inner loops are unrolled and vectorized by the
+    // compiler.
+    template <class T> inline void multiplyStrips(int depth, const T* a, const T* b,
+                                                  T* result, std::size_t stride,
+                                                  int rows, int columns, bool accumulate)
+    {
+      T aTile[MR][NR];
+      for (int i=0; i<MR; ++i)
+        for (int j=0; j<NR; ++j)
+          aTile[i][j] = 0;
+      for (int k=0; k<depth; ++k, a += MR, b += NR)
+        for (int i=0; i<MR; ++i)
+          {
+            const T ai = a[i];
+            for (int j=0; j<NR; ++j)
+              aTile[i][j] += ai * b[j];
+          }
+
+      for (int i=0; i<rows; ++i)
+        {
+          T* pRow = rowAt(result, stride, i);
+          if (accumulate)
+            for (int j=0; j<columns; ++j)
+              pRow[j] += aTile[i][j];
+          else
+            for (int j=0; j<columns; ++j)
+              pRow[j] = aTile[i][j];
+        }
+    }
+
+    // Calculates a band of rows of the product.
+    template <class T> struct BlockedProduct
+    {
+      BlockedProduct(const PiiMatrix<T>& a, const PiiMatrix<T>& b, PiiMatrix<T>& result) :
+        a(a), b(b), resultRows(result)
+      {}
+
+      void operator() (int firstRow, int rowCount)
+      {
+        typedef BlockSize<T> Size;
+        const int iDepth = a.columns(), iColumns = b.columns(), iLastRow = firstRow + rowCount;
+        const int iPanelColumns = (qMin(int(Size::nc), iColumns) + NR - 1) / NR * NR;
+        // Each band packs its own copy of the panels. This costs
+        // O(n^2) per band and needs no synchronization.
+        std::vector<T> vecRows(Size::mc * Size::kc), vecColumns(Size::kc * iPanelColumns);
+
+        for (int j0=0; j0<iColumns; j0+=Size::nc)
+          {
+            const int iPanelWidth = qMin(int(Size::nc), iColumns - j0);
+            for (int k0=0; k0<iDepth; k0+=Size::kc)
+              {
+                const int iBlockDepth = qMin(int(Size::kc), iDepth - k0);
+                packColumns(b, k0, iBlockDepth, j0, iPanelWidth, &vecColumns[0]);
+                for (int i0=firstRow; i0<iLastRow; i0+=Size::mc)
+                  {
+                    const int iBlockRows = qMin(int(Size::mc), iLastRow - i0);
+                    packRows(a, i0, iBlockRows, k0, iBlockDepth, &vecRows[0]);
+                    for (int j=0; j<iPanelWidth; j+=NR)
+                      for (int i=0; i<iBlockRows; i+=MR)
+                        multiplyStrips(iBlockDepth, &vecRows[i * iBlockDepth], &vecColumns[j * iBlockDepth],
+                                       resultRows.row(i0 + i) + j0 + j, resultRows.stride(),
+                                       qMin(int(MR), iBlockRows - i), qMin(int(NR), iPanelWidth - j),
+                                       k0 > 0);
+                  }
+              }
+          }
+      }
+
+      const PiiMatrix<T>& a;
+      const PiiMatrix<T>& b;
+      const BandRows<T> resultRows;
+    };
+
+    // Matrix-vector product. The vector is copied to contiguous
+    // memory, and each row becomes a dot product.
+    template <class T> struct VectorProduct
+    {
+      VectorProduct(const PiiMatrix<T>& a, const PiiMatrix<T>& b, PiiMatrix<T>& result) :
+        a(a), vecColumn(b.rows()), resultRows(result)
+      {
+        for (int r=0; r<b.rows(); ++r)
+          vecColumn[r] = b(r,0);
+      }
+
+      void operator() (int firstRow, int rowCount)
+      {
+        const int iDepth = a.columns();
+        const T* pColumn = &vecColumn[0];
+        for (int r=firstRow; r<firstRow+rowCount; ++r)
+          {
+            const T* pRow = a.row(r);
+            T sum(0);
+            for (int k=0; k<iDepth; ++k)
+              sum += pRow[k] * pColumn[k];
+            *resultRows.row(r) = sum;
+          }
+      }
+
+      const PiiMatrix<T>& a;
+      std::vector<T> vecColumn;
+      const BandRows<T> resultRows;
+    };
+
+    // Row vector times matrix: the result is a weighted sum of the
+    // rows of b.
+    template <class T> void multiplyRow(const PiiMatrix<T>& a, const PiiMatrix<T>& b, PiiMatrix<T>& result)
+    {
+      const T* pVector = a.row(0);
+      T* pResult = result.row(0);
+      const int iColumns = b.columns();
+      for (int c=0; c<iColumns; ++c)
+        pResult[c] = 0;
+      for (int k=0; k<b.rows(); ++k)
+        {
+          const T* pRow = b.row(k);
+          const T weight = pVector[k];
+          for (int c=0; c<iColumns; ++c)
+            pResult[c] += weight * pRow[c];
+        }
+    }
+
+#ifdef PII_USE_CBLAS
+    inline void gemm(const PiiMatrix<float>& a, const PiiMatrix<float>& b, PiiMatrix<float>& result)
+    {
+      cblas_sgemm(CblasRowMajor, CblasNoTrans, CblasNoTrans,
+                  a.rows(), b.columns(), a.columns(),
+                  1.0f, a.row(0), int(a.stride() / sizeof(float)),
+                  b.row(0), int(b.stride() / sizeof(float)),
+                  0.0f, result.row(0), int(result.stride() / sizeof(float)));
+    }
+
+    inline void gemm(const PiiMatrix<double>& a, const PiiMatrix<double>& b, PiiMatrix<double>& result)
+    {
+      cblas_dgemm(CblasRowMajor, CblasNoTrans, CblasNoTrans,
+                  a.rows(), b.columns(), a.columns(),
+                  1.0, a.row(0), int(a.stride() / sizeof(double)),
+                  b.row(0), int(b.stride() / sizeof(double)),
+                  0.0, result.row(0), int(result.stride() / sizeof(double)));
+    }
+#endif
+
+    template <class T> void multiplyBands(const ParallelExecution& policy,
+                                          const PiiMatrix<T>& a,
+                                          const PiiMatrix<T>& b,
+                                          PiiMatrix<T>& result)
+    {
+      if (a.columns() != b.rows() ||
+          result.rows() != a.rows() || result.columns() != b.columns())
+        PII_MATRIX_SIZE_MISMATCH;
+      if (result.isEmpty())
+        return;
+      if (a.columns() == 0)
+        {
+          result = 0;
+          return;
+        }
+
+#ifdef PII_USE_CBLAS
+      Q_UNUSED(policy);
+      gemm(a, b, result);
+#else
+      if (a.rows() == 1)
+        multiplyRow(a, b, result);
+      else if (b.columns() == 1)
+        forEachBand(policy, a.rows(), 0, VectorProduct<T>(a, b, result));
+      else
+        forEachBand(policy, a.rows(), 0, BlockedProduct<T>(a, b, result));
+#endif
+    }
+
+    ParallelExecution defaultPolicy()
+    {
+      ParallelExecution policy;
+      // Each band packs the second matrix separately. Make sure the
+      // bands are large enough to amortize that.
+      policy.minBandRows = 64;
+      return policy;
+    }
+  }
+
+  void multiplyMatrices(const ParallelExecution& policy,
+                        const PiiMatrix<float>& a,
+                        const PiiMatrix<float>& b,
+                        PiiMatrix<float>& result)
+  {
+    multiplyBands(policy, a, b, result);
+  }
+
+  void multiplyMatrices(const ParallelExecution& policy,
+                        const PiiMatrix<double>& a,
+                        const PiiMatrix<double>& b,
+                        PiiMatrix<double>& result)
+  {
+    multiplyBands(policy, a, b, result);
+  }
+
+  void multiplyMatrices(const PiiMatrix<float>& a, const PiiMatrix<float>& b, PiiMatrix<float>& result)
+  {
+    multiplyBands(defaultPolicy(), a, b, result);
+  }
+
+  void multiplyMatrices(const PiiMatrix<double>& a, const PiiMatrix<double>& b, PiiMatrix<double>& result)
+  {
+    multiplyBands(defaultPolicy(), a, b, result);
+  }
+}
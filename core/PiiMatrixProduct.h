@@ -0,0 +1,111 @@
+/* This file is part of Into.
+ * Copyright (C) Intopii 2013.
+ * All rights reserved.
+ *
+ * Licensees holding a commercial Into license may use this file in
+ * accordance with the commercial license agreement. Please see
+ * LICENSE.commercial for commercial licensing terms.
+ *
+ * Alternatively, this file may be used under the terms of the GNU
+ * Affero General Public License version 3 as published by the Free
+ * Software Foundation. In addition, Intopii gives you special rights
+ * to use Into as a part of open source software projects. Please
+ * refer to LICENSE.AGPL3 for details.
+ */
+
+#ifndef _PIIMATRIXPRODUCT_H
+#define _PIIMATRIXPRODUCT_H
+
+#include "PiiMatrix.h"
+
+namespace Pii
+{
+  struct ParallelExecution;
+
+  /**
+   * The number of multiply-add operations (rows of the first matrix
+   * times its columns times the columns of the second one) at and
+   * above which the matrix multiplication operator uses
+   * [multiplyMatrices()] for `float` and `double` matrices. Below
+   * this limit, packing the matrices costs more than it saves.
+   */
+  enum { BlockedProductThreshold = 32*32*32 };
+
+  /**
+   * Calculates *a* * *b* and stores the result to *result*, which
+   * must be a preallocated *a*.rows()-by-*b*.columns() matrix. The
+   * initial contents of *result* are overwritten, and *result* must
+   * not share data with *a* or *b*.
+   *
+   * The product is calculated with a cache-blocked algorithm: blocks
+   * of *a* and *b* are packed into contiguous buffers that fit into
+   * the processor's caches, and a register-blocked kernel
+   * accumulates 4-by-8 tiles of the result. The rows of the result
+   * are split into bands that are processed in parallel as
+   * determined by *policy*. If Into was built with
+   * `ENABLE=cblas`, the calculation is delegated to the system's
+   * BLAS library, and *policy* is ignored.
+   *
+   * ~~~(c++)
+   * PiiMatrix<double> matResult(PiiMatrix<double>::uninitialized(a.rows(), b.columns()));
+   * // Use at most two threads
+   * Pii::multiplyMatrices(Pii::ParallelExecution(2), a, b, matResult);
+   * ~~~
+   *
+   * @exception PiiInvalidArgumentException& if the sizes of the
+   * matrices don't match.
+   */
+  PII_CORE_EXPORT void multiplyMatrices(const ParallelExecution& policy,
+                                        const PiiMatrix<float>& a,
+                                        const PiiMatrix<float>& b,
+                                        PiiMatrix<float>& result);
+  /**
+   * @overload
+   */
+  PII_CORE_EXPORT void multiplyMatrices(const ParallelExecution& policy,
+                                        const PiiMatrix<double>& a,
+                                        const PiiMatrix<double>& b,
+                                        PiiMatrix<double>& result);
+  /**
+   * Calculates *a* * *b* with the default parallel execution policy.
+   */
+  PII_CORE_EXPORT void multiplyMatrices(const PiiMatrix<float>& a,
+                                        const PiiMatrix<float>& b,
+                                        PiiMatrix<float>& result);
+  /**
+   * @overload
+   */
+  PII_CORE_EXPORT void multiplyMatrices(const PiiMatrix<double>& a,
+                                        const PiiMatrix<double>& b,
+                                        PiiMatrix<double>& result);
+
+  /// @hide
+  template <class T, class Matrix1, class Matrix2>
+  bool multiplyBlocked(const Matrix1& m1, const Matrix2& m2, PiiMatrix<T>& result)
+  {
+    if (qint64(m1.rows()) * m1.columns() * m2.columns() < BlockedProductThreshold)
+      return false;
+    // Expressions and other types are evaluated first. This costs
+    // O(n^2), the product O(n^3).
+    multiplyMatrices(PiiMatrix<T>(m1), PiiMatrix<T>(m2), result);
+    return true;
+  }
+
+  template <class Matrix1, class Matrix2, class Result>
+  inline bool multiplyLarge(const Matrix1&, const Matrix2&, Result&) { return false; }
+
+  template <class Matrix1, class Matrix2>
+  inline bool multiplyLarge(const Matrix1& m1, const Matrix2& m2, PiiMatrix<float>& result)
+  {
+    return multiplyBlocked<float>(m1, m2, result);
+  }
+
+  template <class Matrix1, class Matrix2>
+  inline bool multiplyLarge(const Matrix1& m1, const Matrix2& m2, PiiMatrix<double>& result)
+  {
+    return multiplyBlocked<double>(m1, m2, result);
+  }
+  /// @endhide
+}
+
+#endif //_PIIMATRIXPRODUCT_H
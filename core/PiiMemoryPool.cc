@@ -0,0 +1,102 @@
+/* This file is part of Into.
+ * Copyright (C) Intopii 2013.
+ * All rights reserved.
+ *
+ * Licensees holding a commercial Into license may use this file in
+ * accordance with the commercial license agreement. Please see
+ * LICENSE.commercial for commercial licensing terms.
+ *
+ * Alternatively, this file may be used under the terms of the GNU
+ * Affero General Public License version 3 as published by the Free
+ * Software Foundation. In addition, Intopii gives you special rights
+ * to use Into as a part of open source software projects. Please
+ * refer to LICENSE.AGPL3 for details.
+ */
+
+#include "PiiMemoryPool.h"
+#include <cstdlib>
+
+class PiiMemoryPool::Data
+{
+public:
+  Data(std::size_t maxBlockSize, std::size_t classMemorySize, int cacheSize) :
+    stClassMemorySize(classMemorySize),
+    iClassCount(1)
+  {
+    // The usable size of class N is (16 << N) - sizeof(void*).
+    while ((std::size_t(16) << (iClassCount-1)) - sizeof(void*) < maxBlockSize && iClassCount < MaxClassCount)
+      ++iClassCount;
+    stTotalSize = stClassMemorySize * iClassCount;
+    pMemory = static_cast<char*>(std::malloc(stTotalSize));
+    for (int i=0; i<iClassCount; ++i)
+      apClasses[i] = new PiiSimpleMemoryManager(pMemory != 0 ? pMemory + i * stClassMemorySize : 0,
+                                                pMemory != 0 ? stClassMemorySize : 0,
+                                                (std::size_t(16) << i) - sizeof(void*),
+                                                cacheSize);
+  }
+
+  ~Data()
+  {
+    for (int i=0; i<iClassCount; ++i)
+      delete apClasses[i];
+    std::free(pMemory);
+  }
+
+  enum { MaxClassCount = 24 };
+
+  std::size_t stClassMemorySize, stTotalSize;
+  int iClassCount;
+  char* pMemory;
+  PiiSimpleMemoryManager* apClasses[MaxClassCount];
+};
+
+PiiMemoryPool::PiiMemoryPool(std::size_t maxBlockSize, std::size_t classMemorySize, int cacheSize) :
+  d(new Data(maxBlockSize, classMemorySize, cacheSize))
+{}
+
+PiiMemoryPool::~PiiMemoryPool()
+{
+  delete d;
+}
+
+void* PiiMemoryPool::allocate(std::size_t bytes)
+{
+  if (bytes == 0)
+    return 0;
+  // Find the smallest N for which (16 << N) >= bytes + sizeof(void*).
+  std::size_t stUnits = (bytes + sizeof(void*) - 1) >> 4;
+  int iClass = 0;
+  while (stUnits != 0)
+    {
+      stUnits >>= 1;
+      ++iClass;
+    }
+  if (iClass >= d->iClassCount)
+    return 0;
+  return d->apClasses[iClass]->allocate(bytes);
+}
+
+bool PiiMemoryPool::deallocate(void* buffer)
+{
+  if (buffer == 0)
+    return true;
+  std::size_t stOffset = std::size_t(buffer) - std::size_t(d->pMemory);
+  if (stOffset >= d->stTotalSize)
+    return false;
+  return d->apClasses[stOffset / d->stClassMemorySize]->deallocate(buffer);
+}
+
+int PiiMemoryPool::classCount() const
+{
+  return d->iClassCount;
+}
+
+PiiSimpleMemoryManager* PiiMemoryPool::sizeClass(int index) const
+{
+  return d->apClasses[index];
+}
+
+std::size_t PiiMemoryPool::maxBlockSize() const
+{
+  return d->apClasses[d->iClassCount-1]->blockSize();
+}
@@ -0,0 +1,111 @@
+/* This file is part of Into.
+ * Copyright (C) Intopii 2013.
+ * All rights reserved.
+ *
+ * Licensees holding a commercial Into license may use this file in
+ * accordance with the commercial license agreement. Please see
+ * LICENSE.commercial for commercial licensing terms.
+ *
+ * Alternatively, this file may be used under the terms of the GNU
+ * Affero General Public License version 3 as published by the Free
+ * Software Foundation. In addition, Intopii gives you special rights
+ * to use Into as a part of open source software projects. Please
+ * refer to LICENSE.AGPL3 for details.
+ */
+
+#ifndef _PIIMEMORYPOOL_H
+#define _PIIMEMORYPOOL_H
+
+#include "PiiSimpleMemoryManager.h"
+
+/**
+ * A memory pool with multiple size classes. PiiMemoryPool divides a
+ * fixed-size buffer into a number of [PiiSimpleMemoryManager]
+ * instances, each of which manages blocks of a different size. The
+ * size classes are powers of two, starting at 16 bytes. A request is
+ * served from the smallest class whose blocks are large enough. If
+ * the class is exhausted or the request is too large for any class,
+ * no memory will be allocated.
+ *
+ * Like PiiSimpleMemoryManager, PiiMemoryPool is lock-free and can
+ * keep per-thread caches of free blocks. All classes share a single
+ * contiguous buffer, which makes it possible to find the owner of a
+ * released block with one subtraction and division.
+ *
+ * ~~~(c++)
+ * // 64 kB for each of the classes 16, 32, ..., 512 bytes.
+ * PiiMemoryPool pool(512 - sizeof(void*), 65536);
+ * void* ptr = pool.allocate(100);
+ * if (ptr == 0)
+ *   ptr = ::operator new(100);
+ * // ...
+ * if (!pool.deallocate(ptr))
+ *   ::operator delete(ptr);
+ * ~~~
+ */
+class PII_CORE_EXPORT PiiMemoryPool
+{
+public:
+  /**
+   * Creates a new memory pool.
+   *
+   * @param maxBlockSize the largest number of bytes the pool needs to
+   * serve. Size classes are created until the usable size of the
+   * largest class (a power of two minus `sizeof(void*)`) is at least
+   * this large.
+   *
+   * @param classMemorySize the number of bytes to reserve for each
+   * size class.
+   *
+   * @param cacheSize the number of free blocks each thread may keep
+   * in its private cache in each size class. See
+   * [PiiSimpleMemoryManager::PiiSimpleMemoryManager()].
+   */
+  PiiMemoryPool(std::size_t maxBlockSize, std::size_t classMemorySize, int cacheSize = 32);
+
+  /**
+   * Releases the memory buffer. All memory allocated from the pool
+   * will be invalidated.
+   */
+  ~PiiMemoryPool();
+
+  /**
+   * Allocates at least *bytes* bytes of memory from the smallest
+   * size class that fits the request. Returns 0 if *bytes* is zero,
+   * exceeds [maxBlockSize()], or if the size class is full. The
+   * returned memory is aligned at a 16-byte boundary.
+   */
+  void* allocate(std::size_t bytes);
+
+  /**
+   * Releases a block allocated with [allocate()]. Returns `false` if
+   * *buffer* was not allocated from this pool and `true` otherwise.
+   * Null pointers are accepted and `true` is returned.
+   */
+  bool deallocate(void* buffer);
+
+  /**
+   * Returns the number of size classes.
+   */
+  int classCount() const;
+
+  /**
+   * Returns the memory manager that handles the size class at
+   * *index*. Index zero is the smallest class.
+   */
+  PiiSimpleMemoryManager* sizeClass(int index) const;
+
+  /**
+   * Returns the largest number of bytes that can be allocated with a
+   * single call to [allocate()].
+   */
+  std::size_t maxBlockSize() const;
+
+private:
+  class Data;
+  Data* d;
+
+  PII_DISABLE_COPY(PiiMemoryPool);
+};
+
+#endif //_PIIMEMORYPOOL_H
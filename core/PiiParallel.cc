@@ -0,0 +1,183 @@
+/* This file is part of Into.
+ * Copyright (C) Intopii 2013.
+ * All rights reserved.
+ *
+ * Licensees holding a commercial Into license may use this file in
+ * accordance with the commercial license agreement. Please see
+ * LICENSE.commercial for commercial licensing terms.
+ *
+ * Alternatively, this file may be used under the terms of the GNU
+ * Affero General Public License version 3 as published by the Free
+ * Software Foundation. In addition, Intopii gives you special rights
+ * to use Into as a part of open source software projects. Please
+ * refer to LICENSE.AGPL3 for details.
+ */
+
+#include "PiiParallel.h"
+
+#ifndef PII_NO_QT
+#  include "PiiThreadPool.h"
+#  include "PiiException.h"
+#  include <QMutex>
+#  include <QWaitCondition>
+#  include <QVector>
+#  ifdef PII_CXX11
+#    include <exception>
+#  endif
+#endif
+
+namespace Pii
+{
+  BandFunction::~BandFunction() {}
+
+#ifndef PII_NO_QT
+  namespace
+  {
+    struct BandContext
+    {
+      BandContext(BandFunction* function, int bandCount) :
+        pFunction(function),
+        iRemainingBands(bandCount)
+#ifndef PII_CXX11
+        , pException(0), bUnknownException(false)
+#endif
+      {}
+#ifndef PII_CXX11
+      ~BandContext() { delete pException; }
+#endif
+
+      void run(int firstRow, int rowCount);
+      void finishBand();
+      void rethrow();
+
+      BandFunction* pFunction;
+      QMutex mutex;
+      QWaitCondition condition;
+      int iRemainingBands;
+#ifdef PII_CXX11
+      std::exception_ptr exception;
+#else
+      PiiException* pException;
+      bool bUnknownException;
+#endif
+    };
+
+    void BandContext::run(int firstRow, int rowCount)
+    {
+      try
+        {
+          (*pFunction)(firstRow, rowCount);
+        }
+#ifdef PII_CXX11
+      catch (...)
+        {
+          synchronized (mutex)
+            if (!exception)
+              exception = std::current_exception();
+        }
+#else
+      catch (PiiException& ex)
+        {
+          synchronized (mutex)
+            if (pException == 0 && !bUnknownException)
+              pException = new PiiException(ex);
+        }
+      catch (...)
+        {
+          synchronized (mutex)
+            if (pException == 0)
+              bUnknownException = true;
+        }
+#endif
+    }
+
+    void BandContext::finishBand()
+    {
+      synchronized (mutex)
+        if (--iRemainingBands == 0)
+          condition.wakeAll();
+    }
+
+    void BandContext::rethrow()
+    {
+#ifdef PII_CXX11
+      if (exception)
+        std::rethrow_exception(exception);
+#else
+      if (pException != 0)
+        {
+          // Only the base class can be copied.
+          PiiException ex(*pException);
+          throw ex;
+        }
+      if (bUnknownException)
+        PII_THROW(PiiException, "Unknown exception in a parallel band.");
+#endif
+    }
+
+    class BandTask : public PiiThreadPool::Task
+    {
+    public:
+      BandTask() : _pContext(0), _iFirstRow(0), _iRowCount(0) {}
+      BandTask(BandContext* context, int firstRow, int rowCount) :
+        _pContext(context), _iFirstRow(firstRow), _iRowCount(rowCount)
+      {}
+
+      void run()
+      {
+        _pContext->run(_iFirstRow, _iRowCount);
+        _pContext->finishBand();
+      }
+
+    private:
+      BandContext* _pContext;
+      int _iFirstRow, _iRowCount;
+    };
+  }
+#endif
+
+  void forEachBand(const ParallelExecution& policy, int rows, int overlap, BandFunction& function)
+  {
+    if (rows <= 0)
+      return;
+#ifdef PII_NO_QT
+    Q_UNUSED(policy);
+    Q_UNUSED(overlap);
+    function(0, rows);
+#else
+    PiiThreadPool* pPool = policy.pool != 0 ? policy.pool : PiiThreadPool::globalInstance();
+    const int iMaxBands = policy.maxBands > 0 ? policy.maxBands : pPool->threadCount();
+    // A band shorter than the overlap would mostly process rows that
+    // are thrown away.
+    const int iMinRows = qMax(1, qMax(policy.minBandRows, overlap));
+    const int iBands = qMin(iMaxBands, rows / iMinRows);
+    if (iBands <= 1)
+      {
+        function(0, rows);
+        return;
+      }
+
+    BandContext context(&function, iBands);
+    QVector<BandTask> vecTasks(iBands);
+    for (int i=1; i<iBands; ++i)
+      {
+        const int iFirst = int(qint64(rows) * i / iBands),
+          iNext = int(qint64(rows) * (i+1) / iBands);
+        vecTasks[i] = BandTask(&context, iFirst, iNext - iFirst);
+        pPool->submit(&vecTasks[i]);
+      }
+    // The calling thread takes the first band.
+    context.run(0, int(qint64(rows) / iBands));
+
+    pPool->beginBlocking();
+    synchronized (context.mutex)
+      {
+        --context.iRemainingBands;
+        while (context.iRemainingBands > 0)
+          context.condition.wait(&context.mutex);
+      }
+    pPool->endBlocking();
+    context.rethrow();
+#endif
+  }
+}
@@ -0,0 +1,241 @@
+/* This file is part of Into.
+ * Copyright (C) Intopii 2013.
+ * All rights reserved.
+ *
+ * Licensees holding a commercial Into license may use this file in
+ * accordance with the commercial license agreement. Please see
+ * LICENSE.commercial for commercial licensing terms.
+ *
+ * Alternatively, this file may be used under the terms of the GNU
+ * Affero General Public License version 3 as published by the Free
+ * Software Foundation. In addition, Intopii gives you special rights
+ * to use Into as a part of open source software projects. Please
+ * refer to LICENSE.AGPL3 for details.
+ */
+
+#ifndef _PIIPARALLEL_H
+#define _PIIPARALLEL_H
+
+#include "PiiMatrix.h"
+#include <algorithm>
+
+class PiiThreadPool;
+
+namespace Pii
+{
+  /**
+   * An execution policy for library functions that can process a
+   * matrix in parallel. Such functions have an overload that takes a
+   * `ParallelExecution` as the first argument. The overload splits
+   * the output into bands of consecutive rows and processes the bands
+   * in a thread pool.
+   *
+   * ~~~(c++)
+   * // Use the global thread pool with default settings
+   * PiiMatrix<int> matFiltered = PiiImage::medianFilter(Pii::ParallelExecution(), image, 7);
+   * // At most two bands
+   * PiiMatrix<int> matEroded = PiiImage::erode(Pii::ParallelExecution(2), image, mask);
+   * ~~~
+   *
+   * ! In builds without Qt, the bands are processed sequentially in
+   * the calling thread.
+   */
+  struct ParallelExecution
+  {
+    /**
+     * Creates a new execution policy.
+     *
+     * @param maxBands the maximum number of bands. If this value is
+     * less than one, the number of threads in *pool* will be used.
+     *
+     * @param pool the thread pool that processes the bands. If this
+     * value is zero, PiiThreadPool::globalInstance() will be used.
+     */
+    explicit ParallelExecution(int maxBands = 0, PiiThreadPool* pool = 0) :
+      maxBands(maxBands), minBandRows(16), pool(pool)
+    {}
+
+    /**
+     * The maximum number of bands.
+     */
+    int maxBands;
+    /**
+     * The minimum number of rows in a band, excluding overlap. Small
+     * matrices are processed in fewer bands, and matrices with less
+     * than two times `minBandRows` rows in the calling thread only.
+     * The default is 16.
+     */
+    int minBandRows;
+    /**
+     * The thread pool used for processing the bands.
+     */
+    PiiThreadPool* pool;
+  };
+
+  /**
+   * An interface for functions that process a band of rows. See
+   * [forEachBand()].
+   */
+  class PII_CORE_EXPORT BandFunction
+  {
+  public:
+    virtual ~BandFunction();
+    /**
+     * Processes *rowCount* rows starting at *firstRow*. This function
+     * will be called from many threads simultaneously.
+     */
+    virtual void operator() (int firstRow, int rowCount) = 0;
+  };
+
+  /**
+   * Splits *rows* rows into bands as determined by *policy* and calls
+   * *function* for each of them. One of the bands is processed in the
+   * calling thread. The function returns once all bands are done. If
+   * *function* throws an exception for any of the bands, the first
+   * exception will be rethrown after all bands have finished.
+   *
+   * @param overlap the number of extra rows *function* needs to read
+   * on each side of its band. This is used in choosing a band count
+   * that keeps the overhead reasonable.
+   */
+  PII_CORE_EXPORT void forEachBand(const ParallelExecution& policy, int rows, int overlap,
+                                   BandFunction& function);
+
+  /**
+   * Writable access to the rows of a matrix from band functions.
+   * PiiMatrix::row() detaches the matrix, which must not happen in
+   * many threads at once. The constructor detaches *matrix* in the
+   * calling thread and stores a pointer to the first row and the row
+   * stride. The band functions then use [row()], which does not touch
+   * the matrix. The matrix must not be resized or reassigned as long
+   * as its rows are accessed this way.
+   *
+   * ~~~(c++)
+   * struct MyBand
+   * {
+   *   MyBand(const PiiMatrix<int>& input, PiiMatrix<int>& output) :
+   *     input(input), outputRows(output)
+   *   {}
+   *
+   *   void operator() (int firstRow, int rowCount)
+   *   {
+   *     for (int r=firstRow; r<firstRow+rowCount; ++r)
+   *       Pii::copyN(input[r], input.columns(), outputRows.row(r));
+   *   }
+   *
+   *   const PiiMatrix<int>& input;
+   *   Pii::BandRows<int> outputRows;
+   * };
+   * ~~~
+   */
+  template <class T> class BandRows
+  {
+  public:
+    /**
+     * Creates an invalid object with a null [data()] pointer.
+     */
+    BandRows() : _pData(0), _iStride(0) {}
+    /**
+     * Detaches *matrix* and stores the location of its rows.
+     */
+    BandRows(PiiMatrix<T>& matrix) :
+      _pData(reinterpret_cast<char*>(matrix.row(0))), _iStride(matrix.stride())
+    {}
+
+    /**
+     * Returns a pointer to the beginning of row *r*.
+     */
+    T* row(int r) const { return reinterpret_cast<T*>(_pData + r * _iStride); }
+    /**
+     * Returns a pointer to the first row.
+     */
+    T* data() const { return reinterpret_cast<T*>(_pData); }
+    /**
+     * Returns the number of bytes between the beginnings of
+     * successive rows.
+     */
+    std::size_t stride() const { return _iStride; }
+
+  private:
+    char* _pData;
+    std::size_t _iStride;
+  };
+
+  /// @hide
+  template <class Function> class GenericBandFunction : public BandFunction
+  {
+  public:
+    GenericBandFunction(Function function) : _function(function) {}
+    void operator() (int firstRow, int rowCount) { _function(firstRow, rowCount); }
+  private:
+    Function _function;
+  };
+
+  template <class T, class U, class Function> struct BandTransform
+  {
+    BandTransform(const PiiMatrix<U>& input, PiiMatrix<T>& output, int overlap, Function function) :
+      input(input), overlap(overlap), function(function), outputRows(output)
+    {}
+
+    void operator() (int firstRow, int rowCount)
+    {
+      const int iFirst = qMax(0, firstRow - overlap),
+        iLast = qMin(input.rows(), firstRow + rowCount + overlap);
+      const PiiMatrix<T> matBand(function(input(iFirst, 0, iLast - iFirst, -1)));
+      for (int r=0; r<rowCount; ++r)
+        {
+          const T* pSource = matBand.row(firstRow - iFirst + r);
+          std::copy(pSource, pSource + matBand.columns(), outputRows.row(firstRow + r));
+        }
+    }
+
+    const PiiMatrix<U>& input;
+    const int overlap;
+    Function function;
+    const BandRows<T> outputRows;
+  };
+  /// @hide
+
+  /**
+   * Calls *function* for each band of rows. *function* must be
+   * callable as `function(firstRow, rowCount)`.
+   */
+  template <class Function>
+  inline void forEachBand(const ParallelExecution& policy, int rows, int overlap, Function function)
+  {
+    GenericBandFunction<Function> bandFunction(function);
+    forEachBand(policy, rows, overlap, static_cast<BandFunction&>(bandFunction));
+  }
+
+  /**
+   * Applies *function* to *input* in bands of rows. Each band is
+   * extended by *overlap* rows at the top and at the bottom, if
+   * there are enough rows in *input*, and passed to *function*. The
+   * function must return a matrix whose size equals that of its
+   * input. The rows that correspond to the band without the overlap
+   * are then copied to a preallocated result matrix. If the result
+   * of *function* at a row depends on input rows no farther than
+   * *overlap* rows away, the result equals `function(input)`.
+   *
+   * ~~~(c++)
+   * // A 5-by-5 median filter needs two rows above and below.
+   * PiiMatrix<int> matResult(Pii::transformBands<int>(Pii::ParallelExecution(), image, 2,
+   *                                                   MyMedianFilter(5)));
+   * ~~~
+   */
+  template <class T, class U, class Function>
+  PiiMatrix<T> transformBands(const ParallelExecution& policy,
+                              const PiiMatrix<U>& input,
+                              int overlap,
+                              Function function)
+  {
+    PiiMatrix<T> matResult(PiiMatrix<T>::uninitialized(input.rows(), input.columns()));
+    if (matResult.isEmpty())
+      return matResult;
+    forEachBand(policy, input.rows(), overlap,
+                BandTransform<T,U,Function>(input, matResult, overlap, function));
+    return matResult;
+  }
+}
+
+#endif //_PIIPARALLEL_H
@@ -85,6 +85,27 @@ namespace Pii
    * copy of matrix' data.
    */
   template <class T> QImage matrixToQImage(const PiiMatrix<T>& matrix);
+
+#if QT_VERSION >= 0x050000
+  /**
+   * Converts a PiiMatrix to a QImage without copying pixel data, if
+   * possible. The returned image wraps the matrix' buffer in
+   * read-only mode and holds a reference to the data. The reference
+   * is released once the last copy of the image is destroyed, in
+   * whichever thread that happens. Modifying the image detaches it
+   * from the matrix. If the type of the matrix is not
+   * binary-compatible with a QImage format or its rows are not
+   * 32-bit aligned, this function falls back to
+   * [matrixToQImage()].
+   *
+   * ~~~(c++)
+   * PiiMatrix<uchar> matGray(480, 640);
+   * QImage image(Pii::matrixToSharedQImage(matGray));
+   * // image.constBits() == matGray.row(0)
+   * ~~~
+   */
+  template <class T> QImage matrixToSharedQImage(const PiiMatrix<T>& matrix);
+#endif
 }
 
 /**
@@ -265,7 +286,7 @@ typedef PiiQImage<PiiColor4<uchar> > PiiColorQImage;
 
 template <class T> struct PiiQImageTraits
 {
-  enum { Format = QImage::Format_Indexed8 };
+  enum { Format = QImage::Format_Indexed8, Shareable = 0 };
   static inline void memcpy(uchar* to, const T* from, std::size_t pixels)
   {
     for (std::size_t i=0; i<pixels; ++i)
@@ -274,6 +295,7 @@ template <class T> struct PiiQImageTraits
 };
 template <class T> struct PiiCompatibleQImageTraits
 {
+  enum { Shareable = 1 };
   static inline void memcpy(uchar* to, const T* from, std::size_t pixels) { std::memcpy(to, from, pixels*sizeof(T)); }
 };
 template <> struct PiiQImageTraits<char> : PiiCompatibleQImageTraits<char>
@@ -294,7 +316,7 @@ template <> struct PiiQImageTraits<PiiColor4<uchar> > : PiiCompatibleQImageTrait
 };
 template <> struct PiiQImageTraits<PiiColor<uchar> >
 {
-  enum { Format = QImage::Format_RGB32 };
+  enum { Format = QImage::Format_RGB32, Shareable = 0 };
   static inline void memcpy(uchar* to, const PiiColor<uchar>* from, std::size_t pixels)
   {
     for (std::size_t i=0; i<pixels; ++i, to+=4,  ++from)
@@ -309,7 +331,7 @@ template <> struct PiiQImageTraits<PiiColor<uchar> >
 template <> struct PiiQImageTraits<PiiColor<char> > : PiiQImageTraits<PiiColor<uchar> > {};
 template <> struct PiiQImageTraits<float>
 {
-  enum { Format = QImage::Format_Indexed8 };
+  enum { Format = QImage::Format_Indexed8, Shareable = 0 };
   static inline void memcpy(uchar* to, const float* from, std::size_t pixels)
   {
     for (std::size_t i=0; i<pixels; ++i)
@@ -384,6 +406,36 @@ namespace Pii
     return result;
   }
 
+#if QT_VERSION >= 0x050000
+  /// @internal
+  template <class T> void releaseSharedQImageData(void* matrix)
+  {
+    delete static_cast<PiiMatrix<T>*>(matrix);
+  }
+
+  template <class T> QImage matrixToSharedQImage(const PiiMatrix<T>& matrix)
+  {
+    if (!PiiQImageTraits<T>::Shareable || matrix.isEmpty() ||
+        (quintptr(matrix.row(0)) & 3) != 0 || (matrix.stride() & 3) != 0)
+      return matrixToQImage(matrix);
+
+    QImage::Format format = (QImage::Format)PiiQImageTraits<T>::Format;
+    // Setting a color table would detach a read-only image.
+    if (format == QImage::Format_Indexed8)
+#if QT_VERSION >= 0x050500
+      format = QImage::Format_Grayscale8;
+#else
+      return matrixToQImage(matrix);
+#endif
+
+    // The copy keeps the buffer alive as long as the image needs it.
+    PiiMatrix<T>* pMatrix = new PiiMatrix<T>(matrix);
+    return QImage(reinterpret_cast<const uchar*>(pMatrix->row(0)),
+                  pMatrix->columns(), pMatrix->rows(), int(pMatrix->stride()),
+                  format, &releaseSharedQImageData<T>, pMatrix);
+  }
+#endif
+
   template <class T> QImage* createQImage(PiiMatrix<T>& matrix)
   {
     return Pii::IfClass<Pii::IsColor<T>,
@@ -0,0 +1,392 @@
+/* This file is part of Into.
+ * Copyright (C) Intopii 2013.
+ * All rights reserved.
+ *
+ * Licensees holding a commercial Into license may use this file in
+ * accordance with the commercial license agreement. Please see
+ * LICENSE.commercial for commercial licensing terms.
+ *
+ * Alternatively, this file may be used under the terms of the GNU
+ * Affero General Public License version 3 as published by the Free
+ * Software Foundation. In addition, Intopii gives you special rights
+ * to use Into as a part of open source software projects. Please
+ * refer to LICENSE.AGPL3 for details.
+ */
+
+#include "PiiRandomGenerator.h"
+#include "PiiParallel.h"
+#include "PiiFastMath.h"
+#include "PiiSynchronized.h"
+
+#include <cmath>
+
+#ifndef PII_NO_QT
+#  include <QThreadStorage>
+#  include <QMutex>
+#elif defined(PII_CXX11)
+#  include <atomic>
+#endif
+
+namespace
+{
+  enum
+  {
+    PhiloxM0 = 0xD2511F53u,
+    PhiloxM1 = 0xCD9E8D57u,
+    PhiloxW0 = 0x9E3779B9u,
+    PhiloxW1 = 0xBB67AE85u
+  };
+
+  // The number of words generated at once by the bulk fills.
+  const int iWordBufferSize = 256;
+
+  inline void philoxRound(quint32* c, quint32 k0, quint32 k1)
+  {
+    const quint64 iProduct0 = quint64(PhiloxM0) * c[0],
+      iProduct1 = quint64(PhiloxM1) * c[2];
+    const quint32 iNew0 = quint32(iProduct1 >> 32) ^ c[1] ^ k0,
+      iNew2 = quint32(iProduct0 >> 32) ^ c[3] ^ k1;
+    c[0] = iNew0;
+    c[1] = quint32(iProduct1);
+    c[2] = iNew2;
+    c[3] = quint32(iProduct0);
+  }
+
+  inline void philox(const quint32* key, quint64 counter, quint64 stream, quint32* result)
+  {
+    result[0] = quint32(counter);
+    result[1] = quint32(counter >> 32);
+    result[2] = quint32(stream);
+    result[3] = quint32(stream >> 32);
+    quint32 k0 = key[0], k1 = key[1];
+    for (int i=0; i<9; ++i)
+      {
+        philoxRound(result, k0, k1);
+        k0 += PhiloxW0;
+        k1 += PhiloxW1;
+      }
+    philoxRound(result, k0, k1);
+  }
+
+  // Turns random words into numbers. Each unit of wordsPerUnit words
+  // produces elementsPerUnit numbers. The loops have no branches so
+  // that the compiler can vectorize them.
+  template <class T> struct UniformConverter;
+  template <> struct UniformConverter<float>
+  {
+    enum { wordsPerUnit = 1, elementsPerUnit = 1 };
+    UniformConverter(float min, float max) : fScale(max - min), fOffset(min) {}
+    // Returns (n + offset) / 2^24, where n is a random 24-bit integer.
+    static float toUnit(const quint32* words, int offset = 0)
+    {
+      return float(int(words[0] >> 8) + offset) * (1.0f / 16777216.0f);
+    }
+    void operator() (const quint32* words, float* result, int units) const
+    {
+      for (int i=0; i<units; ++i)
+        result[i] = fOffset + fScale * toUnit(words + i);
+    }
+    float fScale, fOffset;
+  };
+
+  template <> struct UniformConverter<double>
+  {
+    enum { wordsPerUnit = 2, elementsPerUnit = 1 };
+    UniformConverter(double min, double max) : dScale(max - min), dOffset(min) {}
+    // Returns (n + offset) / 2^53, where n is a random 53-bit integer.
+    static double toUnit(const quint32* words, int offset = 0)
+    {
+      return (double(int(words[0] >> 5)) * 67108864.0 + double(int(words[1] >> 6) + offset)) *
+        (1.0 / 9007199254740992.0);
+    }
+    void operator() (const quint32* words, double* result, int units) const
+    {
+      for (int i=0; i<units; ++i)
+        result[i] = dOffset + dScale * toUnit(words + 2*i);
+    }
+    double dScale, dOffset;
+  };
+
+  // Box-Muller transform. The first number of each pair is in (0,1]
+  // to avoid log(0).
+  template <class T> struct NormalConverter
+  {
+    enum
+    {
+      wordsPerUnit = 2 * UniformConverter<T>::wordsPerUnit,
+      elementsPerUnit = 2,
+      maxUnits = iWordBufferSize / wordsPerUnit
+    };
+    NormalConverter(T mean, T deviation) : mean(mean), deviation(deviation) {}
+    void operator() (const quint32* words, T* result, int units) const
+    {
+      const int iStep = UniformConverter<T>::wordsPerUnit;
+      T aRadius[maxUnits];
+      // std::sqrt() may set errno, which prevents vectorization.
+      // Keep it in a loop of its own.
+      for (int i=0; i<units; ++i)
+        aRadius[i] = T(-2) * Pii::fastLog(UniformConverter<T>::toUnit(words + 2*iStep*i, 1));
+      for (int i=0; i<units; ++i)
+        aRadius[i] = deviation * std::sqrt(aRadius[i]);
+      for (int i=0; i<units; ++i)
+        {
+          const T angle = T(2 * M_PI) * (UniformConverter<T>::toUnit(words + (2*i+1)*iStep) - T(0.5));
+          result[2*i] = mean + aRadius[i] * Pii::fastCos(angle);
+          result[2*i+1] = mean + aRadius[i] * Pii::fastSin(angle);
+        }
+    }
+    T mean, deviation;
+  };
+
+  template <class Converter> inline int wordsPerRow(int columns)
+  {
+    return (columns + Converter::elementsPerUnit - 1) / Converter::elementsPerUnit * Converter::wordsPerUnit;
+  }
+
+#ifndef PII_NO_QT
+  QThreadStorage<PiiRandomGenerator*> threadGenerators;
+  QMutex threadMutex;
+  quint64 iThreadSeed = 0, iThreadStreamCount = 0;
+#elif defined(PII_CXX11)
+  std::atomic<quint64> iThreadSeed(0), iThreadStreamCount(0);
+#else
+  quint64 iThreadSeed = 0, iThreadStreamCount = 0;
+#endif
+}
+
+// Fills a band of rows. Each band starts at its own position in
+// the stream so that the result does not depend on the band
+// count.
+template <class T, class Converter> struct PiiRandomGenerator::BandFiller
+{
+  BandFiller(const PiiRandomGenerator& generator, PiiMatrix<T>& matrix, Converter converter) :
+    generator(generator),
+    iStartPosition(generator.position()),
+    iColumns(matrix.columns()),
+    iWordsPerRow(wordsPerRow<Converter>(matrix.columns())),
+    rows(matrix),
+    converter(converter)
+  {}
+
+  void operator() (int firstRow, int rowCount)
+  {
+    PiiRandomGenerator bandGenerator(generator);
+    for (int r=firstRow; r<firstRow+rowCount; ++r)
+      {
+        bandGenerator.setPosition(iStartPosition + quint64(r) * iWordsPerRow);
+        bandGenerator.fill(rows.row(r), iColumns, converter);
+      }
+  }
+
+  const PiiRandomGenerator& generator;
+  const quint64 iStartPosition;
+  const int iColumns, iWordsPerRow;
+  const Pii::BandRows<T> rows;
+  Converter converter;
+};
+
+PiiRandomGenerator::PiiRandomGenerator(quint64 seed, quint64 stream)
+{
+  setSeed(seed, stream);
+}
+
+void PiiRandomGenerator::setSeed(quint64 seed, quint64 stream)
+{
+  _aKey[0] = quint32(seed);
+  _aKey[1] = quint32(seed >> 32);
+  _iStream = stream;
+  _iPosition = 0;
+}
+
+quint64 PiiRandomGenerator::seed() const { return quint64(_aKey[0]) | (quint64(_aKey[1]) << 32); }
+quint64 PiiRandomGenerator::stream() const { return _iStream; }
+
+PiiRandomGenerator PiiRandomGenerator::substream(quint64 stream) const
+{
+  return PiiRandomGenerator(seed(), stream);
+}
+
+void PiiRandomGenerator::setPosition(quint64 position)
+{
+  _iPosition = position;
+  // next() only refreshes the block at block boundaries.
+  if (_iPosition & 3)
+    philox(_aKey, _iPosition >> 2, _iStream, _aBlock);
+}
+
+quint64 PiiRandomGenerator::position() const { return _iPosition; }
+void PiiRandomGenerator::discard(quint64 count) { setPosition(_iPosition + count); }
+
+quint32 PiiRandomGenerator::next()
+{
+  if ((_iPosition & 3) == 0)
+    philox(_aKey, _iPosition >> 2, _iStream, _aBlock);
+  return _aBlock[_iPosition++ & 3];
+}
+
+double PiiRandomGenerator::uniform()
+{
+  quint32 aWords[2] = { next(), next() };
+  double dResult;
+  UniformConverter<double>(0, 1)(aWords, &dResult, 1);
+  return dResult;
+}
+
+double PiiRandomGenerator::normal()
+{
+  quint32 aWords[4] = { next(), next(), next(), next() };
+  double aResult[2];
+  NormalConverter<double>(0, 1)(aWords, aResult, 1);
+  return aResult[0];
+}
+
+void PiiRandomGenerator::generateBlock(const quint32* key, quint64 counter, quint64 stream, quint32* result)
+{
+  philox(key, counter, stream, result);
+}
+
+void PiiRandomGenerator::generateWords(quint32* words, int count)
+{
+  int i = 0;
+  while (i < count && (_iPosition & 3) != 0)
+    words[i++] = next();
+  // Full blocks are independent of each other.
+  const int iBlocks = (count - i) >> 2;
+  const quint64 iCounter = _iPosition >> 2;
+  for (int b=0; b<iBlocks; ++b)
+    philox(_aKey, iCounter + b, _iStream, words + i + 4*b);
+  i += iBlocks << 2;
+  _iPosition += quint64(iBlocks) << 2;
+  while (i < count)
+    words[i++] = next();
+}
+
+template <class T, class Converter> void PiiRandomGenerator::fill(T* data, int count, Converter converter)
+{
+  const int iUnits = (count + Converter::elementsPerUnit - 1) / Converter::elementsPerUnit,
+    iUnitsPerChunk = iWordBufferSize / Converter::wordsPerUnit;
+  quint32 aWords[iWordBufferSize];
+  for (int u=0; u<iUnits; u += iUnitsPerChunk)
+    {
+      const int iChunkUnits = qMin(iUnitsPerChunk, iUnits - u);
+      generateWords(aWords, iChunkUnits * Converter::wordsPerUnit);
+      T* pData = data + u * Converter::elementsPerUnit;
+      const int iElements = qMin(count - u * int(Converter::elementsPerUnit),
+                                 iChunkUnits * int(Converter::elementsPerUnit));
+      if (iElements == iChunkUnits * Converter::elementsPerUnit)
+        converter(aWords, pData, iChunkUnits);
+      else
+        {
+          // The last unit does not fit; discard the extra numbers.
+          converter(aWords, pData, iChunkUnits - 1);
+          T aTail[Converter::elementsPerUnit];
+          converter(aWords + (iChunkUnits - 1) * Converter::wordsPerUnit, aTail, 1);
+          for (int i=(iChunkUnits - 1) * Converter::elementsPerUnit; i<iElements; ++i)
+            pData[i] = aTail[i - (iChunkUnits - 1) * Converter::elementsPerUnit];
+        }
+    }
+}
+
+template <class T, class Converter>
+void PiiRandomGenerator::fillMatrix(PiiMatrix<T>& matrix, Converter converter, const Pii::ParallelExecution* policy)
+{
+  if (matrix.isEmpty())
+    return;
+  BandFiller<T,Converter> filler(*this, matrix, converter);
+  if (policy != 0)
+    Pii::forEachBand(*policy, matrix.rows(), 0, filler);
+  else
+    filler(0, matrix.rows());
+  setPosition(_iPosition + quint64(matrix.rows()) * wordsPerRow<Converter>(matrix.columns()));
+}
+
+void PiiRandomGenerator::fillUniform(float* data, int count, float min, float max)
+{
+  fill(data, count, UniformConverter<float>(min, max));
+}
+
+void PiiRandomGenerator::fillUniform(double* data, int count, double min, double max)
+{
+  fill(data, count, UniformConverter<double>(min, max));
+}
+
+void PiiRandomGenerator::fillNormal(float* data, int count, float mean, float deviation)
+{
+  fill(data, count, NormalConverter<float>(mean, deviation));
+}
+
+void PiiRandomGenerator::fillNormal(double* data, int count, double mean, double deviation)
+{
+  fill(data, count, NormalConverter<double>(mean, deviation));
+}
+
+void PiiRandomGenerator::fillUniform(PiiMatrix<float>& matrix, float min, float max)
+{
+  fillMatrix(matrix, UniformConverter<float>(min, max), 0);
+}
+
+void PiiRandomGenerator::fillUniform(PiiMatrix<double>& matrix, double min, double max)
+{
+  fillMatrix(matrix, UniformConverter<double>(min, max), 0);
+}
+
+void PiiRandomGenerator::fillNormal(PiiMatrix<float>& matrix, float mean, float deviation)
+{
+  fillMatrix(matrix, NormalConverter<float>(mean, deviation), 0);
+}
+
+void PiiRandomGenerator::fillNormal(PiiMatrix<double>& matrix, double mean, double deviation)
+{
+  fillMatrix(matrix, NormalConverter<double>(mean, deviation), 0);
+}
+
+void PiiRandomGenerator::fillUniform(PiiMatrix<float>& matrix, float min, float max,
+                                     const Pii::ParallelExecution& policy)
+{
+  fillMatrix(matrix, UniformConverter<float>(min, max), &policy);
+}
+
+void PiiRandomGenerator::fillUniform(PiiMatrix<double>& matrix, double min, double max,
+                                     const Pii::ParallelExecution& policy)
+{
+  fillMatrix(matrix, UniformConverter<double>(min, max), &policy);
+}
+
+void PiiRandomGenerator::fillNormal(PiiMatrix<float>& matrix, float mean, float deviation,
+                                    const Pii::ParallelExecution& policy)
+{
+  fillMatrix(matrix, NormalConverter<float>(mean, deviation), &policy);
+}
+
+void PiiRandomGenerator::fillNormal(PiiMatrix<double>& matrix, double mean, double deviation,
+                                    const Pii::ParallelExecution& policy)
+{
+  fillMatrix(matrix, NormalConverter<double>(mean, deviation), &policy);
+}
+
+PiiRandomGenerator& PiiRandomGenerator::threadInstance()
+{
+#ifndef PII_NO_QT
+  if (!threadGenerators.hasLocalData())
+    {
+      synchronized (threadMutex)
+        threadGenerators.setLocalData(new PiiRandomGenerator(iThreadSeed, iThreadStreamCount++));
+    }
+  return *threadGenerators.localData();
+#elif defined(PII_CXX11)
+  static thread_local PiiRandomGenerator generator(iThreadSeed.load(), iThreadStreamCount.fetch_add(1));
+  return generator;
+#else
+  // No portable thread-local objects without Qt or C++11.
+  static PiiRandomGenerator generator(iThreadSeed, iThreadStreamCount);
+  return generator;
+#endif
+}
+
+void PiiRandomGenerator::setThreadSeed(quint64 seed)
+{
+#ifndef PII_NO_QT
+  synchronized (threadMutex)
+#endif
+    iThreadSeed = seed;
+}
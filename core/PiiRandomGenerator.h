@@ -0,0 +1,183 @@
+/* This file is part of Into.
+ * Copyright (C) Intopii 2013.
+ * All rights reserved.
+ *
+ * Licensees holding a commercial Into license may use this file in
+ * accordance with the commercial license agreement. Please see
+ * LICENSE.commercial for commercial licensing terms.
+ *
+ * Alternatively, this file may be used under the terms of the GNU
+ * Affero General Public License version 3 as published by the Free
+ * Software Foundation. In addition, Intopii gives you special rights
+ * to use Into as a part of open source software projects. Please
+ * refer to LICENSE.AGPL3 for details.
+ */
+
+#ifndef _PIIRANDOMGENERATOR_H
+#define _PIIRANDOMGENERATOR_H
+
+#include "PiiGlobal.h"
+#include "PiiMatrix.h"
+
+namespace Pii { struct ParallelExecution; }
+
+/**
+ * A counter-based pseudo-random number generator. The generator
+ * implements the Philox4x32-10 algorithm by Salmon et al. Each random
+ * number is a function of a 64-bit seed, a 64-bit stream number and
+ * the position of the number in the stream. Thus, any number of
+ * independent, reproducible streams can be created from a single seed
+ * without sharing state, and a stream can be jumped to any position in
+ * constant time.
+ *
+ * Bulk fills generate many blocks of random bits independently of
+ * each other, which lets the compiler vectorize the generation. The
+ * parallel fill functions divide a matrix into bands so that each
+ * band starts at its own position in the stream. The result does not
+ * depend on the number of threads.
+ *
+ * ~~~(c++)
+ * // Each camera gets its own stream
+ * PiiRandomGenerator generator(1234, iCameraIndex);
+ * PiiMatrix<float> matNoise(PiiMatrix<float>::uninitialized(1024, 1024));
+ * generator.fillNormal(matNoise, 0, 5, Pii::ParallelExecution());
+ * ~~~
+ *
+ * PiiRandomGenerator is not thread-safe. Use a separate generator
+ * (preferably with a different stream number) in each thread, or
+ * [threadInstance()].
+ */
+class PII_CORE_EXPORT PiiRandomGenerator
+{
+public:
+  /**
+   * Creates a new generator with the given *seed* and *stream*
+   * number. The position is set to zero.
+   */
+  PiiRandomGenerator(quint64 seed = 0, quint64 stream = 0);
+
+  /**
+   * Sets the seed and the stream number, and resets the position to
+   * zero.
+   */
+  void setSeed(quint64 seed, quint64 stream = 0);
+  quint64 seed() const;
+  quint64 stream() const;
+
+  /**
+   * Returns a generator that has the same seed but a different
+   * stream number.
+   */
+  PiiRandomGenerator substream(quint64 stream) const;
+
+  /**
+   * Moves the generator to *position*, which is the number of 32-bit
+   * words generated since the start of the stream.
+   */
+  void setPosition(quint64 position);
+  /**
+   * Returns the number of 32-bit words generated since the start of
+   * the stream. Each uniform `float` takes one word, and each
+   * uniform `double` two words. Pairs of normally distributed numbers
+   * take two words for `float` and four words for `double`.
+   */
+  quint64 position() const;
+  /**
+   * Skips *count* 32-bit words.
+   */
+  void discard(quint64 count);
+
+  /**
+   * Returns 32 uniformly distributed random bits.
+   */
+  quint32 next();
+
+  /**
+   * Returns a uniformly distributed random number in [0,1).
+   */
+  double uniform();
+  /**
+   * Returns a uniformly distributed random number in [*min*, *max*).
+   */
+  double uniform(double min, double max) { return min + (max - min) * uniform(); }
+  /**
+   * Returns a normally distributed random number with zero mean and
+   * unit variance.
+   */
+  double normal();
+
+  /**
+   * Fills *count* elements starting at *data* with uniformly
+   * distributed random numbers in [*min*, *max*).
+   */
+  void fillUniform(float* data, int count, float min = 0, float max = 1);
+  void fillUniform(double* data, int count, double min = 0, double max = 1);
+  /**
+   * Fills *count* elements starting at *data* with normally
+   * distributed random numbers. The numbers are generated in pairs;
+   * an odd *count* discards the last number of the last pair.
+   */
+  void fillNormal(float* data, int count, float mean = 0, float deviation = 1);
+  void fillNormal(double* data, int count, double mean = 0, double deviation = 1);
+
+  /**
+   * Fills *matrix* with uniformly distributed random numbers in
+   * [*min*, *max*). The elements are filled row by row, and the
+   * position of the generator is moved past all generated numbers.
+   */
+  void fillUniform(PiiMatrix<float>& matrix, float min = 0, float max = 1);
+  void fillUniform(PiiMatrix<double>& matrix, double min = 0, double max = 1);
+  /**
+   * Fills *matrix* with normally distributed random numbers.
+   */
+  void fillNormal(PiiMatrix<float>& matrix, float mean = 0, float deviation = 1);
+  void fillNormal(PiiMatrix<double>& matrix, double mean = 0, double deviation = 1);
+
+  /**
+   * Fills *matrix* in parallel. The result is exactly the same as
+   * with [fillUniform(PiiMatrix<float>&, float, float)].
+   */
+  void fillUniform(PiiMatrix<float>& matrix, float min, float max, const Pii::ParallelExecution& policy);
+  void fillUniform(PiiMatrix<double>& matrix, double min, double max, const Pii::ParallelExecution& policy);
+  void fillNormal(PiiMatrix<float>& matrix, float mean, float deviation, const Pii::ParallelExecution& policy);
+  void fillNormal(PiiMatrix<double>& matrix, double mean, double deviation, const Pii::ParallelExecution& policy);
+
+  /**
+   * Returns a generator that is private to the calling thread. Each
+   * thread gets a stream of its own. The streams are numbered in the
+   * order the threads first call this function, and the seed is
+   * given by [setThreadSeed()]. If threads are started in a fixed
+   * order, the numbers are reproducible.
+   *
+   * ! In builds without Qt and C++11 support, all threads share a
+   * single generator, which is not thread-safe. Create a generator
+   * for each thread instead.
+   */
+  static PiiRandomGenerator& threadInstance();
+  /**
+   * Sets the seed of the generators returned by [threadInstance()].
+   * Only affects threads that have not yet called [threadInstance()].
+   * The default seed is zero.
+   */
+  static void setThreadSeed(quint64 seed);
+
+  /// @hide
+  // Calculates a block of 128 random bits.
+  static void generateBlock(const quint32* key, quint64 counter, quint64 stream, quint32* result);
+  /// @endhide
+
+private:
+  template <class T, class Converter> struct BandFiller;
+
+  void generateWords(quint32* words, int count);
+  template <class T, class Converter> void fill(T* data, int count, Converter converter);
+  template <class T, class Converter>
+  void fillMatrix(PiiMatrix<T>& matrix, Converter converter, const Pii::ParallelExecution* policy);
+
+  quint32 _aKey[2];
+  quint64 _iStream;
+  quint64 _iPosition;
+  quint32 _aBlock[4];
+};
+
+#endif //_PIIRANDOMGENERATOR_H
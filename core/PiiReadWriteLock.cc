@@ -16,17 +16,40 @@
 #include "PiiReadWriteLock.h"
 
 #include <QThread>
+#include <new>
 
-// Note: Similarities to QReadWriteLock are not coincidental.
+namespace
+{
+  enum { MaxThreadEntries = 16 };
+
+  PiiAtomicInt iNextSlot;
+  PII_THREAD_LOCAL int iThreadSlot = -1;
+
+  // Threads are assigned to reader slots in round-robin order.
+  inline int slotIndex(int slotCount)
+  {
+    if (iThreadSlot < 0)
+      iThreadSlot = (iNextSlot++ & 0x7fffffff) % slotCount;
+    return iThreadSlot;
+  }
+}
 
 PiiReadWriteLock::Data::Data(bool recursive) :
-  currentWriter(0),
-  bRecursive(recursive),
-  iActiveReaders(0),
-  iActiveWriters(0),
-  iWaitingReaders(0),
-  iWaitingWriters(0)
-{}
+  slots(reinterpret_cast<Slot*>((quintptr(aSlotStorage) + CacheLineSize - 1) & ~quintptr(CacheLineSize - 1))),
+  bWriterActive(false),
+  bRecursive(recursive)
+{
+  static_assert(sizeof(Slot) == CacheLineSize, "A slot must fill a cache line.");
+  for (int i=0; i<SlotCount; ++i)
+    new (slots + i) Slot;
+}
+
+PiiReadWriteLock::Data::~Data()
+{
+  for (int i=0; i<SlotCount; ++i)
+    slots[i].~Slot();
+  qDeleteAll(hashOverflowEntries);
+}
 
 PiiReadWriteLock::PiiReadWriteLock() : d(new Data(false))
 {
@@ -41,117 +64,180 @@ PiiReadWriteLock::~PiiReadWriteLock()
   delete d;
 }
 
-void PiiReadWriteLock::lockForRead()
+PiiReadWriteLock::ThreadEntry* PiiReadWriteLock::threadEntries()
 {
-  QMutexLocker lock(&d->mutex);
+  // Read and write counts of the recursive locks the current thread
+  // holds.
+  static PII_THREAD_LOCAL ThreadEntry aEntries[MaxThreadEntries];
+  return aEntries;
+}
 
-  Qt::HANDLE self = 0;
-  // If the lock is recursive, must check if we currently hold it.
-  if (d->bRecursive)
-    {
-      self = QThread::currentThreadId();
+PiiReadWriteLock::ThreadEntry* PiiReadWriteLock::findEntry()
+{
+  ThreadEntry* pEntries = threadEntries();
+  for (int i=0; i<MaxThreadEntries; ++i)
+    if (pEntries[i].pLock == this)
+      return pEntries + i;
+  if (d->iOverflowEntries.load() == 0)
+    return 0;
+  QMutexLocker lock(&d->mutex);
+  return d->hashOverflowEntries.value(QThread::currentThreadId());
+}
 
-      ThreadHash::iterator it = d->hashCurrentReaders.find(self);
-      // Re-acquiring a read lock
-      if (it != d->hashCurrentReaders.end())
-        {
-          ++it.value();
-          ++d->iActiveReaders;
-          return;
-        }
-      // Using a write lock for reading
-      if (d->currentWriter == self)
-        {
-          d->hashCurrentReaders.insert(self, 1);
-          ++d->iActiveReaders;
-          return;
-        }
-    }
+PiiReadWriteLock::ThreadEntry* PiiReadWriteLock::createEntry()
+{
+  ThreadEntry* pEntries = threadEntries();
+  for (int i=0; i<MaxThreadEntries; ++i)
+    if (pEntries[i].pLock == 0)
+      {
+        pEntries[i].pLock = this;
+        pEntries[i].iReads = pEntries[i].iWrites = 0;
+        return pEntries + i;
+      }
+  // The thread holds too many locks at once.
+  ThreadEntry* pEntry = new ThreadEntry;
+  pEntry->pLock = this;
+  pEntry->iReads = pEntry->iWrites = 0;
+  QMutexLocker lock(&d->mutex);
+  d->hashOverflowEntries.insert(QThread::currentThreadId(), pEntry);
+  ++d->iOverflowEntries;
+  return pEntry;
+}
 
-  // Must wait for all writers to finish.
-  while (d->iActiveWriters > 0 || d->iWaitingWriters > 0)
+void PiiReadWriteLock::releaseEntry(ThreadEntry* entry)
+{
+  if (entry->iReads > 0 || entry->iWrites > 0)
+    return;
+  ThreadEntry* pEntries = threadEntries();
+  if (entry >= pEntries && entry < pEntries + MaxThreadEntries)
+    entry->pLock = 0;
+  else
     {
-      ++d->iWaitingReaders;
-      d->readerWait.wait(&d->mutex);
-      --d->iWaitingReaders;
+      QMutexLocker lock(&d->mutex);
+      d->hashOverflowEntries.remove(QThread::currentThreadId());
+      --d->iOverflowEntries;
+      delete entry;
     }
-  if (d->bRecursive)
-    d->hashCurrentReaders.insert(self, 1);
+}
 
-  ++d->iActiveReaders;
+int PiiReadWriteLock::readerCount() const
+{
+  int iCount = 0;
+  for (int i=0; i<SlotCount; ++i)
+    iCount += d->slots[i].iReaders.load();
+  return iCount;
 }
 
-void PiiReadWriteLock::lockForWrite()
+void PiiReadWriteLock::wakeWriters()
 {
   QMutexLocker lock(&d->mutex);
+  d->writerWait.wakeAll();
+}
 
-  Qt::HANDLE self = 0;
-  int iRemainingReaders = 0;
-  if (d->bRecursive)
+void PiiReadWriteLock::acquireRead(Slot& slot)
+{
+  for (;;)
     {
-      self = QThread::currentThreadId();
+      // The increment is a full barrier. Either we see the pending
+      // writer here or the writer sees our slot in readerCount().
+      ++slot.iReaders;
+      if (d->iPendingWriters.load() == 0)
+        return;
+
+      // A writer is waiting or active. Back off and let it finish.
+      --slot.iReaders;
+      QMutexLocker lock(&d->mutex);
+      d->writerWait.wakeAll();
+      while (d->iPendingWriters.load() != 0)
+        d->readerWait.wait(&d->mutex);
+    }
+}
 
-      // Recursive lock can be locked for writing again.
-      if (d->currentWriter == self)
+void PiiReadWriteLock::lockForRead()
+{
+  Slot& slot = d->slots[slotIndex(SlotCount)];
+  if (d->bRecursive)
+    {
+      ThreadEntry* pEntry = findEntry();
+      // Re-acquiring a read lock or using a write lock for reading.
+      // Writers cannot get in, so there is no need to check.
+      if (pEntry != 0)
         {
-          ++d->iActiveWriters;
+          ++slot.iReaders;
+          ++pEntry->iReads;
           return;
         }
-      // See if we currently hold a read lock.
-      ThreadHash::iterator it = d->hashCurrentReaders.find(self);
-      // Yes, we must leave one reader in the queue.
-      if (it != d->hashCurrentReaders.end())
-        iRemainingReaders = it.value();
+      acquireRead(slot);
+      createEntry()->iReads = 1;
     }
+  else
+    acquireRead(slot);
+}
 
-  while (d->iActiveWriters > 0 || d->iActiveReaders > iRemainingReaders)
+void PiiReadWriteLock::lockForWrite()
+{
+  ThreadEntry* pEntry = 0;
+  int iRemainingReaders = 0;
+  if (d->bRecursive)
     {
-      ++d->iWaitingWriters;
-      d->writerWait.wait(&d->mutex);
-      --d->iWaitingWriters;
+      pEntry = findEntry();
+      if (pEntry != 0)
+        {
+          // Recursive lock can be locked for writing again.
+          if (pEntry->iWrites > 0)
+            {
+              ++pEntry->iWrites;
+              return;
+            }
+          // We currently hold a read lock and must leave our readers
+          // in the count.
+          iRemainingReaders = pEntry->iReads;
+        }
     }
 
-  d->currentWriter = self;
-  ++d->iActiveWriters;
+  QMutexLocker lock(&d->mutex);
+  ++d->iPendingWriters;
+  while (d->bWriterActive || readerCount() > iRemainingReaders)
+    d->writerWait.wait(&d->mutex);
+  d->bWriterActive = true;
+  lock.unlock();
+
+  if (d->bRecursive)
+    (pEntry != 0 ? pEntry : createEntry())->iWrites = 1;
 }
 
 void PiiReadWriteLock::unlockRead()
 {
-  QMutexLocker lock(&d->mutex);
-
-  Q_ASSERT(d->iActiveReaders > 0);
-
   if (d->bRecursive)
     {
-      Qt::HANDLE self = QThread::currentThreadId();
-      ThreadHash::iterator it = d->hashCurrentReaders.find(self);
-      if (it != d->hashCurrentReaders.end() &&
-          --it.value() <= 0)
-        d->hashCurrentReaders.erase(it);
+      ThreadEntry* pEntry = findEntry();
+      Q_ASSERT(pEntry != 0 && pEntry->iReads > 0);
+      --pEntry->iReads;
+      releaseEntry(pEntry);
     }
 
-  if (--d->iActiveReaders == 0 && d->iActiveWriters == 0)
-    wakeUp();
+  --d->slots[slotIndex(SlotCount)].iReaders;
+  // A writer may be waiting for us.
+  if (d->iPendingWriters.load() != 0)
+    wakeWriters();
 }
 
 void PiiReadWriteLock::unlockWrite()
 {
-  QMutexLocker lock(&d->mutex);
-
-  Q_ASSERT(d->iActiveWriters > 0);
-
-  if (--d->iActiveWriters == 0)
+  if (d->bRecursive)
     {
-      d->currentWriter = 0;
-      if (d->iActiveReaders == 0)
-        wakeUp();
+      ThreadEntry* pEntry = findEntry();
+      Q_ASSERT(pEntry != 0 && pEntry->iWrites > 0);
+      if (--pEntry->iWrites > 0)
+        return;
+      releaseEntry(pEntry);
     }
-}
 
-void PiiReadWriteLock::wakeUp()
-{
-  if (d->iWaitingWriters)
-    d->writerWait.wakeOne();
-  else if (d->iWaitingReaders)
+  QMutexLocker lock(&d->mutex);
+  Q_ASSERT(d->bWriterActive);
+  d->bWriterActive = false;
+  if (--d->iPendingWriters == 0)
     d->readerWait.wakeAll();
+  else
+    d->writerWait.wakeAll();
 }
@@ -17,9 +17,11 @@
 #define _PIIREADWRITELOCK_H
 
 #include "PiiGlobal.h"
+#include "PiiAtomicInt.h"
 
 #include <QMutex>
 #include <QWaitCondition>
+#include <QHash>
 
 /**
  * A read-write lock. This class provides functionality similar to
@@ -31,6 +33,14 @@
  * Note that there is no unlock() function. Instead, a read lock must
  * be released with unlockRead() and a write lock with unlockWrite().
  *
+ * The lock is optimized for frequent reads and rare writes. Readers
+ * are counted in a number of cache-line-sized slots, and each thread
+ * always uses the same slot. Acquiring and releasing a read lock
+ * while there are no writers takes one atomic operation on the
+ * thread's slot and does not touch memory shared by all readers.
+ * Writers are preferred: once a writer is waiting, new readers block
+ * until it has finished. A thread that already holds the lock can
+ * always re-acquire it (if the lock is recursive).
  */
 class PII_CORE_EXPORT PiiReadWriteLock
 {
@@ -47,21 +57,54 @@ public:
   void unlockWrite();
 
 private:
-  typedef QHash<Qt::HANDLE, int> ThreadHash;
+  enum { SlotCount = 16, CacheLineSize = 64 };
+
+  /// @internal
+  struct Slot
+  {
+    PiiAtomicInt iReaders;
+    char padding[CacheLineSize - sizeof(PiiAtomicInt)];
+  };
+
+  /// @internal
+  struct ThreadEntry
+  {
+    const PiiReadWriteLock* pLock;
+    int iReads, iWrites;
+  };
+
+  typedef QHash<Qt::HANDLE, ThreadEntry*> ThreadHash;
   class Data
   {
   public:
     Data (bool recursive);
-
+    ~Data();
+
+    // Storage for the slots. The heap doesn't guarantee 64-byte
+    // alignment, so the slots start at the first cache line boundary
+    // in the buffer.
+    char aSlotStorage[(SlotCount + 1) * CacheLineSize];
+    Slot* slots;
+    // The number of writers that are waiting or active. Readers
+    // check this after incrementing their slot.
+    PiiAtomicInt iPendingWriters;
+    // The number of thread entries in hashOverflowEntries.
+    PiiAtomicInt iOverflowEntries;
     QMutex mutex;
     QWaitCondition readerWait, writerWait;
-    ThreadHash hashCurrentReaders;
-    Qt::HANDLE currentWriter;
+    bool bWriterActive;
     bool bRecursive;
-    int iActiveReaders, iActiveWriters, iWaitingReaders, iWaitingWriters;
+    // Holds the entries of threads whose thread-local table is full.
+    ThreadHash hashOverflowEntries;
   } *d;
 
-  inline void wakeUp();
+  int readerCount() const;
+  void acquireRead(Slot& slot);
+  void wakeWriters();
+  static ThreadEntry* threadEntries();
+  ThreadEntry* findEntry();
+  ThreadEntry* createEntry();
+  void releaseEntry(ThreadEntry* entry);
 
   PII_DISABLE_COPY(PiiReadWriteLock);
 };
@@ -15,6 +15,9 @@
 
 #include "PiiResourceDatabase.h"
 
+#include <algorithm>
+#include <vector>
+
 namespace Pii
 {
   Subject subject;
@@ -85,6 +88,7 @@ int PiiResourceDatabase::addStatement(const PiiResourceStatement& statement)
   PiiResourceStatement copy(statement);
   int id = generateId();
   copy.setId(id);
+  d->index.add(copy, d->lstStatements.size());
   d->lstStatements.push_back(copy);
   return id;
 }
@@ -116,20 +120,45 @@ QList<int> PiiResourceDatabase::addStatements(const QList<PiiResourceStatement>&
 
 void PiiResourceDatabase::removeStatements(const QList<int>& ids)
 {
-  for (int i=0; i<ids.size(); ++i)
-    removeStatement(ids[i]);
+  // A sorted array instead of QSet keeps this usable without Qt.
+  std::vector<int> vecIds(ids.begin(), ids.end());
+  std::sort(vecIds.begin(), vecIds.end());
+  QList<PiiResourceStatement> lstRemaining;
+  for (int i=0; i<d->lstStatements.size(); ++i)
+    if (!std::binary_search(vecIds.begin(), vecIds.end(), d->lstStatements[i].id()))
+      lstRemaining.push_back(d->lstStatements[i]);
+  if (lstRemaining.size() != d->lstStatements.size())
+    {
+      d->lstStatements = lstRemaining;
+      // Statement positions changed.
+      rebuildIndex();
+    }
 }
 
 void PiiResourceDatabase::removeStatement(int id)
 {
+  removeStatements(QList<int>() << id);
+}
+
+void PiiResourceDatabase::rebuildIndex()
+{
+  d->index.clear();
   for (int i=0; i<d->lstStatements.size(); ++i)
-    {
-      if (d->lstStatements[i].id() == id)
-        {
-          d->lstStatements.removeAt(i);
-          return;
-        }
-    }
+    d->index.add(d->lstStatements[i], i);
+}
+
+void PiiResourceDatabase::Index::add(const PiiResourceStatement& statement, int position)
+{
+  mapSubjects[statement.subject()].push_back(position);
+  mapPredicates[statement.predicate()].push_back(position);
+  mapObjects[statement.object()].push_back(position);
+}
+
+void PiiResourceDatabase::Index::clear()
+{
+  mapSubjects.clear();
+  mapPredicates.clear();
+  mapObjects.clear();
 }
 
 QList<PiiResourceStatement> PiiResourceDatabase::statements() const
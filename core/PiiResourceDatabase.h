@@ -24,6 +24,11 @@
 #endif
 
 #include <QStringList>
+#ifndef PII_NO_QT
+#  include <QHash>
+#else
+#  include <QMap>
+#endif
 
 #include <functional>
 
@@ -264,14 +269,69 @@ public:
    */
   void dump() const;
 
+  /// @internal
+  class PII_CORE_EXPORT Index
+  {
+  public:
+#ifndef PII_NO_QT
+    typedef QHash<QString,QList<int> > Map;
+#else
+    // The standard library wrapper cannot hash QString.
+    typedef QMap<QString,QList<int> > Map;
+#endif
+
+    const QList<int>* subjects(const QString& subject) const { return find(mapSubjects, subject); }
+    const QList<int>* predicates(const QString& predicate) const { return find(mapPredicates, predicate); }
+    const QList<int>* objects(const QString& object) const { return find(mapObjects, object); }
+
+    // Returns the shorter one of two candidate lists. Null means
+    // that all statements are candidates.
+    static const QList<int>* intersect(const QList<int>* lst1, const QList<int>* lst2)
+    {
+      if (lst1 == 0) return lst2;
+      if (lst2 == 0) return lst1;
+      return lst1->size() <= lst2->size() ? lst1 : lst2;
+    }
+
+    // Candidates for an AND filter.
+    static const QList<int>* combine(const std::logical_and<bool>&, const QList<int>* lst1, const QList<int>* lst2)
+    {
+      return intersect(lst1, lst2);
+    }
+    // Any other filter must inspect all statements.
+    template <class BinaryPredicate>
+    static const QList<int>* combine(const BinaryPredicate&, const QList<int>*, const QList<int>*)
+    {
+      return 0;
+    }
+
+    void add(const PiiResourceStatement& statement, int position);
+    void clear();
+
+  private:
+    const QList<int>* find(const Map& map, const QString& key) const
+    {
+      Map::const_iterator i = map.find(key);
+      return i != map.end() ? &PII_ITERATOR_VALUE(i) : &lstEmpty;
+    }
+
+    Map mapSubjects, mapPredicates, mapObjects;
+    QList<int> lstEmpty;
+  };
+
 private:
   class Data
   {
   public:
     QList<PiiResourceStatement> lstStatements;
+    // Positions of statements in lstStatements, indexed by subject,
+    // predicate and object.
+    Index index;
   } *d;
 
   int generateId();
+  void rebuildIndex();
+  template <class Filter> const QList<int>* candidates(const Filter& filter) const;
 
   PII_DISABLE_COPY(PiiResourceDatabase);
 };
@@ -279,9 +339,15 @@ private:
 template <class Filter> QList<PiiResourceStatement> PiiResourceDatabase::select(Filter filter) const
 {
   QList<PiiResourceStatement> lstResult;
-  for (int i=0; i<d->lstStatements.size(); ++i)
-    if (filter(d->lstStatements[i]))
-      lstResult.push_back(d->lstStatements[i]);
+  // Only statements listed in the index can match the filter.
+  const QList<int>* pCandidates = candidates(filter);
+  const int iCount = pCandidates != 0 ? pCandidates->size() : d->lstStatements.size();
+  for (int i=0; i<iCount; ++i)
+    {
+      const PiiResourceStatement& statement = d->lstStatements[pCandidates != 0 ? (*pCandidates)[i] : i];
+      if (filter(statement))
+        lstResult.push_back(statement);
+    }
   return lstResult;
 }
 
@@ -290,21 +356,31 @@ QList<typename Selector::ValueType> PiiResourceDatabase::select(Selector selecto
 {
   typedef typename Selector::ValueType ValueType;
   QList<ValueType> lstResult;
-  for (int i=0; i<d->lstStatements.size(); ++i)
-    if (filter(d->lstStatements[i]))
-      {
-        ValueType selected = selector(d->lstStatements[i]);
-        if (!lstResult.contains(selected))
-          lstResult.push_back(selected);
-      }
+  const QList<int>* pCandidates = candidates(filter);
+  const int iCount = pCandidates != 0 ? pCandidates->size() : d->lstStatements.size();
+  for (int i=0; i<iCount; ++i)
+    {
+      const PiiResourceStatement& statement = d->lstStatements[pCandidates != 0 ? (*pCandidates)[i] : i];
+      if (filter(statement))
+        {
+          ValueType selected = selector(statement);
+          if (!lstResult.contains(selected))
+            lstResult.push_back(selected);
+        }
+    }
   return lstResult;
 }
 
 template <class Filter> int PiiResourceDatabase::findFirst(Filter filter) const
 {
-  for (int i=0; i<d->lstStatements.size(); ++i)
-    if (filter(d->lstStatements[i]))
-      return d->lstStatements[i].id();
+  const QList<int>* pCandidates = candidates(filter);
+  const int iCount = pCandidates != 0 ? pCandidates->size() : d->lstStatements.size();
+  for (int i=0; i<iCount; ++i)
+    {
+      const PiiResourceStatement& statement = d->lstStatements[pCandidates != 0 ? (*pCandidates)[i] : i];
+      if (filter(statement))
+        return statement.id();
+    }
   return -1;
 }
 
@@ -324,8 +400,22 @@ namespace Pii
     const Filter* self() const { return static_cast<const Filter*>(this); }
 
     inline NotFilter<Filter> operator! () const;
+
+    // Returns the positions of the statements that may match the
+    // filter, or 0 if all statements need to be inspected.
+    const QList<int>* candidates(const PiiResourceDatabase::Index&) const { return 0; }
   };
 
+  // Returns the index candidates of a filter. Filters that are not
+  // derived from ResourceFilterBase cannot use the index.
+  template <class Filter>
+  inline const QList<int>* resourceCandidates(const ResourceFilterBase<Filter>* filter,
+                                              const PiiResourceDatabase::Index& index)
+  {
+    return filter->self()->candidates(index);
+  }
+  inline const QList<int>* resourceCandidates(const void*, const PiiResourceDatabase::Index&) { return 0; }
+
   // A function object that composes the results of two other filters
   // using a logical operator (BinaryPredicate).
   template <class BinaryPredicate, class Filter1, class Filter2>
@@ -340,6 +430,13 @@ namespace Pii
       return predicate(filter1(statement), filter2(statement));
     }
 
+    const QList<int>* candidates(const PiiResourceDatabase::Index& index) const
+    {
+      return PiiResourceDatabase::Index::combine(predicate,
+                                                 resourceCandidates(&filter1, index),
+                                                 resourceCandidates(&filter2, index));
+    }
+
     const BinaryPredicate& predicate;
     const Filter1& filter1;
     const Filter2& filter2;
@@ -401,6 +498,11 @@ namespace Pii
       return compare(select(statement), value) && select;
     }
 
+    const QList<int>* candidates(const PiiResourceDatabase::Index& index) const
+    {
+      return select.candidates(index, compare, value);
+    }
+
     const Selector& select;
     const BinaryPredicate& compare;
     ValueType value;
@@ -487,21 +589,51 @@ namespace Pii
     // Check if the selector is valid after selecting a statement.
     // Default selector is always valid.
     operator bool () const { return true; }
+
+    // Returns the index candidates for statements whose selected
+    // field compares to value. Only equality comparisons of indexed
+    // fields are supported (see Subject, Predicate, Object).
+    template <class BinaryPredicate>
+    const QList<int>* candidates(const PiiResourceDatabase::Index&, const BinaryPredicate&, ConstReferenceType) const
+    {
+      return 0;
+    }
   };
 
   struct Subject : SelectorBase<Subject, QString>
   {
     QString operator() (const PiiResourceStatement& statement) const { return statement.subject(); }
+
+    using SelectorBase<Subject, QString>::candidates;
+    const QList<int>* candidates(const PiiResourceDatabase::Index& index,
+                                 const std::equal_to<QString>&, const QString& value) const
+    {
+      return index.subjects(value);
+    }
   };
 
   struct Predicate : SelectorBase<Predicate, QString>
   {
     QString operator() (const PiiResourceStatement& statement) const { return statement.predicate(); }
+
+    using SelectorBase<Predicate, QString>::candidates;
+    const QList<int>* candidates(const PiiResourceDatabase::Index& index,
+                                 const std::equal_to<QString>&, const QString& value) const
+    {
+      return index.predicates(value);
+    }
   };
 
   struct Object : SelectorBase<Object, QString>
   {
     QString operator() (const PiiResourceStatement& statement) const { return statement.object(); }
+
+    using SelectorBase<Object, QString>::candidates;
+    const QList<int>* candidates(const PiiResourceDatabase::Index& index,
+                                 const std::equal_to<QString>&, const QString& value) const
+    {
+      return index.objects(value);
+    }
   };
 
   template <class T> struct ObjectPtr : SelectorBase<ObjectPtr<T>, T*>
@@ -530,6 +662,13 @@ namespace Pii
     }
     operator bool () const { return bOk; }
 
+    using SelectorBase<Attribute, QString>::candidates;
+    const QList<int>* candidates(const PiiResourceDatabase::Index& index,
+                                 const std::equal_to<QString>&, const QString& value) const
+    {
+      return PiiResourceDatabase::Index::intersect(index.predicates(strPredicate), index.objects(value));
+    }
+
     const QString& strPredicate;
     mutable bool bOk;
   };
@@ -612,4 +751,9 @@ namespace Pii
 }
 /// @endhide
 
+template <class Filter> const QList<int>* PiiResourceDatabase::candidates(const Filter& filter) const
+{
+  return Pii::resourceCandidates(&filter, d->index);
+}
+
 #endif //_PIIRESOURCEDATABASE_H
@@ -0,0 +1,279 @@
+/* This file is part of Into.
+ * Copyright (C) Intopii 2013.
+ * All rights reserved.
+ *
+ * Licensees holding a commercial Into license may use this file in
+ * accordance with the commercial license agreement. Please see
+ * LICENSE.commercial for commercial licensing terms.
+ *
+ * Alternatively, this file may be used under the terms of the GNU
+ * Affero General Public License version 3 as published by the Free
+ * Software Foundation. In addition, Intopii gives you special rights
+ * to use Into as a part of open source software projects. Please
+ * refer to LICENSE.AGPL3 for details.
+ */
+
+#ifndef _PIISATURATINGARITHMETIC_H
+#define _PIISATURATINGARITHMETIC_H
+
+#include "PiiMatrix.h"
+#include "PiiMathDefs.h"
+#include "PiiFunctional.h"
+#include "PiiFixedPoint.h"
+
+#include <functional>
+
+namespace Pii
+{
+  /**
+   * @group saturation Saturating integer arithmetic
+   *
+   * Element-wise arithmetic for 8 and 16 bit integer matrices that
+   * clamps results to the range of the type instead of wrapping
+   * around. Intermediate results are calculated as `int`, or as
+   * `qint64` for products and shifts, without branches. Modern
+   * compilers map the loops over matrix rows to packed integer
+   * instructions that process 8 or 16 elements at a time, which keeps
+   * image pipelines in integer arithmetic.
+   *
+   * ~~~(c++)
+   * PiiMatrix<unsigned char> matA(...), matB(...);
+   * // 250 + 10 = 255
+   * PiiMatrix<unsigned char> matSum(Pii::saturatingSum(matA, matB));
+   * // 0.75 * matA + 0.25 * matB
+   * PiiMatrix<unsigned char> matBlend(Pii::fixedPointBlend(matA, matB, 0.75));
+   * ~~~
+   */
+
+  /**
+   * A type trait whose `boolValue` is `true` for the types the
+   * saturating functions accept: `char`, `unsigned char`, `short`
+   * and `unsigned short`.
+   */
+  template <class T> struct IsSaturable : False {};
+  template <> struct IsSaturable<char> : True {};
+  template <> struct IsSaturable<unsigned char> : True {};
+  template <> struct IsSaturable<short> : True {};
+  template <> struct IsSaturable<unsigned short> : True {};
+
+  /**
+   * Clamps *value* to the range of `T`.
+   */
+  template <class T> inline T saturate(int value)
+  {
+    const int iMin = Numeric<T>::minValue(), iMax = Numeric<T>::maxValue();
+    return T(value < iMin ? iMin : value > iMax ? iMax : value);
+  }
+
+  /**
+   * Clamps a 64-bit *value* to the range of `T`.
+   */
+  template <class T> inline T saturate(qint64 value)
+  {
+    const qint64 iMin = Numeric<T>::minValue(), iMax = Numeric<T>::maxValue();
+    return T(value < iMin ? iMin : value > iMax ? iMax : value);
+  }
+
+  /**
+   * An adaptable binary function that adds its arguments with
+   * saturation.
+   */
+  template <class T> struct SaturatingPlus : public BinaryFunction<T>
+  {
+    T operator() (T a, T b) const { return saturate<T>(int(a) + int(b)); }
+  };
+
+  /**
+   * An adaptable binary function that subtracts its second argument
+   * from the first one with saturation.
+   */
+  template <class T> struct SaturatingMinus : public BinaryFunction<T>
+  {
+    T operator() (T a, T b) const { return saturate<T>(int(a) - int(b)); }
+  };
+
+  /**
+   * An adaptable binary function that multiplies its arguments with
+   * saturation.
+   */
+  template <class T> struct SaturatingMultiplies : public BinaryFunction<T>
+  {
+    // The product of two unsigned shorts doesn't fit into an int.
+    T operator() (T a, T b) const { return saturate<T>(qint64(a) * qint64(b)); }
+  };
+
+  /**
+   * An adaptable binary function that shifts its first argument
+   * *bits* bits to the left with saturation. *bits* must not be
+   * negative.
+   */
+  template <class T> struct SaturatingShiftLeft : public BinaryFunction<T,int>
+  {
+    // Any non-zero value saturates after 16 bits, so limiting the
+    // shift to 32 bits doesn't change the result.
+    T operator() (T value, int bits) const
+    {
+      return saturate<T>(qint64(value) * (qint64(1) << (bits < 32 ? bits : 32)));
+    }
+  };
+
+  /**
+   * An adaptable unary function that calculates \(ax + b\) in fixed
+   * point and rounds the result to the nearest integer with
+   * saturation. The multiplier and the offset are given as raw
+   * fixed-point values with *decimals* fractional bits. The caller
+   * must ensure that the result does not overflow an `int` before
+   * the shift.
+   */
+  template <class T> struct FixedPointAffine : public UnaryFunction<T>
+  {
+    FixedPointAffine(int multiplier, int offset, int decimals) :
+      iMultiplier(multiplier),
+      iOffset(offset + (decimals > 0 ? 1 << (decimals-1) : 0)),
+      iDecimals(decimals)
+    {}
+
+    T operator() (T value) const { return saturate<T>((int(value) * iMultiplier + iOffset) >> iDecimals); }
+
+    int iMultiplier, iOffset, iDecimals;
+  };
+
+  /**
+   * An adaptable binary function that calculates \(wa + (1-w)b\)
+   * with eight fractional bits in the weight *w*.
+   */
+  template <class T> struct FixedPointBlend : public BinaryFunction<T>
+  {
+    FixedPointBlend(int weight) : iWeight(weight), iComplement(256 - weight) {}
+
+    T operator() (T a, T b) const { return T((int(a) * iWeight + int(b) * iComplement + 128) >> 8); }
+
+    int iWeight, iComplement;
+  };
+
+  /**
+   * Returns the element-wise sum of *mat1* and *mat2* with saturation.
+   *
+   * @exception PiiInvalidArgumentException& if the matrices are not
+   * equal in size.
+   */
+  template <class Matrix1, class Matrix2>
+  inline PiiBinaryMatrixTransform<Matrix1, Matrix2, SaturatingPlus<typename Matrix1::value_type> >
+  saturatingSum(const PiiConceptualMatrix<Matrix1>& mat1, const PiiConceptualMatrix<Matrix2>& mat2)
+  {
+    PII_MATRIX_CHECK_EQUAL_SIZE(mat1, mat2);
+    return binaryMatrixTransform(mat1.selfRef(), mat2.selfRef(), SaturatingPlus<typename Matrix1::value_type>());
+  }
+
+  /**
+   * Adds *value* to each element of *mat* with saturation.
+   */
+  template <class Matrix>
+  inline PiiUnaryMatrixTransform<Matrix, std::binder2nd<SaturatingPlus<typename Matrix::value_type> > >
+  saturatingSum(const PiiConceptualMatrix<Matrix>& mat, typename Matrix::value_type value)
+  {
+    return unaryMatrixTransform(mat.selfRef(), std::bind2nd(SaturatingPlus<typename Matrix::value_type>(), value));
+  }
+
+  /**
+   * Returns the element-wise difference of *mat1* and *mat2* with
+   * saturation.
+   *
+   * @exception PiiInvalidArgumentException& if the matrices are not
+   * equal in size.
+   */
+  template <class Matrix1, class Matrix2>
+  inline PiiBinaryMatrixTransform<Matrix1, Matrix2, SaturatingMinus<typename Matrix1::value_type> >
+  saturatingDifference(const PiiConceptualMatrix<Matrix1>& mat1, const PiiConceptualMatrix<Matrix2>& mat2)
+  {
+    PII_MATRIX_CHECK_EQUAL_SIZE(mat1, mat2);
+    return binaryMatrixTransform(mat1.selfRef(), mat2.selfRef(), SaturatingMinus<typename Matrix1::value_type>());
+  }
+
+  /**
+   * Subtracts *value* from each element of *mat* with saturation.
+   */
+  template <class Matrix>
+  inline PiiUnaryMatrixTransform<Matrix, std::binder2nd<SaturatingMinus<typename Matrix::value_type> > >
+  saturatingDifference(const PiiConceptualMatrix<Matrix>& mat, typename Matrix::value_type value)
+  {
+    return unaryMatrixTransform(mat.selfRef(), std::bind2nd(SaturatingMinus<typename Matrix::value_type>(), value));
+  }
+
+  /**
+   * Returns the element-wise product of *mat1* and *mat2* with
+   * saturation.
+   *
+   * @exception PiiInvalidArgumentException& if the matrices are not
+   * equal in size.
+   */
+  template <class Matrix1, class Matrix2>
+  inline PiiBinaryMatrixTransform<Matrix1, Matrix2, SaturatingMultiplies<typename Matrix1::value_type> >
+  saturatingProduct(const PiiConceptualMatrix<Matrix1>& mat1, const PiiConceptualMatrix<Matrix2>& mat2)
+  {
+    PII_MATRIX_CHECK_EQUAL_SIZE(mat1, mat2);
+    return binaryMatrixTransform(mat1.selfRef(), mat2.selfRef(), SaturatingMultiplies<typename Matrix1::value_type>());
+  }
+
+  /**
+   * Multiplies each element of *mat* by *value* with saturation.
+   */
+  template <class Matrix>
+  inline PiiUnaryMatrixTransform<Matrix, std::binder2nd<SaturatingMultiplies<typename Matrix::value_type> > >
+  saturatingProduct(const PiiConceptualMatrix<Matrix>& mat, typename Matrix::value_type value)
+  {
+    return unaryMatrixTransform(mat.selfRef(), std::bind2nd(SaturatingMultiplies<typename Matrix::value_type>(), value));
+  }
+
+  /**
+   * Shifts each element of *mat* *bits* bits to the left with
+   * saturation.
+   */
+  template <class Matrix>
+  inline PiiUnaryMatrixTransform<Matrix, std::binder2nd<SaturatingShiftLeft<typename Matrix::value_type> > >
+  saturatingShiftLeft(const PiiConceptualMatrix<Matrix>& mat, int bits)
+  {
+    return unaryMatrixTransform(mat.selfRef(), std::bind2nd(SaturatingShiftLeft<typename Matrix::value_type>(), bits));
+  }
+
+  /**
+   * Calculates *scale* * x + *offset* for each element x of *mat*
+   * in fixed point, rounds the result to the nearest integer and
+   * saturates it to the range of the element type.
+   *
+   * ~~~(c++)
+   * typedef PiiFixedPoint<12> Fixed;
+   * PiiMatrix<unsigned char> matBrighter(Pii::fixedPointScale(image, Fixed(1.2), Fixed(-10.0)));
+   * ~~~
+   */
+  template <class Matrix, int decimals>
+  inline PiiUnaryMatrixTransform<Matrix, FixedPointAffine<typename Matrix::value_type> >
+  fixedPointScale(const PiiConceptualMatrix<Matrix>& mat,
+                  PiiFixedPoint<decimals> scale,
+                  PiiFixedPoint<decimals> offset = PiiFixedPoint<decimals>())
+  {
+    return unaryMatrixTransform(mat.selfRef(),
+                                FixedPointAffine<typename Matrix::value_type>(scale.rawValue(),
+                                                                              offset.rawValue(),
+                                                                              decimals));
+  }
+
+  /**
+   * Returns *weight* * *mat1* + (1 - *weight*) * *mat2*. The weight
+   * must be in [0,1] and is rounded to eight fractional bits.
+   *
+   * @exception PiiInvalidArgumentException& if the matrices are not
+   * equal in size.
+   */
+  template <class Matrix1, class Matrix2>
+  inline PiiBinaryMatrixTransform<Matrix1, Matrix2, FixedPointBlend<typename Matrix1::value_type> >
+  fixedPointBlend(const PiiConceptualMatrix<Matrix1>& mat1, const PiiConceptualMatrix<Matrix2>& mat2,
+                  PiiFixedPoint<8> weight)
+  {
+    PII_MATRIX_CHECK_EQUAL_SIZE(mat1, mat2);
+    return binaryMatrixTransform(mat1.selfRef(), mat2.selfRef(),
+                                 FixedPointBlend<typename Matrix1::value_type>(weight.rawValue()));
+  }
+}
+
+#endif //_PIISATURATINGARITHMETIC_H
@@ -15,7 +15,10 @@
 
 #include "PiiSimpleMemoryManager.h"
 #include <PiiBits.h>
-#include <QMutexLocker>
+#include <PiiAtomicInt.h>
+#ifndef PII_NO_QT
+#  include <QThreadStorage>
+#endif
 #include <cstdlib>
 
 /* Memory arrangement
@@ -24,77 +27,222 @@
  *   |
  *   v
  * +-+-------+-+-------+-+-------+-+ ... +-------+-+
- * | | block |p| block |p| block |p|     | block |p|
+ * | | block |n| block |n| block |n|     | block |n|
  * +-+-------+-+-------+-+-------+-+ ... +-------+-+
  *            |^        |^        |      ^
  *            ||        ||        |      |
  *            ++        ++        +------+
  *
- * Each memory block is followed by a void* that points to the
- * beginning of the next free memory block. Each memory block is
- * aligned at a 16-byte boundary. In the beginning, empty space may be
- * left for proper alignment. The head pointer always points to the
- * first free memory block.
+ * Each memory block is followed by a void*-sized slot that holds the
+ * number of the next free block. Blocks are numbered starting at
+ * one; zero terminates the list. Each memory block is aligned at a
+ * 16-byte boundary. In the beginning, empty space may be left for
+ * proper alignment. The head always refers to the first free memory
+ * block.
+ *
+ * The head is an atomic integer whose low bits store the number of
+ * the first free block and high bits a tag that is incremented on
+ * each modification. The tag makes compare-and-swap fail if the head
+ * was popped and pushed back by another thread in between (the ABA
+ * problem). Since the blocks are never returned to the system while
+ * the manager exists, reading the link of a block that was just
+ * taken by another thread is harmless: the result will be discarded
+ * because the tag has changed.
  */
 
-#define PII_NEXT_POINTER(buffer) \
-  reinterpret_cast<void**>(static_cast<char*>(buffer) + stBlockSize)
-
 class PiiSimpleMemoryManager::Data
 {
 public:
-  Data(void* memory, bool own, std::size_t memorySize, std::size_t blockSize) :
+  // Free blocks owned by a single thread.
+  struct Cache
+  {
+    Cache(Data* data) : d(data), uiHead(0), uiTail(0), iCount(0) {}
+    // Returns the blocks to the shared stack when the thread exits.
+    ~Cache() { if (iCount > 0) d->pushBlocks(uiHead, uiTail); }
+
+    Data* d;
+    unsigned int uiHead, uiTail;
+    int iCount;
+  };
+
+  Data(void* memory, bool own, std::size_t memorySize, std::size_t blockSize, int cacheSize) :
     // Align blocks to 16-byte boundaries
-    stBlockSize(Pii::alignAddress(blockSize + sizeof(void*), 0xf)),
+    stFullBlockSize(Pii::alignAddress(blockSize + sizeof(void*), 0xf)),
+    // This is the number of bytes available to the user
+    stBlockSize(stFullBlockSize - sizeof(void*)),
     bOwn(own),
     pMemory(memory),
-    pHead(0) // Initialize the manager as fully allocated
+    iHead(0), // Initialize the manager as fully allocated
+    uiIndexBits(1),
+#ifndef PII_NO_QT
+    iCacheSize(qMax(cacheSize, 0)),
+#else
+    iCacheSize(0),
+#endif
+    iBatchSize(qMax(iCacheSize/2, 1))
   {
+    Q_UNUSED(cacheSize);
     // Align first block
-    std::size_t stStartAddress = reinterpret_cast<std::size_t>(Pii::alignAddress(pMemory, 0xf));
+    pFirstBlock = static_cast<char*>(Pii::alignAddress(pMemory, 0xf));
     // Bytes available after alignment
-    std::size_t stBytesAvailable = reinterpret_cast<std::size_t>(pMemory) + memorySize - stStartAddress;
-    // Total number of blocks
-    ulBlockCount = ulong(stBytesAvailable/stBlockSize);
-    // Start of last block
-    pLastAddress = reinterpret_cast<void*>(stStartAddress + (ulBlockCount-1) * stBlockSize);
+    std::size_t stBytesAvailable = memory != 0 && memorySize >= std::size_t(pFirstBlock - static_cast<char*>(pMemory)) ?
+      memorySize - std::size_t(pFirstBlock - static_cast<char*>(pMemory)) : 0;
+    // Total number of blocks. The rest of the head is needed for the tag.
+    ulBlockCount = qMin(ulong(stBytesAvailable/stFullBlockSize), ulong(MaxBlockCount));
+    stRangeSize = ulBlockCount * stFullBlockSize;
+    while ((1ul << uiIndexBits) <= ulBlockCount)
+      ++uiIndexBits;
+    uiIndexMask = (1u << uiIndexBits) - 1;
 
-    std::size_t stFullBlockSize = stBlockSize;
-    // This is the number of bytes available to the user
-    stBlockSize -= sizeof(void*);
-
-    // Optimization...
-    stLastAddress = std::size_t(pLastAddress) - std::size_t(pMemory);
-
-    // Since head is now zero, the buffer is full. We need to release
-    // all memory blocks.
-    char* pBuffer = static_cast<char*>(pLastAddress);
-    for (ulong i=0; i<ulBlockCount; ++i, pBuffer -= stFullBlockSize)
-      deallocate(pBuffer);
+    // Since head is now zero, the buffer is full. We need to link all
+    // blocks to the list of free blocks.
+    if (ulBlockCount > 0)
+      {
+        for (unsigned int i=1; i<unsigned(ulBlockCount); ++i)
+          setNext(i, i+1);
+        setNext(unsigned(ulBlockCount), 0);
+        iHead = 1;
+      }
   }
 
   ~Data()
   {
+#ifndef PII_NO_QT
+    // Flush the calling thread's cache while we still exist. Caches
+    // of other threads are abandoned.
+    if (caches.hasLocalData())
+      caches.setLocalData(0);
+#endif
     if (bOwn) std::free(pMemory);
   }
 
-  void* allocate(std::size_t bytes);
-  bool deallocate(void* ptr);
+  enum { MaxBlockCount = (1 << 24) - 1 };
 
-  std::size_t stBlockSize;
+  char* block(unsigned int index) const { return pFirstBlock + std::size_t(index-1) * stFullBlockSize; }
+  volatile int* link(unsigned int index) const
+  {
+    return reinterpret_cast<volatile int*>(block(index) + stBlockSize);
+  }
+  unsigned int next(unsigned int index) const { return unsigned(*link(index)); }
+  void setNext(unsigned int index, unsigned int next) { *link(index) = int(next); }
+  // Returns the block number of buffer, or zero if buffer is not
+  // managed by us.
+  unsigned int indexOf(void* buffer) const
+  {
+    std::size_t stOffset = std::size_t(buffer) - std::size_t(pFirstBlock);
+    return stOffset < stRangeSize ? unsigned(stOffset / stFullBlockSize) + 1 : 0;
+  }
+  // Increments the tag and replaces the index.
+  unsigned int nextHead(unsigned int head, unsigned int index) const
+  {
+    return ((head + uiIndexMask + 1) & ~uiIndexMask) | index;
+  }
+
+  int popBlocks(int maxCount, unsigned int& first, unsigned int& last);
+  void pushBlocks(unsigned int first, unsigned int last);
+  void* allocate(Cache* cache);
+  void deallocate(Cache* cache, unsigned int index);
+#ifndef PII_NO_QT
+  Cache* threadCache()
+  {
+    if (!caches.hasLocalData())
+      caches.setLocalData(new Cache(this));
+    return caches.localData();
+  }
+#endif
+
+  std::size_t stFullBlockSize, stBlockSize;
   bool bOwn;
-  void *pMemory, *pLastAddress, *pHead;
+  void *pMemory;
+  char* pFirstBlock;
+  PiiAtomicInt iHead;
+  unsigned int uiIndexBits, uiIndexMask;
   ulong ulBlockCount;
-  std::size_t stLastAddress;
-  QMutex mutex;
+  std::size_t stRangeSize;
+  int iCacheSize, iBatchSize;
+#ifndef PII_NO_QT
+  QThreadStorage<Cache*> caches;
+#endif
 };
 
-PiiSimpleMemoryManager::PiiSimpleMemoryManager(std::size_t memorySize, std::size_t blockSize) :
-  d(new Data(std::malloc(memorySize), true, memorySize, blockSize)) // Allocate memory block from heap
+int PiiSimpleMemoryManager::Data::popBlocks(int maxCount, unsigned int& first, unsigned int& last)
+{
+  for (;;)
+    {
+      unsigned int uiHead = unsigned(iHead.loadAcquire());
+      first = uiHead & uiIndexMask;
+      if (first == 0)
+        return 0;
+      // Follow the links. If another thread modifies the list while
+      // we are walking, the links may be garbage, but the
+      // compare-and-swap will fail.
+      last = first;
+      unsigned int uiNext = next(first);
+      int iCount = 1;
+      while (iCount < maxCount && uiNext != 0 && uiNext <= ulBlockCount)
+        {
+          last = uiNext;
+          uiNext = next(uiNext);
+          ++iCount;
+        }
+      if (uiNext <= ulBlockCount &&
+          iHead.testAndSetOrdered(int(uiHead), int(nextHead(uiHead, uiNext))))
+        return iCount;
+    }
+}
+
+void PiiSimpleMemoryManager::Data::pushBlocks(unsigned int first, unsigned int last)
+{
+  for (;;)
+    {
+      unsigned int uiHead = unsigned(iHead.load());
+      setNext(last, uiHead & uiIndexMask);
+      if (iHead.testAndSetOrdered(int(uiHead), int(nextHead(uiHead, first))))
+        return;
+    }
+}
+
+void* PiiSimpleMemoryManager::Data::allocate(Cache* cache)
+{
+  // Refill an empty cache from the shared stack.
+  if (cache->iCount == 0)
+    {
+      cache->iCount = popBlocks(iBatchSize, cache->uiHead, cache->uiTail);
+      if (cache->iCount == 0)
+        return 0;
+    }
+  unsigned int uiIndex = cache->uiHead;
+  if (--cache->iCount > 0)
+    cache->uiHead = next(uiIndex);
+  return block(uiIndex);
+}
+
+void PiiSimpleMemoryManager::Data::deallocate(Cache* cache, unsigned int index)
+{
+  if (cache->iCount == 0)
+    cache->uiTail = index;
+  else
+    setNext(index, cache->uiHead);
+  cache->uiHead = index;
+  // Return the least recently released blocks to the shared stack
+  // once the cache is full.
+  if (++cache->iCount > iCacheSize)
+    {
+      unsigned int uiSplit = cache->uiHead;
+      for (int i=1; i<cache->iCount - iBatchSize; ++i)
+        uiSplit = next(uiSplit);
+      pushBlocks(next(uiSplit), cache->uiTail);
+      cache->uiTail = uiSplit;
+      cache->iCount -= iBatchSize;
+    }
+}
+
+PiiSimpleMemoryManager::PiiSimpleMemoryManager(std::size_t memorySize, std::size_t blockSize, int cacheSize) :
+  d(new Data(std::malloc(memorySize), true, memorySize, blockSize, cacheSize)) // Allocate memory block from heap
 {}
 
-PiiSimpleMemoryManager::PiiSimpleMemoryManager(void* memory, std::size_t memorySize, std::size_t blockSize) :
-  d(new Data(memory, false, memorySize, blockSize))
+PiiSimpleMemoryManager::PiiSimpleMemoryManager(void* memory, std::size_t memorySize, std::size_t blockSize, int cacheSize) :
+  d(new Data(memory, false, memorySize, blockSize, cacheSize))
 {}
 
 PiiSimpleMemoryManager::~PiiSimpleMemoryManager()
@@ -104,48 +252,34 @@ PiiSimpleMemoryManager::~PiiSimpleMemoryManager()
 
 void* PiiSimpleMemoryManager::allocate(std::size_t bytes)
 {
-  // No need to allocate anything.
-  if (bytes == 0)
+  // No need to allocate anything. Can we allocate this many bytes?
+  if (bytes == 0 || bytes > d->stBlockSize)
     return 0;
 
-  QMutexLocker lock(&d->mutex);
-  return d->allocate(bytes);
-}
-
-void* PiiSimpleMemoryManager::Data::allocate(std::size_t bytes)
-{
-  // Do we have free blocks? Can we allocate this many bytes?
-  if (pHead != 0 && bytes <= stBlockSize)
-    {
-      void* pBuffer = pHead;
-      // Move the head pointer to the next free block
-      pHead = *PII_NEXT_POINTER(pHead);
-      return pBuffer;
-    }
-  return 0;
+#ifndef PII_NO_QT
+  if (d->iCacheSize > 0)
+    return d->allocate(d->threadCache());
+#endif
+  unsigned int uiFirst, uiLast;
+  return d->popBlocks(1, uiFirst, uiLast) != 0 ? d->block(uiFirst) : 0;
 }
 
 bool PiiSimpleMemoryManager::deallocate(void* buffer)
 {
   if (buffer == 0)
     return true;
-  QMutexLocker lock(&d->mutex);
-  return d->deallocate(buffer);
-}
-
-bool PiiSimpleMemoryManager::Data::deallocate(void* buffer)
-{
-  //if (buffer >= pMemory && buffer <= pLastAddress)
-  if (std::size_t(buffer) - std::size_t(pMemory) <= stLastAddress)
+  unsigned int uiIndex = d->indexOf(buffer);
+  if (uiIndex == 0)
+    return false;
+#ifndef PII_NO_QT
+  if (d->iCacheSize > 0)
     {
-      // Make the pointer at the end of the released buffer to point
-      // to the old head.
-      *PII_NEXT_POINTER(buffer) = pHead;
-      // Mark the just released buffer as the new head.
-      pHead = buffer;
+      d->deallocate(d->threadCache(), uiIndex);
       return true;
     }
-  return false;
+#endif
+  d->pushBlocks(uiIndex, uiIndex);
+  return true;
 }
 
 ulong PiiSimpleMemoryManager::blockCount() const
@@ -157,3 +291,8 @@ std::size_t PiiSimpleMemoryManager::blockSize() const
 {
   return d->stBlockSize;
 }
+
+int PiiSimpleMemoryManager::cacheSize() const
+{
+  return d->iCacheSize;
+}
@@ -17,7 +17,6 @@
 #define _PIISIMPLEMEMORYMANAGER_H
 
 #include <PiiGlobal.h>
-#include <QMutex>
 
 /**
  * A simple segregated storage. This class reserves a fixed amount of
@@ -36,7 +35,18 @@
  * `new`. This may be attributed not only to faster
  * allocation/deallocation but also slightly better cache hit ratios.
  *
- * Memory allocation and deallocation are thread-safe operations.
+ * Memory allocation and deallocation are thread-safe and lock-free.
+ * Free blocks are kept in a shared stack that is updated with atomic
+ * compare-and-swap operations. When many threads allocate and release
+ * blocks at a high rate, even atomic operations on the shared stack
+ * cause cache line contention. To avoid it, the manager can keep a
+ * small cache of free blocks for each thread (see the *cacheSize*
+ * constructor parameter). Blocks are then moved between the thread
+ * caches and the shared stack in batches, and most allocations
+ * touch thread-local data only. Blocks cached by a thread are
+ * returned to the shared stack when the thread exits. Note that
+ * [allocate()] may return 0 even if there are free blocks in the
+ * caches of other threads.
  *
  * The following example shows how to override `new` and `delete` to
  * use a custom memory manager.
@@ -107,16 +117,23 @@ public:
    * `malloc()` implementation returns an unaligned pointer (which is
    * highly unlikely).
    *
+   * @param cacheSize the maximum number of free blocks each thread
+   * keeps in its private cache. Zero disables per-thread caching.
+   * Values between 16 and 64 work well for objects that are
+   * allocated and released at a high rate by many threads. Caching
+   * is not available if Into is built without Qt.
+   *
    * Note that the initial values cannot be changed once the memory
-   * manager has been constructed.
+   * manager has been constructed. At most 2^24 - 1 blocks will be
+   * managed.
    */
-  PiiSimpleMemoryManager(std::size_t memorySize, std::size_t blockSize);
+  PiiSimpleMemoryManager(std::size_t memorySize, std::size_t blockSize, int cacheSize = 0);
 
   /**
    * Creates a new memory manager that uses a preallocated block of
    * memory.
    */
-  PiiSimpleMemoryManager(void* buffer, std::size_t memorySize, std::size_t blockSize);
+  PiiSimpleMemoryManager(void* buffer, std::size_t memorySize, std::size_t blockSize, int cacheSize = 0);
 
   /**
    * Deallocates the memory buffer.
@@ -160,6 +177,11 @@ public:
    */
   std::size_t blockSize() const;
 
+  /**
+   * Returns the maximum number of free blocks cached by each thread.
+   */
+  int cacheSize() const;
+
 private:
   class Data;
   Data* d;
@@ -0,0 +1,439 @@
+/* This file is part of Into.
+ * Copyright (C) Intopii 2013.
+ * All rights reserved.
+ *
+ * Licensees holding a commercial Into license may use this file in
+ * accordance with the commercial license agreement. Please see
+ * LICENSE.commercial for commercial licensing terms.
+ *
+ * Alternatively, this file may be used under the terms of the GNU
+ * Affero General Public License version 3 as published by the Free
+ * Software Foundation. In addition, Intopii gives you special rights
+ * to use Into as a part of open source software projects. Please
+ * refer to LICENSE.AGPL3 for details.
+ */
+
+#ifndef _PIISORT_H
+#define _PIISORT_H
+
+#include "PiiParallel.h"
+#include "PiiMatrixUtil.h"
+
+#include <algorithm>
+#include <functional>
+#include <iterator>
+#include <vector>
+#include <cmath>
+#include <climits>
+
+namespace Pii
+{
+  /**
+   * @group sorting Sorting and selection
+   *
+   * Sorting algorithms and selection of the smallest elements or
+   * quantiles from unsorted data.
+   */
+
+  /**
+   * Moves the *k* smallest elements in the range [*begin*, *end*) to
+   * the beginning of the range and sorts them into ascending order
+   * according to *lessThan*. The order of the remaining elements is
+   * unspecified. The average complexity is `O(N + k log(k))`, which is
+   * faster than sorting the full range if *k* is small compared to
+   * the number of elements.
+   *
+   * ~~~(c++)
+   * QVector<QPair<double,int> > vecDistances(distances());
+   * // Three nearest neighbors
+   * Pii::selectSmallest(vecDistances.begin(), vecDistances.end(), 3);
+   * ~~~
+   */
+  template <class RandomAccessIterator, class LessThan>
+  void selectSmallest(RandomAccessIterator begin, RandomAccessIterator end, int k, LessThan lessThan)
+  {
+    if (k <= 0)
+      return;
+    if (k < int(end - begin))
+      {
+        std::nth_element(begin, begin + k, end, lessThan);
+        end = begin + k;
+      }
+    std::sort(begin, end, lessThan);
+  }
+
+  /**
+   * Moves the *k* smallest elements in the range [*begin*, *end*) to
+   * the beginning of the range and sorts them into ascending order
+   * using `operator<`.
+   */
+  template <class RandomAccessIterator>
+  inline void selectSmallest(RandomAccessIterator begin, RandomAccessIterator end, int k)
+  {
+    selectSmallest(begin, end, k, std::less<typename std::iterator_traits<RandomAccessIterator>::value_type>());
+  }
+
+  /**
+   * Returns the *fraction* quantile of all elements in *matrix*. The
+   * quantile is the smallest element *v* for which at least
+   * `ceil(fraction * N)` elements are less than or equal to *v*. For
+   * example, `quantile(mat, 0.5)` returns the median. This is the
+   * same definition as in PiiImage::percentile(), but works without
+   * a histogram and thus for any element type. The average
+   * complexity is linear in the number of elements. Returns `T(0)` for
+   * an empty matrix.
+   */
+  template <class T> T quantile(const PiiMatrix<T>& matrix, double fraction);
+
+  /**
+   * Returns many quantiles of *matrix* at once. The result is a row
+   * vector that contains the quantile corresponding to each element
+   * of *fractions*. The data is partitioned only once from each
+   * quantile to the next, which is faster than calling [quantile()]
+   * repeatedly.
+   *
+   * ~~~(c++)
+   * PiiMatrix<float> matQuartiles(Pii::quantiles(matValues, PiiMatrix<double>(1,3, 0.25, 0.5, 0.75)));
+   * ~~~
+   */
+  template <class T> PiiMatrix<T> quantiles(const PiiMatrix<T>& matrix, const PiiMatrix<double>& fractions);
+
+  /**
+   * Sorts the elements in [*begin*, *end*) into ascending order using
+   * least significant digit radix sort. *T* must be a primitive
+   * integer or floating-point type. The complexity is `O(N)`, which
+   * makes radix sort considerably faster than comparison-based
+   * sorting with large data sets. Floating-point numbers are ordered
+   * as with `operator<`, except that negative zero is placed before
+   * positive zero. NaNs with the sign bit set are placed first and
+   * others last. The function allocates a temporary buffer of *N*
+   * elements.
+   */
+  template <class T> void radixSort(T* begin, T* end);
+
+  /**
+   * Sorts the elements in [*begin*, *end*) into ascending order
+   * according to *lessThan*. The range is divided into chunks that
+   * are sorted in parallel as determined by *policy*. The sorted
+   * chunks are then merged pairwise, also in parallel. Like
+   * `std::sort()`, the sort is not stable. The function allocates a
+   * temporary buffer of *N* elements. Small ranges are sorted in the
+   * calling thread.
+   *
+   * ~~~(c++)
+   * QVector<double> vecValues(values());
+   * Pii::parallelSort(Pii::ParallelExecution(), vecValues.begin(), vecValues.end());
+   * ~~~
+   */
+  template <class RandomAccessIterator, class LessThan>
+  void parallelSort(const ParallelExecution& policy,
+                    RandomAccessIterator begin, RandomAccessIterator end,
+                    LessThan lessThan);
+
+  /**
+   * Sorts the elements in [*begin*, *end*) in parallel using
+   * `operator<`.
+   */
+  template <class RandomAccessIterator>
+  inline void parallelSort(const ParallelExecution& policy,
+                           RandomAccessIterator begin, RandomAccessIterator end)
+  {
+    parallelSort(policy, begin, end,
+                 std::less<typename std::iterator_traits<RandomAccessIterator>::value_type>());
+  }
+
+  /**
+   * Sorts the rows of *matrix* in parallel based on the values on
+   * *column*. The result is the same as with the serial
+   * [sortRows()]: the sort is stable.
+   */
+  template <class T, class LessThan>
+  void sortRows(const ParallelExecution& policy, PiiMatrix<T>& matrix, LessThan lessThan, int column = 0);
+
+  /**
+   * Sorts the rows of *matrix* in parallel into ascending order based
+   * on the values on *column*.
+   */
+  template <class T> inline void sortRows(const ParallelExecution& policy, PiiMatrix<T>& matrix, int column = 0)
+  {
+    sortRows(policy, matrix, std::less<T>(), column);
+  }
+
+  /**
+   * Returns a copy of *matrix* with rows sorted in parallel.
+   */
+  template <class T, class LessThan>
+  inline PiiMatrix<T> sortedRows(const ParallelExecution& policy, const PiiMatrix<T>& matrix,
+                                 LessThan lessThan, int column = 0)
+  {
+    PiiMatrix<T> result(matrix);
+    sortRows(policy, result, lessThan, column);
+    return result;
+  }
+
+  /**
+   * Returns a copy of *matrix* with rows sorted in parallel into
+   * ascending order.
+   */
+  template <class T>
+  inline PiiMatrix<T> sortedRows(const ParallelExecution& policy, const PiiMatrix<T>& matrix, int column = 0)
+  {
+    return sortedRows(policy, matrix, std::less<T>(), column);
+  }
+
+  /// @hide
+  namespace Sort
+  {
+    // Maps a primitive type to an unsigned integer with the same
+    // ordering.
+    template <class T> struct RadixKey
+    {
+      typedef T Type;
+      static Type key(T value) { return value; }
+    };
+
+    // Flipping the sign bit moves negative numbers below positive
+    // ones.
+#define PII_SIGNED_RADIX_KEY(SIGNED, UNSIGNED) \
+    template <> struct RadixKey<SIGNED> \
+    { \
+      typedef UNSIGNED Type; \
+      static Type key(SIGNED value) { return Type(Type(value) ^ (Type(1) << (sizeof(Type)*8-1))); } \
+    }
+
+    PII_SIGNED_RADIX_KEY(signed char, unsigned char);
+    PII_SIGNED_RADIX_KEY(short, unsigned short);
+    PII_SIGNED_RADIX_KEY(int, unsigned int);
+    PII_SIGNED_RADIX_KEY(long, unsigned long);
+    PII_SIGNED_RADIX_KEY(long long, unsigned long long);
+#undef PII_SIGNED_RADIX_KEY
+
+    // char may be either signed or unsigned.
+    template <> struct RadixKey<char>
+    {
+      typedef unsigned char Type;
+      static Type key(char value) { return Type(Type(value) ^ (CHAR_MIN < 0 ? 0x80 : 0)); }
+    };
+
+    template <> struct RadixKey<float>
+    {
+      typedef quint32 Type;
+      // Negative numbers are flipped entirely, positive ones gain the
+      // sign bit.
+      static Type key(float value)
+      {
+        union { float f; quint32 i; } u;
+        u.f = value;
+        return u.i ^ (quint32(-qint32(u.i >> 31)) | 0x80000000u);
+      }
+    };
+
+    template <> struct RadixKey<double>
+    {
+      typedef quint64 Type;
+      static Type key(double value)
+      {
+        union { double f; quint64 i; } u;
+        u.f = value;
+        return u.i ^ (quint64(-qint64(u.i >> 63)) | (quint64(1) << 63));
+      }
+    };
+
+    // Merges pairs of adjacent, sorted chunks from source to target.
+    template <class SourceIterator, class TargetIterator, class LessThan> struct ChunkMerger
+    {
+      ChunkMerger(SourceIterator source, TargetIterator target,
+                  const int* bounds, int width, LessThan lessThan) :
+        source(source), target(target), bounds(bounds), width(width), lessThan(lessThan)
+      {}
+
+      void operator() (int firstPair, int pairCount)
+      {
+        for (int p=firstPair; p<firstPair+pairCount; ++p)
+          {
+            const int iStart = bounds[2*p*width],
+              iMiddle = bounds[(2*p+1)*width],
+              iEnd = bounds[(2*p+2)*width];
+            std::merge(source + iStart, source + iMiddle,
+                       source + iMiddle, source + iEnd,
+                       target + iStart, lessThan);
+          }
+      }
+
+      SourceIterator source;
+      TargetIterator target;
+      const int* bounds;
+      int width;
+      LessThan lessThan;
+    };
+
+    template <class RandomAccessIterator, class LessThan> struct ChunkSorter
+    {
+      ChunkSorter(RandomAccessIterator begin, const int* bounds, LessThan lessThan) :
+        begin(begin), bounds(bounds), lessThan(lessThan)
+      {}
+
+      void operator() (int firstChunk, int chunkCount)
+      {
+        for (int c=firstChunk; c<firstChunk+chunkCount; ++c)
+          std::sort(begin + bounds[c], begin + bounds[c+1], lessThan);
+      }
+
+      RandomAccessIterator begin;
+      const int* bounds;
+      LessThan lessThan;
+    };
+
+    template <class SourceIterator, class TargetIterator, class LessThan>
+    inline void mergeChunks(const ParallelExecution& policy,
+                            SourceIterator source, TargetIterator target,
+                            const int* bounds, int chunks, int width, LessThan lessThan)
+    {
+      forEachBand(policy, chunks / (2*width), 0,
+                  ChunkMerger<SourceIterator,TargetIterator,LessThan>(source, target, bounds, width, lessThan));
+    }
+
+    // Minimum number of elements in a chunk of parallelSort().
+    const int iMinChunkSize = 8192;
+    // Maximum number of chunks in parallelSort().
+    const int iMaxChunks = 64;
+  }
+  /// @endhide
+
+  template <class T> void radixSort(T* begin, T* end)
+  {
+    typedef typename Sort::RadixKey<T>::Type KeyType;
+    const int iCount = int(end - begin), iPasses = int(sizeof(T));
+    if (iCount < 2)
+      return;
+
+    // Count all digits in a single pass.
+    std::vector<int> vecCounts(256 * iPasses, 0);
+    for (int i=0; i<iCount; ++i)
+      {
+        const KeyType key = Sort::RadixKey<T>::key(begin[i]);
+        for (int p=0; p<iPasses; ++p)
+          ++vecCounts[256*p + int((key >> (8*p)) & 0xff)];
+      }
+
+    std::vector<T> vecBuffer(iCount);
+    T *pSource = begin, *pTarget = &vecBuffer[0];
+    for (int p=0; p<iPasses; ++p)
+      {
+        int* pCounts = &vecCounts[256*p];
+        // All keys have the same digit -> nothing to do.
+        if (pCounts[Sort::RadixKey<T>::key(*pSource) >> (8*p) & 0xff] == iCount)
+          continue;
+        // Turn counts into offsets
+        for (int i=0, iOffset=0; i<256; ++i)
+          {
+            const int iDigitCount = pCounts[i];
+            pCounts[i] = iOffset;
+            iOffset += iDigitCount;
+          }
+        for (int i=0; i<iCount; ++i)
+          pTarget[pCounts[int((Sort::RadixKey<T>::key(pSource[i]) >> (8*p)) & 0xff)]++] = pSource[i];
+        std::swap(pSource, pTarget);
+      }
+    if (pSource != begin)
+      std::copy(pSource, pSource + iCount, begin);
+  }
+
+  template <class RandomAccessIterator, class LessThan>
+  void parallelSort(const ParallelExecution& policy,
+                    RandomAccessIterator begin, RandomAccessIterator end,
+                    LessThan lessThan)
+  {
+    typedef typename std::iterator_traits<RandomAccessIterator>::value_type ValueType;
+    const int iCount = int(end - begin);
+    // The number of chunks must be a power of two for pairwise
+    // merging.
+    int iChunks = 1;
+    while (iChunks < Sort::iMaxChunks &&
+           iCount / (iChunks*2) >= Sort::iMinChunkSize &&
+           (policy.maxBands <= 0 || iChunks < policy.maxBands))
+      iChunks *= 2;
+    if (iChunks == 1)
+      {
+        std::sort(begin, end, lessThan);
+        return;
+      }
+
+    std::vector<int> vecBounds(iChunks + 1);
+    for (int i=0; i<=iChunks; ++i)
+      vecBounds[i] = int(qint64(iCount) * i / iChunks);
+
+    // Each chunk and pair of chunks is a single unit of work.
+    ParallelExecution chunkPolicy(policy);
+    chunkPolicy.minBandRows = 1;
+    forEachBand(chunkPolicy, iChunks, 0,
+                Sort::ChunkSorter<RandomAccessIterator,LessThan>(begin, &vecBounds[0], lessThan));
+
+    std::vector<ValueType> vecBuffer(iCount);
+    bool bInBuffer = false;
+    for (int iWidth=1; iWidth<iChunks; iWidth *= 2)
+      {
+        if (bInBuffer)
+          Sort::mergeChunks(chunkPolicy, vecBuffer.begin(), begin, &vecBounds[0], iChunks, iWidth, lessThan);
+        else
+          Sort::mergeChunks(chunkPolicy, begin, vecBuffer.begin(), &vecBounds[0], iChunks, iWidth, lessThan);
+        bInBuffer = !bInBuffer;
+      }
+    if (bInBuffer)
+      std::copy(vecBuffer.begin(), vecBuffer.end(), begin);
+  }
+
+  template <class T, class LessThan>
+  void sortRows(const ParallelExecution& policy, PiiMatrix<T>& matrix, LessThan lessThan, int column)
+  {
+    const int iRows = matrix.rows();
+    if (iRows < 2) return;
+    std::vector<std::pair<T,int> > vecKeys(iRows);
+    for (int r=0; r<iRows; ++r)
+      vecKeys[r] = std::make_pair(matrix(r, column), r);
+    parallelSort(policy, vecKeys.begin(), vecKeys.end(), KeyIndexLess<T,LessThan>(lessThan));
+    std::vector<int> vecOrder(iRows);
+    for (int r=0; r<iRows; ++r)
+      vecOrder[r] = vecKeys[r].second;
+    reorderRows(matrix, &vecOrder[0]);
+  }
+
+  template <class T> T quantile(const PiiMatrix<T>& matrix, double fraction)
+  {
+    return quantiles(matrix, PiiMatrix<double>(1, 1, fraction))(0, 0);
+  }
+
+  template <class T> PiiMatrix<T> quantiles(const PiiMatrix<T>& matrix, const PiiMatrix<double>& fractions)
+  {
+    const int iCount = matrix.rows() * matrix.columns(),
+      iFractions = fractions.rows() * fractions.columns();
+    PiiMatrix<T> matResult(1, iFractions);
+    if (iCount == 0)
+      return matResult;
+
+    std::vector<T> vecValues(matrix.begin(), matrix.end());
+    // Find the rank of each quantile.
+    std::vector<std::pair<int,int> > vecRanks(iFractions);
+    int i = 0;
+    for (PiiMatrix<double>::const_iterator it = fractions.begin(); it != fractions.end(); ++it, ++i)
+      vecRanks[i] = std::make_pair(qBound(0, int(std::ceil(*it * iCount)) - 1, iCount - 1), i);
+    std::sort(vecRanks.begin(), vecRanks.end());
+
+    // Each partitioning step leaves everything below the rank in
+    // place. The next one only needs to look above it.
+    typename std::vector<T>::iterator first = vecValues.begin();
+    for (i=0; i<iFractions; ++i)
+      {
+        typename std::vector<T>::iterator nth = vecValues.begin() + vecRanks[i].first;
+        if (nth >= first)
+          {
+            std::nth_element(first, nth, vecValues.end());
+            first = nth + 1;
+          }
+        matResult(0, vecRanks[i].second) = *nth;
+      }
+    return matResult;
+  }
+}
+
+#endif //_PIISORT_H
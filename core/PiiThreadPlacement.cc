@@ -0,0 +1,170 @@
+/* This file is part of Into.
+ * Copyright (C) Intopii 2013.
+ * All rights reserved.
+ *
+ * Licensees holding a commercial Into license may use this file in
+ * accordance with the commercial license agreement. Please see
+ * LICENSE.commercial for commercial licensing terms.
+ *
+ * Alternatively, this file may be used under the terms of the GNU
+ * Affero General Public License version 3 as published by the Free
+ * Software Foundation. In addition, Intopii gives you special rights
+ * to use Into as a part of open source software projects. Please
+ * refer to LICENSE.AGPL3 for details.
+ */
+
+
+#include "PiiThreadPlacement.h"
+
+#include <QFile>
+#include <QStringList>
+
+#if defined(Q_OS_LINUX)
+#  include <sched.h>
+#  include <pthread.h>
+#  include <unistd.h>
+#  include <sys/syscall.h>
+#elif defined(Q_OS_WIN)
+#  include <windows.h>
+#endif
+
+namespace Pii
+{
+  QList<int> parseCpuList(const QString& cpus)
+  {
+    QList<int> lstResult;
+    QStringList lstParts(cpus.trimmed().split(',', QString::SkipEmptyParts));
+    for (int i=0; i<lstParts.size(); ++i)
+      {
+        QStringList lstRange(lstParts[i].split('-'));
+        bool bFirstOk = false, bLastOk = false;
+        const int iFirst = lstRange[0].trimmed().toInt(&bFirstOk);
+        const int iLast = lstRange.size() == 2 ? lstRange[1].trimmed().toInt(&bLastOk) : iFirst;
+        if (!bFirstOk || (lstRange.size() == 2 && !bLastOk) || lstRange.size() > 2 || iFirst < 0)
+          continue;
+        for (int iCpu=iFirst; iCpu<=iLast; ++iCpu)
+          if (!lstResult.contains(iCpu))
+            lstResult << iCpu;
+      }
+    return lstResult;
+  }
+
+#if defined(Q_OS_LINUX)
+  static QString nodeDirectory(int node)
+  {
+    return QString("/sys/devices/system/node/node%1").arg(node);
+  }
+
+  int numaNodeCount()
+  {
+    QFile file("/sys/devices/system/node/online");
+    if (!file.open(QIODevice::ReadOnly))
+      return 1;
+    return qMax(1, parseCpuList(QString(file.readAll())).size());
+  }
+
+  QList<int> numaNodeCpus(int node)
+  {
+    if (node < 0)
+      return QList<int>();
+    QFile file(nodeDirectory(node) + "/cpulist");
+    if (!file.open(QIODevice::ReadOnly))
+      return QList<int>();
+    return parseCpuList(QString(file.readAll()));
+  }
+
+  bool setThreadAffinity(const QList<int>& cpus)
+  {
+    cpu_set_t cpuSet;
+    CPU_ZERO(&cpuSet);
+    if (cpus.isEmpty())
+      {
+        for (int i=0; i<CPU_SETSIZE; ++i)
+          CPU_SET(i, &cpuSet);
+      }
+    else
+      {
+        for (int i=0; i<cpus.size(); ++i)
+          if (cpus[i] >= 0 && cpus[i] < CPU_SETSIZE)
+            CPU_SET(cpus[i], &cpuSet);
+      }
+    // Zero means the calling thread.
+    return sched_setaffinity(0, sizeof(cpuSet), &cpuSet) == 0;
+  }
+
+  bool setThreadMemoryNode(int node)
+  {
+    // Values from linux/mempolicy.h
+    enum { MpolDefault = 0, MpolPreferred = 1 };
+    if (node < 0)
+      return syscall(SYS_set_mempolicy, MpolDefault, 0, 0) == 0;
+    if (node >= int(sizeof(unsigned long) * 8))
+      return false;
+    unsigned long ulMask = 1ul << node;
+    return syscall(SYS_set_mempolicy, MpolPreferred, &ulMask, sizeof(ulMask) * 8) == 0;
+  }
+
+  bool setThreadRealTimePriority(int priority)
+  {
+    sched_param param;
+    param.sched_priority = priority > 0 ? qBound(1, priority, 99) : 0;
+    return pthread_setschedparam(pthread_self(), priority > 0 ? SCHED_FIFO : SCHED_OTHER, &param) == 0;
+  }
+
+#elif defined(Q_OS_WIN)
+  int numaNodeCount()
+  {
+    ULONG ulHighestNode = 0;
+    if (!GetNumaHighestNodeNumber(&ulHighestNode))
+      return 1;
+    return int(ulHighestNode) + 1;
+  }
+
+  QList<int> numaNodeCpus(int node)
+  {
+    QList<int> lstResult;
+    ULONGLONG ullMask = 0;
+    if (node < 0 || !GetNumaNodeProcessorMask(UCHAR(node), &ullMask))
+      return lstResult;
+    for (int i=0; i<64; ++i)
+      if (ullMask & (ULONGLONG(1) << i))
+        lstResult << i;
+    return lstResult;
+  }
+
+  bool setThreadAffinity(const QList<int>& cpus)
+  {
+    DWORD_PTR processMask = 0, systemMask = 0;
+    if (!GetProcessAffinityMask(GetCurrentProcess(), &processMask, &systemMask))
+      return false;
+    DWORD_PTR mask = cpus.isEmpty() ? processMask : 0;
+    for (int i=0; i<cpus.size(); ++i)
+      if (cpus[i] >= 0 && cpus[i] < int(sizeof(DWORD_PTR) * 8))
+        mask |= DWORD_PTR(1) << cpus[i];
+    return SetThreadAffinityMask(GetCurrentThread(), mask) != 0;
+  }
+
+  bool setThreadMemoryNode(int node)
+  {
+    // Windows prefers the node of the thread's ideal processor.
+    if (node < 0)
+      return true;
+    QList<int> lstCpus(numaNodeCpus(node));
+    return !lstCpus.isEmpty() &&
+      SetThreadIdealProcessor(GetCurrentThread(), DWORD(lstCpus[0])) != DWORD(-1);
+  }
+
+  bool setThreadRealTimePriority(int priority)
+  {
+    return SetThreadPriority(GetCurrentThread(),
+                             priority > 0 ? THREAD_PRIORITY_TIME_CRITICAL : THREAD_PRIORITY_NORMAL) != 0;
+  }
+
+#else
+  int numaNodeCount() { return 1; }
+  QList<int> numaNodeCpus(int) { return QList<int>(); }
+  bool setThreadAffinity(const QList<int>&) { return false; }
+  bool setThreadMemoryNode(int node) { return node < 0; }
+  bool setThreadRealTimePriority(int priority) { return priority <= 0; }
+#endif
+}
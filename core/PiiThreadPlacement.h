@@ -0,0 +1,85 @@
+/* This file is part of Into.
+ * Copyright (C) Intopii 2013.
+ * All rights reserved.
+ *
+ * Licensees holding a commercial Into license may use this file in
+ * accordance with the commercial license agreement. Please see
+ * LICENSE.commercial for commercial licensing terms.
+ *
+ * Alternatively, this file may be used under the terms of the GNU
+ * Affero General Public License version 3 as published by the Free
+ * Software Foundation. In addition, Intopii gives you special rights
+ * to use Into as a part of open source software projects. Please
+ * refer to LICENSE.AGPL3 for details.
+ */
+
+
+#ifndef _PIITHREADPLACEMENT_H
+#define _PIITHREADPLACEMENT_H
+
+#include "PiiGlobal.h"
+#include <QList>
+#include <QString>
+
+/**
+ * @file
+ *
+ * Functions for controlling where and how the calling thread is
+ * scheduled. The functions return `false` if the requested placement
+ * is not supported on the platform or the caller lacks the necessary
+ * privileges. Only Linux supports all of them.
+ */
+
+namespace Pii
+{
+  /**
+   * Parses a list of CPU indices in the format used by Linux
+   * (`taskset -c`, `/sys/devices/system/node/nodeN/cpulist`).
+   * Comma-separated values are either single indices or inclusive
+   * ranges. Invalid entries are ignored.
+   *
+   * ~~~(c++)
+   * QList<int> lstCpus(Pii::parseCpuList("0-3,8")); // 0, 1, 2, 3, 8
+   * ~~~
+   */
+  PII_CORE_EXPORT QList<int> parseCpuList(const QString& cpus);
+
+  /**
+   * Returns the number of NUMA nodes in the system. Returns one if
+   * the system has a single node or the number cannot be determined.
+   */
+  PII_CORE_EXPORT int numaNodeCount();
+
+  /**
+   * Returns the indices of the CPUs that belong to the given NUMA
+   * node. Returns an empty list if there is no such node.
+   */
+  PII_CORE_EXPORT QList<int> numaNodeCpus(int node);
+
+  /**
+   * Restricts the calling thread to run only on the given CPUs.
+   * An empty list removes all restrictions.
+   */
+  PII_CORE_EXPORT bool setThreadAffinity(const QList<int>& cpus);
+
+  /**
+   * Makes the operating system allocate memory for the calling
+   * thread preferably from the given NUMA node. Since memory is
+   * assigned to a node when it is first touched, objects such as
+   * images created by the thread will be local to the node. A
+   * negative value restores the default (local) policy.
+   */
+  PII_CORE_EXPORT bool setThreadMemoryNode(int node);
+
+  /**
+   * Makes the calling thread a real-time thread with the given
+   * priority. On Linux, the thread will be scheduled with the
+   * SCHED_FIFO policy; *priority* must be in [1, 99]. On Windows,
+   * the thread priority will be set to time critical. Zero restores
+   * normal scheduling. Use with care: a busy real-time thread can
+   * starve the rest of the system.
+   */
+  PII_CORE_EXPORT bool setThreadRealTimePriority(int priority);
+}
+
+#endif //_PIITHREADPLACEMENT_H
@@ -0,0 +1,317 @@
+/* This file is part of Into.
+ * Copyright (C) Intopii 2013.
+ * All rights reserved.
+ *
+ * Licensees holding a commercial Into license may use this file in
+ * accordance with the commercial license agreement. Please see
+ * LICENSE.commercial for commercial licensing terms.
+ *
+ * Alternatively, this file may be used under the terms of the GNU
+ * Affero General Public License version 3 as published by the Free
+ * Software Foundation. In addition, Intopii gives you special rights
+ * to use Into as a part of open source software projects. Please
+ * refer to LICENSE.AGPL3 for details.
+ */
+
+#include "PiiThreadPool.h"
+#include "PiiAtomicInt.h"
+
+#include <QThread>
+#include <QMutex>
+#include <QWaitCondition>
+#include <QList>
+
+// The worker running in the current thread, if any.
+static PII_THREAD_LOCAL void* pCurrentWorker = 0;
+
+PiiThreadPool::Task::~Task() {}
+
+class PiiThreadPool::Data
+{
+public:
+  Data(int threadCount) :
+    iThreadCount(threadCount),
+    iMaxThreadCount(threadCount * 4),
+    bMaxThreadCountSet(false),
+    iBlockedWorkers(0),
+    iNextWorker(0),
+    iStopping(0)
+  {}
+
+  Task* takeTask(Worker* worker);
+  Task* stealTask(Worker* worker);
+  void ensureWorkers();
+  bool mustExit(Worker* worker);
+  void wakeIdleWorker();
+  void deleteFinishedWorkers();
+
+  // Protects everything but the deques.
+  QMutex poolLock;
+  QWaitCondition taskCondition;
+  QList<Worker*> lstWorkers, lstFinishedWorkers;
+  int iThreadCount, iMaxThreadCount;
+  bool bMaxThreadCountSet;
+  int iBlockedWorkers;
+  int iNextWorker;
+  // Non-zero once the pool is being destroyed. Read without poolLock.
+  PiiAtomicInt iStopping;
+  // The total number of queued tasks and the number of parked
+  // workers. Both are modified with ordered atomic operations, which
+  // together guarantee that a task is never left in queue while all
+  // workers are parked.
+  PiiAtomicInt iPendingTasks, iIdleWorkers;
+};
+
+class PiiThreadPool::Worker : public QThread
+{
+public:
+  Worker(PiiThreadPool::Data* data) : pData(data) {}
+
+  // Lock order: poolLock -> dequeLock.
+  QMutex dequeLock;
+  QList<Task*> lstTasks;
+  PiiThreadPool::Data* pData;
+
+protected:
+  void run();
+};
+
+void PiiThreadPool::Worker::run()
+{
+  pCurrentWorker = this;
+  while (pData->iStopping.loadAcquire() == 0)
+    {
+      Task* pTask = pData->takeTask(this);
+      if (pTask != 0)
+        {
+          try { pTask->run(); } catch (...) {}
+          continue;
+        }
+
+      QMutexLocker lock(&pData->poolLock);
+      if (pData->mustExit(this))
+        break;
+      ++pData->iIdleWorkers;
+      // Must check again after announcing to be idle. Otherwise a
+      // task submitted in between would not wake us up.
+      if (pData->iPendingTasks.loadAcquire() == 0 && pData->iStopping.loadAcquire() == 0)
+        pData->taskCondition.wait(&pData->poolLock);
+      --pData->iIdleWorkers;
+    }
+  pCurrentWorker = 0;
+}
+
+PiiThreadPool::Task* PiiThreadPool::Data::takeTask(Worker* worker)
+{
+  // Fast path: LIFO from own deque.
+  synchronized (worker->dequeLock)
+    {
+      if (!worker->lstTasks.isEmpty())
+        {
+          --iPendingTasks;
+          return worker->lstTasks.takeLast();
+        }
+    }
+  if (iPendingTasks.loadAcquire() == 0)
+    return 0;
+  return stealTask(worker);
+}
+
+PiiThreadPool::Task* PiiThreadPool::Data::stealTask(Worker* worker)
+{
+  QMutexLocker lock(&poolLock);
+  const int iCount = lstWorkers.size();
+  const int iStart = lstWorkers.indexOf(worker);
+  for (int i=1; i<iCount; ++i)
+    {
+      Worker* pVictim = lstWorkers[(iStart + i) % iCount];
+      // Don't wait for a busy deque; another one may have work.
+      if (!pVictim->dequeLock.tryLock())
+        continue;
+      Task* pTask = 0;
+      if (!pVictim->lstTasks.isEmpty())
+        {
+          // FIFO from the victim's deque: the oldest task is the
+          // least likely to have its data in the victim's cache.
+          pTask = pVictim->lstTasks.takeFirst();
+          --iPendingTasks;
+        }
+      pVictim->dequeLock.unlock();
+      if (pTask != 0)
+        return pTask;
+    }
+  return 0;
+}
+
+// poolLock must be held when calling this function
+bool PiiThreadPool::Data::mustExit(Worker* worker)
+{
+  if (iStopping.loadAcquire() == 0)
+    {
+      // Spare workers exit once they are no longer needed.
+      if (lstWorkers.size() - iBlockedWorkers <= iThreadCount)
+        return false;
+      synchronized (worker->dequeLock)
+        if (!worker->lstTasks.isEmpty())
+          return false;
+    }
+  lstWorkers.removeOne(worker);
+  lstFinishedWorkers << worker;
+  return true;
+}
+
+// poolLock must be held when calling this function
+void PiiThreadPool::Data::deleteFinishedWorkers()
+{
+  for (int i=0; i<lstFinishedWorkers.size(); ++i)
+    {
+      lstFinishedWorkers[i]->wait();
+      delete lstFinishedWorkers[i];
+    }
+  lstFinishedWorkers.clear();
+}
+
+// poolLock must be held when calling this function
+void PiiThreadPool::Data::ensureWorkers()
+{
+  if (iStopping.loadAcquire() != 0)
+    return;
+  deleteFinishedWorkers();
+  while (lstWorkers.size() - iBlockedWorkers < iThreadCount &&
+         lstWorkers.size() < iMaxThreadCount)
+    {
+      Worker* pWorker = new Worker(this);
+      lstWorkers << pWorker;
+      pWorker->start();
+    }
+}
+
+void PiiThreadPool::Data::wakeIdleWorker()
+{
+  if (iIdleWorkers.loadAcquire() > 0)
+    synchronized (poolLock) taskCondition.wakeOne();
+}
+
+PiiThreadPool::PiiThreadPool(int threadCount) :
+  d(new Data(threadCount > 0 ? threadCount : qMax(QThread::idealThreadCount(), 1)))
+{
+}
+
+PiiThreadPool::~PiiThreadPool()
+{
+  QList<Worker*> lstWorkers;
+  synchronized (d->poolLock)
+    {
+      d->iStopping.storeRelease(1);
+      d->taskCondition.wakeAll();
+      lstWorkers = d->lstWorkers + d->lstFinishedWorkers;
+      d->lstWorkers.clear();
+      d->lstFinishedWorkers.clear();
+    }
+  for (int i=0; i<lstWorkers.size(); ++i)
+    {
+      lstWorkers[i]->wait();
+      delete lstWorkers[i];
+    }
+  delete d;
+}
+
+void PiiThreadPool::setThreadCount(int threadCount)
+{
+  if (threadCount < 1)
+    return;
+  synchronized (d->poolLock)
+    {
+      d->iThreadCount = threadCount;
+      if (!d->bMaxThreadCountSet)
+        d->iMaxThreadCount = threadCount * 4;
+      else if (d->iMaxThreadCount < threadCount)
+        d->iMaxThreadCount = threadCount;
+      // Wake idle workers so that extra ones can exit.
+      d->taskCondition.wakeAll();
+    }
+}
+
+int PiiThreadPool::threadCount() const
+{
+  return d->iThreadCount;
+}
+
+void PiiThreadPool::setMaxThreadCount(int maxThreadCount)
+{
+  synchronized (d->poolLock)
+    {
+      d->iMaxThreadCount = qMax(maxThreadCount, d->iThreadCount);
+      d->bMaxThreadCountSet = true;
+    }
+}
+
+int PiiThreadPool::maxThreadCount() const
+{
+  return d->iMaxThreadCount;
+}
+
+int PiiThreadPool::activeThreadCount() const
+{
+  synchronized (d->poolLock) return d->lstWorkers.size();
+  return 0;
+}
+
+void PiiThreadPool::submit(Task* task)
+{
+  Worker* pWorker = static_cast<Worker*>(pCurrentWorker);
+  if (pWorker != 0 && pWorker->pData == d)
+    {
+      // Submitted by a worker: push to own deque.
+      synchronized (pWorker->dequeLock) pWorker->lstTasks.append(task);
+      ++d->iPendingTasks;
+    }
+  else
+    {
+      QMutexLocker lock(&d->poolLock);
+      d->ensureWorkers();
+      if (d->lstWorkers.isEmpty())
+        return;
+      // The deque is filled while holding poolLock. This ensures
+      // the worker cannot exit before it sees the task.
+      pWorker = d->lstWorkers[d->iNextWorker++ % d->lstWorkers.size()];
+      synchronized (pWorker->dequeLock) pWorker->lstTasks.append(task);
+      ++d->iPendingTasks;
+      if (d->iIdleWorkers.loadAcquire() > 0)
+        d->taskCondition.wakeOne();
+      return;
+    }
+  d->wakeIdleWorker();
+}
+
+void PiiThreadPool::beginBlocking()
+{
+  if (!isWorkerThread())
+    return;
+  synchronized (d->poolLock)
+    {
+      ++d->iBlockedWorkers;
+      // Start a spare worker if needed. Queued tasks could otherwise
+      // wait for the blocked worker forever.
+      d->ensureWorkers();
+    }
+}
+
+void PiiThreadPool::endBlocking()
+{
+  if (!isWorkerThread())
+    return;
+  synchronized (d->poolLock) --d->iBlockedWorkers;
+}
+
+bool PiiThreadPool::isWorkerThread() const
+{
+  Worker* pWorker = static_cast<Worker*>(pCurrentWorker);
+  return pWorker != 0 && pWorker->pData == d;
+}
+
+PiiThreadPool* PiiThreadPool::globalInstance()
+{
+  static PiiThreadPool pool;
+  return &pool;
+}
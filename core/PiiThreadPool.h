@@ -0,0 +1,147 @@
+/* This file is part of Into.
+ * Copyright (C) Intopii 2013.
+ * All rights reserved.
+ *
+ * Licensees holding a commercial Into license may use this file in
+ * accordance with the commercial license agreement. Please see
+ * LICENSE.commercial for commercial licensing terms.
+ *
+ * Alternatively, this file may be used under the terms of the GNU
+ * Affero General Public License version 3 as published by the Free
+ * Software Foundation. In addition, Intopii gives you special rights
+ * to use Into as a part of open source software projects. Please
+ * refer to LICENSE.AGPL3 for details.
+ */
+
+#ifndef _PIITHREADPOOL_H
+#define _PIITHREADPOOL_H
+
+#include "PiiGlobal.h"
+
+/**
+ * A work-stealing thread pool. Each worker thread has a task deque of
+ * its own. A task submitted by a worker is pushed to the back of the
+ * worker's own deque, and the worker takes tasks from the back
+ * (LIFO), which keeps related work on a warm cache. Tasks submitted
+ * by other threads are distributed to the workers in round-robin
+ * fashion. A worker whose deque runs empty steals the oldest task
+ * from the front of another worker's deque. Idle workers are parked
+ * until new tasks arrive.
+ *
+ * The pool does not guarantee any execution order. If the order of
+ * results matters, the caller must restore it (see
+ * PiiOutputSocket::startEmit()).
+ *
+ * If a task needs to block (for example, wait until a receiver is
+ * able to take an object), it should announce this with
+ * [beginBlocking()] and [endBlocking()]. The pool then starts a
+ * spare worker so that the number of runnable workers stays at
+ * [threadCount]. This prevents deadlocks in pipelines where the task
+ * that would release the blocked one is waiting in a deque.
+ *
+ * ~~~(c++)
+ * class MyTask : public PiiThreadPool::Task
+ * {
+ * public:
+ *   void run() { doSomething(); }
+ * };
+ *
+ * MyTask task;
+ * PiiThreadPool::globalInstance()->submit(&task);
+ * ~~~
+ */
+class PII_CORE_EXPORT PiiThreadPool
+{
+public:
+  /**
+   * An interface for tasks that can be executed in the pool.
+   */
+  class PII_CORE_EXPORT Task
+  {
+  public:
+    virtual ~Task();
+    /**
+     * Executes the task. Exceptions thrown from this function are
+     * caught and ignored by the worker.
+     */
+    virtual void run() = 0;
+  };
+
+  /**
+   * Creates a new thread pool with *threadCount* worker threads. If
+   * *threadCount* is less than one, QThread::idealThreadCount() will
+   * be used. Threads will be started on demand.
+   */
+  PiiThreadPool(int threadCount = 0);
+
+  /**
+   * Destroys the pool. Waits until all workers have finished their
+   * current task. Tasks still in queue are discarded.
+   */
+  ~PiiThreadPool();
+
+  /**
+   * Sets the number of worker threads. If the pool is running, extra
+   * threads will exit once they become idle, and missing threads are
+   * started on demand.
+   */
+  void setThreadCount(int threadCount);
+  /**
+   * Returns the target number of worker threads.
+   */
+  int threadCount() const;
+
+  /**
+   * Sets the maximum number of threads that may be running at the
+   * same time, including spare threads started to compensate for
+   * blocked workers. The default is four times [threadCount()].
+   */
+  void setMaxThreadCount(int maxThreadCount);
+  /**
+   * Returns the maximum number of threads.
+   */
+  int maxThreadCount() const;
+
+  /**
+   * Returns the number of worker threads currently alive.
+   */
+  int activeThreadCount() const;
+
+  /**
+   * Schedules *task* for execution. The pool does not take the
+   * ownership of the task, which must stay alive until its run()
+   * function has returned.
+   */
+  void submit(Task* task);
+
+  /**
+   * Announces that the calling worker thread is about to block. If
+   * the calling thread is not a worker of this pool, this function
+   * does nothing. Each call must be matched with [endBlocking()].
+   */
+  void beginBlocking();
+  /**
+   * Announces that the calling worker thread is no longer blocked.
+   */
+  void endBlocking();
+
+  /**
+   * Returns `true` if the calling thread is a worker in this pool,
+   * and `false` otherwise.
+   */
+  bool isWorkerThread() const;
+
+  /**
+   * Returns a process-wide pool with QThread::idealThreadCount()
+   * threads. Library functions that run in parallel use this pool.
+   */
+  static PiiThreadPool* globalInstance();
+
+private:
+  class Worker;
+  class Data;
+  Data* d;
+  PII_DISABLE_COPY(PiiThreadPool);
+};
+
+#endif //_PIITHREADPOOL_H
@@ -252,6 +252,31 @@ namespace Pii
    */
   template <bool rule, class T = int> struct OnlyIf : If<rule, Id<T>, Empty>::Type {};
 
+  /**
+   * A tester struct whose `boolValue` member evaluates statically to
+   * `true` if objects of type `T` can be moved to another memory
+   * location with a plain memcpy(), without calling a copy or move
+   * constructor. Primitive types, pointers and complex numbers are
+   * relocatable by default. Specialize this template for types that
+   * hold nothing but pointers to shared data, such as implicitly
+   * shared classes with a d pointer.
+   */
+  template <class T> struct IsRelocatable : Or<IsPrimitive<T>::boolValue, IsPointer<T>::boolValue> {};
+  template <class T> struct IsRelocatable<std::complex<T> > : True {};
+
+  /**
+   * A traits structure whose `share()` function is called when an
+   * object of type `T` is about to become visible to other threads,
+   * for example when it is stored into a PiiVariant. The default
+   * implementation does nothing. Specialize this template for types
+   * that use cheaper, non-atomic reference counting while confined
+   * to a single thread (see PiiTypelessMatrix::confineToThread()).
+   */
+  template <class T> struct ThreadSharing
+  {
+    static void share(const T&) {}
+  };
+
   /**
    * A tester struct whose `boolValue` member evaluates statically to
    * `true` if the template parameter `T` is a `const` type.
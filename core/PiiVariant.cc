@@ -14,12 +14,21 @@
  */
 
 #include "PiiVariant.h"
+#include "PiiMemoryPool.h"
+
+#ifdef PII_CXX11
+#  include <atomic>
+#endif
 
 #ifndef PII_NO_QT
+#  include <QReadWriteLock>
 #  include <PiiSerializableExport.h>
 #  include <PiiSerializationTraits.h>
 #  include <PiiSerialization.h>
 #  include <PiiQVariantWrapper.h>
+#else
+#  include <QMutex>
+#  include <QMutexLocker>
 #endif
 
 //PII_VARIANT_REGISTER_PRIMITIVE(TYPE, PREFIX, NAME) PII_REGISTER_VARIANT_TYPE(TYPE)
@@ -44,24 +53,61 @@ const char* PiiVariant::pValueStr = "value";
 PiiVariant::ConvertInit PiiVariant::_convertInit;
 
 
+PiiVariant::VTable* PiiVariant::_vTables[PiiVariant::FlatTypeCount];
+PiiVariant::ConverterFunction* PiiVariant::_converters[PiiVariant::FlatTypeCount];
+
+#ifndef PII_NO_QT
+typedef QReadWriteLock RegistryLock;
+typedef QReadLocker RegistryReadLocker;
+typedef QWriteLocker RegistryWriteLocker;
+#else
+// The standard library wrapper has no read-write lock. Lookups from
+// the hash tables are rare enough to share a plain mutex.
+typedef QMutex RegistryLock;
+typedef QMutexLocker RegistryReadLocker;
+typedef QMutexLocker RegistryWriteLocker;
+#endif
+
+// Serializes registrations and protects the hash tables.
+static RegistryLock* registryLock()
+{
+  static RegistryLock lock;
+  return &lock;
+}
+
+// Makes the entries written so far visible before a new converter
+// array is published to lock-free readers.
+static inline void publishBarrier()
+{
+#ifdef PII_CXX11
+  std::atomic_thread_fence(std::memory_order_release);
+#endif
+}
+
 QHash<unsigned int, PiiVariant::VTable*>* PiiVariant::hashVTables()
 {
   static QHash<unsigned int, VTable*> hash;
   return &hash;
 }
 
-PiiVariant::PiiVariant() :
-  _pVTable(0), _uiType(InvalidType)
+void PiiVariant::setVTable(unsigned int type, VTable* vTable)
 {
+  RegistryWriteLocker lock(registryLock());
+  if (type < FlatTypeCount)
+    _vTables[type] = vTable;
+  else
+    hashVTables()->insert(type, vTable);
 }
 
-PiiVariant::PiiVariant(const PiiVariant& other) :
-  _pVTable(other._pVTable), _uiType(other._uiType)
+PiiVariant::VTable* PiiVariant::overflowVTable(unsigned int type)
+{
+  RegistryReadLocker lock(registryLock());
+  return hashVTables()->value(type);
+}
+
+PiiVariant::PiiVariant() :
+  _pVTable(0), _uiType(InvalidType)
 {
-  if (other._pVTable != 0)
-    other._pVTable->constructCopy(*this, other);
-  else
-    _value = other._value;
 }
 
 PiiVariant& PiiVariant::operator= (const PiiVariant& other)
@@ -123,11 +169,6 @@ PiiVariant::~PiiVariant()
     _pVTable->destruct(*this);
 }
 
-PiiVariant::VTable* PiiVariant::vTableByType(unsigned int type)
-{
-  return hashVTables()->value(type);
-}
-
 const char* PiiVariant::typeName() const
 {
   return typeName(_uiType);
@@ -165,11 +206,11 @@ bool PiiVariant::canConvert(uint toType) const
   return canConvert(_uiType, toType);
 }
 
-PiiVariant::ConverterFunction PiiVariant::converter(uint fromType, uint toType)
+PiiVariant::ConverterFunction PiiVariant::overflowConverter(uint fromType, uint toType)
 {
+  RegistryReadLocker lock(registryLock());
   ConverterMap* pMap = converterMap();
-  quint64 uiKey = toKey(fromType, toType);
-  ConverterMap::iterator it = pMap->find(uiKey);
+  ConverterMap::iterator it = pMap->find(toKey(fromType, toType));
   if (it != pMap->end())
     return PII_ITERATOR_VALUE(it);
   return 0;
@@ -177,11 +218,30 @@ PiiVariant::ConverterFunction PiiVariant::converter(uint fromType, uint toType)
 
 void PiiVariant::setConverter(uint fromType, uint toType, ConverterFunction function)
 {
-  quint64 uiKey = toKey(fromType, toType);
-  if (function)
-    converterMap()->insert(uiKey, function);
+  RegistryWriteLocker lock(registryLock());
+  if (fromType < FlatTypeCount && toType < FlatTypeCount)
+    {
+      ConverterFunction* pConverters = _converters[fromType];
+      if (pConverters == 0)
+        {
+          if (function == 0)
+            return;
+          pConverters = new ConverterFunction[FlatTypeCount]();
+          pConverters[toType] = function;
+          publishBarrier();
+          _converters[fromType] = pConverters;
+        }
+      else
+        pConverters[toType] = function;
+    }
   else
-    converterMap()->remove(uiKey);
+    {
+      quint64 uiKey = toKey(fromType, toType);
+      if (function)
+        converterMap()->insert(uiKey, function);
+      else
+        converterMap()->remove(uiKey);
+    }
 }
 
 #define CONVERT_DEFAULT(FROM_TYPE, TO_TYPE) \
@@ -221,6 +281,33 @@ void* PiiVariant::data()
   return _pVTable->data(*this);
 }
 
+// Set once and never deleted.
+static PiiMemoryPool* pHeapPool = 0;
+
+void PiiVariant::setMemoryPool(PiiMemoryPool* pool)
+{
+  if (pHeapPool == 0)
+    pHeapPool = pool;
+}
+
+PiiMemoryPool* PiiVariant::memoryPool()
+{
+  return pHeapPool;
+}
+
+void* PiiVariant::allocateHeap(std::size_t bytes)
+{
+  void* pMemory = pHeapPool != 0 ? pHeapPool->allocate(bytes) : 0;
+  return pMemory != 0 ? pMemory : ::operator new(bytes);
+}
+
+void PiiVariant::deallocateHeap(void* ptr)
+{
+  // Objects created before the pool was set were allocated with new.
+  if (pHeapPool == 0 || !pHeapPool->deallocate(ptr))
+    ::operator delete(ptr);
+}
+
 #ifndef PII_NO_QT
 #  include <QVariant>
 
@@ -24,6 +24,8 @@
 #include <QHash>
 #include <QMap>
 #include <QList>
+#include <cstring>
+#include <new>
 
 #ifndef PII_NO_QT
 class QVariant;
@@ -37,6 +39,26 @@ class QVariant;
 
 class PiiGenericOutputArchive;
 class PiiGenericInputArchive;
+class PiiMemoryPool;
+
+/**
+ * The size of the buffer PiiVariant uses for storing objects without
+ * a heap allocation, in bytes. Objects whose size is at most this
+ * and whose alignment requirement does not exceed that of `double`
+ * are stored inline. The default value, 24, fits PiiMatrix,
+ * QString, PiiPoint<double>, std::complex<double> and other small
+ * value types. Values smaller than eight will be ignored. Define the
+ * macro before including PiiVariant.h to change the default.
+ *
+ * ! The size of PiiVariant depends on this value. Every piece of
+ * code linked together must therefore be compiled with the same
+ * value.
+ *
+ * @relates PiiVariant
+ */
+#ifndef PII_VARIANT_BUFFER_SIZE
+#  define PII_VARIANT_BUFFER_SIZE 24
+#endif
 
 /**
  * Declares a new custom variant type. Use this macro in a .h file.
@@ -308,6 +330,20 @@ public:
    */
   template <class T> explicit PiiVariant(const T& value);
 
+#ifdef PII_CXX11
+  /**
+   * Creates a variant by moving *value* into it. This avoids a
+   * deep copy (or reference count traffic in the case of implicitly
+   * shared types) when the value is a temporary, such as the return
+   * value of a function. Primitive types are always copied.
+   */
+  template <class T> explicit PiiVariant(T&& value,
+                                         typename Pii::OnlyIf<!Pii::IsReference<T>::boolValue &&
+                                                              !Pii::IsConst<T>::boolValue &&
+                                                              !Pii::IsPrimitive<T>::boolValue &&
+                                                              !Pii::IsSame<T,PiiVariant>::boolValue>::Type = 0);
+#endif
+
   /**
    * Creates a variant with a non-default type ID. If you want to give
    * a special meaning to a variant while still storing its actual
@@ -327,13 +363,30 @@ public:
   /**
    * Creates a copy of *other*.
    */
-  PiiVariant(const PiiVariant& other);
+  inline PiiVariant(const PiiVariant& other);
 
   /**
    * Copies the contents of *other* to `this`.
    */
   PiiVariant& operator= (const PiiVariant& other);
 
+#ifdef PII_CXX11
+  /**
+   * Moves the contents of *other* to a new variant and leaves *other*
+   * invalid. Heap-allocated objects change owner without being
+   * copied, and relocatable objects (see Pii::IsRelocatable) stored
+   * in the internal buffer are moved with a plain memory copy.
+   * Neither needs to touch reference counts of implicitly shared
+   * objects.
+   */
+  inline PiiVariant(PiiVariant&& other);
+  /**
+   * Releases the current contents of this variant and moves the
+   * contents of *other* in its place. *other* will be left invalid.
+   */
+  inline PiiVariant& operator= (PiiVariant&& other);
+#endif
+
   /**
    * Destroys the variant.
    */
@@ -513,14 +566,72 @@ public:
   /**
    * Returns the conversion function used to convert *fromType* to
    * *toType*. If no such converter is registered, returns zero.
+   *
+   * Converters between built-in types are looked up from a flat
+   * table without locking. Type IDs greater than or equal to 0x100
+   * are looked up from a hash table, which is slower.
+   */
+  static inline ConverterFunction converter(uint fromType, uint toType);
+  /**
+   * Returns the conversion function used to convert *From* to *To*.
+   * Since both type IDs are compile-time constants, the range checks
+   * are resolved by the compiler, and finding a converter between
+   * built-in types costs two memory reads.
+   *
+   * ~~~(c++)
+   * PiiVariant::ConverterFunction convert = PiiVariant::converter<int,double>();
+   * ~~~
+   */
+  template <class From, class To> static inline ConverterFunction converter();
+
+  /**
+   * Returns the number of bytes of memory occupied by this variant
+   * and the object it holds. The figure includes `sizeof(PiiVariant)`,
+   * the heap-allocated copy of the object if it doesn't fit into the
+   * internal buffer, and the memory owned by the object itself as
+   * reported by [Pii::MemoryUsage]. Implicitly shared data is counted
+   * in full even if it is shared with other objects.
+   *
+   * ~~~(c++)
+   * PiiVariant var(PiiMatrix<double>(100, 100));
+   * qint64 lBytes = var.memoryUsage(); // > 80000
+   * ~~~
    */
-  static ConverterFunction converter(uint fromType, uint toType);
+  inline qint64 memoryUsage() const;
 
   /// @internal
   const void* data() const;
   /// @internal
   void* data();
 
+  /**
+   * Sets the memory pool used for storing objects that don't fit into
+   * the internal buffer. By default, such objects are allocated with
+   * `new`. If many threads create and destroy large objects at a high
+   * rate, a pool with per-thread caches avoids contention in the
+   * system allocator. If the pool is full, `new` will be used as
+   * before.
+   *
+   * The pool can be set only once, preferably at program start-up
+   * before any other threads have been started. Subsequent calls are
+   * ignored. The pool must never be deleted. Objects created before
+   * the pool was set will be released correctly.
+   *
+   * ~~~(c++)
+   * int main(int argc, char* argv[])
+   * {
+   *   PiiVariant::setMemoryPool(new PiiMemoryPool(256, 1 << 20));
+   *   // ...
+   * }
+   * ~~~
+   */
+  static void setMemoryPool(PiiMemoryPool* pool);
+  /**
+   * Returns the memory pool used for heap-allocated objects, or 0 if
+   * no pool has been set.
+   */
+  static PiiMemoryPool* memoryPool();
+
 private:
   /* This class plays chicken with binary compatibility. There is no
      d-pointer because PiiVariant is the most common data type used in
@@ -537,6 +648,9 @@ private:
   template <unsigned int typeId> struct TypeIdMapper;
   template <unsigned int typeId> friend struct TypeIdMapper;
   typedef QMap<quint64, ConverterFunction> ConverterMap;
+  // Type IDs below this limit are stored in flat tables. All built-in
+  // types fall into this range.
+  enum { FlatTypeCount = 0x100 };
   struct ConvertInit { ConvertInit(); };
   static ConvertInit _convertInit;
 
@@ -548,12 +662,16 @@ private:
   struct VTable
   {
     void (*constructCopy)(PiiVariant&, const PiiVariant&);
+    // Constructs the first argument from the second one and destroys
+    // the second.
+    void (*constructMove)(PiiVariant&, PiiVariant&);
     void (*destruct)(PiiVariant&);
     void (*copy)(PiiVariant&, const PiiVariant&);
     void* (*data)(const PiiVariant&);
     void (*save)(PiiGenericOutputArchive&, const PiiVariant&);
     void (*load)(PiiGenericInputArchive&, PiiVariant&);
     bool (*equals)(const PiiVariant&, const PiiVariant&);
+    qint64 (*memoryUsage)(const PiiVariant&);
     const char* typeName;
   } *_pVTable;
 
@@ -574,6 +692,10 @@ private:
     bool bValue;
     void* pValue;
   };
+  // The maximum size for a stored object.
+  enum { InternalBufferSize = PII_VARIANT_BUFFER_SIZE > int(sizeof(Value)) ?
+         PII_VARIANT_BUFFER_SIZE : int(sizeof(Value)) };
+
   // This union holds either a pointer to a heap-allocated object, a
   // primitive value as such, or a non-pod type in a preallocated
   // buffer.
@@ -581,37 +703,129 @@ private:
   {
     void* _pointer;
     Value _value;
-    char _buffer[sizeof(Value)];
+    char _buffer[InternalBufferSize];
   };
 
-  // The maximum size for a stored object equals the size of the Value
-  // union.
-  enum { InternalBufferSize = sizeof(Value) };
+  // Objects that fit into the buffer are stored inline. The buffer is
+  // aligned like Value.
+  template <class T> struct IsSmall
+  {
+    enum { boolValue = sizeof(T) <= InternalBufferSize && Q_ALIGNOF(T) <= Q_ALIGNOF(Value) };
+  };
 
   template <class T> inline const T*
-    ptrAs(typename Pii::OnlyIf<sizeof(T) <= InternalBufferSize>::Type = 0) const
+    ptrAs(typename Pii::OnlyIf<IsSmall<T>::boolValue>::Type = 0) const
   {
     return reinterpret_cast<const T*>(_buffer);
   }
   template <class T> inline T*
-    ptrAs(typename Pii::OnlyIf<sizeof(T) <= InternalBufferSize>::Type = 0)
+    ptrAs(typename Pii::OnlyIf<IsSmall<T>::boolValue>::Type = 0)
   {
     return reinterpret_cast<T*>(_buffer);
   }
 
   template <class T> inline const T*
-    ptrAs(typename Pii::OnlyIf<(sizeof(T) > InternalBufferSize)>::Type = 0) const
+    ptrAs(typename Pii::OnlyIf<!IsSmall<T>::boolValue>::Type = 0) const
   {
     return reinterpret_cast<const T*>(_pointer);
   }
 
   template <class T> inline T*
-    ptrAs(typename Pii::OnlyIf<(sizeof(T) > InternalBufferSize)>::Type = 0)
+    ptrAs(typename Pii::OnlyIf<!IsSmall<T>::boolValue>::Type = 0)
   {
     return reinterpret_cast<T*>(_pointer);
   }
 
-  static VTable* vTableByType(unsigned int type);
+  // Heap storage for large objects. Memory is taken from the pool if
+  // one has been set. The pool only guarantees 16-byte alignment.
+  static void* allocateHeap(std::size_t bytes);
+  static void deallocateHeap(void* ptr);
+  template <class T> static T* createHeapObject(const T& value)
+  {
+    if (Q_ALIGNOF(T) > 16)
+      return new T(value);
+    void* pMemory = allocateHeap(sizeof(T));
+    try
+      {
+        return new (pMemory) T(value);
+      }
+    catch (...)
+      {
+        deallocateHeap(pMemory);
+        throw;
+      }
+  }
+#ifdef PII_CXX11
+  template <class T> static T* createHeapObject(T&& value)
+  {
+    if (Q_ALIGNOF(T) > 16)
+      return new T(std::move(value));
+    void* pMemory = allocateHeap(sizeof(T));
+    try
+      {
+        return new (pMemory) T(std::move(value));
+      }
+    catch (...)
+      {
+        deallocateHeap(pMemory);
+        throw;
+      }
+  }
+#endif
+  template <class T> static T* createHeapObject()
+  {
+    if (Q_ALIGNOF(T) > 16)
+      return new T;
+    void* pMemory = allocateHeap(sizeof(T));
+    try
+      {
+        return new (pMemory) T;
+      }
+    catch (...)
+      {
+        deallocateHeap(pMemory);
+        throw;
+      }
+  }
+  template <class T> static void destroyHeapObject(T* object)
+  {
+    if (Q_ALIGNOF(T) > 16)
+      delete object;
+    else
+      {
+        object->~T();
+        deallocateHeap(object);
+      }
+  }
+
+  // Copies the raw contents of the buffer.
+  inline void copyBuffer(const PiiVariant& other)
+  {
+    std::memcpy(_buffer, other._buffer, InternalBufferSize);
+  }
+
+  /* Registries. The flat tables are zero-initialized before any
+     static constructor is run and are read without locking. Entries
+     are only written while registering types and converters, which
+     usually happens during static initialization. Types whose ID
+     doesn't fit into the flat tables are stored in hashVTables() and
+     converterMap(), both protected by a lock.
+
+     _converters is indexed by the source type. Each non-zero entry
+     points to an array of FlatTypeCount converters indexed by the
+     target type. The arrays are allocated when the first converter
+     for a source type is set and never released.
+   */
+  static VTable* _vTables[FlatTypeCount];
+  static ConverterFunction* _converters[FlatTypeCount];
+
+  static inline VTable* vTableByType(unsigned int type)
+  {
+    return type < FlatTypeCount ? _vTables[type] : overflowVTable(type);
+  }
+  static void setVTable(unsigned int type, VTable* vTable);
+  static VTable* overflowVTable(unsigned int type);
+  static ConverterFunction overflowConverter(uint fromType, uint toType);
   static QHash<unsigned int, VTable*>* hashVTables();
   static ConverterMap* converterMap();
   template <class From, class To>
@@ -636,19 +850,102 @@ namespace Pii
    * There is no default implementation.
    */
   template <class T> inline constexpr unsigned int typeId();
+
+  /**
+   * A traits structure that tells how many bytes of memory an object
+   * of type `T` owns in addition to `sizeof(T)`. This is used by
+   * [PiiVariant::memoryUsage()]. The default implementation returns
+   * zero, which is correct for types that don't allocate memory.
+   * Specialize this structure for types that own heap-allocated
+   * buffers.
+   *
+   * ~~~(c++)
+   * namespace Pii
+   * {
+   *   template <> struct MemoryUsage<MyBuffer>
+   *   {
+   *     static qint64 heapBytes(const MyBuffer& buffer) { return buffer.capacity(); }
+   *   };
+   * }
+   * ~~~
+   */
+  template <class T> struct MemoryUsage
+  {
+    static qint64 heapBytes(const T&) { return 0; }
+  };
 }
 
 /// @hide
 
+inline PiiVariant::PiiVariant(const PiiVariant& other) :
+  _pVTable(other._pVTable), _uiType(other._uiType)
+{
+  // Primitive values and control tags need no function call.
+  if (other._pVTable != 0)
+    other._pVTable->constructCopy(*this, other);
+  else
+    _value = other._value;
+}
+
+#ifdef PII_CXX11
+inline PiiVariant::PiiVariant(PiiVariant&& other) :
+  _pVTable(other._pVTable), _uiType(other._uiType)
+{
+  if (other._pVTable != 0)
+    other._pVTable->constructMove(*this, other);
+  else
+    _value = other._value;
+  other._pVTable = 0;
+  other._uiType = InvalidType;
+}
+
+inline PiiVariant& PiiVariant::operator= (PiiVariant&& other)
+{
+  if (&other != this)
+    {
+      if (_pVTable != 0)
+        _pVTable->destruct(*this);
+      _pVTable = other._pVTable;
+      _uiType = other._uiType;
+      if (other._pVTable != 0)
+        other._pVTable->constructMove(*this, other);
+      else
+        _value = other._value;
+      other._pVTable = 0;
+      other._uiType = InvalidType;
+    }
+  return *this;
+}
+#endif
+
 template <class T> PiiVariant::PiiVariant(const T& value) :
   _pVTable(&VTableImpl<T>::instance),
   _uiType(Pii::typeId<T>())
 {
-  if (sizeof(T) <= InternalBufferSize)
+  // Variants are passed between threads.
+  Pii::ThreadSharing<T>::share(value);
+  if (IsSmall<T>::boolValue)
     new ((void*)_buffer) T(value);
   else
-    _pointer = new T(value);
+    _pointer = createHeapObject<T>(value);
+}
+
+#ifdef PII_CXX11
+template <class T> PiiVariant::PiiVariant(T&& value,
+                                          typename Pii::OnlyIf<!Pii::IsReference<T>::boolValue &&
+                                                               !Pii::IsConst<T>::boolValue &&
+                                                               !Pii::IsPrimitive<T>::boolValue &&
+                                                               !Pii::IsSame<T,PiiVariant>::boolValue>::Type) :
+  _pVTable(&VTableImpl<T>::instance),
+  _uiType(Pii::typeId<T>())
+{
+  Pii::ThreadSharing<T>::share(value);
+  if (IsSmall<T>::boolValue)
+    new ((void*)_buffer) T(std::move(value));
+  else
+    _pointer = createHeapObject<T>(std::move(value));
 }
+#endif
 
 template <class T> PiiVariant::PiiVariant(T value, unsigned int typeId, typename Pii::OnlyPrimitive<T>::Type) :
   _pVTable(0),
@@ -661,10 +958,11 @@ template <class T> PiiVariant::PiiVariant(T value, unsigned int typeId, typename
   _pVTable(&VTableImpl<T>::instance),
   _uiType(typeId)
 {
-  if (sizeof(T) <= InternalBufferSize)
+  Pii::ThreadSharing<T>::share(value);
+  if (IsSmall<T>::boolValue)
     new ((void*)_buffer) T(value);
   else
-    _pointer = new T(value);
+    _pointer = createHeapObject<T>(value);
 }
 
 template <class T> struct PiiVariant::SmallObjectFunctions
@@ -674,6 +972,27 @@ template <class T> struct PiiVariant::SmallObjectFunctions
     new (to._buffer) T(*from.ptrAs<T>());
   }
 
+  static void constructMoveImpl(PiiVariant& to, PiiVariant& from)
+  {
+    constructMove(to, from, typename Pii::If<Pii::IsRelocatable<T>::boolValue || !QTypeInfo<T>::isStatic,
+                                             Pii::True, Pii::False>::Type());
+  }
+
+  static void constructMove(PiiVariant& to, PiiVariant& from, Pii::True)
+  {
+    to.copyBuffer(from);
+  }
+
+  static void constructMove(PiiVariant& to, PiiVariant& from, Pii::False)
+  {
+#ifdef PII_CXX11
+    new (to._buffer) T(std::move(*from.ptrAs<T>()));
+#else
+    new (to._buffer) T(*from.ptrAs<T>());
+#endif
+    from.ptrAs<T>()->~T();
+  }
+
   static void destructImpl(PiiVariant& var)
   {
     var.ptrAs<T>()->~T();
@@ -694,6 +1013,11 @@ template <class T> struct PiiVariant::SmallObjectFunctions
     return Pii::ptrEquals<T>(a.ptrAs<T>(), b.ptrAs<T>());
   }
 
+  static qint64 memoryUsageImpl(const PiiVariant& var)
+  {
+    return qint64(sizeof(PiiVariant)) + Pii::MemoryUsage<T>::heapBytes(*var.ptrAs<T>());
+  }
+
 #ifndef PII_NO_QT
   static void saveImpl(PiiGenericOutputArchive& archive, const PiiVariant& var)
   {
@@ -712,12 +1036,17 @@ template <class T> struct PiiVariant::LargeObjectFunctions
 {
   static void constructCopyImpl(PiiVariant& to, const PiiVariant& from)
   {
-    to._pointer = new T(*from.ptrAs<T>());
+    to._pointer = createHeapObject<T>(*from.ptrAs<T>());
+  }
+
+  static void constructMoveImpl(PiiVariant& to, PiiVariant& from)
+  {
+    to._pointer = from._pointer;
   }
 
   static void destructImpl(PiiVariant& var)
   {
-    delete var.ptrAs<T>();
+    destroyHeapObject(var.ptrAs<T>());
   }
 
   static void copyImpl(PiiVariant& to, const PiiVariant& from)
@@ -735,6 +1064,11 @@ template <class T> struct PiiVariant::LargeObjectFunctions
     return Pii::ptrEquals<T>(a.ptrAs<T>(), b.ptrAs<T>());
   }
 
+  static qint64 memoryUsageImpl(const PiiVariant& var)
+  {
+    return qint64(sizeof(PiiVariant) + sizeof(T)) + Pii::MemoryUsage<T>::heapBytes(*var.ptrAs<T>());
+  }
+
 #ifndef PII_NO_QT
   static void saveImpl(PiiGenericOutputArchive& archive, const PiiVariant& var)
   {
@@ -743,7 +1077,7 @@ template <class T> struct PiiVariant::LargeObjectFunctions
 
   static void loadImpl(PiiGenericInputArchive& archive, PiiVariant& var)
   {
-    var._pointer = new T;
+    var._pointer = createHeapObject<T>();
     archive >> *reinterpret_cast<T*>(var._pointer);
   }
 #endif
@@ -751,27 +1085,29 @@ template <class T> struct PiiVariant::LargeObjectFunctions
 
 template <class T> struct PiiVariant::VTableImpl :
   PiiVariant::VTable,
-  Pii::If<sizeof(T) <= PiiVariant::InternalBufferSize,
+  Pii::If<PiiVariant::IsSmall<T>::boolValue,
                        PiiVariant::SmallObjectFunctions<T>,
                        PiiVariant::LargeObjectFunctions<T> >::Type
 {
-  typedef typename Pii::If<sizeof(T) <= PiiVariant::InternalBufferSize,
+  typedef typename Pii::If<PiiVariant::IsSmall<T>::boolValue,
                            PiiVariant::SmallObjectFunctions<T>,
                            PiiVariant::LargeObjectFunctions<T> >::Type ParentType;
   VTableImpl(unsigned int type, const char* name)
   {
     this->constructCopy = ParentType::constructCopyImpl;
+    this->constructMove = ParentType::constructMoveImpl;
     this->destruct = ParentType::destructImpl;
     this->copy = ParentType::copyImpl;
     this->data = ParentType::dataImpl;
     this->equals = ParentType::equalsImpl;
+    this->memoryUsage = ParentType::memoryUsageImpl;
 #ifndef PII_NO_QT
     this->save = ParentType::saveImpl;
     this->load = ParentType::loadImpl;
 #endif
 
     this->typeName = name;
-    PiiVariant::hashVTables()->insert(type, this);
+    PiiVariant::setVTable(type, this);
   }
   // PENDING this may trigger static initialization order fiasco with TypeIdMapper
   static VTableImpl instance;
@@ -781,7 +1117,7 @@ template <unsigned int typeId> struct PiiVariant::TypeIdMapper
 {
   TypeIdMapper(unsigned int type)
   {
-    PiiVariant::hashVTables()->insert(typeId, PiiVariant::vTableByType(type));
+    PiiVariant::setVTable(typeId, PiiVariant::vTableByType(type));
   }
   static TypeIdMapper instance;
 };
@@ -846,6 +1182,27 @@ namespace Pii
 }
 #endif
 
+PiiVariant::ConverterFunction PiiVariant::converter(uint fromType, uint toType)
+{
+  if (fromType < FlatTypeCount && toType < FlatTypeCount)
+    {
+      ConverterFunction* pConverters = _converters[fromType];
+      return pConverters != 0 ? pConverters[toType] : 0;
+    }
+  return overflowConverter(fromType, toType);
+}
+
+qint64 PiiVariant::memoryUsage() const
+{
+  // Primitive values and control tags live in the internal buffer.
+  return _pVTable != 0 ? _pVTable->memoryUsage(*this) : qint64(sizeof(PiiVariant));
+}
+
+template <class From, class To> PiiVariant::ConverterFunction PiiVariant::converter()
+{
+  return converter(Pii::typeId<From>(), Pii::typeId<To>());
+}
+
 template <class T> bool PiiVariant::convertTo(T& value) const
 {
   if (_uiType == Pii::typeId<T>())
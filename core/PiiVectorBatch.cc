@@ -0,0 +1,315 @@
+/* This file is part of Into.
+ * Copyright (C) Intopii 2013.
+ * All rights reserved.
+ *
+ * Licensees holding a commercial Into license may use this file in
+ * accordance with the commercial license agreement. Please see
+ * LICENSE.commercial for commercial licensing terms.
+ *
+ * Alternatively, this file may be used under the terms of the GNU
+ * Affero General Public License version 3 as published by the Free
+ * Software Foundation. In addition, Intopii gives you special rights
+ * to use Into as a part of open source software projects. Please
+ * refer to LICENSE.AGPL3 for details.
+ */
+
+#include "PiiVectorBatch.h"
+#include "PiiCpu.h"
+
+// All kernels evaluate (a*x + b*y) + c without fused multiply-add so
+// that they produce the same results as the generic code.
+
+namespace Pii
+{
+  namespace
+  {
+    typedef void (*FloatSoaFunction)(const float*, const float*, const float*, float*, float*, int);
+    typedef void (*DoubleSoaFunction)(const double*, const double*, const double*, double*, double*, int);
+    typedef void (*FloatInterleavedFunction)(const float*, const float*, float*, int);
+    typedef void (*DoubleInterleavedFunction)(const double*, const double*, double*, int);
+
+    template <class T> void transformPointsGeneric(const T* transform,
+                                                   const T* x, const T* y,
+                                                   T* transformedX, T* transformedY,
+                                                   int n)
+    {
+      transformPoints<T>(transform, x, y, transformedX, transformedY, n);
+    }
+
+    template <class T> void transformPackedPointsGeneric(const T* transform, const T* source, T* target, int n)
+    {
+      transformInterleavedPoints<T>(transform, source, 2 * sizeof(T), target, 2 * sizeof(T), n);
+    }
+
+#if defined(PII_X86_SIMD)
+    PII_CPU_TARGET("sse2")
+    void transformPointsSse2(const float* transform,
+                             const float* x, const float* y,
+                             float* transformedX, float* transformedY,
+                             int n)
+    {
+      const __m128 a = _mm_set1_ps(transform[0]), b = _mm_set1_ps(transform[1]), c = _mm_set1_ps(transform[2]);
+      const __m128 d = _mm_set1_ps(transform[3]), e = _mm_set1_ps(transform[4]), f = _mm_set1_ps(transform[5]);
+      int i = 0;
+      for (; i <= n-4; i += 4)
+        {
+          const __m128 vx = _mm_loadu_ps(x + i), vy = _mm_loadu_ps(y + i);
+          _mm_storeu_ps(transformedX + i, _mm_add_ps(_mm_add_ps(_mm_mul_ps(a, vx), _mm_mul_ps(b, vy)), c));
+          _mm_storeu_ps(transformedY + i, _mm_add_ps(_mm_add_ps(_mm_mul_ps(d, vx), _mm_mul_ps(e, vy)), f));
+        }
+      transformPoints<float>(transform, x + i, y + i, transformedX + i, transformedY + i, n - i);
+    }
+
+    PII_CPU_TARGET("avx")
+    void transformPointsAvx(const float* transform,
+                            const float* x, const float* y,
+                            float* transformedX, float* transformedY,
+                            int n)
+    {
+      const __m256 a = _mm256_set1_ps(transform[0]), b = _mm256_set1_ps(transform[1]), c = _mm256_set1_ps(transform[2]);
+      const __m256 d = _mm256_set1_ps(transform[3]), e = _mm256_set1_ps(transform[4]), f = _mm256_set1_ps(transform[5]);
+      int i = 0;
+      for (; i <= n-8; i += 8)
+        {
+          const __m256 vx = _mm256_loadu_ps(x + i), vy = _mm256_loadu_ps(y + i);
+          _mm256_storeu_ps(transformedX + i, _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(a, vx), _mm256_mul_ps(b, vy)), c));
+          _mm256_storeu_ps(transformedY + i, _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(d, vx), _mm256_mul_ps(e, vy)), f));
+        }
+      transformPoints<float>(transform, x + i, y + i, transformedX + i, transformedY + i, n - i);
+    }
+
+    PII_CPU_TARGET("sse2")
+    void transformPointsSse2(const double* transform,
+                             const double* x, const double* y,
+                             double* transformedX, double* transformedY,
+                             int n)
+    {
+      const __m128d a = _mm_set1_pd(transform[0]), b = _mm_set1_pd(transform[1]), c = _mm_set1_pd(transform[2]);
+      const __m128d d = _mm_set1_pd(transform[3]), e = _mm_set1_pd(transform[4]), f = _mm_set1_pd(transform[5]);
+      int i = 0;
+      for (; i <= n-2; i += 2)
+        {
+          const __m128d vx = _mm_loadu_pd(x + i), vy = _mm_loadu_pd(y + i);
+          _mm_storeu_pd(transformedX + i, _mm_add_pd(_mm_add_pd(_mm_mul_pd(a, vx), _mm_mul_pd(b, vy)), c));
+          _mm_storeu_pd(transformedY + i, _mm_add_pd(_mm_add_pd(_mm_mul_pd(d, vx), _mm_mul_pd(e, vy)), f));
+        }
+      transformPoints<double>(transform, x + i, y + i, transformedX + i, transformedY + i, n - i);
+    }
+
+    PII_CPU_TARGET("avx")
+    void transformPointsAvx(const double* transform,
+                            const double* x, const double* y,
+                            double* transformedX, double* transformedY,
+                            int n)
+    {
+      const __m256d a = _mm256_set1_pd(transform[0]), b = _mm256_set1_pd(transform[1]), c = _mm256_set1_pd(transform[2]);
+      const __m256d d = _mm256_set1_pd(transform[3]), e = _mm256_set1_pd(transform[4]), f = _mm256_set1_pd(transform[5]);
+      int i = 0;
+      for (; i <= n-4; i += 4)
+        {
+          const __m256d vx = _mm256_loadu_pd(x + i), vy = _mm256_loadu_pd(y + i);
+          _mm256_storeu_pd(transformedX + i, _mm256_add_pd(_mm256_add_pd(_mm256_mul_pd(a, vx), _mm256_mul_pd(b, vy)), c));
+          _mm256_storeu_pd(transformedY + i, _mm256_add_pd(_mm256_add_pd(_mm256_mul_pd(d, vx), _mm256_mul_pd(e, vy)), f));
+        }
+      transformPoints<double>(transform, x + i, y + i, transformedX + i, transformedY + i, n - i);
+    }
+
+    // Interleaved kernels duplicate x and y into both halves of a
+    // point: (x, x) * (a, d) + (y, y) * (b, e) + (c, f).
+
+    PII_CPU_TARGET("sse2")
+    void transformPackedPointsSse2(const float* transform, const float* source, float* target, int n)
+    {
+      const __m128 ad = _mm_setr_ps(transform[0], transform[3], transform[0], transform[3]);
+      const __m128 be = _mm_setr_ps(transform[1], transform[4], transform[1], transform[4]);
+      const __m128 cf = _mm_setr_ps(transform[2], transform[5], transform[2], transform[5]);
+      int i = 0;
+      for (; i <= n-2; i += 2)
+        {
+          const __m128 v = _mm_loadu_ps(source + 2*i);
+          const __m128 xx = _mm_shuffle_ps(v, v, _MM_SHUFFLE(2,2,0,0));
+          const __m128 yy = _mm_shuffle_ps(v, v, _MM_SHUFFLE(3,3,1,1));
+          _mm_storeu_ps(target + 2*i, _mm_add_ps(_mm_add_ps(_mm_mul_ps(ad, xx), _mm_mul_ps(be, yy)), cf));
+        }
+      transformPackedPointsGeneric<float>(transform, source + 2*i, target + 2*i, n - i);
+    }
+
+    PII_CPU_TARGET("avx")
+    void transformPackedPointsAvx(const float* transform, const float* source, float* target, int n)
+    {
+      const __m256 ad = _mm256_setr_ps(transform[0], transform[3], transform[0], transform[3],
+                                       transform[0], transform[3], transform[0], transform[3]);
+      const __m256 be = _mm256_setr_ps(transform[1], transform[4], transform[1], transform[4],
+                                       transform[1], transform[4], transform[1], transform[4]);
+      const __m256 cf = _mm256_setr_ps(transform[2], transform[5], transform[2], transform[5],
+                                       transform[2], transform[5], transform[2], transform[5]);
+      int i = 0;
+      for (; i <= n-4; i += 4)
+        {
+          const __m256 v = _mm256_loadu_ps(source + 2*i);
+          const __m256 xx = _mm256_shuffle_ps(v, v, _MM_SHUFFLE(2,2,0,0));
+          const __m256 yy = _mm256_shuffle_ps(v, v, _MM_SHUFFLE(3,3,1,1));
+          _mm256_storeu_ps(target + 2*i, _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(ad, xx), _mm256_mul_ps(be, yy)), cf));
+        }
+      transformPackedPointsGeneric<float>(transform, source + 2*i, target + 2*i, n - i);
+    }
+
+    PII_CPU_TARGET("sse2")
+    void transformPackedPointsSse2(const double* transform, const double* source, double* target, int n)
+    {
+      const __m128d ad = _mm_setr_pd(transform[0], transform[3]);
+      const __m128d be = _mm_setr_pd(transform[1], transform[4]);
+      const __m128d cf = _mm_setr_pd(transform[2], transform[5]);
+      for (int i=0; i<n; ++i)
+        {
+          const __m128d v = _mm_loadu_pd(source + 2*i);
+          const __m128d xx = _mm_unpacklo_pd(v, v), yy = _mm_unpackhi_pd(v, v);
+          _mm_storeu_pd(target + 2*i, _mm_add_pd(_mm_add_pd(_mm_mul_pd(ad, xx), _mm_mul_pd(be, yy)), cf));
+        }
+    }
+
+    PII_CPU_TARGET("avx")
+    void transformPackedPointsAvx(const double* transform, const double* source, double* target, int n)
+    {
+      const __m256d ad = _mm256_setr_pd(transform[0], transform[3], transform[0], transform[3]);
+      const __m256d be = _mm256_setr_pd(transform[1], transform[4], transform[1], transform[4]);
+      const __m256d cf = _mm256_setr_pd(transform[2], transform[5], transform[2], transform[5]);
+      int i = 0;
+      for (; i <= n-2; i += 2)
+        {
+          const __m256d v = _mm256_loadu_pd(source + 2*i);
+          // unpack works within 128-bit lanes, one point per lane.
+          const __m256d xx = _mm256_unpacklo_pd(v, v), yy = _mm256_unpackhi_pd(v, v);
+          _mm256_storeu_pd(target + 2*i, _mm256_add_pd(_mm256_add_pd(_mm256_mul_pd(ad, xx), _mm256_mul_pd(be, yy)), cf));
+        }
+      transformPackedPointsGeneric<double>(transform, source + 2*i, target + 2*i, n - i);
+    }
+#endif
+
+#if defined(PII_NEON_SIMD)
+    void transformPointsNeon(const float* transform,
+                             const float* x, const float* y,
+                             float* transformedX, float* transformedY,
+                             int n)
+    {
+      const float32x4_t a = vdupq_n_f32(transform[0]), b = vdupq_n_f32(transform[1]), c = vdupq_n_f32(transform[2]);
+      const float32x4_t d = vdupq_n_f32(transform[3]), e = vdupq_n_f32(transform[4]), f = vdupq_n_f32(transform[5]);
+      int i = 0;
+      for (; i <= n-4; i += 4)
+        {
+          const float32x4_t vx = vld1q_f32(x + i), vy = vld1q_f32(y + i);
+          vst1q_f32(transformedX + i, vaddq_f32(vaddq_f32(vmulq_f32(a, vx), vmulq_f32(b, vy)), c));
+          vst1q_f32(transformedY + i, vaddq_f32(vaddq_f32(vmulq_f32(d, vx), vmulq_f32(e, vy)), f));
+        }
+      transformPoints<float>(transform, x + i, y + i, transformedX + i, transformedY + i, n - i);
+    }
+
+    void transformPackedPointsNeon(const float* transform, const float* source, float* target, int n)
+    {
+      const float32x4_t a = vdupq_n_f32(transform[0]), b = vdupq_n_f32(transform[1]), c = vdupq_n_f32(transform[2]);
+      const float32x4_t d = vdupq_n_f32(transform[3]), e = vdupq_n_f32(transform[4]), f = vdupq_n_f32(transform[5]);
+      int i = 0;
+      for (; i <= n-4; i += 4)
+        {
+          // Deinterleave four points, transform and interleave back.
+          const float32x4x2_t v = vld2q_f32(source + 2*i);
+          float32x4x2_t result;
+          result.val[0] = vaddq_f32(vaddq_f32(vmulq_f32(a, v.val[0]), vmulq_f32(b, v.val[1])), c);
+          result.val[1] = vaddq_f32(vaddq_f32(vmulq_f32(d, v.val[0]), vmulq_f32(e, v.val[1])), f);
+          vst2q_f32(target + 2*i, result);
+        }
+      transformPackedPointsGeneric<float>(transform, source + 2*i, target + 2*i, n - i);
+    }
+#endif
+
+    const PiiCpuDispatcher<FloatSoaFunction>& floatSoaKernels()
+    {
+      static const PiiCpuDispatcher<FloatSoaFunction> kernels =
+        PiiCpuDispatcher<FloatSoaFunction>(transformPointsGeneric<float>)
+#if defined(PII_X86_SIMD)
+        .add(Sse2CpuFeature, transformPointsSse2)
+        .add(AvxCpuFeature, transformPointsAvx)
+#elif defined(PII_NEON_SIMD)
+        .add(NeonCpuFeature, transformPointsNeon)
+#endif
+        ;
+      return kernels;
+    }
+
+    const PiiCpuDispatcher<DoubleSoaFunction>& doubleSoaKernels()
+    {
+      static const PiiCpuDispatcher<DoubleSoaFunction> kernels =
+        PiiCpuDispatcher<DoubleSoaFunction>(transformPointsGeneric<double>)
+#if defined(PII_X86_SIMD)
+        .add(Sse2CpuFeature, transformPointsSse2)
+        .add(AvxCpuFeature, transformPointsAvx)
+#endif
+        ;
+      return kernels;
+    }
+
+    const PiiCpuDispatcher<FloatInterleavedFunction>& floatInterleavedKernels()
+    {
+      static const PiiCpuDispatcher<FloatInterleavedFunction> kernels =
+        PiiCpuDispatcher<FloatInterleavedFunction>(transformPackedPointsGeneric<float>)
+#if defined(PII_X86_SIMD)
+        .add(Sse2CpuFeature, transformPackedPointsSse2)
+        .add(AvxCpuFeature, transformPackedPointsAvx)
+#elif defined(PII_NEON_SIMD)
+        .add(NeonCpuFeature, transformPackedPointsNeon)
+#endif
+        ;
+      return kernels;
+    }
+
+    const PiiCpuDispatcher<DoubleInterleavedFunction>& doubleInterleavedKernels()
+    {
+      static const PiiCpuDispatcher<DoubleInterleavedFunction> kernels =
+        PiiCpuDispatcher<DoubleInterleavedFunction>(transformPackedPointsGeneric<double>)
+#if defined(PII_X86_SIMD)
+        .add(Sse2CpuFeature, transformPackedPointsSse2)
+        .add(AvxCpuFeature, transformPackedPointsAvx)
+#endif
+        ;
+      return kernels;
+    }
+  }
+
+  void transformPoints(const float* transform,
+                       const float* x, const float* y,
+                       float* transformedX, float* transformedY,
+                       int n)
+  {
+    floatSoaKernels().function()(transform, x, y, transformedX, transformedY, n);
+  }
+
+  void transformPoints(const double* transform,
+                       const double* x, const double* y,
+                       double* transformedX, double* transformedY,
+                       int n)
+  {
+    doubleSoaKernels().function()(transform, x, y, transformedX, transformedY, n);
+  }
+
+  void transformInterleavedPoints(const float* transform,
+                                  const float* source, std::size_t sourceStride,
+                                  float* target, std::size_t targetStride,
+                                  int n)
+  {
+    if (sourceStride == 2 * sizeof(float) && targetStride == 2 * sizeof(float))
+      floatInterleavedKernels().function()(transform, source, target, n);
+    else
+      transformInterleavedPoints<float>(transform, source, sourceStride, target, targetStride, n);
+  }
+
+  void transformInterleavedPoints(const double* transform,
+                                  const double* source, std::size_t sourceStride,
+                                  double* target, std::size_t targetStride,
+                                  int n)
+  {
+    if (sourceStride == 2 * sizeof(double) && targetStride == 2 * sizeof(double))
+      doubleInterleavedKernels().function()(transform, source, target, n);
+    else
+      transformInterleavedPoints<double>(transform, source, sourceStride, target, targetStride, n);
+  }
+}
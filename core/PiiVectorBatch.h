@@ -0,0 +1,321 @@
+/* This file is part of Into.
+ * Copyright (C) Intopii 2013.
+ * All rights reserved.
+ *
+ * Licensees holding a commercial Into license may use this file in
+ * accordance with the commercial license agreement. Please see
+ * LICENSE.commercial for commercial licensing terms.
+ *
+ * Alternatively, this file may be used under the terms of the GNU
+ * Affero General Public License version 3 as published by the Free
+ * Software Foundation. In addition, Intopii gives you special rights
+ * to use Into as a part of open source software projects. Please
+ * refer to LICENSE.AGPL3 for details.
+ */
+
+#ifndef _PIIVECTORBATCH_H
+#define _PIIVECTORBATCH_H
+
+#include "PiiVector.h"
+
+/**
+ * A resizable array of `D`-dimensional vectors stored as a structure
+ * of arrays. While a PiiMatrix with one vector on each row (or an
+ * array of PiiVector objects) interleaves the coordinates, a
+ * PiiVectorBatch keeps each coordinate in its own contiguous array.
+ * Bulk operations such as [Pii::transformPoints()] and
+ * [Pii::squaredDistances()] can then process a full SIMD register of
+ * vectors at a time.
+ *
+ * The coordinate arrays are aligned to 32 bytes. The data is
+ * implicitly shared.
+ *
+ * ~~~(c++)
+ * PiiMatrix<float> matPoints(3, 2,
+ *                            0.0, 0.0,
+ *                            1.0, 0.0,
+ *                            0.0, 2.0);
+ * PiiVectorBatch<float,2> points(matPoints);
+ * const float* pX = points.coordinates(0); // 0 1 0
+ * const float* pY = points.coordinates(1); // 0 0 2
+ * ~~~
+ */
+template <class T, int D> class PiiVectorBatch
+{
+public:
+  typedef PiiVector<T,D> VectorType;
+
+  /**
+   * Creates an empty batch.
+   */
+  PiiVectorBatch() :
+    _matData(PiiMatrix<T>::aligned(D, 0, iAlignment)),
+    _iSize(0)
+  {}
+
+  /**
+   * Creates a batch of *size* zero vectors.
+   */
+  explicit PiiVectorBatch(int size) :
+    _matData(PiiMatrix<T>::aligned(D, size, iAlignment)),
+    _iSize(size)
+  {}
+
+  /**
+   * Creates a batch that contains the rows of *vectors*, which must
+   * have `D` columns.
+   */
+  explicit PiiVectorBatch(const PiiMatrix<T>& vectors) :
+    _matData(PiiMatrix<T>::aligned(D, vectors.rows(), iAlignment)),
+    _iSize(vectors.rows())
+  {
+    T* apCoordinates[D];
+    for (int d=0; d<D; ++d)
+      apCoordinates[d] = _matData[d];
+    for (int i=0; i<_iSize; ++i)
+      {
+        const T* pRow = vectors[i];
+        for (int d=0; d<D; ++d)
+          apCoordinates[d][i] = pRow[d];
+      }
+  }
+
+  /**
+   * Returns the number of vectors in the batch.
+   */
+  int size() const { return _iSize; }
+  /**
+   * Returns `true` if the batch contains no vectors.
+   */
+  bool isEmpty() const { return _iSize == 0; }
+  /**
+   * Returns the number of vectors the batch can hold without
+   * reallocating memory.
+   */
+  int capacity() const { return _matData.columns(); }
+
+  /**
+   * Reserves space for at least *capacity* vectors.
+   */
+  void reserve(int capacity)
+  {
+    if (capacity > _matData.columns())
+      reallocate(capacity);
+  }
+
+  /**
+   * Changes the number of vectors to *size*. New vectors are set to
+   * zero.
+   */
+  void resize(int size)
+  {
+    if (size > _matData.columns())
+      reallocate(size);
+    else if (size > _iSize)
+      {
+        for (int d=0; d<D; ++d)
+          Pii::fillN(_matData[d] + _iSize, size - _iSize, T(0));
+      }
+    _iSize = size;
+  }
+
+  /**
+   * Removes all vectors. The capacity is retained.
+   */
+  void clear() { _iSize = 0; }
+
+  /**
+   * Adds *vector* to the end of the batch.
+   */
+  void append(const VectorType& vector)
+  {
+    if (_iSize == _matData.columns())
+      reallocate(qMax(8, _iSize * 2));
+    set(_iSize++, vector);
+  }
+
+  /**
+   * Returns the vector at *index*.
+   */
+  VectorType at(int index) const
+  {
+    VectorType result;
+    for (int d=0; d<D; ++d)
+      result[d] = _matData(d, index);
+    return result;
+  }
+
+  /**
+   * Replaces the vector at *index* with *vector*.
+   */
+  void set(int index, const VectorType& vector)
+  {
+    for (int d=0; d<D; ++d)
+      _matData(d, index) = vector[d];
+  }
+
+  /**
+   * Returns a pointer to the array that stores the *d*th coordinate
+   * of all vectors.
+   */
+  const T* coordinates(int d) const { return _matData[d]; }
+  /**
+   * Returns a pointer to the array that stores the *d*th coordinate.
+   * Detaches the batch from shared data.
+   */
+  T* coordinates(int d) { return _matData[d]; }
+
+  /**
+   * Returns the vectors as the rows of a *size()*-by-`D` matrix.
+   */
+  PiiMatrix<T> toMatrix() const
+  {
+    PiiMatrix<T> matResult(PiiMatrix<T>::uninitialized(_iSize, D));
+    for (int i=0; i<_iSize; ++i)
+      {
+        T* pRow = matResult[i];
+        for (int d=0; d<D; ++d)
+          pRow[d] = _matData(d, i);
+      }
+    return matResult;
+  }
+
+private:
+  enum { iAlignment = 32 };
+
+  void reallocate(int capacity)
+  {
+    PiiMatrix<T> matNewData(PiiMatrix<T>::aligned(D, capacity, iAlignment));
+    for (int d=0; d<D; ++d)
+      Pii::copyN(_matData[d], _iSize, matNewData[d]);
+    _matData = matNewData;
+  }
+
+  // One row for each coordinate, capacity() columns.
+  PiiMatrix<T> _matData;
+  int _iSize;
+};
+
+namespace Pii
+{
+  /**
+   * Applies the affine part of a homogeneous 2D transform to *n*
+   * points. *transform* points to the first two rows of a 3-by-3
+   * transformation matrix in row-major order (`a b c d e f`). The
+   * transformed coordinates are `tx = a*x + b*y + c` and `ty = d*x +
+   * e*y + f`. The output arrays may be the same as the input arrays.
+   *
+   * There are optimized overloads for `float` and `double`.
+   */
+  template <class T> void transformPoints(const T* transform,
+                                          const T* x, const T* y,
+                                          T* transformedX, T* transformedY,
+                                          int n)
+  {
+    const T a = transform[0], b = transform[1], c = transform[2];
+    const T d = transform[3], e = transform[4], f = transform[5];
+    for (int i=0; i<n; ++i)
+      {
+        const T tx = a * x[i] + b * y[i] + c;
+        const T ty = d * x[i] + e * y[i] + f;
+        transformedX[i] = tx;
+        transformedY[i] = ty;
+      }
+  }
+
+  PII_CORE_EXPORT void transformPoints(const float* transform,
+                                       const float* x, const float* y,
+                                       float* transformedX, float* transformedY,
+                                       int n);
+  PII_CORE_EXPORT void transformPoints(const double* transform,
+                                       const double* x, const double* y,
+                                       double* transformedX, double* transformedY,
+                                       int n);
+
+  /**
+   * Same as the structure-of-arrays version of transformPoints(),
+   * but reads interleaved (x, y) pairs from *source* and writes them
+   * to *target*. Successive points are *sourceStride* and
+   * *targetStride* bytes apart. This is the layout of an N-by-2
+   * matrix. The kernels are fastest if the pairs are packed
+   * (stride == 2 * sizeof(T)).
+   */
+  template <class T> void transformInterleavedPoints(const T* transform,
+                                                     const T* source, std::size_t sourceStride,
+                                                     T* target, std::size_t targetStride,
+                                                     int n)
+  {
+    const T a = transform[0], b = transform[1], c = transform[2];
+    const T d = transform[3], e = transform[4], f = transform[5];
+    for (int i=0; i<n; ++i)
+      {
+        const T x = source[0], y = source[1];
+        target[0] = a * x + b * y + c;
+        target[1] = d * x + e * y + f;
+        source = reinterpret_cast<const T*>(reinterpret_cast<const char*>(source) + sourceStride);
+        target = reinterpret_cast<T*>(reinterpret_cast<char*>(target) + targetStride);
+      }
+  }
+
+  PII_CORE_EXPORT void transformInterleavedPoints(const float* transform,
+                                                  const float* source, std::size_t sourceStride,
+                                                  float* target, std::size_t targetStride,
+                                                  int n);
+  PII_CORE_EXPORT void transformInterleavedPoints(const double* transform,
+                                                  const double* source, std::size_t sourceStride,
+                                                  double* target, std::size_t targetStride,
+                                                  int n);
+
+  /**
+   * Transforms all points in *points* with the 3-by-3 homogeneous
+   * *transform* and returns the result in a new batch.
+   *
+   * ~~~(c++)
+   * PiiVectorBatch<double,2> points(matPoints);
+   * PiiVectorBatch<double,2> moved(Pii::transformPoints(matTransform, points));
+   * ~~~
+   *
+   * @relates PiiVectorBatch
+   */
+  template <class T> PiiVectorBatch<T,2> transformPoints(const PiiMatrix<T>& transform,
+                                                         const PiiVectorBatch<T,2>& points)
+  {
+    T aTransform[6] = { transform(0,0), transform(0,1), transform(0,2),
+                        transform(1,0), transform(1,1), transform(1,2) };
+    PiiVectorBatch<T,2> result(points.size());
+    transformPoints(aTransform,
+                    points.coordinates(0), points.coordinates(1),
+                    result.coordinates(0), result.coordinates(1),
+                    points.size());
+    return result;
+  }
+
+  /**
+   * Calculates the squared geometric distance from *point* to each
+   * vector in *vectors* and stores the results to *distances*, which
+   * must have room for `vectors.size()` values. The loop runs over
+   * contiguous coordinate arrays, which lets the compiler vectorize
+   * it.
+   *
+   * @relates PiiVectorBatch
+   */
+  template <class T, int D> void squaredDistances(const PiiVectorBatch<T,D>& vectors,
+                                                  const PiiVector<T,D>& point,
+                                                  T* distances)
+  {
+    const int iSize = vectors.size();
+    fillN(distances, iSize, T(0));
+    for (int d=0; d<D; ++d)
+      {
+        const T* pCoordinates = vectors.coordinates(d);
+        const T value = point[d];
+        for (int i=0; i<iSize; ++i)
+          {
+            const T diff = pCoordinates[i] - value;
+            distances[i] += diff * diff;
+          }
+      }
+  }
+}
+
+#endif //_PIIVECTORBATCH_H
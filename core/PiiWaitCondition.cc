@@ -14,62 +14,216 @@
  */
 
 #include "PiiWaitCondition.h"
+#include "PiiTimer.h"
+
+#include <QThread>
+#include <climits>
+
+#if defined(Q_OS_LINUX)
+#  define PII_WAIT_FUTEX
+#  include <linux/futex.h>
+#  include <sys/syscall.h>
+#  include <unistd.h>
+#  include <time.h>
+#elif defined(Q_OS_WIN) && defined(PII_USE_WAITONADDRESS)
+#  define PII_WAIT_ONADDRESS
+#  include <windows.h>
+#endif
+
+namespace
+{
+  enum { MinSpinCount = 16, MaxSpinCount = 4096 };
+
+  inline void cpuRelax()
+  {
+#if defined(__i386__) || defined(__x86_64__)
+    __builtin_ia32_pause();
+#elif defined(_MSC_VER)
+    YieldProcessor();
+#endif
+  }
+
+  // Spinning is pointless if the waker cannot run at the same time.
+  bool isMultiCore()
+  {
+    static const bool bMultiCore = QThread::idealThreadCount() > 1;
+    return bMultiCore;
+  }
+
+  // PiiAtomicInt has a single int member. The futex and
+  // WaitOnAddress() interfaces need its address.
+  inline int* address(PiiAtomicInt& value)
+  {
+    return reinterpret_cast<int*>(&value);
+  }
+}
 
 PiiWaitCondition::PiiWaitCondition(QueueMode mode) :
-  _bQueue(mode == Queue), _iWaiters(0), _iWakeSignals(0)
+  _bQueue(mode == Queue), _iSpinCount(MinSpinCount * 4)
 {}
 
 bool PiiWaitCondition::wait(unsigned long time)
 {
-  //serialize access to _iWakeSignals and _iWaiters
-  QMutexLocker locker(&_mutex);
-
-  //see if we have already been signalled
-  if (_iWakeSignals > 0)
+  // Either take a queued signal or register as a waiter.
+  for (;;)
     {
-      //we are queuing signals -> just decrement by one
-      if (_bQueue)
-        --_iWakeSignals;
-      //we just need one signal -> clear the queue
-      else
-        _iWakeSignals = 0;
-      return true;
+      int iState = _iState.load();
+      if (iState > 0)
+        {
+          // Queue mode consumes one signal, NoQueue mode all.
+          if (_iState.testAndSetOrdered(iState, _bQueue ? iState-1 : 0))
+            return true;
+        }
+      else if (_iState.testAndSetOrdered(iState, iState-1))
+        break;
     }
-  ++_iWaiters;
 
-  //Unlock the mutex and wait for a signal. The mutex is atomically
-  //unlocked at the time this thread enters suspended mode and
-  //atomically locked again when the suspension ends.
-  return _condition.wait(&_mutex, time);
+  if (acquireRelease(time))
+    return true;
+
+  // Timed out. Unregister unless a waker has already counted us.
+  for (;;)
+    {
+      int iState = _iState.load();
+      if (iState >= 0)
+        break;
+      if (_iState.testAndSetOrdered(iState, iState+1))
+        return false;
+    }
+  // A wake-up has been handed to us and must be consumed.
+  acquireRelease(ULONG_MAX);
+  return true;
 }
 
 void PiiWaitCondition::wakeOne()
 {
-  _mutex.lock();
-  //if no thread is waiting, build up a queue
-  if (_iWaiters == 0)
-    ++_iWakeSignals;
-  else
+  for (;;)
     {
-      // Somebody is waiting: wake one up
-      _condition.wakeOne();
-      // Decrement the waiter count. In some rare cases, wait()
-      // doesn't return immediately after wakeOne(), but multiple
-      // wakeOne() calls may be invoked before wait() finishes.
-      // Therefore, the waiter count must be decreased before the
-      // wait() call actually returns.
-      --_iWaiters;
+      int iState = _iState.load();
+      if (iState < 0)
+        {
+          // Somebody is waiting: wake one up
+          if (_iState.testAndSetOrdered(iState, iState+1))
+            {
+              release(1);
+              return;
+            }
+        }
+      // If no thread is waiting, build up a queue
+      else if (_iState.testAndSetOrdered(iState, _bQueue ? iState+1 : 1))
+        return;
     }
-  _mutex.unlock();
 }
 
 void PiiWaitCondition::wakeAll()
 {
-  _mutex.lock();
-  //release all waiting threads
-  _condition.wakeAll();
-  //make sure no signals are left in the queue
-  _iWakeSignals = 0;
-  _iWaiters = 0;
-  _mutex.unlock();
+  // Release all waiting threads and make sure no signals are left in
+  // the queue.
+  for (;;)
+    {
+      int iState = _iState.load();
+      if (_iState.testAndSetOrdered(iState, 0))
+        {
+          if (iState < 0)
+            release(-iState);
+          return;
+        }
+    }
+}
+
+bool PiiWaitCondition::takeRelease()
+{
+  for (int iReleases = _iReleases.load(); iReleases > 0; iReleases = _iReleases.load())
+    if (_iReleases.testAndSetOrdered(iReleases, iReleases-1))
+      return true;
+  return false;
+}
+
+bool PiiWaitCondition::acquireRelease(unsigned long time)
+{
+  if (time > 0 && isMultiCore())
+    {
+      // The spin count is a heuristic shared by all waiters. Races
+      // in updating it do no harm.
+      const int iSpinCount = _iSpinCount;
+      for (int i=0; i<iSpinCount; ++i)
+        {
+          if (takeRelease())
+            {
+              _iSpinCount = qMin(iSpinCount * 2, int(MaxSpinCount));
+              return true;
+            }
+          cpuRelax();
+        }
+      _iSpinCount = qMax(iSpinCount / 2, int(MinSpinCount));
+    }
+
+  PiiTimer timer;
+  ++_iParked;
+  for (;;)
+    {
+      if (takeRelease())
+        break;
+      unsigned long ulRemaining = ULONG_MAX;
+      if (time != ULONG_MAX)
+        {
+          const qint64 iElapsed = timer.milliseconds();
+          if (iElapsed >= qint64(time))
+            {
+              --_iParked;
+              return takeRelease();
+            }
+          ulRemaining = time - (unsigned long)iElapsed;
+        }
+      park(ulRemaining);
+    }
+  --_iParked;
+  return true;
+}
+
+void PiiWaitCondition::release(int count)
+{
+  // The increment is a full barrier. Either the waiter sees the
+  // release before parking or we see it in _iParked.
+  _iReleases += count;
+  if (_iParked.load() > 0)
+    unpark(count);
+}
+
+void PiiWaitCondition::park(unsigned long time)
+{
+#if defined(PII_WAIT_FUTEX)
+  timespec timeout;
+  timeout.tv_sec = time / 1000;
+  timeout.tv_nsec = (time % 1000) * 1000000;
+  // Returns immediately if a release has been posted in between.
+  syscall(SYS_futex, address(_iReleases), FUTEX_WAIT_PRIVATE, 0,
+          time == ULONG_MAX ? 0 : &timeout, 0, 0);
+#elif defined(PII_WAIT_ONADDRESS)
+  int iExpected = 0;
+  WaitOnAddress(address(_iReleases), &iExpected, sizeof(int),
+                time == ULONG_MAX ? INFINITE : DWORD(qMin(time, (unsigned long)(INFINITE-1))));
+#else
+  QMutexLocker lock(&_mutex);
+  if (_iReleases.load() == 0)
+    _condition.wait(&_mutex, time);
+#endif
+}
+
+void PiiWaitCondition::unpark(int count)
+{
+#if defined(PII_WAIT_FUTEX)
+  syscall(SYS_futex, address(_iReleases), FUTEX_WAKE_PRIVATE, count, 0, 0, 0);
+#elif defined(PII_WAIT_ONADDRESS)
+  if (count == 1)
+    WakeByAddressSingle(address(_iReleases));
+  else
+    WakeByAddressAll(address(_iReleases));
+#else
+  QMutexLocker lock(&_mutex);
+  if (count == 1)
+    _condition.wakeOne();
+  else
+    _condition.wakeAll();
+#endif
 }
@@ -19,6 +19,7 @@
 #include <QWaitCondition>
 #include <QMutex>
 #include "PiiGlobal.h"
+#include "PiiAtomicInt.h"
 
 /**
  * Provides waiting/waking conditions between two threads. The
@@ -61,6 +62,12 @@
  *   }
  * ~~~
  *
+ * The implementation is an event count built on atomic integers.
+ * Signalling and waiting do not take a lock unless the waiting
+ * thread needs to be suspended. A waiting thread first spins for a
+ * short, adaptively tuned time and then parks itself on a futex
+ * (Linux) or WaitOnAddress() (Windows 8 and later). On other
+ * systems, parked threads block on a QWaitCondition.
  */
 class PII_CORE_EXPORT PiiWaitCondition
 {
@@ -123,22 +130,37 @@ public:
   /**
    * Get the number of wakeOne() signals currently in queue.
    */
-  unsigned int queueLength() const { return _iWakeSignals; }
+  unsigned int queueLength() const { return unsigned(qMax(_iState.load(), 0)); }
 
   /**
    * Get the number of threads currently waiting on the condition.
    */
-  unsigned int waiterCount() const { return _iWaiters; }
+  unsigned int waiterCount() const { return unsigned(qMax(-_iState.load(), 0)); }
 
 private:
+  bool takeRelease();
+  bool acquireRelease(unsigned long time);
+  void release(int count);
+  void park(unsigned long time);
+  void unpark(int count);
+
   bool _bQueue;
-  //number of threads waiting
-  unsigned int _iWaiters;
-  //number of wake signals in queue
-  unsigned int _iWakeSignals;
+  // Positive values are queued wake signals, negative values
+  // registered waiters.
+  PiiAtomicInt _iState;
+  // Wake-ups handed to registered waiters but not yet taken. Parked
+  // threads sleep on the address of this value.
+  PiiAtomicInt _iReleases;
+  // The number of threads that may be parked.
+  PiiAtomicInt _iParked;
+  // The number of iterations a waiter spins before parking.
+  int _iSpinCount;
 
+  // Used for parking if the platform has no futex-like primitive.
   QWaitCondition _condition;
   QMutex _mutex;
+
+  PII_DISABLE_COPY(PiiWaitCondition);
 };
 
 #endif //_PIIWAITCONDITION_H
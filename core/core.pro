@@ -12,16 +12,38 @@ qt {
     SOURCES += network/*.cc
   }
 } else {
-  SOURCES += PiiBits.cc PiiColorTable.cc PiiConstCharWrapper.cc PiiException.cc PiiGlobal.cc \
-    PiiInvalidArgumentException.cc PiiIOException.cc PiiMath.cc PiiMathException.cc \
-    PiiPtrHolder.cc PiiRandom.cc PiiResourceStatement.cc PiiResourceDatabase.cc \
-    PiiSharedObject.cc PiiSharedPtr.cc PiiSimpleMemoryManager.cc PiiTimer.cc PiiVariant.cc \
+  SOURCES += PiiAllocationCounter.cc PiiBits.cc PiiColorTable.cc PiiConstCharWrapper.cc PiiCpu.cc PiiException.cc PiiGlobal.cc \
+    PiiInvalidArgumentException.cc PiiIOException.cc PiiMath.cc PiiMathException.cc PiiMemoryPool.cc \
+    PiiMatrixProduct.cc PiiParallel.cc PiiPtrHolder.cc PiiRandom.cc PiiRandomGenerator.cc \
+    PiiResourceStatement.cc PiiResourceDatabase.cc \
+    PiiSharedObject.cc PiiSharedPtr.cc PiiSimpleMemoryManager.cc PiiTimer.cc PiiVariant.cc PiiVectorBatch.cc \
     PiiVersionNumber.cc
   SOURCES += stdwrapper/*.cc matrix/*.cc
   INCLUDEPATH += stdwapper
   posix: LIBS += -lrt
 }
 
+# Use "qmake ENABLE=cblas" to calculate large matrix products with
+# the system's BLAS library.
+contains(ENABLE,cblas) {
+  DEFINES += PII_USE_CBLAS
+  LIBS += -lcblas
+}
+
+# Use "qmake ENABLE=allocationcount" to count heap allocations. See
+# Pii::allocationCount().
+contains(ENABLE,allocationcount) {
+  DEFINES += PII_COUNT_ALLOCATIONS
+}
+
+# PiiWaitCondition parks threads with WaitOnAddress() on Windows 8
+# and later. Use "qmake DISABLE=waitonaddress" to target older
+# versions.
+win32:!contains(DISABLE,waitonaddress) {
+  DEFINES += PII_USE_WAITONADDRESS
+  LIBS += -lsynchronization
+}
+
 INTODIR = ..
 include($$INTODIR/base.pri)
 include($$INTODIR/libinstall.pri)
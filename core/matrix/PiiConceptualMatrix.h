@@ -55,6 +55,10 @@ template <class Matrix> struct PiiMatrixTraits;
 template <class Matrix, class UnaryFunction> class PiiUnaryMatrixTransform;
 template <class Matrix1, class Matrix2, class BinaryFunction> class PiiBinaryMatrixTransform;
 
+// The algorithm overloads for matrix iterators must be visible to the
+// member functions below.
+#include "PiiMatrixIterator.h"
+
 #define PII_MATRIX_SCALAR_ASSIGNMENT_OPERATOR(OPERATOR, FUNCTION) \
 Derived& operator OPERATOR ## = (typename PiiMatrixTraits<Derived>::value_type value) \
 { \
@@ -230,7 +234,7 @@ public:
    */
   Derived& operator= (value_type value)
   {
-    std::fill(self()->begin(), self()->end(), value);
+    Pii::fill(self()->begin(), self()->end(), value);
     return selfRef();
   }
 
@@ -352,6 +356,25 @@ public:
     return mapped(Pii::Cast<value_type,T>());
   }
 
+  /**
+   * Returns `true` if this matrix may read memory that is modified
+   * when its elements are written in row-major order to a matrix
+   * whose first row starts at *data*, whose last row ends at
+   * *dataEnd*, and whose rows are *stride* bytes apart. Reading an
+   * element from the address it is written to is safe. PiiMatrix
+   * uses this function to find out whether an expression can be
+   * evaluated directly into the target matrix or if a temporary
+   * result is needed.
+   *
+   * The default implementation conservatively returns `true`.
+   * Matrix models that know their storage, such as PiiMatrix and
+   * element-wise transforms of them, override this function.
+   */
+  bool aliases(const void* /*data*/, const void* /*dataEnd*/, std::size_t /*stride*/) const
+  {
+    return true;
+  }
+
 protected:
   void fixIndices(int &r, int &c, int &rows, int &columns) const
   {
@@ -362,7 +385,6 @@ protected:
   }
 };
 
-#include "PiiMatrixIterator.h"
 #include "PiiSubmatrix.h"
 
 template <class Derived>
@@ -452,13 +474,18 @@ public:
   }
   typename Traits::const_row_iterator rowEnd(int index) const
   {
-    return typename Traits::const_row_iterator(_mat.roEnd(index), _func);
+    return typename Traits::const_row_iterator(_mat.rowEnd(index), _func);
   }
   typename Traits::const_column_iterator columnEnd(int index) const
   {
     return typename Traits::const_column_iterator(_mat.columnEnd(index), _func);
   }
 
+  bool aliases(const void* data, const void* dataEnd, std::size_t stride) const
+  {
+    return _mat.aliases(data, dataEnd, stride);
+  }
+
 private:
   const Matrix& _mat;
   UnaryFunction _func;
@@ -551,6 +578,11 @@ public:
     return typename Traits::const_column_iterator(_mat1.columnEnd(index), _mat2.columnEnd(index), _func);
   }
 
+  bool aliases(const void* data, const void* dataEnd, std::size_t stride) const
+  {
+    return _mat1.aliases(data, dataEnd, stride) || _mat2.aliases(data, dataEnd, stride);
+  }
+
 private:
   const Matrix1& _mat1;
   const Matrix2& _mat2;
@@ -618,7 +650,7 @@ template <class Derived> template <class Matrix>
 Derived& PiiConceptualMatrix<Derived>::operator<< (const Matrix& other)
 {
   PII_MATRIX_CHECK_EQUAL_SIZE(*this, other);
-  std::transform(other.begin(), other.end(), self()->begin(),
+  Pii::transform(other.begin(), other.end(), self()->begin(),
                  Pii::Cast<typename Matrix::value_type, value_type>());
   return selfRef();
 }
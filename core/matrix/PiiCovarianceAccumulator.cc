@@ -0,0 +1,122 @@
+/* This file is part of Into.
+ * Copyright (C) Intopii 2013.
+ * All rights reserved.
+ *
+ * Licensees holding a commercial Into license may use this file in
+ * accordance with the commercial license agreement. Please see
+ * LICENSE.commercial for commercial licensing terms.
+ *
+ * Alternatively, this file may be used under the terms of the GNU
+ * Affero General Public License version 3 as published by the Free
+ * Software Foundation. In addition, Intopii gives you special rights
+ * to use Into as a part of open source software projects. Please
+ * refer to LICENSE.AGPL3 for details.
+ */
+
+#include "PiiCovarianceAccumulator.h"
+#include "PiiSvDecomposition.h"
+
+#include <PiiMath.h>
+#include <PiiInvalidArgumentException.h>
+
+PiiCovarianceAccumulator::PiiCovarianceAccumulator() :
+  d(new Data)
+{}
+
+PiiCovarianceAccumulator::PiiCovarianceAccumulator(const PiiCovarianceAccumulator& other) :
+  d(other.d)
+{
+  d->reserve();
+}
+
+PiiCovarianceAccumulator::~PiiCovarianceAccumulator()
+{
+  d->release();
+}
+
+PiiCovarianceAccumulator& PiiCovarianceAccumulator::operator= (const PiiCovarianceAccumulator& other)
+{
+  other.d->assignTo(d);
+  return *this;
+}
+
+void PiiCovarianceAccumulator::addSamples(const PiiMatrix<double>& samples)
+{
+  if (samples.isEmpty())
+    return;
+  if (d->iCount != 0 && samples.columns() != d->matMean.columns())
+    PII_MATRIX_SIZE_MISMATCH;
+
+  // Center the batch around its own mean and merge.
+  PiiMatrix<double> matBatchMean(Pii::mean<double>(samples, Pii::Vertically));
+  PiiMatrix<double> matCentered(samples);
+  Pii::transformRows(matCentered, matBatchMean[0], std::minus<double>());
+  merge(samples.rows(), matBatchMean, Pii::transpose(matCentered) * matCentered);
+}
+
+void PiiCovarianceAccumulator::merge(const PiiCovarianceAccumulator& other)
+{
+  if (other.d->iCount == 0)
+    return;
+  if (d->iCount != 0 && other.d->matMean.columns() != d->matMean.columns())
+    PII_MATRIX_SIZE_MISMATCH;
+  // Hold a reference in case other is this.
+  PiiCovarianceAccumulator copy(other);
+  merge(copy.d->iCount, copy.d->matMean, copy.d->matScatter);
+}
+
+void PiiCovarianceAccumulator::merge(qint64 count, const PiiMatrix<double>& mean, const PiiMatrix<double>& scatter)
+{
+  d = d->detach();
+  if (d->iCount == 0)
+    {
+      d->iCount = count;
+      d->matMean = mean;
+      d->matScatter = scatter;
+      return;
+    }
+
+  const qint64 iTotal = d->iCount + count;
+  const PiiMatrix<double> matDelta(mean - d->matMean);
+  d->matMean += matDelta * (double(count) / iTotal);
+  d->matScatter += scatter;
+  d->matScatter += Pii::transpose(matDelta) * matDelta * (double(d->iCount) * count / iTotal);
+  d->iCount = iTotal;
+}
+
+void PiiCovarianceAccumulator::clear()
+{
+  d = d->detach();
+  d->iCount = 0;
+  d->matMean = PiiMatrix<double>();
+  d->matScatter = PiiMatrix<double>();
+}
+
+qint64 PiiCovarianceAccumulator::count() const { return d->iCount; }
+int PiiCovarianceAccumulator::dimensions() const { return d->matMean.columns(); }
+PiiMatrix<double> PiiCovarianceAccumulator::mean() const { return d->matMean; }
+PiiMatrix<double> PiiCovarianceAccumulator::scatter() const { return d->matScatter; }
+
+PiiMatrix<double> PiiCovarianceAccumulator::covariance() const
+{
+  if (d->iCount < 2)
+    return PiiMatrix<double>(d->matScatter.rows(), d->matScatter.columns());
+  return PiiMatrix<double>(d->matScatter / double(d->iCount - 1));
+}
+
+PiiMatrix<double> PiiCovarianceAccumulator::principalComponents(PiiMatrix<double>* variances) const
+{
+  PiiMatrix<double> matV;
+  if (d->iCount == 0)
+    {
+      if (variances != 0)
+        *variances = PiiMatrix<double>();
+      return matV;
+    }
+  // The covariance matrix is symmetric and positive semidefinite.
+  // Its singular values are its eigenvalues, and U = V.
+  PiiMatrix<double> matS(Pii::svDecompose(covariance(), 0, &matV, Pii::SvdFullV));
+  if (variances != 0)
+    *variances = matS;
+  return matV;
+}
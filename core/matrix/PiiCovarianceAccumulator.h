@@ -0,0 +1,142 @@
+/* This file is part of Into.
+ * Copyright (C) Intopii 2013.
+ * All rights reserved.
+ *
+ * Licensees holding a commercial Into license may use this file in
+ * accordance with the commercial license agreement. Please see
+ * LICENSE.commercial for commercial licensing terms.
+ *
+ * Alternatively, this file may be used under the terms of the GNU
+ * Affero General Public License version 3 as published by the Free
+ * Software Foundation. In addition, Intopii gives you special rights
+ * to use Into as a part of open source software projects. Please
+ * refer to LICENSE.AGPL3 for details.
+ */
+
+#ifndef _PIICOVARIANCEACCUMULATOR_H
+#define _PIICOVARIANCEACCUMULATOR_H
+
+#include "PiiMatrix.h"
+#include <PiiSharedD.h>
+
+/**
+ * Accumulates the mean and the covariance of a stream of samples
+ * without storing the samples. Samples are added in batches, one
+ * sample per row. The statistics of each batch are first calculated
+ * around the batch mean and then merged to the accumulated ones
+ * (Chan, Golub & LeVeque: Updating formulae and a pairwise algorithm
+ * for computing sample variances, 1979). Unlike accumulating sums of
+ * squares, this does not lose precision if the mean is large
+ * compared to the variance.
+ *
+ * Accumulators filled in separate threads can be combined with
+ * [merge()].
+ *
+ * ~~~(c++)
+ * PiiCovarianceAccumulator accumulator;
+ * while (readFeatures(matFeatures)) // PiiMatrix<float>, one sample per row
+ *   accumulator.addSamples(matFeatures);
+ * PiiMatrix<double> matVariances;
+ * PiiMatrix<double> matBase(accumulator.principalComponents(&matVariances));
+ * ~~~
+ *
+ * PiiCovarianceAccumulator is implicitly shared.
+ */
+class PII_CORE_EXPORT PiiCovarianceAccumulator
+{
+public:
+  PiiCovarianceAccumulator();
+  PiiCovarianceAccumulator(const PiiCovarianceAccumulator& other);
+  ~PiiCovarianceAccumulator();
+  PiiCovarianceAccumulator& operator= (const PiiCovarianceAccumulator& other);
+
+  /**
+   * Adds a batch of samples, one sample per row. The number of
+   * columns must be the same in all batches. Empty batches are
+   * ignored.
+   *
+   * @exception PiiInvalidArgumentException& if the number of columns
+   * in *samples* does not match previously added samples.
+   */
+  void addSamples(const PiiMatrix<double>& samples);
+
+  /**
+   * Converts *samples* to doubles and adds them.
+   */
+  template <class T> void addSamples(const PiiMatrix<T>& samples)
+  {
+    addSamples(PiiMatrix<double>(samples));
+  }
+
+  /**
+   * Merges the statistics of *other* to this accumulator. The result
+   * is the same as if all samples added to *other* had been added to
+   * this accumulator.
+   *
+   * @exception PiiInvalidArgumentException& if the accumulators have
+   * different dimensions.
+   */
+  void merge(const PiiCovarianceAccumulator& other);
+
+  /**
+   * Removes all samples.
+   */
+  void clear();
+
+  /**
+   * Returns the number of samples added so far.
+   */
+  qint64 count() const;
+  /**
+   * Returns the number of dimensions, or zero if no samples have been
+   * added.
+   */
+  int dimensions() const;
+
+  /**
+   * Returns the mean of all samples as a row vector.
+   */
+  PiiMatrix<double> mean() const;
+  /**
+   * Returns the scatter matrix, the sum of \((x-m)^T(x-m)\) over all
+   * samples x, where m is the mean.
+   */
+  PiiMatrix<double> scatter() const;
+  /**
+   * Returns the covariance matrix. Like Pii::covariance(), this
+   * function divides the scatter matrix by the number of samples
+   * minus one.
+   */
+  PiiMatrix<double> covariance() const;
+
+  /**
+   * Returns the principal components of the accumulated samples as
+   * columns of a matrix, in descending order of variance. To
+   * decorrelate samples, subtract [mean()] and multiply from the
+   * right with the returned matrix.
+   *
+   * @param variances an optional output value that will store the
+   * variances along each component as a row vector.
+   */
+  PiiMatrix<double> principalComponents(PiiMatrix<double>* variances = 0) const;
+
+private:
+  void merge(qint64 count, const PiiMatrix<double>& mean, const PiiMatrix<double>& scatter);
+
+  class Data : public PiiSharedD<Data>
+  {
+  public:
+    Data() : iCount(0) {}
+    Data(const Data& other) :
+      iCount(other.iCount),
+      matMean(other.matMean),
+      matScatter(other.matScatter)
+    {}
+
+    qint64 iCount;
+    PiiMatrix<double> matMean;
+    PiiMatrix<double> matScatter;
+  } *d;
+};
+
+#endif //_PIICOVARIANCEACCUMULATOR_H
@@ -103,6 +103,9 @@ public:
       0;
   }
 
+  pointer ptr() const { return _ptr; }
+  std::size_t stride() const { return _iStride; }
+
 private:
   pointer _ptr;
   std::size_t _iStride;
@@ -188,21 +191,44 @@ template <class T>
 template <class Matrix>
 PiiMatrix<T>& PiiMatrix<T,-1,-1>::operator= (const PiiConceptualMatrix<Matrix>& other)
 {
-  // If sizes are different, need to create a copy
-  if (other.self()->rows() != rows() || other.self()->columns() != columns())
+  // Evaluate into a new buffer if the size changes, if the data is
+  // shared (detaching would copy data that will be overwritten), or
+  // if other reads elements of this matrix at other positions, e.g.
+  // a = transpose(a).
+  if (other.self()->rows() != rows() || other.self()->columns() != columns() ||
+      d->iRefCount != 1 ||
+      (!this->isEmpty() &&
+       other.self()->aliases(d->row(0),
+                             static_cast<const char*>(d->row(rows()-1)) + columns() * sizeof(T),
+                             stride())))
     {
       PiiMatrix matCopy(PiiMatrixData::createUninitializedData(other.self()->rows(), other.self()->columns(),
                                                                other.self()->columns() * sizeof(T)));
-      Pii::transform(other.self()->begin(), other.self()->end(), matCopy.begin(),
-                     Pii::Cast<typename Matrix::value_type,T>());
+      matCopy.assignRows(other.selfRef());
       *this = matCopy;
     }
   else
+    assignRows(other.selfRef());
+  return *this;
+}
+
+template <class T>
+template <class Matrix>
+void PiiMatrix<T,-1,-1>::assignRows(const Matrix& other)
+{
+  // Row iterators of element-wise expressions are plain pointers
+  // wrapped in function objects. Evaluating the whole expression row
+  // by row, without the row checks of matrix iterators, makes a
+  // tight loop the compiler can vectorize.
+  const int iRows = rows(), iColumns = columns();
+  Pii::Cast<typename Matrix::value_type,T> cast;
+  for (int r=0; r<iRows; ++r)
     {
-      Pii::transform(other.self()->begin(), other.self()->end(), begin(),
-                     Pii::Cast<typename Matrix::value_type,T>());
+      T* pRow = static_cast<T*>(d->row(r));
+      typename Matrix::const_row_iterator it = other.rowBegin(r);
+      for (int c=0; c<iColumns; ++c, ++it)
+        pRow[c] = cast(*it);
     }
-  return *this;
 }
 
 template <class T>
@@ -22,6 +22,8 @@ PiiMatrixData* PiiTypelessMatrix::createReference(int rows, int columns, void* b
                                                             buffer);
   d->reserve();
   pData->pSourceData = d;
+  // The reference is owned by the calling thread, like d.
+  pData->bThreadConfined = d->bThreadConfined;
   return pData;
 }
 
@@ -43,7 +45,8 @@ void* PiiTypelessMatrix::insertRow(int index, std::size_t bytesPerRow)
     {
       PiiMatrixData* pData = PiiMatrixData::createUninitializedData(d->iRows + 1,
                                                                     d->iColumns,
-                                                                    bytesPerRow);
+                                                                    bytesPerRow,
+                                                                    0, d->iAlignment);
       for (int r=index; r<d->iRows; ++r)
         std::memcpy(pData->row(r+1), d->row(r), bytesPerRow);
       d->release();
@@ -119,7 +122,8 @@ void* PiiTypelessMatrix::insertColumn(int index, std::size_t bytesPerItem)
     {
       PiiMatrixData* pData = PiiMatrixData::createUninitializedData(qMax(d->iRows, d->iCapacity),
                                                                     d->iColumns + 1,
-                                                                    iBytesPerRow);
+                                                                    iBytesPerRow,
+                                                                    0, d->iAlignment);
       pData->iRows = d->iRows;
       std::size_t iRowStartBytes = index * bytesPerItem;
       char* pTargetRow = static_cast<char*>(pData->row(0));
@@ -144,6 +148,7 @@ void* PiiTypelessMatrix::insertColumn(int index, std::size_t bytesPerItem)
 void PiiTypelessMatrix::cloneAndReplaceData(int capacity, std::size_t bytesPerRow)
 {
   PiiMatrixData* pData = d->clone(capacity, bytesPerRow);
+  pData->bThreadConfined = d->bThreadConfined;
   d->release();
   d = pData;
 }
@@ -187,7 +192,8 @@ void PiiTypelessMatrix::resize(int rows, int columns, std::size_t bytesPerItem)
   // to reallocate.
   else
     {
-      PiiMatrixData* pData = PiiMatrixData::createUninitializedData(rows, columns, iBytesPerRow);
+      PiiMatrixData* pData = PiiMatrixData::createUninitializedData(rows, columns, iBytesPerRow,
+                                                                    0, d->iAlignment);
       int iMinRows = qMin(rows, d->iRows);
       std::size_t iMinBytes = qMin(iBytesPerRow, bytesPerItem * d->iColumns);
       for (int r=0; r<iMinRows; ++r)
@@ -197,6 +203,15 @@ void PiiTypelessMatrix::resize(int rows, int columns, std::size_t bytesPerItem)
     }
 }
 
+bool PiiTypelessMatrix::confineToThread()
+{
+  // Other references may live in other threads.
+  if (d->iRefCount.load() != d->iLastRef || d == PiiMatrixData::sharedNull())
+    return false;
+  d->bThreadConfined = true;
+  return true;
+}
+
 void PiiTypelessMatrix::clear()
 {
   d->release();
@@ -146,6 +146,14 @@ public:
 
   static std::size_t stride() { return columnCount * sizeof(T); }
 
+  bool aliases(const void* data, const void* dataEnd, std::size_t stride) const
+  {
+    const char* pBegin = reinterpret_cast<const char*>(_data);
+    return pBegin < static_cast<const char*>(dataEnd) &&
+      pBegin + byteCount() > static_cast<const char*>(data) &&
+      (pBegin != data || stride != this->stride());
+  }
+
 private:
   static inline std::size_t byteCount() { return rowCount * columnCount * sizeof(T); }
 
@@ -208,6 +216,50 @@ public:
    */
   void clear();
 
+  /**
+   * Switches the matrix to non-atomic reference counting. Copying a
+   * matrix and destroying a copy increment and decrement a reference
+   * counter, which is normally an atomic operation. If a matrix is
+   * only used as a temporary within the calling thread, atomic
+   * operations are unnecessary, and in tight loops their cost is
+   * measurable. Once this function has been called, all copies of the
+   * matrix share a counter that is modified with plain instructions
+   * until the matrix is [shared](shareAcrossThreads()) again.
+   *
+   * The matrix can be confined only if it is the sole reference to
+   * its data. Returns `true` on success and `false` if there are
+   * other references.
+   *
+   * ! No copy of a confined matrix may be accessed by another thread
+   * before [shareAcrossThreads()] has been called in the owning
+   * thread. Storing a matrix into a PiiVariant does this
+   * automatically. Thus, emitting a confined matrix through an output
+   * socket is safe, but passing it to another thread by other means
+   * is not.
+   *
+   * ~~~(c++)
+   * PiiMatrix<float> matTmp(rows, columns);
+   * matTmp.confineToThread();
+   * for (int i=0; i<iterations; ++i)
+   *   process(matTmp); // copies are cheap now
+   * emitObject(matTmp); // switches back to atomic counting
+   * ~~~
+   */
+  bool confineToThread();
+
+  /**
+   * Switches the matrix back to atomic reference counting after
+   * [confineToThread()]. This function must be called by the owning
+   * thread before a copy of the matrix is handed to another thread.
+   * It has no effect if the matrix is not confined.
+   */
+  void shareAcrossThreads() const { d->shareAcrossThreads(); }
+
+  /**
+   * Returns `true` if the matrix uses non-atomic reference counting.
+   */
+  bool isThreadConfined() const { return d->bThreadConfined; }
+
 protected:
   /// @hide
   PiiTypelessMatrix() : d(PiiMatrixData::sharedNull()) { d->reserve(); }
@@ -374,8 +426,7 @@ public:
                                                              other.self()->columns(),
                                                              other.self()->columns() * sizeof(T)))
   {
-    Pii::transform(other.self()->begin(), other.self()->end(), begin(),
-                   Pii::Cast<typename Matrix::value_type,T>());
+    assignRows(other.selfRef());
   }
 
   /**
@@ -444,6 +495,40 @@ public:
       d->bufferType = PiiMatrixData::ExternalOwnBuffer;
   }
 
+  /**
+   * Constructs a *rows*-by-*columns* matrix that uses *data* as its
+   * data buffer, and informs the owner of the buffer when it is no
+   * longer needed. Like the constructor that takes a `const T*`,
+   * this one creates an immutable matrix: modifying it makes a deep
+   * copy. Once the last matrix referring to *data* has been
+   * destroyed, *releaseFunction* will be called with *context* as
+   * the argument. The function may be called from any thread.
+   *
+   * This constructor makes it possible to pass memory owned by
+   * someone else, such as a frame buffer of a camera driver, to
+   * other parts of the program without copying, and to recycle the
+   * memory once everyone is done with it.
+   *
+   * ~~~(c++)
+   * void returnToPool(void* buffer) { pool.put(buffer); }
+   *
+   * float* pBuffer = pool.get();
+   * // returnToPool(pBuffer) will be called once mat and all of its
+   * // copies have been destroyed.
+   * PiiMatrix<float> mat(rows, columns, pBuffer, returnToPool, pBuffer);
+   * ~~~
+   */
+  PiiMatrix(int rows, int columns, const T* data,
+            void (*releaseFunction)(void*), void* context,
+            std::size_t stride = 0) :
+    PiiTypelessMatrix(PiiMatrixData::createReferenceData(rows, columns,
+                                                         qMax(stride, sizeof(T)*columns),
+                                                         const_cast<T*>(data))->makeImmutable())
+  {
+    d->releaseFunction = releaseFunction;
+    d->pReleaseContext = context;
+  }
+
   /**
    * Constructs a matrix with the given number of *rows* and
    * *columns*. Matrix contents are given as a variable-length parameter
@@ -609,6 +694,22 @@ public:
   const T* row(int index) const { return static_cast<const T*>(d->row(index)); }
   T* row(int index) { detach(); return static_cast<T*>(d->row(index)); }
 
+  /**
+   * Returns `true` if the data of this matrix overlaps the given
+   * memory range with another layout. See
+   * [PiiConceptualMatrix::aliases()].
+   */
+  bool aliases(const void* data, const void* dataEnd, std::size_t stride) const
+  {
+    if (this->isEmpty())
+      return false;
+    const char* pBegin = static_cast<const char*>(d->row(0));
+    const char* pEnd = static_cast<const char*>(d->row(rows()-1)) + columns() * sizeof(T);
+    return pBegin < static_cast<const char*>(dataEnd) &&
+      pEnd > static_cast<const char*>(data) &&
+      (pBegin != data || stride != this->stride());
+  }
+
   /**
    * A utility function that returns a reference to the memory
    * location at the beginning of the given row as the specified type.
@@ -1010,13 +1111,34 @@ public:
    * state. It is useful as an optimization if you know you are going
    * to set all matrix entries anyway. If *stride* is set to a value
    * larger than `sizeof(T)*columns`, matrix rows will be
-   * padded to *stride* bytes.
+   * padded to *stride* bytes. If *alignment* is non-zero, it
+   * overrides PiiMatrixData::defaultAlignment() (see [aligned()]).
    */
-  static PiiMatrix uninitialized(int rows, int columns, std::size_t stride = 0)
+  static PiiMatrix uninitialized(int rows, int columns, std::size_t stride = 0, std::size_t alignment = 0)
   {
     return PiiMatrix(PiiMatrixData::createUninitializedData(rows, columns,
                                                             columns * sizeof(T),
-                                                            stride));
+                                                            stride, alignment));
+  }
+
+  /**
+   * Creates *rows*-by-*columns* matrix with initial contents set to
+   * zero. Both the first element and the stride will be aligned to
+   * a multiple of *alignment* bytes, which must be a power of two.
+   * Use 32 to make every row safe for aligned AVX loads and 64 to
+   * make rows start at cache line boundaries. The alignment is
+   * retained when the matrix is resized or cloned.
+   *
+   * ~~~(c++)
+   * PiiMatrix<float> mat(PiiMatrix<float>::aligned(480, 641, 32));
+   * // mat.stride() == 2592
+   * ~~~
+   */
+  static PiiMatrix aligned(int rows, int columns, std::size_t alignment)
+  {
+    return PiiMatrix(PiiMatrixData::createInitializedData(rows, columns,
+                                                          columns * sizeof(T),
+                                                          0, alignment));
   }
 
   /**
@@ -1050,8 +1172,22 @@ public:
 
 private:
   PiiMatrix(PiiMatrixData* d) : PiiTypelessMatrix(d) {}
+
+  template <class Matrix> void assignRows(const Matrix& other);
 };
 
+namespace Pii
+{
+  // A dynamic matrix is just a d pointer.
+  template <class T> struct IsRelocatable<PiiMatrix<T> > : True {};
+
+  // Thread-confined matrices must use atomic counting once shared.
+  template <class T> struct ThreadSharing<PiiMatrix<T> >
+  {
+    static void share(const PiiMatrix<T>& matrix) { matrix.shareAcrossThreads(); }
+  };
+}
+
 #include "PiiMatrix-templates.h"
 
 namespace Pii
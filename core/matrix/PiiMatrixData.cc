@@ -14,9 +14,324 @@
  */
 
 #include "PiiMatrixData.h"
+#include <QMutex>
+#include <QMutexLocker>
+#include <QList>
 #include <cstdlib>
 #include <cstring>
+#include <cstddef>
 #include <new>
+#ifdef PII_CXX11
+#  include <atomic>
+#endif
+
+namespace
+{
+#ifdef PII_CXX11
+  typedef std::atomic<std::size_t> PoolCounter;
+#else
+  // Protected by PiiMatrixBufferPool::mutex.
+  typedef std::size_t PoolCounter;
+#endif
+
+  /* Recycles released matrix buffers. Each size class holds blocks
+   * of exactly the same size, which is what recurring frame sizes
+   * produce. Blocks smaller than minimumBlockSize are not worth
+   * pooling and go directly to malloc().
+   */
+  class PiiMatrixBufferPool
+  {
+  public:
+    enum { minimumBlockSize = 4096, maximumSizeClasses = 16 };
+
+    PiiMatrixBufferPool() :
+      iMaxRetainedBytes(0), iRetainedBytes(0), iHits(0), iMisses(0)
+    {}
+
+    ~PiiMatrixBufferPool()
+    {
+      clear();
+      bDestroyed = true;
+    }
+
+    bool isEnabled(std::size_t bytes) const
+    {
+      return iMaxRetainedBytes != 0 && bytes >= minimumBlockSize && !bDestroyed;
+    }
+
+    void* take(std::size_t bytes);
+    bool put(void* block, std::size_t bytes);
+    bool addToSizeClass(void* block, std::size_t bytes);
+    void clear();
+
+    // Reserves room for a block of the given size in the retained
+    // byte budget. Without C++11, mutex must be held.
+    bool reserveBytes(std::size_t bytes)
+    {
+      if ((iRetainedBytes += bytes) <= iMaxRetainedBytes)
+        return true;
+      iRetainedBytes -= bytes;
+      return false;
+    }
+
+    struct SizeClass
+    {
+      SizeClass(std::size_t size = 0) : iSize(size) {}
+      std::size_t iSize;
+      QList<void*> lstBlocks;
+    };
+
+    QMutex mutex;
+    QList<SizeClass> lstSizeClasses;
+    volatile std::size_t iMaxRetainedBytes;
+    PoolCounter iRetainedBytes, iHits, iMisses;
+    static bool bDestroyed;
+  };
+
+  bool PiiMatrixBufferPool::bDestroyed = false;
+
+  PiiMatrixBufferPool* bufferPool()
+  {
+    static PiiMatrixBufferPool pool;
+    return &pool;
+  }
+
+#ifdef PII_CXX11
+  /* A small per-thread cache in front of the shared pool. Threads
+   * that repeatedly allocate and free buffers of the same size never
+   * touch the shared mutex. The cached blocks count against the
+   * retained byte budget and are returned to the shared pool when
+   * the thread exits.
+   */
+  struct PiiMatrixThreadCache
+  {
+    enum { size = 4 };
+
+    PiiMatrixThreadCache() : iCount(0) {}
+    ~PiiMatrixThreadCache() { flush(); }
+
+    void* take(std::size_t bytes)
+    {
+      for (int i=iCount; i--; )
+        if (aBlockSizes[i] == bytes)
+          {
+            void* pBlock = apBlocks[i];
+            --iCount;
+            apBlocks[i] = apBlocks[iCount];
+            aBlockSizes[i] = aBlockSizes[iCount];
+            return pBlock;
+          }
+      return 0;
+    }
+
+    bool put(void* block, std::size_t bytes)
+    {
+      if (iCount == size)
+        return false;
+      apBlocks[iCount] = block;
+      aBlockSizes[iCount++] = bytes;
+      return true;
+    }
+
+    void flush()
+    {
+      PiiMatrixBufferPool* pPool = bufferPool();
+      QMutexLocker lock(&pPool->mutex);
+      for (int i=0; i<iCount; ++i)
+        {
+          // The blocks are already accounted for.
+          if (PiiMatrixBufferPool::bDestroyed || !pPool->addToSizeClass(apBlocks[i], aBlockSizes[i]))
+            {
+              pPool->iRetainedBytes -= aBlockSizes[i];
+              std::free(apBlocks[i]);
+            }
+        }
+      iCount = 0;
+    }
+
+    void* apBlocks[size];
+    std::size_t aBlockSizes[size];
+    int iCount;
+  };
+
+  thread_local PiiMatrixThreadCache threadCache;
+#endif
+
+  void* PiiMatrixBufferPool::take(std::size_t bytes)
+  {
+#ifdef PII_CXX11
+    void* pBlock = threadCache.take(bytes);
+    if (pBlock != 0)
+      {
+        iRetainedBytes -= bytes;
+        ++iHits;
+        return pBlock;
+      }
+#endif
+    QMutexLocker lock(&mutex);
+    for (int i=0; i<lstSizeClasses.size(); ++i)
+      {
+        SizeClass& sizeClass = lstSizeClasses[i];
+        if (sizeClass.iSize == bytes && !sizeClass.lstBlocks.isEmpty())
+          {
+            iRetainedBytes -= bytes;
+            ++iHits;
+            return sizeClass.lstBlocks.takeLast();
+          }
+      }
+    ++iMisses;
+    return 0;
+  }
+
+  bool PiiMatrixBufferPool::put(void* block, std::size_t bytes)
+  {
+#ifdef PII_CXX11
+    if (!reserveBytes(bytes))
+      return false;
+    if (threadCache.put(block, bytes))
+      return true;
+    {
+      QMutexLocker lock(&mutex);
+      if (addToSizeClass(block, bytes))
+        return true;
+    }
+#else
+    QMutexLocker lock(&mutex);
+    if (!reserveBytes(bytes))
+      return false;
+    if (addToSizeClass(block, bytes))
+      return true;
+#endif
+    iRetainedBytes -= bytes;
+    return false;
+  }
+
+  // mutex must be held when calling this function
+  bool PiiMatrixBufferPool::addToSizeClass(void* block, std::size_t bytes)
+  {
+    int iEmptyClass = -1;
+    for (int i=0; i<lstSizeClasses.size(); ++i)
+      {
+        SizeClass& sizeClass = lstSizeClasses[i];
+        if (sizeClass.iSize == bytes)
+          {
+            sizeClass.lstBlocks.append(block);
+            return true;
+          }
+        else if (iEmptyClass == -1 && sizeClass.lstBlocks.isEmpty())
+          iEmptyClass = i;
+      }
+    // Recycle a size class that is no longer in use.
+    if (iEmptyClass != -1)
+      lstSizeClasses[iEmptyClass].iSize = bytes;
+    else if (lstSizeClasses.size() < maximumSizeClasses)
+      {
+        iEmptyClass = lstSizeClasses.size();
+        lstSizeClasses.append(SizeClass(bytes));
+      }
+    else
+      return false;
+    lstSizeClasses[iEmptyClass].lstBlocks.append(block);
+    return true;
+  }
+
+  void PiiMatrixBufferPool::clear()
+  {
+#ifdef PII_CXX11
+    // Only the calling thread's cache can be reached.
+    threadCache.flush();
+#endif
+    QMutexLocker lock(&mutex);
+    for (int i=0; i<lstSizeClasses.size(); ++i)
+      {
+        QList<void*>& lstBlocks = lstSizeClasses[i].lstBlocks;
+        for (int j=0; j<lstBlocks.size(); ++j)
+          {
+            std::free(lstBlocks[j]);
+            iRetainedBytes -= lstSizeClasses[i].iSize;
+          }
+      }
+    lstSizeClasses.clear();
+  }
+
+  inline void* allocateBlock(std::size_t bytes)
+  {
+    PiiMatrixBufferPool* pPool = bufferPool();
+    if (pPool->isEnabled(bytes))
+      {
+        void* pBlock = pPool->take(bytes);
+        if (pBlock != 0)
+          return pBlock;
+      }
+    return std::malloc(bytes);
+  }
+
+  inline void releaseBlock(void* block, std::size_t bytes)
+  {
+    PiiMatrixBufferPool* pPool = bufferPool();
+    if (!pPool->isEnabled(bytes) || !pPool->put(block, bytes))
+      std::free(block);
+  }
+}
+
+static std::size_t iDefaultMatrixAlignment = PiiMatrixData::minimumAlignment;
+
+static std::size_t validAlignment(std::size_t alignment)
+{
+  if (alignment < PiiMatrixData::minimumAlignment)
+    return PiiMatrixData::minimumAlignment;
+  // Round up to the next power of two
+  std::size_t iAlignment = PiiMatrixData::minimumAlignment;
+  while (iAlignment < alignment && iAlignment < PiiMatrixData::maximumAlignment)
+    iAlignment <<= 1;
+  return iAlignment;
+}
+
+void PiiMatrixData::setDefaultAlignment(std::size_t alignment)
+{
+  iDefaultMatrixAlignment = validAlignment(alignment);
+}
+
+std::size_t PiiMatrixData::defaultAlignment()
+{
+  return iDefaultMatrixAlignment;
+}
+
+void PiiMatrixData::setPoolCapacity(std::size_t maxRetainedBytes)
+{
+  PiiMatrixBufferPool* pPool = bufferPool();
+  pPool->iMaxRetainedBytes = maxRetainedBytes;
+  if (maxRetainedBytes == 0)
+    pPool->clear();
+}
+
+std::size_t PiiMatrixData::poolCapacity()
+{
+  return bufferPool()->iMaxRetainedBytes;
+}
+
+PiiMatrixData::PoolStatistics PiiMatrixData::poolStatistics()
+{
+  PiiMatrixBufferPool* pPool = bufferPool();
+  QMutexLocker lock(&pPool->mutex);
+  PoolStatistics stats;
+  stats.hits = pPool->iHits;
+  stats.misses = pPool->iMisses;
+  stats.retainedBytes = pPool->iRetainedBytes;
+  return stats;
+}
+
+void PiiMatrixData::clearPool()
+{
+  bufferPool()->clear();
+}
+
+std::size_t PiiMatrixData::blockSize() const
+{
+  // Only internal buffers occupy rows in the block.
+  return headerSize() +
+    (bufferType == InternalBuffer ? alignmentPadding(iAlignment) + iCapacity * iStride : 0);
+}
 
 PiiMatrixData* PiiMatrixData::sharedNull()
 {
@@ -24,19 +339,33 @@ PiiMatrixData* PiiMatrixData::sharedNull()
   return &nullData;
 }
 
-PiiMatrixData* PiiMatrixData::allocate(int rows, int columns, std::size_t stride)
+PiiMatrixData* PiiMatrixData::allocate(int rows, int columns, std::size_t stride, std::size_t alignment)
 {
-  void* bfr = std::malloc(headerSize() + rows * stride);
-  return new (bfr) PiiMatrixData(rows, columns, stride);
+  void* bfr = allocateBlock(headerSize() + alignmentPadding(alignment) + rows * stride);
+  return new (bfr) PiiMatrixData(rows, columns, stride, alignment);
 }
 
 PiiMatrixData* PiiMatrixData::reallocate(PiiMatrixData* d, int rows)
 {
+  const bool bMoveContents = d->bufferType == InternalBuffer && d->pBuffer != 0;
+  const std::ptrdiff_t iOldOffset = bMoveContents ?
+    static_cast<char*>(d->pBuffer) - reinterpret_cast<char*>(d) : 0;
+  const int iOldCapacity = d->iCapacity;
   // This may move the contents of d into a new memory location
-  d = static_cast<PiiMatrixData*>(std::realloc(d, headerSize() + rows * d->iStride));
+  d = static_cast<PiiMatrixData*>(std::realloc(d, headerSize() + alignmentPadding(d->iAlignment) +
+                                               rows * d->iStride));
   // If the data buffer is internal, we need to fix the data pointer
   if (d->bufferType == InternalBuffer)
-    d->pBuffer = d->bufferAddress();
+    {
+      d->pBuffer = d->bufferAddress();
+      // The new block may have a different alignment. If so, the
+      // contents must be moved to the new aligned position.
+      char* pOldBuffer = reinterpret_cast<char*>(d) + iOldOffset;
+      if (bMoveContents && pOldBuffer != d->pBuffer)
+        std::memmove(d->pBuffer, pOldBuffer, qMin(iOldCapacity, rows) * d->iStride);
+    }
+  // Keeps blockSize() in sync with the allocated size.
+  d->iCapacity = rows;
   return d;
 }
 
@@ -44,16 +373,20 @@ void PiiMatrixData::destroy()
 {
   if (bufferType == ExternalOwnBuffer)
     std::free(pBuffer);
+  else if (releaseFunction != 0)
+    releaseFunction(pReleaseContext);
   else if (pSourceData != 0)
     pSourceData->release();
-  std::free(this);
+  releaseBlock(this, blockSize());
 }
 
-PiiMatrixData* PiiMatrixData::createUninitializedData(int rows, int columns, std::size_t bytesPerRow, std::size_t stride)
+PiiMatrixData* PiiMatrixData::createUninitializedData(int rows, int columns, std::size_t bytesPerRow,
+                                                      std::size_t stride, std::size_t alignment)
 {
+  alignment = alignment == 0 ? iDefaultMatrixAlignment : validAlignment(alignment);
   if (stride < bytesPerRow)
-    stride = alignedWidth(bytesPerRow);
-  PiiMatrixData* pData = allocate(rows, columns, stride);
+    stride = alignedWidth(bytesPerRow, alignment);
+  PiiMatrixData* pData = allocate(rows, columns, stride, alignment);
   pData->bufferType = InternalBuffer;
   if (rows*columns != 0)
     pData->pBuffer = pData->bufferAddress();
@@ -62,9 +395,10 @@ PiiMatrixData* PiiMatrixData::createUninitializedData(int rows, int columns, std
   return pData;
 }
 
-PiiMatrixData* PiiMatrixData::createInitializedData(int rows, int columns, std::size_t bytesPerRow, std::size_t stride)
+PiiMatrixData* PiiMatrixData::createInitializedData(int rows, int columns, std::size_t bytesPerRow,
+                                                    std::size_t stride, std::size_t alignment)
 {
-  PiiMatrixData* pData = createUninitializedData(rows, columns, bytesPerRow, stride);
+  PiiMatrixData* pData = createUninitializedData(rows, columns, bytesPerRow, stride, alignment);
   std::memset(pData->pBuffer, 0, pData->iStride * rows);
   return pData;
 }
@@ -85,10 +419,10 @@ PiiMatrixData* PiiMatrixData::clone(int capacity, std::size_t bytesPerRow)
   int iNewRows = qMax(capacity, iRows);
   // If this is not a submatrix, retain the full width.
   if (pSourceData == 0)
-    pData = createUninitializedData(iNewRows, iColumns, iStride, iStride);
+    pData = createUninitializedData(iNewRows, iColumns, iStride, iStride, iAlignment);
   // Submatrices are truncated to minimum (aligned) width when cloning.
   else
-    pData = createUninitializedData(iNewRows, iColumns, bytesPerRow);
+    pData = createUninitializedData(iNewRows, iColumns, bytesPerRow, 0, pSourceData->iAlignment);
 
   // Equal strides -> can copy the full contents at once
   if (pData->iStride == iStride)
@@ -28,56 +28,160 @@ struct PII_CORE_EXPORT PiiMatrixData
   PiiMatrixData() :
     iRefCount(1),
     iLastRef(1),
+    bThreadConfined(false),
     iRows(0),
     iColumns(0),
     iStride(0),
     iCapacity(0),
+    iAlignment(minimumAlignment),
     bufferType(InternalBuffer),
     pSourceData(0),
-    pBuffer(0)
+    pBuffer(0),
+    releaseFunction(0),
+    pReleaseContext(0)
   {}
 
-  PiiMatrixData(int rows, int columns, std::size_t stride) :
+  PiiMatrixData(int rows, int columns, std::size_t stride, std::size_t alignment) :
     iRefCount(1),
     iLastRef(1),
+    bThreadConfined(false),
     iRows(rows),
     iColumns(columns),
     iStride(stride),
     iCapacity(rows),
+    iAlignment(alignment),
     bufferType(InternalBuffer),
     pSourceData(0),
-    pBuffer(0)
+    pBuffer(0),
+    releaseFunction(0),
+    pReleaseContext(0)
   {}
 
+  // The smallest supported alignment. With this alignment, the
+  // stride is aligned to four bytes, and the buffer to eight bytes.
+  enum { minimumAlignment = 4, maximumAlignment = 4096 };
+
   PiiAtomicInt iRefCount;
   // Destroy data when iRefCount goes below this value. Default is
   // one. Setting this value to two and increasing iRefCount by one
   // makes referenced data immutable.
   int iLastRef;
+  // If true, all references to this data are owned by one thread, and
+  // iRefCount is modified without atomic instructions.
+  bool bThreadConfined;
   int iRows, iColumns;
   // Number of bytes between beginnings of successive rows.
   std::size_t iStride;
   // Size of allocated buffer in rows
   int iCapacity;
+  // The alignment of an internal buffer and its stride in bytes.
+  std::size_t iAlignment;
   BufferType bufferType;
   // Points to the source data if this matrix is a subwindow of
   // another matrix.
   PiiMatrixData* pSourceData;
   // Points to the first element of the matrix.
   void* pBuffer;
+  // If non-zero, called with pReleaseContext when an external buffer
+  // is no longer referenced.
+  void (*releaseFunction)(void*);
+  void* pReleaseContext;
 
   void* row(int index) { return static_cast<char*>(pBuffer) + iStride * index; }
   const void* row(int index) const { return static_cast<const char*>(pBuffer) + iStride * index; }
 
   // Aligns row width to a four-byte boundary
   static std::size_t alignedWidth(std::size_t bytes) { return (bytes + 3) & ~3; }
+  // Aligns row width to a multiple of alignment, which must be a
+  // power of two.
+  static std::size_t alignedWidth(std::size_t bytes, std::size_t alignment)
+  {
+    return (bytes + alignment - 1) & ~(alignment - 1);
+  }
   // Returns the size of this structure rounded up to closest multiple of 8.
   static std::size_t headerSize() { return (sizeof(PiiMatrixData) + 7) & ~7; }
+  // Returns the number of bytes that need to be reserved in addition
+  // to the header and the buffer to guarantee alignment.
+  static std::size_t alignmentPadding(std::size_t alignment) { return alignment > 8 ? alignment - 1 : 0; }
   // Returns a pointer to the beginning of an internally allocated buffer.
-  char* bufferAddress() { return reinterpret_cast<char*>(this) + headerSize(); }
+  char* bufferAddress()
+  {
+    char* pAddress = reinterpret_cast<char*>(this) + headerSize();
+    if (iAlignment <= 8)
+      return pAddress;
+    return reinterpret_cast<char*>((reinterpret_cast<std::size_t>(pAddress) + iAlignment - 1) & ~(iAlignment - 1));
+  }
+
+  /* Sets the alignment used for new matrices whose alignment is not
+   * explicitly given. The alignment applies both to the start of the
+   * data buffer and to the stride. *alignment* must be a power of
+   * two. Values smaller than four restore the default four-byte
+   * stride alignment. Use 32 for aligned AVX loads and 64 to make
+   * rows start at cache line boundaries. Matrices that share or
+   * reference external data are not affected. This function is not
+   * thread-safe and should be called before any matrices are
+   * created.
+   */
+  static void setDefaultAlignment(std::size_t alignment);
+  static std::size_t defaultAlignment();
+
+  /* Buffer pool statistics. *hits* is the number of allocations
+   * served from the pool, *misses* the number of pooled allocations
+   * that had to fall back to malloc(), and *retainedBytes* the
+   * number of bytes currently held in the pool.
+   */
+  struct PoolStatistics
+  {
+    std::size_t hits, misses, retainedBytes;
+  };
+
+  /* Sets the maximum number of bytes retained in the buffer pool.
+   * Released internal buffers are kept in the pool and reused for
+   * new matrices whose buffers have exactly the same size (same
+   * rows, stride and alignment). This avoids malloc() and page
+   * faults in pipelines that allocate and free large frames of a
+   * fixed size at a high rate. Buffers smaller than 4 KiB are never
+   * pooled. Zero (the default) disables pooling and releases all
+   * retained buffers.
+   */
+  static void setPoolCapacity(std::size_t maxRetainedBytes);
+  static std::size_t poolCapacity();
+  // Returns hit/miss statistics for the buffer pool.
+  static PoolStatistics poolStatistics();
+  // Releases all buffers retained in the shared pool and in the
+  // calling thread's cache.
+  static void clearPool();
 
-  void reserve() { iRefCount.ref(); }
-  void release() { if (iRefCount-- == iLastRef) destroy(); }
+  void reserve()
+  {
+    if (bThreadConfined)
+      iRefCount.storeRelaxed(iRefCount.loadRelaxed() + 1);
+    else
+      iRefCount.ref();
+  }
+
+  void release()
+  {
+    if (bThreadConfined)
+      {
+        const int iCount = iRefCount.loadRelaxed();
+        iRefCount.storeRelaxed(iCount - 1);
+        if (iCount == iLastRef)
+          destroy();
+      }
+    else if (iRefCount-- == iLastRef)
+      destroy();
+  }
+
+  // Switches this data and the data it references to atomic
+  // reference counting. Must be called by the owning thread before
+  // any reference is handed to another thread.
+  void shareAcrossThreads()
+  {
+    for (PiiMatrixData* pData = this; pData != 0; pData = pData->pSourceData)
+      if (pData->bThreadConfined)
+        pData->bThreadConfined = false;
+  }
 
   PiiMatrixData* clone(int capacity, std::size_t bytesPerRow);
 
@@ -91,13 +195,20 @@ struct PII_CORE_EXPORT PiiMatrixData
   }
 
   static PiiMatrixData* sharedNull();
-  static PiiMatrixData* allocate(int rows, int columns, std::size_t stride);
+  static PiiMatrixData* allocate(int rows, int columns, std::size_t stride,
+                                 std::size_t alignment = minimumAlignment);
   static PiiMatrixData* reallocate(PiiMatrixData* d, int rows);
-  static PiiMatrixData* createUninitializedData(int rows, int columns, std::size_t bytesPerRow, std::size_t stride = 0);
-  static PiiMatrixData* createInitializedData(int rows, int columns, std::size_t bytesPerRow, std::size_t stride = 0);
+  // If alignment is zero, defaultAlignment() will be used.
+  static PiiMatrixData* createUninitializedData(int rows, int columns, std::size_t bytesPerRow,
+                                                std::size_t stride = 0, std::size_t alignment = 0);
+  static PiiMatrixData* createInitializedData(int rows, int columns, std::size_t bytesPerRow,
+                                              std::size_t stride = 0, std::size_t alignment = 0);
   static PiiMatrixData* createReferenceData(int rows, int columns, std::size_t stride, void* buffer);
 
   void destroy();
+
+  // The size of the memory block holding this structure.
+  std::size_t blockSize() const;
 };
 
 #endif //_PIIMATRIXDATA_H
@@ -20,6 +20,7 @@
 #include <PiiTypeTraits.h>
 #include <PiiMetaTemplate.h>
 #include <stddef.h>
+#include <iterator>
 
 // Used in the usual case when stride is counted in columns.
 template <class T> struct PiiStrideHandler
@@ -30,6 +31,11 @@ template <class T> struct PiiStrideHandler
   {
     return (it1 - it2) / std::ptrdiff_t(stride);
   }
+
+  static inline bool isContiguous(int columns, std::size_t stride)
+  {
+    return stride == std::size_t(columns);
+  }
 };
 
 // Used when the iterator type T is a pointer. In such case, stride is
@@ -47,6 +53,11 @@ template <class T> struct PiiStrideHandler<T*>
   {
     return ((char*)(ptr1) - (char*)(ptr2)) / std::ptrdiff_t(stride);
   }
+
+  static inline bool isContiguous(int columns, std::size_t stride)
+  {
+    return stride == std::size_t(columns) * sizeof(T);
+  }
 };
 
 template <class T>
@@ -163,8 +174,429 @@ public:
       0;
   }
 
+  /**
+   * Returns `true` if consecutive rows follow each other without
+   * padding, i.e. if the stride equals the row width.
+   */
+  bool isContiguous() const { return Stride::isContiguous(_iColumns, _sStride); }
+  /**
+   * Returns the underlying iterator at the current position.
+   */
+  T base() const { return _row + _iColumn; }
+  /**
+   * Returns the number of elements left on the current row,
+   * including the current one.
+   */
+  int remainingColumns() const { return _iColumns - _iColumn; }
+
 private:
   T _firstRow, _row;
   int _iColumn, _iColumns;
   std::size_t _sStride;
 };
+
+namespace Pii
+{
+  /**
+   * Converts stride-aware iterators into plain ones. If
+   * `isFlat(it)` returns `true`, the range starting at *it* can be
+   * traversed with the simple iterator returned by `flatten(it)`,
+   * which usually is a pointer the compiler is able to vectorize.
+   * Otherwise, `segment(it)` returns a simple iterator that is valid
+   * for `segmentLength(it, n)` elements, at most *n*.
+   *
+   * @hide
+   */
+  template <class Iterator> struct FlatIterator
+  {
+    typedef Iterator Type;
+    typedef Iterator SegmentType;
+    static bool isFlat(const Iterator&) { return false; }
+    static Type flatten(const Iterator& it) { return it; }
+    static SegmentType segment(const Iterator& it) { return it; }
+    static int segmentLength(const Iterator&, int n) { return n; }
+  };
+
+  template <class T> struct FlatIterator<T*>
+  {
+    typedef T* Type;
+    typedef T* SegmentType;
+    static bool isFlat(T*) { return true; }
+    static Type flatten(T* ptr) { return ptr; }
+    static SegmentType segment(T* ptr) { return ptr; }
+    static int segmentLength(T*, int n) { return n; }
+  };
+
+  // A matrix iterator is flat if its rows are contiguous and the
+  // iterator it wraps is flat. This covers submatrices, whose
+  // iterators wrap the iterator of the parent matrix.
+  template <class T> struct FlatIterator<PiiMatrixIterator<T> >
+  {
+    typedef FlatIterator<T> Base;
+    typedef typename Base::Type Type;
+    typedef typename Base::SegmentType SegmentType;
+    static bool isFlat(const PiiMatrixIterator<T>& it) { return it.isContiguous() && Base::isFlat(it.base()); }
+    static Type flatten(const PiiMatrixIterator<T>& it) { return Base::flatten(it.base()); }
+    static SegmentType segment(const PiiMatrixIterator<T>& it) { return Base::segment(it.base()); }
+    static int segmentLength(const PiiMatrixIterator<T>& it, int n)
+    {
+      return Base::segmentLength(it.base(), qMin(n, it.remainingColumns()));
+    }
+  };
+
+  template <class Iterator, class UnaryFunction>
+  struct FlatIterator<PiiUnaryFunctionIterator<Iterator, UnaryFunction> >
+  {
+    typedef PiiUnaryFunctionIterator<Iterator, UnaryFunction> Self;
+    typedef FlatIterator<Iterator> Base;
+    typedef PiiUnaryFunctionIterator<typename Base::Type, UnaryFunction> Type;
+    typedef Self SegmentType;
+    static bool isFlat(const Self& it) { return Base::isFlat(it.iterator()); }
+    static Type flatten(const Self& it) { return Type(Base::flatten(it.iterator()), it.function()); }
+    static SegmentType segment(const Self& it) { return it; }
+    static int segmentLength(const Self&, int n) { return n; }
+  };
+
+  template <class Iterator1, class Iterator2, class BinaryFunction>
+  struct FlatIterator<PiiBinaryFunctionIterator<Iterator1, Iterator2, BinaryFunction> >
+  {
+    typedef PiiBinaryFunctionIterator<Iterator1, Iterator2, BinaryFunction> Self;
+    typedef FlatIterator<Iterator1> Base1;
+    typedef FlatIterator<Iterator2> Base2;
+    typedef PiiBinaryFunctionIterator<typename Base1::Type, typename Base2::Type, BinaryFunction> Type;
+    typedef Self SegmentType;
+    static bool isFlat(const Self& it) { return Base1::isFlat(it.iterator1()) && Base2::isFlat(it.iterator2()); }
+    static Type flatten(const Self& it)
+    {
+      return Type(Base1::flatten(it.iterator1()), Base2::flatten(it.iterator2()), it.function());
+    }
+    static SegmentType segment(const Self& it) { return it; }
+    static int segmentLength(const Self&, int n) { return n; }
+  };
+
+  // Loop bodies for the single-range algorithms below. operator()
+  // processes n consecutive elements, filtered() only those whose
+  // corresponding filter element is non-zero.
+
+  /// @hide
+  template <class T> struct FillOperation
+  {
+    FillOperation(T v) : value(v) {}
+    template <class Iterator> void operator() (Iterator data, int n)
+    {
+      for (; n > 0; --n, ++data)
+        *data = value;
+    }
+    template <class Iterator, class Filter> void filtered(Iterator data, Filter filter, int n)
+    {
+      for (; n > 0; --n, ++data, ++filter)
+        if (*filter)
+          *data = value;
+    }
+    T value;
+  };
+
+  /// @hide
+  template <class UnaryFunction> struct MapOperation
+  {
+    MapOperation(UnaryFunction f) : func(f) {}
+    template <class Iterator> void operator() (Iterator data, int n)
+    {
+      for (; n > 0; --n, ++data)
+        *data = func(*data);
+    }
+    template <class Iterator, class Filter> void filtered(Iterator data, Filter filter, int n)
+    {
+      for (; n > 0; --n, ++data, ++filter)
+        if (*filter)
+          *data = func(*data);
+    }
+    UnaryFunction func;
+  };
+
+  /// @hide
+  template <class UnaryPredicate, class UnaryFunction> struct MapIfOperation
+  {
+    MapIfOperation(UnaryPredicate p, UnaryFunction f) : predicate(p), func(f) {}
+    template <class Iterator> void operator() (Iterator data, int n)
+    {
+      for (; n > 0; --n, ++data)
+        if (predicate(*data))
+          *data = func(*data);
+    }
+    template <class Iterator, class Filter> void filtered(Iterator data, Filter filter, int n)
+    {
+      for (; n > 0; --n, ++data, ++filter)
+        if (*filter && predicate(*data))
+          *data = func(*data);
+    }
+    UnaryPredicate predicate;
+    UnaryFunction func;
+  };
+
+  /// @hide
+  template <class UnaryFunction> struct ForEachOperation
+  {
+    ForEachOperation(UnaryFunction f) : func(f) {}
+    template <class Iterator> void operator() (Iterator data, int n)
+    {
+      for (; n > 0; --n, ++data)
+        func(*data);
+    }
+    template <class Iterator, class Filter> void filtered(Iterator data, Filter filter, int n)
+    {
+      for (; n > 0; --n, ++data, ++filter)
+        if (*filter)
+          func(*data);
+    }
+    UnaryFunction func;
+  };
+
+  /// @hide
+  template <class UnaryPredicate, class UnaryFunction> struct ForEachIfOperation
+  {
+    ForEachIfOperation(UnaryPredicate p, UnaryFunction f) : predicate(p), func(f) {}
+    template <class Iterator> void operator() (Iterator data, int n)
+    {
+      for (; n > 0; --n, ++data)
+        if (predicate(*data))
+          func(*data);
+    }
+    template <class Iterator, class Filter> void filtered(Iterator data, Filter filter, int n)
+    {
+      for (; n > 0; --n, ++data, ++filter)
+        if (*filter && predicate(*data))
+          func(*data);
+    }
+    UnaryPredicate predicate;
+    UnaryFunction func;
+  };
+
+  /// @hide
+  template <class BinaryFunction, class T> struct AccumulateOperation
+  {
+    AccumulateOperation(BinaryFunction f, T v) : func(f), value(v) {}
+    template <class Iterator> void operator() (Iterator data, int n)
+    {
+      for (; n > 0; --n, ++data)
+        value = func(value, *data);
+    }
+    template <class Iterator, class Filter> void filtered(Iterator data, Filter filter, int n)
+    {
+      for (; n > 0; --n, ++data, ++filter)
+        if (*filter)
+          value = func(value, *data);
+    }
+    BinaryFunction func;
+    T value;
+  };
+
+  /**
+   * Applies *operation* to the range [*begin*, *begin* + *n*). If
+   * the range is contiguous in memory, *operation* is called once
+   * with a flat iterator. Otherwise, it is called once for each row
+   * segment.
+   *
+   * @hide
+   */
+  template <class Iterator, class Operation>
+  void processMatrixRange(Iterator begin, int n, Operation& operation)
+  {
+    typedef FlatIterator<Iterator> Flat;
+    if (Flat::isFlat(begin))
+      operation(Flat::flatten(begin), n);
+    else
+      while (n > 0)
+        {
+          const int iLength = Flat::segmentLength(begin, n);
+          operation(Flat::segment(begin), iLength);
+          begin += iLength;
+          n -= iLength;
+        }
+  }
+
+  /**
+   * Applies *operation* to the elements of a filtered range. If both
+   * the data and the filter are contiguous, the loop runs over plain
+   * pointers.
+   *
+   * @hide
+   */
+  template <class T, class FilterIterator, bool bConst, class Operation>
+  void processFilteredRange(const PiiFilteredIterator<PiiMatrixIterator<T>, FilterIterator, bConst>& begin,
+                            const PiiFilteredIterator<PiiMatrixIterator<T>, FilterIterator, bConst>& end,
+                            Operation& operation)
+  {
+    typedef FlatIterator<PiiMatrixIterator<T> > FlatData;
+    typedef FlatIterator<FilterIterator> FlatFilter;
+    const int n = int(end.current() - begin.current());
+    PiiMatrixIterator<T> data(begin.current());
+    FilterIterator filter(begin.filter());
+    if (FlatData::isFlat(data) && FlatFilter::isFlat(filter))
+      operation.filtered(FlatData::flatten(data), FlatFilter::flatten(filter), n);
+    else
+      operation.filtered(data, filter, n);
+  }
+
+#define PII_FILTERED_ITERATOR PiiFilteredIterator<PiiMatrixIterator<T>, FilterIterator, bConst>
+
+  // Overloads of the generic algorithms in PiiAlgorithm.h. Partial
+  // ordering selects these whenever the range is a matrix iterator.
+
+  template <class T>
+  PiiMatrixIterator<T> fill(PiiMatrixIterator<T> begin, PiiMatrixIterator<T> end,
+                            typename PiiMatrixIterator<T>::value_type value)
+  {
+    FillOperation<typename PiiMatrixIterator<T>::value_type> op(value);
+    processMatrixRange(begin, int(end - begin), op);
+    return end;
+  }
+
+  template <class T, class FilterIterator, bool bConst>
+  PII_FILTERED_ITERATOR fill(PII_FILTERED_ITERATOR begin, PII_FILTERED_ITERATOR end,
+                             typename PII_FILTERED_ITERATOR::value_type value)
+  {
+    FillOperation<typename PII_FILTERED_ITERATOR::value_type> op(value);
+    processFilteredRange(begin, end, op);
+    return end;
+  }
+
+  template <class T, class UnaryFunction>
+  PiiMatrixIterator<T> map(PiiMatrixIterator<T> begin, PiiMatrixIterator<T> end, UnaryFunction func)
+  {
+    MapOperation<UnaryFunction> op(func);
+    processMatrixRange(begin, int(end - begin), op);
+    return end;
+  }
+
+  template <class T, class FilterIterator, bool bConst, class UnaryFunction>
+  PII_FILTERED_ITERATOR map(PII_FILTERED_ITERATOR begin, PII_FILTERED_ITERATOR end, UnaryFunction func)
+  {
+    MapOperation<UnaryFunction> op(func);
+    processFilteredRange(begin, end, op);
+    return end;
+  }
+
+  template <class T, class UnaryPredicate, class UnaryFunction>
+  PiiMatrixIterator<T> mapIf(PiiMatrixIterator<T> begin, PiiMatrixIterator<T> end,
+                             UnaryPredicate predicate, UnaryFunction func)
+  {
+    MapIfOperation<UnaryPredicate, UnaryFunction> op(predicate, func);
+    processMatrixRange(begin, int(end - begin), op);
+    return end;
+  }
+
+  template <class T, class FilterIterator, bool bConst, class UnaryPredicate, class UnaryFunction>
+  PII_FILTERED_ITERATOR mapIf(PII_FILTERED_ITERATOR begin, PII_FILTERED_ITERATOR end,
+                              UnaryPredicate predicate, UnaryFunction func)
+  {
+    MapIfOperation<UnaryPredicate, UnaryFunction> op(predicate, func);
+    processFilteredRange(begin, end, op);
+    return end;
+  }
+
+  template <class T, class UnaryFunction>
+  UnaryFunction forEach(PiiMatrixIterator<T> begin, PiiMatrixIterator<T> end, UnaryFunction func)
+  {
+    ForEachOperation<UnaryFunction> op(func);
+    processMatrixRange(begin, int(end - begin), op);
+    return op.func;
+  }
+
+  template <class T, class FilterIterator, bool bConst, class UnaryFunction>
+  UnaryFunction forEach(PII_FILTERED_ITERATOR begin, PII_FILTERED_ITERATOR end, UnaryFunction func)
+  {
+    ForEachOperation<UnaryFunction> op(func);
+    processFilteredRange(begin, end, op);
+    return op.func;
+  }
+
+  template <class T, class UnaryPredicate, class UnaryFunction>
+  UnaryFunction forEachIf(PiiMatrixIterator<T> begin, PiiMatrixIterator<T> end,
+                          UnaryPredicate predicate, UnaryFunction func)
+  {
+    ForEachIfOperation<UnaryPredicate, UnaryFunction> op(predicate, func);
+    processMatrixRange(begin, int(end - begin), op);
+    return op.func;
+  }
+
+  template <class T, class FilterIterator, bool bConst, class UnaryPredicate, class UnaryFunction>
+  UnaryFunction forEachIf(PII_FILTERED_ITERATOR begin, PII_FILTERED_ITERATOR end,
+                          UnaryPredicate predicate, UnaryFunction func)
+  {
+    ForEachIfOperation<UnaryPredicate, UnaryFunction> op(predicate, func);
+    processFilteredRange(begin, end, op);
+    return op.func;
+  }
+
+  template <class T, class BinaryFunction, class U>
+  U accumulate(PiiMatrixIterator<T> begin, PiiMatrixIterator<T> end,
+               BinaryFunction func, U initialValue)
+  {
+    AccumulateOperation<BinaryFunction, U> op(func, initialValue);
+    processMatrixRange(begin, int(end - begin), op);
+    return op.value;
+  }
+
+  template <class T, class FilterIterator, bool bConst, class BinaryFunction, class U>
+  U accumulate(PII_FILTERED_ITERATOR begin, PII_FILTERED_ITERATOR end,
+               BinaryFunction func, U initialValue)
+  {
+    AccumulateOperation<BinaryFunction, U> op(func, initialValue);
+    processFilteredRange(begin, end, op);
+    return op.value;
+  }
+
+#undef PII_FILTERED_ITERATOR
+
+  // Algorithms with more than one input cannot be split into row
+  // segments unless all rows are equally aligned. They are flattened
+  // only if all iterators are flat and fall back to the stride-aware
+  // loop otherwise.
+
+  template <class T, class OutputIterator, class UnaryFunction>
+  OutputIterator transform(PiiMatrixIterator<T> begin, PiiMatrixIterator<T> end,
+                           OutputIterator output, UnaryFunction func)
+  {
+    typedef FlatIterator<PiiMatrixIterator<T> > FlatInput;
+    typedef FlatIterator<OutputIterator> FlatOutput;
+    const int n = int(end - begin);
+    if (FlatInput::isFlat(begin) && FlatOutput::isFlat(output))
+      {
+        transformN(FlatInput::flatten(begin), n, FlatOutput::flatten(output), func);
+        std::advance(output, n);
+        return output;
+      }
+    return transformN(begin, n, output, func);
+  }
+
+  template <class T, class InputIterator2, class OutputIterator, class BinaryFunction>
+  OutputIterator transform(PiiMatrixIterator<T> begin1, PiiMatrixIterator<T> end1,
+                           InputIterator2 begin2, OutputIterator output,
+                           BinaryFunction func)
+  {
+    typedef FlatIterator<PiiMatrixIterator<T> > FlatInput1;
+    typedef FlatIterator<InputIterator2> FlatInput2;
+    typedef FlatIterator<OutputIterator> FlatOutput;
+    const int n = int(end1 - begin1);
+    if (FlatInput1::isFlat(begin1) && FlatInput2::isFlat(begin2) && FlatOutput::isFlat(output))
+      {
+        transformN(FlatInput1::flatten(begin1), n, FlatInput2::flatten(begin2), FlatOutput::flatten(output), func);
+        std::advance(output, n);
+        return output;
+      }
+    return transformN(begin1, n, begin2, output, func);
+  }
+
+  template <class T, class Iterator2, class BinaryFunction>
+  void map(PiiMatrixIterator<T> begin1, PiiMatrixIterator<T> end1, Iterator2 begin2, BinaryFunction func)
+  {
+    typedef FlatIterator<PiiMatrixIterator<T> > Flat1;
+    typedef FlatIterator<Iterator2> Flat2;
+    const int n = int(end1 - begin1);
+    if (Flat1::isFlat(begin1) && Flat2::isFlat(begin2))
+      mapN(Flat1::flatten(begin1), n, Flat2::flatten(begin2), func);
+    else
+      mapN(begin1, n, begin2, func);
+  }
+}
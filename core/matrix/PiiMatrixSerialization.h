@@ -24,12 +24,22 @@
 #include <PiiSerializationException.h>
 #include <PiiSerialization.h>
 
+#include <climits>
+
 /// @hide
 
 namespace PiiSerialization
 {
   /**** Variable-size matrices ****/
 
+  // True if the rows of *mat* follow each other without padding and
+  // their total size fits into a single raw data block.
+  template <class T> inline bool isContiguous(const PiiMatrix<T>& mat, unsigned int rowBytes)
+  {
+    return mat.rows() > 0 && mat.stride() == rowBytes &&
+      quint64(rowBytes) * mat.rows() <= quint64(INT_MAX);
+  }
+
   template <class Archive, class T>
   void save(Archive& archive, const PiiMatrix<T>& mat, const unsigned int /*version*/)
   {
@@ -37,8 +47,13 @@ namespace PiiSerialization
     archive << PII_NVP("rows", iRows);
     archive << PII_NVP("cols", iCols);
     unsigned int uiBytes = iCols*sizeof(T);
-    for (int r=0; r<iRows; ++r)
-      archive.writeRawData(mat[r], uiBytes);
+    archive.startPayload(quint64(uiBytes) * iRows);
+    // Byte-stream archives can take contiguous rows in one block.
+    if (Archive::BulkTransfer && isContiguous(mat, uiBytes))
+      archive.writeRawData(mat[0], uiBytes*iRows);
+    else
+      for (int r=0; r<iRows; ++r)
+        archive.writeRawData(mat[r], uiBytes);
   }
 
   template <class Archive, class T>
@@ -51,11 +66,26 @@ namespace PiiSerialization
     if (iRows < 0 || iCols < 0)
       PII_SERIALIZATION_ERROR(InvalidDataFormat);
 
-    mat.resize(iRows, iCols);
-
     unsigned int uiBytes = iCols*sizeof(T);
-    for (int r=0; r<iRows; ++r)
-      archive.readRawData(mat[r], uiBytes);
+    // The archive may be able to provide the data without copying.
+    void (*releaseFunction)(void*) = 0;
+    void* pContext = 0;
+    const void* pPayload = archive.startPayload(quint64(uiBytes) * iRows, &releaseFunction, &pContext);
+    if (pPayload != 0)
+      {
+        mat = PiiMatrix<T>(iRows, iCols, static_cast<const T*>(pPayload),
+                           releaseFunction, pContext, uiBytes);
+        return;
+      }
+
+    // All elements will be overwritten.
+    mat = PiiMatrix<T>::uninitialized(iRows, iCols);
+
+    if (Archive::BulkTransfer && isContiguous(mat, uiBytes))
+      archive.readRawData(mat[0], uiBytes*iRows);
+    else
+      for (int r=0; r<iRows; ++r)
+        archive.readRawData(mat[r], uiBytes);
   }
 
   template <class Archive, class T>
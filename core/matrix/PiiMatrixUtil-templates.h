@@ -18,6 +18,8 @@
 #endif
 
 #include <PiiRandom.h>
+#include <vector>
+#include <algorithm>
 
 namespace Pii
 {
@@ -354,62 +356,43 @@ namespace Pii
     return result;
   }
 
-  /**
-   * @internal
-   * Optimized quicksort for matrix rows.
-   */
-  template <class T, class LessThan> void sortRows(PiiMatrix<T>& matrix, int column,
-                                                   T* pivotRow,
-                                                   int firstRow, int lastRow,
-                                                   LessThan lessThan)
+  /// @hide
+  // Compares (key, row index) pairs. Ties are resolved by the index,
+  // which makes any sort algorithm stable.
+  template <class T, class LessThan> struct KeyIndexLess
   {
-    if (firstRow < lastRow)
-      {
-        int iStartIndex, iEndIndex;
-        const int iColumns = matrix.columns(), iBytesPerRow = iColumns * sizeof(T);
-        iStartIndex = firstRow;
-        iEndIndex = lastRow;
-        // Take the last row as a pivot
-        std::memcpy(pivotRow, matrix.row(lastRow), iBytesPerRow);
-        do
-          {
-            // Find first row that is not smaller than pivot.
-            while (iStartIndex < iEndIndex &&
-                   !lessThan(pivotRow[column], matrix.at(iStartIndex, column)))
-              ++iStartIndex;
-            // Find last row that is not greater
-            while ((iEndIndex > iStartIndex) &&
-                   !lessThan(matrix.at(iEndIndex, column), pivotRow[column]))
-              --iEndIndex;
-            // Swap rows
-            if (iStartIndex < iEndIndex)
-              {
-                T *pFirstRow = matrix.rowBegin(iStartIndex),
-                  *pLastRow = matrix.rowBegin(iEndIndex);
-                for (int i=0; i<iColumns; ++i)
-                  qSwap(pFirstRow[i], pLastRow[i]);
-              }
-          } while (iStartIndex < iEndIndex);
-
-        // Now, rows above iStartIndex are smaller or equal than the
-        // pivot, and rows below (or at iStartIndex) are greater or
-        // equal.
-        std::memcpy(matrix.rowBegin(lastRow), matrix.constRowBegin(iStartIndex), iBytesPerRow);
-        std::memcpy(matrix.rowBegin(iStartIndex), pivotRow, iBytesPerRow);
-
-        sortRows(matrix, column, pivotRow, firstRow, iStartIndex-1, lessThan);
-        sortRows(matrix, column, pivotRow, iStartIndex+1, lastRow, lessThan);
-      }
+    KeyIndexLess(LessThan lessThan) : lessThan(lessThan) {}
+    bool operator() (const std::pair<T,int>& a, const std::pair<T,int>& b) const
+    {
+      return lessThan(a.first, b.first) || (!lessThan(b.first, a.first) && a.second < b.second);
+    }
+    LessThan lessThan;
+  };
+
+  // Reorders rows so that row r of the result is row order[r] of the
+  // original.
+  template <class T> void reorderRows(PiiMatrix<T>& matrix, const int* order)
+  {
+    const PiiMatrix<T>& source(matrix);
+    PiiMatrix<T> matResult(PiiMatrix<T>::uninitialized(source.rows(), source.columns()));
+    const std::size_t iBytesPerRow = source.columns() * sizeof(T);
+    for (int r=0; r<source.rows(); ++r)
+      std::memcpy(matResult.row(r), source.row(order[r]), iBytesPerRow);
+    matrix = matResult;
   }
+  /// @endhide
 
   template <class T, class LessThan> void sortRows(PiiMatrix<T>& matrix, LessThan lessThan, int column)
   {
-    if (matrix.isEmpty()) return;
-    T* pPivotRow = new T[matrix.columns()];
-    sortRows(matrix, column,
-             pPivotRow,
-             0, matrix.rows()-1,
-             lessThan);
-    delete[] pPivotRow;
+    const int iRows = matrix.rows();
+    if (iRows < 2) return;
+    std::vector<std::pair<T,int> > vecKeys(iRows);
+    for (int r=0; r<iRows; ++r)
+      vecKeys[r] = std::make_pair(matrix(r, column), r);
+    std::sort(vecKeys.begin(), vecKeys.end(), KeyIndexLess<T,LessThan>(lessThan));
+    std::vector<int> vecOrder(iRows);
+    for (int r=0; r<iRows; ++r)
+      vecOrder[r] = vecKeys[r].second;
+    reorderRows(matrix, &vecOrder[0]);
   }
 }
@@ -411,6 +411,8 @@ namespace Pii
   /**
    * Sort matrix rows into ascending order based on the value on the
    * specified column. Use `predicate` as the comparison function.
+   * The sort is stable: rows with equal keys retain their relative
+   * order. See PiiSort.h for a parallel version.
    *
    * ~~~(c++)
    * PiiMatrix<int> mat(3,3,
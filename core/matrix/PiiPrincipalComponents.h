@@ -75,12 +75,61 @@ namespace Pii
   template <class Matrix> PiiMatrix<typename Matrix::value_type> pcaDecorrelate(const Matrix& X)
   {
     typedef typename Matrix::value_type T;
-    PiiMatrix<T> matU;
-    // Singular values as a row vector
-    PiiMatrix<T> matS = svDecompose(X, &matU, 0, Pii::SvdFullU);
-    // Optimized multiplication of U*S (S is diagonal)
-    transformRows(matU, matS[0], std::multiplies<T>());
-    return matU;
+    // Y = XV = US. Calculating U would rotate all m rows on each
+    // Jacobi sweep. A single product with the n-by-n V is much
+    // cheaper.
+    PiiMatrix<T> matV;
+    svDecompose(X, 0, &matV, Pii::SvdFullV);
+    return PiiMatrix<T>(X) * matV;
+  }
+
+  /**
+   * Returns the *components* most significant PCA base vectors for a
+   * data set in *X*. This function works like [principalComponents()],
+   * but calculates only the first *components* columns of V using
+   * [truncatedSvDecompose()]. If *X* is large and only a few
+   * components are needed, this is much faster than a full
+   * decomposition.
+   *
+   * @param X the input data, stored as rows. The input data must have
+   * a zero mean.
+   *
+   * @param components the number of base vectors to calculate.
+   *
+   * @param S an optional output parameter that will store the
+   * *components* largest singular values of X as a row vector.
+   *
+   * @return an n-by-*components* matrix whose columns are the base
+   * vectors.
+   */
+  template <class Matrix>
+  PiiMatrix<typename Matrix::value_type> truncatedPrincipalComponents(const Matrix& X,
+                                                                      int components,
+                                                                      PiiMatrix<typename Matrix::value_type>* S = 0)
+  {
+    PiiMatrix<typename Matrix::value_type> matV;
+    if (S == 0)
+      truncatedSvDecompose(X, components, 0, &matV);
+    else
+      *S = truncatedSvDecompose(X, components, 0, &matV);
+    return matV;
+  }
+
+  /**
+   * Projects *X* to its *components* first principal components.
+   * Returns an m-by-*components* matrix that equals the first
+   * *components* columns of `pcaDecorrelate(X)`, up to rounding
+   * errors and the signs of the columns.
+   *
+   * @param X input data with observation vectors as its rows. Must
+   * have zero mean.
+   *
+   * @param components the number of components to retain.
+   */
+  template <class Matrix> PiiMatrix<typename Matrix::value_type> pcaDecorrelate(const Matrix& X, int components)
+  {
+    typedef typename Matrix::value_type T;
+    return PiiMatrix<T>(X) * truncatedPrincipalComponents(X, components);
   }
 }
 
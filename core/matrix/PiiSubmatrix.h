@@ -47,7 +47,7 @@ public:
   typename Traits::const_iterator end() const
   {
     typename Matrix::const_iterator it = _mat.begin() + (_iRow * _mat.columns() + _iColumn);
-    return typename Traits::const_iterator(it, it + ((_iRows - 1) * _mat.columns() + _iColumns),
+    return typename Traits::const_iterator(it, it + _iRows * _mat.columns(),
                                            _iColumns, _mat.columns());
   }
   typename Traits::iterator begin()
@@ -58,7 +58,7 @@ public:
   typename Traits::iterator end()
   {
     typename Matrix::iterator it = _mat.begin() + (_iRow * _mat.columns() + _iColumn);
-    return typename Traits::iterator(it, it + ((_iRows - 1) * _mat.columns() + _iColumns),
+    return typename Traits::iterator(it, it + _iRows * _mat.columns(),
                                      _iColumns, _mat.columns());
   }
 
@@ -18,6 +18,7 @@
 
 #include "PiiPlaneRotation.h"
 #include "PiiQrDecomposition.h"
+#include <PiiRandom.h>
 
 namespace Pii
 {
@@ -257,6 +258,96 @@ namespace Pii
     PiiMatrix<typename Matrix::value_type> matTmp(iMinSize, iMinSize);
     return svDecompose(A, matTmp, U, V, options);
   }
+
+  /**
+   * Calculates the *k* largest singular values of *A* and the
+   * corresponding singular vectors. The result is a truncated SVD
+   * \(A \approx U*S*V^T\), where U is m-by-k, S k-by-k and V n-by-k.
+   *
+   * The decomposition is calculated with a randomized algorithm
+   * (Halko, Martinsson & Tropp: Finding structure with randomness,
+   * SIAM Review 53(2), 2011). The range of *A* is sampled with
+   * *k* + *oversampling* random vectors, and only the projection of
+   * *A* to the sampled subspace is decomposed with [svDecompose()].
+   * The cost is dominated by a few matrix products with *A*, which
+   * makes the function much faster than a full decomposition if *k*
+   * is small compared to the dimensions of *A*. The results are exact
+   * up to rounding errors if the rank of *A* is at most *k* +
+   * *oversampling*. Otherwise, the accuracy of the smallest singular
+   * values depends on the decay of the spectrum. Power iterations
+   * improve accuracy if the singular values decay slowly.
+   *
+   * ~~~(c++)
+   * // 20 largest singular values of a 100000-by-512 matrix
+   * PiiMatrix<double> matU, matV;
+   * PiiMatrix<double> matS(Pii::truncatedSvDecompose(matA, 20, &matU, &matV));
+   * ~~~
+   *
+   * @param A the input matrix. Must be a floating-point matrix.
+   *
+   * @param k the number of singular values to calculate. Will be
+   * limited to the smaller dimension of *A*.
+   *
+   * @param U pointer to a matrix that will store U.
+   *
+   * @param V pointer to a matrix that will store V.
+   *
+   * @param oversampling the number of extra random samples.
+   *
+   * @param powerIterations the number of power iterations.
+   *
+   * @return the singular values as a row vector, in descending order.
+   */
+  template <class Matrix>
+  PiiMatrix<typename Matrix::value_type> truncatedSvDecompose(const Matrix& A, int k,
+                                                              PiiMatrix<typename Matrix::value_type>* U = 0,
+                                                              PiiMatrix<typename Matrix::value_type>* V = 0,
+                                                              int oversampling = 10,
+                                                              int powerIterations = 2)
+  {
+    typedef typename Matrix::value_type Real;
+    const PiiMatrix<Real> matA(A);
+    const int iRows = matA.rows(), iCols = matA.columns();
+    k = qBound(0, k, qMin(iRows, iCols));
+    if (k == 0)
+      {
+        if (U != 0) *U = PiiMatrix<Real>();
+        if (V != 0) *V = PiiMatrix<Real>();
+        return PiiMatrix<Real>();
+      }
+
+    const int iSamples = qMin(k + qMax(0, oversampling), qMin(iRows, iCols));
+    PiiMatrix<Real> matS;
+    // Random sampling does not pay off if the whole range is needed.
+    if (iSamples == qMin(iRows, iCols))
+      {
+        matS = svDecompose(matA, U, V, SvdThinU | SvdThinV);
+        if (U != 0) *U = PiiMatrix<Real>((*U)(0, 0, -1, k));
+        if (V != 0) *V = PiiMatrix<Real>((*V)(0, 0, -1, k));
+        return PiiMatrix<Real>(matS(0, 0, 1, k));
+      }
+
+    // Orthonormal base Q for the range of A*Omega, where Omega is a
+    // random n-by-l matrix.
+    const PiiMatrix<Real> matAt(transpose(matA));
+    PiiMatrix<Real> matQ(qrDecompose(matA * PiiMatrix<Real>(normalRandomMatrix(iCols, iSamples))));
+    // Power iterations: Q = qr((A*A')^q * A*Omega). Orthonormalizing
+    // between the products keeps rounding errors from wiping out the
+    // small singular values.
+    for (int i=0; i<powerIterations; ++i)
+      {
+        matQ = qrDecompose(matAt * matQ);
+        matQ = qrDecompose(matA * matQ);
+      }
+
+    // A ~ Q*Q'*A. Decompose the small n-by-l matrix C = A'*Q = Uc*S*Vc'
+    // to get A ~ (Q*Vc)*S*Uc'.
+    PiiMatrix<Real> matUc, matVc;
+    matS = svDecompose(matAt * matQ, V != 0 ? &matUc : 0, U != 0 ? &matVc : 0, SvdThinU | SvdThinV);
+    if (U != 0) *U = PiiMatrix<Real>((matQ * matVc)(0, 0, -1, k));
+    if (V != 0) *V = PiiMatrix<Real>(matUc(0, 0, -1, k));
+    return PiiMatrix<Real>(matS(0, 0, 1, k));
+  }
 }
 
 #endif //_PIISVDECOMPOSITION_H
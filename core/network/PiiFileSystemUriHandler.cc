@@ -64,6 +64,8 @@ void PiiFileSystemUriHandler::getFile(const QString& fileName,
                                       PiiHttpDevice* dev,
                                       PiiHttpProtocol::TimeLimiter* controller)
 {
+  // The device uses the same controller.
+  Q_UNUSED(controller);
   if (dev->requestMethod() not_member_of<QString> ("GET", "HEAD"))
     PII_THROW_HTTP_ERROR(MethodNotAllowedStatus);
   QFileInfo info(fileName);
@@ -103,8 +105,8 @@ void PiiFileSystemUriHandler::getFile(const QString& fileName,
   if (bLock && flock(file.handle(), LOCK_SH) == -1)
     piiWarning(tr("Cannot obtain a shared lock for %1.").arg(file.fileName()));
 #endif
-  // Read file contents and pass to the socket.
-  PiiNetwork::passData(&file, dev, iSize, controller);
+  // Pass file contents to the socket, without copying if possible.
+  dev->sendFile(&file, iSize);
 #ifdef Q_OS_LINUX
   if (bLock && flock(file.handle(), LOCK_UN) == -1)
     piiWarning(tr("Cannot unlock %1.").arg(file.fileName()));
@@ -115,6 +117,8 @@ void PiiFileSystemUriHandler::putFile(const QString& fileName,
                                       PiiHttpDevice* dev,
                                       PiiHttpProtocol::TimeLimiter* controller)
 {
+  // The device uses the same controller.
+  Q_UNUSED(controller);
   QFileInfo info(fileName);
   bool bExisted = info.exists();
 
@@ -132,7 +136,8 @@ void PiiFileSystemUriHandler::putFile(const QString& fileName,
       piiWarning(tr("Cannot open %1 for writing.").arg(tmpFile.fileName()));
       PII_THROW_HTTP_ERROR(InternalServerErrorStatus);
     }
-  if (PiiNetwork::passData(dev, &tmpFile, dev->requestHeader().contentLength(), controller) == -1)
+  // readBody() also handles chunked uploads.
+  if (dev->readBody(&tmpFile) == -1)
     {
       piiWarning(tr("Uploading to %1 failed.").arg(tmpFile.fileName()));
       PII_THROW_HTTP_ERROR(InternalServerErrorStatus);
@@ -65,7 +65,7 @@ struct PII_NETWORK_EXPORT PiiGenericSocketDescriptor
     void* customDescriptor;
   };
 
-  inline bool operator== (PiiGenericSocketDescriptor other)
+  inline bool operator== (PiiGenericSocketDescriptor other) const
   {
     return std::memcmp(this, &other, sizeof(PiiGenericSocketDescriptor)) == 0;
   }
@@ -23,6 +23,7 @@
 #include <QTextCodec>
 #include <QAbstractSocket>
 #include <QLocalSocket>
+#include <QFile>
 
 #include <PiiDelay.h>
 #include <PiiUtil.h>
@@ -34,6 +35,12 @@
 #include <PiiGenericBinaryOutputArchive.h>
 #include <PiiInvalidArgumentException.h>
 
+#ifdef Q_OS_LINUX
+#  include <sys/sendfile.h>
+#  include <poll.h>
+#  include <errno.h>
+#endif
+
 PiiHttpDevice::Data::Data(PiiHttpDevice* owner, const PiiSocketDevice& device, Mode mode) :
   mode(mode),
   pSocket(device),
@@ -49,7 +56,13 @@ PiiHttpDevice::Data::Data(PiiHttpDevice* owner, const PiiSocketDevice& device, M
   bFinished(false),
   iBodyLength(-1),
   iHeaderLength(-1),
-  iDataTimeout(5000)
+  iDataTimeout(5000),
+  iChunkSize(16384),
+  bChunkedInput(false),
+  bChunkedOutput(false),
+  iChunkBytesLeft(0),
+  bLastChunkRead(false),
+  bOutOfSync(false)
 {
 }
 
@@ -68,6 +81,9 @@ PiiHttpDevice::~PiiHttpDevice()
 qint64 PiiHttpDevice::flushFilter()
 {
   PII_D;
+  // Send buffered chunk data
+  if (d->bChunkedOutput && !writeChunk(0, 0))
+    return -1;
   qint64 iTotalBytesToWrite = d->pSocket->bytesToWrite();
   while (d->pSocket->bytesToWrite() > 0)
     {
@@ -84,8 +100,22 @@ qint64 PiiHttpDevice::flushFilter()
 void PiiHttpDevice::finish()
 {
   PII_D;
+  // If the client closed a persistent connection without sending
+  // anything, there is nothing to respond to.
+  if (d->mode == Server && d->bHeaderRead && d->iHeaderLength == 0)
+    d->bFinished = true;
+
   if (!d->bFinished && isWritable())
     {
+      // The next pipelined request starts after this one's body.
+      if (d->mode == Server && d->bHeaderRead &&
+          connectionType() == KeepAliveConnection && !discardUnreadBody())
+        {
+          d->bOutOfSync = true;
+          if (!d->bHeaderSent)
+            setHeader("Connection", "close");
+        }
+
       endOutputFiltering(this);
 
       // If nothing has been sent, send header.
@@ -96,6 +126,8 @@ void PiiHttpDevice::finish()
           sendHeader();
         }
 
+      finishChunkedOutput();
+
       // Flush the device if it is still connected
       if (d->pSocket->bytesToWrite() > 0 && isWritable())
         d->pSocket->waitForBytesWritten(5000);
@@ -141,10 +173,23 @@ PiiHttpResponseHeader PiiHttpDevice::responseHeader() const
 PiiHttpDevice::ConnectionType PiiHttpDevice::connectionType() const
 {
   const PII_D;
-  return (d->requestHeader.value("connection").toLower() == "close" ||
-          d->responseHeader.value("connection").toLower() == "close") ?
-    CloseConnection :
-    KeepAliveConnection;
+  if (d->bOutOfSync ||
+      d->requestHeader.value("connection").toLower() == "close" ||
+      d->responseHeader.value("connection").toLower() == "close")
+    return CloseConnection;
+
+  // HTTP/1.0 connections are persistent only if explicitly requested.
+  const PiiMimeHeader& peerHeader = d->mode == Server ?
+    static_cast<const PiiMimeHeader&>(d->requestHeader) :
+    static_cast<const PiiMimeHeader&>(d->responseHeader);
+  PiiVersionNumber peerVersion(d->mode == Server ?
+                               d->requestHeader.httpVersion() :
+                               d->responseHeader.httpVersion());
+  if (peerVersion < PiiVersionNumber(1,1) &&
+      peerHeader.value("connection").toLower() != "keep-alive")
+    return CloseConnection;
+
+  return KeepAliveConnection;
 }
 
 QString PiiHttpDevice::requestMethod() const
@@ -247,7 +292,57 @@ qint64 PiiHttpDevice::filterData(const char* data, qint64 maxSize)
 {
   // Must ensure that headers are sent first.
   sendHeader();
-  return writeToSocket(data, maxSize);
+  PII_D;
+  if (!d->bChunkedOutput)
+    return writeToSocket(data, maxSize);
+
+  // Collect small writes to avoid sending tiny chunks.
+  if (d->aChunkBuffer.size() + maxSize < d->iChunkSize)
+    {
+      d->aChunkBuffer.append(data, int(maxSize));
+      return maxSize;
+    }
+  return writeChunk(data, maxSize) ? maxSize : -1;
+}
+
+void PiiHttpDevice::startChunkedOutput()
+{
+  PII_D;
+  setHeader("Transfer-Encoding", "chunked");
+  d->bChunkedOutput = true;
+  // Retains the capacity when the buffer is emptied.
+  d->aChunkBuffer.reserve(d->iChunkSize);
+}
+
+bool PiiHttpDevice::writeChunk(const char* data, qint64 size)
+{
+  PII_D;
+  const qint64 iChunkLength = d->aChunkBuffer.size() + size;
+  if (iChunkLength == 0)
+    return true;
+
+  // A chunk consists of its length in hex, the data and a CRLF. The
+  // buffered data and the new data are written separately to avoid
+  // copying large blocks.
+  QByteArray aHeader(QByteArray::number(iChunkLength, 16) + "\r\n");
+  bool bSuccess =
+    writeToSocket(aHeader.constData(), aHeader.size()) == aHeader.size() &&
+    writeToSocket(d->aChunkBuffer.constData(), d->aChunkBuffer.size()) == d->aChunkBuffer.size() &&
+    (size == 0 || writeToSocket(data, size) == size) &&
+    writeToSocket("\r\n", 2) == 2;
+  d->aChunkBuffer.resize(0);
+  return bSuccess;
+}
+
+void PiiHttpDevice::finishChunkedOutput()
+{
+  PII_D;
+  if (!d->bChunkedOutput)
+    return;
+  // A zero-length chunk ends the message.
+  if (!writeChunk(0, 0) || writeToSocket("0\r\n\r\n", 5) != 5)
+    d->bOutOfSync = true;
+  d->bChunkedOutput = false;
 }
 
 PiiStreamFilter* PiiHttpDevice::outputFilter() const
@@ -563,6 +658,18 @@ qint64 PiiHttpDevice::readData(char* bytes, qint64 maxSize)
   if (d->bHeaderRead)
     d->bBodyRead = true;
 
+  if (d->bChunkedInput)
+    {
+      qint64 iRead = readChunkedData(bytes, maxSize);
+      if (iRead > 0)
+        {
+          d->iBytesRead += iRead;
+          if (d->iMessageSizeLimit > 0 && d->iBytesRead > d->iMessageSizeLimit)
+            return -1;
+        }
+      return iRead;
+    }
+
   // We know how much there is to come...
   if (d->iHeaderLength != -1 && d->iBodyLength != -1)
     {
@@ -595,6 +702,199 @@ qint64 PiiHttpDevice::readData(char* bytes, qint64 maxSize)
   return iRead;
 }
 
+qint64 PiiHttpDevice::readChunkedData(char* bytes, qint64 maxSize)
+{
+  PII_D;
+  if (d->bOutOfSync)
+    return -1;
+
+  // Fill the whole buffer unless the last chunk is reached. Returning
+  // less than requested before that would be interpreted as the end
+  // of the body.
+  qint64 iTotalBytes = 0;
+  while (iTotalBytes < maxSize && !d->bLastChunkRead)
+    {
+      if (d->iChunkBytesLeft == 0)
+        {
+          // Chunk size in hex, possibly followed by extensions.
+          QByteArray aLine;
+          if (!readSocketLine(&aLine))
+            break;
+          int iExtensionPos = aLine.indexOf(';');
+          if (iExtensionPos != -1)
+            aLine.truncate(iExtensionPos);
+          bool bOk = false;
+          qint64 iChunkLength = aLine.trimmed().toLongLong(&bOk, 16);
+          if (!bOk || iChunkLength < 0)
+            {
+              d->bOutOfSync = true;
+              break;
+            }
+          if (iChunkLength == 0)
+            {
+              // Skip trailer headers up to the terminating empty line.
+              do
+                {
+                  if (!readSocketLine(&aLine))
+                    {
+                      d->bOutOfSync = true;
+                      break;
+                    }
+                }
+              while (!aLine.isEmpty());
+              d->bLastChunkRead = true;
+              break;
+            }
+          d->iChunkBytesLeft = iChunkLength;
+        }
+
+      qint64 iBytesToRead = qMin(maxSize - iTotalBytes, d->iChunkBytesLeft);
+      qint64 iRead = d->pSocket.readWaited(bytes + iTotalBytes, iBytesToRead,
+                                           d->iDataTimeout, d->pController);
+      if (iRead <= 0)
+        break;
+      iTotalBytes += iRead;
+      d->iChunkBytesLeft -= iRead;
+      if (d->iChunkBytesLeft == 0)
+        {
+          // Each chunk is followed by a CRLF.
+          QByteArray aLine;
+          if (!readSocketLine(&aLine) || !aLine.isEmpty())
+            {
+              d->bOutOfSync = true;
+              break;
+            }
+        }
+      // Timed out
+      if (iRead < iBytesToRead)
+        break;
+    }
+
+  if (iTotalBytes == 0 && d->bOutOfSync)
+    return -1;
+  return iTotalBytes;
+}
+
+bool PiiHttpDevice::readSocketLine(QByteArray* line)
+{
+  PII_D;
+  line->resize(0);
+  char c;
+  // Chunk headers are short. This limit just prevents a malicious
+  // peer from making us buffer data forever.
+  while (line->size() < 1024)
+    {
+      if (d->pSocket.readWaited(&c, 1, d->iDataTimeout, d->pController) != 1)
+        return false;
+      if (c == '\n')
+        {
+          if (line->endsWith('\r'))
+            line->chop(1);
+          return true;
+        }
+      line->append(c);
+    }
+  return false;
+}
+
+bool PiiHttpDevice::discardUnreadBody()
+{
+  PII_D;
+  if (!d->bHeaderRead || d->iHeaderLength < 0 ||
+      (!d->bChunkedInput && d->iBodyLength < 0))
+    return false;
+
+  char buffer[4096];
+  qint64 iBytesRead;
+  while ((iBytesRead = read(buffer, sizeof(buffer))) > 0) ;
+
+  if (iBytesRead < 0)
+    return false;
+  return d->bChunkedInput ?
+    d->bLastChunkRead :
+    d->iBytesRead >= d->iHeaderLength + d->iBodyLength;
+}
+
+qint64 PiiHttpDevice::sendFile(QFile* file, qint64 bytes)
+{
+  PII_D;
+  if (bytes < 0)
+    bytes = file->size() - file->pos();
+  if (!sendHeader())
+    return -1;
+  if (bytes == 0)
+    return 0;
+
+#ifdef Q_OS_LINUX
+  // If the data doesn't need to be filtered or encoded, the kernel
+  // can copy it directly from the page cache to the socket.
+  if (d->pActiveOutputFilter == this && !d->bChunkedOutput && file->handle() != -1)
+    {
+      int iSocket = nativeSocketDescriptor();
+      if (iSocket != -1)
+        return sendFileDirectly(iSocket, file, bytes);
+    }
+#endif
+  return PiiNetwork::passData(file, this, bytes, d->pController);
+}
+
+int PiiHttpDevice::nativeSocketDescriptor() const
+{
+  QIODevice* pDevice = _d()->pSocket.device();
+  // Encrypted data must go through Qt.
+  if (pDevice->inherits("QSslSocket"))
+    return -1;
+  if (QAbstractSocket* pSocket = qobject_cast<QAbstractSocket*>(pDevice))
+    return int(pSocket->socketDescriptor());
+  if (QLocalSocket* pSocket = qobject_cast<QLocalSocket*>(pDevice))
+    return int(pSocket->socketDescriptor());
+  return -1;
+}
+
+#ifdef Q_OS_LINUX
+qint64 PiiHttpDevice::sendFileDirectly(int socket, QFile* file, qint64 bytes)
+{
+  PII_D;
+  // Whatever Qt has buffered must go first.
+  if (flushFilter() < 0 || d->pSocket->bytesToWrite() > 0)
+    return -1;
+
+  off_t iOffset = off_t(file->pos());
+  qint64 iTotalBytes = 0;
+  PiiTimer timer;
+  while (iTotalBytes < bytes)
+    {
+      if (d->pController != 0 && !d->pController->canContinue())
+        break;
+      ssize_t iSent = ::sendfile(socket, file->handle(), &iOffset,
+                                 size_t(qMin(bytes - iTotalBytes, qint64(1) << 30)));
+      if (iSent > 0)
+        {
+          iTotalBytes += iSent;
+          timer.restart();
+          continue;
+        }
+      // Unexpected end of file
+      if (iSent == 0)
+        break;
+      if (errno == EINTR)
+        continue;
+      if (errno != EAGAIN)
+        break;
+      // Qt sockets are non-blocking. Wait until the socket can take
+      // more, checking the controller every now and then.
+      if (timer.milliseconds() >= d->iDataTimeout)
+        break;
+      pollfd fd = { socket, POLLOUT, 0 };
+      ::poll(&fd, 1, 100);
+    }
+  file->seek(qint64(iOffset));
+  return iTotalBytes == bytes ? iTotalBytes : -1;
+}
+#else
+qint64 PiiHttpDevice::sendFileDirectly(int, QFile*, qint64) { return -1; }
+#endif
+
 QByteArray PiiHttpDevice::readBody()
 {
   PII_D;
@@ -659,10 +959,26 @@ bool PiiHttpDevice::isSequential() const
 bool PiiHttpDevice::sendResponseHeader()
 {
   PII_D;
+  const int iStatus = d->responseHeader.statusCode();
+  const bool bHasBody = requestMethod() != "HEAD" && iStatus >= 200 &&
+    iStatus != PiiHttpProtocol::NoContentStatus &&
+    iStatus != PiiHttpProtocol::NotModifiedStatus;
+  const bool bHttp11 = d->requestHeader.httpVersion() >= PiiVersionNumber(1,1);
   // If the response header has no Content-Length, the end of the
-  // transfer must be indicated by closing the connection.
-  if (!d->responseHeader.hasContentLength() && !d->responseHeader.hasKey("Connection"))
-    setHeader("Connection", "close");
+  // transfer must be indicated either by a zero-length chunk or by
+  // closing the connection. HTTP/1.0 clients don't understand
+  // chunks.
+  if (bHasBody &&
+      !d->responseHeader.hasContentLength() &&
+      !d->responseHeader.hasKey("Transfer-Encoding"))
+    {
+      if (d->iChunkSize > 0 && bHttp11 && connectionType() == KeepAliveConnection)
+        startChunkedOutput();
+      else if (!d->responseHeader.hasKey("Connection"))
+        setHeader("Connection", "close");
+    }
+  else if (!bHttp11 && connectionType() == KeepAliveConnection)
+    setHeader("Connection", "keep-alive");
 
   QByteArray aHeader(d->responseHeader.toByteArray());
   return writeToSocket(aHeader.constData(), aHeader.size()) == aHeader.size();
@@ -681,7 +997,10 @@ bool PiiHttpDevice::decodeResponseHeader()
       PiiHttpResponseHeader header(aHeader);
       if (!header.isValid())
         return false;
-      if (header.hasContentLength())
+      // Transfer-Encoding overrides Content-Length.
+      if (header.value("Transfer-Encoding").toLower().contains("chunked"))
+        d->bChunkedInput = true;
+      else if (header.hasContentLength())
         d->iBodyLength = header.contentLength();
 
       d->responseHeader = header;
@@ -740,6 +1059,12 @@ void PiiHttpDevice::createQueryString()
 bool PiiHttpDevice::sendRequestHeader()
 {
   PII_D;
+  // A request body of unknown length can only be sent in chunks.
+  if (d->iChunkSize > 0 &&
+      !d->requestHeader.hasContentLength() &&
+      !d->requestHeader.hasKey("Transfer-Encoding") &&
+      requestMethod() != "GET" && requestMethod() != "HEAD")
+    startChunkedOutput();
   QByteArray aHeader(d->requestHeader.toByteArray());
   return writeToSocket(aHeader.constData(), aHeader.size()) == aHeader.size();
 }
@@ -760,8 +1085,13 @@ bool PiiHttpDevice::decodeRequestHeader()
           return false;
         }
 
-      if (header.hasContentLength())
+      if (header.value("Transfer-Encoding").toLower().contains("chunked"))
+        d->bChunkedInput = true;
+      else if (header.hasContentLength())
         d->iBodyLength = header.contentLength();
+      else
+        // A request with neither has no body.
+        d->iBodyLength = 0;
 
       d->requestHeader = header;
       parseQueryValues(header.path());
@@ -825,13 +1155,21 @@ void PiiHttpDevice::restart()
   destroyOutputFilters();
 
   clearBuffer(this);
-  clearBuffer(d->pSocket);
+  // On the server side, the socket may already contain the next
+  // pipelined request.
+  if (d->mode == Client)
+    clearBuffer(d->pSocket);
 
   d->bBodyRead = false;
   d->bHeaderRead = d->bHeaderSent = false;
   d->iBytesRead = d->iBytesWritten = 0;
   d->iBodyLength = d->iHeaderLength = -1;
   d->bFinished = false;
+  d->bChunkedInput = d->bChunkedOutput = false;
+  d->iChunkBytesLeft = 0;
+  d->bLastChunkRead = false;
+  d->bOutOfSync = false;
+  d->aChunkBuffer.resize(0);
   d->mapFormValues.clear();
   d->lstFormItems.clear();
   d->mapQueryValues.clear();
@@ -840,3 +1178,5 @@ void PiiHttpDevice::restart()
 
 void PiiHttpDevice::setDataTimeout(int dataTimeout) { _d()->iDataTimeout = dataTimeout; }
 int PiiHttpDevice::dataTimeout() const { return _d()->iDataTimeout; }
+void PiiHttpDevice::setChunkSize(int chunkSize) { _d()->iChunkSize = qMax(chunkSize, 0); }
+int PiiHttpDevice::chunkSize() const { return _d()->iChunkSize; }
@@ -29,6 +29,7 @@
 #include "PiiHttpResponseHeader.h"
 
 class QTextCodec;
+class QFile;
 class PiiProgressController;
 
 /**
@@ -76,6 +77,18 @@ class PiiProgressController;
  * utilizes the buffer by automatically setting the Content-Length
  * header.
  *
+ * If the length of the message body is not known when the header is
+ * sent, PiiHttpDevice uses the chunked transfer coding, unless the
+ * other end only understands HTTP/1.0. Small writes are collected
+ * into a buffer of at most [chunkSize()] bytes before a chunk is sent.
+ * Chunked messages received from the other end are decoded
+ * transparently.
+ *
+ * Connections are persistent by default. On the server side,
+ * [finish()] skips the unread part of the request body so that the
+ * next request, which the client may have sent without waiting for
+ * the response, can be read from the same connection.
+ *
  * In `Client` mode, the I/O device must be created first.
  * PiiNetworkClient can be used to easily create a suitable I/O
  * device:
@@ -142,8 +155,11 @@ public:
 
   /**
    * Returns the connection type. If either the request or the
-   * response header specifies "Connection: close" returns
-   * `CloseConnection`. Otherwise returns `KeepAliveConnection`.
+   * response header specifies "Connection: close", or the end of the
+   * previous message could not be found, returns `CloseConnection`.
+   * HTTP/1.0 connections are closed unless the other end sent
+   * "Connection: keep-alive". Otherwise returns
+   * `KeepAliveConnection`.
    */
   ConnectionType connectionType() const;
 
@@ -610,6 +626,20 @@ public:
    */
   void discardBody();
 
+  /**
+   * Sends *bytes* bytes from *file*, starting at the current position
+   * of the file. If *bytes* is negative, everything up to the end of
+   * the file will be sent. Headers will be sent first, if needed.
+   *
+   * If no output filters are active and the message is not chunked,
+   * the data is copied to the socket by the kernel using `sendfile`
+   * on Linux. Otherwise, the file is read and written to the device
+   * in blocks.
+   *
+   * @return the number of bytes sent, or -1 on failure
+   */
+  qint64 sendFile(QFile* file, qint64 bytes = -1);
+
   /**
    * Reads request/response header. This function checks that the
    * header has not been read and calls the protected [decodeHeader()]
@@ -706,6 +736,17 @@ public:
   void setDataTimeout(int dataTimeout);
   int dataTimeout() const;
 
+  /**
+   * Sets the maximum number of bytes buffered before a chunk is
+   * written to the socket in chunked transfer mode. Larger writes are
+   * sent as a single chunk without copying. The default is 16384.
+   * Setting the chunk size to zero disables chunked output; the end
+   * of a message without a Content-Length header will then be
+   * indicated by closing the connection.
+   */
+  void setChunkSize(int chunkSize);
+  int chunkSize() const;
+
 protected:
   qint64 readData(char* data, qint64 maxSize);
   qint64 writeData(const char * data, qint64 maxSize);
@@ -732,6 +773,15 @@ private:
   bool sendRequestHeader();
   bool decodeRequestHeader();
 
+  void startChunkedOutput();
+  bool writeChunk(const char* data, qint64 size);
+  void finishChunkedOutput();
+  qint64 readChunkedData(char* data, qint64 maxSize);
+  bool readSocketLine(QByteArray* line);
+  bool discardUnreadBody();
+  int nativeSocketDescriptor() const;
+  qint64 sendFileDirectly(int socket, QFile* file, qint64 bytes);
+
   /// @internal
   class Data : public PiiStreamFilter::Data
   {
@@ -758,6 +808,15 @@ private:
     bool bBodyRead, bFinished;
     qint64 iBodyLength, iHeaderLength;
     int iDataTimeout;
+    int iChunkSize;
+    bool bChunkedInput, bChunkedOutput;
+    // Bytes left in the chunk being read. Zero means the next chunk
+    // header must be read first.
+    qint64 iChunkBytesLeft;
+    bool bLastChunkRead;
+    // Set if the end of the incoming message could not be found.
+    bool bOutOfSync;
+    QByteArray aChunkBuffer;
   };
   PII_D_FUNC;
 
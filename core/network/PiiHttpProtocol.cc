@@ -87,68 +87,72 @@ void PiiHttpProtocol::unregisterAllHandlers(UriHandler* handler)
 
 void PiiHttpProtocol::communicate(QIODevice* dev, PiiProgressController* controller)
 {
-  PII_D;
   // This loop handles keep-alive connections.
-  while (controller->canContinue())
+  while (controller->canContinue() && communicateOnce(dev, controller)) ;
+}
+
+bool PiiHttpProtocol::communicateOnce(QIODevice* dev, PiiProgressController* controller)
+{
+  PII_D;
+  PiiHttpDevice httpDevice(dev, PiiHttpDevice::Server);
+  httpDevice.setController(controller);
+  if (!httpDevice.readHeader())
+    return false;
+  // If the header indicates the message will be too large, cut
+  // the request short right here.
+  if (httpDevice.messageSizeLimit() > 0 &&
+      qMax(qint64(0), httpDevice.bodyLength()) + httpDevice.headerLength() > httpDevice.messageSizeLimit())
     {
-      PiiHttpDevice httpDevice(dev, PiiHttpDevice::Server);
-      httpDevice.setController(controller);
-      if (!httpDevice.readHeader())
-        return;
-      // If the header indicates the message will be too large, cut
-      // the request short right here.
-      if (httpDevice.messageSizeLimit() > 0 &&
-          qMax(qint64(0), httpDevice.bodyLength()) + httpDevice.headerLength() > httpDevice.messageSizeLimit())
+      httpDevice.setStatus(RequestEntityTooLargeStatus);
+      // Don't bother reading the body.
+      httpDevice.setHeader("Connection", "close");
+      return false;
+    }
+
+  // Interrupted
+  if (!controller->canContinue())
+    {
+      httpDevice.setStatus(ServiceUnavailableStatus);
+      httpDevice.setHeader("Connection", "close");
+      return false;
+    }
+
+  HandlerPair pair = findHandler(httpDevice.requestUri());
+  if (pair.second != 0)
+    {
+      TimeLimiter limiter(controller, d->iMaxConnectionTime);
+      try
         {
-          httpDevice.setStatus(RequestEntityTooLargeStatus);
-          return;
+          httpDevice.setController(&limiter);
+          piiDebug(httpDevice.requestMethod() + " " + httpDevice.requestPath());
+          pair.second->handleRequest(pair.first, &httpDevice, &limiter);
         }
-
-      // Interrupted
-      if (!controller->canContinue())
+      catch (PiiHttpException& ex)
         {
-          httpDevice.setStatus(ServiceUnavailableStatus);
-          return;
+          httpDevice.setStatus(ex.statusCode());
+          httpDevice.print(ex.message());
+          piiWarning(ex.location("", ": ") +
+                     httpDevice.requestMethod() + " " + httpDevice.requestPath() + " " +
+                     QString::number(ex.statusCode()) + " " + ex.message());
         }
-
-      HandlerPair pair = findHandler(httpDevice.requestUri());
-      if (pair.second != 0)
+      catch (PiiException& ex)
         {
-          TimeLimiter limiter(controller, d->iMaxConnectionTime);
-          try
-            {
-              httpDevice.setController(&limiter);
-              piiDebug(httpDevice.requestMethod() + " " + httpDevice.requestPath());
-              pair.second->handleRequest(pair.first, &httpDevice, &limiter);
-            }
-          catch (PiiHttpException& ex)
-            {
-              httpDevice.setStatus(ex.statusCode());
-              httpDevice.print(ex.message());
-              piiWarning(ex.location("", ": ") +
-                         httpDevice.requestMethod() + " " + httpDevice.requestPath() + " " +
-                         QString::number(ex.statusCode()) + " " + ex.message());
-            }
-          catch (PiiException& ex)
-            {
-              httpDevice.setStatus(InternalServerErrorStatus);
-              httpDevice.print(ex.message());
-              piiWarning(ex.location("", ": ") + ex.message());
-            }
-          httpDevice.setController(0);
+          httpDevice.setStatus(InternalServerErrorStatus);
+          httpDevice.print(ex.message());
+          piiWarning(ex.location("", ": ") + ex.message());
         }
-      else
-        httpDevice.setStatus(NotFoundStatus);
+      httpDevice.setController(0);
+    }
+  else
+    httpDevice.setStatus(NotFoundStatus);
 
-      httpDevice.finish();
+  httpDevice.finish();
 
-      // HTTP/1.1 behavior: we'll only close the connection if the
-      // client or the handler specifically asked to do so, or the
-      // client just closed the connection.
-      if (httpDevice.connectionType() == PiiHttpDevice::CloseConnection ||
-          !httpDevice.isWritable())
-        return;
-    }
+  // HTTP/1.1 behavior: we'll only close the connection if the
+  // client or the handler specifically asked to do so, or the
+  // client just closed the connection.
+  return httpDevice.connectionType() != PiiHttpDevice::CloseConnection &&
+    httpDevice.isWritable();
 }
 
 PiiHttpProtocol::UriHandler* PiiHttpProtocol::uriHandler(const QString& uri, bool exactMatch)
@@ -166,6 +166,7 @@ public:
   ~PiiHttpProtocol();
 
   void communicate(QIODevice* dev, PiiProgressController* controller);
+  bool communicateOnce(QIODevice* dev, PiiProgressController* controller);
 
   /**
    * Register a URI handler. He caller retains the ownership of the
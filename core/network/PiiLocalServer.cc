@@ -65,6 +65,23 @@ QString PiiLocalServer::serverAddress() const
 }
 
 
+int PiiLocalServer::pollDescriptor(PiiGenericSocketDescriptor socketDescriptor) const
+{
+  // Named pipes cannot be polled.
+#ifndef Q_OS_WIN
+  return int(socketDescriptor.localSocketDescriptor);
+#else
+  Q_UNUSED(socketDescriptor);
+  return -1;
+#endif
+}
+
+PiiGenericSocketDescriptor PiiLocalServer::genericDescriptor(int pollDescriptor) const
+{
+  return PiiGenericSocketDescriptor(quintptr(pollDescriptor));
+}
+
+
 PiiLocalServer::EntryPoint::EntryPoint(PiiLocalServer* owner) : _pOwner(owner) {}
 void PiiLocalServer::EntryPoint::incomingConnection(quintptr sockedFd) { _pOwner->incomingConnection(sockedFd); }
 
@@ -52,6 +52,9 @@ protected:
 
   void stopListening();
 
+  int pollDescriptor(PiiGenericSocketDescriptor socketDescriptor) const;
+  PiiGenericSocketDescriptor genericDescriptor(int pollDescriptor) const;
+
 private:
   class EntryPoint : public QLocalServer
   {
@@ -17,6 +17,8 @@
 #include "PiiMimeHeader.h"
 #include "PiiMimeException.h"
 
+#include <cstring>
+
 PiiMultipartDecoder::Data::Data(QIODevice* device) :
   pDevice(device),
   bHeadersRead(false),
@@ -72,61 +74,94 @@ qint64 PiiMultipartDecoder::readData(char* data, qint64 maxSize)
   // delimiter.
   else if (d->aBoundary.size() > 0)
     {
-      // Read at most the size of the boundary bytes
-      qint64 iBytesRead = d->pDevice->read(data, qMin(d->aBoundary.size(), int(maxSize)));
-      if (iBytesRead <= 0)
-        return iBytesRead;
-
-      // Check received data for the boundary marker
-      int i = 0, iTailLength = 0, iPeekLength = 0;
-      while (i < iBytesRead)
-        {
-          // If the end of the read data matches the beginning of the
-          // boundary marker, we must check if this is really the
-          // start of the boundary.
-          iTailLength = iBytesRead - i;
-          iPeekLength = d->aBoundary.size()-iTailLength;
-          if (std::memcmp(d->aBoundary.constData(), data + i, iTailLength) == 0)
-            {
-              // either the boundary was fully matched ...
-              if (iPeekLength == 0)
-                break;
-              else
-                {
-                  // ... or the data to come next is the boundary
-                  QByteArray aRest = d->pDevice->peek(iPeekLength);
-                  if (aRest.size() == iPeekLength &&
-                      std::memcmp(aRest.constData(), d->aBoundary.constData() + iTailLength, iPeekLength) == 0)
-                    break;
-                }
-            }
-          ++i;
-        }
+      // Look at as much data as the caller can take and only consume
+      // the bytes that precede the boundary. This way the boundary
+      // never needs to be put back to the device.
+      qint64 iBytesPeeked = d->pDevice->peek(data, maxSize);
+      if (iBytesPeeked <= 0)
+        return iBytesPeeked;
 
-      // Great, we found the boundary
-      if (i < iBytesRead)
+      bool bBoundaryFound = false;
+      qint64 iBodyBytes = findBoundary(data, iBytesPeeked, &bBoundaryFound);
+      if (bBoundaryFound)
         {
-          // Put the boundary marker back. nextMessage() will handle it.
-          while (iBytesRead > i)
-            d->pDevice->ungetChar(data[--iBytesRead]);
-
-          // This blocks reads beyond the boundary.
+          // This blocks reads beyond the boundary. nextMessage()
+          // will handle it.
           d->iContentLength = 0;
           // This allows one to read a new header.
           d->bHeadersRead = false;
         }
-      return iBytesRead;
+      if (iBodyBytes == 0)
+        return 0;
+      return d->pDevice->read(data, iBodyBytes);
     }
   // No boundary, no Content-Length. Too bad...
   else
     return d->pDevice->read(data, maxSize);
 }
 
+qint64 PiiMultipartDecoder::findBoundary(const char* data, qint64 size, bool* found)
+{
+  const int iBoundarySize = d->aBoundary.size();
+  const char* pBoundary = d->aBoundary.constData();
+  const char* pEnd = data + size;
+  const char* pCandidate = data;
+  // Jump between occurrences of the first boundary character
+  // instead of comparing the whole boundary at each byte.
+  while ((pCandidate = static_cast<const char*>(std::memchr(pCandidate, *pBoundary, pEnd - pCandidate))) != 0)
+    {
+      const qint64 iOffset = pCandidate - data;
+      const int iTailLength = int(qMin(qint64(iBoundarySize), size - iOffset));
+      if (std::memcmp(pCandidate, pBoundary, iTailLength) == 0)
+        {
+          // The boundary was fully matched.
+          if (iTailLength == iBoundarySize)
+            {
+              *found = true;
+              return iOffset;
+            }
+          // The end of the data matches the beginning of the
+          // boundary. Return the bytes before it and look again once
+          // more data is available.
+          if (iOffset > 0)
+            return iOffset;
+          // There is nothing before the partial match. Check if the
+          // data to come next completes the boundary.
+          QByteArray aRest = d->pDevice->peek(iBoundarySize);
+          if (aRest.size() == iBoundarySize &&
+              std::memcmp(aRest.constData(), pBoundary, iBoundarySize) == 0)
+            {
+              *found = true;
+              return 0;
+            }
+        }
+      ++pCandidate;
+    }
+  return size;
+}
+
 qint64 PiiMultipartDecoder::writeData(const char* data, qint64 maxSize)
 {
   return d->pDevice->write(data, maxSize);
 }
 
+bool PiiMultipartDecoder::waitForReadyRead(int msecs)
+{
+  // No more data will come before the next header has been read.
+  if (d->iContentLength == 0)
+    return false;
+  return d->pDevice->waitForReadyRead(msecs);
+}
+
+qint64 PiiMultipartDecoder::skipBody()
+{
+  char buffer[4096];
+  qint64 iTotalBytes = 0, iBytesRead;
+  while ((iBytesRead = read(buffer, sizeof(buffer))) > 0)
+    iTotalBytes += iBytesRead;
+  return iTotalBytes;
+}
+
 bool PiiMultipartDecoder::isSequential() const
 {
   return d->pDevice->isSequential();
@@ -164,7 +164,17 @@ public:
    */
   int depth();
 
+  /**
+   * Reads and discards the rest of the current body part. Unlike
+   * `readAll`(), this function does not collect the skipped data
+   * into memory.
+   *
+   * @return the number of bytes skipped
+   */
+  qint64 skipBody();
+
   bool isSequential() const;
+  bool waitForReadyRead(int msecs);
   qint64 bytesAvailable() const;
 
 protected:
@@ -183,6 +193,7 @@ private:
   void popHeader();
   void updateBodyPartInfo();
   bool readPreamble();
+  qint64 findBoundary(const char* data, qint64 size, bool* found);
 
   /// @internal
   class Data
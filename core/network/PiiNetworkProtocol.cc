@@ -37,3 +37,9 @@ PiiNetworkProtocol* PiiNetworkProtocol::clone() const
 {
   return const_cast<PiiNetworkProtocol*>(this);
 }
+
+bool PiiNetworkProtocol::communicateOnce(QIODevice* dev, PiiProgressController* controller)
+{
+  communicate(dev, controller);
+  return false;
+}
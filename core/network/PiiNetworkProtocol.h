@@ -55,6 +55,25 @@ public:
    */
   virtual void communicate(QIODevice* dev, PiiProgressController* controller) = 0;
 
+  /**
+   * Serves a single request and returns. This function is used by
+   * PiiNetworkServer in the [event-driven
+   * mode](PiiNetworkServer::ioMode), in which idle connections are
+   * not bound to a thread. The next request in the same connection
+   * may be served by a different thread and a different clone of the
+   * protocol, and through a different QIODevice that wraps the same
+   * connection.
+   *
+   * Protocols that have a notion of a request, such as HTTP, should
+   * override this function. The default implementation calls
+   * [communicate()] and returns `false`, which makes the whole
+   * connection to be served at once.
+   *
+   * @return `true` if the connection should be kept open for
+   * further requests, `false` if it should be closed.
+   */
+  virtual bool communicateOnce(QIODevice* dev, PiiProgressController* controller);
+
   /**
    * Creates a copy of the protocol. This function is used by
    * PiiNetworkServer to create a copy of a protocol object for each
@@ -0,0 +1,344 @@
+/* This file is part of Into.
+ * Copyright (C) Intopii 2013.
+ * All rights reserved.
+ *
+ * Licensees holding a commercial Into license may use this file in
+ * accordance with the commercial license agreement. Please see
+ * LICENSE.commercial for commercial licensing terms.
+ *
+ * Alternatively, this file may be used under the terms of the GNU
+ * Affero General Public License version 3 as published by the Free
+ * Software Foundation. In addition, Intopii gives you special rights
+ * to use Into as a part of open source software projects. Please
+ * refer to LICENSE.AGPL3 for details.
+ */
+
+
+#include "PiiNetworkReactor.h"
+#include <PiiAsyncCall.h>
+#include <QThread>
+#include <QDateTime>
+
+#if defined(Q_OS_LINUX)
+#  define PII_REACTOR_EPOLL
+#  include <sys/epoll.h>
+#elif defined(Q_OS_MAC) || defined(Q_OS_FREEBSD) || defined(Q_OS_NETBSD) || defined(Q_OS_OPENBSD)
+#  define PII_REACTOR_KQUEUE
+#  include <sys/types.h>
+#  include <sys/event.h>
+#  include <sys/time.h>
+#elif !defined(Q_OS_WIN)
+#  define PII_REACTOR_POLL
+#  include <poll.h>
+#  include <QVector>
+#endif
+
+#ifndef Q_OS_WIN
+#  include <unistd.h>
+#  include <fcntl.h>
+#  include <errno.h>
+#endif
+
+PiiNetworkReactor::Data::Data(Listener* listener) :
+  pListener(listener),
+  pThread(0),
+  bRunning(false),
+  iPollDescriptor(-1),
+  iMaxIdleTime(60000)
+{
+  aWakePipe[0] = aWakePipe[1] = -1;
+}
+
+PiiNetworkReactor::PiiNetworkReactor(Listener* listener) :
+  d(new Data(listener))
+{
+}
+
+PiiNetworkReactor::~PiiNetworkReactor()
+{
+  stop();
+  delete d;
+}
+
+bool PiiNetworkReactor::start()
+{
+#ifdef Q_OS_WIN
+  return false;
+#else
+  if (d->pThread != 0)
+    return true;
+
+  if (pipe(d->aWakePipe) == -1)
+    return false;
+  for (int i=0; i<2; ++i)
+    {
+      fcntl(d->aWakePipe[i], F_SETFL, fcntl(d->aWakePipe[i], F_GETFL) | O_NONBLOCK);
+      fcntl(d->aWakePipe[i], F_SETFD, FD_CLOEXEC);
+    }
+
+#  if defined(PII_REACTOR_EPOLL)
+  d->iPollDescriptor = epoll_create(64);
+  if (d->iPollDescriptor != -1)
+    {
+      fcntl(d->iPollDescriptor, F_SETFD, FD_CLOEXEC);
+      epoll_event event;
+      event.events = EPOLLIN;
+      event.data.fd = d->aWakePipe[0];
+      epoll_ctl(d->iPollDescriptor, EPOLL_CTL_ADD, d->aWakePipe[0], &event);
+    }
+#  elif defined(PII_REACTOR_KQUEUE)
+  d->iPollDescriptor = kqueue();
+  if (d->iPollDescriptor != -1)
+    {
+      struct kevent event;
+      EV_SET(&event, d->aWakePipe[0], EVFILT_READ, EV_ADD, 0, 0, 0);
+      kevent(d->iPollDescriptor, &event, 1, 0, 0, 0);
+    }
+#  else
+  // poll() needs no kernel object.
+  d->iPollDescriptor = 0;
+#  endif
+
+  if (d->iPollDescriptor == -1)
+    {
+      ::close(d->aWakePipe[0]);
+      ::close(d->aWakePipe[1]);
+      d->aWakePipe[0] = d->aWakePipe[1] = -1;
+      return false;
+    }
+
+  d->bRunning = true;
+  d->pThread = Pii::createAsyncCall(this, &PiiNetworkReactor::run);
+  d->pThread->start();
+  return true;
+#endif
+}
+
+QList<int> PiiNetworkReactor::stop()
+{
+  QList<int> lstDescriptors;
+  if (d->pThread == 0)
+    return lstDescriptors;
+
+  d->bRunning = false;
+  wakeUp();
+  d->pThread->wait();
+  delete d->pThread;
+  d->pThread = 0;
+
+#ifndef Q_OS_WIN
+  synchronized (d->mutex)
+    {
+      lstDescriptors = d->hashDescriptors.keys();
+      for (int i=0; i<lstDescriptors.size(); ++i)
+        disarm(lstDescriptors[i]);
+      d->hashDescriptors.clear();
+    }
+
+#  ifndef PII_REACTOR_POLL
+  ::close(d->iPollDescriptor);
+#  endif
+  d->iPollDescriptor = -1;
+  ::close(d->aWakePipe[0]);
+  ::close(d->aWakePipe[1]);
+  d->aWakePipe[0] = d->aWakePipe[1] = -1;
+#endif
+  return lstDescriptors;
+}
+
+bool PiiNetworkReactor::isRunning() const { return d->bRunning; }
+
+bool PiiNetworkReactor::watch(int descriptor)
+{
+  QMutexLocker lock(&d->mutex);
+  if (!d->bRunning)
+    return false;
+  const bool bAdd = !d->hashDescriptors.contains(descriptor);
+  d->hashDescriptors[descriptor] = QDateTime::currentMSecsSinceEpoch();
+  if (!arm(descriptor, bAdd))
+    {
+      d->hashDescriptors.remove(descriptor);
+      return false;
+    }
+  return true;
+}
+
+void PiiNetworkReactor::unwatch(int descriptor)
+{
+  QMutexLocker lock(&d->mutex);
+  d->hashDescriptors.remove(descriptor);
+  // Reported descriptors are still registered in the kernel.
+  disarm(descriptor);
+}
+
+int PiiNetworkReactor::count() const
+{
+  QMutexLocker lock(&d->mutex);
+  return d->hashDescriptors.size();
+}
+
+void PiiNetworkReactor::wakeUp()
+{
+#ifndef Q_OS_WIN
+  if (d->aWakePipe[1] != -1)
+    {
+      char c = 0;
+      // If the pipe is full, the reactor is going to wake up anyway.
+      if (::write(d->aWakePipe[1], &c, 1) == -1) {}
+    }
+#endif
+}
+
+// Called with the mutex held.
+bool PiiNetworkReactor::arm(int descriptor, bool add)
+{
+#if defined(PII_REACTOR_EPOLL)
+  epoll_event event;
+  event.events = EPOLLIN | EPOLLRDHUP | EPOLLONESHOT;
+  event.data.fd = descriptor;
+  // One-shot descriptors stay registered after being reported.
+  if (epoll_ctl(d->iPollDescriptor, EPOLL_CTL_MOD, descriptor, &event) == 0)
+    return true;
+  return epoll_ctl(d->iPollDescriptor, EPOLL_CTL_ADD, descriptor, &event) == 0;
+#elif defined(PII_REACTOR_KQUEUE)
+  Q_UNUSED(add);
+  struct kevent event;
+  EV_SET(&event, descriptor, EVFILT_READ, EV_ADD | EV_ONESHOT, 0, 0, 0);
+  return kevent(d->iPollDescriptor, &event, 1, 0, 0, 0) != -1;
+#elif defined(PII_REACTOR_POLL)
+  // The poll set is rebuilt on each round.
+  if (add)
+    wakeUp();
+  Q_UNUSED(descriptor);
+  return true;
+#else
+  Q_UNUSED(descriptor);
+  Q_UNUSED(add);
+  return false;
+#endif
+}
+
+// Called with the mutex held.
+void PiiNetworkReactor::disarm(int descriptor)
+{
+#if defined(PII_REACTOR_EPOLL)
+  // A duplicate of the descriptor may still be open, which would keep
+  // it in the interest list even after close().
+  epoll_event event;
+  epoll_ctl(d->iPollDescriptor, EPOLL_CTL_DEL, descriptor, &event);
+#elif defined(PII_REACTOR_KQUEUE)
+  struct kevent event;
+  EV_SET(&event, descriptor, EVFILT_READ, EV_DELETE, 0, 0, 0);
+  kevent(d->iPollDescriptor, &event, 1, 0, 0, 0);
+#else
+  Q_UNUSED(descriptor);
+#endif
+}
+
+void PiiNetworkReactor::expireIdle()
+{
+  if (d->iMaxIdleTime <= 0)
+    return;
+
+  QList<int> lstExpired;
+  synchronized (d->mutex)
+    {
+      const qint64 iLimit = QDateTime::currentMSecsSinceEpoch() - d->iMaxIdleTime;
+      for (QHash<int,qint64>::iterator i = d->hashDescriptors.begin(); i != d->hashDescriptors.end(); )
+        {
+          if (i.value() < iLimit)
+            {
+              lstExpired << i.key();
+              disarm(i.key());
+              i = d->hashDescriptors.erase(i);
+            }
+          else
+            ++i;
+        }
+    }
+  for (int i=0; i<lstExpired.size(); ++i)
+    d->pListener->descriptorExpired(lstExpired[i]);
+}
+
+void PiiNetworkReactor::run()
+{
+#ifndef Q_OS_WIN
+  enum { MaxEvents = 64 };
+  // Wake up at least once a second to expire idle descriptors.
+  const int iTimeout = d->iMaxIdleTime > 0 ? qMin(d->iMaxIdleTime, 1000) : -1;
+  while (d->bRunning)
+    {
+      QList<int> lstReady;
+      bool bWoken = false;
+#  if defined(PII_REACTOR_EPOLL)
+      epoll_event events[MaxEvents];
+      int iCount = epoll_wait(d->iPollDescriptor, events, MaxEvents, iTimeout);
+      for (int i=0; i<iCount; ++i)
+        {
+          if (events[i].data.fd == d->aWakePipe[0])
+            bWoken = true;
+          else
+            lstReady << events[i].data.fd;
+        }
+#  elif defined(PII_REACTOR_KQUEUE)
+      struct kevent events[MaxEvents];
+      struct timespec timeout = { iTimeout / 1000, (iTimeout % 1000) * 1000000 };
+      int iCount = kevent(d->iPollDescriptor, 0, 0, events, MaxEvents, iTimeout >= 0 ? &timeout : 0);
+      for (int i=0; i<iCount; ++i)
+        {
+          if (int(events[i].ident) == d->aWakePipe[0])
+            bWoken = true;
+          else
+            lstReady << int(events[i].ident);
+        }
+#  else
+      QVector<pollfd> vecDescriptors;
+      pollfd wake = { d->aWakePipe[0], POLLIN, 0 };
+      vecDescriptors << wake;
+      synchronized (d->mutex)
+        {
+          for (QHash<int,qint64>::const_iterator i = d->hashDescriptors.constBegin();
+               i != d->hashDescriptors.constEnd(); ++i)
+            {
+              pollfd descriptor = { i.key(), POLLIN, 0 };
+              vecDescriptors << descriptor;
+            }
+        }
+      int iCount = poll(vecDescriptors.data(), nfds_t(vecDescriptors.size()), iTimeout);
+      if (iCount > 0)
+        {
+          bWoken = vecDescriptors[0].revents != 0;
+          for (int i=1; i<vecDescriptors.size(); ++i)
+            if (vecDescriptors[i].revents != 0)
+              lstReady << vecDescriptors[i].fd;
+        }
+#  endif
+      if (iCount == -1 && errno != EINTR)
+        break;
+
+      if (bWoken)
+        {
+          char aBuffer[64];
+          while (::read(d->aWakePipe[0], aBuffer, sizeof(aBuffer)) > 0) ;
+        }
+
+      // Skip descriptors that have been unwatched or expired while
+      // we were waiting.
+      synchronized (d->mutex)
+        {
+          for (int i=lstReady.size(); i--; )
+            if (d->hashDescriptors.remove(lstReady[i]) == 0)
+              lstReady.removeAt(i);
+        }
+
+      for (int i=0; i<lstReady.size(); ++i)
+        d->pListener->descriptorReady(lstReady[i]);
+
+      expireIdle();
+    }
+#endif
+  d->bRunning = false;
+}
+
+void PiiNetworkReactor::setMaxIdleTime(int maxIdleTime) { d->iMaxIdleTime = qMax(maxIdleTime, 0); }
+int PiiNetworkReactor::maxIdleTime() const { return d->iMaxIdleTime; }
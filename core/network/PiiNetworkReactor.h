@@ -0,0 +1,143 @@
+/* This file is part of Into.
+ * Copyright (C) Intopii 2013.
+ * All rights reserved.
+ *
+ * Licensees holding a commercial Into license may use this file in
+ * accordance with the commercial license agreement. Please see
+ * LICENSE.commercial for commercial licensing terms.
+ *
+ * Alternatively, this file may be used under the terms of the GNU
+ * Affero General Public License version 3 as published by the Free
+ * Software Foundation. In addition, Intopii gives you special rights
+ * to use Into as a part of open source software projects. Please
+ * refer to LICENSE.AGPL3 for details.
+ */
+
+
+#ifndef _PIINETWORKREACTOR_H
+#define _PIINETWORKREACTOR_H
+
+#include "PiiNetwork.h"
+#include <QMutex>
+#include <QHash>
+#include <QList>
+
+class QThread;
+
+/**
+ * An I/O multiplexer that watches a set of socket descriptors in a
+ * single thread and reports them when they become readable.
+ * PiiNetworkServer uses reactors to park idle keep-alive connections
+ * so that they don't occupy worker threads.
+ *
+ * The reactor uses epoll on Linux, kqueue on BSD systems and Mac OS X,
+ * and poll() on other Unix systems. Descriptors are watched in
+ * one-shot mode: once a descriptor has been reported, it won't be
+ * reported again until re-armed with [watch()]. Windows is not
+ * supported; [start()] always fails there.
+ */
+class PII_NETWORK_EXPORT PiiNetworkReactor
+{
+public:
+  /**
+   * An interface for receiving notifications from the reactor. The
+   * functions are called in the reactor's thread.
+   */
+  class Listener
+  {
+  public:
+    virtual ~Listener() {}
+
+    /**
+     * Called when *descriptor* has data available, or the peer has
+     * closed the connection. The descriptor is no longer watched.
+     */
+    virtual void descriptorReady(int descriptor) = 0;
+
+    /**
+     * Called when *descriptor* has been idle for longer than
+     * [maxIdleTime()]. The descriptor is no longer watched.
+     */
+    virtual void descriptorExpired(int descriptor) = 0;
+  };
+
+  /**
+   * Creates a new reactor that reports events to *listener*.
+   */
+  PiiNetworkReactor(Listener* listener);
+  /**
+   * Stops the reactor.
+   */
+  ~PiiNetworkReactor();
+
+  /**
+   * Starts the reactor thread. Returns `true` on success and `false`
+   * if the polling mechanism could not be initialized.
+   */
+  bool start();
+
+  /**
+   * Stops the reactor thread and waits until it has finished.
+   * Returns the descriptors that were still being watched. The
+   * caller is responsible for closing them.
+   */
+  QList<int> stop();
+
+  /**
+   * Returns `true` if the reactor thread is running.
+   */
+  bool isRunning() const;
+
+  /**
+   * Starts watching *descriptor* or re-arms it after it has been
+   * reported. Returns `false` if the reactor is not running or the
+   * descriptor cannot be watched.
+   */
+  bool watch(int descriptor);
+
+  /**
+   * Stops watching *descriptor*. This must be done before an
+   * unreported descriptor is closed.
+   */
+  void unwatch(int descriptor);
+
+  /**
+   * Returns the number of descriptors currently being watched.
+   */
+  int count() const;
+
+  /**
+   * Sets the maximum time (in milliseconds) a descriptor may be
+   * watched without becoming readable. Zero disables the limit. The
+   * default is 60000.
+   */
+  void setMaxIdleTime(int maxIdleTime);
+  int maxIdleTime() const;
+
+private:
+  void run();
+  void wakeUp();
+  bool arm(int descriptor, bool add);
+  void disarm(int descriptor);
+  void expireIdle();
+
+  class Data
+  {
+  public:
+    Data(Listener* listener);
+
+    Listener* pListener;
+    QThread* pThread;
+    mutable QMutex mutex;
+    // Descriptor -> the time it was armed (ms since epoch).
+    QHash<int, qint64> hashDescriptors;
+    volatile bool bRunning;
+    int iPollDescriptor;
+    int aWakePipe[2];
+    int iMaxIdleTime;
+  } *d;
+
+  PII_DISABLE_COPY(PiiNetworkReactor);
+};
+
+#endif //_PIINETWORKREACTOR_H
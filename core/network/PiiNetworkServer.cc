@@ -17,12 +17,19 @@
 #include "PiiNetworkServerThread.h"
 #include <QIODevice>
 
+#ifndef Q_OS_WIN
+#  include <unistd.h>
+#endif
+
 PiiNetworkServer::Data::Data(PiiNetworkProtocol* protocol) :
   iMinWorkers(0), iMaxWorkers(10),
   iWorkerMaxIdleTime(20),
   iMaxPendingConnections(0),
   aBusyMessage("Server busy\n"),
   pProtocol(protocol),
+  ioMode(ThreadPerConnection),
+  iReactorThreads(1),
+  iMaxIdleConnectionTime(60000),
   state(Stopped)
 {}
 
@@ -51,6 +58,7 @@ PiiNetworkServer::~PiiNetworkServer()
         lstThreads[i]->stop(PiiNetwork::InterruptClients);
     }
 
+  stopReactors();
   waitAll(lstThreads);
   qDeleteAll(lstThreads);
 
@@ -76,15 +84,72 @@ bool PiiNetworkServer::start()
       d->lstFreeThreads << newWorker;
     }
 
+  if (d->ioMode == EventDriven)
+    startReactors();
+
   if (startListening())
     {
       d->state = Running;
       return true;
     }
 
+  lock.unlock();
+  stopReactors();
   return false;
 }
 
+void PiiNetworkServer::startReactors()
+{
+  for (int i=0; i<d->iReactorThreads; ++i)
+    {
+      PiiNetworkReactor* pReactor = new PiiNetworkReactor(this);
+      pReactor->setMaxIdleTime(d->iMaxIdleConnectionTime);
+      if (!pReactor->start())
+        {
+          delete pReactor;
+          piiWarning(tr("Event-driven I/O is not available. Using one thread per connection."));
+          qDeleteAll(d->lstReactors);
+          d->lstReactors.clear();
+          return;
+        }
+      d->lstReactors << pReactor;
+    }
+}
+
+void PiiNetworkServer::stopReactors()
+{
+  // Must be called without holding threadListLock because reactor
+  // threads may be waiting for it.
+  QList<PiiNetworkReactor*> lstReactors;
+  synchronized (d->threadListLock)
+    {
+      lstReactors = d->lstReactors;
+      d->lstReactors.clear();
+    }
+
+  for (int i=0; i<lstReactors.size(); ++i)
+    {
+      QList<int> lstDescriptors = lstReactors[i]->stop();
+      for (int j=0; j<lstDescriptors.size(); ++j)
+        closeDescriptor(lstDescriptors[j]);
+      delete lstReactors[i];
+    }
+}
+
+PiiNetworkReactor* PiiNetworkServer::reactorFor(int descriptor) const
+{
+  return d->lstReactors[descriptor % d->lstReactors.size()];
+}
+
+void PiiNetworkServer::closeDescriptor(int descriptor)
+{
+#ifndef Q_OS_WIN
+  ::close(descriptor);
+#else
+  Q_UNUSED(descriptor);
+#endif
+}
+
 bool PiiNetworkServer::isRunning() const { return d->state == Running; }
 
 void PiiNetworkServer::waitAll(const QList<PiiNetworkServerThread*>& threads)
@@ -111,6 +176,9 @@ bool PiiNetworkServer::stop(PiiNetwork::StopMode mode)
         lstThreads[i]->stop(mode);
     }
 
+  // Close idle connections.
+  stopReactors();
+
   // Wait until all threads are done. We can't use d->lstAllThreads here
   // because it is modified by threadFinished().
   waitAll(lstThreads);
@@ -153,7 +221,10 @@ void PiiNetworkServer::threadAvailable(PiiNetworkServerThread* worker)
 
   // If there is a pending connection, start serving it immediately.
   if (d->lstPendingConnections.size() > 0)
-    worker->startRequest(d->lstPendingConnections.dequeue());
+    {
+      PendingConnection connection(d->lstPendingConnections.dequeue());
+      worker->startRequest(connection.socketDescriptor, connection.iPollDescriptor);
+    }
   else
     // If there are no pending connections, add the thread to the list
     // of free threads.
@@ -181,12 +252,26 @@ void PiiNetworkServer::incomingConnection(PiiGenericSocketDescriptor socketDescr
 
   if (d->state != Running) return;
 
+  // In the event-driven mode, wait for the first request in a
+  // reactor.
+  if (!d->lstReactors.isEmpty())
+    {
+      int iDescriptor = pollDescriptor(socketDescriptor);
+      if (iDescriptor != -1 && reactorFor(iDescriptor)->watch(iDescriptor))
+        return;
+    }
+
+  dispatch(socketDescriptor, -1);
+}
+
+void PiiNetworkServer::dispatch(PiiGenericSocketDescriptor socketDescriptor, int pollDescriptor)
+{
   // If at least one thread is available, use it.
   if (d->lstFreeThreads.size() > 0)
     {
       //piiDebug("Picked an idle thread");
       PiiNetworkServerThread *worker = d->lstFreeThreads.takeLast();
-      worker->startRequest(socketDescriptor);
+      worker->startRequest(socketDescriptor, pollDescriptor);
     }
   // If no free threads are available, and we are still allowed to
   // create a new one, do it.
@@ -197,7 +282,7 @@ void PiiNetworkServer::incomingConnection(PiiGenericSocketDescriptor socketDescr
       // separately for each client.
       PiiNetworkServerThread *newWorker = createWorker(d->pProtocol);
       newWorker->setController(this);
-      newWorker->startRequest(socketDescriptor);
+      newWorker->startRequest(socketDescriptor, pollDescriptor);
       d->lstAllThreads << newWorker;
     }
   // No more threads, please. Are we allowed to queue pending connections?
@@ -211,15 +296,62 @@ void PiiNetworkServer::incomingConnection(PiiGenericSocketDescriptor socketDescr
          descriptor is allocated to another client. We must thus check
          that the descriptor isn't already in our list.
       */
-      if (!d->lstPendingConnections.contains(socketDescriptor))
-        d->lstPendingConnections.enqueue(socketDescriptor);
+      PendingConnection connection(socketDescriptor, pollDescriptor);
+      if (!d->lstPendingConnections.contains(connection))
+        d->lstPendingConnections.enqueue(connection);
     }
   // No luck this time.
   else
     {
       //piiWarning(tr("Too many concurrent clients."));
       serverBusy(socketDescriptor);
+      if (pollDescriptor != -1)
+        closeDescriptor(pollDescriptor);
+    }
+}
+
+void PiiNetworkServer::descriptorReady(int descriptor)
+{
+  QMutexLocker lock(&d->threadListLock);
+  // The worker gets its own duplicate of the descriptor because the
+  // socket device closes its descriptor when deleted.
+#ifndef Q_OS_WIN
+  int iDuplicate = d->state == Running ? ::dup(descriptor) : -1;
+#else
+  int iDuplicate = -1;
+#endif
+  if (iDuplicate == -1)
+    {
+      closeDescriptor(descriptor);
+      return;
     }
+  dispatch(genericDescriptor(iDuplicate), descriptor);
+}
+
+void PiiNetworkServer::descriptorExpired(int descriptor)
+{
+  closeDescriptor(descriptor);
+}
+
+void PiiNetworkServer::connectionReleased(int pollDescriptor, bool keepAlive)
+{
+  synchronized (d->threadListLock)
+    {
+      if (keepAlive && d->state == Running && !d->lstReactors.isEmpty() &&
+          reactorFor(pollDescriptor)->watch(pollDescriptor))
+        return;
+    }
+  closeDescriptor(pollDescriptor);
+}
+
+int PiiNetworkServer::pollDescriptor(PiiGenericSocketDescriptor) const
+{
+  return -1;
+}
+
+PiiGenericSocketDescriptor PiiNetworkServer::genericDescriptor(int) const
+{
+  return PiiGenericSocketDescriptor();
 }
 
 PiiNetworkServerThread* PiiNetworkServer::createWorker(PiiNetworkProtocol* protocol)
@@ -245,3 +377,9 @@ int PiiNetworkServer::maxPendingConnections() const { return d->iMaxPendingConne
 void PiiNetworkServer::setBusyMessage(const QString& busyMessage) { d->aBusyMessage = busyMessage.toUtf8(); }
 QString PiiNetworkServer::busyMessage() const { return QString::fromUtf8(d->aBusyMessage.constData(), d->aBusyMessage.size()); }
 PiiNetworkProtocol* PiiNetworkServer::protocol() const { return d->pProtocol; }
+void PiiNetworkServer::setIoMode(IoMode ioMode) { d->ioMode = ioMode; }
+PiiNetworkServer::IoMode PiiNetworkServer::ioMode() const { return d->ioMode; }
+void PiiNetworkServer::setReactorThreads(int reactorThreads) { if (reactorThreads > 0 && reactorThreads < 100) d->iReactorThreads = reactorThreads; }
+int PiiNetworkServer::reactorThreads() const { return d->iReactorThreads; }
+void PiiNetworkServer::setMaxIdleConnectionTime(int maxIdleConnectionTime) { d->iMaxIdleConnectionTime = qMax(maxIdleConnectionTime, 0); }
+int PiiNetworkServer::maxIdleConnectionTime() const { return d->iMaxIdleConnectionTime; }
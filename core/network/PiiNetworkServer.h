@@ -22,6 +22,7 @@
 #include <QMutex>
 
 #include "PiiNetworkServerThread.h"
+#include "PiiNetworkReactor.h"
 
 /**
  * An implementation of a threaded network server. This class provides
@@ -37,13 +38,39 @@
  * event loop there. It is not possible to move servers from a thread
  * to another due to limitations of the Qt threading system.
  *
+ * Event-driven mode
+ * -----------------
+ *
+ * By default, a connection occupies a worker thread from the moment
+ * it is accepted until it is closed. With keep-alive connections,
+ * most of this time is spent waiting for the client, and a few
+ * hundred idle clients exhaust the thread pool. If [ioMode] is set
+ * to `EventDriven`, idle connections are parked in [reactorThreads]
+ * reactor threads that watch all of them with epoll, kqueue or
+ * poll(). Once a request arrives, the connection is handed to a
+ * worker thread that serves the request with
+ * PiiNetworkProtocol::communicateOnce() and then hands the
+ * connection back to a reactor. The number of worker threads is thus
+ * determined by the number of concurrent requests, not connections.
+ *
+ * ~~~(c++)
+ * PiiHttpServer* pServer = PiiHttpServer::addServer("dashboard", "tcp://0.0.0.0:8080");
+ * pServer->networkServer()->setIoMode(PiiNetworkServer::EventDriven);
+ * pServer->networkServer()->setMaxWorkers(8);
+ * ~~~
+ *
+ * Connections that cannot be polled are served one thread per
+ * connection also in the event-driven mode. This applies to
+ * encrypted connections and to all connections on Windows.
+ *
  * @see PiiTcpServer
  * @see PiiLocalServer
  *
  */
 class PII_NETWORK_EXPORT PiiNetworkServer :
   public QObject,
-  private PiiNetworkServerThread::Controller
+  private PiiNetworkServerThread::Controller,
+  private PiiNetworkReactor::Listener
 {
   Q_OBJECT
 
@@ -96,7 +123,41 @@ class PII_NETWORK_EXPORT PiiNetworkServer :
    */
   Q_PROPERTY(QString busyMessage READ busyMessage WRITE setBusyMessage);
 
+  /**
+   * The way connections are assigned to threads. The default value is
+   * `ThreadPerConnection`. Changes take effect when the server is
+   * started the next time.
+   */
+  Q_PROPERTY(IoMode ioMode READ ioMode WRITE setIoMode);
+  Q_ENUMS(IoMode);
+
+  /**
+   * The number of reactor threads that watch idle connections in the
+   * `EventDriven` mode. One thread easily handles thousands of
+   * connections. The default value is 1.
+   */
+  Q_PROPERTY(int reactorThreads READ reactorThreads WRITE setReactorThreads);
+
+  /**
+   * The time (in milliseconds) an idle connection is kept open in the
+   * `EventDriven` mode. If the client sends no new request in this
+   * time, the connection will be closed. Zero means no limit. The
+   * default value is 60000.
+   */
+  Q_PROPERTY(int maxIdleConnectionTime READ maxIdleConnectionTime WRITE setMaxIdleConnectionTime);
+
 public:
+  /**
+   * Connection handling modes.
+   *
+   * - `ThreadPerConnection` - each connection is bound to a worker
+   * thread until it is closed.
+   *
+   * - `EventDriven` - idle connections are watched by reactor
+   * threads, and worker threads are used only for serving requests.
+   */
+  enum IoMode { ThreadPerConnection, EventDriven };
+
   /**
    * Interrupts all open connections and destroys the server.
    */
@@ -141,6 +202,12 @@ public:
   int maxPendingConnections() const;
   void setBusyMessage(const QString& busyMessage);
   QString busyMessage() const;
+  void setIoMode(IoMode ioMode);
+  IoMode ioMode() const;
+  void setReactorThreads(int reactorThreads);
+  int reactorThreads() const;
+  void setMaxIdleConnectionTime(int maxIdleConnectionTime);
+  int maxIdleConnectionTime() const;
 
   /**
    * Get the communication protocol.
@@ -163,6 +230,21 @@ protected:
   /// @internal
   enum State { Stopped, Stopping, Running };
   /// @internal
+  struct PendingConnection
+  {
+    PendingConnection(PiiGenericSocketDescriptor descriptor = PiiGenericSocketDescriptor(),
+                      int pollDescriptor = -1) :
+      socketDescriptor(descriptor), iPollDescriptor(pollDescriptor)
+    {}
+    bool operator== (const PendingConnection& other) const
+    {
+      return socketDescriptor == other.socketDescriptor;
+    }
+
+    PiiGenericSocketDescriptor socketDescriptor;
+    int iPollDescriptor;
+  };
+  /// @internal
   class Data
   {
   public:
@@ -177,9 +259,14 @@ protected:
 
     QMutex threadListLock;
     QList<PiiNetworkServerThread*> lstFreeThreads, lstAllThreads, lstFinishedThreads;
-    QQueue<PiiGenericSocketDescriptor> lstPendingConnections;
+    QQueue<PendingConnection> lstPendingConnections;
     PiiNetworkProtocol* pProtocol;
 
+    IoMode ioMode;
+    int iReactorThreads;
+    int iMaxIdleConnectionTime;
+    QList<PiiNetworkReactor*> lstReactors;
+
     State state;
     QString strServerAddress;
   } *d;
@@ -266,10 +353,37 @@ protected:
    */
   virtual PiiNetworkServerThread* createWorker(PiiNetworkProtocol* protocol);
 
+  /**
+   * Returns a native descriptor that can be watched with the
+   * operating system's polling mechanism in the `EventDriven` mode,
+   * or -1 if *socketDescriptor* cannot be polled. Connections that
+   * cannot be polled are served one thread per connection. The
+   * default implementation returns -1.
+   */
+  virtual int pollDescriptor(PiiGenericSocketDescriptor socketDescriptor) const;
+
+  /**
+   * Converts a native descriptor returned by [pollDescriptor()] (or a
+   * duplicate of it) back to a generic socket descriptor that can be
+   * passed to `createSocket`(). The default implementation returns
+   * an invalid descriptor.
+   */
+  virtual PiiGenericSocketDescriptor genericDescriptor(int pollDescriptor) const;
+
 private:
   friend class PiiNetworkServerThread;
   void threadAvailable(PiiNetworkServerThread* thread);
   void threadFinished(PiiNetworkServerThread* tread);
+  void connectionReleased(int pollDescriptor, bool keepAlive);
+
+  void descriptorReady(int descriptor);
+  void descriptorExpired(int descriptor);
+
+  void dispatch(PiiGenericSocketDescriptor socketDescriptor, int pollDescriptor);
+  PiiNetworkReactor* reactorFor(int descriptor) const;
+  void startReactors();
+  void stopReactors();
+  void closeDescriptor(int descriptor);
 
   void deleteFinishedThreads();
   void waitAll(const QList<PiiNetworkServerThread*>& threads);
@@ -21,6 +21,7 @@ PiiNetworkServerThread::Data::Data(PiiNetworkProtocol* protocol) :
   pProtocol(protocol->clone()),
   bOwnProtocol(protocol != pProtocol),
   pController(0),
+  iPollDescriptor(-1),
   requestCondition(PiiWaitCondition::Queue),
   bRunning(false), bInterrupted(false),
   iMaxIdleTime(10000)
@@ -39,9 +40,10 @@ PiiNetworkServerThread::~PiiNetworkServerThread()
     delete d->pProtocol;
 }
 
-void PiiNetworkServerThread::startRequest(PiiGenericSocketDescriptor socketDescriptor)
+void PiiNetworkServerThread::startRequest(PiiGenericSocketDescriptor socketDescriptor, int pollDescriptor)
 {
   d->socketDescriptor = socketDescriptor;
+  d->iPollDescriptor = pollDescriptor;
 
   // If the thread is not running, start it.
   if (!d->bRunning)
@@ -80,12 +82,26 @@ void PiiNetworkServerThread::run()
       if (!d->bRunning)
         break;
 
+      const int iPollDescriptor = d->iPollDescriptor;
+      bool bKeepAlive = false;
       QIODevice* pSocket = d->pController->createSocket(d->socketDescriptor);
       if (pSocket != 0)
         {
-          d->pProtocol->communicate(pSocket, this);
+          if (iPollDescriptor != -1)
+            {
+              // Requests that have already been read into the
+              // device's buffer would be lost if the device was
+              // deleted now.
+              do
+                bKeepAlive = d->pProtocol->communicateOnce(pSocket, this);
+              while (bKeepAlive && pSocket->bytesAvailable() > 0 && !d->bInterrupted);
+            }
+          else
+            d->pProtocol->communicate(pSocket, this);
           delete pSocket;
         }
+      if (iPollDescriptor != -1)
+        d->pController->connectionReleased(iPollDescriptor, bKeepAlive && !d->bInterrupted);
 
       // We are done with the client. Tell mama.
       d->pController->threadAvailable(this);
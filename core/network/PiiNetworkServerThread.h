@@ -68,6 +68,25 @@ public:
      * will be closed and deleted.
      */
     virtual QIODevice* createSocket(PiiGenericSocketDescriptor socketDescriptor) = 0;
+
+    /**
+     * Called by the thread when it is done with a request on a
+     * multiplexed connection. See [startRequest()].
+     *
+     * @param pollDescriptor the descriptor passed to
+     * [startRequest()].
+     *
+     * @param keepAlive `true` if the protocol wants to keep the
+     * connection open for more requests, `false` if the connection
+     * should be closed.
+     *
+     * The default implementation does nothing.
+     */
+    virtual void connectionReleased(int pollDescriptor, bool keepAlive)
+    {
+      Q_UNUSED(pollDescriptor);
+      Q_UNUSED(keepAlive);
+    }
   };
 
 
@@ -104,8 +123,14 @@ public:
    *
    * @param socketDescriptor the socket descriptor of a connected
    * socket.
+   *
+   * @param pollDescriptor if not -1, the connection is multiplexed.
+   * The thread serves only a single request with
+   * [PiiNetworkProtocol::communicateOnce()] (and any requests already
+   * buffered in the device) and then calls
+   * [Controller::connectionReleased()] with this value.
    */
-  void startRequest(PiiGenericSocketDescriptor socketDescriptor);
+  void startRequest(PiiGenericSocketDescriptor socketDescriptor, int pollDescriptor = -1);
 
   /**
    * Sends a stop signal to the thread. The thread will later exit
@@ -146,6 +171,7 @@ private:
     bool bOwnProtocol;
     Controller* pController;
     PiiGenericSocketDescriptor socketDescriptor;
+    int iPollDescriptor;
     PiiWaitCondition requestCondition;
     volatile bool bRunning, bInterrupted;
     int iMaxIdleTime;
@@ -18,6 +18,7 @@
 #include "PiiHttpDevice.h"
 #include "PiiHttpException.h"
 #include "PiiStreamBuffer.h"
+#include "PiiWebSocket.h"
 
 #include <PiiUtil.h>
 #include <PiiMetaTypeUtil.h>
@@ -133,7 +134,7 @@ void PiiObjectServer::handleChannelCommand(const QString& uri, PiiHttpDevice* de
   // No slash -> the request was to /channels/id -> reconnect to channel
   if (iSlashIndex == -1)
     {
-      channelById(uri)->push(dev, controller, lock); // may throw
+      pushToChannel(channelById(uri), dev, controller, lock); // may throw
       return;
     }
 
@@ -302,9 +303,7 @@ void PiiObjectServer::handleRequest(const QString& uri, PiiHttpDevice* dev,
             {
               PII_REQUIRE_HTTP_METHOD("GET");
               QString strChannelId = createNewChannel(dev->requestHeader().value("X-Client-ID"));
-              dev->print(strChannelId);
-              dev->putChar('\n');
-              channelById(strChannelId)->push(dev, controller, &lock); // may throw
+              pushToChannel(channelById(strChannelId), dev, controller, &lock, strChannelId); // may throw
             }
           else
             // strFunction must be of the form channel-id/action
@@ -318,6 +317,25 @@ void PiiObjectServer::handleRequest(const QString& uri, PiiHttpDevice* dev,
     PII_THROW_HTTP_ERROR(NotFoundStatus);
 }
 
+// channelMutex must be held when calling this function
+void PiiObjectServer::pushToChannel(ChannelImpl* channel, PiiHttpDevice* dev,
+                                    PiiHttpProtocol::TimeLimiter* controller,
+                                    QMutexLocker* lock, const QString& newChannelId)
+{
+  if (PiiWebSocket::isUpgradeRequest(dev->requestHeader()))
+    channel->pushToWebSocket(this, dev, controller, lock, newChannelId);
+  else
+    {
+      // The ID of a new channel is sent as the preamble.
+      if (!newChannelId.isEmpty())
+        {
+          dev->print(newChannelId);
+          dev->putChar('\n');
+        }
+      channel->push(dev, controller, lock);
+    }
+}
+
 // channelMutex must be held when calling this function
 PiiObjectServer::ChannelImpl* PiiObjectServer::channelById(const QString& channelId)
 {
@@ -603,16 +621,7 @@ void PiiObjectServer::ChannelImpl::push(PiiHttpDevice* dev,
      to the new thread.
   */
 
-  if (_bPushing)
-    {
-      quit();
-      wait();
-      piiWarning("Reconnecting to an active channel. Old connection will break.");
-    }
-  _bPushing = true;
-  _idleTimer.stop();
-
-  lock->unlock();
+  startPushing(lock);
 
   controller->setMaxTime(-1);
   dev->setHeader("Content-Type", QString("multipart/mixed-replace; boundary=\"%1\"").arg(pBoundary+2));
@@ -662,16 +671,158 @@ void PiiObjectServer::ChannelImpl::push(PiiHttpDevice* dev,
       _queueCondition.wait(&_queueMutex, 50);
     }
 
+  stopPushing();
+
+  dev->setHeader("Connection", "close");
+}
+
+// *lock* must be held when calling this function
+void PiiObjectServer::ChannelImpl::startPushing(QMutexLocker* lock)
+{
+  if (_bPushing)
+    {
+      quit();
+      wait();
+      piiWarning("Reconnecting to an active channel. Old connection will break.");
+    }
+  _bPushing = true;
+  _idleTimer.stop();
+
+  lock->unlock();
+}
+
+// _queueMutex must be held when calling this function. Releases it.
+void PiiObjectServer::ChannelImpl::stopPushing()
+{
   _bKilled = false;
   _bPushing = false;
   _idleTimer.restart();
 
   _pushEndCondition.wakeAll();
   _queueMutex.unlock();
+}
+
+// *lock* must be held when calling this function
+void PiiObjectServer::ChannelImpl::pushToWebSocket(PiiObjectServer* server,
+                                                   PiiHttpDevice* dev,
+                                                   PiiHttpProtocol::TimeLimiter* controller,
+                                                   QMutexLocker* lock,
+                                                   const QString& channelId)
+{
+  startPushing(lock);
+
+  if (!PiiWebSocket::acceptUpgrade(dev))
+    {
+      dev->setHeader("Connection", "close");
+      _queueMutex.lock();
+      stopPushing();
+      return;
+    }
+  // Nothing has been buffered; frames go directly to the socket.
+  dev->endOutputFiltering();
+
+  controller->setMaxTime(-1);
+  PiiWebSocket socket(dev->device());
+  socket.setController(controller);
+  if (!channelId.isEmpty())
+    socket.writeMessage(channelId.toUtf8(), PiiWebSocket::TextFrame);
+
+  _queueMutex.lock();
+
+  while (!_bKilled && socket.isOpen() && controller->canContinue())
+    {
+      if (!_dataQueue.isEmpty())
+        {
+          // Send everything that has been queued meanwhile as one
+          // message, up to a reasonable size.
+          QList<QPair<QString,QByteArray> > lstBatch;
+          QByteArray aMessage;
+          while (!_dataQueue.isEmpty() && aMessage.size() < 65536)
+            {
+              lstBatch << _dataQueue.dequeue();
+              const QPair<QString,QByteArray>& pair = lstBatch.last();
+              aMessage.append(QString("X-ID: %1\r\nContent-Length: %2\r\n\r\n")
+                              .arg(pair.first).arg(pair.second.size()).toUtf8());
+              aMessage.append(pair.second);
+            }
+          _queueMutex.unlock();
+          bool bSuccess = socket.writeMessage(aMessage);
+          _queueMutex.lock();
+          if (!bSuccess)
+            {
+              // Keep the data for a reconnecting client.
+              piiWarning("Failed to push data to a WebSocket channel.");
+              for (int i=lstBatch.size(); i--; )
+                _dataQueue.prepend(lstBatch[i]);
+              break;
+            }
+        }
+      else if (socket.hasPendingData())
+        {
+          _queueMutex.unlock();
+          handleWebSocketCommand(server, socket);
+          _queueMutex.lock();
+        }
+      else
+        _queueCondition.wait(&_queueMutex, 50);
+    }
+
+  if (socket.isOpen())
+    socket.close(_bKilled || !controller->canContinue() ? 1001 : 1000);
 
+  stopPushing();
+
+  // The connection cannot be used for HTTP any more.
   dev->setHeader("Connection", "close");
 }
 
+void PiiObjectServer::ChannelImpl::handleWebSocketCommand(PiiObjectServer* server, PiiWebSocket& socket)
+{
+  QByteArray aMessage;
+  PiiWebSocket::Opcode opcode;
+  if (!socket.readMessage(&aMessage, &opcode) || opcode != PiiWebSocket::TextFrame)
+    return;
+
+  QString strMessage(QString::fromUtf8(aMessage));
+  int iSpaceIndex = strMessage.indexOf(' ');
+  QString strCommand = strMessage.left(iSpaceIndex);
+  QString strSourceId = iSpaceIndex == -1 ? QString() : strMessage.mid(iSpaceIndex+1);
+  int iStatus = PiiHttpProtocol::OkStatus;
+
+  try
+    {
+      QMutexLocker lock(&server->d->channelMutex);
+      if (strCommand == "connect")
+        {
+          // Disallow multiple registrations to a channel.
+          if (!lstSources.contains(strSourceId))
+            {
+              server->connectToChannel(this, strSourceId);
+              lstSources << strSourceId;
+            }
+        }
+      else if (strCommand == "disconnect")
+        {
+          lstSources.removeOne(strSourceId);
+          removeObjectsQueuedTo(strSourceId);
+          server->disconnectFromChannel(this, strSourceId);
+        }
+      else
+        iStatus = PiiHttpProtocol::BadRequestStatus;
+    }
+  catch (PiiHttpException& ex)
+    {
+      iStatus = ex.statusCode();
+    }
+  catch (PiiException& ex)
+    {
+      iStatus = PiiHttpProtocol::InternalServerErrorStatus;
+      piiWarning(ex.message());
+    }
+
+  socket.writeMessage(QString("%1 %2").arg(iStatus).arg(strMessage).toUtf8(), PiiWebSocket::TextFrame);
+}
+
 void PiiObjectServer::CallbackFunction::call(void** args)
 {
   QByteArray aData = PiiNetwork::toByteArray(Pii::argsToList(d->lstParamTypes, args), PiiNetwork::BinaryFormat);
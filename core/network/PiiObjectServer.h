@@ -30,6 +30,8 @@
 #include <QHash>
 #include <QMap>
 
+class PiiWebSocket;
+
 /**
  * A URI handler for PiiHttpProtocol that maps HTTP requests to member
  * function calls on any object instance.
@@ -219,6 +221,33 @@
  * A channel can be explicitly destroyed by requesting
  * /channels/channel-id/delete.
  *
+ * WebSocket channels
+ * ------------------
+ *
+ * If the request to /channels/new or /channels/channel-id asks for a
+ * WebSocket upgrade (see PiiWebSocket), the channel is pushed
+ * through a full-duplex WebSocket connection instead of a multipart
+ * response. Upon a new channel, the server first sends the channel ID
+ * as a text message. Pushed data is sent in binary messages that
+ * contain one or more parts in the same format as above:
+ *
+ * ~~~
+ * X-ID: callbacks/callback(QString)
+ * Content-Length: 17
+ *
+ * Callback invoked.
+ * ~~~
+ *
+ * Everything that was queued while the previous message was being
+ * written is sent in one message, which turns bursts of small
+ * call-backs into few large writes. The client can connect and
+ * disconnect sources through the same connection by sending text
+ * messages such as "connect callbacks/callback(QString)" or
+ * "disconnect callbacks/callback(QString)". The server replies to
+ * each with a text message that starts with a HTTP status code
+ * followed by the command, e.g. "200 connect
+ * callbacks/callback(QString)".
+ *
  * Ping
  * ----
  *
@@ -507,6 +536,9 @@ protected:
     ChannelImpl(const QString& clientId);
 
     void push(PiiHttpDevice* dev, PiiHttpProtocol::TimeLimiter* controller, QMutexLocker* lock);
+    void pushToWebSocket(PiiObjectServer* server, PiiHttpDevice* dev,
+                         PiiHttpProtocol::TimeLimiter* controller, QMutexLocker* lock,
+                         const QString& channelId);
     void removeObjectsQueuedTo(const QString& uri);
     bool isAlive(int timeout) const;
     void quit();
@@ -515,6 +547,10 @@ protected:
     QStringList lstSources;
 
   private:
+    void startPushing(QMutexLocker* lock);
+    void stopPushing();
+    void handleWebSocketCommand(PiiObjectServer* server, PiiWebSocket& socket);
+
     bool _bPushing, _bKilled;
     PiiTimer _idleTimer;
   };
@@ -666,6 +702,9 @@ private:
   void init();
   void createExceptionResponse(PiiHttpDevice* dev, const PiiException& ex);
   QString createNewChannel(const QString& clientId);
+  void pushToChannel(ChannelImpl* channel, PiiHttpDevice* dev,
+                     PiiHttpProtocol::TimeLimiter* controller,
+                     QMutexLocker* lock, const QString& newChannelId = QString());
   inline ChannelImpl* channelById(const QString& id);
   void killChannels();
   void disconnectChannel(Channel* channel);
@@ -114,6 +114,23 @@ QString PiiTcpServer::serverAddress() const
 }
 
 
+int PiiTcpServer::pollDescriptor(PiiGenericSocketDescriptor socketDescriptor) const
+{
+#ifndef Q_OS_WIN
+  if (_d()->encryption == NoEncryption)
+    return int(socketDescriptor.networkSocketDescriptor);
+#else
+  Q_UNUSED(socketDescriptor);
+#endif
+  return -1;
+}
+
+PiiGenericSocketDescriptor PiiTcpServer::genericDescriptor(int pollDescriptor) const
+{
+  return PiiGenericSocketDescriptor(PiiNetwork::SocketDescriptorType(pollDescriptor));
+}
+
+
 PiiTcpServer::EntryPoint::EntryPoint(PiiTcpServer* owner) : _pOwner(owner) {}
 void PiiTcpServer::EntryPoint::incomingConnection(PiiNetwork::SocketDescriptorType sockedFd) { _pOwner->incomingConnection(sockedFd); }
 
@@ -134,6 +134,14 @@ protected:
 
   void stopListening();
 
+  /**
+   * Returns the native descriptor of an unencrypted connection. SSL
+   * sessions cannot be resumed on a new socket object, and encrypted
+   * connections are thus always served one thread per connection.
+   */
+  int pollDescriptor(PiiGenericSocketDescriptor socketDescriptor) const;
+  PiiGenericSocketDescriptor genericDescriptor(int pollDescriptor) const;
+
 private:
   class EntryPoint : public QTcpServer
   {
@@ -0,0 +1,275 @@
+/* This file is part of Into.
+ * Copyright (C) Intopii 2013.
+ * All rights reserved.
+ *
+ * Licensees holding a commercial Into license may use this file in
+ * accordance with the commercial license agreement. Please see
+ * LICENSE.commercial for commercial licensing terms.
+ *
+ * Alternatively, this file may be used under the terms of the GNU
+ * Affero General Public License version 3 as published by the Free
+ * Software Foundation. In addition, Intopii gives you special rights
+ * to use Into as a part of open source software projects. Please
+ * refer to LICENSE.AGPL3 for details.
+ */
+
+
+#include "PiiWebSocket.h"
+#include "PiiHttpDevice.h"
+#include "PiiHttpProtocol.h"
+
+#include <QCryptographicHash>
+
+class PiiWebSocket::Data
+{
+public:
+  Data(const PiiSocketDevice& device, Mode mode) :
+    pSocket(device),
+    mode(mode),
+    bOpen(true),
+    bCloseSent(false),
+    iMaxMessageSize(16 << 20),
+    iDataTimeout(5000),
+    pController(0)
+  {}
+
+  PiiSocketDevice pSocket;
+  Mode mode;
+  bool bOpen, bCloseSent;
+  qint64 iMaxMessageSize;
+  int iDataTimeout;
+  PiiProgressController* pController;
+};
+
+PiiWebSocket::PiiWebSocket(const PiiSocketDevice& device, Mode mode) :
+  d(new Data(device, mode))
+{
+}
+
+PiiWebSocket::~PiiWebSocket()
+{
+  delete d;
+}
+
+bool PiiWebSocket::isUpgradeRequest(const PiiHttpRequestHeader& header)
+{
+  return header.method() == "GET" &&
+    header.value("Upgrade").toLower().contains("websocket") &&
+    header.value("Connection").toLower().contains("upgrade");
+}
+
+QByteArray PiiWebSocket::acceptKey(const QByteArray& key)
+{
+  return QCryptographicHash::hash(key + "258EAFA5-E914-47DA-95CA-C5AB0DC85B11",
+                                  QCryptographicHash::Sha1).toBase64();
+}
+
+bool PiiWebSocket::acceptUpgrade(PiiHttpDevice* dev)
+{
+  const PiiHttpRequestHeader& header = dev->requestHeader();
+  QByteArray aKey(header.value("Sec-WebSocket-Key").trimmed().toLatin1());
+  if (!isUpgradeRequest(header) || aKey.isEmpty())
+    {
+      dev->setStatus(PiiHttpProtocol::BadRequestStatus);
+      return false;
+    }
+  if (header.value("Sec-WebSocket-Version").trimmed() != "13")
+    {
+      dev->setStatus(PiiHttpProtocol::UpgradeRequiredStatus);
+      dev->setHeader("Sec-WebSocket-Version", "13");
+      return false;
+    }
+
+  dev->setStatus(PiiHttpProtocol::SwitchingProtocolsStatus);
+  dev->setHeader("Upgrade", "websocket");
+  dev->setHeader("Connection", "Upgrade");
+  dev->setHeader("Sec-WebSocket-Accept", acceptKey(aKey));
+  return dev->sendHeader();
+}
+
+bool PiiWebSocket::writeMessage(const QByteArray& message, Opcode opcode)
+{
+  return d->bOpen && writeFrame(opcode, message.constData(), message.size());
+}
+
+bool PiiWebSocket::writeFrame(int opcode, const char* data, qint64 size)
+{
+  uchar aHeader[14];
+  int iHeaderSize = 2;
+  aHeader[0] = uchar(0x80 | opcode); // final fragment
+  if (size < 126)
+    aHeader[1] = uchar(size);
+  else if (size <= 0xffff)
+    {
+      aHeader[1] = 126;
+      aHeader[2] = uchar(size >> 8);
+      aHeader[3] = uchar(size);
+      iHeaderSize = 4;
+    }
+  else
+    {
+      aHeader[1] = 127;
+      for (int i=0; i<8; ++i)
+        aHeader[2+i] = uchar(quint64(size) >> (56 - 8*i));
+      iHeaderSize = 10;
+    }
+
+  QByteArray aMasked;
+  if (d->mode == Client)
+    {
+      aHeader[1] |= 0x80;
+      uchar* pMask = aHeader + iHeaderSize;
+      for (int i=0; i<4; ++i)
+        pMask[i] = uchar(qrand());
+      iHeaderSize += 4;
+      aMasked = QByteArray(data, int(size));
+      for (int i=0; i<aMasked.size(); ++i)
+        aMasked.data()[i] ^= pMask[i & 3];
+      data = aMasked.constData();
+    }
+
+  // Servers send the payload straight from the caller's buffer.
+  if (d->pSocket.writeWaited(reinterpret_cast<const char*>(aHeader), iHeaderSize,
+                             d->iDataTimeout, d->pController) != iHeaderSize)
+    return fail(0);
+  while (size > 0)
+    {
+      qint64 iWritten = d->pSocket.writeWaited(data, size, d->iDataTimeout, d->pController);
+      if (iWritten <= 0)
+        return fail(0);
+      data += iWritten;
+      size -= iWritten;
+    }
+  return true;
+}
+
+bool PiiWebSocket::readBytes(void* data, qint64 size)
+{
+  char* pData = static_cast<char*>(data);
+  while (size > 0)
+    {
+      qint64 iRead = d->pSocket.readWaited(pData, size, d->iDataTimeout, d->pController);
+      if (iRead <= 0)
+        return false;
+      pData += iRead;
+      size -= iRead;
+    }
+  return true;
+}
+
+bool PiiWebSocket::readMessage(QByteArray* message, Opcode* opcode)
+{
+  message->clear();
+  int iMessageOpcode = ContinuationFrame;
+
+  while (d->bOpen)
+    {
+      uchar aHeader[2];
+      if (!readBytes(aHeader, 2))
+        return fail(0);
+
+      const bool bFinal = (aHeader[0] & 0x80) != 0;
+      const int iOpcode = aHeader[0] & 0x0f;
+      const bool bMasked = (aHeader[1] & 0x80) != 0;
+      // No extensions have been negotiated. Clients must mask their
+      // frames, servers must not.
+      if ((aHeader[0] & 0x70) != 0 || bMasked != (d->mode == Server))
+        return fail(1002);
+
+      quint64 iLength = aHeader[1] & 0x7f;
+      if (iLength >= 126)
+        {
+          uchar aLength[8];
+          const int iBytes = iLength == 126 ? 2 : 8;
+          if (!readBytes(aLength, iBytes))
+            return fail(0);
+          iLength = 0;
+          for (int i=0; i<iBytes; ++i)
+            iLength = (iLength << 8) | aLength[i];
+        }
+      uchar aMask[4] = { 0, 0, 0, 0 };
+      if (bMasked && !readBytes(aMask, 4))
+        return fail(0);
+
+      const bool bControl = (iOpcode & 0x8) != 0;
+      if (bControl)
+        {
+          if (!bFinal || iLength > 125)
+            return fail(1002);
+        }
+      else if ((iOpcode == ContinuationFrame) != (iMessageOpcode != ContinuationFrame))
+        return fail(1002);
+      else if (quint64(message->size()) + iLength > quint64(d->iMaxMessageSize))
+        return fail(1009);
+
+      // Control frames may arrive between the fragments of a message.
+      QByteArray aControl;
+      QByteArray* pTarget = bControl ? &aControl : message;
+      const int iOffset = pTarget->size();
+      pTarget->resize(iOffset + int(iLength));
+      char* pPayload = pTarget->data() + iOffset;
+      if (!readBytes(pPayload, qint64(iLength)))
+        return fail(0);
+      if (bMasked)
+        for (int i=0; i<int(iLength); ++i)
+          pPayload[i] ^= aMask[i & 3];
+
+      if (bControl)
+        {
+          if (iOpcode == PingFrame)
+            writeFrame(PongFrame, aControl.constData(), aControl.size());
+          else if (iOpcode == CloseFrame)
+            {
+              // Echo the status code back.
+              if (!d->bCloseSent)
+                writeFrame(CloseFrame, aControl.constData(), qMin(aControl.size(), 2));
+              d->bCloseSent = true;
+              d->bOpen = false;
+            }
+          else if (iOpcode != PongFrame)
+            return fail(1002);
+          continue;
+        }
+
+      if (iOpcode != ContinuationFrame)
+        iMessageOpcode = iOpcode;
+      if (bFinal)
+        {
+          if (iMessageOpcode != TextFrame && iMessageOpcode != BinaryFrame)
+            return fail(1003);
+          if (opcode != 0)
+            *opcode = Opcode(iMessageOpcode);
+          return true;
+        }
+    }
+  return false;
+}
+
+bool PiiWebSocket::fail(int code)
+{
+  // A code of zero means the connection is already broken.
+  if (code != 0)
+    close(code);
+  d->bOpen = false;
+  return false;
+}
+
+void PiiWebSocket::close(int code)
+{
+  if (!d->bCloseSent)
+    {
+      const char aCode[2] = { char(code >> 8), char(code) };
+      d->bCloseSent = true;
+      writeFrame(CloseFrame, aCode, 2);
+    }
+  d->bOpen = false;
+}
+
+bool PiiWebSocket::hasPendingData() const { return d->pSocket->bytesAvailable() > 0; }
+bool PiiWebSocket::isOpen() const { return d->bOpen; }
+void PiiWebSocket::setMaxMessageSize(qint64 maxMessageSize) { d->iMaxMessageSize = maxMessageSize; }
+qint64 PiiWebSocket::maxMessageSize() const { return d->iMaxMessageSize; }
+void PiiWebSocket::setDataTimeout(int dataTimeout) { d->iDataTimeout = dataTimeout; }
+int PiiWebSocket::dataTimeout() const { return d->iDataTimeout; }
+void PiiWebSocket::setController(PiiProgressController* controller) { d->pController = controller; }
+PiiProgressController* PiiWebSocket::controller() const { return d->pController; }
@@ -0,0 +1,168 @@
+/* This file is part of Into.
+ * Copyright (C) Intopii 2013.
+ * All rights reserved.
+ *
+ * Licensees holding a commercial Into license may use this file in
+ * accordance with the commercial license agreement. Please see
+ * LICENSE.commercial for commercial licensing terms.
+ *
+ * Alternatively, this file may be used under the terms of the GNU
+ * Affero General Public License version 3 as published by the Free
+ * Software Foundation. In addition, Intopii gives you special rights
+ * to use Into as a part of open source software projects. Please
+ * refer to LICENSE.AGPL3 for details.
+ */
+
+
+#ifndef _PIIWEBSOCKET_H
+#define _PIIWEBSOCKET_H
+
+#include <QByteArray>
+#include "PiiSocketDevice.h"
+
+class PiiHttpDevice;
+class PiiHttpRequestHeader;
+class PiiProgressController;
+
+/**
+ * The framing layer of the WebSocket protocol (RFC 6455).
+ * PiiWebSocket reads and writes messages through a socket whose
+ * connection has already been upgraded from HTTP. The upgrade
+ * handshake itself is performed by [acceptUpgrade()] on the server
+ * side.
+ *
+ * ~~~(c++)
+ * void MyHandler::handleRequest(const QString& uri,
+ *                               PiiHttpDevice* h,
+ *                               PiiHttpProtocol::TimeLimiter* controller)
+ * {
+ *   if (!PiiWebSocket::acceptUpgrade(h))
+ *     return;
+ *   // The connection cannot be used for HTTP any more.
+ *   h->setHeader("Connection", "close");
+ *   controller->setMaxTime(-1);
+ *   PiiWebSocket socket(h->device());
+ *   socket.setController(controller);
+ *   QByteArray aMessage;
+ *   while (socket.readMessage(&aMessage))
+ *     socket.writeMessage(aMessage); // echo
+ * }
+ * ~~~
+ *
+ * Ping frames are answered automatically. Fragmented messages are
+ * reassembled by [readMessage()]; [writeMessage()] always sends a
+ * message as a single frame.
+ */
+class PII_NETWORK_EXPORT PiiWebSocket
+{
+public:
+  /**
+   * Roles of the end points. Clients mask the frames they send,
+   * servers must not.
+   */
+  enum Mode { Server, Client };
+
+  /**
+   * Frame types.
+   */
+  enum Opcode
+  {
+    ContinuationFrame = 0x0,
+    TextFrame = 0x1,
+    BinaryFrame = 0x2,
+    CloseFrame = 0x8,
+    PingFrame = 0x9,
+    PongFrame = 0xa
+  };
+
+  /**
+   * Creates a WebSocket that communicates through *device*.
+   */
+  PiiWebSocket(const PiiSocketDevice& device, Mode mode = Server);
+  /**
+   * Destroys the object without closing the connection.
+   */
+  ~PiiWebSocket();
+
+  /**
+   * Returns `true` if *header* requests an upgrade to the WebSocket
+   * protocol.
+   */
+  static bool isUpgradeRequest(const PiiHttpRequestHeader& header);
+
+  /**
+   * Returns the value of the Sec-WebSocket-Accept header that
+   * matches the Sec-WebSocket-Key *key* sent by a client.
+   */
+  static QByteArray acceptKey(const QByteArray& key);
+
+  /**
+   * Sends a `101 Switching Protocols` response to the upgrade request
+   * received by *dev*. Returns `true` on success. If the request is
+   * not a valid WebSocket handshake, sets an error status to *dev*
+   * and returns `false`. Nothing but WebSocket frames may be sent
+   * through the connection once this function has succeeded.
+   */
+  static bool acceptUpgrade(PiiHttpDevice* dev);
+
+  /**
+   * Sends *message* as a single frame. Returns `true` if the whole
+   * frame was written.
+   */
+  bool writeMessage(const QByteArray& message, Opcode opcode = BinaryFrame);
+
+  /**
+   * Reads the next complete text or binary message into *message*
+   * and stores its type to *opcode*, if given. Control frames
+   * received in between are handled automatically. Returns `false`
+   * if the connection was closed, the peer violated the protocol, or
+   * data did not arrive within [dataTimeout()].
+   */
+  bool readMessage(QByteArray* message, Opcode* opcode = 0);
+
+  /**
+   * Returns `true` if there are received bytes waiting to be read.
+   */
+  bool hasPendingData() const;
+
+  /**
+   * Sends a close frame with the given status *code* unless one has
+   * already been sent. No messages can be written after this.
+   */
+  void close(int code = 1000);
+
+  /**
+   * Returns `true` until a close frame has been sent or received, or
+   * an I/O error has occurred.
+   */
+  bool isOpen() const;
+
+  /**
+   * Sets the maximum size of a received message. Larger messages
+   * close the connection. The default is 16 MiB.
+   */
+  void setMaxMessageSize(qint64 maxMessageSize);
+  qint64 maxMessageSize() const;
+
+  /**
+   * Sets the number of milliseconds to wait for the rest of a frame
+   * once its first byte has arrived. The default is 5000.
+   */
+  void setDataTimeout(int dataTimeout);
+  int dataTimeout() const;
+
+  void setController(PiiProgressController* controller);
+  PiiProgressController* controller() const;
+
+private:
+  bool writeFrame(int opcode, const char* data, qint64 size);
+  bool readBytes(void* data, qint64 size);
+  bool fail(int code);
+
+  class Data;
+  Data* d;
+
+  PII_DISABLE_COPY(PiiWebSocket);
+};
+
+#endif //_PIIWEBSOCKET_H
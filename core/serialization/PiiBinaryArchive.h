@@ -18,6 +18,25 @@
 
 #define PII_BINARY_ARCHIVE_ID "Into Bin"
 #define PII_BINARY_ARCHIVE_ID_LEN 8
-#define PII_BINARY_ARCHIVE_VERSION 0
+// Version 1 archives align large payloads. Unaligned archives are
+// still written as version 0.
+#define PII_BINARY_ARCHIVE_VERSION 1
+
+/// @hide
+namespace PiiSerialization
+{
+  // Reverses the byte order of *count* elements in place.
+  inline void swapBytes(char* data, unsigned int count, unsigned int elementSize)
+  {
+    for (unsigned int i=0; i<count; ++i, data += elementSize)
+      for (unsigned int b=0; b<elementSize/2; ++b)
+        {
+          char cTmp = data[b];
+          data[b] = data[elementSize-1-b];
+          data[elementSize-1-b] = cTmp;
+        }
+  }
+}
+/// @endhide
 
 #endif //_PIIBINARYARCHIVE_H
@@ -15,10 +15,33 @@
 
 #include "PiiBinaryInputArchive.h"
 
+#include <PiiAtomicInt.h>
+#include <QFile>
+
 PII_DEFINE_SERIALIZER(PiiBinaryInputArchive);
 PII_DEFINE_FACTORY_MAP(PiiBinaryInputArchive);
 
-PiiBinaryInputArchive::PiiBinaryInputArchive(QIODevice* d) : QDataStream(d)
+struct PiiBinaryInputArchive::Mapping
+{
+  Mapping(const QString& fileName) : file(fileName), pData(0), iSize(0), iRefCount(1) {}
+  ~Mapping()
+  {
+    if (pData != 0)
+      file.unmap(pData);
+  }
+
+  QFile file;
+  uchar* pData;
+  qint64 iSize;
+  PiiAtomicInt iRefCount;
+};
+
+PiiBinaryInputArchive::PiiBinaryInputArchive(QIODevice* d, bool mapPayloads) :
+  QDataStream(d),
+  _iPayloadAlignment(0),
+  _iStartPos(d->isSequential() ? 0 : d->pos()),
+  _bMapPayloads(mapPayloads),
+  _pMapping(0)
 {
   if (!d->isOpen())
     PII_SERIALIZATION_ERROR(StreamNotOpen);
@@ -40,6 +63,84 @@ PiiBinaryInputArchive::PiiBinaryInputArchive(QIODevice* d) : QDataStream(d)
   if (iVersion > PII_BINARY_ARCHIVE_VERSION)
     PII_SERIALIZATION_ERROR(ArchiveVersionMismatch);
   setMinorVersion(iVersion);
+
+  if (iVersion >= 1)
+    {
+      *this >> _iPayloadAlignment;
+      // Must be a power of two.
+      if (_iPayloadAlignment <= 0 || _iPayloadAlignment > 4096 ||
+          (_iPayloadAlignment & (_iPayloadAlignment - 1)) != 0)
+        PII_SERIALIZATION_ERROR(InvalidDataFormat);
+    }
+}
+
+PiiBinaryInputArchive::~PiiBinaryInputArchive()
+{
+  if (_pMapping != 0)
+    releaseMapping(_pMapping);
+}
+
+PiiBinaryInputArchive::Mapping* PiiBinaryInputArchive::mapping()
+{
+  if (_pMapping == 0)
+    {
+      // Mapping is tried only once.
+      _bMapPayloads = false;
+      QFile* pFile = qobject_cast<QFile*>(device());
+      if (pFile == 0 || pFile->fileName().isEmpty())
+        return 0;
+      // The mapping has its own file handle because it may outlive
+      // the device.
+      Mapping* pMapping = new Mapping(pFile->fileName());
+      if (pMapping->file.open(QIODevice::ReadOnly))
+        {
+          pMapping->iSize = pMapping->file.size();
+          pMapping->pData = pMapping->file.map(0, pMapping->iSize);
+        }
+      if (pMapping->pData == 0)
+        {
+          delete pMapping;
+          return 0;
+        }
+      _pMapping = pMapping;
+      _bMapPayloads = true;
+    }
+  return _pMapping;
+}
+
+void PiiBinaryInputArchive::releaseMapping(void* context)
+{
+  Mapping* pMapping = static_cast<Mapping*>(context);
+  if (pMapping->iRefCount.deref() == 0)
+    delete pMapping;
+}
+
+const void* PiiBinaryInputArchive::startPayload(quint64 size, void (**release)(void*), void** context)
+{
+  if (_iPayloadAlignment == 0 || size < quint64(_iPayloadAlignment))
+    return 0;
+
+  QIODevice* pDevice = device();
+  const qint64 iPosition = pDevice->pos();
+  const qint64 iPadding = (_iPayloadAlignment - (iPosition - _iStartPos) % _iPayloadAlignment) % _iPayloadAlignment;
+  const qint64 iOffset = iPosition + iPadding;
+
+  // The mapping starts at a page boundary. If the archive itself
+  // does not start at an aligned offset, neither do the payloads.
+  Mapping* pMapping = _bMapPayloads && iOffset % _iPayloadAlignment == 0 ? mapping() : 0;
+  if (pMapping != 0 &&
+      quint64(iOffset) + size <= quint64(pMapping->iSize) &&
+      pDevice->seek(iOffset + qint64(size)))
+    {
+      pMapping->iRefCount.ref();
+      *release = releaseMapping;
+      *context = pMapping;
+      return pMapping->pData + iOffset;
+    }
+
+  char padding[4096];
+  readRawData(padding, unsigned(iPadding));
+  return 0;
 }
 
 void PiiBinaryInputArchive::readRawData(void* ptr, unsigned int size)
@@ -48,6 +149,24 @@ void PiiBinaryInputArchive::readRawData(void* ptr, unsigned int size)
     PII_SERIALIZATION_ERROR(StreamError);
 }
 
+void PiiBinaryInputArchive::readPrimitiveArray(void* ptr, unsigned int count, unsigned int elementSize)
+{
+  char* pData = static_cast<char*>(ptr);
+  const QDataStream::ByteOrder hostOrder = QSysInfo::ByteOrder == QSysInfo::BigEndian ?
+    QDataStream::BigEndian : QDataStream::LittleEndian;
+  const bool bSwap = elementSize > 1 && byteOrder() != hostOrder;
+  const unsigned int iMaxCount = (1u << 26) / elementSize;
+  while (count > 0)
+    {
+      unsigned int iCount = qMin(count, iMaxCount);
+      readRawData(pData, iCount * elementSize);
+      if (bSwap)
+        PiiSerialization::swapBytes(pData, iCount, elementSize);
+      pData += iCount * elementSize;
+      count -= iCount;
+    }
+}
+
 PiiBinaryInputArchive& PiiBinaryInputArchive::operator>> (QString& value)
 {
   // Read the raw bytes
@@ -27,6 +27,24 @@
  * PiiBinaryInputArchive reads raw binary data. The binary format is
  * platform-dependent.
  *
+ * If the archive was written with aligned payloads (see
+ * PiiBinaryOutputArchive) and payload mapping is enabled, matrices
+ * are not read into memory. Instead, the archive maps the whole file
+ * and returns matrices that refer to the mapped memory. The
+ * operating system loads pages on first access, so the time it takes
+ * to read the archive does not depend on the size of the matrices.
+ * The matrices are immutable: modifying one makes a private copy of
+ * it. The mapping is released once the archive and all matrices
+ * referring to it have been destroyed.
+ *
+ * ~~~(c++)
+ * QFile file("model.bin");
+ * file.open(QIODevice::ReadOnly);
+ * PiiBinaryInputArchive ia(&file, true);
+ * ia >> matModels;
+ * ~~~
+ *
+ * The file must not be modified as long as the mapping exists.
  */
 class PII_SERIALIZATION_EXPORT PiiBinaryInputArchive :
   public PiiInputArchive<PiiBinaryInputArchive>,
@@ -38,13 +56,39 @@ public:
    * Construct a new binary input archive that reads the given I/O
    * device. The device must be open.
    *
+   * @param d the input device
+   *
+   * @param mapPayloads map aligned payloads directly from the file
+   * if *d* is a QFile.
+   *
    * @exception PiiSerializationException& if the device is not open,
    * or it cannot be read from, or the archive format is unknown
    */
-  PiiBinaryInputArchive(QIODevice* d);
+  PiiBinaryInputArchive(QIODevice* d, bool mapPayloads = false);
+  ~PiiBinaryInputArchive();
+
+  /**
+   * Returns the payload alignment stored in the archive, or zero if
+   * payloads are not aligned.
+   */
+  int payloadAlignment() const { return _iPayloadAlignment; }
+
+  const void* startPayload(quint64 size, void (**release)(void*), void** context);
+
+  enum { BulkTransfer = true };
 
   void readRawData(void* ptr, unsigned int size);
 
+  /**
+   * Reads *count* primitive values into the memory pointed to by
+   * *ptr*. The counterpart of
+   * PiiBinaryOutputArchive::writePrimitiveArray().
+   */
+  template <class T> void readPrimitiveArray(T* ptr, unsigned int count)
+  {
+    readPrimitiveArray(ptr, count, sizeof(T));
+  }
+
   PiiBinaryInputArchive& operator>> (QString& value);
 
   PiiBinaryInputArchive& operator>> (char*& value);
@@ -59,6 +103,18 @@ public:
 protected:
   void startDelim() {}
   void endDelim() {}
+
+private:
+  struct Mapping;
+
+  void readPrimitiveArray(void* ptr, unsigned int count, unsigned int elementSize);
+  Mapping* mapping();
+  static void releaseMapping(void* context);
+
+  int _iPayloadAlignment;
+  qint64 _iStartPos;
+  bool _bMapPayloads;
+  Mapping* _pMapping;
 };
 
 PII_DECLARE_SERIALIZER(PiiBinaryInputArchive);
@@ -18,18 +18,46 @@
 PII_DEFINE_SERIALIZER(PiiBinaryOutputArchive);
 PII_DEFINE_FACTORY_MAP(PiiBinaryOutputArchive);
 
-PiiBinaryOutputArchive::PiiBinaryOutputArchive(QIODevice* d) : QDataStream(d)
+PiiBinaryOutputArchive::PiiBinaryOutputArchive(QIODevice* d, int payloadAlignment) :
+  QDataStream(d),
+  _iPayloadAlignment(0),
+  _iStartPos(0)
 {
   if (!d->isOpen())
     PII_SERIALIZATION_ERROR(StreamNotOpen);
 
+  // Positions are needed for alignment.
+  if (payloadAlignment > 0 && !d->isSequential())
+    {
+      _iPayloadAlignment = 1;
+      while (_iPayloadAlignment < payloadAlignment && _iPayloadAlignment < 4096)
+        _iPayloadAlignment <<= 1;
+      _iStartPos = d->pos();
+    }
+
   // Store archive ID
   if (d->write(PII_BINARY_ARCHIVE_ID, PII_BINARY_ARCHIVE_ID_LEN) != PII_BINARY_ARCHIVE_ID_LEN)
     PII_SERIALIZATION_ERROR(StreamError);
 
   // Store archive version
   *this << PII_ARCHIVE_VERSION;
-  *this << PII_BINARY_ARCHIVE_VERSION;
+  if (_iPayloadAlignment > 0)
+    {
+      *this << PII_BINARY_ARCHIVE_VERSION;
+      *this << _iPayloadAlignment;
+    }
+  else
+    *this << 0;
+}
+
+void PiiBinaryOutputArchive::startPayload(quint64 size)
+{
+  if (_iPayloadAlignment == 0 || size < quint64(_iPayloadAlignment))
+    return;
+
+  static const char padding[4096] = { 0 };
+  qint64 iPosition = device()->pos() - _iStartPos;
+  writeRawData(padding, unsigned((_iPayloadAlignment - iPosition % _iPayloadAlignment) % _iPayloadAlignment));
 }
 
 void PiiBinaryOutputArchive::writeRawData(const void* ptr, unsigned int size)
@@ -39,6 +67,40 @@ void PiiBinaryOutputArchive::writeRawData(const void* ptr, unsigned int size)
     PII_SERIALIZATION_ERROR(StreamError);
 }
 
+void PiiBinaryOutputArchive::writePrimitiveArray(const void* ptr, unsigned int count, unsigned int elementSize)
+{
+  const char* pData = static_cast<const char*>(ptr);
+  const QDataStream::ByteOrder hostOrder = QSysInfo::ByteOrder == QSysInfo::BigEndian ?
+    QDataStream::BigEndian : QDataStream::LittleEndian;
+  if (elementSize == 1 || byteOrder() == hostOrder)
+    {
+      // Write in large blocks to avoid overflowing writeRawData().
+      const unsigned int iMaxCount = (1u << 26) / elementSize;
+      while (count > 0)
+        {
+          unsigned int iCount = qMin(count, iMaxCount);
+          writeRawData(pData, iCount * elementSize);
+          pData += iCount * elementSize;
+          count -= iCount;
+        }
+    }
+  else
+    {
+      // Swap the bytes in a local buffer.
+      char buffer[8192];
+      const unsigned int iMaxCount = sizeof(buffer) / elementSize;
+      while (count > 0)
+        {
+          unsigned int iCount = qMin(count, iMaxCount);
+          std::memcpy(buffer, pData, iCount * elementSize);
+          PiiSerialization::swapBytes(buffer, iCount, elementSize);
+          writeRawData(buffer, iCount * elementSize);
+          pData += iCount * elementSize;
+          count -= iCount;
+        }
+    }
+}
+
 PiiBinaryOutputArchive& PiiBinaryOutputArchive::operator<< (const QString& value)
 {
   QByteArray utf8Data = value.toUtf8();
@@ -27,6 +27,17 @@
  * Binary output archive stores data in a raw binary format. The
  * binary format is platform-dependent.
  *
+ * If the archive is created with a non-zero payload alignment, large
+ * raw data blocks such as matrix contents are aligned within the
+ * archive. This makes it possible for PiiBinaryInputArchive to map
+ * matrices directly from a file instead of reading them into memory.
+ *
+ * ~~~(c++)
+ * QFile file("model.bin");
+ * file.open(QIODevice::WriteOnly);
+ * PiiBinaryOutputArchive oa(&file, 4096);
+ * oa << matModels;
+ * ~~~
  */
 class PII_SERIALIZATION_EXPORT PiiBinaryOutputArchive :
   public PiiOutputArchive<PiiBinaryOutputArchive>,
@@ -38,13 +49,43 @@ public:
    * Construct a new binary output archive that writes data to the
    * given I/O device. The device must be open.
    *
+   * @param d the output device
+   *
+   * @param payloadAlignment align raw data blocks that are at least
+   * this many bytes long to a multiple of this many bytes from the
+   * beginning of the archive. The value is rounded up to a power of
+   * two, at most 4096. Zero disables alignment. Alignment is ignored
+   * if *d* is a sequential device.
+   *
    * @exception PiiSerializationException& if the stream is not open
    * or cannot be written to.
    */
-  PiiBinaryOutputArchive(QIODevice* d);
+  PiiBinaryOutputArchive(QIODevice* d, int payloadAlignment = 0);
+
+  /**
+   * Returns the payload alignment in bytes, or zero if payloads are
+   * not aligned.
+   */
+  int payloadAlignment() const { return _iPayloadAlignment; }
+
+  void startPayload(quint64 size);
+
+  enum { BulkTransfer = true };
 
   void writeRawData(const void* ptr, unsigned int size);
 
+  /**
+   * Writes *count* primitive values starting at *ptr*. The result is
+   * the same as writing each value separately with operator<<, but
+   * the byte order is checked only once, and the data is written in
+   * large blocks. *T* must be a
+   * PiiSerializationTraits::IsRawPrimitive type.
+   */
+  template <class T> void writePrimitiveArray(const T* ptr, unsigned int count)
+  {
+    writePrimitiveArray(ptr, count, sizeof(T));
+  }
+
   PiiBinaryOutputArchive& operator<< (const QString& value);
   PiiBinaryOutputArchive& operator<< (const char* value);
 
@@ -56,6 +97,12 @@ public:
 protected:
   void startDelim() {}
   void endDelim() {}
+
+private:
+  void writePrimitiveArray(const void* ptr, unsigned int count, unsigned int elementSize);
+
+  int _iPayloadAlignment;
+  qint64 _iStartPos;
 };
 
 PII_DECLARE_SERIALIZER(PiiBinaryOutputArchive);
@@ -120,17 +120,8 @@ template <class T, class Archive> T* PiiSerializationFactory::create(const char*
 {
   if (PiiSerialization::isDynamicType((T*)0))
     {
-      // Try archive-specific factory first
-      PiiSerializationFactory* pFactory = factory<Archive>(className);
-      if (pFactory == 0)
-        {
-          // If this is already the default factory, fail
-          if (Pii::IsSame<Archive, PiiSerialization::Void>::boolValue ||
-              // Otherwise try the default factory
-              (pFactory = factory<PiiSerialization::Void>(className)) == 0)
-            return 0;
-        }
-      return reinterpret_cast<T*>(pFactory->create(&archive));
+      PiiSerializationFactory* pFactory = resolve<Archive>(className);
+      return pFactory != 0 ? reinterpret_cast<T*>(pFactory->create(&archive)) : 0;
     }
   return create<T>(archive);
 }
@@ -54,6 +54,7 @@ public:
   virtual PiiGenericInputArchive& operator>>(char*& value) = 0;
   virtual PiiGenericInputArchive& operator>>(QString& value) = 0;
   virtual void readRawData(void* ptr, unsigned int size) = 0;
+  virtual const void* startPayload(quint64 size, void (**release)(void*), void** context) = 0;
 
   PII_DEFAULT_INPUT_OPERATORS(PiiGenericInputArchive)
 private:
@@ -77,6 +78,7 @@ template <class Archive> class PiiGenericInputArchive::Impl :
 {
 public:
   Impl(QIODevice* d) : Archive(d) {}
+  template <class Arg> Impl(QIODevice* d, Arg arg) : Archive(d, arg) {}
 
   int majorVersion() const { return Archive::majorVersion(); }
   int minorVersion() const { return Archive::minorVersion(); }
@@ -100,6 +102,10 @@ public:
   PII_STREAM_OP(QString&)
 #undef PII_STREAM_OP
   virtual void readRawData(void* ptr, unsigned int size) { Archive::readRawData(ptr, size); }
+  virtual const void* startPayload(quint64 size, void (**release)(void*), void** context)
+  {
+    return Archive::startPayload(size, release, context);
+  }
 
   PII_DEFAULT_INPUT_OPERATORS(PiiGenericInputArchive)
 
@@ -55,6 +55,7 @@ public:
   virtual PiiGenericOutputArchive& operator<<(const char* value) = 0;
   virtual PiiGenericOutputArchive& operator<<(const QString& value) = 0;
   virtual void writeRawData(const void* ptr, unsigned int size) = 0;
+  virtual void startPayload(quint64 size) = 0;
 
   PII_DEFAULT_OUTPUT_OPERATORS(PiiGenericOutputArchive)
 
@@ -79,6 +80,7 @@ template <class Archive> class PiiGenericOutputArchive::Impl :
 {
 public:
   Impl(QIODevice* d) : Archive(d) {}
+  template <class Arg> Impl(QIODevice* d, Arg arg) : Archive(d, arg) {}
 
   int majorVersion() const { return Archive::majorVersion(); }
   int minorVersion() const { return Archive::minorVersion(); }
@@ -102,6 +104,7 @@ public:
   PII_STREAM_OP(const QString&)
 #undef PII_STREAM_OP
   virtual void writeRawData(const void* ptr, unsigned int size) { Archive::writeRawData(ptr, size); }
+  virtual void startPayload(quint64 size) { Archive::startPayload(size); }
 
   PII_DEFAULT_OUTPUT_OPERATORS(PiiGenericOutputArchive)
 
@@ -17,6 +17,8 @@
 #define _PIIINPUTARCHIVE_H
 
 #include <QList>
+#include <QVector>
+#include <QByteArray>
 #include <cstring>
 #include <PiiMetaTemplate.h>
 #include "PiiTypeTraits.h"
@@ -31,6 +33,7 @@
 /// @internal
 struct PiiArchivePointerInfo
 {
+  PiiArchivePointerInfo() : ptr(0), objectStored(false) {}
   PiiArchivePointerInfo(void*p, const QList<void**>& a, bool b) :
     ptr(p), addresses(a), objectStored(b) {}
   void* ptr;
@@ -38,6 +41,8 @@ struct PiiArchivePointerInfo
   bool objectStored;
 };
 
+Q_DECLARE_TYPEINFO(PiiArchivePointerInfo, Q_MOVABLE_TYPE);
+
 namespace PiiSerialization
 {
   /**
@@ -99,12 +104,31 @@ public:
    */
   enum { InputArchive = true, OutputArchive = false };
 
+  /**
+   * Tells whether the archive is a plain byte stream. In such an
+   * archive, consecutive raw data blocks can be merged into one, and
+   * arrays of PiiSerializationTraits::IsRawPrimitive types can be
+   * transferred in bulk with `readPrimitiveArray()`. Archives that
+   * support this redefine the constant as `true`.
+   */
+  enum { BulkTransfer = false };
+
+  PiiInputArchive() : _pLastFactory(0) {}
+
   /**
    * A design pattern for casting the type of this archive to that of
    * the template parameter.
    */
   Archive* self() { return static_cast<Archive*>(this); }
 
+  /**
+   * Prepares the archive for restoring at least *count* distinct
+   * tracked pointers or objects.
+   *
+   * @see PiiOutputArchive::reservePointers()
+   */
+  void reservePointers(int count) { _lstPointers.reserve(count); }
+
   /**
    * This operator is defined for both input and output archives,
    * which makes it possible to serialize and deserialize data with a
@@ -133,6 +157,22 @@ public:
       ptr = 0;
   }
 
+  /**
+   * Informs the archive that a raw data block of *size* bytes will
+   * be read next. Archives that align large blocks skip the padding
+   * here. If the archive can provide the block without copying, it
+   * returns a pointer to the data, skips the block and stores a
+   * function that must be called with *context* once the data is no
+   * longer needed to *release*. Otherwise, the function returns 0
+   * and the block must be read with `readRawData()`. The default
+   * implementation always returns 0.
+   */
+  const void* startPayload(quint64 size, void (**release)(void*), void** context)
+  {
+    Q_UNUSED(size); Q_UNUSED(release); Q_UNUSED(context);
+    return 0;
+  }
+
   /**
    * Analogous to PiiOutputArchive::operator<<(T&). This function
    * calls Archive::load(value).
@@ -300,7 +340,7 @@ private:
   template <class T> void loadComplexPointer(const char* name, T*& value, bool tracked = false)
   {
     // Create an instance of the named class
-    value = PiiSerializationFactory::create<T>(name, *self());
+    value = createInstance<T>(name);
     PiiSmartPtr<T> valuePtr(value); // Exception safety
     if (value == 0)
       PII_SERIALIZATION_ERROR_INFO(UnregisteredClass, name);
@@ -330,6 +370,25 @@ private:
     valuePtr.release();
   }
 
+  /* Creates an instance of the named class. The factory of the
+   * previously created dynamic type is cached, because archives
+   * usually contain long runs of objects of the same class. This
+   * saves the two factory map look-ups PiiSerializationFactory would
+   * do for each object.
+   */
+  template <class T> T* createInstance(const char* name)
+  {
+    if (!PiiSerialization::isDynamicType((T*)0))
+      return PiiSerializationFactory::create<T>(*self());
+
+    if (_pLastFactory == 0 || std::strcmp(name, _aLastClassName.constData()) != 0)
+      {
+        _pLastFactory = PiiSerializationFactory::resolve<Archive>(name);
+        _aLastClassName = name;
+      }
+    return _pLastFactory != 0 ? reinterpret_cast<T*>(_pLastFactory->create(self())) : 0;
+  }
+
   template <class T> void loadTrackedPointer(T*& value)
   {
     // Check if we can handle this pointer by reference only
@@ -382,7 +441,9 @@ private:
    * with the addresses of the pointers that point to these memory
    * locations. (Clear, no?)
    */
-  QList<PiiArchivePointerInfo> _lstPointers;
+  QVector<PiiArchivePointerInfo> _lstPointers;
+  QByteArray _aLastClassName;
+  PiiSerializationFactory* _pLastFactory;
 };
 
 
@@ -16,14 +16,13 @@
 #ifndef _PIIOUTPUTARCHIVE_H
 #define _PIIOUTPUTARCHIVE_H
 
-#include <QHash>
 #include <PiiMetaTemplate.h>
 #include <PiiTypeTraits.h>
 #include "PiiSerializationTraits.h"
 #include "PiiSerializationException.h"
 #include "PiiMetaObject.h"
 #include "PiiSerializer.h"
-#include "PiiTrackedPointerHolder.h"
+#include "PiiPointerMap.h"
 #include "PiiDynamicTypeFunctions.h"
 
 /**
@@ -54,10 +53,14 @@ public:
    */
   enum { InputArchive = false, OutputArchive = true };
 
-  ~PiiOutputArchive()
-  {
-    qDeleteAll(_pointerMap);
-  }
+  /**
+   * Tells whether the archive is a plain byte stream. In such an
+   * archive, consecutive raw data blocks can be merged into one, and
+   * arrays of PiiSerializationTraits::IsRawPrimitive types can be
+   * transferred in bulk with `writePrimitiveArray()`. Archives that
+   * support this redefine the constant as `true`.
+   */
+  enum { BulkTransfer = false };
 
   /**
    * A design pattern for casting the type of this archive to that of
@@ -68,6 +71,15 @@ public:
    */
   Archive* self() { return static_cast<Archive*>(this); }
 
+  /**
+   * Prepares the archive for saving at least *count* distinct
+   * tracked pointers or objects. Tracked addresses are stored in a
+   * hash table that otherwise grows as needed. If the size of the
+   * object graph is known in advance, reserving space avoids
+   * rehashing.
+   */
+  void reservePointers(int count) { _pointerMap.reserve(count); }
+
   /**
    * Writes an array of *size* elements to the archive.
    */
@@ -78,6 +90,14 @@ public:
       self()->writeRawData(ptr, sizeof(T)*size);
   }
 
+  /**
+   * Informs the archive that a raw data block of *size* bytes, such
+   * as the contents of a matrix, will be written next. Archives that
+   * align large blocks write padding here. The default
+   * implementation does nothing.
+   */
+  void startPayload(quint64 size) { Q_UNUSED(size); }
+
   /**
    * This operator is defined for both input and output archives,
    * which makes it possible to serialize and deserialize data with a
@@ -137,7 +157,7 @@ private:
         return true;
       }
 
-    PiiTrackedPointerHolder* pHolder = _pointerMap.value(value,0);
+    PiiTrackedPointerHolder* pHolder = _pointerMap.value(value);
     // Already stored this one ...
     if (pHolder != 0)
       {
@@ -164,7 +184,7 @@ private:
   template <class T> bool trackObject(const T* value)
   {
     // Already stored this one ...
-    PiiTrackedPointerHolder* pHolder = _pointerMap.value(value,0);
+    PiiTrackedPointerHolder* pHolder = _pointerMap.value(value);
     if (pHolder != 0)
       {
         // Store the index of the already saved object.
@@ -278,7 +298,7 @@ private:
       }
   }
 
-  QHash<const void*,PiiTrackedPointerHolder*> _pointerMap;
+  PiiPointerMap _pointerMap;
 };
 
 template <class Archive> struct PiiOutputArchive<Archive>::TrackedPointerSaver
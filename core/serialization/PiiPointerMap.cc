@@ -0,0 +1,81 @@
+/* This file is part of Into.
+ * Copyright (C) Intopii 2013.
+ * All rights reserved.
+ *
+ * Licensees holding a commercial Into license may use this file in
+ * accordance with the commercial license agreement. Please see
+ * LICENSE.commercial for commercial licensing terms.
+ *
+ * Alternatively, this file may be used under the terms of the GNU
+ * Affero General Public License version 3 as published by the Free
+ * Software Foundation. In addition, Intopii gives you special rights
+ * to use Into as a part of open source software projects. Please
+ * refer to LICENSE.AGPL3 for details.
+ */
+
+
+#include "PiiPointerMap.h"
+
+#include <cstring>
+
+PiiPointerMap::PiiPointerMap() :
+  _pEntries(0),
+  _iCapacity(0),
+  _iSize(0)
+{}
+
+PiiPointerMap::~PiiPointerMap()
+{
+  clear();
+}
+
+void PiiPointerMap::insert(const void* pointer, PiiTrackedPointerHolder* holder)
+{
+  // Keep the load factor below 1/2 to make probe sequences short.
+  if (unsigned(_iSize + 1) * 2 > _iCapacity)
+    rehash(_iCapacity == 0 ? 64 : _iCapacity * 2);
+
+  unsigned i = hash(pointer) & (_iCapacity - 1);
+  while (_pEntries[i].key != 0)
+    i = (i + 1) & (_iCapacity - 1);
+  _pEntries[i].key = pointer;
+  _pEntries[i].holder = holder;
+  ++_iSize;
+}
+
+void PiiPointerMap::reserve(int count)
+{
+  unsigned iCapacity = 64;
+  while (iCapacity < unsigned(count) * 2)
+    iCapacity *= 2;
+  if (iCapacity > _iCapacity)
+    rehash(iCapacity);
+}
+
+void PiiPointerMap::clear()
+{
+  for (unsigned i=0; i<_iCapacity; ++i)
+    delete _pEntries[i].holder;
+  delete[] _pEntries;
+  _pEntries = 0;
+  _iCapacity = 0;
+  _iSize = 0;
+}
+
+void PiiPointerMap::rehash(unsigned capacity)
+{
+  Entry* pNewEntries = new Entry[capacity];
+  std::memset(pNewEntries, 0, sizeof(Entry) * capacity);
+  for (unsigned i=0; i<_iCapacity; ++i)
+    {
+      if (_pEntries[i].key == 0)
+        continue;
+      unsigned j = hash(_pEntries[i].key) & (capacity - 1);
+      while (pNewEntries[j].key != 0)
+        j = (j + 1) & (capacity - 1);
+      pNewEntries[j] = _pEntries[i];
+    }
+  delete[] _pEntries;
+  _pEntries = pNewEntries;
+  _iCapacity = capacity;
+}
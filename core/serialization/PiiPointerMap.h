@@ -0,0 +1,108 @@
+/* This file is part of Into.
+ * Copyright (C) Intopii 2013.
+ * All rights reserved.
+ *
+ * Licensees holding a commercial Into license may use this file in
+ * accordance with the commercial license agreement. Please see
+ * LICENSE.commercial for commercial licensing terms.
+ *
+ * Alternatively, this file may be used under the terms of the GNU
+ * Affero General Public License version 3 as published by the Free
+ * Software Foundation. In addition, Intopii gives you special rights
+ * to use Into as a part of open source software projects. Please
+ * refer to LICENSE.AGPL3 for details.
+ */
+
+
+#ifndef _PIIPOINTERMAP_H
+#define _PIIPOINTERMAP_H
+
+#include "PiiSerializationGlobal.h"
+#include "PiiTrackedPointerHolder.h"
+
+/**
+ * An open-addressing hash table that maps the addresses of tracked
+ * objects to their PiiTrackedPointerHolder instances. PiiOutputArchive
+ * consults the map whenever a tracked pointer or object is saved.
+ * Keys and values are stored in a single flat array, and collisions
+ * are resolved by linear probing. Compared to QHash, a look-up does
+ * not allocate or follow node pointers.
+ *
+ * The map never removes individual entries; it only grows until it
+ * is cleared. The holders are owned by the map and deleted together
+ * with it.
+ *
+ * @internal
+ */
+class PII_SERIALIZATION_EXPORT PiiPointerMap
+{
+public:
+  PiiPointerMap();
+  /**
+   * Deletes all stored holders.
+   */
+  ~PiiPointerMap();
+
+  /**
+   * Returns the holder of *pointer*, or 0 if the pointer has not been
+   * inserted.
+   */
+  PiiTrackedPointerHolder* value(const void* pointer) const
+  {
+    if (_iCapacity == 0)
+      return 0;
+    for (unsigned i = hash(pointer) & (_iCapacity - 1); _pEntries[i].key != 0; i = (i + 1) & (_iCapacity - 1))
+      if (_pEntries[i].key == pointer)
+        return _pEntries[i].holder;
+    return 0;
+  }
+
+  /**
+   * Inserts *holder* with *pointer* as the key. *pointer* must not be
+   * null or already in the map. The map takes the ownership of
+   * *holder*.
+   */
+  void insert(const void* pointer, PiiTrackedPointerHolder* holder);
+
+  /**
+   * Returns the number of pointers in the map.
+   */
+  int size() const { return _iSize; }
+
+  /**
+   * Prepares the map for at least *count* pointers so that inserting
+   * them does not cause rehashing.
+   */
+  void reserve(int count);
+
+  /**
+   * Deletes all holders and empties the map.
+   */
+  void clear();
+
+private:
+  struct Entry
+  {
+    const void* key;
+    PiiTrackedPointerHolder* holder;
+  };
+
+  static unsigned hash(const void* pointer)
+  {
+    // Objects are aligned, which makes the lowest bits useless.
+    // Multiplicative hashing spreads the rest over the table.
+    quintptr iKey = reinterpret_cast<quintptr>(pointer);
+    unsigned iHash = unsigned((iKey >> 3) ^ (quint64(iKey) >> 32)) * 2654435769U;
+    return iHash ^ (iHash >> 16);
+  }
+
+  void rehash(unsigned capacity);
+
+  Entry* _pEntries;
+  unsigned _iCapacity;
+  int _iSize;
+
+  PII_DISABLE_COPY(PiiPointerMap);
+};
+
+#endif //_PIIPOINTERMAP_H
@@ -272,6 +272,20 @@ public:
     return map<PiiSerialization::Void>()->value(className);
   }
 
+  /**
+   * Returns the factory that creates instances of the named class
+   * when reading *Archive*. The archive-specific factory map is
+   * searched first, then the default one. Returns 0 if the class has
+   * not been registered to either.
+   */
+  template <class Archive> static PiiSerializationFactory* resolve(const char* className)
+  {
+    PiiSerializationFactory* pFactory = factory<Archive>(className);
+    if (pFactory == 0 && !Pii::IsSame<Archive, PiiSerialization::Void>::boolValue)
+      pFactory = factory<PiiSerialization::Void>(className);
+    return pFactory;
+  }
+
   /**
    * Returns a list of all class names registered to the default
    * factory.
@@ -200,6 +200,25 @@ namespace PiiSerializationTraits
    */
   template <> struct IsPrimitive<QString> : Pii::True {};
 
+  /**
+   * A type trait for primitive types whose serialized representation
+   * in a binary archive is exactly `sizeof(T)` bytes. Arrays of such
+   * types can be written and read in bulk by archives that support
+   * it. `bool`, `long` and `float` are not raw types because they
+   * are converted before writing.
+   */
+  template <class T> struct IsRawPrimitive : Pii::False {};
+  template <> struct IsRawPrimitive<char> : Pii::True {};
+  template <> struct IsRawPrimitive<signed char> : Pii::True {};
+  template <> struct IsRawPrimitive<unsigned char> : Pii::True {};
+  template <> struct IsRawPrimitive<short> : Pii::True {};
+  template <> struct IsRawPrimitive<unsigned short> : Pii::True {};
+  template <> struct IsRawPrimitive<int> : Pii::True {};
+  template <> struct IsRawPrimitive<unsigned int> : Pii::True {};
+  template <> struct IsRawPrimitive<long long> : Pii::True {};
+  template <> struct IsRawPrimitive<unsigned long long> : Pii::True {};
+  template <> struct IsRawPrimitive<double> : Pii::True {};
+
   /**
    * A type trait for checking the abstractness of a type. An explicit
    * specializations must be provided for types that cannot be
@@ -236,6 +236,38 @@ namespace PiiSerialization
     Pii::If<Archive::InputArchive, CollectionLoader, CollectionSaver>::Type::serialize(archive, lst, version, (T*)0);
   }
 
+  struct ContiguousCollectionLoader
+  {
+    template <class Archive, class Collection, class T> static void serialize(Archive& archive, Collection& lst, const unsigned int /*version*/, T*)
+    {
+      int size;
+      archive >> PII_NVP("size", size);
+      if (size < 0)
+        PII_SERIALIZATION_ERROR(InvalidDataFormat);
+      lst.resize(size);
+      archive.readPrimitiveArray(lst.data(), unsigned(size));
+    }
+  };
+
+  struct ContiguousCollectionSaver
+  {
+    template <class Archive, class Collection, class T> static void serialize(Archive& archive, const Collection& lst, const unsigned int /*version*/, T*)
+    {
+      int size = lst.size();
+      archive << PII_NVP("size", size);
+      archive.writePrimitiveArray(lst.constData(), unsigned(size));
+    }
+  };
+
+  template <class Archive, class Collection, class T> inline void serializeContiguous(Archive& archive, Collection& lst, const unsigned int version)
+  {
+    // Arrays of raw primitives are moved in bulk if the archive
+    // supports it. The archive format is the same in both cases.
+    Pii::If<Archive::BulkTransfer && PiiSerializationTraits::IsRawPrimitive<T>::boolValue,
+      typename Pii::If<Archive::InputArchive, ContiguousCollectionLoader, ContiguousCollectionSaver>::Type,
+      typename Pii::If<Archive::InputArchive, CollectionLoader, CollectionSaver>::Type>::Type::serialize(archive, lst, version, (T*)0);
+  }
+
   template <class Archive, class T, class U> inline void serialize(Archive & ar, QPair<T,U> & pair, const unsigned int /*version*/)
   {
     ar & PII_NVP("_1", pair.first);
@@ -259,6 +259,15 @@ namespace PiiSerialization
 
   template <class Archive, class Collection, class T> inline void serialize(Archive& archive, Collection& lst, const unsigned int version);
 
+  /**
+   * Serializes a collection whose elements are stored contiguously
+   * (QVector/QVarLengthArray). If the archive supports bulk transfer
+   * of primitive arrays, arrays of
+   * PiiSerializationTraits::IsRawPrimitive types are transferred as
+   * a single block.
+   */
+  template <class Archive, class Collection, class T> inline void serializeContiguous(Archive& archive, Collection& lst, const unsigned int version);
+
   /**
    * Serializes a QList.
    */
@@ -272,7 +281,7 @@ namespace PiiSerialization
    */
   template <class Archive, class T> inline void serialize(Archive & ar, QVector<T> & lst, const unsigned int version)
   {
-    serialize<Archive, QVector<T>, T>(ar, lst, version);
+    serializeContiguous<Archive, QVector<T>, T>(ar, lst, version);
   }
 
   /**
@@ -288,7 +297,7 @@ namespace PiiSerialization
    */
   template <class Archive, class T, int N> inline void serialize(Archive & ar, QVarLengthArray<T,N> & lst, const unsigned int version)
   {
-    serialize<Archive, QVarLengthArray<T,N>, T>(ar, lst, version);
+    serializeContiguous<Archive, QVarLengthArray<T,N>, T>(ar, lst, version);
   }
 
   /**
@@ -13,18 +13,30 @@
  * refer to LICENSE.AGPL3 for details.
  */
 
+
 #include "PiiTextInputArchive.h"
 
+#include <QString>
+#include <clocale>
+#include <cstdlib>
+#include <limits>
+
 PII_DEFINE_SERIALIZER(PiiTextInputArchive);
 PII_DEFINE_FACTORY_MAP(PiiTextInputArchive);
 
-PiiTextInputArchive::PiiTextInputArchive(QIODevice* d) : QTextStream(d)
+static inline bool isSpace(char c)
+{
+  return c == ' ' || (c >= '\t' && c <= '\r');
+}
+
+PiiTextInputArchive::PiiTextInputArchive(QIODevice* d) :
+  _pDevice(d),
+  _iPosition(0),
+  _cDecimalPoint(*std::localeconv()->decimal_point)
 {
   if (!d->isOpen())
     PII_SERIALIZATION_ERROR(StreamNotOpen);
 
-  setCodec("UTF-8");
-
   // Read and verify ID
   char id[PII_TEXT_ARCHIVE_ID_LEN];
   if (d->read(id, PII_TEXT_ARCHIVE_ID_LEN) != PII_TEXT_ARCHIVE_ID_LEN)
@@ -53,13 +65,121 @@ PiiTextInputArchive::PiiTextInputArchive(QIODevice* d) : QTextStream(d)
   setMinorVersion(iVersion);
 }
 
+bool PiiTextInputArchive::fillBuffer()
+{
+  if (_iPosition < _aBuffer.size())
+    return true;
+  _aBuffer = _pDevice->read(16384);
+  _iPosition = 0;
+  return !_aBuffer.isEmpty();
+}
+
+void PiiTextInputArchive::skipWhiteSpace()
+{
+  while (fillBuffer())
+    {
+      const char* pData = _aBuffer.constData();
+      const int iSize = _aBuffer.size();
+      while (_iPosition < iSize && isSpace(pData[_iPosition]))
+        ++_iPosition;
+      if (_iPosition < iSize)
+        return;
+    }
+}
+
+void PiiTextInputArchive::readToken()
+{
+  skipWhiteSpace();
+  _aToken.resize(0);
+  while (fillBuffer())
+    {
+      const char* pData = _aBuffer.constData();
+      const int iSize = _aBuffer.size(), iStart = _iPosition;
+      while (_iPosition < iSize && !isSpace(pData[_iPosition]))
+        ++_iPosition;
+      _aToken.append(pData + iStart, _iPosition - iStart);
+      // Token continues in the next block.
+      if (_iPosition < iSize)
+        return;
+    }
+}
+
+QString PiiTextInputArchive::readCharacters(int count)
+{
+  // Decodes UTF-8 until count UTF-16 code units have been read.
+  QString strResult;
+  strResult.reserve(count);
+  while (strResult.size() < count)
+    {
+      if (!fillBuffer())
+        PII_SERIALIZATION_ERROR(InvalidDataFormat);
+      const uchar ucLead = uchar(_aBuffer[_iPosition++]);
+      int iExtraBytes = ucLead < 0x80 ? 0 : ucLead < 0xe0 ? 1 : ucLead < 0xf0 ? 2 : 3;
+      uint uiCode = iExtraBytes == 0 ? ucLead : ucLead & (0x3f >> iExtraBytes);
+      if (ucLead >= 0x80 && ucLead < 0xc0)
+        {
+          // Stray continuation byte.
+          strResult.append(QChar(QChar::ReplacementCharacter));
+          continue;
+        }
+      for (; iExtraBytes > 0; --iExtraBytes)
+        {
+          if (!fillBuffer())
+            PII_SERIALIZATION_ERROR(InvalidDataFormat);
+          const uchar ucNext = uchar(_aBuffer[_iPosition]);
+          if ((ucNext & 0xc0) != 0x80)
+            break;
+          ++_iPosition;
+          uiCode = (uiCode << 6) | (ucNext & 0x3f);
+        }
+      if (iExtraBytes > 0 || uiCode > 0x10ffff)
+        strResult.append(QChar(QChar::ReplacementCharacter));
+      else if (uiCode > 0xffff)
+        {
+          strResult.append(QChar(ushort(0xd800 + ((uiCode - 0x10000) >> 10))));
+          strResult.append(QChar(ushort(0xdc00 + ((uiCode - 0x10000) & 0x3ff))));
+        }
+      else
+        strResult.append(QChar(ushort(uiCode)));
+    }
+  if (strResult.size() != count)
+    PII_SERIALIZATION_ERROR(InvalidDataFormat);
+  return strResult;
+}
+
+double PiiTextInputArchive::readReal()
+{
+  readToken();
+  // Read the number as text to catch "nan", "inf", and "-inf"
+  if (_aToken == "nan")
+    return std::numeric_limits<double>::quiet_NaN();
+  if (_aToken == "inf")
+    return std::numeric_limits<double>::infinity();
+  if (_aToken == "-inf")
+    return -std::numeric_limits<double>::infinity();
+  if (_aToken.isEmpty())
+    PII_SERIALIZATION_ERROR(InvalidDataFormat);
+
+  // strtod() uses the decimal point of the C locale.
+  if (_cDecimalPoint != '.')
+    {
+      int iPoint = _aToken.indexOf('.');
+      if (iPoint >= 0)
+        _aToken[iPoint] = _cDecimalPoint;
+    }
+  const char* pStart = _aToken.constData();
+  char* pEnd = 0;
+  double dValue = std::strtod(pStart, &pEnd);
+  if (pEnd != pStart + _aToken.size())
+    PII_SERIALIZATION_ERROR(InvalidDataFormat);
+  return dValue;
+}
+
 void PiiTextInputArchive::readRawData(void* ptr, unsigned int size)
 {
-  startDelim();
   // Base64 encoded data has no spaces.
-  QString strEncoded;
-  QTextStream::operator>>(strEncoded);
-  QByteArray decoded(QByteArray::fromBase64(strEncoded.toLatin1()));
+  readToken();
+  QByteArray decoded(QByteArray::fromBase64(_aToken));
   if (int(size) != decoded.size())
     PII_SERIALIZATION_ERROR(InvalidDataFormat);
   std::memcpy(ptr, decoded.constData(), size);
@@ -73,13 +193,12 @@ PiiTextInputArchive& PiiTextInputArchive::operator>> (QString& value)
   *this >> len;
   if (len > 0)
     {
-      // Read separator.
-      char ws;
-      QTextStream::operator>>(ws);
-      // Read all characters
-      value = QTextStream::read(len);
-      if (value.size() != len)
+      // Skip the separator.
+      if (!fillBuffer())
         PII_SERIALIZATION_ERROR(InvalidDataFormat);
+      ++_iPosition;
+      // Read all characters
+      value = readCharacters(len);
     }
   return *this;
 }
@@ -89,13 +208,17 @@ PiiTextInputArchive& PiiTextInputArchive::operator>> (char*& value)
   unsigned len;
   *this >> len;
   // PENDING limit for len
-  value = new char[len+1];
+  QByteArray aLatin1;
   if (len > 0)
     {
-      startDelim();
-      for (unsigned i=0; i<len; i++)
-        QTextStream::operator>>(value[i]);
+      // Skip the separator.
+      if (!fillBuffer())
+        PII_SERIALIZATION_ERROR(InvalidDataFormat);
+      ++_iPosition;
+      aLatin1 = readCharacters(int(len)).toLatin1();
     }
+  value = new char[len+1];
+  std::memcpy(value, aLatin1.constData(), len);
   // Terminate the string with null
   value[len] = '\0';
   return *this;
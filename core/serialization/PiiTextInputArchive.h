@@ -13,15 +13,18 @@
  * refer to LICENSE.AGPL3 for details.
  */
 
+
 #ifndef _PIITEXTINPUTARCHIVE_H
 #define _PIITEXTINPUTARCHIVE_H
 
-#include <QTextStream>
+#include <QIODevice>
+#include <QByteArray>
 #include "PiiArchive.h"
 #include "PiiInputArchive.h"
 #include "PiiArchiveMacros.h"
 #include "PiiTextArchive.h"
 #include <cstring>
+#include <limits>
 
 /* PENDING This class and siblings should perhaps be separated into
  * two parts: PiiTextInputArchiveBase which does not derive
@@ -38,11 +41,14 @@
  * TextInputArchive reads space-separated textual data. All non-ASCII
  * characters need to be UTF-8 encoded.
  *
+ * The archive reads its device in large blocks and parses numbers
+ * directly from the read buffer independent of the current locale.
+ * Since the archive reads ahead, the device should not be read by
+ * others while the archive exists.
  */
 class PII_SERIALIZATION_EXPORT PiiTextInputArchive :
   public PiiInputArchive<PiiTextInputArchive>,
-  public PiiArchive,
-  private QTextStream
+  public PiiArchive
 {
 public:
   /**
@@ -67,14 +73,14 @@ public:
   PiiTextInputArchive& operator>> (char& value)
   {
     short shrt;
-    QTextStream::operator>>(shrt);
+    readInteger(shrt);
     value = (char)shrt;
     return *this;
   }
   PiiTextInputArchive& operator>> (unsigned char& value)
   {
     unsigned short shrt;
-    QTextStream::operator>>(shrt);
+    readInteger(shrt);
     value = (unsigned char)shrt;
     return *this;
   }
@@ -88,27 +94,85 @@ public:
     return readFloat(value);
   }
 
+  PiiTextInputArchive& operator>> (short& value) { return readInteger(value); }
+  PiiTextInputArchive& operator>> (int& value) { return readInteger(value); }
+  PiiTextInputArchive& operator>> (long long& value) { return readInteger(value); }
+  PiiTextInputArchive& operator>> (unsigned short& value) { return readInteger(value); }
+  PiiTextInputArchive& operator>> (unsigned int& value) { return readInteger(value); }
+  PiiTextInputArchive& operator>> (unsigned long long& value) { return readInteger(value); }
+  PiiTextInputArchive& operator>> (bool& value)
+  {
+    unsigned char c;
+    operator>> (c);
+    value = c != 0;
+    return *this;
+  }
+  PiiTextInputArchive& operator>> (long& value)
+  {
+    int i;
+    readInteger(i);
+    value = i;
+    return *this;
+  }
+  PiiTextInputArchive& operator>> (unsigned long& value)
+  {
+    unsigned int i;
+    readInteger(i);
+    value = i;
+    return *this;
+  }
+
   PII_DEFAULT_INPUT_OPERATORS(PiiTextInputArchive)
-  PII_INTEGER_INPUT_OPERATORS(PiiTextInputArchive, QTextStream)
 
 protected:
   // Text archive sucks all white space before reading the actual value.
-  void startDelim() { QTextStream::skipWhiteSpace(); }
+  void startDelim() { skipWhiteSpace(); }
   void endDelim() {}
 
 private:
-  template <class T> PiiTextInputArchive& readFloat(T& value)
+  template <class T> PiiTextInputArchive& readInteger(T& value)
   {
-    // Read the number as text to catch "nan", "inf", and "-inf"
-    startDelim();
-    QString valueTxt;
-    QTextStream::operator>> (valueTxt);
-    bool ok;
-    value = (T)valueTxt.toDouble(&ok);
-    if (!ok)
+    readToken();
+    const char* pData = _aToken.constData(), *pEnd = pData + _aToken.size();
+    const bool bNegative = pData != pEnd && *pData == '-';
+    if (pData != pEnd && (*pData == '-' || *pData == '+'))
+      ++pData;
+    if (pData == pEnd || (bNegative && !std::numeric_limits<T>::is_signed))
       PII_SERIALIZATION_ERROR(InvalidDataFormat);
+
+    // The magnitude is accumulated as an unsigned 64-bit number and
+    // checked against the range of T.
+    const quint64 iLimit = bNegative ?
+      quint64(-(std::numeric_limits<T>::min() + 1)) + 1 :
+      quint64(std::numeric_limits<T>::max());
+    quint64 iMagnitude = 0;
+    for (; pData != pEnd; ++pData)
+      {
+        const unsigned int uiDigit = unsigned(*pData - '0');
+        if (uiDigit > 9 || iMagnitude > (iLimit - uiDigit) / 10)
+          PII_SERIALIZATION_ERROR(InvalidDataFormat);
+        iMagnitude = iMagnitude * 10 + uiDigit;
+      }
+    value = bNegative ? T(-qint64(iMagnitude - 1) - 1) : T(iMagnitude);
+    return *this;
+  }
+
+  template <class T> PiiTextInputArchive& readFloat(T& value)
+  {
+    value = (T)readReal();
     return *this;
   }
+
+  double readReal();
+  void skipWhiteSpace();
+  void readToken();
+  bool fillBuffer();
+  QString readCharacters(int count);
+
+  QIODevice* _pDevice;
+  QByteArray _aBuffer, _aToken;
+  int _iPosition;
+  char _cDecimalPoint;
 };
 
 PII_DECLARE_SERIALIZER(PiiTextInputArchive);
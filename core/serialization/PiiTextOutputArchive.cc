@@ -13,17 +13,26 @@
  * refer to LICENSE.AGPL3 for details.
  */
 
+
 #include "PiiTextOutputArchive.h"
 
+#include <QString>
+#include <clocale>
+#include <cstdlib>
+#include <cmath>
+#include <limits>
+
 PII_DEFINE_SERIALIZER(PiiTextOutputArchive);
 PII_DEFINE_FACTORY_MAP(PiiTextOutputArchive);
 
-PiiTextOutputArchive::PiiTextOutputArchive(QIODevice* d) : QTextStream(d)
+PiiTextOutputArchive::PiiTextOutputArchive(QIODevice* d) :
+  _pDevice(d),
+  _cDecimalPoint(*std::localeconv()->decimal_point)
 {
   if (!d->isOpen())
     PII_SERIALIZATION_ERROR(StreamNotOpen);
 
-  setCodec("UTF-8");
+  _aBuffer.reserve(16384 + 64);
 
   // Store archive ID
   if (d->write(PII_TEXT_ARCHIVE_ID, PII_TEXT_ARCHIVE_ID_LEN) != PII_TEXT_ARCHIVE_ID_LEN)
@@ -36,11 +45,25 @@ PiiTextOutputArchive::PiiTextOutputArchive(QIODevice* d) : QTextStream(d)
   setMinorVersion(PII_TEXT_ARCHIVE_VERSION);
 }
 
+PiiTextOutputArchive::~PiiTextOutputArchive()
+{
+  // Destructors must not throw.
+  if (!_aBuffer.isEmpty())
+    _pDevice->write(_aBuffer);
+}
+
+void PiiTextOutputArchive::flush()
+{
+  if (_pDevice->write(_aBuffer) != qint64(_aBuffer.size()))
+    PII_SERIALIZATION_ERROR(StreamError);
+  _aBuffer.resize(0);
+}
+
 void PiiTextOutputArchive::writeRawData(const void* ptr, unsigned int size)
 {
   startDelim();
   QByteArray encoded(QByteArray::fromRawData(static_cast<const char*>(ptr), size).toBase64());
-  QTextStream::operator<< ((const char*)encoded.data());
+  write(encoded.constData(), encoded.size());
 }
 
 PiiTextOutputArchive& PiiTextOutputArchive::operator<< (const QString& value)
@@ -50,7 +73,8 @@ PiiTextOutputArchive& PiiTextOutputArchive::operator<< (const QString& value)
   if (len > 0)
     {
       startDelim();
-      QTextStream::operator<<(value);
+      QByteArray aUtf8(value.toUtf8());
+      write(aUtf8.constData(), aUtf8.size());
     }
   return *this;
 }
@@ -63,7 +87,59 @@ PiiTextOutputArchive& PiiTextOutputArchive::operator<< (const char* value)
     {
       // Separate length and data
       startDelim();
-      QTextStream::operator<< (value);
+      // Bytes are Latin-1 characters.
+      QByteArray aUtf8(QString::fromLatin1(value, len).toUtf8());
+      write(aUtf8.constData(), aUtf8.size());
     }
   return *this;
 }
+
+PiiTextOutputArchive& PiiTextOutputArchive::operator<< (float value)
+{
+  writeReal(value, 6, 9, true);
+  return *this;
+}
+
+PiiTextOutputArchive& PiiTextOutputArchive::operator<< (double value)
+{
+  writeReal(value, 15, 17, false);
+  return *this;
+}
+
+void PiiTextOutputArchive::writeReal(double value, int minPrecision, int maxPrecision, bool isFloat)
+{
+  startDelim();
+  if (value != value)
+    {
+      write("nan", 3);
+      return;
+    }
+  if (std::fabs(value) > std::numeric_limits<double>::max())
+    {
+      if (value < 0)
+        write("-inf", 4);
+      else
+        write("inf", 3);
+      return;
+    }
+
+  // Use the smallest precision that reads back to the same value.
+  char buffer[32];
+  int iLength = 0;
+  for (int iPrecision = minPrecision; iPrecision <= maxPrecision; ++iPrecision)
+    {
+      iLength = qsnprintf(buffer, sizeof(buffer), "%.*g", iPrecision, value);
+      double dParsed = std::strtod(buffer, 0);
+      if (isFloat ? float(dParsed) == float(value) : dParsed == value)
+        break;
+    }
+  // %g never uses thousands separators, but the decimal point
+  // depends on the C locale.
+  if (_cDecimalPoint != '.')
+    {
+      char* pPoint = static_cast<char*>(std::memchr(buffer, _cDecimalPoint, iLength));
+      if (pPoint != 0)
+        *pPoint = '.';
+    }
+  write(buffer, iLength);
+}
@@ -13,10 +13,12 @@
  * refer to LICENSE.AGPL3 for details.
  */
 
+
 #ifndef _PIITEXTOUTPUTARCHIVE_H
 #define _PIITEXTOUTPUTARCHIVE_H
 
-#include <QTextStream>
+#include <QIODevice>
+#include <QByteArray>
 #include <cstring>
 #include "PiiArchive.h"
 #include "PiiOutputArchive.h"
@@ -27,11 +29,15 @@
  * Text output archive stores data in a space-separated textual
  * format. The archive uses UTF-8 to encode non-ASCII characters.
  *
+ * Numbers are formatted independent of the current locale. Floating
+ * point numbers are written with the smallest number of significant
+ * digits that reads back to the same value. Output is buffered and
+ * written to the device in large blocks; the buffer is flushed when
+ * the archive is destroyed.
  */
 class PII_SERIALIZATION_EXPORT PiiTextOutputArchive :
   public PiiOutputArchive<PiiTextOutputArchive>,
-  public PiiArchive,
-  private QTextStream
+  public PiiArchive
 {
 public:
   /**
@@ -42,6 +48,10 @@ public:
    * or cannot be written to.
    */
   PiiTextOutputArchive(QIODevice* d);
+  /**
+   * Flushes buffered data to the device.
+   */
+  ~PiiTextOutputArchive();
 
   /**
    * Writes raw binary data to the text archive. The data is base64
@@ -54,13 +64,57 @@ public:
 
   PiiTextOutputArchive& operator<< (char value) { return operator<<((short)value); }
   PiiTextOutputArchive& operator<< (unsigned char value) { return operator<<((unsigned short)value); }
-  PII_PRIMITIVE_OUTPUT_OPERATORS(PiiTextOutputArchive, QTextStream)
+  PiiTextOutputArchive& operator<< (short value) { return writeInteger(value); }
+  PiiTextOutputArchive& operator<< (int value) { return writeInteger(value); }
+  PiiTextOutputArchive& operator<< (long long value) { return writeInteger(value); }
+  PiiTextOutputArchive& operator<< (unsigned short value) { return writeInteger(value); }
+  PiiTextOutputArchive& operator<< (unsigned int value) { return writeInteger(value); }
+  PiiTextOutputArchive& operator<< (unsigned long long value) { return writeInteger(value); }
+  PiiTextOutputArchive& operator<< (bool value) { return operator<<((unsigned char)value); }
+  PiiTextOutputArchive& operator<< (long value) { return operator<<((int)value); }
+  PiiTextOutputArchive& operator<< (unsigned long value) { return operator<<((unsigned int)value); }
+  PiiTextOutputArchive& operator<< (float value);
+  PiiTextOutputArchive& operator<< (double value);
   PII_DEFAULT_OUTPUT_OPERATORS(PiiTextOutputArchive)
 
 protected:
   // Text archive separates each value by a single space.
-  void startDelim() { QTextStream::operator<< (' '); }
+  void startDelim() { write(" ", 1); }
   void endDelim() {}
+
+private:
+  template <class T> PiiTextOutputArchive& writeInteger(T value)
+  {
+    // Digits are produced from the least significant end.
+    char buffer[24];
+    char* pEnd = buffer + sizeof(buffer), *pStart = pEnd;
+    const bool bNegative = value < 0;
+    do
+      {
+        T digit = value % 10;
+        *--pStart = char('0' + (bNegative ? -digit : digit));
+        value /= 10;
+      }
+    while (value != 0);
+    if (bNegative)
+      *--pStart = '-';
+    startDelim();
+    write(pStart, int(pEnd - pStart));
+    return *this;
+  }
+
+  void writeReal(double value, int minPrecision, int maxPrecision, bool isFloat);
+  void write(const char* data, int size)
+  {
+    _aBuffer.append(data, size);
+    if (_aBuffer.size() >= 16384)
+      flush();
+  }
+  void flush();
+
+  QIODevice* _pDevice;
+  QByteArray _aBuffer;
+  char _cDecimalPoint;
 };
 
 PII_DECLARE_SERIALIZER(PiiTextOutputArchive);
@@ -39,6 +39,7 @@ public:
 
   void removeAt(int i) { self()->erase(self()->begin() + i); }
   void removeLast() { self()->pop_back(); }
+  T takeLast() { T value(self()->back()); self()->pop_back(); return value; }
   void append(const T& value) { self()->push_back(value); }
   void append(const Derived& values)
   {
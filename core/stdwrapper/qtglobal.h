@@ -48,9 +48,13 @@ typedef unsigned int quint32;
 #if defined(Q_OS_WIN) && !defined(__GNUC__)
 typedef __int64 qint64;
 typedef unsigned __int64 quint64;
+#  define Q_INT64_C(c) c ## i64
+#  define Q_UINT64_C(c) c ## ui64
 #else
 typedef long long qint64;
 typedef unsigned long long quint64;
+#  define Q_INT64_C(c) static_cast<long long>(c ## LL)
+#  define Q_UINT64_C(c) static_cast<unsigned long long>(c ## ULL)
 #endif
 
 
@@ -72,4 +76,23 @@ template <class T> inline void qSwap(T& a, T&b) { std::swap(a, b); }
 
 #define Q_UNUSED(X) (void)(X)
 
+#ifdef PII_CXX11
+#  define Q_ALIGNOF(T) alignof(T)
+#elif defined(_MSC_VER)
+#  define Q_ALIGNOF(T) __alignof(T)
+#else
+#  define Q_ALIGNOF(T) __alignof__(T)
+#endif
+
+// Without Qt's type registry, every type is assumed to need its
+// constructors. Specializations may relax this.
+template <class T> struct QTypeInfo
+{
+  enum { isStatic = true };
+};
+template <class T> struct QTypeInfo<T*>
+{
+  enum { isStatic = false };
+};
+
 #endif //_QTGLOBAL_H
@@ -27,13 +27,17 @@ public:
   ~QVarLengthArray()
   {
     if (_ptr != _array)
-      delete _ptr;
+      delete[] _ptr;
   }
 
   T& operator[] (int index) { return _ptr[index]; }
   const T& operator[] (int index) const { return _ptr[index]; }
   const T& at(int index) const { return _ptr[index]; }
 
+  T* data() { return _ptr; }
+  const T* data() const { return _ptr; }
+  const T* constData() const { return _ptr; }
+
   int size() const { return _iSize; }
 
 private:
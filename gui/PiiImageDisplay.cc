@@ -147,6 +147,16 @@ bool PiiImageDisplay::showHorizontalMeasureBar() const
   return d->ui._pHorizontalMeasureBar->isVisible();
 }
 
+void PiiImageDisplay::setMaxFrameRate(double maxFrameRate)
+{
+  d->ui._pImageScrollArea->setMaxFrameRate(maxFrameRate);
+}
+
+double PiiImageDisplay::maxFrameRate() const
+{
+  return d->ui._pImageScrollArea->maxFrameRate();
+}
+
 void PiiImageDisplay::setImage(const PiiVariant& image, int layer)
 {
   d->ui._pImageScrollArea->setImage(image,layer);
@@ -57,6 +57,12 @@ class PII_GUI_EXPORT PiiImageDisplay : public QFrame
   Q_PROPERTY(bool showHorizontalMeasureBar READ showHorizontalMeasureBar WRITE setShowHorizontalMeasureBar);
   Q_PROPERTY(bool showVerticalMeasureBar READ showVerticalMeasureBar WRITE setShowVerticalMeasureBar);
 
+  /**
+   * The maximum number of images displayed per second. See
+   * [PiiImageScrollArea::maxFrameRate].
+   */
+  Q_PROPERTY(double maxFrameRate READ maxFrameRate WRITE setMaxFrameRate);
+
 public:
   /**
    * Display types.
@@ -82,6 +88,9 @@ public:
   void setShowVerticalMeasureBar(bool show);
   bool showVerticalMeasureBar() const;
 
+  void setMaxFrameRate(double maxFrameRate);
+  double maxFrameRate() const;
+
   /**
    * Returns the horizontal measure bar.
    */
@@ -21,6 +21,7 @@
 #include <PiiQImage.h>
 #include <PiiColor.h>
 #include <PiiImageDisplay.h>
+#include <PiiTimer.h>
 
 #include <QScrollBar>
 #include <QtDebug>
@@ -28,6 +29,7 @@
 #include <QMouseEvent>
 #include <QWheelEvent>
 #include <QPoint>
+#include <QTimer>
 
 PiiImageScrollArea::Data::Data() :
   pImageViewport(0),
@@ -35,7 +37,10 @@ PiiImageScrollArea::Data::Data() :
   bDragging(false),
   displayType(PiiImageDisplay::Normal),
   dStartX(0),
-  dStartY(0)
+  dStartY(0),
+  dMaxFrameRate(30),
+  pFrameTimer(0),
+  iLastFrameTime(0)
 {
   lstImages << 0;
 }
@@ -103,6 +108,10 @@ void PiiImageScrollArea::init()
           this, SLOT(visibleAreaChanged(int, int, int, int)));
   connect(d->pImageViewport, SIGNAL(areaSelected(const QRect&,int)), this, SIGNAL(areaSelected(const QRect&,int)));
   connect(d->pImageViewport, SIGNAL(clicked(const QPoint&,int)), this, SIGNAL(clicked(const QPoint&,int)));
+
+  d->pFrameTimer = new QTimer(this);
+  d->pFrameTimer->setSingleShot(true);
+  connect(d->pFrameTimer, SIGNAL(timeout()), SLOT(showPendingImages()));
 }
 
 
@@ -241,6 +250,45 @@ void PiiImageScrollArea::scrollContentsBy(int dx, int dy)
 }
 
 void PiiImageScrollArea::setImage(const PiiVariant& image, int layer)
+{
+  if (d->dMaxFrameRate <= 0)
+    {
+      showImage(image, layer);
+      return;
+    }
+
+  // Just store the image if it cannot be shown right now. If images
+  // arrive faster than they can be shown, the older ones will be
+  // replaced without ever being converted.
+  d->mapPendingImages[layer] = image;
+  if (!isVisible() || d->pFrameTimer->isActive())
+    return;
+
+  qint64 iInterval = qint64(1e6 / d->dMaxFrameRate);
+  qint64 iElapsed = PiiTimer::currentTime() - d->iLastFrameTime;
+  if (iElapsed >= iInterval)
+    showPendingImages();
+  else
+    d->pFrameTimer->start(int((iInterval - iElapsed + 999) / 1000));
+}
+
+void PiiImageScrollArea::showPendingImages()
+{
+  d->iLastFrameTime = PiiTimer::currentTime();
+  QMap<int,PiiVariant> mapImages;
+  mapImages.swap(d->mapPendingImages);
+  for (QMap<int,PiiVariant>::const_iterator i = mapImages.constBegin(); i != mapImages.constEnd(); ++i)
+    showImage(i.value(), i.key());
+}
+
+void PiiImageScrollArea::showEvent(QShowEvent* event)
+{
+  QAbstractScrollArea::showEvent(event);
+  if (!d->mapPendingImages.isEmpty())
+    showPendingImages();
+}
+
+void PiiImageScrollArea::showImage(const PiiVariant& image, int layer)
 {
   if (layer < 0 || layer > d->lstImages.size())
     return;
@@ -338,3 +386,16 @@ template <class T> void PiiImageScrollArea::view(const PiiMatrix<T>& image, int
 
 void PiiImageScrollArea::setDisplayType(int type) { d->displayType = type; }
 int PiiImageScrollArea::displayType() { return d->displayType; }
+
+void PiiImageScrollArea::setMaxFrameRate(double maxFrameRate)
+{
+  d->dMaxFrameRate = maxFrameRate;
+  // Don't let the last received images wait forever.
+  if (maxFrameRate <= 0 && !d->mapPendingImages.isEmpty())
+    {
+      d->pFrameTimer->stop();
+      showPendingImages();
+    }
+}
+
+double PiiImageScrollArea::maxFrameRate() const { return d->dMaxFrameRate; }
@@ -18,6 +18,7 @@
 
 #include <QAbstractScrollArea>
 #include <QImage>
+#include <QMap>
 
 #include <PiiVariant.h>
 #include <PiiMatrix.h>
@@ -25,12 +26,25 @@
 
 class PiiImageViewport;
 class QWidget;
+class QTimer;
 
 class PII_GUI_EXPORT PiiImageScrollArea : public QAbstractScrollArea
 {
   Q_OBJECT
   Q_PROPERTY(int displayType READ displayType WRITE setDisplayType);
 
+  /**
+   * The maximum number of images converted and displayed per second.
+   * Images that arrive faster are not converted. Only the latest
+   * image is displayed once the frame interval has passed. If the
+   * widget is hidden, images are not converted at all until it is
+   * shown again. This keeps the cost of converting incoming images
+   * bounded no matter how fast they arrive, and the display never
+   * slows down the sender. Zero or a negative value disables decimation. The default
+   * value is 30.
+   */
+  Q_PROPERTY(double maxFrameRate READ maxFrameRate WRITE setMaxFrameRate);
+
 public:
   PiiImageScrollArea(QImage *image, QWidget* parent = 0);
   PiiImageScrollArea(const QImage& image, QWidget* parent = 0);
@@ -41,6 +55,9 @@ public:
   void setDisplayType(int type);
   int displayType();
 
+  void setMaxFrameRate(double maxFrameRate);
+  double maxFrameRate() const;
+
   PiiImageViewport* imageViewport() const;
 
   double startX() const;
@@ -55,6 +72,7 @@ protected:
   void resizeEvent(QResizeEvent* event);
   void wheelEvent(QWheelEvent *event);
   void scrollContentsBy ( int dx, int dy );
+  void showEvent(QShowEvent* event);
 
 
   /// @internal
@@ -84,6 +102,12 @@ protected:
     int displayType;
 
     double dStartX, dStartY;
+
+    double dMaxFrameRate;
+    // Images received but not yet converted, by layer
+    QMap<int,PiiVariant> mapPendingImages;
+    QTimer* pFrameTimer;
+    qint64 iLastFrameTime;
   } *d;
 
   /// @internal
@@ -123,7 +147,11 @@ public slots:
 protected slots:
   void visibleAreaChanged(int x, int y, int width, int height);
 
+private slots:
+  void showPendingImages();
+
 private:
+  void showImage(const PiiVariant& image, int layer);
   template <class T> void grayImage(const PiiVariant& obj, int layer);
   template <class T> void floatImage(const PiiVariant& obj, int layer);
   template <class T> void colorImage(const PiiVariant& obj, int layer);
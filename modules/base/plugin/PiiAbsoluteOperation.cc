@@ -29,26 +29,33 @@ PiiAbsoluteOperation::PiiAbsoluteOperation() :
 
 void PiiAbsoluteOperation::process()
 {
-  PiiVariant obj = readInput();
+  emitObject(transform(readInput()));
+}
 
+bool PiiAbsoluteOperation::isFusible() const
+{
+  return true;
+}
+
+PiiVariant PiiAbsoluteOperation::transform(const PiiVariant& obj)
+{
   switch (obj.type())
     {
-      PII_NUMERIC_CASES(operatePrimitive, obj);
-      PII_COMPLEX_CASES(operatePrimitive, obj);
-      PII_NUMERIC_MATRIX_CASES(operateMatrix, obj);
-      PII_COMPLEX_MATRIX_CASES(operateMatrix, obj);
-    default:
-      emitObject(obj);
+      PII_NUMERIC_CASES(return operatePrimitive, obj);
+      PII_COMPLEX_CASES(return operatePrimitive, obj);
+      PII_NUMERIC_MATRIX_CASES(return operateMatrix, obj);
+      PII_COMPLEX_MATRIX_CASES(return operateMatrix, obj);
     }
+  return obj;
 }
 
-template <class T> void PiiAbsoluteOperation::operatePrimitive( const PiiVariant& obj )
+template <class T> PiiVariant PiiAbsoluteOperation::operatePrimitive( const PiiVariant& obj )
 {
-  emitObject(Pii::abs(obj.valueAs<T>()));
+  return createVariant(Pii::abs(obj.valueAs<T>()));
 }
 
 
-template <class T> void PiiAbsoluteOperation::operateMatrix( const PiiVariant& obj )
+template <class T> PiiVariant PiiAbsoluteOperation::operateMatrix( const PiiVariant& obj )
 {
-  emitObject(Pii::abs(obj.valueAs<PiiMatrix<T> >()));
+  return createVariant(Pii::abs(obj.valueAs<PiiMatrix<T> >()));
 }
@@ -17,6 +17,7 @@
 #define _PIIABSOLUTEOPERATION_H
 
 #include <PiiDefaultOperation.h>
+#include <PiiFusibleOperation.h>
 #include <PiiMatrix.h>
 
 /**
@@ -33,21 +34,27 @@
  *
  * @out output - absolute value(s)
  *
+ * The operation can be fused with other element-wise operations (see
+ * PiiFusibleOperation).
  */
-class PiiAbsoluteOperation : public PiiDefaultOperation
+class PiiAbsoluteOperation : public PiiDefaultOperation, public PiiFusibleOperation
 {
   Q_OBJECT
+  Q_INTERFACES(PiiFusibleOperation)
 
   PII_OPERATION_SERIALIZATION_FUNCTION
 public:
   PiiAbsoluteOperation();
 
+  bool isFusible() const;
+  PiiVariant transform(const PiiVariant& obj);
+
 protected:
   void process();
 
 private:
-  template <class T> void operatePrimitive( const PiiVariant& obj );
-  template <class T> void operateMatrix( const PiiVariant& obj );
+  template <class T> static PiiVariant operatePrimitive( const PiiVariant& obj );
+  template <class T> static PiiVariant operateMatrix( const PiiVariant& obj );
 };
 
 
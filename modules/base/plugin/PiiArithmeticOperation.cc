@@ -17,11 +17,13 @@
 #include <PiiYdinTypes.h>
 #include <QString>
 #include <PiiMath.h>
+#include <PiiSaturatingArithmetic.h>
 
 PiiArithmeticOperation::Data::Data() :
   pConstant(PiiVariant(0.0)),
   bInput1Connected(false),
-  function(Plus)
+  function(Plus),
+  bSaturated(false)
 {
 }
 
@@ -41,8 +43,21 @@ void PiiArithmeticOperation::setConstant(const PiiVariant& constant) { _d()->pCo
 
 PiiArithmeticOperation::Function PiiArithmeticOperation::function() const { return _d()->function; }
 void PiiArithmeticOperation::setFunction(Function function) { _d()->function = function; }
+bool PiiArithmeticOperation::saturated() const { return _d()->bSaturated; }
+void PiiArithmeticOperation::setSaturated(bool saturated) { _d()->bSaturated = saturated; }
 
 
+PiiArithmeticOperation::Dispatchers::Dispatchers()
+{
+  PII_NUMERIC_DISPATCH(calculators, &PiiArithmeticOperation::calculate);
+}
+
+const PiiArithmeticOperation::Dispatchers& PiiArithmeticOperation::dispatchers()
+{
+  static const Dispatchers instance;
+  return instance;
+}
+
 void PiiArithmeticOperation::check(bool reset)
 {
   PiiDefaultOperation::check(reset);
@@ -62,11 +77,28 @@ void PiiArithmeticOperation::wrongTypes(int type0, int type1)
             .arg(type1, 0, 16));
 }
 
+bool PiiArithmeticOperation::isFusible() const
+{
+  // A matrix constant applies to whole matrices, not blocks of rows.
+  const PII_D;
+  return !d->bInput1Connected && !PiiYdin::isMatrixType(d->pConstant.type());
+}
+
+PiiVariant PiiArithmeticOperation::transform(const PiiVariant& obj)
+{
+  return apply(obj, _d()->pConstant);
+}
+
 void PiiArithmeticOperation::process()
 {
   PII_D;
   PiiVariant obj0 = d->pInput0->firstObject();
   PiiVariant obj1 = d->bInput1Connected ? d->pInput1->firstObject() : d->pConstant;
+  d->pOutput->emitObject(apply(obj0, obj1));
+}
+
+PiiVariant PiiArithmeticOperation::apply(const PiiVariant& obj0, const PiiVariant& obj1)
+{
   int iType0 = obj0.type(), iType1 = obj1.type();
   int iClass0 = iType0 & ~0x1f, iClass1 = iType1 & ~0x1f;
   int iPrimitive0 = iType0 & 0x1f, iPrimitive1 = iType1 & 0x1f;
@@ -90,109 +122,138 @@ void PiiArithmeticOperation::process()
         iResultType = qMax(iPrimitive0 & ~0x8, iPrimitive1 & ~0x8);
     }
 
-  switch (iResultType)
-    {
-      PII_NUMERIC_CASES_M(calculate, (obj0, obj1));
-    default:
-      wrongTypes(iType0, iType1);
-    }
+  CalculateFunction pCalculate = dispatchers().calculators[iResultType];
+  if (pCalculate == 0)
+    wrongTypes(iType0, iType1);
+  return (this->*pCalculate)(obj0, obj1);
 }
 
-template <class T> void PiiArithmeticOperation::send(const T& value)
+template <class T> PiiVariant PiiArithmeticOperation::result(const T& value)
 {
-  _d()->pOutput->emitObject(value);
+  return PiiYdin::createVariant(value);
 }
 
-template <class T> void PiiArithmeticOperation::calculate(const PiiVariant& obj0, const PiiVariant& obj1)
+template <class T> PiiVariant PiiArithmeticOperation::calculate(const PiiVariant& obj0, const PiiVariant& obj1)
 {
   int iType0 = obj0.type(), iType1 = obj1.type();
   int iMatrixMask = ((iType0 & 0x40) >> 6) | ((iType1 & 0x40) >> 5);
   if (iMatrixMask == 0) // Both scalars
     {
-      T op0 = 0, op1 = 0;
-      switch (iType0)
-        {
-          PII_NUMERIC_CASES(op0 = (T)PiiYdin::primitiveAs, obj0);
-        default:
-          wrongTypes(iType0, iType1);
-        }
-      switch (iType1)
-        {
-          PII_NUMERIC_CASES(op1 = (T)PiiYdin::primitiveAs, obj1);
-        default:
-          wrongTypes(iType0, iType1);
-        }
-      calculate(op0, op1);
+      const PiiTypeDispatcher<T (*)(const PiiVariant&)>& converters = PiiYdin::primitiveConverters<T>();
+      T (*convert0)(const PiiVariant&) = converters[iType0];
+      T (*convert1)(const PiiVariant&) = converters[iType1];
+      if (convert0 == 0 || convert1 == 0)
+        wrongTypes(iType0, iType1);
+      return calculate(convert0(obj0), convert1(obj1));
     }
   else if (iMatrixMask == 1) // First is matrix, second scalar
     {
-      PiiMatrix<T> op0;
-      T op1 = 0;
-      switch (iType0)
-        {
-          PII_NUMERIC_MATRIX_CASES(op0 = (PiiMatrix<T>)PiiYdin::matrixAs, obj0);
-        default:
-          wrongTypes(iType0, iType1);
-        }
-      switch (iType1)
-        {
-          PII_NUMERIC_CASES(op1 = (T)PiiYdin::primitiveAs, obj1);
-        default:
-          wrongTypes(iType0, iType1);
-        }
-      calculate(op0, op1);
+      PiiMatrix<T> (*convert0)(const PiiVariant&) = PiiYdin::matrixConverters<T>()[iType0];
+      T (*convert1)(const PiiVariant&) = PiiYdin::primitiveConverters<T>()[iType1];
+      if (convert0 == 0 || convert1 == 0)
+        wrongTypes(iType0, iType1);
+      return calculate(convert0(obj0), convert1(obj1));
     }
   else if (iMatrixMask == 3) // Both matrices
     {
-      PiiMatrix<T> op0, op1;
-      switch (iType0)
-        {
-          PII_NUMERIC_MATRIX_CASES(op0 = (PiiMatrix<T>)PiiYdin::matrixAs, obj0);
-        default:
-          wrongTypes(iType0, iType1);
-        }
-      switch (iType1)
-        {
-          PII_NUMERIC_MATRIX_CASES(op1 = (PiiMatrix<T>)PiiYdin::matrixAs, obj1);
-        default:
-          wrongTypes(iType0, iType1);
-        }
-      calculate(op0, op1);
+      const PiiTypeDispatcher<PiiMatrix<T> (*)(const PiiVariant&)>& converters = PiiYdin::matrixConverters<T>();
+      PiiMatrix<T> (*convert0)(const PiiVariant&) = converters[iType0];
+      PiiMatrix<T> (*convert1)(const PiiVariant&) = converters[iType1];
+      if (convert0 == 0 || convert1 == 0)
+        wrongTypes(iType0, iType1);
+      return calculate(convert0(obj0), convert1(obj1));
     }
-  else
-    PII_THROW(PiiExecutionException, tr("%1 must be a matrix if %2 is a matrix.").arg("input0").arg("input1"));
+  PII_THROW(PiiExecutionException, tr("%1 must be a matrix if %2 is a matrix.").arg("input0").arg("input1"));
 }
 
-template <class T> void PiiArithmeticOperation::calculate(const PiiMatrix<T>& obj0,
-                                                          const PiiMatrix<T>& obj1)
+template <class T> PiiVariant PiiArithmeticOperation::calculate(const PiiMatrix<T>& obj0,
+                                                                const PiiMatrix<T>& obj1)
 {
+  if (_d()->bSaturated)
+    {
+      PiiVariant varResult(saturatedCalculate(obj0, obj1, Pii::IsSaturable<T>()));
+      if (varResult.isValid())
+        return varResult;
+    }
   try
     {
       switch (_d()->function)
         {
-        case Plus: send(obj0 + obj1); break;
-        case Minus: send(obj0 - obj1); break;
-        case ElementDivision: send(Pii::divided(obj0, obj1)); break;
-        case Division: send(obj0 / obj1); break;
-        case ElementMultiplication: send(Pii::multiplied(obj0, obj1)); break;
-        case Multiplication: send(obj0 * obj1); break;
+        case Plus: return result(obj0 + obj1);
+        case Minus: return result(obj0 - obj1);
+        case ElementDivision: return result(Pii::divided(obj0, obj1));
+        case Division: return result(obj0 / obj1);
+        case ElementMultiplication: return result(Pii::multiplied(obj0, obj1));
+        case Multiplication: return result(obj0 * obj1);
         }
     }
   catch (PiiMathException& ex)
     {
       PII_THROW(PiiExecutionException, ex.message());
     }
+  return PiiVariant();
+}
+
+template <class T> PiiVariant PiiArithmeticOperation::calculate(const PiiMatrix<T>& obj0, T obj1)
+{
+  if (_d()->bSaturated)
+    {
+      PiiVariant varResult(saturatedCalculate(obj0, obj1, Pii::IsSaturable<T>()));
+      if (varResult.isValid())
+        return varResult;
+    }
+  return calculate<PiiMatrix<T>, T>(obj0, obj1);
+}
+
+template <class T> PiiVariant PiiArithmeticOperation::saturatedCalculate(const PiiMatrix<T>& obj0,
+                                                                         const PiiMatrix<T>& obj1,
+                                                                         Pii::True)
+{
+  switch (_d()->function)
+    {
+    case Plus: return result(Pii::saturatingSum(obj0, obj1));
+    case Minus: return result(Pii::saturatingDifference(obj0, obj1));
+    case ElementMultiplication: return result(Pii::saturatingProduct(obj0, obj1));
+    default: break;
+    }
+  return PiiVariant();
+}
+
+template <class T> PiiVariant PiiArithmeticOperation::saturatedCalculate(const PiiMatrix<T>& obj0,
+                                                                         T obj1,
+                                                                         Pii::True)
+{
+  switch (_d()->function)
+    {
+    case Plus: return result(Pii::saturatingSum(obj0, obj1));
+    case Minus: return result(Pii::saturatingDifference(obj0, obj1));
+    case ElementMultiplication:
+    case Multiplication: return result(Pii::saturatingProduct(obj0, obj1));
+    default: break;
+    }
+  return PiiVariant();
+}
+
+template <class T> PiiVariant PiiArithmeticOperation::saturatedCalculate(const PiiMatrix<T>&, const PiiMatrix<T>&, Pii::False)
+{
+  return PiiVariant();
+}
+
+template <class T> PiiVariant PiiArithmeticOperation::saturatedCalculate(const PiiMatrix<T>&, T, Pii::False)
+{
+  return PiiVariant();
 }
 
-template <class T, class U> void PiiArithmeticOperation::calculate(const T& obj0, const U& obj1)
+template <class T, class U> PiiVariant PiiArithmeticOperation::calculate(const T& obj0, const U& obj1)
 {
   switch (_d()->function)
     {
-    case Plus: send(obj0 + obj1); break;
-    case Minus: send(obj0 - obj1); break;
+    case Plus: return result(obj0 + obj1);
+    case Minus: return result(obj0 - obj1);
     case ElementDivision:
-    case Division: send(obj0 / obj1); break;
+    case Division: return result(obj0 / obj1);
     case ElementMultiplication:
-    case Multiplication: send(obj0 * obj1);
+    case Multiplication: return result(obj0 * obj1);
     }
+  return PiiVariant();
 }
@@ -17,6 +17,8 @@
 #define _PIIARITHMETICOPERATION_H
 
 #include <PiiDefaultOperation.h>
+#include <PiiFusibleOperation.h>
+#include <PiiTypeDispatcher.h>
 #include <QPair>
 #include <PiiMatrix.h>
 
@@ -42,10 +44,14 @@
  * is `double`, output type is PiiMatrix<double>. If both types are
  * the same, no type change will be made.
  *
+ * If `input1` is not connected and [constant] is a scalar, the
+ * operation can be fused with other element-wise operations (see
+ * PiiFusibleOperation).
  */
-class PiiArithmeticOperation : public PiiDefaultOperation
+class PiiArithmeticOperation : public PiiDefaultOperation, public PiiFusibleOperation
 {
   Q_OBJECT
+  Q_INTERFACES(PiiFusibleOperation)
 
   /**
    * A constant value for the input1. If input1 is not connected,
@@ -59,6 +65,16 @@ class PiiArithmeticOperation : public PiiDefaultOperation
   Q_PROPERTY(Function function READ function WRITE setFunction);
   Q_ENUMS(Function);
 
+  /**
+   * If `true`, `Plus`, `Minus`, `ElementMultiplication` and
+   * multiplication by a scalar clamp the results to the range of the
+   * type when the result is an 8 or 16 bit integer matrix. Otherwise,
+   * the results wrap around. With saturation, 8 and 16 bit images
+   * can be added, subtracted and scaled without converting them to a
+   * wider type. The default value is `false`.
+   */
+  Q_PROPERTY(bool saturated READ saturated WRITE setSaturated);
+
   PII_OPERATION_SERIALIZATION_FUNCTION
 public:
   PiiArithmeticOperation();
@@ -91,19 +107,41 @@ public:
   Function function() const;
   void setFunction(Function function);
 
+  bool saturated() const;
+  void setSaturated(bool saturated);
+
   void check(bool reset);
 
+  bool isFusible() const;
+  PiiVariant transform(const PiiVariant& obj);
+
 protected:
   void process();
 
 private:
-  template <class T> void calculate(const PiiVariant& obj0, const PiiVariant& obj1);
-  template <class T> void calculate(const PiiMatrix<T>& obj0,
-                                    const PiiMatrix<T>& obj1);
-  template <class T, class U> void calculate(const T& obj0, const U& obj1);
+  typedef PiiVariant (PiiArithmeticOperation::*CalculateFunction)(const PiiVariant&, const PiiVariant&);
+  // Function tables shared by all instances.
+  struct Dispatchers
+  {
+    Dispatchers();
+    // Indexed by the primitive type of the result.
+    PiiTypeDispatcher<CalculateFunction> calculators;
+  };
+  static const Dispatchers& dispatchers();
+
+  PiiVariant apply(const PiiVariant& obj0, const PiiVariant& obj1);
+  template <class T> PiiVariant calculate(const PiiVariant& obj0, const PiiVariant& obj1);
+  template <class T> PiiVariant calculate(const PiiMatrix<T>& obj0,
+                                          const PiiMatrix<T>& obj1);
+  template <class T> PiiVariant calculate(const PiiMatrix<T>& obj0, T obj1);
+  template <class T, class U> PiiVariant calculate(const T& obj0, const U& obj1);
+  template <class T> PiiVariant saturatedCalculate(const PiiMatrix<T>& obj0, const PiiMatrix<T>& obj1, Pii::True);
+  template <class T> PiiVariant saturatedCalculate(const PiiMatrix<T>&, const PiiMatrix<T>&, Pii::False);
+  template <class T> PiiVariant saturatedCalculate(const PiiMatrix<T>& obj0, T obj1, Pii::True);
+  template <class T> PiiVariant saturatedCalculate(const PiiMatrix<T>&, T, Pii::False);
 
   inline void wrongTypes(int type0, int type1);
-  template <class T> inline void send(const T& value);
+  template <class T> static inline PiiVariant result(const T& value);
 
   /// @internal
   class Data : public PiiDefaultOperation::Data
@@ -116,6 +154,7 @@ private:
     PiiVariant pConstant;
     bool bInput1Connected;
     Function function;
+    bool bSaturated;
   };
   PII_D_FUNC;
 };
@@ -42,21 +42,27 @@ void PiiComparisonOperation::check(bool reset)
   d->bInput1Connected = d->pInput1->isConnected();
 }
 
+bool PiiComparisonOperation::isFusible() const
+{
+  return !_d()->bInput1Connected;
+}
+
 void PiiComparisonOperation::process()
 {
-  PII_D;
-  PiiVariant obj = d->pInput0->firstObject();
+  emitObject(transform(_d()->pInput0->firstObject()));
+}
 
+PiiVariant PiiComparisonOperation::transform(const PiiVariant& obj)
+{
   switch (obj.type())
     {
-      PII_NUMERIC_MATRIX_CASES(operateMatrix, obj);
-      PII_NUMERIC_CASES(operateNumber, obj);
-    default:
-      PII_THROW_UNKNOWN_TYPE(d->pInput0);
+      PII_NUMERIC_MATRIX_CASES(return operateMatrix, obj);
+      PII_NUMERIC_CASES(return operateNumber, obj);
     }
+  PII_THROW_UNKNOWN_TYPE(_d()->pInput0);
 }
 
-template <class T> void PiiComparisonOperation::operateMatrix(const PiiVariant& obj)
+template <class T> PiiVariant PiiComparisonOperation::operateMatrix(const PiiVariant& obj)
 {
   PII_D;
   if (d->bInput1Connected)
@@ -64,27 +70,25 @@ template <class T> void PiiComparisonOperation::operateMatrix(const PiiVariant&
       PiiVariant obj2 = d->pInput1->firstObject();
       switch (obj2.type())
         {
-          PII_NUMERIC_CASES_M(operateMatrixNumber, (obj.valueAs<PiiMatrix<T> >(), obj2));
-          PII_NUMERIC_MATRIX_CASES_M(operateMatrixMatrix, (obj.valueAs<PiiMatrix<T> >(), obj2));
-        default:
-          PII_THROW_UNKNOWN_TYPE(d->pInput1);
+          PII_NUMERIC_CASES_M(return operateMatrixNumber, (obj.valueAs<PiiMatrix<T> >(), obj2));
+          PII_NUMERIC_MATRIX_CASES_M(return operateMatrixMatrix, (obj.valueAs<PiiMatrix<T> >(), obj2));
         }
+      PII_THROW_UNKNOWN_TYPE(d->pInput1);
     }
-  else
-    compare(obj.valueAs<PiiMatrix<T> >(), (T)d->dConstant);
+  return compare(obj.valueAs<PiiMatrix<T> >(), (T)d->dConstant);
 }
 
-template <class T, class U> void PiiComparisonOperation::operateMatrixNumber(const PiiMatrix<U>& matrix, const PiiVariant& obj)
+template <class T, class U> PiiVariant PiiComparisonOperation::operateMatrixNumber(const PiiMatrix<U>& matrix, const PiiVariant& obj)
 {
-  compare(matrix, (U)obj.valueAs<T>());
+  return compare(matrix, (U)obj.valueAs<T>());
 }
 
-template <class T, class U> void PiiComparisonOperation::operateMatrixMatrix(const PiiMatrix<U>& matrix, const PiiVariant& obj)
+template <class T, class U> PiiVariant PiiComparisonOperation::operateMatrixMatrix(const PiiMatrix<U>& matrix, const PiiVariant& obj)
 {
-  compare(matrix, PiiMatrix<U>(obj.valueAs<PiiMatrix<T> >()));
+  return compare(matrix, PiiMatrix<U>(obj.valueAs<PiiMatrix<T> >()));
 }
 
-template <class T> void PiiComparisonOperation::operateNumber(const PiiVariant& obj)
+template <class T> PiiVariant PiiComparisonOperation::operateNumber(const PiiVariant& obj)
 {
   PII_D;
   if (d->bInput1Connected)
@@ -92,41 +96,34 @@ template <class T> void PiiComparisonOperation::operateNumber(const PiiVariant&
       PiiVariant obj2 = d->pInput1->firstObject();
       switch (obj2.type())
         {
-          PII_NUMERIC_CASES_M(operateNumberNumber, (obj.valueAs<T>(), obj2));
-        default:
-          PII_THROW_UNKNOWN_TYPE(d->pInput1);
+          PII_NUMERIC_CASES_M(return operateNumberNumber, (obj.valueAs<T>(), obj2));
         }
+      PII_THROW_UNKNOWN_TYPE(d->pInput1);
     }
-  else
-    compare(obj.valueAs<T>(), (T)d->dConstant);
+  return compare(obj.valueAs<T>(), (T)d->dConstant);
 }
 
-template <class T, class U> void PiiComparisonOperation::operateNumberNumber(U number, const PiiVariant& obj)
+template <class T, class U> PiiVariant PiiComparisonOperation::operateNumberNumber(U number, const PiiVariant& obj)
 {
-  compare(number, (U)obj.valueAs<T>());
+  return compare(number, (U)obj.valueAs<T>());
 }
 
-template <class T, class U> void PiiComparisonOperation::compare(const T& op1, const U& op2)
+template <class T, class U> PiiVariant PiiComparisonOperation::compare(const T& op1, const U& op2)
 {
   try
     {
       switch (_d()->function)
         {
         case Equal:
-          emitObject(op1 == op2);
-          break;
+          return PiiYdin::createVariant(op1 == op2);
         case LessThan:
-          emitObject(op1 < op2);
-          break;
+          return PiiYdin::createVariant(op1 < op2);
         case GreaterThan:
-          emitObject(op1 > op2);
-          break;
+          return PiiYdin::createVariant(op1 > op2);
         case LessEqual:
-          emitObject(op1 <= op2);
-          break;
+          return PiiYdin::createVariant(op1 <= op2);
         case GreaterEqual:
-          emitObject(op1 >= op2);
-          break;
+          return PiiYdin::createVariant(op1 >= op2);
         default:
           PII_THROW(PiiExecutionException, tr("Unknown comparison function."));
         }
@@ -135,6 +132,7 @@ template <class T, class U> void PiiComparisonOperation::compare(const T& op1, c
     {
       PII_THROW(PiiExecutionException, ex.message());
     }
+  return PiiVariant();
 }
 
 void PiiComparisonOperation::setConstant(double constant) { _d()->dConstant = constant; }
@@ -17,6 +17,7 @@
 #define _PIICOMPARISONOPERATION_H
 
 #include <PiiDefaultOperation.h>
+#include <PiiFusibleOperation.h>
 #include <QPair>
 #include <PiiMatrix.h>
 
@@ -42,10 +43,13 @@
  *
  * @out output - The comparison result, bool or PiiMatrix<bool>.
  *
+ * If `input1` is not connected, the operation can be fused with
+ * other element-wise operations (see PiiFusibleOperation).
  */
-class PiiComparisonOperation : public PiiDefaultOperation
+class PiiComparisonOperation : public PiiDefaultOperation, public PiiFusibleOperation
 {
   Q_OBJECT
+  Q_INTERFACES(PiiFusibleOperation)
 
   /**
    * A constant value that is used instead of `input1` if it is not
@@ -80,6 +84,9 @@ public:
 
   void check(bool reset);
 
+  bool isFusible() const;
+  PiiVariant transform(const PiiVariant& obj);
+
 protected:
   void process();
 
@@ -96,12 +103,12 @@ private:
   };
   PII_D_FUNC;
 
-  template <class T> void operateMatrix(const PiiVariant& obj);
-  template <class T, class U> void operateMatrixNumber(const PiiMatrix<U>& matrix,const PiiVariant& obj);
-  template <class T, class U> void operateMatrixMatrix(const PiiMatrix<U>& matrix,const PiiVariant& obj);
-  template <class T> void operateNumber(const PiiVariant& obj);
-  template <class T, class U> void operateNumberNumber(U number, const PiiVariant& obj);
-  template <class T, class U> void compare(const T& op1, const U& op2);
+  template <class T> PiiVariant operateMatrix(const PiiVariant& obj);
+  template <class T, class U> PiiVariant operateMatrixNumber(const PiiMatrix<U>& matrix,const PiiVariant& obj);
+  template <class T, class U> PiiVariant operateMatrixMatrix(const PiiMatrix<U>& matrix,const PiiVariant& obj);
+  template <class T> PiiVariant operateNumber(const PiiVariant& obj);
+  template <class T, class U> PiiVariant operateNumberNumber(U number, const PiiVariant& obj);
+  template <class T, class U> PiiVariant compare(const T& op1, const U& op2);
 };
 
 
@@ -16,13 +16,118 @@
 #include "PiiFileSystemScanner.h"
 
 #include <PiiYdinTypes.h>
+#include <PiiThreadPool.h>
+#include <QDirIterator>
+#include <QDateTime>
+#include <QDataStream>
+#include <QFile>
+
+static const quint32 iIndexMagic = 0x50494653; // "PIFS"
+static const qint32 iIndexVersion = 1;
+
+struct PiiFileSystemScanner::Listing
+{
+  Listing(const Data* d, const QString& path, int maxDepth) :
+    strPath(path),
+    iMaxDepth(maxDepth),
+    lstNameFilters(d->lstNameFilters),
+    iFilters(d->iFilters),
+    iSortFlags(d->iSortFlags),
+    bTimes(!d->strIndexFile.isEmpty())
+  {}
+
+  QDir::Filters entryFilters() const
+  {
+    // If we have subfolders to scan, include all folders in search
+    if (iMaxDepth > 1)
+      return QDir::Filter((iFilters | QDir::AllDirs | QDir::NoDotAndDotDot) & ~QDir::Dirs);
+    return QDir::Filter(iFilters);
+  }
+
+  void list()
+  {
+    QFileInfoList lstInfos(QDir(strPath).entryInfoList(lstNameFilters, entryFilters(),
+                                                       QDir::SortFlag(iSortFlags)));
+    for (int i=0; i<lstInfos.size(); ++i)
+      add(lstInfos[i]);
+  }
+
+  void add(const QFileInfo& info)
+  {
+    QString strFullPath = strPath + '/' + info.fileName();
+    if (iMaxDepth > 1 && info.isDir())
+      {
+        // Directories need to be scanned
+        lstFolders << qMakePair(strFullPath, iMaxDepth-1);
+        // If all directories are to be listed, add this one to
+        // matched files as well.
+        if (iFilters & QDir::AllDirs)
+          addFile(strFullPath, info);
+        // If only matching directories are to be returned.
+        else if ((iFilters & QDir::Dirs) &&
+                 (lstNameFilters.isEmpty() || QDir::match(lstNameFilters, info.fileName())))
+          addFile(strFullPath, info);
+      }
+    else // normal file
+      addFile(strFullPath, info);
+  }
+
+  void addFile(const QString& fullPath, const QFileInfo& info)
+  {
+    lstFiles << fullPath;
+    if (bTimes)
+      lstTimes << info.lastModified().toMSecsSinceEpoch();
+  }
+
+  void clearResults()
+  {
+    lstFolders.clear();
+    lstFiles.clear();
+    lstTimes.clear();
+  }
+
+  QString strPath;
+  int iMaxDepth;
+  QStringList lstNameFilters;
+  int iFilters, iSortFlags;
+  bool bTimes;
+
+  PathList lstFolders;
+  QStringList lstFiles;
+  QList<qint64> lstTimes;
+};
+
+class PiiFileSystemScanner::ScanTask : public PiiThreadPool::Task
+{
+public:
+  ScanTask(Data* data, const QString& path, int maxDepth) :
+    d(data), listing(data, path, maxDepth), bDone(false)
+  {}
+
+  void run()
+  {
+    listing.list();
+    QMutexLocker lock(&d->scanMutex);
+    bDone = true;
+    d->scanCondition.wakeAll();
+  }
+
+  Data* d;
+  Listing listing;
+  bool bDone;
+};
 
 PiiFileSystemScanner::Data::Data() :
   iMaxDepth(1),
   iSortFlags(Unsorted),
   iFilters(Readable | Files),
   iRepeatCount(-1),
-  iLoopIndex(0)
+  iScanThreadCount(0),
+  iLoopIndex(0),
+  pCurrentListing(0),
+  pDirIterator(0),
+  pScanPool(0),
+  bIndexChanged(false)
 {
 }
 
@@ -37,22 +142,51 @@ PiiFileSystemScanner::PiiFileSystemScanner() :
   d->pPathInput->setOptional(true);
 
   addSocket(new PiiOutputSocket("filename"));
+
+  setProtectionLevel("scanThreadCount", WriteWhenStoppedOrPaused);
+  setProtectionLevel("indexFile", WriteWhenStopped);
+}
+
+PiiFileSystemScanner::~PiiFileSystemScanner()
+{
+  PII_D;
+  clearScanQueue();
+  delete d->pScanPool;
 }
 
 void PiiFileSystemScanner::check(bool reset)
 {
+  PII_D;
   PiiDefaultOperation::check(reset);
 
+  if (d->iScanThreadCount > 0)
+    {
+      if (d->pScanPool == 0)
+        d->pScanPool = new PiiThreadPool(d->iScanThreadCount);
+      else
+        d->pScanPool->setThreadCount(d->iScanThreadCount);
+    }
+
   if (reset)
     {
+      loadIndex();
       resetPaths();
-      _d()->iLoopIndex = 0;
+      if (!d->pPathInput->isConnected() && !findAtLeastOneFile())
+        PII_THROW(PiiExecutionException, tr("Cannot find any matching files with the given set of filters."));
+      d->iLoopIndex = 0;
     }
- }
+}
+
+void PiiFileSystemScanner::aboutToChangeState(State state)
+{
+  if (state == Stopped)
+    saveIndex();
+}
 
 void PiiFileSystemScanner::resetPaths()
 {
   PII_D;
+  clearScanQueue();
   if (d->lstPaths.isEmpty())
     d->lstPathsToScan = PathList() << qMakePair(QString("."), d->iMaxDepth);
   else
@@ -62,8 +196,7 @@ void PiiFileSystemScanner::resetPaths()
         d->lstPathsToScan << qMakePair(d->lstPaths[i], d->iMaxDepth);
     }
   d->lstCollectedFiles.clear();
-  if (!d->pPathInput->isConnected() && !findAtLeastOneFile())
-    PII_THROW(PiiExecutionException, tr("Cannot find any matching files with the given set of filters."));
+  d->lstCollectedTimes.clear();
 }
 
 void PiiFileSystemScanner::process()
@@ -72,26 +205,40 @@ void PiiFileSystemScanner::process()
   if (d->pPathInput->isConnected())
     {
       startMany();
-      scanFolder(PiiYdin::convertToQString(d->pPathInput), d->iMaxDepth);
-      for (int i=0; i<d->lstCollectedFiles.size(); ++i)
-        emitObject(d->lstCollectedFiles[i]);
+      clearScanQueue();
+      d->lstPathsToScan = PathList() << qMakePair(PiiYdin::convertToQString(d->pPathInput), d->iMaxDepth);
+      d->lstCollectedFiles.clear();
+      d->lstCollectedTimes.clear();
+      // Emit the files as soon as they are found.
+      while (findAtLeastOneFile())
+        emitNextFile();
       endMany();
     }
   else
     {
-      emitObject(d->lstCollectedFiles.takeFirst());
+      emitNextFile();
 
       // If no more files exist...
       if (d->lstCollectedFiles.isEmpty() &&
           !findAtLeastOneFile())
         {
+          saveIndex();
           // If we are done iterating, stop spontaneously.
           if (!d->pTriggerInput->isConnected() &&
               d->iRepeatCount > 0 &&
               ++d->iLoopIndex >= d->iRepeatCount)
             operationStopped();
           else
-            resetPaths();
+            {
+              resetPaths();
+              if (!findAtLeastOneFile())
+                {
+                  // With an index, there may just be no new files.
+                  if (!d->strIndexFile.isEmpty())
+                    operationStopped();
+                  PII_THROW(PiiExecutionException, tr("Cannot find any matching files with the given set of filters."));
+                }
+            }
         }
     }
 }
@@ -99,78 +246,202 @@ void PiiFileSystemScanner::process()
 bool PiiFileSystemScanner::findAtLeastOneFile()
 {
   PII_D;
-  // Scan folders until at least one matching file is found or the
-  // folder list becomes empty.
-  while (d->lstCollectedFiles.isEmpty() && !d->lstPathsToScan.isEmpty())
+  // Scan folders until at least one matching file is found or there
+  // are no more folders to scan.
+  while (d->lstCollectedFiles.isEmpty())
     {
-      QPair<QString,int> pathPair(d->lstPathsToScan.takeFirst());
-      scanFolder(pathPair.first, pathPair.second, d->lstPathsToScan, d->lstCollectedFiles);
+      if (d->pDirIterator != 0)
+        readCurrentFolder();
+      else if (!d->queTasks.isEmpty())
+        {
+          // Keep the scanners busy before blocking on the oldest
+          // folder.
+          scheduleScans();
+          ScanTask* pTask = d->queTasks.dequeue();
+          d->scanMutex.lock();
+          while (!pTask->bDone)
+            d->scanCondition.wait(&d->scanMutex);
+          d->scanMutex.unlock();
+          collect(pTask->listing);
+          delete pTask;
+        }
+      else if (!d->lstPathsToScan.isEmpty())
+        {
+          QPair<QString,int> pathPair(d->lstPathsToScan.takeFirst());
+          Listing* pListing = new Listing(d, pathPair.first, pathPair.second);
+          // Without sorting, entries can be collected as they are
+          // read.
+          if ((d->iSortFlags & QDir::SortByMask) == QDir::Unsorted)
+            {
+              d->pCurrentListing = pListing;
+              d->pDirIterator = new QDirIterator(pListing->strPath, pListing->lstNameFilters,
+                                                 pListing->entryFilters());
+            }
+          else
+            {
+              pListing->list();
+              collect(*pListing);
+              delete pListing;
+            }
+          scheduleScans();
+        }
+      else
+        return false;
     }
-  return !d->lstCollectedFiles.isEmpty();
+  return true;
 }
 
-void PiiFileSystemScanner::scanFolder(const QString& path, int maxDepth)
+void PiiFileSystemScanner::readCurrentFolder()
 {
   PII_D;
-  d->lstPathsToScan.clear();
-  d->lstCollectedFiles.clear();
-  d->lstPathsToScan << qMakePair(path, maxDepth);
+  Listing* pListing = d->pCurrentListing;
+  while (d->pDirIterator->hasNext() && pListing->lstFiles.isEmpty())
+    {
+      d->pDirIterator->next();
+      pListing->add(d->pDirIterator->fileInfo());
+    }
+  const bool bNewFolders = !pListing->lstFolders.isEmpty();
+  collect(*pListing);
+  pListing->clearResults();
 
-  // Breadth first search
-  while (!d->lstPathsToScan.isEmpty())
+  if (!d->pDirIterator->hasNext())
+    {
+      delete d->pDirIterator;
+      delete pListing;
+      d->pDirIterator = 0;
+      d->pCurrentListing = 0;
+    }
+  if (bNewFolders)
+    scheduleScans();
+}
+
+void PiiFileSystemScanner::scheduleScans()
+{
+  PII_D;
+  if (d->iScanThreadCount <= 0 || d->pScanPool == 0)
+    return;
+  // Folders listed in advance are taken from the head of the queue,
+  // which retains the breadth-first order.
+  while (d->queTasks.size() < d->iScanThreadCount && !d->lstPathsToScan.isEmpty())
     {
       QPair<QString,int> pathPair(d->lstPathsToScan.takeFirst());
-      scanFolder(pathPair.first, pathPair.second, d->lstPathsToScan, d->lstCollectedFiles);
+      ScanTask* pTask = new ScanTask(d, pathPair.first, pathPair.second);
+      d->queTasks.enqueue(pTask);
+      d->pScanPool->submit(pTask);
     }
 }
 
-void PiiFileSystemScanner::scanFolder(const QString& path, int maxDepth,
-                                      PathList& paths, QStringList& files)
+void PiiFileSystemScanner::collect(Listing& listing)
 {
   PII_D;
-  if (maxDepth > 1)
-    {
-      // If we have subfolders to scan, include all folders in search
-      QFileInfoList lstInfos(QDir(path).entryInfoList(d->lstNameFilters,
-                                                      QDir::Filter((d->iFilters |
-                                                                    QDir::AllDirs |
-                                                                    QDir::NoDotAndDotDot) &
-                                                                   ~QDir::Dirs),
-                                                      QDir::SortFlag(d->iSortFlags)));
-      for (int i=0; i<lstInfos.size(); ++i)
+  d->lstPathsToScan << listing.lstFolders;
+  if (!listing.bTimes)
+    {
+      d->lstCollectedFiles << listing.lstFiles;
+      return;
+    }
+  // Skip files whose modification time is already in the index.
+  for (int i=0; i<listing.lstFiles.size(); ++i)
+    {
+      QHash<QString,qint64>::const_iterator it = d->hashIndex.constFind(listing.lstFiles[i]);
+      if (it == d->hashIndex.constEnd() || it.value() != listing.lstTimes[i])
         {
-          QString strFullPath = path + '/' + lstInfos[i].fileName();
-          if (lstInfos[i].isDir())
-            {
-              // Directories need to be scanned
-              paths << qMakePair(strFullPath, maxDepth-1);
-              // If all directories are to be listed, add this one to
-              // matched files as well.
-              if (d->iFilters & QDir::AllDirs)
-                files << strFullPath;
-              // If only matching directories are to be returned.
-              else if (d->iFilters & QDir::Dirs)
-                {
-                  QRegExp wildcard;
-                  wildcard.setPatternSyntax(QRegExp::Wildcard);
-                  for (int j=0; j<d->lstNameFilters.size(); ++j)
-                    if (wildcard.exactMatch(lstInfos[i].fileName()))
-                      {
-                        files << strFullPath;
-                        break;
-                      }
-                }
-            }
-          else // normal file
-            files << strFullPath;
+          d->lstCollectedFiles << listing.lstFiles[i];
+          d->lstCollectedTimes << listing.lstTimes[i];
         }
     }
-  else
+}
+
+void PiiFileSystemScanner::emitNextFile()
+{
+  PII_D;
+  QString strFileName(d->lstCollectedFiles.takeFirst());
+  // Files are indexed only after they have been emitted.
+  if (!d->strIndexFile.isEmpty())
     {
-      QStringList lstFiles(QDir(path).entryList(d->lstNameFilters, QDir::Filter(d->iFilters), QDir::SortFlag(d->iSortFlags)));
-      for (int i=0; i<lstFiles.size(); ++i)
-        files << path + '/' + lstFiles[i];
+      d->hashIndex.insert(strFileName, d->lstCollectedTimes.takeFirst());
+      d->bIndexChanged = true;
     }
+  emitObject(strFileName);
+}
+
+void PiiFileSystemScanner::clearScanQueue()
+{
+  PII_D;
+  delete d->pDirIterator;
+  delete d->pCurrentListing;
+  d->pDirIterator = 0;
+  d->pCurrentListing = 0;
+
+  // Tasks refer to the operation's data; wait until all of them are
+  // done before deleting.
+  QMutexLocker lock(&d->scanMutex);
+  while (!d->queTasks.isEmpty())
+    {
+      ScanTask* pTask = d->queTasks.dequeue();
+      while (!pTask->bDone)
+        d->scanCondition.wait(&d->scanMutex);
+      delete pTask;
+    }
+}
+
+void PiiFileSystemScanner::loadIndex()
+{
+  PII_D;
+  d->hashIndex.clear();
+  d->bIndexChanged = false;
+  if (d->strIndexFile.isEmpty())
+    return;
+
+  QFile file(d->strIndexFile);
+  // No index yet. Everything is new.
+  if (!file.exists())
+    return;
+  if (!file.open(QIODevice::ReadOnly))
+    PII_THROW(PiiExecutionException, tr("Cannot open index file %1.").arg(d->strIndexFile));
+  QDataStream stream(&file);
+  quint32 iMagic = 0;
+  qint32 iVersion = 0;
+  stream >> iMagic >> iVersion;
+  if (iMagic != iIndexMagic || iVersion != iIndexVersion)
+    PII_THROW(PiiExecutionException, tr("%1 is not a valid index file.").arg(d->strIndexFile));
+  stream >> d->hashIndex;
+  if (stream.status() != QDataStream::Ok)
+    {
+      d->hashIndex.clear();
+      PII_THROW(PiiExecutionException, tr("Index file %1 is corrupted.").arg(d->strIndexFile));
+    }
+}
+
+void PiiFileSystemScanner::saveIndex()
+{
+  PII_D;
+  if (d->strIndexFile.isEmpty() || !d->bIndexChanged)
+    return;
+
+  // Write to a temporary file first so that an interrupted write
+  // doesn't destroy the old index.
+  QString strTempFile(d->strIndexFile + ".tmp");
+  QFile file(strTempFile);
+  if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate))
+    {
+      piiWarning(tr("Cannot write index file %1.").arg(strTempFile));
+      return;
+    }
+  QDataStream stream(&file);
+  stream << iIndexMagic << iIndexVersion << d->hashIndex;
+  file.close();
+  if (stream.status() != QDataStream::Ok)
+    {
+      piiWarning(tr("Cannot write index file %1.").arg(strTempFile));
+      QFile::remove(strTempFile);
+      return;
+    }
+  QFile::remove(d->strIndexFile);
+  if (!QFile::rename(strTempFile, d->strIndexFile))
+    piiWarning(tr("Cannot replace index file %1.").arg(d->strIndexFile));
+  else
+    d->bIndexChanged = false;
 }
 
 void PiiFileSystemScanner::setPaths(const QStringList& paths) { _d()->lstPaths = paths; }
@@ -185,3 +456,7 @@ void PiiFileSystemScanner::setNameFilters(const QStringList& nameFilters) { _d()
 QStringList PiiFileSystemScanner::nameFilters() const { return _d()->lstNameFilters; }
 void PiiFileSystemScanner::setRepeatCount(int repeatCount) { _d()->iRepeatCount = repeatCount; }
 int PiiFileSystemScanner::repeatCount() const { return _d()->iRepeatCount; }
+void PiiFileSystemScanner::setScanThreadCount(int scanThreadCount) { _d()->iScanThreadCount = scanThreadCount; }
+int PiiFileSystemScanner::scanThreadCount() const { return _d()->iScanThreadCount; }
+void PiiFileSystemScanner::setIndexFile(const QString& indexFile) { _d()->strIndexFile = indexFile; }
+QString PiiFileSystemScanner::indexFile() const { return _d()->strIndexFile; }
@@ -18,6 +18,12 @@
 
 #include <PiiDefaultOperation.h>
 #include <QDir>
+#include <QQueue>
+#include <QMutex>
+#include <QWaitCondition>
+
+class PiiThreadPool;
+class QDirIterator;
 
 /**
  * Scans directory hierarchies finding files that match filters. This
@@ -43,6 +49,26 @@
  *
  * @out filename - a full path name of a matched file.
  *
+ * Scanning
+ * --------
+ *
+ * Directories are scanned breadth first, and file names are emitted
+ * as soon as they are found. If [sortFlags] is `Unsorted` or
+ * `NoSort`, the entries of a directory are read one by one, and the
+ * first file name can be emitted before the rest of the directory
+ * has been read. Sorting requires the whole directory to be read
+ * first.
+ *
+ * If [scanThreadCount] is positive, upcoming subdirectories are
+ * listed in advance in a private pool of threads while the operation
+ * is emitting file names. This helps with slow or remote file
+ * systems. The emission order is not affected.
+ *
+ * If [indexFile] is set, the modification times of emitted files are
+ * stored into the index, and only new or modified files will be
+ * emitted. The index is loaded when the operation is started and
+ * saved once all paths have been scanned and when the operation
+ * stops.
  */
 class PiiFileSystemScanner : public PiiDefaultOperation
 {
@@ -92,6 +118,26 @@ class PiiFileSystemScanner : public PiiDefaultOperation
    */
   Q_PROPERTY(int repeatCount READ repeatCount WRITE setRepeatCount);
 
+  /**
+   * The number of threads used for listing subdirectories in
+   * advance. Since listing is usually limited by I/O latency, the
+   * number may well exceed the number of processor cores. Each thread
+   * reads one directory at a time. Zero disables parallel scanning.
+   * The default is zero.
+   */
+  Q_PROPERTY(int scanThreadCount READ scanThreadCount WRITE setScanThreadCount);
+
+  /**
+   * The name of a file that stores the modification times of files
+   * that have already been emitted. If this property is set, a file
+   * will be emitted only if it is not in the index or has been
+   * modified after it was indexed. If there are no new files when the
+   * operation is started, an exception will be thrown. If a repeated
+   * scan (see [repeatCount]) finds no new files, the operation stops.
+   * An empty string disables indexing, which is the default.
+   */
+  Q_PROPERTY(QString indexFile READ indexFile WRITE setIndexFile);
+
   Q_FLAGS(SortFlags);
   Q_FLAGS(Filters);
 
@@ -143,11 +189,16 @@ public:
   Q_DECLARE_FLAGS(Filters, Filter);
 
   PiiFileSystemScanner();
+  ~PiiFileSystemScanner();
 
   void check(bool reset);
 
 protected:
   void process();
+  /**
+   * Saves the index if *state* is `Stopped`.
+   */
+  void aboutToChangeState(State state);
 
   void setPaths(const QStringList& paths);
   QStringList paths() const;
@@ -161,9 +212,16 @@ protected:
   QStringList nameFilters() const;
   void setRepeatCount(int repeatCount);
   int repeatCount() const;
+  void setScanThreadCount(int scanThreadCount);
+  int scanThreadCount() const;
+  void setIndexFile(const QString& indexFile);
+  QString indexFile() const;
 
 private:
   typedef QList<QPair<QString,int> > PathList;
+  struct Listing;
+  class ScanTask;
+
   /// @internal
   class Data : public PiiDefaultOperation::Data
   {
@@ -177,16 +235,36 @@ private:
     int iFilters;
     QStringList lstNameFilters;
     int iRepeatCount;
+    int iScanThreadCount;
+    QString strIndexFile;
+    // Folders that haven't been scheduled for scanning yet
     PathList lstPathsToScan;
     QStringList lstCollectedFiles;
+    QList<qint64> lstCollectedTimes;
     int iLoopIndex;
+    // The folder that is currently being read entry by entry
+    Listing* pCurrentListing;
+    QDirIterator* pDirIterator;
+    // Folders listed in advance, in scanning order
+    PiiThreadPool* pScanPool;
+    QQueue<ScanTask*> queTasks;
+    QMutex scanMutex;
+    QWaitCondition scanCondition;
+    // File name -> modification time (ms since epoch)
+    QHash<QString,qint64> hashIndex;
+    bool bIndexChanged;
   };
   PII_D_FUNC;
 
   void resetPaths();
   bool findAtLeastOneFile();
-  void scanFolder(const QString& path, int maxDepth);
-  void scanFolder(const QString& path, int maxDepth, PathList& paths, QStringList& files);
+  void readCurrentFolder();
+  void scheduleScans();
+  void collect(Listing& listing);
+  void emitNextFile();
+  void clearScanQueue();
+  void loadIndex();
+  void saveIndex();
 };
 
 Q_DECLARE_OPERATORS_FOR_FLAGS(PiiFileSystemScanner::SortFlags);
@@ -18,10 +18,21 @@
 #include <QtDebug>
 #include <QTimer>
 #include <QDirIterator>
+#include <QSocketNotifier>
 
+#if defined(Q_OS_LINUX)
+#  define PII_WATCHER_INOTIFY
+#  include <sys/inotify.h>
+#  include <unistd.h>
+#  include <errno.h>
+#endif
 
 PiiFileSystemWatcher::Data::Data() :
-  iWatchDelay(0)
+  iWatchDelay(0),
+  bRecursive(false),
+  bWaitForClose(false),
+  iNativeDescriptor(-1),
+  pNativeNotifier(0)
 {
 }
 
@@ -33,6 +44,14 @@ PiiFileSystemWatcher::PiiFileSystemWatcher() :
 
   //connect signal for notifying changes
   connect(&d->fileSystemWatcher, SIGNAL(directoryChanged(const QString&)), this, SLOT(directoryChanged(const QString&)));
+
+  setProtectionLevel("recursive", WriteWhenStopped);
+  setProtectionLevel("waitForClose", WriteWhenStopped);
+}
+
+PiiFileSystemWatcher::~PiiFileSystemWatcher()
+{
+  stopWatching();
 }
 
 void PiiFileSystemWatcher::check(bool reset)
@@ -43,56 +62,113 @@ void PiiFileSystemWatcher::check(bool reset)
   if (d->lstDirectories.size() == 0)
     PII_THROW(PiiExecutionException, tr("Cannot start without watched directories."));
 
+  d->lstNameFilterExps.clear();
+  for (int i=0; i<d->lstNameFilters.size(); ++i)
+    d->lstNameFilterExps << QRegExp(d->lstNameFilters[i],
+#ifdef Q_OS_WIN
+                                    Qt::CaseInsensitive,
+#else
+                                    Qt::CaseSensitive,
+#endif
+                                    QRegExp::Wildcard);
+
+  stopWatching();
+  d->lstModifiedFiles.clear();
+
+#ifdef PII_WATCHER_INOTIFY
+  if (startNativeWatch())
+    return;
+  piiWarning(tr("Cannot initialize inotify. Falling back to QFileSystemWatcher."));
+#endif
+
+  // Set previous check time for all directories
+  QDateTime currentTime = QDateTime::currentDateTime();
+  for (int i=0; i<d->lstDirectories.size(); ++i)
+    watchDirectories(d->lstDirectories[i], currentTime, d->bRecursive);
+}
+
+void PiiFileSystemWatcher::stopWatching()
+{
+  PII_D;
   // This unnecessary check suppresses a bogus warning from Qt.
   if (!d->fileSystemWatcher.directories().isEmpty())
     // remove old paths
     d->fileSystemWatcher.removePaths(d->fileSystemWatcher.directories());
+  d->hashDirectoryStates.clear();
 
-  //set new paths for watching
-  d->fileSystemWatcher.addPaths(d->lstDirectories);
+  delete d->pNativeNotifier;
+  d->pNativeNotifier = 0;
+#ifdef PII_WATCHER_INOTIFY
+  if (d->iNativeDescriptor != -1)
+    ::close(d->iNativeDescriptor);
+#endif
+  d->iNativeDescriptor = -1;
+  d->hashNativeWatches.clear();
+}
 
-  // Set previous check time for all directories
-  QDateTime currentTime = QDateTime::currentDateTime();
-  d->lstPreviousCheckTimes.clear();
-  d->lstLastModifiedFiles.clear();
-  for (int i=0; i<d->lstDirectories.size(); ++i)
+void PiiFileSystemWatcher::watchDirectories(const QString& path, const QDateTime& checkTime, bool recursive)
+{
+  PII_D;
+  QStringList lstPaths(path);
+  if (recursive)
     {
-      d->lstPreviousCheckTimes << currentTime;
-      d->lstLastModifiedFiles << QStringList();
+      QDirIterator iterator(path, QDir::Dirs | QDir::NoDotAndDotDot, QDirIterator::Subdirectories);
+      while (iterator.hasNext())
+        lstPaths << iterator.next();
     }
 
-  d->lstModifiedFiles.clear();
+  for (int i=0; i<lstPaths.size(); ++i)
+    {
+      DirectoryState state;
+      state.previousCheckTime = checkTime;
+      d->hashDirectoryStates.insert(directoryKey(lstPaths[i]), state);
+    }
+  d->fileSystemWatcher.addPaths(lstPaths);
 }
 
-int PiiFileSystemWatcher::indexOf(const QStringList& paths, const QString& path)
+QString PiiFileSystemWatcher::directoryKey(const QString& path)
 {
   // Must be case-insensitive on Windows
 #ifdef Q_OS_WIN
-  QString strPath = path.toLower();
-  for (int i=0; i<paths.size(); ++i)
-    if (paths[i].toLower() == strPath)
-      return i;
-  return -1;
+  return path.toLower();
 #else
-  return paths.indexOf(path);
+  return path;
 #endif
 }
 
+bool PiiFileSystemWatcher::matchesNameFilters(const QString& fileName) const
+{
+  const PII_D;
+  if (d->lstNameFilterExps.isEmpty())
+    return true;
+  for (int i=0; i<d->lstNameFilterExps.size(); ++i)
+    if (d->lstNameFilterExps[i].exactMatch(fileName))
+      return true;
+  return false;
+}
+
+void PiiFileSystemWatcher::addModifiedFile(const QString& fileName)
+{
+  PII_D;
+  if (!d->lstModifiedFiles.contains(fileName))
+    d->lstModifiedFiles << fileName;
+}
+
 void PiiFileSystemWatcher::directoryChanged(const QString& path)
 {
   PII_D;
   //qDebug("directoryChanged()");
-  // Find the index of the path in our path list.
-  int iPathIndex = indexOf(d->lstDirectories, path);
+  QHash<QString,DirectoryState>::iterator it = d->hashDirectoryStates.find(directoryKey(path));
 
   // Not on our watch list.
-  if (iPathIndex == -1)
+  if (it == d->hashDirectoryStates.end())
     return;
 
+  DirectoryState& state = it.value();
   // Take the last check time of the directory.
-  QDateTime previousCheckTime = d->lstPreviousCheckTimes[iPathIndex];
+  QDateTime previousCheckTime = state.previousCheckTime;
 
-  //qDebug() << "path index" << iPathIndex << "previous check time:" << previousCheckTime;
+  //qDebug() << "path" << path << "previous check time:" << previousCheckTime;
 
   // Iterate over all files in the directory
   QDirIterator iterator(path, d->lstNameFilters, QDir::Files);
@@ -132,19 +208,19 @@ void PiiFileSystemWatcher::directoryChanged(const QString& path)
               // If it was changed exactly at the time of the last
               // check, it may have been missed...
               else if (lastModified == previousCheckTime &&
-                       !d->lstLastModifiedFiles[iPathIndex].contains(strFileName))
+                       !state.lstLastModifiedFiles.contains(strFileName))
                 d->lstModifiedFiles << strFullFileName;
             }
           // If this file is the newest so far, update previous check
           // time and clear the list of newest files.
-          if (lastModified > d->lstPreviousCheckTimes[iPathIndex])
+          if (lastModified > state.previousCheckTime)
             {
-              d->lstPreviousCheckTimes[iPathIndex] = lastModified;
+              state.previousCheckTime = lastModified;
               lstNewestFiles.clear();
               lstNewestFiles << strFileName;
             }
           // Add to the list of newest files.
-          else if (lastModified == d->lstPreviousCheckTimes[iPathIndex])
+          else if (lastModified == state.previousCheckTime)
             lstNewestFiles << strFileName;
         }
     }
@@ -153,8 +229,31 @@ void PiiFileSystemWatcher::directoryChanged(const QString& path)
 
   // Store the names of files that were modified at the same time
   // instant.
-  d->lstLastModifiedFiles[iPathIndex] = lstNewestFiles;
+  state.lstLastModifiedFiles = lstNewestFiles;
 
+  if (d->bRecursive)
+    {
+      // Start watching new subdirectories. Everything in them is new.
+      QDirIterator dirIterator(path, QDir::Dirs | QDir::NoDotAndDotDot);
+      while (dirIterator.hasNext())
+        {
+          QString strSubdirectory(dirIterator.next());
+          if (!d->hashDirectoryStates.contains(directoryKey(strSubdirectory)))
+            {
+              watchDirectories(strSubdirectory, QDateTime::fromMSecsSinceEpoch(0), false);
+              directoryChanged(strSubdirectory);
+            }
+        }
+    }
+
+  scheduleEmission();
+}
+
+void PiiFileSystemWatcher::scheduleEmission()
+{
+  PII_D;
+  if (d->lstModifiedFiles.isEmpty())
+    return;
   // If watch delay is zero, we need to send modified files immediately.
   if (d->iWatchDelay == 0)
     emitAllFileNames();
@@ -164,6 +263,138 @@ void PiiFileSystemWatcher::directoryChanged(const QString& path)
     QTimer::singleShot(d->iWatchDelay*1000, this, SLOT(emitNotModifiedFileNames()));
 }
 
+bool PiiFileSystemWatcher::startNativeWatch()
+{
+#ifdef PII_WATCHER_INOTIFY
+  PII_D;
+  d->iNativeDescriptor = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+  if (d->iNativeDescriptor == -1)
+    return false;
+
+  for (int i=0; i<d->lstDirectories.size(); ++i)
+    {
+      QString strPath(QDir(d->lstDirectories[i]).absolutePath());
+      addNativeWatch(strPath);
+      if (d->bRecursive)
+        {
+          QDirIterator iterator(strPath, QDir::Dirs | QDir::NoDotAndDotDot, QDirIterator::Subdirectories);
+          while (iterator.hasNext())
+            addNativeWatch(iterator.next());
+        }
+    }
+
+  d->pNativeNotifier = new QSocketNotifier(d->iNativeDescriptor, QSocketNotifier::Read);
+  connect(d->pNativeNotifier, SIGNAL(activated(int)), this, SLOT(readNativeEvents()));
+  return true;
+#else
+  return false;
+#endif
+}
+
+void PiiFileSystemWatcher::addNativeWatch(const QString& path)
+{
+#ifdef PII_WATCHER_INOTIFY
+  PII_D;
+  uint32_t iMask = IN_ONLYDIR | IN_CLOSE_WRITE | IN_MOVED_TO | IN_CREATE | IN_MOVE_SELF;
+  if (!d->bWaitForClose)
+    iMask |= IN_MODIFY;
+  int iWatch = inotify_add_watch(d->iNativeDescriptor, QFile::encodeName(path).constData(), iMask);
+  if (iWatch == -1)
+    piiWarning(tr("Cannot watch %1 (error %2).").arg(path).arg(errno));
+  else
+    d->hashNativeWatches.insert(iWatch, path);
+#else
+  Q_UNUSED(path);
+#endif
+}
+
+void PiiFileSystemWatcher::watchNewDirectory(const QString& path)
+{
+  addNativeWatch(path);
+  // Files may have been created before the watch was added.
+  QDirIterator iterator(path, QDir::Files | QDir::Dirs | QDir::NoDotAndDotDot);
+  while (iterator.hasNext())
+    {
+      iterator.next();
+      QFileInfo info(iterator.fileInfo());
+      if (info.isDir())
+        watchNewDirectory(info.absoluteFilePath());
+      else if (matchesNameFilters(info.fileName()))
+        addModifiedFile(info.absoluteFilePath());
+    }
+}
+
+void PiiFileSystemWatcher::readNativeEvents()
+{
+#ifdef PII_WATCHER_INOTIFY
+  PII_D;
+  // inotify_event must be properly aligned.
+  quint64 aBuffer[1024];
+  const int iNameMask = IN_CREATE | IN_MODIFY | IN_CLOSE_WRITE | IN_MOVED_TO;
+  const int iCompleteMask = d->bWaitForClose ? IN_CLOSE_WRITE | IN_MOVED_TO : iNameMask;
+  bool bOverflow = false;
+  // Read everything there is. All changes to a file are coalesced
+  // into one emission.
+  for (;;)
+    {
+      ssize_t iBytes = ::read(d->iNativeDescriptor, aBuffer, sizeof(aBuffer));
+      if (iBytes <= 0)
+        break;
+      const char* pData = reinterpret_cast<const char*>(aBuffer);
+      for (ssize_t i=0; i<iBytes; )
+        {
+          const struct inotify_event* pEvent = reinterpret_cast<const struct inotify_event*>(pData + i);
+          i += sizeof(struct inotify_event) + pEvent->len;
+
+          if (pEvent->mask & IN_Q_OVERFLOW)
+            {
+              bOverflow = true;
+              continue;
+            }
+          if (pEvent->mask & IN_IGNORED)
+            {
+              d->hashNativeWatches.remove(pEvent->wd);
+              continue;
+            }
+          // The stored path of a moved directory is no longer valid.
+          // If it was moved to a watched place, it will be watched
+          // again under the new name.
+          if (pEvent->mask & IN_MOVE_SELF)
+            {
+              inotify_rm_watch(d->iNativeDescriptor, pEvent->wd);
+              d->hashNativeWatches.remove(pEvent->wd);
+              continue;
+            }
+          QHash<int,QString>::const_iterator it = d->hashNativeWatches.constFind(pEvent->wd);
+          if (it == d->hashNativeWatches.constEnd() || pEvent->len == 0)
+            continue;
+
+          QString strFileName(QFile::decodeName(pEvent->name));
+          QString strFullFileName(it.value() + '/' + strFileName);
+          if (pEvent->mask & IN_ISDIR)
+            {
+              if (d->bRecursive && (pEvent->mask & (IN_CREATE | IN_MOVED_TO)))
+                watchNewDirectory(strFullFileName);
+            }
+          else if ((pEvent->mask & iCompleteMask) && matchesNameFilters(strFileName))
+            addModifiedFile(strFullFileName);
+        }
+    }
+
+  if (bOverflow)
+    piiWarning(tr("The inotify event queue overflowed. Some changes may have been missed."));
+
+  // Events may arrive before the operation is running or after it
+  // has been stopped.
+  if (state() != Running)
+    {
+      d->lstModifiedFiles.clear();
+      return;
+    }
+  scheduleEmission();
+#endif
+}
+
 void PiiFileSystemWatcher::emitAllFileNames()
 {
   PII_D;
@@ -201,7 +432,6 @@ void PiiFileSystemWatcher::emitNotModifiedFileNames()
               //qDebug("Sending %s", qPrintable(d->lstModifiedFiles[i]));
               emitObject(d->lstModifiedFiles[i]);
               d->lstModifiedFiles.removeAt(i);
-              d->lstModifiedTimes.removeAt(i);
             }
         }
     }
@@ -219,3 +449,7 @@ void PiiFileSystemWatcher::setNameFilters(const QStringList& nameFilters) { _d()
 QStringList PiiFileSystemWatcher::nameFilters() const { return _d()->lstNameFilters; }
 void PiiFileSystemWatcher::setWatchDelay(int watchDelay) { _d()->iWatchDelay = watchDelay; }
 int PiiFileSystemWatcher::watchDelay() const { return _d()->iWatchDelay; }
+void PiiFileSystemWatcher::setRecursive(bool recursive) { _d()->bRecursive = recursive; }
+bool PiiFileSystemWatcher::recursive() const { return _d()->bRecursive; }
+void PiiFileSystemWatcher::setWaitForClose(bool waitForClose) { _d()->bWaitForClose = waitForClose; }
+bool PiiFileSystemWatcher::waitForClose() const { return _d()->bWaitForClose; }
@@ -20,6 +20,9 @@
 
 #include <QFileSystemWatcher>
 #include <QDateTime>
+#include <QRegExp>
+
+class QSocketNotifier;
 
 /**
  * An operation for monitoring directories for new files. If the file
@@ -32,6 +35,19 @@
  * @out filename - the absolute path of a file that was modified or
  * added to a watched directory.
  *
+ * Backends
+ * --------
+ *
+ * On Linux, the operation uses inotify directly. Events are read as
+ * they arrive, and all changes to a file found in one batch of events
+ * are coalesced into one emission. Since inotify reports when a file
+ * that was open for writing is closed, [waitForClose] can be used to
+ * emit files only once they have been completely written. On other
+ * platforms, and if inotify cannot be initialized, QFileSystemWatcher
+ * is used, and changes are detected by comparing modification times.
+ * In this case, [waitForClose] has no effect, and [watchDelay] must
+ * be used to delay the handling of files that are still being
+ * written.
  */
 class PiiFileSystemWatcher : public PiiDefaultOperation
 {
@@ -66,9 +82,27 @@ class PiiFileSystemWatcher : public PiiDefaultOperation
    */
   Q_PROPERTY(int watchDelay READ watchDelay WRITE setWatchDelay);
 
+  /**
+   * If `true`, subdirectories of [directories] will be watched as
+   * well. Directories created while watching will be added
+   * automatically, and files already in them will be reported. The
+   * default is `false`.
+   */
+  Q_PROPERTY(bool recursive READ recursive WRITE setRecursive);
+
+  /**
+   * If `true`, a file name will be emitted only after a process that
+   * wrote to the file has closed it, or when a file has been moved
+   * into a watched directory. This makes it possible to handle files
+   * once they are complete without polling. Only supported by the
+   * inotify backend. The default is `false`.
+   */
+  Q_PROPERTY(bool waitForClose READ waitForClose WRITE setWaitForClose);
+
   PII_OPERATION_SERIALIZATION_FUNCTION
 public:
   PiiFileSystemWatcher();
+  ~PiiFileSystemWatcher();
 
   void setDirectories(const QStringList& directories);
   QStringList directories() const;
@@ -76,6 +110,10 @@ public:
   QStringList nameFilters() const;
   void setWatchDelay(int watchDelay);
   int watchDelay() const;
+  void setRecursive(bool recursive);
+  bool recursive() const;
+  void setWaitForClose(bool waitForClose);
+  bool waitForClose() const;
 
   void check(bool reset);
 
@@ -89,29 +127,53 @@ private slots:
    */
   void directoryChanged(const QString& path);
   void emitNotModifiedFileNames();
+  /**
+   * Reads pending events from the native backend.
+   */
+  void readNativeEvents();
 
 private:
   void emitAllFileNames();
-  int indexOf(const QStringList& paths, const QString& path);
+  void scheduleEmission();
+  bool matchesNameFilters(const QString& fileName) const;
+  void stopWatching();
+  void watchDirectories(const QString& path, const QDateTime& checkTime, bool recursive);
+  bool startNativeWatch();
+  void addNativeWatch(const QString& path);
+  void watchNewDirectory(const QString& path);
+  void addModifiedFile(const QString& fileName);
+  static QString directoryKey(const QString& path);
+
+  struct DirectoryState
+  {
+    QDateTime previousCheckTime;
+    // Files modified at previousCheckTime
+    QStringList lstLastModifiedFiles;
+  };
 
   /// @internal
   class Data : public PiiDefaultOperation::Data
   {
   public:
     Data();
-    // List of watched dirs and their last check times
     QStringList lstDirectories;
-    QList<QDateTime> lstPreviousCheckTimes;
+    // Last check times of watched dirs (QFileSystemWatcher backend)
+    QHash<QString,DirectoryState> hashDirectoryStates;
 
     QFileSystemWatcher fileSystemWatcher;
     QStringList lstNameFilters;
+    QList<QRegExp> lstNameFilterExps;
     int iWatchDelay;
+    bool bRecursive;
+    bool bWaitForClose;
 
     // List of modified files pending emission
     QStringList lstModifiedFiles;
-    // Lists of modified files found during the last check, per folder.
-    QList<QStringList> lstLastModifiedFiles;
-    QList<QDateTime> lstModifiedTimes;
+
+    // inotify backend
+    int iNativeDescriptor;
+    QSocketNotifier* pNativeNotifier;
+    QHash<int,QString> hashNativeWatches;
   };
   PII_D_FUNC;
 };
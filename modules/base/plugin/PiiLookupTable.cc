@@ -19,9 +19,22 @@
 #include <PiiMath.h>
 #include <PiiUtil.h>
 
+#include <algorithm>
+#include <climits>
+
+namespace
+{
+  struct RangeOrder
+  {
+    RangeOrder(const QVector<double>& starts) : _starts(starts) {}
+    bool operator() (int a, int b) const { return _starts[a] < _starts[b]; }
+    const QVector<double>& _starts;
+  };
+}
+
 PiiLookupTable::Data::Data() :
-  iMaxTableIndex(0),
-  iMaxLookupIndex(0)
+  iListCount(0),
+  iEntryCount(0)
 {
 }
 
@@ -36,28 +49,41 @@ void PiiLookupTable::setTable(const QVariantList& table)
 {
   PII_D;
   d->lstTable = table;
-  d->lstOutputValues.clear();
+  d->vecValues.clear();
+  d->iListCount = d->iEntryCount = 0;
 
   if (table.size() == 0)
     return;
 
+  QList<QVariantList> lstLists;
   // Multiple look-up lists
   if (table[0].type() == QVariant::List)
     {
       // Check that each is of equal length
-      int len = table[0].toList().size();
-
-      for (int i=1; i<table.size(); i++)
-        if (table[i].type() != QVariant::List || table[i].toList().size() != len)
-          return;
-
-      // Convert each to a list of PiiVariants.
       for (int i=0; i<table.size(); i++)
-        d->lstOutputValues.append(Pii::variantsToList<PiiVariant>(table[i].toList()));
+        {
+          if (table[i].type() != QVariant::List)
+            return;
+          lstLists << table[i].toList();
+          if (lstLists[i].size() != lstLists[0].size())
+            return;
+        }
     }
   // Only one list -> use as such
   else
-    d->lstOutputValues << Pii::variantsToList<PiiVariant>(table);
+    lstLists << table;
+
+  // Convert the lists to PiiVariants once and store them so that the
+  // values of an entry are consecutive.
+  d->iListCount = lstLists.size();
+  d->iEntryCount = lstLists[0].size();
+  d->vecValues.resize(d->iListCount * d->iEntryCount);
+  for (int i=0; i<d->iListCount; ++i)
+    {
+      QList<PiiVariant> lstValues(Pii::variantsToList<PiiVariant>(lstLists[i]));
+      for (int j=0; j<d->iEntryCount; ++j)
+        d->vecValues[j * d->iListCount + i] = lstValues[j];
+    }
 }
 
 void PiiLookupTable::setDynamicOutputCount(int cnt)
@@ -70,14 +96,100 @@ void PiiLookupTable::check(bool reset)
 {
   PII_D;
   PiiDefaultOperation::check(reset);
-  d->iMaxTableIndex = Pii::min(inputCount(), d->lstOutputValues.size()) - 1;
-  d->iMaxLookupIndex = d->lstOutputValues.isEmpty() ? -1 : d->lstOutputValues[0].size() - 1;
 
   // Check that we were not given nulls.
-  for (int i=d->lstOutputValues.size(); i--; )
-    for (int j=d->lstOutputValues[i].size(); j--; )
-      if (!d->lstOutputValues[i][j].isValid())
-        PII_THROW(PiiExecutionException, tr("The provided look-up table contains invalid values."));
+  for (int i=d->vecValues.size(); i--; )
+    if (!d->vecValues[i].isValid())
+      PII_THROW(PiiExecutionException, tr("The provided look-up table contains invalid values."));
+
+  buildKeys();
+}
+
+void PiiLookupTable::buildKeys()
+{
+  PII_D;
+  d->hashKeys.clear();
+  d->vecRangeStarts.clear();
+  d->vecRangeEnds.clear();
+  d->vecRangeEntries.clear();
+
+  if (d->lstKeys.isEmpty())
+    return;
+  if (d->lstKeys.size() != d->iEntryCount)
+    PII_THROW(PiiExecutionException, tr("The number of keys (%1) doesn't match the number of look-up table entries (%2).")
+              .arg(d->lstKeys.size()).arg(d->iEntryCount));
+
+  QVector<double> vecStarts, vecEnds;
+  QVector<int> vecEntries;
+  for (int i=0; i<d->lstKeys.size(); ++i)
+    {
+      const QVariant& key = d->lstKeys[i];
+      if (key.type() == QVariant::List)
+        {
+          QVariantList lstRange(key.toList());
+          bool bMinOk = false, bMaxOk = false;
+          double dMin = 0, dMax = 0;
+          if (lstRange.size() == 2)
+            {
+              dMin = lstRange[0].toDouble(&bMinOk);
+              dMax = lstRange[1].toDouble(&bMaxOk);
+            }
+          if (!bMinOk || !bMaxOk || dMin > dMax)
+            PII_THROW(PiiExecutionException, tr("Key %1 is not a valid range.").arg(i));
+          vecStarts << dMin;
+          vecEnds << dMax;
+          vecEntries << i;
+        }
+      else
+        {
+          bool bOk = false;
+          int iKey = key.toInt(&bOk);
+          if (!bOk)
+            PII_THROW(PiiExecutionException, tr("Key %1 is not an integer.").arg(i));
+          if (d->hashKeys.contains(iKey))
+            PII_THROW(PiiExecutionException, tr("Key %1 is given multiple times.").arg(iKey));
+          d->hashKeys.insert(iKey, i);
+        }
+    }
+
+  // Sort the ranges so that they can be searched in logarithmic time.
+  QVector<int> vecOrder(vecStarts.size());
+  for (int i=0; i<vecOrder.size(); ++i)
+    vecOrder[i] = i;
+  std::sort(vecOrder.begin(), vecOrder.end(), RangeOrder(vecStarts));
+  for (int i=0; i<vecOrder.size(); ++i)
+    {
+      const int iRange = vecOrder[i];
+      if (i > 0 && vecStarts[iRange] <= d->vecRangeEnds.last())
+        PII_THROW(PiiExecutionException, tr("Key range %1 overlaps another range.").arg(vecEntries[iRange]));
+      d->vecRangeStarts << vecStarts[iRange];
+      d->vecRangeEnds << vecEnds[iRange];
+      d->vecRangeEntries << vecEntries[iRange];
+    }
+}
+
+int PiiLookupTable::findEntry(double key) const
+{
+  const PII_D;
+  if (d->lstKeys.isEmpty())
+    {
+      // Fractions are truncated towards zero.
+      return key > -1 && key < d->iEntryCount ? int(key) : -1;
+    }
+
+  if (!d->hashKeys.isEmpty() && key > INT_MIN - 1.0 && key < INT_MAX + 1.0)
+    {
+      QHash<int,int>::const_iterator it = d->hashKeys.find(int(key));
+      if (it != d->hashKeys.end())
+        return it.value();
+    }
+
+  // Find the last range that starts at or below key.
+  const double* pStarts = d->vecRangeStarts.constData();
+  const int iRange = std::upper_bound(pStarts, pStarts + d->vecRangeStarts.size(), key) - pStarts - 1;
+  if (iRange >= 0 && key <= d->vecRangeEnds[iRange])
+    return d->vecRangeEntries[iRange];
+  return -1;
 }
 
 void PiiLookupTable::process()
@@ -85,39 +197,43 @@ void PiiLookupTable::process()
   PII_D;
   PiiVariant obj = readInput();
 
-  int index = 0;
+  double dKey = 0;
   switch (obj.type())
     {
-      PII_PRIMITIVE_CASES(index = (int)PiiYdin::primitiveAs, obj);
+      PII_PRIMITIVE_CASES(dKey = (double)PiiYdin::primitiveAs, obj);
     default:
       PII_THROW_UNKNOWN_TYPE(inputAt(0));
     }
 
+  const int iEntry = findEntry(dKey);
+  const int iOutputCount = outputCount();
   // If there is no lookup table entry, we need to resort to the
   // default value.
-  if (index < 0 || index > d->iMaxLookupIndex)
+  if (iEntry < 0)
     {
       if (d->varDefaultValue.isValid())
         {
-          for (int i=outputCount(); i--; )
+          for (int i=iOutputCount; i--; )
             emitObject(d->varDefaultValue, i);
           return;
         }
+      else if (d->lstKeys.isEmpty())
+        PII_THROW(PiiExecutionException, tr("The value of the index input (%1) is out of range (0-%2).").arg(dKey).arg(d->iEntryCount - 1));
       else
-        PII_THROW(PiiExecutionException, tr("The value of the index input (%1) is out of range (0-%2).").arg(index).arg(d->iMaxLookupIndex));
+        PII_THROW(PiiExecutionException, tr("There is no look-up table entry for %1.").arg(dKey));
     }
 
-  int i = 0;
+  const PiiVariant* pValues = d->vecValues.constData() + iEntry * d->iListCount;
   // Emit look-up table values to all outputs that have the look-up
-  // table defined.
-  for (; i<=d->iMaxTableIndex; ++i)
-    emitObject(d->lstOutputValues[i][index], i);
-  // Use the last valid value for the rest of the outputs.
-  for (; i<d->lstOutputs.size(); ++i)
-    emitObject(d->lstOutputValues[d->iMaxTableIndex][index], i);
+  // table defined. Use the last valid value for the rest of the
+  // outputs.
+  for (int i=0; i<iOutputCount; ++i)
+    emitObject(pValues[qMin(i, d->iListCount - 1)], i);
 }
 
 QVariantList PiiLookupTable::table() const { return _d()->lstTable; }
+void PiiLookupTable::setKeys(const QVariantList& keys) { _d()->lstKeys = keys; }
+QVariantList PiiLookupTable::keys() const { return _d()->lstKeys; }
 int PiiLookupTable::dynamicOutputCount() const { return outputCount(); }
 void PiiLookupTable::setDefaultValue(const PiiVariant& defaultValue) { _d()->varDefaultValue = defaultValue; }
 PiiVariant PiiLookupTable::defaultValue() const { return _d()->varDefaultValue; }
@@ -24,8 +24,9 @@
  * Inputs
  * ------
  *
- * @in index - a zero-based index into the look-up table. If there is
- * no [default value](defaultValue), overflows and underflows will
+ * @in index - a zero-based index into the look-up table or a key
+ * that is matched against [keys]. If there is no [default
+ * value](defaultValue), overflows, underflows and unknown keys will
  * cause a run-time exception. Any primitive type is be accepted.
  *
  * Outputs
@@ -72,6 +73,29 @@ class PiiLookupTable : public PiiDefaultOperation
    */
   Q_PROPERTY(QVariantList table READ table WRITE setTable);
 
+  /**
+   * Keys for the look-up table entries. If this list is empty (the
+   * default), the incoming `index` is used as a zero-based index into
+   * [table]. Otherwise, `keys[i]` is the key of the look-up table
+   * entry at `i`, and the number of keys must match the number of
+   * entries. Each key is either an integer that must be matched
+   * exactly or a list of two numbers that defines a closed range of
+   * keys. Exact keys are looked up in a hash table and ranges with a
+   * binary search. Exact keys take precedence over ranges. Duplicate
+   * exact keys and overlapping ranges are not allowed.
+   *
+   * ~~~(c++)
+   * // Map 10 to "ten", [0, 5] to "low" and [5.5, 100] to "high".
+   * lut->setProperty("table", QVariantList() << Pii::createQVariant(QString("ten"))
+   *                                          << Pii::createQVariant(QString("low"))
+   *                                          << Pii::createQVariant(QString("high")));
+   * lut->setProperty("keys", QVariantList() << 10
+   *                                         << (QVariantList() << 0 << 5)
+   *                                         << (QVariantList() << 5.5 << 100));
+   * ~~~
+   */
+  Q_PROPERTY(QVariantList keys READ keys WRITE setKeys);
+
   /**
    * The number of outputs. Must be greater than zero. The default
    * value is one.
@@ -94,6 +118,8 @@ public:
 
   void setTable(const QVariantList& table);
   QVariantList table() const;
+  void setKeys(const QVariantList& keys);
+  QVariantList keys() const;
   void setDynamicOutputCount(int count);
   int dynamicOutputCount() const;
   void setDefaultValue(const PiiVariant& defaultValue);
@@ -103,21 +129,26 @@ protected:
   void process();
 
 private:
+  int findEntry(double key) const;
+  void buildKeys();
+
   /// @internal
   class Data : public PiiDefaultOperation::Data
   {
   public:
     Data();
-    // A look-up list for all outputs
-    QList<QList<PiiVariant> > lstOutputValues;
-    // The actual property value
-    QVariantList lstTable;
-    // Last list index that overflows neither look-up list
-    // (lstOutputValues) nor output list.
-    int iMaxTableIndex;
-    // Last index that doesn't overflow the look-up table itself
-    // (lstOutputValues[0])
-    int iMaxLookupIndex;
+    // Look-up table entries in a row-major matrix. Each row contains
+    // the values of one entry for all look-up lists.
+    QVector<PiiVariant> vecValues;
+    int iListCount;
+    int iEntryCount;
+    // The actual property values
+    QVariantList lstTable, lstKeys;
+    // Exact keys to entry indices
+    QHash<int,int> hashKeys;
+    // Key ranges sorted by their lower bounds
+    QVector<double> vecRangeStarts, vecRangeEnds;
+    QVector<int> vecRangeEntries;
     PiiVariant varDefaultValue;
   };
   PII_D_FUNC;
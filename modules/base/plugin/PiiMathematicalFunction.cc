@@ -18,7 +18,8 @@
 #include <PiiYdinTypes.h>
 
 PiiMathematicalFunction::Data::Data() :
-  function(NoFunction)
+  function(NoFunction),
+  accuracy(FullAccuracy)
 {
 }
 
@@ -53,7 +54,15 @@ void PiiMathematicalFunction::process()
       switch (obj.type())
         {
           PII_NUMERIC_CASES(log, obj);
-          PII_NUMERIC_MATRIX_CASES(absMat, obj);
+          PII_NUMERIC_MATRIX_CASES(logMat, obj);
+        }
+      return;
+
+    case Exp:
+      switch (obj.type())
+        {
+          PII_NUMERIC_CASES(exp, obj);
+          PII_NUMERIC_MATRIX_CASES(expMat, obj);
         }
       return;
 
@@ -126,3 +135,5 @@ void PiiMathematicalFunction::process()
 
 void PiiMathematicalFunction::setFunction(Function function) { _d()->function = function; }
 PiiMathematicalFunction::Function PiiMathematicalFunction::function() const { return _d()->function; }
+void PiiMathematicalFunction::setAccuracy(Accuracy accuracy) { _d()->accuracy = accuracy; }
+PiiMathematicalFunction::Accuracy PiiMathematicalFunction::accuracy() const { return _d()->accuracy; }
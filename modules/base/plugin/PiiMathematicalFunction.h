@@ -44,6 +44,12 @@ class PiiMathematicalFunction : public PiiDefaultOperation
    */
   Q_PROPERTY(Function function READ function WRITE setFunction);
   Q_ENUMS(Function);
+  /**
+   * The accuracy of element-wise functions applied to matrices. The
+   * default value is `FullAccuracy`.
+   */
+  Q_PROPERTY(Accuracy accuracy READ accuracy WRITE setAccuracy);
+  Q_ENUMS(Accuracy);
 
   PII_OPERATION_SERIALIZATION_FUNCTION
 public:
@@ -79,6 +85,10 @@ public:
    * `float` input, for which it is `float`. Complex numbers cause
    * run-time exception.
    *
+   * - `Exp` - base-e exponential. Output type is `double` except for
+   * `float` input, for which it is `float`. Complex numbers cause
+   * run-time exception.
+   *
    * Functions that calculate a value over all elements in a matrix.
    * In all these cases the output type is `double`. Scalars and
    * complex-valued matrices as input cause run-time exception:
@@ -91,13 +101,29 @@ public:
   {
     NoFunction,
     Abs, Log, Sqrt, Square, Sin, Cos, Tan,
-    Var, Std, Mean
+    Var, Std, Mean,
+    Exp
   };
 
+  /**
+   * Accuracy modes for `Log`, `Exp`, `Sin`, `Cos` and `Tan`.
+   *
+   * - `FullAccuracy` - use the standard math library.
+   *
+   * - `FastApproximation` - use the polynomial approximations in
+   * PiiFastMath.h for matrices. The maximum error is 1-2 ULP (4 ULP
+   * for `Tan`) within the documented input ranges, and processing is
+   * several times faster because the compiler can vectorize the
+   * loops. Scalars are always calculated with full accuracy.
+   */
+  enum Accuracy { FullAccuracy, FastApproximation };
+
   PiiMathematicalFunction();
 
   void setFunction(Function function);
   Function function() const;
+  void setAccuracy(Accuracy accuracy);
+  Accuracy accuracy() const;
 
 protected:
   void process();
@@ -108,13 +134,24 @@ private:
   template <class T> void func(const PiiVariant& obj) { EMIT(Pii::func(obj.valueAs<T>())); } \
   template <class T> void func##Mat(const PiiVariant& obj) { EMIT(Pii::func(obj.valueAs<PiiMatrix<T> >())); }
 
+#define FAST_FUNC_DEF(func, fastFunc) \
+  template <class T> void func(const PiiVariant& obj) { EMIT(Pii::func(obj.valueAs<T>())); } \
+  template <class T> void func##Mat(const PiiVariant& obj) \
+  { \
+    if (_d()->accuracy == FastApproximation) \
+      EMIT(Pii::fastFunc(obj.valueAs<PiiMatrix<T> >())); \
+    else \
+      EMIT(Pii::func(obj.valueAs<PiiMatrix<T> >())); \
+  }
+
   FUNC_DEF(abs)
-  FUNC_DEF(log)
+  FAST_FUNC_DEF(log, fastLog)
+  FAST_FUNC_DEF(exp, fastExp)
   FUNC_DEF(sqrt)
   FUNC_DEF(square)
-  FUNC_DEF(sin)
-  FUNC_DEF(cos)
-  FUNC_DEF(tan)
+  FAST_FUNC_DEF(sin, fastSin)
+  FAST_FUNC_DEF(cos, fastCos)
+  FAST_FUNC_DEF(tan, fastTan)
 
   template <class T> void std(const PiiVariant& obj) { EMIT(Pii::std<double>(obj.valueAs<PiiMatrix<T> >())); }
   template <class T> void var(const PiiVariant& obj) { EMIT(Pii::var<double>(obj.valueAs<PiiMatrix<T> >())); }
@@ -122,6 +159,7 @@ private:
 
 #undef EMIT
 #undef FUNC_DEF
+#undef FAST_FUNC_DEF
 
   /// @internal
   class Data : public PiiDefaultOperation::Data
@@ -129,6 +167,7 @@ private:
   public:
     Data();
     Function function;
+    Accuracy accuracy;
   };
   PII_D_FUNC;
 };
@@ -21,7 +21,7 @@
 using namespace PiiYdin;
 
 PiiMatrixCombiner::Data::Data() :
-  iRows(1), iColumns(0)
+  iRows(1), iColumns(0), bUniformSize(false)
 {
 }
 
@@ -55,6 +55,7 @@ void PiiMatrixCombiner::process()
   PiiVariant::PrimitiveType maxPrimitive = PiiVariant::CharType;
   bool primitiveFound = false, colorFound = false, complexFound = false;
   QSize maxSize(0,0);
+  bool bUniformSize = true;
 
   for (int i=0; i<cnt; ++i)
     {
@@ -90,6 +91,8 @@ void PiiMatrixCombiner::process()
           PII_ALL_MATRIX_CASES(size = matrixSize, obj);
           PII_COLOR_IMAGE_CASES(size = matrixSize, obj);
         }
+      if (i > 0 && size != maxSize)
+        bUniformSize = false;
       maxSize = maxSize.expandedTo(size);
     }
 
@@ -101,6 +104,8 @@ void PiiMatrixCombiner::process()
   else if (!complexFound)
     maxType = 0x40 + maxPrimitive;
 
+  _d()->bUniformSize = bUniformSize;
+
   switch (maxType)
     {
       PII_PRIMITIVE_MATRIX_CASES(buildCompound, maxSize);
@@ -143,7 +148,19 @@ template <class T> void PiiMatrixCombiner::buildCompound(QSize maxSize)
       columns = cnt;
     }
 
-  PiiMatrix<T> matResult(rows * maxSize.height(), columns * maxSize.width());
+  // A lone matrix of the right type needs no copying.
+  if (cnt == 1 && readInput(0).type() == Pii::typeId<PiiMatrix<T> >())
+    {
+      emitObject(readInput(0));
+      return;
+    }
+
+  // If the blocks fill the grid completely, there is no need to zero
+  // the result first.
+  const int iResultRows = rows * maxSize.height(), iResultColumns = columns * maxSize.width();
+  PiiMatrix<T> matResult(d->bUniformSize && rows * columns == cnt ?
+                         PiiMatrix<T>::uninitialized(iResultRows, iResultColumns) :
+                         PiiMatrix<T>(iResultRows, iResultColumns));
 
   Pii::IfClass<Pii::IsPrimitive<T>,
     PrimitiveBuilder,
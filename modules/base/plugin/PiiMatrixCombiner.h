@@ -75,6 +75,7 @@ private:
     Data();
     int iRows;
     int iColumns;
+    bool bUniformSize;
   };
   PII_D_FUNC;
 
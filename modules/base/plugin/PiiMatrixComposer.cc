@@ -16,6 +16,7 @@
 #include "PiiMatrixComposer.h"
 #include <PiiYdinTypes.h>
 #include <PiiUtil.h>
+#include <PiiTransposedMatrix.h>
 
 PiiMatrixComposer::Data::Data() :
   direction(Pii::Horizontally),
@@ -139,17 +140,25 @@ void PiiMatrixComposer::syncEvent(SyncEvent* event)
 
 template <class T> void PiiMatrixComposer::emitMatrix()
 {
-  PiiMatrix<T>& matResult = static_cast<PiiMatrix<T>& >(*_d()->pMatResult);
-  emitObject(matResult);
-  resize(matResult);
-}
-
-template <class T> void PiiMatrixComposer::resize(PiiMatrix<T>& matrix)
-{
-  if (_d()->direction == Pii::Horizontally)
-    matrix.resize(0, matrix.columns());
+  PII_D;
+  PiiMatrix<T>& matResult = static_cast<PiiMatrix<T>& >(*d->pMatResult);
+  if (d->direction == Pii::Horizontally)
+    {
+      // Hand the collected rows over as such. A fresh buffer with the
+      // same capacity avoids detaching (and copying) the emitted one.
+      const int iCapacity = matResult.capacity();
+      emitObject(matResult);
+      matResult = PiiMatrix<T>(0, matResult.columns());
+      matResult.reserve(iCapacity);
+    }
   else
-    matrix.resize(matrix.rows(), 0);
+    {
+      // Rows are collected even in vertical mode because appending a
+      // column reallocates the whole matrix. One transpose at the end
+      // is cheaper.
+      emitObject(PiiMatrix<T>(Pii::transpose(matResult)));
+      matResult.resize(0, matResult.columns());
+    }
 }
 
 template <class T> void PiiMatrixComposer::operate()
@@ -157,49 +166,39 @@ template <class T> void PiiMatrixComposer::operate()
   PII_D;
   const int iCnt = inputCount()-1;
 
+  // Without sync, each object set makes a matrix of its own. Fill it
+  // in place instead of going through a shared buffer that would
+  // need to be detached after emission.
+  if (!d->pSyncInput->isConnected())
+    {
+      PiiMatrix<T> matResult(d->direction == Pii::Horizontally ?
+                             PiiMatrix<T>::uninitialized(1, iCnt) :
+                             PiiMatrix<T>::uninitialized(iCnt, 1));
+      fill<T>(matResult.begin());
+      emitObject(matResult);
+      return;
+    }
+
   if (d->uiPreviousType != Pii::typeId<T>())
     {
       delete d->pMatResult;
-      if (d->direction == Pii::Horizontally)
-        d->pMatResult = new PiiMatrix<T>(0, iCnt);
-      else
-        d->pMatResult = new PiiMatrix<T>(iCnt, 0);
+      d->pMatResult = new PiiMatrix<T>(0, iCnt);
       d->uiPreviousType = Pii::typeId<T>();
     }
   PiiMatrix<T>& matResult = static_cast<PiiMatrix<T>& >(*d->pMatResult);
+  fill<T>(matResult.appendRow());
+}
 
-  int iItemCount = 0;
-  if (d->direction == Pii::Horizontally)
-    {
-      iItemCount = matResult.rows();
-      matResult.appendRow();
-    }
-  else
-    {
-      iItemCount = matResult.columns();
-      matResult.appendColumn();
-    }
-
+template <class T, class Iterator> void PiiMatrixComposer::fill(Iterator values)
+{
+  PII_D;
   // For each input, it is checked, whether the input is connected or
   // not. If the input is not connected, the default value is used for
   // filling the matrix column/row.
-  for (int i=0; i<iCnt; ++i)
-    {
-      // If the input is not connected. Use the default value for the input.
-      T value = d->lstConnectedInputs[i] ?
-        PiiYdin::convertPrimitiveTo<T>(inputAt(i+1)) :
-        T(d->lstDefaultValues[i]);
-      if (d->direction == Pii::Horizontally)
-        matResult(iItemCount, i) = value;
-      else
-        matResult(i, iItemCount) = value;
-    }
-
-  if (!d->pSyncInput->isConnected())
-    {
-      emitObject(matResult);
-      resize(matResult);
-    }
+  for (int i=0; i<inputCount()-1; ++i, ++values)
+    *values = d->lstConnectedInputs[i] ?
+      PiiYdin::convertPrimitiveTo<T>(inputAt(i+1)) :
+      T(d->lstDefaultValues[i]);
 }
 
 void PiiMatrixComposer::setDirection(const Pii::MatrixDirection& direction)
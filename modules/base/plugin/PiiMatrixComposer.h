@@ -118,7 +118,7 @@ protected:
 private:
   template <class T> void operate();
   template <class T> void emitMatrix();
-  template <class T> void resize(PiiMatrix<T>& matrix);
+  template <class T, class Iterator> void fill(Iterator values);
 
   class Data : public PiiDefaultOperation::Data
   {
@@ -15,6 +15,7 @@
 
 #include "PiiMatrixNormalizer.h"
 #include <PiiMath.h>
+#include <PiiSaturatingArithmetic.h>
 #include <PiiYdinTypes.h>
 
 PiiMatrixNormalizer::Data::Data() :
@@ -30,25 +31,32 @@ PiiMatrixNormalizer::PiiMatrixNormalizer() :
   addSocket(new PiiOutputSocket("output"));
 }
 
+PiiMatrixNormalizer::Dispatchers::Dispatchers()
+{
+  PII_NUMERIC_MATRIX_DISPATCH(normalizers, &PiiMatrixNormalizer::normalize);
+  PII_NUMERIC_MATRIX_DISPATCH(emitters, &PiiMatrixNormalizer::emitMatrix);
+}
+
+const PiiMatrixNormalizer::Dispatchers& PiiMatrixNormalizer::dispatchers()
+{
+  static const Dispatchers instance;
+  return instance;
+}
+
 void PiiMatrixNormalizer::check(bool reset)
 {
   PiiDefaultOperation::check(reset);
-  PII_D;
-  if (d->iOutputType < PiiYdin::CharMatrixType ||
-      d->iOutputType > PiiYdin::DoubleMatrixType)
+  if (!dispatchers().emitters.contains(_d()->iOutputType))
     throwOutputTypeError();
 }
 
 void PiiMatrixNormalizer::process()
 {
   PiiVariant obj = readInput();
-
-  switch (obj.type())
-    {
-      PII_NUMERIC_MATRIX_CASES(normalize, obj);
-    default:
-      PII_THROW_UNKNOWN_TYPE(inputAt(0));
-    }
+  NormalizeFunction pNormalize = dispatchers().normalizers[obj.type()];
+  if (pNormalize == 0)
+    PII_THROW_UNKNOWN_TYPE(inputAt(0));
+  (this->*pNormalize)(obj);
 }
 
 template <class T> void PiiMatrixNormalizer::normalize(const PiiVariant& obj)
@@ -83,13 +91,42 @@ template <class T> void PiiMatrixNormalizer::normalize(const PiiVariant& obj)
       postShift = d->dMean;
     }
 
+  if (normalizeFixed(mat, scale, preShift * scale + postShift, Pii::IsSaturable<T>()))
+    return;
+
   PiiMatrix<double> matNormalized(normalizeAs<double>(mat, preShift, scale, postShift));
-  switch (d->iOutputType)
+  EmitFunction pEmit = dispatchers().emitters[d->iOutputType];
+  if (pEmit == 0)
+    throwOutputTypeError();
+  (this->*pEmit)(matNormalized);
+}
+
+template <class T> bool PiiMatrixNormalizer::normalizeFixed(const PiiMatrix<T>& matrix,
+                                                             double scale,
+                                                             double offset,
+                                                             Pii::True)
+{
+  if (_d()->iOutputType != int(Pii::typeId<PiiMatrix<T> >()))
+    return false;
+
+  // The rounding error of the scale, multiplied by the largest input,
+  // must stay below half a unit. Thus, we need at least as many
+  // fractional bits as there are bits in the input. Use as many as
+  // possible without overflowing an int.
+  const double dMaxInput = qMax(-double(Pii::Numeric<T>::minValue()), double(Pii::Numeric<T>::maxValue()));
+  for (int iDecimals = 24; iDecimals >= int(sizeof(T)) * 8; --iDecimals)
     {
-      PII_NUMERIC_MATRIX_CASES(emitMatrix, matNormalized);
-    default:
-      throwOutputTypeError();
+      const double dUnit = double(1 << iDecimals);
+      if ((dMaxInput * Pii::abs(scale) + Pii::abs(offset) + 1) * dUnit < double(INT_MAX))
+        {
+          emitObject(PiiMatrix<T>(Pii::unaryMatrixTransform(matrix,
+                                                            Pii::FixedPointAffine<T>(Pii::round<int>(scale * dUnit),
+                                                                                     Pii::round<int>(offset * dUnit),
+                                                                                     iDecimals))));
+          return true;
+        }
     }
+  return false;
 }
 
 template <class T> PiiMatrix<double> PiiMatrixNormalizer::normalizeAs(const PiiMatrix<T>& matrix,
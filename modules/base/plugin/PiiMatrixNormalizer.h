@@ -17,6 +17,7 @@
 #define _PIIMATRIXNORMALIZER_H
 
 #include <PiiDefaultOperation.h>
+#include <PiiTypeDispatcher.h>
 #include <PiiMatrix.h>
 
 /**
@@ -64,6 +65,12 @@ class PiiMatrixNormalizer : public PiiDefaultOperation
    * The output type. See [PiiYdin::MatrixTypeId] for valid values.
    * Only numeric matrix types are allowed. The default is
    * `PiiYdin::DoubleMatrixType`.
+   *
+   * If the output type equals the type of an 8 or 16 bit integer
+   * input matrix, normalization is done in fixed point without
+   * converting the matrix to `double`, whenever the precision of the
+   * result allows it. In this case, the results are rounded to the
+   * nearest integer and saturated to the range of the type.
    */
   Q_PROPERTY(int outputType READ outputType WRITE setOutputType);
 
@@ -121,7 +128,20 @@ private:
   };
   PII_D_FUNC;
 
+  typedef void (PiiMatrixNormalizer::*NormalizeFunction)(const PiiVariant&);
+  typedef void (PiiMatrixNormalizer::*EmitFunction)(PiiMatrix<double>&);
+  // Function tables shared by all instances.
+  struct Dispatchers
+  {
+    Dispatchers();
+    PiiTypeDispatcher<NormalizeFunction> normalizers;
+    PiiTypeDispatcher<EmitFunction> emitters;
+  };
+  static const Dispatchers& dispatchers();
+
   template <class T> void normalize(const PiiVariant& obj);
+  template <class T> bool normalizeFixed(const PiiMatrix<T>& matrix, double scale, double offset, Pii::True);
+  template <class T> bool normalizeFixed(const PiiMatrix<T>&, double, double, Pii::False) { return false; }
   template <class T> PiiMatrix<double> normalizeAs(const PiiMatrix<T>& matrix,
                                                    double preShift,
                                                    double scale,
@@ -16,6 +16,8 @@
 #include "PiiMovingAverageOperation.h"
 #include <PiiYdinTypes.h>
 #include <PiiTypeTraits.h>
+#include <PiiGenericInputArchive.h>
+#include <PiiGenericOutputArchive.h>
 #include <complex>
 #include <PiiMath.h>
 
@@ -25,7 +27,8 @@ PiiMovingAverageOperation::Data::Data() :
   dRangeMax(0),
   dRange(0),
   uiType(PiiVariant::InvalidType),
-  bForceInputType(false)
+  bForceInputType(false),
+  iSumUpdates(0)
 {
 }
 
@@ -44,9 +47,39 @@ void PiiMovingAverageOperation::check(bool reset)
     {
       d->uiType = PiiVariant::InvalidType;
       d->lstBuffer.clear();
+      d->varSum = PiiVariant();
     }
 }
 
+void PiiMovingAverageOperation::saveState(PiiGenericOutputArchive& archive)
+{
+  PII_D;
+  archive << d->uiType;
+  const int iCount = d->lstBuffer.size();
+  archive << iCount;
+  for (QLinkedList<PiiVariant>::const_iterator i = d->lstBuffer.constBegin(); i != d->lstBuffer.constEnd(); ++i)
+    archive << *i;
+  archive << d->varSum;
+  archive << d->iSumUpdates;
+}
+
+void PiiMovingAverageOperation::loadState(PiiGenericInputArchive& archive)
+{
+  PII_D;
+  archive >> d->uiType;
+  int iCount;
+  archive >> iCount;
+  d->lstBuffer.clear();
+  for (int i=0; i<iCount; ++i)
+    {
+      PiiVariant obj;
+      archive >> obj;
+      d->lstBuffer << obj;
+    }
+  archive >> d->varSum;
+  archive >> d->iSumUpdates;
+}
+
 void PiiMovingAverageOperation::process()
 {
   PiiVariant obj = readInput();
@@ -79,9 +112,141 @@ template <class T> void PiiMovingAverageOperation::average(const PiiVariant& obj
 {
   averageTemplate<T, typename AverageTraits<T>::Type>(obj);
 }
+
+// Matrices are summed into accumulators of this type. Integer pixels
+// are summed exactly, and the sum never needs to be recalculated.
+template <class T> struct SumTraits
+{
+  typedef typename AverageTraits<T>::Type Type;
+  enum { exact = false };
+};
+template <class T> struct IntSumTraits
+{
+  typedef T Type;
+  enum { exact = true };
+};
+template <> struct SumTraits<char> : IntSumTraits<int> {};
+template <> struct SumTraits<unsigned char> : IntSumTraits<int> {};
+template <> struct SumTraits<short> : IntSumTraits<int> {};
+template <> struct SumTraits<unsigned short> : IntSumTraits<int> {};
+template <> struct SumTraits<int> : IntSumTraits<qint64> {};
+template <> struct SumTraits<unsigned int> : IntSumTraits<qint64> {};
+
+// The type of the scale factor that turns a sum into an average.
+template <class T> struct ScaleTraits { typedef T Type; };
+template <class T> struct ScaleTraits<std::complex<T> > { typedef T Type; };
+
+template <class S, class T> static void addToSum(PiiMatrix<S>& sum, const PiiMatrix<T>& added)
+{
+  const int iRows = sum.rows(), iColumns = sum.columns();
+  for (int r=0; r<iRows; ++r)
+    {
+      S* pSum = sum.row(r);
+      const T* pAdded = added.row(r);
+      for (int c=0; c<iColumns; ++c)
+        pSum[c] += S(pAdded[c]);
+    }
+}
+
+template <class S, class T> static void updateSum(PiiMatrix<S>& sum,
+                                                  const PiiMatrix<T>& added,
+                                                  const PiiMatrix<T>& removed)
+{
+  const int iRows = sum.rows(), iColumns = sum.columns();
+  for (int r=0; r<iRows; ++r)
+    {
+      S* pSum = sum.row(r);
+      const T* pAdded = added.row(r), *pRemoved = removed.row(r);
+      for (int c=0; c<iColumns; ++c)
+        pSum[c] += S(pAdded[c]) - S(pRemoved[c]);
+    }
+}
+
+// Converts *sum* to an average of *count* objects in one pass. The
+// average is calculated as AverageType and then converted to R.
+template <class R, class AverageType, class S> static PiiMatrix<R> scaledSum(const PiiMatrix<S>& sum, int count)
+{
+  const int iRows = sum.rows(), iColumns = sum.columns();
+  PiiMatrix<R> result(PiiMatrix<R>::uninitialized(iRows, iColumns));
+  // Multiplying by 1/count may round an exact integer average one
+  // step down (e.g. 41 * (1/41.0f) < 1), which truncates to the next
+  // smaller integer.
+  const typename ScaleTraits<AverageType>::Type divisor(count);
+  for (int r=0; r<iRows; ++r)
+    {
+      const S* pSum = sum.row(r);
+      R* pResult = result.row(r);
+      for (int c=0; c<iColumns; ++c)
+        pResult[c] = R(AverageType(pSum[c]) / divisor);
+    }
+  return result;
+}
+
 template <class T> void PiiMovingAverageOperation::matrixAverage(const PiiVariant& obj)
 {
-  averageTemplate<PiiMatrix<T>, typename AverageTraits<PiiMatrix<T> >::Type>(obj);
+  typedef typename AverageTraits<T>::Type AverageType;
+  typedef typename SumTraits<T>::Type SumType;
+  PII_D;
+  const PiiMatrix<T> matAdded(obj.valueAs<PiiMatrix<T> >());
+  if (d->lstBuffer.isEmpty())
+    {
+      d->varSum = PiiVariant();
+      d->lstBuffer << obj;
+      if (d->bForceInputType)
+        d->lstOutputs[0]->emitObject(matAdded);
+      else
+        d->lstOutputs[0]->emitObject(PiiMatrix<AverageType>(matAdded));
+      d->uiType = Pii::typeId<PiiMatrix<T> >();
+      return;
+    }
+
+  if (obj.type() != d->uiType)
+    PII_THROW(PiiExecutionException, tr("Cannot average objects of different type."));
+  const PiiMatrix<T> matFirst(d->lstBuffer.first().valueAs<PiiMatrix<T> >());
+  if (matAdded.rows() != matFirst.rows() || matAdded.columns() != matFirst.columns())
+    PII_THROW(PiiExecutionException, tr("Cannot average matrices of different size."));
+
+  // The buffer only holds references to the input frames. Nothing is
+  // copied.
+  d->lstBuffer << obj;
+  PiiVariant removed;
+  int iRemoved = 0;
+  while (d->lstBuffer.size() > d->iWindowSize)
+    {
+      removed = d->lstBuffer.takeFirst();
+      ++iRemoved;
+    }
+
+  // Floating-point sums are recalculated once per window to keep
+  // rounding errors from accumulating. Integer sums are exact. A
+  // restored sum of another type is recalculated as well.
+  if (!d->varSum.isValid() ||
+      d->varSum.type() != Pii::typeId<PiiMatrix<SumType> >() ||
+      iRemoved > 1 ||
+      (!SumTraits<T>::exact && ++d->iSumUpdates >= d->iWindowSize))
+    {
+      PiiMatrix<SumType> matSum(matAdded.rows(), matAdded.columns());
+      for (QLinkedList<PiiVariant>::const_iterator i = d->lstBuffer.constBegin(); i != d->lstBuffer.constEnd(); ++i)
+        addToSum(matSum, i->valueAs<PiiMatrix<T> >());
+      d->varSum = PiiVariant(matSum);
+      d->iSumUpdates = 0;
+    }
+  else
+    {
+      // Add the new frame and subtract the removed one in a single
+      // pass over the sum.
+      PiiMatrix<SumType>& matSum = d->varSum.valueAs<PiiMatrix<SumType> >();
+      if (iRemoved == 1)
+        updateSum(matSum, matAdded, removed.valueAs<PiiMatrix<T> >());
+      else
+        addToSum(matSum, matAdded);
+    }
+
+  const PiiMatrix<SumType>& matSum = d->varSum.valueAs<PiiMatrix<SumType> >();
+  if (d->bForceInputType)
+    d->lstOutputs[0]->emitObject(scaledSum<T,AverageType>(matSum, d->lstBuffer.size()));
+  else
+    d->lstOutputs[0]->emitObject(scaledSum<AverageType,AverageType>(matSum, d->lstBuffer.size()));
 }
 
 template <class T, class ResultType> void PiiMovingAverageOperation::averageTemplate(const PiiVariant& obj)
@@ -89,6 +254,7 @@ template <class T, class ResultType> void PiiMovingAverageOperation::averageTemp
   PII_D;
   if (d->lstBuffer.isEmpty())
     {
+      d->varSum = PiiVariant();
       d->lstBuffer << obj;
       if ( d->bForceInputType )
         d->lstOutputs[0]->emitObject(obj.valueAs<T>());
@@ -107,16 +273,36 @@ template <class T, class ResultType> void PiiMovingAverageOperation::averageTemp
   // Add the object to the buffer, and remove the first one if window
   // size is exceeded.
   d->lstBuffer << obj;
+  PiiVariant removed;
+  int iRemoved = 0;
   while (d->lstBuffer.size() > d->iWindowSize)
-    d->lstBuffer.removeFirst();
+    {
+      removed = d->lstBuffer.takeFirst();
+      ++iRemoved;
+    }
 
-  // Calculate average
-  int index = 0;
-  QLinkedList<PiiVariant>::iterator i = d->lstBuffer.begin();
-  ResultType result((*i).valueAs<T>());
-  i++, index++;
-  try
+  ResultType result;
+  // Circular ranges need to be averaged sequentially. Otherwise, a
+  // running sum gives the average in constant time.
+  if (d->dRange == 0 || !Pii::IsPrimitive<T>::boolValue)
+    {
+      try
+        {
+          result = runningSum<T,ResultType>(obj, removed, iRemoved);
+        }
+      catch (PiiException&)
+        {
+          d->varSum = PiiVariant();
+          PII_THROW(PiiExecutionException, tr("Cannot average matrices of different size."));
+        }
+    }
+  else
     {
+      // Calculate average
+      int index = 0;
+      QLinkedList<PiiVariant>::iterator i = d->lstBuffer.begin();
+      result = ResultType((*i).valueAs<T>());
+      i++, index++;
       while (i != d->lstBuffer.end())
         {
           // Same type -> no conversion
@@ -128,10 +314,6 @@ template <class T, class ResultType> void PiiMovingAverageOperation::averageTemp
           i++, index++;;
         }
     }
-  catch (PiiMathException&)
-    {
-      PII_THROW(PiiExecutionException, tr("Cannot average matrices of different size."));
-    }
 
   scale(result, d->lstBuffer.size());
 
@@ -141,6 +323,34 @@ template <class T, class ResultType> void PiiMovingAverageOperation::averageTemp
     emitObject(result);
 }
 
+template <class T, class ResultType>
+ResultType PiiMovingAverageOperation::runningSum(const PiiVariant& added, const PiiVariant& removed, int removedCount)
+{
+  PII_D;
+  // The sum is recalculated once per window to keep rounding errors
+  // from accumulating. A sum of another type, e.g. one restored from
+  // a saved state, is recalculated as well.
+  if (!d->varSum.isValid() ||
+      d->varSum.type() != Pii::typeId<ResultType>() ||
+      removedCount > 1 ||
+      ++d->iSumUpdates >= d->iWindowSize)
+    {
+      QLinkedList<PiiVariant>::iterator i = d->lstBuffer.begin();
+      ResultType sum((*i).valueAs<T>());
+      for (++i; i != d->lstBuffer.end(); ++i)
+        sum += ResultType((*i).valueAs<T>());
+      d->varSum = PiiVariant(sum);
+      d->iSumUpdates = 0;
+      return sum;
+    }
+
+  ResultType& sum = d->varSum.valueAs<ResultType>();
+  sum += ResultType(added.valueAs<T>());
+  if (removedCount == 1)
+    sum -= ResultType(removed.valueAs<T>());
+  return sum;
+}
+
 template <class T> void PiiMovingAverageOperation::addImpl(T& op1, T op2, int index)
 {
   PII_D;
@@ -46,7 +46,10 @@ class PiiMovingAverageOperation : public PiiDefaultOperation
   /**
    * The size of the averaging window. Note that the operation buffers
    * this many past values. If large matrices are averaged, a large
-   * portion of memory may be reserved. The default value is two (2).
+   * portion of memory may be reserved. Unless the values are handled
+   * circularly (see [rangeMin]), the average is updated with a
+   * running sum, and the time it takes does not depend on the window
+   * size. The default value is two (2).
    */
   Q_PROPERTY(int windowSize READ windowSize WRITE setWindowSize);
   /**
@@ -86,6 +89,8 @@ public:
 protected:
   void process();
   void check(bool reset);
+  void saveState(PiiGenericOutputArchive& archive);
+  void loadState(PiiGenericInputArchive& archive);
 
 private:
   /// @internal
@@ -100,12 +105,19 @@ private:
     unsigned int uiType;
     QLinkedList<PiiVariant> lstBuffer;
     bool bForceInputType;
+    // Sum of the objects in lstBuffer and the number of updates since
+    // it was last recalculated.
+    PiiVariant varSum;
+    int iSumUpdates;
   };
   PII_D_FUNC;
 
   template <class T> void average(const PiiVariant& obj);
   template <class T> void matrixAverage(const PiiVariant& obj);
   template <class T, class ResultType> void averageTemplate(const PiiVariant& obj);
+  template <class T, class ResultType> ResultType runningSum(const PiiVariant& added,
+                                                             const PiiVariant& removed,
+                                                             int removedCount);
   template <class T> void addImpl(T& op1, T op2, int index);
   template <class T> void scaleImpl(T& result, int cnt);
   template <class T> void add(T& op1, const T& op2, int index);
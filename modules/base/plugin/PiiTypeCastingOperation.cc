@@ -33,89 +33,83 @@ PiiTypeCastingOperation::PiiTypeCastingOperation() :
 {
   addSocket(new PiiInputSocket("input"));
   addSocket(new PiiOutputSocket("output"));
+  updateCasters();
 }
 
 PiiTypeCastingOperation::~PiiTypeCastingOperation()
 {
 }
 
-void PiiTypeCastingOperation::process()
+template <class T> struct PiiTypeCastingOperation::Caster
 {
-  PiiVariant obj = readInput();
-
-  switch (obj.type())
-    {
-      PII_NUMERIC_MATRIX_CASES(operate, obj);
-    case FloatComplexMatrixType:
-      operateC<std::complex<float> >(obj);
-      break;
-    case DoubleComplexMatrixType:
-      operateC<std::complex<double> >(obj);
-      break;
-      /*case LongDoubleComplexMatrixType:
-      operateC<std::complex<long double> >(obj);
-      break;*/
-
-      PII_COLOR_IMAGE_CASES(operateCI, obj);
-    default:
-      PII_THROW_UNKNOWN_TYPE(inputAt(0));
-    }
+  template <class U> static PiiVariant matrix(const PiiVariant& obj)
+  {
+    return operateMatrix<T>(obj.valueAs<PiiMatrix<U> >());
+  }
+
+  template <class U> static PiiVariant complexToReal(const PiiVariant& obj)
+  {
+    return operateComplex<T>(obj.valueAs<PiiMatrix<U> >());
+  }
+
+  template <class U> static PiiVariant colorToGray(const PiiVariant& obj)
+  {
+    return operateColorToGray<T>(obj.valueAs<PiiMatrix<U> >());
+  }
+};
+
+template <class T> void PiiTypeCastingOperation::setNumericCasters()
+{
+  PII_D;
+  PII_NUMERIC_MATRIX_DISPATCH(d->casters, &Caster<T>::template matrix);
+  PII_COMPLEX_MATRIX_DISPATCH(d->casters, &Caster<T>::template complexToReal);
+  PII_COLOR_IMAGE_DISPATCH(d->casters, &Caster<T>::template colorToGray);
 }
 
-template <class T> void PiiTypeCastingOperation::operate(const PiiVariant& obj)
+template <class T> void PiiTypeCastingOperation::setComplexCasters()
 {
-  PiiMatrix<T> matrix(obj.valueAs<PiiMatrix<T> >());
+  PII_D;
+  PII_NUMERIC_MATRIX_DISPATCH(d->casters, &Caster<T>::template matrix);
+  PII_COMPLEX_MATRIX_DISPATCH(d->casters, &Caster<T>::template matrix);
+}
 
-  switch (_d()->outputType)
+void PiiTypeCastingOperation::updateCasters()
+{
+  PII_D;
+  d->casters.clear();
+  // Unknown output types leave the table empty. All input types will
+  // then be rejected.
+  switch (d->outputType)
     {
-      PII_NUMERIC_MATRIX_CASES(operateMatrix, matrix);
-      PII_COMPLEX_MATRIX_CASES(operateMatrix, matrix);
-      //PII_COLOR_IMAGE_CASES(operateMatrix, matrix);
-    default:
-      PII_THROW_UNKNOWN_TYPE(inputAt(0));
+      PII_NUMERIC_MATRIX_CASES(setNumericCasters, );
+      PII_COMPLEX_MATRIX_CASES(setComplexCasters, );
     }
 }
 
-template <class T> void PiiTypeCastingOperation::operateC(const PiiVariant& obj)
+void PiiTypeCastingOperation::process()
 {
-  PiiMatrix<T> matrix(obj.valueAs<PiiMatrix<T> >());
-
-  switch (_d()->outputType)
-    {
-      PII_NUMERIC_MATRIX_CASES(operateComplex, matrix);
-    case FloatComplexMatrixType:
-      operateMatrix<std::complex<float> >(matrix);
-      break;
-    case DoubleComplexMatrixType:
-      operateMatrix<std::complex<double> >(matrix);
-      break;
-      /*case LongDoubleComplexMatrixType:
-      operateMatrix<std::complex<long double> >(matrix);
-      break;*/
-    default:
-      PII_THROW_UNKNOWN_TYPE(inputAt(0));
-    }
+  emitObject(transform(readInput()));
 }
 
-template <class T> void PiiTypeCastingOperation::operateCI( const PiiVariant& obj )
+bool PiiTypeCastingOperation::isFusible() const
 {
-  PiiMatrix<T> matrix(obj.valueAs<PiiMatrix<T> >());
+  return true;
+}
 
-  switch (_d()->outputType)
-    {
-      PII_NUMERIC_MATRIX_CASES(operateColorToGray, matrix);
-      //PII_COLOR_IMAGE_CASES(operateMatrix, matrix);
-    default:
-      PII_THROW_UNKNOWN_TYPE(inputAt(0));
-    }
+PiiVariant PiiTypeCastingOperation::transform(const PiiVariant& obj)
+{
+  CastFunction pCast = _d()->casters[obj.type()];
+  if (pCast == 0)
+    PII_THROW_UNKNOWN_TYPE(inputAt(0));
+  return pCast(obj);
 }
 
-template <class T, class U> void PiiTypeCastingOperation::operateMatrix(const PiiMatrix<U>& matrix)
+template <class T, class U> PiiVariant PiiTypeCastingOperation::operateMatrix(const PiiMatrix<U>& matrix)
 {
-  emitObject(PiiMatrix<T>(matrix));
+  return PiiVariant(PiiMatrix<T>(matrix));
 }
 
-template <class T, class U> void PiiTypeCastingOperation::operateComplex(const PiiMatrix<U>& matrix)
+template <class T, class U> PiiVariant PiiTypeCastingOperation::operateComplex(const PiiMatrix<U>& matrix)
 {
   PiiMatrix<T> matResult(matrix.rows(), matrix.columns());
   T* ptrr;
@@ -129,10 +123,10 @@ template <class T, class U> void PiiTypeCastingOperation::operateComplex(const P
         ptrr[c] = T(ptrm[c].real());
     }
 
-  emitObject(matResult);
+  return PiiVariant(matResult);
 }
 
-template <class T, class U> void PiiTypeCastingOperation::operateColorToGray(const PiiMatrix<U>& matrix)
+template <class T, class U> PiiVariant PiiTypeCastingOperation::operateColorToGray(const PiiMatrix<U>& matrix)
 {
   PiiMatrix<T> matResult(matrix.rows(), matrix.columns());
   T* ptrr;
@@ -149,8 +143,12 @@ template <class T, class U> void PiiTypeCastingOperation::operateColorToGray(con
         }
     }
 
-  emitObject(matResult);
+  return PiiVariant(matResult);
 }
 
 int PiiTypeCastingOperation::outputType() const { return _d()->outputType; }
-void PiiTypeCastingOperation::setOutputType(int outputType) { _d()->outputType = outputType; }
+void PiiTypeCastingOperation::setOutputType(int outputType)
+{
+  _d()->outputType = outputType;
+  updateCasters();
+}
@@ -17,6 +17,8 @@
 #define _PIITYPECASTINGOPERATION_H
 
 #include <PiiDefaultOperation.h>
+#include <PiiFusibleOperation.h>
+#include <PiiTypeDispatcher.h>
 #include <QPair>
 #include <PiiMatrix.h>
 
@@ -33,10 +35,13 @@
  *
  * @out output - a matrix whose type is specified by [outputType].
  *
+ * The operation can be fused with other element-wise operations (see
+ * PiiFusibleOperation).
  */
-class PiiTypeCastingOperation : public PiiDefaultOperation
+class PiiTypeCastingOperation : public PiiDefaultOperation, public PiiFusibleOperation
 {
   Q_OBJECT
+  Q_INTERFACES(PiiFusibleOperation)
 
   /**
    * The type id of the output. See PiiYdinTypes for valid type id
@@ -49,6 +54,9 @@ public:
   PiiTypeCastingOperation();
   ~PiiTypeCastingOperation();
 
+  bool isFusible() const;
+  PiiVariant transform(const PiiVariant& obj);
+
 protected:
   void process();
 
@@ -56,6 +64,8 @@ protected:
   void setOutputType(int outputType);
 
 private:
+  typedef PiiVariant (*CastFunction)(const PiiVariant&);
+
   /// @internal
   class Data : public PiiDefaultOperation::Data
   {
@@ -63,15 +73,21 @@ private:
     Data();
 
     int outputType;
+    // Cast functions for the current output type, indexed by the
+    // input type.
+    PiiTypeDispatcher<CastFunction> casters;
   };
   PII_D_FUNC;
 
-  template <class T> void operate( const PiiVariant& obj );
-  template <class T> void operateC( const PiiVariant& obj );
-  template <class T> void operateCI( const PiiVariant& obj );
-  template <class T, class U> void operateMatrix( const PiiMatrix<U>& matrix );
-  template <class T, class U> void operateComplex( const PiiMatrix<U>& matrix );
-  template <class T, class U> void operateColorToGray( const PiiMatrix<U>& matrix );
+  template <class T> struct Caster;
+  template <class T> friend struct Caster;
+
+  void updateCasters();
+  template <class T> void setNumericCasters();
+  template <class T> void setComplexCasters();
+  template <class T, class U> static PiiVariant operateMatrix( const PiiMatrix<U>& matrix );
+  template <class T, class U> static PiiVariant operateComplex( const PiiMatrix<U>& matrix );
+  template <class T, class U> static PiiVariant operateColorToGray( const PiiMatrix<U>& matrix );
 };
 
 #endif //_PIITYPECASTINGOPERATION_H
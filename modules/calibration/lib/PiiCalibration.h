@@ -539,7 +539,8 @@ namespace PiiCalibration
    * creates an undistortion map with undistortMap() and then applies
    * PiiImage::remap(). If you need to repeat the process for many
    * images, it is more efficient to calculate the undistortion map
-   * once and then apply it to all images.
+   * once, convert it to a PiiImage::RemapTable, and then apply it to
+   * all images.
    *
    * @param sourceImage the input image
    *
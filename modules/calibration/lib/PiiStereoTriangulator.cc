@@ -14,8 +14,144 @@
  */
 
 #include "PiiStereoTriangulator.h"
+#include <PiiCpu.h>
 #include <QCoreApplication>
 
+namespace
+{
+  bool useSse2()
+  {
+#if defined(PII_X86_SIMD)
+    return Pii::hasCpuFeatures(Pii::Sse2CpuFeature);
+#else
+    return false;
+#endif
+  }
+
+  /* Triangulates the rays through normalized points A = (xA, yA, 1)
+   * in camera 1 and B = (xB, yB, 1) in camera 2 (X2 = R X1 + T). The
+   * depths of the closest points on the rays are solved from a 2-by-2
+   * linear system, and the mean of the two points is transformed to
+   * the frame of the first camera (X0 = R0 (X1 - T0)). Coordinates are
+   * stored in separate arrays so that points can be processed
+   * side by side in SIMD registers.
+   *
+   * Ported from the camera calibration toolbox by Jean-Yves Bouguet.
+   */
+  void triangulatePoints(const double* R, const double* T,
+                         const double* R0, const double* T0,
+                         const double* xA, const double* yA,
+                         const double* xB, const double* yB,
+                         int start, int count,
+                         double* x, double* y, double* z)
+  {
+    for (int i=start; i<count; ++i)
+      {
+        // U = A in the frame of camera 2
+        const double dU0 = R[0]*xA[i] + R[1]*yA[i] + R[2],
+          dU1 = R[3]*xA[i] + R[4]*yA[i] + R[5],
+          dU2 = R[6]*xA[i] + R[7]*yA[i] + R[8];
+
+        const double dNorm2A = xA[i]*xA[i] + yA[i]*yA[i] + 1.0,
+          dNorm2B = xB[i]*xB[i] + yB[i]*yB[i] + 1.0,
+          dDotUB = dU0*xB[i] + dU1*yB[i] + dU2,
+          dDotUT = dU0*T[0] + dU1*T[1] + dU2*T[2],
+          dDotBT = xB[i]*T[0] + yB[i]*T[1] + T[2];
+
+        const double dDD = dNorm2A*dNorm2B - dDotUB*dDotUB,
+          dZA = (dDotUB*dDotBT - dNorm2B*dDotUT) / dDD,
+          dZB = (dNorm2A*dDotBT - dDotUT*dDotUB) / dDD;
+
+        // X2 = R^T (B zB - T), back in the frame of camera 1
+        const double dB0 = xB[i]*dZB - T[0], dB1 = yB[i]*dZB - T[1], dB2 = dZB - T[2];
+        // Mean of the two estimates, relative to T0
+        const double dX = 0.5 * (xA[i]*dZA + R[0]*dB0 + R[3]*dB1 + R[6]*dB2) - T0[0],
+          dY = 0.5 * (yA[i]*dZA + R[1]*dB0 + R[4]*dB1 + R[7]*dB2) - T0[1],
+          dZ = 0.5 * (dZA + R[2]*dB0 + R[5]*dB1 + R[8]*dB2) - T0[2];
+
+        x[i] = R0[0]*dX + R0[1]*dY + R0[2]*dZ;
+        y[i] = R0[3]*dX + R0[4]*dY + R0[5]*dZ;
+        z[i] = R0[6]*dX + R0[7]*dY + R0[8]*dZ;
+      }
+  }
+
+#ifdef PII_X86_SIMD
+  /* The same as triangulatePoints(), two points at a time. Returns the
+   * index of the first point that was not processed.
+   */
+  PII_CPU_TARGET("sse2")
+  int triangulatePointsSse2(const double* R, const double* T,
+                            const double* R0, const double* T0,
+                            const double* xA, const double* yA,
+                            const double* xB, const double* yB,
+                            int count,
+                            double* x, double* y, double* z)
+  {
+    __m128d aR[9], aR0[9], aT[3], aT0[3];
+    for (int i=0; i<9; ++i)
+      {
+        aR[i] = _mm_set1_pd(R[i]);
+        aR0[i] = _mm_set1_pd(R0[i]);
+      }
+    for (int i=0; i<3; ++i)
+      {
+        aT[i] = _mm_set1_pd(T[i]);
+        aT0[i] = _mm_set1_pd(T0[i]);
+      }
+    const __m128d one = _mm_set1_pd(1.0), half = _mm_set1_pd(0.5);
+
+    int i = 0;
+    for (; i<=count-2; i+=2)
+      {
+        const __m128d xa = _mm_loadu_pd(xA + i), ya = _mm_loadu_pd(yA + i),
+          xb = _mm_loadu_pd(xB + i), yb = _mm_loadu_pd(yB + i);
+
+        const __m128d u0 = _mm_add_pd(_mm_add_pd(_mm_mul_pd(aR[0], xa), _mm_mul_pd(aR[1], ya)), aR[2]),
+          u1 = _mm_add_pd(_mm_add_pd(_mm_mul_pd(aR[3], xa), _mm_mul_pd(aR[4], ya)), aR[5]),
+          u2 = _mm_add_pd(_mm_add_pd(_mm_mul_pd(aR[6], xa), _mm_mul_pd(aR[7], ya)), aR[8]);
+
+        const __m128d norm2A = _mm_add_pd(_mm_add_pd(_mm_mul_pd(xa, xa), _mm_mul_pd(ya, ya)), one),
+          norm2B = _mm_add_pd(_mm_add_pd(_mm_mul_pd(xb, xb), _mm_mul_pd(yb, yb)), one),
+          dotUB = _mm_add_pd(_mm_add_pd(_mm_mul_pd(u0, xb), _mm_mul_pd(u1, yb)), u2),
+          dotUT = _mm_add_pd(_mm_add_pd(_mm_mul_pd(u0, aT[0]), _mm_mul_pd(u1, aT[1])), _mm_mul_pd(u2, aT[2])),
+          dotBT = _mm_add_pd(_mm_add_pd(_mm_mul_pd(xb, aT[0]), _mm_mul_pd(yb, aT[1])), aT[2]);
+
+        const __m128d dd = _mm_sub_pd(_mm_mul_pd(norm2A, norm2B), _mm_mul_pd(dotUB, dotUB)),
+          za = _mm_div_pd(_mm_sub_pd(_mm_mul_pd(dotUB, dotBT), _mm_mul_pd(norm2B, dotUT)), dd),
+          zb = _mm_div_pd(_mm_sub_pd(_mm_mul_pd(norm2A, dotBT), _mm_mul_pd(dotUT, dotUB)), dd);
+
+        const __m128d b0 = _mm_sub_pd(_mm_mul_pd(xb, zb), aT[0]),
+          b1 = _mm_sub_pd(_mm_mul_pd(yb, zb), aT[1]),
+          b2 = _mm_sub_pd(zb, aT[2]);
+
+        const __m128d px = _mm_sub_pd(_mm_mul_pd(half, _mm_add_pd(_mm_add_pd(_mm_add_pd(_mm_mul_pd(xa, za),
+                                                                                        _mm_mul_pd(aR[0], b0)),
+                                                                             _mm_mul_pd(aR[3], b1)),
+                                                                  _mm_mul_pd(aR[6], b2))),
+                                      aT0[0]),
+          py = _mm_sub_pd(_mm_mul_pd(half, _mm_add_pd(_mm_add_pd(_mm_add_pd(_mm_mul_pd(ya, za),
+                                                                            _mm_mul_pd(aR[1], b0)),
+                                                                 _mm_mul_pd(aR[4], b1)),
+                                                      _mm_mul_pd(aR[7], b2))),
+                          aT0[1]),
+          pz = _mm_sub_pd(_mm_mul_pd(half, _mm_add_pd(_mm_add_pd(_mm_add_pd(za,
+                                                                            _mm_mul_pd(aR[2], b0)),
+                                                                 _mm_mul_pd(aR[5], b1)),
+                                                      _mm_mul_pd(aR[8], b2))),
+                          aT0[2]);
+
+        _mm_storeu_pd(x + i, _mm_add_pd(_mm_add_pd(_mm_mul_pd(aR0[0], px), _mm_mul_pd(aR0[1], py)),
+                                        _mm_mul_pd(aR0[2], pz)));
+        _mm_storeu_pd(y + i, _mm_add_pd(_mm_add_pd(_mm_mul_pd(aR0[3], px), _mm_mul_pd(aR0[4], py)),
+                                        _mm_mul_pd(aR0[5], pz)));
+        _mm_storeu_pd(z + i, _mm_add_pd(_mm_add_pd(_mm_mul_pd(aR0[6], px), _mm_mul_pd(aR0[7], py)),
+                                        _mm_mul_pd(aR0[8], pz)));
+      }
+    return i;
+  }
+#endif
+}
+
 QString PiiStereoTriangulator::tr(const char* message)
 {
   return QCoreApplication::translate("PiiStereoTriangulator", message);
@@ -46,9 +182,155 @@ void PiiStereoTriangulator::addCamera(const PiiCalibration::CameraParameters& in
   for (int i=0; i<d->lstRelativePositions.size(); i++)
     d->lstRelativePositions[i] << PiiCalibration::calculateRelativePosition(d->lstRelativePositions[i][0], extrinsic);
   d->lstRelativePositions << (QList<PiiCalibration::RelativePosition>() << extrinsic);
+
+  // Precompute the geometry of all camera pairs.
+  d->vecPairs.clear();
+  const int iCameras = d->lstCameraParameters.size();
+  for (int c1=0; c1<iCameras; ++c1)
+    {
+      for (int c2=c1+1; c2<iCameras; ++c2)
+        {
+          Data::PairGeometry pair;
+          pair.iCamera1 = c1;
+          pair.iCamera2 = c2;
+          const PiiCalibration::RelativePosition& relative = d->lstRelativePositions[c1][c2-c1];
+          const PiiMatrix<double> matRotation(PiiCalibration::rotationVectorToMatrix(relative.rotation));
+          // Triangulated points are in c1's reference frame. If c1 is
+          // not the first camera, they need to be converted to its
+          // coordinate frame to ensure the summed points are all in
+          // the same coordinate system.
+          PiiMatrix<double> matFirstRotation(PiiMatrix<double>::identity(3));
+          PiiVector<double,3> vecFirstTranslation(0.0, 0.0, 0.0);
+          if (c1 != 0)
+            {
+              matFirstRotation = Pii::transpose(d->lstRelativePositions[0][c1].rotationMatrix());
+              vecFirstTranslation = d->lstRelativePositions[0][c1].translation;
+            }
+          for (int i=0; i<3; ++i)
+            {
+              pair.adTranslation[i] = relative.translation.values[i];
+              pair.adFirstTranslation[i] = vecFirstTranslation.values[i];
+              for (int j=0; j<3; ++j)
+                {
+                  pair.adRotation[i*3 + j] = matRotation(i,j);
+                  pair.adFirstRotation[i*3 + j] = matFirstRotation(i,j);
+                }
+            }
+          d->vecPairs << pair;
+        }
+    }
 }
 
+class PiiStereoTriangulator::TriangulationBand
+{
+public:
+  TriangulationBand(const Data* data,
+                    const QList<PiiMatrix<double> >& imagePoints,
+                    PiiMatrix<double>& result) :
+    d(data),
+    imagePoints(imagePoints),
+    resultRows(result)
+  {}
+
+  void operator() (int firstRow, int rowCount) const
+  {
+    const int iCameras = d->lstCameraParameters.size();
+    // Normalized x and y coordinates of each view in separate arrays
+    QVector<double> vecNormalized(2 * iCameras * rowCount);
+    for (int i=0; i<iCameras; ++i)
+      {
+        double* pX = vecNormalized.data() + 2 * i * rowCount, *pY = pX + rowCount;
+        const PiiMatrix<double>& matPoints = imagePoints[i];
+        for (int r=0; r<rowCount; ++r)
+          {
+            const double* pPoint = matPoints[firstRow + r];
+            // Missing points stay missing without iterating.
+            if (Pii::isNan(pPoint[0]) || Pii::isNan(pPoint[1]))
+              pX[r] = pY[r] = NAN;
+            else
+              PiiCalibration::undistort(d->lstCameraParameters[i], pPoint[0], pPoint[1], pX + r, pY + r);
+          }
+      }
+
+    QVector<double> vecPoints(3 * rowCount);
+    double* pX = vecPoints.data(), *pY = pX + rowCount, *pZ = pY + rowCount;
+    QVector<int> vecValidPairs(rowCount, 0);
+    const bool bSimd = useSse2();
+
+    // Go through all possible camera pairings
+    for (int p=0; p<d->vecPairs.size(); ++p)
+      {
+        const Data::PairGeometry& pair = d->vecPairs[p];
+        const double* pA = vecNormalized.constData() + 2 * pair.iCamera1 * rowCount;
+        const double* pB = vecNormalized.constData() + 2 * pair.iCamera2 * rowCount;
+        int iStart = 0;
+#ifdef PII_X86_SIMD
+        if (bSimd)
+          iStart = triangulatePointsSse2(pair.adRotation, pair.adTranslation,
+                                         pair.adFirstRotation, pair.adFirstTranslation,
+                                         pA, pA + rowCount, pB, pB + rowCount,
+                                         rowCount, pX, pY, pZ);
+#else
+        Q_UNUSED(bSimd);
+#endif
+        triangulatePoints(pair.adRotation, pair.adTranslation,
+                          pair.adFirstRotation, pair.adFirstTranslation,
+                          pA, pA + rowCount, pB, pB + rowCount,
+                          iStart, rowCount, pX, pY, pZ);
+
+        // Add successfully triangulated points to the result
+        for (int r=0; r<rowCount; ++r)
+          {
+            if (!Pii::isNan(pX[r] + pY[r] + pZ[r]))
+              {
+                double* pResultRow = resultRows.row(firstRow + r);
+                // Copy the first point (NAN + x = NAN)
+                if (vecValidPairs[r] == 0)
+                  {
+                    pResultRow[0] = pX[r];
+                    pResultRow[1] = pY[r];
+                    pResultRow[2] = pZ[r];
+                  }
+                else
+                  {
+                    pResultRow[0] += pX[r];
+                    pResultRow[1] += pY[r];
+                    pResultRow[2] += pZ[r];
+                  }
+                ++vecValidPairs[r];
+              }
+          }
+      }
+
+    // Divide by the total number of valid pairings to get the mean
+    // of all pairwise estimates.
+    for (int r=0; r<rowCount; ++r)
+      {
+        double* pResultRow = resultRows.row(firstRow + r);
+        if (vecValidPairs[r] == 0)
+          pResultRow[0] = pResultRow[1] = pResultRow[2] = NAN;
+        else if (vecValidPairs[r] > 1)
+          {
+            pResultRow[0] /= vecValidPairs[r];
+            pResultRow[1] /= vecValidPairs[r];
+            pResultRow[2] /= vecValidPairs[r];
+          }
+      }
+  }
+
+private:
+  const Data* d;
+  const QList<PiiMatrix<double> >& imagePoints;
+  const Pii::BandRows<double> resultRows;
+};
+
 PiiMatrix<double> PiiStereoTriangulator::calculate3DPoints(const QList<PiiMatrix<double> >& imagePoints)
+{
+  return calculate3DPoints(Pii::ParallelExecution(1), imagePoints);
+}
+
+PiiMatrix<double> PiiStereoTriangulator::calculate3DPoints(const Pii::ParallelExecution& policy,
+                                                           const QList<PiiMatrix<double> >& imagePoints)
 {
   if (imagePoints.size() != d->lstCameraParameters.size())
     PII_THROW(PiiCalibrationException,
@@ -59,8 +341,6 @@ PiiMatrix<double> PiiStereoTriangulator::calculate3DPoints(const QList<PiiMatrix
 
   int pointsPerView = imagePoints[0].rows();
 
-  // Unapply lens distortions and save normalized points in this list
-  QList<PiiMatrix<double> > lstNormalized;
   for (int i=0; i<imagePoints.size(); ++i)
     {
       if (imagePoints[i].rows() != pointsPerView)
@@ -71,110 +351,10 @@ PiiMatrix<double> PiiStereoTriangulator::calculate3DPoints(const QList<PiiMatrix
         PII_THROW(PiiCalibrationException,
                   tr("Measurement points must be 2-dimensional. View %1 is %2-dimensional.")
                   .arg(i).arg(imagePoints[i].columns()));
-
-      // Transform to normalized image coordinates and add a fixed z coordinate
-      lstNormalized << PiiCalibration::undistort(imagePoints[i], d->lstCameraParameters[i], 1.0);
     }
 
-  // Initialize a zero matrix
-  PiiMatrix<double> matResult(pointsPerView, 3);
-  matResult = NAN;
-  PiiMatrix<int> matValidPairs(1, pointsPerView);
-
-  int camCount = d->lstCameraParameters.size();
-  // Go through all possible camera pairings
-  for (int c1=0; c1<camCount; ++c1)
-    {
-      for (int c2=c1+1; c2<camCount; ++c2)
-        {
-          // Triangulated points are in c1's reference frame
-          PiiMatrix<double> mat3DPoints = triangulate(c1, c2, lstNormalized[c1], lstNormalized[c2]);
-          // If c1 is not the first camera, we need to convert the
-          // result to its coordinate frame to ensure the summed
-          // points are all in the same coordinate system.
-          if (c1 != 0)
-            mat3DPoints = PiiCalibration::cameraToWorldCoordinates(mat3DPoints, d->lstRelativePositions[0][c1]);
-
-          // Add successfully triangulated points to the result matrix
-          for (int r=0; r<mat3DPoints.rows(); ++r)
-            {
-              if (!Pii::isNan(mat3DPoints(r,0) + mat3DPoints(r,1) + mat3DPoints(r,2)))
-                {
-                  // Copy the first point (NAN + x = NAN)
-                  if (matValidPairs(r) == 0)
-                    matResult(r,0,1,-1) << mat3DPoints(r,0,1,-1);
-                  else
-                    matResult(r,0,1,-1) += mat3DPoints(r,0,1,-1);
-                  ++matValidPairs(r);
-                }
-            }
-        }
-    }
-  // Divide by the total number of valid pairings to get the mean
-  // of all pairwise estimates.
-  if (camCount > 2)
-    {
-      for (int r=0; r<matResult.rows(); ++r)
-        {
-          if (matValidPairs(r) > 1)
-            matResult(r,0,1,-1) /= matValidPairs(r);
-        }
-    }
+  PiiMatrix<double> matResult(PiiMatrix<double>::uninitialized(pointsPerView, 3));
+  if (pointsPerView > 0)
+    Pii::forEachBand(policy, pointsPerView, 0, TriangulationBand(d, imagePoints, matResult));
   return matResult;
 }
-
-#define dot(a,b) a(0)*b(0)+a(1)*b(1)+a(2)*b(2)
-
-PiiMatrix<double> PiiStereoTriangulator::triangulate(int camera1, int camera2,
-                                                     const PiiMatrix<double>& normalizedA,
-                                                     const PiiMatrix<double>& normalizedB)
-{
-  // Rotation matrix corresponding to the rigid motion between camera1
-  // and camera2. (X2 = R * X1 + T)
-  PiiMatrix<double> matRot = PiiCalibration::rotationVectorToMatrix(d->lstRelativePositions[camera1][camera2-camera1].rotation);
-  PiiMatrix<double> matInvRot(Pii::transpose(matRot));
-  PiiVector<double,3> vecTrans = d->lstRelativePositions[camera1][camera2-camera1].translation;
-
-  // Triangulation of the rays in 3D space. Matlab code ported from
-  // camera the calibration toolbox by Jean-Yves Bouguet. Don't ask me.
-
-  // Result matrix is the same size as normalizedA.
-  PiiMatrix<double> result(PiiMatrix<double>::uninitialized(normalizedA.rows(), normalizedA.columns()));
-
-  for (int row = 0; row < normalizedA.rows(); row++)
-    {
-      // Treat matrix rows as 3-dimensional vectors
-      PiiVector<double,3> ptA = normalizedA.rowAs<PiiVector<double,3> >(row);
-      PiiVector<double,3> ptB = normalizedB.rowAs<PiiVector<double,3> >(row);
-
-      // U = A's normalized measurent in B's coordinate system
-      PiiVector<double,3> ptU;
-      Pii::multiply(matRot, ptA.begin(), ptU.begin());
-
-      double norm2A = dot(ptA,ptA);
-      double norm2B = dot(ptB,ptB);
-
-      double DD = norm2A*norm2B - Pii::square(dot(ptU,ptB));
-
-      double dot_uT = dot(ptU,vecTrans);
-
-      double dot_normalizedBT = dot(ptB,vecTrans);
-      double dot_normalizedBu = dot(ptU,ptB);
-
-      double NN1 = dot_normalizedBu * dot_normalizedBT - norm2B * dot_uT;
-      double NN2 = norm2A * dot_normalizedBT - dot_uT * dot_normalizedBu;
-
-      double zA = NN1 / DD;
-      double zB = NN2 / DD;
-
-      PiiVector<double,3> X1 = ptA * zA;
-      PiiVector<double,3> X2;
-      Pii::multiply(matInvRot, (ptB * zB - vecTrans).begin(), X2.begin());
-
-      // Coordinates in camera1's reference frame. (We take the mean
-      // of two estimates.)
-      result.rowAs<PiiVector<double,3> >(row) = (X1 + X2) * 0.5;
-    }
-  return result;
-}
-#undef dot
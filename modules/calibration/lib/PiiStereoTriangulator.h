@@ -17,6 +17,8 @@
 #define _PIISTEREOTRIANGULATOR_H
 
 #include "PiiCalibration.h"
+#include <PiiParallel.h>
+#include <QVector>
 
 /**
  * A class that calculates 3D world coordinates for objects seen from
@@ -27,6 +29,18 @@
  * from all possible stereo pairs if more than two cameras are
  * available.
  *
+ * The geometry of each camera pair is precomputed when cameras are
+ * added. Large point sets can be triangulated in parallel by giving
+ * a Pii::ParallelExecution policy to [calculate3DPoints()].
+ *
+ * ~~~(c++)
+ * PiiStereoTriangulator triangulator;
+ * triangulator.addCamera(intrinsic1, extrinsic1);
+ * triangulator.addCamera(intrinsic2, extrinsic2);
+ * PiiMatrix<double> matPoints(triangulator.calculate3DPoints(Pii::ParallelExecution(),
+ *                                                            QList<PiiMatrix<double> >() <<
+ *                                                            matPixels1 << matPixels2));
+ * ~~~
  */
 class PII_CALIBRATION_EXPORT PiiStereoTriangulator
 {
@@ -79,11 +93,24 @@ public:
    */
   PiiMatrix<double> calculate3DPoints(const QList<PiiMatrix<double> >& imagePoints);
 
+  /**
+   * Calculates 3D coordinates for a large number of points in
+   * parallel. The points are split into bands of rows, and each band
+   * is undistorted and triangulated in a separate thread. On x86, the
+   * triangulation of camera pairs is vectorized over points. The
+   * result is the same as with the sequential version.
+   *
+   * @param policy parallelization policy
+   *
+   * @param imagePoints point coordinates in each view. See
+   * calculate3DPoints(const QList<PiiMatrix<double> >&).
+   */
+  PiiMatrix<double> calculate3DPoints(const Pii::ParallelExecution& policy,
+                                      const QList<PiiMatrix<double> >& imagePoints);
+
 private:
   QString tr(const char* message);
-  PiiMatrix<double> triangulate(int camera1, int camera2,
-                                const PiiMatrix<double>& normalizedA,
-                                const PiiMatrix<double>& normalizedB);
+  class TriangulationBand;
 
   /// @internal
   class Data
@@ -104,6 +131,26 @@ private:
      * Intrinsic parameters of cameras added so far.
      */
     QList<PiiCalibration::CameraParameters> lstCameraParameters;
+
+    /**
+     * Precomputed geometry of a camera pair. A point triangulated in
+     * the frame of camera 1 is transformed to that of the first
+     * camera with rotation R0 and translation T0: X0 = R0 (X1 - T0).
+     */
+    struct PairGeometry
+    {
+      int iCamera1, iCamera2;
+      // X2 = R * X1 + T
+      double adRotation[9];
+      double adTranslation[3];
+      double adFirstRotation[9];
+      double adFirstTranslation[3];
+    };
+
+    /**
+     * All camera pairs (c1 < c2) in the order they are combined.
+     */
+    QVector<PairGeometry> vecPairs;
   } *d;
 };
 
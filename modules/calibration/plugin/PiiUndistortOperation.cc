@@ -57,9 +57,7 @@ void PiiUndistortOperation::check(bool reset)
 
 void PiiUndistortOperation::invalidate()
 {
-  PII_D;
-  d->dmatMap.resize(0,0);
-  d->imatMap.resize(0,0);
+  _d()->remapTable = PiiImage::RemapTable();
 }
 
 void PiiUndistortOperation::process()
@@ -79,27 +77,22 @@ template <class T> void PiiUndistortOperation::undistort(const PiiVariant& obj)
   PII_D;
   PiiMatrix<T> matImage(obj.valueAs<PiiMatrix<T> >());
 
-  PiiTypelessMatrix* pMat = d->interpolation == Pii::LinearInterpolation ?
-    static_cast<PiiTypelessMatrix*>(&d->dmatMap) :
-    static_cast<PiiTypelessMatrix*>(&d->imatMap);
-
-  if (pMat->rows() != matImage.rows() ||
-      pMat->columns() != matImage.columns())
+  // The distortion model is evaluated only when the camera
+  // parameters or the image size change.
+  if (d->remapTable.sourceRows() != matImage.rows() ||
+      d->remapTable.sourceColumns() != matImage.columns())
     {
-      PiiCalibration::CameraParameters intrinsic(_d()->intrinsic);
+      PiiCalibration::CameraParameters intrinsic(d->intrinsic);
       if (Pii::isNan(intrinsic.center.x))
         intrinsic.center.x = double(matImage.columns()/2 - 0.5);
       if (Pii::isNan(intrinsic.center.y))
         intrinsic.center.y = double(matImage.rows()/2 - 0.5);
       if (d->interpolation == Pii::LinearInterpolation)
-        d->dmatMap = PiiCalibration::undistortMap(matImage.rows(), matImage.columns(), intrinsic);
+        d->remapTable = PiiImage::RemapTable(PiiCalibration::undistortMap(matImage.rows(), matImage.columns(), intrinsic));
       else
-        d->imatMap = PiiCalibration::undistortMapInt(matImage.rows(), matImage.columns(), intrinsic);
+        d->remapTable = PiiImage::RemapTable(PiiCalibration::undistortMapInt(matImage.rows(), matImage.columns(), intrinsic));
     }
-  if (d->interpolation == Pii::LinearInterpolation)
-    emitObject(PiiImage::remap(matImage, d->dmatMap));
-  else
-    emitObject(PiiImage::remap(matImage, d->imatMap));
+  emitObject(PiiImage::remap(Pii::ParallelExecution(), matImage, d->remapTable));
 }
 
 
@@ -153,5 +146,5 @@ PiiVariant PiiUndistortOperation::cameraParameters() const
                                       d->intrinsic.p2));
 }
 
-void PiiUndistortOperation::setInterpolation(Pii::Interpolation interpolation) { _d()->interpolation = interpolation; }
+void PiiUndistortOperation::setInterpolation(Pii::Interpolation interpolation) { _d()->interpolation = interpolation; invalidate(); }
 Pii::Interpolation PiiUndistortOperation::interpolation() const { return _d()->interpolation; }
@@ -135,8 +135,7 @@ private:
     Data();
 
     PiiCalibration::CameraParameters intrinsic;
-    PiiImage::DoubleCoordinateMap dmatMap;
-    PiiImage::IntCoordinateMap imatMap;
+    PiiImage::RemapTable remapTable;
     Pii::Interpolation interpolation;
   };
   PII_D_FUNC;
@@ -20,12 +20,80 @@
 #include <PiiRandom.h>
 #include <PiiBits.h>
 #include <PiiYdinResources.h>
+#include <PiiParallel.h>
+#include <PiiUtil.h>
 
 #include <QMutexLocker>
+#include <QScopedPointer>
 #include <QDir>
 #include <QFile>
 #include <QFileInfo>
 
+// Renders a band of texture tiles. Each band uses a copy of the
+// texture generator because generators keep state between calls.
+class PiiLineScanEmulator::TileRenderer : public Pii::BandFunction
+{
+public:
+  TileRenderer(PiiLineScanEmulator* owner) : _pOwner(owner) {}
+
+  void operator() (int firstTile, int tileCount)
+  {
+    PiiTextureGenerator* pSource = _pOwner->_pTextureGenerator;
+    QScopedPointer<PiiTextureGenerator> pGenerator(PiiYdin::createResource<PiiTextureGenerator>(pSource->metaObject()->className()));
+    if (pGenerator == 0)
+      return;
+    Pii::setProperties(pGenerator.data(), Pii::propertyList(pSource));
+
+    const int iRows = _pOwner->_iTextureTileRows, iColumns = _pOwner->_frameBuffer.columns();
+    const int iBlockSize = qMax(1, _pOwner->_iTextureBlockSize);
+    for (int i=firstTile; i<firstTile+tileCount; ++i)
+      {
+        PiiMatrix<unsigned char> matTile(iRows, iColumns);
+        for (int r=0; r<iRows; r += iBlockSize)
+          pGenerator->generateTexture(matTile, r, 0, qMin(iBlockSize, iRows-r), iColumns, r == 0);
+        _pOwner->_lstTextureTiles[i] = matTile;
+      }
+  }
+
+private:
+  PiiLineScanEmulator* _pOwner;
+};
+
+// Applies vignetting and the exposure/gain scaling to a band of
+// rows in a frame.
+class PiiLineScanEmulator::FrameFilter : public Pii::BandFunction
+{
+public:
+  FrameFilter(unsigned char* frame, int width, std::size_t stride,
+              const unsigned char* gainTable,
+              const QVector<unsigned int>& multipliers) :
+    _pFrame(frame), _iWidth(width), _iStride(stride),
+    _pGainTable(gainTable),
+    _pMultipliers(multipliers.isEmpty() ? 0 : multipliers.constData())
+  {}
+
+  void operator() (int firstRow, int rowCount)
+  {
+    for (int r=firstRow; r<firstRow+rowCount; ++r)
+      {
+        unsigned char* pLine = _pFrame + r * _iStride;
+        if (_pMultipliers != 0)
+          for (int c=0; c<_iWidth; ++c)
+            pLine[c] = _pGainTable[(_pMultipliers[c] * pLine[c]) >> 16];
+        else
+          for (int c=0; c<_iWidth; ++c)
+            pLine[c] = _pGainTable[pLine[c]];
+      }
+  }
+
+private:
+  unsigned char* _pFrame;
+  const int _iWidth;
+  const std::size_t _iStride;
+  const unsigned char* _pGainTable;
+  const unsigned int* _pMultipliers;
+};
+
 PiiLineScanEmulator::PiiLineScanEmulator() :
   _bOpen(false),
   _bCapturingRunning(false),
@@ -55,6 +123,8 @@ PiiLineScanEmulator::PiiLineScanEmulator() :
   _iLeftEdgeLimit(0),
   _iRightEdgeLimit(0),
   _iTextureBlockSize(128),
+  _iTextureTileRows(0),
+  _iTextureTileCount(4),
   _dGain(0.0),
   _iExposureTime(100),
   _iBaseExposureTime(100),
@@ -63,19 +133,23 @@ PiiLineScanEmulator::PiiLineScanEmulator() :
   _dOutputPulseFrequency(1000),
   _bFirstScanLine(true),
   _pTextureGenerator(0),
+  _iTileIndex(0),
+  _iTileRow(0),
+  _iTileColumn(0),
   _iLineCounter(0),
   _iCurrentLineIndex(0),
   _iCurrLineInImage(0),
   _dTempProbability(0),
   _dTotalDefectRate(0),
-  _dpMultipliers(0),
   _dLeftEdgePos(0),
   _dRightEdgePos(0)
 {
   _lstCriticalProperties = QStringList() << "maxResolution"
                                          << "frameSize"
                                          << "frameRect"
-                                         << "frameBufferCount";
+                                         << "frameBufferCount"
+                                         << "textureTileRows"
+                                         << "textureTileCount";
 
 }
 
@@ -172,6 +246,7 @@ void PiiLineScanEmulator::initialize(const QString& /*cameraId*/)
   _vecBufferPointers.fill(0,_iFrameBufferCount);
   _iSkippingLimit = _vecBufferPointers.size() / 2;
 
+  renderTextureTiles();
   loadImages();
 
   _bOpen = true;
@@ -312,13 +387,7 @@ void PiiLineScanEmulator::buffer()
           generateLine();
         }
 
-      // Fake the frame intensity depends on gain and exposureTime
-      double dFactor = (double)_iExposureTime / (double)_iBaseExposureTime * (_dGain + 1.0);
-      unsigned char *pPtr = _frameBuffer.row(iStartLineIndex);
-      int count = _iHeight*_frameBuffer.columns();
-
-      for (int i=0; i<count; i++)
-        pPtr[i] = (unsigned char)qBound(0.0,dFactor * pPtr[i], 255.0);
+      filterFrame(_frameBuffer.row(iStartLineIndex));
 
       // Increase frame index
       _iFrameIndex++;
@@ -548,11 +617,62 @@ bool PiiLineScanEmulator::loadImages()
   return true;
 }
 
+void PiiLineScanEmulator::filterFrame(unsigned char* frame)
+{
+  // Fake the frame intensity depends on gain and exposureTime
+  double dFactor = (double)_iExposureTime / (double)_iBaseExposureTime * (_dGain + 1.0);
+  unsigned char aGainTable[256];
+  for (int i=0; i<256; ++i)
+    aGainTable[i] = (unsigned char)qBound(0.0, dFactor * i, 255.0);
+
+  FrameFilter filter(frame, _frameBuffer.columns(), _frameBuffer.stride(), aGainTable, _vecMultipliers);
+  Pii::forEachBand(Pii::ParallelExecution(), _iHeight, 0, filter);
+}
+
+void PiiLineScanEmulator::renderTextureTiles()
+{
+  _lstTextureTiles.clear();
+  _iTileIndex = _iTileRow = _iTileColumn = 0;
+  if (_iTextureTileRows <= 0 || _pTextureGenerator == 0)
+    return;
+
+  for (int i=0; i<_iTextureTileCount; ++i)
+    _lstTextureTiles << PiiMatrix<unsigned char>();
+  Pii::ParallelExecution policy;
+  policy.minBandRows = 1;
+  TileRenderer renderer(this);
+  Pii::forEachBand(policy, _iTextureTileCount, 0, renderer);
+  // Drop the tiles of failed bands.
+  for (int i=_lstTextureTiles.size(); i--; )
+    if (_lstTextureTiles[i].isEmpty())
+      _lstTextureTiles.removeAt(i);
+}
+
+void PiiLineScanEmulator::copyTextureTileRow(unsigned char* line)
+{
+  const PiiMatrix<unsigned char>& matTile = _lstTextureTiles[_iTileIndex];
+  const unsigned char* pSource = matTile.row(_iTileRow);
+  const int iColumns = matTile.columns();
+  std::memcpy(line, pSource + _iTileColumn, iColumns - _iTileColumn);
+  std::memcpy(line + iColumns - _iTileColumn, pSource, _iTileColumn);
+
+  // Continue from a random place when the tile runs out.
+  if (++_iTileRow >= matTile.rows())
+    {
+      _iTileRow = 0;
+      _iTileIndex = rand() % _lstTextureTiles.size();
+      _iTileColumn = rand() % iColumns;
+    }
+}
+
 void PiiLineScanEmulator::generateTexture()
 {
   // If texture generator is not set, use a constant color for the background
   if (_pTextureGenerator == 0)
     memset(_frameBuffer.row(_iCurrentLineIndex), _backgroundColor.red(), _iWidth);
+  // Pre-rendered tiles are copied line by line.
+  else if (!_lstTextureTiles.isEmpty())
+    copyTextureTileRow(_frameBuffer.row(_iCurrentLineIndex));
   // Else use the generator to produce background texture (in blocks)
   else if (_iCurrentLineIndex % _iTextureBlockSize == 0)
     {
@@ -606,12 +726,12 @@ void PiiLineScanEmulator::setImages(const QList<QImage>& images, const QList<QIm
 
 void PiiLineScanEmulator::generateMultipliers()
 {
-  delete[] _dpMultipliers;
+  _vecMultipliers.clear();
 
   int width = _iWidth;
   if (_dFieldOfView != 0 && width > 1)
     {
-      _dpMultipliers = new double[width];
+      _vecMultipliers.resize(width);
       // Field of view ranges from -fov/2 -> fov/2
       // Convert to radians at the same time
       double theta = -_dFieldOfView / 360 * M_PI;
@@ -621,7 +741,7 @@ void PiiLineScanEmulator::generateMultipliers()
       // towards the edges of the scan line according to the cos^4
       // law.
       for (int i=0; i<width; i++, theta += step)
-        _dpMultipliers[i] = ::pow(::cos(theta),4);
+        _vecMultipliers[i] = (unsigned int)(::pow(::cos(theta),4) * 65536);
     }
 }
 
@@ -719,10 +839,7 @@ void PiiLineScanEmulator::generateLine()
       memset(line + _iWidth - int(_dRightEdgePos), _borderColor.red(), int(_dRightEdgePos));
     }
 
-  // Simulate vignetting
-  if (_dpMultipliers)
-    for (int i=_iWidth; i--; )
-      line[i] = static_cast<unsigned char>(_dpMultipliers[i] * line[i]);
+  // Vignetting is simulated in filterFrame().
 
   updateTotalDefRate(double(newDefPixels)/_iWidth);
 
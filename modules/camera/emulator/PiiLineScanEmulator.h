@@ -117,6 +117,26 @@ class PII_CAMERAEMULATOR_EXPORT PiiLineScanEmulator : public PiiCameraDriver
    */
   Q_PROPERTY(int textureBlockSize READ textureBlockSize WRITE setTextureBlockSize);
 
+  /**
+   * The number of rows in a pre-rendered texture tile. If this value
+   * is greater than zero, the emulator renders [textureTileCount]
+   * tiles with the texture generator once in [initialize()] and
+   * builds the background by copying scan lines from them. Whenever
+   * the end of a tile is reached, the emulator continues from a
+   * randomly selected tile with a random horizontal offset. This
+   * makes the background repeat but allows line rates that cannot be
+   * reached by generating the texture on the fly. The default value
+   * is zero, which disables tiling.
+   */
+  Q_PROPERTY(int textureTileRows READ textureTileRows WRITE setTextureTileRows);
+
+  /**
+   * The number of texture tiles to pre-render if [textureTileRows] is
+   * non-zero. The tiles are rendered in parallel. The default value
+   * is 4.
+   */
+  Q_PROPERTY(int textureTileCount READ textureTileCount WRITE setTextureTileCount);
+
   /**
    * gain description
    */
@@ -201,6 +221,8 @@ public:
   bool setRightEdgeLimit(int rightEdgeLimit) { _iRightEdgeLimit = rightEdgeLimit; return true; }
   bool setTextureGeneratorName(const QString& textureGeneratorName);
   bool setTextureBlockSize(int textureBlockSize) { _iTextureBlockSize = textureBlockSize; return true; }
+  bool setTextureTileRows(int textureTileRows) { _iTextureTileRows = qMax(0,textureTileRows); return true; }
+  bool setTextureTileCount(int textureTileCount) { _iTextureTileCount = qMax(1,textureTileCount); return true; }
   bool setGain(double gain) { _dGain = qBound(0.0,gain,1.0); return true; }
   bool setExposureTime(int exposureTime) { _iExposureTime = qMax(1,exposureTime); return true; }
   bool setBaseExposureTime(int baseExposureTime) { _iBaseExposureTime = qMax(1,baseExposureTime); return true; }
@@ -221,6 +243,8 @@ public:
   int rightEdgeLimit() const { return _iRightEdgeLimit; }
   QString textureGeneratorName() const;
   int textureBlockSize() const { return _iTextureBlockSize; }
+  int textureTileRows() const { return _iTextureTileRows; }
+  int textureTileCount() const { return _iTextureTileCount; }
   double gain() const { return _dGain; }
   int exposureTime() const { return _iExposureTime; }
   int baseExposureTime() const { return _iBaseExposureTime; }
@@ -230,6 +254,9 @@ protected:
   bool requiresInitialization(const char* name) const;
 
 private:
+  class TileRenderer;
+  class FrameFilter;
+
   void buffer();
   void capture();
   void stopBuffering();
@@ -262,6 +289,7 @@ private:
   int _iLeftEdgeLimit;
   int _iRightEdgeLimit;
   int _iTextureBlockSize;
+  int _iTextureTileRows, _iTextureTileCount;
   double _dGain;
   int _iExposureTime;
   int _iBaseExposureTime;
@@ -273,6 +301,9 @@ private:
   QVariantMap _mapGeneratorProperties;
   PiiTextureGenerator* _pTextureGenerator;
 
+  QList<PiiMatrix<unsigned char> > _lstTextureTiles;
+  int _iTileIndex, _iTileRow, _iTileColumn;
+
   bool loadImages();
   void lineAdded();
 
@@ -308,7 +339,9 @@ private:
   /* Counts the number of all lines generated. Is used in calculating the
      total defect rate (_dTotalDefectRate)*/
   int _iTotalLineCounter;
-  double* _dpMultipliers;
+  // Vignetting multipliers in 16-bit fixed point. Empty if
+  // vignetting is disabled.
+  QVector<unsigned int> _vecMultipliers;
   double _dLeftEdgePos, _dRightEdgePos;
   QPoint _leftTargetPoint, _rightTargetPoint;
 
@@ -317,6 +350,9 @@ private:
   QPoint getRandomCoord(const QImage& image);
   void generateLine();
   void generateTexture();
+  void copyTextureTileRow(unsigned char* line);
+  void renderTextureTiles();
+  void filterFrame(unsigned char* frame);
   void updateTotalDefRate(double currRowDefRate);
   void generateMultipliers();
   double updateEdgePos(double pos, QPoint& targetPoint, int limit);
@@ -0,0 +1,310 @@
+/* This file is part of Into.
+ * Copyright (C) Intopii 2013.
+ * All rights reserved.
+ *
+ * Licensees holding a commercial Into license may use this file in
+ * accordance with the commercial license agreement. Please see
+ * LICENSE.commercial for commercial licensing terms.
+ *
+ * Alternatively, this file may be used under the terms of the GNU
+ * Affero General Public License version 3 as published by the Free
+ * Software Foundation. In addition, Intopii gives you special rights
+ * to use Into as a part of open source software projects. Please
+ * refer to LICENSE.AGPL3 for details.
+ */
+
+
+#include "PiiLoadGenerator.h"
+#include "PiiTextureGenerator.h"
+
+#include <PiiAsyncCall.h>
+#include <PiiParallel.h>
+#include <PiiTimer.h>
+#include <PiiYdinResources.h>
+
+#include <QScopedPointer>
+
+// Renders a band of pool frames. Each band uses a generator of its
+// own because generators keep state between calls.
+class PiiLoadGenerator::Renderer : public Pii::BandFunction
+{
+public:
+  Renderer(PiiLoadGenerator* owner) : _pOwner(owner) {}
+
+  void operator() (int firstFrame, int frameCount)
+  {
+    QScopedPointer<PiiTextureGenerator> pGenerator(PiiYdin::createResource<PiiTextureGenerator>(_pOwner->_strTextureGeneratorName));
+    if (pGenerator == 0)
+      PII_THROW(PiiCameraDriverException, PiiLoadGenerator::tr("Texture generator %1 is not available.").arg(_pOwner->_strTextureGeneratorName));
+    for (QVariantMap::const_iterator i = _pOwner->_mapGeneratorProperties.constBegin();
+         i != _pOwner->_mapGeneratorProperties.constEnd(); ++i)
+      pGenerator->setProperty(qPrintable(i.key()), i.value());
+
+    const int iRows = _pOwner->_frameSize.height(), iColumns = _pOwner->_frameSize.width();
+    for (int i=firstFrame; i<firstFrame+frameCount; ++i)
+      {
+        PiiMatrix<unsigned char> matFrame(iRows, iColumns);
+        pGenerator->generateTexture(matFrame, 0, 0, iRows, iColumns, true);
+        _pOwner->_lstPool[i] = matFrame;
+      }
+  }
+
+private:
+  PiiLoadGenerator* _pOwner;
+};
+
+PiiLoadGenerator::PiiLoadGenerator() :
+  _bOpen(false),
+  _bCapturing(false),
+  _pCapturingThread(0),
+  _triggerMode(PiiCameraDriver::FreeRun),
+  _iMaxFrames(0),
+  _iMissedFrameCount(0),
+  _iRandomState(1),
+  _frameSize(640, 480),
+  _iPoolSize(16),
+  _dFrameRate(25),
+  _dJitter(0),
+  _strTextureGeneratorName("PiiNonWovenGenerator")
+{
+}
+
+PiiLoadGenerator::~PiiLoadGenerator()
+{
+  close();
+}
+
+QVariant PiiLoadGenerator::property(const char* name) const
+{
+  if (strncmp(name, "textureGenerator.", 17) == 0)
+    return _mapGeneratorProperties.value(name+17);
+  return PiiCameraDriver::property(name);
+}
+
+bool PiiLoadGenerator::setProperty(const char* name, const QVariant& value)
+{
+  if (strncmp(name, "textureGenerator.", 17) == 0)
+    {
+      // Takes effect when the pool is rendered.
+      _mapGeneratorProperties[name+17] = value;
+      return true;
+    }
+  return PiiCameraDriver::setProperty(name, value);
+}
+
+QStringList PiiLoadGenerator::cameraList() const
+{
+  return QStringList();
+}
+
+void PiiLoadGenerator::initialize(const QString& cameraId)
+{
+  if (_bCapturing)
+    PII_THROW(PiiCameraDriverException, tr("Capturing is running. Stop the capture first."));
+
+  close();
+
+  QVariantMap& dataMap = propertyMap();
+  for (QVariantMap::iterator i=dataMap.begin(); i != dataMap.end(); ++i)
+    {
+      if (!QObject::setProperty(qPrintable(i.key()), i.value()))
+        PII_THROW(PiiCameraDriverException, tr("Couldn't write the configuration value '%1'").arg(i.key()));
+    }
+  dataMap.clear();
+
+  // Each virtual camera gets a different jitter sequence.
+  _iRandomState = qHash(cameraId) | 1;
+  renderPool();
+  _bOpen = true;
+}
+
+void PiiLoadGenerator::renderPool()
+{
+  _lstPool.clear();
+  for (int i=0; i<_iPoolSize; ++i)
+    _lstPool << PiiMatrix<unsigned char>();
+  Pii::ParallelExecution policy;
+  policy.minBandRows = 1;
+  Renderer renderer(this);
+  Pii::forEachBand(policy, _iPoolSize, 0, renderer);
+}
+
+bool PiiLoadGenerator::close()
+{
+  if (!_bOpen)
+    return false;
+
+  stopCapture();
+  delete _pCapturingThread;
+  _pCapturingThread = 0;
+  _lstPool.clear();
+  _bOpen = false;
+  return true;
+}
+
+bool PiiLoadGenerator::startCapture(int frames)
+{
+  if (!_bOpen || listener() == 0 || _bCapturing)
+    return false;
+
+  if (_pCapturingThread == 0)
+    _pCapturingThread = Pii::createAsyncCall(this, &PiiLoadGenerator::capture);
+
+  _iMaxFrames = frames;
+  _iMissedFrameCount = 0;
+  _bCapturing = true;
+  _pCapturingThread->start();
+  return true;
+}
+
+bool PiiLoadGenerator::stopCapture()
+{
+  if (!_bCapturing)
+    return false;
+
+  _bCapturing = false;
+  _triggerWaitCondition.wakeAll();
+  _pCapturingThread->wait();
+  return true;
+}
+
+qint64 PiiLoadGenerator::jitterOffset(qint64 period)
+{
+  if (_dJitter <= 0)
+    return 0;
+  _iRandomState = _iRandomState * 1103515245 + 12345;
+  const double dRandom = double(_iRandomState >> 8) / (1 << 24) - 0.5;
+  return qint64(dRandom * _dJitter * period);
+}
+
+void PiiLoadGenerator::capture()
+{
+  _pCapturingThread->setPriority(QThread::HighestPriority);
+
+  const qint64 iPeriod = qMax(qint64(1), qint64(1e6 / _dFrameRate));
+  qint64 iNextRelease = PiiTimer::currentTime();
+  qint64 iPreviousRelease = -1;
+  uint uiFrameIndex = 0;
+
+  while (_bCapturing)
+    {
+      if (_triggerMode == PiiCameraDriver::SoftwareTrigger)
+        _triggerWaitCondition.wait();
+      else
+        {
+          const qint64 iRelease = iNextRelease + jitterOffset(iPeriod);
+          qint64 iNow = PiiTimer::currentTime();
+          // Sleep in short steps to respond to stopCapture().
+          while (_bCapturing && iRelease > iNow)
+            {
+              _triggerWaitCondition.wait(ulong(qMin(qint64(10), qMax(qint64(1), (iRelease - iNow) / 1000))));
+              iNow = PiiTimer::currentTime();
+            }
+          iNextRelease += iPeriod;
+
+          // Drop the frames whose release time passed while the
+          // receiver was busy.
+          if (iNow - iNextRelease > iPeriod)
+            {
+              const int iMissed = int((iNow - iNextRelease) / iPeriod);
+              listener()->framesMissed(uiFrameIndex, uiFrameIndex + iMissed - 1);
+              uiFrameIndex += iMissed;
+              iNextRelease += iMissed * iPeriod;
+              _iMissedFrameCount += iMissed;
+            }
+        }
+      if (!_bCapturing)
+        break;
+
+      PiiCamera::FrameInfo info;
+      info.timestamp = PiiTimer::currentTime();
+      info.elapsedTime = iPreviousRelease >= 0 ? info.timestamp - iPreviousRelease : 0;
+      info.frameCounter = uiFrameIndex;
+      iPreviousRelease = info.timestamp;
+      listener()->frameCaptured(uiFrameIndex, 0, info);
+
+      if (++uiFrameIndex >= uint(_iMaxFrames) && _iMaxFrames > 0)
+        break;
+    }
+  _bCapturing = false;
+  listener()->captureFinished(true);
+}
+
+void* PiiLoadGenerator::frameBuffer(uint frameIndex) const
+{
+  if (_lstPool.isEmpty())
+    return 0;
+  return const_cast<unsigned char*>(_lstPool[frameIndex % _lstPool.size()].row(0));
+}
+
+bool PiiLoadGenerator::supportsFrameLeasing() const { return true; }
+bool PiiLoadGenerator::isOpen() const { return _bOpen; }
+bool PiiLoadGenerator::isCapturing() const { return _bCapturing; }
+
+bool PiiLoadGenerator::triggerImage()
+{
+  _triggerWaitCondition.wakeOne();
+  return true;
+}
+
+bool PiiLoadGenerator::setTriggerMode(PiiCameraDriver::TriggerMode mode)
+{
+  _triggerMode = mode;
+  return true;
+}
+
+PiiCameraDriver::TriggerMode PiiLoadGenerator::triggerMode() const { return _triggerMode; }
+
+bool PiiLoadGenerator::requiresInitialization(const char* name) const
+{
+  return strcmp(name, "frameSize") == 0 ||
+    strcmp(name, "poolSize") == 0 ||
+    strcmp(name, "textureGeneratorName") == 0;
+}
+
+bool PiiLoadGenerator::setFrameSize(const QSize& frameSize)
+{
+  if (frameSize.width() < 1 || frameSize.height() < 1)
+    return false;
+  _frameSize = frameSize;
+  return true;
+}
+
+QSize PiiLoadGenerator::frameSize() const { return _frameSize; }
+
+bool PiiLoadGenerator::setPoolSize(int poolSize)
+{
+  if (poolSize < 1)
+    return false;
+  _iPoolSize = poolSize;
+  return true;
+}
+
+int PiiLoadGenerator::poolSize() const { return _iPoolSize; }
+
+bool PiiLoadGenerator::setFrameRate(double frameRate)
+{
+  if (frameRate <= 0)
+    return false;
+  _dFrameRate = frameRate;
+  return true;
+}
+
+double PiiLoadGenerator::frameRate() const { return _dFrameRate; }
+
+bool PiiLoadGenerator::setJitter(double jitter)
+{
+  _dJitter = qBound(0.0, jitter, 1.0);
+  return true;
+}
+
+double PiiLoadGenerator::jitter() const { return _dJitter; }
+
+bool PiiLoadGenerator::setTextureGeneratorName(const QString& textureGeneratorName)
+{
+  _strTextureGeneratorName = textureGeneratorName;
+  return true;
+}
+
+QString PiiLoadGenerator::textureGeneratorName() const { return _strTextureGeneratorName; }
+int PiiLoadGenerator::missedFrameCount() const { return _iMissedFrameCount; }
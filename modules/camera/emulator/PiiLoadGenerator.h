@@ -0,0 +1,170 @@
+/* This file is part of Into.
+ * Copyright (C) Intopii 2013.
+ * All rights reserved.
+ *
+ * Licensees holding a commercial Into license may use this file in
+ * accordance with the commercial license agreement. Please see
+ * LICENSE.commercial for commercial licensing terms.
+ *
+ * Alternatively, this file may be used under the terms of the GNU
+ * Affero General Public License version 3 as published by the Free
+ * Software Foundation. In addition, Intopii gives you special rights
+ * to use Into as a part of open source software projects. Please
+ * refer to LICENSE.AGPL3 for details.
+ */
+
+
+#ifndef _PIILOADGENERATOR_H
+#define _PIILOADGENERATOR_H
+
+#include <PiiCameraDriver.h>
+#include <PiiWaitCondition.h>
+#include <PiiCameraEmulatorGlobal.h>
+
+#include <QThread>
+#include <QList>
+
+/**
+ * A camera driver that replays pre-rendered frames at a fixed rate
+ * for load testing. When initialized, the driver renders a pool of
+ * [poolSize] frames with a PiiTextureGenerator, using all threads of
+ * the global thread pool. During capture, the frames are released
+ * in turn at [frameRate] frames per second, with a random [jitter]
+ * added to each release time. Since no frames are generated while
+ * capturing, the rate is limited only by the receivers.
+ *
+ * Each frame carries its release time (PiiTimer::currentTime()) as
+ * the timestamp in PiiCamera::FrameInfo. PiiCameraOperation emits it
+ * through the `timestamp` output, which makes it possible to measure
+ * the end-to-end latency of a frame through a processing pipeline.
+ * Many virtual cameras can be emulated by using a separate
+ * PiiCameraOperation with a different `cameraId` for each. The
+ * camera id seeds the jitter sequence.
+ *
+ * If a receiver blocks for longer than a frame period, the frames
+ * whose release times have passed are dropped and reported with
+ * [PiiCameraDriver::Listener::framesMissed()] "framesMissed()".
+ * Frames can be leased (see PiiCameraDriver::leaseFrame()), because
+ * the pool is never modified during capture.
+ *
+ * In `SoftwareTrigger` mode, a frame is released for each
+ * [triggerImage()] call. Other trigger modes replay at [frameRate].
+ *
+ * ~~~(c++)
+ * PiiOperation* pCamera = engine.createOperation("PiiCameraOperation");
+ * pCamera->setProperty("driverName", "PiiLoadGenerator");
+ * pCamera->setProperty("cameraId", "camera1");
+ * pCamera->setProperty("driver.frameRate", 200.0);
+ * pCamera->setProperty("driver.jitter", 0.1);
+ * ~~~
+ */
+class PII_CAMERAEMULATOR_EXPORT PiiLoadGenerator : public PiiCameraDriver
+{
+  Q_OBJECT
+
+  /**
+   * The size of the frames. The default is 640-by-480.
+   */
+  Q_PROPERTY(QSize frameSize READ frameSize WRITE setFrameSize);
+
+  /**
+   * The number of pre-rendered frames. The default is 16.
+   */
+  Q_PROPERTY(int poolSize READ poolSize WRITE setPoolSize);
+
+  /**
+   * The number of frames released per second. The default is 25.
+   */
+  Q_PROPERTY(double frameRate READ frameRate WRITE setFrameRate);
+
+  /**
+   * The maximum deviation of release times as a fraction of the frame
+   * period. The release time of each frame is randomly moved by at
+   * most `jitter/2` periods in either direction. The default is zero.
+   */
+  Q_PROPERTY(double jitter READ jitter WRITE setJitter);
+
+  /**
+   * The name of the class that renders the frames. The generator must
+   * be registered to the resource database. Properties of the
+   * generator can be set with a "textureGenerator." prefix. The
+   * default is "PiiNonWovenGenerator".
+   *
+   * ~~~(c++)
+   * driver->setProperty("textureGeneratorName", "PiiTiledImageGenerator");
+   * driver->setProperty("textureGenerator.tileFileName", "tile.png");
+   * ~~~
+   */
+  Q_PROPERTY(QString textureGeneratorName READ textureGeneratorName WRITE setTextureGeneratorName);
+
+  /**
+   * The number of frames dropped during the current or last capture
+   * because the receiver could not keep up.
+   */
+  Q_PROPERTY(int missedFrameCount READ missedFrameCount);
+
+public:
+  PiiLoadGenerator();
+  ~PiiLoadGenerator();
+
+  QVariant property(const char* name) const;
+  bool setProperty(const char* name, const QVariant& value);
+
+  QStringList cameraList() const;
+  void initialize(const QString& cameraId);
+  bool close();
+  bool startCapture(int frames);
+  bool stopCapture();
+  void* frameBuffer(uint frameIndex) const;
+  bool supportsFrameLeasing() const;
+  bool isOpen() const;
+  bool isCapturing() const;
+  bool triggerImage();
+  bool setTriggerMode(PiiCameraDriver::TriggerMode mode);
+  PiiCameraDriver::TriggerMode triggerMode() const;
+  int bitsPerPixel() const { return 8; }
+  int imageFormat() const { return PiiCamera::MonoFormat; }
+  bool setImageFormat(int format) { return format == PiiCamera::MonoFormat; }
+  QSize resolution() const { return _frameSize; }
+
+  bool setFrameSize(const QSize& frameSize);
+  QSize frameSize() const;
+  bool setPoolSize(int poolSize);
+  int poolSize() const;
+  bool setFrameRate(double frameRate);
+  double frameRate() const;
+  bool setJitter(double jitter);
+  double jitter() const;
+  bool setTextureGeneratorName(const QString& textureGeneratorName);
+  QString textureGeneratorName() const;
+  int missedFrameCount() const;
+
+protected:
+  bool requiresInitialization(const char* name) const;
+
+private:
+  class Renderer;
+
+  void renderPool();
+  void capture();
+  qint64 jitterOffset(qint64 period);
+
+  bool _bOpen;
+  volatile bool _bCapturing;
+  QThread* _pCapturingThread;
+  PiiWaitCondition _triggerWaitCondition;
+  PiiCameraDriver::TriggerMode _triggerMode;
+  int _iMaxFrames;
+  int _iMissedFrameCount;
+  unsigned int _iRandomState;
+
+  QSize _frameSize;
+  int _iPoolSize;
+  double _dFrameRate;
+  double _dJitter;
+  QString _strTextureGeneratorName;
+  QVariantMap _mapGeneratorProperties;
+  QList<PiiMatrix<unsigned char> > _lstPool;
+};
+
+#endif //_PIILOADGENERATOR_H
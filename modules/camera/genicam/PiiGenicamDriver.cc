@@ -11,9 +11,27 @@
 #include <QLibrary>
 #include <PiiTimer.h>
 
+#if defined(Q_OS_LINUX)
+#  include <pthread.h>
+#  include <sched.h>
+#elif defined(Q_OS_WIN)
+#  include <windows.h>
+#endif
+
+namespace
+{
+  // genicam_initialize() and genicam_terminate() are global to the
+  // wrapper library. With many driver instances, only the first one
+  // initializes the library and the last one terminates it.
+  QMutex wrapperMutex;
+  int iWrapperUsers = 0;
+}
+
 PiiGenicamDriver::PiiGenicamDriver(const QString& wrapperLibrary) :
   _strWrapperLibrary(wrapperLibrary),
   _bWrapperFunctionsInitialized(false),
+  genicamFrameInfo(0),
+  genicamRequeueBuffer(0),
   _pDevice(0),
   _pBuffer(0),
   _bOpen(false),
@@ -23,13 +41,16 @@ PiiGenicamDriver::PiiGenicamDriver(const QString& wrapperLibrary) :
   _iMaxFrames(0),
   _iHandledFrameCount(0),
   _triggerMode(FreeRun),
-  _iFrameBufferCount(10)
+  _iFrameBufferCount(10),
+  _iCaptureCpu(-1),
+  _iMissedFrameCount(0)
 {
   _lstCriticalProperties << "frameBufferCount"
                          << "frameRect"
                          << "frameSize"
                          << "imageFormat"
                          << "packetSize"
+                         << "socketBufferSize"
                          << "triggerMode";
 }
 
@@ -39,7 +60,11 @@ PiiGenicamDriver::~PiiGenicamDriver()
     close();
 
   if (_bWrapperFunctionsInitialized)
-    genicamTerminate();
+    {
+      QMutexLocker lock(&wrapperMutex);
+      if (--iWrapperUsers == 0)
+        genicamTerminate();
+    }
 
   delete[] _pBuffer;
 }
@@ -90,6 +115,8 @@ void PiiGenicamDriver::initializeWrapperFunctions()
   genicamRequeueBuffers = resolveLib<GenicamIntDevicepFunc>(lib, "genicam_requeue_buffers");
   genicamStartCapture = resolveLib<GenicamIntDevicepFunc>(lib, "genicam_start_capture");
   genicamStopCapture = resolveLib<GenicamIntDevicepFunc>(lib, "genicam_stop_capture");
+  genicamFrameInfo = resolveLib<GenicamIntDevicepUCharpInfopFunc>(lib, "genicam_get_frame_info");
+  genicamRequeueBuffer = resolveLib<GenicamIntDevicepUCharpFunc>(lib, "genicam_requeue_buffer");
 
   if (genicamInitialize == 0 ||
       genicamTerminate == 0 ||
@@ -113,13 +140,17 @@ void PiiGenicamDriver::initializeWrapperFunctions()
       return;
     }
 
-  if (genicamInitialize() != 0)
+  QMutexLocker lock(&wrapperMutex);
+  if (iWrapperUsers == 0 && genicamInitialize() != 0)
     {
       piiWarning(lastError());
       _bWrapperFunctionsInitialized = false;
     }
   else
-    _bWrapperFunctionsInitialized = true;
+    {
+      ++iWrapperUsers;
+      _bWrapperFunctionsInitialized = true;
+    }
 }
 
 QString PiiGenicamDriver::lastError() const
@@ -177,6 +208,9 @@ void PiiGenicamDriver::initializeGenicamDevice(const QString& camId)
     }
   else
     {
+      // Leased frames still point to the old buffer.
+      if (leasedFrameCount() > 0)
+        PII_THROW(PiiCameraDriverException, tr("Frame buffers cannot be reallocated while frames are leased."));
       if (genicamDeregisterFramebuffers(_pDevice) != 0)
         PII_THROW(PiiCameraDriverException, tr("Could not deregister frame buffers: %1").arg(lastError()));
     }
@@ -214,6 +248,8 @@ void PiiGenicamDriver::initializeGenicamDevice(const QString& camId)
     }
 
   _vecBufferPointers.fill(0,_iFrameBufferCount);
+  _hashLeasedBuffers.clear();
+  _vecReleasedBuffers.clear();
 
   delete[] _pBuffer;
   _pBuffer = pBuffer;
@@ -306,9 +342,13 @@ bool PiiGenicamDriver::startCapture(int frames)
     _pCapturingThread = Pii::createAsyncCall(this, &PiiGenicamDriver::capture);
 
   _bCapturingRunning = true;
-  _iFrameIndex = -1;
+  // Leases are identified by frame index. Don't reuse indices while
+  // frames from the previous run are still leased.
+  if (leasedFrameCount() == 0)
+    _iFrameIndex = -1;
   _iHandledFrameCount = 0;
   _iMaxFrames = _triggerMode == SoftwareTrigger ? 0 : frames;
+  _iMissedFrameCount = 0;
 
   // Let the camera acquire
   if (genicamStartCapture(_pDevice) != 0)
@@ -350,12 +390,60 @@ bool PiiGenicamDriver::reconnect()
   return false;
 }
 
+void PiiGenicamDriver::bindCaptureThread()
+{
+  if (_iCaptureCpu < 0)
+    return;
+#if defined(Q_OS_LINUX)
+  cpu_set_t cpuSet;
+  CPU_ZERO(&cpuSet);
+  CPU_SET(_iCaptureCpu, &cpuSet);
+  if (pthread_setaffinity_np(pthread_self(), sizeof(cpuSet), &cpuSet) != 0)
+    piiWarning(tr("Couldn't bind the capture thread to core %1.").arg(_iCaptureCpu));
+#elif defined(Q_OS_WIN)
+  if (SetThreadAffinityMask(GetCurrentThread(), DWORD_PTR(1) << _iCaptureCpu) == 0)
+    piiWarning(tr("Couldn't bind the capture thread to core %1.").arg(_iCaptureCpu));
+#endif
+}
+
+PiiCamera::FrameInfo PiiGenicamDriver::frameInfo(unsigned char* buffer, qint64& previousTimestamp)
+{
+  PiiCamera::FrameInfo info;
+  genicam_frame_info deviceInfo;
+  if (genicamFrameInfo == 0 || genicamFrameInfo(_pDevice, buffer, &deviceInfo) != 0)
+    return info;
+  info.timestamp = deviceInfo.timestamp;
+  info.frameCounter = deviceInfo.frame_counter;
+  info.exposureTime = deviceInfo.exposure_time;
+  info.triggerId = deviceInfo.trigger_id;
+  if (info.timestamp >= 0)
+    {
+      if (previousTimestamp >= 0)
+        info.elapsedTime = info.timestamp - previousTimestamp;
+      previousTimestamp = info.timestamp;
+    }
+  return info;
+}
+
+void PiiGenicamDriver::reportMissedFrames(uint startIndex, uint endIndex)
+{
+  _iMissedFrameCount += int(endIndex - startIndex + 1);
+  listener()->framesMissed(startIndex, endIndex);
+}
+
 void PiiGenicamDriver::capture()
 {
   _pCapturingThread->setPriority(QThread::HighestPriority);
+  bindCaptureThread();
 
   QVector<unsigned char*> lstBuffers;
   lstBuffers.reserve(_iFrameBufferCount);
+  QVector<PiiCamera::FrameInfo> lstFrameInfos;
+  lstFrameInfos.reserve(_iFrameBufferCount);
+  // The index each buffer was emitted with, -1 for skipped frames.
+  QVector<qint64> lstFrameIndices;
+  lstFrameIndices.reserve(_iFrameBufferCount);
+  qint64 iPreviousTimestamp = -1;
 
   int iHandledFrames = 0;
   bool bSoftwareTrigger = _triggerMode == SoftwareTrigger;
@@ -369,6 +457,15 @@ void PiiGenicamDriver::capture()
       if (!_bCapturingRunning)
         break;
 
+      // Give frames released since the last round back to the
+      // grabber before waiting for new ones.
+      if (genicamRequeueBuffer != 0 && !requeueBuffers(lstBuffers, lstFrameIndices))
+        {
+          piiWarning(tr("Couldn't requeue buffers: %1").arg(lastError()));
+          _bCapturingRunning = false;
+          break;
+        }
+
       do
         {
           unsigned char* pBuffer = 0;
@@ -398,7 +495,7 @@ void PiiGenicamDriver::capture()
                       int adder = _iFrameBufferCount - _iFrameIndex % _iFrameBufferCount;
                       if (adder > 0)
                         {
-                          listener()->framesMissed(_iFrameIndex+1, _iFrameIndex+adder);
+                          reportMissedFrames(_iFrameIndex+1, _iFrameIndex+adder);
                           _iFrameIndex += adder;
                         }
                     }
@@ -407,15 +504,18 @@ void PiiGenicamDriver::capture()
 
           if (pBuffer == 0) break;
           lstBuffers << pBuffer;
+          lstFrameInfos << frameInfo(pBuffer, iPreviousTimestamp);
         }
       while (!bSoftwareTrigger && lstBuffers.size() < _iFrameBufferCount);
 
+      lstFrameIndices.fill(-1, lstBuffers.size());
       if (lstBuffers.size() > _iFrameBufferCount/2)
         {
-          listener()->framesMissed(_iFrameIndex+1, _iFrameIndex+lstBuffers.size()-1);
+          reportMissedFrames(_iFrameIndex+1, _iFrameIndex+lstBuffers.size()-1);
           _iFrameIndex += lstBuffers.size();
           _vecBufferPointers[_iFrameIndex % _iFrameBufferCount] = lstBuffers.last();
-          listener()->frameCaptured(_iFrameIndex, 0,0);
+          lstFrameIndices.last() = _iFrameIndex;
+          listener()->frameCaptured(_iFrameIndex, 0, lstFrameInfos.last());
           iHandledFrames = 1;
         }
       else if (lstBuffers.size() > 0)
@@ -424,22 +524,26 @@ void PiiGenicamDriver::capture()
             {
               ++_iFrameIndex;
               _vecBufferPointers[_iFrameIndex % _iFrameBufferCount] = lstBuffers[i];
-              listener()->frameCaptured(_iFrameIndex, 0,0);
+              lstFrameIndices[i] = _iFrameIndex;
+              listener()->frameCaptured(_iFrameIndex, 0, lstFrameInfos[i]);
             }
           iHandledFrames = lstBuffers.size();
         }
       else if (bSoftwareTrigger)
         listener()->frameCaptured(-1, 0,0);
 
-      if (lstBuffers.size() > 0)
-        lstBuffers.clear();
-
-      if (genicamRequeueBuffers(_pDevice) != 0)
+      if (!requeueBuffers(lstBuffers, lstFrameIndices))
         {
           piiWarning(tr("Couldn't requeue buffers: %1").arg(lastError()));
           _bCapturingRunning = false;
         }
 
+      if (lstBuffers.size() > 0)
+        {
+          lstBuffers.clear();
+          lstFrameInfos.clear();
+        }
+
       // Check if we must stop capturing
       if (_iMaxFrames > 0)
         {
@@ -457,6 +561,46 @@ void PiiGenicamDriver::capture()
   listener()->captureFinished(true);
 }
 
+bool PiiGenicamDriver::requeueBuffers(const QVector<unsigned char*>& buffers,
+                                      const QVector<qint64>& frameIndices)
+{
+  if (genicamRequeueBuffer == 0)
+    return genicamRequeueBuffers(_pDevice) == 0;
+
+  // All calls to the wrapper are made from the capture thread.
+  // Buffers released in other threads are requeued here.
+  QMutexLocker lock(&_bufferMutex);
+  for (int i=0; i<buffers.size(); ++i)
+    {
+      if (frameIndices[i] >= 0 && isFrameLeased(uint(frameIndices[i])))
+        _hashLeasedBuffers.insert(uint(frameIndices[i]), buffers[i]);
+      else if (genicamRequeueBuffer(_pDevice, buffers[i]) != 0)
+        return false;
+    }
+  for (int i=0; i<_vecReleasedBuffers.size(); ++i)
+    {
+      if (genicamRequeueBuffer(_pDevice, _vecReleasedBuffers[i]) != 0)
+        return false;
+    }
+  _vecReleasedBuffers.clear();
+  return true;
+}
+
+void PiiGenicamDriver::frameReleased(uint frameIndex)
+{
+  QMutexLocker lock(&_bufferMutex);
+  QHash<uint,unsigned char*>::iterator i = _hashLeasedBuffers.find(frameIndex);
+  if (i == _hashLeasedBuffers.end())
+    return;
+  _vecReleasedBuffers << i.value();
+  _hashLeasedBuffers.erase(i);
+}
+
+bool PiiGenicamDriver::supportsFrameLeasing() const
+{
+  return genicamRequeueBuffer != 0;
+}
+
 void* PiiGenicamDriver::frameBuffer(uint frameIndex) const
 {
   frameIndex %= _iFrameBufferCount;
@@ -523,6 +667,26 @@ int PiiGenicamDriver::triggerLine() const
 {
   return readIntValue("triggerLine");
 }
+int PiiGenicamDriver::captureCpu() const
+{
+  return _iCaptureCpu;
+}
+int PiiGenicamDriver::socketBufferSize() const
+{
+  return readIntValue("socketBufferSize", 0);
+}
+int PiiGenicamDriver::resentPacketCount() const
+{
+  return readIntValue("resentPacketCount", 0);
+}
+int PiiGenicamDriver::lostPacketCount() const
+{
+  return readIntValue("lostPacketCount", 0);
+}
+int PiiGenicamDriver::missedFrameCount() const
+{
+  return _iMissedFrameCount.load();
+}
 
 int PiiGenicamDriver::packetSize() const
 {
@@ -703,6 +867,18 @@ bool PiiGenicamDriver::setTriggerLine(int triggerLine)
   return writeIntValue("triggerLine", triggerLine);
 }
 
+bool PiiGenicamDriver::setCaptureCpu(int captureCpu)
+{
+  // Takes effect when the capture thread is started next time.
+  _iCaptureCpu = qMax(-1, captureCpu);
+  return true;
+}
+
+bool PiiGenicamDriver::setSocketBufferSize(int socketBufferSize)
+{
+  return writeIntValue("socketBufferSize", socketBufferSize);
+}
+
 int PiiGenicamDriver::readIntValue(const char* name, int defaultValue, bool* ok) const
 {
   int value = 0;
@@ -22,15 +22,34 @@ extern "C"
   GENICAM_TYPEDEF(int, GenicamIntDevicepCCharpIntpFunc)(genicam_device*,const char*,int*);
   GENICAM_TYPEDEF(int, GenicamIntDevicepUCharppIntFunc)(genicam_device*,unsigned char**,int);
   GENICAM_TYPEDEF(int, GenicamIntDevicepUCharpIntFunc)(genicam_device*,unsigned char*,int);
+  GENICAM_TYPEDEF(int, GenicamIntDevicepUCharpFunc)(genicam_device*,unsigned char*);
+  GENICAM_TYPEDEF(int, GenicamIntDevicepUCharpInfopFunc)(genicam_device*,unsigned char*,genicam_frame_info*);
 }
 
 #include <PiiWaitCondition.h>
+#include <PiiAtomicInt.h>
 #include <QThread>
 #include <QMutex>
+#include <QHash>
 #include <QLibrary>
 #include <PiiCameraDriver.h>
 
-/// @internal
+/**
+ * @internal
+ *
+ * Each driver instance controls one camera and runs its own capture
+ * thread with a private frame pool. To capture from many cameras at
+ * once, create one PiiCameraOperation per camera and set its
+ * `cameraId` to the serial number of the camera. The wrapper library
+ * is shared by all instances.
+ *
+ * The frames are grabbed directly into buffers allocated by the
+ * driver and registered with the wrapper. If the wrapper exports
+ * `genicam_requeue_buffer()`, frames can be leased (see
+ * PiiCameraDriver::leaseFrame()). A leased buffer is handed back to
+ * the grabber only after the last reference to the frame has been
+ * released. While all buffers are leased, the camera drops frames.
+ */
 class PII_CAMERA_EXPORT PiiGenicamDriver : public PiiCameraDriver
 {
   Q_OBJECT
@@ -66,6 +85,39 @@ class PII_CAMERA_EXPORT PiiGenicamDriver : public PiiCameraDriver
    */
   Q_PROPERTY(int triggerLine READ triggerLine WRITE setTriggerLine);
 
+  /**
+   * The index of the processor core the capture thread is bound to.
+   * With many cameras per host, binding each capture thread to a
+   * separate core prevents the threads from competing for the same
+   * core and keeps packet processing latency stable. -1 means the
+   * thread can run on any core. The default is -1.
+   */
+  Q_PROPERTY(int captureCpu READ captureCpu WRITE setCaptureCpu);
+
+  /**
+   * The size of the receive buffer of the stream socket in bytes.
+   * Large buffers are needed when many GigE cameras share a network
+   * interface. Zero means the default size of the operating system.
+   */
+  Q_PROPERTY(int socketBufferSize READ socketBufferSize WRITE setSocketBufferSize);
+
+  /**
+   * The number of packets the camera has resent on request since the
+   * capture was started.
+   */
+  Q_PROPERTY(int resentPacketCount READ resentPacketCount);
+
+  /**
+   * The number of packets that were lost even after resend requests.
+   */
+  Q_PROPERTY(int lostPacketCount READ lostPacketCount);
+
+  /**
+   * The number of frames dropped by the driver since the capture was
+   * started because the receiver could not keep up.
+   */
+  Q_PROPERTY(int missedFrameCount READ missedFrameCount);
+
   PII_DEFAULT_SERIALIZATION_FUNCTION(PiiCameraDriver)
 protected:
   PiiGenicamDriver(const QString& wrapperLibrary);
@@ -82,6 +134,7 @@ public:
   bool isCapturing() const;
   bool triggerImage();
   bool requiresInitialization(const char* name) const;
+  bool supportsFrameLeasing() const;
   bool setTriggerMode(PiiCameraDriver::TriggerMode mode);
   PiiCameraDriver::TriggerMode triggerMode() const;
   int bitsPerPixel() const;
@@ -107,6 +160,11 @@ public:
   QSize sensorSize() const;
   double triggerRate() const;
   int triggerLine() const;
+  int captureCpu() const;
+  int socketBufferSize() const;
+  int resentPacketCount() const;
+  int lostPacketCount() const;
+  int missedFrameCount() const;
 
   bool setFrameBufferCount(int frameBufferCount);
   bool setFrameRate(double frameRate);
@@ -120,6 +178,8 @@ public:
   bool setFlipHorizontally(bool flipHorizontally);
   bool setTriggerRate(double triggerRate);
   bool setTriggerLine(int triggerLine);
+  bool setCaptureCpu(int captureCpu);
+  bool setSocketBufferSize(int socketBufferSize);
 
   QVariant property(const char* name) const;
   bool setProperty(const char* name, const QVariant& value);
@@ -149,6 +209,11 @@ protected:
   GenicamIntDevicepFunc genicamRequeueBuffers;
   GenicamIntDevicepFunc genicamStartCapture;
   GenicamIntDevicepFunc genicamStopCapture;
+  // Optional, may be zero.
+  GenicamIntDevicepUCharpInfopFunc genicamFrameInfo;
+  GenicamIntDevicepUCharpFunc genicamRequeueBuffer;
+
+  void frameReleased(uint frameIndex);
 
   void capture();
   bool reconnect();
@@ -169,8 +234,20 @@ protected:
   TriggerMode _triggerMode;
   int _iFrameBufferCount;
   mutable QMutex _reconnectMutex;
+  int _iCaptureCpu;
+  PiiAtomicInt _iMissedFrameCount;
+  // Guards the two below.
+  QMutex _bufferMutex;
+  // Leased buffers by frame index.
+  QHash<uint,unsigned char*> _hashLeasedBuffers;
+  // Released buffers waiting to be requeued by the capture thread.
+  QVector<unsigned char*> _vecReleasedBuffers;
 
 private:
+  void bindCaptureThread();
+  void reportMissedFrames(uint startIndex, uint endIndex);
+  bool requeueBuffers(const QVector<unsigned char*>& buffers, const QVector<qint64>& frameIndices);
+  PiiCamera::FrameInfo frameInfo(unsigned char* buffer, qint64& previousTimestamp);
   QString lastError() const;
   int readIntValue(const char* name, int defaultValue = 0, bool *ok = 0) const;
   bool writeIntValue(const char* name, int value);
@@ -22,6 +22,16 @@ extern "C" {
 
   struct genicam_device;
 
+  /* Per-frame information. The timestamp is in microseconds of the
+     camera's clock. Unknown values are set to -1. */
+  struct genicam_frame_info
+  {
+    long long timestamp;
+    long long frame_counter;
+    int exposure_time;
+    int trigger_id;
+  };
+
   GENICAM_WAPI(int) genicam_initialize(void);
   GENICAM_WAPI(int) genicam_terminate(void);
 
@@ -36,6 +46,11 @@ extern "C" {
   GENICAM_WAPI(int) genicam_free(void* data);
   GENICAM_WAPI(void) genicam_last_error(char* bfr);
   
+  /* In addition to camera features, the following stream properties
+     are used by the driver: socketBufferSize (read/write, bytes),
+     resentPacketCount and lostPacketCount (read-only, reset when
+     capture is started). A wrapper that does not support them returns
+     an error. */
   GENICAM_WAPI(int) genicam_set_property(genicam_device* device, const char* name, int value);
   GENICAM_WAPI(int) genicam_get_property(genicam_device* device, const char* name, int *value);
 
@@ -44,6 +59,13 @@ extern "C" {
 
   GENICAM_WAPI(int) genicam_grab_frame(genicam_device* device, unsigned char** buffer, int timeout);
   GENICAM_WAPI(int) genicam_requeue_buffers(genicam_device* device);
+  /* Optional. Requeues a single buffer returned by
+     genicam_grab_frame(). The other reserved buffers stay out of the
+     grabber until they are requeued. */
+  GENICAM_WAPI(int) genicam_requeue_buffer(genicam_device* device, unsigned char* buffer);
+  /* Optional. Reads the information of a frame returned by
+     genicam_grab_frame() before the buffer is requeued. */
+  GENICAM_WAPI(int) genicam_get_frame_info(genicam_device* device, unsigned char* buffer, genicam_frame_info* info);
 
   GENICAM_WAPI(int) genicam_start_capture(genicam_device* device);
   GENICAM_WAPI(int) genicam_stop_capture(genicam_device* device);
@@ -18,6 +18,7 @@
 
 #include <PiiMatrix.h>
 #include <PiiColor.h>
+#include <PiiParallel.h>
 #include <PiiCameraGlobal.h>
 
 namespace PiiCamera
@@ -250,35 +251,84 @@ namespace PiiCamera
   };
 
   /**
-   * Bayer decoding structure for RGGB color ordering.
+   * An interpolation functor that calculates the value of a color
+   * channel by averaging the two straight neighbors along the
+   * direction of the smaller gradient. If the horizontal and vertical
+   * gradients are equal, all four neighbors are averaged. This
+   * reduces the zipper artefacts bilinear interpolation causes at
+   * edges. The functor can be used in place of StraightInterpolator
+   * for the green channel at red and blue pixels.
+   *
+   * ~~~(c++)
+   * typedef PiiCamera::RggbDecoder<unsigned char, PiiCamera::EdgeSensingInterpolator<unsigned char> > Decoder;
+   * PiiMatrix<PiiColor4<> > matRgb(PiiCamera::bayerToRgb(encoded, Decoder(), PiiCamera::Rgb4Pixel<>()));
+   * ~~~
+   */
+  template <class T> struct EdgeSensingInterpolator : StraightInterpolator<T>
+  {
+    int center(const T* ptr0, const T* ptr1, const T* ptr2) const
+    {
+      const int iHorizontal = qAbs(int(ptr1[0]) - int(ptr1[2])),
+        iVertical = qAbs(int(ptr0[1]) - int(ptr2[1]));
+      if (iHorizontal < iVertical)
+        return (ptr1[0] + ptr1[2]) >> 1;
+      else if (iVertical < iHorizontal)
+        return (ptr0[1] + ptr2[1]) >> 1;
+      return StraightInterpolator<T>::center(ptr0, ptr1, ptr2);
+    }
+  };
+
+  /**
+   * Bayer decoding structure for RGGB color ordering. *Straight* is
+   * the interpolator used for the green channel at red and blue
+   * pixels. The `redRow` and `redColumn` constants tell the position
+   * of the red pixel in the 2-by-2 pattern. They are needed by
+   * [bayerToRgbBinned()].
    */
-  template <class T = unsigned char> struct RggbDecoder :
-    public BayerDecoder<CenterInterpolator<T>,StraightInterpolator<T>,DiagonalInterpolator<T>,
+  template <class T = unsigned char, class Straight = StraightInterpolator<T> > struct RggbDecoder :
+    public BayerDecoder<CenterInterpolator<T>,Straight,DiagonalInterpolator<T>,
                         HorizontalInterpolator<T>,CenterInterpolator<T>,VerticalInterpolator<T>,
                         VerticalInterpolator<T>,CenterInterpolator<T>,HorizontalInterpolator<T>,
-                        DiagonalInterpolator<T>,StraightInterpolator<T>,CenterInterpolator<T> >
-  {};
+                        DiagonalInterpolator<T>,Straight,CenterInterpolator<T> >
+  {
+    enum { redRow = 0, redColumn = 0 };
+  };
 
   /**
    * Bayer decoding structure for GRBG color ordering.
    */
-  template <class T = unsigned char> struct GrbgDecoder :
+  template <class T = unsigned char, class Straight = StraightInterpolator<T> > struct GrbgDecoder :
     public BayerDecoder<HorizontalInterpolator<T>,CenterInterpolator<T>,VerticalInterpolator<T>,
-                        CenterInterpolator<T>,StraightInterpolator<T>,DiagonalInterpolator<T>,
-                        DiagonalInterpolator<T>,StraightInterpolator<T>,CenterInterpolator<T>,
+                        CenterInterpolator<T>,Straight,DiagonalInterpolator<T>,
+                        DiagonalInterpolator<T>,Straight,CenterInterpolator<T>,
                         VerticalInterpolator<T>,CenterInterpolator<T>,HorizontalInterpolator<T> >
-  {};
+  {
+    enum { redRow = 0, redColumn = 1 };
+  };
 
+  /**
+   * Bayer decoding structure for GBRG color ordering.
+   */
+  template <class T = unsigned char, class Straight = StraightInterpolator<T> > struct GbrgDecoder :
+    public BayerDecoder<VerticalInterpolator<T>,CenterInterpolator<T>,HorizontalInterpolator<T>,
+                        DiagonalInterpolator<T>,Straight,CenterInterpolator<T>,
+                        CenterInterpolator<T>,Straight,DiagonalInterpolator<T>,
+                        HorizontalInterpolator<T>,CenterInterpolator<T>,VerticalInterpolator<T> >
+  {
+    enum { redRow = 1, redColumn = 0 };
+  };
 
   /**
    * Bayer decoding structure for BGGR color ordering.
    */
-  template <class T = unsigned char> struct BggrDecoder :
-    public BayerDecoder<DiagonalInterpolator<T>,StraightInterpolator<T>,CenterInterpolator<T>,
+  template <class T = unsigned char, class Straight = StraightInterpolator<T> > struct BggrDecoder :
+    public BayerDecoder<DiagonalInterpolator<T>,Straight,CenterInterpolator<T>,
                         VerticalInterpolator<T>,CenterInterpolator<T>,HorizontalInterpolator<T>,
                         HorizontalInterpolator<T>,CenterInterpolator<T>,VerticalInterpolator<T>,
-                        CenterInterpolator<T>,StraightInterpolator<T>,DiagonalInterpolator<T> >
-  {};
+                        CenterInterpolator<T>,Straight,DiagonalInterpolator<T> >
+  {
+    enum { redRow = 1, redColumn = 1 };
+  };
 
   /**
    * Rgb color pixel type functor for Bayer decoding. Uses PiiColor<T>
@@ -358,6 +408,171 @@ namespace PiiCamera
     Type operator()(int r, int g, int b) const { return Type((r+g+b)/3); }
   };
 
+  /// @hide
+  // Decodes the top row. The pointers point to the first pixel on the
+  // first two rows. The interpolators decode the colors of pixels at
+  // even (0) and odd (1) columns.
+  template <class T, class U, class R0, class G0, class B0, class R1, class G1, class B1, class Pixel>
+  void decodeBayerTopRow(const T* row1, const T* row2, U* resultRow, int columns,
+                         const R0& r0, const G0& g0, const B0& b0,
+                         const R1& r1, const G1& g1, const B1& b1,
+                         const Pixel& pixel)
+  {
+    --row1; --row2;
+    resultRow[0] = pixel(r0.topLeft(row1, row2), g0.topLeft(row1, row2), b0.topLeft(row1, row2));
+    ++row1; ++row2;
+
+    int c = 1;
+    // Two pixels at a time, an odd column first. This avoids testing
+    // the parity of each column.
+    for (; c < columns-2; c += 2, row1 += 2, row2 += 2)
+      {
+        resultRow[c] = pixel(r1.top(row1, row2), g1.top(row1, row2), b1.top(row1, row2));
+        resultRow[c+1] = pixel(r0.top(row1+1, row2+1), g0.top(row1+1, row2+1), b0.top(row1+1, row2+1));
+      }
+    if (c < columns-1)
+      {
+        resultRow[c] = pixel(r1.top(row1, row2), g1.top(row1, row2), b1.top(row1, row2));
+        ++c; ++row1; ++row2;
+      }
+
+    if (c & 1)
+      resultRow[c] = pixel(r1.topRight(row1, row2), g1.topRight(row1, row2), b1.topRight(row1, row2));
+    else
+      resultRow[c] = pixel(r0.topRight(row1, row2), g0.topRight(row1, row2), b0.topRight(row1, row2));
+  }
+
+  // Decodes a row that has a neighbor both above and below.
+  template <class T, class U, class R0, class G0, class B0, class R1, class G1, class B1, class Pixel>
+  void decodeBayerRow(const T* row0, const T* row1, const T* row2, U* resultRow, int columns,
+                      const R0& r0, const G0& g0, const B0& b0,
+                      const R1& r1, const G1& g1, const B1& b1,
+                      const Pixel& pixel)
+  {
+    --row0; --row1; --row2;
+    resultRow[0] = pixel(r0.left(row0, row1, row2), g0.left(row0, row1, row2), b0.left(row0, row1, row2));
+    ++row0; ++row1; ++row2;
+
+    int c = 1;
+    for (; c < columns-2; c += 2, row0 += 2, row1 += 2, row2 += 2)
+      {
+        resultRow[c] = pixel(r1.center(row0, row1, row2),
+                             g1.center(row0, row1, row2),
+                             b1.center(row0, row1, row2));
+        resultRow[c+1] = pixel(r0.center(row0+1, row1+1, row2+1),
+                               g0.center(row0+1, row1+1, row2+1),
+                               b0.center(row0+1, row1+1, row2+1));
+      }
+    if (c < columns-1)
+      {
+        resultRow[c] = pixel(r1.center(row0, row1, row2),
+                             g1.center(row0, row1, row2),
+                             b1.center(row0, row1, row2));
+        ++c; ++row0; ++row1; ++row2;
+      }
+
+    if (c & 1)
+      resultRow[c] = pixel(r1.right(row0, row1, row2), g1.right(row0, row1, row2), b1.right(row0, row1, row2));
+    else
+      resultRow[c] = pixel(r0.right(row0, row1, row2), g0.right(row0, row1, row2), b0.right(row0, row1, row2));
+  }
+
+  // Decodes the bottom row.
+  template <class T, class U, class R0, class G0, class B0, class R1, class G1, class B1, class Pixel>
+  void decodeBayerBottomRow(const T* row0, const T* row1, U* resultRow, int columns,
+                            const R0& r0, const G0& g0, const B0& b0,
+                            const R1& r1, const G1& g1, const B1& b1,
+                            const Pixel& pixel)
+  {
+    --row0; --row1;
+    resultRow[0] = pixel(r0.bottomLeft(row0, row1), g0.bottomLeft(row0, row1), b0.bottomLeft(row0, row1));
+    ++row0; ++row1;
+
+    int c = 1;
+    for (; c < columns-2; c += 2, row0 += 2, row1 += 2)
+      {
+        resultRow[c] = pixel(r1.bottom(row0, row1), g1.bottom(row0, row1), b1.bottom(row0, row1));
+        resultRow[c+1] = pixel(r0.bottom(row0+1, row1+1), g0.bottom(row0+1, row1+1), b0.bottom(row0+1, row1+1));
+      }
+    if (c < columns-1)
+      {
+        resultRow[c] = pixel(r1.bottom(row0, row1), g1.bottom(row0, row1), b1.bottom(row0, row1));
+        ++c; ++row0; ++row1;
+      }
+
+    if (c & 1)
+      resultRow[c] = pixel(r1.bottomRight(row0, row1), g1.bottomRight(row0, row1), b1.bottomRight(row0, row1));
+    else
+      resultRow[c] = pixel(r0.bottomRight(row0, row1), g0.bottomRight(row0, row1), b0.bottomRight(row0, row1));
+  }
+
+  // Decodes rows [firstRow, firstRow + rowCount). The result is
+  // accessed through a pointer to its first row because non-const
+  // access to a PiiMatrix may detach it.
+  template <class T, class U, class Decoder, class Pixel>
+  void decodeBayerRows(const PiiMatrix<T>& encoded, U* result, std::size_t stride,
+                       const Decoder& decoder, const Pixel& pixel,
+                       int firstRow, int rowCount)
+  {
+    const int iRows = encoded.rows(), iColumns = encoded.columns();
+    for (int r=firstRow; r<firstRow+rowCount; ++r)
+      {
+        U* resultRow = reinterpret_cast<U*>(reinterpret_cast<char*>(result) + r * stride);
+        if (r == 0)
+          decodeBayerTopRow(encoded[0], encoded[1], resultRow, iColumns,
+                            decoder.interpolatorR00, decoder.interpolatorG00, decoder.interpolatorB00,
+                            decoder.interpolatorR01, decoder.interpolatorG01, decoder.interpolatorB01,
+                            pixel);
+        else if (r == iRows-1)
+          {
+            if (r & 1)
+              decodeBayerBottomRow(encoded[r-1], encoded[r], resultRow, iColumns,
+                                   decoder.interpolatorR10, decoder.interpolatorG10, decoder.interpolatorB10,
+                                   decoder.interpolatorR11, decoder.interpolatorG11, decoder.interpolatorB11,
+                                   pixel);
+            else
+              decodeBayerBottomRow(encoded[r-1], encoded[r], resultRow, iColumns,
+                                   decoder.interpolatorR00, decoder.interpolatorG00, decoder.interpolatorB00,
+                                   decoder.interpolatorR01, decoder.interpolatorG01, decoder.interpolatorB01,
+                                   pixel);
+          }
+        else if (r & 1)
+          decodeBayerRow(encoded[r-1], encoded[r], encoded[r+1], resultRow, iColumns,
+                         decoder.interpolatorR10, decoder.interpolatorG10, decoder.interpolatorB10,
+                         decoder.interpolatorR11, decoder.interpolatorG11, decoder.interpolatorB11,
+                         pixel);
+        else
+          decodeBayerRow(encoded[r-1], encoded[r], encoded[r+1], resultRow, iColumns,
+                         decoder.interpolatorR00, decoder.interpolatorG00, decoder.interpolatorB00,
+                         decoder.interpolatorR01, decoder.interpolatorG01, decoder.interpolatorB01,
+                         pixel);
+      }
+  }
+
+  template <class T, class Decoder, class Pixel> class BayerBand
+  {
+  public:
+    typedef typename Pixel::Type U;
+
+    BayerBand(const PiiMatrix<T>& encoded, PiiMatrix<U>& result,
+              const Decoder& decoder, const Pixel& pixel) :
+      _encoded(encoded), _resultRows(result),
+      _decoder(decoder), _pixel(pixel)
+    {}
+
+    void operator() (int firstRow, int rowCount) const
+    {
+      decodeBayerRows(_encoded, _resultRows.data(), _resultRows.stride(), _decoder, _pixel, firstRow, rowCount);
+    }
+
+  private:
+    const PiiMatrix<T>& _encoded;
+    const Pii::BandRows<U> _resultRows;
+    Decoder _decoder;
+    Pixel _pixel;
+  };
+  /// @endhide
+
   template <class T, class Decoder, class Pixel>
   void bayerToRgb(const PiiMatrix<T>& encoded,
                   PiiMatrix<typename Pixel::Type>& result,
@@ -415,7 +630,7 @@ namespace PiiCamera
                                              Pixel pixel)
   {
     typedef typename Pixel::Type U;
-    PiiMatrix<U> matResult(PiiMatrix<T>::uninitialized(encoded.rows(), encoded.columns()));
+    PiiMatrix<U> matResult(PiiMatrix<U>::uninitialized(encoded.rows(), encoded.columns()));
     bayerToRgb(encoded, matResult, decoder, pixel);
     return matResult;
   }
@@ -423,7 +638,14 @@ namespace PiiCamera
   /**
    * This version stores the decoded color data into *result*, which
    * must be preallocated by the caller. The size of *result* must be
-   * the same as that of *encoded*.
+   * the same as that of *encoded*. A camera driver can use this
+   * function to decode directly into a buffer of its own by wrapping
+   * the buffer into a PiiMatrix.
+   *
+   * ~~~(c++)
+   * PiiMatrix<PiiColor4<> > matFrame(iHeight, iWidth, pBuffer, Pii::RetainOwnership);
+   * PiiCamera::bayerToRgb(encoded, matFrame, PiiCamera::BggrDecoder<>(), PiiCamera::Rgb4Pixel<>());
+   * ~~~
    */
   template <class T, class Decoder, class Pixel>
   void bayerToRgb(const PiiMatrix<T>& encoded,
@@ -431,189 +653,111 @@ namespace PiiCamera
                   Decoder decoder,
                   Pixel pixel)
   {
-    typedef typename Pixel::Type U;
-
     // Cannot handle too small input
     if (encoded.rows() < 2 || encoded.columns() < 2)
       return;
 
-    // PENDING all loops could be optimized to step two pixels at a
-    // time. The c & 1 or r & 1 comparison could be avoided.
-
-    U* resultRow = result.row(0);
-
-    // Pointers to the previous, current, and next row
-    const T* row0, *row1, *row2;
-
-    int c;
-    row1 = encoded.row(0)-1;
-    row2 = encoded.row(1)-1;
+    decodeBayerRows(encoded, result.row(0), result.stride(), decoder, pixel, 0, encoded.rows());
+  }
 
-    // Top left corner
-    resultRow[0] = pixel(decoder.interpolatorR00.topLeft(row1, row2),
-                         decoder.interpolatorG00.topLeft(row1, row2),
-                         decoder.interpolatorB00.topLeft(row1, row2));
+  /**
+   * Decodes a Bayer-encoded image in parallel. The image is split
+   * into bands of rows as determined by *policy*. The result is
+   * identical to that of the sequential version.
+   *
+   * @see bayerToRgb(const PiiMatrix<T>&, Decoder, Pixel)
+   */
+  template <class T, class Decoder, class Pixel>
+  void bayerToRgb(const Pii::ParallelExecution& policy,
+                  const PiiMatrix<T>& encoded,
+                  PiiMatrix<typename Pixel::Type>& result,
+                  Decoder decoder,
+                  Pixel pixel)
+  {
+    if (encoded.rows() < 2 || encoded.columns() < 2)
+      return;
 
-    ++row1; ++row2;
+    Pii::forEachBand(policy, encoded.rows(), 0, BayerBand<T,Decoder,Pixel>(encoded, result, decoder, pixel));
+  }
 
-    // Top Row
-    for (c = 1; c<encoded.columns()-1; ++c, ++row1, ++row2)
-      {
-        if (c & 1)
-          resultRow[c] = pixel(decoder.interpolatorR01.top(row1, row2),
-                               decoder.interpolatorG01.top(row1, row2),
-                               decoder.interpolatorB01.top(row1, row2));
-        else
-          resultRow[c] = pixel(decoder.interpolatorR00.top(row1, row2),
-                               decoder.interpolatorG00.top(row1, row2),
-                               decoder.interpolatorB00.top(row1, row2));
-      }
-    // Top right corner
-    if (c & 1)
-      resultRow[c] = pixel(decoder.interpolatorR01.topRight(row1, row2),
-                           decoder.interpolatorG01.topRight(row1, row2),
-                           decoder.interpolatorB01.topRight(row1, row2));
-    else
-      resultRow[c] = pixel(decoder.interpolatorR00.topRight(row1, row2),
-                           decoder.interpolatorG00.topRight(row1, row2),
-                           decoder.interpolatorB00.topRight(row1, row2));
+  /**
+   * Decodes a Bayer-encoded image in parallel and returns the result
+   * in a newly allocated matrix.
+   */
+  template <class T, class Decoder, class Pixel>
+  PiiMatrix<typename Pixel::Type> bayerToRgb(const Pii::ParallelExecution& policy,
+                                             const PiiMatrix<T>& encoded,
+                                             Decoder decoder,
+                                             Pixel pixel)
+  {
+    typedef typename Pixel::Type U;
+    PiiMatrix<U> matResult(PiiMatrix<U>::uninitialized(encoded.rows(), encoded.columns()));
+    bayerToRgb(policy, encoded, matResult, decoder, pixel);
+    return matResult;
+  }
 
+  /**
+   * Decodes a Bayer-encoded image at a reduced resolution. Each
+   * *scale*-by-*scale* block of input pixels becomes one output pixel
+   * whose color channels are the averages of the red, green and blue
+   * pixels in the block. No interpolation is needed, and the cost is
+   * only a fraction of full-resolution decoding followed by
+   * scaling. This is useful for preview images.
+   *
+   * @param encoded a Bayer-encoded image
+   *
+   * @param decoder determines the color ordering. The decoder must
+   * define the `redRow` and `redColumn` constants, as the predefined
+   * decoders do. The interpolators are not used.
+   *
+   * @param pixel converts the averaged channels to the output type
+   *
+   * @param scale the size of a block. Must be even; usually 2 or 4.
+   * If the size of *encoded* is not divisible by *scale*, the
+   * remaining rows and columns will be ignored.
+   *
+   * ~~~(c++)
+   * // 1/4 resolution preview
+   * PiiMatrix<PiiColor4<> > matPreview(PiiCamera::bayerToRgbBinned(encoded,
+   *                                                                PiiCamera::BggrDecoder<>(),
+   *                                                                PiiCamera::Rgb4Pixel<>(),
+   *                                                                4));
+   * ~~~
+   */
+  template <class T, class Decoder, class Pixel>
+  PiiMatrix<typename Pixel::Type> bayerToRgbBinned(const PiiMatrix<T>& encoded,
+                                                   Decoder /*decoder*/,
+                                                   Pixel pixel,
+                                                   int scale = 2)
+  {
+    typedef typename Pixel::Type U;
+    // Number of 2-by-2 cells in each direction
+    const int iCells = qMax(scale/2, 1), iScale = iCells * 2, iCellCount = iCells * iCells;
+    const int iRows = encoded.rows() / iScale, iColumns = encoded.columns() / iScale;
+    const int iRedRow = Decoder::redRow, iRedColumn = Decoder::redColumn;
 
-    // Handle all but the top and bottom rows
-    int r = 1;
-    for (;r<encoded.rows()-1; ++r)
+    PiiMatrix<U> matResult(PiiMatrix<U>::uninitialized(iRows, iColumns));
+    for (int r=0; r<iRows; ++r)
       {
-        row0 = encoded.row(r-1)-1;
-        row1 = encoded.row(r)-1;
-        row2 = encoded.row(r+1)-1;
-        resultRow = result.row(r);
-
-        // Odd rows
-        if (r & 1)
-          {
-            // Handle the lefmost pixel
-            resultRow[0] = pixel(decoder.interpolatorR10.left(row0, row1, row2),
-                                 decoder.interpolatorG10.left(row0, row1, row2),
-                                 decoder.interpolatorB10.left(row0, row1, row2));
-
-            ++row0; ++row1; ++row2;
-            for (c = 1; c<encoded.columns()-1; ++c, ++row0, ++row1, ++row2)
-              {
-                if (c & 1)
-                  resultRow[c] = pixel(decoder.interpolatorR11.center(row0, row1, row2),
-                                       decoder.interpolatorG11.center(row0, row1, row2),
-                                       decoder.interpolatorB11.center(row0, row1, row2));
-                else
-                  resultRow[c] = pixel(decoder.interpolatorR10.center(row0, row1, row2),
-                                       decoder.interpolatorG10.center(row0, row1, row2),
-                                       decoder.interpolatorB10.center(row0, row1, row2));
-              }
-            // Handle the rightmost pixel
-            if (c & 1)
-              resultRow[c] = pixel(decoder.interpolatorR11.right(row0, row1, row2),
-                                   decoder.interpolatorG11.right(row0, row1, row2),
-                                   decoder.interpolatorB11.right(row0, row1, row2));
-            else
-              resultRow[c] = pixel(decoder.interpolatorR10.right(row0, row1, row2),
-                                   decoder.interpolatorG10.right(row0, row1, row2),
-                                   decoder.interpolatorB10.right(row0, row1, row2));
-          }
-        // Even rows
-        else
+        U* pResult = matResult[r];
+        for (int c=0; c<iColumns; ++c)
           {
-            resultRow[0] = pixel(decoder.interpolatorR00.left(row0, row1, row2),
-                                 decoder.interpolatorG00.left(row0, row1, row2),
-                                 decoder.interpolatorB00.left(row0, row1, row2));
-
-            ++row0; ++row1; ++row2;
-            for (c = 1; c<encoded.columns()-1; ++c, ++row0, ++row1, ++row2)
+            int iRed = 0, iGreen = 0, iBlue = 0;
+            for (int i=0; i<iCells; ++i)
               {
-                if (c & 1)
-                  resultRow[c] = pixel(decoder.interpolatorR01.center(row0, row1, row2),
-                                       decoder.interpolatorG01.center(row0, row1, row2),
-                                       decoder.interpolatorB01.center(row0, row1, row2));
-                else
-                  resultRow[c] = pixel(decoder.interpolatorR00.center(row0, row1, row2),
-                                       decoder.interpolatorG00.center(row0, row1, row2),
-                                       decoder.interpolatorB00.center(row0, row1, row2));
+                const T* pRed = encoded[r*iScale + 2*i + iRedRow] + c*iScale;
+                const T* pBlue = encoded[r*iScale + 2*i + 1 - iRedRow] + c*iScale;
+                for (int j=0; j<iScale; j += 2)
+                  {
+                    iRed += pRed[j + iRedColumn];
+                    iGreen += pRed[j + 1 - iRedColumn] + pBlue[j + iRedColumn];
+                    iBlue += pBlue[j + 1 - iRedColumn];
+                  }
               }
-            if (c & 1)
-              resultRow[c] = pixel(decoder.interpolatorR01.right(row0, row1, row2),
-                                   decoder.interpolatorG01.right(row0, row1, row2),
-                                   decoder.interpolatorB01.right(row0, row1, row2));
-            else
-              resultRow[c] = pixel(decoder.interpolatorR00.right(row0, row1, row2),
-                                   decoder.interpolatorG00.right(row0, row1, row2),
-                                   decoder.interpolatorB00.right(row0, row1, row2));
+            pResult[c] = pixel(iRed / iCellCount, iGreen / (2*iCellCount), iBlue / iCellCount);
           }
       }
-
-    resultRow = result.row(r);
-    row0 = encoded.row(r-1)-1;
-    row1 = encoded.row(r)-1;
-
-    // Last row is odd
-    if (r & 1)
-      {
-        // Bottom left corner
-        resultRow[0] = pixel(decoder.interpolatorR10.bottomLeft(row0, row1),
-                             decoder.interpolatorG10.bottomLeft(row0, row1),
-                             decoder.interpolatorB10.bottomLeft(row0, row1));
-
-        ++row0; ++row1;
-        // Bottom Row
-        for (c = 1; c<encoded.columns()-1; ++c, ++row0, ++row1)
-          {
-            if (c & 1)
-              resultRow[c] = pixel(decoder.interpolatorR11.bottom(row0, row1),
-                                   decoder.interpolatorG11.bottom(row0, row1),
-                                   decoder.interpolatorB11.bottom(row0, row1));
-            else
-              resultRow[c] = pixel(decoder.interpolatorR10.bottom(row0, row1),
-                                   decoder.interpolatorG10.bottom(row0, row1),
-                                   decoder.interpolatorB10.bottom(row0, row1));
-          }
-
-        // Bottom right corner
-        if (c & 1)
-          resultRow[c] = pixel(decoder.interpolatorR11.bottomRight(row0, row1),
-                               decoder.interpolatorG11.bottomRight(row0, row1),
-                               decoder.interpolatorB11.bottomRight(row0, row1));
-        else
-          resultRow[c] = pixel(decoder.interpolatorR10.bottomRight(row0, row1),
-                               decoder.interpolatorG10.bottomRight(row0, row1),
-                               decoder.interpolatorB10.bottomRight(row0, row1));
-      }
-    // Last row is even
-    else
-      {
-        resultRow[0] = pixel(decoder.interpolatorR00.bottomLeft(row0, row1),
-                             decoder.interpolatorG00.bottomLeft(row0, row1),
-                             decoder.interpolatorB00.bottomLeft(row0, row1));
-
-        // Bottom Row
-        for (c = 1; c<encoded.columns()-1; ++c, ++row0, ++row1)
-          {
-            if (c & 1)
-              resultRow[c] = pixel(decoder.interpolatorR01.bottom(row0, row1),
-                                   decoder.interpolatorG01.bottom(row0, row1),
-                                   decoder.interpolatorB01.bottom(row0, row1));
-            else
-              resultRow[c] = pixel(decoder.interpolatorR00.bottom(row0, row1),
-                                   decoder.interpolatorG00.bottom(row0, row1),
-                                   decoder.interpolatorB00.bottom(row0, row1));
-          }
-
-        // Bottom right corner
-        if (c & 1)
-          resultRow[c] = pixel(decoder.interpolatorR01.bottomRight(row0, row1),
-                               decoder.interpolatorG01.bottomRight(row0, row1),
-                               decoder.interpolatorB01.bottomRight(row0, row1));
-        else
-          resultRow[c] = pixel(decoder.interpolatorR00.bottomRight(row0, row1),
-                               decoder.interpolatorG00.bottomRight(row0, row1),
-                               decoder.interpolatorB00.bottomRight(row0, row1));
-      }
+    return matResult;
   }
 
   /**
@@ -16,6 +16,8 @@
 #ifndef _PIICAMERA_H
 #define _PIICAMERA_H
 
+#include <QtGlobal>
+
 /**
  * Camera-related utility functions and definitions.
  *
@@ -43,9 +45,16 @@ namespace PiiCamera
    *
    * - `Yuv411Format` - the image is in YUV411-format.
    *
+   * - `Nv12Format` - the image is in YUV 4:2:0 format with a
+   * full-resolution luma plane followed by a half-resolution plane of
+   * interleaved U and V samples.
+   *
    * - `RgbFormat` - the image is in RGB format
    *
    * - `BgrFormat` - the image is in BGR format.
+   *
+   * - `MjpegFormat` - the camera sends each frame as a JPEG image.
+   * Drivers decode the frames and deliver them in RGB format.
    */
   enum ImageFormat
     {
@@ -57,8 +66,10 @@ namespace PiiCamera
       BayerGRBGFormat,
       Yuv411Format,
       Yuv422Format,
+      Nv12Format,
       RgbFormat = 16,
-      BgrFormat
+      BgrFormat,
+      MjpegFormat
     };
 
   /**
@@ -73,6 +84,45 @@ namespace PiiCamera
       AreaScan = 0,
       LineScan
     };
+
+  /**
+   * Per-frame information provided by a camera. The structure is
+   * passed by value and never allocated from the heap. Fields the
+   * camera cannot provide are set to -1.
+   *
+   * - `timestamp` - the time the exposure started as measured by the
+   * camera's clock, in microseconds. Unlike the time of arrival, the
+   * device timestamp does not jitter with host load, which makes it
+   * possible to align frames from many cameras.
+   *
+   * - `elapsedTime` - the time in microseconds since the previous
+   * frame, or zero if not known. This is the value passed to the
+   * old-style [PiiCameraDriver::Listener::frameCaptured()]
+   * "frameCaptured()".
+   *
+   * - `frameCounter` - the frame counter of the camera.
+   *
+   * - `exposureTime` - the exposure time of the frame in microseconds.
+   *
+   * - `triggerId` - the identifier of the trigger that started the
+   * exposure, typically a counter of hardware trigger pulses.
+   */
+  struct FrameInfo
+  {
+    FrameInfo() :
+      timestamp(-1),
+      elapsedTime(0),
+      frameCounter(-1),
+      exposureTime(-1),
+      triggerId(-1)
+    {}
+
+    qint64 timestamp;
+    qint64 elapsedTime;
+    qint64 frameCounter;
+    int exposureTime;
+    int triggerId;
+  };
 }
 
 #endif //_PIICAMERA_H
@@ -81,11 +81,68 @@ bool PiiCameraDriver::setProperty(const char* name, const QVariant& value)
 
 
 
+struct PiiCameraDriver::Lease
+{
+  Lease(PiiCameraDriver* driver, uint frameIndex) : pDriver(driver), iFrameIndex(frameIndex) {}
+  PiiCameraDriver* pDriver;
+  uint iFrameIndex;
+};
+
+bool PiiCameraDriver::supportsFrameLeasing() const { return false; }
+
+void* PiiCameraDriver::leaseFrameBuffer(uint frameIndex, void** lease)
+{
+  if (!supportsFrameLeasing())
+    return 0;
+  void* pBuffer = frameBuffer(frameIndex);
+  if (pBuffer == 0)
+    return 0;
+  QMutexLocker lock(&d->leaseMutex);
+  ++d->hashLeaseCounts[frameIndex];
+  *lease = new Lease(this, frameIndex);
+  return pBuffer;
+}
+
+void PiiCameraDriver::releaseFrameBuffer(void* lease)
+{
+  Lease* pLease = static_cast<Lease*>(lease);
+  PiiCameraDriver* pDriver = pLease->pDriver;
+  const uint iFrameIndex = pLease->iFrameIndex;
+  delete pLease;
+
+  {
+    QMutexLocker lock(&pDriver->d->leaseMutex);
+    QHash<uint,int>::iterator i = pDriver->d->hashLeaseCounts.find(iFrameIndex);
+    if (--i.value() > 0)
+      return;
+    pDriver->d->hashLeaseCounts.erase(i);
+  }
+  pDriver->frameReleased(iFrameIndex);
+}
+
+bool PiiCameraDriver::isFrameLeased(uint frameIndex) const
+{
+  QMutexLocker lock(&d->leaseMutex);
+  return d->hashLeaseCounts.contains(frameIndex);
+}
+
+int PiiCameraDriver::leasedFrameCount() const
+{
+  QMutexLocker lock(&d->leaseMutex);
+  return d->hashLeaseCounts.size();
+}
+
+void PiiCameraDriver::frameReleased(uint /*frameIndex*/) {}
+
 void PiiCameraDriver::setListener(Listener* listener) { d->pListener = listener; }
 PiiCameraDriver::Listener* PiiCameraDriver::listener() const { return d->pListener; }
 
 PiiCameraDriver::Listener::~Listener() {}
 void PiiCameraDriver::Listener::frameCaptured(uint /*frameIndex*/, void* /*frameBuffer*/, qint64 /*elapsedTime*/) {}
+void PiiCameraDriver::Listener::frameCaptured(uint frameIndex, void* frameBuffer, const PiiCamera::FrameInfo& info)
+{
+  frameCaptured(frameIndex, frameBuffer, info.elapsedTime);
+}
 void PiiCameraDriver::Listener::framesMissed(uint /*startIndex*/, uint /*endIndex*/) {}
 void PiiCameraDriver::Listener::captureFinished(bool /*state*/) {}
 void PiiCameraDriver::Listener::captureError(const QString& /*message*/) {}
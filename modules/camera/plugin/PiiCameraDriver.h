@@ -18,8 +18,11 @@
 
 #include <QObject>
 #include <QSize>
+#include <QMutex>
+#include <QHash>
 
 #include <PiiConfigurable.h>
+#include <PiiMatrix.h>
 
 #include "PiiCameraDriverException.h"
 #include "PiiCamera.h"
@@ -89,6 +92,20 @@
  * taken to ensure proper mutual exclusion. To directly access the
  * frame buffer memory, use the [frameBuffer()] function.
  *
+ * Leasing frame buffers
+ * ---------------------
+ *
+ * Drivers that use a circular frame buffer may allow the frames to be
+ * *leased*. [leaseFrame()] wraps a frame buffer into an immutable
+ * matrix without copying the data. The frame stays leased until the
+ * last copy of the matrix has been destroyed, after which the driver
+ * is informed via [frameReleased()]. A driver that supports leasing
+ * must return `true` from [supportsFrameLeasing()] and must not
+ * overwrite a leased frame. If the next free slot in the buffer is
+ * still leased, the driver must drop the incoming frame and report it
+ * with [PiiCameraDriver::Listener::framesMissed()]
+ * "framesMissed()".
+ *
  */
 class PII_CAMERA_EXPORT PiiCameraDriver : public QObject, public PiiConfigurable
 {
@@ -245,6 +262,44 @@ public:
    */
   virtual void* frameBuffer(uint frameIndex = 0) const = 0;
 
+  /**
+   * Returns `true` if the driver allows frame buffers to be leased
+   * with [leaseFrame()]. The default implementation returns `false`.
+   */
+  virtual bool supportsFrameLeasing() const;
+
+  /**
+   * Returns the frame buffer of *frameIndex* as a *rows*-by-*columns*
+   * matrix that refers to the driver's memory. The frame stays leased
+   * until the returned matrix and all copies of it have been
+   * destroyed. The matrix is immutable; modifying it makes a deep
+   * copy. The same frame can be leased many times.
+   *
+   * Returns an empty matrix if the driver does not support leasing or
+   * [frameBuffer()] returns a null pointer.
+   *
+   * ! The driver must not be destroyed before all leased frames have
+   * been released.
+   */
+  template <class T> PiiMatrix<T> leaseFrame(uint frameIndex, int rows, int columns, std::size_t stride = 0)
+  {
+    void* pLease = 0;
+    const T* pBuffer = static_cast<const T*>(leaseFrameBuffer(frameIndex, &pLease));
+    if (pBuffer == 0)
+      return PiiMatrix<T>();
+    return PiiMatrix<T>(rows, columns, pBuffer, &PiiCameraDriver::releaseFrameBuffer, pLease, stride);
+  }
+
+  /**
+   * Returns `true` if *frameIndex* is currently leased.
+   */
+  bool isFrameLeased(uint frameIndex) const;
+
+  /**
+   * Returns the number of distinct frames currently leased.
+   */
+  int leasedFrameCount() const;
+
   /**
    * Sets the listener that handles received image frames.
    */
@@ -271,13 +326,28 @@ public:
   QVariant property(const char* name) const;
   bool setProperty(const char* name, const QVariant& value);
 
+protected:
+  /**
+   * Called when the last reference to a leased frame has been
+   * released. Drivers can now reuse the frame buffer. This function
+   * may be called from any thread. The default implementation does
+   * nothing.
+   */
+  virtual void frameReleased(uint frameIndex);
+
 private:
+  struct Lease;
+  void* leaseFrameBuffer(uint frameIndex, void** lease);
+  static void releaseFrameBuffer(void* lease);
+
   class Data
   {
   public:
     Data();
     Listener *pListener;
     QVariantMap mapProperties;
+    mutable QMutex leaseMutex;
+    QHash<uint,int> hashLeaseCounts;
   } *d;
 };
 
@@ -311,13 +381,27 @@ public:
    */
   virtual void frameCaptured(uint frameIndex, void *frameBuffer = 0, qint64 elapsedTime = 0);
 
+  /**
+   * Called whenever a frame has been captured by a driver that can
+   * provide per-frame information. Apart from *info*, this function
+   * works the same way as the one above. Drivers that read device
+   * timestamps or other per-frame data from the camera should call
+   * this function. The default implementation calls
+   * `frameCaptured(frameIndex, frameBuffer, info.elapsedTime)`.
+   *
+   * @param info information about the captured frame
+   */
+  virtual void frameCaptured(uint frameIndex, void *frameBuffer, const PiiCamera::FrameInfo& info);
+
   /**
    * Called when the driver notices that the receiver cannot process
    * all frames. Depending on the size of the frame buffer the driver
    * may allow the processing lag behind for a while. When it decides
    * the processing will never catch up capture, it'll inform the
    * listener. The next frame sent to [frameCaptured()] will be after
-   * `endIndex`.
+   * `endIndex`. Drivers that support frame leasing also call this
+   * function when a frame is dropped because the buffer it would
+   * have been written to is still leased.
    *
    * @param startIndex the first missed frame
    *
@@ -24,6 +24,7 @@
 
 #include <PiiLog.h>
 #include <QFile>
+#include <QThread>
 
 PiiCameraOperation::Data::Data() :
   pCameraDriver(0),
@@ -33,10 +34,18 @@ PiiCameraOperation::Data::Data() :
   iImageHeight(0),
   iBitsPerPixel(8),
   bCopyImage(false),
+  bConvertYuv(true),
   iFrameCount(-1),
   bWaitPause(false),
   bMissedFrames(false),
-  iMaxMissedIndex(0)
+  iMaxMissedIndex(0),
+  pPreviewOutput(0),
+  iPreviewScale(4),
+  pTimestampOutput(0),
+  pFrameCounterOutput(0),
+  pExposureTimeOutput(0),
+  pTriggerIdOutput(0),
+  placedThread(0)
 {
 }
 
@@ -52,6 +61,14 @@ PiiCameraOperation::PiiCameraOperation() : PiiImageReaderOperation(new Data)
 
 void PiiCameraOperation::init()
 {
+  PII_D;
+  d->pPreviewOutput = new PiiOutputSocket("preview");
+  addSocket(d->pPreviewOutput);
+  addSocket(d->pTimestampOutput = new PiiOutputSocket("timestamp"));
+  addSocket(d->pFrameCounterOutput = new PiiOutputSocket("frame counter"));
+  addSocket(d->pExposureTimeOutput = new PiiOutputSocket("exposure time"));
+  addSocket(d->pTriggerIdOutput = new PiiOutputSocket("trigger id"));
+
   setThreadingCapabilities(NonThreaded);
   startTimer(5000);
 }
@@ -108,6 +125,11 @@ void PiiCameraOperation::check(bool reset)
       d->frameTimer.restart();
       d->iMaxMissedIndex = 0;
       d->bMissedFrames = false;
+
+      if (d->pPreviewOutput->isConnected() &&
+          !(d->imageFormat member_of (PiiCamera::BayerRGGBFormat, PiiCamera::BayerBGGRFormat,
+                                      PiiCamera::BayerGBRGFormat, PiiCamera::BayerGRBGFormat)))
+        PII_THROW(PiiExecutionException, tr("The preview output can only be used with Bayer-encoded images."));
     }
 
   PiiImageReaderOperation::check(reset);
@@ -166,8 +188,24 @@ void PiiCameraOperation::stop()
 }
 
 void PiiCameraOperation::frameCaptured(uint frameIndex, void *frameBuffer, qint64 elapsedTime)
+{
+  PiiCamera::FrameInfo info;
+  info.elapsedTime = elapsedTime;
+  frameCaptured(frameIndex, frameBuffer, info);
+}
+
+void PiiCameraOperation::frameCaptured(uint frameIndex, void *frameBuffer, const PiiCamera::FrameInfo& info)
 {
   PII_D;
+  const qint64 elapsedTime = info.elapsedTime;
+
+  // Frames arrive in the driver's capture thread, which is where
+  // affinity and real-time priority matter.
+  if (d->placedThread != QThread::currentThreadId())
+    {
+      applyThreadPlacement();
+      d->placedThread = QThread::currentThreadId();
+    }
 
   QMutexLocker lock(&d->pauseMutex);
   if (d->bWaitPause)
@@ -186,6 +224,8 @@ void PiiCameraOperation::frameCaptured(uint frameIndex, void *frameBuffer, qint6
 
   if (frameIndex >= 0)
     {
+      // Only the capture thread calls this function.
+      d->frameInfo = info;
       Pii::PtrOwnership ownership = frameBuffer != 0 ? Pii::ReleaseOwnership : Pii::RetainOwnership;
       void *pFrameBuffer = ownership == Pii::ReleaseOwnership ?
         frameBuffer : d->pCameraDriver->frameBuffer(frameIndex);
@@ -204,8 +244,10 @@ void PiiCameraOperation::frameCaptured(uint frameIndex, void *frameBuffer, qint6
               convert<unsigned short>(pFrameBuffer, ownership, frameIndex, elapsedTime);
               break;
             case 24:
-              emitImage(PiiMatrix<PiiColor<unsigned char> >(d->iImageHeight, d->iImageWidth, pFrameBuffer, ownership),
-                        ownership, frameIndex, elapsedTime);
+              {
+                PiiMatrix<PiiColor<unsigned char> > image(frameMatrix<PiiColor<unsigned char> >(pFrameBuffer, ownership, frameIndex));
+                emitImage(image, ownership, frameIndex, elapsedTime);
+              }
               break;
               /*case 32:
                 convertColor<PiiColor4<unsigned char> >(pFrameBuffer,
@@ -232,9 +274,12 @@ template <class T> void PiiCameraOperation::convert(void *frameBuffer,
 
   if (d->imageType == Original && d->imageFormat member_of (PiiCamera::MonoFormat, PiiCamera::RgbFormat))
     {
-      PiiMatrix<T> image(d->iImageHeight, d->iImageWidth, frameBuffer, ownership);
+      PiiMatrix<T> image(frameMatrix<T>(frameBuffer, ownership, frameIndex));
       emitImage(image, ownership, frameIndex, elapsedTime);
     }
+  else if (d->imageFormat member_of (PiiCamera::Yuv422Format, PiiCamera::Nv12Format) &&
+           (d->imageType == GrayScale || !d->bConvertYuv))
+    emitYuvImage<T>(frameBuffer, ownership, frameIndex, elapsedTime);
   else
     {
       switch (d->imageFormat)
@@ -263,22 +308,121 @@ template <class T> void PiiCameraOperation::convert(void *frameBuffer,
 
             break;
           }
-        case PiiCamera::BayerBGGRFormat:
+        case PiiCamera::Nv12Format:
           {
-            PiiMatrix<T> image(d->iImageHeight, d->iImageWidth, frameBuffer, ownership);
-            emitImage(bayerToRgb(image, PiiCamera::BggrDecoder<T>(), PiiCamera::Rgb4Pixel<>()),
+            emitImage(PiiColors::nv12toRgb<PiiColor<T> >(reinterpret_cast<T*>(frameBuffer),
+                                                         d->iImageWidth, d->iImageHeight),
                       Pii::ReleaseOwnership, frameIndex, elapsedTime);
+
+            if (ownership == Pii::ReleaseOwnership)
+              free(frameBuffer);
+
             break;
           }
+        case PiiCamera::BayerRGGBFormat:
+          emitBayerImage<T, PiiCamera::RggbDecoder<T> >(frameBuffer, ownership, frameIndex, elapsedTime);
+          break;
+        case PiiCamera::BayerBGGRFormat:
+          emitBayerImage<T, PiiCamera::BggrDecoder<T> >(frameBuffer, ownership, frameIndex, elapsedTime);
+          break;
+        case PiiCamera::BayerGBRGFormat:
+          emitBayerImage<T, PiiCamera::GbrgDecoder<T> >(frameBuffer, ownership, frameIndex, elapsedTime);
+          break;
+        case PiiCamera::BayerGRBGFormat:
+          emitBayerImage<T, PiiCamera::GrbgDecoder<T> >(frameBuffer, ownership, frameIndex, elapsedTime);
+          break;
         default:
           {
-            PiiMatrix<T> image(d->iImageHeight, d->iImageWidth, frameBuffer, ownership);
+            PiiMatrix<T> image(frameMatrix<T>(frameBuffer, ownership, frameIndex));
             emitImage(image, ownership, frameIndex, elapsedTime);
           }
         }
     }
 }
 
+template <class T, class Decoder> void PiiCameraOperation::emitBayerImage(void *frameBuffer,
+                                                                        Pii::PtrOwnership ownership,
+                                                                        int frameIndex,
+                                                                        qint64 elapsedTime)
+{
+  PII_D;
+  PiiMatrix<T> image(d->iImageHeight, d->iImageWidth, frameBuffer, ownership);
+  // Decoding a large frame on one thread may take longer than the
+  // exposure.
+  emitImage(PiiCamera::bayerToRgb(Pii::ParallelExecution(), image, Decoder(), PiiCamera::Rgb4Pixel<>()),
+            Pii::ReleaseOwnership, frameIndex, elapsedTime);
+  if (d->pPreviewOutput->isConnected())
+    d->pPreviewOutput->emitObject(PiiCamera::bayerToRgbBinned(image, Decoder(), PiiCamera::Rgb4Pixel<>(),
+                                                              d->iPreviewScale));
+}
+
+template <class T> void PiiCameraOperation::emitYuvImage(void *frameBuffer,
+                                                         Pii::PtrOwnership ownership,
+                                                         int frameIndex,
+                                                         qint64 elapsedTime)
+{
+  PII_D;
+  const bool bNv12 = d->imageFormat == PiiCamera::Nv12Format;
+  if (d->imageType == GrayScale && !bNv12)
+    {
+      // Every other sample of a YUYV frame is luma.
+      PiiMatrix<T> image(PiiMatrix<T>::uninitialized(d->iImageHeight, d->iImageWidth));
+      const T* pSource = static_cast<const T*>(frameBuffer);
+      for (int r=0; r<d->iImageHeight; ++r)
+        {
+          T* pRow = image[r];
+          for (int c=0; c<d->iImageWidth; ++c, pSource += 2)
+            pRow[c] = *pSource;
+        }
+      if (ownership == Pii::ReleaseOwnership)
+        free(frameBuffer);
+      emitImage(image, Pii::ReleaseOwnership, frameIndex, elapsedTime);
+    }
+  else
+    {
+      // NV12 begins with the luma plane, gray-scale images thus need
+      // no conversion.
+      int iRows = d->iImageHeight, iColumns = d->iImageWidth;
+      if (d->imageType != GrayScale)
+        {
+          if (bNv12)
+            iRows += iRows / 2;
+          else
+            iColumns *= 2;
+        }
+      PiiMatrix<T> image(frameMatrix<T>(frameBuffer, ownership, frameIndex, iRows, iColumns));
+      emitImage(image, ownership, frameIndex, elapsedTime);
+    }
+}
+
+template <class T> PiiMatrix<T> PiiCameraOperation::frameMatrix(void *frameBuffer,
+                                                                Pii::PtrOwnership& ownership,
+                                                                int frameIndex)
+{
+  PII_D;
+  return frameMatrix<T>(frameBuffer, ownership, frameIndex, d->iImageHeight, d->iImageWidth);
+}
+
+template <class T> PiiMatrix<T> PiiCameraOperation::frameMatrix(void *frameBuffer,
+                                                                Pii::PtrOwnership& ownership,
+                                                                int frameIndex,
+                                                                int rows, int columns)
+{
+  PII_D;
+  // A leased frame is safe to pass on without copying. The lease
+  // ends when the last reference to the matrix is released.
+  if (ownership == Pii::RetainOwnership && !d->bCopyImage && d->pCameraDriver->supportsFrameLeasing())
+    {
+      PiiMatrix<T> image(d->pCameraDriver->leaseFrame<T>(frameIndex, rows, columns));
+      if (!image.isEmpty())
+        {
+          ownership = Pii::ReleaseOwnership;
+          return image;
+        }
+    }
+  return PiiMatrix<T>(rows, columns, frameBuffer, ownership);
+}
+
 template <class T> void PiiCameraOperation::emitImage(const PiiMatrix<T>& image, Pii::PtrOwnership ownership, int frameIndex, qint64 elapsedTime)
 {
   PII_D;
@@ -291,6 +435,20 @@ template <class T> void PiiCameraOperation::emitImage(const PiiMatrix<T>& image,
     }
   else
     d->pImageOutput->emitObject(processImage(PiiVariant(image), frameIndex, elapsedTime));
+  emitFrameInfo();
+}
+
+void PiiCameraOperation::emitFrameInfo()
+{
+  PII_D;
+  if (d->pTimestampOutput->isConnected())
+    d->pTimestampOutput->emitObject(d->frameInfo.timestamp);
+  if (d->pFrameCounterOutput->isConnected())
+    d->pFrameCounterOutput->emitObject(d->frameInfo.frameCounter);
+  if (d->pExposureTimeOutput->isConnected())
+    d->pExposureTimeOutput->emitObject(d->frameInfo.exposureTime);
+  if (d->pTriggerIdOutput->isConnected())
+    d->pTriggerIdOutput->emitObject(d->frameInfo.triggerId);
 }
 
 PiiVariant PiiCameraOperation::processImage(const PiiVariant& image, int /*frameIndex*/, qint64 /*elapsedTime*/)
@@ -459,3 +617,23 @@ bool PiiCameraOperation::copyImage() const
 {
   return _d()->bCopyImage;
 }
+
+void PiiCameraOperation::setConvertYuv(bool convertYuv)
+{
+  _d()->bConvertYuv = convertYuv;
+}
+
+bool PiiCameraOperation::convertYuv() const
+{
+  return _d()->bConvertYuv;
+}
+
+void PiiCameraOperation::setPreviewScale(int previewScale)
+{
+  _d()->iPreviewScale = qMax(2, previewScale & ~1);
+}
+
+int PiiCameraOperation::previewScale() const
+{
+  return _d()->iPreviewScale;
+}
@@ -24,6 +24,35 @@
 /**
  * PiiCameraOperation description
  *
+ * Outputs
+ * -------
+ *
+ * @out image - the captured image
+ *
+ * @out preview - a reduced-resolution color image, emitted
+ * together with each captured image if the output is connected. The
+ * preview is decoded directly from the Bayer-encoded frame without
+ * full-resolution interpolation (see [previewScale]). This output can
+ * only be used if the camera produces Bayer-encoded images.
+ *
+ * @out timestamp - the device timestamp of the image in microseconds
+ * (qint64). Use this to align images from many cameras. -1 if the
+ * driver cannot read timestamps from the camera.
+ *
+ * @out frame counter - the frame counter of the camera (qint64), or
+ * -1.
+ *
+ * @out exposure time - the exposure time of the image in
+ * microseconds (int), or -1.
+ *
+ * @out trigger id - the identifier of the trigger that started the
+ * exposure (int), or -1.
+ *
+ * The frame information outputs are emitted together with each
+ * image. The values are stored in the emitted objects as such;
+ * passing them requires no memory allocations. See
+ * [PiiCamera::FrameInfo].
+ *
  */
 class PII_CAMERA_EXPORT PiiCameraOperation : public PiiImageReaderOperation, public PiiCameraDriver::Listener
 {
@@ -56,11 +85,35 @@ class PII_CAMERA_EXPORT PiiCameraOperation : public PiiImageReaderOperation, pub
    * of each captured frame. Otherwise, it is up to the driver how the
    * memory is allocated. This mode is usually faster. However,
    * drivers that use a circular frame buffer, will silently overwrite
-   * image data if the frame buffer is not big enough. The default
-   * value is `false`.
+   * image data if the frame buffer is not big enough. If the driver
+   * supports frame leasing (see [PiiCameraDriver::leaseFrame()]),
+   * uncopied frames are leased from the driver. The driver will then
+   * not overwrite a frame until all processing on it has finished,
+   * but drops new frames instead. The default value is `false`.
    */
   Q_PROPERTY(bool copyImage READ copyImage WRITE setCopyImage);
 
+  /**
+   * If this property is `true` (the default), YUV frames are
+   * converted to RGB before emission. Setting it to `false` skips the
+   * conversion and emits the samples as they are, in unsigned char
+   * matrices: packed YUV 4:2:2 (YUYV) frames have twice as many
+   * columns as the image, and NV12 frames have 1.5 times as many rows
+   * with the luma plane first, followed by interleaved chroma. Such
+   * frames can be leased from the driver without copying. Regardless
+   * of this property, the luma plane is emitted as such if
+   * [imageType] is `GrayScale`.
+   */
+  Q_PROPERTY(bool convertYuv READ convertYuv WRITE setConvertYuv);
+
+  /**
+   * The ratio of the sizes of the captured image and the image
+   * emitted through the `preview` output. Each *previewScale* by
+   * *previewScale* block of the captured image becomes one pixel in
+   * the preview. Must be an even number. The default value is 4.
+   */
+  Q_PROPERTY(int previewScale READ previewScale WRITE setPreviewScale);
+
   friend struct PiiSerialization::Accessor;
   PII_DECLARE_VIRTUAL_METAOBJECT_FUNCTION;
   template <class Archive> void serialize(Archive& archive, const unsigned int)
@@ -90,6 +143,7 @@ public:
 
   // Listener functions
   void frameCaptured(uint frameIndex, void *frameBuffer, qint64 elapsedTime);
+  void frameCaptured(uint frameIndex, void *frameBuffer, const PiiCamera::FrameInfo& info);
   void framesMissed(uint startIndex, uint endIndex);
   void captureFinished(bool state);
   void captureError(const QString& message);
@@ -128,6 +182,12 @@ protected:
   void setCopyImage(bool copy);
   bool copyImage() const;
 
+  void setConvertYuv(bool convertYuv);
+  bool convertYuv() const;
+
+  void setPreviewScale(int previewScale);
+  int previewScale() const;
+
   /**
    * Processes an image before delivery. The default implementation
    * returns *image*. Subclasses may add custom functionality by
@@ -139,7 +199,13 @@ protected:
 
 private:
   template <class T> void convert(void *frameBuffer, Pii::PtrOwnership ownership, int frameIndex, qint64 elapsedTime);
+  template <class T> PiiMatrix<T> frameMatrix(void *frameBuffer, Pii::PtrOwnership& ownership, int frameIndex);
+  template <class T> PiiMatrix<T> frameMatrix(void *frameBuffer, Pii::PtrOwnership& ownership, int frameIndex,
+                                              int rows, int columns);
+  template <class T> void emitYuvImage(void *frameBuffer, Pii::PtrOwnership ownership, int frameIndex, qint64 elapsedTime);
+  void emitFrameInfo();
   template <class T> void emitImage(const PiiMatrix<T>& image, Pii::PtrOwnership ownership, int frameIndex, qint64 elapsedTime);
+  template <class T, class Decoder> void emitBayerImage(void *frameBuffer, Pii::PtrOwnership ownership, int frameIndex, qint64 elapsedTime);
 
   void init();
 protected:
@@ -157,13 +223,22 @@ protected:
     PiiCamera::ImageFormat imageFormat;
     int iBitsPerPixel;
     bool bCopyImage;
+    bool bConvertYuv;
     QAtomicInt iFrameCount;
     PiiTimer frameTimer;
     bool bWaitPause, bMissedFrames;
     PiiWaitCondition pauseWaitCondition;
     int iMaxMissedIndex;
     QMutex pauseMutex;
-
+    PiiOutputSocket* pPreviewOutput;
+    int iPreviewScale;
+    PiiOutputSocket* pTimestampOutput;
+    PiiOutputSocket* pFrameCounterOutput;
+    PiiOutputSocket* pExposureTimeOutput;
+    PiiOutputSocket* pTriggerIdOutput;
+    PiiCamera::FrameInfo frameInfo;
+    // The driver thread to which thread placement was last applied.
+    Qt::HANDLE placedThread;
   };
   PII_D_FUNC;
 
@@ -9,6 +9,11 @@
 #include <PiiPylonDriverGlobal.h>
 #include <PiiGenicamDriver.h>
 
+/**
+ * A camera driver for Basler GigE cameras. The driver uses the Pylon
+ * wrapper library, which grabs frames directly into the buffers of
+ * PiiGenicamDriver. Grabbed frames can be leased without copying.
+ */
 class PII_PYLONDRIVER_EXPORT PiiPylonDriver : public PiiGenicamDriver
 {
   Q_OBJECT
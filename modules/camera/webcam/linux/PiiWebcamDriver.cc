@@ -21,11 +21,27 @@
 #include <QDir>
 #include <sys/prctl.h>
 #include <poll.h>
-#include <PiiDelay.h>
 #include <PiiBits.h>
 
+#include <QImage>
+#include <QSet>
+
 #define CLEAR(x) memset (&(x), 0, sizeof (x))
 
+class PiiWebcamDriver::DecodeTask : public PiiThreadPool::Task
+{
+public:
+  DecodeTask(PiiWebcamDriver* driver) : pDriver(driver), uiFrameIndex(0), iSequence(0) {}
+
+  void run() { pDriver->decodeFrame(this); }
+
+  PiiWebcamDriver* pDriver;
+  QByteArray aData;
+  uint uiFrameIndex;
+  qint64 iSequence;
+  PiiCamera::FrameInfo info;
+};
+
 static bool xioctl(int fd, int request, void  *arg)
 {
   int r;
@@ -48,7 +64,14 @@ PiiWebcamDriver::PiiWebcamDriver() :
   _bCroppingSupported(false),
   _iPixelFormat(V4L2_PIX_FMT_YUYV),
   _resolution(0,0),
-  _iBitsPerPixel(8)
+  _iBitsPerPixel(8),
+  _bStreaming(false),
+  _iNextSequence(-1),
+  _iPreviousTimestamp(-1),
+  _iDecoderThreadCount(2),
+  _pDecoderPool(0),
+  _iNextSubmission(0),
+  _iNextDelivery(0)
 {
   _lstCriticalProperties << "frameBufferCount"
                          << "imageFormat"
@@ -66,6 +89,8 @@ PiiWebcamDriver::PiiWebcamDriver() :
 PiiWebcamDriver::~PiiWebcamDriver()
 {
   close();
+  delete _pDecoderPool;
+  qDeleteAll(_vecDecodeTasks);
 }
 
 
@@ -220,6 +245,10 @@ bool PiiWebcamDriver::startCapture(int frames)
 
   _uiFrameIndex = -1;
   _iMaxFrames = _triggerMode == PiiCameraDriver::SoftwareTrigger ? 0 : frames;
+  _iNextSequence = -1;
+  _iPreviousTimestamp = -1;
+  if (_iPixelFormat == V4L2_PIX_FMT_MJPEG)
+    prepareDecoder();
 
   if (!startVideoStream(_fileDevice.handle()))
     {
@@ -268,9 +297,6 @@ bool PiiWebcamDriver::stopCapture()
 
 void PiiWebcamDriver::capture()
 {
-  QVector<void*> lstBuffers;
-  lstBuffers.reserve(_iFrameBufferCount);
-
   bool bSoftwareTrigger = _triggerMode == PiiCameraDriver::SoftwareTrigger;
   bool bSuccess = true;
 
@@ -282,42 +308,25 @@ void PiiWebcamDriver::capture()
       if (!_pCaptureThread)
         break;
 
-      // Take all filled buffers from v4l
-      do
-        {
-          void* pBuffer = 0;
-
-          if (!grabFrame(_fileDevice.handle(), &pBuffer, 10))
-            bSuccess = false;
-
-          if (pBuffer == 0) break;
-          lstBuffers << pBuffer;
-        }
-      while (!bSoftwareTrigger && lstBuffers.size() < _iFrameBufferCount);
-
-      // Inform listener about each frame in turn.
-      if (lstBuffers.size() > 0)
-        {
-          for (int i=0; i<lstBuffers.size(); ++i)
-            {
-              ++_uiFrameIndex;
-              _vecBufferPointers[_uiFrameIndex % _iFrameBufferCount] = lstBuffers[i];
-              listener()->frameCaptured(_uiFrameIndex, 0,0);
-              if (_iMaxFrames > 0 && int(_uiFrameIndex) > _iMaxFrames)
-                break;
-            }
-          lstBuffers.clear();
-          lstBuffers.reserve(_iFrameBufferCount);
-        }
+      v4l2_buffer buf;
+      int iResult = grabFrame(_fileDevice.handle(), &buf, 10);
+      if (iResult < 0)
+        bSuccess = false;
+      if (iResult <= 0)
+        continue;
 
-      // Release buffers back to v4l
-      if (!requeueBuffers(_fileDevice.handle()))
+      if (!handleFrame(buf))
         {
           bSuccess = false;
           break;
         }
+      if (_iMaxFrames > 0 && int(_uiFrameIndex) + 1 >= _iMaxFrames)
+        break;
     }
 
+  // Frames still being decoded are delivered before finishing.
+  waitForDecoders();
+
   // Stop streaming
   if (!stopVideoStream(_fileDevice.handle()))
     piiWarning(tr("Failed to stop video stream."));
@@ -326,10 +335,154 @@ void PiiWebcamDriver::capture()
   listener()->captureFinished(bSuccess);
 }
 
-bool PiiWebcamDriver::grabFrame(int fd, void **buffer, int timeout)
+bool PiiWebcamDriver::handleFrame(v4l2_buffer& buf)
+{
+  PiiCamera::FrameInfo info;
+  info.timestamp = qint64(buf.timestamp.tv_sec) * 1000000 + buf.timestamp.tv_usec;
+  info.frameCounter = buf.sequence;
+  if (_iPreviousTimestamp >= 0)
+    info.elapsedTime = info.timestamp - _iPreviousTimestamp;
+  _iPreviousTimestamp = info.timestamp;
+
+  // The device drops frames if it runs out of queued buffers, for
+  // example if all of them are leased.
+  if (_iNextSequence >= 0 && qint64(buf.sequence) > _iNextSequence)
+    {
+      uint uiMissed = uint(qint64(buf.sequence) - _iNextSequence);
+      listener()->framesMissed(_uiFrameIndex + 1, _uiFrameIndex + uiMissed);
+      _uiFrameIndex += uiMissed;
+    }
+  _iNextSequence = qint64(buf.sequence) + 1;
+  ++_uiFrameIndex;
+
+  if (_iPixelFormat == V4L2_PIX_FMT_MJPEG)
+    {
+      // The compressed frame is small enough to be copied. This
+      // returns the buffer to the device immediately.
+      submitDecoding(buf, info);
+      return requeueBuffer(_fileDevice.handle(), buf);
+    }
+
+  _vecBufferPointers[_uiFrameIndex % _iFrameBufferCount] = _vecBuffers[buf.index]->frameStart;
+  listener()->frameCaptured(_uiFrameIndex, 0, info);
+
+  // A leased buffer will be requeued in frameReleased().
+  QMutexLocker lock(&_bufferMutex);
+  if (isFrameLeased(_uiFrameIndex))
+    {
+      _hashLeasedBuffers.insert(_uiFrameIndex, buf);
+      return true;
+    }
+  return requeueBuffer(_fileDevice.handle(), buf);
+}
+
+void PiiWebcamDriver::frameReleased(uint frameIndex)
+{
+  QMutexLocker lock(&_bufferMutex);
+  QHash<uint,v4l2_buffer>::iterator i = _hashLeasedBuffers.find(frameIndex);
+  if (i == _hashLeasedBuffers.end())
+    return;
+  v4l2_buffer buf = i.value();
+  _hashLeasedBuffers.erase(i);
+  // Buffers released while the stream is off are queued when it is
+  // started again.
+  if (_bStreaming)
+    requeueBuffer(_fileDevice.handle(), buf);
+}
+
+void PiiWebcamDriver::prepareDecoder()
+{
+  if (_pDecoderPool == 0)
+    _pDecoderPool = new PiiThreadPool(_iDecoderThreadCount);
+  else
+    _pDecoderPool->setThreadCount(_iDecoderThreadCount);
+
+  // Each pending frame needs a task. If all of them are busy, the
+  // decoders cannot keep up, and frames are dropped.
+  if (_vecDecodeTasks.size() != _iFrameBufferCount)
+    {
+      qDeleteAll(_vecDecodeTasks);
+      _vecDecodeTasks.clear();
+      for (int i=0; i<_iFrameBufferCount; ++i)
+        _vecDecodeTasks << new DecodeTask(this);
+    }
+  _lstFreeDecodeTasks = _vecDecodeTasks.toList();
+  _iNextSubmission = _iNextDelivery = 0;
+  _decodedSize = frameSize();
+}
+
+void PiiWebcamDriver::submitDecoding(const v4l2_buffer& buf, const PiiCamera::FrameInfo& info)
+{
+  DecodeTask* pTask = 0;
+  synchronized (_decodeMutex)
+    {
+      if (!_lstFreeDecodeTasks.isEmpty())
+        {
+          pTask = _lstFreeDecodeTasks.takeLast();
+          pTask->iSequence = _iNextSubmission++;
+        }
+    }
+  if (pTask == 0)
+    {
+      listener()->framesMissed(_uiFrameIndex, _uiFrameIndex);
+      return;
+    }
+
+  pTask->aData.resize(buf.bytesused);
+  memcpy(pTask->aData.data(), _vecBuffers[buf.index]->frameStart, buf.bytesused);
+  pTask->uiFrameIndex = _uiFrameIndex;
+  pTask->info = info;
+  _pDecoderPool->submit(pTask);
+}
+
+void PiiWebcamDriver::decodeFrame(DecodeTask* task)
+{
+  const int iWidth = _decodedSize.width(), iHeight = _decodedSize.height();
+  void* pFrameBuffer = 0;
+  QImage image;
+  if (image.loadFromData(reinterpret_cast<const uchar*>(task->aData.constData()), task->aData.size(), "JPEG") &&
+      image.width() == iWidth && image.height() == iHeight)
+    {
+      image = image.convertToFormat(QImage::Format_RGB888);
+      const int iRowLength = iWidth * 3;
+      uchar* pData = static_cast<uchar*>(malloc(iRowLength * iHeight));
+      for (int r=0; r<iHeight; ++r)
+        memcpy(pData + r * iRowLength, image.constScanLine(r), iRowLength);
+      pFrameBuffer = pData;
+    }
+  else
+    piiWarning(tr("Couldn't decode MJPEG frame %1.").arg(task->uiFrameIndex));
+
+  // Frames are decoded in parallel but delivered in order.
+  synchronized (_decodeMutex)
+    {
+      while (_iNextDelivery != task->iSequence)
+        _decodeCondition.wait(&_decodeMutex);
+    }
+
+  // The listener takes the ownership of the buffer.
+  if (pFrameBuffer != 0)
+    listener()->frameCaptured(task->uiFrameIndex, pFrameBuffer, task->info);
+  else
+    listener()->framesMissed(task->uiFrameIndex, task->uiFrameIndex);
+
+  synchronized (_decodeMutex)
+    {
+      ++_iNextDelivery;
+      _lstFreeDecodeTasks << task;
+      _decodeCondition.wakeAll();
+    }
+}
+
+void PiiWebcamDriver::waitForDecoders()
 {
-  *buffer = 0;
+  QMutexLocker lock(&_decodeMutex);
+  while (_lstFreeDecodeTasks.size() < _vecDecodeTasks.size())
+    _decodeCondition.wait(&_decodeMutex);
+}
 
+int PiiWebcamDriver::grabFrame(int fd, v4l2_buffer* buffer, int timeout)
+{
   pollfd pfd = { fd, POLLIN, 0 };
   int r = poll(&pfd, 1, timeout);
 
@@ -353,48 +506,50 @@ bool PiiWebcamDriver::grabFrame(int fd, void **buffer, int timeout)
         }
 
       piiWarning(tr("Couldn't grab frame: %1").arg(strReason));
-      return false;
+      return -1;
     }
 
   if (r == 0) // poll() timeout
-    return true;
+    return 0;
 
-  v4l2_buffer buf;
-  CLEAR (buf);
+  CLEAR (*buffer);
 
-  buf.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
-  buf.memory = V4L2_MEMORY_MMAP;
+  buffer->type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+  buffer->memory = V4L2_MEMORY_MMAP;
 
-  if (xioctl(fd, VIDIOC_DQBUF, &buf))
-    {
-      *buffer = _vecBuffers[buf.index]->frameStart;
-      _vecReservedBuffers << buf;
-      return true;
-    }
+  if (xioctl(fd, VIDIOC_DQBUF, buffer))
+    return 1;
   piiWarning("Failed to dequeue frame buffer.");
-  return false;
+  return -1;
 }
 
-bool PiiWebcamDriver::requeueBuffers(int fd)
+bool PiiWebcamDriver::requeueBuffer(int fd, const v4l2_buffer& buffer)
 {
-  for (int i=0; i<_vecReservedBuffers.size(); i++)
+  v4l2_buffer buf(buffer);
+  if (!xioctl(fd, VIDIOC_QBUF, &buf))
     {
-      if (!xioctl(fd, VIDIOC_QBUF, &_vecReservedBuffers[i]))
-        {
-          piiWarning(tr("Couldn't requeue buffer %1").arg(i));
-          return false;
-        }
+      piiWarning(tr("Couldn't requeue buffer %1").arg(buf.index));
+      return false;
     }
-  _vecReservedBuffers.clear();
-
   return true;
 }
 
 bool PiiWebcamDriver::startVideoStream(int fd)
 {
+  QMutexLocker lock(&_bufferMutex);
+  // Buffers of frames leased before the stream was stopped will be
+  // queued once released.
+  QSet<uint> setLeasedBuffers;
+  for (QHash<uint,v4l2_buffer>::const_iterator i = _hashLeasedBuffers.constBegin();
+       i != _hashLeasedBuffers.constEnd(); ++i)
+    setLeasedBuffers << i.value().index;
+
   v4l2_buf_type type;
   for (int i=0; i<_iFrameBufferCount; ++i)
     {
+      if (setLeasedBuffers.contains(i))
+        continue;
+
       v4l2_buffer buf;
 
       CLEAR (buf);
@@ -408,11 +563,14 @@ bool PiiWebcamDriver::startVideoStream(int fd)
     }
 
   type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
-  return xioctl(fd, VIDIOC_STREAMON, &type);
+  _bStreaming = xioctl(fd, VIDIOC_STREAMON, &type);
+  return _bStreaming;
 }
 
 bool PiiWebcamDriver::stopVideoStream(int fd)
 {
+  QMutexLocker lock(&_bufferMutex);
+  _bStreaming = false;
   v4l2_buf_type type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
   return xioctl(fd, VIDIOC_STREAMOFF, &type);
 }
@@ -478,16 +636,23 @@ bool PiiWebcamDriver::registerFrameBuffers(int fd)
 
 bool PiiWebcamDriver::deregisterFrameBuffers()
 {
+  // Unmapping leased buffers would pull the memory from under the
+  // frames that still refer to it.
+  bool bLeased = leasedFrameCount() > 0;
+  if (bLeased)
+    piiWarning(tr("Frame buffers are still leased and will not be unmapped."));
+
   // munmap buffers
   for (int i=0; i<_vecBuffers.size(); i++)
     {
-      if (munmap(_vecBuffers[i]->frameStart, _vecBuffers[i]->v4l2Buffer.length) == -1)
+      if (!bLeased && munmap(_vecBuffers[i]->frameStart, _vecBuffers[i]->v4l2Buffer.length) == -1)
         piiWarning(tr("Error in unmap buffers"));
       delete _vecBuffers[i];
     }
   _vecBuffers.clear();
-  _vecReservedBuffers.clear();
   _vecBufferPointers.clear();
+  synchronized (_bufferMutex)
+    _hashLeasedBuffers.clear();
 
   return true;
 }
@@ -497,6 +662,12 @@ void* PiiWebcamDriver::frameBuffer(uint index) const
   return _vecBufferPointers[index % _iFrameBufferCount];
 }
 
+bool PiiWebcamDriver::supportsFrameLeasing() const
+{
+  // Decoded MJPEG frames are passed to the listener.
+  return _iPixelFormat != V4L2_PIX_FMT_MJPEG;
+}
+
 bool PiiWebcamDriver::isOpen() const
 {
   return _bOpen;
@@ -565,6 +736,8 @@ int PiiWebcamDriver::imageFormat() const
         case V4L2_PIX_FMT_SBGGR8: return PiiCamera::BayerBGGRFormat;
         case V4L2_PIX_FMT_Y41P: return PiiCamera::Yuv411Format;
         case V4L2_PIX_FMT_YUYV: return PiiCamera::Yuv422Format;
+        case V4L2_PIX_FMT_NV12: return PiiCamera::Nv12Format;
+        case V4L2_PIX_FMT_MJPEG: return PiiCamera::MjpegFormat;
         case V4L2_PIX_FMT_RGB24: return PiiCamera::RgbFormat;
         case V4L2_PIX_FMT_BGR24: return PiiCamera::BgrFormat;
         default:
@@ -651,6 +824,19 @@ bool PiiWebcamDriver::setFrameBufferCount(int frameBufferCount)
   return true;
 }
 
+int PiiWebcamDriver::decoderThreadCount() const
+{
+  return _iDecoderThreadCount;
+}
+
+void PiiWebcamDriver::setDecoderThreadCount(int decoderThreadCount)
+{
+  QMutexLocker lock(&_captureMutex);
+  _iDecoderThreadCount = qMax(1, decoderThreadCount);
+  if (_pDecoderPool != 0 && _pCaptureThread == 0)
+    _pDecoderPool->setThreadCount(_iDecoderThreadCount);
+}
+
 bool PiiWebcamDriver::setFrameSize(const QSize& frameSize)
 {
   struct v4l2_format fmt;
@@ -718,6 +904,15 @@ bool PiiWebcamDriver::setImageFormat(int value)
       _iPixelFormat = V4L2_PIX_FMT_YUYV;
       _iBitsPerPixel = 8;
       break;
+    case PiiCamera::Nv12Format:
+      _iPixelFormat = V4L2_PIX_FMT_NV12;
+      _iBitsPerPixel = 8;
+      break;
+    case PiiCamera::MjpegFormat:
+      // Frames are decoded to RGB
+      _iPixelFormat = V4L2_PIX_FMT_MJPEG;
+      _iBitsPerPixel = 24;
+      break;
     case PiiCamera::RgbFormat:
       _iPixelFormat = V4L2_PIX_FMT_RGB24;
       _iBitsPerPixel = 24;
@@ -20,10 +20,13 @@
 #include <PiiWaitCondition.h>
 #include <PiiWebcamDriverGlobal.h>
 #include <PiiTimer.h>
+#include <PiiThreadPool.h>
 
 #include <QThread>
 #include <QMutex>
+#include <QWaitCondition>
 #include <QFile>
+#include <QHash>
 
 #include <unistd.h>
 #include <errno.h>
@@ -35,6 +38,23 @@
 #include <unistd.h>
 #include <linux/videodev2.h>
 
+/**
+ * A driver for V4L2 video devices on Linux.
+ *
+ * Frames are captured into memory-mapped kernel buffers. Unless the
+ * receiver copies the frames, they are leased (see
+ * PiiCameraDriver::leaseFrame()) and their buffers are returned to
+ * the device once the last reference to the frame has been released.
+ * If all buffers are leased, the device drops frames. Dropped frames
+ * are detected from the sequence numbers of the buffers and reported
+ * to the listener as missed.
+ *
+ * Besides the uncompressed formats, the driver supports NV12
+ * (PiiCamera::Nv12Format) and MJPEG (PiiCamera::MjpegFormat). MJPEG
+ * frames are copied out of the kernel buffers and decoded to RGB in a
+ * thread pool of their own (see [decoderThreadCount]). Decoded frames
+ * are delivered in capture order.
+ */
 class PII_WEBCAMDRIVER_EXPORT PiiWebcamDriver : public PiiCameraDriver
 {
   Q_OBJECT
@@ -54,6 +74,13 @@ class PII_WEBCAMDRIVER_EXPORT PiiWebcamDriver : public PiiCameraDriver
    */
   Q_PROPERTY(QVariantList frameSizes READ frameSizes);
 
+  /**
+   * The number of threads that decode MJPEG frames. One thread
+   * usually cannot decode 4K frames at the full frame rate. The
+   * default is 2.
+   */
+  Q_PROPERTY(int decoderThreadCount READ decoderThreadCount WRITE setDecoderThreadCount);
+
 public:
   /**
    * Construct a new PiiWebcamDriver.
@@ -71,6 +98,7 @@ public:
   bool startCapture(int frames);
   bool stopCapture();
   void* frameBuffer(uint frameIndex) const;
+  bool supportsFrameLeasing() const;
   bool isOpen() const;
   bool isCapturing() const;
   bool triggerImage();
@@ -90,10 +118,23 @@ public:
   bool setFrameRect(const QRect& frameRect);
   QVariantList frameSizes() const;
 
+  int decoderThreadCount() const;
+  void setDecoderThreadCount(int decoderThreadCount);
+
+protected:
+  void frameReleased(uint frameIndex);
+
 private slots:
   void deleteCaptureThread();
 private:
+  class DecodeTask;
+
   void capture();
+  bool handleFrame(v4l2_buffer& buffer);
+  void prepareDecoder();
+  void submitDecoding(const v4l2_buffer& buffer, const PiiCamera::FrameInfo& info);
+  void decodeFrame(DecodeTask* task);
+  void waitForDecoders();
 
   bool requiresInitialization(const char* name) const;
 
@@ -102,8 +143,8 @@ private:
   int readIntValue(const char* name, int defaultValue = 0, bool *ok = 0) const;
 
   // v4l-functions
-  bool grabFrame(int fd, void **buffer, int timeout);
-  bool requeueBuffers(int fd);
+  int grabFrame(int fd, v4l2_buffer* buffer, int timeout);
+  bool requeueBuffer(int fd, const v4l2_buffer& buffer);
   bool startVideoStream(int fd);
   bool stopVideoStream(int fd);
   bool registerFrameBuffers(int fd);
@@ -122,8 +163,23 @@ private:
 
   int _iFrameBufferCount;
   QVector<WebcamBuffer*> _vecBuffers;
-  QVector<v4l2_buffer> _vecReservedBuffers;
   QVector<void*> _vecBufferPointers;
+  // Buffers held by leased frames, keyed by frame index. Guarded by
+  // _bufferMutex, as is _bStreaming.
+  QHash<uint,v4l2_buffer> _hashLeasedBuffers;
+  QMutex _bufferMutex;
+  bool _bStreaming;
+  qint64 _iNextSequence, _iPreviousTimestamp;
+
+  int _iDecoderThreadCount;
+  PiiThreadPool* _pDecoderPool;
+  QVector<DecodeTask*> _vecDecodeTasks;
+  // Guards the following members.
+  QMutex _decodeMutex;
+  QWaitCondition _decodeCondition;
+  QList<DecodeTask*> _lstFreeDecodeTasks;
+  qint64 _iNextSubmission, _iNextDelivery;
+  QSize _decodedSize;
 
   QThread *_pCaptureThread;
   QMutex _captureMutex;
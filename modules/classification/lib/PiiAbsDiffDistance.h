@@ -17,6 +17,7 @@
 #define _PIIABSDIFFDISTANCE_H
 
 #include "PiiDistanceMeasure.h"
+#include "PiiDistanceKernels.h"
 
 /**
  * Calculates the sum of absolute differences between corresponding
@@ -33,4 +34,6 @@ PII_DEFAULT_DISTANCE_MEASURE_DEF(PiiAbsDiffDistance)
   return distance;
 }
 
+PII_VECTORIZED_BOUNDED_DISTANCE_MEASURES(PiiAbsDiffDistance, absDiffDistance)
+
 #endif //_PIIABSDIFFDISTANCE_H
@@ -129,6 +129,20 @@ void PiiBoostClassifier<SampleSet>::learn(const SampleSet& samples,
         vecWeights.fill(1.0 / iSamples, iSamples);
     }
 
+  // Lets the factory release shared data on all exit paths.
+  struct LearningScope
+  {
+    LearningScope(Factory* factory, PiiBoostClassifier* classifier, const SampleSet& samples) :
+      pFactory(factory), pClassifier(classifier)
+    {
+      pFactory->startLearning(pClassifier, samples);
+    }
+    ~LearningScope() { pFactory->endLearning(pClassifier); }
+
+    Factory* pFactory;
+    PiiBoostClassifier* pClassifier;
+  } scope(d->pFactory, this, samples);
+
   QVector<double> vecHypotheses(iSamples);
   double dMinError = 1;
   while (d->lstClassifiers.size() < d->iMaxClassifiers)
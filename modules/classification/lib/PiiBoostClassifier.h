@@ -88,6 +88,28 @@ public:
                                              const SampleSet& samples,
                                              const QVector<double>& labels,
                                              const QVector<double>& weights) = 0;
+
+    /**
+     * Called by [PiiBoostClassifier::learn()] before the first weak
+     * classifier is created. The factory may use this function to
+     * prepare data that is shared by all weak classifiers. The
+     * default implementation does nothing.
+     */
+    virtual void startLearning(PiiBoostClassifier<SampleSet>* classifier,
+                               const SampleSet& samples)
+    {
+      Q_UNUSED(classifier);
+      Q_UNUSED(samples);
+    }
+
+    /**
+     * Called by [PiiBoostClassifier::learn()] when learning ends,
+     * even if it fails. The default implementation does nothing.
+     */
+    virtual void endLearning(PiiBoostClassifier<SampleSet>* classifier)
+    {
+      Q_UNUSED(classifier);
+    }
   };
 
   /**
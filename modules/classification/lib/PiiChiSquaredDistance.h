@@ -17,6 +17,7 @@
 #define _PIICHISQUAREDDISTANCE_H
 
 #include "PiiDistanceMeasure.h"
+#include "PiiDistanceKernels.h"
 
 /**
  * Chi squared distance. The chi squared distance between two vectors
@@ -36,4 +37,6 @@ PII_DEFAULT_DISTANCE_MEASURE_DEF(PiiChiSquaredDistance)
   return sum;
 }
 
+PII_VECTORIZED_BOUNDED_DISTANCE_MEASURES(PiiChiSquaredDistance, chiSquaredDistance)
+
 #endif //_PIICHISQUAREDDISTANCE_H
@@ -0,0 +1,380 @@
+/* This file is part of Into.
+ * Copyright (C) Intopii 2013.
+ * All rights reserved.
+ *
+ * Licensees holding a commercial Into license may use this file in
+ * accordance with the commercial license agreement. Please see
+ * LICENSE.commercial for commercial licensing terms.
+ *
+ * Alternatively, this file may be used under the terms of the GNU
+ * Affero General Public License version 3 as published by the Free
+ * Software Foundation. In addition, Intopii gives you special rights
+ * to use Into as a part of open source software projects. Please
+ * refer to LICENSE.AGPL3 for details.
+ */
+
+#ifndef _PIICHUNKEDSAMPLESET_H
+#define _PIICHUNKEDSAMPLESET_H
+
+#include "PiiSampleSet.h"
+
+#include <QList>
+#include <QVector>
+#include <algorithm>
+#include <iterator>
+
+/**
+ * A sample set that stores feature vectors in fixed-size chunks. When
+ * a PiiMatrix is used as a sample set, it must be reallocated and
+ * copied as it grows. At the moment of reallocation both the old and
+ * the new buffer are in memory. PiiChunkedSampleSet allocates new
+ * chunks as needed and never moves stored samples. Pointers returned
+ * by [sampleAt()] remain valid until the sample set is modified
+ * through another copy, cleared or resized.
+ *
+ * The feature type *T* need not be the type of the original
+ * features. For example, storing `double` features as `float` or
+ * `unsigned char` halves or eighths the memory needed. Features are
+ * converted when appended, and all distance measures work with any
+ * feature iterator type.
+ *
+ * Chunks are implicitly shared. Copying a sample set is cheap, and
+ * modifying a copy only detaches the chunk that is modified.
+ *
+ * ~~~(c++)
+ * PiiChunkedSampleSet<float> samples(128);
+ * for (int i=0; i<iSamples; ++i)
+ *   samples.append(matFeatures.constRowBegin(i)); // converts double to float
+ * PiiSquaredGeometricDistance<const float*> measure;
+ * double dLabel = PiiClassification::knnClassify(pSample, samples, vecLabels, measure, 5);
+ * ~~~
+ */
+template <class T> class PiiChunkedSampleSet
+{
+public:
+  /**
+   * A read-only iterator over the values of one feature in all
+   * samples. See [columnBegin()].
+   */
+  class ConstColumnIterator
+  {
+  public:
+    typedef std::forward_iterator_tag iterator_category;
+    typedef T value_type;
+    typedef int difference_type;
+    typedef const T* pointer;
+    typedef const T& reference;
+
+    ConstColumnIterator() :
+      _pChunks(0), _iChunkSize(1), _iFeatures(0), _iFeature(0), _iSample(0), _pValue(0)
+    {}
+
+    const T& operator* () const { return *_pValue; }
+    const T* operator-> () const { return _pValue; }
+
+    ConstColumnIterator& operator++ ()
+    {
+      if (++_iSample % _iChunkSize == 0)
+        _pValue = chunkStart();
+      else
+        _pValue += _iFeatures;
+      return *this;
+    }
+    ConstColumnIterator operator++ (int)
+    {
+      ConstColumnIterator tmp(*this);
+      operator++ ();
+      return tmp;
+    }
+
+    bool operator== (const ConstColumnIterator& other) const { return _iSample == other._iSample; }
+    bool operator!= (const ConstColumnIterator& other) const { return _iSample != other._iSample; }
+    int operator- (const ConstColumnIterator& other) const { return _iSample - other._iSample; }
+
+  private:
+    friend class PiiChunkedSampleSet;
+    ConstColumnIterator(const QList<QVector<T> >* chunks, int chunkSize, int features,
+                        int feature, int sample) :
+      _pChunks(chunks), _iChunkSize(chunkSize), _iFeatures(features), _iFeature(feature),
+      _iSample(sample), _pValue(0)
+    {
+      if (_iSample < _pChunks->size() * _iChunkSize)
+        _pValue = _pChunks->at(_iSample / _iChunkSize).constData() +
+          (_iSample % _iChunkSize) * _iFeatures + _iFeature;
+    }
+
+    const T* chunkStart() const
+    {
+      const int iChunk = _iSample / _iChunkSize;
+      return iChunk < _pChunks->size() ? _pChunks->at(iChunk).constData() + _iFeature : 0;
+    }
+
+    const QList<QVector<T> >* _pChunks;
+    int _iChunkSize, _iFeatures, _iFeature, _iSample;
+    const T* _pValue;
+  };
+
+  /**
+   * Creates an empty sample set.
+   *
+   * @param featureCount the number of features in each sample
+   *
+   * @param chunkSize the number of samples in each chunk. If zero, a
+   * chunk size that makes each chunk about 1 MB will be used.
+   */
+  PiiChunkedSampleSet(int featureCount = 0, int chunkSize = 0);
+
+  /**
+   * Returns the number of samples.
+   */
+  int sampleCount() const { return _iSamples; }
+  /**
+   * Returns the number of features in each sample.
+   */
+  int featureCount() const { return _iFeatures; }
+  /**
+   * Returns the number of samples in each chunk.
+   */
+  int chunkSize() const { return _iChunkSize; }
+  /**
+   * Returns the number of samples that fit into the allocated chunks.
+   */
+  int capacity() const { return _lstChunks.size() * _iChunkSize; }
+
+  /**
+   * Returns a pointer to the beginning of the sample at *index*.
+   */
+  const T* operator[] (int index) const
+  {
+    return _lstChunks[index / _iChunkSize].constData() + (index % _iChunkSize) * _iFeatures;
+  }
+  /**
+   * Returns a pointer to the beginning of the sample at *index*. If
+   * the chunk that contains the sample is shared, it will be
+   * detached.
+   */
+  T* operator[] (int index)
+  {
+    return _lstChunks[index / _iChunkSize].data() + (index % _iChunkSize) * _iFeatures;
+  }
+
+  /**
+   * Appends a sample to the end of the sample set. *features* must
+   * point to [featureCount()] values that are convertible to *T*.
+   * Stored samples will not be moved.
+   */
+  template <class InputIterator> void append(InputIterator features);
+
+  /**
+   * Removes the sample at *index*. The following samples will be
+   * moved one step backwards.
+   */
+  void remove(int index);
+
+  /**
+   * Resizes the sample set to *sampleCount* samples. If
+   * *featureCount* is different from the current feature count, all
+   * samples will be removed first. New samples will be initialized to
+   * zeros. Chunks that are no longer needed will be released.
+   */
+  void resize(int sampleCount, int featureCount = -1);
+
+  /**
+   * Allocates chunks for at least *sampleCount* samples.
+   */
+  void reserve(int sampleCount);
+
+  /**
+   * Removes all samples and releases the memory.
+   */
+  void clear();
+
+  /**
+   * Returns an iterator to the value of *feature* in the first
+   * sample. The iterator reads the feature from each sample in turn
+   * without copying the column.
+   *
+   * ~~~(c++)
+   * // Find the range of feature 3
+   * std::pair<PiiChunkedSampleSet<float>::ConstColumnIterator,
+   *           PiiChunkedSampleSet<float>::ConstColumnIterator> range =
+   *   std::minmax_element(samples.columnBegin(3), samples.columnEnd(3));
+   * ~~~
+   */
+  ConstColumnIterator columnBegin(int feature) const
+  {
+    return ConstColumnIterator(&_lstChunks, _iChunkSize, _iFeatures, feature, 0);
+  }
+  /**
+   * Returns an iterator past the last value of *feature*.
+   */
+  ConstColumnIterator columnEnd(int feature) const
+  {
+    return ConstColumnIterator(&_lstChunks, _iChunkSize, _iFeatures, feature, _iSamples);
+  }
+
+  /**
+   * Copies all samples to a matrix, one sample per row.
+   */
+  PiiMatrix<T> toMatrix() const;
+
+  /**
+   * Returns `true` if the sample sets have the same number of samples
+   * and features and all features are equal.
+   */
+  bool operator== (const PiiChunkedSampleSet& other) const;
+
+private:
+  void setFeatureCount(int featureCount);
+
+  QList<QVector<T> > _lstChunks;
+  int _iFeatures, _iSamples, _iChunkSize, _iRequestedChunkSize;
+};
+
+template <class T> PiiChunkedSampleSet<T>::PiiChunkedSampleSet(int featureCount, int chunkSize) :
+  _iFeatures(0), _iSamples(0), _iChunkSize(1), _iRequestedChunkSize(chunkSize)
+{
+  setFeatureCount(featureCount);
+}
+
+template <class T> void PiiChunkedSampleSet<T>::setFeatureCount(int featureCount)
+{
+  _iFeatures = qMax(featureCount, 0);
+  _iChunkSize = _iRequestedChunkSize > 0 ?
+    _iRequestedChunkSize :
+    qMax(1, int((1 << 20) / (qMax(_iFeatures, 1) * sizeof(T))));
+}
+
+template <class T> template <class InputIterator> void PiiChunkedSampleSet<T>::append(InputIterator features)
+{
+  if (_iSamples == capacity())
+    _lstChunks.append(QVector<T>(_iChunkSize * _iFeatures));
+  T* pSample = operator[] (_iSamples);
+  for (int i=0; i<_iFeatures; ++i, ++features)
+    pSample[i] = T(*features);
+  ++_iSamples;
+}
+
+template <class T> void PiiChunkedSampleSet<T>::remove(int index)
+{
+  for (int i=index+1; i<_iSamples; ++i)
+    std::copy((*this)[i], (*this)[i] + _iFeatures, (*this)[i-1]);
+  resize(_iSamples - 1);
+}
+
+template <class T> void PiiChunkedSampleSet<T>::resize(int sampleCount, int featureCount)
+{
+  if (featureCount != -1 && featureCount != _iFeatures)
+    {
+      clear();
+      setFeatureCount(featureCount);
+    }
+  const int iOldSamples = _iSamples;
+  reserve(sampleCount);
+  _iSamples = sampleCount;
+  // Release unused chunks and zero the tail of the last one.
+  const int iChunks = (_iSamples + _iChunkSize - 1) / _iChunkSize;
+  while (_lstChunks.size() > iChunks)
+    _lstChunks.removeLast();
+  if (iOldSamples > _iSamples && _iSamples % _iChunkSize != 0)
+    {
+      T* pTail = (*this)[_iSamples];
+      std::fill(pTail, pTail + (_iChunkSize - _iSamples % _iChunkSize) * _iFeatures, T(0));
+    }
+}
+
+template <class T> void PiiChunkedSampleSet<T>::reserve(int sampleCount)
+{
+  while (capacity() < sampleCount)
+    _lstChunks.append(QVector<T>(_iChunkSize * _iFeatures));
+}
+
+template <class T> void PiiChunkedSampleSet<T>::clear()
+{
+  _lstChunks.clear();
+  _iSamples = 0;
+}
+
+template <class T> PiiMatrix<T> PiiChunkedSampleSet<T>::toMatrix() const
+{
+  PiiMatrix<T> matResult(PiiMatrix<T>::uninitialized(_iSamples, _iFeatures));
+  for (int i=0; i<_iSamples; ++i)
+    std::copy((*this)[i], (*this)[i] + _iFeatures, matResult.rowBegin(i));
+  return matResult;
+}
+
+template <class T> bool PiiChunkedSampleSet<T>::operator== (const PiiChunkedSampleSet& other) const
+{
+  if (_iSamples != other._iSamples || _iFeatures != other._iFeatures)
+    return false;
+  for (int i=0; i<_iSamples; ++i)
+    if (!std::equal((*this)[i], (*this)[i] + _iFeatures, other[i]))
+      return false;
+  return true;
+}
+
+namespace PiiSampleSet
+{
+  /**
+   * Defines the traits of PiiChunkedSampleSet when used as a sample
+   * set.
+   */
+  template <class T> struct Traits<PiiChunkedSampleSet<T> >
+  {
+    typedef PiiChunkedSampleSet<T> Type;
+    typedef T FeatureType;
+    typedef T* FeatureIterator;
+    typedef const T* ConstFeatureIterator;
+    typedef typename PiiChunkedSampleSet<T>::ConstColumnIterator ConstColumnIterator;
+
+    static PiiChunkedSampleSet<T> create(int sampleCount, int featureCount)
+    {
+      PiiChunkedSampleSet<T> result(featureCount);
+      result.resize(sampleCount);
+      return result;
+    }
+  };
+
+  /// @hide
+  template <class T> inline int sampleCount(const PiiChunkedSampleSet<T>& samples) { return samples.sampleCount(); }
+  template <class T> inline int featureCount(const PiiChunkedSampleSet<T>& samples) { return samples.featureCount(); }
+  template <class T> inline void resize(PiiChunkedSampleSet<T>& samples, int sampleCount, int featureCount = -1)
+  {
+    samples.resize(sampleCount, featureCount);
+  }
+  template <class T> inline void reserve(PiiChunkedSampleSet<T>& samples, int sampleCount, int featureCount = -1)
+  {
+    if (featureCount != -1 && samples.featureCount() != featureCount)
+      samples.resize(0, featureCount);
+    samples.reserve(sampleCount);
+  }
+  template <class T> inline void clear(PiiChunkedSampleSet<T>& samples) { samples.clear(); }
+  template <class T> inline int capacity(const PiiChunkedSampleSet<T>& samples) { return samples.capacity(); }
+  template <class T> inline const T* sampleAt(const PiiChunkedSampleSet<T>& samples, int index) { return samples[index]; }
+  template <class T> inline T* sampleAt(PiiChunkedSampleSet<T>& samples, int index) { return samples[index]; }
+  template <class T> inline void setSampleAt(PiiChunkedSampleSet<T>& samples, int index, const T* features)
+  {
+    std::memcpy(samples[index], features, sizeof(T) * samples.featureCount());
+  }
+  template <class T> inline void append(PiiChunkedSampleSet<T>& samples, const T* sample) { samples.append(sample); }
+  template <class T> inline void remove(PiiChunkedSampleSet<T>& samples, int index) { samples.remove(index); }
+  template <class T> inline bool equals(PiiChunkedSampleSet<T>& set1, PiiChunkedSampleSet<T>& set2)
+  {
+    return set1 == set2;
+  }
+  template <class T>
+  inline typename PiiChunkedSampleSet<T>::ConstColumnIterator columnBegin(const PiiChunkedSampleSet<T>& samples,
+                                                                         int feature)
+  {
+    return samples.columnBegin(feature);
+  }
+  template <class T>
+  inline typename PiiChunkedSampleSet<T>::ConstColumnIterator columnEnd(const PiiChunkedSampleSet<T>& samples,
+                                                                       int feature)
+  {
+    return samples.columnEnd(feature);
+  }
+  /// @endhide
+}
+
+#endif //_PIICHUNKEDSAMPLESET_H
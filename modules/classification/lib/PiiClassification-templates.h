@@ -18,6 +18,9 @@
 #endif
 
 #include <PiiMathDefs.h>
+#include <PiiSort.h>
+#include <PiiRandom.h>
+#include <algorithm>
 
 namespace PiiClassification
 {
@@ -60,52 +63,6 @@ namespace PiiClassification
     return newLabels;
   }
 
-  template <class SampleSet, class DistanceMeasure>
-  PiiMatrix<double> calculateDistanceMatrix(const SampleSet& samples,
-                                            const DistanceMeasure& measure,
-                                            bool symmetric,
-                                            bool calculateDiagonal)
-  {
-    const int iSamples = PiiSampleSet::sampleCount(samples),
-      iFeatures = PiiSampleSet::featureCount(samples);
-
-    PiiMatrix<double> result(iSamples, iSamples);
-
-    // Upper triangle is a reflection of the lower triangle
-    if (symmetric)
-      {
-        for (int r=0; r<iSamples; ++r)
-          for (int c=0; c<r; ++c)
-            result(r,c) = result(c,r) = measure(PiiSampleSet::sampleAt(samples,r),
-                                                PiiSampleSet::sampleAt(samples,c),
-                                                iFeatures);
-      }
-    // Must calculate both triangles separately
-    else
-      {
-        for (int r=0; r<iSamples; ++r)
-          for (int c=0; c<r; ++c)
-            {
-              result(r,c) = measure(PiiSampleSet::sampleAt(samples,r),
-                                    PiiSampleSet::sampleAt(samples,c),
-                                    iFeatures);
-              result(c,r) = measure(PiiSampleSet::sampleAt(samples,c),
-                                    PiiSampleSet::sampleAt(samples,r),
-                                    iFeatures);
-            }
-      }
-
-    // Fill the diagonal only on request
-    if (calculateDiagonal)
-      for (int i=0; i<iSamples; ++i)
-        result(i,i) = measure(PiiSampleSet::sampleAt(samples,i),
-                              PiiSampleSet::sampleAt(samples,i),
-                              iFeatures);
-
-    return result;
-  }
-
-
   template <class SampleSet, class DistanceMeasure>
   int findClosestMatch(typename PiiSampleSet::Traits<SampleSet>::ConstFeatureIterator sample,
                        const SampleSet& modelSet,
@@ -119,7 +76,9 @@ namespace PiiClassification
     int minIndex = -1;
     for (int modelIndex = 0; modelIndex < iModels; ++modelIndex)
       {
-        double d = measure(sample, modelSet[modelIndex], iFeatures);
+        // Models farther than the best match so far can be rejected
+        // early.
+        double d = boundedDistance(measure, sample, modelSet[modelIndex], iFeatures, dMinDistance);
         if (d < dMinDistance)
           {
             minIndex = modelIndex;
@@ -139,31 +98,43 @@ namespace PiiClassification
   {
     const int iModels = PiiSampleSet::sampleCount(modelSet),
       iFeatures = PiiSampleSet::featureCount(modelSet);
+    // If a large fraction of the models is retained, a heap rejects
+    // few models early. Selecting from all distances is faster.
+    if (n > 0 && 4 * n >= iModels)
+      {
+        QVector<QPair<double,int> > vecDistances(iModels);
+        for (int modelIndex = 0; modelIndex < iModels; ++modelIndex)
+          vecDistances[modelIndex] = qMakePair(measure(sample, PiiSampleSet::sampleAt(modelSet, modelIndex), iFeatures),
+                                               modelIndex);
+        Pii::selectSmallest(vecDistances.begin(), vecDistances.end(), n);
+        MatchList lstMatches(qMin(iModels, n));
+        std::copy(vecDistances.begin(), vecDistances.begin() + lstMatches.size(), lstMatches.data());
+        return lstMatches;
+      }
+
     MatchList heap;
     heap.fill(qMin(iModels, n), qMakePair(double(INFINITY), -1));
-    // Heap ensures that only shortest distances will be preserved
+    if (heap.size() == 0)
+      return heap;
+    // Heap ensures that only shortest distances will be preserved.
+    // The top of the heap is the largest distance retained so far.
     for (int modelIndex = 0; modelIndex < iModels; ++modelIndex)
-      heap.put(qMakePair(measure(sample, PiiSampleSet::sampleAt(modelSet, modelIndex), iFeatures),
+      heap.put(qMakePair(boundedDistance(measure, sample, PiiSampleSet::sampleAt(modelSet, modelIndex),
+                                         iFeatures, heap[0].first),
                          modelIndex));
     // Ascending order -> first is the best match
     heap.sort();
     return heap;
   }
 
-  template <class SampleSet, class DistanceMeasure>
-  double knnClassify(typename PiiSampleSet::Traits<SampleSet>::ConstFeatureIterator sample,
-                     const SampleSet& modelSet,
-                     const QVector<double>& labels,
-                     const DistanceMeasure& measure,
-                     int k,
-                     double* distance,
-                     int* closestIndex)
+  /// @hide
+  // Selects the winning label among sorted closest matches.
+  inline double knnVote(const MatchList& closest,
+                        const QVector<double>& labels,
+                        double* distance,
+                        int* closestIndex)
   {
-    MatchList lstClosest = findClosestMatches(sample, modelSet, measure, k);
-    // May be smaller than original if we have less samples in the
-    // model set.
-    k = lstClosest.size();
-
+    const int k = closest.size();
     if (k == 0) // empty set
       return NAN;
     PiiSmartPtr<double[]> pClosestLabels = new double[k];
@@ -172,7 +143,7 @@ namespace PiiClassification
 
     // Store class labels corresponding to the closest samples.
     for (int i=0; i<k; ++i)
-      pClosestLabels[i] = labels[lstClosest[i].second];
+      pClosestLabels[i] = labels[closest[i].second];
     // Find the class label with the most occurrences.
     for (int i=0; i<k; ++i)
       {
@@ -189,11 +160,454 @@ namespace PiiClassification
           }
       }
     if (distance != 0)
-      *distance = lstClosest[iBestLabel].first;
+      *distance = closest[iBestLabel].first;
     if (closestIndex != 0)
-      *closestIndex = lstClosest[iBestLabel].second;
+      *closestIndex = closest[iBestLabel].second;
     return pClosestLabels[iBestLabel];
   }
+  /// @endhide
+
+  template <class SampleSet, class DistanceMeasure>
+  double knnClassify(typename PiiSampleSet::Traits<SampleSet>::ConstFeatureIterator sample,
+                     const SampleSet& modelSet,
+                     const QVector<double>& labels,
+                     const DistanceMeasure& measure,
+                     int k,
+                     double* distance,
+                     int* closestIndex)
+  {
+    // May be smaller than k if we have less samples in the model set.
+    return knnVote(findClosestMatches(sample, modelSet, measure, k),
+                   labels, distance, closestIndex);
+  }
+
+  /// @hide
+  template <class Measure> inline bool isSquaredGeometricDistance(const Measure&) { return false; }
+  template <class FeatureIterator>
+  inline bool isSquaredGeometricDistance(const PiiSquaredGeometricDistance<FeatureIterator>&) { return true; }
+  template <class FeatureIterator>
+  inline bool isSquaredGeometricDistance(const PiiDistanceMeasure<FeatureIterator>& measure)
+  {
+    typedef typename PiiDistanceMeasure<FeatureIterator>::template Impl<PiiSquaredGeometricDistance<FeatureIterator> > Impl;
+    return dynamic_cast<const Impl*>(&measure) != 0;
+  }
+
+  // Calculates the squared geometric distance from sample to
+  // modelCount models stored feature by feature. The distance to
+  // each model is accumulated in feature order. The vectorized
+  // PiiSquaredGeometricDistance may differ in the last bits.
+  template <class T>
+  void squaredGeometricDistances(const T* sample, const T* models, int modelCount, int featureCount,
+                                 double* distances)
+  {
+    enum { BlockSize = 8 };
+    int m = 0;
+    // A block of independent sums is kept in registers over all
+    // features. This lets the compiler vectorize the block.
+    for (; m <= modelCount - BlockSize; m += BlockSize)
+      {
+        double aSums[BlockSize] = { 0 };
+        const T* pModels = models + m;
+        for (int f=0; f<featureCount; ++f, pModels += modelCount)
+          {
+            const T value = sample[f];
+            for (int j=0; j<BlockSize; ++j)
+              {
+                const double dDiff = double(value - pModels[j]);
+                aSums[j] += dDiff * dDiff;
+              }
+          }
+        std::copy(aSums, aSums + BlockSize, distances + m);
+      }
+    for (; m<modelCount; ++m)
+      {
+        double dSum = 0;
+        for (int f=0; f<featureCount; ++f)
+          {
+            const double dDiff = double(sample[f] - models[f*modelCount + m]);
+            dSum += dDiff * dDiff;
+          }
+        distances[m] = dSum;
+      }
+  }
+
+  // Finds the closest matches for sampleCount samples starting at
+  // firstSample.
+  template <class SampleSet, class DistanceMeasure>
+  void findClosestMatchesInRange(const SampleSet& samples,
+                                 const SampleSet& modelSet,
+                                 const DistanceMeasure& measure,
+                                 int n,
+                                 int firstSample,
+                                 int sampleCount,
+                                 MatchList* matches)
+  {
+    for (int i=0; i<sampleCount; ++i)
+      matches[i] = findClosestMatches(PiiSampleSet::sampleAt(samples, firstSample + i), modelSet, measure, n);
+  }
+
+  template <class T, class DistanceMeasure>
+  void findClosestMatchesInRange(const PiiMatrix<T>& samples,
+                                 const PiiMatrix<T>& modelSet,
+                                 const DistanceMeasure& measure,
+                                 int n,
+                                 int firstSample,
+                                 int sampleCount,
+                                 MatchList* matches)
+  {
+    if (!isSquaredGeometricDistance(measure))
+      {
+        for (int i=0; i<sampleCount; ++i)
+          matches[i] = findClosestMatches(samples[firstSample + i], modelSet, measure, n);
+        return;
+      }
+
+    const int iModels = modelSet.rows(), iFeatures = modelSet.columns();
+    // About 16 kB of models at a time stays in L1 while all samples
+    // are compared to them.
+    const int iTileSize = qBound(8, int(16384 / qMax(1, iFeatures * int(sizeof(T)))), 256);
+    QVector<T> vecTile(iTileSize * iFeatures);
+    QVector<double> vecDistances(iTileSize);
+
+    for (int i=0; i<sampleCount; ++i)
+      matches[i].fill(qMin(iModels, n), qMakePair(double(INFINITY), -1));
+
+    for (int iFirstModel=0; iFirstModel<iModels; iFirstModel += iTileSize)
+      {
+        const int iTileModels = qMin(iTileSize, iModels - iFirstModel);
+        T* pTile = vecTile.data();
+        for (int m=0; m<iTileModels; ++m)
+          {
+            const T* pModel = modelSet[iFirstModel + m];
+            for (int f=0; f<iFeatures; ++f)
+              pTile[f*iTileModels + m] = pModel[f];
+          }
+        for (int i=0; i<sampleCount; ++i)
+          {
+            squaredGeometricDistances(samples[firstSample + i], pTile, iTileModels, iFeatures,
+                                      vecDistances.data());
+            for (int m=0; m<iTileModels; ++m)
+              matches[i].put(qMakePair(vecDistances[m], iFirstModel + m));
+          }
+      }
+
+    for (int i=0; i<sampleCount; ++i)
+      matches[i].sort();
+  }
+
+  template <class SampleSet, class DistanceMeasure> struct ClosestMatchBand
+  {
+    ClosestMatchBand(const SampleSet& samples, const SampleSet& modelSet,
+                     const DistanceMeasure& measure, int n, MatchList* matches) :
+      samples(samples), modelSet(modelSet), measure(measure), n(n), matches(matches)
+    {}
+
+    void operator() (int firstSample, int sampleCount)
+    {
+      findClosestMatchesInRange(samples, modelSet, measure, n, firstSample, sampleCount, matches + firstSample);
+    }
+
+    const SampleSet& samples;
+    const SampleSet& modelSet;
+    const DistanceMeasure& measure;
+    int n;
+    MatchList* matches;
+  };
+
+  inline double* distanceRow(double* data, std::size_t stride, int row)
+  {
+    return reinterpret_cast<double*>(reinterpret_cast<char*>(data) + row * stride);
+  }
+
+  // Calculates the distances from samples [firstRow, firstRow +
+  // rowCount) to samples [firstColumn, firstColumn + columnCount).
+  // If lowerOnly is true, only columns less than the row index are
+  // calculated. The first row of the result is stored at output.
+  template <class SampleSet, class DistanceMeasure>
+  void calculateDistancesDirectly(const SampleSet& samples,
+                                  const DistanceMeasure& measure,
+                                  int firstRow, int rowCount,
+                                  int firstColumn, int columnCount,
+                                  bool lowerOnly,
+                                  double* output, std::size_t stride)
+  {
+    const int iFeatures = PiiSampleSet::featureCount(samples);
+    for (int r=firstRow; r<firstRow+rowCount; ++r)
+      {
+        double* pRow = distanceRow(output, stride, r - firstRow);
+        const int iEnd = lowerOnly ? qMin(r, firstColumn + columnCount) : firstColumn + columnCount;
+        for (int c=firstColumn; c<iEnd; ++c)
+          pRow[c] = measure(PiiSampleSet::sampleAt(samples, r),
+                            PiiSampleSet::sampleAt(samples, c),
+                            iFeatures);
+      }
+  }
+
+  template <class SampleSet, class DistanceMeasure>
+  void calculateDistanceBlock(const SampleSet& samples,
+                              const DistanceMeasure& measure,
+                              int firstRow, int rowCount,
+                              int firstColumn, int columnCount,
+                              bool lowerOnly,
+                              double* output, std::size_t stride)
+  {
+    calculateDistancesDirectly(samples, measure, firstRow, rowCount, firstColumn, columnCount,
+                               lowerOnly, output, stride);
+  }
+
+  template <class T, class DistanceMeasure>
+  void calculateDistanceBlock(const PiiMatrix<T>& samples,
+                              const DistanceMeasure& measure,
+                              int firstRow, int rowCount,
+                              int firstColumn, int columnCount,
+                              bool lowerOnly,
+                              double* output, std::size_t stride)
+  {
+    if (!isSquaredGeometricDistance(measure))
+      {
+        calculateDistancesDirectly(samples, measure, firstRow, rowCount, firstColumn, columnCount,
+                                   lowerOnly, output, stride);
+        return;
+      }
+
+    const int iFeatures = samples.columns();
+    // The same tile size as in findClosestMatchesInRange().
+    const int iTileSize = qBound(8, int(16384 / qMax(1, iFeatures * int(sizeof(T)))), 256);
+    QVector<T> vecTile(iTileSize * iFeatures);
+    QVector<double> vecDistances(iTileSize);
+
+    const int iColumnEnd = lowerOnly ?
+      qMin(firstColumn + columnCount, firstRow + rowCount - 1) :
+      firstColumn + columnCount;
+    for (int iFirstColumn=firstColumn; iFirstColumn<iColumnEnd; iFirstColumn += iTileSize)
+      {
+        const int iTileColumns = qMin(iTileSize, iColumnEnd - iFirstColumn);
+        T* pTile = vecTile.data();
+        for (int c=0; c<iTileColumns; ++c)
+          {
+            const T* pSample = samples[iFirstColumn + c];
+            for (int f=0; f<iFeatures; ++f)
+              pTile[f*iTileColumns + c] = pSample[f];
+          }
+        for (int r=firstRow; r<firstRow+rowCount; ++r)
+          {
+            const int iColumns = lowerOnly ? qMin(iTileColumns, r - iFirstColumn) : iTileColumns;
+            if (iColumns <= 0)
+              continue;
+            squaredGeometricDistances(samples[r], pTile, iTileColumns, iFeatures, vecDistances.data());
+            std::copy(vecDistances.constData(), vecDistances.constData() + iColumns,
+                      distanceRow(output, stride, r - firstRow) + iFirstColumn);
+          }
+      }
+  }
+
+  template <class SampleSet, class DistanceMeasure> struct DistanceMatrixBand
+  {
+    enum { BlockRows = 32 };
+
+    DistanceMatrixBand(const SampleSet& samples, const DistanceMeasure& measure,
+                       bool symmetric, PiiMatrix<double>& result) :
+      samples(samples), measure(measure), symmetric(symmetric), outputRows(result)
+    {}
+
+    static int blockCount(int samples) { return (samples + BlockRows - 1) / BlockRows; }
+
+    void operator() (int firstBlock, int blockCount)
+    {
+      const int iSamples = PiiSampleSet::sampleCount(samples),
+        iBlocks = DistanceMatrixBand::blockCount(iSamples);
+      for (int i=firstBlock; i<firstBlock+blockCount; ++i)
+        {
+          // The blocks of a lower triangle get longer towards the
+          // end. Taking them alternately from both ends gives each
+          // band about the same amount of work.
+          const int iBlock = symmetric && i % 2 ? iBlocks - 1 - i/2 : symmetric ? i/2 : i;
+          const int iFirstRow = iBlock * BlockRows,
+            iRows = qMin(int(BlockRows), iSamples - iFirstRow),
+            iEndRow = iFirstRow + iRows;
+          calculateDistanceBlock(samples, measure, iFirstRow, iRows, 0, iSamples, symmetric,
+                                 outputRows.row(iFirstRow), outputRows.stride());
+          if (symmetric)
+            {
+              // Copy the block to the upper triangle. No other block
+              // writes to these columns.
+              for (int c=0; c<iEndRow-1; ++c)
+                {
+                  double* pTarget = outputRows.row(c);
+                  for (int r=qMax(iFirstRow, c+1); r<iEndRow; ++r)
+                    pTarget[r] = outputRows.row(r)[c];
+                }
+            }
+        }
+    }
+
+    const SampleSet& samples;
+    const DistanceMeasure& measure;
+    bool symmetric;
+    const Pii::BandRows<double> outputRows;
+  };
+
+  template <class SampleSet, class DistanceMeasure> struct DistanceRowBand
+  {
+    DistanceRowBand(const SampleSet& samples, const DistanceMeasure& measure,
+                    int firstRow, PiiMatrix<double>& rows) :
+      samples(samples), measure(measure), iFirstRow(firstRow),
+      outputRows(rows)
+    {}
+
+    void operator() (int firstRow, int rowCount)
+    {
+      calculateDistanceBlock(samples, measure, iFirstRow + firstRow, rowCount,
+                             0, PiiSampleSet::sampleCount(samples), false,
+                             outputRows.row(firstRow), outputRows.stride());
+    }
+
+    const SampleSet& samples;
+    const DistanceMeasure& measure;
+    int iFirstRow;
+    const Pii::BandRows<double> outputRows;
+  };
+  /// @endhide
+
+  template <class SampleSet, class DistanceMeasure>
+  PiiMatrix<double> calculateDistanceMatrix(const SampleSet& samples,
+                                            const DistanceMeasure& measure,
+                                            bool symmetric,
+                                            bool calculateDiagonal)
+  {
+    return calculateDistanceMatrix(Pii::ParallelExecution(1), samples, measure, symmetric, calculateDiagonal);
+  }
+
+  template <class SampleSet, class DistanceMeasure>
+  PiiMatrix<double> calculateDistanceMatrix(const Pii::ParallelExecution& policy,
+                                            const SampleSet& samples,
+                                            const DistanceMeasure& measure,
+                                            bool symmetric,
+                                            bool calculateDiagonal)
+  {
+    typedef DistanceMatrixBand<SampleSet,DistanceMeasure> Band;
+    const int iSamples = PiiSampleSet::sampleCount(samples),
+      iFeatures = PiiSampleSet::featureCount(samples);
+
+    PiiMatrix<double> result(iSamples, iSamples);
+    if (iSamples == 0)
+      return result;
+
+    // Bands are counted in blocks of rows.
+    Pii::ParallelExecution blockPolicy(policy);
+    blockPolicy.minBandRows = qMax(1, policy.minBandRows / int(Band::BlockRows));
+    Pii::forEachBand(blockPolicy, Band::blockCount(iSamples), 0,
+                     Band(samples, measure, symmetric, result));
+
+    // Fill the diagonal only on request
+    for (int i=0; i<iSamples; ++i)
+      result(i,i) = calculateDiagonal ?
+        measure(PiiSampleSet::sampleAt(samples,i),
+                PiiSampleSet::sampleAt(samples,i),
+                iFeatures) :
+        0.0;
+
+    return result;
+  }
+
+  template <class SampleSet, class DistanceMeasure, class Function>
+  void calculateDistanceRows(const Pii::ParallelExecution& policy,
+                             const SampleSet& samples,
+                             const DistanceMeasure& measure,
+                             int blockRows,
+                             Function function)
+  {
+    const int iSamples = PiiSampleSet::sampleCount(samples);
+    if (iSamples == 0)
+      return;
+    blockRows = qBound(1, blockRows, iSamples);
+
+    PiiMatrix<double> matBlock(blockRows, iSamples);
+    for (int iFirstRow=0; iFirstRow<iSamples; iFirstRow += blockRows)
+      {
+        const int iRows = qMin(blockRows, iSamples - iFirstRow);
+        if (iRows != matBlock.rows())
+          matBlock.resize(iRows, iSamples);
+        // If function retained the previous block, this detaches.
+        Pii::forEachBand(policy, iRows, 0,
+                         DistanceRowBand<SampleSet,DistanceMeasure>(samples, measure, iFirstRow, matBlock));
+        function(iFirstRow, const_cast<const PiiMatrix<double>&>(matBlock));
+      }
+  }
+
+  template <class SampleSet, class DistanceMeasure>
+  QVector<MatchList> findClosestMatches(const SampleSet& samples,
+                                        const SampleSet& modelSet,
+                                        const DistanceMeasure& measure,
+                                        int n)
+  {
+    QVector<MatchList> vecMatches(PiiSampleSet::sampleCount(samples));
+    if (!vecMatches.isEmpty())
+      findClosestMatchesInRange(samples, modelSet, measure, n, 0, vecMatches.size(), vecMatches.data());
+    return vecMatches;
+  }
+
+  template <class SampleSet, class DistanceMeasure>
+  QVector<MatchList> findClosestMatches(const Pii::ParallelExecution& policy,
+                                        const SampleSet& samples,
+                                        const SampleSet& modelSet,
+                                        const DistanceMeasure& measure,
+                                        int n)
+  {
+    QVector<MatchList> vecMatches(PiiSampleSet::sampleCount(samples));
+    if (!vecMatches.isEmpty())
+      Pii::forEachBand(policy, vecMatches.size(), 0,
+                       ClosestMatchBand<SampleSet,DistanceMeasure>(samples, modelSet, measure, n,
+                                                                   vecMatches.data()));
+    return vecMatches;
+  }
+
+  /// @hide
+  inline QVector<double> knnVote(const QVector<MatchList>& matches,
+                                 const QVector<double>& labels,
+                                 QVector<double>* distances,
+                                 QVector<int>* closestIndices)
+  {
+    const int iSamples = matches.size();
+    QVector<double> vecLabels(iSamples);
+    if (distances != 0)
+      distances->resize(iSamples);
+    if (closestIndices != 0)
+      closestIndices->resize(iSamples);
+    for (int i=0; i<iSamples; ++i)
+      vecLabels[i] = knnVote(matches[i], labels,
+                             distances != 0 ? distances->data() + i : 0,
+                             closestIndices != 0 ? closestIndices->data() + i : 0);
+    return vecLabels;
+  }
+  /// @endhide
+
+  template <class SampleSet, class DistanceMeasure>
+  QVector<double> knnClassify(const SampleSet& samples,
+                              const SampleSet& modelSet,
+                              const QVector<double>& labels,
+                              const DistanceMeasure& measure,
+                              int k,
+                              QVector<double>* distances,
+                              QVector<int>* closestIndices)
+  {
+    return knnVote(findClosestMatches(samples, modelSet, measure, k),
+                   labels, distances, closestIndices);
+  }
+
+  template <class SampleSet, class DistanceMeasure>
+  QVector<double> knnClassify(const Pii::ParallelExecution& policy,
+                              const SampleSet& samples,
+                              const SampleSet& modelSet,
+                              const QVector<double>& labels,
+                              const DistanceMeasure& measure,
+                              int k,
+                              QVector<double>* distances,
+                              QVector<int>* closestIndices)
+  {
+    return knnVote(findClosestMatches(policy, samples, modelSet, measure, k),
+                   labels, distances, closestIndices);
+  }
 
   template <class FeatureIterator, class ConstFeatureIterator>
   void adaptVector(FeatureIterator code,
@@ -206,57 +620,386 @@ namespace PiiClassification
       code[i] = alpha * sample[i] + tmp * code[i];
   }
 
+  /// @hide
+  // Updates the distance from each sample to the closest selected
+  // k-means++ center.
+  template <class SampleSet, class DistanceMeasure> struct KMeansPlusPlusBand
+  {
+    typedef typename PiiSampleSet::Traits<SampleSet>::ConstFeatureIterator ConstFeatureIterator;
+
+    KMeansPlusPlusBand(const SampleSet& samples, ConstFeatureIterator center,
+                       const DistanceMeasure& measure, double* distances) :
+      samples(samples), center(center), measure(measure),
+      iFeatures(PiiSampleSet::featureCount(samples)), distances(distances)
+    {}
+
+    void operator() (int firstSample, int sampleCount)
+    {
+      for (int i=firstSample; i<firstSample+sampleCount; ++i)
+        {
+          // Only a distance below the current minimum matters.
+          double d = boundedDistance(measure, PiiSampleSet::sampleAt(samples, i), center,
+                                     iFeatures, distances[i]);
+          if (d < distances[i])
+            distances[i] = d;
+        }
+    }
+
+    const SampleSet& samples;
+    ConstFeatureIterator center;
+    const DistanceMeasure& measure;
+    int iFeatures;
+    double* distances;
+  };
+
+  // Calculates half of the distance from each centroid to the
+  // closest other one.
+  template <class SampleSet, class DistanceMeasure> struct KMeansCentroidDistances
+  {
+    KMeansCentroidDistances(const SampleSet& centroids, const DistanceMeasure& measure,
+                            double* halfDistances) :
+      centroids(centroids), measure(measure), halfDistances(halfDistances)
+    {}
+
+    void operator() (int firstCentroid, int centroidCount)
+    {
+      const int iCentroids = PiiSampleSet::sampleCount(centroids),
+        iFeatures = PiiSampleSet::featureCount(centroids);
+      for (int c=firstCentroid; c<firstCentroid+centroidCount; ++c)
+        {
+          double dMin = INFINITY;
+          for (int j=0; j<iCentroids; ++j)
+            if (j != c)
+              dMin = qMin(dMin, boundedDistance(measure,
+                                                PiiSampleSet::sampleAt(centroids, c),
+                                                PiiSampleSet::sampleAt(centroids, j),
+                                                iFeatures, dMin));
+          halfDistances[c] = 0.5 * std::sqrt(dMin);
+        }
+    }
+
+    const SampleSet& centroids;
+    const DistanceMeasure& measure;
+    double* halfDistances;
+  };
+
+  // Assigns samples to the closest centroid. If upper is non-zero,
+  // Hamerly's bounds are used to skip distance calculations. The
+  // bounds are Euclidean distances, which requires a squared
+  // geometric distance measure.
+  template <class SampleSet, class DistanceMeasure> struct KMeansAssignment
+  {
+    KMeansAssignment(const SampleSet& samples, const SampleSet& centroids,
+                     const DistanceMeasure& measure, const double* halfDistances,
+                     int* assignments, double* upper, double* lower) :
+      samples(samples), centroids(centroids), measure(measure), halfDistances(halfDistances),
+      assignments(assignments), upper(upper), lower(lower)
+    {}
+
+    void operator() (int firstSample, int sampleCount)
+    {
+      const int iCentroids = PiiSampleSet::sampleCount(centroids),
+        iFeatures = PiiSampleSet::featureCount(centroids);
+      for (int i=firstSample; i<firstSample+sampleCount; ++i)
+        {
+          if (upper == 0)
+            {
+              assignments[i] = findClosestMatch(PiiSampleSet::sampleAt(samples, i), centroids, measure);
+              continue;
+            }
+          int a = assignments[i];
+          if (a >= 0)
+            {
+              // The closest centroid cannot change if it is closer
+              // than half way to any other centroid or closer than
+              // any other centroid can be.
+              double dBound = qMax(halfDistances[a], lower[i]);
+              if (upper[i] <= dBound)
+                continue;
+              upper[i] = std::sqrt(measure(PiiSampleSet::sampleAt(samples, i),
+                                           PiiSampleSet::sampleAt(centroids, a),
+                                           iFeatures));
+              if (upper[i] <= dBound)
+                continue;
+            }
+          double dBest = INFINITY, dSecond = INFINITY;
+          for (int c=0; c<iCentroids; ++c)
+            {
+              double d = boundedDistance(measure,
+                                         PiiSampleSet::sampleAt(samples, i),
+                                         PiiSampleSet::sampleAt(centroids, c),
+                                         iFeatures, dSecond);
+              if (d < dBest)
+                {
+                  dSecond = dBest;
+                  dBest = d;
+                  a = c;
+                }
+              else if (d < dSecond)
+                dSecond = d;
+            }
+          assignments[i] = a;
+          upper[i] = std::sqrt(dBest);
+          lower[i] = std::sqrt(dSecond);
+        }
+    }
+
+    const SampleSet& samples;
+    const SampleSet& centroids;
+    const DistanceMeasure& measure;
+    const double* halfDistances;
+    int* assignments;
+    double* upper;
+    double* lower;
+  };
+
+  // Calculates the mean of the samples in each cluster. Samples are
+  // summed in their original order.
+  template <class SampleSet> struct KMeansUpdate
+  {
+    KMeansUpdate(const SampleSet& samples, const int* order, const int* starts, double* means) :
+      samples(samples), order(order), starts(starts), means(means)
+    {}
+
+    void operator() (int firstCentroid, int centroidCount)
+    {
+      const int iFeatures = PiiSampleSet::featureCount(samples);
+      for (int c=firstCentroid; c<firstCentroid+centroidCount; ++c)
+        {
+          double* pMean = means + c * iFeatures;
+          std::fill(pMean, pMean + iFeatures, 0.0);
+          if (starts[c+1] == starts[c])
+            continue;
+          for (int j=starts[c]; j<starts[c+1]; ++j)
+            {
+              typename PiiSampleSet::Traits<SampleSet>::ConstFeatureIterator pSample =
+                PiiSampleSet::sampleAt(samples, order[j]);
+              for (int f=0; f<iFeatures; ++f, ++pSample)
+                pMean[f] += double(*pSample);
+            }
+          const double dScale = 1.0 / (starts[c+1] - starts[c]);
+          for (int f=0; f<iFeatures; ++f)
+            pMean[f] *= dScale;
+        }
+    }
+
+    const SampleSet& samples;
+    const int* order;
+    const int* starts;
+    double* means;
+  };
+  /// @endhide
+
+  template <class SampleSet, class DistanceMeasure>
+  SampleSet kMeansPlusPlus(const Pii::ParallelExecution& policy,
+                           const SampleSet& samples,
+                           int k,
+                           const DistanceMeasure& measure)
+  {
+    const int iSamples = PiiSampleSet::sampleCount(samples),
+      iFeatures = PiiSampleSet::featureCount(samples);
+    if (k >= iSamples)
+      return samples;
+
+    SampleSet resultSet(PiiSampleSet::create<SampleSet>(0, iFeatures));
+    if (k <= 0)
+      return resultSet;
+    PiiSampleSet::reserve(resultSet, k);
+
+    QVector<double> vecDistances(iSamples, INFINITY);
+    int iCenter = qMin(int(Pii::uniformRandom() * iSamples), iSamples-1);
+    for (;;)
+      {
+        PiiSampleSet::append(resultSet, PiiSampleSet::sampleAt(samples, iCenter));
+        if (PiiSampleSet::sampleCount(resultSet) == k)
+          break;
+
+        Pii::forEachBand(policy, iSamples, 0,
+                         KMeansPlusPlusBand<SampleSet,DistanceMeasure>(samples,
+                                                                       PiiSampleSet::sampleAt(samples, iCenter),
+                                                                       measure,
+                                                                       vecDistances.data()));
+        double dSum = 0;
+        for (int i=0; i<iSamples; ++i)
+          dSum += vecDistances[i];
+
+        // All remaining samples duplicate a selected center.
+        if (!(dSum > 0))
+          {
+            iCenter = qMin(int(Pii::uniformRandom() * iSamples), iSamples-1);
+            continue;
+          }
+
+        // Select the next center with a probability proportional to
+        // its distance. Samples already selected have a zero
+        // distance and are never selected again.
+        double dTarget = Pii::uniformRandom() * dSum, dCumulative = 0;
+        for (int i=0; i<iSamples; ++i)
+          {
+            if (vecDistances[i] > 0)
+              {
+                iCenter = i;
+                dCumulative += vecDistances[i];
+                if (dCumulative > dTarget)
+                  break;
+              }
+          }
+      }
+    return resultSet;
+  }
+
   template <class SampleSet, class DistanceMeasure>
   SampleSet kMeans(const SampleSet& samples,
                    unsigned int k,
                    const DistanceMeasure& measure,
                    unsigned int maxIterations)
+  {
+    return kMeans(Pii::ParallelExecution(1), samples, k, measure, maxIterations);
+  }
+
+  template <class SampleSet, class DistanceMeasure>
+  SampleSet kMeans(const Pii::ParallelExecution& policy,
+                   const SampleSet& samples,
+                   unsigned int k,
+                   const DistanceMeasure& measure,
+                   unsigned int maxIterations)
   {
     const int iSamples = PiiSampleSet::sampleCount(samples),
       iFeatures = PiiSampleSet::featureCount(samples);
 
-    SampleSet resultSet(PiiSampleSet::create<SampleSet>(0, iFeatures));
-    if (int(k) >= iSamples)
-      return resultSet;
+    if (k == 0 || int(k) >= iSamples)
+      return PiiSampleSet::create<SampleSet>(0, iFeatures);
 
-    // First initialize the centroids by random selection
-    for (int i=k; i--; )
-      // OK, this is a bad thing, but we don't need a really good random
-      // number here.
-      PiiSampleSet::append(resultSet, PiiSampleSet::sampleAt(samples,rand() % iSamples));
+    const int iCentroids = int(k);
+    SampleSet centroidSet(kMeansPlusPlus(policy, samples, iCentroids, measure));
+    const SampleSet& constCentroids = centroidSet;
 
-    // Allocate storage for temporary mean vectors
-    SampleSet centroidSet(resultSet);
+    // Hamerly's bounds are valid for Euclidean distance only.
+    const bool bUseBounds = isSquaredGeometricDistance(measure);
+    QVector<double> vecUpper, vecLower, vecHalfDistances, vecMovements;
+    if (bUseBounds)
+      {
+        vecUpper.fill(INFINITY, iSamples);
+        vecLower.fill(0, iSamples);
+        vecHalfDistances.resize(iCentroids);
+        vecMovements.resize(iCentroids);
+      }
 
-    // Stores the number of samples per centroid.
-    QVector<int> hitCounts(k, 0);
+    QVector<int> vecAssignments(iSamples, -1), vecPreviousAssignments;
+    QVector<int> vecOrder(iSamples), vecStarts(iCentroids + 1), vecPositions;
+    QVector<double> vecMeans(iCentroids * iFeatures);
+    SampleSet previousCentroids;
 
     unsigned int iterationCount = 0;
-    while (maxIterations == 0 ||
-           iterationCount < maxIterations)
+    for (;;)
       {
-        hitCounts.fill(0);
-        // Classify all samples to the closest centroid
+        vecPreviousAssignments = vecAssignments;
+        if (bUseBounds)
+          Pii::forEachBand(policy, iCentroids, 0,
+                           KMeansCentroidDistances<SampleSet,DistanceMeasure>(constCentroids, measure,
+                                                                              vecHalfDistances.data()));
+        Pii::forEachBand(policy, iSamples, 0,
+                         KMeansAssignment<SampleSet,DistanceMeasure>(samples, constCentroids, measure,
+                                                                     bUseBounds ? vecHalfDistances.constData() : 0,
+                                                                     vecAssignments.data(),
+                                                                     bUseBounds ? vecUpper.data() : 0,
+                                                                     bUseBounds ? vecLower.data() : 0));
+        // Converged
+        if (vecAssignments == vecPreviousAssignments)
+          break;
+
+        // Sort sample indices by cluster.
+        vecStarts.fill(0);
         for (int i=0; i<iSamples; ++i)
+          ++vecStarts[vecAssignments[i] + 1];
+        for (int c=0; c<iCentroids; ++c)
+          vecStarts[c+1] += vecStarts[c];
+        vecPositions = vecStarts;
+        for (int i=0; i<iSamples; ++i)
+          vecOrder[vecPositions[vecAssignments[i]]++] = i;
+
+        Pii::forEachBand(policy, iCentroids, 0,
+                         KMeansUpdate<SampleSet>(samples, vecOrder.constData(), vecStarts.constData(),
+                                                 vecMeans.data()));
+
+        if (bUseBounds)
+          previousCentroids = centroidSet;
+
+        typedef typename PiiSampleSet::Traits<SampleSet>::FeatureType T;
+        for (int c=0; c<iCentroids; ++c)
+          {
+            // An empty cluster keeps its previous centroid.
+            if (vecStarts[c+1] == vecStarts[c])
+              continue;
+            typename PiiSampleSet::Traits<SampleSet>::FeatureIterator pCentroid =
+              PiiSampleSet::sampleAt(centroidSet, c);
+            const double* pMean = vecMeans.constData() + c * iFeatures;
+            for (int f=0; f<iFeatures; ++f, ++pCentroid)
+              *pCentroid = T(pMean[f]);
+          }
+
+        if (bUseBounds)
           {
-            // This is the closest centroid
-            int centroidIndex = findClosestMatch(PiiSampleSet::sampleAt(samples,i), resultSet, measure);
-
-            // Iteratively update the mean
-            adaptVector(centroidSet[centroidIndex],
-                        PiiSampleSet::sampleAt(samples,i),
-                        iFeatures,
-                        1.0/++hitCounts[centroidIndex]);
+            const SampleSet& constPrevious = previousCentroids;
+            int iFarthest = 0;
+            double dMaxMovement = 0, dSecondMovement = 0;
+            for (int c=0; c<iCentroids; ++c)
+              {
+                double d = vecMovements[c] = std::sqrt(measure(PiiSampleSet::sampleAt(constPrevious, c),
+                                                               PiiSampleSet::sampleAt(constCentroids, c),
+                                                               iFeatures));
+                if (d > dMaxMovement)
+                  {
+                    dSecondMovement = dMaxMovement;
+                    dMaxMovement = d;
+                    iFarthest = c;
+                  }
+                else if (d > dSecondMovement)
+                  dSecondMovement = d;
+              }
+            for (int i=0; i<iSamples; ++i)
+              {
+                const int a = vecAssignments[i];
+                vecUpper[i] += vecMovements[a];
+                vecLower[i] -= a == iFarthest ? dSecondMovement : dMaxMovement;
+              }
           }
-        // Now we have the new centers. Let's see if they equal to the
-        // previous ones...
-        if (PiiSampleSet::equals(centroidSet, resultSet))
+
+        if (++iterationCount == maxIterations)
           break;
+      }
+    return centroidSet;
+  }
+
+  template <class SampleSet, class DistanceMeasure>
+  void miniBatchKMeans(const Pii::ParallelExecution& policy,
+                       SampleSet& centroids,
+                       QVector<int>& counts,
+                       const SampleSet& batch,
+                       const DistanceMeasure& measure)
+  {
+    const int iCentroids = PiiSampleSet::sampleCount(centroids),
+      iSamples = PiiSampleSet::sampleCount(batch),
+      iFeatures = PiiSampleSet::featureCount(batch);
+    if (iCentroids == 0 || iSamples == 0)
+      return;
+    if (counts.size() != iCentroids)
+      counts.fill(0, iCentroids);
 
-        resultSet = centroidSet;
-        ++iterationCount;
+    QVector<int> vecAssignments(iSamples);
+    const SampleSet& constCentroids = centroids;
+    Pii::forEachBand(policy, iSamples, 0,
+                     KMeansAssignment<SampleSet,DistanceMeasure>(batch, constCentroids, measure,
+                                                                 0, vecAssignments.data(), 0, 0));
+    // Each centroid is the running mean of its samples.
+    for (int i=0; i<iSamples; ++i)
+      {
+        const int c = vecAssignments[i];
+        adaptVector(PiiSampleSet::sampleAt(centroids, c),
+                    PiiSampleSet::sampleAt(batch, i),
+                    iFeatures,
+                    1.0/++counts[c]);
       }
-    return resultSet;
   }
 
   template <class SampleSet> SampleSet createRandomSampleSet(int samples,
@@ -18,11 +18,13 @@
 
 #include <PiiMatrix.h>
 #include <PiiHeap.h>
+#include <PiiParallel.h>
 #include <QList>
 #include <QPair>
 #include <QVector>
 #include "PiiClassificationGlobal.h"
 #include "PiiDistanceMeasure.h"
+#include "PiiSquaredGeometricDistance.h"
 #include "PiiSampleSet.h"
 #include "PiiClassificationException.h"
 
@@ -142,6 +144,68 @@ namespace PiiClassification
                                             bool symmetric = true,
                                             bool calculateDiagonal = false);
 
+  /**
+   * Generates a distance matrix in parallel. The rows of the matrix
+   * are calculated in blocks, and each block is compared to a tile of
+   * samples that fits into the cache. If *symmetric* is `true`, only
+   * the lower triangle is calculated. The work is still divided
+   * evenly between threads. If *samples* is a PiiMatrix and *measure*
+   * is PiiSquaredGeometricDistance, a vectorized kernel compares each
+   * row to many samples at once.
+   *
+   * *measure* must be safe to call from many threads.
+   *
+   * ~~~(c++)
+   * PiiMatrix<double> matDistances(PiiClassification::calculateDistanceMatrix(Pii::ParallelExecution(),
+   *                                                                           matSamples,
+   *                                                                           PiiSquaredGeometricDistance<const float*>()));
+   * ~~~
+   */
+  template <class SampleSet, class DistanceMeasure>
+  PiiMatrix<double> calculateDistanceMatrix(const Pii::ParallelExecution& policy,
+                                            const SampleSet& samples,
+                                            const DistanceMeasure& measure,
+                                            bool symmetric = true,
+                                            bool calculateDiagonal = false);
+
+  /**
+   * Calculates a distance matrix in blocks of *blockRows* rows
+   * without storing the full matrix. Each block is calculated in
+   * parallel as determined by *policy* and passed to *function* in
+   * the calling thread as `function(firstRow, distances)`. The
+   * distances matrix has at most *blockRows* rows and as many
+   * columns as there are samples. Element (r,c) is the distance
+   * between sample `firstRow + r` and sample c, diagonal included.
+   * The memory needed is proportional to *blockRows* times the
+   * number of samples.
+   *
+   * ~~~(c++)
+   * struct NeighborCounter
+   * {
+   *   NeighborCounter(QVector<int>& counts) : counts(counts) {}
+   *   void operator() (int firstRow, const PiiMatrix<double>& distances)
+   *   {
+   *     for (int r=0; r<distances.rows(); ++r)
+   *       for (int c=0; c<distances.columns(); ++c)
+   *         if (distances(r,c) < 0.01)
+   *           ++counts[firstRow + r];
+   *   }
+   *   QVector<int>& counts;
+   * };
+   *
+   * QVector<int> vecCounts(matSamples.rows());
+   * PiiClassification::calculateDistanceRows(Pii::ParallelExecution(), matSamples,
+   *                                          PiiSquaredGeometricDistance<const float*>(),
+   *                                          256, NeighborCounter(vecCounts));
+   * ~~~
+   */
+  template <class SampleSet, class DistanceMeasure, class Function>
+  void calculateDistanceRows(const Pii::ParallelExecution& policy,
+                             const SampleSet& samples,
+                             const DistanceMeasure& measure,
+                             int blockRows,
+                             Function function);
+
 
   /**
    * Find the closest match for *sample* in *modelSet*.
@@ -218,6 +282,47 @@ namespace PiiClassification
                                const DistanceMeasure& measure,
                                int n);
 
+  /**
+   * Finds the *n* closest matches in *modelSet* for each sample in
+   * *samples*. The result is equal to calling the single-sample
+   * version for each sample in turn, but the search is faster for
+   * large sets.
+   *
+   * If the sample sets are matrices and *measure* is a
+   * PiiSquaredGeometricDistance (either directly or through
+   * PiiDistanceMeasure), the models are processed in cache-sized
+   * tiles. Each tile is transposed so that the distances from a
+   * sample to all models in the tile are accumulated in a single
+   * loop the compiler can vectorize. Other measures compare the
+   * samples one by one.
+   *
+   * @return one match list for each sample, sorted in ascending order
+   * according to the distance.
+   *
+   * ~~~(c++)
+   * PiiSquaredGeometricDistance<const float*> dist;
+   * QVector<PiiClassification::MatchList> vecMatches =
+   *   PiiClassification::findClosestMatches(matObserved, matModels, dist, 5);
+   * ~~~
+   */
+  template <class SampleSet, class DistanceMeasure>
+  QVector<MatchList> findClosestMatches(const SampleSet& samples,
+                                        const SampleSet& modelSet,
+                                        const DistanceMeasure& measure,
+                                        int n);
+
+  /**
+   * Finds the *n* closest matches for each sample in *samples* in
+   * parallel. The samples are divided into bands as determined by
+   * *policy*. *measure* must be safe to call from many threads.
+   */
+  template <class SampleSet, class DistanceMeasure>
+  QVector<MatchList> findClosestMatches(const Pii::ParallelExecution& policy,
+                                        const SampleSet& samples,
+                                        const SampleSet& modelSet,
+                                        const DistanceMeasure& measure,
+                                        int n);
+
   /**
    * Classify a sample using the *k nearest neighbors* rule.
    * This function compares *sample* to each model in *modelSet*, to
@@ -261,6 +366,46 @@ namespace PiiClassification
                      double* distance = 0,
                      int* closestIndex = 0);
 
+  /**
+   * Classifies each sample in *samples* using the *k nearest
+   * neighbors* rule. The closest matches are searched with the batch
+   * version of [findClosestMatches()].
+   *
+   * @param distances an optional output value that, if non-zero,
+   * will store the distance to the closest sample of the winning
+   * class for each sample.
+   *
+   * @param closestIndices an optional output value that, if
+   * non-zero, will store the index of the closest model sample of the
+   * winning class for each sample.
+   *
+   * @return the winning class label for each sample. See the
+   * single-sample version for details.
+   */
+  template <class SampleSet, class DistanceMeasure>
+  QVector<double> knnClassify(const SampleSet& samples,
+                              const SampleSet& modelSet,
+                              const QVector<double>& labels,
+                              const DistanceMeasure& measure,
+                              int k,
+                              QVector<double>* distances = 0,
+                              QVector<int>* closestIndices = 0);
+
+  /**
+   * Classifies each sample in *samples* in parallel. The samples are
+   * divided into bands as determined by *policy*. *measure* must be
+   * safe to call from many threads.
+   */
+  template <class SampleSet, class DistanceMeasure>
+  QVector<double> knnClassify(const Pii::ParallelExecution& policy,
+                              const SampleSet& samples,
+                              const SampleSet& modelSet,
+                              const QVector<double>& labels,
+                              const DistanceMeasure& measure,
+                              int k,
+                              QVector<double>* distances = 0,
+                              QVector<int>* closestIndices = 0);
+
   /**
    * Adapt a *code* vector towards *sample* with the given strength
    * *alpha*. The code vector will be modified in place. The function
@@ -301,7 +446,18 @@ namespace PiiClassification
    * and \(\mu_i\) is the centroid or mean point of all the points
    * \(x_j \in S_i\). This implementation uses an iterative
    * refinement heuristic known as Lloyd's algorithm to solve the
-   * optimization problem.
+   * optimization problem. The initial centroids are selected with
+   * [kMeansPlusPlus()].
+   *
+   * If *measure* is PiiSquaredGeometricDistance, Hamerly's
+   * algorithm is used to speed up the assignment of samples to
+   * centroids. It keeps an upper bound for the distance to the
+   * closest centroid and a lower bound for the distance to the second
+   * closest one. The triangle inequality makes it possible to skip
+   * most distance calculations once the centroids start to settle.
+   * The result is the same as with plain Lloyd iterations.
+   *
+   * This function runs sequentially. See the parallel overload.
    *
    * @param samples a set of feature vectors to run the algorithm on.
    * Each row of this matrix represents a feature vector. The number
@@ -324,6 +480,80 @@ namespace PiiClassification
                    const DistanceMeasure& measure,
                    unsigned int maxIterations = 0);
 
+  /**
+   * Runs the k-means algorithm in parallel. Samples are assigned to
+   * centroids in bands as determined by *policy*, and the new
+   * centroids are calculated in parallel. Each centroid is the mean
+   * of its samples summed in sample order, which makes the result
+   * independent of the number of threads. *measure* must be safe to
+   * call from many threads.
+   *
+   * ~~~(c++)
+   * PiiMatrix<float> matCodeBook(PiiClassification::kMeans(Pii::ParallelExecution(), matSamples, 4096,
+   *                                                        PiiSquaredGeometricDistance<const float*>()));
+   * ~~~
+   */
+  template <class SampleSet, class DistanceMeasure>
+  SampleSet kMeans(const Pii::ParallelExecution& policy,
+                   const SampleSet& samples,
+                   unsigned int k,
+                   const DistanceMeasure& measure,
+                   unsigned int maxIterations = 0);
+
+  /**
+   * Selects *k* initial centroids for k-means clustering using the
+   * k-means++ method. The first centroid is selected randomly. Each
+   * following one is selected with a probability proportional to the
+   * distance between the sample and the closest centroid already
+   * selected, as measured by *measure*. With
+   * PiiSquaredGeometricDistance this is the distance squared, as in
+   * the original method. The distances are updated in parallel as
+   * determined by *policy*.
+   *
+   * Spreading the initial centroids this way makes k-means converge
+   * faster and to a better solution than random selection.
+   *
+   * @return *k* samples selected from *samples*, or all samples if
+   * there are no more than *k*.
+   */
+  template <class SampleSet, class DistanceMeasure>
+  SampleSet kMeansPlusPlus(const Pii::ParallelExecution& policy,
+                           const SampleSet& samples,
+                           int k,
+                           const DistanceMeasure& measure);
+
+  /**
+   * Runs one step of mini-batch k-means. Each sample in *batch* is
+   * first assigned to its closest centroid in parallel. Then, each
+   * centroid is moved towards its samples with a learning rate that
+   * is inversely proportional to the number of samples the centroid
+   * has received so far. This makes each centroid the running mean
+   * of all samples assigned to it.
+   *
+   * Only one batch needs to be in memory at a time. This makes it
+   * possible to cluster data sets that do not fit into memory.
+   *
+   * @param centroids the current centroids, modified in place.
+   *
+   * @param counts the number of samples each centroid has received.
+   * If the size of this vector doesn't match the number of centroids,
+   * it will be reset to zeros.
+   *
+   * ~~~(c++)
+   * PiiSquaredGeometricDistance<const float*> measure;
+   * PiiMatrix<float> matCentroids(PiiClassification::kMeansPlusPlus(policy, matFirstBatch, 256, measure));
+   * QVector<int> vecCounts;
+   * for (PiiMatrix<float> matBatch = matFirstBatch; !matBatch.isEmpty(); matBatch = readNextBatch())
+   *   PiiClassification::miniBatchKMeans(policy, matCentroids, vecCounts, matBatch, measure);
+   * ~~~
+   */
+  template <class SampleSet, class DistanceMeasure>
+  void miniBatchKMeans(const Pii::ParallelExecution& policy,
+                       SampleSet& centroids,
+                       QVector<int>& counts,
+                       const SampleSet& batch,
+                       const DistanceMeasure& measure);
+
   /**
    * Create a random sample set. Each element in the returned sample
    * set is a random number uniformly distributed in the range
@@ -229,10 +229,16 @@ public:
    * - `SomQErrAlgorithm` - a modification of the "parameterless" SOM
    * algorithm. Each input sample is weighted based on its
    * quantization error. This algorithm is the most "elastic" of the
-   * three. It tries to cover the whole input space independent of
+   * sequential ones. It tries to cover the whole input space independent of
    * data density.
+   *
+   * - `SomBatchAlgorithm` - the batch SOM algorithm. Each code vector
+   * is replaced by a neighborhood-weighted mean of the samples, and
+   * all samples are processed at once on each epoch. The best
+   * matching units are searched in parallel. In on-line learning,
+   * works like `SomSequentialAlgorithm`.
    */
-  enum SomLearningAlgorithm { SomSequentialAlgorithm, SomBalancedAlgorithm, SomQErrAlgorithm };
+  enum SomLearningAlgorithm { SomSequentialAlgorithm, SomBalancedAlgorithm, SomQErrAlgorithm, SomBatchAlgorithm };
 };
 
 #endif //_PIICLASSIFICATIONGLOBAL_H
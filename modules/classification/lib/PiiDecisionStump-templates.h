@@ -17,6 +17,8 @@
 # error "Never use <PiiDecisionStump-templates.h> directly; include <PiiDecisionStump.h> instead."
 #endif
 
+#include <algorithm>
+
 template <class SampleSet> PiiDecisionStump<SampleSet>::Data::Data() :
   iSelectedFeature(0),
   dLeftLabel(NAN),
@@ -61,10 +63,173 @@ double PiiDecisionStump<SampleSet>::optimizeSplit(const QVector<double>& leftWei
 }
 
 
+template <class SampleSet> PiiDecisionStump<SampleSet>::FeatureIndex::FeatureIndex() :
+  iSampleCount(0), iFeatureCount(0), iBinCount(0)
+{
+}
+
+template <class SampleSet>
+PiiDecisionStump<SampleSet>::FeatureIndex::FeatureIndex(const Pii::ParallelExecution& policy,
+                                                        const SampleSet& samples,
+                                                        int binCount) :
+  iSampleCount(PiiSampleSet::sampleCount(samples)),
+  iFeatureCount(PiiSampleSet::featureCount(samples)),
+  iBinCount(binCount > 0 ? qBound(2, binCount, 256) : 0)
+{
+  if (iSampleCount == 0 || iFeatureCount == 0)
+    {
+      iSampleCount = iFeatureCount = 0;
+      return;
+    }
+  if (iBinCount == 0)
+    matOrder = PiiMatrix<int>(iFeatureCount, iSampleCount);
+  else
+    {
+      matBins = PiiMatrix<unsigned char>(iFeatureCount, iSampleCount);
+      vecBinLimits.resize(iFeatureCount);
+    }
+  // Each feature takes O(N log N) time; don't combine them to bands.
+  Pii::ParallelExecution featurePolicy(policy);
+  featurePolicy.minBandRows = 1;
+  Pii::forEachBand(featurePolicy, iFeatureCount, 0, IndexBuilder(this, samples));
+}
+
+template <class SampleSet>
+void PiiDecisionStump<SampleSet>::IndexBuilder::operator() (int firstFeature, int featureCount)
+{
+  const int iSamples = index->iSampleCount;
+  QVector<QPair<FeatureType,int> > vecValues(iSamples);
+  for (int f=firstFeature; f<firstFeature+featureCount; ++f)
+    {
+      typename PiiSampleSet::Traits<SampleSet>::ConstColumnIterator itColumn =
+        PiiSampleSet::columnBegin(samples, f);
+      for (int i=0; i<iSamples; ++i, ++itColumn)
+        vecValues[i] = qMakePair(FeatureType(*itColumn), i);
+      // Equal values are ordered by sample index.
+      std::sort(vecValues.begin(), vecValues.end());
+
+      if (index->iBinCount == 0)
+        {
+          int* pOrder = index->matOrder.row(f);
+          for (int i=0; i<iSamples; ++i)
+            pOrder[i] = vecValues[i].second;
+          continue;
+        }
+
+      unsigned char* pBins = index->matBins.row(f);
+      QVector<FeatureType>& vecLimits = index->vecBinLimits[f];
+      for (int iStart = 0; iStart < iSamples; )
+        {
+          const int iBin = vecLimits.size();
+          int iEnd = qMax(iStart + 1, int(qint64(iSamples) * (iBin + 1) / index->iBinCount));
+          // A run of equal values is never split.
+          while (iEnd < iSamples && !(vecValues[iEnd-1].first < vecValues[iEnd].first))
+            ++iEnd;
+          for (int i=iStart; i<iEnd; ++i)
+            pBins[vecValues[i].second] = (unsigned char)iBin;
+          vecLimits << vecValues[iEnd-1].first;
+          iStart = iEnd;
+        }
+    }
+}
+
+template <class SampleSet>
+void PiiDecisionStump<SampleSet>::SplitSearch::operator() (int firstFeature, int featureCount)
+{
+  QVector<double> vecLeftWeights(weightTotals.size()), vecHistogram;
+  for (int f=firstFeature; f<firstFeature+featureCount; ++f)
+    {
+      if (index.binCount() == 0)
+        searchSorted(f, vecLeftWeights);
+      else
+        searchBinned(f, vecLeftWeights, vecHistogram);
+    }
+}
+
+template <class SampleSet>
+void PiiDecisionStump<SampleSet>::SplitSearch::searchSorted(int feature, QVector<double>& leftWeights)
+{
+  const int iSamples = index.sampleCount();
+  const int* pOrder = index.matOrder.row(feature);
+  Split& split = splits[feature];
+  leftWeights.fill(0);
+  FeatureType value = PiiSampleSet::sampleAt(samples, pOrder[0])[feature];
+  for (int i=0; i<iSamples; ++i)
+    {
+      const int iSample = pOrder[i];
+      leftWeights[labels[iSample]] += weights[iSample];
+      // Thresholds can only be placed between different values.
+      FeatureType nextValue = value;
+      if (i+1 < iSamples)
+        {
+          nextValue = PiiSampleSet::sampleAt(samples, pOrder[i+1])[feature];
+          if (!(value < nextValue))
+            continue;
+        }
+
+      int iLeftLabel = 0, iRightLabel = 0;
+      double dError = optimizeSplit(leftWeights, weightTotals, weightSum, &iLeftLabel, &iRightLabel);
+      if (dError < split.dError)
+        {
+          split.dError = dError;
+          split.iLeftLabel = iLeftLabel;
+          split.iRightLabel = iRightLabel;
+          split.threshold = value;
+        }
+      value = nextValue;
+    }
+}
+
+template <class SampleSet>
+void PiiDecisionStump<SampleSet>::SplitSearch::searchBinned(int feature,
+                                                            QVector<double>& leftWeights,
+                                                            QVector<double>& histogram)
+{
+  const int iSamples = index.sampleCount(), iLabels = weightTotals.size();
+  const QVector<FeatureType>& vecLimits = index.vecBinLimits[feature];
+  const int iBins = vecLimits.size();
+  const unsigned char* pBins = index.matBins.row(feature);
+  Split& split = splits[feature];
+
+  // Per-label weight sums in each bin.
+  histogram.fill(0, iBins * iLabels);
+  double* pHistogram = histogram.data();
+  for (int i=0; i<iSamples; ++i)
+    pHistogram[pBins[i] * iLabels + labels[i]] += weights[i];
+
+  leftWeights.fill(0);
+  for (int b=0; b<iBins; ++b)
+    {
+      for (int l=0; l<iLabels; ++l)
+        leftWeights[l] += pHistogram[b * iLabels + l];
+
+      int iLeftLabel = 0, iRightLabel = 0;
+      double dError = optimizeSplit(leftWeights, weightTotals, weightSum, &iLeftLabel, &iRightLabel);
+      if (dError < split.dError)
+        {
+          split.dError = dError;
+          split.iLeftLabel = iLeftLabel;
+          split.iRightLabel = iRightLabel;
+          split.threshold = vecLimits[b];
+        }
+    }
+}
+
 template <class SampleSet>
 void PiiDecisionStump<SampleSet>::learn(const SampleSet& samples,
                                         const QVector<double>& labels,
                                         const QVector<double>& weights)
+{
+  learn(Pii::ParallelExecution(1), FeatureIndex(Pii::ParallelExecution(1), samples),
+        samples, labels, weights);
+}
+
+template <class SampleSet>
+void PiiDecisionStump<SampleSet>::learn(const Pii::ParallelExecution& policy,
+                                        const FeatureIndex& index,
+                                        const SampleSet& samples,
+                                        const QVector<double>& labels,
+                                        const QVector<double>& weights)
 {
   PII_D;
   d->iSelectedFeature = 0;
@@ -73,60 +238,54 @@ void PiiDecisionStump<SampleSet>::learn(const SampleSet& samples,
 
   const int iSamples = PiiSampleSet::sampleCount(samples),
     iFeatures = PiiSampleSet::featureCount(samples);
+  if (iSamples == 0 || iFeatures == 0)
+    return;
+
+  if (index.sampleCount() != iSamples || index.featureCount() != iFeatures)
+    {
+      learn(policy, FeatureIndex(policy, samples, index.binCount()), samples, labels, weights);
+      return;
+    }
 
   const QVector<double> vecWeights(weights.size() == iSamples ?
                                    weights : QVector<double>(iSamples, 1.0/iSamples));
 
-
   double dWeightSum = 0;
   // Calculate the sum of weights for each class separately
   QVector<double> vecWeightTotals;
+  QVector<int> vecLabels(iSamples);
   for (int i=0; i<iSamples; ++i)
     {
       int iLabel = int(labels[i]);
+      vecLabels[i] = iLabel;
       if (iLabel >= vecWeightTotals.size())
         vecWeightTotals.resize(iLabel+1);
-      vecWeightTotals[iLabel] += weights[i];
-      dWeightSum += weights[i];
+      vecWeightTotals[iLabel] += vecWeights[i];
+      dWeightSum += vecWeights[i];
     }
 
-  QVector<Feature> vecFeatures(iSamples);
-  QVector<double> vecLeftWeights(vecWeightTotals.size());
+  // Each feature is searched independently, and the best one is
+  // selected afterwards. The result does not depend on the number of
+  // threads.
+  QVector<Split> vecSplits(iFeatures);
+  Pii::ParallelExecution featurePolicy(policy);
+  featurePolicy.minBandRows = 1;
+  Pii::forEachBand(featurePolicy, iFeatures, 0,
+                   SplitSearch(index, samples, vecLabels, vecWeights,
+                               vecWeightTotals, dWeightSum, vecSplits.data()));
 
   double dMinError = INFINITY;
-
-  // For each feature
   for (int f=0; f<iFeatures; ++f)
     {
-      for (int i=0; i<iSamples; ++i)
-        vecFeatures[i] = Feature(PiiSampleSet::sampleAt(samples,i)[f], int(labels[i]), weights[i]);
-
-      // Sort according to the feature value
-      qSort(vecFeatures);
-      vecLeftWeights.fill(0);
-
-      // Calculate classification error for each threshold.
-      for (int i=0; i<iSamples; i++)
+      if (vecSplits[f].dError < dMinError)
         {
-          vecLeftWeights[vecFeatures[i].iLabel] += vecFeatures[i].dWeight;
-
-          int iLeftLabel = 0, iRightLabel = 0;
-          double dError = optimizeSplit(vecLeftWeights, vecWeightTotals,
-                                        dWeightSum,
-                                        &iLeftLabel, &iRightLabel);
-
-          if (dError < dMinError)
-            {
-              dMinError = dError;
-              d->dLeftLabel = iLeftLabel;
-              d->dRightLabel = iRightLabel;
-              d->iSelectedFeature = f;
-              d->threshold = vecFeatures[i].value;
-            }
+          dMinError = vecSplits[f].dError;
+          d->dLeftLabel = vecSplits[f].iLeftLabel;
+          d->dRightLabel = vecSplits[f].iRightLabel;
+          d->iSelectedFeature = f;
+          d->threshold = vecSplits[f].threshold;
         }
     }
-
-  //piiDebug("Selected feature %d, threshold %lf (%d|%d)", d->iSelectedFeature, double(d->threshold), int(d->dLeftLabel), int(d->dRightLabel));
 }
 
 template <class SampleSet> double PiiDecisionStump<SampleSet>::classify(ConstFeatureIterator sample) throw()
@@ -20,6 +20,8 @@
 #include "PiiClassifier.h"
 
 #include <PiiSerializationTraits.h>
+#include <PiiParallel.h>
+#include <PiiMatrix.h>
 
 /**
  * A primitive learner that works by thresholding a single feature. A
@@ -33,6 +35,21 @@
  * stump that selects not only the optimal threshold but also two
  * classes that are optimally separated by the threshold.
  *
+ * Finding the optimal threshold requires the samples to be sorted
+ * according to each feature. When many stumps are trained with the
+ * same samples, as in boosting, the sorting can be done only once by
+ * creating a [FeatureIndex] and passing it to [learn()]. The index
+ * can also divide the feature values into a fixed number of bins,
+ * which makes training faster with large sample sets at the cost of
+ * a coarser choice of thresholds.
+ *
+ * ~~~(c++)
+ * PiiDecisionStump<PiiMatrix<float> >::FeatureIndex index(Pii::ParallelExecution(), matSamples, 64);
+ * PiiDecisionStump<PiiMatrix<float> > stump;
+ * stump.learn(Pii::ParallelExecution(), index, matSamples, vecLabels, vecWeights);
+ * ~~~
+ *
+ * @see PiiDecisionStumpFactory
  */
 template <class SampleSet> class PiiDecisionStump :
   public PiiClassifier<SampleSet>,
@@ -42,16 +59,90 @@ public:
   typedef typename PiiSampleSet::Traits<SampleSet>::ConstFeatureIterator ConstFeatureIterator;
   typedef typename PiiSampleSet::Traits<SampleSet>::FeatureType FeatureType;
 
+  /**
+   * Presorted feature values of a sample set. Each feature is sorted
+   * separately. Optionally, the values of each feature are divided
+   * into bins that contain roughly the same number of samples.
+   * Equal feature values always fall into the same bin.
+   */
+  class FeatureIndex
+  {
+  public:
+    /**
+     * Creates an empty index.
+     */
+    FeatureIndex();
+
+    /**
+     * Creates an index for *samples*, sorting the features in
+     * parallel.
+     *
+     * @param binCount the maximum number of bins per feature. If
+     * this value is zero or negative, no binning will be done.
+     * Otherwise, the value will be clamped to [2, 256]. A binned index
+     * takes one byte per feature value.
+     */
+    FeatureIndex(const Pii::ParallelExecution& policy, const SampleSet& samples, int binCount = 0);
+
+    /**
+     * Returns `true` if the index is empty.
+     */
+    bool isEmpty() const { return iSampleCount == 0; }
+    /**
+     * Returns the number of samples in the index.
+     */
+    int sampleCount() const { return iSampleCount; }
+    /**
+     * Returns the number of features in the index.
+     */
+    int featureCount() const { return iFeatureCount; }
+    /**
+     * Returns the maximum number of bins per feature, or zero if the
+     * index is not binned.
+     */
+    int binCount() const { return iBinCount; }
+
+  private:
+    friend class PiiDecisionStump;
+
+    int iSampleCount, iFeatureCount, iBinCount;
+    // Sample indices in ascending order of each feature. One row per
+    // feature.
+    PiiMatrix<int> matOrder;
+    // The bin of each sample. One row per feature.
+    PiiMatrix<unsigned char> matBins;
+    // The largest value in each bin of each feature.
+    QVector<QVector<FeatureType> > vecBinLimits;
+  };
+
   PiiDecisionStump();
 
   /**
    * Finds the feature that best separates the two classes present in
-   * *samples* and an optimal threshold for it.
+   * *samples* and an optimal threshold for it. If *weights* is empty,
+   * each sample will be given an equal weight.
    */
   void learn(const SampleSet& samples,
              const QVector<double>& labels,
              const QVector<double>& weights);
 
+  /**
+   * Trains the stump using a presorted *index* for *samples*. The
+   * features are searched in parallel. If *index* is not binned, the
+   * result is the same as with the non-indexed version. With a
+   * binned index, only bin limits are considered as thresholds.
+   *
+   * @param policy execution policy for the feature search
+   *
+   * @param index an index created for *samples*. If the sizes do not
+   * match, a temporary index will be created.
+   */
+  void learn(const Pii::ParallelExecution& policy,
+             const FeatureIndex& index,
+             const SampleSet& samples,
+             const QVector<double>& labels,
+             const QVector<double>& weights);
+
   /**
    * Returns [leftLabel()] if the [selectedFeature()] "selected
    * feature" is less than or equal to [threshold()] and [rightLabel()]
@@ -117,10 +208,57 @@ private:
   };
   PII_D_FUNC;
 
-  double optimizeSplit(const QVector<double>& leftWeights,
-                       const QVector<double>& weightTotals,
-                       double totalWeightSum,
-                       int* leftLabel, int* rightLabel);
+  static double optimizeSplit(const QVector<double>& leftWeights,
+                              const QVector<double>& weightTotals,
+                              double totalWeightSum,
+                              int* leftLabel, int* rightLabel);
+
+  // The best split found for a feature.
+  struct Split
+  {
+    Split() : dError(INFINITY), iLeftLabel(0), iRightLabel(0), threshold(0) {}
+
+    double dError;
+    int iLeftLabel, iRightLabel;
+    FeatureType threshold;
+  };
+
+  // Finds the best split for each feature.
+  struct SplitSearch
+  {
+    SplitSearch(const FeatureIndex& index, const SampleSet& samples,
+                const QVector<int>& labels, const QVector<double>& weights,
+                const QVector<double>& weightTotals, double weightSum,
+                Split* splits) :
+      index(index), samples(samples), labels(labels), weights(weights),
+      weightTotals(weightTotals), weightSum(weightSum), splits(splits)
+    {}
+
+    void operator() (int firstFeature, int featureCount);
+    void searchSorted(int feature, QVector<double>& leftWeights);
+    void searchBinned(int feature, QVector<double>& leftWeights, QVector<double>& histogram);
+
+    const FeatureIndex& index;
+    const SampleSet& samples;
+    const QVector<int>& labels;
+    const QVector<double>& weights;
+    const QVector<double>& weightTotals;
+    double weightSum;
+    Split* splits;
+  };
+
+  // Sorts and optionally bins each feature.
+  struct IndexBuilder
+  {
+    IndexBuilder(FeatureIndex* index, const SampleSet& samples) :
+      index(index), samples(samples)
+    {}
+
+    void operator() (int firstFeature, int featureCount);
+
+    FeatureIndex* index;
+    const SampleSet& samples;
+  };
   friend struct PiiSerialization::Accessor;
   PII_DECLARE_VIRTUAL_METAOBJECT_FUNCTION;
   template <class Archive> void serialize(Archive& archive, const unsigned int)
@@ -0,0 +1,128 @@
+/* This file is part of Into.
+ * Copyright (C) Intopii 2013.
+ * All rights reserved.
+ *
+ * Licensees holding a commercial Into license may use this file in
+ * accordance with the commercial license agreement. Please see
+ * LICENSE.commercial for commercial licensing terms.
+ *
+ * Alternatively, this file may be used under the terms of the GNU
+ * Affero General Public License version 3 as published by the Free
+ * Software Foundation. In addition, Intopii gives you special rights
+ * to use Into as a part of open source software projects. Please
+ * refer to LICENSE.AGPL3 for details.
+ */
+
+#ifndef _PIIDECISIONSTUMPFACTORY_H
+#define _PIIDECISIONSTUMPFACTORY_H
+
+#include "PiiBoostClassifier.h"
+#include "PiiDecisionStump.h"
+
+/**
+ * A PiiBoostClassifier::Factory that creates decision stumps. The
+ * features are sorted only once when learning starts, and the same
+ * [PiiDecisionStump::FeatureIndex] is used for each stump. The
+ * features are searched in parallel.
+ *
+ * ~~~(c++)
+ * // Bin each feature to 64 bins
+ * PiiDecisionStumpFactory<PiiMatrix<float> > factory(64);
+ * PiiBoostClassifier<PiiMatrix<float> > classifier(&factory);
+ * classifier.learn(matSamples, vecLabels);
+ * ~~~
+ *
+ * @see PiiDefaultClassifierFactory
+ */
+template <class SampleSet> class PiiDecisionStumpFactory :
+  public PiiBoostClassifier<SampleSet>::Factory
+{
+public:
+  /**
+   * Creates a new factory.
+   *
+   * @param binCount the number of bins per feature. Zero means that
+   * all thresholds will be tried. See
+   * [PiiDecisionStump::FeatureIndex].
+   *
+   * @param policy the execution policy for sorting and searching the
+   * features.
+   */
+  explicit PiiDecisionStumpFactory(int binCount = 0,
+                                   const Pii::ParallelExecution& policy = Pii::ParallelExecution()) :
+    _iBinCount(binCount), _policy(policy)
+  {}
+
+  /**
+   * Sets the number of bins per feature. Takes effect when learning
+   * is started next time.
+   */
+  void setBinCount(int binCount) { _iBinCount = binCount; }
+  /**
+   * Returns the number of bins per feature.
+   */
+  int binCount() const { return _iBinCount; }
+
+  /**
+   * Sets the execution policy.
+   */
+  void setExecutionPolicy(const Pii::ParallelExecution& policy) { _policy = policy; }
+  /**
+   * Returns the execution policy.
+   */
+  Pii::ParallelExecution executionPolicy() const { return _policy; }
+
+  /**
+   * Creates the feature index for *samples*.
+   */
+  void startLearning(PiiBoostClassifier<SampleSet>* classifier, const SampleSet& samples);
+
+  /**
+   * Releases the feature index.
+   */
+  void endLearning(PiiBoostClassifier<SampleSet>* classifier);
+
+  /**
+   * Creates a decision stump and trains it using the feature index.
+   */
+  PiiDecisionStump<SampleSet>* create(PiiBoostClassifier<SampleSet>* classifier,
+                                      const SampleSet& samples,
+                                      const QVector<double>& labels,
+                                      const QVector<double>& weights);
+
+private:
+  int _iBinCount;
+  Pii::ParallelExecution _policy;
+  typename PiiDecisionStump<SampleSet>::FeatureIndex _index;
+};
+
+template <class SampleSet>
+void PiiDecisionStumpFactory<SampleSet>::startLearning(PiiBoostClassifier<SampleSet>* /*classifier*/,
+                                                       const SampleSet& samples)
+{
+  _index = typename PiiDecisionStump<SampleSet>::FeatureIndex(_policy, samples, _iBinCount);
+}
+
+template <class SampleSet>
+void PiiDecisionStumpFactory<SampleSet>::endLearning(PiiBoostClassifier<SampleSet>* /*classifier*/)
+{
+  _index = typename PiiDecisionStump<SampleSet>::FeatureIndex();
+}
+
+template <class SampleSet>
+PiiDecisionStump<SampleSet>* PiiDecisionStumpFactory<SampleSet>::create(PiiBoostClassifier<SampleSet>* /*classifier*/,
+                                                                        const SampleSet& samples,
+                                                                        const QVector<double>& labels,
+                                                                        const QVector<double>& weights)
+{
+  // If learning was not started by PiiBoostClassifier, the index may
+  // be missing or stale.
+  if (_index.sampleCount() != PiiSampleSet::sampleCount(samples) ||
+      _index.featureCount() != PiiSampleSet::featureCount(samples))
+    startLearning(0, samples);
+  PiiDecisionStump<SampleSet>* pStump = new PiiDecisionStump<SampleSet>;
+  pStump->learn(_policy, _index, samples, labels, weights);
+  return pStump;
+}
+
+#endif //_PIIDECISIONSTUMPFACTORY_H
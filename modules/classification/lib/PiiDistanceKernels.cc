@@ -0,0 +1,716 @@
+/* This file is part of Into.
+ * Copyright (C) Intopii 2013.
+ * All rights reserved.
+ *
+ * Licensees holding a commercial Into license may use this file in
+ * accordance with the commercial license agreement. Please see
+ * LICENSE.commercial for commercial licensing terms.
+ *
+ * Alternatively, this file may be used under the terms of the GNU
+ * Affero General Public License version 3 as published by the Free
+ * Software Foundation. In addition, Intopii gives you special rights
+ * to use Into as a part of open source software projects. Please
+ * refer to LICENSE.AGPL3 for details.
+ */
+
+#include "PiiDistanceKernels.h"
+
+#include <PiiMath.h>
+#include <PiiCpu.h>
+
+#include <cstring>
+
+namespace
+{
+  // Bit counting instructions are detected separately because they
+  // are only used by the Hamming distance.
+  enum PopcountLevel { SoftwarePopcount, HardwarePopcount, Avx512Popcount };
+
+  PopcountLevel popcountLevel()
+  {
+#if defined(PII_X86_SIMD)
+    if (Pii::hasCpuFeatures(Pii::Avx512FCpuFeature | Pii::Avx512VpopcntdqCpuFeature))
+      return Avx512Popcount;
+    if (Pii::hasCpuFeatures(Pii::PopcntCpuFeature))
+      return HardwarePopcount;
+#endif
+    return SoftwarePopcount;
+  }
+
+  // The partial sum is compared to the bound once per this many
+  // features. Reducing the vector accumulators is not free.
+  const int iBoundCheckInterval = 64;
+
+  /* Element-wise terms. These must match the generic distance
+   * measures exactly. The SIMD versions below calculate the same
+   * expressions lane by lane: differences and sums in T, everything
+   * else in double.
+   */
+  struct SquaredTerm
+  {
+    template <class T> static double term(T s, T m) { double d = double(s - m); return d*d; }
+  };
+
+  struct AbsDiffTerm
+  {
+    template <class T> static double term(T s, T m) { return double(Pii::abs(s - m)); }
+  };
+
+  struct ChiSquaredTerm
+  {
+    template <class T> static double term(T s, T m) { double d = double(s - m); return d*d / double(s + m); }
+  };
+
+  struct MinimumTerm
+  {
+    template <class T> static double term(T s, T m) { return double(qMin(s, m)); }
+  };
+
+  inline int countOnes(unsigned int v)
+  {
+    v = v - ((v >> 1) & 0x55555555u);
+    v = (v & 0x33333333u) + ((v >> 2) & 0x33333333u);
+    return int((((v + (v >> 4)) & 0x0f0f0f0fu) * 0x01010101u) >> 24);
+  }
+
+  template <class Term, class T>
+  double scalarSum(const T* sample, const T* model, int length, double bound)
+  {
+    double dSum = 0;
+    for (int i=0; i<length; )
+      {
+        const int iEnd = qMin(length, i + iBoundCheckInterval);
+        for (; i<iEnd; ++i)
+          dSum += Term::term(sample[i], model[i]);
+        if (dSum > bound)
+          break;
+      }
+    return dSum;
+  }
+
+  double scalarHamming(const int* sample, const int* model, int length, double bound)
+  {
+    double dSum = 0;
+    for (int i=0; i<length; )
+      {
+        const int iEnd = qMin(length, i + iBoundCheckInterval);
+        int iCount = 0;
+        for (; i<iEnd; ++i)
+          iCount += countOnes(unsigned(sample[i] ^ model[i]));
+        dSum += iCount;
+        if (dSum > bound)
+          break;
+      }
+    return dSum;
+  }
+
+#ifdef PII_X86_SIMD
+  namespace Sse2
+  {
+    // Four features converted to two vectors of doubles.
+    struct Pair { __m128d lo, hi; };
+
+    PII_CPU_TARGET("sse2") inline Pair toPair(__m128 v)
+    {
+      Pair p = { _mm_cvtps_pd(v), _mm_cvtps_pd(_mm_movehl_ps(v, v)) };
+      return p;
+    }
+    PII_CPU_TARGET("sse2") inline Pair toPair(__m128i v)
+    {
+      Pair p = { _mm_cvtepi32_pd(v), _mm_cvtepi32_pd(_mm_srli_si128(v, 8)) };
+      return p;
+    }
+
+    PII_CPU_TARGET("sse2") inline Pair difference(const float* s, const float* m)
+    { return toPair(_mm_sub_ps(_mm_loadu_ps(s), _mm_loadu_ps(m))); }
+    PII_CPU_TARGET("sse2") inline Pair difference(const int* s, const int* m)
+    {
+      return toPair(_mm_sub_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(s)),
+                                  _mm_loadu_si128(reinterpret_cast<const __m128i*>(m))));
+    }
+    PII_CPU_TARGET("sse2") inline Pair difference(const double* s, const double* m)
+    {
+      Pair p = { _mm_sub_pd(_mm_loadu_pd(s), _mm_loadu_pd(m)),
+                 _mm_sub_pd(_mm_loadu_pd(s+2), _mm_loadu_pd(m+2)) };
+      return p;
+    }
+
+    PII_CPU_TARGET("sse2") inline Pair sum(const float* s, const float* m)
+    { return toPair(_mm_add_ps(_mm_loadu_ps(s), _mm_loadu_ps(m))); }
+    PII_CPU_TARGET("sse2") inline Pair sum(const int* s, const int* m)
+    {
+      return toPair(_mm_add_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(s)),
+                                  _mm_loadu_si128(reinterpret_cast<const __m128i*>(m))));
+    }
+    PII_CPU_TARGET("sse2") inline Pair sum(const double* s, const double* m)
+    {
+      Pair p = { _mm_add_pd(_mm_loadu_pd(s), _mm_loadu_pd(m)),
+                 _mm_add_pd(_mm_loadu_pd(s+2), _mm_loadu_pd(m+2)) };
+      return p;
+    }
+
+    // min_pd(a,b) returns b unless a < b, which equals qMin(a,b).
+    // Conversion to double retains the order.
+    PII_CPU_TARGET("sse2") inline Pair minimum(const float* s, const float* m)
+    {
+      Pair a = toPair(_mm_loadu_ps(s)), b = toPair(_mm_loadu_ps(m));
+      Pair p = { _mm_min_pd(a.lo, b.lo), _mm_min_pd(a.hi, b.hi) };
+      return p;
+    }
+    PII_CPU_TARGET("sse2") inline Pair minimum(const int* s, const int* m)
+    {
+      Pair a = toPair(_mm_loadu_si128(reinterpret_cast<const __m128i*>(s))),
+        b = toPair(_mm_loadu_si128(reinterpret_cast<const __m128i*>(m)));
+      Pair p = { _mm_min_pd(a.lo, b.lo), _mm_min_pd(a.hi, b.hi) };
+      return p;
+    }
+    PII_CPU_TARGET("sse2") inline Pair minimum(const double* s, const double* m)
+    {
+      Pair p = { _mm_min_pd(_mm_loadu_pd(s), _mm_loadu_pd(m)),
+                 _mm_min_pd(_mm_loadu_pd(s+2), _mm_loadu_pd(m+2)) };
+      return p;
+    }
+
+    template <class Term> struct Terms;
+
+    template <> struct Terms<SquaredTerm>
+    {
+      template <class T> PII_CPU_TARGET("sse2") static Pair terms(const T* s, const T* m)
+      {
+        Pair d = difference(s, m);
+        Pair p = { _mm_mul_pd(d.lo, d.lo), _mm_mul_pd(d.hi, d.hi) };
+        return p;
+      }
+    };
+
+    template <> struct Terms<AbsDiffTerm>
+    {
+      template <class T> PII_CPU_TARGET("sse2") static Pair terms(const T* s, const T* m)
+      {
+        const __m128d signMask = _mm_set1_pd(-0.0);
+        Pair d = difference(s, m);
+        Pair p = { _mm_andnot_pd(signMask, d.lo), _mm_andnot_pd(signMask, d.hi) };
+        return p;
+      }
+    };
+
+    template <> struct Terms<ChiSquaredTerm>
+    {
+      template <class T> PII_CPU_TARGET("sse2") static Pair terms(const T* s, const T* m)
+      {
+        Pair d = difference(s, m), t = sum(s, m);
+        Pair p = { _mm_div_pd(_mm_mul_pd(d.lo, d.lo), t.lo),
+                   _mm_div_pd(_mm_mul_pd(d.hi, d.hi), t.hi) };
+        return p;
+      }
+    };
+
+    template <> struct Terms<MinimumTerm>
+    {
+      template <class T> PII_CPU_TARGET("sse2") static Pair terms(const T* s, const T* m)
+      {
+        return minimum(s, m);
+      }
+    };
+
+    PII_CPU_TARGET("sse2") inline double horizontalSum(__m128d v)
+    {
+      return _mm_cvtsd_f64(_mm_add_sd(v, _mm_unpackhi_pd(v, v)));
+    }
+
+    template <class Term, class T>
+    PII_CPU_TARGET("sse2") double accumulate(const T* sample, const T* model, int length, double bound)
+    {
+      __m128d sum1 = _mm_setzero_pd(), sum2 = _mm_setzero_pd();
+      double dSum = 0;
+      int i = 0;
+      while (i <= length - 4)
+        {
+          const int iEnd = qMin(length - 4, i + iBoundCheckInterval - 4);
+          for (; i <= iEnd; i += 4)
+            {
+              Pair p = Terms<Term>::terms(sample + i, model + i);
+              sum1 = _mm_add_pd(sum1, p.lo);
+              sum2 = _mm_add_pd(sum2, p.hi);
+            }
+          dSum = horizontalSum(_mm_add_pd(sum1, sum2));
+          if (dSum > bound)
+            return dSum;
+        }
+      for (; i<length; ++i)
+        dSum += Term::term(sample[i], model[i]);
+      return dSum;
+    }
+
+    // Counts bits in each byte and sums the counts into two 64-bit
+    // lanes.
+    PII_CPU_TARGET("sse2") inline __m128i countOnes(__m128i v)
+    {
+      const __m128i m1 = _mm_set1_epi8(0x55), m2 = _mm_set1_epi8(0x33), m4 = _mm_set1_epi8(0x0f);
+      v = _mm_sub_epi8(v, _mm_and_si128(_mm_srli_epi16(v, 1), m1));
+      v = _mm_add_epi8(_mm_and_si128(v, m2), _mm_and_si128(_mm_srli_epi16(v, 2), m2));
+      v = _mm_and_si128(_mm_add_epi8(v, _mm_srli_epi16(v, 4)), m4);
+      return _mm_sad_epu8(v, _mm_setzero_si128());
+    }
+
+    PII_CPU_TARGET("sse2") double hamming(const int* sample, const int* model, int length, double bound)
+    {
+      __m128i counts = _mm_setzero_si128();
+      double dSum = 0;
+      int i = 0;
+      while (i <= length - 4)
+        {
+          const int iEnd = qMin(length - 4, i + iBoundCheckInterval - 4);
+          for (; i <= iEnd; i += 4)
+            counts = _mm_add_epi64(counts,
+                                   countOnes(_mm_xor_si128(_mm_loadu_si128(reinterpret_cast<const __m128i*>(sample + i)),
+                                                           _mm_loadu_si128(reinterpret_cast<const __m128i*>(model + i)))));
+          dSum = double(_mm_cvtsi128_si32(counts) + _mm_cvtsi128_si32(_mm_srli_si128(counts, 8)));
+          if (dSum > bound)
+            return dSum;
+        }
+      return dSum + scalarHamming(sample + i, model + i, length - i, INFINITY);
+    }
+  }
+
+  namespace Popcnt
+  {
+    // The scalar instruction counts 64 bits at a time. It beats the
+    // byte-wise vector algorithms with short binary descriptors.
+    PII_CPU_TARGET("popcnt") double hamming(const int* sample, const int* model, int length, double bound)
+    {
+      double dSum = 0;
+      int i = 0;
+      while (i <= length - 2)
+        {
+          const int iEnd = qMin(length - 2, i + iBoundCheckInterval - 2);
+          long long iCount = 0;
+          for (; i <= iEnd; i += 2)
+            {
+              unsigned long long s, m;
+              memcpy(&s, sample + i, sizeof(s));
+              memcpy(&m, model + i, sizeof(m));
+#if defined(__x86_64__) || defined(_M_X64)
+              iCount += (long long)_mm_popcnt_u64(s ^ m);
+#else
+              iCount += _mm_popcnt_u32((unsigned int)(s ^ m)) + _mm_popcnt_u32((unsigned int)((s ^ m) >> 32));
+#endif
+            }
+          dSum += double(iCount);
+          if (dSum > bound)
+            return dSum;
+        }
+      if (i < length)
+        dSum += _mm_popcnt_u32(unsigned(sample[i] ^ model[i]));
+      return dSum;
+    }
+  }
+
+  namespace Avx512
+  {
+    // 16 features per iteration. Masked loads handle the tail.
+    PII_CPU_TARGET("avx512f,avx512vpopcntdq") double hamming(const int* sample, const int* model,
+                                                                  int length, double bound)
+    {
+      __m512i counts = _mm512_setzero_si512();
+      double dSum = 0;
+      int i = 0;
+      while (i < length)
+        {
+          const int iEnd = qMin(length, i + iBoundCheckInterval);
+          for (; i < iEnd; i += 16)
+            {
+              const __mmask16 mask = iEnd - i >= 16 ? __mmask16(0xffff) : __mmask16((1u << (iEnd - i)) - 1);
+              counts = _mm512_add_epi64(counts,
+                                        _mm512_popcnt_epi64(_mm512_xor_si512(_mm512_maskz_loadu_epi32(mask, sample + i),
+                                                                             _mm512_maskz_loadu_epi32(mask, model + i))));
+            }
+          i = iEnd;
+          dSum = double(_mm512_reduce_add_epi64(counts));
+          if (dSum > bound)
+            return dSum;
+        }
+      return dSum;
+    }
+  }
+
+  namespace Avx2
+  {
+    // Eight features converted to two vectors of doubles.
+    struct Pair { __m256d lo, hi; };
+
+    PII_CPU_TARGET("avx2") inline Pair toPair(__m256 v)
+    {
+      Pair p = { _mm256_cvtps_pd(_mm256_castps256_ps128(v)), _mm256_cvtps_pd(_mm256_extractf128_ps(v, 1)) };
+      return p;
+    }
+    PII_CPU_TARGET("avx2") inline Pair toPair(__m256i v)
+    {
+      Pair p = { _mm256_cvtepi32_pd(_mm256_castsi256_si128(v)), _mm256_cvtepi32_pd(_mm256_extracti128_si256(v, 1)) };
+      return p;
+    }
+    PII_CPU_TARGET("avx2") inline __m256i load(const int* p)
+    {
+      return _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p));
+    }
+
+    PII_CPU_TARGET("avx2") inline Pair difference(const float* s, const float* m)
+    { return toPair(_mm256_sub_ps(_mm256_loadu_ps(s), _mm256_loadu_ps(m))); }
+    PII_CPU_TARGET("avx2") inline Pair difference(const int* s, const int* m)
+    { return toPair(_mm256_sub_epi32(load(s), load(m))); }
+    PII_CPU_TARGET("avx2") inline Pair difference(const double* s, const double* m)
+    {
+      Pair p = { _mm256_sub_pd(_mm256_loadu_pd(s), _mm256_loadu_pd(m)),
+                 _mm256_sub_pd(_mm256_loadu_pd(s+4), _mm256_loadu_pd(m+4)) };
+      return p;
+    }
+
+    PII_CPU_TARGET("avx2") inline Pair sum(const float* s, const float* m)
+    { return toPair(_mm256_add_ps(_mm256_loadu_ps(s), _mm256_loadu_ps(m))); }
+    PII_CPU_TARGET("avx2") inline Pair sum(const int* s, const int* m)
+    { return toPair(_mm256_add_epi32(load(s), load(m))); }
+    PII_CPU_TARGET("avx2") inline Pair sum(const double* s, const double* m)
+    {
+      Pair p = { _mm256_add_pd(_mm256_loadu_pd(s), _mm256_loadu_pd(m)),
+                 _mm256_add_pd(_mm256_loadu_pd(s+4), _mm256_loadu_pd(m+4)) };
+      return p;
+    }
+
+    PII_CPU_TARGET("avx2") inline Pair minimum(const float* s, const float* m)
+    {
+      Pair a = toPair(_mm256_loadu_ps(s)), b = toPair(_mm256_loadu_ps(m));
+      Pair p = { _mm256_min_pd(a.lo, b.lo), _mm256_min_pd(a.hi, b.hi) };
+      return p;
+    }
+    PII_CPU_TARGET("avx2") inline Pair minimum(const int* s, const int* m)
+    {
+      Pair a = toPair(load(s)), b = toPair(load(m));
+      Pair p = { _mm256_min_pd(a.lo, b.lo), _mm256_min_pd(a.hi, b.hi) };
+      return p;
+    }
+    PII_CPU_TARGET("avx2") inline Pair minimum(const double* s, const double* m)
+    {
+      Pair p = { _mm256_min_pd(_mm256_loadu_pd(s), _mm256_loadu_pd(m)),
+                 _mm256_min_pd(_mm256_loadu_pd(s+4), _mm256_loadu_pd(m+4)) };
+      return p;
+    }
+
+    template <class Term> struct Terms;
+
+    template <> struct Terms<SquaredTerm>
+    {
+      template <class T> PII_CPU_TARGET("avx2") static Pair terms(const T* s, const T* m)
+      {
+        // No FMA. Rounding must match the scalar code.
+        Pair d = difference(s, m);
+        Pair p = { _mm256_mul_pd(d.lo, d.lo), _mm256_mul_pd(d.hi, d.hi) };
+        return p;
+      }
+    };
+
+    template <> struct Terms<AbsDiffTerm>
+    {
+      template <class T> PII_CPU_TARGET("avx2") static Pair terms(const T* s, const T* m)
+      {
+        const __m256d signMask = _mm256_set1_pd(-0.0);
+        Pair d = difference(s, m);
+        Pair p = { _mm256_andnot_pd(signMask, d.lo), _mm256_andnot_pd(signMask, d.hi) };
+        return p;
+      }
+    };
+
+    template <> struct Terms<ChiSquaredTerm>
+    {
+      template <class T> PII_CPU_TARGET("avx2") static Pair terms(const T* s, const T* m)
+      {
+        Pair d = difference(s, m), t = sum(s, m);
+        Pair p = { _mm256_div_pd(_mm256_mul_pd(d.lo, d.lo), t.lo),
+                   _mm256_div_pd(_mm256_mul_pd(d.hi, d.hi), t.hi) };
+        return p;
+      }
+    };
+
+    template <> struct Terms<MinimumTerm>
+    {
+      template <class T> PII_CPU_TARGET("avx2") static Pair terms(const T* s, const T* m)
+      {
+        return minimum(s, m);
+      }
+    };
+
+    PII_CPU_TARGET("avx2") inline double horizontalSum(__m256d v)
+    {
+      __m128d v2 = _mm_add_pd(_mm256_castpd256_pd128(v), _mm256_extractf128_pd(v, 1));
+      return _mm_cvtsd_f64(_mm_add_sd(v2, _mm_unpackhi_pd(v2, v2)));
+    }
+
+    template <class Term, class T>
+    PII_CPU_TARGET("avx2") double accumulate(const T* sample, const T* model, int length, double bound)
+    {
+      __m256d sum1 = _mm256_setzero_pd(), sum2 = _mm256_setzero_pd();
+      double dSum = 0;
+      int i = 0;
+      while (i <= length - 8)
+        {
+          const int iEnd = qMin(length - 8, i + iBoundCheckInterval - 8);
+          for (; i <= iEnd; i += 8)
+            {
+              Pair p = Terms<Term>::terms(sample + i, model + i);
+              sum1 = _mm256_add_pd(sum1, p.lo);
+              sum2 = _mm256_add_pd(sum2, p.hi);
+            }
+          dSum = horizontalSum(_mm256_add_pd(sum1, sum2));
+          if (dSum > bound)
+            return dSum;
+        }
+      for (; i<length; ++i)
+        dSum += Term::term(sample[i], model[i]);
+      return dSum;
+    }
+
+    // Nibble lookup with pshufb, summed into four 64-bit lanes.
+    PII_CPU_TARGET("avx2") inline __m256i countOnes(__m256i v)
+    {
+      const __m256i lookup = _mm256_setr_epi8(0,1,1,2,1,2,2,3,1,2,2,3,2,3,3,4,
+                                              0,1,1,2,1,2,2,3,1,2,2,3,2,3,3,4);
+      const __m256i m4 = _mm256_set1_epi8(0x0f);
+      __m256i counts = _mm256_add_epi8(_mm256_shuffle_epi8(lookup, _mm256_and_si256(v, m4)),
+                                       _mm256_shuffle_epi8(lookup, _mm256_and_si256(_mm256_srli_epi16(v, 4), m4)));
+      return _mm256_sad_epu8(counts, _mm256_setzero_si256());
+    }
+
+    PII_CPU_TARGET("avx2") double hamming(const int* sample, const int* model, int length, double bound)
+    {
+      __m256i counts = _mm256_setzero_si256();
+      double dSum = 0;
+      int i = 0;
+      while (i <= length - 8)
+        {
+          const int iEnd = qMin(length - 8, i + iBoundCheckInterval - 8);
+          for (; i <= iEnd; i += 8)
+            counts = _mm256_add_epi64(counts, countOnes(_mm256_xor_si256(load(sample + i), load(model + i))));
+          __m128i counts2 = _mm_add_epi64(_mm256_castsi256_si128(counts), _mm256_extracti128_si256(counts, 1));
+          dSum = double(_mm_cvtsi128_si32(counts2) + _mm_cvtsi128_si32(_mm_srli_si128(counts2, 8)));
+          if (dSum > bound)
+            return dSum;
+        }
+      return dSum + scalarHamming(sample + i, model + i, length - i, INFINITY);
+    }
+  }
+#endif
+
+#ifdef PII_NEON64_SIMD
+  namespace Neon
+  {
+    // Four features converted to two vectors of doubles.
+    struct Pair { float64x2_t lo, hi; };
+
+    inline Pair toPair(float32x4_t v)
+    {
+      Pair p = { vcvt_f64_f32(vget_low_f32(v)), vcvt_high_f64_f32(v) };
+      return p;
+    }
+    inline Pair toPair(int32x4_t v)
+    {
+      Pair p = { vcvtq_f64_s64(vmovl_s32(vget_low_s32(v))), vcvtq_f64_s64(vmovl_high_s32(v)) };
+      return p;
+    }
+
+    inline Pair difference(const float* s, const float* m) { return toPair(vsubq_f32(vld1q_f32(s), vld1q_f32(m))); }
+    inline Pair difference(const int* s, const int* m) { return toPair(vsubq_s32(vld1q_s32(s), vld1q_s32(m))); }
+    inline Pair difference(const double* s, const double* m)
+    {
+      Pair p = { vsubq_f64(vld1q_f64(s), vld1q_f64(m)), vsubq_f64(vld1q_f64(s+2), vld1q_f64(m+2)) };
+      return p;
+    }
+
+    inline Pair sum(const float* s, const float* m) { return toPair(vaddq_f32(vld1q_f32(s), vld1q_f32(m))); }
+    inline Pair sum(const int* s, const int* m) { return toPair(vaddq_s32(vld1q_s32(s), vld1q_s32(m))); }
+    inline Pair sum(const double* s, const double* m)
+    {
+      Pair p = { vaddq_f64(vld1q_f64(s), vld1q_f64(m)), vaddq_f64(vld1q_f64(s+2), vld1q_f64(m+2)) };
+      return p;
+    }
+
+    // vminq differs from qMin() with NaNs. Select explicitly.
+    inline float64x2_t minimum(float64x2_t a, float64x2_t b) { return vbslq_f64(vcltq_f64(a, b), a, b); }
+    inline Pair minimum(const Pair& a, const Pair& b)
+    {
+      Pair p = { minimum(a.lo, b.lo), minimum(a.hi, b.hi) };
+      return p;
+    }
+    inline Pair minimum(const float* s, const float* m) { return minimum(toPair(vld1q_f32(s)), toPair(vld1q_f32(m))); }
+    inline Pair minimum(const int* s, const int* m) { return minimum(toPair(vld1q_s32(s)), toPair(vld1q_s32(m))); }
+    inline Pair minimum(const double* s, const double* m)
+    {
+      Pair a = { vld1q_f64(s), vld1q_f64(s+2) }, b = { vld1q_f64(m), vld1q_f64(m+2) };
+      return minimum(a, b);
+    }
+
+    template <class Term> struct Terms;
+
+    template <> struct Terms<SquaredTerm>
+    {
+      template <class T> static Pair terms(const T* s, const T* m)
+      {
+        Pair d = difference(s, m);
+        Pair p = { vmulq_f64(d.lo, d.lo), vmulq_f64(d.hi, d.hi) };
+        return p;
+      }
+    };
+
+    template <> struct Terms<AbsDiffTerm>
+    {
+      template <class T> static Pair terms(const T* s, const T* m)
+      {
+        Pair d = difference(s, m);
+        Pair p = { vabsq_f64(d.lo), vabsq_f64(d.hi) };
+        return p;
+      }
+    };
+
+    template <> struct Terms<ChiSquaredTerm>
+    {
+      template <class T> static Pair terms(const T* s, const T* m)
+      {
+        Pair d = difference(s, m), t = sum(s, m);
+        Pair p = { vdivq_f64(vmulq_f64(d.lo, d.lo), t.lo), vdivq_f64(vmulq_f64(d.hi, d.hi), t.hi) };
+        return p;
+      }
+    };
+
+    template <> struct Terms<MinimumTerm>
+    {
+      template <class T> static Pair terms(const T* s, const T* m) { return minimum(s, m); }
+    };
+
+    template <class Term, class T>
+    double accumulate(const T* sample, const T* model, int length, double bound)
+    {
+      float64x2_t sum1 = vdupq_n_f64(0), sum2 = vdupq_n_f64(0);
+      double dSum = 0;
+      int i = 0;
+      while (i <= length - 4)
+        {
+          const int iEnd = qMin(length - 4, i + iBoundCheckInterval - 4);
+          for (; i <= iEnd; i += 4)
+            {
+              Pair p = Terms<Term>::terms(sample + i, model + i);
+              sum1 = vaddq_f64(sum1, p.lo);
+              sum2 = vaddq_f64(sum2, p.hi);
+            }
+          dSum = vaddvq_f64(vaddq_f64(sum1, sum2));
+          if (dSum > bound)
+            return dSum;
+        }
+      for (; i<length; ++i)
+        dSum += Term::term(sample[i], model[i]);
+      return dSum;
+    }
+
+    double hamming(const int* sample, const int* model, int length, double bound)
+    {
+      uint64x2_t counts = vdupq_n_u64(0);
+      double dSum = 0;
+      int i = 0;
+      while (i <= length - 4)
+        {
+          const int iEnd = qMin(length - 4, i + iBoundCheckInterval - 4);
+          for (; i <= iEnd; i += 4)
+            {
+              uint8x16_t bits = vcntq_u8(vreinterpretq_u8_s32(veorq_s32(vld1q_s32(sample + i),
+                                                                        vld1q_s32(model + i))));
+              counts = vpadalq_u32(counts, vpaddlq_u16(vpaddlq_u8(bits)));
+            }
+          dSum = double(vaddvq_u64(counts));
+          if (dSum > bound)
+            return dSum;
+        }
+      return dSum + scalarHamming(sample + i, model + i, length - i, INFINITY);
+    }
+  }
+#endif
+
+  template <class Term, class T>
+  double sumTerms(const T* sample, const T* model, int length, double bound)
+  {
+    switch (Pii::simdLevel())
+      {
+#ifdef PII_X86_SIMD
+      case Pii::Avx2Simd:
+        return Avx2::accumulate<Term>(sample, model, length, bound);
+      case Pii::Sse2Simd:
+        return Sse2::accumulate<Term>(sample, model, length, bound);
+#endif
+#ifdef PII_NEON64_SIMD
+      case Pii::NeonSimd:
+        return Neon::accumulate<Term>(sample, model, length, bound);
+#endif
+      default:
+        return scalarSum<Term>(sample, model, length, bound);
+      }
+  }
+}
+
+namespace PiiClassification
+{
+#define PII_DISTANCE_FUNCTIONS(TYPE) \
+  double squaredGeometricDistance(const TYPE* sample, const TYPE* model, int length, double bound) \
+  { \
+    return sumTerms<SquaredTerm>(sample, model, length, bound); \
+  } \
+  double absDiffDistance(const TYPE* sample, const TYPE* model, int length, double bound) \
+  { \
+    return sumTerms<AbsDiffTerm>(sample, model, length, bound); \
+  } \
+  double chiSquaredDistance(const TYPE* sample, const TYPE* model, int length, double bound) \
+  { \
+    return sumTerms<ChiSquaredTerm>(sample, model, length, bound); \
+  } \
+  double histogramIntersection(const TYPE* sample, const TYPE* model, int length) \
+  { \
+    return -sumTerms<MinimumTerm>(sample, model, length, INFINITY); \
+  }
+
+  PII_DISTANCE_FUNCTIONS(float)
+  PII_DISTANCE_FUNCTIONS(double)
+  PII_DISTANCE_FUNCTIONS(int)
+
+#undef PII_DISTANCE_FUNCTIONS
+
+  double hammingDistance(const int* sample, const int* model, int length, double bound)
+  {
+#ifdef PII_X86_SIMD
+    switch (popcountLevel())
+      {
+      case Avx512Popcount:
+        return Avx512::hamming(sample, model, length, bound);
+      case HardwarePopcount:
+        return Popcnt::hamming(sample, model, length, bound);
+      default:
+        break;
+      }
+#endif
+    switch (Pii::simdLevel())
+      {
+#ifdef PII_X86_SIMD
+      case Pii::Avx2Simd:
+        return Avx2::hamming(sample, model, length, bound);
+      case Pii::Sse2Simd:
+        return Sse2::hamming(sample, model, length, bound);
+#endif
+#ifdef PII_NEON64_SIMD
+      case Pii::NeonSimd:
+        return Neon::hamming(sample, model, length, bound);
+#endif
+      default:
+        return scalarHamming(sample, model, length, bound);
+      }
+  }
+
+  double hammingDistance(const unsigned int* sample, const unsigned int* model, int length, double bound)
+  {
+    return hammingDistance(reinterpret_cast<const int*>(sample), reinterpret_cast<const int*>(model),
+                           length, bound);
+  }
+}
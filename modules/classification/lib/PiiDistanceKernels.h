@@ -0,0 +1,136 @@
+/* This file is part of Into.
+ * Copyright (C) Intopii 2013.
+ * All rights reserved.
+ *
+ * Licensees holding a commercial Into license may use this file in
+ * accordance with the commercial license agreement. Please see
+ * LICENSE.commercial for commercial licensing terms.
+ *
+ * Alternatively, this file may be used under the terms of the GNU
+ * Affero General Public License version 3 as published by the Free
+ * Software Foundation. In addition, Intopii gives you special rights
+ * to use Into as a part of open source software projects. Please
+ * refer to LICENSE.AGPL3 for details.
+ */
+
+#ifndef _PIIDISTANCEKERNELS_H
+#define _PIIDISTANCEKERNELS_H
+
+#include "PiiClassificationGlobal.h"
+#include <PiiMathDefs.h>
+
+/**
+ * Vectorized implementations of common distance measures for `float`,
+ * `double` and `int` feature vectors. The functions use SSE2/AVX2 on
+ * x86 and NEON on 64-bit ARM, selected at run time, and fall back to
+ * portable code elsewhere.
+ *
+ * Each element-wise term is calculated exactly as in the
+ * corresponding generic distance measure (e.g.
+ * PiiSquaredGeometricDistance), and the terms are summed in `double`
+ * precision. The summation order is however different, which may
+ * change the last bits of floating-point results. With `int`
+ * features, the results are exact.
+ *
+ * Functions that take a *bound* parameter implement partial distance
+ * elimination: they may stop as soon as the partial sum exceeds
+ * *bound*. In such a case the returned value is larger than *bound*,
+ * but not necessarily the full distance. If the distance is less than
+ * or equal to *bound*, the full distance will always be returned.
+ * This makes it possible to reject a model early once the distance is
+ * known to exceed that of the best match found so far.
+ *
+ * The distance measures in this module use these functions
+ * automatically with `const float*`, `const double*` and `const int*`
+ * feature iterators.
+ */
+namespace PiiClassification
+{
+  /**
+   * Returns \(\sum (S_i - M_i)^2\). See PiiSquaredGeometricDistance.
+   */
+  PII_CLASSIFICATION_EXPORT double squaredGeometricDistance(const float* sample, const float* model,
+                                                            int length, double bound = INFINITY);
+  PII_CLASSIFICATION_EXPORT double squaredGeometricDistance(const double* sample, const double* model,
+                                                            int length, double bound = INFINITY);
+  PII_CLASSIFICATION_EXPORT double squaredGeometricDistance(const int* sample, const int* model,
+                                                            int length, double bound = INFINITY);
+
+  /**
+   * Returns \(\sum |S_i - M_i|\). See PiiAbsDiffDistance.
+   */
+  PII_CLASSIFICATION_EXPORT double absDiffDistance(const float* sample, const float* model,
+                                                   int length, double bound = INFINITY);
+  PII_CLASSIFICATION_EXPORT double absDiffDistance(const double* sample, const double* model,
+                                                   int length, double bound = INFINITY);
+  PII_CLASSIFICATION_EXPORT double absDiffDistance(const int* sample, const int* model,
+                                                   int length, double bound = INFINITY);
+
+  /**
+   * Returns \(\sum (S_i - M_i)^2 / (S_i + M_i)\). See
+   * PiiChiSquaredDistance. Feature values must be non-negative for
+   * *bound* to be meaningful.
+   */
+  PII_CLASSIFICATION_EXPORT double chiSquaredDistance(const float* sample, const float* model,
+                                                      int length, double bound = INFINITY);
+  PII_CLASSIFICATION_EXPORT double chiSquaredDistance(const double* sample, const double* model,
+                                                      int length, double bound = INFINITY);
+  PII_CLASSIFICATION_EXPORT double chiSquaredDistance(const int* sample, const int* model,
+                                                      int length, double bound = INFINITY);
+
+  /**
+   * Returns \(-\sum \min(S_i,M_i)\). See PiiHistogramIntersection.
+   * The partial sum decreases as more features are added, and there
+   * is therefore no *bound* parameter.
+   */
+  PII_CLASSIFICATION_EXPORT double histogramIntersection(const float* sample, const float* model, int length);
+  PII_CLASSIFICATION_EXPORT double histogramIntersection(const double* sample, const double* model, int length);
+  PII_CLASSIFICATION_EXPORT double histogramIntersection(const int* sample, const int* model, int length);
+
+  /**
+   * Returns the number of different bits in *sample* and *model*. See
+   * PiiHammingDistance. The bits are counted with the AVX-512
+   * VPOPCNTDQ or POPCNT instructions if the processor supports them.
+   * The `unsigned int` version is meant for packed binary
+   * descriptors.
+   */
+  PII_CLASSIFICATION_EXPORT double hammingDistance(const int* sample, const int* model,
+                                                   int length, double bound = INFINITY);
+  PII_CLASSIFICATION_EXPORT double hammingDistance(const unsigned int* sample, const unsigned int* model,
+                                                   int length, double bound = INFINITY);
+}
+
+/// @internal
+#define PII_VECTORIZED_DISTANCE_MEASURE(MEASURE, FUNCTION, TYPE) \
+template <> inline double MEASURE<const TYPE*>::operator() (const TYPE* sample, \
+                                                            const TYPE* model, \
+                                                            int length) const throw() \
+{ \
+  return PiiClassification::FUNCTION(sample, model, length); \
+}
+
+/// @internal
+#define PII_VECTORIZED_BOUNDED_DISTANCE_MEASURE(MEASURE, FUNCTION, TYPE) \
+PII_VECTORIZED_DISTANCE_MEASURE(MEASURE, FUNCTION, TYPE) \
+namespace PiiClassification { template <> struct BoundedDistance<MEASURE<const TYPE*> > \
+{ \
+  static double measure(const MEASURE<const TYPE*>&, const TYPE* sample, const TYPE* model, \
+                        int length, double bound) \
+  { \
+    return FUNCTION(sample, model, length, bound); \
+  } \
+}; }
+
+/// @internal
+#define PII_VECTORIZED_DISTANCE_MEASURES(MEASURE, FUNCTION) \
+  PII_VECTORIZED_DISTANCE_MEASURE(MEASURE, FUNCTION, float) \
+  PII_VECTORIZED_DISTANCE_MEASURE(MEASURE, FUNCTION, double) \
+  PII_VECTORIZED_DISTANCE_MEASURE(MEASURE, FUNCTION, int)
+
+/// @internal
+#define PII_VECTORIZED_BOUNDED_DISTANCE_MEASURES(MEASURE, FUNCTION) \
+  PII_VECTORIZED_BOUNDED_DISTANCE_MEASURE(MEASURE, FUNCTION, float) \
+  PII_VECTORIZED_BOUNDED_DISTANCE_MEASURE(MEASURE, FUNCTION, double) \
+  PII_VECTORIZED_BOUNDED_DISTANCE_MEASURE(MEASURE, FUNCTION, int)
+
+#endif //_PIIDISTANCEKERNELS_H
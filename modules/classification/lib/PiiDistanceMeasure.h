@@ -71,6 +71,46 @@ public:
                              FeatureIterator model,
                              int length) const throw() = 0;
 
+  /**
+   * Measure the distance between two vectors, but stop as soon as
+   * the distance is known to exceed *bound*. This is known as partial
+   * distance elimination. If the distance is larger than *bound*, the
+   * returned value will be larger than *bound*, but not necessarily
+   * equal to the full distance. Otherwise, the full distance will be
+   * returned.
+   *
+   * The default implementation ignores *bound* and returns the full
+   * distance. Distance measures whose partial sums never decrease may
+   * exit early. See [PiiClassification::BoundedDistance].
+   */
+  virtual double operator() (FeatureIterator sample,
+                             FeatureIterator model,
+                             int length,
+                             double bound) const throw();
+
+  /**
+   * Measure the distance from *sample* to *count* models at once and
+   * store the results to *distances*. Calling this function once for
+   * many models avoids a virtual function call per model. The default
+   * implementation calls the two-vector version for each model. See
+   * [PiiClassification::BatchDistance].
+   *
+   * @param sample a sample feature vector
+   *
+   * @param models an array of *count* model feature vectors
+   *
+   * @param count the number of models
+   *
+   * @param length the number of features (dimensions) to consider
+   *
+   * @param distances an array of at least *count* elements that will
+   * receive the distances
+   */
+  virtual void operator() (FeatureIterator sample,
+                           const FeatureIterator* models,
+                           int count,
+                           int length,
+                           double* distances) const throw();
 
   virtual PiiDistanceMeasure* clone() const = 0;
 
@@ -92,6 +132,126 @@ template <class FeatureIterator> PiiDistanceMeasure<FeatureIterator>::~PiiDistan
 {
 }
 
+template <class FeatureIterator> double PiiDistanceMeasure<FeatureIterator>::operator() (FeatureIterator sample,
+                                                                                         FeatureIterator model,
+                                                                                         int length,
+                                                                                         double) const throw()
+{
+  return operator() (sample, model, length);
+}
+
+template <class FeatureIterator> void PiiDistanceMeasure<FeatureIterator>::operator() (FeatureIterator sample,
+                                                                                       const FeatureIterator* models,
+                                                                                       int count,
+                                                                                       int length,
+                                                                                       double* distances) const throw()
+{
+  for (int i=0; i<count; ++i)
+    distances[i] = operator() (sample, models[i], length);
+}
+
+namespace PiiClassification
+{
+  /**
+   * A traits structure that calculates a distance with partial
+   * distance elimination. The default implementation ignores *bound*
+   * and calls `measure(sample, model, length)`. Distance measures
+   * that are able to exit early specialize this structure. The
+   * specialization for PiiDistanceMeasure calls the virtual bounded
+   * distance function.
+   *
+   * ~~~(c++)
+   * double dDistance = PiiClassification::BoundedDistance<Measure>::measure(measure, sample, model,
+   *                                                                         length, dBestDistance);
+   * if (dDistance < dBestDistance)
+   *   dBestDistance = dDistance;
+   * ~~~
+   */
+  template <class Measure> struct BoundedDistance
+  {
+    template <class FeatureIterator>
+    static double measure(const Measure& measure, FeatureIterator sample, FeatureIterator model,
+                          int length, double)
+    {
+      return measure(sample, model, length);
+    }
+  };
+
+  /// @hide
+  template <class FeatureIterator> struct BoundedDistance<PiiDistanceMeasure<FeatureIterator> >
+  {
+    static double measure(const PiiDistanceMeasure<FeatureIterator>& measure,
+                          FeatureIterator sample, FeatureIterator model,
+                          int length, double bound)
+    {
+      return measure(sample, model, length, bound);
+    }
+  };
+  /// @endhide
+
+  /**
+   * Returns `BoundedDistance<Measure>::measure(measure, sample, model,
+   * length, bound)`.
+   */
+  template <class Measure, class FeatureIterator>
+  inline double boundedDistance(const Measure& measure, FeatureIterator sample, FeatureIterator model,
+                                int length, double bound)
+  {
+    return BoundedDistance<Measure>::measure(measure, sample, model, length, bound);
+  }
+
+  /**
+   * A traits structure that calculates the distances from a sample to
+   * many models at once. The default implementation calls
+   * `measure(sample, models[i], length)` for each model. Since the
+   * type of *measure* is known, the calls can be inlined. The
+   * specialization for PiiDistanceMeasure calls the virtual batch
+   * function, which makes only one virtual call for all models.
+   *
+   * ~~~(c++)
+   * QVector<ConstFeatureIterator> vecModels;
+   * for (int i=0; i<iModels; ++i)
+   *   vecModels << PiiSampleSet::sampleAt(models, i);
+   * QVector<double> vecDistances(iModels);
+   * PiiClassification::batchDistance(measure, sample, vecModels.constData(),
+   *                                  iModels, iFeatures, vecDistances.data());
+   * ~~~
+   */
+  template <class Measure> struct BatchDistance
+  {
+    template <class FeatureIterator>
+    static void measure(const Measure& measure, FeatureIterator sample, const FeatureIterator* models,
+                        int count, int length, double* distances)
+    {
+      for (int i=0; i<count; ++i)
+        distances[i] = measure(sample, models[i], length);
+    }
+  };
+
+  /// @hide
+  template <class FeatureIterator> struct BatchDistance<PiiDistanceMeasure<FeatureIterator> >
+  {
+    static void measure(const PiiDistanceMeasure<FeatureIterator>& measure,
+                        FeatureIterator sample, const FeatureIterator* models,
+                        int count, int length, double* distances)
+    {
+      measure(sample, models, count, length, distances);
+    }
+  };
+  /// @endhide
+
+  /**
+   * Calls `BatchDistance<Measure>::measure(measure, sample, models,
+   * count, length, distances)`.
+   */
+  template <class Measure, class FeatureIterator>
+  inline void batchDistance(const Measure& measure, FeatureIterator sample, const FeatureIterator* models,
+                            int count, int length, double* distances)
+  {
+    BatchDistance<Measure>::measure(measure, sample, models, count, length, distances);
+  }
+}
+
 /**
  * A template that implements the PiiDistanceMeasure interface by
  * using `Measure` as the distance measure implementation. The
@@ -112,6 +272,23 @@ public:
     return Measure::operator() (sample, model, length);
   }
 
+  double operator() (FeatureIterator sample,
+                     FeatureIterator model,
+                     int length,
+                     double bound) const throw()
+  {
+    return PiiClassification::BoundedDistance<Measure>::measure(*this, sample, model, length, bound);
+  }
+
+  void operator() (FeatureIterator sample,
+                   const FeatureIterator* models,
+                   int count,
+                   int length,
+                   double* distances) const throw()
+  {
+    PiiClassification::BatchDistance<Measure>::measure(*this, sample, models, count, length, distances);
+  }
+
   Impl* clone() const
   {
     return new Impl;
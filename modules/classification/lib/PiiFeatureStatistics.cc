@@ -0,0 +1,232 @@
+/* This file is part of Into.
+ * Copyright (C) Intopii 2013.
+ * All rights reserved.
+ *
+ * Licensees holding a commercial Into license may use this file in
+ * accordance with the commercial license agreement. Please see
+ * LICENSE.commercial for commercial licensing terms.
+ *
+ * Alternatively, this file may be used under the terms of the GNU
+ * Affero General Public License version 3 as published by the Free
+ * Software Foundation. In addition, Intopii gives you special rights
+ * to use Into as a part of open source software projects. Please
+ * refer to LICENSE.AGPL3 for details.
+ */
+
+#include "PiiFeatureStatistics.h"
+
+#include <PiiInvalidArgumentException.h>
+#include <PiiMath.h>
+#include <PiiCpu.h>
+
+#include <QCoreApplication>
+
+#include <cstring>
+
+PiiFeatureStatistics::PiiFeatureStatistics() :
+  _lCount(0)
+{}
+
+void PiiFeatureStatistics::clear()
+{
+  _lCount = 0;
+  _matStats = PiiMatrix<double>();
+}
+
+void PiiFeatureStatistics::checkLength(int length)
+{
+  if (_lCount != 0)
+    {
+      if (length != _matStats.columns())
+        PII_THROW(PiiInvalidArgumentException,
+                  QCoreApplication::translate("PiiFeatureStatistics",
+                                              "Expected %1 features, got %2.")
+                  .arg(_matStats.columns()).arg(length));
+    }
+  else if (length != _matStats.columns())
+    {
+      _matStats = PiiMatrix<double>(RowCount, length);
+      Pii::fillN(_matStats[MinRow], length, INFINITY);
+      Pii::fillN(_matStats[MaxRow], length, -INFINITY);
+    }
+}
+
+void PiiFeatureStatistics::merge(const PiiFeatureStatistics& other)
+{
+  if (other._lCount == 0)
+    return;
+  if (_lCount == 0)
+    {
+      *this = other;
+      return;
+    }
+  checkLength(other.featureCount());
+
+  const qint64 lCount = _lCount + other._lCount;
+  // Chan et al.: the combined M2 gets an additional term from the
+  // difference of the partial means.
+  const double dOtherWeight = double(other._lCount) / double(lCount),
+    dCrossWeight = double(_lCount) * dOtherWeight;
+  const int iFeatures = featureCount();
+  double* pMean = _matStats[MeanRow], *pM2 = _matStats[M2Row],
+    *pMin = _matStats[MinRow], *pMax = _matStats[MaxRow];
+  const double* pOtherMean = other._matStats[MeanRow], *pOtherM2 = other._matStats[M2Row],
+    *pOtherMin = other._matStats[MinRow], *pOtherMax = other._matStats[MaxRow];
+  for (int i=0; i<iFeatures; ++i)
+    {
+      const double dDelta = pOtherMean[i] - pMean[i];
+      pMean[i] += dDelta * dOtherWeight;
+      pM2[i] += pOtherM2[i] + dDelta * dDelta * dCrossWeight;
+      pMin[i] = qMin(pMin[i], pOtherMin[i]);
+      pMax[i] = qMax(pMax[i], pOtherMax[i]);
+    }
+  _lCount = lCount;
+}
+
+PiiMatrix<double> PiiFeatureStatistics::statistic(int index) const
+{
+  const int iFeatures = featureCount();
+  if (iFeatures == 0)
+    return PiiMatrix<double>();
+  PiiMatrix<double> matResult(PiiMatrix<double>::uninitialized(1, iFeatures));
+  std::memcpy(matResult[0], _matStats[index], sizeof(double) * iFeatures);
+  return matResult;
+}
+
+PiiMatrix<double> PiiFeatureStatistics::mean() const { return statistic(MeanRow); }
+PiiMatrix<double> PiiFeatureStatistics::min() const { return statistic(MinRow); }
+PiiMatrix<double> PiiFeatureStatistics::max() const { return statistic(MaxRow); }
+
+PiiMatrix<double> PiiFeatureStatistics::variance() const
+{
+  PiiMatrix<double> matResult(statistic(M2Row));
+  if (_lCount > 1)
+    matResult /= double(_lCount);
+  return matResult;
+}
+
+namespace
+{
+  template <class T> inline void scalarMultiplyAdd(const T* source, const T* scale,
+                                                   const T* offset, T* target, int length)
+  {
+    for (int i=0; i<length; ++i)
+      target[i] = source[i] * scale[i] + offset[i];
+  }
+
+#ifdef PII_X86_SIMD
+  PII_CPU_TARGET("sse2")
+  void sse2MultiplyAdd(const float* source, const float* scale, const float* offset, float* target, int length)
+  {
+    int i = 0;
+    for (; i+4 <= length; i += 4)
+      _mm_storeu_ps(target + i, _mm_add_ps(_mm_mul_ps(_mm_loadu_ps(source + i), _mm_loadu_ps(scale + i)),
+                                           _mm_loadu_ps(offset + i)));
+    scalarMultiplyAdd(source + i, scale + i, offset + i, target + i, length - i);
+  }
+
+  PII_CPU_TARGET("sse2")
+  void sse2MultiplyAdd(const double* source, const double* scale, const double* offset, double* target, int length)
+  {
+    int i = 0;
+    for (; i+2 <= length; i += 2)
+      _mm_storeu_pd(target + i, _mm_add_pd(_mm_mul_pd(_mm_loadu_pd(source + i), _mm_loadu_pd(scale + i)),
+                                           _mm_loadu_pd(offset + i)));
+    scalarMultiplyAdd(source + i, scale + i, offset + i, target + i, length - i);
+  }
+
+  PII_CPU_TARGET("avx")
+  void avxMultiplyAdd(const float* source, const float* scale, const float* offset, float* target, int length)
+  {
+    int i = 0;
+    for (; i+8 <= length; i += 8)
+      _mm256_storeu_ps(target + i, _mm256_add_ps(_mm256_mul_ps(_mm256_loadu_ps(source + i),
+                                                               _mm256_loadu_ps(scale + i)),
+                                                 _mm256_loadu_ps(offset + i)));
+    sse2MultiplyAdd(source + i, scale + i, offset + i, target + i, length - i);
+  }
+
+  PII_CPU_TARGET("avx")
+  void avxMultiplyAdd(const double* source, const double* scale, const double* offset, double* target, int length)
+  {
+    int i = 0;
+    for (; i+4 <= length; i += 4)
+      _mm256_storeu_pd(target + i, _mm256_add_pd(_mm256_mul_pd(_mm256_loadu_pd(source + i),
+                                                               _mm256_loadu_pd(scale + i)),
+                                                 _mm256_loadu_pd(offset + i)));
+    sse2MultiplyAdd(source + i, scale + i, offset + i, target + i, length - i);
+  }
+
+  PII_CPU_TARGET("avx,fma")
+  void fmaMultiplyAdd(const float* source, const float* scale, const float* offset, float* target, int length)
+  {
+    int i = 0;
+    for (; i+8 <= length; i += 8)
+      _mm256_storeu_ps(target + i, _mm256_fmadd_ps(_mm256_loadu_ps(source + i),
+                                                   _mm256_loadu_ps(scale + i),
+                                                   _mm256_loadu_ps(offset + i)));
+    sse2MultiplyAdd(source + i, scale + i, offset + i, target + i, length - i);
+  }
+
+  PII_CPU_TARGET("avx,fma")
+  void fmaMultiplyAdd(const double* source, const double* scale, const double* offset, double* target, int length)
+  {
+    int i = 0;
+    for (; i+4 <= length; i += 4)
+      _mm256_storeu_pd(target + i, _mm256_fmadd_pd(_mm256_loadu_pd(source + i),
+                                                   _mm256_loadu_pd(scale + i),
+                                                   _mm256_loadu_pd(offset + i)));
+    sse2MultiplyAdd(source + i, scale + i, offset + i, target + i, length - i);
+  }
+#endif
+
+#ifdef PII_NEON64_SIMD
+  void neonMultiplyAdd(const float* source, const float* scale, const float* offset, float* target, int length)
+  {
+    int i = 0;
+    for (; i+4 <= length; i += 4)
+      vst1q_f32(target + i, vfmaq_f32(vld1q_f32(offset + i), vld1q_f32(source + i), vld1q_f32(scale + i)));
+    scalarMultiplyAdd(source + i, scale + i, offset + i, target + i, length - i);
+  }
+
+  void neonMultiplyAdd(const double* source, const double* scale, const double* offset, double* target, int length)
+  {
+    int i = 0;
+    for (; i+2 <= length; i += 2)
+      vst1q_f64(target + i, vfmaq_f64(vld1q_f64(offset + i), vld1q_f64(source + i), vld1q_f64(scale + i)));
+    scalarMultiplyAdd(source + i, scale + i, offset + i, target + i, length - i);
+  }
+#endif
+
+  template <class T> void multiplyAddTemplate(const T* source, const T* scale,
+                                              const T* offset, T* target, int length)
+  {
+    typedef void (*MultiplyAddFunction)(const T*, const T*, const T*, T*, int);
+    static const PiiCpuDispatcher<MultiplyAddFunction> kernels =
+      PiiCpuDispatcher<MultiplyAddFunction>(scalarMultiplyAdd<T>)
+#if defined(PII_X86_SIMD)
+      .add(Pii::Sse2CpuFeature, sse2MultiplyAdd)
+      .add(Pii::AvxCpuFeature, avxMultiplyAdd)
+      .add(Pii::AvxCpuFeature | Pii::FmaCpuFeature, fmaMultiplyAdd)
+#elif defined(PII_NEON64_SIMD)
+      .add(Pii::NeonCpuFeature, neonMultiplyAdd)
+#endif
+      ;
+    kernels.function()(source, scale, offset, target, length);
+  }
+}
+
+namespace PiiClassification
+{
+  void multiplyAdd(const float* source, const float* scale,
+                   const float* offset, float* target, int length)
+  {
+    multiplyAddTemplate(source, scale, offset, target, length);
+  }
+
+  void multiplyAdd(const double* source, const double* scale,
+                   const double* offset, double* target, int length)
+  {
+    multiplyAddTemplate(source, scale, offset, target, length);
+  }
+}
@@ -0,0 +1,209 @@
+/* This file is part of Into.
+ * Copyright (C) Intopii 2013.
+ * All rights reserved.
+ *
+ * Licensees holding a commercial Into license may use this file in
+ * accordance with the commercial license agreement. Please see
+ * LICENSE.commercial for commercial licensing terms.
+ *
+ * Alternatively, this file may be used under the terms of the GNU
+ * Affero General Public License version 3 as published by the Free
+ * Software Foundation. In addition, Intopii gives you special rights
+ * to use Into as a part of open source software projects. Please
+ * refer to LICENSE.AGPL3 for details.
+ */
+
+#ifndef _PIIFEATURESTATISTICS_H
+#define _PIIFEATURESTATISTICS_H
+
+#include "PiiClassificationGlobal.h"
+#include <PiiMatrix.h>
+
+/**
+ * Running per-feature statistics (mean, variance, minimum and
+ * maximum) of a stream of feature vectors. The statistics are
+ * updated one sample or one batch at a time with Welford's
+ * algorithm, and no samples are stored. Two accumulators can be
+ * combined with [merge()], which makes it possible to collect
+ * statistics in many threads and combine them afterwards.
+ *
+ * ~~~(c++)
+ * PiiFeatureStatistics stats;
+ * stats.addSamples(PiiMatrix<float>(2, 2,
+ *                                   1.0, 10.0,
+ *                                   3.0, 30.0));
+ * PiiFeatureStatistics other;
+ * int aSample[] = { 5, 50 };
+ * other.addSample(aSample, 2);
+ * stats.merge(other);
+ * // stats.mean() == (3, 30), stats.max() == (5, 50)
+ * ~~~
+ *
+ * The accumulated values are stored in `double` precision. The class
+ * is implicitly shared.
+ */
+class PII_CLASSIFICATION_EXPORT PiiFeatureStatistics
+{
+public:
+  /**
+   * Creates an empty accumulator. The number of features is fixed by
+   * the first added sample.
+   */
+  PiiFeatureStatistics();
+
+  /**
+   * Removes all accumulated statistics. The next sample will again
+   * fix the number of features.
+   */
+  void clear();
+
+  /**
+   * Returns the number of features, or zero if no samples have been
+   * added.
+   */
+  int featureCount() const { return _matStats.columns(); }
+  /**
+   * Returns the number of samples seen so far.
+   */
+  qint64 sampleCount() const { return _lCount; }
+  /**
+   * Returns `true` if no samples have been added.
+   */
+  bool isEmpty() const { return _lCount == 0; }
+
+  /**
+   * Adds a single sample to the statistics. If the accumulator is
+   * not empty, *length* must equal [featureCount()].
+   *
+   * @exception PiiInvalidArgumentException& if *length* does not
+   * match the number of features.
+   */
+  template <class T> void addSample(const T* features, int length);
+
+  /**
+   * Adds each row of *samples* to the statistics. The batch is first
+   * summarized separately and then merged, which is both faster and
+   * numerically more stable than adding the rows one by one.
+   *
+   * @exception PiiInvalidArgumentException& if the number of columns
+   * does not match the number of features.
+   */
+  template <class T> void addSamples(const PiiMatrix<T>& samples);
+
+  /**
+   * Combines the statistics collected by *other* to this object. The
+   * result is the same (up to rounding) as if all samples added to
+   * *other* had been added to this object.
+   *
+   * @exception PiiInvalidArgumentException& if the number of
+   * features differs.
+   */
+  void merge(const PiiFeatureStatistics& other);
+
+  /**
+   * Returns the mean of each feature as a 1-by-[featureCount()]
+   * matrix.
+   */
+  PiiMatrix<double> mean() const;
+  /**
+   * Returns the population variance of each feature.
+   */
+  PiiMatrix<double> variance() const;
+  /**
+   * Returns the smallest value of each feature.
+   */
+  PiiMatrix<double> min() const;
+  /**
+   * Returns the largest value of each feature.
+   */
+  PiiMatrix<double> max() const;
+
+private:
+  enum { MeanRow, M2Row, MinRow, MaxRow, RowCount };
+
+  void checkLength(int length);
+  PiiMatrix<double> statistic(int index) const;
+
+  qint64 _lCount;
+  // One row for each statistic, one column for each feature.
+  PiiMatrix<double> _matStats;
+};
+
+namespace PiiClassification
+{
+  /**
+   * Calculates `target[i] = source[i] * scale[i] + offset[i]` over
+   * *length* elements. The operation is vectorized with SSE2/AVX on
+   * x86 and NEON on 64-bit ARM, selected at run time. If the
+   * processor supports fused multiply-add instructions, the product
+   * is not rounded before the addition, which may change the last
+   * bit of the result compared to portable code. *source* and
+   * *target* may be the same.
+   */
+  PII_CLASSIFICATION_EXPORT void multiplyAdd(const float* source, const float* scale,
+                                             const float* offset, float* target, int length);
+  PII_CLASSIFICATION_EXPORT void multiplyAdd(const double* source, const double* scale,
+                                             const double* offset, double* target, int length);
+}
+
+template <class T> void PiiFeatureStatistics::addSample(const T* features, int length)
+{
+  checkLength(length);
+  ++_lCount;
+  const double dInvCount = 1.0 / double(_lCount);
+  double* pMean = _matStats[MeanRow], *pM2 = _matStats[M2Row],
+    *pMin = _matStats[MinRow], *pMax = _matStats[MaxRow];
+  for (int i=0; i<length; ++i)
+    {
+      const double dValue = double(features[i]), dDelta = dValue - pMean[i];
+      pMean[i] += dDelta * dInvCount;
+      pM2[i] += dDelta * (dValue - pMean[i]);
+      if (dValue < pMin[i]) pMin[i] = dValue;
+      if (dValue > pMax[i]) pMax[i] = dValue;
+    }
+}
+
+template <class T> void PiiFeatureStatistics::addSamples(const PiiMatrix<T>& samples)
+{
+  const int iRows = samples.rows(), iColumns = samples.columns();
+  if (iRows == 0)
+    return;
+  if (iRows == 1)
+    {
+      addSample(samples[0], iColumns);
+      return;
+    }
+
+  // Summarize the batch with two passes and merge the result.
+  PiiFeatureStatistics batch;
+  batch.checkLength(iColumns);
+  batch._lCount = iRows;
+  double* pMean = batch._matStats[MeanRow], *pM2 = batch._matStats[M2Row],
+    *pMin = batch._matStats[MinRow], *pMax = batch._matStats[MaxRow];
+  for (int r=0; r<iRows; ++r)
+    {
+      const T* pRow = samples[r];
+      for (int c=0; c<iColumns; ++c)
+        {
+          const double dValue = double(pRow[c]);
+          pMean[c] += dValue;
+          if (dValue < pMin[c]) pMin[c] = dValue;
+          if (dValue > pMax[c]) pMax[c] = dValue;
+        }
+    }
+  const double dInvCount = 1.0 / double(iRows);
+  for (int c=0; c<iColumns; ++c)
+    pMean[c] *= dInvCount;
+  for (int r=0; r<iRows; ++r)
+    {
+      const T* pRow = samples[r];
+      for (int c=0; c<iColumns; ++c)
+        {
+          const double dDelta = double(pRow[c]) - pMean[c];
+          pM2[c] += dDelta * dDelta;
+        }
+    }
+  merge(batch);
+}
+
+#endif //_PIIFEATURESTATISTICS_H
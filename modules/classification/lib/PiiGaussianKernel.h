@@ -16,12 +16,18 @@
 #ifndef _PIIGAUSSIANKERNEL_H
 #define _PIIGAUSSIANKERNEL_H
 
+#include "PiiSquaredGeometricDistance.h"
+
 /**
  * Gaussian kernel function. The Gaussian kernel is defined as
  * \(k(x,y) = e^-\fraq{||x-y||^2}{2\sigma^2}\), where *x* and *y*
  * are vectors of any dimensionality. It is also known as the radial
  * basis function (RBF) kernel.
  *
+ * The squared distance is calculated with
+ * PiiSquaredGeometricDistance, which is vectorized for `float`,
+ * `double` and `int` features.
+ *
  */
 template <class FeatureIterator> class PiiGaussianKernel
 {
@@ -51,7 +57,7 @@ public:
 
   inline double operator() (FeatureIterator sample, FeatureIterator model, int length) const throw()
   {
-    return Pii::exp(-Pii::squaredDistanceN(sample, length, model, 0.0) * _dNormalizer);
+    return Pii::exp(-PiiSquaredGeometricDistance<FeatureIterator>()(sample, model, length) * _dNormalizer);
   }
 private:
   double _dSigma, _dNormalizer;
@@ -17,6 +17,7 @@
 #define _PIIHAMMINGDISTANCE_H
 
 #include "PiiDistanceMeasure.h"
+#include "PiiDistanceKernels.h"
 #include <PiiBits.h>
 
 /**
@@ -30,8 +31,11 @@ PII_DEFAULT_DISTANCE_MEASURE_DEF(PiiHammingDistance)
   double distance = 0;
   for (int i=0; i<length; ++i)
     distance += Pii::hammingDistance(sample[i], model[i],
-                                     sizeof(typename std::iterator_traits<FeatureIterator>::value_type));
+                                     sizeof(typename std::iterator_traits<FeatureIterator>::value_type) * 8);
   return distance;
 }
 
+PII_VECTORIZED_BOUNDED_DISTANCE_MEASURE(PiiHammingDistance, hammingDistance, int)
+PII_VECTORIZED_BOUNDED_DISTANCE_MEASURE(PiiHammingDistance, hammingDistance, unsigned int)
+
 #endif //_PIIHAMMINGDISTANCE_H
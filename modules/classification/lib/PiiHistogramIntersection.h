@@ -17,6 +17,7 @@
 #define _PIIHISTOGRAMINTERSECTION_H
 
 #include "PiiDistanceMeasure.h"
+#include "PiiDistanceKernels.h"
 
 /**
  * Histogram intersection. Measures difference between two
@@ -41,4 +42,6 @@ PII_DEFAULT_DISTANCE_MEASURE_DEF(PiiHistogramIntersection)
   return -diffSum;
 }
 
+PII_VECTORIZED_DISTANCE_MEASURES(PiiHistogramIntersection, histogramIntersection)
+
 #endif //_PIIHISTOGRAMINTERSECTION_H
@@ -53,6 +53,14 @@ PiiKdTree<SampleSet>& PiiKdTree<SampleSet>::operator= (const PiiKdTree& other)
 template <class SampleSet>
 void PiiKdTree<SampleSet>::buildTree(const SampleSet& modelSet,
                                      PiiProgressController* controller)
+{
+  buildTree(modelSet, 1, controller);
+}
+
+template <class SampleSet>
+void PiiKdTree<SampleSet>::buildTree(const SampleSet& modelSet,
+                                     int treeCount,
+                                     PiiProgressController* controller)
 {
   d->release();
   d = new Data;
@@ -71,13 +79,16 @@ void PiiKdTree<SampleSet>::buildTree(const SampleSet& modelSet,
 
   d->modelSet = modelSet;
   // May throw a PiiClassificationException
-  d->pRoot = createNode(vecSorters.data(), iSampleCount, 0, controller);
+  d->pRoot = createNode(vecSorters.data(), iSampleCount, 0, false, controller);
+  for (int i=1; i<treeCount; ++i)
+    d->lstForest << createNode(vecSorters.data(), iSampleCount, 0, true, controller);
 }
 
 template <class SampleSet>
 int PiiKdTree<SampleSet>::selectDimension(FeatureSorter* sorterArray,
                                           int sampleCount,
-                                          int /*depth*/)
+                                          int /*depth*/,
+                                          bool randomize)
 {
   Pii::fillN(d->pMeans, d->iFeatureCount, 0.0);
   Pii::fillN(d->pVars, d->iFeatureCount, 0.0);
@@ -95,6 +106,26 @@ int PiiKdTree<SampleSet>::selectDimension(FeatureSorter* sorterArray,
     }
   Pii::mapN(d->pVars, d->iFeatureCount, std::bind2nd(std::multiplies<double>(), 1.0/sampleCount));
 
+  if (randomize)
+    {
+      // Select randomly among the dimensions with the largest
+      // variances. aCandidates is kept in descending order.
+      int aCandidates[RandomSplitCandidates];
+      int iCandidates = 0;
+      for (int j=0; j<d->iFeatureCount; ++j)
+        {
+          int i = qMin(iCandidates, int(RandomSplitCandidates) - 1);
+          if (i < iCandidates && d->pVars[aCandidates[i]] >= d->pVars[j])
+            continue;
+          for (; i > 0 && d->pVars[aCandidates[i-1]] < d->pVars[j]; --i)
+            aCandidates[i] = aCandidates[i-1];
+          aCandidates[i] = j;
+          if (iCandidates < RandomSplitCandidates)
+            ++iCandidates;
+        }
+      return aCandidates[qMin(int(Pii::uniformRandom() * iCandidates), iCandidates - 1)];
+    }
+
   // Return the index of the dimension with max variance.
   return Pii::findSpecialValue(d->pVars, d->pVars + d->iFeatureCount,
                                std::greater<T>(),
@@ -105,6 +136,7 @@ template <class SampleSet>
 typename PiiKdTree<SampleSet>::Node* PiiKdTree<SampleSet>::createNode(FeatureSorter* sorterArray,
                                                                       int sampleCount,
                                                                       int depth,
+                                                                      bool randomize,
                                                                       PiiProgressController* controller)
 {
   if (sampleCount == 0)
@@ -113,7 +145,7 @@ typename PiiKdTree<SampleSet>::Node* PiiKdTree<SampleSet>::createNode(FeatureSor
     return new Node(sorterArray[0].second);
 
   // Select the dimension that best splits the remaining samples.
-  int iSplitDimension = selectDimension(sorterArray, sampleCount, depth);
+  int iSplitDimension = selectDimension(sorterArray, sampleCount, depth, randomize);
 
   // Collect the features on the selected dimension.
   for (int i=0; i<sampleCount; ++i)
@@ -127,8 +159,8 @@ typename PiiKdTree<SampleSet>::Node* PiiKdTree<SampleSet>::createNode(FeatureSor
   ++depth;
 
   // Exception safety
-  PiiSmartPtr<Node> smaller(createNode(sorterArray, iHalf, depth, controller));
-  PiiSmartPtr<Node> larger(createNode(sorterArray + iHalf + 1, sampleCount - iHalf - 1, depth, controller));
+  PiiSmartPtr<Node> smaller(createNode(sorterArray, iHalf, depth, randomize, controller));
+  PiiSmartPtr<Node> larger(createNode(sorterArray + iHalf + 1, sampleCount - iHalf - 1, depth, randomize, controller));
 
   PII_TRY_CONTINUE(controller, NAN);
 
@@ -247,79 +279,69 @@ void PiiKdTree<SampleSet>::findClosestMatches(Sample sample,
                                               int maxEvaluations,
                                               MatchList& matches) const
 {
-  Node* pNode = d->pRoot;
-
-  BranchList lstBranches;
-
-  for (;;)
+  /* Best-bin-first search. Branches not taken on the way down are
+     collected to a priority queue together with a lower bound of
+     their distance to the query. The search always continues from
+     the closest one.
+   */
+  BranchHeap heap(0, Pii::InverseHeap);
+  heap.append(BranchSorter(0.0, d->pRoot));
+  for (int i=0; i<d->lstForest.size(); ++i)
+    heap.append(BranchSorter(0.0, d->lstForest[i]));
+
+  // Each sample appears once in every tree. In a forest, samples
+  // that have already been checked must be skipped to avoid
+  // duplicate matches.
+  QSet<int> setVisited;
+  QSet<int>* pVisited = d->lstForest.isEmpty() ? 0 : &setVisited;
+
+  while (heap.size() > 0 && maxEvaluations > 0)
     {
-      // Search recursively to a leaf node. In backtracking,
-      // lstBranches will be filled with nodes that need to be
-      // evaluated to be sure about the NN.
-      findPossibleBranches(pNode, sample, &maxEvaluations, lstBranches, matches);
-      // No more choices found -> found the exact NN
-      // No more evaluations allowed -> don't know the NN for sure,
-      // but who cares?
-      if (lstBranches.isEmpty() || maxEvaluations <= 0)
+      BranchSorter branch = heap.take(0);
+      // No unexplored branch can contain a closer sample -> found
+      // the exact NN.
+      if (branch.first > distanceLimit(matches))
         break;
-      // Otherwise find the closest node and continue search from there.
-      typename BranchList::iterator i = Pii::findSpecialValue(lstBranches.begin(),
-                                                              lstBranches.end(),
-                                                              std::less<BranchSorter>(),
-                                                              Pii::Identity<BranchSorter>());
-      lstBranches.erase(i);
-      pNode = i->second;
+      findPossibleBranches(branch.second, branch.first, sample, &maxEvaluations, heap, matches, pVisited);
     }
 }
 
-
 template <class SampleSet> template <class MatchList>
 void PiiKdTree<SampleSet>::findPossibleBranches(Node* node,
+                                                double bound,
                                                 Sample sample,
-                                                int *maxEvaluations,
-                                                BranchList& branchList,
-                                                MatchList& matches) const
+                                                int* maxEvaluations,
+                                                BranchHeap& branches,
+                                                MatchList& matches,
+                                                QSet<int>* visited) const
 {
-  if (node == 0 || *maxEvaluations <= 0)
-    return;
-
-  /* This function is equivalent to the normal recursive tree look-up,
-     but instead of inspecting each possible branch when unwinding the
-     stack, all possible branches are collected into a priority queue
-     and inspected in the order of increasing distance from the query
-     sample.
-   */
-  --*maxEvaluations;
-
-  double dDistance = d->measure(sample, sampleAt(node->sampleIndex), d->iFeatureCount);
-
-  if (dDistance < distanceLimit(matches))
-    updateLimit(dDistance, node->sampleIndex, matches);
-  /* Prune branches that are no longer possible.
-     for (typename BranchList::iterator i=branchList.begin(); i != branchList.end(); )
-     {
-     T diff = sample[i->second->splitDimension] - i->second->featureValue;
-     double dSqDiff = Pii::square(diff);
-     if (Pii::square(diff) > distanceLimit(matches))
-     i = branchList.erase(i);
-     else
-     ++i;
-     }
-  */
-
-  T featureValue = sample[node->splitDimension];
-  if (featureValue <= node->featureValue)
-    {
-      findPossibleBranches(node->smaller, sample, maxEvaluations, branchList, matches);
-      // The NN could be on the other branch -> store to possible
-      // branches and let the caller to evaluate it if needed.
-      if (node->larger != 0 && Pii::square(node->featureValue - featureValue) <= distanceLimit(matches))
-        branchList.append(BranchSorter(dDistance, node->larger));
-    }
-  else
+  // Descend to a leaf node, always selecting the branch the sample
+  // falls into.
+  while (node != 0 && *maxEvaluations > 0)
     {
-      findPossibleBranches(node->larger, sample, maxEvaluations, branchList, matches);
-      if (node->smaller != 0 && Pii::square(node->featureValue - featureValue) <= distanceLimit(matches))
-        branchList.append(BranchSorter(dDistance, node->smaller));
+      if (visited == 0 || !visited->contains(node->sampleIndex))
+        {
+          if (visited != 0)
+            visited->insert(node->sampleIndex);
+          --*maxEvaluations;
+          double dDistance = d->measure(sample, sampleAt(node->sampleIndex), d->iFeatureCount);
+          if (dDistance < distanceLimit(matches))
+            updateLimit(dDistance, node->sampleIndex, matches);
+        }
+
+      const double dDiff = double(sample[node->splitDimension]) - double(node->featureValue);
+      Node *pNear = node->smaller, *pFar = node->larger;
+      if (dDiff > 0)
+        qSwap(pNear, pFar);
+      // Every sample on the other side of the hyperplane is at least
+      // dDiff away. If it is too far already, the branch can be
+      // discarded for good.
+      if (pFar != 0)
+        {
+          const double dFarBound = qMax(bound, dDiff * dDiff);
+          if (dFarBound <= distanceLimit(matches))
+            branches.append(BranchSorter(dFarBound, pFar));
+        }
+      node = pNear;
     }
 }
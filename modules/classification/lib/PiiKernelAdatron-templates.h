@@ -18,6 +18,7 @@
 #endif
 
 #include "PiiGaussianKernel.h"
+#include "PiiKernelCache.h"
 
 template <class SampleSet> PiiKernelAdatron<SampleSet>::Data::Data() :
   pKernel(new PII_POLYMORPHIC_KERNEL(PiiGaussianKernel)),
@@ -25,7 +26,8 @@ template <class SampleSet> PiiKernelAdatron<SampleSet>::Data::Data() :
   iMaxIterations(100),
   dTheta(0),
   dLearningRate(1),
-  dConvergenceThreshold(1e-2)
+  dConvergenceThreshold(1e-2),
+  iCacheSize(64 << 20)
 {
 }
 
@@ -48,10 +50,13 @@ void PiiKernelAdatron<SampleSet>::learn(const SampleSet& samples,
   const int iSamples = PiiSampleSet::sampleCount(samples),
     iFeatures = PiiSampleSet::featureCount(samples);
 
-  PiiMatrix<double> matKernel(PiiClassification::calculateDistanceMatrix(samples,
-                                                                         *d->pKernel,
-                                                                         true, true));
+  PiiKernelCache<SampleSet, PiiKernelFunction<ConstFeatureIterator> > cache(samples,
+                                                                             *d->pKernel,
+                                                                             d->iCacheSize);
   QVector<double> vecWeights(iSamples, 1.0);
+  // Whenever a weight changes, the change is added to the outputs
+  // of all samples. A kernel row is needed only if the weight of the
+  // sample changes.
   QVector<double> vecZ(iSamples);
 
   d->vecWeights.clear();
@@ -66,11 +71,17 @@ void PiiKernelAdatron<SampleSet>::learn(const SampleSet& samples,
       dMinZ = INFINITY, dMaxZ = -INFINITY;
       for (int i=0; i<iSamples; ++i)
         {
-          const double* pKernelRow = matKernel.constRowBegin(i);
-          double dSum = 0;
-          for (int j=0; j<iSamples; ++j, ++pKernelRow)
-            dSum += (labels[j] - 0.5) * *pKernelRow * vecWeights[j];
-          vecZ[i] = dSum;
+          const double* pKernelRow = 0;
+          // Calculate the outputs from scratch on the first round.
+          if (iIterations == 0)
+            {
+              pKernelRow = cache.row(i);
+              double dSum = 0;
+              for (int j=0; j<iSamples; ++j)
+                dSum += (labels[j] - 0.5) * pKernelRow[j] * vecWeights[j];
+              vecZ[i] = dSum;
+            }
+          const double dSum = vecZ[i];
           double dDelta;
           if (labels[i] == 1)
             {
@@ -84,7 +95,16 @@ void PiiKernelAdatron<SampleSet>::learn(const SampleSet& samples,
                 dMaxZ = dSum;
               dDelta = dLearningRate * (1 + dSum*2 - dTheta);
             }
-          vecWeights[i] = qMax(0.0, vecWeights[i] + dDelta);
+          const double dWeight = qMax(0.0, vecWeights[i] + dDelta),
+            dChange = (labels[i] - 0.5) * (dWeight - vecWeights[i]);
+          if (dChange != 0)
+            {
+              vecWeights[i] = dWeight;
+              if (pKernelRow == 0)
+                pKernelRow = cache.row(i);
+              for (int j=0; j<iSamples; ++j)
+                vecZ[j] += dChange * pKernelRow[j];
+            }
           PII_TRY_CONTINUE(this->controller(), NAN);
         }
       dTheta = dMaxZ + dMinZ;
@@ -127,14 +147,25 @@ double PiiKernelAdatron<SampleSet>::classify(ConstFeatureIterator featureVector)
   PII_D;
   if (!d->vecWeights.isEmpty())
     {
-      const int iSamples = PiiSampleSet::sampleCount(d->supportVectors),
-        iFeatures = PiiSampleSet::featureCount(d->supportVectors);
+      enum { BlockSize = 64 };
+      const SampleSet& supportVectors = d->supportVectors;
+      const int iSamples = PiiSampleSet::sampleCount(supportVectors),
+        iFeatures = PiiSampleSet::featureCount(supportVectors);
+      ConstFeatureIterator aModels[BlockSize];
+      double aValues[BlockSize];
       double dSum = 0;
-      for (int i=0; i<iSamples; ++i)
-        dSum += (d->vecLabels[i]-0.5) * d->vecWeights[i] *
-          (*d->pKernel)(PiiSampleSet::sampleAt(d->supportVectors, i),
-                        featureVector,
-                        iFeatures);
+      // Evaluate the kernel against a block of support vectors at a
+      // time.
+      for (int i=0; i<iSamples; i += BlockSize)
+        {
+          const int iCount = qMin(int(BlockSize), iSamples - i);
+          for (int j=0; j<iCount; ++j)
+            aModels[j] = PiiSampleSet::sampleAt(supportVectors, i+j);
+          PiiClassification::batchDistance(*d->pKernel, featureVector, aModels,
+                                           iCount, iFeatures, aValues);
+          for (int j=0; j<iCount; ++j)
+            dSum += (d->vecLabels[i+j]-0.5) * d->vecWeights[i+j] * aValues[j];
+        }
       return dSum > d->dTheta ? 1 : 0;
     }
   return NAN;
@@ -169,3 +200,5 @@ template <class SampleSet> void PiiKernelAdatron<SampleSet>::setConvergenceThres
 template <class SampleSet> double PiiKernelAdatron<SampleSet>::convergenceThreshold() const { return _d()->dConvergenceThreshold; }
 template <class SampleSet> SampleSet PiiKernelAdatron<SampleSet>::supportVectors() const { return _d()->supportVectors; }
 template <class SampleSet> void PiiKernelAdatron<SampleSet>::setSupportVectors(const SampleSet& supportVectors) { _d()->supportVectors = supportVectors; }
+template <class SampleSet> void PiiKernelAdatron<SampleSet>::setCacheSize(qint64 cacheSize) { _d()->iCacheSize = cacheSize; }
+template <class SampleSet> qint64 PiiKernelAdatron<SampleSet>::cacheSize() const { return _d()->iCacheSize; }
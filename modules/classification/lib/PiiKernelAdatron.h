@@ -177,6 +177,19 @@ public:
    */
   double convergenceThreshold() const;
 
+  /**
+   * Sets the maximum number of bytes used for caching kernel values
+   * during training. The full kernel matrix takes N² doubles, where N
+   * is the number of training samples. If it doesn't fit into the
+   * cache, rows of the matrix will be recalculated as needed. See
+   * PiiKernelCache. The default is 64 MB.
+   */
+  void setCacheSize(qint64 cacheSize);
+  /**
+   * Returns the size of the kernel cache in bytes.
+   */
+  qint64 cacheSize() const;
+
 private:
   class Data : public PiiLearningAlgorithm<SampleSet>::Data
   {
@@ -186,6 +199,7 @@ private:
     bool bConverged;
     int iMaxIterations;
     double dTheta, dLearningRate, dConvergenceThreshold;
+    qint64 iCacheSize;
     QVector<double> vecWeights, vecLabels;
     SampleSet supportVectors;
   };
@@ -0,0 +1,105 @@
+/* This file is part of Into.
+ * Copyright (C) Intopii 2013.
+ * All rights reserved.
+ *
+ * Licensees holding a commercial Into license may use this file in
+ * accordance with the commercial license agreement. Please see
+ * LICENSE.commercial for commercial licensing terms.
+ *
+ * Alternatively, this file may be used under the terms of the GNU
+ * Affero General Public License version 3 as published by the Free
+ * Software Foundation. In addition, Intopii gives you special rights
+ * to use Into as a part of open source software projects. Please
+ * refer to LICENSE.AGPL3 for details.
+ */
+
+#ifndef _PIIKERNELCACHE_H
+# error "Never use <PiiKernelCache-templates.h> directly; include <PiiKernelCache.h> instead."
+#endif
+
+template <class SampleSet, class Kernel>
+PiiKernelCache<SampleSet,Kernel>::PiiKernelCache(const SampleSet& samples,
+                                                 const Kernel& kernel,
+                                                 qint64 cacheSize) :
+  _kernel(kernel),
+  _iSamples(PiiSampleSet::sampleCount(samples)),
+  _iFeatures(PiiSampleSet::featureCount(samples)),
+  _iCapacity(0),
+  _iUsedSlots(0),
+  _iHead(-1),
+  _iTail(-1),
+  _iMisses(0),
+  _vecSamples(_iSamples),
+  _vecSlots(_iSamples, -1)
+{
+  if (_iSamples == 0)
+    return;
+  _iCapacity = int(qBound(qint64(1), cacheSize / (qint64(_iSamples) * qint64(sizeof(double))),
+                          qint64(_iSamples)));
+  for (int i=0; i<_iSamples; ++i)
+    _vecSamples[i] = PiiSampleSet::sampleAt(samples, i);
+  _vecData.resize(_iCapacity * _iSamples);
+  _vecRows.resize(_iCapacity);
+  _vecPrevious.resize(_iCapacity);
+  _vecNext.resize(_iCapacity);
+}
+
+template <class SampleSet, class Kernel>
+void PiiKernelCache<SampleSet,Kernel>::unlink(int slot)
+{
+  const int iPrevious = _vecPrevious[slot], iNext = _vecNext[slot];
+  if (iPrevious >= 0)
+    _vecNext[iPrevious] = iNext;
+  else
+    _iHead = iNext;
+  if (iNext >= 0)
+    _vecPrevious[iNext] = iPrevious;
+  else
+    _iTail = iPrevious;
+}
+
+template <class SampleSet, class Kernel>
+void PiiKernelCache<SampleSet,Kernel>::pushFront(int slot)
+{
+  _vecPrevious[slot] = -1;
+  _vecNext[slot] = _iHead;
+  if (_iHead >= 0)
+    _vecPrevious[_iHead] = slot;
+  else
+    _iTail = slot;
+  _iHead = slot;
+}
+
+template <class SampleSet, class Kernel>
+const double* PiiKernelCache<SampleSet,Kernel>::row(int index)
+{
+  int iSlot = _vecSlots[index];
+  if (iSlot >= 0)
+    {
+      if (iSlot != _iHead)
+        {
+          unlink(iSlot);
+          pushFront(iSlot);
+        }
+      return _vecData.constData() + iSlot * _iSamples;
+    }
+
+  if (_iUsedSlots < _iCapacity)
+    iSlot = _iUsedSlots++;
+  else
+    {
+      // Recycle the least recently used row.
+      iSlot = _iTail;
+      unlink(iSlot);
+      _vecSlots[_vecRows[iSlot]] = -1;
+    }
+  pushFront(iSlot);
+  _vecSlots[index] = iSlot;
+  _vecRows[iSlot] = index;
+  ++_iMisses;
+
+  double* pRow = _vecData.data() + iSlot * _iSamples;
+  PiiClassification::batchDistance(_kernel, _vecSamples[index], _vecSamples.constData(),
+                                   _iSamples, _iFeatures, pRow);
+  return pRow;
+}
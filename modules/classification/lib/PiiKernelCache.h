@@ -0,0 +1,104 @@
+/* This file is part of Into.
+ * Copyright (C) Intopii 2013.
+ * All rights reserved.
+ *
+ * Licensees holding a commercial Into license may use this file in
+ * accordance with the commercial license agreement. Please see
+ * LICENSE.commercial for commercial licensing terms.
+ *
+ * Alternatively, this file may be used under the terms of the GNU
+ * Affero General Public License version 3 as published by the Free
+ * Software Foundation. In addition, Intopii gives you special rights
+ * to use Into as a part of open source software projects. Please
+ * refer to LICENSE.AGPL3 for details.
+ */
+
+#ifndef _PIIKERNELCACHE_H
+#define _PIIKERNELCACHE_H
+
+#include "PiiSampleSet.h"
+#include "PiiDistanceMeasure.h"
+
+#include <QVector>
+
+/**
+ * A least recently used cache of kernel matrix rows. Kernel-based
+ * learning algorithms such as PiiKernelAdatron and
+ * PiiKernelPerceptron need the kernel values between training
+ * samples over and over again. Storing the full kernel matrix takes
+ * N² doubles, which is not feasible with large training sets.
+ * PiiKernelCache keeps as many rows as fit into a given number of
+ * bytes and calculates missing rows on demand. The row that was used
+ * least recently is thrown away first.
+ *
+ * Rows are calculated with [PiiClassification::batchDistance()],
+ * which evaluates the kernel between one sample and all others with
+ * a single (possibly virtual) call.
+ *
+ * ~~~(c++)
+ * typedef PiiKernelFunction<const double*> Kernel;
+ * PiiKernelCache<PiiMatrix<double>, Kernel> cache(matSamples, *pKernel, 64 << 20);
+ * const double* pRow = cache.row(5);
+ * // pRow[j] is now k(x_5, x_j)
+ * ~~~
+ *
+ * The cache refers to *samples* and *kernel*; they must remain valid
+ * as long as the cache is in use.
+ */
+template <class SampleSet, class Kernel> class PiiKernelCache
+{
+public:
+  typedef typename PiiSampleSet::Traits<SampleSet>::ConstFeatureIterator ConstFeatureIterator;
+
+  /**
+   * Creates a new kernel cache for *samples*.
+   *
+   * @param samples the training samples
+   *
+   * @param kernel the kernel function
+   *
+   * @param cacheSize the maximum number of bytes to use for cached
+   * rows. At least one row will always be cached. No more than the
+   * full kernel matrix will be allocated.
+   */
+  PiiKernelCache(const SampleSet& samples, const Kernel& kernel, qint64 cacheSize);
+
+  /**
+   * Returns the kernel values between sample *index* and all
+   * samples. The returned pointer is valid until the next call to
+   * row().
+   */
+  const double* row(int index);
+
+  /**
+   * Returns the number of samples in the cached sample set, which is
+   * also the length of each row.
+   */
+  int sampleCount() const { return _iSamples; }
+
+  /**
+   * Returns the maximum number of rows that can be cached at a time.
+   */
+  int capacity() const { return _iCapacity; }
+
+  /**
+   * Returns the number of rows calculated so far.
+   */
+  int missCount() const { return _iMisses; }
+
+private:
+  void unlink(int slot);
+  void pushFront(int slot);
+
+  const Kernel& _kernel;
+  int _iSamples, _iFeatures, _iCapacity, _iUsedSlots, _iHead, _iTail, _iMisses;
+  QVector<ConstFeatureIterator> _vecSamples;
+  QVector<double> _vecData;
+  // Slot of each row (-1 if not cached), row of each slot, and a
+  // doubly linked list of slots in most recently used order.
+  QVector<int> _vecSlots, _vecRows, _vecPrevious, _vecNext;
+};
+
+#include "PiiKernelCache-templates.h"
+
+#endif //_PIIKERNELCACHE_H
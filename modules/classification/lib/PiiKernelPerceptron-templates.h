@@ -18,11 +18,13 @@
 #endif
 
 #include "PiiGaussianKernel.h"
+#include "PiiKernelCache.h"
 
 template <class SampleSet> PiiKernelPerceptron<SampleSet>::Data::Data() :
   pKernel(new PII_POLYMORPHIC_KERNEL(PiiGaussianKernel)),
   bConverged(false),
-  iMaxIterations(100)
+  iMaxIterations(100),
+  iCacheSize(64 << 20)
 {
 }
 
@@ -45,10 +47,14 @@ void PiiKernelPerceptron<SampleSet>::learn(const SampleSet& samples,
   const int iSamples = PiiSampleSet::sampleCount(samples),
     iFeatures = PiiSampleSet::featureCount(samples);
 
-  PiiMatrix<double> matKernel(PiiClassification::calculateDistanceMatrix(samples,
-                                                                         *d->pKernel,
-                                                                         true, true));
+  PiiKernelCache<SampleSet, PiiKernelFunction<ConstFeatureIterator> > cache(samples,
+                                                                             *d->pKernel,
+                                                                             d->iCacheSize);
   QVector<double> vecWeights(iSamples, 0.0);
+  // Projections of all samples to the hyperplane's normal. Whenever a
+  // weight is changed, the change is added to all projections. A
+  // kernel row is thus needed only for misclassified samples.
+  QVector<double> vecProjections(iSamples, 0.0);
   d->vecWeights.clear();
   d->supportVectors.clear();
   d->bConverged = false;
@@ -60,22 +66,15 @@ void PiiKernelPerceptron<SampleSet>::learn(const SampleSet& samples,
       iErrorCount = 0;
       for (int i=0; i<iSamples; ++i)
         {
-          const double* pKernelRow = matKernel.constRowBegin(i);
-          // Projection to the hyperplane's normal
-          double dSum = 0;
-          for (int j=0; j<iSamples; ++j, ++pKernelRow)
-            dSum += *pKernelRow * vecWeights[j];
-          if (dSum > 0)
-            dSum = 1;
-          else
-            dSum = 0;
+          const double dPrediction = vecProjections[i] > 0 ? 1 : 0;
           // Prediction doesn't match the training label -> update weights
-          if (dSum != labels[i])
+          if (dPrediction != labels[i])
             {
-              if (labels[i] == 1)
-                ++vecWeights[i];
-              else
-                --vecWeights[i];
+              const double dChange = labels[i] == 1 ? 1 : -1;
+              vecWeights[i] += dChange;
+              const double* pKernelRow = cache.row(i);
+              for (int j=0; j<iSamples; ++j)
+                vecProjections[j] += dChange * pKernelRow[j];
               ++iErrorCount;
             }
           PII_TRY_CONTINUE(this->controller(), NAN);
@@ -115,14 +114,25 @@ double PiiKernelPerceptron<SampleSet>::classify(ConstFeatureIterator featureVect
   PII_D;
   if (!d->vecWeights.isEmpty())
     {
-      const int iSamples = PiiSampleSet::sampleCount(d->supportVectors),
-        iFeatures = PiiSampleSet::featureCount(d->supportVectors);
+      enum { BlockSize = 64 };
+      const SampleSet& supportVectors = d->supportVectors;
+      const int iSamples = PiiSampleSet::sampleCount(supportVectors),
+        iFeatures = PiiSampleSet::featureCount(supportVectors);
+      ConstFeatureIterator aModels[BlockSize];
+      double aValues[BlockSize];
       double dSum = 0;
-      for (int i=0; i<iSamples; ++i)
-        dSum += d->vecWeights[i] *
-          (*d->pKernel)(PiiSampleSet::sampleAt(d->supportVectors, i),
-                        featureVector,
-                        iFeatures);
+      // Evaluate the kernel against a block of support vectors at a
+      // time.
+      for (int i=0; i<iSamples; i += BlockSize)
+        {
+          const int iCount = qMin(int(BlockSize), iSamples - i);
+          for (int j=0; j<iCount; ++j)
+            aModels[j] = PiiSampleSet::sampleAt(supportVectors, i+j);
+          PiiClassification::batchDistance(*d->pKernel, featureVector, aModels,
+                                           iCount, iFeatures, aValues);
+          for (int j=0; j<iCount; ++j)
+            dSum += d->vecWeights[i+j] * aValues[j];
+        }
       return dSum > 0 ? 1 : 0;
     }
   return NAN;
@@ -152,3 +162,5 @@ template <class SampleSet> QVector<double> PiiKernelPerceptron<SampleSet>::weigh
 template <class SampleSet> bool PiiKernelPerceptron<SampleSet>::converged() const throw() { return _d()->bConverged; }
 template <class SampleSet> SampleSet PiiKernelPerceptron<SampleSet>::supportVectors() const { return _d()->supportVectors; }
 template <class SampleSet> void PiiKernelPerceptron<SampleSet>::setSupportVectors(const SampleSet& supportVectors) { _d()->supportVectors = supportVectors; }
+template <class SampleSet> void PiiKernelPerceptron<SampleSet>::setCacheSize(qint64 cacheSize) { _d()->iCacheSize = cacheSize; }
+template <class SampleSet> qint64 PiiKernelPerceptron<SampleSet>::cacheSize() const { return _d()->iCacheSize; }
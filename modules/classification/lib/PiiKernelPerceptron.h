@@ -174,6 +174,19 @@ public:
    */
   void setMaxIterations(int maxIterations);
 
+  /**
+   * Sets the maximum number of bytes used for caching kernel values
+   * during training. A row of the kernel matrix is needed only when
+   * a training sample is misclassified. Rows that don't fit into the
+   * cache will be recalculated as needed. See PiiKernelCache. The
+   * default is 64 MB.
+   */
+  void setCacheSize(qint64 cacheSize);
+  /**
+   * Returns the size of the kernel cache in bytes.
+   */
+  qint64 cacheSize() const;
+
 private:
   class Data : public PiiLearningAlgorithm<SampleSet>::Data
   {
@@ -182,6 +195,7 @@ private:
     PiiKernelFunction<ConstFeatureIterator>* pKernel;
     bool bConverged;
     int iMaxIterations;
+    qint64 iCacheSize;
     QVector<double> vecWeights;
     SampleSet supportVectors;
   };
@@ -72,6 +72,47 @@ double PiiKnnClassifier<SampleSet>::classify(ConstFeatureIterator featureVector)
   return d->vecClassLabels[iLabelIndex];
 }
 
+template <class SampleSet>
+QVector<double> PiiKnnClassifier<SampleSet>::classify(const SampleSet& samples)
+{
+  const PII_D;
+  return classify(PiiClassification::findClosestMatches(samples, d->modelSet, *d->pMeasure, d->k));
+}
+
+template <class SampleSet>
+QVector<double> PiiKnnClassifier<SampleSet>::classify(const Pii::ParallelExecution& policy,
+                                                      const SampleSet& samples)
+{
+  const PII_D;
+  return classify(PiiClassification::findClosestMatches(policy, samples, d->modelSet, *d->pMeasure, d->k));
+}
+
+template <class SampleSet>
+QVector<double> PiiKnnClassifier<SampleSet>::classify(const QVector<PiiClassification::MatchList>& matches) const
+{
+  const PII_D;
+  QVector<double> vecResults(matches.size(), NAN);
+  for (int i=0; i<matches.size(); ++i)
+    {
+      double dDistance = INFINITY;
+      int iLabelIndex = -1;
+      // With k = 1, labels are not needed for voting.
+      if (d->k == 1)
+        {
+          if (matches[i].size() > 0)
+            {
+              dDistance = matches[i][0].first;
+              iLabelIndex = matches[i][0].second;
+            }
+        }
+      else
+        PiiClassification::knnVote(matches[i], d->vecClassLabels, &dDistance, &iLabelIndex);
+      if (dDistance <= d->dRejectThreshold && iLabelIndex >= 0 && iLabelIndex < d->vecClassLabels.size())
+        vecResults[i] = d->vecClassLabels[iLabelIndex];
+    }
+  return vecResults;
+}
+
 template <class SampleSet> int PiiKnnClassifier<SampleSet>::findClosestMatch(ConstFeatureIterator featureVector,
                                                                              double* distance) const throw()
 {
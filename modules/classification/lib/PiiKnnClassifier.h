@@ -52,6 +52,29 @@ public:
    */
   double classify(ConstFeatureIterator featureVector) throw();
 
+  /**
+   * Classifies all samples in *samples* and returns a class label
+   * for each. The result is equal to calling the single-sample
+   * version for each sample, but the closest neighbors are searched
+   * with the batch version of
+   * PiiClassification::findClosestMatches(), which is much faster
+   * with large matrices and the default distance measure.
+   *
+   * ~~~(c++)
+   * PiiKnnClassifier<PiiMatrix<float> > knn;
+   * knn.setModels(matModels);
+   * knn.setClassLabels(vecLabels);
+   * QVector<double> vecResults = knn.classify(Pii::ParallelExecution(), matSamples);
+   * ~~~
+   */
+  QVector<double> classify(const SampleSet& samples);
+
+  /**
+   * Classifies all samples in *samples* in parallel. The samples are
+   * divided into bands as determined by *policy*.
+   */
+  QVector<double> classify(const Pii::ParallelExecution& policy, const SampleSet& samples);
+
   /**
    * Returns the index of the closest model sample in the winning
    * class selected by the k nearest neighbors rule.
@@ -85,6 +108,8 @@ public:
   int getK() const;
 
 private:
+  QVector<double> classify(const QVector<PiiClassification::MatchList>& matches) const;
+
   class Data : public PiiVectorQuantizer<SampleSet>::Data
   {
   public:
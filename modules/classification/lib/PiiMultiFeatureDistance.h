@@ -19,6 +19,7 @@
 #include "PiiDistanceMeasure.h"
 #include "PiiClassification.h"
 #include <PiiMath.h>
+#include <algorithm>
 
 /**
  * A distance measure that combines many distance measures into one.
@@ -31,6 +32,17 @@
  * together to get the final distance. Other options are minimum,
  * maximum and product.
  *
+ * PiiMultiFeatureDistance supports partial distance elimination (see
+ * [PiiClassification::BoundedDistance]). With `DistanceMax`, the
+ * calculation stops as soon as a single weighted distance exceeds the
+ * bound. With `DistanceSum`, the same is done for the partial sum,
+ * but only if the distances are known to be non-negative (see
+ * [setNonNegativeDistances()]). In both cases, sub-vectors with a
+ * large weight per feature are measured first, and each distance
+ * measure receives the part of the bound that is still left. This
+ * way the expensive sub-vectors often don't need to be measured at
+ * all in nearest neighbor search.
+ *
  */
 template <class FeatureIterator> class PiiMultiFeatureDistance :
   public QList<PiiDistanceMeasure<FeatureIterator>* >
@@ -74,18 +86,84 @@ public:
    */
   QVector<double> weights() const;
 
-  double operator() (const FeatureIterator sample,
-                     const FeatureIterator model,
+  /**
+   * Tells whether all distance measures and weights are known to be
+   * non-negative. In `DistanceSum` mode, this makes it possible to
+   * stop summing once the partial sum exceeds the bound. Most
+   * distance measures, such as PiiSquaredGeometricDistance and
+   * PiiChiSquaredDistance, are non-negative. PiiHistogramIntersection
+   * and PiiCosineDistance are not. The default is `false`.
+   */
+  void setNonNegativeDistances(bool nonNegativeDistances);
+  /**
+   * Returns `true` if the distances are known to be non-negative.
+   */
+  bool nonNegativeDistances() const;
+
+  double operator() (FeatureIterator sample,
+                     FeatureIterator model,
                      int length) const throw();
 
+  /**
+   * Calculates the combined distance, but stops as soon as the
+   * result is known to exceed *bound*.
+   */
+  double operator() (FeatureIterator sample,
+                     FeatureIterator model,
+                     int length,
+                     double bound) const throw();
+
 private:
+  struct CostOrder;
+  void updateOrder();
+  bool canStopEarly() const;
+  double weight(int index) const;
+
   PiiClassification::DistanceCombinationMode _mode;
   PiiMatrix<int> _matBoundaries;
   QVector<double> _lstWeights;
+  bool _bNonNegativeDistances;
+  // Sub-vector indices in the order of decreasing weight per feature.
+  QVector<int> _vecOrder;
+};
+
+namespace PiiClassification
+{
+  /// @hide
+  template <class FeatureIterator> struct BoundedDistance<PiiMultiFeatureDistance<FeatureIterator> >
+  {
+    static double measure(const PiiMultiFeatureDistance<FeatureIterator>& measure,
+                          FeatureIterator sample, FeatureIterator model,
+                          int length, double bound)
+    {
+      return measure(sample, model, length, bound);
+    }
+  };
+  /// @endhide
+}
+
+template <class FeatureIterator> struct PiiMultiFeatureDistance<FeatureIterator>::CostOrder
+{
+  CostOrder(const PiiMultiFeatureDistance* distance) : distance(distance) {}
+
+  double weightPerFeature(int index) const
+  {
+    const int iStart = index > 0 ? distance->_matBoundaries(0,index-1) : 0;
+    const int iLength = distance->_matBoundaries(0,index) - iStart;
+    return iLength > 0 ? distance->weight(index) / iLength : 0;
+  }
+
+  bool operator() (int index1, int index2) const
+  {
+    return weightPerFeature(index1) > weightPerFeature(index2);
+  }
+
+  const PiiMultiFeatureDistance* distance;
 };
 
 template <class FeatureIterator> PiiMultiFeatureDistance<FeatureIterator>::PiiMultiFeatureDistance() :
-  _mode(PiiClassification::DistanceSum)
+  _mode(PiiClassification::DistanceSum),
+  _bNonNegativeDistances(false)
 {
 }
 
@@ -95,57 +173,115 @@ template <class FeatureIterator> PiiMultiFeatureDistance<FeatureIterator>::~PiiM
 
 template <class FeatureIterator> void PiiMultiFeatureDistance<FeatureIterator>::setCombinationMode(PiiClassification::DistanceCombinationMode mode) { _mode = mode; }
 template <class FeatureIterator> PiiClassification::DistanceCombinationMode PiiMultiFeatureDistance<FeatureIterator>::combinationMode() const { return _mode; }
-template <class FeatureIterator> void PiiMultiFeatureDistance<FeatureIterator>::setBoundaries(const PiiMatrix<int>& boundaries) { _matBoundaries = boundaries; }
+template <class FeatureIterator> void PiiMultiFeatureDistance<FeatureIterator>::setBoundaries(const PiiMatrix<int>& boundaries) { _matBoundaries = boundaries; updateOrder(); }
 template <class FeatureIterator> PiiMatrix<int> PiiMultiFeatureDistance<FeatureIterator>::boundaries() const { return _matBoundaries; }
-template <class FeatureIterator> void PiiMultiFeatureDistance<FeatureIterator>::setWeights(const QVector<double>& weights) { _lstWeights = weights; }
+template <class FeatureIterator> void PiiMultiFeatureDistance<FeatureIterator>::setWeights(const QVector<double>& weights) { _lstWeights = weights; updateOrder(); }
 template <class FeatureIterator> QVector<double> PiiMultiFeatureDistance<FeatureIterator>::weights() const { return _lstWeights; }
+template <class FeatureIterator> void PiiMultiFeatureDistance<FeatureIterator>::setNonNegativeDistances(bool nonNegativeDistances) { _bNonNegativeDistances = nonNegativeDistances; }
+template <class FeatureIterator> bool PiiMultiFeatureDistance<FeatureIterator>::nonNegativeDistances() const { return _bNonNegativeDistances; }
+
+template <class FeatureIterator> double PiiMultiFeatureDistance<FeatureIterator>::weight(int index) const
+{
+  return index < _lstWeights.size() ? _lstWeights[index] : 1;
+}
+
+template <class FeatureIterator> void PiiMultiFeatureDistance<FeatureIterator>::updateOrder()
+{
+  const int iCount = _matBoundaries.columns();
+  _vecOrder.resize(iCount);
+  for (int i=0; i<iCount; ++i)
+    _vecOrder[i] = i;
+  // The order of equally effective sub-vectors is retained.
+  std::stable_sort(_vecOrder.begin(), _vecOrder.end(), CostOrder(this));
+}
+
+template <class FeatureIterator> bool PiiMultiFeatureDistance<FeatureIterator>::canStopEarly() const
+{
+  if (_mode == PiiClassification::DistanceMax)
+    return true;
+  if (_mode != PiiClassification::DistanceSum || !_bNonNegativeDistances)
+    return false;
+  for (int i=0; i<_lstWeights.size(); ++i)
+    if (_lstWeights[i] < 0)
+      return false;
+  return true;
+}
 
 template <class FeatureIterator> double PiiMultiFeatureDistance<FeatureIterator>::operator() (FeatureIterator sample,
                                                                                               FeatureIterator model,
                                                                                               int length) const throw()
+{
+  return operator() (sample, model, length, INFINITY);
+}
+
+template <class FeatureIterator> double PiiMultiFeatureDistance<FeatureIterator>::operator() (FeatureIterator sample,
+                                                                                              FeatureIterator model,
+                                                                                              int length,
+                                                                                              double bound) const throw()
 {
   const int iSize = this->size();
   if (iSize == 0)
     return 0;
-  if (_matBoundaries.columns() == 0)
-    return (*this->at(0))(sample, model, length);
-
-  PiiDistanceMeasure<FeatureIterator>* measure = 0;
-  int start = 0, end;
-  // Init a matrix that collects all sub-vector distances
-  PiiMatrix<double> distances(1, _matBoundaries.columns());
-  // Loop through all sub-vectors
-  for (int i=0; i<_matBoundaries.columns(); ++i)
-    {
-      // If we have a distance measure for this sub-vector, we use it.
-      // Otherwise use the last one.
-      if (i < iSize)
-        measure = this->at(i);
-      end = _matBoundaries(0,i);
-      if (end > length) break; // Error
-
-      double weight = (i < _lstWeights.size() ? _lstWeights[i] : 1);
+  const int iColumns = _matBoundaries.columns();
+  if (iColumns == 0)
+    return PiiClassification::boundedDistance(*this->at(0), sample, model, length, bound);
 
-      distances(0,i) = weight * (*measure)(sample + start, model + start, end-start);
-      start = end;
-    }
+  // Sub-vectors that don't fit into the feature vector are an error.
+  // They count as zero distances.
+  int iValid = 0;
+  while (iValid < iColumns && _matBoundaries(0,iValid) <= length)
+    ++iValid;
 
-  switch (_mode)
+  const bool bStopEarly = canStopEarly();
+  double dResult = _mode == PiiClassification::DistanceProduct ? 1 :
+    _mode == PiiClassification::DistanceMin ? INFINITY :
+    _mode == PiiClassification::DistanceMax ? -INFINITY : 0;
+  for (int j=0; j<iColumns; ++j)
     {
-    case PiiClassification::DistanceSum: return Pii::sum<double>(distances);
-    case PiiClassification::DistanceProduct:
-      {
-        double product = distances(0,0);
-        for (int c=1; c<distances.columns(); c++)
-          product *= distances(0,c);
-        return product;
-      }
-    case PiiClassification::DistanceMin: return Pii::min(distances);
-    case PiiClassification::DistanceMax: return Pii::max(distances);
-
-    default: return Pii::sum<double>(distances);
+      // Early termination measures the most effective sub-vectors
+      // first.
+      const int i = bStopEarly ? _vecOrder[j] : j;
+      double dDistance = 0;
+      if (i < iValid)
+        {
+          // If we have a distance measure for this sub-vector, we use
+          // it. Otherwise use the last one.
+          PiiDistanceMeasure<FeatureIterator>* pMeasure = this->at(qMin(i, iSize-1));
+          const int iStart = i > 0 ? _matBoundaries(0,i-1) : 0, iEnd = _matBoundaries(0,i);
+          const double dWeight = weight(i);
+          if (bStopEarly && dWeight > 0)
+            {
+              // The part of the bound that is still left for this
+              // sub-vector.
+              const double dSubBound = (_mode == PiiClassification::DistanceSum ? bound - dResult : bound) / dWeight;
+              const double dSubDistance = PiiClassification::boundedDistance(*pMeasure, sample + iStart, model + iStart,
+                                                                             iEnd - iStart, dSubBound);
+              if (dSubDistance > dSubBound)
+                {
+                  // Rounding may bring the weighted result back
+                  // below the bound.
+                  const double dExceeded = _mode == PiiClassification::DistanceSum ?
+                    dResult + dWeight * dSubDistance :
+                    dWeight * dSubDistance;
+                  return dExceeded > bound ? dExceeded : INFINITY;
+                }
+              dDistance = dWeight * dSubDistance;
+            }
+          else
+            dDistance = dWeight * (*pMeasure)(sample + iStart, model + iStart, iEnd - iStart);
+        }
+
+      switch (_mode)
+        {
+        case PiiClassification::DistanceProduct: dResult *= dDistance; break;
+        case PiiClassification::DistanceMin: dResult = qMin(dResult, dDistance); break;
+        case PiiClassification::DistanceMax: dResult = qMax(dResult, dDistance); break;
+        default: dResult += dDistance; break;
+        }
+      if (bStopEarly && dResult > bound)
+        return dResult;
     }
-  return 0;
+  return dResult;
 }
 
 #endif //_PIIMULTIFEATUREDISTANCE_H
@@ -0,0 +1,222 @@
+/* This file is part of Into.
+ * Copyright (C) Intopii 2013.
+ * All rights reserved.
+ *
+ * Licensees holding a commercial Into license may use this file in
+ * accordance with the commercial license agreement. Please see
+ * LICENSE.commercial for commercial licensing terms.
+ *
+ * Alternatively, this file may be used under the terms of the GNU
+ * Affero General Public License version 3 as published by the Free
+ * Software Foundation. In addition, Intopii gives you special rights
+ * to use Into as a part of open source software projects. Please
+ * refer to LICENSE.AGPL3 for details.
+ */
+
+
+#include "PiiMultiIndexHash.h"
+#include "PiiDistanceKernels.h"
+
+#include <PiiMath.h>
+
+#include <QSet>
+#include <QVarLengthArray>
+#include <algorithm>
+#include <cmath>
+
+namespace
+{
+  // Extracts *length* (at most 32) bits starting at bit *start*.
+  inline unsigned int substring(const unsigned int* code, int start, int length)
+  {
+    const int iWord = start >> 5, iShift = start & 31;
+    unsigned long long ullBits = code[iWord] >> iShift;
+    if (iShift + length > 32)
+      ullBits |= (unsigned long long)code[iWord+1] << (32 - iShift);
+    return length == 32 ? unsigned(ullBits) : unsigned(ullBits) & ((1u << length) - 1);
+  }
+
+  // Next larger integer with the same number of set bits.
+  inline unsigned long long nextCombination(unsigned long long mask)
+  {
+    const unsigned long long ullLowest = mask & (~mask + 1);
+    const unsigned long long ullRipple = mask + ullLowest;
+    return ullRipple | (((mask ^ ullRipple) >> 2) / ullLowest);
+  }
+
+  double binomial(int n, int k)
+  {
+    double dResult = 1;
+    for (int i=1; i<=k; ++i)
+      dResult = dResult * (n - k + i) / i;
+    return dResult;
+  }
+
+  struct KeyIndexLess
+  {
+    KeyIndexLess(const unsigned int* keys) : pKeys(keys) {}
+    bool operator() (int a, int b) const { return pKeys[a] < pKeys[b] || (pKeys[a] == pKeys[b] && a < b); }
+    const unsigned int* pKeys;
+  };
+}
+
+PiiMultiIndexHash::Data::Data()
+{}
+
+PiiMultiIndexHash::PiiMultiIndexHash() :
+  d(new Data)
+{}
+
+PiiMultiIndexHash::PiiMultiIndexHash(const PiiMultiIndexHash& other) :
+  d(other.d->reserved())
+{}
+
+PiiMultiIndexHash::~PiiMultiIndexHash()
+{
+  d->release();
+}
+
+PiiMultiIndexHash& PiiMultiIndexHash::operator= (const PiiMultiIndexHash& other)
+{
+  other.d->assignTo(d);
+  return *this;
+}
+
+bool PiiMultiIndexHash::isEmpty() const { return d->matCodes.rows() == 0; }
+int PiiMultiIndexHash::codeCount() const { return d->matCodes.rows(); }
+int PiiMultiIndexHash::wordCount() const { return d->matCodes.columns(); }
+int PiiMultiIndexHash::substringCount() const { return qMax(0, d->vecSubstringStarts.size() - 1); }
+PiiMatrix<unsigned int> PiiMultiIndexHash::codes() const { return d->matCodes; }
+
+void PiiMultiIndexHash::buildIndex(const PiiMatrix<unsigned int>& codes, int substrings)
+{
+  Data* d = _d();
+  const int iCodes = codes.rows(), iBits = codes.columns() * 32;
+  d->matCodes = codes;
+  d->vecSubstringStarts.clear();
+  d->vecKeys.clear();
+  d->vecIndices.clear();
+  if (iCodes == 0 || iBits == 0)
+    return;
+
+  if (substrings <= 0)
+    substrings = Pii::round<int>(iBits / qMax(1.0, std::log(double(iCodes)) / std::log(2.0)));
+  substrings = qBound((iBits + 31) / 32, substrings, iBits);
+
+  // Distribute the bits as evenly as possible.
+  d->vecSubstringStarts.resize(substrings + 1);
+  for (int t=0; t<=substrings; ++t)
+    d->vecSubstringStarts[t] = int((long long)iBits * t / substrings);
+
+  d->vecKeys.resize(substrings * iCodes);
+  d->vecIndices.resize(substrings * iCodes);
+  QVector<unsigned int> vecKeys(iCodes);
+  for (int t=0; t<substrings; ++t)
+    {
+      const int iStart = d->vecSubstringStarts[t], iLength = d->vecSubstringStarts[t+1] - iStart;
+      for (int i=0; i<iCodes; ++i)
+        vecKeys[i] = substring(codes[i], iStart, iLength);
+      int* pIndices = d->vecIndices.data() + t * iCodes;
+      for (int i=0; i<iCodes; ++i)
+        pIndices[i] = i;
+      std::sort(pIndices, pIndices + iCodes, KeyIndexLess(vecKeys.constData()));
+      unsigned int* pKeys = d->vecKeys.data() + t * iCodes;
+      for (int i=0; i<iCodes; ++i)
+        pKeys[i] = vecKeys[pIndices[i]];
+    }
+}
+
+PiiClassification::MatchList PiiMultiIndexHash::findClosestMatches(const unsigned int* code,
+                                                                   int n,
+                                                                   int maxDistance) const
+{
+  PiiClassification::MatchList lstMatches;
+  const int iCodes = d->matCodes.rows(), iWords = d->matCodes.columns();
+  const int iSubstrings = substringCount();
+  if (n <= 0 || iCodes == 0)
+    return lstMatches;
+
+  lstMatches.fill(qMin(n, iCodes), qMakePair(double(INFINITY), -1));
+  const double dMaxDistance = maxDistance >= 0 ? double(maxDistance) : INFINITY;
+  QSet<int> setVisited;
+  int iMaxLength = 0;
+  for (int t=0; t<iSubstrings; ++t)
+    iMaxLength = qMax(iMaxLength, d->vecSubstringStarts[t+1] - d->vecSubstringStarts[t]);
+
+  // Compares code i to the query and retains it if it is among the
+  // closest ones.
+#define PII_CHECK_CODE(INDEX) \
+  do { \
+    const int iIndex = INDEX; \
+    if (!setVisited.contains(iIndex)) \
+      { \
+        setVisited.insert(iIndex); \
+        const double dBound = qMin(lstMatches[0].first, dMaxDistance); \
+        const double dDistance = PiiClassification::hammingDistance(code, d->matCodes[iIndex], iWords, dBound); \
+        if (dDistance <= dBound) \
+          lstMatches.put(qMakePair(dDistance, iIndex)); \
+      } \
+  } while (false)
+
+  for (int iRadius=0; iRadius<=iMaxLength; ++iRadius)
+    {
+      // Buckets at this radius. If there are more of them than
+      // unchecked codes, a linear scan is cheaper.
+      double dBuckets = 0;
+      for (int t=0; t<iSubstrings; ++t)
+        dBuckets += binomial(d->vecSubstringStarts[t+1] - d->vecSubstringStarts[t], iRadius);
+      if (dBuckets > iCodes - setVisited.size())
+        {
+          for (int i=0; i<iCodes; ++i)
+            PII_CHECK_CODE(i);
+          break;
+        }
+
+      for (int t=0; t<iSubstrings; ++t)
+        {
+          const int iStart = d->vecSubstringStarts[t], iLength = d->vecSubstringStarts[t+1] - iStart;
+          if (iRadius > iLength)
+            continue;
+          const unsigned int uiQuery = substring(code, iStart, iLength);
+          const unsigned int* pKeys = d->vecKeys.constData() + t * iCodes;
+          const int* pIndices = d->vecIndices.constData() + t * iCodes;
+          const unsigned long long ullLimit = 1ull << iLength;
+          // Enumerate all keys that differ from the query in exactly
+          // iRadius bits.
+          for (unsigned long long ullMask = (1ull << iRadius) - 1; ullMask < ullLimit;
+               ullMask = nextCombination(ullMask))
+            {
+              const unsigned int uiKey = uiQuery ^ unsigned(ullMask);
+              for (const unsigned int* pKey = std::lower_bound(pKeys, pKeys + iCodes, uiKey);
+                   pKey != pKeys + iCodes && *pKey == uiKey; ++pKey)
+                PII_CHECK_CODE(pIndices[pKey - pKeys]);
+              if (ullMask == 0)
+                break;
+            }
+        }
+
+      // Codes closer than this have all been checked.
+      const double dGuaranteed = double(iSubstrings) * (iRadius + 1) - 1;
+      if (lstMatches[0].second != -1 && lstMatches[0].first <= dGuaranteed)
+        break;
+      if (dMaxDistance <= dGuaranteed)
+        break;
+    }
+#undef PII_CHECK_CODE
+
+  // Drop unfilled entries. The rest stays in ascending order when
+  // assigned in place.
+  lstMatches.sort();
+  int iFound = 0;
+  while (iFound < lstMatches.size() && lstMatches[iFound].second != -1)
+    ++iFound;
+  if (iFound < lstMatches.size())
+    {
+      PiiClassification::MatchList lstFound;
+      lstFound.fill(iFound, qMakePair(0.0, -1));
+      for (int i=0; i<iFound; ++i)
+        lstFound[i] = lstMatches[i];
+      return lstFound;
+    }
+  return lstMatches;
+}
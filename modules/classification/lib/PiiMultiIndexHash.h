@@ -0,0 +1,148 @@
+/* This file is part of Into.
+ * Copyright (C) Intopii 2013.
+ * All rights reserved.
+ *
+ * Licensees holding a commercial Into license may use this file in
+ * accordance with the commercial license agreement. Please see
+ * LICENSE.commercial for commercial licensing terms.
+ *
+ * Alternatively, this file may be used under the terms of the GNU
+ * Affero General Public License version 3 as published by the Free
+ * Software Foundation. In addition, Intopii gives you special rights
+ * to use Into as a part of open source software projects. Please
+ * refer to LICENSE.AGPL3 for details.
+ */
+
+
+#ifndef _PIIMULTIINDEXHASH_H
+#define _PIIMULTIINDEXHASH_H
+
+#include <QVector>
+#include <PiiMatrix.h>
+#include "PiiClassificationGlobal.h"
+#include "PiiClassification.h"
+#include <PiiSerialization.h>
+#include <PiiSerializationUtil.h>
+#include <PiiNameValuePair.h>
+#include <PiiSharedD.h>
+
+/**
+ * Multi-index hashing for fast Hamming-distance search in large sets
+ * of binary codes. Each code is a row of 32-bit words in a
+ * PiiMatrix<unsigned int>, for example a binary descriptor created
+ * by PiiRandomLbp.
+ *
+ * The bits of each code are split into *m* disjoint substrings, and
+ * a hash table is built for each substring. If two codes differ in
+ * less than \(m(s+1)\) bits, at least one of their substrings differs
+ * in at most *s* bits. The closest matches of a query can therefore
+ * be found by looking up the buckets whose substring is within *s*
+ * bits of the query's substring, for increasing *s*, and calculating
+ * the full distance only to the codes found in the buckets. The
+ * search stops as soon as the found matches are guaranteed to be
+ * the closest ones. The result is exact.
+ *
+ * With substrings of about \(\log_2 N\) bits, where N is the number
+ * of codes, the number of codes inspected grows sub-linearly with N
+ * if the closest matches are close to the query. If the number of
+ * buckets to inspect would exceed the number of codes, the remaining
+ * codes are compared linearly.
+ *
+ * ~~~(c++)
+ * PiiMatrix<unsigned int> matCodes(10000, 8); // 256-bit codes
+ * // ... fill matCodes
+ * PiiMultiIndexHash index;
+ * index.buildIndex(matCodes);
+ * PiiClassification::MatchList lstMatches = index.findClosestMatches(matQuery[0], 5);
+ * ~~~
+ */
+class PII_CLASSIFICATION_EXPORT PiiMultiIndexHash
+{
+  friend struct PiiSerialization::Accessor;
+  template <class Archive> void serialize(Archive& archive, const unsigned int)
+  {
+    int iSubstrings = d->vecSubstringStarts.size() - 1;
+    archive & PII_NVP("codes", _d()->matCodes);
+    archive & PII_NVP("substrings", iSubstrings);
+    // The hash tables are derived data.
+    if (Archive::InputArchive)
+      buildIndex(PiiMatrix<unsigned int>(d->matCodes), iSubstrings);
+  }
+
+public:
+  PiiMultiIndexHash();
+  PiiMultiIndexHash(const PiiMultiIndexHash& other);
+  ~PiiMultiIndexHash();
+
+  PiiMultiIndexHash& operator= (const PiiMultiIndexHash& other);
+
+  /**
+   * Builds the hash tables for *codes*. Each row of *codes* is a
+   * binary code of 32 * *codes*.columns() bits.
+   *
+   * @param substrings the number of substrings each code is divided
+   * into. If this value is zero or negative, the number is selected
+   * so that each substring has about \(\log_2 N\) bits. The
+   * substrings are at most 32 bits long.
+   */
+  void buildIndex(const PiiMatrix<unsigned int>& codes, int substrings = 0);
+
+  /**
+   * Returns `true` if the index contains no codes.
+   */
+  bool isEmpty() const;
+  /**
+   * Returns the number of codes in the index.
+   */
+  int codeCount() const;
+  /**
+   * Returns the number of 32-bit words in each code.
+   */
+  int wordCount() const;
+  /**
+   * Returns the number of substrings (and hash tables).
+   */
+  int substringCount() const;
+  /**
+   * Returns the indexed codes.
+   */
+  PiiMatrix<unsigned int> codes() const;
+
+  /**
+   * Returns at most *n* codes closest to *code* in Hamming distance.
+   * *code* must contain [wordCount()] words.
+   *
+   * @param maxDistance if non-negative, only codes whose distance to
+   * *code* is at most *maxDistance* will be returned. A small limit
+   * makes the search faster.
+   *
+   * @return the closest matches as (distance, index) pairs in
+   * ascending order of distance. Equal to
+   * PiiClassification::findClosestMatches() with
+   * PiiHammingDistance, except that the order of equally distant
+   * matches may differ.
+   */
+  PiiClassification::MatchList findClosestMatches(const unsigned int* code,
+                                                  int n,
+                                                  int maxDistance = -1) const;
+
+private:
+  /// @internal
+  class Data : public PiiSharedD<Data>
+  {
+  public:
+    Data();
+
+    PiiMatrix<unsigned int> matCodes;
+    // Bit offsets of the substrings. The last entry is the total
+    // number of bits.
+    QVector<int> vecSubstringStarts;
+    // Hash table t occupies indices [t*N, (t+1)*N) in these vectors,
+    // sorted by substring.
+    QVector<unsigned int> vecKeys;
+    QVector<int> vecIndices;
+  } *d;
+  PII_SHARED_D_FUNC;
+};
+
+#endif //_PIIMULTIINDEXHASH_H
@@ -16,6 +16,8 @@
 #ifndef _PIIPOLYNOMIALKERNEL_H
 #define _PIIPOLYNOMIALKERNEL_H
 
+#include <PiiMath.h>
+
 /**
  * Polynomial kernel function. The polynomial kernel is defined as
  * \(k(x,y) = (\alpha + \beta \langle x, y \rangle)^d\), where *x*
@@ -38,7 +40,7 @@ public:
   /**
    * Constructs a new polynomial kernel function.
    */
-  PiiPolynomialKernel() : _dAlpha(0), _dBeta(1), _iDegree(2) {}
+  PiiPolynomialKernel() : _dOffset(0), _dScale(1), _iDegree(2) {}
 
   /**
    * Sets the value of \(\alpha\) to *offset*. The default value is
@@ -70,12 +72,12 @@ public:
 
   inline double operator() (FeatureIterator sample, FeatureIterator model, int length) const throw()
   {
-    return Pii::pow(_dAlpha + _dBeta * Pii::innerProductN(sample, length, model, 0.0), _iDegree)
+    return Pii::pow(_dOffset + _dScale * Pii::innerProductN(sample, length, model, 0.0), _iDegree);
   }
 private:
   double _dOffset;
   double _dScale;
   int _iDegree;
-}
+};
 
 #endif //_PIIPOLYNOMIALKERNEL_H
@@ -0,0 +1,283 @@
+/* This file is part of Into.
+ * Copyright (C) Intopii 2013.
+ * All rights reserved.
+ *
+ * Licensees holding a commercial Into license may use this file in
+ * accordance with the commercial license agreement. Please see
+ * LICENSE.commercial for commercial licensing terms.
+ *
+ * Alternatively, this file may be used under the terms of the GNU
+ * Affero General Public License version 3 as published by the Free
+ * Software Foundation. In addition, Intopii gives you special rights
+ * to use Into as a part of open source software projects. Please
+ * refer to LICENSE.AGPL3 for details.
+ */
+
+#ifndef _PIIPRODUCTQUANTIZER_H
+# error "Never use <PiiProductQuantizer-templates.h> directly; include <PiiProductQuantizer.h> instead."
+#endif
+
+#include <PiiRandom.h>
+
+template <class SampleSet>
+PiiProductQuantizer<SampleSet>::PiiProductQuantizer() :
+  d(new Data)
+{
+}
+
+template <class SampleSet>
+PiiProductQuantizer<SampleSet>::PiiProductQuantizer(const PiiProductQuantizer& other) :
+  d(other.d)
+{
+  d->reserve();
+}
+
+template <class SampleSet> PiiProductQuantizer<SampleSet>::~PiiProductQuantizer()
+{
+  d->release();
+}
+
+template <class SampleSet>
+PiiProductQuantizer<SampleSet>& PiiProductQuantizer<SampleSet>::operator= (const PiiProductQuantizer& other)
+{
+  other.d->assignTo(d);
+  return *this;
+}
+
+template <class SampleSet>
+void PiiProductQuantizer<SampleSet>::train(const SampleSet& samples,
+                                           int subspaceCount,
+                                           int centroidCount,
+                                           int maxTrainingSamples,
+                                           int maxIterations)
+{
+  d->release();
+  d = new Data;
+  const int iSampleCount = PiiSampleSet::sampleCount(samples),
+    iFeatureCount = PiiSampleSet::featureCount(samples);
+  if (iSampleCount == 0 || iFeatureCount == 0)
+    return;
+
+  d->iFeatureCount = iFeatureCount;
+  subspaceCount = qBound(1, subspaceCount, iFeatureCount);
+  centroidCount = qBound(1, centroidCount, int(MaxCentroidCount));
+
+  d->vecSubspaceStarts.resize(subspaceCount + 1);
+  for (int m=0; m<=subspaceCount; ++m)
+    d->vecSubspaceStarts[m] = m * iFeatureCount / subspaceCount;
+
+  // Large sets are trained with a random subset. The code books are
+  // small, and a few hundred samples per centroid is plenty.
+  QVector<int> vecIndices;
+  if (maxTrainingSamples > 0 && iSampleCount > maxTrainingSamples)
+    vecIndices = Pii::selectRandomly(maxTrainingSamples, iSampleCount);
+  else
+    {
+      vecIndices.resize(iSampleCount);
+      for (int i=0; i<iSampleCount; ++i)
+        vecIndices[i] = i;
+    }
+  const int iTrainingCount = vecIndices.size();
+
+  PiiSquaredGeometricDistance<ConstFeatureIterator> measure;
+  for (int m=0; m<subspaceCount; ++m)
+    {
+      const int iStart = d->vecSubspaceStarts[m],
+        iLength = d->vecSubspaceStarts[m+1] - iStart;
+      SampleSet subspace(PiiSampleSet::create<SampleSet>(iTrainingCount, iLength));
+      for (int i=0; i<iTrainingCount; ++i)
+        {
+          ConstFeatureIterator source = PiiSampleSet::sampleAt(samples, vecIndices[i]) + iStart;
+          FeatureIterator target = PiiSampleSet::sampleAt(subspace, i);
+          for (int f=0; f<iLength; ++f)
+            target[f] = source[f];
+        }
+      // With too few samples, each of them is a centroid.
+      if (iTrainingCount <= centroidCount)
+        d->lstCodebooks << subspace;
+      else
+        d->lstCodebooks << PiiClassification::kMeans(subspace, centroidCount, measure, maxIterations);
+    }
+}
+
+template <class SampleSet>
+void PiiProductQuantizer<SampleSet>::encodeRange(const SampleSet& samples,
+                                                 int firstSample,
+                                                 int sampleCount,
+                                                 unsigned char* codes,
+                                                 std::size_t stride) const
+{
+  const int iSubspaces = d->lstCodebooks.size();
+  PiiSquaredGeometricDistance<ConstFeatureIterator> measure;
+  for (int i=firstSample; i<firstSample+sampleCount; ++i, codes += stride)
+    {
+      ConstFeatureIterator sample = PiiSampleSet::sampleAt(samples, i);
+      for (int m=0; m<iSubspaces; ++m)
+        codes[m] = (unsigned char)PiiClassification::findClosestMatch(sample + d->vecSubspaceStarts[m],
+                                                                      d->lstCodebooks[m],
+                                                                      measure);
+    }
+}
+
+template <class SampleSet>
+bool PiiProductQuantizer<SampleSet>::allocateCodes(const SampleSet& samples)
+{
+  d = d->detach();
+  if (isEmpty() || PiiSampleSet::featureCount(samples) != d->iFeatureCount)
+    {
+      d->matCodes = PiiMatrix<unsigned char>();
+      return false;
+    }
+  d->matCodes = PiiMatrix<unsigned char>(PiiSampleSet::sampleCount(samples), subspaceCount());
+  return d->matCodes.rows() > 0;
+}
+
+template <class SampleSet>
+void PiiProductQuantizer<SampleSet>::encode(const SampleSet& samples)
+{
+  if (allocateCodes(samples))
+    encodeRange(samples, 0, d->matCodes.rows(), d->matCodes[0], d->matCodes.stride());
+}
+
+template <class SampleSet>
+void PiiProductQuantizer<SampleSet>::encode(const Pii::ParallelExecution& policy, const SampleSet& samples)
+{
+  if (allocateCodes(samples))
+    Pii::forEachBand(policy, d->matCodes.rows(), 0,
+                     EncodeBand(this, samples, d->matCodes));
+}
+
+template <class SampleSet> bool PiiProductQuantizer<SampleSet>::isEmpty() const
+{
+  return d->lstCodebooks.isEmpty();
+}
+
+template <class SampleSet> int PiiProductQuantizer<SampleSet>::codeCount() const
+{
+  return d->matCodes.rows();
+}
+
+template <class SampleSet> int PiiProductQuantizer<SampleSet>::featureCount() const
+{
+  return d->iFeatureCount;
+}
+
+template <class SampleSet> int PiiProductQuantizer<SampleSet>::subspaceCount() const
+{
+  return d->lstCodebooks.size();
+}
+
+template <class SampleSet> int PiiProductQuantizer<SampleSet>::centroidCount() const
+{
+  return d->lstCodebooks.isEmpty() ? 0 : PiiSampleSet::sampleCount(d->lstCodebooks[0]);
+}
+
+template <class SampleSet> int PiiProductQuantizer<SampleSet>::subspaceStart(int subspace) const
+{
+  return d->vecSubspaceStarts[subspace];
+}
+
+template <class SampleSet> int PiiProductQuantizer<SampleSet>::subspaceLength(int subspace) const
+{
+  return d->vecSubspaceStarts[subspace+1] - d->vecSubspaceStarts[subspace];
+}
+
+template <class SampleSet> SampleSet PiiProductQuantizer<SampleSet>::centroids(int subspace) const
+{
+  return d->lstCodebooks[subspace];
+}
+
+template <class SampleSet> PiiMatrix<unsigned char> PiiProductQuantizer<SampleSet>::codes() const
+{
+  return d->matCodes;
+}
+
+template <class SampleSet>
+void PiiProductQuantizer<SampleSet>::decode(int index, FeatureIterator features) const
+{
+  const unsigned char* pCode = const_cast<const PiiMatrix<unsigned char>&>(d->matCodes)[index];
+  for (int m=0; m<d->lstCodebooks.size(); ++m)
+    {
+      ConstFeatureIterator centroid = PiiSampleSet::sampleAt(d->lstCodebooks[m], pCode[m]);
+      FeatureIterator target = features + d->vecSubspaceStarts[m];
+      for (int f=0, iLength=subspaceLength(m); f<iLength; ++f)
+        target[f] = centroid[f];
+    }
+}
+
+template <class SampleSet>
+template <class DistanceMeasure>
+PiiMatrix<double> PiiProductQuantizer<SampleSet>::distanceTable(ConstFeatureIterator sample,
+                                                                const DistanceMeasure& measure) const
+{
+  const int iSubspaces = subspaceCount(), iCentroids = centroidCount();
+  PiiMatrix<double> matTable(iSubspaces, iCentroids);
+  for (int m=0; m<iSubspaces; ++m)
+    {
+      ConstFeatureIterator subSample = sample + d->vecSubspaceStarts[m];
+      const int iLength = subspaceLength(m);
+      double* pRow = matTable[m];
+      for (int k=0; k<iCentroids; ++k)
+        pRow[k] = measure(subSample, PiiSampleSet::sampleAt(d->lstCodebooks[m], k), iLength);
+    }
+  return matTable;
+}
+
+template <class SampleSet>
+double PiiProductQuantizer<SampleSet>::distance(const PiiMatrix<double>& table, int index) const
+{
+  const unsigned char* pCode = const_cast<const PiiMatrix<unsigned char>&>(d->matCodes)[index];
+  double dSum = 0;
+  for (int m=0; m<table.rows(); ++m)
+    dSum += table(m, pCode[m]);
+  return dSum;
+}
+
+template <class SampleSet>
+template <class DistanceMeasure>
+int PiiProductQuantizer<SampleSet>::findClosestMatch(ConstFeatureIterator sample,
+                                                     const DistanceMeasure& measure,
+                                                     double* distance) const
+{
+  PiiClassification::MatchList lstMatches(findClosestMatches(sample, measure, 1));
+  if (lstMatches.size() == 0)
+    {
+      if (distance != 0)
+        *distance = INFINITY;
+      return -1;
+    }
+  if (distance != 0)
+    *distance = lstMatches[0].first;
+  return lstMatches[0].second;
+}
+
+template <class SampleSet>
+template <class DistanceMeasure>
+PiiClassification::MatchList PiiProductQuantizer<SampleSet>::findClosestMatches(ConstFeatureIterator sample,
+                                                                                const DistanceMeasure& measure,
+                                                                                int n) const
+{
+  const int iCodes = codeCount(), iSubspaces = subspaceCount();
+  PiiClassification::MatchList heap;
+  heap.fill(qMin(iCodes, n), qMakePair(double(INFINITY), -1));
+  if (heap.size() == 0)
+    return heap;
+
+  PiiMatrix<double> matTable(distanceTable(sample, measure));
+  QVector<const double*> vecRows(iSubspaces);
+  for (int m=0; m<iSubspaces; ++m)
+    vecRows[m] = matTable[m];
+  const double* const* pRows = vecRows.constData();
+
+  const PiiMatrix<unsigned char>& matCodes = d->matCodes;
+  for (int i=0; i<iCodes; ++i)
+    {
+      const unsigned char* pCode = matCodes[i];
+      double dSum = 0;
+      for (int m=0; m<iSubspaces; ++m)
+        dSum += pRows[m][pCode[m]];
+      heap.put(qMakePair(dSum, i));
+    }
+  heap.sort();
+  return heap;
+}
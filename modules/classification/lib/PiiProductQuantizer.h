@@ -0,0 +1,257 @@
+/* This file is part of Into.
+ * Copyright (C) Intopii 2013.
+ * All rights reserved.
+ *
+ * Licensees holding a commercial Into license may use this file in
+ * accordance with the commercial license agreement. Please see
+ * LICENSE.commercial for commercial licensing terms.
+ *
+ * Alternatively, this file may be used under the terms of the GNU
+ * Affero General Public License version 3 as published by the Free
+ * Software Foundation. In addition, Intopii gives you special rights
+ * to use Into as a part of open source software projects. Please
+ * refer to LICENSE.AGPL3 for details.
+ */
+
+#ifndef _PIIPRODUCTQUANTIZER_H
+#define _PIIPRODUCTQUANTIZER_H
+
+#include <QList>
+#include <QVector>
+#include <PiiMatrix.h>
+#include <PiiParallel.h>
+#include "PiiSampleSet.h"
+#include "PiiClassification.h"
+#include "PiiSquaredGeometricDistance.h"
+#include <PiiSerialization.h>
+#include <PiiSerializationUtil.h>
+#include <PiiNameValuePair.h>
+#include <PiiSharedD.h>
+
+/**
+ * A product quantizer that stores a large set of vectors in a
+ * compressed form. The feature space is split into a number of
+ * subspaces of consecutive features. A small code book of centroids
+ * is trained for each subspace with k-means, and each vector is
+ * replaced by the indices of the closest centroids, one byte per
+ * subspace. A 128-dimensional `double` vector split into 16
+ * subspaces thus takes 16 bytes instead of 1024.
+ *
+ * Distances to the compressed vectors are calculated with asymmetric
+ * distance computation: the query is not quantized. Instead, a table
+ * containing the distance from each subspace of the query to each
+ * centroid is built first (see [distanceTable()]). The approximate
+ * distance to a compressed vector is then a sum of one table entry
+ * per subspace. This works with distance measures that are sums over
+ * features, such as PiiSquaredGeometricDistance, PiiAbsDiffDistance
+ * or PiiHistogramIntersection, but not e.g. with PiiGeometricDistance.
+ *
+ * ~~~(c++)
+ * PiiProductQuantizer<PiiMatrix<float> > quantizer;
+ * quantizer.train(matModels, 16);
+ * quantizer.encode(matModels);
+ * // Release the original models
+ * matModels = PiiMatrix<float>();
+ * PiiSquaredGeometricDistance<const float*> measure;
+ * PiiClassification::MatchList lstMatches = quantizer.findClosestMatches(sample, measure, 10);
+ * ~~~
+ *
+ * @see PiiVectorQuantizer::compressModels()
+ */
+template <class SampleSet> class PiiProductQuantizer
+{
+  friend struct PiiSerialization::Accessor;
+  template <class Archive> void serialize(Archive& archive, const unsigned int)
+  {
+    archive & PII_NVP("features", d->iFeatureCount);
+    archive & PII_NVP("starts", d->vecSubspaceStarts);
+    archive & PII_NVP("codebooks", d->lstCodebooks);
+    archive & PII_NVP("codes", d->matCodes);
+  }
+
+public:
+  typedef typename PiiSampleSet::Traits<SampleSet>::FeatureIterator FeatureIterator;
+  typedef typename PiiSampleSet::Traits<SampleSet>::ConstFeatureIterator ConstFeatureIterator;
+
+  /**
+   * The maximum number of centroids per subspace.
+   */
+  enum { MaxCentroidCount = 256 };
+
+  /**
+   * Creates an empty product quantizer.
+   */
+  PiiProductQuantizer();
+  PiiProductQuantizer(const PiiProductQuantizer& other);
+  ~PiiProductQuantizer();
+  PiiProductQuantizer& operator= (const PiiProductQuantizer& other);
+
+  /**
+   * Trains the code books. Removes all previously encoded vectors.
+   *
+   * @param samples training samples
+   *
+   * @param subspaceCount the number of subspaces. The features are
+   * divided as evenly as possible. Clamped to [1, featureCount].
+   *
+   * @param centroidCount the number of centroids per subspace. At
+   * most [MaxCentroidCount]. If there are less training samples, each
+   * of them will be used as a centroid.
+   *
+   * @param maxTrainingSamples if *samples* is larger than this,
+   * k-means is run on a random subset of this size.
+   *
+   * @param maxIterations the maximum number of k-means iterations.
+   */
+  void train(const SampleSet& samples,
+             int subspaceCount,
+             int centroidCount = MaxCentroidCount,
+             int maxTrainingSamples = 65536,
+             int maxIterations = 20);
+
+  /**
+   * Encodes *samples* using the trained code books and replaces all
+   * previously encoded vectors. Each sample is replaced by the
+   * closest centroid in each subspace in squared geometric distance.
+   */
+  void encode(const SampleSet& samples);
+
+  /**
+   * Encodes *samples* in parallel. See [encode()].
+   */
+  void encode(const Pii::ParallelExecution& policy, const SampleSet& samples);
+
+  /**
+   * Returns `true` if the code books have not been trained.
+   */
+  bool isEmpty() const;
+
+  /**
+   * Returns the number of encoded vectors.
+   */
+  int codeCount() const;
+
+  /**
+   * Returns the number of features in the original vectors.
+   */
+  int featureCount() const;
+
+  /**
+   * Returns the number of subspaces.
+   */
+  int subspaceCount() const;
+
+  /**
+   * Returns the number of centroids per subspace.
+   */
+  int centroidCount() const;
+
+  /**
+   * Returns the index of the first feature in *subspace*.
+   */
+  int subspaceStart(int subspace) const;
+
+  /**
+   * Returns the number of features in *subspace*.
+   */
+  int subspaceLength(int subspace) const;
+
+  /**
+   * Returns the centroids of *subspace*.
+   */
+  SampleSet centroids(int subspace) const;
+
+  /**
+   * Returns the codes. Each row holds the centroid indices of one
+   * vector, one column per subspace.
+   */
+  PiiMatrix<unsigned char> codes() const;
+
+  /**
+   * Writes the approximation of the encoded vector at *index* to
+   * *features*, which must have room for [featureCount()] values.
+   */
+  void decode(int index, FeatureIterator features) const;
+
+  /**
+   * Returns a table of distances from *sample* to the centroids.
+   * Row *m* contains the distances from the features of *sample* in
+   * subspace *m* to each of the centroids of the subspace. The
+   * matrix has [subspaceCount()] rows and [centroidCount()] columns.
+   */
+  template <class DistanceMeasure>
+  PiiMatrix<double> distanceTable(ConstFeatureIterator sample,
+                                  const DistanceMeasure& measure) const;
+
+  /**
+   * Returns the approximate distance to the encoded vector at *index*
+   * using a table returned by [distanceTable()].
+   */
+  double distance(const PiiMatrix<double>& table, int index) const;
+
+  /**
+   * Returns the index of the encoded vector closest to *sample* in
+   * approximate distance, or -1 if there are no encoded vectors.
+   *
+   * @param distance an optional output-value argument that will store
+   * the approximate distance to the closest vector.
+   */
+  template <class DistanceMeasure>
+  int findClosestMatch(ConstFeatureIterator sample,
+                       const DistanceMeasure& measure,
+                       double* distance = 0) const;
+
+  /**
+   * Returns the *n* encoded vectors closest to *sample* in
+   * approximate distance, in ascending order of distance.
+   */
+  template <class DistanceMeasure>
+  PiiClassification::MatchList findClosestMatches(ConstFeatureIterator sample,
+                                                  const DistanceMeasure& measure,
+                                                  int n) const;
+
+private:
+  class Data : public PiiSharedD<Data>
+  {
+  public:
+    Data() : iFeatureCount(0) {}
+    Data(const Data& other) :
+      iFeatureCount(other.iFeatureCount),
+      vecSubspaceStarts(other.vecSubspaceStarts),
+      lstCodebooks(other.lstCodebooks),
+      matCodes(other.matCodes)
+    {}
+
+    int iFeatureCount;
+    // Subspace m covers features [starts[m], starts[m+1]).
+    QVector<int> vecSubspaceStarts;
+    QList<SampleSet> lstCodebooks;
+    PiiMatrix<unsigned char> matCodes;
+  } *d;
+
+  bool allocateCodes(const SampleSet& samples);
+  void encodeRange(const SampleSet& samples, int firstSample, int sampleCount,
+                   unsigned char* codes, std::size_t stride) const;
+
+  struct EncodeBand
+  {
+    EncodeBand(const PiiProductQuantizer* quantizer, const SampleSet& samples,
+               PiiMatrix<unsigned char>& codes) :
+      quantizer(quantizer), samples(samples), codeRows(codes)
+    {}
+
+    void operator() (int firstSample, int sampleCount)
+    {
+      quantizer->encodeRange(samples, firstSample, sampleCount,
+                             codeRows.row(firstSample), codeRows.stride());
+    }
+
+    const PiiProductQuantizer* quantizer;
+    const SampleSet& samples;
+    const Pii::BandRows<unsigned char> codeRows;
+  };
+};
+
+#include "PiiProductQuantizer-templates.h"
+
+#endif //_PIIPRODUCTQUANTIZER_H
@@ -47,6 +47,7 @@ namespace PiiSampleSet
     typedef T FeatureType;
     typedef T* FeatureIterator;
     typedef const T* ConstFeatureIterator;
+    typedef typename PiiMatrix<T>::const_column_iterator ConstColumnIterator;
 
     static PiiMatrix<T> create(int sampleCount, int featureCount) { return PiiMatrix<T>(sampleCount, featureCount); }
   };
@@ -134,6 +135,33 @@ namespace PiiSampleSet
     samples.removeRow(index);
   }
 
+  /**
+   * Returns an iterator to the value of *feature* in the first
+   * sample. The iterator goes through the values of the feature in
+   * all samples without copying them.
+   *
+   * ~~~(c++)
+   * typedef typename PiiSampleSet::Traits<SampleSet>::ConstColumnIterator ColumnIterator;
+   * double dSum = 0;
+   * for (ColumnIterator it = PiiSampleSet::columnBegin(samples, 2);
+   *      it != PiiSampleSet::columnEnd(samples, 2); ++it)
+   *   dSum += *it;
+   * ~~~
+   */
+  template <class T>
+  inline typename PiiMatrix<T>::const_column_iterator columnBegin(const PiiMatrix<T>& samples, int feature)
+  {
+    return samples.columnBegin(feature);
+  }
+  /**
+   * Returns an iterator past the last value of *feature*.
+   */
+  template <class T>
+  inline typename PiiMatrix<T>::const_column_iterator columnEnd(const PiiMatrix<T>& samples, int feature)
+  {
+    return samples.columnEnd(feature);
+  }
+
   /**
    * Returns `true` if *set1* is equal to *set2*, and `false`
    * otherwise.
@@ -22,6 +22,11 @@
  * A learning algorithm that just collects all incoming data into a
  * sample set.
  *
+ * Growing a PiiMatrix requires reallocation and copying all samples
+ * collected so far. To collect a large number of samples, use
+ * PiiChunkedSampleSet, which never moves stored samples. It can also
+ * store the features in a smaller type.
+ *
  */
 template <class SampleSet> class PiiSampleSetCollector :
   public PiiLearningAlgorithm<SampleSet>
@@ -396,10 +401,7 @@ double PiiSampleSetCollector<SampleSet>::learnOne(ConstFeatureIterator featureVe
   // There is still room in the batch -> append a new row
   if (d->iBatchSize < 0 || iSampleCount < d->iBatchSize)
     {
-      // Allocate room for at most 64 samples each time.
-      if (PiiSampleSet::capacity(sampleSet) == iSampleCount)
-        PiiSampleSet::reserve(sampleSet, qBound(1, iSampleCount*2, iSampleCount + 64));
-
+      // The sample set takes care of allocating more room.
       PiiSampleSet::append(sampleSet, featureVector);
 
       if (d->bCollectLabels)
@@ -472,7 +474,7 @@ template <class SampleSet> void PiiSampleSetCollector<SampleSet>::resize(int sam
   if (d->pvecLabels != 0)
     d->pvecLabels->resize(samples);
   if (d->pvecWeights != 0)
-    d->pvecLabels->resize(samples);
+    d->pvecWeights->resize(samples);
 }
 
 #endif //_PIISAMPLESETCOLLECTOR_H
@@ -85,7 +85,7 @@ template <class SampleSet> double PiiSom<SampleSet>::findMostDistantNeighbor(int
   const PII_D;
   const int iSamples = this->sampleCount(), iFeatures = this->featureCount();
   if (iSamples < d->iSizeX * d->iSizeY)
-    return QVector<double>(iSamples, -1);
+    return -1;
 
   int hX = vector1Index % d->iSizeX;
   int hY = vector1Index / d->iSizeX;
@@ -151,6 +151,14 @@ template <class SampleSet> void PiiSom<SampleSet>::setIterationNumber(int index)
 }
 
 template <class SampleSet> void PiiSom<SampleSet>::learn(const SampleSet& samples,
+                                                         const QVector<double>& labels,
+                                                         const QVector<double>& weights)
+{
+  learn(Pii::ParallelExecution(), samples, labels, weights);
+}
+
+template <class SampleSet> void PiiSom<SampleSet>::learn(const Pii::ParallelExecution& policy,
+                                                         const SampleSet& samples,
                                                          const QVector<double>& /*labels*/,
                                                          const QVector<double>& /*weights*/)
 {
@@ -189,6 +197,12 @@ template <class SampleSet> void PiiSom<SampleSet>::learn(const SampleSet& sample
         }
     }
 
+  if (d->algorithm == PiiClassification::SomBatchAlgorithm)
+    {
+      learnBatch(policy, samples);
+      return;
+    }
+
   while (true)
     {
       for (int i=0; i<iSamples; ++i)
@@ -294,6 +308,7 @@ template <class SampleSet> void PiiSom<SampleSet>::adaptNeighborhood(int hitX, i
   switch (d->algorithm)
     {
     case PiiClassification::SomSequentialAlgorithm:
+    case PiiClassification::SomBatchAlgorithm:
       alpha = currentLearningRate();
       break;
 
@@ -355,42 +370,107 @@ template <class SampleSet> void PiiSom<SampleSet>::adaptNeighborhood(int hitX, i
       break;
     }
 
-  const int iModels = this->modelCount();
+  const int iModels = this->modelCount(), iHitIndex = hitY * d->iSizeX + hitX;
   for (int index=0; index < iModels; ++index)
     {
-      // current x,y
-      int tX = index % d->iSizeX;
-      int tY = index / d->iSizeX;
-
-      //distance to the current node at (hitX, hitY)
-      double distance = d->topology == PiiClassification::SomHexagonal ?
-        PiiClassification::somHexagonalDistance(hitX, hitY, tX, tY) :
-        PiiClassification::somSquareDistance(hitX, hitY, tX, tY);
-
-      /* Note that radius is squared! somXXXDistance functions return
-       * a squared distance as well.
-       */
-      switch (d->neighborhood)
-        {
-        case PiiClassification::SomBubble:
-          // Bubble neighborhood equally adapts all vectors within the
-          // current radius
-          if (distance <= radius)
-            PiiClassification::adaptVector(this->modelAt(index), vector, iFeatures, alpha);
-          break;
-        case PiiClassification::SomGaussian:
-          // Gaussian updates all vectors, and weights the update with
-          // a Gaussian function.
-          PiiClassification::adaptVector(this->modelAt(index), vector, iFeatures,
-                                    alpha*std::exp(-distance/(2*radius)));
-          break;
-        case PiiClassification::SomCutGaussian:
-          // Combination of the two above.
-          if (distance <= radius)
-            PiiClassification::adaptVector(this->modelAt(index), vector, iFeatures,
-                                      alpha*std::exp(-distance/(2*radius)));
-          break;
-        }
+      double dWeight = neighborhoodWeight(iHitIndex, index, radius);
+      if (dWeight != 0)
+        PiiClassification::adaptVector(this->modelAt(index), vector, iFeatures, alpha * dWeight);
+    }
+}
+
+/*
+ * Returns the weight of the node at *nodeIndex* in the neighborhood
+ * of the node at *hitIndex*. Note that the radius is squared.
+ */
+template <class SampleSet> double PiiSom<SampleSet>::neighborhoodWeight(int hitIndex,
+                                                                        int nodeIndex,
+                                                                        double squaredRadius) const
+{
+  const PII_D;
+  const int hitX = hitIndex % d->iSizeX, hitY = hitIndex / d->iSizeX;
+  const int tX = nodeIndex % d->iSizeX, tY = nodeIndex / d->iSizeX;
+
+  // somXXXDistance functions return a squared distance as well.
+  double distance = d->topology == PiiClassification::SomHexagonal ?
+    PiiClassification::somHexagonalDistance(hitX, hitY, tX, tY) :
+    PiiClassification::somSquareDistance(hitX, hitY, tX, tY);
+
+  switch (d->neighborhood)
+    {
+    case PiiClassification::SomBubble:
+      // Bubble neighborhood equally adapts all vectors within the
+      // current radius
+      return distance <= squaredRadius ? 1.0 : 0.0;
+    case PiiClassification::SomGaussian:
+      // Gaussian updates all vectors, and weights the update with
+      // a Gaussian function.
+      return std::exp(-distance/(2*squaredRadius));
+    case PiiClassification::SomCutGaussian:
+      // Combination of the two above.
+      return distance <= squaredRadius ? std::exp(-distance/(2*squaredRadius)) : 0.0;
+    }
+  return 0.0;
+}
+
+/*
+ * Batch SOM. On each epoch, the best matching units of all samples
+ * are first found in parallel. The samples are then grouped by their
+ * best matching units, and the sum of the samples in each group is
+ * calculated. Finally, each code vector is replaced by a
+ * neighborhood-weighted mean of the groups. Each step is parallelized
+ * so that the summation order does not depend on the number of
+ * threads.
+ */
+template <class SampleSet> void PiiSom<SampleSet>::learnBatch(const Pii::ParallelExecution& policy,
+                                                              const SampleSet& samples)
+{
+  PII_D;
+  const int iSamples = PiiSampleSet::sampleCount(samples),
+    iFeatures = PiiSampleSet::featureCount(samples),
+    iModels = this->modelCount();
+  if (iModels == 0 || iFeatures != this->featureCount())
+    return;
+
+  // Fetching the iterators detaches the code book before the
+  // parallel loops.
+  QVector<FeatureIterator> vecModels(iModels);
+  for (int k=0; k<iModels; ++k)
+    vecModels[k] = this->modelAt(k);
+
+  QVector<int> vecBestMatches(iSamples), vecOrder(iSamples);
+  QVector<int> vecCounts(iModels), vecOffsets(iModels + 1), vecPositions(iModels);
+  QVector<double> vecSums(iModels * iFeatures);
+
+  while (!converged())
+    {
+      const double dRadius = currentRadius();
+      Pii::forEachBand(policy, iSamples, 0,
+                       BestMatchBand(this, samples, vecBestMatches.data()));
+
+      // Counting sort by the best matching unit retains the order of
+      // samples within each node.
+      vecCounts.fill(0);
+      for (int i=0; i<iSamples; ++i)
+        if (vecBestMatches[i] >= 0)
+          ++vecCounts[vecBestMatches[i]];
+      vecOffsets[0] = 0;
+      for (int k=0; k<iModels; ++k)
+        vecOffsets[k+1] = vecOffsets[k] + vecCounts[k];
+      for (int k=0; k<iModels; ++k)
+        vecPositions[k] = vecOffsets[k];
+      for (int i=0; i<iSamples; ++i)
+        if (vecBestMatches[i] >= 0)
+          vecOrder[vecPositions[vecBestMatches[i]]++] = i;
+
+      Pii::forEachBand(policy, iModels, 0,
+                       NodeSumBand(samples, vecOrder.constData(), vecOffsets.constData(), vecSums.data()));
+      Pii::forEachBand(policy, iModels, 0,
+                       SmoothBand(this, vecSums.constData(), vecCounts.constData(),
+                                  vecModels.data(), iFeatures, dRadius * dRadius));
+
+      d->iIterationNumber = int(qMin(qint64(d->iIterationNumber) + iSamples, qint64(d->iLearningLength)));
+      PII_TRY_CONTINUE(this->controller(), double(d->iIterationNumber)/d->iLearningLength);
     }
 }
 
@@ -21,6 +21,7 @@
 #include "PiiLearningAlgorithm.h"
 
 #include <QVector>
+#include <PiiParallel.h>
 
 /**
  * An implementation of the self-organizing map (Kohonen map).
@@ -39,6 +40,13 @@
  * learning parameters. The class modifies a code book that is given
  * upon construction of the class.
  *
+ * With the batch algorithm (see [setLearningAlgorithm()]), the
+ * whole training set is processed on each epoch. Each code vector
+ * is replaced by a mean of the samples, weighted by the
+ * neighborhood function of their best matching units. The result
+ * does not depend on the order of samples, and the best matching
+ * units are searched in parallel. The learning rate is not used.
+ *
  * In classification, the SOM works as a vector quantizer.
  *
  */
@@ -76,6 +84,30 @@ public:
              const QVector<double>& labels,
              const QVector<double>& weights = QVector<double>());
 
+  /**
+   * Trains the SOM with a batch of samples using *policy* to
+   * parallelize the batch algorithm. With the sequential algorithms,
+   * this function works as the non-parallel version.
+   *
+   * Each epoch of the batch algorithm processes all *samples* and
+   * increases [iterationNumber()] by their number. The number of
+   * epochs is thus determined by [learningLength()] divided by the
+   * number of samples. The result is independent of the number of
+   * threads.
+   *
+   * ~~~(c++)
+   * PiiSom<PiiMatrix<float> > som(20, 20);
+   * som.setLearningAlgorithm(PiiClassification::SomBatchAlgorithm);
+   * // Ten epochs
+   * som.setLearningLength(10 * matSamples.rows());
+   * som.learn(Pii::ParallelExecution(), matSamples, QVector<double>());
+   * ~~~
+   */
+  void learn(const Pii::ParallelExecution& policy,
+             const SampleSet& samples,
+             const QVector<double>& labels,
+             const QVector<double>& weights = QVector<double>());
+
   /**
    * Train the SOM with the given feature vector.
    *
@@ -228,7 +260,8 @@ public:
   PiiClassification::SomLearningAlgorithm learningAlgorithm() const;
 
   /**
-   * Set the learning algorithm
+   * Set the learning algorithm. The default is
+   * `PiiClassification::SomSequentialAlgorithm`.
    */
   void setLearningAlgorithm(PiiClassification::SomLearningAlgorithm algorithm);
 
@@ -277,6 +310,105 @@ private:
 
   int adaptTo(ConstFeatureIterator vector);
   void adaptNeighborhood(int hitX, int hitY, ConstFeatureIterator vector, double distance);
+  double neighborhoodWeight(int hitIndex, int nodeIndex, double squaredRadius) const;
+  void learnBatch(const Pii::ParallelExecution& policy, const SampleSet& samples);
+
+  typedef typename PiiSampleSet::Traits<SampleSet>::FeatureIterator FeatureIterator;
+
+  // Finds the best matching unit for each sample.
+  struct BestMatchBand
+  {
+    BestMatchBand(const PiiSom* som, const SampleSet& samples, int* bestMatches) :
+      som(som), samples(samples), bestMatches(bestMatches)
+    {}
+
+    void operator() (int firstSample, int sampleCount)
+    {
+      const SampleSet& models = som->_d()->modelSet;
+      for (int i=firstSample; i<firstSample+sampleCount; ++i)
+        bestMatches[i] = PiiClassification::findClosestMatch(PiiSampleSet::sampleAt(samples, i),
+                                                             models, *som->_d()->pMeasure);
+    }
+
+    const PiiSom* som;
+    const SampleSet& samples;
+    int* bestMatches;
+  };
+
+  // Sums up the samples mapped to each node in sample order.
+  struct NodeSumBand
+  {
+    NodeSumBand(const SampleSet& samples, const int* order, const int* offsets, double* sums) :
+      samples(samples), order(order), offsets(offsets), sums(sums)
+    {}
+
+    void operator() (int firstNode, int nodeCount)
+    {
+      const int iFeatures = PiiSampleSet::featureCount(samples);
+      for (int k=firstNode; k<firstNode+nodeCount; ++k)
+        {
+          double* pSum = sums + k * iFeatures;
+          std::fill(pSum, pSum + iFeatures, 0.0);
+          for (int i=offsets[k]; i<offsets[k+1]; ++i)
+            {
+              ConstFeatureIterator sample = PiiSampleSet::sampleAt(samples, order[i]);
+              for (int f=0; f<iFeatures; ++f)
+                pSum[f] += sample[f];
+            }
+        }
+    }
+
+    const SampleSet& samples;
+    const int* order;
+    const int* offsets;
+    double* sums;
+  };
+
+  // Replaces each code vector with a neighborhood-weighted mean.
+  struct SmoothBand
+  {
+    SmoothBand(const PiiSom* som, const double* sums, const int* counts,
+               FeatureIterator* models, int featureCount, double squaredRadius) :
+      som(som), sums(sums), counts(counts), models(models),
+      featureCount(featureCount), squaredRadius(squaredRadius)
+    {}
+
+    void operator() (int firstNode, int nodeCount)
+    {
+      typedef typename PiiSampleSet::Traits<SampleSet>::FeatureType T;
+      const int iModels = som->modelCount();
+      QVector<double> vecMean(featureCount);
+      double* pMean = vecMean.data();
+      for (int j=firstNode; j<firstNode+nodeCount; ++j)
+        {
+          std::fill(pMean, pMean + featureCount, 0.0);
+          double dWeightSum = 0;
+          for (int k=0; k<iModels; ++k)
+            {
+              if (counts[k] == 0)
+                continue;
+              const double dWeight = som->neighborhoodWeight(k, j, squaredRadius);
+              if (dWeight == 0)
+                continue;
+              dWeightSum += dWeight * counts[k];
+              const double* pSum = sums + k * featureCount;
+              for (int f=0; f<featureCount; ++f)
+                pMean[f] += dWeight * pSum[f];
+            }
+          // Nodes with no samples in their neighborhood are retained.
+          if (dWeightSum > 0)
+            for (int f=0; f<featureCount; ++f)
+              models[j][f] = T(pMean[f] / dWeightSum);
+        }
+    }
+
+    const PiiSom* som;
+    const double* sums;
+    const int* counts;
+    FeatureIterator* models;
+    int featureCount;
+    double squaredRadius;
+  };
 };
 
 namespace PiiClassification
@@ -17,6 +17,7 @@
 #define _PIISQUAREDGEOMETRICDISTANCE_H
 
 #include "PiiDistanceMeasure.h"
+#include "PiiDistanceKernels.h"
 
 /**
  * Squared geometric distance. The squared geometric distance is
@@ -39,4 +40,6 @@ PII_DEFAULT_DISTANCE_MEASURE_DEF(PiiSquaredGeometricDistance)
   return sum;
 }
 
+PII_VECTORIZED_BOUNDED_DISTANCE_MEASURES(PiiSquaredGeometricDistance, squaredGeometricDistance)
+
 #endif //_PIISQUAREDGEOMETRICDISTANCE_H
@@ -24,14 +24,16 @@
 template <class SampleSet>
 PiiVectorQuantizer<SampleSet>::Data::Data() :
   pMeasure(new PII_POLYMORPHIC_MEASURE(PiiSquaredGeometricDistance)),
-  dRejectThreshold(INFINITY)
+  dRejectThreshold(INFINITY),
+  iRerankCount(0)
 {
 }
 
 template <class SampleSet>
 PiiVectorQuantizer<SampleSet>::Data::Data(PiiDistanceMeasure<ConstFeatureIterator>* measure) :
+  pMeasure(measure),
   dRejectThreshold(INFINITY),
-  pMeasure(measure)
+  iRerankCount(0)
 {
 }
 
@@ -78,6 +80,43 @@ PiiDistanceMeasure<typename PiiSampleSet::Traits<SampleSet>::ConstFeatureIterato
 template <class SampleSet> void PiiVectorQuantizer<SampleSet>::setModels(const SampleSet& models)
 {
   d->modelSet = models;
+  d->quantizer = PiiProductQuantizer<SampleSet>();
+}
+
+template <class SampleSet> void PiiVectorQuantizer<SampleSet>::compressModels(int subspaceCount, bool keepModels)
+{
+  const SampleSet& models = d->modelSet;
+  d->quantizer.train(models, subspaceCount);
+  d->quantizer.encode(Pii::ParallelExecution(), models);
+  if (!keepModels && !d->quantizer.isEmpty())
+    d->modelSet = PiiSampleSet::create<SampleSet>(0, PiiSampleSet::featureCount(models));
+}
+
+template <class SampleSet> bool PiiVectorQuantizer<SampleSet>::isCompressed() const
+{
+  return !d->quantizer.isEmpty();
+}
+
+template <class SampleSet>
+PiiProductQuantizer<SampleSet> PiiVectorQuantizer<SampleSet>::productQuantizer() const
+{
+  return d->quantizer;
+}
+
+template <class SampleSet>
+void PiiVectorQuantizer<SampleSet>::setProductQuantizer(const PiiProductQuantizer<SampleSet>& quantizer)
+{
+  d->quantizer = quantizer;
+}
+
+template <class SampleSet> void PiiVectorQuantizer<SampleSet>::setRerankCount(int rerankCount)
+{
+  d->iRerankCount = rerankCount;
+}
+
+template <class SampleSet> int PiiVectorQuantizer<SampleSet>::rerankCount() const
+{
+  return d->iRerankCount;
 }
 
 template <class SampleSet> SampleSet& PiiVectorQuantizer<SampleSet>::models()
@@ -104,11 +143,15 @@ typename PiiSampleSet::Traits<SampleSet>::ConstFeatureIterator PiiVectorQuantize
 
 template <class SampleSet> int PiiVectorQuantizer<SampleSet>::modelCount() const
 {
+  if (!d->quantizer.isEmpty())
+    return d->quantizer.codeCount();
   return PiiSampleSet::sampleCount(d->modelSet);
 }
 
 template <class SampleSet> int PiiVectorQuantizer<SampleSet>::featureCount() const
 {
+  if (!d->quantizer.isEmpty())
+    return d->quantizer.featureCount();
   return PiiSampleSet::featureCount(d->modelSet);
 }
 
@@ -130,10 +173,35 @@ template <class SampleSet> int PiiVectorQuantizer<SampleSet>::findClosestMatch(C
                                                                                double* distance) const throw()
 {
   *distance = INFINITY;
-  int iBestMatch = PiiClassification::findClosestMatch(features,
-                                                       const_cast<const SampleSet&>(d->modelSet),
-                                                       *d->pMeasure,
-                                                       distance);
+  int iBestMatch;
+  if (d->quantizer.isEmpty())
+    iBestMatch = PiiClassification::findClosestMatch(features,
+                                                     const_cast<const SampleSet&>(d->modelSet),
+                                                     *d->pMeasure,
+                                                     distance);
+  else if (d->iRerankCount > 0 &&
+           PiiSampleSet::sampleCount(d->modelSet) == d->quantizer.codeCount())
+    {
+      // Calculate exact distances to the best approximate matches.
+      PiiClassification::MatchList lstCandidates =
+        d->quantizer.findClosestMatches(features, *d->pMeasure, d->iRerankCount);
+      const int iFeatures = d->quantizer.featureCount();
+      iBestMatch = -1;
+      for (int i=0; i<lstCandidates.size(); ++i)
+        {
+          const int iIndex = lstCandidates[i].second;
+          double dDistance = PiiClassification::boundedDistance(*d->pMeasure, features,
+                                                                PiiSampleSet::sampleAt(const_cast<const SampleSet&>(d->modelSet), iIndex),
+                                                                iFeatures, *distance);
+          if (dDistance < *distance || (dDistance == *distance && iIndex < iBestMatch))
+            {
+              *distance = dDistance;
+              iBestMatch = iIndex;
+            }
+        }
+    }
+  else
+    iBestMatch = d->quantizer.findClosestMatch(features, *d->pMeasure, distance);
   // Return the index of the closest code vector or -1, if the sample
   // is rejected.
   return *distance <= d->dRejectThreshold ? iBestMatch : -1;
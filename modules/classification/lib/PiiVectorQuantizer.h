@@ -19,6 +19,7 @@
 #include <Pii.h>
 #include "PiiDistanceMeasure.h"
 #include "PiiClassifier.h"
+#include "PiiProductQuantizer.h"
 
 /**
  * A vector quantizer. Vector quantization is perhaps the most
@@ -29,6 +30,10 @@
  * terms of a [classification_distance_measures] "distance
  * measure".
  *
+ * Large code books can be stored in a compressed form with product
+ * quantization (see [compressModels()]). Closest matches are then
+ * found using approximate distances, optionally refined by
+ * calculating exact distances to the best candidates.
  */
 template <class SampleSet> class PiiVectorQuantizer :
   public PiiClassifier<SampleSet>
@@ -109,6 +114,68 @@ public:
    */
   void setModels(const SampleSet& models);
 
+  /**
+   * Compresses the model set using a product quantizer. The feature
+   * space is split into *subspaceCount* subspaces, and each model is
+   * stored as one byte per subspace. After compression,
+   * [findClosestMatch()] uses approximate distances calculated with
+   * the current distance measure, which must be a sum over features
+   * (e.g. PiiSquaredGeometricDistance or PiiAbsDiffDistance).
+   *
+   * @param subspaceCount the number of subspaces. Larger values
+   * improve accuracy but take more memory.
+   *
+   * @param keepModels if `false`, the original models will be
+   * released after compression. Otherwise they are retained and can
+   * be used for re-ranking (see [setRerankCount()]).
+   *
+   * ~~~(c++)
+   * PiiVectorQuantizer<PiiMatrix<float> > vq;
+   * vq.setModels(matCodeBook);
+   * matCodeBook = PiiMatrix<float>();
+   * // 128 features -> 16 bytes per model
+   * vq.compressModels(16);
+   * int iIndex = vq.findClosestMatch(sample, &dDistance);
+   * ~~~
+   *
+   * ! [models()] and [modelAt()] are available only if the models
+   * were kept. Changing the models in place does not update the
+   * compressed codes. PiiKnnClassifier does not use the compressed
+   * form.
+   */
+  void compressModels(int subspaceCount, bool keepModels = false);
+
+  /**
+   * Returns `true` if the models have been compressed with
+   * [compressModels()] or [setProductQuantizer()].
+   */
+  bool isCompressed() const;
+
+  /**
+   * Returns the product quantizer that holds the compressed models.
+   */
+  PiiProductQuantizer<SampleSet> productQuantizer() const;
+
+  /**
+   * Sets a trained and encoded product quantizer that holds the
+   * compressed models. The current model set is retained. Setting an
+   * empty quantizer disables compression.
+   */
+  void setProductQuantizer(const PiiProductQuantizer<SampleSet>& quantizer);
+
+  /**
+   * Sets the number of closest approximate matches whose exact
+   * distance will be calculated. If this value is positive and the
+   * original models are available, [findClosestMatch()] returns the
+   * best of the candidates in exact distance. The default is zero.
+   */
+  void setRerankCount(int rerankCount);
+
+  /**
+   * Returns the number of re-ranked candidates.
+   */
+  int rerankCount() const;
+
   /**
    * Returns the number of model vectors in the model sample set.
    */
@@ -140,6 +207,8 @@ protected:
     SampleSet modelSet;
     PiiDistanceMeasure<ConstFeatureIterator>* pMeasure;
     double dRejectThreshold;
+    PiiProductQuantizer<SampleSet> quantizer;
+    int iRerankCount;
   } *d;
 
   /// @internal
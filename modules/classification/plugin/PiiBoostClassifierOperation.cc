@@ -21,7 +21,8 @@ PiiBoostClassifierOperation::Data::Data() :
   PiiClassifierOperation::Data(PiiClassification::WeightedLearner),
   algorithm(PiiClassification::RealBoost),
   iMaxClassifiers(100),
-  dMinError(0)
+  dMinError(0),
+  iBinCount(0)
 {
 }
 
@@ -39,3 +40,5 @@ void PiiBoostClassifierOperation::setMaxClassifiers(int maxClassifiers) { _d()->
 int PiiBoostClassifierOperation::maxClassifiers() const { return _d()->iMaxClassifiers; }
 void PiiBoostClassifierOperation::setMinError(double minError) { _d()->dMinError = minError; }
 double PiiBoostClassifierOperation::minError() const { return _d()->dMinError; }
+void PiiBoostClassifierOperation::setBinCount(int binCount) { _d()->iBinCount = binCount; }
+int PiiBoostClassifierOperation::binCount() const { return _d()->iBinCount; }
@@ -18,7 +18,7 @@
 
 #include "PiiClassifierOperation.h"
 #include "PiiBoostClassifier.h"
-#include "PiiDefaultClassifierFactory.h"
+#include "PiiDecisionStumpFactory.h"
 #include "PiiDecisionStump.h"
 #include "PiiSampleSetCollector.h"
 
@@ -52,6 +52,14 @@ class PiiBoostClassifierOperation : public PiiClassifierOperation
    */
   Q_PROPERTY(double minError READ minError WRITE setMinError);
 
+  /**
+   * The number of bins each feature is divided into when searching
+   * for the thresholds of decision stumps. Zero means that every
+   * distinct feature value will be tried. Binning makes training
+   * faster with large sample sets. The default is 0.
+   */
+  Q_PROPERTY(int binCount READ binCount WRITE setBinCount);
+
 public:
   template <class SampleSet> class Template;
 
@@ -66,6 +74,7 @@ protected:
     PiiClassification::BoostingAlgorithm algorithm;
     int iMaxClassifiers;
     double dMinError;
+    int iBinCount;
   };
   PII_D_FUNC;
   /// @internal
@@ -77,6 +86,8 @@ protected:
   int maxClassifiers() const;
   void setMinError(double minError);
   double minError() const;
+  void setBinCount(int binCount);
+  int binCount() const;
 };
 
 template <class T> struct MsvcHack
@@ -88,7 +99,7 @@ template <class T> struct MsvcHack
 /// @internal
 template <class SampleSet> class PiiBoostClassifierOperation::Template :
   public PiiBoostClassifierOperation,
-  public PiiDefaultClassifierFactory<PiiDecisionStump<SampleSet> >
+  public PiiDecisionStumpFactory<SampleSet>
 {
   friend struct PiiSerialization::Accessor;
   PII_DECLARE_VIRTUAL_METAOBJECT_FUNCTION;
@@ -111,6 +122,7 @@ public:
 protected:
   void check(bool reset);
   double classify();
+  bool takeLearningBatch();
   bool learnBatch();
   void collectSample(double label, double weight);
   void replaceClassifier();
@@ -126,6 +138,9 @@ private:
     ~Data();
     PiiBoostClassifier<SampleSet> *pClassifier, *pNewClassifier;
     PiiSampleSetCollector<SampleSet> collector;
+    // Shallow copies of the buffer for the learning thread.
+    SampleSet learningSamples;
+    QVector<double> vecLearningLabels, vecLearningWeights;
   };
   PII_D_FUNC;
 
@@ -136,6 +151,7 @@ private:
     PiiBoostClassifier<SampleSet>* pClassifier = new PiiBoostClassifier<SampleSet>(this, d->algorithm);
     pClassifier->setMaxClassifiers(d->iMaxClassifiers);
     pClassifier->setMinError(d->dMinError);
+    this->PiiDecisionStumpFactory<SampleSet>::setBinCount(d->iBinCount);
     return pClassifier;
   }
 };
@@ -193,14 +209,27 @@ void PiiBoostClassifierOperation::Template<SampleSet>::collectSample(double labe
   PiiClassifierOperation::learnOne(d->collector, label, weight);
 }
 
+template <class SampleSet> bool PiiBoostClassifierOperation::Template<SampleSet>::takeLearningBatch()
+{
+  PII_D;
+  d->learningSamples = *d->collector.samples();
+  d->vecLearningLabels = *d->collector.classLabels();
+  d->vecLearningWeights = *d->collector.sampleWeights();
+  return true;
+}
+
 template <class SampleSet> bool PiiBoostClassifierOperation::Template<SampleSet>::learnBatch()
 {
   PII_D;
   d->pNewClassifier = createClassifier();
   bool bSuccess = PiiClassifierOperation::learnBatch(*d->pNewClassifier,
-                                                     *d->collector.samples(),
-                                                     *d->collector.classLabels(),
-                                                     *d->collector.sampleWeights());
+                                                     d->learningSamples,
+                                                     d->vecLearningLabels,
+                                                     d->vecLearningWeights);
+  // Release the snapshot so that the buffer doesn't need to detach.
+  d->learningSamples = SampleSet();
+  d->vecLearningLabels.clear();
+  d->vecLearningWeights.clear();
   if (!bSuccess)
     {
       delete d->pNewClassifier;
@@ -23,7 +23,8 @@ PiiClassifierOperation::Data::Data(PiiClassification::LearnerCapabilities cap) :
   fullBufferBehavior(PiiClassification::OverwriteRandomSample),
   dProgressStep(0.01),
   dCurrentProgress(0),
-  bThreadRunning(false)
+  bThreadRunning(false),
+  bBatchTaken(false)
 {
 }
 
@@ -95,8 +96,8 @@ void PiiClassifierOperation::process()
 
   // Collect samples for training only if requested (by setting batch
   // size to a non-zero value) and if the learning thread is not
-  // already running.
-  if (d->iLearningBatchSize != 0 && !d->pLearningThread->isRunning())
+  // using the buffer.
+  if (d->iLearningBatchSize != 0 && (d->bBatchTaken || !d->pLearningThread->isRunning()))
     {
       double dInputLabel = readLabel();
       double dInputWeight = readWeight();
@@ -104,7 +105,8 @@ void PiiClassifierOperation::process()
       // If the learner is capable of on-line learning and batch size
       // is one, send the sample directly to training.
       if (d->capabilities & PiiClassification::OnlineLearner &&
-          d->iLearningBatchSize == 1)
+          d->iLearningBatchSize == 1 &&
+          !d->pLearningThread->isRunning())
         {
           learnOne(dInputLabel, dInputWeight);
           return;
@@ -119,16 +121,20 @@ void PiiClassifierOperation::process()
 
 bool PiiClassifierOperation::learningThread()
 {
-  _d()->strLearningError.clear();
+  PII_D;
+  d->strLearningError.clear();
 
-  if (learnBatch())
+  bool bSuccess = learnBatch();
+  QMutexLocker lock(&d->learningMutex);
+  d->bBatchTaken = false;
+  if (bSuccess)
     {
-      QMutexLocker lock(&_d()->learningMutex);
       replaceClassifier();
       emit progressed(1.0);
       emit learningFinished(true);
       return true;
     }
+  lock.unlock();
   emit learningFinished(false);
   return false;
 }
@@ -166,6 +172,7 @@ bool PiiClassifierOperation::startLearningThread(bool startThread)
     }
 
   d->bThreadRunning = true;
+  d->bBatchTaken = takeLearningBatch();
 
   if (startThread)
     d->pLearningThread->start();
@@ -263,4 +270,5 @@ bool PiiClassifierOperation::learningThreadRunning() const { return _d()->pLearn
 QString PiiClassifierOperation::learningError() const { return _d()->strLearningError; }
 void PiiClassifierOperation::setLearningError(const QString& learningError) { _d()->strLearningError = learningError; }
 bool PiiClassifierOperation::learnBatch() { return false; }
+bool PiiClassifierOperation::takeLearningBatch() { return false; }
 void PiiClassifierOperation::finishOnlineLearning() {}
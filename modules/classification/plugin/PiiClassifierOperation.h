@@ -112,6 +112,14 @@ namespace PiiClassification
  * training. If you want to avoid this, [reset](reset()) the old
  * classifier before learning.
  *
+ * If the operation supports it (see [takeLearningBatch()]), incoming
+ * samples are collected to the buffer while the learning thread is
+ * running. The learning thread works on a snapshot of the buffer
+ * taken when the thread was started. Since sample sets are
+ * implicitly shared, taking the snapshot copies no samples. The
+ * buffer is copied only once, when the first new sample arrives
+ * during learning.
+ *
  * Inputs
  * ------
  *
@@ -349,6 +357,7 @@ protected:
     QThread* pLearningThread;
     QMutex learningMutex;
     bool bThreadRunning;
+    bool bBatchTaken;
     QString strLearningError;
   };
   PII_D_FUNC;
@@ -384,8 +393,9 @@ protected:
   /**
    * Classifies an incoming feature vector (see [classify()]). If
    * [learningBatchSize] is set to a non-zero value, and if the
-   * learning thread is not running, collects the incoming sample to a
-   * buffer (see [collectSample()]). If [learningBatchSize] is set to
+   * learning thread is not running or works on a snapshot of the
+   * buffer, collects the incoming sample to a buffer (see
+   * [collectSample()]). If [learningBatchSize] is set to
    * one and the learning algorithm is capable of on-line learning,
    * the incoming sample will be sent directly to learning (see
    * [learnOne()]).
@@ -423,6 +433,23 @@ protected:
    */
   virtual bool learnBatch();
 
+  /**
+   * Takes a snapshot of the buffered samples for [learnBatch()].
+   * This function is called with the buffer locked just before
+   * learning starts. If the function returns `true`, [learnBatch()]
+   * must only use the snapshot, and [process()] continues to collect
+   * samples while learning is in progress. If the function returns
+   * `false`, samples received during learning are classified but not
+   * collected.
+   *
+   * The snapshot should be a shallow copy of the implicitly shared
+   * sample set, labels and weights. The buffer will then detach
+   * itself from the snapshot when it is modified.
+   *
+   * The default implementation returns `false`.
+   */
+  virtual bool takeLearningBatch();
+
   /**
    * Replaces the current classifier with a newly trained one. This
    * function is called if [learnBatch()] returns `true`. If the
@@ -16,9 +16,14 @@
 #include "PiiDistributionNormalizer.h"
 #include <PiiYdinTypes.h>
 #include <PiiMath.h>
+#include <PiiInvalidArgumentException.h>
+#include <QMutexLocker>
 
 PiiDistributionNormalizer::Data::Data() :
-  bDoubleMode(false)
+  bDoubleMode(false),
+  normalizationMode(NormalizeSum),
+  bLearningEnabled(true),
+  bParametersValid(false)
 {
 }
 
@@ -34,6 +39,17 @@ PiiDistributionNormalizer::PiiDistributionNormalizer() :
 
 }
 
+void PiiDistributionNormalizer::check(bool reset)
+{
+  PII_D;
+  PiiDefaultOperation::check(reset);
+  if (reset && d->bLearningEnabled)
+    {
+      d->statistics.clear();
+      d->bParametersValid = false;
+    }
+}
+
 void PiiDistributionNormalizer::process()
 {
   PII_D;
@@ -52,7 +68,14 @@ template <class T> void PiiDistributionNormalizer::normalize(const PiiVariant& o
   PII_D;
   const PiiMatrix<T> features = obj.valueAs<PiiMatrix<T> >();
 
-  if (!d->pBoundaryInput->isConnected())
+  if (d->normalizationMode != NormalizeSum)
+    {
+      if (d->bDoubleMode)
+        normalizeFeatures<double>(features);
+      else
+        normalizeFeatures<float>(features);
+    }
+  else if (!d->pBoundaryInput->isConnected())
     {
       // Normalize the whole vector at once
       if (d->bDoubleMode)
@@ -104,5 +127,117 @@ template <class U, class T> void PiiDistributionNormalizer::normalizePieces(cons
   d->pFeatureOutput->emitObject(matResult);
 }
 
+template <class U, class T> void PiiDistributionNormalizer::normalizeFeatures(const PiiMatrix<T>& features)
+{
+  PII_D;
+  PiiMatrix<U> matResult(features);
+  PiiMatrix<U> matScale, matOffset;
+  try
+    {
+      // Summarize the incoming batch without holding the lock.
+      PiiFeatureStatistics batch;
+      if (d->bLearningEnabled)
+        batch.addSamples(matResult);
+
+      QMutexLocker lock(&d->statisticsMutex);
+      if (!batch.isEmpty())
+        {
+          d->statistics.merge(batch);
+          d->bParametersValid = false;
+        }
+      if (!d->bParametersValid)
+        updateParameters();
+      parameters(matScale, matOffset);
+    }
+  catch (PiiInvalidArgumentException& ex)
+    {
+      PII_THROW(PiiExecutionException, ex.message());
+    }
+
+  if (matScale.isEmpty())
+    PII_THROW(PiiExecutionException, tr("Normalization parameters have not been learned."));
+  const int iColumns = matResult.columns();
+  if (matScale.columns() != iColumns)
+    PII_THROW(PiiExecutionException, tr("Expected %1 features, got %2.").arg(matScale.columns()).arg(iColumns));
+
+  const U* pScale = matScale[0], *pOffset = matOffset[0];
+  for (int r=0; r<matResult.rows(); ++r)
+    {
+      U* pRow = matResult[r];
+      PiiClassification::multiplyAdd(pRow, pScale, pOffset, pRow, iColumns);
+    }
+  d->pFeatureOutput->emitObject(matResult);
+}
+
+void PiiDistributionNormalizer::updateParameters()
+{
+  PII_D;
+  d->bParametersValid = true;
+  const int iFeatures = d->statistics.featureCount();
+  if (d->statistics.isEmpty())
+    {
+      d->matScale = d->matOffset = PiiMatrix<double>();
+      d->matScaleFloat = d->matOffsetFloat = PiiMatrix<float>();
+      return;
+    }
+
+  // Express the normalization as x * scale + offset.
+  PiiMatrix<double> matScale(1, iFeatures), matOffset(1, iFeatures);
+  double* pScale = matScale[0], *pOffset = matOffset[0];
+  if (d->normalizationMode == NormalizeMeanVar)
+    {
+      const PiiMatrix<double> matMean(d->statistics.mean()), matVariance(d->statistics.variance());
+      for (int i=0; i<iFeatures; ++i)
+        {
+          pScale[i] = matVariance(i) > 0 ? 1.0 / Pii::sqrt(matVariance(i)) : 1.0;
+          pOffset[i] = -matMean(i) * pScale[i];
+        }
+    }
+  else
+    {
+      const PiiMatrix<double> matMin(d->statistics.min()), matMax(d->statistics.max());
+      for (int i=0; i<iFeatures; ++i)
+        {
+          const double dRange = matMax(i) - matMin(i);
+          pScale[i] = dRange > 0 ? 1.0 / dRange : 1.0;
+          pOffset[i] = -matMin(i) * pScale[i];
+        }
+    }
+  d->matScale = matScale;
+  d->matOffset = matOffset;
+  d->matScaleFloat = PiiMatrix<float>(matScale);
+  d->matOffsetFloat = PiiMatrix<float>(matOffset);
+}
+
+void PiiDistributionNormalizer::parameters(PiiMatrix<double>& scale, PiiMatrix<double>& offset) const
+{
+  const PII_D;
+  scale = d->matScale;
+  offset = d->matOffset;
+}
+
+void PiiDistributionNormalizer::parameters(PiiMatrix<float>& scale, PiiMatrix<float>& offset) const
+{
+  const PII_D;
+  scale = d->matScaleFloat;
+  offset = d->matOffsetFloat;
+}
+
 bool PiiDistributionNormalizer::doubleMode() const { return _d()->bDoubleMode; }
 void PiiDistributionNormalizer::setDoubleMode(bool mode) { _d()->bDoubleMode = mode; }
+PiiDistributionNormalizer::NormalizationMode PiiDistributionNormalizer::normalizationMode() const { return _d()->normalizationMode; }
+void PiiDistributionNormalizer::setNormalizationMode(NormalizationMode normalizationMode)
+{
+  PII_D;
+  QMutexLocker lock(&d->statisticsMutex);
+  d->normalizationMode = normalizationMode;
+  d->bParametersValid = false;
+}
+bool PiiDistributionNormalizer::learningEnabled() const { return _d()->bLearningEnabled; }
+void PiiDistributionNormalizer::setLearningEnabled(bool learningEnabled) { _d()->bLearningEnabled = learningEnabled; }
+int PiiDistributionNormalizer::sampleCount() const
+{
+  const PII_D;
+  QMutexLocker lock(&d->statisticsMutex);
+  return int(d->statistics.sampleCount());
+}
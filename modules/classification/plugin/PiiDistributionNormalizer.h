@@ -18,29 +18,42 @@
 
 #include <PiiDefaultOperation.h>
 #include <PiiMatrix.h>
+#include <QMutex>
+#include "PiiFeatureStatistics.h"
 
 /**
- * An operation that divides incoming feature vectors by their sum.
- * This allows one to use differently scaled distributions in
- * classifying statistical features.
+ * An operation that normalizes incoming feature vectors. By default,
+ * the vectors are divided by their sum. This allows one to use
+ * differently scaled distributions in classifying statistical
+ * features.
+ *
+ * Alternatively, each feature can be scaled to zero mean and unit
+ * variance or to the range [0,1] (see [normalizationMode]). The
+ * required per-feature statistics are learned from the incoming
+ * vectors with an online algorithm while the operation is running,
+ * and no samples are stored. The normalization is applied as a
+ * single vectorized multiply-add pass over each feature vector.
  *
  * Inputs
  * ------
  *
- * @in features - a feature vector. Any numeric matrix.
+ * @in features - a feature vector. Any numeric matrix. In the
+ * statistical modes, each row of the matrix is treated as a separate
+ * feature vector.
  *
  * @in boundaries - an optional input that marks the boundaries of
  * multiple feature vectors in a compound feature vector. This input
  * is mostly used in conjunction with PiiFeatureCombiner. If this
  * input is connected, each part of the compound feature vector will
- * be separately normalized.
+ * be separately normalized. Only used in `NormalizeSum` mode.
  *
  * Outputs
  * -------
  *
  * @out features - a normalized feature vector. PiiMatrix<double> or
  * PiiMatrix<float>, depending on the `doubleMode` property. If the
- * sum of the input vector is zero, it will not be normalized.
+ * sum of the input vector is zero, it will not be normalized. In the
+ * statistical modes, features with no variation are only shifted.
  *
  */
 class PiiDistributionNormalizer : public PiiDefaultOperation
@@ -54,12 +67,54 @@ class PiiDistributionNormalizer : public PiiDefaultOperation
    */
   Q_PROPERTY(bool doubleMode READ doubleMode WRITE setDoubleMode);
 
+  /**
+   * The type of normalization. The default is `NormalizeSum`.
+   */
+  Q_PROPERTY(NormalizationMode normalizationMode READ normalizationMode WRITE setNormalizationMode);
+  Q_ENUMS(NormalizationMode);
+
+  /**
+   * If `true` (the default), every incoming feature vector updates
+   * the statistics used by `NormalizeMeanVar` and `NormalizeMinMax`
+   * before it is normalized. The statistics are cleared when the
+   * operation is reset. If `false`, the previously learned statistics
+   * are used as such. The statistics are not saved with the
+   * operation.
+   */
+  Q_PROPERTY(bool learningEnabled READ learningEnabled WRITE setLearningEnabled);
+
+  /**
+   * The number of feature vectors the current statistics are based
+   * on.
+   */
+  Q_PROPERTY(int sampleCount READ sampleCount);
+
   PII_OPERATION_SERIALIZATION_FUNCTION
 public:
+  /**
+   * Normalization modes.
+   *
+   * - `NormalizeSum` - divide each feature vector by its sum.
+   *
+   * - `NormalizeMeanVar` - scale each feature to zero mean and unit
+   * variance.
+   *
+   * - `NormalizeMinMax` - scale each feature to the range [0,1]
+   * based on the smallest and largest values seen.
+   */
+  enum NormalizationMode { NormalizeSum, NormalizeMeanVar, NormalizeMinMax };
+
   PiiDistributionNormalizer();
 
   bool doubleMode() const;
   void setDoubleMode(bool mode);
+  NormalizationMode normalizationMode() const;
+  void setNormalizationMode(NormalizationMode normalizationMode);
+  bool learningEnabled() const;
+  void setLearningEnabled(bool learningEnabled);
+  int sampleCount() const;
+
+  void check(bool reset);
 
 protected:
   void process();
@@ -71,15 +126,28 @@ private:
   public:
     Data();
     bool bDoubleMode;
+    NormalizationMode normalizationMode;
+    bool bLearningEnabled;
 
     PiiInputSocket* pFeatureInput, *pBoundaryInput;
     PiiOutputSocket* pFeatureOutput;
+
+    // process() may run in many threads.
+    mutable QMutex statisticsMutex;
+    PiiFeatureStatistics statistics;
+    bool bParametersValid;
+    PiiMatrix<double> matScale, matOffset;
+    PiiMatrix<float> matScaleFloat, matOffsetFloat;
   };
   PII_D_FUNC;
 
   template <class T> void normalize(const PiiVariant& obj);
   template <class U, class T> void normalizePieces(const PiiMatrix<T>& vector, const PiiMatrix<int>& boundaries)
 ;
+  template <class U, class T> void normalizeFeatures(const PiiMatrix<T>& features);
+  void updateParameters();
+  void parameters(PiiMatrix<double>& scale, PiiMatrix<double>& offset) const;
+  void parameters(PiiMatrix<float>& scale, PiiMatrix<float>& offset) const;
 };
 
 #endif //_PIIDISTRIBUTIONNORMALIZER_H
@@ -122,7 +122,10 @@ PiiSampleBalancer::Data::Data() :
   iFeatureCnt(0),
   pHistograms(0),
   dAdaptationRatio(0.1),
-  iLearningBatchSize(256)
+  iLearningBatchSize(256),
+  iMaxClasses(65536),
+  iClassSampleCount(0),
+  bClassFrequenciesEstimated(false)
 {
 }
 
@@ -130,6 +133,8 @@ PiiSampleBalancer::PiiSampleBalancer() :
   PiiDefaultOperation(new Data)
 {
   addSocket(new PiiInputSocket("features"));
+  addSocket(new PiiInputSocket("label"));
+  inputAt(1)->setOptional(true);
   addSocket(new PiiOutputSocket("features"));
   addSocket(new PiiOutputSocket("weight"));
   addSocket(new PiiOutputSocket("select"));
@@ -168,6 +173,10 @@ void PiiSampleBalancer::check(bool reset)
     {
       delete[] d->pHistograms;
       d->pHistograms = 0;
+      d->vecClassCounts.clear();
+      d->vecClassFrequencies.clear();
+      d->iClassSampleCount = 0;
+      d->bClassFrequenciesEstimated = false;
     }
 }
 
@@ -193,6 +202,60 @@ double PiiSampleBalancer::weight(int feature, int index)
     return 0;
 }
 
+void PiiSampleBalancer::updateClassFrequencies()
+{
+  PII_D;
+  const double dMu = d->dAdaptationRatio, dNmu = 1.0 - dMu;
+  for (int i=0; i<d->vecClassCounts.size(); ++i)
+    {
+      double dFrequency = double(d->vecClassCounts[i]) / d->iClassSampleCount;
+      // The first estimate replaces the initial guess.
+      d->vecClassFrequencies[i] = d->bClassFrequenciesEstimated ?
+        dNmu * d->vecClassFrequencies[i] + dMu * dFrequency :
+        dFrequency;
+      d->vecClassCounts[i] = 0;
+    }
+  d->iClassSampleCount = 0;
+  d->bClassFrequenciesEstimated = true;
+}
+
+double PiiSampleBalancer::classWeight(int label)
+{
+  PII_D;
+  if (label < 0 || label >= d->iMaxClasses)
+    PII_THROW(PiiExecutionException, tr("Class labels must be in [0, %1]. Got %2.")
+              .arg(d->iMaxClasses - 1).arg(label));
+  if (label >= d->vecClassCounts.size())
+    {
+      int iOldCount = d->vecClassCounts.size();
+      d->vecClassCounts.resize(label + 1);
+      d->vecClassFrequencies.resize(label + 1);
+      for (int i=iOldCount; i<=label; ++i)
+        {
+          d->vecClassCounts[i] = 0;
+          d->vecClassFrequencies[i] = 0;
+        }
+    }
+
+  ++d->vecClassCounts[label];
+  if (++d->iClassSampleCount >= d->iLearningBatchSize)
+    updateClassFrequencies();
+
+  // Until the first batch is complete, use the counts of the current
+  // batch as the estimate.
+  const bool bUseCounts = !d->bClassFrequenciesEstimated;
+  double dOwn = bUseCounts ? d->vecClassCounts[label] : d->vecClassFrequencies[label];
+  if (dOwn <= 0)
+    return 1.0;
+  double dMin = dOwn;
+  for (int i=0; i<d->vecClassCounts.size(); ++i)
+    {
+      double dFrequency = bUseCounts ? d->vecClassCounts[i] : d->vecClassFrequencies[i];
+      if (dFrequency > 0 && dFrequency < dMin)
+        dMin = dFrequency;
+    }
+  return dMin / dOwn;
+}
 
 template <class T> void PiiSampleBalancer::balance(const PiiVariant& obj)
 {
@@ -211,6 +274,8 @@ template <class T> void PiiSampleBalancer::balance(const PiiVariant& obj)
   double dWeight = weight((int)pFeatures[0], 0);
   for (int f=1; f<d->iFeatureCnt; f++)
     dWeight *= weight((int)pFeatures[f], f);
+  if (inputAt(1)->isConnected())
+    dWeight *= classWeight(PiiYdin::primitiveAs<int>(inputAt(1)));
 
   if (d->mode == ProbabilitySelection)
     {
@@ -253,3 +318,5 @@ void PiiSampleBalancer::setAdaptationRatio(double adaptationRatio) { _d()->dAdap
 double PiiSampleBalancer::adaptationRatio() const { return _d()->dAdaptationRatio; }
 void PiiSampleBalancer::setLearningBatchSize(int learningBatchSize) { _d()->iLearningBatchSize = learningBatchSize; }
 int PiiSampleBalancer::learningBatchSize() const { return _d()->iLearningBatchSize; }
+void PiiSampleBalancer::setMaxClasses(int maxClasses) { _d()->iMaxClasses = qMax(maxClasses, 1); }
+int PiiSampleBalancer::maxClasses() const { return _d()->iMaxClasses; }
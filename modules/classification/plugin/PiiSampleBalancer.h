@@ -40,12 +40,23 @@
  * independent. This is often not the case, but gives a reasonable
  * approximation without huge memory requirements.
  *
+ * If the `label` input is connected, the operation also balances
+ * classes. The frequency of each class is estimated from the stream
+ * in the same way as the feature distributions, and the weight of a
+ * sample is multiplied by the ratio of the frequency of the rarest
+ * class to that of the sample's class. Only one counter and one
+ * estimate per class are stored, and each sample is emitted or
+ * rejected as soon as it arrives.
+ *
  * Inputs
  * ------
  *
  * @in features - feature vector. Each component must be quantized to
  * the number of quantization levels determined by [levels].
  *
+ * @in label - an optional class label for the feature vector. (int,
+ * 0 to [maxClasses] - 1)
+ *
  * Outputs
  * -------
  *
@@ -119,6 +130,14 @@ class PiiSampleBalancer : public PiiDefaultOperation
    */
   Q_PROPERTY(int learningBatchSize READ learningBatchSize WRITE setLearningBatchSize);
 
+  /**
+   * The maximum number of classes. One counter and one frequency
+   * estimate are stored for each label up to the largest one seen.
+   * Larger labels are rejected so that a corrupted label cannot
+   * allocate a huge table. The default is 65536.
+   */
+  Q_PROPERTY(int maxClasses READ maxClasses WRITE setMaxClasses);
+
   PII_OPERATION_SERIALIZATION_FUNCTION
 public:
   /**
@@ -147,6 +166,8 @@ public:
   double adaptationRatio() const;
   void setLearningBatchSize(int learningBatchSize);
   int learningBatchSize() const;
+  void setMaxClasses(int maxClasses);
+  int maxClasses() const;
 
   void check(bool reset);
 
@@ -158,6 +179,8 @@ private:
   inline double weight(int feature, int index);
   void allocateHistograms();
   template <class T> void balance(const PiiVariant& obj);
+  double classWeight(int label);
+  void updateClassFrequencies();
 
   /// @internal
   class Data : public PiiDefaultOperation::Data
@@ -171,7 +194,12 @@ private:
     Histogram* pHistograms;
     double dAdaptationRatio;
     int iLearningBatchSize;
+    int iMaxClasses;
     QList<int> lstLevels;
+    QVector<int> vecClassCounts;
+    QVector<double> vecClassFrequencies;
+    int iClassSampleCount;
+    bool bClassFrequenciesEstimated;
   };
   PII_D_FUNC;
 };
@@ -17,13 +17,15 @@
 
 #include <PiiYdinTypes.h>
 #include <QtAlgorithms>
-#include <cstdlib>
 #include <PiiUtil.h>
+#include <PiiRandom.h>
 
 PiiSampleRandomizer::Data::Data() :
   iClassIndex(0),
   iMaxSamples(0),
   iCurrentSampleIndex(0),
+  iReservoirSize(0),
+  iMaxClasses(65536),
   bRandomSampling(false)
 {
 }
@@ -32,9 +34,12 @@ PiiSampleRandomizer::PiiSampleRandomizer() :
   PiiDefaultOperation(new Data)
 {
   addSocket(new PiiInputSocket("trigger"));
+  addSocket(new PiiInputSocket("name"));
+  addSocket(new PiiInputSocket("label"));
   addSocket(new PiiOutputSocket("name"));
   addSocket(new PiiOutputSocket("label"));
-  inputAt(0)->setOptional(true);
+  for (int i=0; i<3; ++i)
+    inputAt(i)->setOptional(true);
 }
 
 void PiiSampleRandomizer::setSampleNames(const QVariantList& sampleNames)
@@ -43,6 +48,25 @@ void PiiSampleRandomizer::setSampleNames(const QVariantList& sampleNames)
   d->lstSampleNames = Pii::variantsToList<QStringList>(sampleNames);
   d->lstSampleIndices.resize(d->lstSampleNames.size());
   qFill(d->lstSampleIndices.begin(), d->lstSampleIndices.end(), 0);
+  // The initial names count as seen samples.
+  d->vecSeenCounts.resize(d->lstSampleNames.size());
+  for (int i=0; i<d->lstSampleNames.size(); ++i)
+    d->vecSeenCounts[i] = d->lstSampleNames[i].size();
+}
+
+void PiiSampleRandomizer::resizeClasses(int classCount)
+{
+  PII_D;
+  int iOldCount = d->lstSampleNames.size();
+  while (d->lstSampleNames.size() < classCount)
+    d->lstSampleNames << QStringList();
+  d->lstSampleIndices.resize(classCount);
+  d->vecSeenCounts.resize(classCount);
+  for (int i=iOldCount; i<classCount; ++i)
+    {
+      d->lstSampleIndices[i] = 0;
+      d->vecSeenCounts[i] = 0;
+    }
 }
 
 QVariantList PiiSampleRandomizer::sampleNames() const
@@ -54,21 +78,7 @@ QVariantList PiiSampleRandomizer::sampleNames() const
 void PiiSampleRandomizer::setClassWeights(const QVariantList& classWeights)
 {
   PII_D;
-  d->lstClassWeights = Pii::variantsToList<double>(classWeights);
-  int len = d->lstClassWeights.size();
-  d->lstCumulativeWeights.resize(len);
-  if (len > 0)
-    {
-      double sum = 0;
-      for (int i=len; i--; )
-        sum += d->lstClassWeights[i];
-
-      d->lstCumulativeWeights[0] = d->lstClassWeights[0] / sum;
-      for (int i=1; i<len; ++i)
-        d->lstCumulativeWeights[i] = d->lstCumulativeWeights[i-1] + d->lstClassWeights[i] / sum;
-      // Get rid of rounding errors
-      d->lstCumulativeWeights.last() = 1.0;
-    }
+  _d()->lstClassWeights = Pii::variantsToList<double>(classWeights);
 }
 
 QVariantList PiiSampleRandomizer::classWeights() const
@@ -83,15 +93,22 @@ void PiiSampleRandomizer::check(bool reset)
   PII_D;
   PiiDefaultOperation::check(reset);
 
-  if (d->lstSampleNames.size() == 0)
-    PII_THROW(PiiExecutionException, tr("Sample names have not been set."));
-  for (int i = d->lstSampleNames.size(); i--; )
-    if (d->lstSampleNames[i].size() == 0)
-      PII_THROW(PiiExecutionException, tr("The sample name list for class %1 is empty.").arg(i));
-  // Weights have not been set -> balance all equally
-  if (d->lstCumulativeWeights.size() != 0 &&
-      d->lstCumulativeWeights.size() != d->lstSampleNames.size())
-    PII_THROW(PiiExecutionException, tr("There must be an equal number of class names and class weights."));
+  if (inputAt(1)->isConnected() != inputAt(2)->isConnected())
+    PII_THROW(PiiExecutionException, tr("Either both or none of name and label must be connected."));
+
+  // Streamed samples fill the classes as they arrive.
+  if (!inputAt(1)->isConnected())
+    {
+      if (d->lstSampleNames.size() == 0)
+        PII_THROW(PiiExecutionException, tr("Sample names have not been set."));
+      for (int i = d->lstSampleNames.size(); i--; )
+        if (d->lstSampleNames[i].size() == 0)
+          PII_THROW(PiiExecutionException, tr("The sample name list for class %1 is empty.").arg(i));
+      // Weights have not been set -> balance all equally
+      if (d->lstClassWeights.size() != 0 &&
+          d->lstClassWeights.size() != d->lstSampleNames.size())
+        PII_THROW(PiiExecutionException, tr("There must be an equal number of class names and class weights."));
+    }
 
   if (reset)
     {
@@ -106,9 +123,12 @@ void PiiSampleRandomizer::emitFromClass(int classIndex)
   QStringList& names = d->lstSampleNames[classIndex];
   // Select a sample randomly from the class names
   if (d->bRandomSampling)
-    emitObject(names[::rand() % names.size()]);
+    emitObject(names[qMin(int(Pii::uniformRandom() * names.size()), names.size() - 1)]);
   else
     {
+      // The reservoir may have grown since the last emission.
+      if (d->lstSampleIndices[classIndex] >= names.size())
+        d->lstSampleIndices[classIndex] = 0;
       emitObject(names[d->lstSampleIndices[classIndex]]);
       // Advance sample index and roll around if necessary
       d->lstSampleIndices[classIndex] = (d->lstSampleIndices[classIndex] + 1) % names.size();
@@ -118,30 +138,96 @@ void PiiSampleRandomizer::emitFromClass(int classIndex)
 }
 
 
-void PiiSampleRandomizer::process()
+void PiiSampleRandomizer::addToReservoir(const QString& name, int classIndex)
+{
+  PII_D;
+  if (classIndex >= d->lstSampleNames.size())
+    resizeClasses(classIndex + 1);
+
+  QStringList& names = d->lstSampleNames[classIndex];
+  qint64 iSeen = ++d->vecSeenCounts[classIndex];
+  if (d->iReservoirSize <= 0 || names.size() < d->iReservoirSize)
+    names << name;
+  else
+    {
+      // Keep the new sample with probability reservoirSize/seen and
+      // let it replace a randomly selected old one.
+      qint64 iIndex = qMin(qint64(Pii::uniformRandom() * iSeen), iSeen - 1);
+      if (iIndex < d->iReservoirSize)
+        names[int(iIndex)] = name;
+    }
+}
+
+int PiiSampleRandomizer::selectClass()
 {
   PII_D;
-  // Weights are set -> select randomly
-  if (d->lstCumulativeWeights.size() > 0)
+  const int iClassCount = d->lstSampleNames.size();
+  // No weights -> go through all non-empty classes in turn
+  if (d->lstClassWeights.isEmpty())
     {
-      double p = double(::rand())/RAND_MAX; // p is in [0,1]
-
-      for (int i=0; i<d->lstCumulativeWeights.size(); ++i)
-        if (p <= d->lstCumulativeWeights[i])
-          {
-            emitFromClass(i);
-            break;
-          }
+      for (int i=0; i<iClassCount; ++i)
+        {
+          if (d->iClassIndex >= iClassCount)
+            d->iClassIndex = 0;
+          int iClass = d->iClassIndex++;
+          if (!d->lstSampleNames[iClass].isEmpty())
+            return iClass;
+        }
+      return -1;
     }
-  else
+
+  // Weights are set -> select randomly among the classes that have
+  // samples.
+  const int iWeightCount = qMin(iClassCount, d->lstClassWeights.size());
+  double dTotal = 0;
+  for (int i=0; i<iWeightCount; ++i)
+    if (!d->lstSampleNames[i].isEmpty())
+      dTotal += d->lstClassWeights[i];
+  if (dTotal <= 0)
+    return -1;
+
+  double p = Pii::uniformRandom() * dTotal; // p is in [0,dTotal]
+  int iSelected = -1;
+  for (int i=0; i<iWeightCount; ++i)
+    if (!d->lstSampleNames[i].isEmpty() && d->lstClassWeights[i] > 0)
+      {
+        iSelected = i;
+        p -= d->lstClassWeights[i];
+        if (p <= 0)
+          break;
+      }
+  // Rounding errors may leave p slightly positive -> iSelected is the
+  // last applicable class.
+  return iSelected;
+}
+
+void PiiSampleRandomizer::process()
+{
+  PII_D;
+  int iClass;
+  if (inputAt(1)->isConnected())
     {
-      // Advance counter by one and roll back
-      emitFromClass(d->iClassIndex);
-      d->iClassIndex = (d->iClassIndex + 1) % d->lstSampleNames.size();
+      PiiVariant obj = inputAt(1)->firstObject();
+      if (obj.type() != PiiYdin::QStringType)
+        PII_THROW_UNKNOWN_TYPE(inputAt(1));
+      int iLabel = PiiYdin::primitiveAs<int>(inputAt(2));
+      if (iLabel < 0 || iLabel >= d->iMaxClasses)
+        PII_THROW(PiiExecutionException, tr("Class labels must be in [0, %1]. Got %2.")
+                  .arg(d->iMaxClasses - 1).arg(iLabel));
+      addToReservoir(obj.valueAs<QString>(), iLabel);
+      iClass = selectClass();
+      // None of the non-empty classes has a weight. The class of the
+      // incoming sample has at least one sample.
+      if (iClass < 0)
+        iClass = iLabel;
     }
+  else
+    iClass = selectClass();
+
+  emitFromClass(iClass);
 
   d->iCurrentSampleIndex++;
-  if (d->iMaxSamples > 0 && !inputAt(0)->isConnected() &&
+  if (d->iMaxSamples > 0 && !inputAt(0)->isConnected() && !inputAt(1)->isConnected() &&
       d->iCurrentSampleIndex >= d->iMaxSamples)
     operationStopped();
 }
@@ -150,4 +236,8 @@ void PiiSampleRandomizer::setRandomSampling(bool randomSampling) { _d()->bRandom
 bool PiiSampleRandomizer::randomSampling() const { return _d()->bRandomSampling; }
 void PiiSampleRandomizer::setMaxSamples(int maxSamples) { _d()->iMaxSamples = maxSamples; }
 int PiiSampleRandomizer::maxSamples() const { return _d()->iMaxSamples; }
+void PiiSampleRandomizer::setReservoirSize(int reservoirSize) { _d()->iReservoirSize = reservoirSize; }
+int PiiSampleRandomizer::reservoirSize() const { return _d()->iReservoirSize; }
+void PiiSampleRandomizer::setMaxClasses(int maxClasses) { _d()->iMaxClasses = qMax(maxClasses, 1); }
+int PiiSampleRandomizer::maxClasses() const { return _d()->iMaxClasses; }
 int PiiSampleRandomizer::currentSampleIndex() const { return _d()->iCurrentSampleIndex; }
@@ -23,11 +23,30 @@
  * classes. On each iteration it randomly selects a sample from one of
  * the classes and outputs its name and class index.
  *
+ * The sample names can also be streamed in through the `name` and
+ * `label` inputs. Each incoming sample is placed into the reservoir
+ * of its class, and a randomly selected sample is emitted
+ * immediately. If [reservoirSize] is non-zero, each class retains at
+ * most that many samples, and every sample seen so far has an equal
+ * chance of being retained (reservoir sampling). Memory usage thus
+ * stays constant no matter how long the input stream is.
+ *
+ * All random numbers come from [Pii::uniformRandom()]. The choices
+ * can thus be repeated by calling [Pii::seedRandom()] with a fixed
+ * seed.
+ *
  * Inputs
  * ------
  *
  * @in trigger - an optional trigger input. (any)
  *
+ * @in name - an optional input that receives names of new samples.
+ * If this input is connected, `label` must be connected as well.
+ * (QString)
+ *
+ * @in label - the class label of the sample in `name`. (int, 0 to
+ * [maxClasses] - 1)
+ *
  * Outputs
  * -------
  *
@@ -51,6 +70,10 @@ class PiiSampleRandomizer : public PiiDefaultOperation
    *                         << (QStringList() << "Orange1" << "Orange2" << "Orange3")
    *                         << (QStringList() << "Apple1" << "Apple2"));
    * ~~~
+   *
+   * If `name` is connected, the names received so far are added to
+   * these lists, and reading this property returns the current
+   * contents of the reservoirs.
    */
   Q_PROPERTY(QVariantList sampleNames READ sampleNames WRITE setSampleNames);
 
@@ -65,6 +88,8 @@ class PiiSampleRandomizer : public PiiDefaultOperation
    *
    * If `classWeights` is an empty list, the operation goes
    * sequentially through all classes and emits one sample from each.
+   * Classes that have no samples yet are skipped. If samples are
+   * streamed in, classes that have no weight will never be selected.
    */
   Q_PROPERTY(QVariantList classWeights READ classWeights WRITE setClassWeights);
 
@@ -77,11 +102,29 @@ class PiiSampleRandomizer : public PiiDefaultOperation
 
   /**
    * The maximum number of sample names the source will emit. Zero
-   * means eternally. This property is ineffective if `trigger` is
-   * connected. The default is zero.
+   * means eternally. This property is ineffective if `trigger`
+   * or `name` is connected. The default is zero.
    */
   Q_PROPERTY(int maxSamples READ maxSamples WRITE setMaxSamples);
 
+  /**
+   * The maximum number of samples retained for each class when
+   * samples are received through the `name` input. Once a class is
+   * full, a new sample replaces a randomly selected old one with a
+   * probability that keeps the reservoir a uniform random sample of
+   * all samples of that class. Zero means no limit. The default is
+   * zero.
+   */
+  Q_PROPERTY(int reservoirSize READ reservoirSize WRITE setReservoirSize);
+
+  /**
+   * The maximum number of classes. Since there is one reservoir per
+   * class label, a corrupted label could otherwise allocate a huge
+   * table. Labels received through the `label` input must be
+   * smaller than this value. The default is 65536.
+   */
+  Q_PROPERTY(int maxClasses READ maxClasses WRITE setMaxClasses);
+
   /**
    * The zero-based index of the next sample to be emitted.
    */
@@ -103,6 +146,12 @@ public:
   void setMaxSamples(int maxSamples);
   int maxSamples() const;
 
+  void setReservoirSize(int reservoirSize);
+  int reservoirSize() const;
+
+  void setMaxClasses(int maxClasses);
+  int maxClasses() const;
+
   int currentSampleIndex() const;
 
 protected:
@@ -111,6 +160,9 @@ protected:
 
 private:
   void emitFromClass(int classIndex);
+  void addToReservoir(const QString& name, int classIndex);
+  int selectClass();
+  void resizeClasses(int classCount);
 
   /// @internal
   class Data : public PiiDefaultOperation::Data
@@ -119,11 +171,13 @@ private:
     Data();
     QList<QStringList> lstSampleNames;
     QList<double> lstClassWeights;
-    QVector<double> lstCumulativeWeights;
     QVector<int> lstSampleIndices;
+    QVector<qint64> vecSeenCounts;
     int iClassIndex;
     int iMaxSamples;
     int iCurrentSampleIndex;
+    int iReservoirSize;
+    int iMaxClasses;
     bool bRandomSampling;
   };
   PII_D_FUNC;
@@ -61,6 +61,7 @@ protected:
   double classify();
   double learnOne(double label, double weight);
   void collectSample(double label, double weight);
+  bool takeLearningBatch();
   bool learnBatch();
   void replaceClassifier();
   void resizeBatch(int newSize);
@@ -75,6 +76,8 @@ protected:
     ~Data();
     PiiSom<SampleSet>* pClassifier, *pNewClassifier;
     PiiSampleSetCollector<SampleSet> collector;
+    // A shallow copy of the buffer for the learning thread.
+    SampleSet learningSamples;
   };
   PII_D_FUNC;
 
@@ -171,13 +174,22 @@ template <class SampleSet> void PiiSomOperation::Template<SampleSet>::resetClass
   setModels(PiiVariant());
 }
 
+template <class SampleSet> bool PiiSomOperation::Template<SampleSet>::takeLearningBatch()
+{
+  PII_D;
+  d->learningSamples = *d->collector.samples();
+  return true;
+}
+
 template <class SampleSet> bool PiiSomOperation::Template<SampleSet>::learnBatch()
 {
   PII_D;
   d->pNewClassifier = createSom();
   bool bSuccess = PiiClassifierOperation::learnBatch(*d->pNewClassifier,
-                                                     *d->collector.samples(),
-                                                     *d->collector.classLabels());
+                                                     d->learningSamples,
+                                                     QVector<double>());
+  // Release the snapshot so that the buffer doesn't need to detach.
+  d->learningSamples = SampleSet();
   if (!bSuccess)
     {
       delete d->pNewClassifier;
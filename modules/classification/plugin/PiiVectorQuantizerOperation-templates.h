@@ -45,13 +45,17 @@ void PiiVectorQuantizerOperation::setDistanceMeasure(PiiVectorQuantizer<SampleSe
       QString strMultiName = QString("PiiMultiFeatureDistance<%1>").arg(PiiYdin::resourceName<T>());
       typedef PII_POLYMORPHIC_MEASURE(PiiMultiFeatureDistance) MeasureType;
       PiiSmartPtr<MeasureType> pMeasureList(new MeasureType);
+      bool bNonNegative = true;
       for (int i=0; i<d->lstDistanceMeasures.size(); ++i)
         {
           QString strName = QString("%1<%2>")
             .arg(d->lstDistanceMeasures[i])
             .arg(PiiYdin::resourceName<T>());
           pMeasureList->append(createDistanceMeasure<PiiDistanceMeasure<ConstFeatureIterator> >(strName));
+          bNonNegative = bNonNegative && isNonNegativeMeasure(d->lstDistanceMeasures[i]);
         }
+      // Enables early termination in nearest neighbor search.
+      pMeasureList->setNonNegativeDistances(bNonNegative);
       pMeasureList->setWeights(Pii::variantsToVector<double>(d->lstDistanceWeights));
       pMeasureList->setCombinationMode(d->distanceCombinationMode);
       classifier.setDistanceMeasure(pMeasureList.release());
@@ -37,6 +37,23 @@ PiiVectorQuantizerOperation::PiiVectorQuantizerOperation(Data* data) :
   init();
 }
 
+bool PiiVectorQuantizerOperation::isNonNegativeMeasure(const QString& name)
+{
+  static const char* aNonNegativeMeasures[] =
+    {
+      "PiiGeometricDistance",
+      "PiiSquaredGeometricDistance",
+      "PiiAbsDiffDistance",
+      "PiiChiSquaredDistance",
+      "PiiJeffreysDivergence",
+      "PiiHammingDistance"
+    };
+  for (unsigned i=0; i<sizeof(aNonNegativeMeasures)/sizeof(aNonNegativeMeasures[0]); ++i)
+    if (name == aNonNegativeMeasures[i])
+      return true;
+  return false;
+}
+
 void PiiVectorQuantizerOperation::init()
 {
   PII_D;
@@ -259,6 +259,7 @@ protected:
 
 private:
   void init();
+  static bool isNonNegativeMeasure(const QString& name);
 };
 
 #include "PiiVectorQuantizerOperation-templates.h"
@@ -21,69 +21,172 @@
 #include <PiiPrincipalComponents.h>
 #include <PiiMetaTemplate.h>
 #include <PiiTypeTraits.h>
+#include <QVector>
+#include <limits>
 
 namespace PiiColors
 {
+  /// @hide
+  // Converts a channel value to its contribution to a color index.
+  template <class T> struct ChannelQuantizer
+  {
+    ChannelQuantizer(int levels, int step) :
+      _fScale(float(levels) / PiiImage::Traits<T>::max()), _iMaxLevel(levels-1), _iStep(step)
+    {}
+    int operator() (T value) const { return qMin(int(_fScale * value), _iMaxLevel) * _iStep; }
+
+    float _fScale;
+    int _iMaxLevel, _iStep;
+  };
+
+  template <> struct ChannelQuantizer<unsigned char>
+  {
+    ChannelQuantizer(int levels, int step)
+    {
+      const float fScale = float(levels) / 255;
+      for (int i=0; i<256; ++i)
+        _aTable[i] = qMin(int(fScale * i), levels-1) * step;
+    }
+    int operator() (unsigned char value) const { return _aTable[value]; }
+
+    int _aTable[256];
+  };
+  /// @endhide
+
   template <class ColorType> PiiMatrix<int> toIndexed(const PiiMatrix<ColorType>& clrImage,
                                                       int redLevels, int greenLevels, int blueLevels)
   {
-    typedef PiiImage::Traits<ColorType> Traits;
+    typedef typename ColorType::Type T;
 
     PiiMatrix<int> result(PiiMatrix<int>::uninitialized(clrImage.rows(), clrImage.columns()));
     if (greenLevels == 0)
       greenLevels = redLevels;
     if (blueLevels == 0)
       blueLevels = redLevels;
-    int iRedStep = blueLevels * greenLevels;
-    float fRedScale = float(redLevels) / Traits::max();
-    float fGreenScale = float(greenLevels) / Traits::max();
-    float fBlueScale = float(blueLevels) / Traits::max();
+    const ChannelQuantizer<T> red(redLevels, blueLevels * greenLevels),
+      green(greenLevels, blueLevels),
+      blue(blueLevels, 1);
     for (int r=0; r<clrImage.rows(); ++r)
       {
         const ColorType* pSourceRow = clrImage[r];
         int* pTargetRow = result[r];
         for (int c=0; c<clrImage.columns(); ++c)
-          pTargetRow[c] =
-            iRedStep * int(fRedScale * pSourceRow[c].rgbR) +
-            blueLevels * int(fGreenScale * pSourceRow[c].rgbG) +
-            int(fBlueScale * pSourceRow[c].rgbB);
+          pTargetRow[c] = red(pSourceRow[c].rgbR) + green(pSourceRow[c].rgbG) + blue(pSourceRow[c].rgbB);
       }
     return result;
   }
 
-  template <class T> void normalizedRgb(const PiiMatrix<T>& image,
-                                        PiiMatrix<typename T::Type>& ch1,
-                                        PiiMatrix<typename T::Type>& ch2,
-                                        float multiplier,
-                                        int ch1Index, int ch2Index)
+  /// @hide
+  // Calculates multiplier/sum for normalizedRgb(). With 8-bit
+  // channels, the sum has only 766 possible values, and the division
+  // is replaced by a table look-up.
+  template <class T> struct RgbNormalizer
   {
-    ch1Index = (2-ch1Index) & 3;
-    ch2Index = (2-ch2Index) & 3;
-    // Reserve space for color channels
-    ch1.resize(image.rows(), image.columns());
-    ch2.resize(image.rows(), image.columns());
+    typedef float SumType;
+    RgbNormalizer(float multiplier) : _fMultiplier(multiplier) {}
+    float operator() (float sum) const { return _fMultiplier / sum; }
+    float _fMultiplier;
+  };
 
-    for (int r=image.rows(); r--; )
+  template <> struct RgbNormalizer<unsigned char>
+  {
+    typedef int SumType;
+    RgbNormalizer(float multiplier)
+    {
+      _aNormalizers[0] = 0;
+      for (int i=1; i<766; ++i)
+        _aNormalizers[i] = multiplier / float(i);
+    }
+    float operator() (int sum) const { return _aNormalizers[sum]; }
+    float _aNormalizers[766];
+  };
+  /// @endhide
+
+  /// @hide
+  template <class T> void normalizeRgbRows(const PiiMatrix<T>& image,
+                                           const Pii::BandRows<typename T::Type>& ch1,
+                                           const Pii::BandRows<typename T::Type>& ch2,
+                                           const RgbNormalizer<typename T::Type>& normalizer,
+                                           int ch1Index, int ch2Index,
+                                           int firstRow, int rowCount)
+  {
+    typedef typename T::Type Type;
+    typedef RgbNormalizer<Type> Normalizer;
+    const int iColumns = image.columns();
+    for (int r=firstRow; r<firstRow+rowCount; ++r)
       {
         const T* row = image.row(r);
-        typename T::Type* ch1Row = ch1.row(r), *ch2Row = ch2.row(r);
-        for (int c=image.columns(); c--; )
+        Type* ch1Row = ch1.row(r), *ch2Row = ch2.row(r);
+        for (int c=0; c<iColumns; ++c)
           {
-            T pixel = row[c];
-            float normalizer = pixel.rgbR + pixel.rgbG + pixel.rgbB;
-            if (normalizer == 0)
+            const T pixel = row[c];
+            const typename Normalizer::SumType sum = pixel.rgbR + pixel.rgbG + pixel.rgbB;
+            if (sum == 0)
               {
                 ch1Row[c] = 0;
                 ch2Row[c] = 0;
                 continue;
               }
-            normalizer = multiplier / normalizer;
-            ch1Row[c] = typename T::Type(normalizer * pixel.channels[ch1Index]);
-            ch2Row[c] = typename T::Type(normalizer * pixel.channels[ch2Index]);
+            const float fNormalizer = normalizer(sum);
+            ch1Row[c] = Type(fNormalizer * pixel.channels[ch1Index]);
+            ch2Row[c] = Type(fNormalizer * pixel.channels[ch2Index]);
           }
       }
   }
 
+  template <class T> struct NormalizeRgbBand
+  {
+    typedef typename T::Type Type;
+    NormalizeRgbBand(const PiiMatrix<T>& image, PiiMatrix<Type>& ch1, PiiMatrix<Type>& ch2,
+                     const RgbNormalizer<Type>& normalizer, int ch1Index, int ch2Index) :
+      image(image), ch1Rows(ch1), ch2Rows(ch2),
+      normalizer(normalizer), iCh1Index(ch1Index), iCh2Index(ch2Index)
+    {}
+
+    void operator() (int firstRow, int rowCount) const
+    {
+      normalizeRgbRows(image, ch1Rows, ch2Rows, normalizer,
+                       iCh1Index, iCh2Index, firstRow, rowCount);
+    }
+
+    const PiiMatrix<T>& image;
+    const Pii::BandRows<Type> ch1Rows, ch2Rows;
+    const RgbNormalizer<Type>& normalizer;
+    int iCh1Index, iCh2Index;
+  };
+  /// @endhide
+
+  template <class T> void normalizedRgb(const PiiMatrix<T>& image,
+                                        PiiMatrix<typename T::Type>& ch1,
+                                        PiiMatrix<typename T::Type>& ch2,
+                                        float multiplier,
+                                        int ch1Index, int ch2Index)
+  {
+    normalizedRgb(Pii::ParallelExecution(1), image, ch1, ch2, multiplier, ch1Index, ch2Index);
+  }
+
+  template <class T> void normalizedRgb(const Pii::ParallelExecution& policy,
+                                        const PiiMatrix<T>& image,
+                                        PiiMatrix<typename T::Type>& ch1,
+                                        PiiMatrix<typename T::Type>& ch2,
+                                        float multiplier,
+                                        int ch1Index, int ch2Index)
+  {
+    typedef typename T::Type Type;
+    // Reserve space for color channels. Matrices that already have
+    // the right size are reused as such.
+    if (ch1.rows() != image.rows() || ch1.columns() != image.columns())
+      ch1 = PiiMatrix<Type>::uninitialized(image.rows(), image.columns());
+    if (ch2.rows() != image.rows() || ch2.columns() != image.columns())
+      ch2 = PiiMatrix<Type>::uninitialized(image.rows(), image.columns());
+    if (image.isEmpty())
+      return;
+    const RgbNormalizer<Type> normalizer(multiplier);
+    Pii::forEachBand(policy, image.rows(), 0,
+                     NormalizeRgbBand<T>(image, ch1, ch2, normalizer,
+                                         (2-ch1Index) & 3, (2-ch2Index) & 3));
+  }
+
   template <class ColorType> void measureColorDistribution(const PiiMatrix<ColorType>& clrImage,
                                                            PiiMatrix<double>& baseVectors,
                                                            PiiMatrix<double>& center,
@@ -330,8 +433,8 @@ namespace PiiColors
 #undef PII_LAB_F
 
     return Clr(116*yPerYn - 16,
-               500*xPerXn - yPerYn,
-               200*yPerYn - zPerZn);
+               500*(xPerXn - yPerYn),
+               200*(yPerYn - zPerZn));
   }
 
   template <class Clr> Clr labToXyz(const Clr& labColor,
@@ -391,4 +494,174 @@ namespace PiiColors
         yuvToRgb(rgbData[iRgbIndex+1], y2, u, v);
       }
   }
+
+  template <class Color>
+  void nv12toRgb(const typename Color::value_type *yuvData, Color* rgbData, int width, int height)
+  {
+    const typename Color::value_type* pChroma = yuvData + width * height;
+    for (int r=0; r<height; ++r)
+      {
+        const typename Color::value_type* pLuma = yuvData + r * width;
+        const typename Color::value_type* pUv = pChroma + (r >> 1) * width;
+        Color* pRgb = rgbData + r * width;
+        for (int c=0; c<width; c+=2, pUv+=2)
+          {
+            int u = pUv[0] - 128, v = pUv[1] - 128;
+            yuvToRgb(pRgb[c], pLuma[c], u, v);
+            yuvToRgb(pRgb[c+1], pLuma[c+1], u, v);
+          }
+      }
+  }
+
+  /// @hide
+  // Clamps and rounds an 8-bit Y'CbCr or RGB channel. The result is
+  // the same as that of roundYcbcr<unsigned char>(d, 255), but the
+  // compiler can turn the comparisons into min/max instructions.
+  inline unsigned char roundYcbcr8(double d)
+  {
+    d = d > 0 ? d : 0;
+    d = d < 255 ? d : 255;
+    return (unsigned char)int(d + 0.5);
+  }
+
+  // Row kernels for packed 8-bit BGR(A) data. The expressions are
+  // those of the per-pixel functions, evaluated in the same order.
+  template <int channels> void rgbToYcbcrRow(const unsigned char* source, unsigned char* target, int columns)
+  {
+    for (int c=0; c<columns; ++c, source += channels, target += channels)
+      {
+        const double dB = source[0], dG = source[1], dR = source[2];
+        const double dY = float(dR * 0.2126 + dG * 0.7152 + dB * 0.0722);
+        target[0] = roundYcbcr8(0.63500127000254000508 * (dR - dY) + 127.5);
+        target[1] = roundYcbcr8(0.53890924768269023496 * (dB - dY) + 127.5);
+        target[2] = roundYcbcr8(dY);
+        if (channels == 4)
+          target[3] = 0;
+      }
+  }
+
+  template <int channels> void ycbcrToRgbRow(const unsigned char* source, unsigned char* target, int columns)
+  {
+    for (int c=0; c<columns; ++c, source += channels, target += channels)
+      {
+        const double dY = source[2], dPb = source[1] - 127.5, dPr = source[0] - 127.5;
+        target[0] = roundYcbcr8(dPb * 1.8556 + dY);
+        target[1] = roundYcbcr8(dY - 0.46812427293064876957 * dPr - 0.18732427293064876958 * dPb);
+        target[2] = roundYcbcr8(dPr * 1.5748 + dY);
+        if (channels == 4)
+          target[3] = 0;
+      }
+  }
+
+  template <class T> PiiMatrix<T> transformBytes(const PiiMatrix<T>& image,
+                                                 void (*rowFunction)(const unsigned char*, unsigned char*, int))
+  {
+    PiiMatrix<T> result(PiiMatrix<T>::uninitialized(image.rows(), image.columns()));
+    for (int r=0; r<image.rows(); ++r)
+      rowFunction(reinterpret_cast<const unsigned char*>(image[r]),
+                  reinterpret_cast<unsigned char*>(result[r]),
+                  image.columns());
+    return result;
+  }
+
+  template <class T> PiiMatrix<T> rgbToYcbcr(const PiiMatrix<T>& image, double maximum, Pii::True)
+  {
+    if (maximum == 255)
+      return transformBytes(image, &rgbToYcbcrRow<sizeof(T)>);
+    return Pii::matrix(image.mapped(RgbToYcbcr<T>(maximum)));
+  }
+
+  template <class T> PiiMatrix<T> rgbToYcbcr(const PiiMatrix<T>& image, double maximum, Pii::False)
+  {
+    return Pii::matrix(image.mapped(RgbToYcbcr<T>(maximum)));
+  }
+
+  template <class T> PiiMatrix<T> ycbcrToRgb(const PiiMatrix<T>& image, double maximum, Pii::True)
+  {
+    if (maximum == 255)
+      return transformBytes(image, &ycbcrToRgbRow<sizeof(T)>);
+    return Pii::matrix(image.mapped(YcbcrToRgb<T>(maximum)));
+  }
+
+  template <class T> PiiMatrix<T> ycbcrToRgb(const PiiMatrix<T>& image, double maximum, Pii::False)
+  {
+    return Pii::matrix(image.mapped(YcbcrToRgb<T>(maximum)));
+  }
+  /// @endhide
+
+  template <class T> PiiMatrix<T> rgbToYcbcr(const PiiMatrix<T>& image, double maximum)
+  {
+    return rgbToYcbcr(image, maximum, Pii::IsSame<typename T::Type, unsigned char>());
+  }
+
+  template <class T> PiiMatrix<T> ycbcrToRgb(const PiiMatrix<T>& image, double maximum)
+  {
+    return ycbcrToRgb(image, maximum, Pii::IsSame<typename T::Type, unsigned char>());
+  }
+
+  /// @hide
+  // The layout of gamma-corrected channels in a pixel: the first
+  // `channels` of every `step` channels are corrected.
+  template <class T> struct GammaChannels
+  {
+    typedef T Type;
+    enum { channels = 1, step = 1 };
+  };
+
+  template <class T> struct GammaChannels<PiiColor<T> >
+  {
+    typedef T Type;
+    enum { channels = 3, step = 3 };
+  };
+
+  template <class T> struct GammaChannels<PiiColor4<T> >
+  {
+    typedef T Type;
+    enum { channels = 3, step = 4 };
+  };
+
+  template <class T> PiiMatrix<T> correctGamma(const PiiMatrix<T>& image, double gamma, double maximum, Pii::True)
+  {
+    typedef GammaChannels<T> Channels;
+    typedef typename Channels::Type Type;
+    const int iLevels = int(std::numeric_limits<Type>::max()) + 1,
+      iRows = image.rows(), iValues = image.columns() * Channels::step;
+    // Building a 64k table doesn't pay off with small 16-bit images.
+    if (qint64(iRows) * iValues < iLevels)
+      return Pii::matrix(image.mapped(CorrectGammaScaled<T>(gamma, maximum)));
+
+    QVector<Type> vecTable(iLevels);
+    Type* pTable = vecTable.data();
+    for (int i=0; i<iLevels; ++i)
+      pTable[i] = correctGamma(Type(i), gamma, maximum);
+
+    PiiMatrix<T> result(PiiMatrix<T>::uninitialized(iRows, image.columns()));
+    for (int r=0; r<iRows; ++r)
+      {
+        const Type* pSource = reinterpret_cast<const Type*>(image[r]);
+        Type* pTarget = reinterpret_cast<Type*>(result[r]);
+        for (int i=0; i<iValues; i += Channels::step)
+          {
+            for (int j=0; j<Channels::channels; ++j)
+              pTarget[i+j] = pTable[pSource[i+j]];
+            if (Channels::step > Channels::channels)
+              pTarget[i+3] = pSource[i+3];
+          }
+      }
+    return result;
+  }
+
+  template <class T> PiiMatrix<T> correctGamma(const PiiMatrix<T>& image, double gamma, double maximum, Pii::False)
+  {
+    return Pii::matrix(image.mapped(CorrectGammaScaled<T>(gamma, maximum)));
+  }
+  /// @endhide
+
+  template <class T> PiiMatrix<T> correctGamma(const PiiMatrix<T>& image, double gamma, double maximum)
+  {
+    typedef typename GammaChannels<T>::Type Type;
+    return correctGamma(image, gamma, maximum,
+                        Pii::Or<Pii::IsSame<Type, unsigned char>::boolValue,
+                                Pii::IsSame<Type, unsigned short>::boolValue>());
+  }
 }
@@ -15,6 +15,15 @@
 
 #include "PiiColors.h"
 
+#include <PiiSynchronized.h>
+#include <PiiCpu.h>
+#include <QMap>
+#include <QMutex>
+#include <QVector>
+
+#include <cstring>
+#include <cmath>
+
 namespace PiiColors
 {
   PiiMatrix<float> ohtaKanadeMatrix(3,3,
@@ -35,204 +44,406 @@ namespace PiiColors
     QList<int> lstDistances;
     for (int i=1; i<=maxDistance; ++i)
       lstDistances << i;
-    return autocorrelogram(image, lstDistances, levels);
+    return autocorrelogram(Pii::ParallelExecution(1), image, lstDistances, levels);
   }
 
   PiiMatrix<float> autocorrelogram(const PiiMatrix<int>& image,
                                    const QList<int>& distances,
                                    int levels)
   {
-    if (levels <= 0)
-      levels = Pii::max(image) + 1;
-    PiiMatrix<float> matCorrelogram(1, levels * distances.size());
-    float* pCorrelogram = matCorrelogram[0];
+    return autocorrelogram(Pii::ParallelExecution(1), image, distances, levels);
+  }
+
+  namespace
+  {
+    /* Each pixel is compared to the ring of pixels at chessboard
+     * distance d. The ring is split into a horizontal segment above
+     * and below the center and two vertical segments. Histograms of
+     * the horizontal segments slide along each row, and one histogram
+     * per column covers the vertical segments. Both are updated
+     * incrementally, so the number of matching ring pixels is found
+     * with four look-ups independent of d.
+     */
+    struct CorrelogramBand
+    {
+      CorrelogramBand(const PiiMatrix<int>& image, const QList<int>& distances, int levels,
+                      QMutex* mutex, QMap<int,QVector<double> >* partials) :
+        image(image), distances(distances), iLevels(levels),
+        pMutex(mutex), pPartials(partials)
+      {}
+
+      inline bool isValid(int color) const { return unsigned(color) < unsigned(iLevels); }
+
+      // Adds (step = 1) or removes (step = -1) a row of the image to
+      // the histograms of all columns.
+      void updateColumns(int* columnHistograms, int row, int step) const
+      {
+        const int* pRow = image[row];
+        for (int c=0; c<image.columns(); ++c)
+          if (isValid(pRow[c]))
+            columnHistograms[c * iLevels + pRow[c]] += step;
+      }
 
-    const int iRows = image.rows(), iCols = image.columns();
-    for (int d=0; d<distances.size(); ++d)
+      // Slides the histogram of segment [c-d, c+d] of *row* from
+      // column c-1 to c.
+      inline void slide(int* histogram, const int* row, int c, int d, int columns) const
       {
-        const int iDist = distances[d];
-        const int iWindowSize = iDist * 8;
-        if (iRows <= iDist && iCols <= iDist)
-          continue;
+        const int iIn = c + d, iOut = c - d - 1;
+        if (iIn < columns && isValid(row[iIn]))
+          ++histogram[row[iIn]];
+        if (iOut >= 0 && isValid(row[iOut]))
+          --histogram[row[iOut]];
+      }
 
-        const int iLastRow = iRows - iDist, iLastCol = iCols - iDist;
+      void operator() (int firstRow, int rowCount) const
+      {
+        const int iRows = image.rows(), iCols = image.columns(), iLastRow = firstRow + rowCount;
+        QVector<double> vecCorrelogram(iLevels * distances.size());
+        QVector<int> vecColumns(iLevels * iCols), vecAbove(iLevels), vecBelow(iLevels);
+        int* pColumns = vecColumns.data(), *pAbove = vecAbove.data(), *pBelow = vecBelow.data();
 
-        int r = 0;
-        // Top boundary
-        for (; r<qMin(iDist,iRows); ++r)
+        for (int i=0; i<distances.size(); ++i)
           {
-            int iWindowVEnd = r+iDist;
-            const int* pRow = image[r], *pRow1 = 0;
-            if (iWindowVEnd < iRows)
-              pRow1 = image[iWindowVEnd];
-            else
-              iWindowVEnd = iRows-1;
-
-            for (int c=0; c<iCols; ++c)
-              {
-                int iSum = 0, iCnt = 0;
-                const int iCenter = pRow[c];
-                if (iCenter >= levels)
-                  continue;
+            const int d = distances[i];
+            if (d < 1)
+              continue;
+            double* pCorrelogram = vecCorrelogram.data() + i * iLevels;
 
-                int iWindowHStart = c-iDist, iWindowHEnd = c+iDist;
+            // Column histograms cover rows [r-d+1, r+d-1].
+            vecColumns.fill(0);
+            for (int r=qMax(firstRow-d+1, 0); r<qMin(firstRow+d, iRows); ++r)
+              updateColumns(pColumns, r, 1);
 
-                // Verticals
-                if (iWindowHStart >= 0)
+            for (int r=firstRow; r<iLastRow; ++r)
+              {
+                if (r > firstRow)
                   {
-                    for (int v=0; v<=iWindowVEnd; ++v)
-                      if (image(v, iWindowHStart) == iCenter)
-                        ++iSum;
-                    iCnt += iWindowVEnd + 1;
+                    if (r-d >= 0)
+                      updateColumns(pColumns, r-d, -1);
+                    if (r+d-1 < iRows)
+                      updateColumns(pColumns, r+d-1, 1);
                   }
-                else
-                  iWindowHStart = -1;
-
-                if (iWindowHEnd < iCols)
+                const int* pRow = image[r];
+                const int* pRowAbove = r-d >= 0 ? image[r-d] : 0;
+                const int* pRowBelow = r+d < iRows ? image[r+d] : 0;
+                vecAbove.fill(0);
+                vecBelow.fill(0);
+                for (int c=0; c<=qMin(d-1, iCols-1); ++c)
                   {
-                    for (int v=0; v<=iWindowVEnd; ++v)
-                      if (image(v, iWindowHEnd) == iCenter)
-                        ++iSum;
-                    iCnt += iWindowVEnd + 1;
+                    if (pRowAbove != 0 && isValid(pRowAbove[c]))
+                      ++pAbove[pRowAbove[c]];
+                    if (pRowBelow != 0 && isValid(pRowBelow[c]))
+                      ++pBelow[pRowBelow[c]];
                   }
-                else
-                  iWindowHEnd = iCols;
+                const int iVerticalLength = qMax(0, qMin(r+d-1, iRows-1) - qMax(r-d+1, 0) + 1);
 
-                // Horizontal
-                if (pRow1 != 0)
+                for (int c=0; c<iCols; ++c)
                   {
-                    for (int h=iWindowHStart+1; h<iWindowHEnd; ++h)
-                      if (pRow1[h] == iCenter)
-                        ++iSum;
-                    iCnt += iWindowHEnd - iWindowHStart - 1;
+                    if (pRowAbove != 0)
+                      slide(pAbove, pRowAbove, c, d, iCols);
+                    if (pRowBelow != 0)
+                      slide(pBelow, pRowBelow, c, d, iCols);
+                    const int iCenter = pRow[c];
+                    if (!isValid(iCenter))
+                      continue;
+
+                    const int iHorizontalLength = qMin(c+d, iCols-1) - qMax(c-d, 0) + 1;
+                    int iSum = 0, iCount = 0;
+                    if (pRowAbove != 0)
+                      {
+                        iSum += pAbove[iCenter];
+                        iCount += iHorizontalLength;
+                      }
+                    if (pRowBelow != 0)
+                      {
+                        iSum += pBelow[iCenter];
+                        iCount += iHorizontalLength;
+                      }
+                    if (c-d >= 0)
+                      {
+                        iSum += pColumns[(c-d) * iLevels + iCenter];
+                        iCount += iVerticalLength;
+                      }
+                    if (c+d < iCols)
+                      {
+                        iSum += pColumns[(c+d) * iLevels + iCenter];
+                        iCount += iVerticalLength;
+                      }
+                    if (iCount > 0)
+                      pCorrelogram[iCenter] += double(iSum) / iCount;
                   }
-                if (iCnt > 0)
-                  pCorrelogram[iCenter] += float(iSum) / iCnt;
               }
           }
 
-        // Center
-        for (; r<iLastRow; ++r)
+        synchronized (pMutex) pPartials->insert(firstRow, vecCorrelogram);
+      }
+
+      const PiiMatrix<int>& image;
+      const QList<int>& distances;
+      const int iLevels;
+      QMutex* pMutex;
+      QMap<int,QVector<double> >* pPartials;
+    };
+  }
+
+  PiiMatrix<float> autocorrelogram(const Pii::ParallelExecution& policy,
+                                   const PiiMatrix<int>& image,
+                                   const QList<int>& distances,
+                                   int levels)
+  {
+    if (levels <= 0)
+      levels = image.isEmpty() ? 1 : Pii::max(image) + 1;
+    PiiMatrix<float> matCorrelogram(1, levels * distances.size());
+    if (image.isEmpty() || distances.isEmpty())
+      return matCorrelogram;
+
+    int iMaxDistance = 1;
+    for (int i=0; i<distances.size(); ++i)
+      iMaxDistance = qMax(iMaxDistance, distances[i]);
+
+    // Each band reduces into its own partial correlogram. The
+    // partials are summed in row order to keep the result
+    // independent of scheduling.
+    QMutex mutex;
+    QMap<int,QVector<double> > mapPartials;
+    Pii::forEachBand(policy, image.rows(), iMaxDistance,
+                     CorrelogramBand(image, distances, levels, &mutex, &mapPartials));
+
+    QVector<double> vecSum(matCorrelogram.columns());
+    for (QMap<int,QVector<double> >::const_iterator i = mapPartials.constBegin(); i != mapPartials.constEnd(); ++i)
+      for (int j=0; j<vecSum.size(); ++j)
+        vecSum[j] += i.value()[j];
+    float* pCorrelogram = matCorrelogram[0];
+    for (int j=0; j<vecSum.size(); ++j)
+      pCorrelogram[j] = float(vecSum[j]);
+    return matCorrelogram;
+  }
+
+  namespace
+  {
+    bool useSse2()
+    {
+#if defined(PII_X86_SIMD)
+      return Pii::hasCpuFeatures(Pii::Sse2CpuFeature);
+#else
+      return false;
+#endif
+    }
+
+    /* The squared distance of a color x (a row vector) to the model is
+     * |(x-t)A|^2 = (x-t) A A^T (x-t)^T. The symmetric matrix A A^T is
+     * factored to L L^T with a lower triangular L, which leaves six
+     * multiplications per pixel in |(x-t)L|^2. A semi-definite form
+     * (a degenerate model) just zeros the corresponding column.
+     */
+    struct ColorForm
+    {
+      ColorForm(const PiiMatrix<double>& baseVectors, const PiiMatrix<double>& center)
+      {
+        double m[3][3];
+        for (int i=0; i<3; ++i)
+          for (int k=0; k<3; ++k)
+            m[i][k] = baseVectors(i,0) * baseVectors(k,0) +
+              baseVectors(i,1) * baseVectors(k,1) +
+              baseVectors(i,2) * baseVectors(k,2);
+        double l[3][3] = { { 0, 0, 0 }, { 0, 0, 0 }, { 0, 0, 0 } };
+        for (int j=0; j<3; ++j)
           {
-            const int iWindowVStart = r-iDist, iWindowVEnd = r+iDist;
-            const int* pRow1 = image[iWindowVStart], *pRow = image[r], *pRow2 = image[iWindowVEnd];
-            int c = 0, iSum = 0, iCnt = 0;
-            // Left center
-            for (; c<qMin(iCols, iDist); ++c)
-              {
-                iSum = 0;
-                const int iCenter = pRow[c], iWindowHEnd = qMin(iCols-1, c+iDist);
-                if (iCenter >= levels)
-                  continue;
-                for (int h=0; h<=iWindowHEnd; ++h)
-                  {
-                    if (pRow1[h] == iCenter)
-                      ++iSum;
-                    if (pRow2[h] == iCenter)
-                      ++iSum;
-                  }
-                iCnt = (iWindowHEnd+1)*2;
-                if (c+iDist < iCols)
-                  {
-                    for (int v=iWindowVStart+1; v<iWindowVEnd; ++v)
-                      if (image(v, iWindowHEnd) == iCenter)
-                        ++iSum;
-                    iCnt += iWindowVEnd - iWindowVStart - 1;
-                  }
-                pCorrelogram[iCenter] += float(iSum) / iCnt;
-              }
-            // Image center
-            for (; c<iLastCol; ++c)
-              {
-                iSum = 0;
-                const int iCenter = pRow[c], iWindowHStart = c-iDist, iWindowHEnd = c+iDist;
-                if (iCenter >= levels)
-                  continue;
-                for (int h=iWindowHStart; h<=iWindowHEnd; ++h)
-                  {
-                    if (pRow1[h] == iCenter)
-                      ++iSum;
-                    if (pRow2[h] == iCenter)
-                      ++iSum;
-                  }
-                for (int v=iWindowVStart+1; v<iWindowVEnd; ++v)
-                  {
-                    if (image(v, iWindowHStart) == iCenter)
-                      ++iSum;
-                    if (image(v, iWindowHEnd) == iCenter)
-                      ++iSum;
-                  }
-                pCorrelogram[iCenter] += float(iSum) / iWindowSize;
-              }
-            // Right center
-            for (; c<iCols; ++c)
+            double dPivot = m[j][j];
+            for (int k=0; k<j; ++k)
+              dPivot -= l[j][k] * l[j][k];
+            if (dPivot <= 0)
+              continue;
+            l[j][j] = std::sqrt(dPivot);
+            for (int i=j+1; i<3; ++i)
               {
-                iSum = 0, iCnt = 0;
-                const int iCenter = pRow[c], iWindowHStart = qMax(0, c-iDist), iWindowHEnd = iCols-1;
-                if (iCenter >= levels)
-                  continue;
-                for (int h=iWindowHStart; h<=iWindowHEnd; ++h, iCnt += 2)
-                  {
-                    if (pRow1[h] == iCenter)
-                      ++iSum;
-                    if (pRow2[h] == iCenter)
-                      ++iSum;
-                  }
-                if (c-iDist >= 0)
-                  for (int v=iWindowVStart+1; v<iWindowVEnd; ++v, ++iCnt)
-                    if (image(v, iWindowHStart) == iCenter)
-                      ++iSum;
-                pCorrelogram[iCenter] += float(iSum) / iCnt;
+                double dSum = m[i][j];
+                for (int k=0; k<j; ++k)
+                  dSum -= l[i][k] * l[j][k];
+                l[i][j] = dSum / l[j][j];
               }
           }
+        fL00 = float(l[0][0]); fL10 = float(l[1][0]); fL20 = float(l[2][0]);
+        fL11 = float(l[1][1]); fL21 = float(l[2][1]);
+        fL22 = float(l[2][2]);
+        for (int i=0; i<3; ++i)
+          aCenter[i] = float(center(i));
+      }
 
-        // Bottom boundary
-        for (; r<iRows; ++r)
-          {
-            const int iWindowVEnd = iRows-1, iWindowVStart = r-iDist;
-            const int* pRow = image[r], *pRow1 = image[iWindowVStart];
+      float operator() (const unsigned char* pixel) const
+      {
+        const float x0 = pixel[0] - aCenter[0], x1 = pixel[1] - aCenter[1], x2 = pixel[2] - aCenter[2];
+        const float y0 = x0 * fL00 + x1 * fL10 + x2 * fL20,
+          y1 = x1 * fL11 + x2 * fL21,
+          y2 = x2 * fL22;
+        return y0*y0 + y1*y1 + y2*y2;
+      }
 
-            for (int c=0; c<iCols; ++c)
-              {
-                int iSum = 0, iCnt = 0;
-                const int iCenter = pRow[c];
-                if (iCenter >= levels)
-                  continue;
+      float aCenter[3];
+      float fL00, fL10, fL20, fL11, fL21, fL22;
+    };
 
-                int iWindowHStart = c-iDist, iWindowHEnd = c+iDist;
+#ifdef PII_X86_SIMD
+    /* Four pixels are processed at a time. Each 32-bit lane holds the
+     * channels of one pixel in its three lowest bytes. Three-byte
+     * pixels are spread to lanes by shifting the source register.
+     */
+    PII_CPU_TARGET("sse2")
+    int colorDistancesSse2(const ColorForm& form, const unsigned char* pixels, int pixelSize, int columns,
+                           float threshold, float* distances, unsigned char* mask)
+    {
+      const __m128i byteMask = _mm_set1_epi32(0xff);
+      const __m128 t0 = _mm_set1_ps(form.aCenter[0]), t1 = _mm_set1_ps(form.aCenter[1]),
+        t2 = _mm_set1_ps(form.aCenter[2]),
+        l00 = _mm_set1_ps(form.fL00), l10 = _mm_set1_ps(form.fL10), l20 = _mm_set1_ps(form.fL20),
+        l11 = _mm_set1_ps(form.fL11), l21 = _mm_set1_ps(form.fL21), l22 = _mm_set1_ps(form.fL22),
+        limit = _mm_set1_ps(threshold);
+      const __m128i one = _mm_set1_epi32(1);
+      // Each load reads 16 bytes.
+      const int iLast = columns - (pixelSize == 4 ? 4 : 6);
+      int c = 0;
+      for (; c <= iLast; c += 4)
+        {
+          __m128i lanes = _mm_loadu_si128(reinterpret_cast<const __m128i*>(pixels + c * pixelSize));
+          if (pixelSize == 3)
+            lanes = _mm_unpacklo_epi64(_mm_unpacklo_epi32(lanes, _mm_srli_si128(lanes, 3)),
+                                       _mm_unpacklo_epi32(_mm_srli_si128(lanes, 6), _mm_srli_si128(lanes, 9)));
+          const __m128 x0 = _mm_sub_ps(_mm_cvtepi32_ps(_mm_and_si128(lanes, byteMask)), t0),
+            x1 = _mm_sub_ps(_mm_cvtepi32_ps(_mm_and_si128(_mm_srli_epi32(lanes, 8), byteMask)), t1),
+            x2 = _mm_sub_ps(_mm_cvtepi32_ps(_mm_and_si128(_mm_srli_epi32(lanes, 16), byteMask)), t2);
+          const __m128 y0 = _mm_add_ps(_mm_add_ps(_mm_mul_ps(x0, l00), _mm_mul_ps(x1, l10)), _mm_mul_ps(x2, l20)),
+            y1 = _mm_add_ps(_mm_mul_ps(x1, l11), _mm_mul_ps(x2, l21)),
+            y2 = _mm_mul_ps(x2, l22);
+          const __m128 d = _mm_add_ps(_mm_add_ps(_mm_mul_ps(y0, y0), _mm_mul_ps(y1, y1)), _mm_mul_ps(y2, y2));
+          if (distances != 0)
+            _mm_storeu_ps(distances + c, d);
+          if (mask != 0)
+            {
+              const __m128i inside = _mm_and_si128(_mm_castps_si128(_mm_cmplt_ps(d, limit)), one);
+              const __m128i words = _mm_packs_epi32(inside, inside);
+              const int iBytes = _mm_cvtsi128_si32(_mm_packus_epi16(words, words));
+              std::memcpy(mask + c, &iBytes, 4);
+            }
+        }
+      return c;
+    }
+#endif
 
-                // Verticals
-                if (iWindowHStart >= 0)
-                  {
-                    for (int v=iWindowVStart; v<=iWindowVEnd; ++v)
-                      if (image(v, iWindowHStart) == iCenter)
-                        ++iSum;
-                    iCnt += iWindowVEnd - iWindowVStart + 1;
-                  }
-                else
-                  iWindowHStart = -1;
+    struct ColorDistanceBand
+    {
+      ColorDistanceBand(const ColorForm& form, const unsigned char* pixels, std::size_t pixelStride,
+                        int pixelSize, int columns, float threshold,
+                        float* distances, std::size_t distanceStride,
+                        unsigned char* mask, std::size_t maskStride) :
+        form(form), pPixels(pixels), iPixelStride(pixelStride), iPixelSize(pixelSize),
+        iColumns(columns), fThreshold(threshold),
+        pDistances(distances), iDistanceStride(distanceStride),
+        pMask(mask), iMaskStride(maskStride)
+      {}
 
-                if (iWindowHEnd < iCols)
-                  {
-                    for (int v=iWindowVStart; v<=iWindowVEnd; ++v)
-                      if (image(v, iWindowHEnd) == iCenter)
-                        ++iSum;
-                    iCnt += iWindowVEnd - iWindowVStart + 1;
-                  }
-                else
-                  iWindowHEnd = iCols;
-
-                // Horizontal
-                for (int h=iWindowHStart+1; h<iWindowHEnd; ++h)
-                  if (pRow1[h] == iCenter)
-                    ++iSum;
-                iCnt += iWindowHEnd - iWindowHStart - 1;
-                pCorrelogram[iCenter] += float(iSum) / iCnt;
+      void operator() (int firstRow, int rowCount) const
+      {
+        const bool bSimd = useSse2();
+        for (int r=firstRow; r<firstRow+rowCount; ++r)
+          {
+            const unsigned char* pRow = pPixels + r * iPixelStride;
+            float* pDistanceRow = pDistances != 0 ?
+              reinterpret_cast<float*>(reinterpret_cast<char*>(pDistances) + r * iDistanceStride) : 0;
+            unsigned char* pMaskRow = pMask != 0 ? pMask + r * iMaskStride : 0;
+            int c = 0;
+#ifdef PII_X86_SIMD
+            if (bSimd)
+              c = colorDistancesSse2(form, pRow, iPixelSize, iColumns, fThreshold, pDistanceRow, pMaskRow);
+#else
+            Q_UNUSED(bSimd);
+#endif
+            for (; c<iColumns; ++c)
+              {
+                const float fDistance = form(pRow + c * iPixelSize);
+                if (pDistanceRow != 0)
+                  pDistanceRow[c] = fDistance;
+                if (pMaskRow != 0)
+                  pMaskRow[c] = fDistance < fThreshold ? 1 : 0;
               }
           }
-
-        pCorrelogram += levels;
       }
-    return matCorrelogram;
+
+      const ColorForm& form;
+      const unsigned char* pPixels;
+      std::size_t iPixelStride;
+      int iPixelSize, iColumns;
+      float fThreshold;
+      float* pDistances;
+      std::size_t iDistanceStride;
+      unsigned char* pMask;
+      std::size_t iMaskStride;
+    };
+
+    template <class Clr> PiiMatrix<float> calculateColorDistances(const Pii::ParallelExecution& policy,
+                                                                  const PiiMatrix<Clr>& clrImage,
+                                                                  const PiiMatrix<double>& baseVectors,
+                                                                  const PiiMatrix<double>& center)
+    {
+      PiiMatrix<float> matResult(PiiMatrix<float>::uninitialized(clrImage.rows(), clrImage.columns()));
+      if (matResult.isEmpty())
+        return matResult;
+      const ColorForm form(baseVectors, center);
+      Pii::forEachBand(policy, clrImage.rows(), 0,
+                       ColorDistanceBand(form, reinterpret_cast<const unsigned char*>(clrImage.row(0)),
+                                         clrImage.stride(), sizeof(Clr), clrImage.columns(), 0,
+                                         matResult.row(0), matResult.stride(), 0, 0));
+      return matResult;
+    }
+
+    template <class Clr> PiiMatrix<unsigned char> thresholdColorDistances(const Pii::ParallelExecution& policy,
+                                                                          const PiiMatrix<Clr>& clrImage,
+                                                                          const PiiMatrix<double>& baseVectors,
+                                                                          const PiiMatrix<double>& center,
+                                                                          double threshold)
+    {
+      PiiMatrix<unsigned char> matResult(PiiMatrix<unsigned char>::uninitialized(clrImage.rows(), clrImage.columns()));
+      if (matResult.isEmpty())
+        return matResult;
+      const ColorForm form(baseVectors, center);
+      Pii::forEachBand(policy, clrImage.rows(), 0,
+                       ColorDistanceBand(form, reinterpret_cast<const unsigned char*>(clrImage.row(0)),
+                                         clrImage.stride(), sizeof(Clr), clrImage.columns(), float(threshold),
+                                         0, 0, matResult.row(0), matResult.stride()));
+      return matResult;
+    }
+  }
+
+  PiiMatrix<float> colorDistances(const Pii::ParallelExecution& policy,
+                                  const PiiMatrix<PiiColor<unsigned char> >& clrImage,
+                                  const PiiMatrix<double>& baseVectors,
+                                  const PiiMatrix<double>& center)
+  {
+    return calculateColorDistances<PiiColor<unsigned char> >(policy, clrImage, baseVectors, center);
+  }
+
+  PiiMatrix<float> colorDistances(const Pii::ParallelExecution& policy,
+                                  const PiiMatrix<PiiColor4<unsigned char> >& clrImage,
+                                  const PiiMatrix<double>& baseVectors,
+                                  const PiiMatrix<double>& center)
+  {
+    return calculateColorDistances<PiiColor4<unsigned char> >(policy, clrImage, baseVectors, center);
+  }
+
+  PiiMatrix<unsigned char> matchColors(const Pii::ParallelExecution& policy,
+                                       const PiiMatrix<PiiColor<unsigned char> >& clrImage,
+                                       const PiiMatrix<double>& baseVectors,
+                                       const PiiMatrix<double>& center,
+                                       double threshold)
+  {
+    return thresholdColorDistances<PiiColor<unsigned char> >(policy, clrImage, baseVectors, center, threshold);
+  }
+
+  PiiMatrix<unsigned char> matchColors(const Pii::ParallelExecution& policy,
+                                       const PiiMatrix<PiiColor4<unsigned char> >& clrImage,
+                                       const PiiMatrix<double>& baseVectors,
+                                       const PiiMatrix<double>& center,
+                                       double threshold)
+  {
+    return thresholdColorDistances<PiiColor4<unsigned char> >(policy, clrImage, baseVectors, center, threshold);
   }
 }
@@ -21,6 +21,7 @@
 #include <PiiMath.h>
 #include <PiiFunctional.h>
 #include <PiiImageTraits.h>
+#include <PiiParallel.h>
 #include <PiiTypeTraits.h>
 
 #include "PiiColorsGlobal.h"
@@ -91,6 +92,23 @@ namespace PiiColors
                                         float multiplier = 255,
                                         int ch1Index = 0, int ch2Index = 1);
 
+  /**
+   * Converts an RGB color image to normalized RGB in parallel. The
+   * rows of *image* are split into bands as determined by *policy*.
+   * If *ch1* and *ch2* already have the size of *image*, their data
+   * is overwritten without reallocating. With 8-bit channels, the
+   * output is 8-bit as well and can be fed to histogram-based
+   * features directly.
+   *
+   * @see normalizedRgb(const PiiMatrix<T>&, PiiMatrix<typename T::Type>&, PiiMatrix<typename T::Type>&, float, int, int)
+   */
+  template <class T> void normalizedRgb(const Pii::ParallelExecution& policy,
+                                        const PiiMatrix<T>& image,
+                                        PiiMatrix<typename T::Type>& ch1,
+                                        PiiMatrix<typename T::Type>& ch2,
+                                        float multiplier = 255,
+                                        int ch1Index = 0, int ch2Index = 1);
+
   /**
    * Measure the distribution of colors in an image. This function
    * uses PCA to find the main axes of a three-dimensional color
@@ -196,6 +214,73 @@ namespace PiiColors
                                                              const PiiMatrix<double>& center,
                                                              UnaryFunction func);
 
+  /**
+   * Calculates the squared distance of each pixel to a color model in
+   * normalized coordinates. The result equals the value passed to
+   * the user-specified function in [matchColors()], but it is
+   * calculated much faster: the base is converted to a triangular
+   * Cholesky factor of the quadratic form once, and pixels are
+   * processed in single precision with SIMD instructions in bands of
+   * rows determined by *policy*.
+   *
+   * @param policy parallel execution policy
+   *
+   * @param clrImage the input image
+   *
+   * @param baseVectors a 3-by-3 matrix in which rows represent a
+   * normalized base for the color system.
+   *
+   * @param center a 1-by-3 translation vector
+   *
+   * @return squared Mahalanobis distances
+   *
+   * ~~~(c++)
+   * PiiMatrix<double> matBase, matCenter;
+   * PiiColors::measureColorDistribution(model, matBase, matCenter);
+   * PiiMatrix<float> matLikelihood(PiiColors::colorDistances(Pii::ParallelExecution(),
+   *                                                          image, matBase, matCenter));
+   * matLikelihood.map(PiiColors::LikelihoodFunction());
+   * ~~~
+   */
+  PII_COLORS_EXPORT PiiMatrix<float> colorDistances(const Pii::ParallelExecution& policy,
+                                                    const PiiMatrix<PiiColor<unsigned char> >& clrImage,
+                                                    const PiiMatrix<double>& baseVectors,
+                                                    const PiiMatrix<double>& center);
+
+  /**
+   * @overload
+   *
+   * The fourth channel is ignored.
+   */
+  PII_COLORS_EXPORT PiiMatrix<float> colorDistances(const Pii::ParallelExecution& policy,
+                                                    const PiiMatrix<PiiColor4<unsigned char> >& clrImage,
+                                                    const PiiMatrix<double>& baseVectors,
+                                                    const PiiMatrix<double>& center);
+
+  /**
+   * Matches colors in an image to a color model and thresholds the
+   * result. Pixels whose squared distance to the model (see
+   * [colorDistances()]) is less than *threshold* will be set to one
+   * in the returned binary image, others to zero. No intermediate
+   * distance image is created.
+   */
+  PII_COLORS_EXPORT PiiMatrix<unsigned char> matchColors(const Pii::ParallelExecution& policy,
+                                                         const PiiMatrix<PiiColor<unsigned char> >& clrImage,
+                                                         const PiiMatrix<double>& baseVectors,
+                                                         const PiiMatrix<double>& center,
+                                                         double threshold);
+
+  /**
+   * @overload
+   *
+   * The fourth channel is ignored.
+   */
+  PII_COLORS_EXPORT PiiMatrix<unsigned char> matchColors(const Pii::ParallelExecution& policy,
+                                                         const PiiMatrix<PiiColor4<unsigned char> >& clrImage,
+                                                         const PiiMatrix<double>& baseVectors,
+                                                         const PiiMatrix<double>& center,
+                                                         double threshold);
+
   /**
    * Convert a color image into indexed colors. This function
    * quantizes each color channel to the specified number of levels.
@@ -216,6 +301,10 @@ namespace PiiColors
    * @param blueLevels the number of quantization levels for the blue
    * color channel. 0 means same as `redLevels`.
    *
+   * Eight-bit channels are quantized with look-up tables that
+   * directly give each channel's contribution to the index. The
+   * maximum channel value maps to the highest level.
+   *
    * ! Despite the color channel names used here, the function
    * also works with color spaces other than RGB.
    */
@@ -276,6 +365,22 @@ namespace PiiColors
                                                      const QList<int>& distances,
                                                      int levels = 0);
 
+  /**
+   * Calculates the autocorrelogram of an indexed color image in
+   * parallel. The image is split into bands of rows as determined by
+   * *policy*, and the partial correlograms of the bands are summed.
+   * The number of operations per pixel does not depend on the
+   * distances: matching pixels on the ring around each pixel are
+   * counted with histograms that are updated incrementally along
+   * rows and columns.
+   *
+   * @see autocorrelogram(const PiiMatrix<int>&, const QList<int>&, int)
+   */
+  PII_COLORS_EXPORT PiiMatrix<float> autocorrelogram(const Pii::ParallelExecution& policy,
+                                                     const PiiMatrix<int>& image,
+                                                     const QList<int>& distances,
+                                                     int levels = 0);
+
   /**
    * Apply gamma correction to a color channel. Gamma correction is
    * defined as \(v_o = v_i^\gamma\), where `o` and `i` stand for
@@ -345,7 +450,8 @@ namespace PiiColors
   {
     return PiiColor4<T>(correctGamma(clr.c0, gamma),
                         correctGamma(clr.c1, gamma),
-                        correctGamma(clr.c2, gamma));
+                        correctGamma(clr.c2, gamma),
+                        clr.c3);
   }
 
   /**
@@ -368,7 +474,8 @@ namespace PiiColors
   {
     return PiiColor4<T>(correctGamma(clr.c0, gamma, maximum),
                         correctGamma(clr.c1, gamma, maximum),
-                        correctGamma(clr.c2, gamma, maximum));
+                        correctGamma(clr.c2, gamma, maximum),
+                        clr.c3);
   }
 
   /**
@@ -414,12 +521,15 @@ namespace PiiColors
    * works with both gray-level and color images. Color channels are
    * assumed to be in [0, `maximum`].
    *
+   * With 8-bit channels, and with 16-bit channels in images large
+   * enough to amortize the cost, the correction is applied through a
+   * look-up table that is calculated with [correctGamma(T, double,
+   * double)]. The result is identical to correcting each pixel
+   * separately.
+   *
    * @see correctGamma(T, double, double)
    */
-  template <class T> inline PiiMatrix<T> correctGamma(const PiiMatrix<T>& image, double gamma, double maximum)
-  {
-    return Pii::matrix(image.mapped(CorrectGammaScaled<T>(gamma, maximum)));
-  }
+  template <class T> PiiMatrix<T> correctGamma(const PiiMatrix<T>& image, double gamma, double maximum);
 
   /**
    * A unary function for converting color distances to "likelihoods".
@@ -524,6 +634,25 @@ namespace PiiColors
     return Pii::matrix(rgbColorImage.mapped(RgbToHsv<Clr>()));
   }
 
+  /// @hide
+  template <class Clr> struct RgbToHsvBandFunction
+  {
+    PiiMatrix<Clr> operator() (const PiiMatrix<Clr>& rgbColorImage) const { return rgbToHsv(rgbColorImage); }
+  };
+  /// @hide
+
+  /**
+   * Converts an RGB color image into an HSV color image in parallel.
+   * The image is split into bands of rows as determined by *policy*.
+   *
+   * @see rgbToHsv(const PiiMatrix<Clr>&)
+   */
+  template <class Clr> inline PiiMatrix<Clr> rgbToHsv(const Pii::ParallelExecution& policy,
+                                                      const PiiMatrix<Clr>& rgbColorImage)
+  {
+    return Pii::transformBands<Clr>(policy, rgbColorImage, 0, RgbToHsvBandFunction<Clr>());
+  }
+
   /**
    * Convert an HSV color image into an RGB color image.
    *
@@ -826,12 +955,14 @@ namespace PiiColors
 
   /**
    * Convert a color image in a non-linear RGB space into Y'CbCr.
+   *
+   * 8-bit color images (PiiColor<unsigned char> and
+   * PiiColor4<unsigned char>) with *maximum* = 255 are converted a
+   * row at a time by a kernel that has no branches in its inner loop.
+   * The result is bit-identical to [rgbToYcbcr(const Clr&, double)].
    */
-  template <class T> inline PiiMatrix<T> rgbToYcbcr(const PiiMatrix<T>& image,
-                                                    double maximum = PiiImage::Traits<T>::max())
-  {
-    return Pii::matrix(image.mapped(RgbToYcbcr<T>(maximum)));
-  }
+  template <class T> PiiMatrix<T> rgbToYcbcr(const PiiMatrix<T>& image,
+                                             double maximum = PiiImage::Traits<T>::max());
 
   /**
    * An adaptable unary function for converting from Y'CbCr to
@@ -847,13 +978,12 @@ namespace PiiColors
   };
 
   /**
-   * Convert a color image in a Y'CbCr space to non-linear RGB.
+   * Convert a color image in a Y'CbCr space to non-linear RGB. 8-bit
+   * color images are converted with a row kernel, see
+   * [rgbToYcbcr(const PiiMatrix<T>&, double)].
    */
-  template <class T> inline PiiMatrix<T> ycbcrToRgb(const PiiMatrix<T>& image,
-                                                    double maximum = PiiImage::Traits<T>::max())
-  {
-    return Pii::matrix(image.mapped(YcbcrToRgb<T>(maximum)));
-  }
+  template <class T> PiiMatrix<T> ycbcrToRgb(const PiiMatrix<T>& image,
+                                             double maximum = PiiImage::Traits<T>::max());
 
   /**
    * An adaptable binary function that multiplies a color with a
@@ -895,6 +1025,8 @@ namespace PiiColors
   void yuv411toRgb(const typename Color::value_type *yuvData, Color* rgbData, int width, int height);
   template <class Color>
   void yuv422toRgb(const typename Color::value_type *yuvData, Color* rgbData, int width, int height);
+  template <class Color>
+  void nv12toRgb(const typename Color::value_type *yuvData, Color* rgbData, int width, int height);
 
   template <class Color>
   PiiMatrix<Color> yuv411toRgb(const typename Color::value_type *yuvData, int width, int height)
@@ -912,6 +1044,20 @@ namespace PiiColors
     return matResult;
   }
 
+  /**
+   * Converts an NV12 frame to RGB. NV12 stores a *width* by *height*
+   * luma plane followed by a plane of interleaved U and V samples,
+   * each shared by a 2-by-2 block of pixels. *width* and *height*
+   * must be even.
+   */
+  template <class Color>
+  PiiMatrix<Color> nv12toRgb(const typename Color::value_type *yuvData, int width, int height)
+  {
+    PiiMatrix<Color> matResult(PiiMatrix<Color>::uninitialized(height, width));
+    nv12toRgb(yuvData, matResult[0], width, height);
+    return matResult;
+  }
+
   template <class Color> inline void yuvToRgb(Color& data, int y, int u, int v)
   {
     typedef typename Color::value_type T;
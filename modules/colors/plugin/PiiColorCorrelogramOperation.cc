@@ -47,6 +47,9 @@ void PiiColorCorrelogramOperation::check(bool reset)
 
   if (d->iLevels < 2)
     PII_THROW(PiiExecutionException, tr("The number of quantization levels must be at least two."));
+  for (int i=0; i<d->lstDistances.size(); ++i)
+    if (d->lstDistances[i] < 1)
+      PII_THROW(PiiExecutionException, tr("Correlogram distances must be positive."));
   PiiDefaultOperation::check(reset);
 }
 
@@ -80,7 +83,8 @@ template <class Clr> void PiiColorCorrelogramOperation::processColor(const PiiVa
   const PiiMatrix<Clr> img = obj.valueAs<PiiMatrix<Clr> >();
   if (d->bQuantize)
     {
-      d->pOutput->emitObject(PiiColors::autocorrelogram(PiiColors::toIndexed(img, d->iLevels),
+      d->pOutput->emitObject(PiiColors::autocorrelogram(Pii::ParallelExecution(),
+                                                        PiiColors::toIndexed(img, d->iLevels),
                                                         d->lstDistances,
                                                         d->iLevels*d->iLevels*d->iLevels));
     }
@@ -98,7 +102,8 @@ template <class Clr> void PiiColorCorrelogramOperation::processColor(const PiiVa
               d->iLevels * pSource[c].rgbG +
               pSource[c].rgbB;
         }
-      d->pOutput->emitObject(PiiColors::autocorrelogram(img,
+      d->pOutput->emitObject(PiiColors::autocorrelogram(Pii::ParallelExecution(),
+                                                        matIndexed,
                                                         d->lstDistances,
                                                         d->iLevels*d->iLevels*d->iLevels));
     }
@@ -112,14 +117,16 @@ template <class T> void PiiColorCorrelogramOperation::processGray(const PiiVaria
   if (d->bQuantize)
     {
       double dScale = double(d->iLevels) / PiiImage::Traits<T>::max();
-      d->pOutput->emitObject(PiiColors::autocorrelogram(Pii::matrix(img.mapped(Pii::unaryCompose(Pii::Round<T>(),
+      d->pOutput->emitObject(PiiColors::autocorrelogram(Pii::ParallelExecution(),
+                                                        Pii::matrix(img.mapped(Pii::unaryCompose(Pii::Round<T>(),
                                                                                                  std::bind2nd(std::multiplies<double>(), dScale)))),
                                                         d->lstDistances,
                                                         d->iLevels));
     }
   else
     {
-      d->pOutput->emitObject(PiiColors::autocorrelogram(img,
+      d->pOutput->emitObject(PiiColors::autocorrelogram(Pii::ParallelExecution(),
+                                                        PiiMatrix<int>(img),
                                                         d->lstDistances,
                                                         d->iLevels));
     }
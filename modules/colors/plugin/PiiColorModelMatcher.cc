@@ -62,19 +62,47 @@ template <class T> void PiiColorModelMatcher::calculateModel(const PiiVariant& o
 }
 
 template <class T> void PiiColorModelMatcher::matchImageToModel(const PiiVariant& obj)
+{
+  match(obj.valueAs<PiiMatrix<T> >());
+}
+
+template <class Clr> void PiiColorModelMatcher::match(const PiiMatrix<Clr>& image)
 {
   PII_D;
   if (d->dMatchingThreshold > 0)
-    emitObject(PiiColors::matchColors(obj.valueAs<PiiMatrix<T> >(),
-                                                      d->matBaseVectors,
-                                                      d->matCenter,
-                                                      std::bind2nd(PiiImage::InverseThresholdFunction<float,unsigned char>(),
-                                                                   d->dMatchingThreshold)));
+    emitObject(PiiColors::matchColors(image,
+                                      d->matBaseVectors,
+                                      d->matCenter,
+                                      std::bind2nd(PiiImage::InverseThresholdFunction<float,unsigned char>(),
+                                                   d->dMatchingThreshold)));
   else
-    emitObject(PiiColors::matchColors(obj.valueAs<PiiMatrix<T> >(),
-                                                      d->matBaseVectors,
-                                                      d->matCenter,
-                                                      PiiColors::LikelihoodFunction()));
+    emitObject(PiiColors::matchColors(image,
+                                      d->matBaseVectors,
+                                      d->matCenter,
+                                      PiiColors::LikelihoodFunction()));
+}
+
+void PiiColorModelMatcher::match(const PiiMatrix<PiiColor<unsigned char> >& image) { matchBytes(image); }
+void PiiColorModelMatcher::match(const PiiMatrix<PiiColor4<unsigned char> >& image) { matchBytes(image); }
+
+template <class Clr> void PiiColorModelMatcher::matchBytes(const PiiMatrix<Clr>& image)
+{
+  PII_D;
+  if (d->dMatchingThreshold > 0)
+    emitObject(PiiColors::matchColors(Pii::ParallelExecution(),
+                                      image,
+                                      d->matBaseVectors,
+                                      d->matCenter,
+                                      d->dMatchingThreshold));
+  else
+    {
+      PiiMatrix<float> matLikelihood(PiiColors::colorDistances(Pii::ParallelExecution(),
+                                                               image,
+                                                               d->matBaseVectors,
+                                                               d->matCenter));
+      matLikelihood.map(PiiColors::LikelihoodFunction());
+      emitObject(matLikelihood);
+    }
 }
 
 void PiiColorModelMatcher::setMatchingThreshold(double matchingThreshold) { _d()->dMatchingThreshold = matchingThreshold; }
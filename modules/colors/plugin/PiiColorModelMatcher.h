@@ -18,6 +18,7 @@
 
 #include <PiiDefaultOperation.h>
 #include <PiiMatrix.h>
+#include <PiiColor.h>
 
 /**
  * An operation that converts a color image into an intensity map.
@@ -40,6 +41,10 @@
  * thresholded image (PiiMatrix<unsigned char>), if [matchingThreshold]
  * is non-zero.
  *
+ * Eight-bit color images are matched in single precision using a
+ * precomputed Cholesky factor of the color model, in parallel. See
+ * [PiiColors::colorDistances()].
+ *
  */
 class PiiColorModelMatcher : public PiiDefaultOperation
 {
@@ -62,6 +67,10 @@ protected:
 private:
   template <class T> void calculateModel(const PiiVariant& obj);
   template <class T> void matchImageToModel(const PiiVariant& obj);
+  template <class Clr> void match(const PiiMatrix<Clr>& image);
+  void match(const PiiMatrix<PiiColor<unsigned char> >& image);
+  void match(const PiiMatrix<PiiColor4<unsigned char> >& image);
+  template <class Clr> void matchBytes(const PiiMatrix<Clr>& image);
 
   /// @internal
   class Data : public PiiDefaultOperation::Data
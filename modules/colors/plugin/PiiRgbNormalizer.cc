@@ -62,7 +62,7 @@ template <class T> void PiiRgbNormalizer::normalizedRgb(const PiiVariant& obj)
       iCh2 = 2;
     }
 
-  PiiColors::normalizedRgb(clrImg, ch1, ch2, (float)d->dMaxValue, iCh1, iCh2);
+  PiiColors::normalizedRgb(Pii::ParallelExecution(), clrImg, ch1, ch2, (float)d->dMaxValue, iCh1, iCh2);
 
   emitObject(ch1, 0);
   emitObject(ch2, 1);
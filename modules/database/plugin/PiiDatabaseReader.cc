@@ -19,11 +19,16 @@
 
 #include <QSqlQuery>
 #include <QSqlDriver>
+#include <QSqlRecord>
+#include <QSqlField>
 #include <QFile>
 
 PiiDatabaseReader::Data::Data() :
   pQuery(0),
-  pFile(0)
+  pFile(0),
+  iFetchSize(0),
+  iOffset(0),
+  iRowsInPage(0)
 {
 }
 
@@ -37,13 +42,19 @@ PiiDatabaseReader::PiiDatabaseReader() : PiiDatabaseOperation(new Data)
 {
   setProtectionLevel("columnNames", WriteWhenStoppedOrPaused);
   setProtectionLevel("defaultValues", WriteWhenStoppedOrPaused);
+  setProtectionLevel("fetchSize", WriteWhenStopped);
+  setProtectionLevel("orderBy", WriteWhenStopped);
 }
 
 void PiiDatabaseReader::aboutToChangeState(State state)
 {
   PII_D;
   if (state == Stopped)
-    delete d->pFile, d->pFile = 0;
+    {
+      delete d->pFile, d->pFile = 0;
+      // The query must be destroyed before the connection is closed.
+      delete d->pQuery, d->pQuery = 0;
+    }
   PiiDatabaseOperation::aboutToChangeState(state);
 }
 
@@ -82,7 +93,6 @@ QSqlDatabase* PiiDatabaseReader::createDatabase(const QString& driver,
 void PiiDatabaseReader::createQuery()
 {
   PII_D;
-  // PENDING
   QSqlDriver* pDriver = db()->driver();
   QString strQuery("SELECT ");
   for (int i=0; i<d->lstColumnNames.size(); ++i)
@@ -93,8 +103,31 @@ void PiiDatabaseReader::createQuery()
     }
   strQuery.append(" FROM ");
   strQuery.append(pDriver->escapeIdentifier(d->strTableName, QSqlDriver::TableName));
+  if (!d->strOrderBy.isEmpty())
+    strQuery.append(" ORDER BY ").append(d->strOrderBy);
+  if (d->iFetchSize > 0)
+    strQuery.append(" LIMIT ? OFFSET ?");
   d->pQuery = new QSqlQuery(*db());
+  // Don't cache rows that have already been read.
+  d->pQuery->setForwardOnly(true);
   d->pQuery->prepare(strQuery);
+  d->iOffset = 0;
+  d->vecColumnTypes.clear();
+}
+
+void PiiDatabaseReader::executeQuery()
+{
+  PII_D;
+  // Release the previous page before fetching the next one.
+  d->pQuery->finish();
+  if (d->iFetchSize > 0)
+    {
+      d->pQuery->bindValue(0, d->iFetchSize);
+      d->pQuery->bindValue(1, d->iOffset);
+    }
+  d->iRowsInPage = 0;
+  if (!exec(*d->pQuery))
+    operationStopped(); // throws
 }
 
 void PiiDatabaseReader::process()
@@ -106,36 +139,113 @@ void PiiDatabaseReader::process()
       if (openConnection())
         createQuery();
     }
-  else if (d->pFile != 0)
+
+  if (d->pFile != 0)
+    readFileRow();
+  else if (d->pQuery != 0)
+    readDatabaseRow();
+}
+
+void PiiDatabaseReader::readDatabaseRow()
+{
+  PII_D;
+  if (!d->pQuery->isActive())
+    executeQuery();
+  if (!d->pQuery->next())
     {
-      QString strLine(d->pFile->readLine());
-      if (!strLine.isEmpty() && strLine[strLine.size()-1] == '\n')
-        strLine.chop(1);
-      if (!strLine.isEmpty() && strLine[strLine.size()-1] == '\r')
-        strLine.chop(1);
-      if (strLine.isEmpty())
+      // A full page means that there may be more rows.
+      if (d->iFetchSize <= 0 || d->iRowsInPage < d->iFetchSize)
         operationStopped(); // throws
-      QStringList lstParts = Pii::splitQuoted(strLine, QChar(';'));
-      if (lstParts.size() != d->lstColumnNames.size())
+      executeQuery();
+      if (!d->pQuery->next())
+        operationStopped();
+    }
+  ++d->iRowsInPage;
+  ++d->iOffset;
+
+  if (d->vecColumnTypes.isEmpty())
+    resolveColumnTypes();
+
+  for (int i=0; i<d->vecColumnTypes.size(); ++i)
+    emitObject(columnValue(i), i);
+}
+
+void PiiDatabaseReader::resolveColumnTypes()
+{
+  PII_D;
+  QSqlRecord record(d->pQuery->record());
+  const int iColumns = qMin(record.count(), outputCount());
+  d->vecColumnTypes.resize(iColumns);
+  for (int i=0; i<iColumns; ++i)
+    {
+      switch (record.field(i).type())
+        {
+        case QVariant::Int: d->vecColumnTypes[i] = PiiVariant::IntType; break;
+        case QVariant::UInt: d->vecColumnTypes[i] = PiiVariant::UnsignedIntType; break;
+        case QVariant::LongLong: d->vecColumnTypes[i] = PiiVariant::Int64Type; break;
+        case QVariant::ULongLong: d->vecColumnTypes[i] = PiiVariant::UnsignedInt64Type; break;
+        case QVariant::Double: d->vecColumnTypes[i] = PiiVariant::DoubleType; break;
+        case QVariant::Bool: d->vecColumnTypes[i] = PiiVariant::BoolType; break;
+        default: d->vecColumnTypes[i] = PiiYdin::QStringType; break;
+        }
+    }
+}
+
+PiiVariant PiiDatabaseReader::columnValue(int column)
+{
+  PII_D;
+  const QVariant value(d->pQuery->value(column));
+  if (value.isNull())
+    {
+      if (!d->vecDefaultValues[column].isValid())
         PII_THROW(PiiExecutionException,
-                  tr("CSV file has %1 data fields, expected %2.")
-                  .arg(lstParts.size())
-                  .arg(d->lstColumnNames.size()));
-      for (int i=0; i<lstParts.size(); ++i)
+                  tr("Column \"%1\" contains a NULL value, but no default value has been set.")
+                  .arg(d->lstColumnNames[column]));
+      return d->vecDefaultValues[column];
+    }
+
+  switch (d->vecColumnTypes[column])
+    {
+    case PiiVariant::IntType: return PiiVariant(value.toInt());
+    case PiiVariant::UnsignedIntType: return PiiVariant(value.toUInt());
+    case PiiVariant::Int64Type: return PiiVariant(value.toLongLong());
+    case PiiVariant::UnsignedInt64Type: return PiiVariant(value.toULongLong());
+    case PiiVariant::DoubleType: return PiiVariant(value.toDouble());
+    case PiiVariant::BoolType: return PiiVariant(value.toBool());
+    default: return PiiVariant(value.toString());
+    }
+}
+
+void PiiDatabaseReader::readFileRow()
+{
+  PII_D;
+  QString strLine(d->pFile->readLine());
+  if (!strLine.isEmpty() && strLine[strLine.size()-1] == '\n')
+    strLine.chop(1);
+  if (!strLine.isEmpty() && strLine[strLine.size()-1] == '\r')
+    strLine.chop(1);
+  if (strLine.isEmpty())
+    operationStopped(); // throws
+  QStringList lstParts = Pii::splitQuoted(strLine, QChar(';'));
+  if (lstParts.size() != d->lstColumnNames.size())
+    PII_THROW(PiiExecutionException,
+              tr("CSV file has %1 data fields, expected %2.")
+              .arg(lstParts.size())
+              .arg(d->lstColumnNames.size()));
+  for (int i=0; i<lstParts.size(); ++i)
+    {
+      QString strPart(lstParts[i]);
+      switch (d->vecDefaultValues[i].type())
         {
-          QString strPart(lstParts[i]);
-          switch (d->vecDefaultValues[i].type())
-            {
-            case PiiVariant::IntType:
-              emitObject(strPart.isEmpty() ? d->vecDefaultValues[i] : PiiVariant(strPart.toInt()), i);
-              break;
-            case PiiVariant::DoubleType:
-              emitObject(strPart.isEmpty() ? d->vecDefaultValues[i] : PiiVariant(strPart.toDouble()), i);
-              break;
-            default:
-              emitObject(strPart.isEmpty() ? d->vecDefaultValues[i] : PiiVariant(strPart), i);
-              break;
-            }
+        case PiiVariant::IntType:
+          emitObject(strPart.isEmpty() ? d->vecDefaultValues[i] : PiiVariant(strPart.toInt()), i);
+          break;
+        case PiiVariant::DoubleType:
+          emitObject(strPart.isEmpty() ? d->vecDefaultValues[i] : PiiVariant(strPart.toDouble()), i);
+          break;
+        default:
+          emitObject(strPart.isEmpty() ? d->vecDefaultValues[i] : PiiVariant(strPart), i);
+          break;
         }
     }
 }
@@ -187,3 +297,8 @@ void PiiDatabaseReader::initializeDefaults()
 }
 
 QVariantMap PiiDatabaseReader::defaultValues() const { return _d()->mapDefaultValues; }
+
+void PiiDatabaseReader::setFetchSize(int fetchSize) { _d()->iFetchSize = qMax(fetchSize, 0); }
+int PiiDatabaseReader::fetchSize() const { return _d()->iFetchSize; }
+void PiiDatabaseReader::setOrderBy(const QString& orderBy) { _d()->strOrderBy = orderBy; }
+QString PiiDatabaseReader::orderBy() const { return _d()->strOrderBy; }
@@ -40,6 +40,21 @@ class QSqlQuery;
  * type is always QString unless explicitly changed with the
  * [defaultValues] property.
  *
+ * Reading large tables
+ * --------------------
+ *
+ * Rows are read with a forward-only cursor, and only the current row
+ * is kept in memory by the reader. Depending on the driver, the
+ * client library may still buffer the whole result set. In such a
+ * case, [fetchSize] can be used to split the query into pages of a
+ * fixed number of rows, which keeps the memory usage constant
+ * independent of the size of the table.
+ *
+ * The output type of each column is resolved once from the result
+ * set's metadata. Integer, floating-point and boolean columns are
+ * emitted as the corresponding primitive types and all other columns
+ * as QStrings.
+ *
  */
 class PiiDatabaseReader : public PiiDatabaseOperation
 {
@@ -80,6 +95,23 @@ class PiiDatabaseReader : public PiiDatabaseOperation
    */
   Q_PROPERTY(QVariantMap defaultValues READ defaultValues WRITE setDefaultValues);
 
+  /**
+   * The maximum number of rows fetched from the database with one
+   * query. If this value is positive, the table will be read in
+   * pages using `LIMIT` and `OFFSET`. Since the order of rows is
+   * undefined unless explicitly set, [orderBy] should be set to a
+   * unique key when paging is enabled. Zero means that all rows are
+   * read with a single query. The default is zero.
+   */
+  Q_PROPERTY(int fetchSize READ fetchSize WRITE setFetchSize);
+
+  /**
+   * An SQL expression that determines the order of rows, for example
+   * "id" or "time DESC". If empty, no `ORDER BY` clause will be
+   * used. The default is empty.
+   */
+  Q_PROPERTY(QString orderBy READ orderBy WRITE setOrderBy);
+
   PII_OPERATION_SERIALIZATION_FUNCTION
 public:
   PiiDatabaseReader();
@@ -106,6 +138,12 @@ protected:
   QVariantMap defaultValues() const;
   void setDefaultValues(const QVariantMap& defaultValues);
 
+  void setFetchSize(int fetchSize);
+  int fetchSize() const;
+
+  void setOrderBy(const QString& orderBy);
+  QString orderBy() const;
+
 private:
   /// @internal
   class Data : public PiiDatabaseOperation::Data
@@ -120,11 +158,21 @@ private:
     QSqlQuery *pQuery;
     QFile *pFile;
     QVector<PiiVariant> vecDefaultValues;
+    int iFetchSize;
+    QString strOrderBy;
+    qint64 iOffset;
+    int iRowsInPage;
+    QVector<unsigned int> vecColumnTypes;
   };
   PII_D_FUNC;
 
   void initializeDefaults();
   void createQuery();
+  void executeQuery();
+  void readFileRow();
+  void readDatabaseRow();
+  void resolveColumnTypes();
+  PiiVariant columnValue(int column);
 };
 
 #endif //_PIIDATABASEREADER_H
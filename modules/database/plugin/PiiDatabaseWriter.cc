@@ -19,6 +19,8 @@
 #include <QMetaType>
 #include <QSqlQuery>
 #include <QFile>
+#include <QThread>
+#include <PiiAsyncCall.h>
 
 using namespace PiiYdin;
 
@@ -26,13 +28,23 @@ PiiDatabaseWriter::Data::Data() :
   bWriteEnabled(true),
   iDecimalsShown(0),
   pQuery(0),
-  pFile(0)
+  pFile(0),
+  iBatchSize(1),
+  iFlushInterval(0),
+  bMultiRowInsert(false),
+  bBackgroundWriting(false),
+  iQueueLength(4096),
+  pBatchQuery(0),
+  pWriterThread(0),
+  bWriterRunning(false),
+  bFlushRequested(false)
 {
 }
 
 PiiDatabaseWriter::Data::~Data()
 {
   delete pQuery;
+  delete pBatchQuery;
   delete pFile;
 }
 
@@ -41,10 +53,14 @@ PiiDatabaseWriter::PiiDatabaseWriter() :
 {
   setProtectionLevel("columnNames", WriteWhenStoppedOrPaused);
   setProtectionLevel("defaultValues", WriteWhenStoppedOrPaused);
+  setProtectionLevel("batchSize", WriteWhenStoppedOrPaused);
+  setProtectionLevel("multiRowInsert", WriteWhenStoppedOrPaused);
+  setProtectionLevel("backgroundWriting", WriteWhenStopped);
 }
 
 PiiDatabaseWriter::~PiiDatabaseWriter()
 {
+  stopWriter();
   closeConnection();
 }
 
@@ -53,12 +69,44 @@ void PiiDatabaseWriter::aboutToChangeState(State state)
   PII_D;
   if (state == Stopped)
     {
+      if (d->pWriterThread != 0)
+        stopWriter();
+      else
+        flushSafely();
       delete d->pFile, d->pFile = 0;
       delete d->pQuery, d->pQuery = 0;
+      delete d->pBatchQuery, d->pBatchQuery = 0;
+    }
+  else if (state == Paused)
+    {
+      if (d->pWriterThread != 0)
+        {
+          QMutexLocker lock(&d->queueMutex);
+          d->bFlushRequested = true;
+          d->rowsAvailable.wakeOne();
+        }
+      else
+        flushSafely();
     }
   PiiDatabaseOperation::aboutToChangeState(state);
 }
 
+bool PiiDatabaseWriter::flushSafely()
+{
+  // State changes must not throw.
+  try
+    {
+      flushRows();
+      return true;
+    }
+  catch (PiiException& ex)
+    {
+      piiWarning(ex.message());
+      _d()->lstPendingRows.clear();
+    }
+  return false;
+}
+
 void PiiDatabaseWriter::check(bool reset)
 {
   PiiDefaultOperation::check(reset);
@@ -70,6 +118,18 @@ void PiiDatabaseWriter::check(bool reset)
 }
 
 void PiiDatabaseWriter::createQuery()
+{
+  PII_D;
+  d->pQuery = new QSqlQuery(*db());
+  d->pQuery->prepare(createInsert(1));
+  if (d->bMultiRowInsert && d->iBatchSize > 1)
+    {
+      d->pBatchQuery = new QSqlQuery(*db());
+      d->pBatchQuery->prepare(createInsert(d->iBatchSize));
+    }
+}
+
+QString PiiDatabaseWriter::createInsert(int rows)
 {
   PII_D;
   // Prepare an SQL query
@@ -86,9 +146,14 @@ void PiiDatabaseWriter::createQuery()
       strQuery.append(pDriver->escapeIdentifier(d->lstColumnNames[i], QSqlDriver::FieldName));
       strValues.append('?');
     }
-  strQuery.append(QString(") VALUES (%1)").arg(strValues));
-  d->pQuery = new QSqlQuery(*db());
-  d->pQuery->prepare(strQuery);
+  strQuery.append(") VALUES ");
+  for (int r=0; r<rows; ++r)
+    {
+      if (r)
+        strQuery.append(',');
+      strQuery.append(QString("(%1)").arg(strValues));
+    }
+  return strQuery;
 }
 
 QSqlDatabase* PiiDatabaseWriter::createDatabase(const QString& driver,
@@ -120,14 +185,7 @@ void PiiDatabaseWriter::process()
   if (!d->bWriteEnabled)
     return;
 
-  if (!isConnected() && d->pFile == 0)
-    {
-      delete d->pQuery, d->pQuery = 0;
-      if (openConnection())
-        createQuery();
-    }
-
-  QStringList row;
+  Row row;
   for (int i=0; i<inputCount() && i<d->lstColumnNames.size(); i++)
     {
       QVariant value;
@@ -150,36 +208,233 @@ void PiiDatabaseWriter::process()
       else
         value = d->vecDefaultValues[i];
 
-      // Decimal numbers may need rounding
-      if (d->iDecimalsShown > 0 && value.type() == QVariant::Double)
-        row << QString().setNum(value.toDouble(), 'f', d->iDecimalsShown);
-      else
-        row << value.toString();
+      row << value;
+    }
+
+  if (d->bBackgroundWriting)
+    enqueueRow(row);
+  else
+    addRow(row);
+}
 
-      if (d->pQuery != 0)
-        // Bind the value to a prepared query
-        d->pQuery->bindValue(i, value.toString());
+void PiiDatabaseWriter::openOutput()
+{
+  PII_D;
+  if (!isConnected() && d->pFile == 0)
+    {
+      delete d->pQuery, d->pQuery = 0;
+      delete d->pBatchQuery, d->pBatchQuery = 0;
+      if (openConnection())
+        createQuery();
     }
+}
+
+void PiiDatabaseWriter::addRow(const Row& row)
+{
+  PII_D;
+  if (d->lstPendingRows.isEmpty())
+    d->batchTimer.restart();
+  d->lstPendingRows << row;
+  if (d->lstPendingRows.size() >= d->iBatchSize || flushIntervalExceeded())
+    flushRows();
+}
+
+bool PiiDatabaseWriter::flushIntervalExceeded() const
+{
+  const PII_D;
+  return d->iFlushInterval > 0 &&
+    !d->lstPendingRows.isEmpty() &&
+    d->batchTimer.milliseconds() >= d->iFlushInterval;
+}
+
+void PiiDatabaseWriter::flushRows()
+{
+  PII_D;
+  if (d->lstPendingRows.isEmpty())
+    return;
+
+  QList<Row> lstRows;
+  qSwap(lstRows, d->lstPendingRows);
 
+  openOutput();
   if (d->pQuery != 0)
+    writeRowsToDatabase(lstRows);
+  else if (d->pFile != 0)
+    writeRowsToFile(lstRows);
+}
+
+void PiiDatabaseWriter::writeRowsToDatabase(const QList<Row>& rows)
+{
+  PII_D;
+  QSqlDriver* pDriver = db()->driver();
+  const bool bTransaction = rows.size() > 1 &&
+    pDriver->hasFeature(QSqlDriver::Transactions) &&
+    db()->transaction();
+
+  int iRow = 0;
+  bool bSuccess = true;
+  // Full batches are written with a single multi-row statement.
+  if (d->pBatchQuery != 0)
     {
-      // Try to execute the query
-      exec(*d->pQuery);
+      for (; bSuccess && rows.size() - iRow >= d->iBatchSize; iRow += d->iBatchSize)
+        {
+          int iValue = 0;
+          for (int r=iRow; r<iRow + d->iBatchSize; ++r)
+            for (int c=0; c<rows[r].size(); ++c)
+              d->pBatchQuery->bindValue(iValue++, rows[r][c].toString());
+          bSuccess = exec(*d->pBatchQuery);
+        }
     }
-  else if (d->pFile != 0)
+
+  if (bSuccess && rows.size() - iRow > 1 && pDriver->hasFeature(QSqlDriver::BatchOperations))
+    {
+      // Bind each column as a list and execute once.
+      for (int c=0; c<rows[iRow].size(); ++c)
+        {
+          QVariantList lstValues;
+          for (int r=iRow; r<rows.size(); ++r)
+            lstValues << rows[r][c].toString();
+          d->pQuery->bindValue(c, lstValues);
+        }
+      bSuccess = d->pQuery->execBatch();
+      if (!bSuccess)
+        checkQuery(*d->pQuery);
+    }
+  else
+    {
+      for (; bSuccess && iRow<rows.size(); ++iRow)
+        {
+          // Bind the values to a prepared query
+          for (int c=0; c<rows[iRow].size(); ++c)
+            d->pQuery->bindValue(c, rows[iRow][c].toString());
+          // Try to execute the query
+          bSuccess = exec(*d->pQuery);
+        }
+    }
+
+  if (bTransaction)
+    {
+      if (bSuccess)
+        db()->commit();
+      else
+        db()->rollback();
+    }
+}
+
+void PiiDatabaseWriter::writeRowsToFile(const QList<Row>& rows)
+{
+  PII_D;
+  for (int r=0; r<rows.size(); ++r)
     {
-      for (int i=0; i<row.size(); i++)
+      for (int i=0; i<rows[r].size(); i++)
         {
           if (i)
             d->pFile->putChar(',');
-          QString value = row[i].replace('"', "\"\"");
+          const QVariant& value = rows[r][i];
+          // Decimal numbers may need rounding
+          QString strValue;
+          if (d->iDecimalsShown > 0 && value.type() == QVariant::Double)
+            strValue.setNum(value.toDouble(), 'f', d->iDecimalsShown);
+          else
+            strValue = value.toString();
+          strValue.replace('"', "\"\"");
           d->pFile->putChar('"');
-          d->pFile->write(value.toUtf8());
+          d->pFile->write(strValue.toUtf8());
           d->pFile->putChar('"');
         }
       d->pFile->putChar('\n');
-      d->pFile->flush();
     }
+  d->pFile->flush();
+}
+
+void PiiDatabaseWriter::enqueueRow(const Row& row)
+{
+  PII_D;
+  QMutexLocker lock(&d->queueMutex);
+  if (d->pWriterThread == 0)
+    {
+      d->strWriterError.clear();
+      d->bWriterRunning = true;
+      d->bFlushRequested = false;
+      d->pWriterThread = Pii::createAsyncCall(this, &PiiDatabaseWriter::writeInBackground);
+      d->pWriterThread->start();
+    }
+
+  while (d->bWriterRunning && d->queRows.size() >= d->iQueueLength)
+    d->spaceAvailable.wait(&d->queueMutex);
+
+  if (!d->bWriterRunning)
+    PII_THROW(PiiExecutionException, d->strWriterError);
+
+  d->queRows.enqueue(row);
+  d->rowsAvailable.wakeOne();
+}
+
+void PiiDatabaseWriter::writeInBackground()
+{
+  PII_D;
+  // The connection must be used by the thread that opened it.
+  try
+    {
+      forever
+        {
+          QList<Row> lstRows;
+          bool bFlush = false, bExit = false;
+          {
+            QMutexLocker lock(&d->queueMutex);
+            while (d->bWriterRunning && d->queRows.isEmpty() && !d->bFlushRequested &&
+                   !flushIntervalExceeded())
+              {
+                if (d->iFlushInterval > 0 && !d->lstPendingRows.isEmpty())
+                  d->rowsAvailable.wait(&d->queueMutex,
+                                        qMax(d->iFlushInterval - int(d->batchTimer.milliseconds()), 1));
+                else
+                  d->rowsAvailable.wait(&d->queueMutex);
+              }
+            while (!d->queRows.isEmpty())
+              lstRows << d->queRows.dequeue();
+            d->spaceAvailable.wakeAll();
+            bExit = !d->bWriterRunning;
+            bFlush = bExit || d->bFlushRequested;
+            d->bFlushRequested = false;
+          }
+
+          for (int i=0; i<lstRows.size(); ++i)
+            addRow(lstRows[i]);
+          if (bFlush || flushIntervalExceeded())
+            flushRows();
+          if (bExit)
+            break;
+        }
+    }
+  catch (PiiException& ex)
+    {
+      QMutexLocker lock(&d->queueMutex);
+      d->strWriterError = ex.message();
+      d->queRows.clear();
+      d->lstPendingRows.clear();
+      d->bWriterRunning = false;
+      d->spaceAvailable.wakeAll();
+    }
+
+  delete d->pQuery, d->pQuery = 0;
+  delete d->pBatchQuery, d->pBatchQuery = 0;
+  closeConnection();
+}
+
+void PiiDatabaseWriter::stopWriter()
+{
+  PII_D;
+  if (d->pWriterThread == 0)
+    return;
+  d->queueMutex.lock();
+  d->bWriterRunning = false;
+  d->rowsAvailable.wakeAll();
+  d->queueMutex.unlock();
+  // Rows still in the queue will be written before the thread exits.
+  d->pWriterThread->wait();
+  delete d->pWriterThread;
+  d->pWriterThread = 0;
 }
 
 PiiInputSocket* PiiDatabaseWriter::input(const QString& name) const
@@ -229,5 +484,16 @@ int PiiDatabaseWriter::decimalsShown() const { return _d()->iDecimalsShown; }
 void PiiDatabaseWriter::setTableName(const QString& tableName) { _d()->strTableName = tableName; }
 QString PiiDatabaseWriter::tableName() const { return _d()->strTableName; }
 
+void PiiDatabaseWriter::setBatchSize(int batchSize) { _d()->iBatchSize = qMax(batchSize, 1); }
+int PiiDatabaseWriter::batchSize() const { return _d()->iBatchSize; }
+void PiiDatabaseWriter::setFlushInterval(int flushInterval) { _d()->iFlushInterval = qMax(flushInterval, 0); }
+int PiiDatabaseWriter::flushInterval() const { return _d()->iFlushInterval; }
+void PiiDatabaseWriter::setMultiRowInsert(bool multiRowInsert) { _d()->bMultiRowInsert = multiRowInsert; }
+bool PiiDatabaseWriter::multiRowInsert() const { return _d()->bMultiRowInsert; }
+void PiiDatabaseWriter::setBackgroundWriting(bool backgroundWriting) { _d()->bBackgroundWriting = backgroundWriting; }
+bool PiiDatabaseWriter::backgroundWriting() const { return _d()->bBackgroundWriting; }
+void PiiDatabaseWriter::setQueueLength(int queueLength) { _d()->iQueueLength = qMax(queueLength, 1); }
+int PiiDatabaseWriter::queueLength() const { return _d()->iQueueLength; }
+
 QStringList PiiDatabaseWriter::columnNames() const { return _d()->lstColumnNames; }
 QVariantMap PiiDatabaseWriter::defaultValues() const { return _d()->mapDefaultValues; }
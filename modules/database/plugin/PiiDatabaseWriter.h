@@ -18,6 +18,10 @@
 
 #include "PiiDatabaseOperation.h"
 #include <QSqlDatabase>
+#include <QQueue>
+#include <QMutex>
+#include <QWaitCondition>
+#include <PiiTimer.h>
 
 class QFile;
 class QSqlQuery;
@@ -39,6 +43,31 @@ class QSqlQuery;
  * @in inputX - input sockets. X is a zero-based index. Inputs can
  * also be accessed with the names given by the [columnNames] property.
  *
+ * Batching
+ * --------
+ *
+ * Executing a separate query for each row makes the throughput
+ * depend on the round-trip time to the database server. If
+ * [batchSize] is larger than one, rows are collected and written in a
+ * single transaction once the batch is full or [flushInterval]
+ * milliseconds have passed since the first row in the batch arrived.
+ * If the driver supports batch operations, the whole batch will be
+ * executed with a single call. If [multiRowInsert] is `true`, full
+ * batches will be written with one INSERT statement that contains
+ * all rows.
+ *
+ * If [backgroundWriting] is enabled, a separate thread opens the
+ * database connection and executes the queries, and [process()] only
+ * converts the incoming values and places them into a queue.
+ * Pending rows are always written before the operation stops or
+ * pauses.
+ *
+ * ~~~(c++)
+ * writer->setProperty("batchSize", 200);
+ * writer->setProperty("flushInterval", 100);
+ * writer->setProperty("multiRowInsert", true);
+ * writer->setProperty("backgroundWriting", true);
+ * ~~~
  */
 class PiiDatabaseWriter : public PiiDatabaseOperation
 {
@@ -90,6 +119,43 @@ class PiiDatabaseWriter : public PiiDatabaseOperation
    */
   Q_PROPERTY(int decimalsShown READ decimalsShown WRITE setDecimalsShown);
 
+  /**
+   * The number of rows written in one transaction. The default is
+   * one, which writes each row immediately.
+   */
+  Q_PROPERTY(int batchSize READ batchSize WRITE setBatchSize);
+
+  /**
+   * The maximum time in milliseconds a row may wait for the batch to
+   * fill up. Zero means no limit. Without [backgroundWriting], the
+   * time is checked only when a new row arrives. The default is zero.
+   */
+  Q_PROPERTY(int flushInterval READ flushInterval WRITE setFlushInterval);
+
+  /**
+   * If `true`, full batches are written with a single multi-row
+   * INSERT statement (`INSERT ... VALUES (...), (...)`). This
+   * minimizes the number of round-trips on drivers that don't
+   * support batch operations natively, such as PostgreSQL. Not all
+   * database engines accept multi-row inserts. The default is
+   * `false`.
+   */
+  Q_PROPERTY(bool multiRowInsert READ multiRowInsert WRITE setMultiRowInsert);
+
+  /**
+   * If `true`, the database is accessed in a separate thread. This
+   * keeps the SQL round-trips off the processing path. Errors that
+   * occur in the background are reported when the next row arrives.
+   * The default is `false`.
+   */
+  Q_PROPERTY(bool backgroundWriting READ backgroundWriting WRITE setBackgroundWriting);
+
+  /**
+   * The maximum number of rows waiting for the background thread. If
+   * the queue is full, [process()] blocks. The default is 4096.
+   */
+  Q_PROPERTY(int queueLength READ queueLength WRITE setQueueLength);
+
   PII_OPERATION_SERIALIZATION_FUNCTION
 
 public:
@@ -126,8 +192,35 @@ protected:
   QString tableName() const;
   void setTableName(const QString& tableName);
 
+  void setBatchSize(int batchSize);
+  int batchSize() const;
+
+  void setFlushInterval(int flushInterval);
+  int flushInterval() const;
+
+  void setMultiRowInsert(bool multiRowInsert);
+  bool multiRowInsert() const;
+
+  void setBackgroundWriting(bool backgroundWriting);
+  bool backgroundWriting() const;
+
+  void setQueueLength(int queueLength);
+  int queueLength() const;
+
 private:
+  typedef QVector<QVariant> Row;
+
   void initializeDefaults();
+  void openOutput();
+  void addRow(const Row& row);
+  void flushRows();
+  void writeRowsToDatabase(const QList<Row>& rows);
+  void writeRowsToFile(const QList<Row>& rows);
+  bool flushIntervalExceeded() const;
+  bool flushSafely();
+  void enqueueRow(const Row& row);
+  void writeInBackground();
+  void stopWriter();
 
   /// @internal
   class Data : public PiiDatabaseOperation::Data
@@ -144,10 +237,25 @@ private:
     int iDecimalsShown;
     QSqlQuery* pQuery;
     QFile *pFile;
+
+    int iBatchSize, iFlushInterval;
+    bool bMultiRowInsert, bBackgroundWriting;
+    int iQueueLength;
+    QSqlQuery* pBatchQuery;
+    QList<Row> lstPendingRows;
+    PiiTimer batchTimer;
+
+    QThread* pWriterThread;
+    QMutex queueMutex;
+    QWaitCondition rowsAvailable, spaceAvailable;
+    QQueue<Row> queRows;
+    bool bWriterRunning, bFlushRequested;
+    QString strWriterError;
   };
   PII_D_FUNC;
 
   void createQuery();
+  QString createInsert(int rows);
 };
 
 
@@ -62,10 +62,150 @@ namespace PiiDsp
     return result;
   }
 
+  /// @hide
+  template <class ResultType, class T, class U>
+  inline PiiMatrix<ResultType> convolution(const PiiMatrix<T>& a,
+                                           const PiiMatrix<U>& b,
+                                           FilterMode mode,
+                                           Pii::False)
+  {
+    return directConvolution<ResultType>(a, b, mode);
+  }
+
+  template <class ResultType, class T, class U>
+  inline PiiMatrix<ResultType> convolution(const PiiMatrix<T>& a,
+                                           const PiiMatrix<U>& b,
+                                           FilterMode mode,
+                                           Pii::True)
+  {
+    const int iTaps = b.rows() * b.columns();
+    // The FFT doesn't pay off if there are only a few outputs per
+    // filter coefficient.
+    if (iTaps >= fftConvolutionThreshold() && a.rows() * a.columns() >= iTaps)
+      return fftConvolution<ResultType>(a, b, mode);
+    return directConvolution<ResultType>(a, b, mode);
+  }
+
+  // Selects the part of the full convolution returned in each mode.
+  inline bool convolutionOutputArea(int ar, int ac, int br, int bc, FilterMode mode,
+                                    int* firstRow, int* firstColumn, int* rows, int* columns)
+  {
+    switch (mode)
+      {
+      case FilterFull:
+        *firstRow = 0;
+        *firstColumn = 0;
+        *rows = ar + br - 1;
+        *columns = ac + bc - 1;
+        break;
+      case FilterOriginalSize:
+        *firstRow = br >> 1;
+        *firstColumn = bc >> 1;
+        *rows = ar;
+        *columns = ac;
+        break;
+      case FilterValidPart:
+        *firstRow = br - 1;
+        *firstColumn = bc - 1;
+        *rows = ar - br + 1;
+        *columns = ac - bc + 1;
+        break;
+      }
+    return *rows > 0 && *columns > 0;
+  }
+
+  // Chooses the length of the transform for overlap-save. Blocks
+  // much larger than the filter waste time in the transform, and
+  // small ones in the overlap.
+  inline int fftConvolutionBlockLength(int filterLength, int outputLength)
+  {
+    const int iTotal = outputLength + filterLength - 1;
+    const int iBlock = qMax(2 * (filterLength - 1), 128);
+    return iTotal <= iBlock ? iTotal : iBlock;
+  }
+  /// @endhide
+
   template <class ResultType, class T, class U>
   PiiMatrix<ResultType> convolution(const PiiMatrix<T>& a,
                                     const PiiMatrix<U>& b,
                                     FilterMode mode)
+  {
+    return convolution<ResultType>(a, b, mode,
+                                   Pii::And<Pii::IsFloatingPoint<ResultType>::boolValue,
+                                            !Pii::IsComplex<T>::boolValue,
+                                            !Pii::IsComplex<U>::boolValue>());
+  }
+
+  template <class ResultType, class T, class U>
+  PiiMatrix<ResultType> fftConvolution(const PiiMatrix<T>& a,
+                                       const PiiMatrix<U>& b,
+                                       FilterMode mode)
+  {
+    const int ar = a.rows(), ac = a.columns(), br = b.rows(), bc = b.columns();
+    if (ar == 0 || ac == 0 || br == 0 || bc == 0)
+      return PiiMatrix<ResultType>(a);
+    int iFirstRow, iFirstColumn, iRows, iColumns;
+    if (!convolutionOutputArea(ar, ac, br, bc, mode, &iFirstRow, &iFirstColumn, &iRows, &iColumns))
+      return PiiMatrix<ResultType>();
+
+    // Even widths make the real-valued transform fast.
+    const int iBlockRows = fastFftLength(fftConvolutionBlockLength(br, iRows)),
+      iBlockColumns = 2 * fastFftLength((fftConvolutionBlockLength(bc, iColumns) + 1) / 2),
+      iStepRows = iBlockRows - br + 1, iStepColumns = iBlockColumns - bc + 1;
+
+    PiiFft<ResultType> fft;
+    PiiMatrix<ResultType> matBlock(iBlockRows, iBlockColumns);
+    matBlock(0, 0, br, bc) << b;
+    const PiiMatrix<std::complex<ResultType> > matFilterSpectrum(fft.forwardRealFft(matBlock));
+    const int iSpectrumColumns = matFilterSpectrum.columns();
+
+    PiiMatrix<ResultType> result(PiiMatrix<ResultType>::uninitialized(iRows, iColumns));
+    for (int r=0; r<iRows; r += iStepRows)
+      for (int c=0; c<iColumns; c += iStepColumns)
+        {
+          // Input coordinates of the top left corner of the block.
+          const int iInputRow = iFirstRow + r - br + 1, iInputColumn = iFirstColumn + c - bc + 1;
+          const int iStartRow = qMax(0, -iInputRow), iEndRow = qMin(iBlockRows, ar - iInputRow),
+            iStartColumn = qMax(0, -iInputColumn), iEndColumn = qMin(iBlockColumns, ac - iInputColumn);
+          matBlock = 0;
+          for (int i=iStartRow; i<iEndRow; ++i)
+            {
+              const T* pInput = a[iInputRow + i] + iInputColumn;
+              ResultType* pBlock = matBlock[i];
+              for (int j=iStartColumn; j<iEndColumn; ++j)
+                pBlock[j] = ResultType(pInput[j]);
+            }
+
+          PiiMatrix<std::complex<ResultType> > matSpectrum(fft.forwardRealFft(matBlock));
+          for (int i=0; i<iBlockRows; ++i)
+            {
+              std::complex<ResultType>* pSpectrum = matSpectrum[i];
+              const std::complex<ResultType>* pFilter = matFilterSpectrum[i];
+              for (int j=0; j<iSpectrumColumns; ++j)
+                pSpectrum[j] = std::complex<ResultType>(pSpectrum[j].real() * pFilter[j].real() -
+                                                        pSpectrum[j].imag() * pFilter[j].imag(),
+                                                        pSpectrum[j].real() * pFilter[j].imag() +
+                                                        pSpectrum[j].imag() * pFilter[j].real());
+            }
+          // Only the part not affected by circular wrap-around is
+          // valid.
+          const PiiMatrix<ResultType> matCircular(fft.inverseRealFft(matSpectrum, iBlockColumns));
+          const int iValidRows = qMin(iStepRows, iRows - r), iValidColumns = qMin(iStepColumns, iColumns - c);
+          for (int i=0; i<iValidRows; ++i)
+            {
+              const ResultType* pCircular = matCircular[br - 1 + i] + bc - 1;
+              ResultType* pResult = result[r + i] + c;
+              for (int j=0; j<iValidColumns; ++j)
+                pResult[j] = pCircular[j];
+            }
+        }
+    return result;
+  }
+
+  template <class ResultType, class T, class U>
+  PiiMatrix<ResultType> directConvolution(const PiiMatrix<T>& a,
+                                          const PiiMatrix<U>& b,
+                                          FilterMode mode)
   {
     const int ar = a.rows(), ac = a.columns(), br = b.rows(), bc = b.columns();
     if (ar == 0 || ac == 0 || br == 0 || bc == 0)
@@ -89,8 +229,7 @@ namespace PiiDsp
               adata = a.row(arr);
 
               for (int i=0; i<bc; ++i)
-                for (int j=0; j<ac; ++j)
-                  rdata[i+j] += ResultType(adata[j]) * ResultType(bdata[i]);
+                convolveRow(rdata + i, adata, bdata + i, ac, 1);
             }
         if (mode == FilterOriginalSize)
           {
@@ -108,6 +247,8 @@ namespace PiiDsp
         if (rr <= 0 || rc <= 0)
           return PiiMatrix<ResultType>();
         PiiMatrix<ResultType> result(rr, rc);
+        // convolveRow() takes the coefficients in reverse order.
+        PiiMatrix<U> matCoeffs(Pii::flipped(b, Pii::Horizontally));
 
         for (int rrr = 0; rrr<rr; ++rrr)
           {
@@ -115,11 +256,8 @@ namespace PiiDsp
             for (int brr = 0; brr<br; ++brr)
               {
                 adata = a.row(rrr + brr);
-                bdata = b.row(br-brr-1) - 1 + bc;
-
-                for (int i = 0; i<rc; ++i)
-                  for (int j = 0; j<bc; ++j)
-                    rdata[i] += ResultType(adata[i+j]) * ResultType(bdata[-j]);
+                bdata = matCoeffs.row(br-brr-1);
+                convolveRow(rdata, adata, bdata, rc, bc);
               }
           }
         return result;
@@ -150,4 +288,21 @@ namespace PiiDsp
 
     return result;
   }
+
+  template <class T> PiiMatrix<T> fftShiftRows(const PiiMatrix<T>& matrix, bool inverse)
+  {
+    int rows = matrix.rows(), cols = matrix.columns();
+    int cols2 = cols / 2;
+    if (inverse && (cols & 1))
+      cols2++;
+    int cols1 = cols - cols2;
+
+    PiiMatrix<T> result(PiiMatrix<T>::uninitialized(rows, cols));
+
+    // Left, right
+    result(0,0,rows,cols2) << matrix(0,cols1,rows,cols2);
+    result(0,cols2,rows,cols1) << matrix(0,0,rows,cols1);
+
+    return result;
+  }
 }
@@ -14,6 +14,10 @@
  */
 
 #include "PiiDsp.h"
+#include "PiiFft.h"
+#include <PiiAtomicInt.h>
+#include <PiiTimer.h>
+#include <PiiCpu.h>
 
 namespace PiiDsp
 {
@@ -111,5 +115,568 @@ namespace PiiDsp
       }
     return lstResult;
   }
-}
 
+  static PiiAtomicInt iFftConvolutionThreshold(169);
+
+  int fftConvolutionThreshold()
+  {
+    return iFftConvolutionThreshold.load();
+  }
+
+  void setFftConvolutionThreshold(int threshold)
+  {
+    iFftConvolutionThreshold.store(threshold);
+  }
+
+  int calibrateFftConvolution()
+  {
+    PiiMatrix<float> matImage(256, 256);
+    for (int r=0; r<matImage.rows(); ++r)
+      {
+        float* pRow = matImage[r];
+        for (int c=0; c<matImage.columns(); ++c)
+          pRow[c] = float((r * 7 + c * 13) % 256);
+      }
+
+    PiiTimer timer;
+    // Filters larger than this are always faster with the FFT.
+    int iSize = 3;
+    for (; iSize < 31; iSize += 2)
+      {
+        PiiMatrix<float> matFilter(iSize, iSize);
+        matFilter = 1.0f / (iSize * iSize);
+        timer.restart();
+        directConvolution<float>(matImage, matFilter, FilterOriginalSize);
+        const qint64 iDirectTime = timer.microseconds();
+        timer.restart();
+        fftConvolution<float>(matImage, matFilter, FilterOriginalSize);
+        if (timer.microseconds() < iDirectTime)
+          break;
+      }
+    setFftConvolutionThreshold(iSize * iSize);
+    return iSize * iSize;
+  }
+
+  int fastFftLength(int length)
+  {
+    for (int i=qMax(length, 1); ; ++i)
+      {
+        int n = i;
+        while (n % 2 == 0) n /= 2;
+        while (n % 3 == 0) n /= 3;
+        while (n % 5 == 0) n /= 5;
+        if (n == 1)
+          return i;
+      }
+  }
+
+  namespace
+  {
+#ifdef PII_X86_SIMD
+    // SSE2 has no 32-bit low multiply. Multiply even and odd lanes
+    // separately and pick the low halves of the 64-bit products.
+    PII_CPU_TARGET("sse2") inline __m128i mulLo32(__m128i a, __m128i b)
+    {
+      __m128i even = _mm_mul_epu32(a, b);
+      __m128i odd = _mm_mul_epu32(_mm_srli_epi64(a, 32), _mm_srli_epi64(b, 32));
+      return _mm_unpacklo_epi32(_mm_shuffle_epi32(even, _MM_SHUFFLE(0,0,2,0)),
+                                _mm_shuffle_epi32(odd, _MM_SHUFFLE(0,0,2,0)));
+    }
+
+    // Widens eight bytes to two vectors of four 32-bit integers.
+    PII_CPU_TARGET("sse2") inline void loadBytes8(const unsigned char* input, __m128i& lo, __m128i& hi)
+    {
+      const __m128i zero = _mm_setzero_si128();
+      __m128i words = _mm_unpacklo_epi8(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(input)), zero);
+      lo = _mm_unpacklo_epi16(words, zero);
+      hi = _mm_unpackhi_epi16(words, zero);
+    }
+
+    PII_CPU_TARGET("sse2") int convolveRowSse2(int* result, const unsigned char* input, const int* coeffs, int count, int taps)
+    {
+      int i = 0;
+      for (; i+8 <= count; i += 8)
+        {
+          __m128i sumLo = _mm_loadu_si128(reinterpret_cast<const __m128i*>(result + i));
+          __m128i sumHi = _mm_loadu_si128(reinterpret_cast<const __m128i*>(result + i + 4));
+          for (int j=0; j<taps; ++j)
+            {
+              __m128i coeff = _mm_set1_epi32(coeffs[j]), lo, hi;
+              loadBytes8(input + i + j, lo, hi);
+              sumLo = _mm_add_epi32(sumLo, mulLo32(lo, coeff));
+              sumHi = _mm_add_epi32(sumHi, mulLo32(hi, coeff));
+            }
+          _mm_storeu_si128(reinterpret_cast<__m128i*>(result + i), sumLo);
+          _mm_storeu_si128(reinterpret_cast<__m128i*>(result + i + 4), sumHi);
+        }
+      return i;
+    }
+
+    PII_CPU_TARGET("sse2") int convolveRowSse2(int* result, const int* input, const int* coeffs, int count, int taps)
+    {
+      int i = 0;
+      for (; i+4 <= count; i += 4)
+        {
+          __m128i sum = _mm_loadu_si128(reinterpret_cast<const __m128i*>(result + i));
+          for (int j=0; j<taps; ++j)
+            sum = _mm_add_epi32(sum, mulLo32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(input + i + j)),
+                                             _mm_set1_epi32(coeffs[j])));
+          _mm_storeu_si128(reinterpret_cast<__m128i*>(result + i), sum);
+        }
+      return i;
+    }
+
+    PII_CPU_TARGET("sse2") int convolveRowSse2(float* result, const unsigned char* input, const float* coeffs, int count, int taps)
+    {
+      int i = 0;
+      for (; i+8 <= count; i += 8)
+        {
+          __m128 sumLo = _mm_loadu_ps(result + i);
+          __m128 sumHi = _mm_loadu_ps(result + i + 4);
+          for (int j=0; j<taps; ++j)
+            {
+              __m128 coeff = _mm_set1_ps(coeffs[j]);
+              __m128i lo, hi;
+              loadBytes8(input + i + j, lo, hi);
+              sumLo = _mm_add_ps(sumLo, _mm_mul_ps(_mm_cvtepi32_ps(lo), coeff));
+              sumHi = _mm_add_ps(sumHi, _mm_mul_ps(_mm_cvtepi32_ps(hi), coeff));
+            }
+          _mm_storeu_ps(result + i, sumLo);
+          _mm_storeu_ps(result + i + 4, sumHi);
+        }
+      return i;
+    }
+
+    PII_CPU_TARGET("sse2") int convolveRowSse2(float* result, const float* input, const float* coeffs, int count, int taps)
+    {
+      int i = 0;
+      for (; i+4 <= count; i += 4)
+        {
+          __m128 sum = _mm_loadu_ps(result + i);
+          for (int j=0; j<taps; ++j)
+            sum = _mm_add_ps(sum, _mm_mul_ps(_mm_loadu_ps(input + i + j), _mm_set1_ps(coeffs[j])));
+          _mm_storeu_ps(result + i, sum);
+        }
+      return i;
+    }
+
+    PII_CPU_TARGET("avx2") int convolveRowAvx2(int* result, const unsigned char* input, const int* coeffs, int count, int taps)
+    {
+      int i = 0;
+      for (; i+8 <= count; i += 8)
+        {
+          __m256i sum = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(result + i));
+          for (int j=0; j<taps; ++j)
+            sum = _mm256_add_epi32(sum, _mm256_mullo_epi32(_mm256_cvtepu8_epi32(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(input + i + j))),
+                                                           _mm256_set1_epi32(coeffs[j])));
+          _mm256_storeu_si256(reinterpret_cast<__m256i*>(result + i), sum);
+        }
+      return i;
+    }
+
+    PII_CPU_TARGET("avx2") int convolveRowAvx2(int* result, const int* input, const int* coeffs, int count, int taps)
+    {
+      int i = 0;
+      for (; i+8 <= count; i += 8)
+        {
+          __m256i sum = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(result + i));
+          for (int j=0; j<taps; ++j)
+            sum = _mm256_add_epi32(sum, _mm256_mullo_epi32(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(input + i + j)),
+                                                           _mm256_set1_epi32(coeffs[j])));
+          _mm256_storeu_si256(reinterpret_cast<__m256i*>(result + i), sum);
+        }
+      return i;
+    }
+
+    PII_CPU_TARGET("avx2") int convolveRowAvx2(float* result, const unsigned char* input, const float* coeffs, int count, int taps)
+    {
+      int i = 0;
+      for (; i+8 <= count; i += 8)
+        {
+          __m256 sum = _mm256_loadu_ps(result + i);
+          for (int j=0; j<taps; ++j)
+            sum = _mm256_add_ps(sum, _mm256_mul_ps(_mm256_cvtepi32_ps(_mm256_cvtepu8_epi32(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(input + i + j)))),
+                                                   _mm256_set1_ps(coeffs[j])));
+          _mm256_storeu_ps(result + i, sum);
+        }
+      return i;
+    }
+
+    PII_CPU_TARGET("avx2") int convolveRowAvx2(float* result, const float* input, const float* coeffs, int count, int taps)
+    {
+      int i = 0;
+      for (; i+8 <= count; i += 8)
+        {
+          __m256 sum = _mm256_loadu_ps(result + i);
+          for (int j=0; j<taps; ++j)
+            sum = _mm256_add_ps(sum, _mm256_mul_ps(_mm256_loadu_ps(input + i + j), _mm256_set1_ps(coeffs[j])));
+          _mm256_storeu_ps(result + i, sum);
+        }
+      return i;
+    }
+#endif
+
+#ifdef PII_NEON_SIMD
+    int convolveRowNeon(int* result, const unsigned char* input, const int* coeffs, int count, int taps)
+    {
+      int i = 0;
+      for (; i+8 <= count; i += 8)
+        {
+          int32x4_t sumLo = vld1q_s32(result + i), sumHi = vld1q_s32(result + i + 4);
+          for (int j=0; j<taps; ++j)
+            {
+              uint16x8_t words = vmovl_u8(vld1_u8(input + i + j));
+              sumLo = vmlaq_n_s32(sumLo, vreinterpretq_s32_u32(vmovl_u16(vget_low_u16(words))), coeffs[j]);
+              sumHi = vmlaq_n_s32(sumHi, vreinterpretq_s32_u32(vmovl_u16(vget_high_u16(words))), coeffs[j]);
+            }
+          vst1q_s32(result + i, sumLo);
+          vst1q_s32(result + i + 4, sumHi);
+        }
+      return i;
+    }
+
+    int convolveRowNeon(int* result, const int* input, const int* coeffs, int count, int taps)
+    {
+      int i = 0;
+      for (; i+4 <= count; i += 4)
+        {
+          int32x4_t sum = vld1q_s32(result + i);
+          for (int j=0; j<taps; ++j)
+            sum = vmlaq_n_s32(sum, vld1q_s32(input + i + j), coeffs[j]);
+          vst1q_s32(result + i, sum);
+        }
+      return i;
+    }
+
+    // vmlaq_f32 may be fused. Separate multiplication and addition
+    // round the same way as the generic code.
+    int convolveRowNeon(float* result, const unsigned char* input, const float* coeffs, int count, int taps)
+    {
+      int i = 0;
+      for (; i+8 <= count; i += 8)
+        {
+          float32x4_t sumLo = vld1q_f32(result + i), sumHi = vld1q_f32(result + i + 4);
+          for (int j=0; j<taps; ++j)
+            {
+              uint16x8_t words = vmovl_u8(vld1_u8(input + i + j));
+              sumLo = vaddq_f32(sumLo, vmulq_n_f32(vcvtq_f32_u32(vmovl_u16(vget_low_u16(words))), coeffs[j]));
+              sumHi = vaddq_f32(sumHi, vmulq_n_f32(vcvtq_f32_u32(vmovl_u16(vget_high_u16(words))), coeffs[j]));
+            }
+          vst1q_f32(result + i, sumLo);
+          vst1q_f32(result + i + 4, sumHi);
+        }
+      return i;
+    }
+
+    int convolveRowNeon(float* result, const float* input, const float* coeffs, int count, int taps)
+    {
+      int i = 0;
+      for (; i+4 <= count; i += 4)
+        {
+          float32x4_t sum = vld1q_f32(result + i);
+          for (int j=0; j<taps; ++j)
+            sum = vaddq_f32(sum, vmulq_n_f32(vld1q_f32(input + i + j), coeffs[j]));
+          vst1q_f32(result + i, sum);
+        }
+      return i;
+    }
+#endif
+
+    // Runs the best available kernel and finishes the columns it left
+    // over with the generic template.
+    template <class ResultType, class T, class U>
+    inline void convolveRowSimd(ResultType* result, const T* input, const U* coeffs, int count, int taps)
+    {
+      int iDone = 0;
+      switch (Pii::simdLevel())
+        {
+#ifdef PII_X86_SIMD
+        case Pii::Avx2Simd:
+          iDone = convolveRowAvx2(result, input, coeffs, count, taps);
+          break;
+        case Pii::Sse2Simd:
+          iDone = convolveRowSse2(result, input, coeffs, count, taps);
+          break;
+#endif
+#ifdef PII_NEON_SIMD
+        case Pii::NeonSimd:
+          iDone = convolveRowNeon(result, input, coeffs, count, taps);
+          break;
+#endif
+        default:
+          break;
+        }
+      if (iDone < count)
+        convolveRow<ResultType,T,U>(result + iDone, input + iDone, coeffs, count - iDone, taps);
+    }
+  }
+
+  void convolveRow(int* result, const unsigned char* input, const int* coeffs, int count, int taps)
+  {
+    convolveRowSimd(result, input, coeffs, count, taps);
+  }
+
+  void convolveRow(int* result, const int* input, const int* coeffs, int count, int taps)
+  {
+    convolveRowSimd(result, input, coeffs, count, taps);
+  }
+
+  void convolveRow(float* result, const unsigned char* input, const float* coeffs, int count, int taps)
+  {
+    convolveRowSimd(result, input, coeffs, count, taps);
+  }
+
+  void convolveRow(float* result, const float* input, const float* coeffs, int count, int taps)
+  {
+    convolveRowSimd(result, input, coeffs, count, taps);
+  }
+
+  namespace
+  {
+#ifdef PII_X86_SIMD
+    // (a.re b.re - a.im b.im, a.re b.im + a.im b.re) without addsub,
+    // which is SSE3.
+    PII_CPU_TARGET("sse2") inline __m128d complexMultiply(__m128d a, __m128d b)
+    {
+      const __m128d realSign = _mm_set_pd(0.0, -0.0);
+      return _mm_add_pd(_mm_mul_pd(a, _mm_unpacklo_pd(b, b)),
+                        _mm_xor_pd(_mm_mul_pd(_mm_shuffle_pd(a, a, 1), _mm_unpackhi_pd(b, b)), realSign));
+    }
+    // Two complex numbers in each vector.
+    PII_CPU_TARGET("sse2") inline __m128 complexMultiply(__m128 a, __m128 b)
+    {
+      const __m128 realSign = _mm_set_ps(0.0f, -0.0f, 0.0f, -0.0f);
+      return _mm_add_ps(_mm_mul_ps(a, _mm_shuffle_ps(b, b, _MM_SHUFFLE(2,2,0,0))),
+                        _mm_xor_ps(_mm_mul_ps(_mm_shuffle_ps(a, a, _MM_SHUFFLE(2,3,0,1)),
+                                              _mm_shuffle_ps(b, b, _MM_SHUFFLE(3,3,1,1))),
+                                   realSign));
+    }
+    // Multiplication by -i: (a.im, -a.re)
+    PII_CPU_TARGET("sse2") inline __m128d multiplyMinusI(__m128d a)
+    {
+      return _mm_xor_pd(_mm_shuffle_pd(a, a, 1), _mm_set_pd(-0.0, 0.0));
+    }
+    PII_CPU_TARGET("sse2") inline __m128 multiplyMinusI(__m128 a)
+    {
+      return _mm_xor_ps(_mm_shuffle_ps(a, a, _MM_SHUFFLE(2,3,0,1)), _mm_set_ps(-0.0f, 0.0f, -0.0f, 0.0f));
+    }
+
+    PII_CPU_TARGET("avx2") inline __m256d complexMultiply(__m256d a, __m256d b)
+    {
+      return _mm256_addsub_pd(_mm256_mul_pd(a, _mm256_movedup_pd(b)),
+                              _mm256_mul_pd(_mm256_permute_pd(a, 0x5), _mm256_permute_pd(b, 0xf)));
+    }
+    PII_CPU_TARGET("avx2") inline __m256 complexMultiply(__m256 a, __m256 b)
+    {
+      return _mm256_addsub_ps(_mm256_mul_ps(a, _mm256_moveldup_ps(b)),
+                              _mm256_mul_ps(_mm256_permute_ps(a, 0xb1), _mm256_movehdup_ps(b)));
+    }
+    PII_CPU_TARGET("avx2") inline __m256d multiplyMinusI(__m256d a)
+    {
+      return _mm256_xor_pd(_mm256_permute_pd(a, 0x5), _mm256_set_pd(-0.0, 0.0, -0.0, 0.0));
+    }
+    PII_CPU_TARGET("avx2") inline __m256 multiplyMinusI(__m256 a)
+    {
+      return _mm256_xor_ps(_mm256_permute_ps(a, 0xb1),
+                           _mm256_set_ps(-0.0f, 0.0f, -0.0f, 0.0f, -0.0f, 0.0f, -0.0f, 0.0f));
+    }
+
+    // Loads and stores for each vector type. The step is the number
+    // of complex numbers in a vector.
+    struct Sse2Double
+    {
+      typedef double Real;
+      typedef __m128d Vector;
+      enum { step = 1 };
+      PII_CPU_TARGET("sse2") static Vector load(const std::complex<double>* p) { return _mm_loadu_pd(reinterpret_cast<const double*>(p)); }
+      PII_CPU_TARGET("sse2") static void store(std::complex<double>* p, Vector v) { _mm_storeu_pd(reinterpret_cast<double*>(p), v); }
+      PII_CPU_TARGET("sse2") static Vector add(Vector a, Vector b) { return _mm_add_pd(a, b); }
+      PII_CPU_TARGET("sse2") static Vector sub(Vector a, Vector b) { return _mm_sub_pd(a, b); }
+    };
+    struct Sse2Float
+    {
+      typedef float Real;
+      typedef __m128 Vector;
+      enum { step = 2 };
+      PII_CPU_TARGET("sse2") static Vector load(const std::complex<float>* p) { return _mm_loadu_ps(reinterpret_cast<const float*>(p)); }
+      PII_CPU_TARGET("sse2") static void store(std::complex<float>* p, Vector v) { _mm_storeu_ps(reinterpret_cast<float*>(p), v); }
+      PII_CPU_TARGET("sse2") static Vector add(Vector a, Vector b) { return _mm_add_ps(a, b); }
+      PII_CPU_TARGET("sse2") static Vector sub(Vector a, Vector b) { return _mm_sub_ps(a, b); }
+    };
+    struct Avx2Double
+    {
+      typedef double Real;
+      typedef __m256d Vector;
+      enum { step = 2 };
+      PII_CPU_TARGET("avx2") static Vector load(const std::complex<double>* p) { return _mm256_loadu_pd(reinterpret_cast<const double*>(p)); }
+      PII_CPU_TARGET("avx2") static void store(std::complex<double>* p, Vector v) { _mm256_storeu_pd(reinterpret_cast<double*>(p), v); }
+      PII_CPU_TARGET("avx2") static Vector add(Vector a, Vector b) { return _mm256_add_pd(a, b); }
+      PII_CPU_TARGET("avx2") static Vector sub(Vector a, Vector b) { return _mm256_sub_pd(a, b); }
+    };
+    struct Avx2Float
+    {
+      typedef float Real;
+      typedef __m256 Vector;
+      enum { step = 4 };
+      PII_CPU_TARGET("avx2") static Vector load(const std::complex<float>* p) { return _mm256_loadu_ps(reinterpret_cast<const float*>(p)); }
+      PII_CPU_TARGET("avx2") static void store(std::complex<float>* p, Vector v) { _mm256_storeu_ps(reinterpret_cast<float*>(p), v); }
+      PII_CPU_TARGET("avx2") static Vector add(Vector a, Vector b) { return _mm256_add_ps(a, b); }
+      PII_CPU_TARGET("avx2") static Vector sub(Vector a, Vector b) { return _mm256_sub_ps(a, b); }
+    };
+
+// The target attribute isn't inherited by templates. Each ISA gets
+// its own copy of the butterfly loops.
+#define PII_DSP_FFT_BUTTERFLIES(ISA, SUFFIX)                            \
+    template <class Ops>                                                \
+    PII_CPU_TARGET(ISA) int fftButterfly2##SUFFIX(std::complex<typename Ops::Real>* x0, \
+                                                  std::complex<typename Ops::Real>* x1, \
+                                                  const std::complex<typename Ops::Real>* twiddles, \
+                                                  int count)            \
+    {                                                                   \
+      int i = 0;                                                        \
+      for (; i + Ops::step <= count; i += Ops::step)                    \
+        {                                                               \
+          const typename Ops::Vector a = Ops::load(x0 + i),             \
+            t = complexMultiply(Ops::load(x1 + i), Ops::load(twiddles + i)); \
+          Ops::store(x0 + i, Ops::add(a, t));                           \
+          Ops::store(x1 + i, Ops::sub(a, t));                           \
+        }                                                               \
+      return i;                                                         \
+    }                                                                   \
+                                                                        \
+    template <class Ops>                                                \
+    PII_CPU_TARGET(ISA) int fftButterfly4##SUFFIX(std::complex<typename Ops::Real>* x0, \
+                                                  std::complex<typename Ops::Real>* x1, \
+                                                  std::complex<typename Ops::Real>* x2, \
+                                                  std::complex<typename Ops::Real>* x3, \
+                                                  const std::complex<typename Ops::Real>* twiddles1, \
+                                                  const std::complex<typename Ops::Real>* twiddles2, \
+                                                  const std::complex<typename Ops::Real>* twiddles3, \
+                                                  int count)            \
+    {                                                                   \
+      int i = 0;                                                        \
+      for (; i + Ops::step <= count; i += Ops::step)                    \
+        {                                                               \
+          const typename Ops::Vector z0 = Ops::load(x0 + i),            \
+            z1 = complexMultiply(Ops::load(x1 + i), Ops::load(twiddles1 + i)), \
+            z2 = complexMultiply(Ops::load(x2 + i), Ops::load(twiddles2 + i)), \
+            z3 = complexMultiply(Ops::load(x3 + i), Ops::load(twiddles3 + i)), \
+            t1 = Ops::add(z0, z2), t2 = Ops::add(z1, z3),               \
+            m2 = Ops::sub(z0, z2), m3 = multiplyMinusI(Ops::sub(z1, z3)); \
+          Ops::store(x0 + i, Ops::add(t1, t2));                         \
+          Ops::store(x1 + i, Ops::add(m2, m3));                         \
+          Ops::store(x2 + i, Ops::sub(t1, t2));                         \
+          Ops::store(x3 + i, Ops::sub(m2, m3));                         \
+        }                                                               \
+      return i;                                                         \
+    }
+
+    PII_DSP_FFT_BUTTERFLIES("sse2", Sse2)
+    PII_DSP_FFT_BUTTERFLIES("avx2", Avx2)
+#undef PII_DSP_FFT_BUTTERFLIES
+
+    inline int fftButterfly2Simd(std::complex<double>* x0, std::complex<double>* x1,
+                                 const std::complex<double>* twiddles, int count, Pii::SimdLevel level)
+    {
+      return level == Pii::Avx2Simd ?
+        fftButterfly2Avx2<Avx2Double>(x0, x1, twiddles, count) :
+        fftButterfly2Sse2<Sse2Double>(x0, x1, twiddles, count);
+    }
+    inline int fftButterfly2Simd(std::complex<float>* x0, std::complex<float>* x1,
+                                 const std::complex<float>* twiddles, int count, Pii::SimdLevel level)
+    {
+      return level == Pii::Avx2Simd ?
+        fftButterfly2Avx2<Avx2Float>(x0, x1, twiddles, count) :
+        fftButterfly2Sse2<Sse2Float>(x0, x1, twiddles, count);
+    }
+    inline int fftButterfly4Simd(std::complex<double>* x0, std::complex<double>* x1,
+                                 std::complex<double>* x2, std::complex<double>* x3,
+                                 const std::complex<double>* twiddles1,
+                                 const std::complex<double>* twiddles2,
+                                 const std::complex<double>* twiddles3,
+                                 int count, Pii::SimdLevel level)
+    {
+      return level == Pii::Avx2Simd ?
+        fftButterfly4Avx2<Avx2Double>(x0, x1, x2, x3, twiddles1, twiddles2, twiddles3, count) :
+        fftButterfly4Sse2<Sse2Double>(x0, x1, x2, x3, twiddles1, twiddles2, twiddles3, count);
+    }
+    inline int fftButterfly4Simd(std::complex<float>* x0, std::complex<float>* x1,
+                                 std::complex<float>* x2, std::complex<float>* x3,
+                                 const std::complex<float>* twiddles1,
+                                 const std::complex<float>* twiddles2,
+                                 const std::complex<float>* twiddles3,
+                                 int count, Pii::SimdLevel level)
+    {
+      return level == Pii::Avx2Simd ?
+        fftButterfly4Avx2<Avx2Float>(x0, x1, x2, x3, twiddles1, twiddles2, twiddles3, count) :
+        fftButterfly4Sse2<Sse2Float>(x0, x1, x2, x3, twiddles1, twiddles2, twiddles3, count);
+    }
+#endif
+
+    // NEON has no kernels here yet; the generic loops are used.
+    template <class T>
+    inline void fftButterfly2Dispatch(std::complex<T>* x0, std::complex<T>* x1,
+                                      const std::complex<T>* twiddles, int count)
+    {
+      int iDone = 0;
+#ifdef PII_X86_SIMD
+      const Pii::SimdLevel level = Pii::simdLevel();
+      if (level == Pii::Avx2Simd || level == Pii::Sse2Simd)
+        iDone = fftButterfly2Simd(x0, x1, twiddles, count, level);
+#endif
+      if (iDone < count)
+        fftButterfly2<T>(x0 + iDone, x1 + iDone, twiddles + iDone, count - iDone);
+    }
+
+    template <class T>
+    inline void fftButterfly4Dispatch(std::complex<T>* x0, std::complex<T>* x1,
+                                      std::complex<T>* x2, std::complex<T>* x3,
+                                      const std::complex<T>* twiddles1,
+                                      const std::complex<T>* twiddles2,
+                                      const std::complex<T>* twiddles3,
+                                      int count)
+    {
+      int iDone = 0;
+#ifdef PII_X86_SIMD
+      const Pii::SimdLevel level = Pii::simdLevel();
+      if (level == Pii::Avx2Simd || level == Pii::Sse2Simd)
+        iDone = fftButterfly4Simd(x0, x1, x2, x3, twiddles1, twiddles2, twiddles3, count, level);
+#endif
+      if (iDone < count)
+        fftButterfly4<T>(x0 + iDone, x1 + iDone, x2 + iDone, x3 + iDone,
+                         twiddles1 + iDone, twiddles2 + iDone, twiddles3 + iDone, count - iDone);
+    }
+  }
+
+  void fftButterfly2(std::complex<float>* x0, std::complex<float>* x1,
+                     const std::complex<float>* twiddles, int count)
+  {
+    fftButterfly2Dispatch(x0, x1, twiddles, count);
+  }
+
+  void fftButterfly2(std::complex<double>* x0, std::complex<double>* x1,
+                     const std::complex<double>* twiddles, int count)
+  {
+    fftButterfly2Dispatch(x0, x1, twiddles, count);
+  }
+
+  void fftButterfly4(std::complex<float>* x0, std::complex<float>* x1,
+                     std::complex<float>* x2, std::complex<float>* x3,
+                     const std::complex<float>* twiddles1,
+                     const std::complex<float>* twiddles2,
+                     const std::complex<float>* twiddles3,
+                     int count)
+  {
+    fftButterfly4Dispatch(x0, x1, x2, x3, twiddles1, twiddles2, twiddles3, count);
+  }
+
+  void fftButterfly4(std::complex<double>* x0, std::complex<double>* x1,
+                     std::complex<double>* x2, std::complex<double>* x3,
+                     const std::complex<double>* twiddles1,
+                     const std::complex<double>* twiddles2,
+                     const std::complex<double>* twiddles3,
+                     int count)
+  {
+    fftButterfly4Dispatch(x0, x1, x2, x3, twiddles1, twiddles2, twiddles3, count);
+  }
+}
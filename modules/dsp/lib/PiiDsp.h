@@ -21,6 +21,7 @@
 #include <QList>
 #include <complex>
 #include "PiiDspGlobal.h"
+#include "PiiFft.h"
 
 /**
  * Routines for common digital signal processing tasks.
@@ -65,12 +66,117 @@ namespace PiiDsp
    * PiiMatrix<int> result = PiiDsp::convolution<int>(a, b);
    * // result = -1 -2 -2 -2 -2 4 5
    * ~~~
+   *
+   * If *ResultType* is `float` or `double`, *a* and *b* are real,
+   * and *b* has at least [fftConvolutionThreshold()] elements, the
+   * convolution is calculated with [fftConvolution()]. Otherwise,
+   * [directConvolution()] is used. The two give the same result
+   * within floating-point tolerance.
    */
   template <class ResultType, class T, class U>
   PiiMatrix<ResultType> convolution(const PiiMatrix<T>& a,
                                     const PiiMatrix<U>& b,
                                     FilterMode mode = FilterFull);
 
+  /**
+   * Calculates the convolution of *a* and *b* directly in the spatial
+   * domain. The time complexity is proportional to the product of
+   * the sizes of *a* and *b*. See [convolution()].
+   */
+  template <class ResultType, class T, class U>
+  PiiMatrix<ResultType> directConvolution(const PiiMatrix<T>& a,
+                                          const PiiMatrix<U>& b,
+                                          FilterMode mode = FilterFull);
+
+  /**
+   * Calculates the convolution of *a* and *b* using the Fourier
+   * transform. The output is computed in blocks with the
+   * overlap-save method: each block of *a* is transformed, multiplied
+   * by the precomputed spectrum of *b*, and transformed back. The
+   * time needed per output element depends only logarithmically on
+   * the size of *b*, which makes this function much faster than
+   * [directConvolution()] with large filters. Only the part of the
+   * output selected by *mode* is calculated.
+   *
+   * *ResultType* must be `float` or `double`, and *a* and *b* must
+   * be real. The transforms are calculated in *ResultType*.
+   *
+   * ~~~(c++)
+   * // Correlate a 64x64 template with a 512x512 image
+   * PiiMatrix<float> matCorrelation(PiiDsp::fftConvolution<float>(image,
+   *                                                              Pii::flipped(templ, Pii::Horizontally | Pii::Vertically),
+   *                                                              PiiDsp::FilterValidPart));
+   * ~~~
+   */
+  template <class ResultType, class T, class U>
+  PiiMatrix<ResultType> fftConvolution(const PiiMatrix<T>& a,
+                                       const PiiMatrix<U>& b,
+                                       FilterMode mode = FilterFull);
+
+  /**
+   * Returns the number of filter coefficients at which
+   * [convolution()] switches to the FFT-based algorithm. The default
+   * value is 169 (a 13-by-13 filter), which can be changed with
+   * [setFftConvolutionThreshold()] or measured on the running
+   * machine with [calibrateFftConvolution()].
+   */
+  PII_DSP_EXPORT int fftConvolutionThreshold();
+
+  /**
+   * Sets the number of filter coefficients at which [convolution()]
+   * switches to the FFT-based algorithm. A very large value disables
+   * the FFT algorithm.
+   */
+  PII_DSP_EXPORT void setFftConvolutionThreshold(int threshold);
+
+  /**
+   * Measures the speeds of [directConvolution()] and
+   * [fftConvolution()] with square filters of increasing size on a
+   * 256-by-256 `float` image. The number of coefficients in the
+   * smallest filter for which the FFT is faster is set as the new
+   * [fftConvolutionThreshold()] and returned. The benchmark takes
+   * a fraction of a second.
+   */
+  PII_DSP_EXPORT int calibrateFftConvolution();
+
+  /**
+   * Returns the smallest length greater than or equal to *length*
+   * that has no prime factors other than 2, 3 and 5. PiiFft is
+   * efficient with such lengths.
+   */
+  PII_DSP_EXPORT int fastFftLength(int length);
+
+  /**
+   * Computes one row of a one-dimensional convolution and adds it to
+   * *result*. For each *i* in [0, *count*-1], *result*[i] is
+   * incremented by the sum of *input*[i+j] * *coeffs*[j] over *j* in
+   * [0, *taps*-1]. Note that *coeffs* is the flipped filter. This is
+   * the innermost loop of [convolution()] and all of its relatives.
+   *
+   * The generic template performs the summation in *ResultType*.
+   * There are non-template overloads for `unsigned char` and `int`
+   * input with `int` coefficients and result, and for `unsigned char`
+   * and `float` input with `float` coefficients and result. They use
+   * SSE/AVX2 or NEON instructions if the CPU running the code
+   * supports them. Each output element is accumulated in the same
+   * order as in the generic version. The integer results are
+   * therefore identical.
+   */
+  template <class ResultType, class T, class U>
+  inline void convolveRow(ResultType* result, const T* input, const U* coeffs, int count, int taps)
+  {
+    for (int i=0; i<count; ++i)
+      for (int j=0; j<taps; ++j)
+        result[i] += ResultType(input[i+j]) * ResultType(coeffs[j]);
+  }
+
+  /// @hide
+  PII_DSP_EXPORT void convolveRow(int* result, const unsigned char* input, const int* coeffs, int count, int taps);
+  PII_DSP_EXPORT void convolveRow(int* result, const int* input, const int* coeffs, int count, int taps);
+  PII_DSP_EXPORT void convolveRow(float* result, const unsigned char* input, const float* coeffs, int count, int taps);
+  PII_DSP_EXPORT void convolveRow(float* result, const float* input, const float* coeffs, int count, int taps);
+  /// @hide
+
 
   /**
    * Two-dimensional correlation of two matrices. The
@@ -230,6 +336,14 @@ namespace PiiDsp
    * @return shifted matrix
    */
   template <class T> PiiMatrix<T> fftShift(const PiiMatrix<T>& matrix, bool inverse = false);
+
+  /**
+   * Swap the left and right halves of each row of *matrix*. This
+   * moves the origin of each spectrum in a matrix of row-wise
+   * transforms to the center of the row. See [fftShift()] for the
+   * meaning of *inverse*.
+   */
+  template <class T> PiiMatrix<T> fftShiftRows(const PiiMatrix<T>& matrix, bool inverse = false);
 }
 
 #include "PiiDsp-templates.h"
@@ -21,437 +21,326 @@
 #endif
 
 #include <cmath>
+#include <QMutexLocker>
+#include <PiiInvalidArgumentException.h>
+
+/// @hide
+
+/* A transform of length N = r_1 r_2 ... r_n is calculated in n
+ * stages. The input is first permuted so that each stage can work in
+ * place. Stage i combines radix r_i sub-transforms of length
+ * sofar = r_1 ... r_{i-1}. The element at block b of data index j in
+ * group g is at g*sofar*r_i + b*sofar + j, which makes j the
+ * contiguous dimension. The twiddle factors of each block are stored
+ * contiguously so that the butterflies can be vectorized over j.
+ */
+template <class T> class PiiFft<T>::Plan : public PiiSharedD<Plan>
+{
+public:
+  explicit Plan(int count);
+
+  int count() const { return _iCount; }
+
+  // Transforms count() elements of source (step elements apart) to
+  // dest. Inverse transforms are scaled by 1/count().
+  template <class S> void transform(const S* source, int step, std::complex<T>* dest, bool inverse) const;
+  // Transforms count() complex numbers formed by consecutive pairs of
+  // real values in source.
+  template <class S> void transformPairs(const S* source, std::complex<T>* dest) const;
+
+  // exp(-i pi k / count()) for k = 0...count(). These are the twiddle
+  // factors of a real-valued transform of length 2*count().
+  const std::complex<T>* realTwiddles() const { return _vecRealTwiddles.constData(); }
+
+private:
+  struct Stage
+  {
+    int iSofar, iRadix, iRemain;
+    int iTwiddleOffset, iTrigOffset;
+  };
+
+  void factorize(int count, QVector<int>& radices) const;
+  void runStages(std::complex<T>* data) const;
+  void runStage(const Stage& stage, std::complex<T>* data) const;
+
+  void fftPrime(std::complex<T>* z,  const std::complex<T>* trig, int radix,
+                std::complex<T>* v, std::complex<T>* w) const;
+  inline void fft3(std::complex<T>* z) const;
+  inline void fft5(std::complex<T>* z) const;
+  inline void fft10(std::complex<T>* z) const;
+
+  static inline std::complex<T> multiply(const std::complex<T>& a, const std::complex<T>& b)
+  {
+    return std::complex<T>(a.real() * b.real() - a.imag() * b.imag(),
+                           a.real() * b.imag() + a.imag() * b.real());
+  }
+
+  int _iCount;
+  QVector<Stage> _vecStages;
+  QVector<int> _vecPermutation;
+  QVector<std::complex<T> > _vecTwiddles, _vecTrig, _vecRealTwiddles;
+  T c3_1, c3_2, c5_1, c5_2, c5_3, c5_4, c5_5;
+};
+
+// Releases a reserved plan when it goes out of scope.
+template <class T> class PiiFft<T>::PlanRef
+{
+public:
+  explicit PlanRef(int count) : _pPlan(PiiFft<T>::plan(count)) {}
+  ~PlanRef() { _pPlan->release(); }
 
-template <class T> PiiFft<T>::PiiFft() : _trig(new std::complex<T>[37]), _twiddle(new std::complex<T>[37]), _z(new std::complex<T>[37]),
-                                         _count(0), _factorCount(0), _prevPrimeRadix(37)
-{
-  _pi  = T(4*std::atan(1.0));
-  c3_1 = T(std::cos(2*_pi/3)-1);
-  c3_2 = T(std::sin(2*_pi/3));
-  u5   = T(2*_pi/5);
-  c5_1 = T((std::cos(u5)+std::cos(2*u5))/2-1);
-  c5_2 = T((std::cos(u5)-std::cos(2*u5))/2);
-  c5_3 = T(-std::sin(u5));
-  c5_4 = T(-(std::sin(u5)+std::sin(2*u5)));
-  c5_5 = T((std::sin(u5)-std::sin(2*u5)));
-  c8   = T(1/std::sqrt(2.0));
-
-  for ( int i=0; i<20; i++ )
-    {
-      _actualRadix[i] = 0;
-      _sofarRadix[i] = 0;
-      _remainRadix[i] = 0;
-    }
-}
+  const Plan* operator-> () const { return _pPlan; }
+  operator const Plan* () const { return _pPlan; }
 
-template <class T> PiiFft<T>::~PiiFft()
-{
-  delete[] _trig;
-  delete[] _twiddle;
-  delete[] _z;
-}
+private:
+  PlanRef(const PlanRef&);
+  PlanRef& operator= (const PlanRef&);
+  Plan* _pPlan;
+};
 
-template <class T>
-template <class S> PiiMatrix<std::complex<T> > PiiFft<T>::forwardFft(const PiiMatrix<S>& source)
+template <class T> PiiFft<T>::Plan::Plan(int count) :
+  _iCount(count)
 {
-  int cols = source.columns();
-  int rows = source.rows();
+  const double dPi = 4*std::atan(1.0), dU5 = 2*dPi/5;
+  c3_1 = T(std::cos(2*dPi/3)-1);
+  c3_2 = T(std::sin(2*dPi/3));
+  c5_1 = T((std::cos(dU5)+std::cos(2*dU5))/2-1);
+  c5_2 = T((std::cos(dU5)-std::cos(2*dU5))/2);
+  c5_3 = T(-std::sin(dU5));
+  c5_4 = T(-(std::sin(dU5)+std::sin(2*dU5)));
+  c5_5 = T((std::sin(dU5)-std::sin(2*dU5)));
+
+  _vecRealTwiddles.resize(count + 1);
+  for (int k=0; k<=count; ++k)
+    _vecRealTwiddles[k] = std::complex<T>(T(std::cos(dPi*k/count)), T(-std::sin(dPi*k/count)));
+
+  _vecPermutation.resize(count);
+  if (count == 1)
+    {
+      _vecPermutation[0] = 0;
+      return;
+    }
 
-  PiiMatrix<std::complex<T> > result(rows, cols);
+  QVector<int> vecRadices;
+  factorize(count, vecRadices);
+  const int iFactors = vecRadices.size();
 
-  if ( cols > 1 )
+  // Index 0 and iFactors+1 are sentinels for the permutation.
+  QVector<int> vecRemain(iFactors + 2), vecCounters(iFactors + 2);
+  vecRemain[0] = count;
+  int iSofar = 1;
+  for (int i=0; i<iFactors; ++i)
     {
-      for ( int r=0; r<rows; r++ )
+      const int iRadix = vecRadices[i];
+      vecRemain[i+1] = vecRemain[i] / iRadix;
+
+      Stage stage = { iSofar, iRadix, vecRemain[i+1], _vecTwiddles.size(), _vecTrig.size() };
+      // Twiddle factors of block b are exp(-2 pi i j b / (sofar radix)).
+      const int iSpan = iSofar * iRadix;
+      for (int b=1; b<iRadix; ++b)
+        for (int j=0; j<iSofar; ++j)
+          {
+            const double dAngle = 2*dPi * ((qint64(j) * b) % iSpan) / iSpan;
+            _vecTwiddles.append(std::complex<T>(T(std::cos(dAngle)), T(-std::sin(dAngle))));
+          }
+      if (iRadix != 2 && iRadix != 3 && iRadix != 4 && iRadix != 5 && iRadix != 10)
         {
-          if (!forward1d<S>(source.row(r), result.row(r), cols) )
-            return PiiMatrix<std::complex<T> >(1,1);
+          for (int k=0; k<iRadix; ++k)
+            _vecTrig.append(std::complex<T>(T(std::cos(2*dPi*k/iRadix)), T(-std::sin(2*dPi*k/iRadix))));
         }
+      _vecStages.append(stage);
+      iSofar = iSpan;
     }
-  else
-    result = source;
 
-  if ( rows > 1 )
+  // Reorder the series so that each stage can be done in place, and
+  // the final result is in correct order.
+  int k = 0;
+  for (int i=0; i<count-1; ++i)
     {
-      if (_tempSource.columns() != rows)
-        reallocateBuffers(rows);
-      std::complex<T> *src = _tempSource.row(0), *res = _tempResult.row(0);
-
-      for ( int c=0; c<cols; c++ )
+      _vecPermutation[i] = k;
+      int j = 1;
+      k += vecRemain[j];
+      ++vecCounters[1];
+      while (vecCounters[j] >= vecRadices[j-1])
         {
-          for ( int r=0; r<rows; r++ )
-            src[r] = result(r,c);
-
-          if ( !forward1d<std::complex<T> >(src, res, rows) )
-            return PiiMatrix<std::complex<T> >(1,1);
-          for ( int r=0; r<rows; r++ )
-            result(r,c) = res[r];
+          vecCounters[j] = 0;
+          k = k - vecRemain[j-1] + vecRemain[j+1];
+          ++j;
+          ++vecCounters[j];
         }
     }
-  return result;
-}
-
-template <class T> void PiiFft<T>::reallocateBuffers(int len)
-{
-  _tempSource.resize(1,len);
-  _tempResult.resize(1,len);
+  _vecPermutation[count-1] = count-1;
 }
 
-template <class T>
-template <class S> PiiMatrix<std::complex<T> > PiiFft<T>::inverseFft(const PiiMatrix<std::complex<S> >& source)
+template <class T> void PiiFft<T>::Plan::factorize(int count, QVector<int>& radices) const
 {
-  int cols = source.columns();
-  int rows = source.rows();
-
-  PiiMatrix<std::complex<T> > result(rows, cols);
-
-  if ( cols > 1 )
+  // Radix 4 has a vectorized kernel. Take as many of them as
+  // possible, but prefer 10 for multiples of ten.
+  const int iRadixCount = 5;
+  const int iRadices[iRadixCount] = { 2, 3, 5, 4, 10 };
+
+  QVector<int> vecFactors;
+  int i = iRadixCount - 1;
+  while (count > 1 && i >= 0)
     {
-      for ( int r=0; r<rows; r++ )
+      if (count % iRadices[i] == 0)
         {
-          if (!inverse1d<S>(source.row(r), result.row(r), cols))
-            return PiiMatrix<std::complex<T> >(1,1);
+          count /= iRadices[i];
+          vecFactors.append(iRadices[i]);
         }
+      else
+        --i;
     }
-  else
-    result = source;
 
-  if ( rows > 1 )
+  // Analyse the rest value and see if it can be factored in primes
+  if (count > 1)
     {
-      if (_tempSource.columns() != rows)
-        reallocateBuffers(rows);
-      std::complex<T> *src = _tempSource.row(0), *res = _tempResult.row(0);
-
-      for ( int c=0; c<cols; c++ )
+      for (int k=2; k<std::sqrt(double(count))+1; ++k)
         {
-          for ( int r=0; r<rows; r++ )
-            src[r] = result(r,c);
-
-          if ( !inverse1d<T>(src, res, rows) )
-            return PiiMatrix<std::complex<T> >(1,1);
-          for ( int r=0; r<rows; r++ )
-            result(r,c) = res[r];
+          while (count % k == 0)
+            {
+              count /= k;
+              vecFactors.append(k);
+            }
         }
+      if (count > 1)
+        vecFactors.append(count);
     }
 
-  return result;
+  radices.resize(vecFactors.size());
+  for (int f=0; f<vecFactors.size(); ++f)
+    radices[f] = vecFactors[vecFactors.size() - f - 1];
 }
 
-
 template <class T>
-template <class S> bool PiiFft<T>::forward1d(const S* source, std::complex<T>* destination, int count)
+template <class S> void PiiFft<T>::Plan::transform(const S* source, int step, std::complex<T>* dest, bool inverse) const
 {
-  if (count == 0)
-    return false;
-
-  if (_count != count)
+  const int* pPermutation = _vecPermutation.constData();
+  if (inverse)
     {
-      factorize(count);
-      _count = count;
+      // The inverse is calculated as conj(F(conj(x)))/N.
+      for (int i=0; i<_iCount; ++i)
+        dest[i] = std::conj(std::complex<T>(source[pPermutation[i] * step]));
+      runStages(dest);
+      const T scale = T(1) / _iCount;
+      for (int i=0; i<_iCount; ++i)
+        dest[i] = std::complex<T>(scale * dest[i].real(), -scale * dest[i].imag());
     }
-
-  _remainRadix[0] = _count;
-  _sofarRadix[1] = 1;
-  _remainRadix[1] = _count / _actualRadix[1];
-  for ( int i = 2; i<=_factorCount; i++ )
+  else
     {
-      _sofarRadix[i]  = _sofarRadix[i-1] * _actualRadix[i-1];
-      _remainRadix[i] = _remainRadix[i-1] / _actualRadix[i];
+      for (int i=0; i<_iCount; ++i)
+        dest[i] = std::complex<T>(source[pPermutation[i] * step]);
+      runStages(dest);
     }
-
-  reorderSeries(source, destination);
-
-  for ( int i=1; i<=_factorCount; i++)
-    synthesizeFft(_sofarRadix[i], _actualRadix[i], _remainRadix[i], destination);
-
-  return true;
-
 }
 
 template <class T>
-template <class S> bool PiiFft<T>::inverse1d(const std::complex<S>* source, std::complex<T>* destination, int count)
+template <class S> void PiiFft<T>::Plan::transformPairs(const S* source, std::complex<T>* dest) const
 {
-  S s;
-
-  if ( count == 0 )
-    return false;
-
-  std::complex<S> *tmpPtr = new std::complex<S>[count];
-
-  for ( int i=count; i--; )
-    tmpPtr[i] = std::complex<S>(source[i].real(), -source[i].imag());
-
-  forward1d(tmpPtr, destination, count);
-
-  s = 1.0 / count;
-  for ( int i=count; i--; )
+  const int* pPermutation = _vecPermutation.constData();
+  for (int i=0; i<_iCount; ++i)
     {
-      destination[i] = (T)s * std::conj(destination[i]);
-      //destination[i].real() =  s * destination[i].real();
-      //destination[i].imag() = -s * destination[i].imag();
+      const S* pPair = source + 2 * pPermutation[i];
+      dest[i] = std::complex<T>(T(pPair[0]), T(pPair[1]));
     }
-
-  delete[] tmpPtr;
-
-  return true;
+  runStages(dest);
 }
 
-
-/********** PRIVATE FUNCTIONS **********/
-
-/**
- * Reorder the series in X to a permuted sequence in Y so that the later step can
- * be done in place, and the final Fft result is in correct order.
- * The series X and Y must be different series!
- */
-template <class T>
-template <class S> void PiiFft<T>::reorderSeries(const S* source, std::complex<T>* dest)
+template <class T> void PiiFft<T>::Plan::runStages(std::complex<T>* data) const
 {
-  int i,j,k;
-  int *counts = new int[_factorCount+1];
-
-  for (i=1; i<=_factorCount; i++)
-    counts[i]=0;
-
-  k=0;
-
-  for (i=0; i<=_count-2; i++)
-    {
-      dest[i] = source[k];
-      j = 1;
-      k = k + _remainRadix[j];
-      counts[1]++;
-      while (counts[j] >= _actualRadix[j])
-        {
-          counts[j] = 0;
-          k = k - _remainRadix[j-1] + _remainRadix[j+1];
-          j = j + 1;
-          counts[j] = counts[j] + 1;
-        }
-    }
-
-  dest[_count-1] = source[_count-1];
-  delete[] counts;
+  for (int i=0; i<_vecStages.size(); ++i)
+    runStage(_vecStages[i], data);
 }
 
-
-template <class T> void PiiFft<T>::factorize(int count)
+template <class T> void PiiFft<T>::Plan::runStage(const Stage& stage, std::complex<T>* data) const
 {
-  int i = 0, k;
-  int factors[20];
-  const int iRadixCount = 6;
-  const int iRadices[7] = {0,2,3,4,5,8,10};
+  const int iSofar = stage.iSofar, iRadix = stage.iRadix, iSpan = iSofar * iRadix;
+  const std::complex<T>* pTwiddles = _vecTwiddles.constData() + stage.iTwiddleOffset;
 
-  if ( count == 1 )
+  if (iRadix == 2)
     {
-      _factorCount = 1;
-      factors[1] = 1;
-    }
-  else
-    _factorCount = 0;
-
-
-  // Factorise the original series length Count into known factors and rest value
-  i = iRadixCount;
-  while(count > 1 && i > 0)
-    {
-      if ( count % iRadices[i] == 0 )
+      for (int g=0; g<stage.iRemain; ++g)
         {
-          count = count / iRadices[i];
-          _factorCount++;
-          factors[_factorCount] = iRadices[i];
+          std::complex<T>* x0 = data + g * iSpan;
+          // Short loops are not worth a function call.
+          if (iSofar < 4)
+            PiiDsp::fftButterfly2<T>(x0, x0 + iSofar, pTwiddles, iSofar);
+          else
+            PiiDsp::fftButterfly2(x0, x0 + iSofar, pTwiddles, iSofar);
         }
-      else
-        i--;
+      return;
     }
-
-  // substitute factors 2*8 with more optimal 4*4
-  if ( factors[_factorCount] == 2 )
+  if (iRadix == 4)
     {
-      i = _factorCount - 1;
-      while( i > 0 && factors[i] != 8 )
-        i--;
-
-      if ( i > 0 )
+      for (int g=0; g<stage.iRemain; ++g)
         {
-          factors[_factorCount] = 4;
-          factors[i] = 4;
+          std::complex<T>* x0 = data + g * iSpan;
+          if (iSofar < 4)
+            PiiDsp::fftButterfly4<T>(x0, x0 + iSofar, x0 + 2*iSofar, x0 + 3*iSofar,
+                                     pTwiddles, pTwiddles + iSofar, pTwiddles + 2*iSofar, iSofar);
+          else
+            PiiDsp::fftButterfly4(x0, x0 + iSofar, x0 + 2*iSofar, x0 + 3*iSofar,
+                                  pTwiddles, pTwiddles + iSofar, pTwiddles + 2*iSofar, iSofar);
         }
+      return;
     }
 
-  // Analyse the rest value and see if it can be factored in primes
-  if ( count > 1 )
+  // Other radices go through a scratch buffer, one butterfly at a
+  // time.
+  QVector<std::complex<T> > vecZ(iRadix), vecV, vecW;
+  const std::complex<T>* pTrig = 0;
+  if (stage.iTrigOffset < _vecTrig.size() && iRadix != 3 && iRadix != 5 && iRadix != 10)
     {
-      for ( k = 2; k<std::sqrt((double)count)+1; k++ )
-        {
-          while (count % k == 0)
-            {
-              count = count / k;
-              _factorCount++;
-              factors[_factorCount] = k;
-            }
-        }
-
-      if ( count > 1)
-        {
-          _factorCount++;
-          factors[_factorCount] = count;
-        }
+      pTrig = _vecTrig.constData() + stage.iTrigOffset;
+      vecV.resize((iRadix + 1) / 2);
+      vecW.resize((iRadix + 1) / 2);
     }
-
-  _actualRadix[0] = 0;
-  for ( i=1; i<=_factorCount; i++ )
-    _actualRadix[i] = factors[_factorCount - i + 1];
-
-}
-
-template <class T> void PiiFft<T>::synthesizeFft(int sofarRadix, int radix, int remainRadix, std::complex<T>* dest)
-{
-  T omega = 2 * _pi/(T)(sofarRadix*radix);
-  std::complex<T> cosSin(std::cos(omega), -std::sin(omega));
-  std::complex<T> S(1,0);
-
-  int groupOffset, dataOffset, adr;
-  int groupNo, dataNo, blockNo, twNo;
-
-  if ( isPrimeFactor(radix) )
-    initializeTrigonomials(radix);
-
-  dataOffset = 0;
-  groupOffset = dataOffset;
-  adr = groupOffset;
-
-  for (dataNo=0; dataNo<sofarRadix; dataNo++)
+  std::complex<T>* z = vecZ.data();
+  for (int g=0; g<stage.iRemain; ++g)
     {
-      if (sofarRadix>1)
+      std::complex<T>* pGroup = data + g * iSpan;
+      for (int j=0; j<iSofar; ++j)
         {
-          _twiddle[0] = std::complex<T>(1.0,0.0);
-          _twiddle[1] = S;
+          z[0] = pGroup[j];
+          for (int b=1; b<iRadix; ++b)
+            z[b] = j == 0 ? pGroup[b * iSofar] : multiply(pTwiddles[(b-1) * iSofar + j], pGroup[b * iSofar + j]);
 
-          for (twNo=2; twNo<radix; twNo++)
-            _twiddle[twNo] = S * _twiddle[twNo-1];
+          switch (iRadix)
+            {
+            case 3: fft3(z); break;
+            case 5: fft5(z); break;
+            case 10: fft10(z); break;
+            default: fftPrime(z, pTrig, iRadix, vecV.data(), vecW.data()); break;
+            }
 
-          S = cosSin * S;
+          for (int b=0; b<iRadix; ++b)
+            pGroup[b * iSofar + j] = z[b];
         }
-
-        for (groupNo=0; groupNo<remainRadix; groupNo++)
-          {
-            if ((sofarRadix>1) && (dataNo > 0))
-              {
-                _z[0] = dest[adr];
-                blockNo=1;
-
-                do {
-                  adr = adr + sofarRadix;
-                  _z[blockNo] = _twiddle[blockNo] * dest[adr];
-                  blockNo++;
-                } while (blockNo < radix);
-              }
-            else
-              {
-                for (blockNo=0; blockNo<radix; blockNo++)
-                  {
-                    _z[blockNo] = dest[adr];
-                    adr = adr + sofarRadix;
-                  }
-              }
-
-            switch(radix)
-              {
-              case  2  : fft2(_z); break;
-              case  3  : fft3(_z); break;
-              case  4  : fft4(_z); break;
-              case  5  : fft5(_z); break;
-              case  8  : fft8(_z); break;
-              case 10  : fft10(_z); break;
-              default  : fftPrime(radix); break;
-              }
-
-            adr = groupOffset;
-            for (blockNo=0; blockNo<radix; blockNo++)
-              {
-                dest[adr] = _z[blockNo];
-                adr = adr + sofarRadix;
-              }
-            groupOffset = groupOffset + sofarRadix * radix;
-            adr = groupOffset;
-          }
-        dataOffset++;
-        groupOffset = dataOffset;
-        adr = dataOffset;
     }
-
 }
 
-template <class T> void PiiFft<T>::initializeTrigonomials( int radix )
+template <class T> void PiiFft<T>::Plan::fftPrime(std::complex<T>* z, const std::complex<T>* trig, int radix,
+                                                  std::complex<T>* v, std::complex<T>* w) const
 {
-  if ( radix > _prevPrimeRadix )
+  const int n = radix, max = (n + 1)/2;
+  for (int j = 1; j < max; j++)
     {
-      delete[] _trig;
-      delete[] _twiddle;
-      delete[] _z;
-      _trig = new std::complex<T>[radix];
-      _twiddle = new std::complex<T>[radix];
-      _z = new std::complex<T>[radix];
-      _prevPrimeRadix = radix;
+      v[j] = std::complex<T>(z[j].real() + z[n-j].real(), z[j].imag() - z[n-j].imag());
+      w[j] = std::complex<T>(z[j].real() - z[n-j].real(), z[j].imag() + z[n-j].imag());
     }
 
-  int i;
-  T w;
-  std::complex<T> x;
-
-
-  w = 2 * _pi / radix;
-  _trig[0] = std::complex<T>(1,0);
-  x = std::complex<T>(std::cos(w), -std::sin(w));
-  _trig[1] = x;
-
-  for (i=2; i<radix; i++)
-    _trig[i] = x * _trig[i-1];
-
-
-}
-
-template <class T> inline void PiiFft<T>::fftPrime(int radix)
-{
-  int i,j,k,n,max;
-  std::complex<T> re, im;
-  int cols = ((radix+1) / 2);
-  std::complex<T> *v = new std::complex<T>[cols];
-  std::complex<T> *w = new std::complex<T>[cols];
-
-  n = radix;
-  max = (n + 1)/2;
-  for (j = 1; j < max; j++)
+  for (int j = 1; j < max; j++)
     {
-      v[j] = std::complex<T>(_z[j].real() + _z[n-j].real(), _z[j].imag() - _z[n-j].imag());
-      w[j] = std::complex<T>(_z[j].real() - _z[n-j].real(), _z[j].imag() + _z[n-j].imag());
-      //v[j].real() = _z[j].real() + _z[n-j].real();
-      //v[j].imag() = _z[j].imag() - _z[n-j].imag();
-      //w[j].real() = _z[j].real() - _z[n-j].real();
-      //w[j].imag() = _z[j].imag() + _z[n-j].imag();
-    }
-
-  for (j = 1; j < max; j++)
-    {
-      _z[j] = _z[0];
-      _z[n-j] = _z[0];
-      k = j;
-      for (i = 1; i < max; i++)
+      z[j] = z[0];
+      z[n-j] = z[0];
+      int k = j;
+      for (int i = 1; i < max; i++)
         {
-          re = std::complex<T>(_trig[k].real() * v[i].real(), _trig[k].real() * w[i].imag());
-          im = std::complex<T>(_trig[k].imag() * w[i].real(), _trig[k].imag() * v[i].imag());
-          //re.real() = _trig[k].real() * v[i].real();
-          //im.imag() = _trig[k].imag() * v[i].imag();
-          //re.imag() = _trig[k].real() * w[i].imag();
-          //im.real() = _trig[k].imag() * w[i].real();
-
-          _z[n-j] = std::complex<T>(_z[n-j].real() + re.real() + im.imag(), _z[n-j].imag() + re.imag() - im.real());
-          _z[j] = std::complex<T>(_z[j].real() + re.real() - im.imag(), _z[j].imag() + re.imag() + im.real());
+          const T reRe = trig[k].real() * v[i].real(), reIm = trig[k].real() * w[i].imag(),
+            imRe = trig[k].imag() * w[i].real(), imIm = trig[k].imag() * v[i].imag();
 
-          //_z[n-j].real() += (re.real() + im.imag());
-          //_z[n-j].imag() += (re.imag() - im.real());
-          //_z[j].real()   += (re.real() - im.imag());
-          //_z[j].imag()   += (re.imag() + im.real());
+          z[n-j] = std::complex<T>(z[n-j].real() + reRe + imIm, z[n-j].imag() + reIm - imRe);
+          z[j] = std::complex<T>(z[j].real() + reRe - imIm, z[j].imag() + reIm + imRe);
 
           k = k + j;
           if (k >= n)
@@ -459,27 +348,11 @@ template <class T> inline void PiiFft<T>::fftPrime(int radix)
         }
     }
 
-  for ( j = 1; j < max; j++)
-    {
-      _z[0] = std::complex<T>(_z[0].real() + v[j].real(), _z[0].imag() + w[j].imag() );
-      //_z[0].real() += v[j].real();
-      //_z[0].imag() += w[j].imag();
-    }
-  delete[] w;
-  delete[] v;
-
-}
-
-template <class T> inline void PiiFft<T>::fft2(std::complex<T>* z)
-{
-  std::complex<T> t1;
-
-  t1 = z[0] + z[1];
-  z[1] = z[0] - z[1];
-  z[0] = t1;
+  for (int j = 1; j < max; j++)
+    z[0] = std::complex<T>(z[0].real() + v[j].real(), z[0].imag() + w[j].imag());
 }
 
-template <class T> inline void PiiFft<T>::fft3(std::complex<T>* z)
+template <class T> inline void PiiFft<T>::Plan::fft3(std::complex<T>* z) const
 {
   std::complex<T> t1, m1, m2, s1;
 
@@ -487,33 +360,12 @@ template <class T> inline void PiiFft<T>::fft3(std::complex<T>* z)
   z[0] += t1;
   m1 = c3_1 * t1;
   m2 = std::complex<T>(c3_2 * (z[1].imag() - z[2].imag()),c3_2 * (z[2].real() - z[1].real()));
-  //m2.real() = c3_2 * (z[1].imag() - z[2].imag());
-  //m2.imag() = c3_2 * (z[2].real() - z[1].real());
   s1 = z[0] + m1;
   z[1] = s1 + m2;
   z[2] = s1 - m2;
-
 }
 
-template <class T> inline void PiiFft<T>::fft4(std::complex<T>* z)
-{
-  std::complex<T> t1, t2, m2, m3;
-
-  t1 = z[0] + z[2];
-  t2 = z[1] + z[3];
-
-  m2 = z[0] - z[2];
-  m3 = std::complex<T>(z[1].imag() - z[3].imag(), z[3].real() - z[1].real());
-  //m3.real() = z[1].imag() - z[3].imag();
-  //m3.imag() = z[3].real() - z[1].real();
-
-  z[0] = t1 + t2;
-  z[2] = t1 - t2;
-  z[1] = m2 + m3;
-  z[3] = m2 - m3;
-}
-
-template <class T> inline void PiiFft<T>::fft5(std::complex<T>* z)
+template <class T> inline void PiiFft<T>::Plan::fft5(std::complex<T>* z) const
 {
   std::complex<T> t1, t2, t3, t4, t5;
   std::complex<T> m1, m2, m3, m4, m5;
@@ -532,12 +384,6 @@ template <class T> inline void PiiFft<T>::fft5(std::complex<T>* z)
   m3 = std::complex<T>(-c5_3 * (t3.imag() + t4.imag()), c5_3 * (t3.real() + t4.real()));
   m4 = std::complex<T>(-c5_4 * t4.imag(), c5_4 * t4.real() );
   m5 = std::complex<T>(-c5_5 * t3.imag(), c5_5 * t3.real());
-  //m3.real() = -c5_3 * (t3.imag() + t4.imag());
-  //m3.imag() =  c5_3 * (t3.real() + t4.real());
-  //m4.real() = -c5_4 * t4.imag();
-  //m4.imag() =  c5_4 * t4.real();
-  //m5.real() = -c5_5 * t3.imag();
-  //m5.imag() =  c5_5 * t3.real();
 
   s3 = m3 - m4;
   s5 = m3 + m5;
@@ -551,97 +397,501 @@ template <class T> inline void PiiFft<T>::fft5(std::complex<T>* z)
   z[4] = s2 - s3;
 }
 
-template <class T> inline void PiiFft<T>::fft8(std::complex<T>* z)
+template <class T> inline void PiiFft<T>::Plan::fft10(std::complex<T>* z) const
+{
+  std::complex<T> a[5], b[5];
+
+  a[0] = z[0];
+  a[1] = z[2];
+  a[2] = z[4];
+  a[3] = z[6];
+  a[4] = z[8];
+
+  b[0] = z[5];
+  b[1] = z[7];
+  b[2] = z[9];
+  b[3] = z[1];
+  b[4] = z[3];
+
+  fft5(a);
+  fft5(b);
+
+  z[0] = a[0] + b[0];
+  z[6] = a[1] + b[1];
+  z[2] = a[2] + b[2];
+  z[8] = a[3] + b[3];
+  z[4] = a[4] + b[4];
+  z[5] = a[0] - b[0];
+  z[1] = a[1] - b[1];
+  z[7] = a[2] - b[2];
+  z[3] = a[3] - b[3];
+  z[9] = a[4] - b[4];
+}
+
+template <class T> template <class S> struct PiiFft<T>::RowTransform
+{
+  RowTransform(const PiiMatrix<S>& source, PiiMatrix<std::complex<T> >& result,
+               const Plan* plan, bool inverse) :
+    source(source), plan(plan), inverse(inverse), resultRows(result)
+  {}
+
+  void operator() (int firstRow, int rowCount)
+  {
+    for (int r=firstRow; r<firstRow+rowCount; ++r)
+      plan->transform(source[r], 1, resultRows.row(r), inverse);
+  }
+
+  const PiiMatrix<S>& source;
+  const Plan* plan;
+  bool inverse;
+  const Pii::BandRows<std::complex<T> > resultRows;
+};
+
+/* Transforms a row of 2M real values as M complex numbers Z and
+ * separates the transforms of the even (Fe) and odd (Fo) samples:
+ *
+ * Fe(k) = (Z(k) + Z*(M-k))/2, Fo(k) = -i (Z(k) - Z*(M-k))/2
+ * X(k) = Fe(k) + exp(-i pi k / M) Fo(k)
+ *
+ * Rows with an odd length use a complex transform.
+ */
+template <class T> template <class S> struct PiiFft<T>::RealRowTransform
 {
-  T gem;
+  RealRowTransform(const PiiMatrix<S>& source, PiiMatrix<std::complex<T> >& result, const Plan* plan) :
+    source(source), plan(plan), resultRows(result)
+  {}
+
+  void operator() (int firstRow, int rowCount)
+  {
+    const int iColumns = source.columns();
+    for (int r=firstRow; r<firstRow+rowCount; ++r)
+      {
+        std::complex<T>* pRow = resultRows.row(r);
+        if (iColumns & 1)
+          {
+            plan->transform(source[r], 1, pRow, false);
+            continue;
+          }
 
-  _a[0] = z[0];
-  _a[1] = z[2];
-  _a[2] = z[4];
-  _a[3] = z[6];
+        const int iHalf = plan->count();
+        const std::complex<T>* pTwiddles = plan->realTwiddles();
+        plan->transformPairs(source[r], pRow);
+        const std::complex<T> z0(pRow[0]);
+        for (int k=1, l=iHalf-1; k<=l; ++k, --l)
+          {
+            const std::complex<T> a(pRow[k]), c(pRow[l]);
+            // Fe(k), Fo(k)
+            const T er = (a.real() + c.real()) / 2, ei = (a.imag() - c.imag()) / 2,
+              or_ = (a.imag() + c.imag()) / 2, oi = (c.real() - a.real()) / 2;
+            // X(k) = Fe(k) + W^k Fo(k), X(l) = Fe(k)* + W^l Fo(k)*
+            const std::complex<T>& wk = pTwiddles[k], &wl = pTwiddles[l];
+            pRow[k] = std::complex<T>(er + wk.real() * or_ - wk.imag() * oi,
+                                      ei + wk.real() * oi + wk.imag() * or_);
+            pRow[l] = std::complex<T>(er + wl.real() * or_ + wl.imag() * oi,
+                                      -ei - wl.real() * oi + wl.imag() * or_);
+          }
+        pRow[0] = std::complex<T>(z0.real() + z0.imag(), 0);
+        pRow[iHalf] = std::complex<T>(z0.real() - z0.imag(), 0);
+      }
+  }
 
-  _b[0] = z[1];
-  _b[1] = z[3];
-  _b[2] = z[5];
-  _b[3] = z[7];
+  const PiiMatrix<S>& source;
+  const Plan* plan;
+  const Pii::BandRows<std::complex<T> > resultRows;
+};
 
-  fft4(_a);
-  fft4(_b);
+/* Reverses RealRowTransform:
+ *
+ * Fe(k) = (X(k) + X*(M-k))/2, Fo(k) = exp(i pi k / M) (X(k) - X*(M-k))/2
+ * Z(k) = Fe(k) + i Fo(k)
+ */
+template <class T> template <class S> struct PiiFft<T>::RealInverseRowTransform
+{
+  RealInverseRowTransform(const PiiMatrix<std::complex<S> >& source, PiiMatrix<T>& result, const Plan* plan) :
+    source(source), plan(plan),
+    resultRows(result), iColumns(result.columns())
+  {}
+
+  void operator() (int firstRow, int rowCount)
+  {
+    const int iCount = plan->count();
+    QVector<std::complex<T> > vecInput(iCount), vecOutput(iCount);
+    std::complex<T>* pInput = vecInput.data(), *pOutput = vecOutput.data();
+    const std::complex<T>* pTwiddles = plan->realTwiddles();
+    for (int r=firstRow; r<firstRow+rowCount; ++r)
+      {
+        const std::complex<S>* pSource = source[r];
+        T* pRow = resultRows.row(r);
+        if (iColumns & 1)
+          {
+            // Restore the redundant half of the spectrum.
+            for (int c=0; c<source.columns(); ++c)
+              pInput[c] = std::complex<T>(pSource[c]);
+            for (int c=source.columns(); c<iColumns; ++c)
+              pInput[c] = std::conj(pInput[iColumns - c]);
+            plan->transform(pInput, 1, pOutput, true);
+            for (int c=0; c<iColumns; ++c)
+              pRow[c] = pOutput[c].real();
+            continue;
+          }
 
-  gem = c8 * (_b[1].real() + _b[1].imag());
-  _b[1] = std::complex<T>(gem, c8 * (_b[1].imag() - _b[1].real()));
-  //_b[1].imag() = c8 * (_b[1].imag() - _b[1].real());
-  //_b[1].real() = gem;
+        for (int k=0; k<iCount; ++k)
+          {
+            const std::complex<T> a(pSource[k]), c(pSource[iCount-k]);
+            const T er = (a.real() + c.real()) / 2, ei = (a.imag() - c.imag()) / 2,
+              dr = (a.real() - c.real()) / 2, di = (a.imag() + c.imag()) / 2;
+            // Fo(k) = conj(W^k) * (dr, di)
+            const std::complex<T>& w = pTwiddles[k];
+            const T or_ = w.real() * dr + w.imag() * di, oi = w.real() * di - w.imag() * dr;
+            pInput[k] = std::complex<T>(er - oi, ei + or_);
+          }
+        plan->transform(pInput, 1, pOutput, true);
+        for (int k=0; k<iCount; ++k)
+          {
+            pRow[2*k] = pOutput[k].real();
+            pRow[2*k+1] = pOutput[k].imag();
+          }
+      }
+  }
 
-  gem = _b[2].imag();
-  _b[2] = std::complex<T>(gem, -_b[2].real());
-  //_b[2].imag() = -_b[2].real();
-  //_b[2].real() = gem;
+  const PiiMatrix<std::complex<S> >& source;
+  const Plan* plan;
+  const Pii::BandRows<T> resultRows;
+  int iColumns;
+};
+
+template <class T> struct PiiFft<T>::ColumnTransform
+{
+  ColumnTransform(PiiMatrix<std::complex<T> >& matrix, const Plan* plan, bool inverse) :
+    plan(plan), inverse(inverse),
+    pData(matrix.row(0)), iStep(int(matrix.stride() / sizeof(std::complex<T>)))
+  {}
+
+  void operator() (int firstColumn, int columnCount)
+  {
+    const int iRows = plan->count();
+    QVector<std::complex<T> > vecBuffer(iRows);
+    std::complex<T>* pBuffer = vecBuffer.data();
+    for (int c=firstColumn; c<firstColumn+columnCount; ++c)
+      {
+        std::complex<T>* pColumn = pData + c;
+        plan->transform(pColumn, iStep, pBuffer, inverse);
+        for (int r=0; r<iRows; ++r)
+          pColumn[r * iStep] = pBuffer[r];
+      }
+  }
+
+  const Plan* plan;
+  bool inverse;
+  std::complex<T>* pData;
+  int iStep;
+};
+
+/// @endhide
+
+template <class T> QMutex PiiFft<T>::_planMutex;
+template <class T> QHash<int,typename PiiFft<T>::Plan*> PiiFft<T>::_hashPlans;
+template <class T> QList<int> PiiFft<T>::_lstPlanOrder;
+template <class T> int PiiFft<T>::_iMaxCachedPlans = 32;
+
+template <class T> PiiFft<T>::PiiFft()
+{
+}
 
-  gem = c8 * (_b[3].imag() - _b[3].real());
-  _b[3] = std::complex<T>(gem, -c8 * (_b[3].real() + _b[3].imag()));
-  //_b[3].imag() = -c8 * (_b[3].real() + _b[3].imag());
-  //_b[3].real() = gem;
+template <class T> PiiFft<T>::~PiiFft()
+{
+}
+
+template <class T> void PiiFft<T>::setMaxCachedPlans(int maxCachedPlans)
+{
+  QMutexLocker lock(&_planMutex);
+  _iMaxCachedPlans = qMax(0, maxCachedPlans);
+  while (_lstPlanOrder.size() > _iMaxCachedPlans)
+    _hashPlans.take(_lstPlanOrder.takeFirst())->release();
+}
+
+template <class T> int PiiFft<T>::maxCachedPlans()
+{
+  QMutexLocker lock(&_planMutex);
+  return _iMaxCachedPlans;
+}
 
-  z[0] = _a[0] + _b[0];
-  z[1] = _a[1] + _b[1];
-  z[2] = _a[2] + _b[2];
-  z[3] = _a[3] + _b[3];
+template <class T> typename PiiFft<T>::Plan* PiiFft<T>::plan(int count)
+{
+  {
+    QMutexLocker lock(&_planMutex);
+    Plan* pPlan = _hashPlans.value(count);
+    if (pPlan != 0)
+      {
+        // Move to the end of the LRU list.
+        _lstPlanOrder.removeOne(count);
+        _lstPlanOrder.append(count);
+        return pPlan->reserved();
+      }
+  }
+
+  // Don't block other threads while building the plan.
+  Plan* pNewPlan = new Plan(count);
+
+  QMutexLocker lock(&_planMutex);
+  if (_iMaxCachedPlans == 0)
+    return pNewPlan;
+  Plan* pPlan = _hashPlans.value(count);
+  if (pPlan != 0)
+    {
+      // Another thread was faster.
+      pNewPlan->release();
+      return pPlan->reserved();
+    }
+  if (_lstPlanOrder.size() >= _iMaxCachedPlans)
+    _hashPlans.take(_lstPlanOrder.takeFirst())->release();
+  _hashPlans.insert(count, pNewPlan);
+  _lstPlanOrder.append(count);
+  return pNewPlan->reserved();
+}
+
+template <class T> void PiiFft<T>::columnFft(const Pii::ParallelExecution& policy,
+                                             PiiMatrix<std::complex<T> >& matrix,
+                                             int columns, bool inverse)
+{
+  PlanRef plan(matrix.rows());
+  Pii::forEachBand(policy, columns, 0, ColumnTransform(matrix, plan, inverse));
+}
+
+template <class T>
+template <class S> PiiMatrix<std::complex<T> > PiiFft<T>::complexFft(const Pii::ParallelExecution& policy,
+                                                                     const PiiMatrix<S>& source,
+                                                                     bool inverse) const
+{
+  const int iRows = source.rows(), iColumns = source.columns();
+  if (iRows == 0 || iColumns == 0)
+    return PiiMatrix<std::complex<T> >(iRows, iColumns);
+
+  PiiMatrix<std::complex<T> > result(PiiMatrix<std::complex<T> >::uninitialized(iRows, iColumns));
+  complexRowFft(policy, source, result, inverse);
+  if (iRows > 1)
+    columnFft(policy, result, iColumns, inverse);
+
+  return result;
+}
+
+template <class T>
+template <class S> void PiiFft<T>::complexRowFft(const Pii::ParallelExecution& policy,
+                                                 const PiiMatrix<S>& source,
+                                                 PiiMatrix<std::complex<T> >& result,
+                                                 bool inverse) const
+{
+  const int iRows = source.rows(), iColumns = source.columns();
+  if (iColumns > 1)
+    {
+      PlanRef plan(iColumns);
+      Pii::forEachBand(policy, iRows, 0, RowTransform<S>(source, result, plan, inverse));
+    }
+  else
+    {
+      for (int r=0; r<iRows; ++r)
+        result(r,0) = std::complex<T>(source(r,0));
+    }
+}
+
+template <class T>
+template <class S> void PiiFft<T>::realRowFft(const PiiMatrix<S>& source,
+                                              PiiMatrix<std::complex<T> >& result,
+                                              const Pii::ParallelExecution& policy) const
+{
+  const int iColumns = source.columns();
+  if (iColumns > 1)
+    {
+      PlanRef plan(iColumns & 1 ? iColumns : iColumns / 2);
+      Pii::forEachBand(policy, source.rows(), 0, RealRowTransform<S>(source, result, plan));
+    }
+  else
+    {
+      for (int r=0; r<source.rows(); ++r)
+        result(r,0) = std::complex<T>(T(source(r,0)));
+    }
+}
 
-  z[4] = _a[0] - _b[0];
-  z[5] = _a[1] - _b[1];
-  z[6] = _a[2] - _b[2];
-  z[7] = _a[3] - _b[3];
+template <class T>
+template <class S> PiiMatrix<std::complex<T> > PiiFft<T>::forwardFft(const PiiMatrix<S>& source) const
+{
+  return forwardFft(Pii::ParallelExecution(1), source);
+}
 
+template <class T>
+template <class S> PiiMatrix<std::complex<T> > PiiFft<T>::forwardFft(const Pii::ParallelExecution& policy,
+                                                                     const PiiMatrix<S>& source) const
+{
+  return forwardFft(policy, source, Pii::IsComplex<S>());
 }
 
-template <class T> inline void PiiFft<T>::fft10(std::complex<T>* z)
+template <class T>
+template <class S> PiiMatrix<std::complex<T> > PiiFft<T>::forwardFft(const Pii::ParallelExecution& policy,
+                                                                     const PiiMatrix<S>& source,
+                                                                     Pii::True) const
 {
+  return complexFft(policy, source, false);
+}
 
-  _a[0] = z[0];
-  _a[1] = z[2];
-  _a[2] = z[4];
-  _a[3] = z[6];
-  _a[4] = z[8];
+template <class T>
+template <class S> PiiMatrix<std::complex<T> > PiiFft<T>::forwardFft(const Pii::ParallelExecution& policy,
+                                                                     const PiiMatrix<S>& source,
+                                                                     Pii::False) const
+{
+  const int iRows = source.rows(), iColumns = source.columns();
+  if (iRows == 0 || iColumns == 0)
+    return PiiMatrix<std::complex<T> >(iRows, iColumns);
+
+  // Only the left half needs to be transformed.
+  const int iHalf = iColumns / 2 + 1;
+  PiiMatrix<std::complex<T> > result(PiiMatrix<std::complex<T> >::uninitialized(iRows, iColumns));
+  realRowFft(source, result, policy);
+  if (iRows > 1)
+    columnFft(policy, result, iHalf, false);
+
+  // X(r,c) = X*(-r,-c)
+  for (int r=0; r<iRows; ++r)
+    {
+      std::complex<T>* pRow = result[r];
+      const std::complex<T>* pMirror = result[r == 0 ? 0 : iRows - r];
+      for (int c=iHalf; c<iColumns; ++c)
+        pRow[c] = std::conj(pMirror[iColumns - c]);
+    }
+  return result;
+}
 
-  _b[0] = z[5];
-  _b[1] = z[7];
-  _b[2] = z[9];
-  _b[3] = z[1];
-  _b[4] = z[3];
+template <class T>
+template <class S> PiiMatrix<std::complex<T> > PiiFft<T>::inverseFft(const PiiMatrix<std::complex<S> >& source) const
+{
+  return complexFft(Pii::ParallelExecution(1), source, true);
+}
 
-  fft5(_a);
-  fft5(_b);
+template <class T>
+template <class S> PiiMatrix<std::complex<T> > PiiFft<T>::inverseFft(const Pii::ParallelExecution& policy,
+                                                                     const PiiMatrix<std::complex<S> >& source) const
+{
+  return complexFft(policy, source, true);
+}
 
-  z[0] = _a[0] + _b[0];
-  z[6] = _a[1] + _b[1];
-  z[2] = _a[2] + _b[2];
-  z[8] = _a[3] + _b[3];
-  z[4] = _a[4] + _b[4];
-  z[5] = _a[0] - _b[0];
-  z[1] = _a[1] - _b[1];
-  z[7] = _a[2] - _b[2];
-  z[3] = _a[3] - _b[3];
-  z[9] = _a[4] - _b[4];
+template <class T>
+template <class S> PiiMatrix<std::complex<T> > PiiFft<T>::forwardRowFft(const Pii::ParallelExecution& policy,
+                                                                        const PiiMatrix<S>& source) const
+{
+  return forwardRowFft(policy, source, Pii::IsComplex<S>());
+}
 
+template <class T>
+template <class S> PiiMatrix<std::complex<T> > PiiFft<T>::forwardRowFft(const Pii::ParallelExecution& policy,
+                                                                        const PiiMatrix<S>& source,
+                                                                        Pii::True) const
+{
+  const int iRows = source.rows(), iColumns = source.columns();
+  PiiMatrix<std::complex<T> > result(PiiMatrix<std::complex<T> >::uninitialized(iRows, iColumns));
+  if (iRows != 0 && iColumns != 0)
+    complexRowFft(policy, source, result, false);
+  return result;
 }
 
-template <class T> bool PiiFft<T>::isPrimeFactor( int radix )
+template <class T>
+template <class S> PiiMatrix<std::complex<T> > PiiFft<T>::forwardRowFft(const Pii::ParallelExecution& policy,
+                                                                        const PiiMatrix<S>& source,
+                                                                        Pii::False) const
 {
-  switch(radix)
+  const int iRows = source.rows(), iColumns = source.columns();
+  if (iRows == 0 || iColumns == 0)
+    return PiiMatrix<std::complex<T> >(iRows, iColumns);
+
+  PiiMatrix<std::complex<T> > result(PiiMatrix<std::complex<T> >::uninitialized(iRows, iColumns));
+  realRowFft(source, result, policy);
+
+  // X(c) = X*(-c) on each row
+  const int iHalf = iColumns / 2 + 1;
+  for (int r=0; r<iRows; ++r)
     {
-    case 2:
-    case 3:
-    case 4:
-    case 5:
-    case 8:
-    case 10:
-      return false;
-      break;
-    default:
-      return true;
+      std::complex<T>* pRow = result[r];
+      for (int c=iHalf; c<iColumns; ++c)
+        pRow[c] = std::conj(pRow[iColumns - c]);
     }
+  return result;
 }
 
+template <class T>
+template <class S> PiiMatrix<std::complex<T> > PiiFft<T>::inverseRowFft(const Pii::ParallelExecution& policy,
+                                                                        const PiiMatrix<std::complex<S> >& source) const
+{
+  const int iRows = source.rows(), iColumns = source.columns();
+  PiiMatrix<std::complex<T> > result(PiiMatrix<std::complex<T> >::uninitialized(iRows, iColumns));
+  if (iRows != 0 && iColumns != 0)
+    complexRowFft(policy, source, result, true);
+  return result;
+}
+
+template <class T>
+template <class S> PiiMatrix<std::complex<T> > PiiFft<T>::forwardRealFft(const PiiMatrix<S>& source) const
+{
+  return forwardRealFft(Pii::ParallelExecution(1), source);
+}
+
+template <class T>
+template <class S> PiiMatrix<std::complex<T> > PiiFft<T>::forwardRealFft(const Pii::ParallelExecution& policy,
+                                                                         const PiiMatrix<S>& source) const
+{
+  const int iRows = source.rows(), iColumns = source.columns();
+  if (iRows == 0 || iColumns == 0)
+    return PiiMatrix<std::complex<T> >(iRows, 0);
+
+  const int iHalf = iColumns / 2 + 1;
+  // Odd rows are transformed in full.
+  PiiMatrix<std::complex<T> > result(PiiMatrix<std::complex<T> >::uninitialized(iRows, iColumns & 1 ? iColumns : iHalf));
+  realRowFft(source, result, policy);
+  if (iRows > 1)
+    columnFft(policy, result, iHalf, false);
+  if (result.columns() != iHalf)
+    result.resize(iRows, iHalf);
+  return result;
+}
+
+template <class T>
+template <class S> PiiMatrix<T> PiiFft<T>::inverseRealFft(const PiiMatrix<std::complex<S> >& source, int columns) const
+{
+  return inverseRealFft(Pii::ParallelExecution(1), source, columns);
+}
+
+template <class T>
+template <class S> PiiMatrix<T> PiiFft<T>::inverseRealFft(const Pii::ParallelExecution& policy,
+                                                          const PiiMatrix<std::complex<S> >& source,
+                                                          int columns) const
+{
+  const int iRows = source.rows();
+  if (iRows == 0 || columns <= 0)
+    return PiiMatrix<T>(iRows, qMax(columns, 0));
+  if (source.columns() != columns / 2 + 1)
+    PII_MATRIX_SIZE_MISMATCH;
+
+  PiiMatrix<std::complex<T> > matHalf(PiiMatrix<std::complex<T> >::uninitialized(iRows, source.columns()));
+  for (int r=0; r<iRows; ++r)
+    {
+      const std::complex<S>* pSource = source[r];
+      std::complex<T>* pTarget = matHalf[r];
+      for (int c=0; c<source.columns(); ++c)
+        pTarget[c] = std::complex<T>(pSource[c]);
+    }
+  if (iRows > 1)
+    columnFft(policy, matHalf, matHalf.columns(), true);
+
+  PiiMatrix<T> result(PiiMatrix<T>::uninitialized(iRows, columns));
+  if (columns > 1)
+    {
+      const PiiMatrix<std::complex<T> >& matConstHalf = matHalf;
+      PlanRef plan(columns & 1 ? columns : columns / 2);
+      Pii::forEachBand(policy, iRows, 0, RealInverseRowTransform<T>(matConstHalf, result, plan));
+    }
+  else
+    {
+      for (int r=0; r<iRows; ++r)
+        result(r,0) = matHalf(r,0).real();
+    }
+  return result;
+}
 
 #endif //_PIIFFT_TEMPLATES_H
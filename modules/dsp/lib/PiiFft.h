@@ -19,14 +19,130 @@
 #include <PiiMatrix.h>
 #include <PiiFunctional.h>
 #include <PiiMatrixValue.h>
+#include <PiiParallel.h>
+#include <PiiSharedD.h>
+#include <PiiTypeTraits.h>
+#include <QHash>
+#include <QList>
+#include <QMutex>
+#include <QVector>
 #include <complex>
+#include "PiiDspGlobal.h"
+
+namespace PiiDsp
+{
+  /**
+   * Performs *count* radix-2 FFT butterflies. Before the butterfly,
+   * each element of *x1* is multiplied by the corresponding twiddle
+   * factor. The results are written in place:
+   *
+   * \[
+   * x_0 \leftarrow x_0 + w x_1, \quad x_1 \leftarrow x_0 - w x_1
+   * \]
+   *
+   * This is the innermost loop of radix-2 stages in PiiFft. The
+   * generic template is used for all types. There are non-template
+   * overloads for `float` and `double` that use SSE2/AVX2
+   * instructions if the CPU running the code supports them.
+   */
+  template <class T> inline void fftButterfly2(std::complex<T>* x0, std::complex<T>* x1,
+                                               const std::complex<T>* twiddles, int count)
+  {
+    // Explicit arithmetic avoids the NaN checks of std::complex
+    // multiplication.
+    for (int i=0; i<count; ++i)
+      {
+        const T tr = x1[i].real() * twiddles[i].real() - x1[i].imag() * twiddles[i].imag(),
+          ti = x1[i].real() * twiddles[i].imag() + x1[i].imag() * twiddles[i].real(),
+          ar = x0[i].real(), ai = x0[i].imag();
+        x0[i] = std::complex<T>(ar + tr, ai + ti);
+        x1[i] = std::complex<T>(ar - tr, ai - ti);
+      }
+  }
+
+  /**
+   * Performs *count* radix-4 FFT butterflies. Before the butterfly,
+   * *x1*, *x2* and *x3* are multiplied by *twiddles1*, *twiddles2*
+   * and *twiddles3*, respectively. There are vectorized overloads for
+   * `float` and `double`. See [fftButterfly2()].
+   */
+  template <class T> inline void fftButterfly4(std::complex<T>* x0, std::complex<T>* x1,
+                                               std::complex<T>* x2, std::complex<T>* x3,
+                                               const std::complex<T>* twiddles1,
+                                               const std::complex<T>* twiddles2,
+                                               const std::complex<T>* twiddles3,
+                                               int count)
+  {
+    for (int i=0; i<count; ++i)
+      {
+        const T z0r = x0[i].real(), z0i = x0[i].imag(),
+          z1r = x1[i].real() * twiddles1[i].real() - x1[i].imag() * twiddles1[i].imag(),
+          z1i = x1[i].real() * twiddles1[i].imag() + x1[i].imag() * twiddles1[i].real(),
+          z2r = x2[i].real() * twiddles2[i].real() - x2[i].imag() * twiddles2[i].imag(),
+          z2i = x2[i].real() * twiddles2[i].imag() + x2[i].imag() * twiddles2[i].real(),
+          z3r = x3[i].real() * twiddles3[i].real() - x3[i].imag() * twiddles3[i].imag(),
+          z3i = x3[i].real() * twiddles3[i].imag() + x3[i].imag() * twiddles3[i].real();
+        const T t1r = z0r + z2r, t1i = z0i + z2i,
+          t2r = z1r + z3r, t2i = z1i + z3i,
+          m2r = z0r - z2r, m2i = z0i - z2i,
+          // -i * (z1 - z3)
+          m3r = z1i - z3i, m3i = z3r - z1r;
+        x0[i] = std::complex<T>(t1r + t2r, t1i + t2i);
+        x1[i] = std::complex<T>(m2r + m3r, m2i + m3i);
+        x2[i] = std::complex<T>(t1r - t2r, t1i - t2i);
+        x3[i] = std::complex<T>(m2r - m3r, m2i - m3i);
+      }
+  }
+
+  /// @hide
+  PII_DSP_EXPORT void fftButterfly2(std::complex<float>* x0, std::complex<float>* x1,
+                                    const std::complex<float>* twiddles, int count);
+  PII_DSP_EXPORT void fftButterfly2(std::complex<double>* x0, std::complex<double>* x1,
+                                    const std::complex<double>* twiddles, int count);
+  PII_DSP_EXPORT void fftButterfly4(std::complex<float>* x0, std::complex<float>* x1,
+                                    std::complex<float>* x2, std::complex<float>* x3,
+                                    const std::complex<float>* twiddles1,
+                                    const std::complex<float>* twiddles2,
+                                    const std::complex<float>* twiddles3,
+                                    int count);
+  PII_DSP_EXPORT void fftButterfly4(std::complex<double>* x0, std::complex<double>* x1,
+                                    std::complex<double>* x2, std::complex<double>* x3,
+                                    const std::complex<double>* twiddles1,
+                                    const std::complex<double>* twiddles2,
+                                    const std::complex<double>* twiddles3,
+                                    int count);
+  /// @endhide
+}
 
 /**
  * A class for performing forward and inverse FFT for 1D and 2D
  * signals. The calculation is optimized by splitting the input into
  * pieces for which an optimized radix-N implementation exists. The
- * class has implementations for radix 2, 3, 4, 5, 8, and 10.
+ * class has implementations for radix 2, 3, 4, 5 and 10. Other prime
+ * factors are handled with a generic (slow) algorithm. The radix-2
+ * and radix-4 stages are vectorized for `float` and `double`.
+ *
+ * The factorization and the twiddle factors of a transform length
+ * form a *plan*. Plans are immutable and shared between all PiiFft
+ * instances through a thread-safe cache, which means that repeated
+ * transforms of the same size pay the initialization cost only once.
+ * PiiFft itself has no state, and a single instance can be used by
+ * many threads simultaneously.
+ *
+ * Real-valued input is transformed as a complex signal of half the
+ * length. [forwardFft()] uses this automatically for real matrices
+ * and fills in the other half of the spectrum using its Hermitian
+ * symmetry. [forwardRealFft()] and [inverseRealFft()] work with the
+ * non-redundant half only.
  *
+ * All transforms have overloads that take a Pii::ParallelExecution
+ * policy as the first argument. These process the rows and columns
+ * of 2D transforms in parallel.
+ *
+ * ~~~(c++)
+ * PiiFft<float> fft;
+ * PiiMatrix<std::complex<float> > matSpectrum(fft.forwardFft(Pii::ParallelExecution(), image));
+ * ~~~
  */
 template <class T> class PiiFft
 {
@@ -37,38 +153,126 @@ public:
   /**
    * Perform a forward Fourier transform.
    */
-  template <class S> PiiMatrix<std::complex<T> > forwardFft(const PiiMatrix<S>& source);
+  template <class S> PiiMatrix<std::complex<T> > forwardFft(const PiiMatrix<S>& source) const;
+  /**
+   * Perform a forward Fourier transform in parallel.
+   */
+  template <class S> PiiMatrix<std::complex<T> > forwardFft(const Pii::ParallelExecution& policy,
+                                                            const PiiMatrix<S>& source) const;
   /**
    * Perform an inverse Fourier transform.
    */
-  template <class S> PiiMatrix<std::complex<T> > inverseFft(const PiiMatrix<std::complex<S> >& source);
+  template <class S> PiiMatrix<std::complex<T> > inverseFft(const PiiMatrix<std::complex<S> >& source) const;
+  /**
+   * Perform an inverse Fourier transform in parallel.
+   */
+  template <class S> PiiMatrix<std::complex<T> > inverseFft(const Pii::ParallelExecution& policy,
+                                                            const PiiMatrix<std::complex<S> >& source) const;
+
+  /**
+   * Perform a forward Fourier transform on each row of *source*
+   * independently. The result is the same as transforming each row
+   * as a separate signal, but all rows share the same plan and are
+   * transformed in parallel.
+   *
+   * ~~~(c++)
+   * // One profile on each row
+   * PiiMatrix<std::complex<float> > matSpectra(fft.forwardRowFft(Pii::ParallelExecution(), matProfiles));
+   * ~~~
+   */
+  template <class S> PiiMatrix<std::complex<T> > forwardRowFft(const Pii::ParallelExecution& policy,
+                                                               const PiiMatrix<S>& source) const;
+  /**
+   * Perform an inverse Fourier transform on each row of *source*
+   * independently.
+   */
+  template <class S> PiiMatrix<std::complex<T> > inverseRowFft(const Pii::ParallelExecution& policy,
+                                                               const PiiMatrix<std::complex<S> >& source) const;
+
+  /**
+   * Perform a forward Fourier transform of real-valued input. Since
+   * the spectrum of a real signal is Hermitian symmetric, only the
+   * first `source.columns()/2 + 1` columns of it are returned.
+   * Calculating the transform this way takes about half the time of
+   * [forwardFft()].
+   */
+  template <class S> PiiMatrix<std::complex<T> > forwardRealFft(const PiiMatrix<S>& source) const;
+  /**
+   * Perform a forward real-valued Fourier transform in parallel.
+   */
+  template <class S> PiiMatrix<std::complex<T> > forwardRealFft(const Pii::ParallelExecution& policy,
+                                                                const PiiMatrix<S>& source) const;
+
+  /**
+   * Perform an inverse Fourier transform whose result is known to
+   * be real. *source* is the non-redundant half of a Hermitian
+   * symmetric spectrum, as returned by [forwardRealFft()].
+   *
+   * @param columns the number of columns in the result. Since the
+   * spectra of signals with *2n* and *2n+1* columns have the same
+   * size, this value cannot be deduced from *source*.
+   *
+   * @exception PiiInvalidArgumentException& if *source* does not have
+   * `columns/2 + 1` columns.
+   */
+  template <class S> PiiMatrix<T> inverseRealFft(const PiiMatrix<std::complex<S> >& source, int columns) const;
+  /**
+   * Perform an inverse real-valued Fourier transform in parallel.
+   */
+  template <class S> PiiMatrix<T> inverseRealFft(const Pii::ParallelExecution& policy,
+                                                 const PiiMatrix<std::complex<S> >& source,
+                                                 int columns) const;
+
+  /**
+   * Sets the maximum number of cached plans. If there are more
+   * different transform lengths in use, the least recently used
+   * plans will be rebuilt when needed. Zero disables caching. The
+   * default is 32. The cache is shared by all PiiFft instances with
+   * the same value type.
+   */
+  static void setMaxCachedPlans(int maxCachedPlans);
+  /**
+   * Returns the maximum number of cached plans.
+   */
+  static int maxCachedPlans();
 
 private:
-  template <class S> bool forward1d(const S* source, std::complex<T>* destination, int count);
-  template <class S> bool inverse1d(const std::complex<S>* source, std::complex<T>* destination, int count);
-
-  void factorize(int count);
-  template <class S> void reorderSeries(const S* source, std::complex<T>* dest);
-  void initializeTrigonomials(int radix);
-
-  inline void fftPrime(int radix);
-  inline void fft2(std::complex<T>* z);
-  inline void fft3(std::complex<T>* z);
-  inline void fft4(std::complex<T>* z);
-  inline void fft5(std::complex<T>* z);
-  inline void fft8(std::complex<T>* z);
-  inline void fft10(std::complex<T>* z);
-  void synthesizeFft(int sofar, int radix, int remain, std::complex<T>* dest);
-  bool isPrimeFactor(int radix);
-  void reallocateBuffers(int len);
-
-  std::complex<T> _a[5], _b[5];
-  std::complex<T> *_trig, *_twiddle, *_z;
-  int _sofarRadix[20], _actualRadix[20], _remainRadix[20];
-  int _count, _factorCount, _prevPrimeRadix;
-
-  T _pi, c3_1, c3_2, u5, c5_1, c5_2, c5_3, c5_4, c5_5, c8;
-  PiiMatrix<std::complex<T> > _tempSource, _tempResult;
+  class Plan;
+  class PlanRef;
+  template <class S> struct RowTransform;
+  template <class S> struct RealRowTransform;
+  template <class S> struct RealInverseRowTransform;
+  struct ColumnTransform;
+
+  static Plan* plan(int count);
+  template <class S> PiiMatrix<std::complex<T> > complexFft(const Pii::ParallelExecution& policy,
+                                                            const PiiMatrix<S>& source,
+                                                            bool inverse) const;
+  template <class S> void complexRowFft(const Pii::ParallelExecution& policy,
+                                        const PiiMatrix<S>& source,
+                                        PiiMatrix<std::complex<T> >& result,
+                                        bool inverse) const;
+  template <class S> PiiMatrix<std::complex<T> > forwardRowFft(const Pii::ParallelExecution& policy,
+                                                               const PiiMatrix<S>& source,
+                                                               Pii::False) const;
+  template <class S> PiiMatrix<std::complex<T> > forwardRowFft(const Pii::ParallelExecution& policy,
+                                                               const PiiMatrix<S>& source,
+                                                               Pii::True) const;
+  template <class S> PiiMatrix<std::complex<T> > forwardFft(const Pii::ParallelExecution& policy,
+                                                            const PiiMatrix<S>& source,
+                                                            Pii::False) const;
+  template <class S> PiiMatrix<std::complex<T> > forwardFft(const Pii::ParallelExecution& policy,
+                                                            const PiiMatrix<S>& source,
+                                                            Pii::True) const;
+  template <class S> void realRowFft(const PiiMatrix<S>& source, PiiMatrix<std::complex<T> >& result,
+                                     const Pii::ParallelExecution& policy) const;
+  static void columnFft(const Pii::ParallelExecution& policy, PiiMatrix<std::complex<T> >& matrix,
+                        int columns, bool inverse);
+
+  static QMutex _planMutex;
+  static QHash<int,Plan*> _hashPlans;
+  static QList<int> _lstPlanOrder;
+  static int _iMaxCachedPlans;
 };
 
 #include "PiiFft-templates.h"
@@ -76,15 +280,29 @@ private:
 
 namespace PiiDsp
 {
-  /// @internal Takes the real part of a complex number
-  template <class T> struct FastCorrelationConverter
+  /// @internal Correlates real signals using real-valued transforms
+  template <class T> struct FastCorrelation
   {
-    static PiiMatrix<T> apply(const PiiMatrix<std::complex<T> >& matrix) { return Pii::matrix(Pii::real(matrix)); }
+    static PiiMatrix<T> apply(const PiiMatrix<T>& a, const PiiMatrix<T>& b)
+    {
+      // Half spectra may match even if the signals don't.
+      PII_MATRIX_CHECK_EQUAL_SIZE(a, b);
+      PiiFft<T> fft;
+      return fft.inverseRealFft(Pii::matrix(Pii::multiplied(fft.forwardRealFft(a),
+                                                            Pii::conj(fft.forwardRealFft(b)))),
+                                a.columns());
+    }
   };
-  /// @internal Returns the complex number itself
-  template <class T> struct FastCorrelationConverter<std::complex<T> >
+  /// @internal Correlates complex signals
+  template <class T> struct FastCorrelation<std::complex<T> >
   {
-    static PiiMatrix<std::complex<T> > apply(const PiiMatrix<std::complex<T> >& matrix) { return matrix; }
+    static PiiMatrix<std::complex<T> > apply(const PiiMatrix<std::complex<T> >& a,
+                                             const PiiMatrix<std::complex<T> >& b)
+    {
+      PiiFft<T> fft;
+      return fft.inverseFft(Pii::matrix(Pii::multiplied(fft.forwardFft(a),
+                                                        Pii::conj(fft.forwardFft(b)))));
+    }
   };
 
   /**
@@ -96,9 +314,10 @@ namespace PiiDsp
    * \]
    *
    * where *F* stands for the Fourier transform, and "*" marks complex
-   * conjugation. The input matrices must be equal in size.
+   * conjugation. The input matrices must be equal in size. Real
+   * signals are transformed with PiiFft::forwardRealFft().
    *
-   * @exception PiiMathException& if input matrices are different in
+   * @exception PiiInvalidArgumentException& if input matrices are different in
    * size
    *
    * @relates PiiFft
@@ -107,9 +326,7 @@ namespace PiiDsp
                                                          const PiiMatrix<T>& b)
 
   {
-    PiiFft<T> fft;
-    return FastCorrelationConverter<T>::apply(fft.inverseFft(Pii::matrix(Pii::multiplied(fft.forwardFft(a),
-                                                                                         Pii::conj(fft.forwardFft(b))))));
+    return FastCorrelation<T>::apply(a, b);
   }
 
   template <class T> PiiMatrixValue<T> findTranslation(const PiiMatrix<T>& correlation)
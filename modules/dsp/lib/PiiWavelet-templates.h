@@ -55,6 +55,372 @@ namespace PiiDsp
     return result;
   }
 
+  /// @hide
+  // Periodic one-dimensional wavelet transforms applied to many
+  // signals at once. Each level is calculated in strips of Lanes
+  // rows or columns that are first gathered into a work buffer so
+  // that sample i of signal j is at work[i*lanes + j]. The innermost
+  // loops then run over contiguous memory in both directions.
+  template <class T> class InPlaceDwt
+  {
+  public:
+    InPlaceDwt(WaveletFamily wavelet, int familyMember);
+
+    int forward(PiiMatrix<T>& mat, int levels);
+    void inverse(PiiMatrix<T>& mat, int levels);
+
+  private:
+    enum Scheme { HaarLifting, Daubechies2Lifting, FilterBank };
+    enum { Lanes = 16 };
+
+    int levelSizes(const PiiMatrix<T>& mat, int levels, QVector<int>* sizes) const;
+    void transformLevel(T* data, std::size_t stride, int rows, int columns, bool inverse);
+    // If fixedLanes is non-zero, it overrides lanes. This lets the
+    // compiler vectorize the loops over full strips.
+    template <int fixedLanes> void forwardPass(int count, int lanes, T* target,
+                                               std::size_t sampleStride, std::size_t laneStride);
+    template <int fixedLanes> void inversePass(int count, int lanes, T* target,
+                                               std::size_t sampleStride, std::size_t laneStride);
+    template <int fixedLanes> void scatter(int count, int lanes, T* target,
+                                           std::size_t sampleStride, std::size_t laneStride);
+    void pass(bool inverse, int count, int lanes, T* target, std::size_t sampleStride, std::size_t laneStride);
+
+    // Lifting constants for the four-tap Daubechies wavelet.
+    static const double Sqrt3, Update1, Update2, ScaleLo, ScaleHi;
+
+    Scheme _scheme;
+    PiiMatrix<T> _matLo, _matHi;
+    QVector<T> _vecWork;
+  };
+
+  template <class T> const double InPlaceDwt<T>::Sqrt3 = 1.73205080756887729353;
+  // sqrt(3)/4 and (sqrt(3)-2)/4
+  template <class T> const double InPlaceDwt<T>::Update1 = 0.43301270189221932338;
+  template <class T> const double InPlaceDwt<T>::Update2 = -0.06698729810778067662;
+  // (sqrt(3)+1)/sqrt(2) and (sqrt(3)-1)/sqrt(2)
+  template <class T> const double InPlaceDwt<T>::ScaleLo = 1.93185165257813657349;
+  template <class T> const double InPlaceDwt<T>::ScaleHi = 0.51763809020504152470;
+
+  template <class T> InPlaceDwt<T>::InPlaceDwt(WaveletFamily wavelet, int familyMember) :
+    _scheme(FilterBank)
+  {
+    PiiMatrix<double> matScaling(scalingFilter(wavelet, familyMember));
+    if (matScaling.columns() == 2)
+      _scheme = HaarLifting;
+    else if (matScaling.columns() == 4)
+      _scheme = Daubechies2Lifting;
+    else
+      {
+        QList<PiiMatrix<double> > lstFilters(createScalingWavelets(matScaling));
+        _matLo = PiiMatrix<T>(lstFilters[0]);
+        _matHi = PiiMatrix<T>(lstFilters[1]);
+      }
+  }
+
+  template <class T> int InPlaceDwt<T>::levelSizes(const PiiMatrix<T>& mat, int levels, QVector<int>* sizes) const
+  {
+    int iRows = mat.rows(), iColumns = mat.columns(), iLevels = 0;
+    for (; iLevels < levels; ++iLevels)
+      {
+        // Odd rows and columns are left out.
+        iRows &= ~1;
+        iColumns &= ~1;
+        if (iRows < 2 || iColumns < 2)
+          break;
+        *sizes << iRows << iColumns;
+        iRows >>= 1;
+        iColumns >>= 1;
+      }
+    return iLevels;
+  }
+
+  template <class T> int InPlaceDwt<T>::forward(PiiMatrix<T>& mat, int levels)
+  {
+    QVector<int> vecSizes;
+    const int iLevels = levelSizes(mat, levels, &vecSizes);
+    if (iLevels == 0)
+      return 0;
+    _vecWork.resize(2 * qMax(vecSizes[0], vecSizes[1]) * Lanes);
+    T* pData = mat.row(0);
+    for (int i=0; i<iLevels; ++i)
+      transformLevel(pData, mat.stride() / sizeof(T), vecSizes[2*i], vecSizes[2*i+1], false);
+    return iLevels;
+  }
+
+  template <class T> void InPlaceDwt<T>::inverse(PiiMatrix<T>& mat, int levels)
+  {
+    QVector<int> vecSizes;
+    const int iLevels = levelSizes(mat, levels, &vecSizes);
+    if (iLevels == 0)
+      return;
+    _vecWork.resize(2 * qMax(vecSizes[0], vecSizes[1]) * Lanes);
+    T* pData = mat.row(0);
+    for (int i=iLevels; i--; )
+      transformLevel(pData, mat.stride() / sizeof(T), vecSizes[2*i], vecSizes[2*i+1], true);
+  }
+
+  template <class T> void InPlaceDwt<T>::transformLevel(T* data, std::size_t stride, int rows, int columns, bool inverse)
+  {
+    T* pWork = _vecWork.data();
+    // Columns are transformed first in the forward direction and
+    // last in the inverse.
+    for (int iPass=0; iPass<2; ++iPass)
+      {
+        if ((iPass == 0) == inverse)
+          {
+            // Columns, Lanes at a time
+            for (int c=0; c<columns; c += Lanes)
+              {
+                const int iLanes = qMin(int(Lanes), columns - c);
+                for (int r=0; r<rows; ++r)
+                  {
+                    const T* pSource = data + r*stride + c;
+                    for (int j=0; j<iLanes; ++j)
+                      pWork[r*iLanes + j] = pSource[j];
+                  }
+                pass(inverse, rows, iLanes, data + c, stride, 1);
+              }
+          }
+        else
+          {
+            // Rows, transposed to the work buffer
+            for (int r=0; r<rows; r += Lanes)
+              {
+                const int iLanes = qMin(int(Lanes), rows - r);
+                for (int j=0; j<iLanes; ++j)
+                  {
+                    const T* pSource = data + (r+j)*stride;
+                    for (int c=0; c<columns; ++c)
+                      pWork[c*iLanes + j] = pSource[c];
+                  }
+                pass(inverse, columns, iLanes, data + r*stride, 1, stride);
+              }
+          }
+      }
+  }
+
+  template <class T> void InPlaceDwt<T>::pass(bool inverse, int count, int lanes, T* target,
+                                            std::size_t sampleStride, std::size_t laneStride)
+  {
+    if (inverse)
+      {
+        if (lanes == Lanes)
+          inversePass<Lanes>(count, lanes, target, sampleStride, laneStride);
+        else
+          inversePass<0>(count, lanes, target, sampleStride, laneStride);
+      }
+    else
+      {
+        if (lanes == Lanes)
+          forwardPass<Lanes>(count, lanes, target, sampleStride, laneStride);
+        else
+          forwardPass<0>(count, lanes, target, sampleStride, laneStride);
+      }
+  }
+
+  template <class T> template <int fixedLanes>
+  void InPlaceDwt<T>::scatter(int count, int lanes, T* target,
+                              std::size_t sampleStride, std::size_t laneStride)
+  {
+    if (fixedLanes != 0)
+      lanes = fixedLanes;
+    const T* pResult = _vecWork.constData() + count*lanes;
+    if (laneStride == 1)
+      {
+        for (int i=0; i<count; ++i, target += sampleStride, pResult += lanes)
+          for (int j=0; j<lanes; ++j)
+            target[j] = pResult[j];
+      }
+    else
+      {
+        for (int j=0; j<lanes; ++j, target += laneStride)
+          for (int i=0; i<count; ++i)
+            target[i*sampleStride] = pResult[i*lanes + j];
+      }
+  }
+
+  // Even and odd samples of signal j at index k, and the results.
+#define PII_DWT_EVEN(k) pWork[2*(k)*lanes + j]
+#define PII_DWT_ODD(k) pWork[(2*(k)+1)*lanes + j]
+#define PII_DWT_RESULT(i) pResult[(i)*lanes + j]
+
+  template <class T> template <int fixedLanes>
+  void InPlaceDwt<T>::forwardPass(int count, int lanes, T* target,
+                                  std::size_t sampleStride, std::size_t laneStride)
+  {
+    if (fixedLanes != 0)
+      lanes = fixedLanes;
+    const int iHalf = count >> 1;
+    T *pWork = _vecWork.data(), *pResult = pWork + count*lanes;
+    switch (_scheme)
+      {
+      case HaarLifting:
+        {
+          const T r = T(0.70710678118654752440);
+          for (int k=0; k<iHalf; ++k)
+            for (int j=0; j<lanes; ++j)
+              {
+                const T even = PII_DWT_EVEN(k), odd = PII_DWT_ODD(k);
+                PII_DWT_RESULT(k) = (even + odd) * r;
+                PII_DWT_RESULT(iHalf + k) = (even - odd) * r;
+              }
+        }
+        break;
+      case Daubechies2Lifting:
+        {
+          // Daubechies & Sweldens factorization of the four-tap
+          // filter. The indices are shifted to match the alignment of
+          // dwt().
+          for (int k=0; k<iHalf; ++k)
+            for (int j=0; j<lanes; ++j)
+              PII_DWT_ODD(k) -= T(Sqrt3) * PII_DWT_EVEN(k);
+          for (int k=0; k<iHalf; ++k)
+            {
+              const int iNext = k+1 < iHalf ? k+1 : 0;
+              for (int j=0; j<lanes; ++j)
+                PII_DWT_EVEN(k) += T(Update1) * PII_DWT_ODD(k) + T(Update2) * PII_DWT_ODD(iNext);
+            }
+          for (int k=0; k<iHalf; ++k)
+            {
+              const int iPrevious = k > 0 ? k-1 : iHalf-1;
+              for (int j=0; j<lanes; ++j)
+                {
+                  PII_DWT_RESULT(iHalf + k) = -T(ScaleHi) * (PII_DWT_ODD(k) + PII_DWT_EVEN(iPrevious));
+                  PII_DWT_RESULT(k) = T(ScaleLo) * PII_DWT_EVEN(iPrevious);
+                }
+            }
+        }
+        break;
+      case FilterBank:
+        {
+          // Output k is the convolution at 2k+1, wrapped around.
+          const T *pLo = _matLo[0], *pHi = _matHi[0];
+          const int iTaps = _matLo.columns();
+          T aLo[Lanes], aHi[Lanes];
+          for (int k=0; k<iHalf; ++k)
+            {
+              for (int j=0; j<lanes; ++j)
+                aLo[j] = aHi[j] = 0;
+              for (int n=0; n<iTaps; ++n)
+                {
+                  const int i = ((2*k + 1 - n) % count + count) % count;
+                  const T* pSample = pWork + i*lanes;
+                  const T lo = pLo[n], hi = pHi[n];
+                  for (int j=0; j<lanes; ++j)
+                    {
+                      aLo[j] += lo * pSample[j];
+                      aHi[j] += hi * pSample[j];
+                    }
+                }
+              for (int j=0; j<lanes; ++j)
+                {
+                  PII_DWT_RESULT(k) = aLo[j];
+                  PII_DWT_RESULT(iHalf + k) = aHi[j];
+                }
+            }
+        }
+        break;
+      }
+    scatter<fixedLanes>(count, lanes, target, sampleStride, laneStride);
+  }
+
+  template <class T> template <int fixedLanes>
+  void InPlaceDwt<T>::inversePass(int count, int lanes, T* target,
+                                  std::size_t sampleStride, std::size_t laneStride)
+  {
+    if (fixedLanes != 0)
+      lanes = fixedLanes;
+    const int iHalf = count >> 1;
+    // Coefficients are read from the beginning of the work buffer and
+    // the signal reconstructed after them.
+    T *pCoeffs = _vecWork.data(), *pResult = pCoeffs + count*lanes, *pWork = pResult;
+#define PII_DWT_LO(k) pCoeffs[(k)*lanes + j]
+#define PII_DWT_HI(k) pCoeffs[(iHalf + (k))*lanes + j]
+    switch (_scheme)
+      {
+      case HaarLifting:
+        {
+          const T r = T(0.70710678118654752440);
+          for (int k=0; k<iHalf; ++k)
+            for (int j=0; j<lanes; ++j)
+              {
+                const T lo = PII_DWT_LO(k), hi = PII_DWT_HI(k);
+                PII_DWT_EVEN(k) = (lo + hi) * r;
+                PII_DWT_ODD(k) = (lo - hi) * r;
+              }
+        }
+        break;
+      case Daubechies2Lifting:
+        {
+          // The scales are inverses of each other.
+          for (int k=0; k<iHalf; ++k)
+            {
+              const int iNext = k+1 < iHalf ? k+1 : 0;
+              for (int j=0; j<lanes; ++j)
+                PII_DWT_EVEN(k) = T(ScaleHi) * PII_DWT_LO(iNext);
+            }
+          for (int k=0; k<iHalf; ++k)
+            {
+              const int iPrevious = k > 0 ? k-1 : iHalf-1;
+              for (int j=0; j<lanes; ++j)
+                PII_DWT_ODD(k) = -T(ScaleLo) * PII_DWT_HI(k) - PII_DWT_EVEN(iPrevious);
+            }
+          for (int k=0; k<iHalf; ++k)
+            {
+              const int iNext = k+1 < iHalf ? k+1 : 0;
+              for (int j=0; j<lanes; ++j)
+                PII_DWT_EVEN(k) -= T(Update1) * PII_DWT_ODD(k) + T(Update2) * PII_DWT_ODD(iNext);
+            }
+          for (int k=0; k<iHalf; ++k)
+            for (int j=0; j<lanes; ++j)
+              PII_DWT_ODD(k) += T(Sqrt3) * PII_DWT_EVEN(k);
+        }
+        break;
+      case FilterBank:
+        {
+          // The synthesis is the transpose of the analysis.
+          const T *pLo = _matLo[0], *pHi = _matHi[0];
+          const int iTaps = _matLo.columns();
+          for (int i=0; i<count*lanes; ++i)
+            pResult[i] = 0;
+          for (int k=0; k<iHalf; ++k)
+            for (int n=0; n<iTaps; ++n)
+              {
+                const int i = ((2*k + 1 - n) % count + count) % count;
+                T* pSample = pResult + i*lanes;
+                const T lo = pLo[n], hi = pHi[n];
+                for (int j=0; j<lanes; ++j)
+                  pSample[j] += lo * PII_DWT_LO(k) + hi * PII_DWT_HI(k);
+              }
+        }
+        break;
+      }
+    scatter<fixedLanes>(count, lanes, target, sampleStride, laneStride);
+#undef PII_DWT_LO
+#undef PII_DWT_HI
+  }
+
+#undef PII_DWT_EVEN
+#undef PII_DWT_ODD
+#undef PII_DWT_RESULT
+  /// @endhide
+
+  template <class T> int dwtInPlace(PiiMatrix<T>& mat,
+                                    int levels,
+                                    WaveletFamily wavelet,
+                                    int familyMember)
+  {
+    return InPlaceDwt<T>(wavelet, familyMember).forward(mat, levels);
+  }
+
+  template <class T> void inverseDwtInPlace(PiiMatrix<T>& mat,
+                                            int levels,
+                                            WaveletFamily wavelet,
+                                            int familyMember)
+  {
+    InPlaceDwt<T>(wavelet, familyMember).inverse(mat, levels);
+  }
+
   template <class T> PiiMatrix<T> quadratureMirror(const PiiMatrix<T>& filter, int odd)
   {
     PiiMatrix<T> result(Pii::flipped(filter, Pii::Horizontally));
@@ -18,6 +18,7 @@
 
 #include <PiiMath.h>
 #include <QList>
+#include <QVector>
 #include "PiiDspGlobal.h"
 
 namespace PiiDsp
@@ -137,6 +138,65 @@ namespace PiiDsp
                                              Pii::MatrixDirections directions,
                                              int odd = 0);
 
+  /**
+   * Performs a multi-level two-dimensional discrete wavelet transform
+   * in place. Unlike [dwt()], this function extends the input
+   * periodically, which makes the number of coefficients equal to
+   * the number of input elements. No temporary matrices are
+   * allocated; the only extra memory is a small work buffer.
+   *
+   * The result is stored in the Mallat layout. The first level
+   * transforms the whole matrix. The approximation coefficients are
+   * stored in the top left quarter, the vertical details (vertical
+   * low-pass, horizontal high-pass) in the top right quarter, the
+   * horizontal details in the bottom left quarter and the diagonal
+   * details in the bottom right quarter. Each subsequent level
+   * transforms the approximation of the previous level in the same
+   * way. If the number of rows or columns on a level is odd, the
+   * last row or column is not transformed but retained as such. The
+   * detail bands of the first level are thus `mat.rows()/2` by
+   * `mat.columns()/2` in size.
+   *
+   * The Haar wavelet and the four-tap Daubechies wavelet are
+   * calculated with the lifting scheme. Other wavelets use a
+   * periodic filter bank.
+   *
+   * ~~~(c++)
+   * PiiMatrix<float> mat(image);
+   * PiiDsp::dwtInPlace(mat, 3, PiiDsp::Daubechies, 2);
+   * // Diagonal details on the second level
+   * int iRows = mat.rows() / 4, iColumns = mat.columns() / 4;
+   * PiiMatrix<float> matDiagonal(mat(iRows, iColumns, iRows, iColumns));
+   * ~~~
+   *
+   * @param mat the input matrix, which will be replaced by the
+   * transform coefficients. *T* must be `float` or `double`.
+   *
+   * @param levels the number of decomposition levels
+   *
+   * @param wavelet the wavelet family
+   *
+   * @param familyMember the index of the wavelet within its family
+   *
+   * @return the number of levels actually calculated. The
+   * decomposition stops when the approximation has fewer than two
+   * rows or columns.
+   */
+  template <class T> int dwtInPlace(PiiMatrix<T>& mat,
+                                    int levels,
+                                    WaveletFamily wavelet = Haar,
+                                    int familyMember = 1);
+
+  /**
+   * Inverts the transform calculated by [dwtInPlace()] in place. The
+   * parameters must be the same as those used in the forward
+   * transform.
+   */
+  template <class T> void inverseDwtInPlace(PiiMatrix<T>& mat,
+                                            int levels,
+                                            WaveletFamily wavelet = Haar,
+                                            int familyMember = 1);
+
   /**
    * Take the central part of a matrix.
    *
@@ -18,7 +18,7 @@
 #include <PiiYdinTypes.h>
 
 PiiDwtOperation::Data::Data() :
-  waveletFamily(Haar), iFamilyMember(1)
+  waveletFamily(Haar), iFamilyMember(1), bPeriodicExtension(false)
 {
 }
 
@@ -60,6 +60,20 @@ template <class T> void PiiDwtOperation::integerTransform(const PiiVariant& obj)
 template <class T> void PiiDwtOperation::transform(const PiiMatrix<T>& mat)
 {
   PII_D;
+  if (d->bPeriodicExtension)
+    {
+      PiiMatrix<T> matTransform(mat);
+      if (PiiDsp::dwtInPlace(matTransform, 1, (PiiDsp::WaveletFamily)d->waveletFamily, d->iFamilyMember) == 1)
+        {
+          const int iRows = mat.rows() / 2, iColumns = mat.columns() / 2;
+          const PiiMatrix<T>& matBands = matTransform;
+          emitObject(matBands(0, 0, iRows, iColumns), 0);
+          emitObject(matBands(0, iColumns, iRows, iColumns), 1);
+          emitObject(matBands(iRows, 0, iRows, iColumns), 2);
+          emitObject(matBands(iRows, iColumns, iRows, iColumns), 3);
+          return;
+        }
+    }
   QList<PiiMatrix<T> > lstTransforms(PiiDsp::dwt(mat, (PiiDsp::WaveletFamily)d->waveletFamily, d->iFamilyMember));
   for (int i=0; i<4; ++i)
     emitObject(lstTransforms[i], i);
@@ -69,3 +83,5 @@ void PiiDwtOperation::setWaveletFamily(const WaveletFamily& waveletFamily) { _d(
 PiiDwtOperation::WaveletFamily PiiDwtOperation::waveletFamily() const { return _d()->waveletFamily; }
 void PiiDwtOperation::setFamilyMember(int familyMember) { _d()->iFamilyMember = familyMember; }
 int PiiDwtOperation::familyMember() const { return _d()->iFamilyMember; }
+void PiiDwtOperation::setPeriodicExtension(bool periodicExtension) { _d()->bPeriodicExtension = periodicExtension; }
+bool PiiDwtOperation::periodicExtension() const { return _d()->bPeriodicExtension; }
@@ -60,6 +60,16 @@ class PiiDwtOperation : public PiiDefaultOperation
    */
   Q_PROPERTY(int familyMember READ familyMember WRITE setFamilyMember);
 
+  /**
+   * If `true`, the input is extended periodically, and the transform
+   * is calculated in place with PiiDsp::dwtInPlace(). Each output is
+   * then exactly half of the input in size, and the calculation is
+   * considerably faster. The coefficients close to the borders
+   * differ from those of the default zero-padded transform. The
+   * default is `false`.
+   */
+  Q_PROPERTY(bool periodicExtension READ periodicExtension WRITE setPeriodicExtension);
+
   PII_OPERATION_SERIALIZATION_FUNCTION
 public:
   /**
@@ -77,6 +87,8 @@ public:
   WaveletFamily waveletFamily() const;
   void setFamilyMember(int familyMember);
   int familyMember() const;
+  void setPeriodicExtension(bool periodicExtension);
+  bool periodicExtension() const;
 
 protected:
   void process();
@@ -94,6 +106,7 @@ private:
 
     WaveletFamily waveletFamily;
     int iFamilyMember;
+    bool bPeriodicExtension;
   };
   PII_D_FUNC;
 };
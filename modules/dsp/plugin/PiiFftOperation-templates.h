@@ -71,6 +71,7 @@ protected:
 private:
   template <class S> void operateForward(const PiiVariant& obj);
   template <class S> void operateInverse(const PiiVariant& obj);
+  template <class U, class S> static PiiMatrix<U> subtractRowMeans(const PiiMatrix<S>& matrix);
 
   class Data : public PiiFftOperation::Data
   {
@@ -92,12 +93,20 @@ template <class S> void PiiFftOperation::Template<T>::operateForward(const PiiVa
 
   const PiiMatrix<S>& image = obj.valueAs<PiiMatrix<S> >();
 
-  ResultType result = d->bSubtractMean ?
-    d->fft.forwardFft(Pii::matrix(image.mapped(std::minus<FloatType>(), Pii::mean<FloatType>(image)))) :
-    d->fft.forwardFft(image);
+  ResultType result;
+  if (d->bRowwise)
+    result = d->bSubtractMean ?
+      d->fft.forwardRowFft(Pii::ParallelExecution(), subtractRowMeans<FloatType>(image)) :
+      d->fft.forwardRowFft(Pii::ParallelExecution(), image);
+  else
+    // Real-valued images are transformed as half-length complex signals.
+    result = d->bSubtractMean ?
+      d->fft.forwardFft(Pii::ParallelExecution(),
+                        Pii::matrix(image.mapped(std::minus<FloatType>(), Pii::mean<FloatType>(image)))) :
+      d->fft.forwardFft(Pii::ParallelExecution(), image);
 
   if (d->bShift)
-    result = PiiDsp::fftShift(result);
+    result = d->bRowwise ? PiiDsp::fftShiftRows(result) : PiiDsp::fftShift(result);
 
   emitObject(result);
 
@@ -110,5 +119,27 @@ template <class S> void PiiFftOperation::Template<T>::operateInverse(const PiiVa
 {
   PII_D;
   const PiiMatrix<std::complex<S> > image = obj.valueAs<PiiMatrix<std::complex<S> > >();
-  emitObject(d->fft.inverseFft(d->bShift ? PiiDsp::fftShift(image, true) : image));
+  if (d->bRowwise)
+    emitObject(d->fft.inverseRowFft(Pii::ParallelExecution(), d->bShift ? PiiDsp::fftShiftRows(image, true) : image));
+  else
+    emitObject(d->fft.inverseFft(Pii::ParallelExecution(), d->bShift ? PiiDsp::fftShift(image, true) : image));
+}
+
+template <class T>
+template <class U, class S> PiiMatrix<U> PiiFftOperation::Template<T>::subtractRowMeans(const PiiMatrix<S>& matrix)
+{
+  const int iRows = matrix.rows(), iColumns = matrix.columns();
+  PiiMatrix<U> result(PiiMatrix<U>::uninitialized(iRows, iColumns));
+  for (int r=0; r<iRows; ++r)
+    {
+      const S* pSource = matrix[r];
+      U* pTarget = result[r];
+      U sum(0);
+      for (int c=0; c<iColumns; ++c)
+        sum += U(pSource[c]);
+      const U mean(sum / U(iColumns));
+      for (int c=0; c<iColumns; ++c)
+        pTarget[c] = U(pSource[c]) - mean;
+    }
+  return result;
 }
@@ -16,7 +16,7 @@
 #include "PiiFftOperation.h"
 
 PiiFftOperation::Data::Data() :
-  direction(Forward), bShift(false), bSubtractMean(false)
+  direction(Forward), bShift(false), bSubtractMean(false), bRowwise(false)
 {
 }
 
@@ -49,3 +49,5 @@ void PiiFftOperation::setShift(bool shift) { _d()->bShift = shift; }
 
 void PiiFftOperation::setSubtractMean(bool subtractMean) { _d()->bSubtractMean = subtractMean; }
 bool PiiFftOperation::subtractMean() const { return _d()->bSubtractMean; }
+void PiiFftOperation::setRowwise(bool rowwise) { _d()->bRowwise = rowwise; }
+bool PiiFftOperation::rowwise() const { return _d()->bRowwise; }
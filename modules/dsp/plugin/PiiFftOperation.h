@@ -73,6 +73,17 @@ class PiiFftOperation : public PiiDefaultOperation
    */
   Q_PROPERTY(bool subtractMean READ subtractMean WRITE setSubtractMean);
 
+  /**
+   * If this flag is `true`, each row of the input matrix is treated
+   * as an independent one-dimensional signal. Use this to transform
+   * a batch of signals, such as one profile per scan line, as a
+   * single object instead of emitting each signal separately. All
+   * rows are transformed with the same plan and in parallel. [shift]
+   * and [subtractMean] are applied to each row separately. The
+   * default is `false`.
+   */
+  Q_PROPERTY(bool rowwise READ rowwise WRITE setRowwise);
+
 public:
 
   PiiFftOperation();
@@ -93,6 +104,8 @@ public:
   void setShift(bool shift);
   void setSubtractMean(bool subtractMean);
   bool subtractMean() const;
+  void setRowwise(bool rowwise);
+  bool rowwise() const;
 
   template <class T> class Template;
 
@@ -106,6 +119,7 @@ protected:
     FftDirection direction;
     bool bShift;
     bool bSubtractMean;
+    bool bRowwise;
   };
   PII_D_FUNC;
 
@@ -17,13 +17,15 @@
 #include "PiiDsp.h"
 
 #include <PiiYdinTypes.h>
+#include <PiiParallel.h>
 
 PiiPeakDetector::Data::Data() :
   dLevelThreshold(0),
   dSharpnessThreshold(0.001),
   iSmoothWidth(5),
   iWindowWidth(7),
- iLevelCorrectionWindow(0)
+ iLevelCorrectionWindow(0),
+  bRowwise(false)
 {
 }
 
@@ -33,6 +35,7 @@ PiiPeakDetector::PiiPeakDetector() :
   addSocket(new PiiInputSocket("signal"));
   addSocket(new PiiOutputSocket("peaks"));
   addSocket(new PiiOutputSocket("indices"));
+  addSocket(new PiiOutputSocket("rows"));
 }
 
 void PiiPeakDetector::process()
@@ -47,32 +50,75 @@ void PiiPeakDetector::process()
     }
 }
 
+template <class T> struct PiiPeakDetector::RowDetector
+{
+  RowDetector(const PiiPeakDetector* detector, const PiiMatrix<T>& signals,
+              QVector<QList<PiiDsp::Peak> >& peaks) :
+    detector(detector), signals(signals), pPeaks(peaks.data())
+  {}
+
+  void operator() (int firstRow, int rowCount)
+  {
+    const PiiPeakDetector::Data* d = detector->_d();
+    for (int r=firstRow; r<firstRow+rowCount; ++r)
+      pPeaks[r] = PiiDsp::findPeaks(detector->adjustLevel(PiiMatrix<T>(signals(r,0,1,-1))),
+                                    d->dLevelThreshold,
+                                    d->dSharpnessThreshold,
+                                    d->iSmoothWidth,
+                                    d->iWindowWidth);
+  }
+
+  const PiiPeakDetector* detector;
+  const PiiMatrix<T>& signals;
+  QList<PiiDsp::Peak>* pPeaks;
+};
+
 template <class T> void PiiPeakDetector::findPeaks(const PiiVariant& obj)
 {
   PII_D;
   const PiiMatrix<T> matrix = obj.valueAs<PiiMatrix<T> >();
-  QList<PiiDsp::Peak> lstPeaks = PiiDsp::findPeaks(adjustLevel(matrix),
-                                                   d->dLevelThreshold,
-                                                   d->dSharpnessThreshold,
-                                                   d->iSmoothWidth,
-                                                   d->iWindowWidth);
-
-  PiiMatrix<double> matPeaks(lstPeaks.size(), 3);
-  PiiMatrix<int> matIndices(lstPeaks.size(), 1);
-  for (int i=0; i<lstPeaks.size(); ++i)
+  QVector<QList<PiiDsp::Peak> > vecPeaks;
+  if (d->bRowwise)
     {
-      matPeaks(i,0) = lstPeaks[i].position;
-      matPeaks(i,1) = lstPeaks[i].height;
-      matPeaks(i,2) = lstPeaks[i].width;
-      matIndices(i,0) = lstPeaks[i].dataIndex;
+      vecPeaks.resize(matrix.rows());
+      Pii::forEachBand(Pii::ParallelExecution(), matrix.rows(), 0,
+                       RowDetector<T>(this, matrix, vecPeaks));
+    }
+  else
+    vecPeaks << PiiDsp::findPeaks(adjustLevel(matrix),
+                                  d->dLevelThreshold,
+                                  d->dSharpnessThreshold,
+                                  d->iSmoothWidth,
+                                  d->iWindowWidth);
+
+  int iPeakCount = 0;
+  for (int r=0; r<vecPeaks.size(); ++r)
+    iPeakCount += vecPeaks[r].size();
+
+  PiiMatrix<double> matPeaks(PiiMatrix<double>::uninitialized(iPeakCount, 3));
+  PiiMatrix<int> matIndices(PiiMatrix<int>::uninitialized(iPeakCount, 1));
+  PiiMatrix<int> matRows(PiiMatrix<int>::uninitialized(iPeakCount, 1));
+  for (int r=0, i=0; r<vecPeaks.size(); ++r)
+    {
+      const QList<PiiDsp::Peak>& lstPeaks = vecPeaks[r];
+      for (int j=0; j<lstPeaks.size(); ++j, ++i)
+        {
+          double* pPeak = matPeaks[i];
+          pPeak[0] = lstPeaks[j].position;
+          pPeak[1] = lstPeaks[j].height;
+          pPeak[2] = lstPeaks[j].width;
+          matIndices(i,0) = lstPeaks[j].dataIndex;
+          matRows(i,0) = r;
+        }
     }
   emitObject(matPeaks, 0);
   emitObject(matIndices, 1);
+  emitObject(matRows, 2);
 }
 
-template <class T> PiiMatrix<double> PiiPeakDetector::adjustLevel(const PiiMatrix<T>& matrix)
+template <class T> PiiMatrix<double> PiiPeakDetector::adjustLevel(const PiiMatrix<T>& matrix) const
 {
-  PII_D;
+  const PII_D;
   if (d->iLevelCorrectionWindow <= 1)
     return PiiMatrix<double>(matrix);
 
@@ -96,3 +142,5 @@ void PiiPeakDetector::setWindowWidth(int windowWidth) { _d()->iWindowWidth = win
 int PiiPeakDetector::windowWidth() const { return _d()->iWindowWidth; }
 void PiiPeakDetector::setLevelCorrectionWindow(int levelCorrectionWindow) { _d()->iLevelCorrectionWindow = levelCorrectionWindow; }
 int PiiPeakDetector::levelCorrectionWindow() const { return _d()->iLevelCorrectionWindow; }
+void PiiPeakDetector::setRowwise(bool rowwise) { _d()->bRowwise = rowwise; }
+bool PiiPeakDetector::rowwise() const { return _d()->bRowwise; }
@@ -26,7 +26,10 @@
  * Inputs
  * ------
  *
- * @in signal - input signal. A row vector. (real-valued PiiMatrix)
+ * @in signal - input signal. A row vector. If the matrix has two
+ * rows, the first one holds the X coordinates of the samples in the
+ * second one. If [rowwise] is `true`, each row is an independent
+ * signal. (real-valued PiiMatrix)
  *
  * Outputs
  * -------
@@ -38,6 +41,10 @@
  * @out indices - zero-based indices of detected peaks in the original
  * signal. A N-by-1 PiiMatrix<int>.
  *
+ * @out rows - the zero-based index of the input row each peak was
+ * found on. A N-by-1 PiiMatrix<int>. All zeros unless [rowwise] is
+ * `true`.
+ *
  */
 class PiiPeakDetector : public PiiDefaultOperation
 {
@@ -69,6 +76,14 @@ class PiiPeakDetector : public PiiDefaultOperation
    * over this many elements. The default value is 0.
    */
   Q_PROPERTY(int levelCorrectionWindow READ levelCorrectionWindow WRITE setLevelCorrectionWindow);
+  /**
+   * If this flag is `true`, each row of the input matrix is treated
+   * as an independent signal. This makes it possible to send a batch
+   * of short signals, such as one profile per scan line, as one
+   * object. The rows are processed in parallel, and the peaks of all
+   * rows are emitted in row order. The default is `false`.
+   */
+  Q_PROPERTY(bool rowwise READ rowwise WRITE setRowwise);
 
   PII_OPERATION_SERIALIZATION_FUNCTION
 public:
@@ -84,13 +99,16 @@ public:
   int windowWidth() const;
   void setLevelCorrectionWindow(int levelCorrectionWindow);
   int levelCorrectionWindow() const;
+  void setRowwise(bool rowwise);
+  bool rowwise() const;
 
 protected:
   void process();
 
 private:
   template <class T> void findPeaks(const PiiVariant& obj);
-  template <class T> PiiMatrix<double> adjustLevel(const PiiMatrix<T>& matrix);
+  template <class T> PiiMatrix<double> adjustLevel(const PiiMatrix<T>& matrix) const;
+  template <class T> struct RowDetector;
 
   /// @internal
   class Data : public PiiDefaultOperation::Data
@@ -103,6 +121,7 @@ private:
     int iSmoothWidth;
     int iWindowWidth;
     int iLevelCorrectionWindow;
+    bool bRowwise;
   };
   PII_D_FUNC;
 };
@@ -13,15 +13,32 @@
  * refer to LICENSE.AGPL3 for details.
  */
 
+
 #include "PiiCacheOperation.h"
 
 #include <PiiYdinTypes.h>
+#include <PiiMemoryBudget.h>
+#include <PiiSerializationUtil.h>
+#include <PiiGenericBinaryInputArchive.h>
+#include <PiiGenericBinaryOutputArchive.h>
+
+#include <QTemporaryFile>
+#include <QDir>
+#include <QVector>
 
 PiiCacheOperation::Data::Data() :
-  iMaxBytes(2*1024*1024),
+  lMaxBytes(2*1024*1024),
   iMaxObjects(0),
   bAllowOrderChanges(false),
-  iConsumedMemory(0)
+  evictionPolicy(LeastRecentlyUsed),
+  bSpillToDisk(false),
+  lMaxSpillBytes(0),
+  pMemoryBudget(0),
+  lRecentBytes(0), lFrequentBytes(0),
+  lTargetRecentBytes(0),
+  lRecentGhostBytes(0), lFrequentGhostBytes(0),
+  pSpillFile(0),
+  lSpillFileSize(0), lSpilledBytes(0)
 {
 }
 
@@ -32,10 +49,74 @@ PiiCacheOperation::PiiCacheOperation() :
   addSocket(d->pKeyInput = new PiiInputSocket("key"));
   addSocket(d->pDataInput = new PiiInputSocket("data"));
   d->pDataInput->setOptional(true);
+  // Data arrives asynchronously with respect to keys.
+  d->pDataInput->setGroupId(-1);
 
   addSocket(d->pFoundOutput = new PiiOutputSocket("found"));
   addSocket(d->pKeyOutput = new PiiOutputSocket("key"));
   addSocket(d->pDataOutput = new PiiOutputSocket("data"));
+  d->pDataOutput->setGroupId(-1);
+
+  setProtectionLevel("allowOrderChanges", WriteWhenStoppedOrPaused);
+  setProtectionLevel("evictionPolicy", WriteWhenStoppedOrPaused);
+  setProtectionLevel("spillToDisk", WriteWhenStoppedOrPaused);
+  setProtectionLevel("spillDirectory", WriteWhenStoppedOrPaused);
+}
+
+PiiCacheOperation::~PiiCacheOperation()
+{
+  PII_D;
+  if (d->pMemoryBudget != 0)
+    d->pMemoryBudget->release(consumedMemory());
+  closeSpillFile();
+}
+
+void PiiCacheOperation::check(bool reset)
+{
+  PiiDefaultOperation::check(reset);
+
+  PII_D;
+  // Requests that were not answered are lost.
+  d->lstPendingKeys.clear();
+  d->lstOutputQueue.clear();
+
+  if (d->evictionPolicy == LeastRecentlyUsed && !d->lstFrequent.isEmpty())
+    {
+      // Merge the ARC lists into a single LRU list.
+      for (Data::KeyList::iterator i = d->lstFrequent.begin(); i != d->lstFrequent.end(); ++i)
+        {
+          Data::Entry& entry = d->hashObjects[*i];
+          entry.itPosition = d->lstRecent.insert(d->lstRecent.end(), *i);
+          entry.bFrequent = false;
+        }
+      d->lstFrequent.clear();
+      d->lRecentBytes += d->lFrequentBytes;
+      d->lFrequentBytes = 0;
+    }
+  if (d->evictionPolicy == LeastRecentlyUsed)
+    {
+      d->hashGhosts.clear();
+      d->lstRecentGhosts.clear();
+      d->lstFrequentGhosts.clear();
+      d->lRecentGhostBytes = d->lFrequentGhostBytes = 0;
+      d->lTargetRecentBytes = 0;
+    }
+  if (!d->bSpillToDisk)
+    closeSpillFile();
+
+  // Move the objects in memory to the current budget.
+  PiiMemoryBudget* pBudget = memoryBudget();
+  if (pBudget != d->pMemoryBudget)
+    {
+      if (d->pMemoryBudget != 0)
+        d->pMemoryBudget->release(consumedMemory());
+      if (pBudget != 0)
+        pBudget->acquire(consumedMemory());
+      d->pMemoryBudget = pBudget;
+    }
+
+  // The limits may have been changed.
+  makeRoom(0, 0);
 }
 
 void PiiCacheOperation::process()
@@ -44,25 +125,395 @@ void PiiCacheOperation::process()
   if (activeInputGroup() == d->pKeyInput->groupId())
     {
       QString strKey = PiiYdin::convertToQString(d->pKeyInput);
-      QHash<QString,PiiVariant>::iterator i = d->hashObjects.find(strKey);
-      if (i != d->hashObjects.end())
-        d->pDataOutput->emitObject(i.value());
+      PiiVariant varObject = findObject(strKey);
+      if (varObject.isValid())
+        {
+          d->pFoundOutput->emitObject(1);
+          // A hit must wait for the pending misses unless the order
+          // may be changed.
+          if (d->bAllowOrderChanges || d->lstOutputQueue.isEmpty())
+            d->pDataOutput->emitObject(varObject);
+          else
+            d->lstOutputQueue << varObject;
+        }
       else
-        d->hashObjects.insert(strKey, d->pDataInput->firstObject());
+        {
+          // Register the request before emitting the key to be ready
+          // for a synchronous loop-back.
+          d->lstPendingKeys << strKey;
+          if (!d->bAllowOrderChanges)
+            d->lstOutputQueue << PiiVariant();
+          d->pFoundOutput->emitObject(0);
+          d->pKeyOutput->emitObject(d->pKeyInput->firstObject());
+        }
+    }
+  else
+    {
+      if (d->lstPendingKeys.isEmpty())
+        PII_THROW(PiiExecutionException, tr("Received an object in the data input, but there is no pending cache miss."));
+      QString strKey = d->lstPendingKeys.takeFirst();
+      PiiVariant varObject = d->pDataInput->firstObject();
+      // A possible spilled copy is outdated now.
+      dropSpilledObject(strKey);
+      storeObject(strKey, varObject);
+      d->pDataOutput->emitObject(varObject);
+
+      if (!d->lstOutputQueue.isEmpty())
+        {
+          // Release the hits that were waiting for this miss.
+          d->lstOutputQueue.removeFirst();
+          while (!d->lstOutputQueue.isEmpty() && d->lstOutputQueue.first().isValid())
+            d->pDataOutput->emitObject(d->lstOutputQueue.takeFirst());
+        }
+    }
+}
+
+PiiVariant PiiCacheOperation::findObject(const QString& key)
+{
+  PII_D;
+  QHash<QString, Data::Entry>::iterator i = d->hashObjects.find(key);
+  if (i != d->hashObjects.end())
+    {
+      Data::Entry& entry = i.value();
+      (entry.bFrequent ? d->lstFrequent : d->lstRecent).erase(entry.itPosition);
+      // ARC promotes an object to the frequent list on the second hit.
+      if (d->evictionPolicy == AdaptiveReplacement && !entry.bFrequent)
+        {
+          d->lRecentBytes -= entry.lBytes;
+          d->lFrequentBytes += entry.lBytes;
+          entry.bFrequent = true;
+        }
+      Data::KeyList& lstKeys = entry.bFrequent ? d->lstFrequent : d->lstRecent;
+      entry.itPosition = lstKeys.insert(lstKeys.end(), key);
+      return entry.varObject;
     }
-  /*
-    int iSize = 64;
-    if (PiiYdin::isMatrixType(obj.type()))
-    iSize += PiiYdin::matrixRows(obj) * PiiYdin::matrixStride(obj);
-    else
-    PII_THROW_UNKNOWN_TYPE(inputAt(0));
-  */
+
+  PiiVariant varObject = loadSpilledObject(key);
+  if (varObject.isValid())
+    storeObject(key, varObject);
+  return varObject;
 }
 
+void PiiCacheOperation::storeObject(const QString& key, const PiiVariant& object)
+{
+  PII_D;
+  removeObject(key);
 
-void PiiCacheOperation::setMaxBytes(int maxBytes) { _d()->iMaxBytes = maxBytes; }
-int PiiCacheOperation::maxBytes() const { return _d()->iMaxBytes; }
+  qint64 lBytes = object.memoryUsage() + Pii::MemoryUsage<QString>::heapBytes(key);
+  bool bFrequent = false;
+  QHash<QString, Data::Ghost>::iterator g = d->hashGhosts.find(key);
+  if (g != d->hashGhosts.end())
+    {
+      // An evicted object was requested again. Adapt the target
+      // size of the recent list towards the list the object was
+      // evicted from. The step is scaled by the ratio of the ghost
+      // list sizes as in ARC.
+      qint64 lCapacity = d->lMaxBytes > 0 ? d->lMaxBytes : consumedMemory() + lBytes;
+      if (!g->bFrequent)
+        d->lTargetRecentBytes = qMin(lCapacity,
+                                     d->lTargetRecentBytes +
+                                     lBytes * qMax(qint64(1), d->lFrequentGhostBytes / qMax(d->lRecentGhostBytes, qint64(1))));
+      else
+        d->lTargetRecentBytes = qMax(qint64(0),
+                                     d->lTargetRecentBytes -
+                                     lBytes * qMax(qint64(1), d->lRecentGhostBytes / qMax(d->lFrequentGhostBytes, qint64(1))));
+      forgetEvicted(key);
+      bFrequent = true;
+    }
+
+  // An object that would flush the whole cache is not kept in memory.
+  if (d->lMaxBytes > 0 && lBytes > d->lMaxBytes)
+    {
+      spillObject(key, object);
+      return;
+    }
+
+  makeRoom(lBytes, 1);
+  Data::KeyList& lstKeys = bFrequent ? d->lstFrequent : d->lstRecent;
+  d->hashObjects.insert(key, Data::Entry(object, lBytes, lstKeys.insert(lstKeys.end(), key), bFrequent));
+  (bFrequent ? d->lFrequentBytes : d->lRecentBytes) += lBytes;
+  if (d->pMemoryBudget != 0)
+    d->pMemoryBudget->acquire(lBytes);
+}
+
+void PiiCacheOperation::removeObject(const QString& key)
+{
+  PII_D;
+  QHash<QString, Data::Entry>::iterator i = d->hashObjects.find(key);
+  if (i == d->hashObjects.end())
+    return;
+  if (i->bFrequent)
+    {
+      d->lstFrequent.erase(i->itPosition);
+      d->lFrequentBytes -= i->lBytes;
+    }
+  else
+    {
+      d->lstRecent.erase(i->itPosition);
+      d->lRecentBytes -= i->lBytes;
+    }
+  if (d->pMemoryBudget != 0)
+    d->pMemoryBudget->release(i->lBytes);
+  d->hashObjects.erase(i);
+}
+
+void PiiCacheOperation::makeRoom(qint64 bytes, int objects)
+{
+  PII_D;
+  // Queues that run out of memory block the pipeline. Cached objects
+  // can always be recalculated.
+  while (!d->hashObjects.isEmpty() &&
+         ((d->lMaxBytes > 0 && consumedMemory() + bytes > d->lMaxBytes) ||
+          (d->iMaxObjects > 0 && d->hashObjects.size() + objects > d->iMaxObjects) ||
+          (d->pMemoryBudget != 0 && d->pMemoryBudget->isUnderPressure(bytes))))
+    {
+      // With LRU, lstFrequent is always empty.
+      bool bRecent = !d->lstRecent.isEmpty() &&
+        (d->lstFrequent.isEmpty() || d->lRecentBytes > d->lTargetRecentBytes);
+      Data::KeyList& lstKeys = bRecent ? d->lstRecent : d->lstFrequent;
+      QString strKey = lstKeys.takeFirst();
+      Data::Entry entry = d->hashObjects.take(strKey);
+      (bRecent ? d->lRecentBytes : d->lFrequentBytes) -= entry.lBytes;
+      if (d->pMemoryBudget != 0)
+        d->pMemoryBudget->release(entry.lBytes);
+
+      spillObject(strKey, entry.varObject);
+      if (d->evictionPolicy == AdaptiveReplacement)
+        rememberEvicted(strKey, entry.lBytes, !bRecent);
+    }
+}
+
+void PiiCacheOperation::rememberEvicted(const QString& key, qint64 bytes, bool frequent)
+{
+  PII_D;
+  Data::KeyList& lstKeys = frequent ? d->lstFrequentGhosts : d->lstRecentGhosts;
+  qint64& lGhostBytes = frequent ? d->lFrequentGhostBytes : d->lRecentGhostBytes;
+  d->hashGhosts.insert(key, Data::Ghost(bytes, lstKeys.insert(lstKeys.end(), key), frequent));
+  lGhostBytes += bytes;
+  // Each ghost list remembers at most as much as fits into the cache.
+  while (!lstKeys.isEmpty() &&
+         ((d->lMaxBytes > 0 && lGhostBytes > d->lMaxBytes) ||
+          (d->iMaxObjects > 0 && lstKeys.size() > d->iMaxObjects)))
+    forgetEvicted(lstKeys.first());
+}
+
+void PiiCacheOperation::forgetEvicted(const QString& key)
+{
+  PII_D;
+  QHash<QString, Data::Ghost>::iterator i = d->hashGhosts.find(key);
+  if (i == d->hashGhosts.end())
+    return;
+  if (i->bFrequent)
+    {
+      d->lstFrequentGhosts.erase(i->itPosition);
+      d->lFrequentGhostBytes -= i->lBytes;
+    }
+  else
+    {
+      d->lstRecentGhosts.erase(i->itPosition);
+      d->lRecentGhostBytes -= i->lBytes;
+    }
+  d->hashGhosts.erase(i);
+}
+
+bool PiiCacheOperation::openSpillFile()
+{
+  PII_D;
+  if (d->pSpillFile != 0)
+    return true;
+
+  QString strDirectory = d->strSpillDirectory.isEmpty() ? QDir::tempPath() : d->strSpillDirectory;
+  QTemporaryFile* pFile = new QTemporaryFile(strDirectory + "/PiiCacheOperation-XXXXXX");
+  if (!pFile->open())
+    {
+      piiWarning(tr("Cannot create a spill file in %1.").arg(strDirectory));
+      delete pFile;
+      return false;
+    }
+  d->pSpillFile = pFile;
+  d->lSpillFileSize = 0;
+  return true;
+}
+
+void PiiCacheOperation::spillObject(const QString& key, const PiiVariant& object)
+{
+  PII_D;
+  if (!d->bSpillToDisk)
+    return;
+
+  QHash<QString, Data::SpillEntry>::iterator i = d->hashSpilled.find(key);
+  if (i != d->hashSpilled.end())
+    {
+      // Spilled objects are never modified; the copy on disk is
+      // still valid.
+      d->lstSpilled.erase(i->itPosition);
+      i->itPosition = d->lstSpilled.insert(d->lstSpilled.end(), key);
+      return;
+    }
+
+  QByteArray aData;
+  try
+    {
+      aData = PiiSerialization::toByteArray<PiiGenericBinaryOutputArchive>(object);
+    }
+  catch (PiiSerializationException&)
+    {
+      // Unserializable objects are just dropped.
+      return;
+    }
+
+  qint64 lLength = aData.size();
+  if (d->lMaxSpillBytes > 0)
+    {
+      if (lLength > d->lMaxSpillBytes)
+        return;
+      while (!d->lstSpilled.isEmpty() && d->lSpilledBytes + lLength > d->lMaxSpillBytes)
+        dropSpilledObject(d->lstSpilled.first());
+    }
+
+  if (!openSpillFile())
+    {
+      d->bSpillToDisk = false;
+      return;
+    }
+  // Rewrite the file once most of it is garbage.
+  if (d->lSpillFileSize - d->lSpilledBytes > d->lSpilledBytes)
+    compactSpillFile();
+
+  if (!d->pSpillFile->seek(d->lSpillFileSize) ||
+      d->pSpillFile->write(aData) != lLength)
+    {
+      piiWarning(tr("Cannot write to the spill file %1.").arg(d->pSpillFile->fileName()));
+      return;
+    }
+  d->hashSpilled.insert(key, Data::SpillEntry(d->lSpillFileSize, lLength,
+                                              d->lstSpilled.insert(d->lstSpilled.end(), key)));
+  d->lSpillFileSize += lLength;
+  d->lSpilledBytes += lLength;
+}
+
+PiiVariant PiiCacheOperation::loadSpilledObject(const QString& key)
+{
+  PII_D;
+  QHash<QString, Data::SpillEntry>::iterator i = d->hashSpilled.find(key);
+  if (i == d->hashSpilled.end())
+    return PiiVariant();
+
+  d->lstSpilled.erase(i->itPosition);
+  i->itPosition = d->lstSpilled.insert(d->lstSpilled.end(), key);
+
+  PiiVariant varObject;
+  d->pSpillFile->flush();
+  uchar* pData = d->pSpillFile->map(i->lOffset, i->lLength);
+  try
+    {
+      if (pData != 0)
+        PiiSerialization::fromByteArray<PiiGenericBinaryInputArchive>(QByteArray::fromRawData(reinterpret_cast<const char*>(pData),
+                                                                                                int(i->lLength)),
+                                                                       varObject);
+      // Mapping is not supported everywhere.
+      else if (d->pSpillFile->seek(i->lOffset))
+        PiiSerialization::fromByteArray<PiiGenericBinaryInputArchive>(d->pSpillFile->read(i->lLength), varObject);
+    }
+  catch (PiiSerializationException& ex)
+    {
+      piiWarning(tr("Cannot reload %1 from the spill file: %2").arg(key).arg(ex.message()));
+      varObject = PiiVariant();
+    }
+  if (pData != 0)
+    d->pSpillFile->unmap(pData);
+  if (!varObject.isValid())
+    dropSpilledObject(key);
+  return varObject;
+}
+
+void PiiCacheOperation::dropSpilledObject(const QString& key)
+{
+  PII_D;
+  QHash<QString, Data::SpillEntry>::iterator i = d->hashSpilled.find(key);
+  if (i == d->hashSpilled.end())
+    return;
+  d->lstSpilled.erase(i->itPosition);
+  // The bytes stay in the file until it is compacted.
+  d->lSpilledBytes -= i->lLength;
+  d->hashSpilled.erase(i);
+}
+
+void PiiCacheOperation::compactSpillFile()
+{
+  PII_D;
+  QTemporaryFile* pOldFile = d->pSpillFile;
+  qint64 lOldSize = d->lSpillFileSize;
+  d->pSpillFile = 0;
+  if (!openSpillFile())
+    {
+      d->pSpillFile = pOldFile;
+      d->lSpillFileSize = lOldSize;
+      return;
+    }
+
+  QVector<qint64> vecOffsets;
+  vecOffsets.reserve(d->lstSpilled.size());
+  qint64 lOffset = 0;
+  for (Data::KeyList::const_iterator i = d->lstSpilled.constBegin(); i != d->lstSpilled.constEnd(); ++i)
+    {
+      const Data::SpillEntry& entry = d->hashSpilled[*i];
+      QByteArray aData;
+      if (pOldFile->seek(entry.lOffset))
+        aData = pOldFile->read(entry.lLength);
+      if (aData.size() != entry.lLength ||
+          d->pSpillFile->write(aData) != entry.lLength)
+        {
+          // Keep using the old file.
+          delete d->pSpillFile;
+          d->pSpillFile = pOldFile;
+          d->lSpillFileSize = lOldSize;
+          return;
+        }
+      vecOffsets << lOffset;
+      lOffset += entry.lLength;
+    }
+
+  int iIndex = 0;
+  for (Data::KeyList::const_iterator i = d->lstSpilled.constBegin(); i != d->lstSpilled.constEnd(); ++i, ++iIndex)
+    d->hashSpilled[*i].lOffset = vecOffsets[iIndex];
+  d->lSpillFileSize = lOffset;
+  delete pOldFile;
+}
+
+void PiiCacheOperation::closeSpillFile()
+{
+  PII_D;
+  delete d->pSpillFile;
+  d->pSpillFile = 0;
+  d->hashSpilled.clear();
+  d->lstSpilled.clear();
+  d->lSpillFileSize = d->lSpilledBytes = 0;
+}
+
+void PiiCacheOperation::setMaxBytes(qint64 maxBytes) { _d()->lMaxBytes = maxBytes; }
+qint64 PiiCacheOperation::maxBytes() const { return _d()->lMaxBytes; }
 void PiiCacheOperation::setMaxObjects(int maxObjects) { _d()->iMaxObjects = maxObjects; }
 int PiiCacheOperation::maxObjects() const { return _d()->iMaxObjects; }
 void PiiCacheOperation::setAllowOrderChanges(bool allowOrderChanges) { _d()->bAllowOrderChanges = allowOrderChanges; }
 bool PiiCacheOperation::allowOrderChanges() const { return _d()->bAllowOrderChanges; }
+void PiiCacheOperation::setEvictionPolicy(EvictionPolicy evictionPolicy) { _d()->evictionPolicy = evictionPolicy; }
+PiiCacheOperation::EvictionPolicy PiiCacheOperation::evictionPolicy() const { return _d()->evictionPolicy; }
+void PiiCacheOperation::setSpillToDisk(bool spillToDisk) { _d()->bSpillToDisk = spillToDisk; }
+bool PiiCacheOperation::spillToDisk() const { return _d()->bSpillToDisk; }
+qint64 PiiCacheOperation::maxSpillBytes() const { return _d()->lMaxSpillBytes; }
+void PiiCacheOperation::setMaxSpillBytes(qint64 maxSpillBytes) { _d()->lMaxSpillBytes = maxSpillBytes; }
+QString PiiCacheOperation::spillDirectory() const { return _d()->strSpillDirectory; }
+qint64 PiiCacheOperation::consumedMemory() const { return _d()->lRecentBytes + _d()->lFrequentBytes; }
+qint64 PiiCacheOperation::retainedMemory() const { return consumedMemory(); }
+qint64 PiiCacheOperation::spilledBytes() const { return _d()->lSpilledBytes; }
+
+void PiiCacheOperation::setSpillDirectory(const QString& spillDirectory)
+{
+  PII_D;
+  if (spillDirectory == d->strSpillDirectory)
+    return;
+  d->strSpillDirectory = spillDirectory;
+  // Objects in the old file are lost.
+  closeSpillFile();
+}
@@ -13,6 +13,7 @@
  * refer to LICENSE.AGPL3 for details.
  */
 
+
 #ifndef _PIICACHEOPERATION_H
 #define _PIICACHEOPERATION_H
 
@@ -20,7 +21,7 @@
 #include <QLinkedList>
 #include <QHash>
 
-#include <PiiMatrix.h>
+class QTemporaryFile;
 
 /**
  * An operation that caches processing results. PiiCacheOperation can
@@ -28,9 +29,6 @@
  * than once. The most typical use is in caching feature vectors used
  * for training a classifier.
  *
- * ! The implementation of this operation is still incomplete.
- * Don't use.
- *
  * The cache works by associating each cached object with a *key*.
  * Whenever a key is received, the cache is searched for an
  * occurrence. If a hit is found, it will be sent to the `data`
@@ -45,6 +43,18 @@
  * object that will be sent back to the cache to be associated with
  * the key.
  *
+ * When the cache is full, objects are evicted according to
+ * [evictionPolicy]. If [spillToDisk] is enabled, evicted objects are
+ * serialized into a temporary file and reloaded from there on a
+ * later hit, which makes it possible to cache data sets that don't
+ * fit into memory without recalculating them.
+ *
+ * If the operation has a [memory budget]
+ * (PiiDefaultOperation::setMemoryBudget()), the objects in memory are
+ * accounted to it. Whenever the budget is under pressure (see
+ * PiiMemoryBudget::isUnderPressure()), the cache evicts objects
+ * before storing a new one, even if [maxBytes] has not been reached.
+ *
  * Inputs
  * ------
  *
@@ -76,22 +86,17 @@ class PiiCacheOperation : public PiiDefaultOperation
   Q_OBJECT
 
   /**
-   * The maximum number of bytes the cache is allowed to occupy. The
-   * operation recognizes all primitive types, complex numbers, and
-   * matrices composed of them. It also knows QStrings. The number of
-   * bytes an object occupies is an approximation because memory
-   * allocation techniques vary. The operation uses an estimate of 32
-   * bytes per each object (const PiiVariant&). If the object is a
-   * primitive type, additional 32 bytes will be assumed. If it is a
-   * matrix, 32 bytes + sizeof(T) * rows * columns will be assumed.
-   * The size of a QString is assumed to be 32 + two times its length.
-   * Zero means no limit. The default is 2 Mb.
+   * The maximum number of bytes the cache is allowed to keep in
+   * memory. The size of an object is queried with
+   * PiiVariant::memoryUsage(), which accounts for the heap storage of
+   * matrices, images and strings exactly. The size of the key is
+   * added to each entry. Zero means no limit. The default is 2 Mb.
    */
-  Q_PROPERTY(int maxBytes READ maxBytes WRITE setMaxBytes);
+  Q_PROPERTY(qint64 maxBytes READ maxBytes WRITE setMaxBytes);
 
   /**
-   * The maximum number of objects the cache is allowed to hold. Zero
-   * (the default) means no limit.
+   * The maximum number of objects the cache is allowed to hold in
+   * memory. Zero (the default) means no limit.
    */
   Q_PROPERTY(int maxObjects READ maxObjects WRITE setMaxObjects);
 
@@ -106,39 +111,189 @@ class PiiCacheOperation : public PiiDefaultOperation
    */
   Q_PROPERTY(bool allowOrderChanges READ allowOrderChanges WRITE setAllowOrderChanges);
 
+  /**
+   * The policy used in selecting the objects to be evicted when the
+   * cache is full. The default is `LeastRecentlyUsed`.
+   */
+  Q_PROPERTY(EvictionPolicy evictionPolicy READ evictionPolicy WRITE setEvictionPolicy);
+  Q_ENUMS(EvictionPolicy);
+
+  /**
+   * Enables or disables the disk tier. If this flag is `true`,
+   * objects evicted from memory are serialized into a temporary file
+   * in [spillDirectory]. If a key that is no longer in memory is
+   * found in the file, the object is read back (through a memory
+   * mapping) instead of reporting a cache miss. Objects that cannot
+   * be serialized are just dropped. The default is `false`.
+   */
+  Q_PROPERTY(bool spillToDisk READ spillToDisk WRITE setSpillToDisk);
+
+  /**
+   * The directory in which the spill file is created. If this
+   * property is empty (the default), the system's temporary directory
+   * will be used.
+   */
+  Q_PROPERTY(QString spillDirectory READ spillDirectory WRITE setSpillDirectory);
+
+  /**
+   * The maximum number of bytes the spilled objects may take on disk.
+   * If the limit is exceeded, the least recently used objects will be
+   * removed from the file. Zero (the default) means no limit.
+   */
+  Q_PROPERTY(qint64 maxSpillBytes READ maxSpillBytes WRITE setMaxSpillBytes);
+
+  /**
+   * The number of bytes currently occupied by the objects in memory.
+   */
+  Q_PROPERTY(qint64 consumedMemory READ consumedMemory);
+
+  /**
+   * The number of bytes currently occupied by live objects in the
+   * spill file.
+   */
+  Q_PROPERTY(qint64 spilledBytes READ spilledBytes);
+
   PII_OPERATION_SERIALIZATION_FUNCTION
 public:
+  /**
+   * Eviction policies.
+   *
+   * - `LeastRecentlyUsed` - the object that has been accessed least
+   * recently will be evicted first.
+   *
+   * - `AdaptiveReplacement` - the cache is split into objects that
+   * have been accessed only once and objects that have been accessed
+   * at least twice. The keys of recently evicted objects are
+   * remembered, and the balance between the two parts is adjusted
+   * based on which kind of evicted objects are requested again
+   * (ARC). This policy is resistant to one-time scans over a large
+   * data set, which would flush an LRU cache.
+   */
+  enum EvictionPolicy { LeastRecentlyUsed, AdaptiveReplacement };
+
   PiiCacheOperation();
+  ~PiiCacheOperation();
 
-  void setMaxBytes(int maxBytes);
-  int maxBytes() const;
+  void check(bool reset);
+
+  void setMaxBytes(qint64 maxBytes);
+  qint64 maxBytes() const;
   void setMaxObjects(int maxObjects);
   int maxObjects() const;
   void setAllowOrderChanges(bool allowOrderChanges);
   bool allowOrderChanges() const;
+  void setEvictionPolicy(EvictionPolicy evictionPolicy);
+  EvictionPolicy evictionPolicy() const;
+  void setSpillToDisk(bool spillToDisk);
+  bool spillToDisk() const;
+  void setSpillDirectory(const QString& spillDirectory);
+  QString spillDirectory() const;
+  void setMaxSpillBytes(qint64 maxSpillBytes);
+  qint64 maxSpillBytes() const;
+  qint64 consumedMemory() const;
+  qint64 spilledBytes() const;
+
+  /**
+   * Returns [consumedMemory].
+   */
+  qint64 retainedMemory() const;
 
 protected:
   void process();
 
 private:
+  PiiVariant findObject(const QString& key);
+  void storeObject(const QString& key, const PiiVariant& object);
+  void removeObject(const QString& key);
+  void makeRoom(qint64 bytes, int objects);
+  void rememberEvicted(const QString& key, qint64 bytes, bool frequent);
+  void forgetEvicted(const QString& key);
+
+  bool openSpillFile();
+  void spillObject(const QString& key, const PiiVariant& object);
+  PiiVariant loadSpilledObject(const QString& key);
+  void dropSpilledObject(const QString& key);
+  void compactSpillFile();
+  void closeSpillFile();
+
   /// @internal
   class Data : public PiiDefaultOperation::Data
   {
   public:
     Data();
+
+    typedef QLinkedList<QString> KeyList;
+
+    // A resident object and its position in the recency lists.
+    struct Entry
+    {
+      Entry() : lBytes(0), bFrequent(false) {}
+      Entry(const PiiVariant& object, qint64 bytes, KeyList::iterator position, bool frequent) :
+        varObject(object), lBytes(bytes), itPosition(position), bFrequent(frequent)
+      {}
+      PiiVariant varObject;
+      qint64 lBytes;
+      KeyList::iterator itPosition;
+      bool bFrequent;
+    };
+
+    // The key of a recently evicted object (ARC ghost entry).
+    struct Ghost
+    {
+      Ghost() : lBytes(0), bFrequent(false) {}
+      Ghost(qint64 bytes, KeyList::iterator position, bool frequent) :
+        lBytes(bytes), itPosition(position), bFrequent(frequent)
+      {}
+      qint64 lBytes;
+      KeyList::iterator itPosition;
+      bool bFrequent;
+    };
+
+    // The location of a spilled object in the spill file.
+    struct SpillEntry
+    {
+      SpillEntry() : lOffset(0), lLength(0) {}
+      SpillEntry(qint64 offset, qint64 length, KeyList::iterator position) :
+        lOffset(offset), lLength(length), itPosition(position)
+      {}
+      qint64 lOffset, lLength;
+      KeyList::iterator itPosition;
+    };
+
     PiiInputSocket* pKeyInput, *pDataInput;
     PiiOutputSocket* pFoundOutput, *pKeyOutput, *pDataOutput;
-    int iMaxBytes;
+    qint64 lMaxBytes;
     int iMaxObjects;
     bool bAllowOrderChanges;
+    EvictionPolicy evictionPolicy;
+    bool bSpillToDisk;
+    QString strSpillDirectory;
+    qint64 lMaxSpillBytes;
+
+    // Resident objects. With LRU, everything is in lstRecent.
+    QHash<QString, Entry> hashObjects;
+    // The budget consumedMemory() is accounted to.
+    PiiMemoryBudget* pMemoryBudget;
+    KeyList lstRecent, lstFrequent;
+    qint64 lRecentBytes, lFrequentBytes;
+    // ARC's target size for lstRecent, in bytes.
+    qint64 lTargetRecentBytes;
 
-    int iConsumedMemory;
+    QHash<QString, Ghost> hashGhosts;
+    KeyList lstRecentGhosts, lstFrequentGhosts;
+    qint64 lRecentGhostBytes, lFrequentGhostBytes;
 
-    QHash<QString, PiiVariant> hashObjects;
-    QLinkedList<QString> lstKeys;
+    QTemporaryFile* pSpillFile;
+    QHash<QString, SpillEntry> hashSpilled;
+    KeyList lstSpilled;
+    qint64 lSpillFileSize, lSpilledBytes;
+
+    // Keys still waiting for their data.
+    QList<QString> lstPendingKeys;
+    // Output order. An invalid variant marks a pending cache miss.
+    QList<PiiVariant> lstOutputQueue;
   };
   PII_D_FUNC;
-
 };
 
 
@@ -23,6 +23,8 @@
 #include "PiiObjectRateChanger.h"
 #include "PiiObjectReplicator.h"
 #include "PiiCacheOperation.h"
+#include "PiiLoadBalancer.h"
+#include "PiiOrderedMerger.h"
 
 PII_IMPLEMENT_PLUGIN(PiiFlowControlPlugin);
 
@@ -34,3 +36,5 @@ PII_REGISTER_OPERATION(PiiFrequencyCounter);
 PII_REGISTER_OPERATION(PiiObjectRateChanger);
 PII_REGISTER_OPERATION(PiiObjectReplicator);
 PII_REGISTER_OPERATION(PiiCacheOperation);
+PII_REGISTER_OPERATION(PiiLoadBalancer);
+PII_REGISTER_OPERATION(PiiOrderedMerger);
@@ -0,0 +1,97 @@
+/* This file is part of Into.
+ * Copyright (C) Intopii 2013.
+ * All rights reserved.
+ *
+ * Licensees holding a commercial Into license may use this file in
+ * accordance with the commercial license agreement. Please see
+ * LICENSE.commercial for commercial licensing terms.
+ *
+ * Alternatively, this file may be used under the terms of the GNU
+ * Affero General Public License version 3 as published by the Free
+ * Software Foundation. In addition, Intopii gives you special rights
+ * to use Into as a part of open source software projects. Please
+ * refer to LICENSE.AGPL3 for details.
+ */
+
+
+#include "PiiLoadBalancer.h"
+
+#include <PiiProxySocket.h>
+
+PiiLoadBalancer::Data::Data() :
+  iNextBranch(0)
+{
+}
+
+PiiLoadBalancer::PiiLoadBalancer() :
+  PiiDefaultOperation(new Data)
+{
+  addSocket(new PiiInputSocket("input"));
+  addSocket(new PiiOutputSocket("route"));
+  setDynamicOutputCount(2);
+  setProtectionLevel("dynamicOutputCount", WriteWhenStopped);
+}
+
+void PiiLoadBalancer::check(bool reset)
+{
+  PiiDefaultOperation::check(reset);
+
+  PII_D;
+  const int iBranchCount = dynamicOutputCount();
+  d->vecReceivers.fill(QList<PiiInputSocket*>(), iBranchCount);
+  for (int i=0; i<iBranchCount; ++i)
+    {
+      QList<PiiAbstractInputSocket*> lstInputs = outputAt(i+1)->connectedInputs();
+      for (int j=0; j<lstInputs.size(); ++j)
+        {
+          // Pass through proxies to the receiving operations.
+          QList<PiiAbstractInputSocket*> lstTargets = PiiProxySocket::connectedInputs(lstInputs[j]);
+          for (int t=0; t<lstTargets.size(); ++t)
+            if (PiiInputSocket* pInput = qobject_cast<PiiInputSocket*>(lstTargets[t]))
+              d->vecReceivers[i] << pInput;
+        }
+    }
+  if (reset)
+    d->iNextBranch = 0;
+}
+
+double PiiLoadBalancer::load(int branch) const
+{
+  const PII_D;
+  // The fullest receiver blocks the branch.
+  double dLoad = 0;
+  const QList<PiiInputSocket*>& lstReceivers = d->vecReceivers[branch];
+  for (int i=0; i<lstReceivers.size(); ++i)
+    dLoad = qMax(dLoad, double(lstReceivers[i]->queueLength()) / qMax(lstReceivers[i]->queueCapacity(), 1));
+  return dLoad;
+}
+
+void PiiLoadBalancer::process()
+{
+  PII_D;
+  const int iBranchCount = d->vecReceivers.size();
+  int iBestBranch = d->iNextBranch;
+  double dBestLoad = load(iBestBranch);
+  for (int i=1; i<iBranchCount && dBestLoad > 0; ++i)
+    {
+      int iBranch = (d->iNextBranch + i) % iBranchCount;
+      double dLoad = load(iBranch);
+      if (dLoad < dBestLoad)
+        {
+          iBestBranch = iBranch;
+          dBestLoad = dLoad;
+        }
+    }
+  d->iNextBranch = (iBestBranch + 1) % iBranchCount;
+
+  emitObject(iBestBranch, 0);
+  emitObject(readInput(), iBestBranch + 1);
+}
+
+void PiiLoadBalancer::setDynamicOutputCount(int count)
+{
+  if (count < 1) return;
+  setNumberedOutputs(count, 1);
+}
+
+int PiiLoadBalancer::dynamicOutputCount() const { return outputCount() - 1; }
@@ -0,0 +1,102 @@
+/* This file is part of Into.
+ * Copyright (C) Intopii 2013.
+ * All rights reserved.
+ *
+ * Licensees holding a commercial Into license may use this file in
+ * accordance with the commercial license agreement. Please see
+ * LICENSE.commercial for commercial licensing terms.
+ *
+ * Alternatively, this file may be used under the terms of the GNU
+ * Affero General Public License version 3 as published by the Free
+ * Software Foundation. In addition, Intopii gives you special rights
+ * to use Into as a part of open source software projects. Please
+ * refer to LICENSE.AGPL3 for details.
+ */
+
+
+#ifndef _PIILOADBALANCER_H
+#define _PIILOADBALANCER_H
+
+#include <PiiDefaultOperation.h>
+#include <QVector>
+
+/**
+ * A dispatcher that spreads objects over replicated branches
+ * according to their load. PiiLoadBalancer can be used to scale
+ * operations that cannot run multi-threaded horizontally: build *N*
+ * identical copies of the sub-pipeline, run each copy in a thread of
+ * its own, connect the copies to the outputs of the balancer and
+ * their results to a PiiOrderedMerger.
+ *
+ * Each incoming object is sent to the branch whose receivers have
+ * the fullest input queues the least, measured as queue length
+ * divided by capacity. Ties are broken in round-robin order. The
+ * index of the selected branch is emitted through the `route`
+ * output. If the `route` output is connected to the `route` input
+ * of a PiiOrderedMerger, the merger restores the original order of
+ * the objects.
+ *
+ * ~~~(c++)
+ * engine.connectOutput("balancer.route", "merger.route");
+ * for (int i=0; i<3; ++i)
+ *   {
+ *     engine.connectOutput(QString("balancer.output%1").arg(i), QString("heavy%1.input").arg(i));
+ *     engine.connectOutput(QString("heavy%1.output").arg(i), QString("merger.input%1").arg(i));
+ *   }
+ * ~~~
+ *
+ * Since the branches are not synchronized to each other, they must
+ * not be joined by any other means than a PiiOrderedMerger.
+ *
+ * Inputs
+ * ------
+ *
+ * @in input - any object.
+ *
+ * Outputs
+ * -------
+ *
+ * @out route - the index of the branch the object was sent to (int).
+ *
+ * @out outputX - the branches. X ranges from 0 to
+ * `dynamicOutputCount` - 1.
+ *
+ */
+class PiiLoadBalancer : public PiiDefaultOperation
+{
+  Q_OBJECT
+
+  /**
+   * The number of branches. The default value is two.
+   */
+  Q_PROPERTY(int dynamicOutputCount READ dynamicOutputCount WRITE setDynamicOutputCount);
+
+  PII_OPERATION_SERIALIZATION_FUNCTION
+public:
+  PiiLoadBalancer();
+
+  void check(bool reset);
+
+  void setDynamicOutputCount(int count);
+  int dynamicOutputCount() const;
+
+protected:
+  void process();
+
+private:
+  double load(int branch) const;
+
+  /// @internal
+  class Data : public PiiDefaultOperation::Data
+  {
+  public:
+    Data();
+    // The non-proxy receivers of each branch.
+    QVector<QList<PiiInputSocket*> > vecReceivers;
+    int iNextBranch;
+  };
+  PII_D_FUNC;
+};
+
+
+#endif //_PIILOADBALANCER_H
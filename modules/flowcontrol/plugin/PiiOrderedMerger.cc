@@ -0,0 +1,78 @@
+/* This file is part of Into.
+ * Copyright (C) Intopii 2013.
+ * All rights reserved.
+ *
+ * Licensees holding a commercial Into license may use this file in
+ * accordance with the commercial license agreement. Please see
+ * LICENSE.commercial for commercial licensing terms.
+ *
+ * Alternatively, this file may be used under the terms of the GNU
+ * Affero General Public License version 3 as published by the Free
+ * Software Foundation. In addition, Intopii gives you special rights
+ * to use Into as a part of open source software projects. Please
+ * refer to LICENSE.AGPL3 for details.
+ */
+
+
+#include "PiiOrderedMerger.h"
+
+#include <PiiYdinTypes.h>
+#include <PiiDefaultFlowController.h>
+
+PiiOrderedMerger::PiiOrderedMerger() :
+  PiiDefaultOperation(new Data)
+{
+  addSocket(new PiiInputSocket("route"));
+  addSocket(new PiiOutputSocket("output"));
+  setDynamicInputCount(2);
+  setProtectionLevel("dynamicInputCount", WriteWhenStopped);
+}
+
+void PiiOrderedMerger::check(bool reset)
+{
+  PII_D;
+  if (reset)
+    {
+      d->queRoute.clear();
+      d->vecBuffers.fill(QQueue<PiiVariant>(), dynamicInputCount());
+    }
+
+  PiiDefaultOperation::check(reset);
+}
+
+PiiFlowController* PiiOrderedMerger::createFlowController()
+{
+  // Each input is a group of its own, and there are no relations
+  // between them.
+  return new PiiDefaultFlowController(inputSockets(), outputSockets());
+}
+
+void PiiOrderedMerger::process()
+{
+  PII_D;
+  const int iGroupId = activeInputGroup();
+  if (iGroupId == 0)
+    {
+      int iBranch = PiiYdin::primitiveAs<int>(inputAt(0));
+      if (iBranch < 0 || iBranch >= d->vecBuffers.size())
+        PII_THROW(PiiExecutionException, tr("Route input value (%1) is out of range (0-%2).").arg(iBranch).arg(d->vecBuffers.size()-1));
+      d->queRoute.enqueue(iBranch);
+    }
+  else
+    d->vecBuffers[iGroupId-1].enqueue(inputAt(iGroupId)->firstObject());
+
+  // Release everything that is next in turn.
+  while (!d->queRoute.isEmpty() && !d->vecBuffers[d->queRoute.head()].isEmpty())
+    emitObject(d->vecBuffers[d->queRoute.dequeue()].dequeue());
+}
+
+void PiiOrderedMerger::setDynamicInputCount(int count)
+{
+  if (count < 1) return;
+  setNumberedInputs(count, 1);
+  // Put each branch into a group of its own.
+  for (int i=1; i<inputCount(); ++i)
+    inputAt(i)->setGroupId(i);
+}
+
+int PiiOrderedMerger::dynamicInputCount() const { return inputCount() - 1; }
@@ -0,0 +1,89 @@
+/* This file is part of Into.
+ * Copyright (C) Intopii 2013.
+ * All rights reserved.
+ *
+ * Licensees holding a commercial Into license may use this file in
+ * accordance with the commercial license agreement. Please see
+ * LICENSE.commercial for commercial licensing terms.
+ *
+ * Alternatively, this file may be used under the terms of the GNU
+ * Affero General Public License version 3 as published by the Free
+ * Software Foundation. In addition, Intopii gives you special rights
+ * to use Into as a part of open source software projects. Please
+ * refer to LICENSE.AGPL3 for details.
+ */
+
+
+#ifndef _PIIORDEREDMERGER_H
+#define _PIIORDEREDMERGER_H
+
+#include <PiiDefaultOperation.h>
+#include <QVector>
+#include <QQueue>
+
+/**
+ * An operation that merges replicated branches back to a single
+ * stream in the original order. PiiOrderedMerger is the counterpart
+ * of PiiLoadBalancer: the `route` input receives the index of the
+ * branch each object was sent to, and the objects arriving from the
+ * branches are emitted in the order given by the route. An object
+ * that arrives early is buffered until all objects before it have
+ * been emitted.
+ *
+ * Each branch must produce exactly one object for each object it
+ * receives and retain the order of objects. Inputs are not
+ * synchronized to each other, and all objects must be on the lowest
+ * flow level.
+ *
+ * Inputs
+ * ------
+ *
+ * @in route - the index of the branch the next object will arrive
+ * from. Any numeric type in the range [0, `dynamicInputCount` - 1].
+ *
+ * @in inputX - the branches. X ranges from 0 to
+ * `dynamicInputCount` - 1.
+ *
+ * Outputs
+ * -------
+ *
+ * @out output - the objects from all branches in route order.
+ *
+ */
+class PiiOrderedMerger : public PiiDefaultOperation
+{
+  Q_OBJECT
+
+  /**
+   * The number of branches. The default value is two.
+   */
+  Q_PROPERTY(int dynamicInputCount READ dynamicInputCount WRITE setDynamicInputCount);
+
+  PII_OPERATION_SERIALIZATION_FUNCTION
+public:
+  PiiOrderedMerger();
+
+  void check(bool reset);
+
+  void setDynamicInputCount(int count);
+  int dynamicInputCount() const;
+
+protected:
+  void process();
+  PiiFlowController* createFlowController();
+
+private:
+  /// @internal
+  class Data : public PiiDefaultOperation::Data
+  {
+  public:
+    // Branch indices waiting for their objects
+    QQueue<int> queRoute;
+    // Objects that arrived before their turn, one queue per branch
+    QVector<QQueue<PiiVariant> > vecBuffers;
+  };
+  PII_D_FUNC;
+};
+
+
+#endif //_PIIORDEREDMERGER_H
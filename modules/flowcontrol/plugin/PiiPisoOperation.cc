@@ -209,15 +209,17 @@ private:
   class InputGroup : public QVector<PiiInputSocket*>
   {
   public:
-    InputGroup(int groupId) : _iGroupId(groupId) {}
-
-    /*void setTagged(bool tagged) { _bTagged = tagged; }
-      bool isTagged() const { return _bTagged; }*/
+    InputGroup(int groupId = 0) : bActive(true), iReadyInputs(0), _iGroupId(groupId) {}
 
     int groupId() const { return _iGroupId; }
 
     void shift();
 
+    // false if the group is waiting for tags in other groups
+    bool bActive;
+    // The number of leading inputs known to contain an object.
+    int iReadyInputs;
+
   private:
     int _iGroupId;
   };
@@ -226,8 +228,8 @@ private:
 
   QList<PiiInputSocket*> _lstInputs;
   QList<PiiOutputSocket*> _lstOutputs;
-  QList<InputGroup> _lstGroups;
-  QList<InputGroup> _lstActiveGroups;
+  QVector<InputGroup> _vecGroups;
+  int _iActiveGroupCount;
   int _iTagMask;
 };
 
@@ -235,6 +237,7 @@ void PiiPisoController::InputGroup::shift()
 {
   for (int i=0; i<size(); ++i)
     at(i)->shift();
+  iReadyInputs = 0;
 }
 
 PiiFlowController* PiiPisoOperation::createFlowController()
@@ -249,6 +252,7 @@ PiiFlowController* PiiPisoOperation::createFlowController()
 PiiPisoController::PiiPisoController(const QList<PiiInputSocket*> inputs, const QList<PiiOutputSocket*> outputs) :
   _lstInputs(inputs),
   _lstOutputs(outputs),
+  _iActiveGroupCount(0),
   _iTagMask(0)
 {
   int previousGroupId = -1;
@@ -258,33 +262,36 @@ PiiPisoController::PiiPisoController(const QList<PiiInputSocket*> inputs, const
         {
           if (previousGroupId != inputs[i]->groupId())
             {
-              _lstGroups << InputGroup(inputs[i]->groupId());
+              _vecGroups << InputGroup(inputs[i]->groupId());
               previousGroupId = inputs[i]->groupId();
             }
-          _lstGroups.last() << inputs[i];
+          _vecGroups.last() << inputs[i];
         }
     }
-  _lstActiveGroups = _lstGroups;
+  _iActiveGroupCount = _vecGroups.size();
 }
 
 void PiiPisoController::passTag()
 {
-  PiiVariant tag = _lstGroups[0][0]->firstObject();
+  PiiVariant tag = _vecGroups[0][0]->firstObject();
   for (int i=0; i<_lstOutputs.size(); ++i)
     _lstOutputs[i]->emitObject(tag);
 }
 
 PiiFlowController::FlowState PiiPisoController::prepareProcess()
 {
-  for (int g=_lstActiveGroups.size(); g--; )
+  for (int g=_vecGroups.size(); g--; )
     {
-      switch (int iTypeMask = inputGroupTypeMask(_lstActiveGroups[g].begin(), _lstActiveGroups[g].end()))
+      InputGroup& group = _vecGroups[g];
+      if (!group.bActive)
+        continue;
+      switch (int iTypeMask = inputGroupTypeMask(group.begin(), group.end(), group.iReadyInputs))
         {
         case NoObject:
           break;
         case NormalObject:
-          setActiveInputGroup(_lstActiveGroups[g].groupId());
-          _lstActiveGroups[g].shift();
+          setActiveInputGroup(group.groupId());
+          group.shift();
           return ProcessableState;
         case StartTag:
         case EndTag:
@@ -294,20 +301,23 @@ PiiFlowController::FlowState PiiPisoController::prepareProcess()
         case ReconfigurationTag:
           //qDebug("PiiPisoOperation %p: Type mask = 0x%x", this, iTypeMask);
           // We need to wait for tags in all groups before proceeding.
-          _lstActiveGroups[g].shift();
-          _lstActiveGroups.removeAt(g);
+          group.shift();
+          group.bActive = false;
+          --_iActiveGroupCount;
           _iTagMask |= iTypeMask;
           break;
         default:
           PII_THROW(PiiExecutionException, tr("Synchronization error at input group %1.\n%2")
-                    .arg(_lstActiveGroups[g].groupId())
-                    .arg(dumpInputObjects(_lstActiveGroups[g].begin(), _lstActiveGroups[g].end())));
+                    .arg(group.groupId())
+                    .arg(dumpInputObjects(group.begin(), group.end())));
         }
     }
   // Tags in all groups
-  if (_lstActiveGroups.size() == 0)
+  if (_iActiveGroupCount == 0)
     {
-      _lstActiveGroups = _lstGroups;
+      for (int g=_vecGroups.size(); g--; )
+        _vecGroups[g].bActive = true;
+      _iActiveGroupCount = _vecGroups.size();
       //qDebug("PiiPisoOperation %p: All groups tagged. Type mask = 0x%x", this, _iTagMask);
       switch (_iTagMask)
         {
@@ -319,7 +329,7 @@ PiiFlowController::FlowState PiiPisoController::prepareProcess()
         case PauseTag:
           return PausedState;
         case ReconfigurationTag:
-          setPropertySetName(_lstGroups[0][0]->firstObject().valueAs<QString>());
+          setPropertySetName(_vecGroups[0][0]->firstObject().valueAs<QString>());
           return ReconfigurableState;
         case StopTag:
           return FinishedState;
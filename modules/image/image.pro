@@ -8,7 +8,7 @@ enabled(fast) {
 qt {
   SOURCES += rawimage/*.cc
   HEADERS += rawimage/*.h
-  INCLUDEPATH += $$INTODIR/modules/camera/lib
+  INCLUDEPATH += $$INTODIR/modules/camera/lib $$INTODIR/modules/image/rawimage
   DEFINES += QT_STATICPLUGIN
 } else {
   LIBS -= -lpiidsp
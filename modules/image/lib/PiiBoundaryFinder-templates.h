@@ -18,6 +18,8 @@
 #endif
 
 #include <PiiMatrixUtil.h>
+#include "PiiObjectProperty.h"
+#include <algorithm>
 
 template <class T, class Matrix, class UnaryOp>
 QList<PiiMatrix<T> > PiiBoundaryFinder::findBoundaries(const Matrix& objects,
@@ -40,6 +42,118 @@ QList<PiiMatrix<T> > PiiBoundaryFinder::findBoundaries(const Matrix& objects,
   return result;
 }
 
+template <class Matrix, class UnaryOp>
+QList<PiiChainCode> PiiBoundaryFinder::findChainCodes(const Matrix& objects,
+                                                      UnaryOp rule,
+                                                      PiiMatrix<unsigned char>* boundaryMask)
+{
+  PiiBoundaryFinder finder(objects.rows(), objects.columns(), boundaryMask);
+
+  QList<PiiChainCode> result;
+  for (;;)
+    {
+      PiiChainCode chain;
+      if (finder.findNextChainCode(objects, rule, chain) == 0)
+        break;
+      result.push_back(chain);
+    }
+
+  return result;
+}
+
+/// @hide
+struct PiiBoundaryFinder::ObjectTracer
+{
+  ObjectTracer(const PiiMatrix<int>& labels,
+               const QVector<PiiImage::ObjectMoments>& objects,
+               QVector<QList<PiiChainCode> >& chains,
+               PiiMatrix<unsigned char>* boundaryMask) :
+    labels(labels), objects(objects), chains(chains),
+    maskRows(boundaryMask != 0 ? Pii::BandRows<unsigned char>(*boundaryMask) : Pii::BandRows<unsigned char>())
+  {}
+
+  void operator() (int firstObject, int objectCount)
+  {
+    for (int i=firstObject; i<firstObject+objectCount; ++i)
+      {
+        const PiiImage::ObjectMoments& object = objects[i];
+        if (object.area == 0)
+          continue;
+        const int iWidth = object.right - object.left + 1, iHeight = object.bottom - object.top + 1;
+        const PiiMatrix<int> matObject(labels(object.top, object.left, iHeight, iWidth));
+        PiiMatrix<unsigned char> matMask;
+        PiiBoundaryFinder finder(iHeight, iWidth, &matMask);
+        std::binder2nd<std::equal_to<int> > rule(std::equal_to<int>(), i+1);
+
+        // The first boundary found in the bounding box is the outer
+        // one. Its length is usually close to the perimeter of the
+        // box, and never more than twice the number of pixels.
+        PiiChainCode chain(0, 0);
+        chain.reserve(qMin(2 * object.area, 2 * (iWidth + iHeight)));
+        while (finder.findNextChainCode(matObject, rule, chain) != 0)
+          {
+            chain.translate(object.left, object.top);
+            chains[i] << chain;
+            chain = PiiChainCode();
+          }
+
+        // Objects never share boundary pixels. The marks can be
+        // copied without locking.
+        if (maskRows.data() != 0)
+          for (int r=0; r<iHeight; ++r)
+            {
+              const unsigned char* pSource = matMask[r];
+              unsigned char* pTarget = maskRows.row(object.top + r) + object.left;
+              for (int c=0; c<iWidth; ++c)
+                if (pSource[c] != 0)
+                  pTarget[c] = pSource[c];
+            }
+      }
+  }
+
+  const PiiMatrix<int>& labels;
+  const QVector<PiiImage::ObjectMoments>& objects;
+  QVector<QList<PiiChainCode> >& chains;
+  const Pii::BandRows<unsigned char> maskRows;
+};
+
+namespace PiiImage
+{
+  // Boundaries are found from bottom to top, right to left.
+  inline bool chainCodeFoundFirst(const PiiChainCode& a, const PiiChainCode& b)
+  {
+    return a.startY() > b.startY() || (a.startY() == b.startY() && a.startX() > b.startX());
+  }
+}
+/// @endhide
+
+template <class Matrix, class UnaryOp>
+QList<PiiChainCode> PiiBoundaryFinder::findChainCodes(const Pii::ParallelExecution& policy,
+                                                      const Matrix& objects,
+                                                      UnaryOp rule,
+                                                      PiiMatrix<unsigned char>* boundaryMask)
+{
+  PiiMatrix<int> matLabels;
+  QVector<PiiImage::ObjectMoments> vecObjects(PiiImage::measureObjects(objects, rule,
+                                                                         PiiImage::Connect8,
+                                                                         &matLabels));
+  if (boundaryMask != 0)
+    *boundaryMask = PiiMatrix<unsigned char>(objects.rows(), objects.columns());
+
+  QVector<QList<PiiChainCode> > vecChains(vecObjects.size());
+  Pii::forEachBand(policy, vecObjects.size(), 0,
+                   ObjectTracer(matLabels, vecObjects, vecChains, boundaryMask));
+
+  QList<PiiChainCode> result;
+  for (int i=0; i<vecChains.size(); ++i)
+    for (int j=0; j<vecChains[i].size(); ++j)
+      result << vecChains[i][j];
+  // The start points of the boundaries are unique and define the
+  // order in which the sequential algorithm finds them.
+  std::sort(result.begin(), result.end(), PiiImage::chainCodeFoundFirst);
+  return result;
+}
+
 template <class T, class Matrix>
 PiiMatrix<T> PiiBoundaryFinder::findBoundary(const Matrix& objects, typename Matrix::value_type label,
                                              PiiMatrix<unsigned char>* boundaryMask)
@@ -77,6 +191,19 @@ PiiMatrix<T> PiiBoundaryFinder::findNextBoundary(const Matrix& objects,
   return PiiMatrix<T>(0,2);
 }
 
+template <class Matrix, class UnaryOp>
+int PiiBoundaryFinder::findNextChainCode(const Matrix& objects,
+                                         UnaryOp rule,
+                                         PiiChainCode& chain)
+{
+  findNextUnhandledPoint(objects, rule);
+
+  if (d->iRow >= 0)
+    return findChainCode(objects, rule, d->iRow, d->iRightEdge, chain);
+
+  return 0;
+}
+
 template <class Matrix, class UnaryOp, class T>
 int PiiBoundaryFinder::findNextBoundary(const Matrix& objects,
                                         UnaryOp rule,
@@ -138,6 +265,27 @@ int PiiBoundaryFinder::findBoundary(const Matrix& objects,
                                     UnaryOp rule,
                                     int startR, int startC,
                                     PiiMatrix<T>& points)
+{
+  PointSink<T> sink(points);
+  return traceBoundary(objects, rule, startR, startC, sink);
+}
+
+template <class Matrix, class UnaryOp>
+int PiiBoundaryFinder::findChainCode(const Matrix& objects,
+                                     UnaryOp rule,
+                                     int startR, int startC,
+                                     PiiChainCode& chain)
+{
+  chain.setStart(startC, startR);
+  ChainSink sink(chain);
+  return traceBoundary(objects, rule, startR, startC, sink);
+}
+
+template <class Matrix, class UnaryOp, class Sink>
+int PiiBoundaryFinder::traceBoundary(const Matrix& objects,
+                                     UnaryOp rule,
+                                     int startR, int startC,
+                                     Sink& sink)
 {
   // Directions to go along the boundary. The last number is the
   // minimum number of turns (clockwise) at a given direction that
@@ -175,7 +323,7 @@ int PiiBoundaryFinder::findBoundary(const Matrix& objects,
   int iPoints = 0;
 
   // Start looking down
-  int currentDir = 2;
+  int currentDir = 2, iFirstDir = -1;
   // Test directions clockwise. Go to the first boundary point
   // found. The magic equation defines the first possible location
   // of the next boundary point. For even angles it is one turn
@@ -195,8 +343,9 @@ int PiiBoundaryFinder::findBoundary(const Matrix& objects,
               rule(objects(testR, testC)))
             {
               // Add to the list of boundary points
-              points.appendRow(T(c), T(r));
-              ++iPoints;
+              sink.addMove(c, r, dirIndex & 0x7);
+              if (iPoints++ == 0)
+                iFirstDir = dirIndex & 0x7;
 
               int turns = dirIndex - firstPossibleDir;
 
@@ -249,7 +398,7 @@ int PiiBoundaryFinder::findBoundary(const Matrix& objects,
     }
   while (r != startR || c != startC);
 
-  points.appendRow(T(startC), T(startR));
+  sink.close(startC, startR);
   ++iPoints;
 
   // Special case: only one pixel
@@ -257,13 +406,8 @@ int PiiBoundaryFinder::findBoundary(const Matrix& objects,
     (*d->pmatBoundaryMask)(r,c) = 3;
   // Special case: boundary start point is a double edge.
   // Starts SE, ends NE
-  else if (currentDir == 7)
-    {
-      int iFirstRow = points.rows() - iPoints;
-      if (points(iFirstRow+1,0) - points(iFirstRow,0) == 1 &&
-          points(iFirstRow+1,1) - points(iFirstRow,1) == 1)
-        (*d->pmatBoundaryMask)(startR, startC) = 3;
-    }
+  else if (currentDir == 7 && iFirstDir == 1)
+    (*d->pmatBoundaryMask)(startR, startC) = 3;
 
   return iPoints;
 }
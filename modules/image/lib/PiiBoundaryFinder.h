@@ -14,7 +14,9 @@
  */
 
 #include "PiiImageGlobal.h"
+#include "PiiChainCode.h"
 #include <PiiMatrix.h>
+#include <PiiParallel.h>
 #include <QList>
 
 #ifndef _PIIBOUNDARYFINDER_H
@@ -26,7 +28,9 @@
  * The algorithm extacts both outer and inner boundaries in the order
  * they are first found in the image. Each boundary is represented as
  * a matrix in which each row stores the (x,y) coordinates of a pixel
- * on the boundary.
+ * on the boundary. Alternatively, boundaries can be stored as
+ * [PiiChainCode]s, which take about an eighth of the memory and can
+ * be converted to coordinates later.
  *
  */
 class PII_IMAGE_EXPORT PiiBoundaryFinder
@@ -76,6 +80,17 @@ public:
   template <class Matrix, class UnaryOp, class T>
   int findNextBoundary(const Matrix& objects, UnaryOp rule, PiiMatrix<T>& points);
 
+  /**
+   * Finds the next unhandled boundary and stores it to *chain*.
+   * Boundaries are found in the same order as with
+   * [findNextBoundary()].
+   *
+   * @return the number of boundary points (`chain.pointCount()`),
+   * or zero if no more boundaries can be found.
+   */
+  template <class Matrix, class UnaryOp>
+  int findNextChainCode(const Matrix& objects, UnaryOp rule, PiiChainCode& chain);
+
   /**
    * Returns the boundary mask. After each iteration
    * ([findNextBoundary()]), all detected boundaries are marked into
@@ -116,6 +131,20 @@ public:
                    int startR, int startC,
                    PiiMatrix<T>& points);
 
+  /**
+   * Extracts the boundary of an object starting at (*startR*,
+   * *startC*) as a chain code. Otherwise equivalent to
+   * [findBoundary()]. The moves will be appended to *chain*, and its
+   * start point will be set to (*startC*, *startR*).
+   *
+   * @return the number of boundary points found
+   */
+  template <class Matrix, class UnaryOp>
+  int findChainCode(const Matrix& objects,
+                    UnaryOp rule,
+                    int startR, int startC,
+                    PiiChainCode& chain);
+
   /**
    * A convenience function that returns the outer boundary of a
    * single labeled object.
@@ -181,6 +210,41 @@ public:
                                              UnaryOp rule,
                                              PiiMatrix<unsigned char>* boundaryMask = 0);
 
+  /**
+   * Extracts all outer and inner boundaries as chain codes. The
+   * order of the boundaries and the boundary mask are the same as
+   * with [findBoundaries()].
+   */
+  template <class Matrix, class UnaryOp>
+  static QList<PiiChainCode> findChainCodes(const Matrix& objects,
+                                            UnaryOp rule,
+                                            PiiMatrix<unsigned char>* boundaryMask = 0);
+
+  /**
+   * Extracts all outer and inner boundaries as chain codes, tracing
+   * independent objects in parallel. The objects are first labeled
+   * with 8-connectivity (the connectivity of the traced boundaries),
+   * and the boundaries of each object are traced within its
+   * bounding box. The object sizes are used to preallocate the
+   * chains. The result, including the boundary mask, is identical to
+   * that of the sequential version.
+   *
+   * This function pays off with large images and many objects. With
+   * a few large objects, there is not much to parallelize.
+   *
+   * ~~~(c++)
+   * QList<PiiChainCode> lstChains =
+   *   PiiBoundaryFinder::findChainCodes(Pii::ParallelExecution(), image,
+   *                                     std::bind2nd(std::greater<int>(), 0));
+   * PiiMatrix<int> matPoints(lstChains[0].toPoints<int>());
+   * ~~~
+   */
+  template <class Matrix, class UnaryOp>
+  static QList<PiiChainCode> findChainCodes(const Pii::ParallelExecution& policy,
+                                            const Matrix& objects,
+                                            UnaryOp rule,
+                                            PiiMatrix<unsigned char>* boundaryMask = 0);
+
 private:
   /// @internal
   class Data
@@ -204,6 +268,35 @@ private:
   template <class Matrix, class UnaryOp>
   void findNextUnhandledPoint(const Matrix& objects,
                               UnaryOp rule);
+
+  /**
+   * Traverses a boundary and reports each move to *sink*.
+   */
+  template <class Matrix, class UnaryOp, class Sink>
+  int traceBoundary(const Matrix& objects,
+                    UnaryOp rule,
+                    int startR, int startC,
+                    Sink& sink);
+
+  /// @hide
+  template <class T> struct PointSink
+  {
+    PointSink(PiiMatrix<T>& points) : points(points) {}
+    void addMove(int c, int r, int) { points.appendRow(T(c), T(r)); }
+    void close(int c, int r) { points.appendRow(T(c), T(r)); }
+    PiiMatrix<T>& points;
+  };
+
+  struct ChainSink
+  {
+    ChainSink(PiiChainCode& chain) : chain(chain) {}
+    void addMove(int, int, int direction) { chain.append(direction); }
+    void close(int, int) {}
+    PiiChainCode& chain;
+  };
+
+  struct ObjectTracer;
+  /// @endhide
 };
 
 #include "PiiBoundaryFinder-templates.h"
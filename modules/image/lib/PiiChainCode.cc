@@ -0,0 +1,33 @@
+/* This file is part of Into.
+ * Copyright (C) Intopii 2013.
+ * All rights reserved.
+ *
+ * Licensees holding a commercial Into license may use this file in
+ * accordance with the commercial license agreement. Please see
+ * LICENSE.commercial for commercial licensing terms.
+ *
+ * Alternatively, this file may be used under the terms of the GNU
+ * Affero General Public License version 3 as published by the Free
+ * Software Foundation. In addition, Intopii gives you special rights
+ * to use Into as a part of open source software projects. Please
+ * refer to LICENSE.AGPL3 for details.
+ */
+
+
+#include "PiiChainCode.h"
+
+const int PiiChainCode::aDirections[8][2] =
+  {
+    { 1,  0}, //E
+    { 1,  1}, //SE
+    { 0,  1}, //S
+    {-1,  1}, //SW
+    {-1,  0}, //W
+    {-1, -1}, //NW
+    { 0, -1}, //N
+    { 1, -1}  //NE
+  };
+
+PiiChainCode::PiiChainCode(int startX, int startY) :
+  _iStartX(startX), _iStartY(startY)
+{}
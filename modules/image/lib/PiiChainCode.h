@@ -0,0 +1,153 @@
+/* This file is part of Into.
+ * Copyright (C) Intopii 2013.
+ * All rights reserved.
+ *
+ * Licensees holding a commercial Into license may use this file in
+ * accordance with the commercial license agreement. Please see
+ * LICENSE.commercial for commercial licensing terms.
+ *
+ * Alternatively, this file may be used under the terms of the GNU
+ * Affero General Public License version 3 as published by the Free
+ * Software Foundation. In addition, Intopii gives you special rights
+ * to use Into as a part of open source software projects. Please
+ * refer to LICENSE.AGPL3 for details.
+ */
+
+
+#ifndef _PIICHAINCODE_H
+#define _PIICHAINCODE_H
+
+#include "PiiImageGlobal.h"
+#include <PiiMatrix.h>
+#include <QVector>
+
+/**
+ * A boundary stored as a start point and a sequence of 8-connected
+ * moves (Freeman chain code). Each move takes one byte, whereas a
+ * coordinate matrix takes two `int`s per point. [PiiBoundaryFinder]
+ * can trace boundaries directly into chain codes, and conversion to
+ * coordinates can be delayed until someone actually needs the
+ * points.
+ *
+ * The directions are numbered clockwise in image coordinates (y
+ * grows downwards), starting from east:
+ *
+ * ~~~
+ * 5 6 7
+ * 4 x 0
+ * 3 2 1
+ * ~~~
+ */
+class PII_IMAGE_EXPORT PiiChainCode
+{
+public:
+  /**
+   * Creates a chain code that starts at (*startX*, *startY*) and
+   * has no moves.
+   */
+  PiiChainCode(int startX = 0, int startY = 0);
+
+  /**
+   * Returns the x coordinate of the start point.
+   */
+  int startX() const { return _iStartX; }
+  /**
+   * Returns the y coordinate of the start point.
+   */
+  int startY() const { return _iStartY; }
+  /**
+   * Sets the start point.
+   */
+  void setStart(int x, int y) { _iStartX = x; _iStartY = y; }
+  /**
+   * Moves the start point, and thus the whole boundary, by (*dx*,
+   * *dy*).
+   */
+  void translate(int dx, int dy) { _iStartX += dx; _iStartY += dy; }
+
+  /**
+   * Returns the number of moves.
+   */
+  int length() const { return _vecCodes.size(); }
+  /**
+   * Returns the number of points the chain code represents,
+   * including the start point. This is the number of rows
+   * [appendPoints()] adds.
+   */
+  int pointCount() const { return _vecCodes.size() + 1; }
+  /**
+   * Returns the direction of the move at *index*.
+   */
+  int code(int index) const { return _vecCodes[index]; }
+  /**
+   * Returns all moves.
+   */
+  QVector<unsigned char> codes() const { return _vecCodes; }
+
+  /**
+   * Adds a move to *direction* (0-7) to the end of the chain.
+   */
+  void append(int direction) { _vecCodes.append((unsigned char)direction); }
+  /**
+   * Reserves space for *moves* moves.
+   */
+  void reserve(int moves) { _vecCodes.reserve(moves); }
+  /**
+   * Removes all moves.
+   */
+  void clear() { _vecCodes.clear(); }
+
+  /**
+   * Appends the coordinates of the start point and the end point of
+   * each move to *points*, an N-by-2 matrix with the x and y
+   * coordinates of a point on each row. For a closed boundary, the
+   * last point equals the first one.
+   *
+   * @return the number of rows appended ([pointCount()])
+   */
+  template <class T> int appendPoints(PiiMatrix<T>& points) const;
+
+  /**
+   * Returns the points as a [pointCount()]-by-2 matrix.
+   */
+  template <class T> PiiMatrix<T> toPoints() const
+  {
+    PiiMatrix<T> matPoints(0, 2);
+    matPoints.reserve(pointCount());
+    appendPoints(matPoints);
+    return matPoints;
+  }
+
+  /**
+   * Returns the change of the x coordinate when moving to
+   * *direction*.
+   */
+  static int dx(int direction) { return aDirections[direction][0]; }
+  /**
+   * Returns the change of the y coordinate when moving to
+   * *direction*.
+   */
+  static int dy(int direction) { return aDirections[direction][1]; }
+
+private:
+  static const int aDirections[8][2];
+
+  int _iStartX, _iStartY;
+  QVector<unsigned char> _vecCodes;
+};
+
+template <class T> int PiiChainCode::appendPoints(PiiMatrix<T>& points) const
+{
+  int iX = _iStartX, iY = _iStartY;
+  points.appendRow(T(iX), T(iY));
+  const unsigned char* pCodes = _vecCodes.constData();
+  for (int i=0; i<_vecCodes.size(); ++i)
+    {
+      iX += aDirections[pCodes[i]][0];
+      iY += aDirections[pCodes[i]][1];
+      points.appendRow(T(iX), T(iY));
+    }
+  return _vecCodes.size() + 1;
+}
+
+#endif //_PIICHAINCODE_H
@@ -17,10 +17,10 @@
 #define _PIICLOUDFRACTALGENERATOR_H
 
 #include <PiiMath.h>
-#include <cstdlib>
+#include <PiiRandomGenerator.h>
 
 // Generate a randon number between -roughness and roughness.
-#define PII_FRAC_RAND(roughness)      ((rand() - RAND_MAX/2) % int(roughness))
+#define PII_FRAC_RAND(roughness)      ((int(_generator.next() >> 1) - 0x3fffffff) % int(roughness))
 // Truncate a value to allowed range
 #define PII_FRAC_TRUNC(a)             ((a) < _iMinimum ? _iMinimum : (a) > _iMaximum ? _iMaximum : T(a))
 // Given three points a,b,c so that b is midway between a and c,
@@ -51,14 +51,26 @@ public:
    *
    * @param maximum the maximum allowed value for the generated
    * fractal.
+   *
+   * The random number generator is initially seeded from
+   * PiiRandomGenerator::threadInstance(). Use [setSeed()] to generate
+   * reproducible fractals.
    */
   PiiCloudFractalGenerator(float roughnessScale = 0.5,
                            int minimum = 0, int maximum = 255) :
     _fRoughnessScale(roughnessScale),
     _iMinimum(minimum), _iMaximum(maximum),
-    _iTargetMean(-1), _iTargetMean3(0)
+    _iTargetMean(-1), _iTargetMean3(0),
+    _generator(PiiRandomGenerator::threadInstance().next())
   {}
 
+  /**
+   * Seeds the random number generator. Generators with the same seed
+   * and parameters produce the same fractals. Fractals generated in
+   * parallel should use different *stream* numbers.
+   */
+  void setSeed(quint64 seed, quint64 stream = 0) { _generator.setSeed(seed, stream); }
+
   /**
    * Generate a square piece of fractal into the given buffer. It the
    * buffer already has data in it, the fractal will be seamlessly
@@ -174,6 +186,7 @@ private:
   float _fRoughnessScale;
   int _iMinimum, _iMaximum;
   int _iTargetMean, _iTargetMean3;
+  PiiRandomGenerator _generator;
 };
 
 template <class T>
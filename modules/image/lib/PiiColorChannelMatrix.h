@@ -0,0 +1,164 @@
+/* This file is part of Into.
+ * Copyright (C) Intopii 2013.
+ * All rights reserved.
+ *
+ * Licensees holding a commercial Into license may use this file in
+ * accordance with the commercial license agreement. Please see
+ * LICENSE.commercial for commercial licensing terms.
+ *
+ * Alternatively, this file may be used under the terms of the GNU
+ * Affero General Public License version 3 as published by the Free
+ * Software Foundation. In addition, Intopii gives you special rights
+ * to use Into as a part of open source software projects. Please
+ * refer to LICENSE.AGPL3 for details.
+ */
+
+#ifndef _PIICOLORCHANNELMATRIX_H
+#define _PIICOLORCHANNELMATRIX_H
+
+#include <PiiMatrix.h>
+#include <PiiColor.h>
+
+/// @hide
+// Moves column iterators from row to row. The stride is counted in
+// bytes, as with pointers.
+template <class T> struct PiiStrideHandler<PiiMatrixColumnIterator<T> >
+{
+  static inline PiiMatrixColumnIterator<T> add(const PiiMatrixColumnIterator<T>& it, std::size_t offset)
+  {
+    return PiiMatrixColumnIterator<T>((T*)((char*)(it.ptr()) + offset), it.stride());
+  }
+
+  static inline int rowDiff(const PiiMatrixColumnIterator<T>& it1,
+                            const PiiMatrixColumnIterator<T>& it2,
+                            std::size_t stride)
+  {
+    return ((char*)(it1.ptr()) - (char*)(it2.ptr())) / std::ptrdiff_t(stride);
+  }
+};
+
+template <class ColorType> class PiiColorChannelMatrix;
+template <class ColorType> struct PiiMatrixTraits<PiiColorChannelMatrix<ColorType> >
+{
+  enum { staticRows = -1, staticColumns = -1 };
+
+  typedef typename ColorType::Type value_type;
+  typedef const value_type& reference;
+  typedef PiiMatrixColumnIterator<const value_type> const_row_iterator;
+  typedef const_row_iterator row_iterator;
+  typedef PiiMatrixColumnIterator<const value_type> const_column_iterator;
+  typedef const_column_iterator column_iterator;
+  typedef PiiMatrixIterator<const_row_iterator> const_iterator;
+  typedef const_iterator iterator;
+};
+/// @endhide
+
+/**
+ * A read-only view to one channel of an interleaved color image. The
+ * view shares the data of the color image and makes it accessible as
+ * a matrix of color channel values without copying. Elements are
+ * accessed through strided row and column iterators, and the view
+ * can be used wherever a [PiiConceptualMatrix] is accepted.
+ *
+ * Since PiiMatrix is implicitly shared, the view keeps the image
+ * data alive. Modifying the original image after creating a view
+ * detaches the image, and the view keeps seeing the old data.
+ *
+ * ~~~(c++)
+ * PiiMatrix<PiiColor4<> > image(480, 640);
+ * PiiColorChannelMatrix<PiiColor4<> > green(image, 1);
+ * // No copies so far. Sum over the green channel:
+ * int iSum = Pii::sum<int>(green);
+ * // Convert to a normal matrix
+ * PiiMatrix<unsigned char> matGreen(green);
+ * ~~~
+ */
+template <class ColorType> class PiiColorChannelMatrix :
+  public PiiConceptualMatrix<PiiColorChannelMatrix<ColorType> >
+{
+public:
+  typedef PiiMatrixTraits<PiiColorChannelMatrix<ColorType> > Traits;
+  typedef typename ColorType::Type ChannelType;
+
+  /**
+   * Creates a view to the color channel at *channel* in *image*. The
+   * channel index is zero-based: 0 means `c0`, 1 means `c1` and so
+   * on. With PiiColor4, *channel* may be 3.
+   */
+  PiiColorChannelMatrix(const PiiMatrix<ColorType>& image, int channel) :
+    _image(image),
+    // Reverse color indexing
+    _iChannel((2-channel) & 3)
+  {}
+
+  typename Traits::const_iterator begin() const
+  {
+    return typename Traits::const_iterator(rowBegin(0), columns(), _image.stride());
+  }
+  typename Traits::const_iterator end() const
+  {
+    return typename Traits::const_iterator(rowBegin(0), rowBegin(rows()), columns(), _image.stride());
+  }
+
+  typename Traits::const_row_iterator rowBegin(int index) const
+  {
+    return typename Traits::const_row_iterator(channelPtr(index, 0), sizeof(ColorType));
+  }
+  typename Traits::const_row_iterator rowEnd(int index) const
+  {
+    return rowBegin(index) + columns();
+  }
+
+  typename Traits::const_column_iterator columnBegin(int index) const
+  {
+    return typename Traits::const_column_iterator(channelPtr(0, index), _image.stride());
+  }
+  typename Traits::const_column_iterator columnEnd(int index) const
+  {
+    return columnBegin(index) + rows();
+  }
+
+  int rows() const { return _image.rows(); }
+  int columns() const { return _image.columns(); }
+
+  /**
+   * Returns the zero-based index of the color channel.
+   */
+  int channel() const { return (2-_iChannel) & 3; }
+
+  /**
+   * Returns the color image this view refers to.
+   */
+  PiiMatrix<ColorType> image() const { return _image; }
+
+private:
+  const ChannelType* channelPtr(int row, int column) const
+  {
+    return reinterpret_cast<const ChannelType*>(_image.row(row) + column) + _iChannel;
+  }
+
+  PiiMatrix<ColorType> _image;
+  int _iChannel;
+};
+
+namespace PiiImage
+{
+  /**
+   * Returns a view to a color channel in *image*. Unlike
+   * [colorChannel()], this function does not copy the data.
+   *
+   * ~~~(c++)
+   * PiiMatrix<PiiColor<> > image(5,5);
+   * double dMeanRed = Pii::mean<double>(PiiImage::channelView(image, 0));
+   * ~~~
+   *
+   * @relates PiiColorChannelMatrix
+   */
+  template <class ColorType>
+  inline PiiColorChannelMatrix<ColorType> channelView(const PiiMatrix<ColorType>& image, int channel)
+  {
+    return PiiColorChannelMatrix<ColorType>(image, channel);
+  }
+}
+
+#endif //_PIICOLORCHANNELMATRIX_H
@@ -0,0 +1,178 @@
+/* This file is part of Into.
+ * Copyright (C) Intopii 2013.
+ * All rights reserved.
+ *
+ * Licensees holding a commercial Into license may use this file in
+ * accordance with the commercial license agreement. Please see
+ * LICENSE.commercial for commercial licensing terms.
+ *
+ * Alternatively, this file may be used under the terms of the GNU
+ * Affero General Public License version 3 as published by the Free
+ * Software Foundation. In addition, Intopii gives you special rights
+ * to use Into as a part of open source software projects. Please
+ * refer to LICENSE.AGPL3 for details.
+ */
+
+#ifndef _PIIEXTREMUMFILTER_H
+#define _PIIEXTREMUMFILTER_H
+
+#include <PiiMatrix.h>
+#include <QVarLengthArray>
+#include <algorithm>
+
+namespace PiiImage
+{
+  /// @hide
+  template <class T, class GreaterThan>
+  inline T extremumOf(GreaterThan greater, T a, T b) { return greater(b, a) ? b : a; }
+  /// @hide
+
+  /**
+   * Computes the extremum of a sliding window over *count* elements
+   * using the van Herk/Gil-Werman algorithm. The padded input is
+   * divided into blocks of *window* elements, and the extremum of a
+   * window is found by combining a suffix extremum of one block with
+   * a prefix extremum of the next. This takes three comparisons per
+   * element independent of the window length.
+   *
+   * @param input the input elements
+   *
+   * @param output *count* output elements. `output[i]` will be the
+   * extremum of `input[i-offset]` ... `input[i-offset+window-1]`.
+   * May not overlap with *input*.
+   *
+   * @param window the length of the window, at least one
+   *
+   * @param offset the number of window elements before the current
+   * one, in [0, window-1].
+   *
+   * @param greater a binary predicate that returns `true` if its
+   * first argument is "more extreme" than the second one.
+   * `std::greater` finds the maximum, `std::less` the minimum.
+   *
+   * @param padding the value assumed outside of *input*
+   *
+   * @param buffer temporary storage for at least `count + window -
+   * 1` elements
+   */
+  template <class T, class GreaterThan>
+  void slidingExtremum(const T* input, T* output, int count,
+                       int window, int offset,
+                       GreaterThan greater, T padding,
+                       T* buffer)
+  {
+    const int iPaddedCount = count + window - 1;
+    // Suffix extrema of each block, from right to left.
+    for (int i=iPaddedCount; i--; )
+      {
+        const T value = i >= offset && i < offset + count ? input[i - offset] : padding;
+        buffer[i] = i == iPaddedCount-1 || (i+1) % window == 0 ?
+          value : extremumOf(greater, buffer[i+1], value);
+      }
+    // Prefix extrema, combined with the suffixes on the fly.
+    T prefix = padding;
+    for (int i=0; i<iPaddedCount; ++i)
+      {
+        const T value = i >= offset && i < offset + count ? input[i - offset] : padding;
+        prefix = i % window == 0 ? value : extremumOf(greater, prefix, value);
+        if (i >= window-1)
+          output[i-window+1] = extremumOf(greater, buffer[i-window+1], prefix);
+      }
+  }
+
+  /**
+   * Computes the extremum of a *windowRows*-by-*windowColumns*
+   * rectangular neighborhood for each pixel in *image*. The filter
+   * is separated into horizontal and vertical passes, both of which
+   * use [slidingExtremum()]. The computational cost per pixel is
+   * therefore independent of the window size.
+   *
+   * @param image the input image
+   *
+   * @param windowRows the height of the window, at least one
+   *
+   * @param windowColumns the width of the window, at least one
+   *
+   * @param topRows the number of window rows above the current pixel
+   *
+   * @param leftColumns the number of window columns left of the
+   * current pixel
+   *
+   * @param greater the comparison predicate, see [slidingExtremum()].
+   *
+   * @param padding the value assumed outside of *image*
+   *
+   * @return a matrix of the same size as *image*
+   */
+  template <class T, class GreaterThan>
+  PiiMatrix<T> separableExtremum(const PiiMatrix<T>& image,
+                                 int windowRows, int windowColumns,
+                                 int topRows, int leftColumns,
+                                 GreaterThan greater, T padding)
+  {
+    const int iRows = image.rows(), iCols = image.columns();
+    if (iRows == 0 || iCols == 0)
+      return PiiMatrix<T>(iRows, iCols);
+
+    PiiMatrix<T> matHorizontal;
+    if (windowColumns > 1)
+      {
+        matHorizontal = PiiMatrix<T>::uninitialized(iRows, iCols);
+        QVarLengthArray<T,256> bfr(iCols + windowColumns - 1);
+        for (int r=0; r<iRows; ++r)
+          slidingExtremum(image[r], matHorizontal[r], iCols,
+                          windowColumns, leftColumns,
+                          greater, padding, bfr.data());
+      }
+    else
+      matHorizontal = image;
+
+    if (windowRows <= 1)
+      return matHorizontal;
+
+    // The vertical pass processes whole rows at a time to keep memory
+    // access sequential.
+    const int iPaddedRows = iRows + windowRows - 1;
+    PiiMatrix<T> matSuffix(PiiMatrix<T>::uninitialized(iPaddedRows, iCols));
+    PiiMatrix<T> matResult(PiiMatrix<T>::uninitialized(iRows, iCols));
+    QVarLengthArray<T,256> paddingRow(iCols), prefixRow(iCols);
+    std::fill(paddingRow.data(), paddingRow.data() + iCols, padding);
+
+    for (int r=iPaddedRows; r--; )
+      {
+        const T* pInput = r >= topRows && r < topRows + iRows ?
+          matHorizontal[r - topRows] : paddingRow.data();
+        T* pSuffix = matSuffix[r];
+        if (r == iPaddedRows-1 || (r+1) % windowRows == 0)
+          std::copy(pInput, pInput + iCols, pSuffix);
+        else
+          {
+            const T* pPrevious = matSuffix[r+1];
+            for (int c=0; c<iCols; ++c)
+              pSuffix[c] = extremumOf(greater, pPrevious[c], pInput[c]);
+          }
+      }
+
+    T* pPrefix = prefixRow.data();
+    for (int r=0; r<iPaddedRows; ++r)
+      {
+        const T* pInput = r >= topRows && r < topRows + iRows ?
+          matHorizontal[r - topRows] : paddingRow.data();
+        if (r % windowRows == 0)
+          std::copy(pInput, pInput + iCols, pPrefix);
+        else
+          for (int c=0; c<iCols; ++c)
+            pPrefix[c] = extremumOf(greater, pPrefix[c], pInput[c]);
+        if (r >= windowRows-1)
+          {
+            const T* pSuffix = matSuffix[r-windowRows+1];
+            T* pOutput = matResult[r-windowRows+1];
+            for (int c=0; c<iCols; ++c)
+              pOutput[c] = extremumOf(greater, pSuffix[c], pPrefix[c]);
+          }
+      }
+    return matResult;
+  }
+}
+
+#endif //_PIIEXTREMUMFILTER_H
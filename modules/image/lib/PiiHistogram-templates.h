@@ -22,23 +22,356 @@
 
 namespace PiiImage
 {
+  /// @hide
+  template <class T, class Roi>
+  void addToHistogram(const PiiMatrix<unsigned char>& image, const Roi& roi,
+                      int firstRow, int lastRow, unsigned int levels, T* bins, Pii::True)
+  {
+    // Four sub-histograms, one for each pixel in a group of four
+    // consecutive pixels. A run of equal pixel values makes a single
+    // counter a serial dependency chain.
+    unsigned int aBanks[4][256];
+    memset(aBanks, 0, sizeof(aBanks));
+    const int iCols = image.columns();
+    for (int r=firstRow; r<lastRow; ++r)
+      {
+        const unsigned char* row = image.row(r);
+        int c = 0;
+        for (; c<iCols-3; c+=4)
+          {
+            aBanks[0][row[c]] += roi(r,c) ? 1u : 0u;
+            aBanks[1][row[c+1]] += roi(r,c+1) ? 1u : 0u;
+            aBanks[2][row[c+2]] += roi(r,c+2) ? 1u : 0u;
+            aBanks[3][row[c+3]] += roi(r,c+3) ? 1u : 0u;
+          }
+        for (; c<iCols; ++c)
+          aBanks[0][row[c]] += roi(r,c) ? 1u : 0u;
+      }
+    const unsigned int iLevels = qMin(levels, 256u);
+    for (unsigned int i=0; i<iLevels; ++i)
+      bins[i] += T(aBanks[0][i] + aBanks[1][i] + aBanks[2][i] + aBanks[3][i]);
+  }
+
+  template <class T, class U, class Roi>
+  void addToHistogram(const PiiMatrix<U>& image, const Roi& roi,
+                      int firstRow, int lastRow, unsigned int levels, T* bins, Pii::False)
+  {
+    const int iCols = image.columns();
+    for (int r=firstRow; r<lastRow; ++r)
+      {
+        const U* row = image.row(r);
+        for (int c=0; c<iCols; ++c)
+          if (unsigned(row[c]) < levels && roi(r,c)) ++bins[unsigned(row[c])];
+      }
+  }
+
+  template <class T, class U, class Roi>
+  inline void addToHistogram(const PiiMatrix<U>& image, const Roi& roi,
+                             int firstRow, int lastRow, unsigned int levels, T* bins)
+  {
+    addToHistogram(image, roi, firstRow, lastRow, levels, bins, Pii::IsSame<U,unsigned char>());
+  }
+
+  template <class T, class U>
+  void addRunsToHistogram(const PiiMatrix<U>& image, const RunLengthRoi& roi,
+                          int firstRow, int lastRow, unsigned int levels, T* bins, Pii::True)
+  {
+    // Same banking as with pixel-wise ROIs, but only covered spans
+    // are visited.
+    unsigned int aBanks[4][256];
+    memset(aBanks, 0, sizeof(aBanks));
+    for (int r=firstRow; r<lastRow; ++r)
+      {
+        const unsigned char* row = image.row(r);
+        for (const RunLengthRoi::Run* pRun = roi.runBegin(r); pRun != roi.runEnd(r); ++pRun)
+          {
+            int c = pRun->start;
+            for (; c<pRun->end-3; c+=4)
+              {
+                ++aBanks[0][row[c]];
+                ++aBanks[1][row[c+1]];
+                ++aBanks[2][row[c+2]];
+                ++aBanks[3][row[c+3]];
+              }
+            for (; c<pRun->end; ++c)
+              ++aBanks[0][row[c]];
+          }
+      }
+    const unsigned int iLevels = qMin(levels, 256u);
+    for (unsigned int i=0; i<iLevels; ++i)
+      bins[i] += T(aBanks[0][i] + aBanks[1][i] + aBanks[2][i] + aBanks[3][i]);
+  }
+
+  template <class T, class U>
+  void addRunsToHistogram(const PiiMatrix<U>& image, const RunLengthRoi& roi,
+                          int firstRow, int lastRow, unsigned int levels, T* bins, Pii::False)
+  {
+    for (int r=firstRow; r<lastRow; ++r)
+      {
+        const U* row = image.row(r);
+        for (const RunLengthRoi::Run* pRun = roi.runBegin(r); pRun != roi.runEnd(r); ++pRun)
+          for (int c=pRun->start; c<pRun->end; ++c)
+            if (unsigned(row[c]) < levels) ++bins[unsigned(row[c])];
+      }
+  }
+
+  template <class T, class U>
+  inline void addToHistogram(const PiiMatrix<U>& image, const RunLengthRoi& roi,
+                             int firstRow, int lastRow, unsigned int levels, T* bins)
+  {
+    addRunsToHistogram(image, roi, firstRow, lastRow, levels, bins, Pii::IsSame<U,unsigned char>());
+  }
+
+  template <class T, class U, class Roi> struct HistogramBand
+  {
+    HistogramBand(const PiiMatrix<U>& image, const Roi& roi, unsigned int levels,
+                  int chunkRows, PiiMatrix<T>& partials) :
+      image(image), roi(roi), levels(levels), iChunkRows(chunkRows),
+      partialRows(partials)
+    {}
+
+    void operator() (int firstChunk, int chunkCount)
+    {
+      // Each band owns the partial histogram at its first chunk.
+      addToHistogram(image, roi,
+                     firstChunk * iChunkRows,
+                     qMin(image.rows(), (firstChunk + chunkCount) * iChunkRows),
+                     levels,
+                     partialRows.row(firstChunk));
+    }
+
+    const PiiMatrix<U>& image;
+    const Roi& roi;
+    const unsigned int levels;
+    const int iChunkRows;
+    const Pii::BandRows<T> partialRows;
+  };
+  /// @endhide
+
   template <class T, class U, class Roi> PiiMatrix<T> histogram(const PiiMatrix<U>& image, const Roi& roi, unsigned int levels)
   {
     if (levels < 1)
       levels = unsigned(Pii::max(image)) + 1;
     PiiMatrix<T> result(1, int(levels));
-    T* vector = result.row(0);
+    addToHistogram(image, roi, 0, image.rows(), levels, result.row(0));
+    return result;
+  }
 
-    const int iRows = image.rows(), iCols = image.columns();
-    for (int r=0; r<iRows; ++r)
+  template <class T, class U, class Roi> PiiMatrix<T> histogram(const Pii::ParallelExecution& policy,
+                                                               const PiiMatrix<U>& image,
+                                                               const Roi& roi,
+                                                               unsigned int levels)
+  {
+    if (levels < 1)
+      levels = unsigned(Pii::max(image)) + 1;
+    // Rows are grouped into at most 64 chunks so that the partial
+    // histograms take a bounded amount of memory.
+    const int iRows = image.rows(),
+      iChunkRows = qMax(qMax(policy.minBandRows, 1), (iRows + 63) / 64),
+      iChunks = (iRows + iChunkRows - 1) / iChunkRows;
+    if (iChunks < 2)
+      return histogram<T,U,Roi>(image, roi, levels);
+
+    PiiMatrix<T> matPartials(iChunks, int(levels));
+    Pii::ParallelExecution chunkPolicy(policy);
+    chunkPolicy.minBandRows = 1;
+    Pii::forEachBand(chunkPolicy, iChunks, 0,
+                     HistogramBand<T,U,Roi>(image, roi, levels, iChunkRows, matPartials));
+
+    PiiMatrix<T> result(1, int(levels));
+    T* pResult = result.row(0);
+    for (int i=0; i<iChunks; ++i)
       {
-        const U* row = image.row(r);
-        for (int c=0; c<iCols; ++c)
-          if (unsigned(row[c]) < levels && roi(r,c)) ++vector[unsigned(row[c])];
+        const T* pPartial = const_cast<const PiiMatrix<T>&>(matPartials).row(i);
+        for (int j=0; j<int(levels); ++j)
+          pResult[j] += pPartial[j];
       }
     return result;
   }
 
+  /// @hide
+  // Adds the channels of rows [firstRow, lastRow) to three histograms
+  // stored *stride* bytes apart.
+  template <class T, class Clr, class Roi>
+  void addToChannelHistograms(const PiiMatrix<Clr>& image, const Roi& roi,
+                              int firstRow, int lastRow, unsigned int levels,
+                              T* bins, std::size_t stride, Pii::True)
+  {
+    // The three channels of a pixel go to different counters
+    // anyway. Odd and even pixels are counted separately to break
+    // runs of equal colors.
+    unsigned int aBanks[6][256];
+    memset(aBanks, 0, sizeof(aBanks));
+    const int iCols = image.columns();
+    for (int r=firstRow; r<lastRow; ++r)
+      {
+        const Clr* row = image.row(r);
+        int c = 0;
+        for (; c<iCols-1; c+=2)
+          {
+            const unsigned int iEven = roi(r,c) ? 1u : 0u, iOdd = roi(r,c+1) ? 1u : 0u;
+            aBanks[0][row[c].c0] += iEven;
+            aBanks[1][row[c].c1] += iEven;
+            aBanks[2][row[c].c2] += iEven;
+            aBanks[3][row[c+1].c0] += iOdd;
+            aBanks[4][row[c+1].c1] += iOdd;
+            aBanks[5][row[c+1].c2] += iOdd;
+          }
+        for (; c<iCols; ++c)
+          {
+            const unsigned int iEven = roi(r,c) ? 1u : 0u;
+            aBanks[0][row[c].c0] += iEven;
+            aBanks[1][row[c].c1] += iEven;
+            aBanks[2][row[c].c2] += iEven;
+          }
+      }
+    const unsigned int iLevels = qMin(levels, 256u);
+    for (int ch=0; ch<3; ++ch)
+      {
+        T* pBins = reinterpret_cast<T*>(reinterpret_cast<char*>(bins) + ch * stride);
+        for (unsigned int i=0; i<iLevels; ++i)
+          pBins[i] += T(aBanks[ch][i] + aBanks[ch+3][i]);
+      }
+  }
+
+  template <class T, class Clr, class Roi>
+  void addToChannelHistograms(const PiiMatrix<Clr>& image, const Roi& roi,
+                              int firstRow, int lastRow, unsigned int levels,
+                              T* bins, std::size_t stride, Pii::False)
+  {
+    T* pBins0 = bins;
+    T* pBins1 = reinterpret_cast<T*>(reinterpret_cast<char*>(bins) + stride);
+    T* pBins2 = reinterpret_cast<T*>(reinterpret_cast<char*>(bins) + 2 * stride);
+    const int iCols = image.columns();
+    for (int r=firstRow; r<lastRow; ++r)
+      {
+        const Clr* row = image.row(r);
+        for (int c=0; c<iCols; ++c)
+          {
+            if (!roi(r,c))
+              continue;
+            const unsigned int i0 = unsigned(row[c].c0), i1 = unsigned(row[c].c1), i2 = unsigned(row[c].c2);
+            if (i0 < levels) ++pBins0[i0];
+            if (i1 < levels) ++pBins1[i1];
+            if (i2 < levels) ++pBins2[i2];
+          }
+      }
+  }
+
+  template <class T, class Clr>
+  void addRunsToChannelHistograms(const PiiMatrix<Clr>& image, const RunLengthRoi& roi,
+                                  int firstRow, int lastRow, unsigned int levels,
+                                  T* bins, std::size_t stride)
+  {
+    T* pBins0 = bins;
+    T* pBins1 = reinterpret_cast<T*>(reinterpret_cast<char*>(bins) + stride);
+    T* pBins2 = reinterpret_cast<T*>(reinterpret_cast<char*>(bins) + 2 * stride);
+    for (int r=firstRow; r<lastRow; ++r)
+      {
+        const Clr* row = image.row(r);
+        for (const RunLengthRoi::Run* pRun = roi.runBegin(r); pRun != roi.runEnd(r); ++pRun)
+          for (int c=pRun->start; c<pRun->end; ++c)
+            {
+              const unsigned int i0 = unsigned(row[c].c0), i1 = unsigned(row[c].c1), i2 = unsigned(row[c].c2);
+              if (i0 < levels) ++pBins0[i0];
+              if (i1 < levels) ++pBins1[i1];
+              if (i2 < levels) ++pBins2[i2];
+            }
+      }
+  }
+
+  template <class T, class Clr>
+  inline void addToChannelHistograms(const PiiMatrix<Clr>& image, const RunLengthRoi& roi,
+                                     int firstRow, int lastRow, unsigned int levels,
+                                     T* bins, std::size_t stride, Pii::True)
+  {
+    addRunsToChannelHistograms(image, roi, firstRow, lastRow, levels, bins, stride);
+  }
+
+  template <class T, class Clr>
+  inline void addToChannelHistograms(const PiiMatrix<Clr>& image, const RunLengthRoi& roi,
+                                     int firstRow, int lastRow, unsigned int levels,
+                                     T* bins, std::size_t stride, Pii::False)
+  {
+    addRunsToChannelHistograms(image, roi, firstRow, lastRow, levels, bins, stride);
+  }
+
+  template <class T, class Clr, class Roi> struct ChannelHistogramBand
+  {
+    ChannelHistogramBand(const PiiMatrix<Clr>& image, const Roi& roi, unsigned int levels,
+                         int chunkRows, PiiMatrix<T>& partials) :
+      image(image), roi(roi), levels(levels), iChunkRows(chunkRows),
+      partialRows(partials)
+    {}
+
+    void operator() (int firstChunk, int chunkCount)
+    {
+      // Each band owns the three partial histograms at its first chunk.
+      addToChannelHistograms(image, roi,
+                             firstChunk * iChunkRows,
+                             qMin(image.rows(), (firstChunk + chunkCount) * iChunkRows),
+                             levels,
+                             partialRows.row(3 * firstChunk),
+                             partialRows.stride(),
+                             Pii::IsSame<typename Clr::Type, unsigned char>());
+    }
+
+    const PiiMatrix<Clr>& image;
+    const Roi& roi;
+    const unsigned int levels;
+    const int iChunkRows;
+    const Pii::BandRows<T> partialRows;
+  };
+  /// @endhide
+
+  template <class T, class Clr, class Roi> void channelHistograms(const Pii::ParallelExecution& policy,
+                                                                 const PiiMatrix<Clr>& image,
+                                                                 const Roi& roi,
+                                                                 unsigned int levels,
+                                                                 PiiMatrix<T>* histograms)
+  {
+    const int iRows = image.rows(), iCols = image.columns();
+    if (levels < 1)
+      {
+        typename Clr::Type maxValue(0);
+        for (int r=0; r<iRows; ++r)
+          {
+            const Clr* row = image.row(r);
+            for (int c=0; c<iCols; ++c)
+              maxValue = qMax(maxValue, qMax(row[c].c0, qMax(row[c].c1, row[c].c2)));
+          }
+        levels = unsigned(maxValue) + 1;
+      }
+    // The same chunking as in histogram() bounds the memory needed for
+    // partial histograms.
+    const int iChunkRows = qMax(qMax(policy.minBandRows, 1), (iRows + 63) / 64),
+      iChunks = qMax((iRows + iChunkRows - 1) / iChunkRows, 1);
+
+    PiiMatrix<T> matPartials(3 * iChunks, int(levels));
+    if (iChunks < 2)
+      addToChannelHistograms(image, roi, 0, iRows, levels, matPartials.row(0), matPartials.stride(),
+                             Pii::IsSame<typename Clr::Type, unsigned char>());
+    else
+      {
+        Pii::ParallelExecution chunkPolicy(policy);
+        chunkPolicy.minBandRows = 1;
+        Pii::forEachBand(chunkPolicy, iChunks, 0,
+                         ChannelHistogramBand<T,Clr,Roi>(image, roi, levels, iChunkRows, matPartials));
+      }
+
+    for (int ch=0; ch<3; ++ch)
+      {
+        histograms[ch] = PiiMatrix<T>(1, int(levels));
+        T* pResult = histograms[ch].row(0);
+        for (int i=0; i<iChunks; ++i)
+          {
+            const T* pPartial = const_cast<const PiiMatrix<T>&>(matPartials).row(3*i + ch);
+            for (int j=0; j<int(levels); ++j)
+              pResult[j] += pPartial[j];
+          }
+      }
+  }
+
   template <class T, class U, class Roi> PiiMatrix<T> histogram(const PiiMatrix<U>& image, const Roi& roi, const PiiQuantizer<U>& quantizer)
   {
     PiiMatrix<T> result(1, quantizer.levels());
@@ -54,6 +387,17 @@ namespace PiiImage
     return result;
   }
 
+  template <class T, class U, class Roi> PiiMatrix<T> cumulativeHistogram(const PiiMatrix<U>& image,
+                                                                         const Roi& roi,
+                                                                         unsigned int levels)
+  {
+    PiiMatrix<T> result(histogram<T,U,Roi>(image, roi, levels));
+    T* pResult = result.row(0);
+    for (int i=1; i<result.columns(); ++i)
+      pResult[i] += pResult[i-1];
+    return result;
+  }
+
   template <class T, class U> PiiMatrix<T> normalize(const PiiMatrix<U>& histogram)
   {
     PiiMatrix<T> result(PiiMatrix<T>::uninitialized(histogram.rows(), histogram.columns()));
@@ -88,10 +432,43 @@ namespace PiiImage
     return end < cumulative.columns() ? end : -1;
   }
 
+  template <class U, class Roi> PiiMatrix<int> percentiles(const PiiMatrix<U>& image,
+                                                          const Roi& roi,
+                                                          unsigned int levels,
+                                                          const PiiMatrix<double>& fractions)
+  {
+    const PiiMatrix<int> matCumulative(cumulativeHistogram<int>(image, roi, levels));
+    const int iTotal = matCumulative.isEmpty() ? 0 : matCumulative(0, matCumulative.columns()-1);
+    PiiMatrix<int> result(PiiMatrix<int>::uninitialized(1, fractions.columns() * fractions.rows()));
+    int* pResult = result.row(0);
+    for (PiiMatrix<double>::const_iterator i = fractions.begin(); i != fractions.end(); ++i)
+      *pResult++ = percentile(matCumulative, int(std::ceil(*i * iTotal)));
+    return result;
+  }
+
   template <class T, class U> PiiMatrix<U> backProject(const PiiMatrix<T>& img, const PiiMatrix<U>& histogram)
   {
     PiiMatrix<U> result(PiiMatrix<U>::uninitialized(img.rows(), img.columns()));
-    Pii::transform(img.begin(), img.end(), result.begin(), Pii::arrayLookup(histogram[0]));
+    // The histogram is the look-up table as such. Going through rows
+    // avoids the stride arithmetic of matrix iterators, and four
+    // independent lookups per step keep the loads in flight.
+    const U* pLut = histogram[0];
+    const int iRows = img.rows(), iCols = img.columns();
+    for (int r=0; r<iRows; ++r)
+      {
+        const T* pSource = img.row(r);
+        U* pTarget = result.row(r);
+        int c = 0;
+        for (; c<iCols-3; c+=4)
+          {
+            pTarget[c] = pLut[int(pSource[c])];
+            pTarget[c+1] = pLut[int(pSource[c+1])];
+            pTarget[c+2] = pLut[int(pSource[c+2])];
+            pTarget[c+3] = pLut[int(pSource[c+3])];
+          }
+        for (; c<iCols; ++c)
+          pTarget[c] = pLut[int(pSource[c])];
+      }
     return result;
   }
 
@@ -100,28 +477,30 @@ namespace PiiImage
   {
     PiiMatrix<U> result(PiiMatrix<U>::uninitialized(ch1.rows(), ch1.columns()));
     const int iRows = ch1.rows(), iCols = ch1.columns();
+    if (histogram.isEmpty())
+      return result;
+    // Index the histogram directly instead of resolving a row for
+    // each pixel.
+    const char* pHistogram = reinterpret_cast<const char*>(histogram.row(0));
+    const std::size_t iStride = histogram.stride();
     for (int r=0; r<iRows; ++r)
       {
         const T* ch1Row = ch1.row(r);
         const T* ch2Row = ch2.row(r);
         U* targetRow = result.row(r);
         for (int c=0; c<iCols; ++c)
-          targetRow[c] = histogram((int)ch1Row[c], (int)ch2Row[c]);
+          targetRow[c] = reinterpret_cast<const U*>(pHistogram + (int)ch1Row[c] * iStride)[(int)ch2Row[c]];
       }
     return result;
   }
 
   template <class T> PiiMatrix<T> equalize(const PiiMatrix<T>& img, unsigned int levels)
   {
-    PiiMatrix<T> result(img.rows(), img.columns());
-
     unsigned int maxValue = (unsigned int)Pii::max(img);
-    if (levels < maxValue)
+    if (levels <= maxValue)
       levels = maxValue + 1;
-    if (levels == 0)
-      return img;
 
-    PiiMatrix<int> dist = cumulative(histogram(img, levels));
+    PiiMatrix<int> dist(cumulativeHistogram<int>(img, DefaultRoi(), levels));
     int* pDist = dist.row(0);
 
     PiiMatrix<T> newDist(1, levels);
@@ -142,4 +521,207 @@ namespace PiiImage
       }
     return backProject(img, newDist);
   }
+
+  /// @hide
+  // Clips the bins of *histogram* to *limit* and spreads the excess
+  // evenly over all bins. The total count is preserved.
+  inline void clipHistogram(int* histogram, unsigned int levels, int limit)
+  {
+    int iExcess = 0;
+    for (unsigned int i=0; i<levels; ++i)
+      if (histogram[i] > limit)
+        {
+          iExcess += histogram[i] - limit;
+          histogram[i] = limit;
+        }
+    const int iIncrement = iExcess / int(levels), iRemainder = iExcess % int(levels);
+    for (unsigned int i=0; i<levels; ++i)
+      histogram[i] += iIncrement;
+    // The remainder goes to evenly spaced bins.
+    if (iRemainder > 0)
+      {
+        const unsigned int iStep = levels / unsigned(iRemainder);
+        for (int i=0; i<iRemainder; ++i)
+          ++histogram[i * iStep];
+      }
+  }
+
+  // Calculates the equalizing mapping of each tile into a row of
+  // *mappings*.
+  template <class T> struct TileMappingBand
+  {
+    TileMappingBand(const PiiMatrix<T>& img, int tileRows, int tileColumns, int gridColumns,
+                    double clipLimit, unsigned int levels, PiiMatrix<float>& mappings) :
+      img(img), iTileRows(tileRows), iTileColumns(tileColumns), iGridColumns(gridColumns),
+      dClipLimit(clipLimit), iLevels(levels), mappingRows(mappings)
+    {}
+
+    void operator() (int firstTile, int tileCount)
+    {
+      QVector<int> vecHistogram(static_cast<int>(iLevels));
+      int* pHistogram = vecHistogram.data();
+      for (int t=firstTile; t<firstTile+tileCount; ++t)
+        {
+          const int iTop = (t / iGridColumns) * iTileRows, iLeft = (t % iGridColumns) * iTileColumns,
+            iRows = qMin(iTileRows, img.rows() - iTop), iCols = qMin(iTileColumns, img.columns() - iLeft);
+          std::fill(pHistogram, pHistogram + iLevels, 0);
+          for (int r=iTop; r<iTop+iRows; ++r)
+            {
+              const T* pRow = img.row(r) + iLeft;
+              for (int c=0; c<iCols; ++c)
+                ++pHistogram[unsigned(pRow[c])];
+            }
+
+          const int iPixels = iRows * iCols;
+          if (dClipLimit > 0)
+            clipHistogram(pHistogram, iLevels, qMax(1, int(dClipLimit * iPixels / iLevels)));
+
+          float* pMapping = mappingRows.row(t);
+          const float fScale = float(iLevels - 1) / float(iPixels);
+          int iSum = 0;
+          for (unsigned int i=0; i<iLevels; ++i)
+            {
+              iSum += pHistogram[i];
+              pMapping[i] = float(iSum) * fScale;
+            }
+        }
+    }
+
+    const PiiMatrix<T>& img;
+    const int iTileRows, iTileColumns, iGridColumns;
+    const double dClipLimit;
+    const unsigned int iLevels;
+    const Pii::BandRows<float> mappingRows;
+  };
+
+  // Finds the two tiles whose centers surround *position* and the
+  // weight of the second one.
+  inline void findTiles(int position, int tileSize, int tiles, int& first, int& second, float& weight)
+  {
+    const float fPosition = (float(position) + 0.5f) / float(tileSize) - 0.5f;
+    if (fPosition <= 0)
+      {
+        first = second = 0;
+        weight = 0;
+      }
+    else if (fPosition >= float(tiles - 1))
+      {
+        first = second = tiles - 1;
+        weight = 0;
+      }
+    else
+      {
+        first = int(fPosition);
+        second = first + 1;
+        weight = fPosition - float(first);
+      }
+  }
+
+  // Maps the rows of *img* through the blended tile mappings.
+  template <class T> struct AdaptiveEqualizationBand
+  {
+    AdaptiveEqualizationBand(const PiiMatrix<T>& img, const PiiMatrix<float>& mappings,
+                             int tileRows, int gridRows, int gridColumns,
+                             const QVector<int>& leftTiles, const QVector<int>& rightTiles,
+                             const QVector<float>& rightWeights, PiiMatrix<T>& result) :
+      img(img), iTileRows(tileRows), iGridRows(gridRows), iGridColumns(gridColumns),
+      leftTiles(leftTiles), rightTiles(rightTiles), rightWeights(rightWeights),
+      pMappings(reinterpret_cast<const char*>(mappings.row(0))), iMappingStride(mappings.stride()),
+      resultRows(result)
+    {}
+
+    void operator() (int firstRow, int rowCount)
+    {
+      const int iCols = img.columns();
+      for (int r=firstRow; r<firstRow+rowCount; ++r)
+        {
+          int iTop, iBottom;
+          float fBottomWeight;
+          findTiles(r, iTileRows, iGridRows, iTop, iBottom, fBottomWeight);
+          const float fTopWeight = 1.0f - fBottomWeight;
+          const char* pTopRow = pMappings + iTop * iGridColumns * iMappingStride;
+          const char* pBottomRow = pMappings + iBottom * iGridColumns * iMappingStride;
+          const T* pSource = img.row(r);
+          T* pTarget = resultRows.row(r);
+          for (int c=0; c<iCols; ++c)
+            {
+              const unsigned int iValue = unsigned(pSource[c]);
+              const int iLeft = leftTiles[c], iRight = rightTiles[c];
+              const float fRightWeight = rightWeights[c], fLeftWeight = 1.0f - fRightWeight;
+              const float fTop = fLeftWeight * mapping(pTopRow, iLeft, iValue) +
+                fRightWeight * mapping(pTopRow, iRight, iValue);
+              const float fBottom = fLeftWeight * mapping(pBottomRow, iLeft, iValue) +
+                fRightWeight * mapping(pBottomRow, iRight, iValue);
+              pTarget[c] = T(fTopWeight * fTop + fBottomWeight * fBottom + 0.5f);
+            }
+        }
+    }
+
+    inline float mapping(const char* gridRow, int tile, unsigned int value) const
+    {
+      return reinterpret_cast<const float*>(gridRow + tile * iMappingStride)[value];
+    }
+
+    const PiiMatrix<T>& img;
+    const int iTileRows, iGridRows, iGridColumns;
+    const QVector<int>& leftTiles;
+    const QVector<int>& rightTiles;
+    const QVector<float>& rightWeights;
+    const char* pMappings;
+    const std::size_t iMappingStride;
+    const Pii::BandRows<T> resultRows;
+  };
+  /// @endhide
+
+  template <class T> PiiMatrix<T> adaptiveEqualize(const PiiMatrix<T>& img,
+                                                   int tileRows, int tileColumns,
+                                                   double clipLimit,
+                                                   unsigned int levels)
+  {
+    return adaptiveEqualize(Pii::ParallelExecution(1), img, tileRows, tileColumns, clipLimit, levels);
+  }
+
+  template <class T> PiiMatrix<T> adaptiveEqualize(const Pii::ParallelExecution& policy,
+                                                   const PiiMatrix<T>& img,
+                                                   int tileRows, int tileColumns,
+                                                   double clipLimit,
+                                                   unsigned int levels)
+  {
+    const int iRows = img.rows(), iCols = img.columns();
+    if (iRows == 0 || iCols == 0)
+      return PiiMatrix<T>(iRows, iCols);
+
+    unsigned int maxValue = (unsigned int)Pii::max(img);
+    if (levels <= maxValue)
+      levels = maxValue + 1;
+    if (tileRows < 1 || tileRows > iRows)
+      tileRows = iRows;
+    if (tileColumns < 1 || tileColumns > iCols)
+      tileColumns = iCols;
+    const int iGridRows = (iRows + tileRows - 1) / tileRows,
+      iGridColumns = (iCols + tileColumns - 1) / tileColumns,
+      iTiles = iGridRows * iGridColumns;
+
+    // One mapping per tile. Each tile is a big enough work item for
+    // a thread of its own.
+    PiiMatrix<float> matMappings(PiiMatrix<float>::uninitialized(iTiles, int(levels)));
+    Pii::ParallelExecution tilePolicy(policy);
+    tilePolicy.minBandRows = 1;
+    Pii::forEachBand(tilePolicy, iTiles, 0,
+                     TileMappingBand<T>(img, tileRows, tileColumns, iGridColumns,
+                                        clipLimit, levels, matMappings));
+
+    // Horizontal blending is the same on each row.
+    QVector<int> vecLeftTiles(iCols), vecRightTiles(iCols);
+    QVector<float> vecRightWeights(iCols);
+    for (int c=0; c<iCols; ++c)
+      findTiles(c, tileColumns, iGridColumns, vecLeftTiles[c], vecRightTiles[c], vecRightWeights[c]);
+
+    PiiMatrix<T> result(PiiMatrix<T>::uninitialized(iRows, iCols));
+    Pii::forEachBand(policy, iRows, 0,
+                     AdaptiveEqualizationBand<T>(img, matMappings, tileRows, iGridRows, iGridColumns,
+                                                 vecLeftTiles, vecRightTiles, vecRightWeights,
+                                                 result));
+    return result;
+  }
 }
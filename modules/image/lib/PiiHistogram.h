@@ -18,6 +18,7 @@
 
 #include "PiiQuantizer.h"
 #include "PiiImage.h"
+#include "PiiRunLengthRoi.h"
 #include <PiiMath.h>
 
 namespace PiiImage
@@ -39,9 +40,77 @@ namespace PiiImage
    * gray-scale images, use 256.
    *
    * @return the histogram as a PiiMatrix<T>
+   *
+   * ! 8-bit images are collected into four interleaved
+   * sub-histograms that are summed at the end. Neighboring pixels
+   * often have the same value, and incrementing the same counter
+   * repeatedly makes each increment wait for the previous one.
    */
   template <class T, class U, class Roi> PiiMatrix<T> histogram(const PiiMatrix<U>& image, const Roi& roi, unsigned int levels);
 
+  /**
+   * Calculates the histogram of a one-channel image in parallel. The
+   * rows of *image* are split into bands as determined by *policy*,
+   * and a partial histogram is collected for each band. The result
+   * equals that of the sequential version.
+   *
+   * ~~~(c++)
+   * PiiMatrix<int> matHistogram(PiiImage::histogram<int>(Pii::ParallelExecution(),
+   *                                                      image, PiiImage::DefaultRoi(), 256));
+   * ~~~
+   */
+  template <class T, class U, class Roi> PiiMatrix<T> histogram(const Pii::ParallelExecution& policy,
+                                                               const PiiMatrix<U>& image,
+                                                               const Roi& roi,
+                                                               unsigned int levels);
+
+  /**
+   * Calculates the histogram of a one-channel image in parallel.
+   * This is a shorthand for `histogram<int>(policy, image,
+   * PiiImage::DefaultRoi(), levels)`.
+   */
+  template <class T> inline PiiMatrix<int> histogram(const Pii::ParallelExecution& policy,
+                                                     const PiiMatrix<T>& image,
+                                                     unsigned int levels=0)
+  {
+    return histogram<int,T>(policy, image, PiiImage::DefaultRoi(), levels);
+  }
+
+  /**
+   * Calculates the histograms of the three color channels of a color
+   * image in a single pass. Unlike separating the channels and
+   * calling [histogram()] for each, this function reads each pixel
+   * only once and allocates no channel images. 8-bit channels are
+   * collected into two interleaved sub-histograms per channel.
+   *
+   * @param policy parallel execution policy. Rows are processed in
+   * bands, and the result equals that of a sequential calculation.
+   *
+   * @param image the input image. PiiColor or PiiColor4. The fourth
+   * channel is ignored.
+   *
+   * @param roi region-of-interest. See PiiImage.
+   *
+   * @param levels the number of distinct levels in each channel. If
+   * zero is given, the maximum channel value of the image will be
+   * found.
+   *
+   * @param histograms an array of three matrices that will be set to
+   * 1-by-*levels* histograms of the channels `c0`, `c1` and `c2`,
+   * in this order.
+   *
+   * ~~~(c++)
+   * PiiMatrix<int> aHistograms[3];
+   * PiiImage::channelHistograms(Pii::ParallelExecution(), image,
+   *                             PiiImage::DefaultRoi(), 256, aHistograms);
+   * ~~~
+   */
+  template <class T, class Clr, class Roi> void channelHistograms(const Pii::ParallelExecution& policy,
+                                                                 const PiiMatrix<Clr>& image,
+                                                                 const Roi& roi,
+                                                                 unsigned int levels,
+                                                                 PiiMatrix<T>* histograms);
+
   /**
    * Calculate the histogram of a one-channel image. This is a
    * shorthand for `histogram<int>(image, roi, levels)`.
@@ -117,6 +186,32 @@ namespace PiiImage
     return Pii::cumulativeSum<T,PiiMatrix<T> >(histogram, Pii::Horizontally);
   }
 
+  /**
+   * Calculates the cumulative histogram of a one-channel image. The
+   * result equals `cumulative(histogram<T>(image, roi, levels))`,
+   * but the cumulative sum is calculated in place, without a
+   * temporary histogram.
+   *
+   * ~~~(c++)
+   * PiiMatrix<int> matCumulative(PiiImage::cumulativeHistogram<int>(image, PiiImage::DefaultRoi(), 256));
+   * // Number of pixels whose gray level is at most 127
+   * int iDarkPixels = matCumulative(0,127);
+   * ~~~
+   */
+  template <class T, class U, class Roi> PiiMatrix<T> cumulativeHistogram(const PiiMatrix<U>& image,
+                                                                         const Roi& roi,
+                                                                         unsigned int levels);
+
+  /**
+   * Calculates the cumulative histogram of a one-channel image. This
+   * is a shorthand for `cumulativeHistogram<int>(image,
+   * PiiImage::DefaultRoi(), levels)`.
+   */
+  template <class T> inline PiiMatrix<int> cumulativeHistogram(const PiiMatrix<T>& image, unsigned int levels=0)
+  {
+    return cumulativeHistogram<int,T>(image, PiiImage::DefaultRoi(), levels);
+  }
+
   /**
    * Normalize the given histogram so that its elements sum up to one.
    * If the matrix has many rows, each row is normalized. The return
@@ -155,6 +250,39 @@ namespace PiiImage
    */
   template <class T> int percentile(const PiiMatrix<T>& cumulative, T value);
 
+  /**
+   * Finds many percentiles of a one-channel image at once. The
+   * cumulative histogram is calculated once, and each percentile is
+   * then found with [percentile()]. Floating-point images and images
+   * with many levels are better handled with Pii::quantiles(), which
+   * selects the values without a histogram.
+   *
+   * ~~~(c++)
+   * // Gray levels below which 5%, 50% and 95% of pixels fall
+   * PiiMatrix<int> matLevels(PiiImage::percentiles(image, PiiImage::DefaultRoi(), 256,
+   *                                                PiiMatrix<double>(1,3, 0.05, 0.5, 0.95)));
+   * ~~~
+   *
+   * @param image the input image. See [histogram()].
+   *
+   * @param roi region-of-interest. See PiiImage.
+   *
+   * @param levels the number of distinct levels in the image. See
+   * [histogram()].
+   *
+   * @param fractions the requested percentiles as fractions of the
+   * number of pixels in the region of interest, in [0,1].
+   *
+   * @return a row matrix with one column for each element in
+   * *fractions*. Each column holds the first gray level at which the
+   * cumulative pixel count exceeds or equals to the fraction, or -1
+   * if no such level was found.
+   */
+  template <class U, class Roi> PiiMatrix<int> percentiles(const PiiMatrix<U>& image,
+                                                          const Roi& roi,
+                                                          unsigned int levels,
+                                                          const PiiMatrix<double>& fractions);
+
   /**
    * Histogram backprojection. In backprojection, each pixel in `img`
    * is replaced by the corresponding value in `histogram`. Despite
@@ -229,6 +357,51 @@ namespace PiiImage
    * @return an image with enhanced contrast
    */
   template <class T> PiiMatrix<T> equalize(const PiiMatrix<T>& img, unsigned int levels = 0);
+
+  /**
+   * Contrast-limited adaptive histogram equalization (CLAHE). The
+   * image is divided into *tileRows*-by-*tileColumns* tiles, and an
+   * equalizing mapping is calculated for each tile separately. Each
+   * output pixel is mapped through the four nearest tile mappings,
+   * which are blended bilinearly based on the distances to tile
+   * centers. This hides the tile boundaries.
+   *
+   * @param img the input image. The minimum value must not be
+   * negative.
+   *
+   * @param tileRows the height of a tile. Values less than one mean
+   * the full height of the image.
+   *
+   * @param tileColumns the width of a tile. Values less than one mean
+   * the full width of the image.
+   *
+   * @param clipLimit limits the amplification of noise in uniform
+   * areas. Histogram bins higher than *clipLimit* times the average
+   * bin height are clipped, and the excess is spread evenly over all
+   * bins. Typical values are between 2 and 4. Zero disables clipping.
+   *
+   * @param levels the number of quantization levels. See
+   * [equalize()].
+   *
+   * ~~~(c++)
+   * PiiMatrix<unsigned char> matEnhanced(PiiImage::adaptiveEqualize(image, 64, 64, 3.0));
+   * ~~~
+   */
+  template <class T> PiiMatrix<T> adaptiveEqualize(const PiiMatrix<T>& img,
+                                                   int tileRows, int tileColumns,
+                                                   double clipLimit = 0,
+                                                   unsigned int levels = 0);
+
+  /**
+   * Parallel CLAHE. The tile mappings are calculated in parallel, and
+   * the rows of the result are split into bands as determined by
+   * *policy*. The result equals that of the sequential version.
+   */
+  template <class T> PiiMatrix<T> adaptiveEqualize(const Pii::ParallelExecution& policy,
+                                                   const PiiMatrix<T>& img,
+                                                   int tileRows, int tileColumns,
+                                                   double clipLimit = 0,
+                                                   unsigned int levels = 0);
 };
 
 #include "PiiHistogram-templates.h"
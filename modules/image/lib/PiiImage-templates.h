@@ -19,13 +19,44 @@
 
 #include <PiiGeometricObjects.h>
 #include "PiiThresholding.h"
-#include <fast.h>
+#include "PiiExtremumFilter.h"
 
 #include <PiiMatrixUtil.h>
 #include <PiiMath.h>
+#include <PiiVectorBatch.h>
 
 namespace PiiImage
 {
+  /// @hide
+  template <class T> struct RemapSampler
+  {
+    static inline T sample(const T* row0, const T* row1, int x0, int x1, int fx, int fy)
+    {
+      typedef typename Pii::ToFloatingPoint<T>::Type Real;
+      typedef typename Pii::ToFloatingPoint<T>::PrimitiveType RealScalar;
+      const RealScalar dScale = RealScalar(1) / RemapTable::FractionScale,
+        dFx = RealScalar(fx) * dScale, dFy = RealScalar(fy) * dScale;
+      const Real top(Real(row0[x0]) * (1 - dFx) + Real(row0[x1]) * dFx),
+        bottom(Real(row1[x0]) * (1 - dFx) + Real(row1[x1]) * dFx);
+      return T(top * (1 - dFy) + bottom * dFy);
+    }
+  };
+
+  // Pure fixed-point arithmetic for 8-bit images. The sum of weights
+  // is 2^16, and intermediate values fit easily in an int.
+  template <> struct RemapSampler<unsigned char>
+  {
+    static inline unsigned char sample(const unsigned char* row0, const unsigned char* row1,
+                                       int x0, int x1, int fx, int fy)
+    {
+      const int iTop = row0[x0] * (RemapTable::FractionScale - fx) + row0[x1] * fx,
+        iBottom = row1[x0] * (RemapTable::FractionScale - fx) + row1[x1] * fx;
+      return (unsigned char)((iTop * (RemapTable::FractionScale - fy) + iBottom * fy +
+                              (1 << (2 * RemapTable::FractionBits - 1))) >> (2 * RemapTable::FractionBits));
+    }
+  };
+  /// @endhide
+
   template <class ColorType> PiiMatrix<typename ColorType::Type> colorChannel(const PiiMatrix<ColorType>& image,
                                                                               int channel)
   {
@@ -187,14 +218,19 @@ namespace PiiImage
       {
         double stepX = (double)image.columns() / columns;
         double stepY = (double)image.rows() / rows;
+        // The source columns are the same on each row.
+        PiiMatrix<int> matColumns(PiiMatrix<int>::uninitialized(1, columns));
+        int* pColumns = matColumns.row(0);
+        double currentColumn = 0;
+        for (int c=0; c<columns; c++, currentColumn += stepX)
+          pColumns[c] = (int)currentColumn;
         double currentRow = 0;
         for (int r=0; r<rows; r++, currentRow += stepY)
           {
             const T* sourceRow = image.row((int)currentRow);
             T* resultRow = result.row(r);
-            double currentColumn = 0;
-            for (int c=0; c<columns; c++, currentColumn += stepX)
-              resultRow[c] = sourceRow[(int)currentColumn];
+            for (int c=0; c<columns; c++)
+              resultRow[c] = sourceRow[pColumns[c]];
           }
       }
     else //if (interpolation == Pii::LinearInterpolation)
@@ -346,7 +382,8 @@ namespace PiiImage
       }
   }
 
-  template <class T> PiiMatrix<T> rotate(const PiiMatrix<T>& image, double theta,
+  template <class T> PiiMatrix<T> rotate(const Pii::ParallelExecution& policy,
+                                         const PiiMatrix<T>& image, double theta,
                                          PiiImage::TransformedSize handling,
                                          T backgroundColor)
   {
@@ -358,6 +395,10 @@ namespace PiiImage
       theta = Pii::mod(theta, M_PI*2) + M_PI*2;
 
     const int iRows = image.rows(), iCols = image.columns();
+    // Right angles are handled in square tiles. Either reads or
+    // writes go column-wise, which thrashes the cache if whole rows
+    // are processed at once.
+    const int iTileSize = 32;
 
     if (handling == ExpandAsNecessary)
       {
@@ -365,24 +406,28 @@ namespace PiiImage
           {
             int iLastRow = iCols-1;
             PiiMatrix<T> result(PiiMatrix<T>::uninitialized(iCols, iRows));
-            for (int r=0; r<iRows; ++r)
-              {
-                const T* row = image.row(r);
-                for (int c=0; c<iCols; ++c)
-                  result(iLastRow-c, r) = row[c];
-              }
+            for (int r0=0; r0<iRows; r0 += iTileSize)
+              for (int c0=0; c0<iCols; c0 += iTileSize)
+                for (int r=r0; r<qMin(r0 + iTileSize, iRows); ++r)
+                  {
+                    const T* row = image.row(r);
+                    for (int c=c0; c<qMin(c0 + iTileSize, iCols); ++c)
+                      result(iLastRow-c, r) = row[c];
+                  }
             return result;
           }
         else if (Pii::almostEqualRel(theta, M_PI_2))
           {
             int iLastCol = iRows-1;
             PiiMatrix<T> result(PiiMatrix<T>::uninitialized(iCols, iRows));
-            for (int r=0; r<iRows; ++r)
-              {
-                const T* row = image.row(r);
-                for (int c=0; c<iCols; ++c)
-                  result(c, iLastCol-r) = row[c];
-              }
+            for (int r0=0; r0<iRows; r0 += iTileSize)
+              for (int c0=0; c0<iCols; c0 += iTileSize)
+                for (int r=r0; r<qMin(r0 + iTileSize, iRows); ++r)
+                  {
+                    const T* row = image.row(r);
+                    for (int c=c0; c<qMin(c0 + iTileSize, iCols); ++c)
+                      result(c, iLastCol-r) = row[c];
+                  }
             return result;
           }
       }
@@ -400,7 +445,8 @@ namespace PiiImage
         return result;
       }
 
-    return transform(image,
+    return transform(policy,
+                     image,
                      createRotationTransform(float(theta),
                                              image.columns()/2.0,
                                              image.rows()/2.0),
@@ -408,6 +454,13 @@ namespace PiiImage
                      backgroundColor);
   }
 
+  template <class T> PiiMatrix<T> rotate(const PiiMatrix<T>& image, double theta,
+                                         PiiImage::TransformedSize handling,
+                                         T backgroundColor)
+  {
+    return rotate(Pii::ParallelExecution(1), image, theta, handling, backgroundColor);
+  }
+
   template <class Matrix, class Function>
   void coordinateTransform(const Matrix& image,
                            Function transform,
@@ -465,7 +518,6 @@ namespace PiiImage
     return matResult;
   }
 
-  // PENDING use histogram-based filtering for large neighborhoods
   template <class T> PiiMatrix<T> medianFilter(const PiiMatrix<T>& image,
                                                int windowRows, int windowColumns,
                                                Pii::ExtendMode mode)
@@ -739,6 +791,32 @@ namespace PiiImage
     {}
   };
 
+  template <class T> struct MedianBandFilter
+  {
+    MedianBandFilter(int windowRows, int windowColumns, Pii::ExtendMode mode) :
+      iWindowRows(windowRows), iWindowColumns(windowColumns), mode(mode)
+    {}
+
+    PiiMatrix<T> operator() (const PiiMatrix<T>& image) const
+    {
+      return medianFilter(image, iWindowRows, iWindowColumns, mode);
+    }
+
+    int iWindowRows, iWindowColumns;
+    Pii::ExtendMode mode;
+  };
+
+  template <class T> PiiMatrix<T> medianFilter(const Pii::ParallelExecution& policy,
+                                               const PiiMatrix<T>& image,
+                                               int windowRows, int windowColumns,
+                                               Pii::ExtendMode mode)
+  {
+    // The full window height as overlap ensures that the window is
+    // not clipped to a band.
+    return Pii::transformBands<T>(policy, image, windowRows,
+                                  MedianBandFilter<T>(windowRows, windowColumns, mode));
+  }
+
   template <class Input, class Output, class BinaryFunction>
   void medianFilter(const Input& image,
                     int windowRows,
@@ -754,9 +832,6 @@ namespace PiiImage
                   padded);
   }
 
-  template <class GreaterThan, class T, class U>
-  inline void takeExtremum(GreaterThan greater, T& a, U b) { if (greater(b, a)) a = b; }
-
   template <class T, class GreaterThan>
   PiiMatrix<T> extremumFilter(const PiiMatrix<T>& image,
                               int windowRows, int windowColumns,
@@ -764,71 +839,16 @@ namespace PiiImage
                               T initialValue)
   {
     const int iRows = image.rows(), iCols = image.columns();
-    PiiMatrix<T> matResult(PiiMatrix<T>::constant(iRows, iCols, initialValue));
     if (windowColumns <= 0) windowColumns = windowRows;
     if (windowRows > iRows) windowRows = iRows;
     if (windowColumns > iCols) windowColumns = iCols;
+    if (windowRows < 1) windowRows = 1;
+    if (windowColumns < 1) windowColumns = 1;
 
-    const int iLeftCols = windowColumns / 2, iRightCols = windowColumns - iLeftCols;
-    for (int r=0; r<iRows; ++r)
-      {
-        typename PiiMatrix<T>::const_row_iterator pSourceRow = image[r];
-        typename PiiMatrix<T>::row_iterator pTargetRow = matResult[r];
-        // We handle both edges separately to avoid boundary checks in
-        // the middle.
-        for (int c=0; c<iLeftCols; ++c)
-          for (int c2=0; c2<c+iRightCols; ++c2)
-            takeExtremum(greater, pTargetRow[c], pSourceRow[c2]);
-        for (int c=iLeftCols; c<iCols-iRightCols; ++c)
-          for (int c2=c-iLeftCols; c2<c+iRightCols; ++c2)
-            takeExtremum(greater, pTargetRow[c], pSourceRow[c2]);
-        for (int c=iCols-iRightCols; c<iCols; ++c)
-          for (int c2=c-iLeftCols; c2<iCols; ++c2)
-            takeExtremum(greater, pTargetRow[c], pSourceRow[c2]);
-      }
-
-    const int iTopRows = windowRows / 2, iBottomRows = windowRows - iTopRows;
-    // Cyclic temporary buffer for data that cannot be written to the
-    // result matrix yet.
-    QVarLengthArray<T,8> tmpBfr(iTopRows);
-
-    for (int c=0; c<iCols; ++c)
-      {
-        typename PiiMatrix<T>::column_iterator pTargetCol = matResult.columnBegin(c);
-
-        // Initialize the buffer with values that cannot be written yet.
-        for (int r=0; r<iTopRows; ++r)
-          {
-            tmpBfr[r] = initialValue;
-            for (int r2=0; r2<r+iBottomRows; ++r2)
-              takeExtremum(greater, tmpBfr[r], pTargetCol[r2]);
-          }
-
-        for (int r=iTopRows; r<iRows-iBottomRows; ++r)
-          {
-            // Write the oldest value from the buffer and update.
-            int iBfrIndex = r % iTopRows;
-            T oldMax = tmpBfr[iBfrIndex];
-            tmpBfr[iBfrIndex] = initialValue;
-            for (int r2=r-iTopRows; r2<r+iBottomRows; ++r2)
-              takeExtremum(greater, tmpBfr[iBfrIndex], pTargetCol[r2]);
-            pTargetCol[r-iTopRows] = oldMax;
-          }
-        for (int r=iRows-iBottomRows; r<iRows; ++r)
-          {
-            int iBfrIndex = r % iTopRows;
-            T oldMax = tmpBfr[iBfrIndex];
-            tmpBfr[iBfrIndex] = initialValue;
-            for (int r2=r-iTopRows; r2<iRows; ++r2)
-              takeExtremum(greater, tmpBfr[iBfrIndex], pTargetCol[r2]);
-            pTargetCol[r-iTopRows] = oldMax;
-          }
-        // Write the remaining values from the buffer.
-        for (int r=iRows-iTopRows; r<iRows; ++r)
-          pTargetCol[r] = tmpBfr[r % iTopRows];
-      }
-
-    return matResult;
+    // Pixels outside of the image never win.
+    return separableExtremum(image, windowRows, windowColumns,
+                             windowRows / 2, windowColumns / 2,
+                             greater, initialValue);
   }
 
   template <class T> PiiMatrix<T> maxFilter(const PiiMatrix<T>& image,
@@ -842,6 +862,38 @@ namespace PiiImage
     return extremumFilter(image, windowRows, windowColumns, std::less<T>(), Pii::Numeric<T>::maxValue());
   }
 
+  template <class T, class GreaterThan> struct ExtremumBandFilter
+  {
+    ExtremumBandFilter(int windowRows, int windowColumns, T initialValue) :
+      iWindowRows(windowRows), iWindowColumns(windowColumns), initialValue(initialValue)
+    {}
+
+    PiiMatrix<T> operator() (const PiiMatrix<T>& image) const
+    {
+      return extremumFilter(image, iWindowRows, iWindowColumns, GreaterThan(), initialValue);
+    }
+
+    int iWindowRows, iWindowColumns;
+    T initialValue;
+  };
+
+  template <class T> PiiMatrix<T> maxFilter(const Pii::ParallelExecution& policy,
+                                            const PiiMatrix<T>& image,
+                                            int windowRows, int windowColumns)
+  {
+    return Pii::transformBands<T>(policy, image, windowRows,
+                                  ExtremumBandFilter<T,std::greater<T> >(windowRows, windowColumns,
+                                                                         Pii::Numeric<T>::minValue()));
+  }
+  template <class T> PiiMatrix<T> minFilter(const Pii::ParallelExecution& policy,
+                                            const PiiMatrix<T>& image,
+                                            int windowRows, int windowColumns)
+  {
+    return Pii::transformBands<T>(policy, image, windowRows,
+                                  ExtremumBandFilter<T,std::less<T> >(windowRows, windowColumns,
+                                                                      Pii::Numeric<T>::maxValue()));
+  }
+
   template <class T> PiiMatrix<T> makeFilter(PrebuiltFilterType type, unsigned int size)
   {
     switch (type)
@@ -1076,7 +1128,69 @@ namespace PiiImage
     return result;
   }
 
-  template <class T> PiiMatrix<T> transform(const PiiMatrix<T>& image,
+  /// @hide
+  template <class T> struct AffineWarpBand
+  {
+    // Source coordinates are stepped in this fixed-point precision.
+    enum { FractionBits = 12, TileWidth = 64, TileHeight = 32 };
+
+    AffineWarpBand(const PiiMatrix<T>& image, const PiiMatrix<float>& inverseTransform,
+                   int minX, int minY, PiiMatrix<T>& result) :
+      image(image), iMinX(minX), iMinY(minY), iWidth(result.columns()),
+      resultRows(result)
+    {
+      for (int i=0; i<3; ++i)
+        {
+          adTransform[i] = inverseTransform(0,i);
+          adTransform[i+3] = inverseTransform(1,i);
+        }
+    }
+
+    inline int toFixed(double value) const { return Pii::round<int>(value * (1 << FractionBits)); }
+
+    void operator() (int firstRow, int rowCount)
+    {
+      const unsigned int
+        uiLastX = unsigned(image.columns()-1) << FractionBits,
+        uiLastY = unsigned(image.rows()-1) << FractionBits;
+      const int iStepX = toFixed(adTransform[0]), iStepY = toFixed(adTransform[3]);
+      const int iLastRow = firstRow + rowCount;
+      for (int iTileY=firstRow; iTileY<iLastRow; iTileY += TileHeight)
+        for (int iTileX=0; iTileX<iWidth; iTileX += TileWidth)
+          {
+            const int iTileEndX = qMin(iTileX + TileWidth, iWidth);
+            for (int r=iTileY; r<qMin(iTileY + TileHeight, iLastRow); ++r)
+              {
+                T* pResultRow = resultRows.row(r);
+                // Exact source position at the start of each tile row
+                // prevents rounding errors from accumulating.
+                const double dX = iMinX + iTileX, dY = iMinY + r;
+                int iSourceX = toFixed(adTransform[0] * dX + adTransform[1] * dY + adTransform[2]),
+                  iSourceY = toFixed(adTransform[3] * dX + adTransform[4] * dY + adTransform[5]);
+                for (int c=iTileX; c<iTileEndX; ++c, iSourceX += iStepX, iSourceY += iStepY)
+                  {
+                    // Negative values wrap to large unsigned ones.
+                    if (unsigned(iSourceX) > uiLastX || unsigned(iSourceY) > uiLastY)
+                      continue;
+                    const int iX = iSourceX >> FractionBits, iY = iSourceY >> FractionBits,
+                      iFx = (iSourceX >> (FractionBits - RemapTable::FractionBits)) & (RemapTable::FractionScale - 1),
+                      iFy = (iSourceY >> (FractionBits - RemapTable::FractionBits)) & (RemapTable::FractionScale - 1);
+                    pResultRow[c] = RemapSampler<T>::sample(image[iY], image[iY + (iFy != 0)],
+                                                            iX, iX + (iFx != 0), iFx, iFy);
+                  }
+              }
+          }
+    }
+
+    const PiiMatrix<T>& image;
+    double adTransform[6];
+    int iMinX, iMinY, iWidth;
+    const Pii::BandRows<T> resultRows;
+  };
+  /// @endhide
+
+  template <class T> PiiMatrix<T> transform(const Pii::ParallelExecution& policy,
+                                            const PiiMatrix<T>& image,
                                             const PiiMatrix<float>& transform,
                                             TransformedSize handling,
                                             T backgroundColor)
@@ -1125,24 +1239,21 @@ namespace PiiImage
     // old one.
     PiiMatrix<float> matInverseTransform = Pii::inverse(transform);
 
-    int lastX = image.columns()-1, lastY = image.rows()-1;
-
-    // Loop through all pixels in the transformed domain
-    for (y=iMinY; y<=iMaxY; ++y)
-      {
-        // Row pointer is out of bound on purpose.
-        T* pResultRow = result[y-iMinY] - iMinX;
-        for (x=iMinX; x<=iMaxX; ++x)
-          {
-            transformHomogeneousPoint(matInverseTransform, float(x), float(y), &fX, &fY);
-            if (fX >= 0 && fX <= lastX &&
-                fY >= 0 && fY <= lastY)
-              pResultRow[x] = T(Pii::valueAt(image, fY, fX));
-          }
-      }
+    if (result.isEmpty() || image.isEmpty())
+      return result;
+    Pii::forEachBand(policy, result.rows(), 0,
+                     AffineWarpBand<T>(image, matInverseTransform, iMinX, iMinY, result));
     return result;
   }
 
+  template <class T> PiiMatrix<T> transform(const PiiMatrix<T>& image,
+                                            const PiiMatrix<float>& transform,
+                                            TransformedSize handling,
+                                            T backgroundColor)
+  {
+    return PiiImage::transform(Pii::ParallelExecution(1), image, transform, handling, backgroundColor);
+  }
+
   template <class T> PiiMatrix<int> detectEdges(const PiiMatrix<T>& image,
                                                 int smoothWidth,
                                                 T lowThreshold, T highThreshold)
@@ -1173,15 +1284,245 @@ namespace PiiImage
                                lowThreshold, highThreshold);
   }
 
-  template <class T> PiiMatrix<int> detectFastCorners(const PiiMatrix<T>& image, T threshold)
+  /// @hide
+  // Byte offsets of the 16 pixels on a Bresenham circle of radius
+  // three, in clockwise order starting from the top.
+  template <class T> void fastCircleOffsets(int* offsets, int stride)
+  {
+    static const int aCircle[16][2] =
+      {
+        { 0,-3 }, { 1,-3 }, { 2,-2 }, { 3,-1 }, { 3, 0 }, { 3, 1 }, { 2, 2 }, { 1, 3 },
+        { 0, 3 }, {-1, 3 }, {-2, 2 }, {-3, 1 }, {-3, 0 }, {-3,-1 }, {-2,-2 }, {-1,-3 }
+      };
+    for (int i=0; i<16; ++i)
+      offsets[i] = aCircle[i][0] * int(sizeof(T)) + aCircle[i][1] * stride;
+  }
+
+  template <class T> inline T fastCirclePixel(const T* center, int offset)
+  {
+    return *reinterpret_cast<const T*>(reinterpret_cast<const char*>(center) + offset);
+  }
+
+  // True if *arcLength* contiguous bits are set in the circular 16-bit
+  // *mask*.
+  inline bool fastHasArc(unsigned int mask, int arcLength)
   {
-    int pixel[16];
-    fast9_make_offsets<T>(pixel, image.stride());
+    const unsigned int uiCircular = mask | (mask << 16);
+    unsigned int uiArcs = uiCircular;
+    for (int i=1; i<arcLength; ++i)
+      uiArcs &= uiCircular >> i;
+    return uiArcs != 0;
+  }
 
-    PiiMatrix<int> matCorners(0,2);
-    fast9_detect(image, pixel, threshold, matCorners);
-    QVector<int> vecScores = fast9_score(image, matCorners, pixel, threshold);
-    return fast_suppress_nonmax(matCorners, vecScores);
+  template <class T> int fastCornerCandidates(const T* centers, const int* offsets, int count,
+                                              T threshold, int arcLength, int* candidates,
+                                              int first = 0)
+  {
+    typedef typename Pii::Combine<T,int>::Type CalcType;
+    int iCandidates = 0;
+    for (int i=0; i<count; ++i)
+      {
+        const T* p = centers + i;
+        const CalcType high = CalcType(*p) + threshold, low = CalcType(*p) - threshold;
+        // An arc of nine or more pixels covers at least two of the
+        // four compass points.
+        int iBrighter = 0, iDarker = 0;
+        for (int k=0; k<16; k+=4)
+          {
+            const CalcType pixel = fastCirclePixel(p, offsets[k]);
+            iBrighter += pixel > high;
+            iDarker += pixel < low;
+          }
+        if (iBrighter < 2 && iDarker < 2)
+          continue;
+        unsigned int uiBrighter = 0, uiDarker = 0;
+        for (int k=0; k<16; ++k)
+          {
+            const CalcType pixel = fastCirclePixel(p, offsets[k]);
+            uiBrighter |= unsigned(pixel > high) << k;
+            uiDarker |= unsigned(pixel < low) << k;
+          }
+        if (fastHasArc(uiBrighter, arcLength) || fastHasArc(uiDarker, arcLength))
+          candidates[iCandidates++] = first + i;
+      }
+    return iCandidates;
+  }
+
+  // The smallest absolute difference to the center on the best
+  // brighter or darker arc. The minima and maxima over all arcs
+  // are built from those of two, four and eight pixels.
+  template <class T> typename Pii::Combine<T,int>::Type fastCornerScore(const T* center, const int* offsets,
+                                                                        int arcLength)
+  {
+    typedef typename Pii::Combine<T,int>::Type CalcType;
+    // Differences to center, twice around the circle.
+    CalcType aMin[32], aMax[32];
+    for (int k=0; k<16; ++k)
+      aMin[k] = aMin[k+16] = CalcType(fastCirclePixel(center, offsets[k])) - CalcType(*center);
+    std::copy(aMin, aMin + 32, aMax);
+    CalcType aMin2[32], aMax2[32], aMin4[24], aMax4[24], aMin8[16], aMax8[16];
+    for (int k=0; k<31; ++k)
+      {
+        aMin2[k] = qMin(aMin[k], aMin[k+1]);
+        aMax2[k] = qMax(aMax[k], aMax[k+1]);
+      }
+    for (int k=0; k<24; ++k)
+      {
+        aMin4[k] = qMin(aMin2[k], aMin2[k+2]);
+        aMax4[k] = qMax(aMax2[k], aMax2[k+2]);
+      }
+    for (int k=0; k<16; ++k)
+      {
+        aMin8[k] = qMin(aMin4[k], aMin4[k+4]);
+        aMax8[k] = qMax(aMax4[k], aMax4[k+4]);
+      }
+    // The last 1-4 pixels of the arc.
+    const CalcType *pMinTail = aMin, *pMaxTail = aMax;
+    switch (arcLength)
+      {
+      case 9: break;
+      case 10: pMinTail = aMin2; pMaxTail = aMax2; break;
+      case 11:
+        for (int k=0; k<16; ++k)
+          {
+            aMin8[k] = qMin(aMin8[k], aMin[k+10]);
+            aMax8[k] = qMax(aMax8[k], aMax[k+10]);
+          }
+        pMinTail = aMin2; pMaxTail = aMax2;
+        break;
+      default: pMinTail = aMin4; pMaxTail = aMax4; break;
+      }
+    CalcType bestScore(0);
+    for (int k=0; k<16; ++k)
+      {
+        const CalcType brighter = qMin(aMin8[k], pMinTail[k+8]), darker = -qMax(aMax8[k], pMaxTail[k+8]);
+        bestScore = qMax(bestScore, qMax(brighter, darker));
+      }
+    return bestScore;
+  }
+
+  template <class T> struct FastCorner
+  {
+    int x, y;
+    T score;
+  };
+
+  // Sorts corners to descending order by score within grid cells.
+  template <class T> struct FastCornerCellOrder
+  {
+    FastCornerCellOrder(const QVector<FastCorner<T> >& corners, int cellSize, int cellColumns) :
+      corners(corners), iCellSize(cellSize), iCellColumns(cellColumns)
+    {}
+
+    int cell(int index) const
+    {
+      return corners[index].y / iCellSize * iCellColumns + corners[index].x / iCellSize;
+    }
+
+    bool operator() (int index1, int index2) const
+    {
+      const int iCell1 = cell(index1), iCell2 = cell(index2);
+      return iCell1 < iCell2 || (iCell1 == iCell2 && corners[index1].score > corners[index2].score);
+    }
+
+    const QVector<FastCorner<T> >& corners;
+    const int iCellSize, iCellColumns;
+  };
+  /// @endhide
+
+  template <class T> PiiMatrix<int> detectFastCorners(const PiiMatrix<T>& image, T threshold, int arcLength)
+  {
+    return detectFastCorners(image, threshold, arcLength, 0, 0);
+  }
+
+  template <class T> PiiMatrix<int> detectFastCorners(const PiiMatrix<T>& image, T threshold,
+                                                      int arcLength, int cellSize, int maxCornersPerCell)
+  {
+    typedef typename Pii::Combine<T,int>::Type ScoreType;
+    const int iRows = image.rows(), iCols = image.columns();
+    PiiMatrix<int> matCorners(0, 2);
+    if (iRows < 7 || iCols < 7)
+      return matCorners;
+    arcLength = qBound(9, arcLength, 12);
+
+    int aOffsets[16];
+    fastCircleOffsets<T>(aOffsets, int(image.stride()));
+
+    // Scores of three successive rows in a ring buffer. A zero score
+    // means no corner; accepted corners always score above zero.
+    const int iWidth = iCols - 6;
+    PiiMatrix<ScoreType> matScores(3, iCols);
+    QVector<int> vecCandidates(3 * iWidth);
+    int aCandidateCounts[3] = { 0, 0, 0 };
+    QVector<FastCorner<ScoreType> > vecCorners;
+
+    for (int r=3; r<=iRows-3; ++r)
+      {
+        // Replace the scores of row r-3 with those of row r. There is
+        // no row r after the last valid one.
+        const int iSlot = r % 3;
+        ScoreType* pScores = matScores[iSlot];
+        int* pCandidates = vecCandidates.data() + iSlot * iWidth;
+        for (int i=0; i<aCandidateCounts[iSlot]; ++i)
+          pScores[pCandidates[i] + 3] = 0;
+        aCandidateCounts[iSlot] = 0;
+        if (r < iRows-3)
+          {
+            const T* pRow = image[r] + 3;
+            const int iCount = fastCornerCandidates(pRow, aOffsets, iWidth, threshold, arcLength, pCandidates);
+            for (int i=0; i<iCount; ++i)
+              pScores[pCandidates[i] + 3] = fastCornerScore(pRow + pCandidates[i], aOffsets, arcLength);
+            aCandidateCounts[iSlot] = iCount;
+          }
+
+        // Suppress non-maxima on the previous row.
+        if (r == 3)
+          continue;
+        const int iPrevSlot = (r-1) % 3;
+        const ScoreType* pAbove = matScores[(r+1) % 3];
+        const ScoreType* pCenter = matScores[iPrevSlot];
+        const ScoreType* pBelow = pScores;
+        const int* pPrevCandidates = vecCandidates.constData() + iPrevSlot * iWidth;
+        for (int i=0; i<aCandidateCounts[iPrevSlot]; ++i)
+          {
+            const int c = pPrevCandidates[i] + 3;
+            const ScoreType score = pCenter[c];
+            if (pAbove[c-1] >= score || pAbove[c] >= score || pAbove[c+1] >= score ||
+                pCenter[c-1] >= score || pCenter[c+1] >= score ||
+                pBelow[c-1] >= score || pBelow[c] >= score || pBelow[c+1] >= score)
+              continue;
+            FastCorner<ScoreType> corner = { c, r-1, score };
+            vecCorners.append(corner);
+          }
+      }
+
+    const int iCornerCount = vecCorners.size();
+    QVector<bool> vecAccepted(iCornerCount, true);
+    if (cellSize > 0 && maxCornersPerCell > 0)
+      {
+        QVector<int> vecOrder(iCornerCount);
+        for (int i=0; i<iCornerCount; ++i)
+          vecOrder[i] = i;
+        FastCornerCellOrder<ScoreType> order(vecCorners, cellSize, (iCols + cellSize - 1) / cellSize);
+        std::stable_sort(vecOrder.begin(), vecOrder.end(), order);
+        // Reject all but the first maxCornersPerCell in each cell.
+        for (int i=0, iInCell=0; i<iCornerCount; ++i)
+          {
+            iInCell = i > 0 && order.cell(vecOrder[i]) == order.cell(vecOrder[i-1]) ? iInCell + 1 : 0;
+            if (iInCell >= maxCornersPerCell)
+              vecAccepted[vecOrder[i]] = false;
+          }
+      }
+
+    matCorners.reserve(iCornerCount);
+    for (int i=0; i<iCornerCount; ++i)
+      if (vecAccepted[i])
+        {
+          int* pRow = matCorners.appendRow();
+          pRow[0] = vecCorners[i].x;
+          pRow[1] = vecCorners[i].y;
+        }
+    return matCorners;
   }
 
   template <class T, class U> PiiMatrix<T> remap(const PiiMatrix<T>& image,
@@ -1204,6 +1545,59 @@ namespace PiiImage
     return matResult;
   }
 
+  /// @hide
+  template <class T> struct RemapBand
+  {
+    RemapBand(const PiiMatrix<T>& image, const RemapTable& table, PiiMatrix<T>& result) :
+      image(image), table(table), resultRows(result)
+    {}
+
+    void operator() (int firstRow, int rowCount)
+    {
+      const int iCols = table.columns();
+      for (int r=firstRow; r<firstRow+rowCount; ++r)
+        {
+          const PiiPoint<int>* pPositions = table.matPositions[r];
+          const PiiPoint<unsigned short>* pFractions = table.matFractions[r];
+          T* pResultRow = resultRows.row(r);
+          for (int c=0; c<iCols; ++c)
+            {
+              const int iX = pPositions[c].x;
+              if (iX < 0)
+                continue;
+              const int iFx = pFractions[c].x, iFy = pFractions[c].y;
+              // Zero fractions never refer to the next pixel, which
+              // may be outside of the image.
+              const T* pRow0 = image[pPositions[c].y];
+              const T* pRow1 = image[pPositions[c].y + (iFy != 0)];
+              pResultRow[c] = RemapSampler<T>::sample(pRow0, pRow1, iX, iX + (iFx != 0), iFx, iFy);
+            }
+        }
+    }
+
+    const PiiMatrix<T>& image;
+    const RemapTable& table;
+    const Pii::BandRows<T> resultRows;
+  };
+  /// @endhide
+
+  template <class T> PiiMatrix<T> remap(const Pii::ParallelExecution& policy,
+                                        const PiiMatrix<T>& image, const RemapTable& table)
+  {
+    if (image.rows() != table.sourceRows() || image.columns() != table.sourceColumns())
+      PII_MATRIX_SIZE_MISMATCH;
+    PiiMatrix<T> matResult(table.rows(), table.columns());
+    if (matResult.isEmpty())
+      return matResult;
+    Pii::forEachBand(policy, table.rows(), 0, RemapBand<T>(image, table, matResult));
+    return matResult;
+  }
+
+  template <class T> PiiMatrix<T> remap(const PiiMatrix<T>& image, const RemapTable& table)
+  {
+    return remap(Pii::ParallelExecution(1), image, table);
+  }
+
   /// @internal
   template <class T> inline T transformHomogeneousPoint(const T* transform, T x, T y)
   {
@@ -1218,19 +1612,58 @@ namespace PiiImage
     *transformedY = transformHomogeneousPoint(transform[1], sourceX, sourceY);
   }
 
-  template <class T, class U> PiiMatrix<U> transformHomogeneousPoints(const PiiMatrix<T>& transform,
-                                                                      const PiiMatrix<U>& points)
+  /// @internal
+  template <class T, class U> void transformHomogeneousPointRows(const PiiMatrix<T>& transform,
+                                                                 const PiiMatrix<U>& points,
+                                                                 PiiMatrix<U>& result)
   {
     const int iRows = points.rows();
-    PiiMatrix<U> matResult(PiiMatrix<U>::uninitialized(iRows, 2));
     const T* pTr0 = transform[0], *pTr1 = transform[1];
     for (int r=0; r<iRows; ++r)
       {
         const U* pSource = points[r];
-        U* pTarget = matResult[r];
+        U* pTarget = result[r];
         pTarget[0] = U(transformHomogeneousPoint(pTr0, T(pSource[0]), T(pSource[1])));
         pTarget[1] = U(transformHomogeneousPoint(pTr1, T(pSource[0]), T(pSource[1])));
       }
+  }
+
+  /// @internal
+  template <class T> void transformHomogeneousPointRowsSimd(const PiiMatrix<T>& transform,
+                                                            const PiiMatrix<T>& points,
+                                                            PiiMatrix<T>& result)
+  {
+    if (points.rows() == 0)
+      return;
+    const T aTransform[6] = { transform(0,0), transform(0,1), transform(0,2),
+                              transform(1,0), transform(1,1), transform(1,2) };
+    Pii::transformInterleavedPoints(aTransform,
+                                    points[0], points.stride(),
+                                    result[0], result.stride(),
+                                    points.rows());
+  }
+
+  /// @internal
+  inline void transformHomogeneousPointRows(const PiiMatrix<float>& transform,
+                                            const PiiMatrix<float>& points,
+                                            PiiMatrix<float>& result)
+  {
+    transformHomogeneousPointRowsSimd(transform, points, result);
+  }
+
+  /// @internal
+  inline void transformHomogeneousPointRows(const PiiMatrix<double>& transform,
+                                            const PiiMatrix<double>& points,
+                                            PiiMatrix<double>& result)
+  {
+    transformHomogeneousPointRowsSimd(transform, points, result);
+  }
+
+  template <class T, class U> PiiMatrix<U> transformHomogeneousPoints(const PiiMatrix<T>& transform,
+                                                                      const PiiMatrix<U>& points)
+  {
+    PiiMatrix<U> matResult(PiiMatrix<U>::uninitialized(points.rows(), 2));
+    transformHomogeneousPointRows(transform, points, matResult);
     return matResult;
   }
 
@@ -1322,6 +1755,135 @@ namespace PiiImage
     return matResult;
   }
 
+  /// @hide
+  // Accumulator type for pyramid filters and a function that divides
+  // the accumulated sum by 2^shift. 8- and 16-bit pixels are summed
+  // as integers and rounded to nearest.
+  template <class T> struct PyramidSum
+  {
+    typedef typename Pii::ToFloatingPoint<T>::Type Type;
+    typedef typename Pii::ToFloatingPoint<T>::PrimitiveType Scalar;
+    static inline T normalize(const Type& sum, int shift) { return T(sum * (Scalar(1) / (1 << shift))); }
+  };
+
+  template <class T> struct IntPyramidSum
+  {
+    typedef int Type;
+    static inline T normalize(int sum, int shift) { return T((sum + (1 << (shift-1))) >> shift); }
+  };
+
+  template <class Clr, class IntClr> struct ColorPyramidSum
+  {
+    typedef IntClr Type;
+    static inline Clr normalize(const Type& sum, int shift) { return Clr((sum + (1 << (shift-1))) / (1 << shift)); }
+  };
+
+  template <> struct PyramidSum<unsigned char> : IntPyramidSum<unsigned char> {};
+  template <> struct PyramidSum<unsigned short> : IntPyramidSum<unsigned short> {};
+  template <> struct PyramidSum<PiiColor<unsigned char> > :
+    ColorPyramidSum<PiiColor<unsigned char>, PiiColor<int> > {};
+  template <> struct PyramidSum<PiiColor4<unsigned char> > :
+    ColorPyramidSum<PiiColor4<unsigned char>, PiiColor4<int> > {};
+
+  template <class T> struct PyramidBand
+  {
+    typedef typename PyramidSum<T>::Type Sum;
+
+    PyramidBand(const PiiMatrix<T>& image, PyramidFilter filter, PiiMatrix<T>& result) :
+      image(image), filter(filter),
+      iSourceRows(image.rows()), iSourceColumns(image.columns()),
+      iColumns(result.columns()),
+      resultRows(result)
+    {}
+
+    const T* sourceRow(int r) const { return image[qBound(0, r, iSourceRows-1)]; }
+
+    void operator() (int firstRow, int rowCount)
+    {
+      if (filter == BoxPyramidFilter)
+        box(firstRow, rowCount);
+      else
+        gaussian(firstRow, rowCount);
+    }
+
+    void box(int firstRow, int rowCount)
+    {
+      // The last source column is paired with itself if the number of
+      // columns is odd.
+      const int iPairs = iSourceColumns/2;
+      for (int r=firstRow; r<firstRow+rowCount; ++r)
+        {
+          const T *pSource1 = sourceRow(r*2), *pSource2 = sourceRow(r*2+1);
+          T* pResultRow = resultRows.row(r);
+          for (int c=0; c<iPairs; ++c)
+            {
+              const int c2 = c*2;
+              pResultRow[c] = PyramidSum<T>::normalize(Sum(pSource1[c2]) + Sum(pSource1[c2+1]) +
+                                                       Sum(pSource2[c2]) + Sum(pSource2[c2+1]), 2);
+            }
+          if (iPairs < iColumns)
+            pResultRow[iPairs] = PyramidSum<T>::normalize((Sum(pSource1[iSourceColumns-1]) +
+                                                           Sum(pSource2[iSourceColumns-1])) * 2, 2);
+        }
+    }
+
+    void gaussian(int firstRow, int rowCount)
+    {
+      // Vertically filtered source row, padded with two copies of the
+      // edge pixels on both sides.
+      QVector<Sum> vecBuffer(iSourceColumns + 4);
+      Sum* pBuffer = vecBuffer.data() + 2;
+      for (int r=firstRow; r<firstRow+rowCount; ++r)
+        {
+          const int r2 = r*2;
+          const T *pSource0 = sourceRow(r2-2), *pSource1 = sourceRow(r2-1), *pSource2 = sourceRow(r2),
+            *pSource3 = sourceRow(r2+1), *pSource4 = sourceRow(r2+2);
+          for (int c=0; c<iSourceColumns; ++c)
+            pBuffer[c] = Sum(pSource0[c]) + Sum(pSource4[c]) +
+              (Sum(pSource1[c]) + Sum(pSource3[c])) * 4 + Sum(pSource2[c]) * 6;
+          pBuffer[-2] = pBuffer[-1] = pBuffer[0];
+          pBuffer[iSourceColumns] = pBuffer[iSourceColumns+1] = pBuffer[iSourceColumns-1];
+
+          T* pResultRow = resultRows.row(r);
+          const Sum* pWindow = pBuffer - 2;
+          for (int c=0; c<iColumns; ++c, pWindow += 2)
+            pResultRow[c] = PyramidSum<T>::normalize(pWindow[0] + pWindow[4] +
+                                                     (pWindow[1] + pWindow[3]) * 4 + pWindow[2] * 6, 8);
+        }
+    }
+
+    const PiiMatrix<T>& image;
+    const PyramidFilter filter;
+    const int iSourceRows, iSourceColumns, iColumns;
+    const Pii::BandRows<T> resultRows;
+  };
+  /// @endhide
+
+  template <class T> PiiMatrix<T> pyramidDown(const Pii::ParallelExecution& policy,
+                                              const PiiMatrix<T>& image,
+                                              PyramidFilter filter)
+  {
+    PiiMatrix<T> matResult(PiiMatrix<T>::uninitialized((image.rows()+1)/2, (image.columns()+1)/2));
+    if (matResult.isEmpty())
+      return matResult;
+    Pii::forEachBand(policy, matResult.rows(), filter == BoxPyramidFilter ? 0 : 1,
+                     PyramidBand<T>(image, filter, matResult));
+    return matResult;
+  }
+
+  template <class T> QList<PiiMatrix<T> > buildPyramid(const Pii::ParallelExecution& policy,
+                                                       const PiiMatrix<T>& image,
+                                                       int levels,
+                                                       PyramidFilter filter)
+  {
+    QList<PiiMatrix<T> > lstLevels;
+    lstLevels << image;
+    while (lstLevels.size() < levels &&
+           (lstLevels.last().rows() > 1 || lstLevels.last().columns() > 1))
+      lstLevels << pyramidDown(policy, lstLevels.last(), filter);
+    return lstLevels;
+  }
+
   template <class Matrix, class BinaryFunction>
   void fastGradient(const Matrix& input,
                     BinaryFunction function,
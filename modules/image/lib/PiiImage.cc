@@ -15,6 +15,11 @@
 
 #include "PiiImage.h"
 #include <PiiMatrixUtil.h>
+#include <PiiCpu.h>
+#include <QVector>
+
+#include <cstring>
+#include <cmath>
 
 namespace PiiImage
 {
@@ -264,4 +269,1008 @@ namespace PiiImage
       }
     return matMask;
   }
+
+  namespace
+  {
+    // Perreault & Hebert: one histogram per column, with 16 coarse
+    // and 256 fine bins. The kernel histogram is moved right by adding
+    // and subtracting column histograms. Only the coarse level is
+    // updated at every pixel. The fine level of a coarse bin is
+    // brought up to date when the rank falls in that bin.
+    void rankFilter8(const PiiMatrix<unsigned char>& extended,
+                     int windowRows, int windowColumns, int rank,
+                     PiiMatrix<unsigned char>& result)
+    {
+      const int iCols = extended.columns(), iOutRows = result.rows(), iOutCols = result.columns();
+      QVector<unsigned short> vecFine(iCols * 256), vecCoarse(iCols * 16);
+      unsigned short* pColFine = vecFine.data();
+      unsigned short* pColCoarse = vecCoarse.data();
+
+      for (int r=0; r<windowRows-1; ++r)
+        {
+          const unsigned char* pRow = extended.row(r);
+          for (int x=0; x<iCols; ++x)
+            {
+              ++pColFine[x*256 + pRow[x]];
+              ++pColCoarse[x*16 + (pRow[x] >> 4)];
+            }
+        }
+
+      for (int r=0; r<iOutRows; ++r)
+        {
+          // Move the column histograms one row down.
+          const unsigned char* pNew = extended.row(r + windowRows - 1);
+          const unsigned char* pOld = r > 0 ? extended.row(r-1) : 0;
+          for (int x=0; x<iCols; ++x)
+            {
+              if (pOld != 0)
+                {
+                  --pColFine[x*256 + pOld[x]];
+                  --pColCoarse[x*16 + (pOld[x] >> 4)];
+                }
+              ++pColFine[x*256 + pNew[x]];
+              ++pColCoarse[x*16 + (pNew[x] >> 4)];
+            }
+
+          int aCoarse[16], aFine[256], aFinePos[16];
+          for (int b=0; b<16; ++b)
+            {
+              aCoarse[b] = 0;
+              aFinePos[b] = -1;
+            }
+          for (int x=0; x<windowColumns; ++x)
+            for (int b=0; b<16; ++b)
+              aCoarse[b] += pColCoarse[x*16 + b];
+
+          unsigned char* pOut = result.row(r);
+          for (int c=0; c<iOutCols; ++c)
+            {
+              if (c > 0)
+                {
+                  const unsigned short* pAdd = pColCoarse + (c + windowColumns - 1) * 16;
+                  const unsigned short* pRemove = pColCoarse + (c - 1) * 16;
+                  for (int b=0; b<16; ++b)
+                    aCoarse[b] += pAdd[b] - pRemove[b];
+                }
+
+              int iCount = 0, b = 0;
+              for (; iCount + aCoarse[b] <= rank; ++b)
+                iCount += aCoarse[b];
+
+              int* pKernelFine = aFine + b*16;
+              const int iLag = c - aFinePos[b];
+              if (aFinePos[b] < 0 || 2*iLag > windowColumns)
+                {
+                  // Cheaper to start over than to catch up.
+                  for (int f=0; f<16; ++f)
+                    pKernelFine[f] = 0;
+                  for (int x=c; x<c+windowColumns; ++x)
+                    {
+                      const unsigned short* pCol = pColFine + x*256 + b*16;
+                      for (int f=0; f<16; ++f)
+                        pKernelFine[f] += pCol[f];
+                    }
+                }
+              else
+                {
+                  for (int x=aFinePos[b]; x<c; ++x)
+                    {
+                      const unsigned short* pAdd = pColFine + (x + windowColumns)*256 + b*16;
+                      const unsigned short* pRemove = pColFine + x*256 + b*16;
+                      for (int f=0; f<16; ++f)
+                        pKernelFine[f] += pAdd[f] - pRemove[f];
+                    }
+                }
+              aFinePos[b] = c;
+
+              int f = 0;
+              for (; iCount + pKernelFine[f] <= rank; ++f)
+                iCount += pKernelFine[f];
+              pOut[c] = (unsigned char)(b*16 + f);
+            }
+        }
+    }
+
+    // Per-column histograms would need too much memory with 65536
+    // levels. Use a single sliding kernel histogram (Huang) with 256
+    // coarse and 65536 fine bins instead. Moving the kernel costs
+    // 2*windowRows updates, and finding the rank at most 512 steps.
+    void rankFilter16(const PiiMatrix<unsigned short>& extended,
+                      int windowRows, int windowColumns, int rank,
+                      PiiMatrix<unsigned short>& result)
+    {
+      const int iOutRows = result.rows(), iOutCols = result.columns();
+      QVector<int> vecFine(65536), vecCoarse(256);
+      int* pFine = vecFine.data();
+      int* pCoarse = vecCoarse.data();
+      QVector<const unsigned short*> vecRows(windowRows);
+
+      for (int r=0; r<iOutRows; ++r)
+        {
+          for (int i=0; i<windowRows; ++i)
+            vecRows[i] = extended.row(r+i);
+
+          for (int i=0; i<windowRows; ++i)
+            for (int x=0; x<windowColumns; ++x)
+              {
+                ++pFine[vecRows[i][x]];
+                ++pCoarse[vecRows[i][x] >> 8];
+              }
+
+          unsigned short* pOut = result.row(r);
+          for (int c=0; c<iOutCols; ++c)
+            {
+              if (c > 0)
+                {
+                  for (int i=0; i<windowRows; ++i)
+                    {
+                      const unsigned short usOld = vecRows[i][c-1], usNew = vecRows[i][c+windowColumns-1];
+                      --pFine[usOld];
+                      --pCoarse[usOld >> 8];
+                      ++pFine[usNew];
+                      ++pCoarse[usNew >> 8];
+                    }
+                }
+              int iCount = 0, b = 0;
+              for (; iCount + pCoarse[b] <= rank; ++b)
+                iCount += pCoarse[b];
+              const int* pBinFine = pFine + (b << 8);
+              int f = 0;
+              for (; iCount + pBinFine[f] <= rank; ++f)
+                iCount += pBinFine[f];
+              pOut[c] = (unsigned short)((b << 8) + f);
+            }
+
+          // Empty the histograms for the next row.
+          for (int i=0; i<windowRows; ++i)
+            for (int x=iOutCols-1; x<iOutCols-1+windowColumns; ++x)
+              {
+                --pFine[vecRows[i][x]];
+                --pCoarse[vecRows[i][x] >> 8];
+              }
+        }
+    }
+
+    template <class T, class Kernel>
+    PiiMatrix<T> histogramRankFilter(const PiiMatrix<T>& image,
+                                     int windowRows, int windowColumns, int rank,
+                                     Pii::ExtendMode mode,
+                                     Kernel kernel)
+    {
+      const int iRows = image.rows(), iCols = image.columns();
+      if (iRows == 0 || iCols == 0)
+        return image;
+      // Window size handling is the same as in medianFilter().
+      if (windowColumns <= 0) windowColumns = windowRows;
+      windowRows = qBound(1, windowRows, iRows);
+      windowColumns = qBound(1, windowColumns, iCols);
+      rank = qBound(0, rank, windowRows * windowColumns - 1);
+
+      const int rows = windowRows / 2, cols = windowColumns / 2;
+      const PiiMatrix<T> matExtended(Pii::extend(image, rows, rows, cols, cols, mode));
+      PiiMatrix<T> matResult(PiiMatrix<T>::uninitialized(matExtended.rows() - windowRows + 1,
+                                                         matExtended.columns() - windowColumns + 1));
+      kernel(matExtended, windowRows, windowColumns, rank, matResult);
+      if (mode != Pii::ExtendNot)
+        return matResult(0, 0, iRows, iCols);
+      return matResult;
+    }
+  }
+
+  PiiMatrix<unsigned char> rankFilter(const PiiMatrix<unsigned char>& image,
+                                      int windowRows, int windowColumns, int rank,
+                                      Pii::ExtendMode mode)
+  {
+    return histogramRankFilter(image, windowRows, windowColumns, rank, mode, rankFilter8);
+  }
+
+  PiiMatrix<unsigned short> rankFilter(const PiiMatrix<unsigned short>& image,
+                                       int windowRows, int windowColumns, int rank,
+                                       Pii::ExtendMode mode)
+  {
+    return histogramRankFilter(image, windowRows, windowColumns, rank, mode, rankFilter16);
+  }
+
+  PiiMatrix<unsigned char> histogramMedianFilter(const PiiMatrix<unsigned char>& image,
+                                                 int windowRows, int windowColumns,
+                                                 Pii::ExtendMode mode)
+  {
+    if (windowColumns <= 0) windowColumns = windowRows;
+    return rankFilter(image, windowRows, windowColumns,
+                      (qMin(windowRows, image.rows()) * qMin(windowColumns, image.columns()) - 1) / 2,
+                      mode);
+  }
+
+  PiiMatrix<unsigned short> histogramMedianFilter(const PiiMatrix<unsigned short>& image,
+                                                  int windowRows, int windowColumns,
+                                                  Pii::ExtendMode mode)
+  {
+    if (windowColumns <= 0) windowColumns = windowRows;
+    return rankFilter(image, windowRows, windowColumns,
+                      (qMin(windowRows, image.rows()) * qMin(windowColumns, image.columns()) - 1) / 2,
+                      mode);
+  }
+
+  RemapTable::RemapTable() :
+    iSourceRows(0), iSourceColumns(0)
+  {}
+
+  RemapTable::RemapTable(const DoubleCoordinateMap& map, int sourceRows, int sourceColumns) :
+    iSourceRows(sourceRows < 0 ? map.rows() : sourceRows),
+    iSourceColumns(sourceColumns < 0 ? map.columns() : sourceColumns),
+    matPositions(PiiMatrix<PiiPoint<int> >::uninitialized(map.rows(), map.columns())),
+    matFractions(map.rows(), map.columns())
+  {
+    for (int r=0; r<map.rows(); ++r)
+      {
+        const PiiPoint<double>* pMapRow = map[r];
+        PiiPoint<int>* pPositions = matPositions[r];
+        PiiPoint<unsigned short>* pFractions = matFractions[r];
+        for (int c=0; c<map.columns(); ++c)
+          {
+            const double dX = pMapRow[c].x, dY = pMapRow[c].y;
+            if (!(dX >= 0 && dX < iSourceColumns &&
+                  dY >= 0 && dY < iSourceRows))
+              {
+                pPositions[c] = PiiPoint<int>(-1, -1);
+                continue;
+              }
+            // Round to the closest 1/256 pixel and split into integer
+            // and fractional parts.
+            int iX = Pii::round<int>(dX * FractionScale), iY = Pii::round<int>(dY * FractionScale);
+            int iFx = iX & (FractionScale - 1), iFy = iY & (FractionScale - 1);
+            iX >>= FractionBits;
+            iY >>= FractionBits;
+            // Positions after the last pixel are clamped to it.
+            if (iX >= iSourceColumns - 1)
+              iX = iSourceColumns - 1, iFx = 0;
+            if (iY >= iSourceRows - 1)
+              iY = iSourceRows - 1, iFy = 0;
+            pPositions[c] = PiiPoint<int>(iX, iY);
+            pFractions[c] = PiiPoint<unsigned short>((unsigned short)iFx, (unsigned short)iFy);
+          }
+      }
+  }
+
+  RemapTable::RemapTable(const IntCoordinateMap& map, int sourceRows, int sourceColumns) :
+    iSourceRows(sourceRows < 0 ? map.rows() : sourceRows),
+    iSourceColumns(sourceColumns < 0 ? map.columns() : sourceColumns),
+    matPositions(PiiMatrix<PiiPoint<int> >::uninitialized(map.rows(), map.columns())),
+    matFractions(map.rows(), map.columns())
+  {
+    for (int r=0; r<map.rows(); ++r)
+      {
+        const PiiPoint<int>* pMapRow = map[r];
+        PiiPoint<int>* pPositions = matPositions[r];
+        for (int c=0; c<map.columns(); ++c)
+          {
+            const PiiPoint<int> pt = pMapRow[c];
+            if (pt.x >= 0 && pt.x < iSourceColumns &&
+                pt.y >= 0 && pt.y < iSourceRows)
+              pPositions[c] = pt;
+            else
+              pPositions[c] = PiiPoint<int>(-1, -1);
+          }
+      }
+  }
+
+  namespace
+  {
+    // Appends the positions of the set bits in *mask* to *candidates*.
+    inline int appendCandidates(unsigned int mask, int first, int* candidates)
+    {
+      int iCount = 0;
+      for (int i=0; mask != 0; ++i, mask >>= 1)
+        if (mask & 1)
+          candidates[iCount++] = first + i;
+      return iCount;
+    }
+
+#ifdef PII_X86_SIMD
+    /* The segment test runs for all lanes at once. Each lane keeps
+     * the length of the current run of brighter (darker) pixels and
+     * the longest run so far. Going around the circle 16+arcLength-1
+     * times catches runs that wrap around. Unsigned comparisons are
+     * done in the signed domain by flipping the sign bits.
+     */
+    PII_CPU_TARGET("sse2")
+    int fastCornerCandidatesSse2(const unsigned char* centers, const int* offsets, int count,
+                                 unsigned char threshold, int arcLength, int* candidates)
+    {
+      const __m128i bias = _mm_set1_epi8(char(0x80)), one = _mm_set1_epi8(1),
+        t = _mm_set1_epi8(char(threshold)), minRun = _mm_set1_epi8(char(arcLength - 1));
+      int iCandidates = 0, i = 0;
+      for (; i + 16 <= count; i += 16)
+        {
+          const unsigned char* p = centers + i;
+          const __m128i center = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+          const __m128i high = _mm_xor_si128(_mm_adds_epu8(center, t), bias),
+            low = _mm_xor_si128(_mm_subs_epu8(center, t), bias);
+          __m128i aBrighter[16], aDarker[16];
+          // Quick rejection: at least two of the four compass points
+          // must pass.
+          __m128i brighterCount = _mm_setzero_si128(), darkerCount = _mm_setzero_si128();
+          for (int k=0; k<16; k+=4)
+            {
+              const __m128i pixel = _mm_xor_si128(_mm_loadu_si128(reinterpret_cast<const __m128i*>(p + offsets[k])), bias);
+              aBrighter[k] = _mm_cmpgt_epi8(pixel, high);
+              aDarker[k] = _mm_cmpgt_epi8(low, pixel);
+              brighterCount = _mm_sub_epi8(brighterCount, aBrighter[k]);
+              darkerCount = _mm_sub_epi8(darkerCount, aDarker[k]);
+            }
+          if (_mm_movemask_epi8(_mm_or_si128(_mm_cmpgt_epi8(brighterCount, one),
+                                             _mm_cmpgt_epi8(darkerCount, one))) == 0)
+            continue;
+          for (int k=1; k<16; ++k)
+            if (k & 3)
+              {
+                const __m128i pixel = _mm_xor_si128(_mm_loadu_si128(reinterpret_cast<const __m128i*>(p + offsets[k])), bias);
+                aBrighter[k] = _mm_cmpgt_epi8(pixel, high);
+                aDarker[k] = _mm_cmpgt_epi8(low, pixel);
+              }
+          __m128i brighterRun = _mm_setzero_si128(), darkerRun = _mm_setzero_si128(),
+            longestRun = _mm_setzero_si128();
+          for (int k=0; k<16+arcLength-1; ++k)
+            {
+              brighterRun = _mm_and_si128(_mm_add_epi8(brighterRun, one), aBrighter[k & 15]);
+              darkerRun = _mm_and_si128(_mm_add_epi8(darkerRun, one), aDarker[k & 15]);
+              longestRun = _mm_max_epu8(longestRun, _mm_max_epu8(brighterRun, darkerRun));
+            }
+          iCandidates += appendCandidates(unsigned(_mm_movemask_epi8(_mm_cmpgt_epi8(longestRun, minRun))),
+                                          i, candidates + iCandidates);
+        }
+      return iCandidates + fastCornerCandidates<unsigned char>(centers + i, offsets, count - i,
+                                                               threshold, arcLength, candidates + iCandidates,
+                                                               i);
+    }
+
+    PII_CPU_TARGET("avx2")
+    int fastCornerCandidatesAvx2(const unsigned char* centers, const int* offsets, int count,
+                                 unsigned char threshold, int arcLength, int* candidates)
+    {
+      const __m256i bias = _mm256_set1_epi8(char(0x80)), one = _mm256_set1_epi8(1),
+        t = _mm256_set1_epi8(char(threshold)), minRun = _mm256_set1_epi8(char(arcLength - 1));
+      int iCandidates = 0, i = 0;
+      for (; i + 32 <= count; i += 32)
+        {
+          const unsigned char* p = centers + i;
+          const __m256i center = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p));
+          const __m256i high = _mm256_xor_si256(_mm256_adds_epu8(center, t), bias),
+            low = _mm256_xor_si256(_mm256_subs_epu8(center, t), bias);
+          __m256i aBrighter[16], aDarker[16];
+          __m256i brighterCount = _mm256_setzero_si256(), darkerCount = _mm256_setzero_si256();
+          for (int k=0; k<16; k+=4)
+            {
+              const __m256i pixel = _mm256_xor_si256(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(p + offsets[k])), bias);
+              aBrighter[k] = _mm256_cmpgt_epi8(pixel, high);
+              aDarker[k] = _mm256_cmpgt_epi8(low, pixel);
+              brighterCount = _mm256_sub_epi8(brighterCount, aBrighter[k]);
+              darkerCount = _mm256_sub_epi8(darkerCount, aDarker[k]);
+            }
+          if (_mm256_movemask_epi8(_mm256_or_si256(_mm256_cmpgt_epi8(brighterCount, one),
+                                                   _mm256_cmpgt_epi8(darkerCount, one))) == 0)
+            continue;
+          for (int k=1; k<16; ++k)
+            if (k & 3)
+              {
+                const __m256i pixel = _mm256_xor_si256(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(p + offsets[k])), bias);
+                aBrighter[k] = _mm256_cmpgt_epi8(pixel, high);
+                aDarker[k] = _mm256_cmpgt_epi8(low, pixel);
+              }
+          __m256i brighterRun = _mm256_setzero_si256(), darkerRun = _mm256_setzero_si256(),
+            longestRun = _mm256_setzero_si256();
+          for (int k=0; k<16+arcLength-1; ++k)
+            {
+              brighterRun = _mm256_and_si256(_mm256_add_epi8(brighterRun, one), aBrighter[k & 15]);
+              darkerRun = _mm256_and_si256(_mm256_add_epi8(darkerRun, one), aDarker[k & 15]);
+              longestRun = _mm256_max_epu8(longestRun, _mm256_max_epu8(brighterRun, darkerRun));
+            }
+          iCandidates += appendCandidates(unsigned(_mm256_movemask_epi8(_mm256_cmpgt_epi8(longestRun, minRun))),
+                                          i, candidates + iCandidates);
+        }
+      return iCandidates + fastCornerCandidates<unsigned char>(centers + i, offsets, count - i,
+                                                               threshold, arcLength, candidates + iCandidates,
+                                                               i);
+    }
+#endif
+
+#ifdef PII_NEON_SIMD
+    int fastCornerCandidatesNeon(const unsigned char* centers, const int* offsets, int count,
+                                 unsigned char threshold, int arcLength, int* candidates)
+    {
+      const uint8x16_t one = vdupq_n_u8(1), t = vdupq_n_u8(threshold),
+        minRun = vdupq_n_u8((unsigned char)(arcLength - 1));
+      int iCandidates = 0, i = 0;
+      for (; i + 16 <= count; i += 16)
+        {
+          const unsigned char* p = centers + i;
+          const uint8x16_t center = vld1q_u8(p);
+          const uint8x16_t high = vqaddq_u8(center, t), low = vqsubq_u8(center, t);
+          uint8x16_t aBrighter[16], aDarker[16];
+          uint8x16_t brighterCount = vdupq_n_u8(0), darkerCount = vdupq_n_u8(0);
+          for (int k=0; k<16; k+=4)
+            {
+              const uint8x16_t pixel = vld1q_u8(p + offsets[k]);
+              aBrighter[k] = vcgtq_u8(pixel, high);
+              aDarker[k] = vcltq_u8(pixel, low);
+              brighterCount = vsubq_u8(brighterCount, aBrighter[k]);
+              darkerCount = vsubq_u8(darkerCount, aDarker[k]);
+            }
+          const uint64x2_t quick = vreinterpretq_u64_u8(vorrq_u8(vcgtq_u8(brighterCount, one),
+                                                                 vcgtq_u8(darkerCount, one)));
+          if ((vgetq_lane_u64(quick, 0) | vgetq_lane_u64(quick, 1)) == 0)
+            continue;
+          for (int k=1; k<16; ++k)
+            if (k & 3)
+              {
+                const uint8x16_t pixel = vld1q_u8(p + offsets[k]);
+                aBrighter[k] = vcgtq_u8(pixel, high);
+                aDarker[k] = vcltq_u8(pixel, low);
+              }
+          uint8x16_t brighterRun = vdupq_n_u8(0), darkerRun = vdupq_n_u8(0), longestRun = vdupq_n_u8(0);
+          for (int k=0; k<16+arcLength-1; ++k)
+            {
+              brighterRun = vandq_u8(vaddq_u8(brighterRun, one), aBrighter[k & 15]);
+              darkerRun = vandq_u8(vaddq_u8(darkerRun, one), aDarker[k & 15]);
+              longestRun = vmaxq_u8(longestRun, vmaxq_u8(brighterRun, darkerRun));
+            }
+          unsigned char aCorners[16];
+          vst1q_u8(aCorners, vcgtq_u8(longestRun, minRun));
+          for (int j=0; j<16; ++j)
+            if (aCorners[j])
+              candidates[iCandidates++] = i + j;
+        }
+      return iCandidates + fastCornerCandidates<unsigned char>(centers + i, offsets, count - i,
+                                                               threshold, arcLength, candidates + iCandidates,
+                                                               i);
+    }
+#endif
+  }
+
+  int fastCornerCandidates(const unsigned char* centers, const int* offsets, int count,
+                           unsigned char threshold, int arcLength, int* candidates)
+  {
+    switch (Pii::simdLevel())
+      {
+#ifdef PII_X86_SIMD
+      case Pii::Avx2Simd:
+        return fastCornerCandidatesAvx2(centers, offsets, count, threshold, arcLength, candidates);
+      case Pii::Sse2Simd:
+        return fastCornerCandidatesSse2(centers, offsets, count, threshold, arcLength, candidates);
+#endif
+#ifdef PII_NEON_SIMD
+      case Pii::NeonSimd:
+        return fastCornerCandidatesNeon(centers, offsets, count, threshold, arcLength, candidates);
+#endif
+      default:
+        return fastCornerCandidates<unsigned char>(centers, offsets, count, threshold, arcLength, candidates);
+      }
+  }
+
+  namespace
+  {
+    // tan(22.5 deg) in 16-bit fixed point. The scalar and SIMD
+    // kernels use the same integer arithmetic and produce identical
+    // results.
+    const int iTan22 = 27146;
+
+    /* Sobel gradient, its magnitude (|gx| + |gy|) and the gradient
+     * direction quantized to four sectors. Sector 0 is horizontal,
+     * 1 the diagonal with same signs (south-east), 2 vertical and 3
+     * the other diagonal.
+     */
+    inline void cannyGradient(const unsigned char* above, const unsigned char* center, const unsigned char* below,
+                              int left, int c, int right, short* magnitude, unsigned char* sectors)
+    {
+      const int iGx = (above[right] - above[left]) + 2 * (center[right] - center[left]) + (below[right] - below[left]),
+        iGy = (below[left] + 2 * below[c] + below[right]) - (above[left] + 2 * above[c] + above[right]);
+      const int iAx = qAbs(iGx), iAy = qAbs(iGy), iT = (iAx * iTan22) >> 16;
+      magnitude[c] = short(iAx + iAy);
+      if (iAy <= iT)
+        sectors[c] = 0;
+      else if (iAy >= 2 * iAx + iT)
+        sectors[c] = 2;
+      else
+        sectors[c] = (iGx ^ iGy) >= 0 ? 1 : 3;
+    }
+
+    /* Non-maximum suppression and double thresholding for a single
+     * pixel. Returns 0 for suppressed pixels, 1 for weak and 2 for
+     * strong edge candidates. *low* must be at least one.
+     */
+    inline unsigned char cannyClass(const short* above, const short* center, const short* below,
+                                    int c, unsigned char sector, int low, int high)
+    {
+      const int iMagnitude = center[c];
+      int iForward, iBackward;
+      switch (sector)
+        {
+        case 0: iForward = center[c+1]; iBackward = center[c-1]; break;
+        case 1: iForward = below[c+1]; iBackward = above[c-1]; break;
+        case 2: iForward = below[c]; iBackward = above[c]; break;
+        default: iForward = below[c-1]; iBackward = above[c+1]; break;
+        }
+      if (iMagnitude <= iForward || iMagnitude < iBackward || iMagnitude < low)
+        return 0;
+      return iMagnitude >= high ? 2 : 1;
+    }
+
+#ifdef PII_X86_SIMD
+#  define PII_LOAD_U8_AS_I16(PTR) _mm_unpacklo_epi8(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(PTR)), zero)
+#  define PII_LOAD_I16(PTR) _mm_loadu_si128(reinterpret_cast<const __m128i*>(PTR))
+
+    // Processes inner columns eight at a time. Returns the first
+    // column left for the scalar code.
+    PII_CPU_TARGET("sse2")
+    int cannyGradientSse2(const unsigned char* above, const unsigned char* center, const unsigned char* below,
+                          int columns, short* magnitude, unsigned char* sectors)
+    {
+      const __m128i zero = _mm_setzero_si128(), minusOne = _mm_set1_epi16(-1),
+        two = _mm_set1_epi16(2), three = _mm_set1_epi16(3), tan22 = _mm_set1_epi16(short(iTan22));
+      int c = 1;
+      for (; c + 9 <= columns; c += 8)
+        {
+          const __m128i aL = PII_LOAD_U8_AS_I16(above + c - 1), aC = PII_LOAD_U8_AS_I16(above + c),
+            aR = PII_LOAD_U8_AS_I16(above + c + 1),
+            bL = PII_LOAD_U8_AS_I16(center + c - 1), bR = PII_LOAD_U8_AS_I16(center + c + 1),
+            dL = PII_LOAD_U8_AS_I16(below + c - 1), dC = PII_LOAD_U8_AS_I16(below + c),
+            dR = PII_LOAD_U8_AS_I16(below + c + 1);
+          const __m128i gx = _mm_add_epi16(_mm_add_epi16(_mm_sub_epi16(aR, aL), _mm_sub_epi16(dR, dL)),
+                                           _mm_slli_epi16(_mm_sub_epi16(bR, bL), 1)),
+            gy = _mm_sub_epi16(_mm_add_epi16(_mm_add_epi16(dL, dR), _mm_slli_epi16(dC, 1)),
+                               _mm_add_epi16(_mm_add_epi16(aL, aR), _mm_slli_epi16(aC, 1)));
+          // SSE2 has no abs for words.
+          const __m128i ax = _mm_max_epi16(gx, _mm_sub_epi16(zero, gx)),
+            ay = _mm_max_epi16(gy, _mm_sub_epi16(zero, gy));
+          _mm_storeu_si128(reinterpret_cast<__m128i*>(magnitude + c), _mm_add_epi16(ax, ay));
+
+          const __m128i t = _mm_mulhi_epu16(ax, tan22),
+            notHorizontal = _mm_cmpgt_epi16(ay, t),
+            notVertical = _mm_cmpgt_epi16(_mm_add_epi16(_mm_slli_epi16(ax, 1), t), ay),
+            sameSign = _mm_cmpgt_epi16(_mm_xor_si128(gx, gy), minusOne),
+            diagonal = _mm_sub_epi16(three, _mm_and_si128(sameSign, two)),
+            sector = _mm_and_si128(notHorizontal,
+                                   _mm_or_si128(_mm_and_si128(notVertical, diagonal),
+                                                _mm_andnot_si128(notVertical, two)));
+          _mm_storel_epi64(reinterpret_cast<__m128i*>(sectors + c), _mm_packus_epi16(sector, zero));
+        }
+      return c;
+    }
+
+    // Replaces the sectors of inner columns with edge classes eight
+    // pixels at a time.
+    PII_CPU_TARGET("sse2")
+    int cannyClassesSse2(const short* above, const short* center, const short* below,
+                         int columns, int low, int high, unsigned char* classes)
+    {
+      const __m128i zero = _mm_setzero_si128(), one = _mm_set1_epi16(1),
+        two = _mm_set1_epi16(2), three = _mm_set1_epi16(3),
+        lowThreshold = _mm_set1_epi16(short(low)), highThreshold = _mm_set1_epi16(short(high));
+      int c = 1;
+      for (; c + 9 <= columns; c += 8)
+        {
+          const __m128i sector = PII_LOAD_U8_AS_I16(classes + c),
+            is0 = _mm_cmpeq_epi16(sector, zero), is1 = _mm_cmpeq_epi16(sector, one),
+            is2 = _mm_cmpeq_epi16(sector, two), is3 = _mm_cmpeq_epi16(sector, three);
+          const __m128i m = PII_LOAD_I16(center + c),
+            forward = _mm_or_si128(_mm_or_si128(_mm_and_si128(is0, PII_LOAD_I16(center + c + 1)),
+                                                _mm_and_si128(is1, PII_LOAD_I16(below + c + 1))),
+                                   _mm_or_si128(_mm_and_si128(is2, PII_LOAD_I16(below + c)),
+                                                _mm_and_si128(is3, PII_LOAD_I16(below + c - 1)))),
+            backward = _mm_or_si128(_mm_or_si128(_mm_and_si128(is0, PII_LOAD_I16(center + c - 1)),
+                                                 _mm_and_si128(is1, PII_LOAD_I16(above + c - 1))),
+                                    _mm_or_si128(_mm_and_si128(is2, PII_LOAD_I16(above + c)),
+                                                 _mm_and_si128(is3, PII_LOAD_I16(above + c + 1))));
+          const __m128i keep = _mm_andnot_si128(_mm_or_si128(_mm_cmpgt_epi16(backward, m),
+                                                             _mm_cmpgt_epi16(lowThreshold, m)),
+                                                _mm_cmpgt_epi16(m, forward)),
+            strong = _mm_andnot_si128(_mm_cmpgt_epi16(highThreshold, m), keep),
+            cls = _mm_add_epi16(_mm_and_si128(keep, one), _mm_and_si128(strong, one));
+          _mm_storel_epi64(reinterpret_cast<__m128i*>(classes + c), _mm_packus_epi16(cls, zero));
+        }
+      return c;
+    }
+#  undef PII_LOAD_I16
+#  undef PII_LOAD_U8_AS_I16
+#endif
+
+    inline bool useSse2()
+    {
+#ifdef PII_X86_SIMD
+      const Pii::SimdLevel level = Pii::simdLevel();
+      return level == Pii::Sse2Simd || level == Pii::Avx2Simd;
+#else
+      return false;
+#endif
+    }
+
+    /* All intermediate results of cannyEdges() are stored in flat
+     * arrays indexed with r * columns + c. The edge class array
+     * first holds the gradient sectors, which are overwritten in
+     * place during non-maximum suppression. Union-find hysteresis
+     * uses the class of a root pixel to mark components that contain
+     * a strong pixel.
+     */
+    struct CannyState
+    {
+      const PiiMatrix<unsigned char>& image;
+      int iRows, iColumns;
+      short* pMagnitude;
+      unsigned char* pClasses;
+      int* pParents;
+      unsigned char* pBandStarts;
+      qint64* pRowSums;
+      qint64* pRowSquares;
+      int iLow, iHigh;
+
+      CannyState(const PiiMatrix<unsigned char>& img) :
+        image(img), iRows(img.rows()), iColumns(img.columns()),
+        pMagnitude(0), pClasses(0), pParents(0), pBandStarts(0),
+        pRowSums(0), pRowSquares(0), iLow(1), iHigh(1)
+      {}
+
+      int find(int i) const
+      {
+        while (pParents[i] != i)
+          i = pParents[i];
+        return i;
+      }
+
+      // Path halving keeps the trees shallow without recursion.
+      int findAndCompress(int i)
+      {
+        while (pParents[i] != i)
+          {
+            pParents[i] = pParents[pParents[i]];
+            i = pParents[i];
+          }
+        return i;
+      }
+
+      void unite(int a, int b)
+      {
+        a = findAndCompress(a);
+        b = findAndCompress(b);
+        if (a == b)
+          return;
+        if (a < b)
+          qSwap(a, b);
+        // Link the larger root under the smaller and carry the
+        // strong mark over.
+        pParents[a] = b;
+        if (pClasses[a] == 2)
+          pClasses[b] = 2;
+      }
+    };
+
+    struct CannyGradientBand
+    {
+      CannyGradientBand(CannyState* state) : s(state) {}
+      void operator() (int firstRow, int rowCount) const
+      {
+        const int iColumns = s->iColumns, iLast = iColumns - 1;
+        const bool bSimd = useSse2();
+        for (int r=firstRow; r<firstRow+rowCount; ++r)
+          {
+            const unsigned char* pAbove = s->image.row(qMax(r-1, 0)),
+              *pCenter = s->image.row(r),
+              *pBelow = s->image.row(qMin(r+1, s->iRows-1));
+            short* pMagnitude = s->pMagnitude + qint64(r) * iColumns;
+            unsigned char* pSectors = s->pClasses + qint64(r) * iColumns;
+            cannyGradient(pAbove, pCenter, pBelow, 0, 0, qMin(1, iLast), pMagnitude, pSectors);
+            int c = 1;
+#ifdef PII_X86_SIMD
+            if (bSimd)
+              c = cannyGradientSse2(pAbove, pCenter, pBelow, iColumns, pMagnitude, pSectors);
+#else
+            Q_UNUSED(bSimd);
+#endif
+            for (; c < iLast; ++c)
+              cannyGradient(pAbove, pCenter, pBelow, c-1, c, c+1, pMagnitude, pSectors);
+            if (iLast > 0)
+              cannyGradient(pAbove, pCenter, pBelow, iLast-1, iLast, iLast, pMagnitude, pSectors);
+
+            if (s->pRowSums != 0)
+              {
+                qint64 iSum = 0, iSquares = 0;
+                for (c=0; c<iColumns; ++c)
+                  {
+                    iSum += pMagnitude[c];
+                    iSquares += pMagnitude[c] * pMagnitude[c];
+                  }
+                s->pRowSums[r] = iSum;
+                s->pRowSquares[r] = iSquares;
+              }
+          }
+      }
+      CannyState* s;
+    };
+
+    struct CannyClassBand
+    {
+      CannyClassBand(CannyState* state) : s(state) {}
+      void operator() (int firstRow, int rowCount) const
+      {
+        const int iColumns = s->iColumns, iLast = iColumns - 1;
+        const bool bSimd = useSse2();
+        for (int r=firstRow; r<firstRow+rowCount; ++r)
+          {
+            unsigned char* pClasses = s->pClasses + qint64(r) * iColumns;
+            // Border pixels have no neighbors on both sides.
+            if (r == 0 || r == s->iRows - 1)
+              {
+                std::memset(pClasses, 0, iColumns);
+                continue;
+              }
+            const short* pCenter = s->pMagnitude + qint64(r) * iColumns,
+              *pAbove = pCenter - iColumns, *pBelow = pCenter + iColumns;
+            pClasses[0] = 0;
+            int c = 1;
+#ifdef PII_X86_SIMD
+            if (bSimd)
+              c = cannyClassesSse2(pAbove, pCenter, pBelow, iColumns, s->iLow, s->iHigh, pClasses);
+#else
+            Q_UNUSED(bSimd);
+#endif
+            for (; c < iLast; ++c)
+              pClasses[c] = cannyClass(pAbove, pCenter, pBelow, c, pClasses[c], s->iLow, s->iHigh);
+            pClasses[iLast] = 0;
+          }
+      }
+      CannyState* s;
+    };
+
+    /* Connects the candidates of a band to their left and upper
+     * neighbors inside the band. Bands are joined afterwards in
+     * cannyEdges().
+     */
+    struct CannyUnionBand
+    {
+      CannyUnionBand(CannyState* state) : s(state) {}
+      void operator() (int firstRow, int rowCount) const
+      {
+        const int iColumns = s->iColumns;
+        const unsigned char* pClasses = s->pClasses;
+        s->pBandStarts[firstRow] = 1;
+        for (int r=firstRow; r<firstRow+rowCount; ++r)
+          {
+            const int iRowStart = r * iColumns;
+            for (int c=0; c<iColumns; ++c)
+              {
+                const int i = iRowStart + c;
+                if (pClasses[i] == 0)
+                  continue;
+                s->pParents[i] = i;
+                if (c > 0 && pClasses[i-1] != 0)
+                  s->unite(i, i-1);
+                if (r > firstRow)
+                  {
+                    const int j = i - iColumns;
+                    if (c > 0 && pClasses[j-1] != 0)
+                      s->unite(i, j-1);
+                    if (pClasses[j] != 0)
+                      s->unite(i, j);
+                    if (c < iColumns - 1 && pClasses[j+1] != 0)
+                      s->unite(i, j+1);
+                  }
+              }
+          }
+      }
+      CannyState* s;
+    };
+
+    struct CannyOutputBand
+    {
+      CannyOutputBand(CannyState* state, PiiMatrix<int>& edges, PiiMatrix<int>* magnitude) :
+        s(state),
+        edgeRows(edges),
+        magnitudeRows(magnitude != 0 ? Pii::BandRows<int>(*magnitude) : Pii::BandRows<int>())
+      {}
+
+      void operator() (int firstRow, int rowCount) const
+      {
+        const int iColumns = s->iColumns;
+        for (int r=firstRow; r<firstRow+rowCount; ++r)
+          {
+            const int iRowStart = r * iColumns;
+            int* pEdgeRow = edgeRows.row(r);
+            for (int c=0; c<iColumns; ++c)
+              {
+                const int i = iRowStart + c;
+                pEdgeRow[c] = s->pClasses[i] != 0 && s->pClasses[s->find(i)] == 2 ? 1 : 0;
+              }
+            if (magnitudeRows.data() != 0)
+              std::copy(s->pMagnitude + iRowStart, s->pMagnitude + iRowStart + iColumns,
+                        magnitudeRows.row(r));
+          }
+      }
+
+      CannyState* s;
+      const Pii::BandRows<int> edgeRows, magnitudeRows;
+    };
+  }
+
+  PiiMatrix<int> cannyEdges(const Pii::ParallelExecution& policy,
+                            const PiiMatrix<unsigned char>& image,
+                            int lowThreshold, int highThreshold,
+                            PiiMatrix<int>* magnitude)
+  {
+    const int iRows = image.rows(), iColumns = image.columns();
+    if (iRows == 0 || iColumns == 0)
+      {
+        if (magnitude != 0)
+          *magnitude = PiiMatrix<int>();
+        return PiiMatrix<int>();
+      }
+
+    const int iCount = iRows * iColumns;
+    PiiMatrix<short> matMagnitude(PiiMatrix<short>::uninitialized(1, iCount));
+    PiiMatrix<unsigned char> matClasses(PiiMatrix<unsigned char>::uninitialized(1, iCount));
+    PiiMatrix<int> matParents(PiiMatrix<int>::uninitialized(1, iCount));
+    PiiMatrix<unsigned char> matBandStarts(1, iRows);
+    QVector<qint64> vecRowSums, vecRowSquares;
+
+    CannyState state(image);
+    state.pMagnitude = matMagnitude.row(0);
+    state.pClasses = matClasses.row(0);
+    state.pParents = matParents.row(0);
+    state.pBandStarts = matBandStarts.row(0);
+    if (highThreshold <= 0)
+      {
+        vecRowSums.resize(iRows);
+        vecRowSquares.resize(iRows);
+        state.pRowSums = vecRowSums.data();
+        state.pRowSquares = vecRowSquares.data();
+      }
+
+    Pii::forEachBand(policy, iRows, 1, CannyGradientBand(&state));
+
+    if (highThreshold <= 0)
+      {
+        qint64 iSum = 0, iSquares = 0;
+        for (int r=0; r<iRows; ++r)
+          {
+            iSum += state.pRowSums[r];
+            iSquares += state.pRowSquares[r];
+          }
+        const double dMean = double(iSum) / iCount,
+          dVariance = qMax(0.0, double(iSquares) / iCount - dMean * dMean);
+        highThreshold = int(dMean + 2 * std::sqrt(dVariance));
+      }
+    if (lowThreshold <= 0)
+      lowThreshold = int(0.4 * highThreshold);
+    // The magnitudes are 16-bit, and a zero magnitude is never an edge.
+    state.iHigh = qBound(1, highThreshold, 32767);
+    state.iLow = qBound(1, qMin(lowThreshold, highThreshold), 32767);
+
+    Pii::forEachBand(policy, iRows, 1, CannyClassBand(&state));
+    Pii::forEachBand(policy, iRows, 1, CannyUnionBand(&state));
+
+    // Join the components across band boundaries.
+    for (int r=1; r<iRows; ++r)
+      {
+        if (!state.pBandStarts[r])
+          continue;
+        for (int c=0; c<iColumns; ++c)
+          {
+            const int i = r * iColumns + c, j = i - iColumns;
+            if (state.pClasses[i] == 0)
+              continue;
+            if (c > 0 && state.pClasses[j-1] != 0)
+              state.unite(i, j-1);
+            if (state.pClasses[j] != 0)
+              state.unite(i, j);
+            if (c < iColumns - 1 && state.pClasses[j+1] != 0)
+              state.unite(i, j+1);
+          }
+      }
+
+    PiiMatrix<int> matEdges(PiiMatrix<int>::uninitialized(iRows, iColumns));
+    if (magnitude != 0)
+      *magnitude = PiiMatrix<int>::uninitialized(iRows, iColumns);
+    Pii::forEachBand(policy, iRows, 0, CannyOutputBand(&state, matEdges, magnitude));
+    return matEdges;
+  }
+
+  namespace
+  {
+    inline int updateBackground(const unsigned char* input, short* background, int* stillCounter,
+                                int first, int columns, int threshold, int rate, int foregroundRate,
+                                int maxStillTime, bool median)
+    {
+      int iForeground = 0;
+      for (int c=first; c<columns; ++c)
+        {
+          const int iFrame = input[c] << 7, iDifference = iFrame - background[c];
+          const bool bForeground = qAbs(iDifference) > threshold;
+          const int iStill = bForeground ? stillCounter[c] + 1 : 0;
+          iForeground += bForeground;
+          if (iStill > maxStillTime)
+            {
+              stillCounter[c] = 0;
+              background[c] = short(iFrame);
+              continue;
+            }
+          stillCounter[c] = iStill;
+          const int iRate = bForeground ? foregroundRate : rate;
+          if (median)
+            background[c] = short(background[c] + qBound(-iRate, iDifference, iRate));
+          else
+            background[c] = short(background[c] + ((iDifference * iRate + (1 << 14)) >> 15));
+        }
+      return iForeground;
+    }
+
+#ifdef PII_X86_SIMD
+    /* Eight pixels at a time. Frame and background values (at most
+     * 255 * 128) and their differences fit into 16 bits. Running
+     * average products are formed in 32 bits with madd: (d, 1) * (w,
+     * 2^14) = d * w + 2^14.
+     */
+    PII_CPU_TARGET("sse2")
+    int updateBackgroundSse2(const unsigned char* input, short* background, int* stillCounter,
+                             int columns, int threshold, int rate, int foregroundRate,
+                             int maxStillTime, bool median, int* processed)
+    {
+      const __m128i zero = _mm_setzero_si128(), one16 = _mm_set1_epi16(1), one32 = _mm_set1_epi32(1),
+        round = _mm_set1_epi16(1 << 14), limit = _mm_set1_epi16(short(threshold)),
+        backgroundRate = _mm_set1_epi16(short(rate)), movingRate = _mm_set1_epi16(short(foregroundRate)),
+        maxStill = _mm_set1_epi32(maxStillTime);
+      __m128i foregroundCounts = zero;
+      int c = 0;
+      for (; c + 8 <= columns; c += 8)
+        {
+          const __m128i frame = _mm_slli_epi16(_mm_unpacklo_epi8(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(input + c)),
+                                                                 zero), 7),
+            model = _mm_loadu_si128(reinterpret_cast<const __m128i*>(background + c)),
+            difference = _mm_sub_epi16(frame, model),
+            foreground = _mm_cmpgt_epi16(_mm_max_epi16(difference, _mm_sub_epi16(zero, difference)), limit);
+          foregroundCounts = _mm_sub_epi16(foregroundCounts, foreground);
+
+          __m128i* pStillLow = reinterpret_cast<__m128i*>(stillCounter + c), *pStillHigh = pStillLow + 1;
+          __m128i stillLow = _mm_and_si128(_mm_unpacklo_epi16(foreground, foreground),
+                                           _mm_add_epi32(_mm_loadu_si128(pStillLow), one32)),
+            stillHigh = _mm_and_si128(_mm_unpackhi_epi16(foreground, foreground),
+                                      _mm_add_epi32(_mm_loadu_si128(pStillHigh), one32));
+          const __m128i resetLow = _mm_cmpgt_epi32(stillLow, maxStill), resetHigh = _mm_cmpgt_epi32(stillHigh, maxStill);
+          _mm_storeu_si128(pStillLow, _mm_andnot_si128(resetLow, stillLow));
+          _mm_storeu_si128(pStillHigh, _mm_andnot_si128(resetHigh, stillHigh));
+
+          const __m128i weights = _mm_or_si128(_mm_and_si128(foreground, movingRate),
+                                               _mm_andnot_si128(foreground, backgroundRate));
+          __m128i update;
+          if (median)
+            update = _mm_max_epi16(_mm_min_epi16(difference, weights), _mm_sub_epi16(zero, weights));
+          else
+            update = _mm_packs_epi32(_mm_srai_epi32(_mm_madd_epi16(_mm_unpacklo_epi16(difference, one16),
+                                                                   _mm_unpacklo_epi16(weights, round)), 15),
+                                     _mm_srai_epi32(_mm_madd_epi16(_mm_unpackhi_epi16(difference, one16),
+                                                                   _mm_unpackhi_epi16(weights, round)), 15));
+          const __m128i reset = _mm_packs_epi32(resetLow, resetHigh),
+            updated = _mm_or_si128(_mm_and_si128(reset, frame),
+                                   _mm_andnot_si128(reset, _mm_add_epi16(model, update)));
+          _mm_storeu_si128(reinterpret_cast<__m128i*>(background + c), updated);
+        }
+      short aCounts[8];
+      _mm_storeu_si128(reinterpret_cast<__m128i*>(aCounts), foregroundCounts);
+      *processed = c;
+      return aCounts[0] + aCounts[1] + aCounts[2] + aCounts[3] +
+        aCounts[4] + aCounts[5] + aCounts[6] + aCounts[7];
+    }
+#endif
+  }
+
+  int updateBackgroundRow(const unsigned char* input, short* background, int* stillCounter,
+                          int columns, int threshold, int rate, int foregroundRate,
+                          int maxStillTime, bool median)
+  {
+    int iForeground = 0, iFirst = 0;
+#ifdef PII_X86_SIMD
+    if (useSse2())
+      iForeground = updateBackgroundSse2(input, background, stillCounter, columns, threshold,
+                                         rate, foregroundRate, maxStillTime, median, &iFirst);
+#endif
+    return iForeground + updateBackground(input, background, stillCounter, iFirst, columns, threshold,
+                                          rate, foregroundRate, maxStillTime, median);
+  }
 }
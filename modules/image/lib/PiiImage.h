@@ -22,6 +22,9 @@
 #include <PiiDsp.h>
 #include <PiiColor.h>
 #include <PiiPoint.h>
+#include <PiiParallel.h>
+#include "PiiColorChannelMatrix.h"
+#include <QList>
 
 /**
  * Definitions and functions for image processing.
@@ -198,6 +201,8 @@ namespace PiiImage
    *
    * @return the channel as a matrix whose dimensions equal to the
    * input image.
+   *
+   * @see channelView()
    */
   template <class ColorType> PiiMatrix<typename ColorType::Type> colorChannel(const PiiMatrix<ColorType>& image,
                                                                               int channel);
@@ -476,6 +481,61 @@ namespace PiiImage
                                                 int smoothWidth = 0,
                                                 T lowThreshold = 0, T highThreshold = 0);
 
+  /**
+   * Detect edges in an 8-bit gray-level image with the Canny edge
+   * detector. This is a fast version of [detectEdges()] for the most
+   * common image type. Sobel gradients, their magnitude (\(|x| +
+   * |y|\)) and the quantized gradient direction are computed in a
+   * single pass using 16-bit integers. Non-maximum suppression
+   * processes eight pixels at a time if the processor supports
+   * SIMD instructions. Hysteresis thresholding joins edge candidates
+   * with a union-find structure, which makes it possible to process
+   * all phases in parallel bands of rows.
+   *
+   * Unlike [detectEdges()], this function does not smooth the image,
+   * replicates border pixels when calculating gradients and
+   * quantizes the gradient direction to four symmetric sectors
+   * centered at multiples of 45 degrees. Pixels on the image border
+   * are never marked as edges.
+   *
+   * @param policy the parallel execution policy
+   *
+   * @param image a gray-level image in which edges are to be found
+   *
+   * @param lowThreshold the low threshold value for hysteresis
+   * thresholding. If zero, 0.4 * highThreshold will be used.
+   *
+   * @param highThreshold the high threshold value for hysteresis
+   * thresholding. If zero, mean+2*std of the gradient magnitude will
+   * be used.
+   *
+   * @param magnitude if non-zero, the gradient magnitude will be
+   * stored here.
+   *
+   * @return a binary image in which detected edges are ones and other
+   * pixels zeros.
+   *
+   * ~~~(c++)
+   * PiiMatrix<unsigned char> image; // read somewhere
+   * PiiMatrix<int> matEdges(PiiImage::cannyEdges(Pii::ParallelExecution(), image));
+   * ~~~
+   */
+  PII_IMAGE_EXPORT PiiMatrix<int> cannyEdges(const Pii::ParallelExecution& policy,
+                                             const PiiMatrix<unsigned char>& image,
+                                             int lowThreshold = 0, int highThreshold = 0,
+                                             PiiMatrix<int>* magnitude = 0);
+
+  /**
+   * Detect edges in the calling thread only. See
+   * [cannyEdges(const Pii::ParallelExecution&, const PiiMatrix<unsigned char>&, int, int, PiiMatrix<int>*)].
+   */
+  inline PiiMatrix<int> cannyEdges(const PiiMatrix<unsigned char>& image,
+                                   int lowThreshold = 0, int highThreshold = 0,
+                                   PiiMatrix<int>* magnitude = 0)
+  {
+    return cannyEdges(Pii::ParallelExecution(1), image, lowThreshold, highThreshold, magnitude);
+  }
+
   /**
    * Filter an image with the given filter. This is equivalent to
    * PiiDsp::filter(), except for the `mode` parameter.
@@ -809,6 +869,20 @@ namespace PiiImage
                                                int windowRows = 3, int windowColumns = 0,
                                                Pii::ExtendMode mode = Pii::ExtendZeros);
 
+  /**
+   * Filters an image with a median filter in parallel. The image is
+   * split into bands of rows as determined by *policy*. The result is
+   * equal to that of the sequential version.
+   *
+   * ~~~(c++)
+   * PiiMatrix<int> matFiltered(PiiImage::medianFilter(Pii::ParallelExecution(), image, 9));
+   * ~~~
+   */
+  template <class T> PiiMatrix<T> medianFilter(const Pii::ParallelExecution& policy,
+                                               const PiiMatrix<T>& image,
+                                               int windowRows = 3, int windowColumns = 0,
+                                               Pii::ExtendMode mode = Pii::ExtendZeros);
+
   template <class Input, class Output, class BinaryFunction>
   void medianFilter(const Input& image,
                     int windowRows,
@@ -816,10 +890,54 @@ namespace PiiImage
                     Output& output,
                     BinaryFunction padded);
 
+  /**
+   * Filters an image with a rank filter. Each pixel is replaced with
+   * the *rank*th smallest value in its neighborhood. With a rank of
+   * zero, the filter works as a minimum filter, and with
+   * *windowRows* * *windowColumns* - 1 as a maximum filter. Window
+   * size and border handling are the same as in [medianFilter()].
+   *
+   * The implementation uses sliding histograms and is thus limited to
+   * 8 and 16 bit images. With 8-bit images, the processing time per
+   * pixel does not depend on the window size (Perreault & Hébert:
+   * Median Filtering in Constant Time). With 16-bit images, it grows
+   * linearly with *windowRows*.
+   *
+   * @param rank the rank of the output value in the sorted
+   * neighborhood, in [0, *windowRows* * *windowColumns* - 1].
+   *
+   * ~~~(c++)
+   * // 25th percentile in a 15-by-15 neighborhood
+   * PiiMatrix<unsigned char> matFiltered(PiiImage::rankFilter(image, 15, 15, 56));
+   * ~~~
+   */
+  PII_IMAGE_EXPORT PiiMatrix<unsigned char> rankFilter(const PiiMatrix<unsigned char>& image,
+                                                       int windowRows, int windowColumns, int rank,
+                                                       Pii::ExtendMode mode = Pii::ExtendZeros);
+  PII_IMAGE_EXPORT PiiMatrix<unsigned short> rankFilter(const PiiMatrix<unsigned short>& image,
+                                                        int windowRows, int windowColumns, int rank,
+                                                        Pii::ExtendMode mode = Pii::ExtendZeros);
+
+  /**
+   * Filters an image with a histogram-based median filter. The
+   * result is equal to that of [medianFilter()], but the function is
+   * much faster with large windows. See [rankFilter()].
+   */
+  PII_IMAGE_EXPORT PiiMatrix<unsigned char> histogramMedianFilter(const PiiMatrix<unsigned char>& image,
+                                                                  int windowRows = 3, int windowColumns = 0,
+                                                                  Pii::ExtendMode mode = Pii::ExtendZeros);
+  PII_IMAGE_EXPORT PiiMatrix<unsigned short> histogramMedianFilter(const PiiMatrix<unsigned short>& image,
+                                                                   int windowRows = 3, int windowColumns = 0,
+                                                                   Pii::ExtendMode mode = Pii::ExtendZeros);
+
   /**
    * Filters *image* with a maximum filter. The maximum filter is a
    * non-linear filter that produces an image in which each pixel is
-   * replaced by the local maximum.
+   * replaced by the local maximum. Pixels outside of the image are
+   * ignored. The filter is computed with two one-dimensional passes
+   * of the van Herk/Gil-Werman algorithm (see
+   * [separableExtremum()]), and its cost per pixel does not depend on
+   * the size of the window.
    *
    * @param image the input image
    *
@@ -833,6 +951,14 @@ namespace PiiImage
   template <class T> PiiMatrix<T> maxFilter(const PiiMatrix<T>& image,
                                             int windowRows, int windowColumns = -1);
 
+  /**
+   * Filters *image* with a maximum filter in parallel. The image is
+   * split into bands of rows as determined by *policy*.
+   */
+  template <class T> PiiMatrix<T> maxFilter(const Pii::ParallelExecution& policy,
+                                            const PiiMatrix<T>& image,
+                                            int windowRows, int windowColumns = -1);
+
   /**
    * Filters *image* with a minimum filter. The minimum filter is
    * similar to the maximum filter, but calculates the local minimum
@@ -842,6 +968,15 @@ namespace PiiImage
    */
   template <class T> PiiMatrix<T> minFilter(const PiiMatrix<T>& image,
                                             int windowRows, int windowColumns = -1);
+
+  /**
+   * Filters *image* with a minimum filter in parallel. The image is
+   * split into bands of rows as determined by *policy*.
+   */
+  template <class T> PiiMatrix<T> minFilter(const Pii::ParallelExecution& policy,
+                                            const PiiMatrix<T>& image,
+                                            int windowRows, int windowColumns = -1);
+
   /**
    * Scales image to a specified size.
    *
@@ -888,6 +1023,78 @@ namespace PiiImage
    */
   template <class T> PiiMatrix<T> oneSixteenthSize(const PiiMatrix<T>& image);
 
+  /**
+   * Low-pass filters used in building image pyramids.
+   *
+   * - `BoxPyramidFilter` - each pixel on the next level is the
+   * average of a 2-by-2 block. Fast, but leaves some aliasing.
+   *
+   * - `GaussianPyramidFilter` - the image is smoothed with a 5-by-5
+   * binomial kernel ([1 4 6 4 1]/16 in both directions) before
+   * dropping every other row and column.
+   */
+  enum PyramidFilter { BoxPyramidFilter, GaussianPyramidFilter };
+
+  /**
+   * Halves the size of *image* after low-pass filtering it with
+   * *filter*. The result has (image.rows()+1)/2 rows and
+   * (image.columns()+1)/2 columns. Pixels outside of the image are
+   * replaced with the nearest edge pixel. With 8-bit gray-level and
+   * color images, the filter is evaluated with integer arithmetic.
+   *
+   * ~~~(c++)
+   * PiiMatrix<unsigned char> matHalf(PiiImage::pyramidDown(Pii::ParallelExecution(), image));
+   * ~~~
+   */
+  template <class T> PiiMatrix<T> pyramidDown(const Pii::ParallelExecution& policy,
+                                              const PiiMatrix<T>& image,
+                                              PyramidFilter filter = GaussianPyramidFilter);
+
+  /**
+   * Halves the size of *image* in the calling thread.
+   */
+  template <class T> PiiMatrix<T> pyramidDown(const PiiMatrix<T>& image,
+                                              PyramidFilter filter = GaussianPyramidFilter)
+  {
+    return pyramidDown(Pii::ParallelExecution(1), image, filter);
+  }
+
+  /**
+   * Builds an image pyramid by repeatedly applying [pyramidDown()]
+   * to *image*. The first level of the returned list is *image*
+   * itself (a shallow copy), and the size of each subsequent level is
+   * half of the previous one. Building stops early if the image is
+   * reduced to a single pixel, so the list may contain less than
+   * *levels* entries.
+   *
+   * Compute the pyramid once and pass the levels to all algorithms
+   * that work on multiple scales instead of letting each of them
+   * downsample the image independently.
+   *
+   * ~~~(c++)
+   * QList<PiiMatrix<unsigned char> > lstLevels(PiiImage::buildPyramid(Pii::ParallelExecution(),
+   *                                                                   image, 4));
+   * // Coarse search on lstLevels.last(), refinement on finer levels
+   * ~~~
+   *
+   * @param levels the maximum number of levels, including the
+   * original image. Values smaller than one are treated as one.
+   */
+  template <class T> QList<PiiMatrix<T> > buildPyramid(const Pii::ParallelExecution& policy,
+                                                       const PiiMatrix<T>& image,
+                                                       int levels,
+                                                       PyramidFilter filter = GaussianPyramidFilter);
+
+  /**
+   * Builds an image pyramid in the calling thread.
+   */
+  template <class T> QList<PiiMatrix<T> > buildPyramid(const PiiMatrix<T>& image,
+                                                       int levels,
+                                                       PyramidFilter filter = GaussianPyramidFilter)
+  {
+    return buildPyramid(Pii::ParallelExecution(1), image, levels, filter);
+  }
+
   /**
    * Transforms a 2D point using *transform*. The source point is
    * represented in homogeneous coordinates; it is assumed that the
@@ -1017,12 +1224,29 @@ namespace PiiImage
    * transformation matrices. Assume *R* is a rotation transform and
    * *S* is a shear transform. Shear after rotate transform is
    * obtained with \(T = SR\).
+   *
+   * Only affine transforms are supported; the last row of
+   * *transform* is ignored. Source coordinates are stepped
+   * incrementally in fixed point, and the output is processed in
+   * tiles of 64-by-32 pixels to keep source accesses local even if
+   * the image is rotated. The pixels are sampled with bilinear
+   * interpolation at 1/256 pixel accuracy.
    */
   template <class T> PiiMatrix<T> transform(const PiiMatrix<T>& image,
                                             const PiiMatrix<float>& transform,
                                             TransformedSize handling = ExpandAsNecessary,
                                             T backgroundColor = T(0));
 
+  /**
+   * Same as above, but processes horizontal bands of the result
+   * image in parallel.
+   */
+  template <class T> PiiMatrix<T> transform(const Pii::ParallelExecution& policy,
+                                            const PiiMatrix<T>& image,
+                                            const PiiMatrix<float>& transform,
+                                            TransformedSize handling = ExpandAsNecessary,
+                                            T backgroundColor = T(0));
+
   /**
    * Rotates image clockwise `theta` radians around its center.
    *
@@ -1042,6 +1266,16 @@ namespace PiiImage
                                          TransformedSize handling = ExpandAsNecessary,
                                          T backgroundColor = T(0));
 
+  /**
+   * Same as above, but uses [transform()] in parallel for arbitrary
+   * angles.
+   */
+  template <class T> PiiMatrix<T> rotate(const Pii::ParallelExecution& policy,
+                                         const PiiMatrix<T>& image,
+                                         double theta,
+                                         TransformedSize handling = ExpandAsNecessary,
+                                         T backgroundColor = T(0));
+
   /**
    * Crop a rectangular area out of a transformed image, in which the
    * target may not appear as a rectangular object. This function
@@ -1122,19 +1356,59 @@ namespace PiiImage
                            PiiMatrix<typename Matrix::value_type>& result);
 
   /**
-   * Detects corners in *image* using the FAST corner detector.
+   * Detects corners in *image* using the FAST corner detector. A
+   * pixel is a corner if at least *arcLength* contiguous pixels on a
+   * circle of radius three around it are all brighter or all darker
+   * than the center by more than *threshold*. The score of a corner is
+   * the smallest absolute difference to the center on its best arc.
+   * Corners whose 8-connected neighbors have an equal or higher score
+   * are suppressed.
    *
-   * @param image the input image
+   * With 8-bit images, 16 or 32 pixels are tested at once using SSE2,
+   * AVX2 or NEON instructions if the processor supports them. Scores
+   * are computed only for the pixels that pass the segment test.
+   *
+   * @param image the input image. Corners closer than three pixels
+   * to the image border are never detected.
    *
    * @param threshold detection threshold. This value affects both the
    * number of detections and the detection speed. A high value
    * accepts only strong corners. The lower the value, the more
    * corners are detected, which also means lower processing speed.
    *
+   * @param arcLength the minimum number of contiguous pixels on the
+   * circle, between 9 (FAST-9) and 12 (FAST-12).
+   *
    * @return a N-by-2 matrix in which each row stores the (x,y)
-   * coordinates of a detected corner.
+   * coordinates of a detected corner. The corners are in raster scan
+   * order.
+   */
+  template <class T> PiiMatrix<int> detectFastCorners(const PiiMatrix<T>& image, T threshold=25, int arcLength=9);
+
+  /**
+   * Detects corners using the FAST corner detector and retains at
+   * most *maxCornersPerCell* strongest corners in each *cellSize*
+   * by *cellSize* cell of a grid laid over the image. This spreads
+   * the corners more evenly over the image than a global threshold,
+   * which is useful for feature tracking. If either *cellSize* or
+   * *maxCornersPerCell* is less than one, no grid is used.
+   *
+   * ~~~(c++)
+   * // At most 4 corners in each 32-by-32 cell
+   * PiiMatrix<int> matCorners(PiiImage::detectFastCorners(image, 20, 9, 32, 4));
+   * ~~~
    */
-  template <class T> PiiMatrix<int> detectFastCorners(const PiiMatrix<T>& image, T threshold=25);
+  template <class T> PiiMatrix<int> detectFastCorners(const PiiMatrix<T>& image, T threshold,
+                                                      int arcLength, int cellSize, int maxCornersPerCell);
+
+  /// @hide
+  // Runs the segment test for 8-bit pixels in SIMD registers if
+  // possible. *offsets* are the byte offsets of the circle pixels.
+  // Stores the indices of the passed pixels to *candidates* and
+  // returns their number.
+  PII_IMAGE_EXPORT int fastCornerCandidates(const unsigned char* centers, const int* offsets, int count,
+                                            unsigned char threshold, int arcLength, int* candidates);
+  /// @endhide
 
   /**
    * Transforms *image* according to the given coordinate *map*. The
@@ -1149,6 +1423,84 @@ namespace PiiImage
    */
   template <class T, class U> PiiMatrix<T> remap(const PiiMatrix<T>& image, const PiiMatrix<PiiPoint<U> >& map);
 
+  /**
+   * A coordinate map converted to a form that is fast to apply to
+   * many images. For each pixel in the result image, the table stores
+   * the integer coordinates of the top left source pixel and the
+   * fractional part of the source position in 1/256 pixel steps. The
+   * table is built once against a fixed source image size, and
+   * [remap()] then only needs to look up and blend four pixels with
+   * precomputed weights, without any bounds checking or floating
+   * point coordinate math per pixel.
+   *
+   * ~~~(c++)
+   * PiiImage::RemapTable table(PiiCalibration::undistortMap(480, 640, intrinsic));
+   * while (grabImage(&image)) // PiiMatrix<unsigned char>
+   *   process(PiiImage::remap(Pii::ParallelExecution(), image, table));
+   * ~~~
+   */
+  class PII_IMAGE_EXPORT RemapTable
+  {
+  public:
+    /// The number of fractional bits in source coordinates.
+    enum { FractionBits = 8, FractionScale = 1 << FractionBits };
+
+    /**
+     * Creates an empty table.
+     */
+    RemapTable();
+    /**
+     * Creates a table that samples a *sourceRows*-by-*sourceColumns*
+     * image with bilinear interpolation. Map entries that point
+     * outside of the source image produce black pixels. If the
+     * source size is not given, it is assumed to be equal to the size
+     * of the map.
+     */
+    RemapTable(const DoubleCoordinateMap& map, int sourceRows = -1, int sourceColumns = -1);
+    /**
+     * Creates a table that picks the source pixels without
+     * interpolation.
+     */
+    RemapTable(const IntCoordinateMap& map, int sourceRows = -1, int sourceColumns = -1);
+
+    /// Returns the number of rows in the result image.
+    int rows() const { return matPositions.rows(); }
+    /// Returns the number of columns in the result image.
+    int columns() const { return matPositions.columns(); }
+    bool isEmpty() const { return matPositions.isEmpty(); }
+
+    /// Returns the number of rows the source image must have.
+    int sourceRows() const { return iSourceRows; }
+    /// Returns the number of columns the source image must have.
+    int sourceColumns() const { return iSourceColumns; }
+
+    /// @internal
+    int iSourceRows, iSourceColumns;
+    /// @internal Top left source pixel. Negative x means "outside".
+    PiiMatrix<PiiPoint<int> > matPositions;
+    /// @internal Fractional source position, 0 to FractionScale-1.
+    PiiMatrix<PiiPoint<unsigned short> > matFractions;
+  };
+
+  /**
+   * Transforms *image* according to a precomputed remap *table*.
+   * Gives the same result as [remap()] with the coordinate map the
+   * table was built from, except that the sampling positions are
+   * rounded to 1/256 pixels and interpolated integer pixel values
+   * are rounded instead of truncated.
+   *
+   * @exception PiiInvalidArgumentException& if the size of *image*
+   * does not match the source size of *table*.
+   */
+  template <class T> PiiMatrix<T> remap(const PiiMatrix<T>& image, const RemapTable& table);
+
+  /**
+   * Same as above, but processes horizontal bands of the result
+   * image in parallel.
+   */
+  template <class T> PiiMatrix<T> remap(const Pii::ParallelExecution& policy,
+                                        const PiiMatrix<T>& image, const RemapTable& table);
+
   template <class T, class Matrix, class UnaryFunction>
   PiiMatrix<T> collectCoordinates(const Matrix& image,
                                   UnaryFunction decisionRule)
@@ -1250,6 +1602,22 @@ namespace PiiImage
    */
   template <class Matrix, class GradientFunction>
   void fastGradient(const Matrix& input, GradientFunction function);
+
+  /// @hide
+  // Updates one row of a fixed-point background model in SIMD
+  // registers if possible. *background* stores gray levels times
+  // 128. A pixel is foreground if its distance to the background
+  // exceeds *threshold*. Foreground pixels increment *stillCounter*;
+  // pixels whose counter exceeds *maxStillTime* are reset to the
+  // current frame. Otherwise, the background moves towards the frame
+  // by *rate* (*foregroundRate* for foreground pixels). With a running
+  // average, the rates are weights times 32768. With an approximate
+  // median, they are maximum steps in background units. Returns the
+  // number of foreground pixels.
+  PII_IMAGE_EXPORT int updateBackgroundRow(const unsigned char* input, short* background, int* stillCounter,
+                                           int columns, int threshold, int rate, int foregroundRate,
+                                           int maxStillTime, bool median);
+  /// @endhide
 }
 
 #include "PiiImage-templates.h"
@@ -113,6 +113,12 @@ namespace PiiImage
            Pii::sin(dAlpha2)) * focalLength);
     */
 
+    // The source position is the same on each row. Calculate it
+    // once for each column and then process the image row by row.
+    PiiMatrix<int> matColumns(PiiMatrix<int>::uninitialized(1, iStraightenedLength));
+    PiiMatrix<RealScalar> matFractions(PiiMatrix<RealScalar>::uninitialized(1, iStraightenedLength));
+    int* pColumns = matColumns.row(0);
+    RealScalar* pFractions = matFractions.row(0);
     for (int i=0; i<iStraightenedLength; ++i)
       {
         // Parametric equation of the surface:
@@ -129,24 +135,27 @@ namespace PiiImage
           dPixelX = iLastPixel;
 
         // Floor to nearest int
-        int iPixelX = int(dPixelX);
+        pColumns[i] = int(dPixelX);
         // Take fraction
-        RealScalar dF1(dPixelX - iPixelX);
+        pFractions[i] = RealScalar(dPixelX - pColumns[i]);
 
-        // Linear interpolation
-        if (dF1 > 0)
-          {
-            RealScalar dF2(1.0 - dF1);
-            for (int r=0; r<warpedImage.rows(); ++r)
-              matResult(r,i) = T(Real(warpedImage(r,iPixelX)) * dF2 + Real(warpedImage(r,iPixelX+1)) * dF1);
-          }
-        else
+        //qDebug("i = %d, dAlpha = %lf, cos = %lf, sin = %lf, dXp = %lf", i, dAlpha * 180 / M_PI, dCosAlpha, dSinAlpha, dPixelX);
+      }
+
+    for (int r=0; r<warpedImage.rows(); ++r)
+      {
+        const T* pSourceRow = warpedImage[r];
+        T* pResultRow = matResult[r];
+        for (int i=0; i<iStraightenedLength; ++i)
           {
-            for (int r=0; r<warpedImage.rows(); ++r)
-              matResult(r,i) = warpedImage(r,iPixelX);
+            const int iPixelX = pColumns[i];
+            const RealScalar dF1 = pFractions[i];
+            // Linear interpolation
+            if (dF1 > 0)
+              pResultRow[i] = T(Real(pSourceRow[iPixelX]) * RealScalar(1.0 - dF1) + Real(pSourceRow[iPixelX+1]) * dF1);
+            else
+              pResultRow[i] = pSourceRow[iPixelX];
           }
-
-        //qDebug("i = %d, dAlpha = %lf, cos = %lf, sin = %lf, dXp = %lf", i, dAlpha * 180 / M_PI, dCosAlpha, dSinAlpha, dPixelX);
       }
 
     if (radius != 0)
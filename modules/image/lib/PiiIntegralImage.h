@@ -0,0 +1,290 @@
+/* This file is part of Into.
+ * Copyright (C) Intopii 2013.
+ * All rights reserved.
+ *
+ * Licensees holding a commercial Into license may use this file in
+ * accordance with the commercial license agreement. Please see
+ * LICENSE.commercial for commercial licensing terms.
+ *
+ * Alternatively, this file may be used under the terms of the GNU
+ * Affero General Public License version 3 as published by the Free
+ * Software Foundation. In addition, Intopii gives you special rights
+ * to use Into as a part of open source software projects. Please
+ * refer to LICENSE.AGPL3 for details.
+ */
+
+#ifndef _PIIINTEGRALIMAGE_H
+#define _PIIINTEGRALIMAGE_H
+
+#include <PiiMatrix.h>
+
+namespace PiiImage
+{
+  /**
+   * Accumulator types for integral images. `SumType` is used for the
+   * sums of pixel values and `SquareSumType` for the sums of their
+   * squares. The types are chosen so that the sum over any window in
+   * an image of any practical size is exact.
+   *
+   * Unsigned integer accumulators are allowed to wrap around. Since
+   * a box sum is a difference of four accumulated values, the result
+   * is correct as long as the sum over the box itself fits into the
+   * accumulator. This makes it possible to use 32-bit sums with 8-bit
+   * images independent of the image size: the box may contain up to
+   * 2^24 pixels.
+   *
+   * Floating-point and 64-bit integer pixels are accumulated as
+   * `double`.
+   */
+  template <class T> struct IntegralTraits
+  {
+    typedef double SumType;
+    typedef double SquareSumType;
+  };
+
+  /// @hide
+  template <> struct IntegralTraits<unsigned char>
+  {
+    typedef unsigned int SumType;
+    typedef quint64 SquareSumType;
+  };
+
+  template <> struct IntegralTraits<char>
+  {
+    typedef qint64 SumType;
+    typedef qint64 SquareSumType;
+  };
+
+  template <> struct IntegralTraits<signed char> : IntegralTraits<char> {};
+  template <> struct IntegralTraits<short> : IntegralTraits<char> {};
+  template <> struct IntegralTraits<unsigned short> : IntegralTraits<char> {};
+
+  template <> struct IntegralTraits<int>
+  {
+    typedef qint64 SumType;
+    typedef double SquareSumType;
+  };
+
+  template <> struct IntegralTraits<unsigned int> : IntegralTraits<int> {};
+  /// @endhide
+
+  /**
+   * An integral image, and optionally an integral image of squared
+   * pixel values. Once calculated, the sum, mean and variance of any
+   * rectangular window can be found in constant time, independent of
+   * the size of the window.
+   *
+   * Element (r,c) of the integral image contains the sum of all
+   * pixels above and left of (r,c). The integral image is one row and
+   * one column larger than the input.
+   *
+   * ~~~(c++)
+   * PiiMatrix<unsigned char> image(...);
+   * PiiImage::IntegralImage<unsigned char> integral(image, true);
+   * // Local variance in a 15-by-15 window
+   * PiiMatrix<float> matVariance(integral.boxVariances<float>(15, 15));
+   * // Mean of the top left 10-by-10 area
+   * double dMean = integral.mean(0, 0, 10, 10);
+   * ~~~
+   *
+   * @see Pii::cumulativeSum()
+   */
+  template <class T> class IntegralImage
+  {
+  public:
+    typedef typename IntegralTraits<T>::SumType SumType;
+    typedef typename IntegralTraits<T>::SquareSumType SquareSumType;
+
+    /**
+     * Creates an empty integral image.
+     */
+    IntegralImage() {}
+
+    /**
+     * Calculates the integral image of *image*.
+     *
+     * @param image the input image. Any matrix type whose
+     * `value_type` is *T*.
+     *
+     * @param squares if `true`, also calculate the integral image of
+     * squared pixel values. This is needed by [squareSum()],
+     * [variance()] and [boxVariances()].
+     */
+    template <class Matrix> explicit IntegralImage(const Matrix& image, bool squares = false);
+
+    /**
+     * Returns the number of rows in the original image.
+     */
+    int rows() const { return qMax(_matSums.rows() - 1, 0); }
+    /**
+     * Returns the number of columns in the original image.
+     */
+    int columns() const { return qMax(_matSums.columns() - 1, 0); }
+
+    /**
+     * Returns `true` if the integral image of squares has been
+     * calculated.
+     */
+    bool hasSquareSums() const { return !_matSquareSums.isEmpty(); }
+
+    /**
+     * Returns the sum of pixel values in rows [*r1*, *r2*) and
+     * columns [*c1*, *c2*).
+     */
+    SumType sum(int r1, int c1, int r2, int c2) const
+    {
+      return boxSum(_matSums[r1], _matSums[r2], c1, c2);
+    }
+
+    /**
+     * Returns the sum of squared pixel values in rows [*r1*, *r2*)
+     * and columns [*c1*, *c2*).
+     */
+    SquareSumType squareSum(int r1, int c1, int r2, int c2) const
+    {
+      return boxSum(_matSquareSums[r1], _matSquareSums[r2], c1, c2);
+    }
+
+    /**
+     * Returns the mean of pixel values in rows [*r1*, *r2*) and
+     * columns [*c1*, *c2*). The area must not be empty.
+     */
+    double mean(int r1, int c1, int r2, int c2) const
+    {
+      return double(sum(r1, c1, r2, c2)) / ((r2-r1) * (c2-c1));
+    }
+
+    /**
+     * Returns the variance of pixel values in rows [*r1*, *r2*) and
+     * columns [*c1*, *c2*). The area must not be empty.
+     */
+    double variance(int r1, int c1, int r2, int c2) const
+    {
+      const double dCount = (r2-r1) * (c2-c1), dMean = double(sum(r1, c1, r2, c2)) / dCount;
+      return qMax(0.0, double(squareSum(r1, c1, r2, c2)) / dCount - dMean * dMean);
+    }
+
+    /**
+     * Returns the mean of a *windowRows*-by-*windowColumns* window
+     * centered at each pixel. If *windowColumns* is less than one,
+     * the window is square. At the borders, only the part of the
+     * window that is inside of the image is used.
+     */
+    template <class U> PiiMatrix<U> boxMeans(int windowRows, int windowColumns = 0) const;
+
+    /**
+     * Returns the variance of a *windowRows*-by-*windowColumns*
+     * window centered at each pixel. The integral image of squares
+     * must have been calculated. See [boxMeans()] for the details.
+     */
+    template <class U> PiiMatrix<U> boxVariances(int windowRows, int windowColumns = 0) const;
+
+    /**
+     * Returns the integral image.
+     */
+    PiiMatrix<SumType> sums() const { return _matSums; }
+
+    /**
+     * Returns the integral image of squares, or an empty matrix if it
+     * has not been calculated.
+     */
+    PiiMatrix<SquareSumType> squareSums() const { return _matSquareSums; }
+
+    /**
+     * Returns the sum of a box given the rows of an integral image
+     * above (*previous*) and below (*next*) the box.
+     */
+    template <class S> static inline S boxSum(const S* previous, const S* next, int c1, int c2)
+    {
+      return S(next[c2] - next[c1] - previous[c2] + previous[c1]);
+    }
+
+  private:
+    template <class U, bool squares> PiiMatrix<U> boxStatistics(int windowRows, int windowColumns) const;
+
+    PiiMatrix<SumType> _matSums;
+    PiiMatrix<SquareSumType> _matSquareSums;
+  };
+
+  template <class T> template <class Matrix>
+  IntegralImage<T>::IntegralImage(const Matrix& image, bool squares)
+  {
+    const int iRows = image.rows(), iCols = image.columns();
+    _matSums = PiiMatrix<SumType>(iRows + 1, iCols + 1);
+    if (squares)
+      _matSquareSums = PiiMatrix<SquareSumType>(iRows + 1, iCols + 1);
+
+    for (int r=0; r<iRows; ++r)
+      {
+        typename Matrix::const_row_iterator pSource = image[r];
+        const SumType* pPrevious = _matSums[r];
+        SumType* pSums = _matSums[r+1];
+        SumType rowSum = 0;
+        if (squares)
+          {
+            const SquareSumType* pPrevious2 = _matSquareSums[r];
+            SquareSumType* pSquareSums = _matSquareSums[r+1];
+            SquareSumType rowSum2 = 0;
+            for (int c=0; c<iCols; ++c)
+              {
+                const SquareSumType value = SquareSumType(pSource[c]);
+                rowSum += SumType(pSource[c]);
+                rowSum2 += value * value;
+                pSums[c+1] = pPrevious[c+1] + rowSum;
+                pSquareSums[c+1] = pPrevious2[c+1] + rowSum2;
+              }
+          }
+        else
+          {
+            for (int c=0; c<iCols; ++c)
+              {
+                rowSum += SumType(pSource[c]);
+                pSums[c+1] = pPrevious[c+1] + rowSum;
+              }
+          }
+      }
+  }
+
+  template <class T> template <class U, bool squares>
+  PiiMatrix<U> IntegralImage<T>::boxStatistics(int windowRows, int windowColumns) const
+  {
+    if (windowColumns <= 0)
+      windowColumns = windowRows;
+    const int iRows = rows(), iCols = columns(),
+      iHalfRows = windowRows/2, iHalfCols = windowColumns/2;
+    PiiMatrix<U> matResult(PiiMatrix<U>::uninitialized(iRows, iCols));
+    for (int r=0; r<iRows; ++r)
+      {
+        const int r1 = qMax(r-iHalfRows, 0), r2 = qMin(r+iHalfRows+1, iRows);
+        const SumType* pPrevious = _matSums[r1], *pNext = _matSums[r2];
+        const SquareSumType* pPrevious2 = squares ? _matSquareSums[r1] : 0;
+        const SquareSumType* pNext2 = squares ? _matSquareSums[r2] : 0;
+        U* pTarget = matResult[r];
+        for (int c=0; c<iCols; ++c)
+          {
+            const int c1 = qMax(c-iHalfCols, 0), c2 = qMin(c+iHalfCols+1, iCols);
+            const double dCount = (c2-c1) * (r2-r1);
+            const double dMean = double(boxSum(pPrevious, pNext, c1, c2)) / dCount;
+            if (squares)
+              pTarget[c] = U(qMax(0.0, double(boxSum(pPrevious2, pNext2, c1, c2)) / dCount - dMean * dMean));
+            else
+              pTarget[c] = U(dMean);
+          }
+      }
+    return matResult;
+  }
+
+  template <class T> template <class U>
+  PiiMatrix<U> IntegralImage<T>::boxMeans(int windowRows, int windowColumns) const
+  {
+    return boxStatistics<U,false>(windowRows, windowColumns);
+  }
+
+  template <class T> template <class U>
+  PiiMatrix<U> IntegralImage<T>::boxVariances(int windowRows, int windowColumns) const
+  {
+    return boxStatistics<U,true>(windowRows, windowColumns);
+  }
+}
+
+#endif //_PIIINTEGRALIMAGE_H
@@ -18,9 +18,16 @@
 
 #include "PiiImageGlobal.h"
 #include <PiiMatrix.h>
+#include <PiiFunctional.h>
+#include <PiiParallel.h>
+#include <PiiAtomicInt.h>
+#include <PiiSmartPtr.h>
 #include <QVector>
+#include <QList>
 #include <QPair>
 #include <QStack>
+#include <QMutex>
+#include <algorithm>
 #include <functional>
 #include <climits>
 
@@ -39,6 +46,7 @@ namespace PiiImage
     inline void setInitialLabels(const QVector<int>&) {}
     inline void addLabel() {}
     inline void addPixel(int) {}
+    inline void addPixels(int, int) {}
     inline void limitLabels(QVector<int>&) {}
   };
 
@@ -80,6 +88,14 @@ namespace PiiImage
     {
       ++_vecCounts[label];
     }
+    /**
+     * Adds *count* pixels to the histogram of *label* at once. Used
+     * by the parallel version of labelImage().
+     */
+    inline void addPixels(int label, int count)
+    {
+      _vecCounts[label] += count;
+    }
     /**
      * Retains all labels with more than `minimumSize` histogram
      * entries. Sets all other labels to zero. The input vector labels
@@ -159,11 +175,12 @@ namespace PiiImage
   };
 
   template <class Matrix, class UnaryOp, class Limiter>
-  void labelImage(const Matrix& mat,
-                  PiiMatrix<int>& labels,
-                  UnaryOp rule,
-                  Limiter limiter,
-                  int* labelCount = 0);
+  typename Pii::OnlyIf<!Pii::IsSame<Matrix,Pii::ParallelExecution>::boolValue, void>::Type
+  labelImage(const Matrix& mat,
+             PiiMatrix<int>& labels,
+             UnaryOp rule,
+             Limiter limiter,
+             int* labelCount = 0);
 
   /**
    * Labels an image using 4-connectivity. This function uses the
@@ -215,11 +232,12 @@ namespace PiiImage
    * input, and it must be initialized to zeros.
    */
   template <class Matrix, class UnaryOp, class Limiter>
-  void labelImage(const Matrix& mat,
-                  PiiMatrix<int>& labels,
-                  UnaryOp rule,
-                  Limiter limiter,
-                  int* labelCount = 0)
+  typename Pii::OnlyIf<!Pii::IsSame<Matrix,Pii::ParallelExecution>::boolValue, void>::Type
+  labelImage(const Matrix& mat,
+             PiiMatrix<int>& labels,
+             UnaryOp rule,
+             Limiter limiter,
+             int* labelCount)
   {
     if (mat.isEmpty())
       {
@@ -415,6 +433,368 @@ namespace PiiImage
   }
 
 
+  /// @hide
+  struct LabelingBand
+  {
+    bool operator< (const LabelingBand& other) const { return iFirstRow < other.iFirstRow; }
+
+    int iFirstRow, iRowCount;
+    int iLabelOffset;
+    // Provisional labels of the band. Each label points to the
+    // smallest label of its component.
+    QVector<int> vecParents;
+    QVector<int> vecCounts;
+  };
+
+  inline int findLocalRoot(QVector<int>& parents, int label)
+  {
+    while (parents[label] != label)
+      label = parents[label] = parents[parents[label]];
+    return label;
+  }
+
+  // Joins the components of two labels. The larger root is always
+  // linked to the smaller one to maintain root == smallest label.
+  inline void joinLocalLabels(QVector<int>& parents, int label1, int label2)
+  {
+    label1 = findLocalRoot(parents, label1);
+    label2 = findLocalRoot(parents, label2);
+    if (label1 < label2)
+      parents[label2] = label1;
+    else if (label2 < label1)
+      parents[label1] = label2;
+  }
+
+  // A lock-free union-find used for the labels on band borders.
+  inline int findSharedRoot(PiiAtomicInt* parents, int label)
+  {
+    for (;;)
+      {
+        const int iParent = parents[label].loadAcquire();
+        if (iParent == label)
+          return label;
+        // Path halving. Concurrent updates only ever move towards
+        // the root, so a failure here is harmless.
+        const int iGrandParent = parents[iParent].loadAcquire();
+        parents[label].testAndSetOrdered(iParent, iGrandParent);
+        label = iGrandParent;
+      }
+  }
+
+  inline void joinSharedLabels(PiiAtomicInt* parents, int label1, int label2)
+  {
+    for (;;)
+      {
+        label1 = findSharedRoot(parents, label1);
+        label2 = findSharedRoot(parents, label2);
+        if (label1 == label2)
+          return;
+        if (label1 < label2)
+          qSwap(label1, label2);
+        // Only a root may be linked. If someone else linked label1
+        // in between, start over.
+        if (parents[label1].testAndSetOrdered(label1, label2))
+          return;
+      }
+  }
+
+  template <class Matrix, class UnaryOp> struct LocalLabelingFunction
+  {
+    LocalLabelingFunction(const Matrix& mat, UnaryOp rule, bool connect8,
+                          Pii::BandRows<int> labels,
+                          QMutex* mutex, QVector<LabelingBand>* bands) :
+      mat(mat), rule(rule), bConnect8(connect8),
+      labelRows(labels),
+      pMutex(mutex), pBands(bands)
+    {}
+
+    void operator() (int firstRow, int rowCount)
+    {
+      LabelingBand band;
+      band.iFirstRow = firstRow;
+      band.iRowCount = rowCount;
+      band.iLabelOffset = 0;
+      band.vecParents.reserve(64);
+      band.vecParents.append(0);
+      band.vecCounts.append(0);
+      const int iCols = mat.columns();
+      int* pUp = 0;
+      for (int r=firstRow; r<firstRow+rowCount; ++r)
+        {
+          typename Matrix::const_row_iterator sourceRow = mat.rowBegin(r);
+          int* pCurrent = labelRows.row(r);
+          for (int c=0; c<iCols; ++c)
+            {
+              if (!rule(sourceRow[c]))
+                {
+                  pCurrent[c] = 0;
+                  continue;
+                }
+              int iLabel = c > 0 ? pCurrent[c-1] : 0;
+              if (pUp != 0)
+                {
+                  int aiNeighbors[3] = { pUp[c], 0, 0 };
+                  if (bConnect8)
+                    {
+                      if (c > 0) aiNeighbors[1] = pUp[c-1];
+                      if (c < iCols-1) aiNeighbors[2] = pUp[c+1];
+                    }
+                  for (int i=0; i<3; ++i)
+                    {
+                      if (aiNeighbors[i] == 0)
+                        continue;
+                      if (iLabel == 0)
+                        iLabel = aiNeighbors[i];
+                      else if (iLabel != aiNeighbors[i])
+                        joinLocalLabels(band.vecParents, iLabel, aiNeighbors[i]);
+                    }
+                }
+              if (iLabel == 0)
+                {
+                  iLabel = band.vecParents.size();
+                  band.vecParents.append(iLabel);
+                  band.vecCounts.append(0);
+                }
+              pCurrent[c] = iLabel;
+              ++band.vecCounts[iLabel];
+            }
+          pUp = pCurrent;
+        }
+      // Parents are always smaller than children. One pass in
+      // ascending order points each label directly to its root.
+      for (int i=1; i<band.vecParents.size(); ++i)
+        band.vecParents[i] = band.vecParents[band.vecParents[i]];
+
+      QMutexLocker lock(pMutex);
+      pBands->append(band);
+    }
+
+    const Matrix& mat;
+    UnaryOp rule;
+    bool bConnect8;
+    Pii::BandRows<int> labelRows;
+    QMutex* pMutex;
+    QVector<LabelingBand>* pBands;
+  };
+
+  struct BorderMergingFunction
+  {
+    BorderMergingFunction(const QVector<LabelingBand>& bands, int columns, bool connect8,
+                          Pii::BandRows<int> labels, PiiAtomicInt* parents) :
+      bands(bands), iColumns(columns), bConnect8(connect8),
+      labelRows(labels), pParents(parents)
+    {}
+
+    // Processes the borders above bands firstBorder+1 ... firstBorder+count.
+    void operator() (int firstBorder, int count) const
+    {
+      for (int b=firstBorder+1; b<=firstBorder+count; ++b)
+        {
+          const int iRow = bands[b].iFirstRow;
+          const int* pCurrent = labelRows.row(iRow), *pUp = labelRows.row(iRow-1);
+          const int iOffset = bands[b].iLabelOffset, iUpOffset = bands[b-1].iLabelOffset;
+          for (int c=0; c<iColumns; ++c)
+            {
+              if (pCurrent[c] == 0)
+                continue;
+              const int iFirst = bConnect8 ? qMax(c-1,0) : c, iLast = bConnect8 ? qMin(c+1,iColumns-1) : c;
+              for (int c2=iFirst; c2<=iLast; ++c2)
+                if (pUp[c2] != 0)
+                  joinSharedLabels(pParents, iOffset + pCurrent[c], iUpOffset + pUp[c2]);
+            }
+        }
+    }
+
+    const QVector<LabelingBand>& bands;
+    int iColumns;
+    bool bConnect8;
+    Pii::BandRows<int> labelRows;
+    PiiAtomicInt* pParents;
+  };
+
+  struct RelabelingFunction
+  {
+    RelabelingFunction(const QVector<LabelingBand>& bands, int columns,
+                       const QVector<int>& finalLabels, Pii::BandRows<int> labels) :
+      bands(bands), iColumns(columns), finalLabels(finalLabels),
+      labelRows(labels)
+    {}
+
+    void operator() (int firstRow, int rowCount) const
+    {
+      // Find the labeling band the first row belongs to.
+      int b = 0;
+      while (b+1 < bands.size() && bands[b+1].iFirstRow <= firstRow)
+        ++b;
+      const int* pFinalLabels = finalLabels.constData();
+      for (int r=firstRow; r<firstRow+rowCount; ++r)
+        {
+          if (r >= bands[b].iFirstRow + bands[b].iRowCount)
+            ++b;
+          const int iOffset = bands[b].iLabelOffset;
+          int* pRow = labelRows.row(r);
+          for (int c=0; c<iColumns; ++c)
+            if (pRow[c] != 0)
+              pRow[c] = pFinalLabels[iOffset + pRow[c]];
+        }
+    }
+
+    const QVector<LabelingBand>& bands;
+    int iColumns;
+    const QVector<int>& finalLabels;
+    Pii::BandRows<int> labelRows;
+  };
+
+  template <class Matrix, class UnaryOp, class Limiter>
+  PiiMatrix<int> parallelLabelImage(const Pii::ParallelExecution& policy,
+                                    const Matrix& mat,
+                                    UnaryOp rule,
+                                    Limiter limiter,
+                                    Connectivity connectivity,
+                                    int* labelCount)
+  {
+    const int iRows = mat.rows(), iCols = mat.columns();
+    if (iRows == 0 || iCols == 0)
+      {
+        if (labelCount) *labelCount = 0;
+        return PiiMatrix<int>(iRows, iCols);
+      }
+    PiiMatrix<int> matLabels(PiiMatrix<int>::uninitialized(iRows, iCols));
+    const Pii::BandRows<int> labelRows(matLabels);
+    const bool bConnect8 = connectivity == Connect8;
+
+    // Pass 1: label each band independently.
+    QMutex bandMutex;
+    QVector<LabelingBand> vecBands;
+    Pii::forEachBand(policy, iRows, 1,
+                     LocalLabelingFunction<Matrix,UnaryOp>(mat, rule, bConnect8, labelRows,
+                                                           &bandMutex, &vecBands));
+    std::sort(vecBands.begin(), vecBands.end());
+
+    // Give each band a range of global provisional labels. The order
+    // of provisional labels follows the raster order of the first
+    // pixel of each component.
+    int iTotalLabels = 0;
+    for (int b=0; b<vecBands.size(); ++b)
+      {
+        vecBands[b].iLabelOffset = iTotalLabels;
+        iTotalLabels += vecBands[b].vecParents.size() - 1;
+      }
+    // Released on exceptions thrown by the band functions.
+    PiiSmartPtr<PiiAtomicInt[]> pParents(new PiiAtomicInt[iTotalLabels + 1]);
+    QVector<int> vecLabels(iTotalLabels + 1);
+    limiter.setInitialLabels(QVector<int>(1));
+    for (int b=0; b<vecBands.size(); ++b)
+      {
+        const LabelingBand& band = vecBands[b];
+        for (int i=1; i<band.vecParents.size(); ++i)
+          {
+            pParents[band.iLabelOffset + i] = band.iLabelOffset + band.vecParents[i];
+            limiter.addLabel();
+          }
+      }
+    for (int b=0; b<vecBands.size(); ++b)
+      for (int i=1; i<vecBands[b].vecCounts.size(); ++i)
+        limiter.addPixels(vecBands[b].iLabelOffset + i, vecBands[b].vecCounts[i]);
+
+    // Pass 2: join components across band borders.
+    if (vecBands.size() > 1)
+      {
+        Pii::ParallelExecution borderPolicy(policy);
+        borderPolicy.minBandRows = 1;
+        Pii::forEachBand(borderPolicy, vecBands.size()-1, 0,
+                         BorderMergingFunction(vecBands, iCols, bConnect8, labelRows, pParents));
+      }
+    for (int i=1; i<=iTotalLabels; ++i)
+      vecLabels[i] = findSharedRoot(pParents, i);
+
+    // Number the accepted components sequentially.
+    limiter.limitLabels(vecLabels);
+    int iLabelIndex = 0;
+    for (int i=1; i<=iTotalLabels; ++i)
+      {
+        if (vecLabels[i] == i)
+          vecLabels[i] = ++iLabelIndex;
+        else if (vecLabels[i] != 0)
+          vecLabels[i] = vecLabels[vecLabels[i]];
+      }
+
+    // Pass 3: replace provisional labels with final ones.
+    Pii::forEachBand(policy, iRows, 0,
+                     RelabelingFunction(vecBands, iCols, vecLabels, labelRows));
+
+    if (labelCount != 0)
+      *labelCount = iLabelIndex;
+    return matLabels;
+  }
+  /// @endhide
+
+  /**
+   * Labels an image in parallel. The image is split into bands of
+   * rows as determined by *policy*. Each band is first labeled
+   * independently. The labels of components that continue over a band
+   * border are then joined with a concurrent union-find, and the
+   * final labels are written in parallel. The result is equal to that
+   * of the corresponding sequential function: objects are numbered
+   * in the raster-scan order of their first pixel.
+   *
+   * @param policy parallel execution policy
+   *
+   * @param mat a matrix to be labeled
+   *
+   * @param rule all pixels for which `rule(pixel)` returns `true` are
+   * object pixels.
+   *
+   * @param connectivity the connectivity type
+   *
+   * @param labelCount an optional output-value parameter that stores
+   * the number of labels found
+   *
+   * ~~~(c++)
+   * PiiMatrix<uchar> img;
+   * int iLabelCount = 0;
+   * PiiMatrix<int> matLabels(PiiImage::labelImage(Pii::ParallelExecution(), img,
+   *                                               std::bind2nd(std::greater<uchar>(), 128),
+   *                                               PiiImage::Connect8, &iLabelCount));
+   * ~~~
+   */
+  template <class Matrix, class UnaryOp>
+  PiiMatrix<int> labelImage(const Pii::ParallelExecution& policy,
+                            const Matrix& mat,
+                            UnaryOp rule,
+                            Connectivity connectivity = Connect4,
+                            int* labelCount = 0)
+  {
+    return parallelLabelImage(policy, mat, rule, DefaultLabelingLimiter(), connectivity, labelCount);
+  }
+
+  /**
+   * Labels all 4-connected non-zero pixels of *mat* in parallel.
+   */
+  template <class Matrix>
+  PiiMatrix<int> labelImage(const Pii::ParallelExecution& policy,
+                            const Matrix& mat,
+                            int* labelCount = 0)
+  {
+    typedef typename Matrix::value_type T;
+    return parallelLabelImage(policy, mat, std::bind2nd(std::not_equal_to<T>(), T(0)),
+                              DefaultLabelingLimiter(), Connect4, labelCount);
+  }
+
+  /**
+   * Parallel version of [labelLargerThan()].
+   */
+  template <class Matrix>
+  PiiMatrix<int> labelLargerThan(const Pii::ParallelExecution& policy,
+                                 const Matrix& mat,
+                                 int sizeLimit, int* labelCount = 0)
+  {
+    typedef typename Matrix::value_type T;
+    return parallelLabelImage(policy, mat, std::bind2nd(std::not_equal_to<T>(), T(0)),
+                              ObjectSizeLimiter(sizeLimit ? sizeLimit+1 : -1),
+                              Connect4, labelCount);
+  }
+
   /// @hide
 
   // A linked list node for runs of consequtive object pixels on one
@@ -489,9 +869,9 @@ namespace PiiImage
   // Keeps track of the current state of the labeling algorithm in
   // recursive calls.
   template <class T>
-  struct LabelInfo
+  struct LabelingState
   {
-    LabelInfo(QVector<RunList>& runs, PiiMatrix<T>& labels, int& index, int connectivityShift) :
+    LabelingState(QVector<RunList>& runs, PiiMatrix<T>& labels, int& index, int connectivityShift) :
       lstRuns(runs), matLabels(labels), iLabelIndex(index), iConnectivityShift(connectivityShift)
     {}
 
@@ -509,7 +889,7 @@ namespace PiiImage
   // Marks a sequence of detected object pixels into the label buffer.
   // Returns the length of the run.
   template <class T>
-  int markToBuffer(LabelInfo<T>& info, int rowIndex, int start, int end)
+  int markToBuffer(LabelingState<T>& info, int rowIndex, int start, int end)
   {
     // Mark the run into the label buffer
     T* pRunRow = info.matLabels[rowIndex];
@@ -522,7 +902,7 @@ namespace PiiImage
 
   // Clears the current label out of existence.
   template <class T>
-  void overwriteLabel(LabelInfo<T>& info, const BoundingBox& box, T label)
+  void overwriteLabel(LabelingState<T>& info, const BoundingBox& box, T label)
   {
     for (int r = box.minRow; r <= box.maxRow; ++r)
       {
@@ -544,7 +924,7 @@ namespace PiiImage
   // On row rowIndex, find all runs that overlap with the range
   // start-end.
   template <class T>
-  int connectRuns(LabelInfo<T>& info, int rowIndex, int start, int end, BoundingBox& box)
+  int connectRuns(LabelingState<T>& info, int rowIndex, int start, int end, BoundingBox& box)
   {
     QStack<RecursiveCall> localStack;
     RecursiveCall currentCall = { rowIndex, start, end };
@@ -706,7 +1086,7 @@ namespace PiiImage
     int iFixedLabel = bTempLabel ? 2 : 1;
     int iLabelIndex = 0;
 
-    LabelInfo<T> info(lstRuns, labels, iLabelIndex, iConnectivityShift);
+    LabelingState<T> info(lstRuns, labels, iLabelIndex, iConnectivityShift);
 
     const int iRows = mat.rows(), iCols = mat.columns();
 
@@ -791,6 +1171,427 @@ namespace PiiImage
     if (labelCount != 0)
       *labelCount = thresholdOnly ? 1 : iLabelIndex;
   }
+  /**
+   * A horizontal run of object pixels in [LabelInfo].
+   */
+  struct LabelRun
+  {
+    /**
+     * The row the run is on, counted from the first row of the stream.
+     */
+    qint64 row;
+    /**
+     * The first column of the run.
+     */
+    int start;
+    /**
+     * One past the last column of the run.
+     */
+    int end;
+  };
+
+  /**
+   * Describes a connected component found by [StreamLabeler].
+   */
+  struct LabelInfo
+  {
+    LabelInfo() :
+      label(0), pixelCount(0),
+      firstRow(0), lastRow(-1), firstColumn(INT_MAX), lastColumn(-1)
+    {}
+
+    /**
+     * The label of the object. Objects are numbered sequentially,
+     * starting at one, in the order they are completed.
+     */
+    int label;
+    /**
+     * The number of pixels in the object.
+     */
+    qint64 pixelCount;
+    /**
+     * The first and the last row of the bounding box (inclusive),
+     * counted from the first row of the stream.
+     */
+    qint64 firstRow, lastRow;
+    /**
+     * The first and the last column of the bounding box (inclusive).
+     */
+    int firstColumn, lastColumn;
+    /**
+     * The pixels of the object as horizontal runs, in no particular
+     * order.
+     */
+    QVector<LabelRun> runs;
+  };
+
+  /**
+   * Labels connected components in an endless stream of image rows,
+   * such as that produced by a line-scan camera. The image is passed
+   * to [addBand()] in bands of consecutive rows. Instead of a label
+   * image, the labeler returns each object as a [LabelInfo] as soon
+   * as it is complete, i.e. when no object pixels on the last
+   * received row touch it.
+   *
+   * Only the runs of object pixels on the last received row and the
+   * objects that have not been completed are kept in memory. Memory
+   * consumption and latency therefore depend on the size of objects,
+   * not on the length of the stream. The runs of an object that grows
+   * larger than the maximum size are released immediately.
+   *
+   * The labeling rules are the same as in the hysteresis version of
+   * [labelImage()]: `rule1` selects object pixel candidates, and a
+   * component is accepted only if `rule2` matches at least one of its
+   * pixels.
+   *
+   * ~~~(c++)
+   * typedef std::binder2nd<std::greater<uchar> > Rule;
+   * PiiImage::StreamLabeler<Rule> labeler(std::bind2nd(std::greater<uchar>(), 128),
+   *                                       PiiImage::Connect8, 10);
+   * while (camera.hasFrames())
+   *   {
+   *     QList<PiiImage::LabelInfo> lstObjects(labeler.addBand(camera.nextFrame()));
+   *     for (int i=0; i<lstObjects.size(); ++i)
+   *       handleDefect(lstObjects[i]);
+   *   }
+   * handleDefects(labeler.finish());
+   * ~~~
+   */
+  template <class UnaryOp1, class UnaryOp2 = Pii::YesFunction<typename UnaryOp1::argument_type> >
+  class StreamLabeler
+  {
+  public:
+    /**
+     * Creates a labeler that treats all pixels matching *rule1* as
+     * object pixels.
+     *
+     * @param minSize the minimum number of pixels in an accepted
+     * object.
+     *
+     * @param maxSize the maximum number of pixels in an accepted
+     * object.
+     */
+    StreamLabeler(UnaryOp1 rule1,
+                  Connectivity connectivity = Connect4,
+                  int minSize = 0,
+                  int maxSize = INT_MAX) :
+      _rule1(rule1),
+      _iConnectivityShift(connectivity == Connect8 ? 1 : 0),
+      _iMinSize(minSize), _iMaxSize(maxSize),
+      _iColumns(-1), _iRow(0), _iLabelCount(0)
+    {}
+
+    /**
+     * Creates a hysteresis labeler. See [labelImage()] for the meaning
+     * of *rule1* and *rule2*.
+     */
+    StreamLabeler(UnaryOp1 rule1, UnaryOp2 rule2,
+                  Connectivity connectivity = Connect4,
+                  int minSize = 0,
+                  int maxSize = INT_MAX) :
+      _rule1(rule1), _rule2(rule2),
+      _iConnectivityShift(connectivity == Connect8 ? 1 : 0),
+      _iMinSize(minSize), _iMaxSize(maxSize),
+      _iColumns(-1), _iRow(0), _iLabelCount(0)
+    {}
+
+    /**
+     * Labels the next band of rows and returns the objects completed
+     * by it. All bands must have the same number of columns as the
+     * first one. A band of a different width is ignored with a
+     * warning.
+     */
+    template <class Matrix> QList<LabelInfo> addBand(const Matrix& band);
+
+    /**
+     * Informs the labeler that the stream has ended and returns all
+     * objects still open. The next band will not be connected to
+     * the previous ones, but row numbering and labels continue.
+     */
+    QList<LabelInfo> finish();
+
+    /**
+     * Discards all state and starts over from row zero and label one.
+     */
+    void reset();
+
+    /**
+     * Returns the number of rows received so far.
+     */
+    qint64 rowCount() const { return _iRow; }
+
+    /**
+     * Returns the number of objects that have been seen but not
+     * completed yet.
+     */
+    int openObjectCount() const { return _vecObjects.size() - _vecFreeSlots.size() - _vecMergedSlots.size(); }
+
+  private:
+    struct Run
+    {
+      int start, end; // end is inclusive
+      bool seed;
+      int object;
+    };
+
+    struct Object
+    {
+      int parent;
+      qint64 lastSeenRow;
+      bool seed, oversized;
+      LabelInfo info;
+    };
+
+    template <class RowIterator> void addRow(RowIterator row);
+    int findRoot(int object);
+    int createObject();
+    int mergeObjects(int object1, int object2);
+    void addRun(int object, const Run& run);
+    void completeObject(int object, QList<LabelInfo>& objects);
+    void releaseObject(int object);
+
+    UnaryOp1 _rule1;
+    UnaryOp2 _rule2;
+    int _iConnectivityShift;
+    int _iMinSize, _iMaxSize;
+    int _iColumns;
+    qint64 _iRow;
+    int _iLabelCount;
+    QVector<Run> _vecPreviousRuns, _vecCurrentRuns;
+    QVector<Object> _vecObjects;
+    QVector<int> _vecFreeSlots, _vecMergedSlots;
+  };
+
+  /// @hide
+  template <class UnaryOp1, class UnaryOp2>
+  template <class Matrix>
+  QList<LabelInfo> StreamLabeler<UnaryOp1,UnaryOp2>::addBand(const Matrix& band)
+  {
+    QList<LabelInfo> lstCompleted;
+    if (band.rows() == 0)
+      return lstCompleted;
+    if (_iColumns == -1)
+      _iColumns = band.columns();
+    else if (band.columns() != _iColumns)
+      {
+        piiWarning("StreamLabeler::addBand(): Band width (%d) differs from that of the first band (%d).",
+                   band.columns(), _iColumns);
+        return lstCompleted;
+      }
+
+    for (int r=0; r<band.rows(); ++r, ++_iRow)
+      {
+        addRow(band.rowBegin(r));
+
+        // Point all runs on this row to the roots of their objects.
+        for (int i=0; i<_vecCurrentRuns.size(); ++i)
+          {
+            _vecCurrentRuns[i].object = findRoot(_vecCurrentRuns[i].object);
+            _vecObjects[_vecCurrentRuns[i].object].lastSeenRow = _iRow;
+          }
+        // An object on the previous row that did not continue to this
+        // one cannot grow any more.
+        for (int i=0; i<_vecPreviousRuns.size(); ++i)
+          {
+            // Already completed through another run.
+            if (_vecObjects[_vecPreviousRuns[i].object].parent == -1)
+              continue;
+            const int iRoot = findRoot(_vecPreviousRuns[i].object);
+            if (_vecObjects[iRoot].lastSeenRow != _iRow)
+              completeObject(iRoot, lstCompleted);
+          }
+        // Nothing refers to merged objects any more.
+        for (int i=0; i<_vecMergedSlots.size(); ++i)
+          releaseObject(_vecMergedSlots[i]);
+        _vecMergedSlots.clear();
+        _vecPreviousRuns.swap(_vecCurrentRuns);
+      }
+    return lstCompleted;
+  }
+
+  template <class UnaryOp1, class UnaryOp2>
+  template <class RowIterator>
+  void StreamLabeler<UnaryOp1,UnaryOp2>::addRow(RowIterator row)
+  {
+    _vecCurrentRuns.clear();
+    const int iPreviousCount = _vecPreviousRuns.size();
+    int iFirstCandidate = 0;
+    for (int c=0; c<_iColumns; ++c)
+      {
+        if (!_rule1(row[c]))
+          continue;
+        Run run = { c, c, _rule2(row[c]), -1 };
+        for (++c; c<_iColumns && _rule1(row[c]); ++c)
+          if (!run.seed && _rule2(row[c]))
+            run.seed = true;
+        run.end = c-1;
+
+        // Connect to all overlapping runs on the previous row. Both
+        // lists are sorted by column.
+        while (iFirstCandidate < iPreviousCount &&
+               _vecPreviousRuns[iFirstCandidate].end + _iConnectivityShift < run.start)
+          ++iFirstCandidate;
+        for (int i=iFirstCandidate;
+             i<iPreviousCount && _vecPreviousRuns[i].start <= run.end + _iConnectivityShift;
+             ++i)
+          {
+            const int iRoot = findRoot(_vecPreviousRuns[i].object);
+            if (run.object == -1)
+              run.object = iRoot;
+            else if (run.object != iRoot)
+              run.object = mergeObjects(run.object, iRoot);
+          }
+        if (run.object == -1)
+          run.object = createObject();
+        addRun(run.object, run);
+        _vecCurrentRuns.append(run);
+      }
+  }
+
+  template <class UnaryOp1, class UnaryOp2>
+  int StreamLabeler<UnaryOp1,UnaryOp2>::findRoot(int object)
+  {
+    int iRoot = object;
+    while (_vecObjects[iRoot].parent != iRoot)
+      iRoot = _vecObjects[iRoot].parent;
+    // Path compression
+    while (object != iRoot)
+      {
+        const int iNext = _vecObjects[object].parent;
+        _vecObjects[object].parent = iRoot;
+        object = iNext;
+      }
+    return iRoot;
+  }
+
+  template <class UnaryOp1, class UnaryOp2>
+  int StreamLabeler<UnaryOp1,UnaryOp2>::createObject()
+  {
+    int iObject;
+    if (!_vecFreeSlots.isEmpty())
+      {
+        iObject = _vecFreeSlots.last();
+        _vecFreeSlots.pop_back();
+      }
+    else
+      {
+        iObject = _vecObjects.size();
+        _vecObjects.append(Object());
+      }
+    Object& object = _vecObjects[iObject];
+    object.parent = iObject;
+    object.lastSeenRow = _iRow;
+    object.seed = object.oversized = false;
+    object.info = LabelInfo();
+    return iObject;
+  }
+
+  template <class UnaryOp1, class UnaryOp2>
+  int StreamLabeler<UnaryOp1,UnaryOp2>::mergeObjects(int object1, int object2)
+  {
+    // Append the shorter list of runs to the longer one.
+    if (_vecObjects[object1].info.runs.size() < _vecObjects[object2].info.runs.size())
+      qSwap(object1, object2);
+    Object& target = _vecObjects[object1];
+    Object& source = _vecObjects[object2];
+    target.seed = target.seed || source.seed;
+    target.oversized = target.oversized || source.oversized;
+    target.info.pixelCount += source.info.pixelCount;
+    target.info.firstRow = qMin(target.info.firstRow, source.info.firstRow);
+    target.info.lastRow = qMax(target.info.lastRow, source.info.lastRow);
+    target.info.firstColumn = qMin(target.info.firstColumn, source.info.firstColumn);
+    target.info.lastColumn = qMax(target.info.lastColumn, source.info.lastColumn);
+    if (target.oversized || target.info.pixelCount > _iMaxSize)
+      {
+        target.oversized = true;
+        target.info.runs = QVector<LabelRun>();
+      }
+    else
+      {
+        target.info.runs.reserve(target.info.runs.size() + source.info.runs.size());
+        for (int i=0; i<source.info.runs.size(); ++i)
+          target.info.runs.append(source.info.runs[i]);
+      }
+    source.info.runs = QVector<LabelRun>();
+    source.parent = object1;
+    _vecMergedSlots.append(object2);
+    return object1;
+  }
+
+  template <class UnaryOp1, class UnaryOp2>
+  void StreamLabeler<UnaryOp1,UnaryOp2>::addRun(int object, const Run& run)
+  {
+    Object& target = _vecObjects[object];
+    LabelInfo& info = target.info;
+    if (info.pixelCount == 0)
+      info.firstRow = _iRow;
+    info.lastRow = _iRow;
+    info.firstColumn = qMin(info.firstColumn, run.start);
+    info.lastColumn = qMax(info.lastColumn, run.end);
+    info.pixelCount += run.end - run.start + 1;
+    target.seed = target.seed || run.seed;
+    if (target.oversized)
+      return;
+    if (info.pixelCount > _iMaxSize)
+      {
+        // The object will be rejected anyway.
+        target.oversized = true;
+        info.runs = QVector<LabelRun>();
+        return;
+      }
+    LabelRun labelRun = { _iRow, run.start, run.end + 1 };
+    info.runs.append(labelRun);
+  }
+
+  template <class UnaryOp1, class UnaryOp2>
+  void StreamLabeler<UnaryOp1,UnaryOp2>::completeObject(int object, QList<LabelInfo>& objects)
+  {
+    Object& completed = _vecObjects[object];
+    if (completed.seed && !completed.oversized && completed.info.pixelCount >= _iMinSize)
+      {
+        completed.info.label = ++_iLabelCount;
+        objects.append(completed.info);
+      }
+    releaseObject(object);
+  }
+
+  template <class UnaryOp1, class UnaryOp2>
+  void StreamLabeler<UnaryOp1,UnaryOp2>::releaseObject(int object)
+  {
+    // parent == -1 marks a free slot.
+    _vecObjects[object].parent = -1;
+    _vecObjects[object].info = LabelInfo();
+    _vecFreeSlots.append(object);
+  }
+
+  template <class UnaryOp1, class UnaryOp2>
+  QList<LabelInfo> StreamLabeler<UnaryOp1,UnaryOp2>::finish()
+  {
+    QList<LabelInfo> lstCompleted;
+    for (int i=0; i<_vecPreviousRuns.size(); ++i)
+      {
+        // Roots were resolved at the end of the last row.
+        const int iObject = _vecPreviousRuns[i].object;
+        if (_vecObjects[iObject].parent != -1)
+          completeObject(iObject, lstCompleted);
+      }
+    _vecPreviousRuns.clear();
+    return lstCompleted;
+  }
+
+  template <class UnaryOp1, class UnaryOp2>
+  void StreamLabeler<UnaryOp1,UnaryOp2>::reset()
+  {
+    _vecPreviousRuns.clear();
+    _vecCurrentRuns.clear();
+    _vecObjects.clear();
+    _vecFreeSlots.clear();
+    _vecMergedSlots.clear();
+    _iColumns = -1;
+    _iRow = 0;
+    _iLabelCount = 0;
+  }
+  /// @endhide
 }
 
 #endif //_PIILABELING_H
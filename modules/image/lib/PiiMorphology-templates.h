@@ -84,6 +84,60 @@ namespace PiiImage
     return closed;
   }
 
+  template <class U> bool isDecomposableMask(const PiiMatrix<U>& mask)
+  {
+    if (mask.isEmpty() || mask(0,0) == 0)
+      return false;
+    const U value = mask(0,0);
+    for (int r=0; r<mask.rows(); ++r)
+      {
+        const U* pRow = mask[r];
+        for (int c=0; c<mask.columns(); ++c)
+          if (pRow[c] != value)
+            return false;
+      }
+    return true;
+  }
+
+  template <class T, class U>
+  PiiMatrix<T> decomposedErode(const PiiMatrix<T>& image, const PiiMatrix<U>& mask)
+  {
+    // A pixel is retained if all bits of the mask are set in every
+    // pixel under it.
+    const int iMask = int(mask(0,0));
+    PiiMatrix<T> matBits(PiiMatrix<T>::uninitialized(image.rows(), image.columns()));
+    for (int r=0; r<image.rows(); ++r)
+      {
+        const T* pSource = image[r];
+        T* pTarget = matBits[r];
+        for (int c=0; c<image.columns(); ++c)
+          pTarget[c] = (iMask & ~int(pSource[c])) ? T(0) : T(1);
+      }
+    // Zeros outside of the image clear all pixels the mask does not
+    // fit in.
+    return separableExtremum(matBits, mask.rows(), mask.columns(),
+                             mask.rows()/2, mask.columns()/2,
+                             std::less<T>(), T(0));
+  }
+
+  template <class T, class U>
+  PiiMatrix<T> decomposedDilate(const PiiMatrix<T>& image, const PiiMatrix<U>& mask)
+  {
+    const T value = T(int(mask(0,0)));
+    PiiMatrix<T> matBits(PiiMatrix<T>::uninitialized(image.rows(), image.columns()));
+    for (int r=0; r<image.rows(); ++r)
+      {
+        const T* pSource = image[r];
+        T* pTarget = matBits[r];
+        for (int c=0; c<image.columns(); ++c)
+          pTarget[c] = pSource[c] ? value : T(0);
+      }
+    // Dilation reflects the mask around its origin.
+    return separableExtremum(matBits, mask.rows(), mask.columns(),
+                             mask.rows() - mask.rows()/2 - 1, mask.columns() - mask.columns()/2 - 1,
+                             std::greater<T>(), T(0));
+  }
+
   template <class Matrix, class U>
   PiiMatrix<typename Matrix::value_type> erode(const Matrix& image, const PiiMatrix<U>& mask, bool handleBorders)
   {
@@ -109,6 +163,14 @@ namespace PiiImage
         return img;
       }
 
+    if (isDecomposableMask(mask))
+      {
+        PiiMatrix<T> result(decomposedErode(img, mask));
+        if (handleBorders)
+          return result(rOrig, cOrig, image.rows(), image.columns());
+        return result;
+      }
+
     PiiMatrix<T> result(rows,cols);
     int rDiff = rows-maskRows;
     int cDiff = cols-maskCols;
@@ -137,6 +199,43 @@ namespace PiiImage
     return result;
   }
 
+  template <class T, class U> struct ErodeBandFunction
+  {
+    ErodeBandFunction(const PiiMatrix<U>& mask, bool handleBorders) :
+      mask(mask), bHandleBorders(handleBorders)
+    {}
+
+    PiiMatrix<T> operator() (const PiiMatrix<T>& image) const { return erode(image, mask, bHandleBorders); }
+
+    const PiiMatrix<U>& mask;
+    bool bHandleBorders;
+  };
+
+  template <class T, class U>
+  PiiMatrix<T> erode(const Pii::ParallelExecution& policy,
+                     const PiiMatrix<T>& image, const PiiMatrix<U>& mask,
+                     bool handleBorders)
+  {
+    return Pii::transformBands<T>(policy, image, mask.rows(),
+                                  ErodeBandFunction<T,U>(mask, handleBorders));
+  }
+
+  template <class T, class U> struct DilateBandFunction
+  {
+    DilateBandFunction(const PiiMatrix<U>& mask) : mask(mask) {}
+
+    PiiMatrix<T> operator() (const PiiMatrix<T>& image) const { return dilate(image, mask); }
+
+    const PiiMatrix<U>& mask;
+  };
+
+  template <class T, class U>
+  PiiMatrix<T> dilate(const Pii::ParallelExecution& policy,
+                      const PiiMatrix<T>& image, const PiiMatrix<U>& mask)
+  {
+    return Pii::transformBands<T>(policy, image, mask.rows(), DilateBandFunction<T,U>(mask));
+  }
+
   template <class Matrix, class U>
   PiiMatrix<typename Matrix::value_type> dilate(const Matrix& image, const PiiMatrix<U>& mask)
   {
@@ -147,6 +246,8 @@ namespace PiiImage
 
     if (maskRows > rows || maskCols > cols)
       piiWarning("BinaryMorphology::dilate(image, mask): Mask cannot be larger than image.");
+    else if (isDecomposableMask(mask))
+      return decomposedDilate(PiiMatrix<T>(image), mask);
 
     PiiMatrix<T> result(rows,cols);
     typename Matrix::row_iterator ptr;
@@ -17,12 +17,25 @@
 #define _PIIMORPHOLOGY_H
 
 #include <PiiMatrix.h>
+#include <PiiParallel.h>
+#include "PiiExtremumFilter.h"
 #include <iostream>
 #include "PiiImageGlobal.h"
 #include <PiiTemplateExport.h>
 
 namespace PiiImage
 {
+  /**
+   * Returns `true` if *mask* is a rectangular structuring element
+   * that can be decomposed into a horizontal and a vertical line. This
+   * is the case if all entries in *mask* are equal and non-zero.
+   * Rectangular masks and those of the other [MaskType]s that have
+   * only one row or column are decomposable. [erode()] and
+   * [dilate()] process images with such masks in constant time per
+   * pixel, independent of the size of the mask.
+   */
+  template <class U> bool isDecomposableMask(const PiiMatrix<U>& mask);
+
   /**
    * Create a morphological mask. A template implementation that can
    * be used to create binary masks with any content type.
@@ -108,6 +121,10 @@ namespace PiiImage
    * borders are handled with a padding technique. If this flag is
    * `false` (the default), zeros are assumed outside of the image.
    *
+   * If `isDecomposableMask(mask)` is `true`, the erosion is
+   * calculated as a separable minimum filter whose cost per pixel is
+   * independent of the size of the mask.
+   *
    * @return the binary image which is result of erosion
    *
    * ~~~(c++)
@@ -180,6 +197,10 @@ namespace PiiImage
    *
    * @param mask is structuring element.
    *
+   * If `isDecomposableMask(mask)` is `true`, the dilation is
+   * calculated as a separable maximum filter whose cost per pixel is
+   * independent of the size of the mask.
+   *
    * @return the binary image which is result of dilation.
    *
    * ~~~(c++)
@@ -215,6 +236,28 @@ namespace PiiImage
    */
   template <class Matrix, class U>
   PiiMatrix<typename Matrix::value_type> dilate(const Matrix& image, const PiiMatrix<U>& mask);
+
+  /**
+   * Performs a morphological erosion in parallel. The image is split
+   * into bands of rows as determined by *policy*. The result is equal
+   * to that of the sequential version.
+   *
+   * ~~~(c++)
+   * PiiMatrix<int> result = PiiImage::erode(Pii::ParallelExecution(), source, mask);
+   * ~~~
+   */
+  template <class T, class U>
+  PiiMatrix<T> erode(const Pii::ParallelExecution& policy,
+                     const PiiMatrix<T>& image, const PiiMatrix<U>& mask,
+                     bool handleBorders = false);
+  /**
+   * Performs a morphological dilation in parallel.
+   *
+   * @see erode(const Pii::ParallelExecution&, const PiiMatrix<T>&, const PiiMatrix<U>&, bool)
+   */
+  template <class T, class U>
+  PiiMatrix<T> dilate(const Pii::ParallelExecution& policy,
+                      const PiiMatrix<T>& image, const PiiMatrix<U>& mask);
   /**
    * Morphological opening.
    */
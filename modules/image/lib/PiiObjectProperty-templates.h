@@ -18,9 +18,147 @@
 #endif
 
 #include <PiiPrincipalComponents.h>
+#include <algorithm>
 
 namespace PiiImage
 {
+  /// @hide
+  struct ObjectRun
+  {
+    int row, start, end; // end is exclusive
+    int label;
+  };
+
+  inline int findObjectRoot(QVector<int>& parents, int label)
+  {
+    int iRoot = label;
+    while (parents[iRoot] != iRoot)
+      iRoot = parents[iRoot];
+    // Path compression
+    while (label != iRoot)
+      {
+        const int iNext = parents[label];
+        parents[label] = iRoot;
+        label = iNext;
+      }
+    return iRoot;
+  }
+  /// @endhide
+
+  template <class Matrix, class UnaryOp>
+  QVector<ObjectMoments> measureObjects(const Matrix& mat,
+                                        UnaryOp rule,
+                                        Connectivity connectivity,
+                                        PiiMatrix<int>* labels)
+  {
+    const int iRows = mat.rows(), iCols = mat.columns();
+    const int iShift = connectivity == Connect8 ? 1 : 0;
+    QVector<ObjectRun> vecRuns;
+    // Provisional labels and their moments. A label always points to
+    // a smaller one, which keeps roots in raster order.
+    QVector<int> vecParents;
+    QVector<ObjectMoments> vecMoments;
+    int iPreviousStart = 0, iPreviousEnd = 0;
+
+    for (int r=0; r<iRows; ++r)
+      {
+        typename Matrix::const_row_iterator row = mat.rowBegin(r);
+        const int iCurrentStart = vecRuns.size();
+        int iCandidate = iPreviousStart;
+        for (int c=0; c<iCols; ++c)
+          {
+            if (!rule(row[c]))
+              continue;
+            const int iStart = c;
+            for (++c; c<iCols && rule(row[c]); ++c) ;
+
+            // Join all overlapping runs on the previous row. Both rows
+            // are sorted by column.
+            while (iCandidate < iPreviousEnd && vecRuns[iCandidate].end + iShift <= iStart)
+              ++iCandidate;
+            int iLabel = -1;
+            for (int i=iCandidate; i<iPreviousEnd && vecRuns[i].start < c + iShift; ++i)
+              {
+                int iRoot = findObjectRoot(vecParents, vecRuns[i].label);
+                if (iLabel == -1)
+                  iLabel = iRoot;
+                else if (iRoot != iLabel)
+                  {
+                    if (iRoot < iLabel)
+                      qSwap(iRoot, iLabel);
+                    vecParents[iRoot] = iLabel;
+                  }
+              }
+            if (iLabel == -1)
+              {
+                iLabel = vecParents.size();
+                vecParents.append(iLabel);
+                vecMoments.append(ObjectMoments());
+              }
+            vecMoments[iLabel].addRun(r, iStart, c);
+            ObjectRun run = { r, iStart, c, iLabel };
+            vecRuns.append(run);
+          }
+        iPreviousStart = iCurrentStart;
+        iPreviousEnd = vecRuns.size();
+      }
+
+    // Roots are numbered in the order they were created. Since a root
+    // is always smaller than its children, the final label of a root
+    // is known when its children are reached.
+    const int iProvisionalCount = vecParents.size();
+    QVector<int> vecFinalLabels(iProvisionalCount);
+    int iLabelCount = 0;
+    for (int i=0; i<iProvisionalCount; ++i)
+      {
+        const int iRoot = findObjectRoot(vecParents, i);
+        vecFinalLabels[i] = iRoot == i ? iLabelCount++ : vecFinalLabels[iRoot];
+      }
+
+    QVector<ObjectMoments> vecResult(iLabelCount);
+    for (int i=0; i<iProvisionalCount; ++i)
+      vecResult[vecFinalLabels[i]].add(vecMoments[i]);
+
+    if (labels != 0)
+      {
+        *labels = PiiMatrix<int>(iRows, iCols);
+        for (int i=0; i<vecRuns.size(); ++i)
+          {
+            const ObjectRun& run = vecRuns[i];
+            int* pRow = labels->row(run.row);
+            std::fill(pRow + run.start, pRow + run.end, vecFinalLabels[run.label] + 1);
+          }
+      }
+    return vecResult;
+  }
+
+  template <class T> QVector<ObjectMoments> calculateMoments(const PiiMatrix<T>& mat, int labels)
+  {
+    const int iRows = mat.rows(), iCols = mat.columns();
+    if (labels == 0 && !mat.isEmpty())
+      labels = qMax(0, int(Pii::max(mat)));
+
+    QVector<ObjectMoments> vecMoments(labels);
+    for (int r=0; r<iRows; ++r)
+      {
+        const T* pRow = mat[r];
+        for (int c=0; c<iCols; ++c)
+          {
+            if (pRow[c] <= 0)
+              continue;
+            const T label = pRow[c];
+            const int iStart = c;
+            while (c+1 < iCols && pRow[c+1] == label)
+              ++c;
+            const int iLabel = int(label);
+            if (iLabel > vecMoments.size())
+              vecMoments.resize(iLabel);
+            vecMoments[iLabel-1].addRun(r, iStart, c+1);
+          }
+      }
+    return vecMoments;
+  }
+
   template <class T> void calculateProperties(const PiiMatrix<T>& mat, int labels, PiiMatrix<int>& areas,
                                               PiiMatrix<int>& centroids, PiiMatrix<int>& bbox)
   {
@@ -0,0 +1,85 @@
+/* This file is part of Into.
+ * Copyright (C) Intopii 2013.
+ * All rights reserved.
+ *
+ * Licensees holding a commercial Into license may use this file in
+ * accordance with the commercial license agreement. Please see
+ * LICENSE.commercial for commercial licensing terms.
+ *
+ * Alternatively, this file may be used under the terms of the GNU
+ * Affero General Public License version 3 as published by the Free
+ * Software Foundation. In addition, Intopii gives you special rights
+ * to use Into as a part of open source software projects. Please
+ * refer to LICENSE.AGPL3 for details.
+ */
+
+#include "PiiObjectProperty.h"
+#include <cmath>
+
+namespace PiiImage
+{
+  PiiMatrix<double> ObjectMoments::direction(double* length, double* width) const
+  {
+    if (area < 2)
+      {
+        if (length != 0) *length = 0;
+        if (width != 0) *width = 0;
+        return PiiMatrix<double>::identity(2);
+      }
+
+    // Central second moments (the scatter matrix).
+    const double dXX = sumXX - sumX * sumX / area,
+      dYY = sumYY - sumY * sumY / area,
+      dXY = sumXY - sumX * sumY / area;
+
+    // Eigenvalues of a symmetric 2-by-2 matrix
+    const double dHalfTrace = (dXX + dYY) / 2,
+      dRoot = std::sqrt((dXX - dYY) * (dXX - dYY) / 4 + dXY * dXY),
+      dLargest = dHalfTrace + dRoot,
+      dSmallest = dHalfTrace - dRoot;
+
+    double dX, dY;
+    if (dXY != 0)
+      {
+        dX = dLargest - dYY;
+        dY = dXY;
+        const double dNorm = std::sqrt(dX * dX + dY * dY);
+        dX /= dNorm;
+        dY /= dNorm;
+      }
+    else if (dXX >= dYY)
+      dX = 1, dY = 0;
+    else
+      dX = 0, dY = 1;
+
+    if (length != 0) *length = std::sqrt(qMax(dLargest, 0.0)) + 1;
+    if (width != 0) *width = std::sqrt(qMax(dSmallest, 0.0)) + 1;
+
+    return PiiMatrix<double>(2,2,
+                             dX, dY,
+                             -dY, dX);
+  }
+
+  void calculateProperties(const QVector<ObjectMoments>& moments, PiiMatrix<int>& areas,
+                           PiiMatrix<int>& centroids, PiiMatrix<int>& bbox)
+  {
+    const int iCount = moments.size();
+    areas = PiiMatrix<int>(iCount, 1);
+    centroids = PiiMatrix<int>(iCount, 2);
+    bbox = PiiMatrix<int>(iCount, 4);
+    for (int i=0; i<iCount; ++i)
+      {
+        const ObjectMoments& object = moments[i];
+        if (object.area == 0)
+          continue;
+        areas(i,0) = object.area;
+        centroids(i,0) = int(object.centroidX() + 0.5);
+        centroids(i,1) = int(object.centroidY() + 0.5);
+        int* pBox = bbox[i];
+        pBox[0] = object.left;
+        pBox[1] = object.top;
+        pBox[2] = object.right - object.left + 1;
+        pBox[3] = object.bottom - object.top + 1;
+      }
+  }
+}
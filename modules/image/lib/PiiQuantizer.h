@@ -71,6 +71,22 @@ public:
    */
   PiiMatrix<T> limits() const { return _matLimits; }
 
+  /**
+   * Create a look-up table that contains the quantization levels of
+   * all integers in [*minimum*, *maximum*]. The quantization level of
+   * `value` is stored at `table(value - minimum)`. Building the table
+   * takes time linear to the size of the range, after which
+   * quantizing an integer takes one memory access instead of a binary
+   * search.
+   *
+   * ~~~(c++)
+   * PiiQuantizer<double> q(PiiMatrix<double>(1,2, 10.0, 100.0));
+   * PiiMatrix<int> lut(q.lookupTable(0, 255));
+   * // lut(50) == q.quantize(50) == 1
+   * ~~~
+   */
+  PiiMatrix<int> lookupTable(int minimum, int maximum) const;
+
   /**
    * Create limits based on a set of "training" data. Quantization
    * boundaries are derived from the training data so that each
@@ -114,6 +130,24 @@ PiiMatrix<T> PiiQuantizer<T>::divideEqually(typename PiiMatrix<T>::iterator begi
   return result;
 }
 
+template <class T> PiiMatrix<int> PiiQuantizer<T>::lookupTable(int minimum, int maximum) const
+{
+  PiiMatrix<int> matTable(PiiMatrix<int>::uninitialized(1, maximum - minimum + 1));
+  int* pTable = matTable[0];
+  // Walk the limits and the range in parallel. The level of a value
+  // is the number of limits that are not greater than it.
+  const int iLimits = _matLimits.columns();
+  const T* pLimits = iLimits > 0 ? _matLimits[0] : 0;
+  int iLevel = 0;
+  for (int i=minimum; i<=maximum; ++i)
+    {
+      while (iLevel < iLimits && !(pLimits[iLevel] > T(i)))
+        ++iLevel;
+      pTable[i - minimum] = iLevel;
+    }
+  return matTable;
+}
+
 template <class T> int PiiQuantizer<T>::quantize(T value) const
 {
   int start = 0, end = _matLimits.columns();
@@ -0,0 +1,80 @@
+/* This file is part of Into.
+ * Copyright (C) Intopii 2013.
+ * All rights reserved.
+ *
+ * Licensees holding a commercial Into license may use this file in
+ * accordance with the commercial license agreement. Please see
+ * LICENSE.commercial for commercial licensing terms.
+ *
+ * Alternatively, this file may be used under the terms of the GNU
+ * Affero General Public License version 3 as published by the Free
+ * Software Foundation. In addition, Intopii gives you special rights
+ * to use Into as a part of open source software projects. Please
+ * refer to LICENSE.AGPL3 for details.
+ */
+
+#include "PiiRunLengthRoi.h"
+#include <cstring>
+
+namespace PiiImage
+{
+  RunLengthRoi::RunLengthRoi() :
+    _vecRowStarts(1, 0),
+    _iPixelCount(0)
+  {}
+
+  RunLengthRoi::RunLengthRoi(const PiiMatrix<bool>& mask) :
+    _matMask(mask),
+    _vecRowStarts(mask.rows() + 1),
+    _iPixelCount(0)
+  {
+    const int iRows = mask.rows(), iColumns = mask.columns();
+    for (int r=0; r<iRows; ++r)
+      {
+        _vecRowStarts[r] = _vecRuns.size();
+        // 8-bit masks are passed as bool matrices. Any non-zero byte
+        // is in.
+        const unsigned char* pRow = reinterpret_cast<const unsigned char*>(mask.row(r));
+        int c = 0;
+        while (c < iColumns)
+          {
+            while (c < iColumns && pRow[c] == 0) ++c;
+            if (c == iColumns)
+              break;
+            Run run;
+            run.start = c;
+            while (c < iColumns && pRow[c] != 0) ++c;
+            run.end = c;
+            _vecRuns.append(run);
+            _iPixelCount += run.end - run.start;
+          }
+      }
+    _vecRowStarts[iRows] = _vecRuns.size();
+  }
+
+  static bool sameMask(const PiiMatrix<bool>& mask1, const PiiMatrix<bool>& mask2)
+  {
+    const int iRows = mask1.rows(), iColumns = mask1.columns();
+    if (iRows != mask2.rows() || iColumns != mask2.columns())
+      return false;
+    if (iRows == 0 || iColumns == 0 ||
+        (mask1.row(0) == mask2.row(0) && mask1.stride() == mask2.stride()))
+      return true;
+    for (int r=0; r<iRows; ++r)
+      if (std::memcmp(mask1.row(r), mask2.row(r), iColumns) != 0)
+        return false;
+    return true;
+  }
+
+  const RunLengthRoi& RunLengthRoiCache::roi(const PiiMatrix<bool>& mask)
+  {
+    if (!sameMask(mask, _roi.mask()))
+      _roi = RunLengthRoi(mask);
+    return _roi;
+  }
+
+  void RunLengthRoiCache::clear()
+  {
+    _roi = RunLengthRoi();
+  }
+}
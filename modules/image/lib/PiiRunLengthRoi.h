@@ -0,0 +1,133 @@
+/* This file is part of Into.
+ * Copyright (C) Intopii 2013.
+ * All rights reserved.
+ *
+ * Licensees holding a commercial Into license may use this file in
+ * accordance with the commercial license agreement. Please see
+ * LICENSE.commercial for commercial licensing terms.
+ *
+ * Alternatively, this file may be used under the terms of the GNU
+ * Affero General Public License version 3 as published by the Free
+ * Software Foundation. In addition, Intopii gives you special rights
+ * to use Into as a part of open source software projects. Please
+ * refer to LICENSE.AGPL3 for details.
+ */
+
+#ifndef _PIIRUNLENGTHROI_H
+#define _PIIRUNLENGTHROI_H
+
+#include "PiiImageGlobal.h"
+#include <PiiMatrix.h>
+#include <QVector>
+
+namespace PiiImage
+{
+  /**
+   * A region-of-interest stored as horizontal runs of covered
+   * pixels. RunLengthRoi works as an ordinary ROI function object, but
+   * functions that know about it iterate over the runs instead of
+   * testing every pixel. With sparse masks, most of the image is
+   * never touched.
+   *
+   * ~~~(c++)
+   * PiiImage::RunLengthRoi roi(matMask);
+   * PiiMatrix<int> matHistogram(PiiImage::histogram(image, roi, 256));
+   * ~~~
+   *
+   * RunLengthRoi is implicitly shared and cheap to copy.
+   */
+  class PII_IMAGE_EXPORT RunLengthRoi
+  {
+  public:
+    /**
+     * A run of consecutive covered pixels on a row. The run covers
+     * columns [start, end).
+     */
+    struct Run
+    {
+      int start;
+      int end;
+    };
+
+    /**
+     * Creates an empty ROI.
+     */
+    RunLengthRoi();
+
+    /**
+     * Creates a ROI that covers the non-zero pixels of *mask*.
+     */
+    explicit RunLengthRoi(const PiiMatrix<bool>& mask);
+
+    /**
+     * Returns `true` if (r,c) is within the ROI. The original mask is
+     * retained for this, so random access costs no more than with a
+     * plain mask.
+     */
+    inline bool operator() (int r, int c) const { return _matMask(r,c); }
+
+    /**
+     * Returns a pointer to the first run on row *r*.
+     */
+    const Run* runBegin(int r) const { return _vecRuns.constData() + _vecRowStarts[r]; }
+    /**
+     * Returns a pointer to the end of runs on row *r*.
+     */
+    const Run* runEnd(int r) const { return _vecRuns.constData() + _vecRowStarts[r+1]; }
+
+    /**
+     * Returns the number of rows in the ROI.
+     */
+    int rows() const { return _matMask.rows(); }
+    /**
+     * Returns the number of columns in the ROI.
+     */
+    int columns() const { return _matMask.columns(); }
+    /**
+     * Returns the total number of runs.
+     */
+    int runCount() const { return _vecRuns.size(); }
+    /**
+     * Returns the number of pixels within the ROI.
+     */
+    int pixelCount() const { return _iPixelCount; }
+    /**
+     * Returns the mask the ROI was created from.
+     */
+    PiiMatrix<bool> mask() const { return _matMask; }
+
+  private:
+    PiiMatrix<bool> _matMask;
+    // Index of the first run on each row, plus one past the last row.
+    QVector<int> _vecRowStarts;
+    QVector<Run> _vecRuns;
+    int _iPixelCount;
+  };
+
+  /**
+   * Keeps the RunLengthRoi of the most recent mask. Operations that
+   * receive the same mask for each frame can convert it just once.
+   */
+  class PII_IMAGE_EXPORT RunLengthRoiCache
+  {
+  public:
+    /**
+     * Returns a run-length ROI for *mask*. If *mask* shares data with
+     * or equals the previous one, the previous result is returned
+     * without conversion.
+     */
+    const RunLengthRoi& roi(const PiiMatrix<bool>& mask);
+
+    /**
+     * Releases the cached ROI.
+     */
+    void clear();
+
+  private:
+    RunLengthRoi _roi;
+  };
+}
+
+Q_DECLARE_TYPEINFO(PiiImage::RunLengthRoi::Run, Q_PRIMITIVE_TYPE);
+
+#endif //_PIIRUNLENGTHROI_H
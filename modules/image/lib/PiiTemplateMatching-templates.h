@@ -0,0 +1,257 @@
+/* This file is part of Into.
+ * Copyright (C) Intopii 2013.
+ * All rights reserved.
+ *
+ * Licensees holding a commercial Into license may use this file in
+ * accordance with the commercial license agreement. Please see
+ * LICENSE.commercial for commercial licensing terms.
+ *
+ * Alternatively, this file may be used under the terms of the GNU
+ * Affero General Public License version 3 as published by the Free
+ * Software Foundation. In addition, Intopii gives you special rights
+ * to use Into as a part of open source software projects. Please
+ * refer to LICENSE.AGPL3 for details.
+ */
+
+#ifndef _PIITEMPLATEMATCHING_H
+# error "Never use <PiiTemplateMatching-templates.h> directly; include <PiiTemplateMatching.h> instead."
+#endif
+
+#include "PiiImage.h"
+#include "PiiIntegralImage.h"
+#include <PiiFft.h>
+#include <cmath>
+
+namespace PiiImage
+{
+  /// @hide
+  namespace TemplateMatching
+  {
+    // The smallest number not less than length that has no prime
+    // factors other than 2, 3 and 5. PiiFft has fast kernels for
+    // these.
+    inline int fastFftLength(int length)
+    {
+      for (;; ++length)
+        {
+          int iRemainder = length;
+          while (iRemainder % 2 == 0) iRemainder /= 2;
+          while (iRemainder % 3 == 0) iRemainder /= 3;
+          while (iRemainder % 5 == 0) iRemainder /= 5;
+          if (iRemainder == 1)
+            return length;
+        }
+    }
+
+    // Stores templ - mean(templ) to the top left corner of target and
+    // returns the sum of squares of the stored values.
+    template <class U> double zeroMeanTemplate(const PiiMatrix<U>& templ, PiiMatrix<double>& target)
+    {
+      const double dMean = Pii::mean<double>(templ);
+      double dSquares = 0;
+      for (int r=0; r<templ.rows(); ++r)
+        {
+          const U* pSource = templ[r];
+          double* pTarget = target[r];
+          for (int c=0; c<templ.columns(); ++c)
+            {
+              pTarget[c] = double(pSource[c]) - dMean;
+              dSquares += pTarget[c] * pTarget[c];
+            }
+        }
+      return dSquares;
+    }
+
+    // Divides the correlation of a zero-mean template and the window
+    // at (r,c) by the norms of the two.
+    template <class T> inline float normalizeCorrelation(double correlation,
+                                                         const IntegralImage<T>& integral,
+                                                         int r, int c, int rows, int columns,
+                                                         double templateSquares)
+    {
+      const double dSum = double(integral.sum(r, c, r + rows, c + columns)),
+        dSquareSum = double(integral.squareSum(r, c, r + rows, c + columns));
+      // Sum of squared deviations from the mean of the window.
+      const double dDeviations = dSquareSum - dSum * dSum / (double(rows) * columns);
+      // Flat windows may have a tiny non-zero deviation due to
+      // round-off.
+      if (dDeviations <= 1e-10 * dSquareSum || templateSquares <= 0)
+        return 0;
+      return float(qBound(-1.0, correlation / std::sqrt(dDeviations * templateSquares), 1.0));
+    }
+
+    template <class T> struct SparseCorrelationBand
+    {
+      SparseCorrelationBand(const PiiMatrix<T>& image,
+                            const PiiMatrix<double>& templ,
+                            double templateSquares,
+                            const IntegralImage<T>& integral,
+                            const PiiMatrix<bool>& positions,
+                            PiiMatrix<float>& result) :
+        image(image), templ(templ), dTemplateSquares(templateSquares),
+        integral(integral), positions(positions),
+        resultRows(result),
+        iColumns(result.columns())
+      {}
+
+      void operator() (int firstRow, int rowCount) const
+      {
+        const int iTemplateRows = templ.rows(), iTemplateColumns = templ.columns();
+        for (int r=firstRow; r<firstRow+rowCount; ++r)
+          {
+            const bool* pPositions = positions[r];
+            float* pResultRow = resultRows.row(r);
+            for (int c=0; c<iColumns; ++c)
+              if (pPositions[c])
+                {
+                  double dCorrelation = 0;
+                  for (int i=0; i<iTemplateRows; ++i)
+                    {
+                      const T* pImage = image[r+i] + c;
+                      const double* pTemplate = templ[i];
+                      for (int j=0; j<iTemplateColumns; ++j)
+                        dCorrelation += double(pImage[j]) * pTemplate[j];
+                    }
+                  pResultRow[c] = normalizeCorrelation(dCorrelation, integral, r, c,
+                                                       iTemplateRows, iTemplateColumns,
+                                                       dTemplateSquares);
+                }
+          }
+      }
+
+      const PiiMatrix<T>& image;
+      const PiiMatrix<double>& templ;
+      double dTemplateSquares;
+      const IntegralImage<T>& integral;
+      const PiiMatrix<bool>& positions;
+      const Pii::BandRows<float> resultRows;
+      int iColumns;
+    };
+  }
+  /// @endhide
+
+  template <class T, class U>
+  PiiMatrix<float> normalizedCorrelation(const Pii::ParallelExecution& policy,
+                                         const PiiMatrix<T>& image,
+                                         const PiiMatrix<U>& templ)
+  {
+    const int iTemplateRows = templ.rows(), iTemplateColumns = templ.columns(),
+      iRows = image.rows() - iTemplateRows + 1, iColumns = image.columns() - iTemplateColumns + 1;
+    if (templ.isEmpty() || iRows <= 0 || iColumns <= 0)
+      return PiiMatrix<float>();
+
+    // Zero padding to a fast transform length causes no wrap-around
+    // in the valid part of the result.
+    const int iFftRows = TemplateMatching::fastFftLength(image.rows()),
+      iFftColumns = TemplateMatching::fastFftLength(image.columns());
+    PiiMatrix<double> matImage(iFftRows, iFftColumns), matTemplate(iFftRows, iFftColumns);
+    for (int r=0; r<image.rows(); ++r)
+      {
+        const T* pSource = image[r];
+        double* pTarget = matImage[r];
+        for (int c=0; c<image.columns(); ++c)
+          pTarget[c] = double(pSource[c]);
+      }
+    // The template is zero-mean. The correlation of the window mean
+    // with it is therefore zero, and the numerator needs no
+    // window-specific correction.
+    const double dTemplateSquares = TemplateMatching::zeroMeanTemplate(templ, matTemplate);
+
+    // Same as PiiDsp::fastCorrelation(), but parallel and without a
+    // temporary for the product.
+    const PiiFft<double> fft;
+    PiiMatrix<std::complex<double> > matSpectrum(fft.forwardRealFft(policy, matImage));
+    const PiiMatrix<std::complex<double> > matTemplateSpectrum(fft.forwardRealFft(policy, matTemplate));
+    for (int r=0; r<matSpectrum.rows(); ++r)
+      {
+        std::complex<double>* pSpectrum = matSpectrum[r];
+        const std::complex<double>* pTemplate = matTemplateSpectrum[r];
+        for (int c=0; c<matSpectrum.columns(); ++c)
+          pSpectrum[c] *= std::conj(pTemplate[c]);
+      }
+    const PiiMatrix<double> matCorrelation(fft.inverseRealFft(policy, matSpectrum, iFftColumns));
+
+    // Window sums for the denominator.
+    const IntegralImage<T> integral(image, true);
+    PiiMatrix<float> matResult(PiiMatrix<float>::uninitialized(iRows, iColumns));
+    for (int r=0; r<iRows; ++r)
+      {
+        const double* pCorrelation = matCorrelation[r];
+        float* pResult = matResult[r];
+        for (int c=0; c<iColumns; ++c)
+          pResult[c] = TemplateMatching::normalizeCorrelation(pCorrelation[c], integral, r, c,
+                                                              iTemplateRows, iTemplateColumns,
+                                                              dTemplateSquares);
+      }
+    return matResult;
+  }
+
+  template <class T, class U>
+  PiiMatrix<float> normalizedCorrelation(const Pii::ParallelExecution& policy,
+                                         const PiiMatrix<T>& image,
+                                         const PiiMatrix<U>& templ,
+                                         const PiiMatrix<bool>& positions)
+  {
+    const int iRows = image.rows() - templ.rows() + 1, iColumns = image.columns() - templ.columns() + 1;
+    if (templ.isEmpty() || iRows <= 0 || iColumns <= 0)
+      return PiiMatrix<float>();
+    if (positions.rows() != iRows || positions.columns() != iColumns)
+      PII_MATRIX_SIZE_MISMATCH;
+
+    PiiMatrix<double> matTemplate(PiiMatrix<double>::uninitialized(templ.rows(), templ.columns()));
+    const double dTemplateSquares = TemplateMatching::zeroMeanTemplate(templ, matTemplate);
+    const IntegralImage<T> integral(image, true);
+
+    PiiMatrix<float> matResult(iRows, iColumns);
+    Pii::forEachBand(policy, iRows, 0,
+                     TemplateMatching::SparseCorrelationBand<T>(image, matTemplate, dTemplateSquares,
+                                                                integral, positions, matResult));
+    return matResult;
+  }
+
+  template <class T, class U>
+  PiiMatrix<float> pyramidCorrelation(const Pii::ParallelExecution& policy,
+                                      const PiiMatrix<T>& image,
+                                      const PiiMatrix<U>& templ,
+                                      int levels,
+                                      double threshold)
+  {
+    if (templ.isEmpty() || image.rows() < templ.rows() || image.columns() < templ.columns())
+      return PiiMatrix<float>();
+
+    const QList<PiiMatrix<T> > lstImages(buildPyramid(policy, image, levels));
+    const QList<PiiMatrix<U> > lstTemplates(buildPyramid(policy, templ, levels));
+    // Tiny templates match almost everywhere.
+    int iLevel = qMin(lstImages.size(), lstTemplates.size()) - 1;
+    while (iLevel > 0 && (lstTemplates[iLevel].rows() < 4 || lstTemplates[iLevel].columns() < 4))
+      --iLevel;
+
+    PiiMatrix<float> matResult(normalizedCorrelation(policy, lstImages[iLevel], lstTemplates[iLevel]));
+    const float fThreshold = float(threshold);
+    while (iLevel-- > 0)
+      {
+        const int iRows = lstImages[iLevel].rows() - lstTemplates[iLevel].rows() + 1,
+          iColumns = lstImages[iLevel].columns() - lstTemplates[iLevel].columns() + 1;
+        // Mark the neighborhood of each candidate on the finer level.
+        PiiMatrix<bool> matPositions(iRows, iColumns);
+        for (int r=0; r<matResult.rows(); ++r)
+          {
+            const float* pResult = matResult[r];
+            for (int c=0; c<matResult.columns(); ++c)
+              if (pResult[c] >= fThreshold)
+                {
+                  const int iTop = qMax(2*r - 1, 0), iBottom = qMin(2*r + 3, iRows),
+                    iLeft = qMax(2*c - 1, 0), iRight = qMin(2*c + 3, iColumns);
+                  for (int rr=iTop; rr<iBottom; ++rr)
+                    {
+                      bool* pPositions = matPositions[rr];
+                      for (int cc=iLeft; cc<iRight; ++cc)
+                        pPositions[cc] = true;
+                    }
+                }
+          }
+        matResult = normalizedCorrelation(policy, lstImages[iLevel], lstTemplates[iLevel], matPositions);
+      }
+    return matResult;
+  }
+}
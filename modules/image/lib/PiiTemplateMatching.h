@@ -0,0 +1,140 @@
+/* This file is part of Into.
+ * Copyright (C) Intopii 2013.
+ * All rights reserved.
+ *
+ * Licensees holding a commercial Into license may use this file in
+ * accordance with the commercial license agreement. Please see
+ * LICENSE.commercial for commercial licensing terms.
+ *
+ * Alternatively, this file may be used under the terms of the GNU
+ * Affero General Public License version 3 as published by the Free
+ * Software Foundation. In addition, Intopii gives you special rights
+ * to use Into as a part of open source software projects. Please
+ * refer to LICENSE.AGPL3 for details.
+ */
+
+#ifndef _PIITEMPLATEMATCHING_H
+#define _PIITEMPLATEMATCHING_H
+
+#include <PiiMatrix.h>
+#include <PiiParallel.h>
+#include "PiiImageGlobal.h"
+
+namespace PiiImage
+{
+  /**
+   * Calculates the normalized correlation coefficient between
+   * *templ* and each *templ*-sized window of *image*. With \(I\)
+   * denoting the image window at (r,c), \(T\) the template and bars
+   * their means, the result is
+   *
+   * \[
+   * R(r,c) = \frac{\sum (I - \bar{I})(T - \bar{T})}
+   *          {\sqrt{\sum (I - \bar{I})^2 \sum (T - \bar{T})^2}},
+   * \]
+   *
+   * which is the same measure as OpenCV's `CV_TM_CCOEFF_NORMED`. The
+   * values are in [-1,1], and 1 means a perfect match (up to
+   * brightness and contrast). Windows and templates with no variance
+   * produce zero.
+   *
+   * The numerator is calculated for all windows at once as a fast
+   * correlation in the Fourier domain (see PiiDsp::fastCorrelation()).
+   * Since the template is made zero-mean, the mean of the window
+   * cancels out. The window sums needed by the denominator are read
+   * from an integral image. The cost is thus independent of the size
+   * of the template.
+   *
+   * ~~~(c++)
+   * PiiMatrix<float> matMatch(PiiImage::normalizedCorrelation(Pii::ParallelExecution(),
+   *                                                           image, templ));
+   * int r, c;
+   * float fBest = Pii::max(matMatch, &r, &c);
+   * ~~~
+   *
+   * @param policy parallelization policy for the transforms
+   *
+   * @param image the image to search
+   *
+   * @param templ the template to look for
+   *
+   * @return a matrix of (image.rows() - templ.rows() + 1) rows and
+   * (image.columns() - templ.columns() + 1) columns. Empty if the
+   * template is empty or larger than the image.
+   */
+  template <class T, class U>
+  PiiMatrix<float> normalizedCorrelation(const Pii::ParallelExecution& policy,
+                                         const PiiMatrix<T>& image,
+                                         const PiiMatrix<U>& templ);
+
+  /**
+   * Calculates the normalized correlation in the calling thread.
+   */
+  template <class T, class U>
+  inline PiiMatrix<float> normalizedCorrelation(const PiiMatrix<T>& image,
+                                                const PiiMatrix<U>& templ)
+  {
+    return normalizedCorrelation(Pii::ParallelExecution(1), image, templ);
+  }
+
+  /**
+   * Calculates the normalized correlation coefficient only at the
+   * positions marked in *positions*. The correlation is evaluated
+   * directly in the spatial domain, which is faster than the full
+   * transform if only a small number of positions is needed. The
+   * result at unmarked positions is zero.
+   *
+   * @param positions a boolean matrix whose size equals the size of
+   * the full result of normalizedCorrelation().
+   *
+   * @exception PiiInvalidArgumentException& if the size of
+   * *positions* is incorrect.
+   */
+  template <class T, class U>
+  PiiMatrix<float> normalizedCorrelation(const Pii::ParallelExecution& policy,
+                                         const PiiMatrix<T>& image,
+                                         const PiiMatrix<U>& templ,
+                                         const PiiMatrix<bool>& positions);
+
+  /**
+   * Calculates the normalized correlation coefficient in a
+   * coarse-to-fine manner. The image and the template are
+   * downsampled into pyramids with buildPyramid(). The full
+   * correlation is calculated only at the coarsest level. Positions
+   * whose correlation reaches *threshold* are projected to the next
+   * finer level, where the correlation is evaluated in their 4-by-4
+   * neighborhood only. This is repeated until the original
+   * resolution is reached.
+   *
+   * Since the correlation at coarse levels is lower than at the
+   * original resolution, *threshold* should be clearly lower than
+   * the final detection threshold. Levels at which the template would
+   * be smaller than four pixels in either direction are not used.
+   *
+   * ~~~(c++)
+   * // Search on four levels, refine everything that scores above 0.5
+   * PiiMatrix<float> matMatch(PiiImage::pyramidCorrelation(Pii::ParallelExecution(),
+   *                                                        image, templ, 4, 0.5));
+   * ~~~
+   *
+   * @param levels the number of pyramid levels, including the
+   * original resolution. One means no pyramid.
+   *
+   * @param threshold the minimum correlation a position must reach
+   * at coarse levels to be refined.
+   *
+   * @return the correlation at the original resolution. The size is
+   * the same as with normalizedCorrelation(). Zero at positions that
+   * were not refined.
+   */
+  template <class T, class U>
+  PiiMatrix<float> pyramidCorrelation(const Pii::ParallelExecution& policy,
+                                      const PiiMatrix<T>& image,
+                                      const PiiMatrix<U>& templ,
+                                      int levels,
+                                      double threshold);
+}
+
+#include "PiiTemplateMatching-templates.h"
+
+#endif //_PIITEMPLATEMATCHING_H
@@ -18,6 +18,7 @@
 
 #include <PiiMatrix.h>
 #include "PiiHistogram.h"
+#include "PiiIntegralImage.h"
 
 namespace PiiImage
 {
@@ -124,10 +125,9 @@ namespace PiiImage
                                     int windowRows,
                                     int windowColumns)
   {
-    typedef typename Pii::Combine<typename Image::value_type,int>::Type I;
     adaptiveThresholdImpl(image,
                           matThresholded,
-                          Pii::cumulativeSum<I,Image>(image, Pii::ZeroBorderCumulativeSum),
+                          IntegralImage<typename Image::value_type>(image).sums(),
                           counter,
                           func,
                           windowRows,
@@ -273,15 +273,14 @@ namespace PiiImage
     typedef typename TernaryFunction::result_type T;
     typedef typename Matrix::const_row_iterator ImageRow;
 
-    // Use at least int accuracy for the integral image
-    typedef typename Pii::Combine<typename Matrix::value_type,int>::Type I;
-    // Use at least long long accuracy for the integral image of squares
-    typedef typename Pii::Combine<typename Matrix::value_type,long long>::Type I2;
+    typedef IntegralImage<typename Matrix::value_type> Integral;
+    typedef typename Integral::SumType I;
+    typedef typename Integral::SquareSumType I2;
 
-    // Calculate an integral image
-    PiiMatrix<I> matIntegral = Pii::cumulativeSum<I,Matrix>(image, Pii::ZeroBorderCumulativeSum);
-    // Integral image of squares
-    PiiMatrix<I2> matIntegral2 = Pii::cumulativeSum(image, Pii::Square<I2>(), Pii::ZeroBorderCumulativeSum);
+    // Calculate integral images of pixel values and their squares
+    const Integral integral(image, true);
+    const PiiMatrix<I> matIntegral(integral.sums());
+    const PiiMatrix<I2> matIntegral2(integral.squareSums());
 
     if (windowColumns <= 0)
       windowColumns = windowRows;
@@ -310,8 +309,8 @@ namespace PiiImage
             c1 = qMax(c-iHalfCols, 0);
             c2 = qMin(c+iHalfCols+1, iCols);
             int iCount = (c2-c1) * (r2-r1);
-            double dMean = double(pNextRow[c2] + pPrevRow[c1] - pNextRow[c1] - pPrevRow[c2]) / iCount;
-            double dVar = double(pNextRow2[c2] + pPrevRow2[c1] - pNextRow2[c1] - pPrevRow2[c2]) / iCount // sum(x)/N
+            double dMean = double(Integral::boxSum(pPrevRow, pNextRow, c1, c2)) / iCount;
+            double dVar = double(Integral::boxSum(pPrevRow2, pNextRow2, c1, c2)) / iCount // sum(x)/N
               - Pii::square(dMean);
 
             pTarget[c] = func(pSource[c],
@@ -320,6 +319,127 @@ namespace PiiImage
           }
       }
   }
+
+  // Returns true if d >= e * sqrt(v) without calculating the square
+  // root. v must be non-negative.
+  inline bool greaterOrEqualScaledRoot(double d, double e, double v)
+  {
+    if (e >= 0)
+      return d >= 0 && d * d >= e * e * v;
+    return d >= 0 || d * d <= e * e * v;
+  }
+
+  /* The local threshold tests below get the window size n, n(p-a),
+   * where p is the pixel value and a the absolute threshold, the sum
+   * s of the window and the sum of squares q. Both sides of p >= t
+   * are multiplied by n (and by n again for Sauvola) so that the mean
+   * never needs to be divided out. n^2 var = nq - s^2.
+   */
+  struct MeanLocalThresholdTest
+  {
+    MeanLocalThresholdTest(double r, double) : dR(r) {}
+    bool operator() (double, double scaledPixel, double sum, double) const
+    {
+      return scaledPixel >= dR * sum;
+    }
+    double dR;
+  };
+
+  struct NiblackLocalThresholdTest
+  {
+    NiblackLocalThresholdTest(double r, double) : dR(r) {}
+    bool operator() (double count, double scaledPixel, double sum, double squares) const
+    {
+      return greaterOrEqualScaledRoot(scaledPixel - sum, dR, qMax(0.0, count * squares - sum * sum));
+    }
+    double dR;
+  };
+
+  struct SauvolaLocalThresholdTest
+  {
+    SauvolaLocalThresholdTest(double r, double maxStd) : dR(r), dScale(r / maxStd) {}
+    bool operator() (double count, double scaledPixel, double sum, double squares) const
+    {
+      return greaterOrEqualScaledRoot(count * (scaledPixel - (1 - dR) * sum),
+                                      dScale * sum,
+                                      qMax(0.0, count * squares - sum * sum));
+    }
+    double dR, dScale;
+  };
+
+  template <bool squares, class T, class Test>
+  void localThresholdImpl(const PiiMatrix<T>& image,
+                          const IntegralImage<T>& integral,
+                          PiiMatrix<T>& result,
+                          Test test,
+                          double absoluteThreshold,
+                          int windowRows, int windowColumns,
+                          bool inverse)
+  {
+    typedef IntegralImage<T> Integral;
+    typedef typename Integral::SumType I;
+    typedef typename Integral::SquareSumType I2;
+
+    const PiiMatrix<I> matSums(integral.sums());
+    const PiiMatrix<I2> matSquareSums(integral.squareSums());
+    const int iRows = image.rows(), iCols = image.columns(),
+      iHalfRows = windowRows/2, iHalfCols = windowColumns/2;
+    const T above = inverse ? T(0) : T(1), below = inverse ? T(1) : T(0);
+
+    for (int r=0; r<iRows; ++r)
+      {
+        const int r1 = qMax(r-iHalfRows, 0), r2 = qMin(r+iHalfRows+1, iRows);
+        const I* pPrevious = matSums[r1], *pNext = matSums[r2];
+        const I2* pPrevious2 = squares ? matSquareSums[r1] : 0;
+        const I2* pNext2 = squares ? matSquareSums[r2] : 0;
+        typename PiiMatrix<T>::const_row_iterator pSource = image[r];
+        T* pTarget = result[r];
+        for (int c=0; c<iCols; ++c)
+          {
+            const int c1 = qMax(c-iHalfCols, 0), c2 = qMin(c+iHalfCols+1, iCols);
+            const double dCount = (r2-r1) * (c2-c1);
+            pTarget[c] = test(dCount,
+                              dCount * (double(pSource[c]) - absoluteThreshold),
+                              double(Integral::boxSum(pPrevious, pNext, c1, c2)),
+                              squares ? double(Integral::boxSum(pPrevious2, pNext2, c1, c2)) : 0.0) ?
+              above : below;
+          }
+      }
+  }
+
+  template <class T>
+  PiiMatrix<T> localThreshold(const PiiMatrix<T>& image,
+                              const IntegralImage<T>& integral,
+                              LocalThresholdMethod method,
+                              double relativeThreshold,
+                              double absoluteThreshold,
+                              int windowRows, int windowColumns,
+                              bool inverse,
+                              double maxStd)
+  {
+    if (windowColumns <= 0)
+      windowColumns = windowRows;
+    PiiMatrix<T> matResult(PiiMatrix<T>::uninitialized(image.rows(), image.columns()));
+    switch (method)
+      {
+      case MeanLocalThreshold:
+        localThresholdImpl<false>(image, integral, matResult,
+                                  MeanLocalThresholdTest(relativeThreshold, maxStd),
+                                  absoluteThreshold, windowRows, windowColumns, inverse);
+        break;
+      case NiblackLocalThreshold:
+        localThresholdImpl<true>(image, integral, matResult,
+                                 NiblackLocalThresholdTest(relativeThreshold, maxStd),
+                                 absoluteThreshold, windowRows, windowColumns, inverse);
+        break;
+      case SauvolaLocalThreshold:
+        localThresholdImpl<true>(image, integral, matResult,
+                                 SauvolaLocalThresholdTest(relativeThreshold, maxStd),
+                                 absoluteThreshold, windowRows, windowColumns, inverse);
+        break;
+      }
+    return matResult;
+  }
 }
 
 #endif //_PIITHRESHOLDING_TEMPLATES_H
@@ -19,6 +19,7 @@
 #include <PiiMatrix.h>
 #include "PiiHistogram.h"
 #include "PiiLabeling.h"
+#include "PiiIntegralImage.h"
 
 namespace PiiImage
 {
@@ -694,6 +695,108 @@ namespace PiiImage
   PiiMatrix<typename TernaryFunction::result_type> adaptiveThresholdVar(const Matrix& image,
                                                                         TernaryFunction func,
                                                                         int windowRows, int windowColumns = 0);
+
+  /**
+   * Local threshold selection methods for [localThreshold()]. In the
+   * formulas below, \(\mu\) and \(\sigma\) denote the local mean
+   * and standard deviation, *r* the relative threshold and *a* the
+   * absolute threshold.
+   *
+   * - `MeanLocalThreshold` - \(t = r \mu + a\).
+   *
+   * - `NiblackLocalThreshold` - \(t = \mu + r \sigma + a\).
+   *
+   * - `SauvolaLocalThreshold` - \(t = \mu (1 + r (\sigma/\sigma_{\mathrm max} - 1)) + a\).
+   */
+  enum LocalThresholdMethod
+  {
+    MeanLocalThreshold,
+    NiblackLocalThreshold,
+    SauvolaLocalThreshold
+  };
+
+  /**
+   * Thresholds an image adaptively using local statistics read from
+   * an integral image. The local mean and variance are found in
+   * constant time per pixel, and the threshold comparison is done in
+   * the same pass without creating intermediate mean or variance
+   * images. The comparisons are done with window sums instead of
+   * means, which avoids a division and a square root per pixel.
+   *
+   * This function is primarily intended for `unsigned char` and
+   * `unsigned short` images, whose integral images are accumulated
+   * in exact integer arithmetic. It works with other types as well.
+   *
+   * @param image the input image
+   *
+   * @param integral the integral image of *image*. If *method* needs
+   * local variance, the integral image of squares must have been
+   * calculated.
+   *
+   * @param method the method used for calculating local thresholds
+   *
+   * @param relativeThreshold *r* in the threshold formula. See
+   * [LocalThresholdMethod].
+   *
+   * @param absoluteThreshold *a* in the threshold formula.
+   *
+   * @param windowRows the number of rows in the local window
+   *
+   * @param windowColumns the number of columns in the local window.
+   * If this value is non-positive, a `windowRows` - by -
+   * `windowRows` square window will be used. At image borders, only
+   * the part of the window that is inside of the image is used.
+   *
+   * @param inverse if `true`, pixels below the threshold will be set
+   * to one and others to zero. By default, pixels equal to or larger
+   * than the threshold will be ones.
+   *
+   * @param maxStd \(\sigma_{\mathrm max}\) in Sauvola's formula.
+   * Defaults to 128 for integer types and 0.5 for floating-point
+   * types.
+   *
+   * @return a binary image
+   *
+   * ~~~(c++)
+   * // Document binarization
+   * PiiMatrix<unsigned char> image;
+   * PiiMatrix<unsigned char> matBinary(PiiImage::localThreshold(image,
+   *                                                             PiiImage::SauvolaLocalThreshold,
+   *                                                             0.34, 0, 31));
+   * ~~~
+   */
+  template <class T>
+  PiiMatrix<T> localThreshold(const PiiMatrix<T>& image,
+                              const IntegralImage<T>& integral,
+                              LocalThresholdMethod method,
+                              double relativeThreshold,
+                              double absoluteThreshold,
+                              int windowRows, int windowColumns = 0,
+                              bool inverse = false,
+                              double maxStd = MaximumStd<T>::value());
+
+  /**
+   * Calculates the integral images needed by *method* and
+   * thresholds *image* adaptively. See
+   * [localThreshold(const PiiMatrix<T>&, const IntegralImage<T>&, LocalThresholdMethod, double, double, int, int, bool, double)]
+   * for details.
+   */
+  template <class T>
+  PiiMatrix<T> localThreshold(const PiiMatrix<T>& image,
+                              LocalThresholdMethod method,
+                              double relativeThreshold,
+                              double absoluteThreshold,
+                              int windowRows, int windowColumns = 0,
+                              bool inverse = false,
+                              double maxStd = MaximumStd<T>::value())
+  {
+    return localThreshold(image,
+                          IntegralImage<T>(image, method != MeanLocalThreshold),
+                          method,
+                          relativeThreshold, absoluteThreshold,
+                          windowRows, windowColumns,
+                          inverse, maxStd);
+  }
 }
 
 #include "PiiThresholding-templates.h"
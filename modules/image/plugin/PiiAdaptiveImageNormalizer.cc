@@ -78,7 +78,7 @@ template <class T> PiiMatrix<T> PiiAdaptiveImageNormalizer::normalize(const PiiM
   double dTarget = d->dTargetMean;
   if (Pii::isNan(dTarget))
     dTarget = PiiImage::Traits<T>::max() / 2;
-  return PiiImage::adaptiveThreshold(image, Normalizer<T>(dTarget), d->windowSize.width(), d->windowSize.height());
+  return PiiImage::adaptiveThreshold(image, Normalizer<T>(dTarget), d->windowSize.height(), d->windowSize.width());
 }
 
 void PiiAdaptiveImageNormalizer::setWindowSize(const QSize& windowSize) { _d()->windowSize = windowSize; }
@@ -18,11 +18,20 @@
 #include <QString>
 #include <PiiMath.h>
 #include <PiiImageTraits.h>
+#include "PiiImage.h"
+#include <PiiParallel.h>
+#include <PiiGenericInputArchive.h>
+#include <PiiGenericOutputArchive.h>
+#include <QVector>
+
+#include <cmath>
 
 PiiBackgroundExtractor::Data::Data() :
   bFirst(true), dThreshold(25.0),
   dAlpha1(0.1), dAlpha2(0.01),
-  iMaxStillTime(1000), dMovementThreshold(0.0)
+  iMaxStillTime(1000), dMovementThreshold(0.0),
+  model(RunningAverageModel),
+  bSelectiveUpdate(false)
 {
 }
 
@@ -38,6 +47,12 @@ PiiBackgroundExtractor::PiiBackgroundExtractor() :
 void PiiBackgroundExtractor::process()
 {
   PiiVariant obj = readInput();
+  if (obj.type() == PiiYdin::UnsignedCharMatrixType)
+    {
+      operateFixedPoint(obj.valueAs<PiiMatrix<unsigned char> >());
+      return;
+    }
+
   switch (obj.type())
     {
       PII_ALL_IMAGE_CASES(operate, obj);
@@ -46,6 +61,26 @@ void PiiBackgroundExtractor::process()
     }
 }
 
+void PiiBackgroundExtractor::saveState(PiiGenericOutputArchive& archive)
+{
+  PII_D;
+  archive << d->bFirst;
+  archive << d->matStillCounter;
+  archive << d->matBackground;
+  archive << d->matForeground;
+  archive << d->matFixedBackground;
+}
+
+void PiiBackgroundExtractor::loadState(PiiGenericInputArchive& archive)
+{
+  PII_D;
+  archive >> d->bFirst;
+  archive >> d->matStillCounter;
+  archive >> d->matBackground;
+  archive >> d->matForeground;
+  archive >> d->matFixedBackground;
+}
+
 template <class T> void PiiBackgroundExtractor::operate(const PiiVariant& obj)
 {
   PII_D;
@@ -55,12 +90,20 @@ template <class T> void PiiBackgroundExtractor::operate(const PiiVariant& obj)
 
   const int iRows = inputMatrix.rows(), iCols = inputMatrix.columns();
 
-  if (d->bFirst) // Initialize.
+  const bool bMedian = d->model == ApproximateMedianModel;
+  // The median moves by one gray level: 1 for integer pixels, 1/255
+  // for floating-point pixels in [0,1].
+  const double dMedianStep = double(PiiImage::Traits<T>::template fromInt<int>(1));
+  const double dBackgroundRate = bMedian ? dMedianStep : d->dAlpha1,
+    dForegroundRate = d->bSelectiveUpdate ? 0.0 : bMedian ? dMedianStep : d->dAlpha2;
+
+  if (d->bFirst || d->matBackground.isEmpty()) // Initialize.
     {
       // Init support matrices.
       d->matStillCounter = PiiMatrix<int>(iRows, iCols);
       d->matBackground = PiiMatrix<float>(inputMatrix); // Init with input image values.
       d->matForeground = PiiMatrix<float>(iRows, iCols);
+      d->matFixedBackground = PiiMatrix<short>();
       d->bFirst = false;
     }
   else // Update model.
@@ -104,14 +147,90 @@ template <class T> void PiiBackgroundExtractor::operate(const PiiVariant& obj)
 
               // Update background model.
               // B_t+1 = B_t + (alpha1 * (1 - M_t) + alpha2 * M_t) * D_t
-              pBackgroundRow[c] += float((d->dAlpha1 * (1.0 - pForegroundRow[c]) +
-                                          d->dAlpha2 * pForegroundRow[c]) * dDifference);
+              const double dRate = pForegroundRow[c] != 0 ? dForegroundRate : dBackgroundRate;
+              if (bMedian)
+                pBackgroundRow[c] += float(qBound(-dRate, dDifference, dRate));
+              else
+                pBackgroundRow[c] += float(dRate * dDifference);
             }
         }
     }
 
+  emitResults(iValidCounter);
+}
+
+struct PiiBackgroundExtractor::FixedPointBand
+{
+  FixedPointBand(const PiiMatrix<unsigned char>& image, PiiMatrix<short>& background,
+                 PiiMatrix<int>& stillCounter, int* foregroundCounts,
+                 int threshold, int rate, int foregroundRate, int maxStillTime, bool median) :
+    image(image), backgroundRows(background), stillCounterRows(stillCounter),
+    pForegroundCounts(foregroundCounts),
+    iThreshold(threshold), iRate(rate), iForegroundRate(foregroundRate),
+    iMaxStillTime(maxStillTime), bMedian(median)
+  {}
+
+  void operator() (int firstRow, int rowCount) const
+  {
+    for (int r=firstRow; r<firstRow+rowCount; ++r)
+      pForegroundCounts[r] =
+        PiiImage::updateBackgroundRow(image[r], backgroundRows.row(r), stillCounterRows.row(r),
+                                      image.columns(), iThreshold, iRate, iForegroundRate,
+                                      iMaxStillTime, bMedian);
+  }
+
+  const PiiMatrix<unsigned char>& image;
+  const Pii::BandRows<short> backgroundRows;
+  const Pii::BandRows<int> stillCounterRows;
+  int* pForegroundCounts;
+  int iThreshold, iRate, iForegroundRate, iMaxStillTime;
+  bool bMedian;
+};
+
+void PiiBackgroundExtractor::operateFixedPoint(const PiiMatrix<unsigned char>& image)
+{
+  PII_D;
+  const int iRows = image.rows(), iCols = image.columns();
+
+  if (d->bFirst || d->matFixedBackground.isEmpty())
+    {
+      // The model stores gray levels times 128, which keeps both
+      // the model and its difference to a frame in 16 bits.
+      d->matStillCounter = PiiMatrix<int>(iRows, iCols);
+      d->matFixedBackground = PiiMatrix<short>(image);
+      d->matFixedBackground.map(std::multiplies<short>(), short(128));
+      d->matBackground = PiiMatrix<float>();
+      d->matForeground = PiiMatrix<float>();
+      d->bFirst = false;
+      emitResults(0);
+      return;
+    }
+
+  if (iRows != d->matFixedBackground.rows() || iCols != d->matFixedBackground.columns())
+    PII_THROW_WRONG_SIZE(inputAt(0), image, d->matFixedBackground.rows(), d->matFixedBackground.columns());
+
+  const bool bMedian = d->model == ApproximateMedianModel;
+  // Running average weights are in Q15, median steps in model units.
+  const int iRate = bMedian ? 128 : qBound(0, int(d->dAlpha1 * 32768 + 0.5), 32767),
+    iForegroundRate = d->bSelectiveUpdate ? 0 : bMedian ? 128 : qBound(0, int(d->dAlpha2 * 32768 + 0.5), 32767),
+    iThreshold = int(qBound(-1.0, std::floor(d->dThreshold * 128), 32767.0));
+
+  QVector<int> vecForegroundCounts(iRows);
+  Pii::forEachBand(Pii::ParallelExecution(), iRows, 0,
+                   FixedPointBand(image, d->matFixedBackground, d->matStillCounter,
+                                  vecForegroundCounts.data(),
+                                  iThreshold, iRate, iForegroundRate, d->iMaxStillTime, bMedian));
+  int iForeground = 0;
+  for (int r=0; r<iRows; ++r)
+    iForeground += vecForegroundCounts[r];
+  emitResults(iForeground);
+}
+
+void PiiBackgroundExtractor::emitResults(int foregroundPixels)
+{
+  PII_D;
   // Too many foreground pixels -> there is something wrong
-  emitObject(iValidCounter < (d->dMovementThreshold * iRows * iCols), 1);
+  emitObject(foregroundPixels < (d->dMovementThreshold * d->matStillCounter.rows() * d->matStillCounter.columns()), 1);
   emitObject(d->matStillCounter, 0);
 }
 
@@ -125,3 +244,7 @@ void PiiBackgroundExtractor::setMaxStillTime(int maxStillTime) { _d()->iMaxStill
 int PiiBackgroundExtractor::maxStillTime() const { return _d()->iMaxStillTime; }
 void PiiBackgroundExtractor::setMovementThreshold(double movementThreshold) { _d()->dMovementThreshold = movementThreshold; }
 float PiiBackgroundExtractor::movementThreshold() const { return _d()->dMovementThreshold; }
+void PiiBackgroundExtractor::setModel(Model model) { _d()->model = model; }
+PiiBackgroundExtractor::Model PiiBackgroundExtractor::model() const { return _d()->model; }
+void PiiBackgroundExtractor::setSelectiveUpdate(bool selectiveUpdate) { _d()->bSelectiveUpdate = selectiveUpdate; }
+bool PiiBackgroundExtractor::selectiveUpdate() const { return _d()->bSelectiveUpdate; }
@@ -37,6 +37,15 @@
  * input image is normalized so that the maximum pixel intensity is
  * always one.
  *
+ * Alternatively, the background can be modeled with an approximate
+ * median that moves at most one gray level towards the current frame
+ * on each frame. See [model].
+ *
+ * 8-bit gray-level images are processed in parallel bands of rows
+ * using a fixed-point background model (1/128 gray levels) and SIMD
+ * instructions if available. Other image types are converted to
+ * `float`.
+ *
  * Inputs
  * ------
  *
@@ -90,8 +99,38 @@ class PiiBackgroundExtractor : public PiiDefaultOperation
    */
   Q_PROPERTY(double movementThreshold READ movementThreshold WRITE setMovementThreshold);
 
+  /**
+   * The background model. The default is `RunningAverageModel`.
+   */
+  Q_PROPERTY(Model model READ model WRITE setModel);
+  Q_ENUMS(Model);
+
+  /**
+   * Selective update flag. If `true`, the background model is updated
+   * only in pixels that are not classified as foreground in the
+   * current frame, and [alpha2] is ignored. Pixels that exceed
+   * [maxStillTime] are still merged to the background. The default is
+   * `false`.
+   */
+  Q_PROPERTY(bool selectiveUpdate READ selectiveUpdate WRITE setSelectiveUpdate);
+
   PII_OPERATION_SERIALIZATION_FUNCTION
 public:
+  /**
+   * Background models.
+   *
+   * - `RunningAverageModel` - an exponentially weighted running
+   * average controlled with [alpha1] and [alpha2].
+   *
+   * - `ApproximateMedianModel` - each background pixel moves at most
+   * one gray level towards the current frame. With floating-point
+   * images, whose intensities are in [0,1], one gray level is 1/255.
+   * This converges to the
+   * median of the pixel's history and is insensitive to outliers.
+   * [alpha1] and [alpha2] are ignored.
+   */
+  enum Model { RunningAverageModel, ApproximateMedianModel };
+
   PiiBackgroundExtractor();
 
   double threshold() const;
@@ -104,12 +143,21 @@ public:
   int maxStillTime() const;
   void setMovementThreshold(double movementThreshold);
   float movementThreshold() const;
+  void setModel(Model model);
+  Model model() const;
+  void setSelectiveUpdate(bool selectiveUpdate);
+  bool selectiveUpdate() const;
 
 protected:
   void process();
+  void saveState(PiiGenericOutputArchive& archive);
+  void loadState(PiiGenericInputArchive& archive);
 
 private:
   template <class T> void operate(const PiiVariant& obj);
+  void operateFixedPoint(const PiiMatrix<unsigned char>& image);
+  void emitResults(int foregroundPixels);
+  struct FixedPointBand;
 
   /// @internal
   class Data : public PiiDefaultOperation::Data
@@ -123,9 +171,12 @@ private:
     PiiMatrix<int> matStillCounter;
     PiiMatrix<float> matBackground;
     PiiMatrix<float> matForeground;
+    PiiMatrix<short> matFixedBackground;
 
     int iMaxStillTime;
     double dMovementThreshold;
+    Model model;
+    bool bSelectiveUpdate;
   };
   PII_D_FUNC;
 };
@@ -53,27 +53,37 @@ template <class T> void PiiBoundaryFinderOperation::findBoundaries(const PiiVari
   PII_D;
   const PiiMatrix<T> image(obj.valueAs<PiiMatrix<T> >());
   PiiMatrix<unsigned char> matBoundaryMask;
-  PiiBoundaryFinder finder(image.rows(), image.columns(), &matBoundaryMask);
-  PiiMatrix<int> matPoints(0,2);
-  matPoints.reserve(256);
-  PiiMatrix<int> matLimits(1,32);
+  // Independent objects are traced in parallel into compact chain
+  // codes.
+  QList<PiiChainCode> lstChains(PiiBoundaryFinder::findChainCodes(Pii::ParallelExecution(), image,
+                                                                  std::bind2nd(std::greater<T>(), T(d->dThreshold)),
+                                                                  d->pMaskOutput->isConnected() ? &matBoundaryMask : 0));
+  PiiMatrix<int> matLimits(1,lstChains.size());
   matLimits.resize(1,0);
   int iLimit = 0;
-
-  for (;;)
+  for (int i=0; i<lstChains.size(); ++i)
     {
-      int iPoints = finder.findNextBoundary(image, std::bind2nd(std::greater<T>(), T(d->dThreshold)), matPoints);
-      if (iPoints == 0)
-        break;
-      if (iPoints < d->iMinLength || iPoints > d->iMaxLength)
-        matPoints.resize(matPoints.rows() - iPoints, 2);
-      else
+      int iPoints = lstChains[i].pointCount();
+      if (iPoints >= d->iMinLength && iPoints <= d->iMaxLength)
         {
           iLimit += iPoints;
           matLimits.appendColumn(iLimit);
         }
     }
 
+  // Coordinates are needed only if someone reads them.
+  PiiMatrix<int> matPoints(0,2);
+  if (d->pBoundariesOutput->isConnected() || d->pBoundaryOutput->isConnected())
+    {
+      matPoints.reserve(iLimit);
+      for (int i=0; i<lstChains.size(); ++i)
+        {
+          int iPoints = lstChains[i].pointCount();
+          if (iPoints >= d->iMinLength && iPoints <= d->iMaxLength)
+            lstChains[i].appendPoints(matPoints);
+        }
+    }
+
   d->pBoundariesOutput->emitObject(matPoints);
   d->pLimitsOutput->emitObject(matLimits);
   d->pMaskOutput->emitObject(matBoundaryMask);
@@ -18,7 +18,10 @@
 #include "PiiImage.h"
 
 PiiCornerDetector::Data::Data() :
-  dThreshold(25)
+  dThreshold(25),
+  iArcLength(9),
+  iCellSize(0),
+  iMaxCornersPerCell(0)
 {
 }
 
@@ -43,9 +46,19 @@ void PiiCornerDetector::process()
 
 template <class T> void PiiCornerDetector::detectCorners(const PiiVariant& obj)
 {
+  PII_D;
   emitObject(PiiImage::detectFastCorners(obj.valueAs<PiiMatrix<T> >(),
-                                         T(_d()->dThreshold)));
+                                         T(d->dThreshold),
+                                         d->iArcLength,
+                                         d->iCellSize,
+                                         d->iMaxCornersPerCell));
 }
 
 void PiiCornerDetector::setThreshold(double threshold) { _d()->dThreshold = threshold; }
 double PiiCornerDetector::threshold() const { return _d()->dThreshold; }
+void PiiCornerDetector::setArcLength(int arcLength) { _d()->iArcLength = qBound(9, arcLength, 12); }
+int PiiCornerDetector::arcLength() const { return _d()->iArcLength; }
+void PiiCornerDetector::setCellSize(int cellSize) { _d()->iCellSize = qMax(cellSize, 0); }
+int PiiCornerDetector::cellSize() const { return _d()->iCellSize; }
+void PiiCornerDetector::setMaxCornersPerCell(int maxCornersPerCell) { _d()->iMaxCornersPerCell = qMax(maxCornersPerCell, 0); }
+int PiiCornerDetector::maxCornersPerCell() const { return _d()->iMaxCornersPerCell; }
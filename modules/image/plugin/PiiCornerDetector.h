@@ -44,12 +44,36 @@ class PiiCornerDetector : public PiiDefaultOperation
    */
   Q_PROPERTY(double threshold READ threshold WRITE setThreshold);
 
+  /**
+   * The minimum number of contiguous pixels on the test circle, 9 to
+   * 12. The default is 9.
+   */
+  Q_PROPERTY(int arcLength READ arcLength WRITE setArcLength);
+
+  /**
+   * The size of a grid cell for limiting the number of corners. Zero
+   * (the default) disables the grid. See [maxCornersPerCell].
+   */
+  Q_PROPERTY(int cellSize READ cellSize WRITE setCellSize);
+
+  /**
+   * The maximum number of strongest corners retained in each grid
+   * cell. Zero (the default) means no limit.
+   */
+  Q_PROPERTY(int maxCornersPerCell READ maxCornersPerCell WRITE setMaxCornersPerCell);
+
   PII_OPERATION_SERIALIZATION_FUNCTION
 public:
   PiiCornerDetector();
 
   void setThreshold(double threshold);
   double threshold() const;
+  void setArcLength(int arcLength);
+  int arcLength() const;
+  void setCellSize(int cellSize);
+  int cellSize() const;
+  void setMaxCornersPerCell(int maxCornersPerCell);
+  int maxCornersPerCell() const;
 
 protected:
   void process();
@@ -61,6 +85,9 @@ private:
   public:
     Data();
     double dThreshold;
+    int iArcLength;
+    int iCellSize;
+    int iMaxCornersPerCell;
   };
   PII_D_FUNC;
 
@@ -29,6 +29,7 @@ PiiEdgeDetector::PiiEdgeDetector() :
   PiiDefaultOperation(new Data)
 {
   setThreadCount(1);
+  setDeterministic(true);
   addSocket(new PiiInputSocket("image"));
   addSocket(new PiiOutputSocket("edges"));
   addSocket(new PiiOutputSocket("magnitude"));
@@ -62,8 +63,16 @@ void PiiEdgeDetector::check(bool reset)
 
 void PiiEdgeDetector::process()
 {
+  PII_D;
   PiiVariant obj = readInput();
 
+  if (obj.type() == PiiYdin::UnsignedCharMatrixType &&
+      d->detector == CannyDetector && !d->bDirectionConnected)
+    {
+      detectCannyEdges(obj.valueAs<PiiMatrix<unsigned char> >());
+      return;
+    }
+
   switch (obj.type())
     {
       PII_INT_GRAY_IMAGE_CASES(detectIntEdges, obj);
@@ -83,6 +92,17 @@ template <class T> void PiiEdgeDetector::detectIntEdges(const PiiVariant& obj)
               PiiImage::filter<int>(image, d->matFilterY));
 }
 
+void PiiEdgeDetector::detectCannyEdges(const PiiMatrix<unsigned char>& image)
+{
+  PII_D;
+  PiiMatrix<int> matMagnitude;
+  PiiMatrix<int> matEdges(PiiImage::cannyEdges(Pii::ParallelExecution(), image,
+                                               int(d->dLowThreshold), int(d->dThreshold),
+                                               outputAt(1)->isConnected() ? &matMagnitude : 0));
+  outputAt(1)->emitObject(matMagnitude);
+  emitObject(matEdges);
+}
+
 template <class T> void PiiEdgeDetector::detectFloatEdges(const PiiVariant& obj)
 {
   PII_D;
@@ -54,7 +54,10 @@ class PiiEdgeDetector : public PiiDefaultOperation
   /**
    * Edge detection method. Except for the Canny detector, the only
    * difference between the detection methods is in the gradient
-   * estimation filters. The default is `CannyDetector`.
+   * estimation filters. The default is `CannyDetector`. If the
+   * input is a PiiMatrix<unsigned char> and the `direction` output
+   * is not connected, the Canny detector uses the parallel
+   * [PiiImage::cannyEdges()].
    */
   Q_PROPERTY(Detector detector READ detector WRITE setDetector);
   Q_ENUMS(Detector);
@@ -123,6 +126,7 @@ protected:
 private:
   template <class T> void detectIntEdges(const PiiVariant& obj);
   template <class T> void detectFloatEdges(const PiiVariant& obj);
+  void detectCannyEdges(const PiiMatrix<unsigned char>& image);
   template <class T> void detectEdges(const PiiMatrix<T>& gradientX,
                                       const PiiMatrix<T>& gradientY);
   template <class T> void cannyThreshold(const PiiMatrix<T>& gradientX,
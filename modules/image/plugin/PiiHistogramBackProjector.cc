@@ -122,6 +122,13 @@ template <class T> void PiiHistogramBackProjector::backProject(const PiiVariant&
     }
 }
 
+// A model with an entry for every possible value of an 8-bit image
+// needs no range check. This saves a full pass over the image.
+template <class U> static inline bool coversRange(int size)
+{
+  return Pii::IsSame<U,unsigned char>::boolValue && size >= 256;
+}
+
 // Convert model to matrix and use already resolved input channel matrices
 template <class T, class U> void PiiHistogramBackProjector::backProject(const PiiMatrix<U>& ch1, const PiiMatrix<U>& ch2)
 {
@@ -129,12 +136,18 @@ template <class T, class U> void PiiHistogramBackProjector::backProject(const Pi
   const PiiMatrix<T> model = _d()->varTmpModel.valueAs<PiiMatrix<T> >();
 
   // Check that the input matrices index a valid range of rows/columns
-  U maxVal =  Pii::max(ch1);
-  if (int(maxVal) >= model.rows()) // maxVal >= 0, because U is unsigned
-    PII_THROW(PiiExecutionException, tr(errorMsg).arg(0).arg(0).arg(maxVal).arg(model.rows()-1));
-  maxVal = Pii::max(ch2);
-  if (int(maxVal) >= model.columns())
-    PII_THROW(PiiExecutionException, tr(errorMsg).arg(1).arg(0).arg(maxVal).arg(model.columns()-1));
+  if (!coversRange<U>(model.rows()))
+    {
+      U maxVal =  Pii::max(ch1);
+      if (int(maxVal) >= model.rows()) // maxVal >= 0, because U is unsigned
+        PII_THROW(PiiExecutionException, tr(errorMsg).arg(0).arg(0).arg(maxVal).arg(model.rows()-1));
+    }
+  if (!coversRange<U>(model.columns()))
+    {
+      U maxVal = Pii::max(ch2);
+      if (int(maxVal) >= model.columns())
+        PII_THROW(PiiExecutionException, tr(errorMsg).arg(1).arg(0).arg(maxVal).arg(model.columns()-1));
+    }
 
   emitObject(PiiImage::backProject(ch1, ch2, model));
 }
@@ -143,9 +156,12 @@ template <class T, class U> void PiiHistogramBackProjector::backProject(const Pi
 template <class T, class U> void PiiHistogramBackProjector::backProject(const PiiMatrix<U>& image)
 {
   const PiiMatrix<T>& model = _d()->varTmpModel.valueAs<PiiMatrix<T> >();
-  U maxVal = Pii::max(image);
-  if (int(maxVal) >= model.columns())
-    PII_THROW(PiiExecutionException, tr("Values in input image (%1-%2) exceed model size (0-%3).").arg(0).arg(maxVal).arg(model.columns()-1));
+  if (!coversRange<U>(model.columns()))
+    {
+      U maxVal = Pii::max(image);
+      if (int(maxVal) >= model.columns())
+        PII_THROW(PiiExecutionException, tr("Values in input image (%1-%2) exceed model size (0-%3).").arg(0).arg(maxVal).arg(model.columns()-1));
+    }
 
   emitObject(PiiImage::backProject(image, model));
 }
@@ -18,7 +18,8 @@
 #include "PiiHistogram.h"
 
 PiiHistogramEqualizer::Data::Data() :
-  iLevels(256)
+  iLevels(256),
+  dClipLimit(0)
 {
 }
 
@@ -50,11 +51,22 @@ void PiiHistogramEqualizer::process()
 
 template <class T> void PiiHistogramEqualizer::equalize(const PiiVariant& obj)
 {
+  PII_D;
   const PiiMatrix<T> img = obj.valueAs<PiiMatrix<T> >();
-  emitObject(PiiImage::equalize(img, (unsigned)_d()->iLevels));
+  if (d->tileSize.width() > 0 && d->tileSize.height() > 0)
+    emitObject(PiiImage::adaptiveEqualize(Pii::ParallelExecution(), img,
+                                          d->tileSize.height(), d->tileSize.width(),
+                                          d->dClipLimit, (unsigned)d->iLevels));
+  else
+    emitObject(PiiImage::equalize(img, (unsigned)d->iLevels));
 }
 
 int PiiHistogramEqualizer::levels() const
 {
   return _d()->iLevels;
 }
+
+void PiiHistogramEqualizer::setTileSize(const QSize& tileSize) { _d()->tileSize = tileSize; }
+QSize PiiHistogramEqualizer::tileSize() const { return _d()->tileSize; }
+void PiiHistogramEqualizer::setClipLimit(double clipLimit) { _d()->dClipLimit = qMax(0.0, clipLimit); }
+double PiiHistogramEqualizer::clipLimit() const { return _d()->dClipLimit; }
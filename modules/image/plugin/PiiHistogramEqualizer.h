@@ -17,11 +17,17 @@
 #define _PIIHISTOGRAMEQUALIZER_H
 
 #include <PiiDefaultOperation.h>
+#include <QSize>
 
 /**
  * Histogram equalizer. Enhances the contrast of input images by
  * making their gray-level distributions as uniform as possible.
  *
+ * By default, the whole image is equalized with one mapping. If
+ * [tileSize] is set, contrast-limited adaptive histogram
+ * equalization (CLAHE) is used instead. See
+ * PiiImage::adaptiveEqualize().
+ *
  * Inputs
  * ------
  *
@@ -44,12 +50,30 @@ class PiiHistogramEqualizer : public PiiDefaultOperation
    */
   Q_PROPERTY(int levels READ levels WRITE setLevels);
 
+  /**
+   * The size of a tile in adaptive equalization. If either dimension
+   * is zero (the default), the image will be equalized globally.
+   */
+  Q_PROPERTY(QSize tileSize READ tileSize WRITE setTileSize);
+
+  /**
+   * The maximum height of a tile's histogram bin relative to the
+   * average. Only used in adaptive equalization. Zero (the default)
+   * disables clipping. Values between 2 and 4 suppress noise in
+   * uniform areas.
+   */
+  Q_PROPERTY(double clipLimit READ clipLimit WRITE setClipLimit);
+
   PII_OPERATION_SERIALIZATION_FUNCTION
 public:
   PiiHistogramEqualizer();
 
   void setLevels(int levels);
   int levels() const;
+  void setTileSize(const QSize& tileSize);
+  QSize tileSize() const;
+  void setClipLimit(double clipLimit);
+  double clipLimit() const;
 
 protected:
   void process();
@@ -62,7 +86,9 @@ private:
   {
   public:
     Data();
-    int iLevels;};
+    int iLevels;
+    QSize tileSize;
+    double dClipLimit;};
   PII_D_FUNC;
 
 };
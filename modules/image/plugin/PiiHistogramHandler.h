@@ -74,22 +74,22 @@ template <class Clr> struct PiiColorHistogramHandler : PiiHistogramHandler
   void operator() (const PiiMatrix<Clr>& image);
   template <class Roi> void operator() (const PiiMatrix<Clr>& image, const Roi& roi);
   void normalize();
+  template <class Roi> void addHistograms(const PiiMatrix<Clr>& image, const Roi& roi, bool count);
 
   PiiVariant varHistograms[3];
-  PiiMatrix<typename Clr::Type> channelImages[3];
   bool baCalculate[3];
 };
 
 template <class T> void PiiGrayHistogramHandler<T>::operator() (const PiiMatrix<T>& image)
 {
   iPixelCount += image.rows() * image.columns();
-  addToVariant(varHistogram, PiiImage::histogram(image, iLevels));
+  addToVariant(varHistogram, PiiImage::histogram(Pii::ParallelExecution(), image, iLevels));
 }
 
 template <class T> template <class Roi>
 void PiiGrayHistogramHandler<T>::operator() (const PiiMatrix<T>& image, const Roi& roi)
 {
-  PiiMatrix<int> matHistogram(PiiImage::histogram(image, roi, iLevels));
+  PiiMatrix<int> matHistogram(PiiImage::histogram<int>(Pii::ParallelExecution(), image, roi, iLevels));
   if (bNormalized)
     iPixelCount += Pii::sum<int>(matHistogram);
   addToVariant(varHistogram, matHistogram);
@@ -110,31 +110,27 @@ template <class T> void PiiGrayHistogramHandler<T>::initialize(int levels, bool
 
 template <class Clr> void PiiColorHistogramHandler<Clr>::operator() (const PiiMatrix<Clr>& image)
 {
-  PiiImage::separateChannels(image, channelImages);
   iPixelCount += image.rows() * image.columns();
-  for (int i=0; i<3; ++i)
-    if (baCalculate[i])
-      addToVariant(varHistograms[i], PiiImage::histogram(channelImages[i], iLevels));
+  addHistograms(image, PiiImage::DefaultRoi(), false);
 }
 
 template <class Clr> template <class Roi>
 void PiiColorHistogramHandler<Clr>::operator() (const PiiMatrix<Clr>& image, const Roi& roi)
 {
-  PiiImage::separateChannels(image, channelImages);
-  bool bMustCount = bNormalized;
+  addHistograms(image, roi, bNormalized);
+}
+
+template <class Clr> template <class Roi>
+void PiiColorHistogramHandler<Clr>::addHistograms(const PiiMatrix<Clr>& image, const Roi& roi, bool count)
+{
+  // All channels are collected in one pass over the image.
+  PiiMatrix<int> aHistograms[3];
+  PiiImage::channelHistograms(Pii::ParallelExecution(), image, roi, iLevels, aHistograms);
+  if (count)
+    iPixelCount += Pii::sum<int>(aHistograms[0]);
   for (int i=0; i<3; ++i)
-    {
-      if (baCalculate[i])
-        {
-          PiiMatrix<int> matHistogram(PiiImage::histogram(channelImages[i], roi, iLevels));
-          if (bMustCount)
-            {
-              iPixelCount += Pii::sum<int>(matHistogram);
-              bMustCount = false;
-            }
-          addToVariant(varHistograms[i], matHistogram);
-        }
-    }
+    if (baCalculate[i])
+      addToVariant(varHistograms[i], aHistograms[i]);
 }
 
 template <class Clr> void PiiColorHistogramHandler<Clr>::normalize()
@@ -141,7 +141,7 @@ template <class T> void PiiHistogramOperation::histogram(const PiiVariant& obj)
   Histogram<T>& hist = *static_cast<Histogram<T>*>(d->pHistogram);
   hist.initialize(d->iLevels, d->bNormalized);
 
-  PiiImage::handleRoiInput(d->pRoiInput, d->roiType, image, hist);
+  PiiImage::handleRoiInput(d->pRoiInput, d->roiType, image, hist, &d->roiCache);
 
   if (d->bNormalized)
     hist.normalize();
@@ -32,7 +32,9 @@
  * @in image - the input image, any gray-scale or color image.
  *
  * @in roi - region-of-interest. See [PiiImagePlugin] for details.
- * Optional.
+ * Optional. Masks are converted to runs of covered pixels, and only
+ * those are visited. The conversion is reused as long as the same
+ * mask keeps coming.
  *
  * Outputs
  * -------
@@ -111,6 +113,7 @@ private:
 
     bool bNormalized;
     PiiImage::RoiType roiType;
+    PiiImage::RunLengthRoiCache roiCache;
     PiiHistogramHandler* pHistogram;
     unsigned int uiPreviousType;
   };
@@ -17,6 +17,7 @@
 
 #include <PiiYdinTypes.h>
 #include <PiiSmartPtr.h>
+#include <PiiTypeTraits.h>
 
 #include <QPainter>
 
@@ -67,7 +68,20 @@ void PiiImageAnnotator::setPen(QPen pen) { _d()->pen = pen; }
 void PiiImageAnnotator::setTextPosition(const QPoint& textPosition) { _d()->textPosition = textPosition; }
 QPoint PiiImageAnnotator::textPosition() const { return _d()->textPosition; }
 
-void PiiImageAnnotator::setAnnotations(const QVariantList& annotations) { _d()->lstAnnotations = annotations; }
+void PiiImageAnnotator::setAnnotations(const QVariantList& annotations)
+{
+  PII_D;
+  d->lstAnnotations = annotations;
+  d->lstAnnotationBatches.clear();
+  for (int i=0; i<annotations.size(); ++i)
+    {
+      QVariantMap map = annotations[i].toMap();
+      // All types must have x
+      if (map.contains("x"))
+        d->lstAnnotationBatches << Data::parseAnnotation(map);
+    }
+}
+
 QVariantList PiiImageAnnotator::annotations() const { return _d()->lstAnnotations; }
 
 void PiiImageAnnotator::setEnabled(bool enabled) { _d()->bEnabled = enabled; }
@@ -90,7 +104,8 @@ void PiiImageAnnotator::process()
 
   PiiVariant obj = d->pImageInput->firstObject();
 
-  if (!d->bEnabled)
+  // Nobody will see the annotations.
+  if (!d->bEnabled || !d->pImageOutput->isConnected())
     d->pImageOutput->emitObject(obj);
   else
     {
@@ -111,14 +126,10 @@ void PiiImageAnnotator::process()
 
 template <class T> void PiiImageAnnotator::Data::annotate(const PiiVariant& obj)
 {
-  if (bAnnotationConnected || lstAnnotations.size() != 0)
+  if (bAnnotationConnected || lstAnnotationBatches.size() != 0)
     {
-      const PiiMatrix<T> matrix = obj.valueAs<PiiMatrix<T> >();
-      // Protect against exceptions
-      PiiSmartPtr<PiiQImage<PiiColor4<unsigned char> > > qmatrix(PiiColorQImage::create(matrix));
-
-      if (lstAnnotations.size() != 0)
-        drawAnnotations(qmatrix, lstAnnotations);
+      // Collect everything that needs to be drawn on this frame.
+      QList<Batch> lstBatches(lstAnnotationBatches);
       if (bAnnotationConnected)
         {
           PiiVariant pAnnotation = pAnnotationInput->firstObject();
@@ -127,58 +138,40 @@ template <class T> void PiiImageAnnotator::Data::annotate(const PiiVariant& obj)
             annotationType;
 
           if (type == Text)
-            drawText(qmatrix, PiiYdin::convertToQString(pAnnotationInput));
+            {
+              Batch batch(Text);
+              batch.pen = pen;
+              batch.matCoordinates = PiiMatrix<double>(1, 2, double(textPosition.x()), double(textPosition.y()));
+              batch.strText = PiiYdin::convertToQString(pAnnotationInput);
+              lstBatches << batch;
+            }
           else
             {
               switch (pAnnotation.type())
                 {
-                  PII_NUMERIC_MATRIX_CASES_M(annotate, (qmatrix, pAnnotation, type));
+                  PII_NUMERIC_MATRIX_CASES_M(addBatch, (lstBatches, pAnnotation, type));
                 default:
                   PII_THROW_UNKNOWN_TYPE(pAnnotationInput);
                   break;
                 }
             }
         }
+
+      const PiiMatrix<T> matrix = obj.valueAs<PiiMatrix<T> >();
+      // Protect against exceptions
+      PiiSmartPtr<PiiQImage<PiiColor4<unsigned char> > > qmatrix(PiiColorQImage::create(matrix));
+      render(qmatrix, lstBatches);
       pImageOutput->emitObject(qmatrix.release()->toMatrix());
     }
   else
     pImageOutput->emitObject(obj);
 }
 
-void PiiImageAnnotator::Data::drawText(QImage* image, const QString& text)
-{
-  QPainter painter(image);
-  painter.setBrush(Qt::NoBrush);
-  painter.setFont(font);
-  painter.setPen(pen);
-  painter.drawText(textPosition.x(), textPosition.y(), text);
-}
-
-
-template <class T> struct DrawingTraits
+template <class T> void PiiImageAnnotator::Data::addBatch(QList<Batch>& batches,
+                                                          const PiiVariant& annotation,
+                                                          AnnotationType type)
 {
-  typedef QPoint Point;
-  typedef QLine Line;
-  typedef QRect Rect;
-};
-
-template <> struct DrawingTraits<float>
-{
-  typedef QPointF Point;
-  typedef QLineF Line;
-  typedef QRectF Rect;
-};
-
-template <> struct DrawingTraits<double> : DrawingTraits<float> {};
-
-template <class T> void PiiImageAnnotator::Data::annotate(QImage* imageBuffer, const PiiVariant& annotation, AnnotationType type)
-{
-  PiiMatrix<T> matrix = annotation.valueAs<PiiMatrix<T> >();
-  QPainter painter(imageBuffer);
-  painter.setPen(pen);
-  painter.setBrush(brush);
-
-  const int iRows = matrix.rows();
+  const PiiMatrix<T> matrix = annotation.valueAs<PiiMatrix<T> >();
   const int iColumns = matrix.columns();
 
   // Determine property type automatically based on the number of
@@ -193,106 +186,323 @@ template <class T> void PiiImageAnnotator::Data::annotate(QImage* imageBuffer, c
         }
     }
 
+  // Ignore mismatching annotations
   switch (type)
     {
+    case Point: if (iColumns != 2) return; break;
+    case Line:
+    case Rectangle:
+    case Ellipse: if (iColumns != 4) return; break;
+    case Circle: if (iColumns != 3) return; break;
+    default: return;
+    }
+
+  Batch batch(type);
+  batch.pen = pen;
+  batch.brush = brush;
+  batch.matCoordinates = PiiMatrix<double>(matrix);
+  batch.bFloat = Pii::IsFloatingPoint<T>::boolValue;
+  batches << batch;
+}
+
+PiiImageAnnotator::Batch PiiImageAnnotator::Data::parseAnnotation(const QVariantMap& annotation)
+{
+  Batch batch(static_cast<AnnotationType>(annotation["annotationType"].toInt()));
+  batch.pen = annotation.contains("pen") ? annotation["pen"].value<QPen>() : QPen(QColor(Qt::red));
+  batch.brush = annotation.contains("brush") ? annotation["brush"].value<QBrush>() : QBrush(Qt::NoBrush);
+  batch.bFloat = annotation["x"].type() == QVariant::Double;
+
+  double dX = annotation["x"].toDouble(), dY = annotation["y"].toDouble();
+  double dWidth = annotation["width"].toDouble(), dHeight = annotation["height"].toDouble();
+  double dRadius = annotation["radius"].toDouble();
+  // Integer annotations are truncated as before.
+  if (!batch.bFloat)
+    {
+      dX = int(dX); dY = int(dY);
+      dWidth = int(dWidth); dHeight = int(dHeight);
+      dRadius = int(dRadius);
+    }
+
+  switch (batch.type)
+    {
+    case Text:
+      batch.matCoordinates = PiiMatrix<double>(1, 2, dX, dY);
+      batch.strText = annotation["text"].toString();
+      break;
     case Point:
-      {
-        if (iColumns != 2)
-          break;
-        for ( int i=iRows; i--; )
-          painter.drawPoint(typename DrawingTraits<T>::Point(matrix(i,0), matrix(i,1)));
-        break;
-      }
+      batch.matCoordinates = PiiMatrix<double>(1, 2, dX, dY);
+      break;
     case Line:
       {
-        if (iColumns != 4)
-          break;
-        for ( int i=iRows; i--; )
-          painter.drawLine(typename DrawingTraits<T>::Line(matrix(i,0), matrix(i,1), matrix(i,2), matrix(i,3)));
-        break;
+        double dX2 = annotation["x2"].toDouble(), dY2 = annotation["y2"].toDouble();
+        if (!batch.bFloat)
+          {
+            dX2 = int(dX2); dY2 = int(dY2);
+          }
+        batch.matCoordinates = PiiMatrix<double>(1, 4, dX, dY, dX2, dY2);
       }
+      break;
     case Rectangle:
-      {
-        if (iColumns != 4)
-          break;
-        for ( int i=iRows; i--; )
-          painter.drawRect(typename DrawingTraits<T>::Rect(matrix(i,0), matrix(i,1), matrix(i,2), matrix(i,3)));
-        break;
-      }
     case Ellipse:
-      {
-        if (iColumns != 4)
-          break;
-        for ( int i=iRows; i--; )
-          painter.drawEllipse(typename DrawingTraits<T>::Rect(matrix(i,0), matrix(i,1), matrix(i,2), matrix(i,3)));
-        break;
-      }
+      batch.matCoordinates = PiiMatrix<double>(1, 4, dX, dY, dWidth, dHeight);
+      break;
     case Circle:
-      {
-        if (iColumns != 3)
-          break;
-        for ( int i=iRows; i--; )
-          painter.drawEllipse(typename DrawingTraits<T>::Rect((matrix(i,0)-matrix(i,2)), (matrix(i,1)-matrix(i,2)), matrix(i,2)*2, matrix(i,2)*2));
-        break;
-      }
-    case Auto:
-    case Text:
+      batch.matCoordinates = PiiMatrix<double>(1, 3, dX, dY, dRadius);
+      break;
     default:
-      // These cases were already handled
       break;
     }
+  return batch;
 }
 
-void PiiImageAnnotator::Data::drawAnnotations(QImage* image, const QVariantList& annotations)
+void PiiImageAnnotator::Data::render(QImage* image, const QList<Batch>& batches)
 {
-  QPainter painter(image);
-  for (int i=0; i<annotations.size(); ++i)
+  // A single painter is shared by all batches that cannot be rendered
+  // directly.
+  QPainter* pPainter = 0;
+  for (int i=0; i<batches.size(); ++i)
     {
-      QVariantMap map = annotations[i].toMap();
-
-      // All types must have x
-      if (!map.contains("x"))
+      if (renderDirectly(image, batches[i]))
         continue;
+      if (pPainter == 0)
+        pPainter = new QPainter(image);
+      paint(pPainter, batches[i]);
+    }
+  delete pPainter;
+}
 
-      if (map.contains("pen"))
-        painter.setPen(map["pen"].value<QPen>());
-      else
-        painter.setPen(Qt::red);
+namespace
+{
+  bool isSolidPen(const QPen& pen)
+  {
+    return pen.style() == Qt::NoPen ||
+      (pen.style() == Qt::SolidLine &&
+       pen.brush().style() == Qt::SolidPattern &&
+       pen.color().alpha() == 255 &&
+       pen.widthF() <= 1);
+  }
+
+  bool isSolidBrush(const QBrush& brush)
+  {
+    return brush.style() == Qt::NoBrush ||
+      (brush.style() == Qt::SolidPattern && brush.color().alpha() == 255);
+  }
+
+  class Rasterizer
+  {
+  public:
+    Rasterizer(QImage* image) :
+      _pBits(image->bits()),
+      _iStride(image->bytesPerLine()),
+      _iWidth(image->width()),
+      _iHeight(image->height())
+    {}
+
+    inline void setPixel(int x, int y, QRgb color)
+    {
+      if (x >= 0 && x < _iWidth && y >= 0 && y < _iHeight)
+        scanLine(y)[x] = color;
+    }
 
-      if (map.contains("brush"))
-        painter.setBrush(map["brush"].value<QBrush>());
-      else
-        painter.setBrush(Qt::NoBrush);
+    // Fills [x1,x2] x [y1,y2], clipped.
+    void fillRect(int x1, int y1, int x2, int y2, QRgb color)
+    {
+      x1 = qMax(x1, 0); y1 = qMax(y1, 0);
+      x2 = qMin(x2, _iWidth-1); y2 = qMin(y2, _iHeight-1);
+      for (int y=y1; y<=y2; ++y)
+        {
+          QRgb* pLine = scanLine(y);
+          for (int x=x1; x<=x2; ++x)
+            pLine[x] = color;
+        }
+    }
+
+    void drawLine(double x1, double y1, double x2, double y2, QRgb color)
+    {
+      if (!clip(x1, y1, x2, y2))
+        return;
+      int iX = qRound(x1), iY = qRound(y1);
+      const int iX2 = qRound(x2), iY2 = qRound(y2);
+      // Bresenham
+      const int iDx = qAbs(iX2 - iX), iDy = -qAbs(iY2 - iY);
+      const int iStepX = iX < iX2 ? 1 : -1, iStepY = iY < iY2 ? 1 : -1;
+      int iError = iDx + iDy;
+      for (;;)
+        {
+          setPixel(iX, iY, color);
+          if (iX == iX2 && iY == iY2)
+            break;
+          const int iError2 = 2 * iError;
+          if (iError2 >= iDy)
+            {
+              iError += iDy;
+              iX += iStepX;
+            }
+          if (iError2 <= iDx)
+            {
+              iError += iDx;
+              iY += iStepY;
+            }
+        }
+    }
+
+  private:
+    inline QRgb* scanLine(int y) { return reinterpret_cast<QRgb*>(_pBits + y * _iStride); }
+
+    // Liang-Barsky clipping against the image extended by one pixel.
+    // Keeps Bresenham from walking far outside of the image.
+    bool clip(double& x1, double& y1, double& x2, double& y2) const
+    {
+      const double dDx = x2 - x1, dDy = y2 - y1;
+      const double aP[] = { -dDx, dDx, -dDy, dDy };
+      const double aQ[] = { x1 + 1, _iWidth - x1, y1 + 1, _iHeight - y1 };
+      double dT1 = 0, dT2 = 1;
+      for (int i=0; i<4; ++i)
+        {
+          if (aP[i] == 0)
+            {
+              if (aQ[i] < 0)
+                return false;
+            }
+          else
+            {
+              const double dT = aQ[i] / aP[i];
+              if (aP[i] < 0)
+                dT1 = qMax(dT1, dT);
+              else
+                dT2 = qMin(dT2, dT);
+            }
+        }
+      if (dT1 > dT2)
+        return false;
+      const double dX = x1, dY = y1;
+      x1 = dX + dT1 * dDx; y1 = dY + dT1 * dDy;
+      x2 = dX + dT2 * dDx; y2 = dY + dT2 * dDy;
+      return true;
+    }
+
+    uchar* _pBits;
+    int _iStride, _iWidth, _iHeight;
+  };
+}
 
-      if (map["x"].type() == QVariant::Double)
-        drawAnnotation<float,double>(&painter, map);
-      else
-        drawAnnotation<int,int>(&painter, map);
+bool PiiImageAnnotator::Data::renderDirectly(QImage* image, const Batch& batch)
+{
+  if (image->depth() != 32 ||
+      (batch.type != Point && batch.type != Line && batch.type != Rectangle) ||
+      !isSolidPen(batch.pen) || !isSolidBrush(batch.brush))
+    return false;
+
+  const bool bPen = batch.pen.style() != Qt::NoPen;
+  const QRgb penColor = batch.pen.color().rgb();
+  const bool bBrush = batch.brush.style() != Qt::NoBrush;
+  const QRgb brushColor = batch.brush.color().rgb();
+  const PiiMatrix<double>& matrix = batch.matCoordinates;
+  Rasterizer rasterizer(image);
+
+  switch (batch.type)
+    {
+    case Point:
+      if (bPen)
+        for (int i=0; i<matrix.rows(); ++i)
+          rasterizer.setPixel(qRound(matrix(i,0)), qRound(matrix(i,1)), penColor);
+      break;
+    case Line:
+      if (bPen)
+        for (int i=0; i<matrix.rows(); ++i)
+          rasterizer.drawLine(matrix(i,0), matrix(i,1), matrix(i,2), matrix(i,3), penColor);
+      break;
+    case Rectangle:
+      for (int i=0; i<matrix.rows(); ++i)
+        {
+          const int iX = qRound(matrix(i,0)), iY = qRound(matrix(i,1));
+          const int iX2 = iX + qRound(matrix(i,2)), iY2 = iY + qRound(matrix(i,3));
+          // The brush fills width x height pixels, and the pen
+          // strokes the outline one pixel larger.
+          if (bBrush)
+            rasterizer.fillRect(iX, iY, iX2 - 1, iY2 - 1, brushColor);
+          if (bPen)
+            {
+              rasterizer.fillRect(iX, iY, iX2, iY, penColor);
+              rasterizer.fillRect(iX, iY2, iX2, iY2, penColor);
+              rasterizer.fillRect(iX, iY, iX, iY2, penColor);
+              rasterizer.fillRect(iX2, iY, iX2, iY2, penColor);
+            }
+        }
+      break;
+    default:
+      break;
     }
+  return true;
 }
 
-template <class T, class U> void PiiImageAnnotator::Data::drawAnnotation(QPainter* painter, const QVariantMap& annotation)
+void PiiImageAnnotator::Data::paint(QPainter* painter, const Batch& batch)
 {
-  AnnotationType type = static_cast<AnnotationType>(annotation["annotationType"].toInt());
+  const PiiMatrix<double>& m = batch.matCoordinates;
+  const int iRows = m.rows();
 
-  T x = annotation["x"].value<U>();
-  T y = annotation["y"].value<U>();
-  T width = annotation["width"].value<U>();
-  T height = annotation["height"].value<U>();
-  T radius = annotation["radius"].value<U>();
-  T x2 = annotation["x2"].value<U>();
-  T y2 = annotation["y2"].value<U>();
-  QString text = annotation["text"].toString();
+  painter->setPen(batch.pen);
+  if (batch.type == Text)
+    {
+      painter->setBrush(Qt::NoBrush);
+      painter->setFont(font);
+      if (iRows > 0)
+        painter->drawText(QPointF(m(0,0), m(0,1)), batch.strText);
+      return;
+    }
+  painter->setBrush(batch.brush);
 
-  switch (type)
+  switch (batch.type)
     {
-    case Text:      painter->drawText(x,y,text); break;
-    case Line:      painter->drawLine(x,y,x2,y2); break;
-    case Point:     painter->drawPoint(x,y); break;
-    case Rectangle: painter->drawRect(x,y,width,height); break;
-    case Ellipse:   painter->drawEllipse(x,y,width,height); break;
-    case Circle:    painter->drawEllipse(x-radius, y-radius,radius*2, radius*2); break;
-    case Auto:
+    case Point:
+      for (int i=iRows; i--; )
+        {
+          if (batch.bFloat)
+            painter->drawPoint(QPointF(m(i,0), m(i,1)));
+          else
+            painter->drawPoint(QPoint(int(m(i,0)), int(m(i,1))));
+        }
+      break;
+    case Line:
+      for (int i=iRows; i--; )
+        {
+          if (batch.bFloat)
+            painter->drawLine(QLineF(m(i,0), m(i,1), m(i,2), m(i,3)));
+          else
+            painter->drawLine(QLine(int(m(i,0)), int(m(i,1)), int(m(i,2)), int(m(i,3))));
+        }
+      break;
+    case Rectangle:
+    case Ellipse:
+      for (int i=iRows; i--; )
+        {
+          QRectF rect(m(i,0), m(i,1), m(i,2), m(i,3));
+          if (batch.type == Rectangle)
+            {
+              if (batch.bFloat)
+                painter->drawRect(rect);
+              else
+                painter->drawRect(rect.toRect());
+            }
+          else
+            {
+              if (batch.bFloat)
+                painter->drawEllipse(rect);
+              else
+                painter->drawEllipse(rect.toRect());
+            }
+        }
+      break;
+    case Circle:
+      for (int i=iRows; i--; )
+        {
+          QRectF rect(m(i,0)-m(i,2), m(i,1)-m(i,2), m(i,2)*2, m(i,2)*2);
+          if (batch.bFloat)
+            painter->drawEllipse(rect);
+          else
+            painter->drawEllipse(rect.toRect());
+        }
+      break;
     default:
       break;
     }
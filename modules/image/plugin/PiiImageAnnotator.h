@@ -49,6 +49,20 @@
  *
  * @out image - the annotated image output
  *
+ * Rendering
+ * ---------
+ *
+ * All annotations of a frame are collected into one list of batches
+ * before drawing. The [annotations] are parsed only when the property
+ * changes, and each matrix received from the `annotation` input
+ * becomes one batch. Points, lines and rectangles drawn with a solid,
+ * opaque pen of at most one pixel and either no brush or a solid,
+ * opaque brush are rasterized directly into the image memory. Other
+ * annotations are drawn with a single QPainter per frame. Direct
+ * rendering rounds floating-point coordinates to the nearest pixel,
+ * and it may differ from QPainter's output at the ends of lines.
+ *
+ * If the `image` output is not connected, nothing is drawn.
  */
 class PiiImageAnnotator : public PiiDefaultOperation
 {
@@ -160,6 +174,20 @@ protected:
   void process();
 
 private:
+  /// @internal
+  struct Batch
+  {
+    Batch(AnnotationType t = Auto) : type(t), bFloat(false) {}
+
+    AnnotationType type;
+    QPen pen;
+    QBrush brush;
+    // One primitive per row. Text is drawn at the first row.
+    PiiMatrix<double> matCoordinates;
+    QString strText;
+    // Coordinates came as floating-point numbers.
+    bool bFloat;
+  };
 
   /// @internal
   class Data : public PiiDefaultOperation::Data
@@ -168,10 +196,11 @@ private:
     Data();
 
     template <class T> void annotate(const PiiVariant& obj);
-    template <class T> void annotate(QImage* image, const PiiVariant& annotation, AnnotationType type);
-    void drawText(QImage* image, const QString& text);
-    void drawAnnotations(QImage*, const QVariantList& annotations);
-    template <class T, class U> void drawAnnotation(QPainter* painter, const QVariantMap& annotation);
+    template <class T> void addBatch(QList<Batch>& batches, const PiiVariant& annotation, AnnotationType type);
+    void render(QImage* image, const QList<Batch>& batches);
+    bool renderDirectly(QImage* image, const Batch& batch);
+    void paint(QPainter* painter, const Batch& batch);
+    static Batch parseAnnotation(const QVariantMap& annotation);
 
     AnnotationType annotationType;
     QFont font;
@@ -179,6 +208,8 @@ private:
     QPen pen;
     QPoint textPosition;
     QVariantList lstAnnotations;
+    // Parsed version of lstAnnotations
+    QList<Batch> lstAnnotationBatches;
 
     PiiInputSocket* pImageInput, *pAnnotationInput, *pTypeInput;
     bool bAnnotationConnected, bTypeConnected;
@@ -16,6 +16,7 @@
 #include "PiiImageFileReader.h"
 #include <PiiYdinTypes.h>
 #include <PiiRandom.h>
+#include <PiiThreadPool.h>
 #include <QDir>
 #include <QFileInfo>
 #include <QtGui>
@@ -28,11 +29,40 @@
 using namespace PiiYdin;
 using namespace Pii;
 
+class PiiImageFileReader::PrefetchTask : public PiiThreadPool::Task
+{
+public:
+  PrefetchTask(Data* data, int fileIndex, const QString& fileName) :
+    d(data), iFileIndex(fileIndex), strFileName(fileName), bDone(false)
+  {}
+
+  void run()
+  {
+    QImage img;
+    QString strResult(loadImage(strFileName, d->bLockFiles, img));
+    QMutexLocker lock(&d->prefetchMutex);
+    image = img;
+    strError = strResult;
+    bDone = true;
+    d->prefetchCondition.wakeAll();
+  }
+
+  Data* d;
+  int iFileIndex;
+  QString strFileName;
+  QImage image;
+  QString strError;
+  bool bDone;
+};
+
 PiiImageFileReader::Data::Data() :
   iRepeatCount(1), bFirst(false), bLockFiles(false),
   bTriggered(false), bNameConnected(false),
   randMode(NoRandomization),
-  bSendKeys(false)
+  bSendKeys(false),
+  iPrefetchDepth(0), iDecoderThreads(0), iScheduledIndex(0),
+  pPrefetchPool(0),
+  imageCache(0)
 {
 }
 
@@ -53,6 +83,15 @@ PiiImageFileReader::PiiImageFileReader(const QString& pattern) :
   d->iStaticOutputCount = outputCount();
 
   setProtectionLevel("metaFields", WriteWhenStoppedOrPaused);
+  setProtectionLevel("prefetchDepth", WriteWhenStoppedOrPaused);
+  setProtectionLevel("decoderThreads", WriteWhenStoppedOrPaused);
+}
+
+PiiImageFileReader::~PiiImageFileReader()
+{
+  PII_D;
+  clearPrefetchQueue();
+  delete d->pPrefetchPool;
 }
 
 void PiiImageFileReader::check(bool reset)
@@ -61,7 +100,9 @@ void PiiImageFileReader::check(bool reset)
   PiiImageReaderOperation::check(reset);
   if (reset)
     {
+      clearPrefetchQueue();
       d->iCurrentIndex = 0;
+      d->iScheduledIndex = 0;
       d->bFirst = true;
     }
 
@@ -81,17 +122,30 @@ void PiiImageFileReader::check(bool reset)
       }
 
   d->bTriggered = d->pTriggerInput->isConnected() || d->bNameConnected;
+
+  if (d->iPrefetchDepth > 0 && !d->bTriggered)
+    {
+      const int iThreads = d->iDecoderThreads > 0 ? d->iDecoderThreads : d->iPrefetchDepth;
+      if (d->pPrefetchPool == 0)
+        d->pPrefetchPool = new PiiThreadPool(iThreads);
+      else
+        d->pPrefetchPool->setThreadCount(iThreads);
+    }
 }
 
 void PiiImageFileReader::process()
 {
   PII_D;
-  if (!d->bNameConnected &&
+  const bool bPrefetch = d->iPrefetchDepth > 0 && !d->bTriggered;
+  // When prefetching, the order is shuffled as the images are
+  // scheduled for loading.
+  if (!d->bNameConnected && !bPrefetch &&
       d->randMode == RandomizeOnEachIteration &&
       d->iCurrentIndex % d->lstFileNames.size() == 0)
     Pii::shuffle(d->vecIndices);
 
   QString fileName;
+  QImage img;
   //We only track the counts if neither trigger input isn't connected
   if (!d->bTriggered)
     {
@@ -99,11 +153,19 @@ void PiiImageFileReader::process()
       if ((d->iMaxImages > 0 && d->iCurrentIndex >= d->iMaxImages) ||
           (d->iRepeatCount > 0 && loopIndex >= d->iRepeatCount))
         operationStopped(); //stop here
-      fileName = d->lstFileNames[d->vecIndices[d->iCurrentIndex % d->lstFileNames.size()]];
+      if (bPrefetch)
+        takePrefetchedImage(fileName, img);
+      else
+        {
+          int iFileIndex = d->vecIndices[d->iCurrentIndex % d->lstFileNames.size()];
+          fileName = d->lstFileNames[iFileIndex];
+          readImage(iFileIndex, fileName, img);
+        }
     }
   else if (d->bNameConnected) // name input is connected -> we don't care about trigger
     {
       fileName = PiiYdin::convertToQString(d->pNameInput);
+      readImage(-1, fileName, img);
     }
   else // only trigger is connected
     {
@@ -120,15 +182,36 @@ void PiiImageFileReader::process()
       d->iCurrentIndex += step;
       while (d->iCurrentIndex < 0)
         d->iCurrentIndex += d->lstFileNames.size();
-      fileName = d->lstFileNames[d->vecIndices[d->iCurrentIndex % d->lstFileNames.size()]];
+      int iFileIndex = d->vecIndices[d->iCurrentIndex % d->lstFileNames.size()];
+      fileName = d->lstFileNames[iFileIndex];
+      readImage(iFileIndex, fileName, img);
     }
 
   //qDebug("PiiImageFileReader: Emitting image %d/%d", d->iCurrentIndex+1, d->lstFileNames.size());
 
-  QImage img;
+  if (d->bSendKeys)
+    sendKeys(img);
+
+  if (d->imageType == GrayScale)
+    emitGrayImage(img);
+  else if (d->imageType == Color)
+    emitColorImage(img);
+  else
+    emitImage(img);
+
+  d->pNameOutput->emitObject(fileName);
+
+  // Auto-advance if no trigger
+  if (!d->bTriggered)
+    d->iCurrentIndex++;
+}
+
+QString PiiImageFileReader::loadImage(const QString& fileName, bool lockFiles, QImage& img)
+{
 #ifdef Q_OS_WIN // no locking on windows
+  Q_UNUSED(lockFiles);
   if (!img.load(fileName))
-    PII_THROW(PiiExecutionException, tr("Cannot read image \"%1\".").arg(fileName));
+    return tr("Cannot read image \"%1\".").arg(fileName);
 #else
   // Must manually open the file to obtain its handle
   // See PiiImageFileReader.h for a detailed description.
@@ -136,36 +219,111 @@ void PiiImageFileReader::process()
   if (!f.open(QIODevice::ReadOnly))
     {
       f.close();
-      PII_THROW(PiiExecutionException, tr("Cannot open %1.").arg(fileName));
+      return tr("Cannot open %1.").arg(fileName);
     }
-  if (d->bLockFiles && flock(f.handle(), LOCK_SH) == -1)
+  if (lockFiles && flock(f.handle(), LOCK_SH) == -1)
     {
       f.close();
-      PII_THROW(PiiExecutionException, tr("Cannot lock %1.").arg(fileName));
+      return tr("Cannot lock %1.").arg(fileName);
     }
   if (!img.load(&f, qPrintable(QFileInfo(fileName).suffix())))
     {
       f.close();
-      PII_THROW(PiiExecutionException, tr("Cannot decode %1.").arg(fileName));
+      return tr("Cannot decode %1.").arg(fileName);
     }
   f.close();
 #endif
+  return QString();
+}
 
-  if (d->bSendKeys)
-    sendKeys(img);
+void PiiImageFileReader::readImage(int fileIndex, const QString& fileName, QImage& img)
+{
+  PII_D;
+  if (fileIndex >= 0)
+    {
+      QImage* pCached = d->imageCache.object(fileIndex);
+      if (pCached != 0)
+        {
+          img = *pCached;
+          return;
+        }
+    }
+  QString strError(loadImage(fileName, d->bLockFiles, img));
+  if (!strError.isEmpty())
+    PII_THROW(PiiExecutionException, strError);
+  if (fileIndex >= 0)
+    cacheImage(fileIndex, img);
+}
 
-  if (d->imageType == GrayScale)
-    emitGrayImage(img);
-  else if (d->imageType == Color)
-    emitColorImage(img);
-  else
-    emitImage(img);
+void PiiImageFileReader::cacheImage(int fileIndex, const QImage& img)
+{
+  PII_D;
+  // There is no point in caching images that will never be reused.
+  if (d->imageCache.maxCost() > 0 && d->iRepeatCount != 1)
+    d->imageCache.insert(fileIndex, new QImage(img), qMax(img.byteCount(), 1));
+}
 
-  d->pNameOutput->emitObject(fileName);
+void PiiImageFileReader::prefetchImages()
+{
+  PII_D;
+  const int iFileCount = d->lstFileNames.size(), iTotalCount = totalImageCount();
+  while (d->queTasks.size() < d->iPrefetchDepth &&
+         (iTotalCount < 0 || d->iScheduledIndex < iTotalCount))
+    {
+      if (d->randMode == RandomizeOnEachIteration && d->iScheduledIndex % iFileCount == 0)
+        Pii::shuffle(d->vecIndices);
+      const int iFileIndex = d->vecIndices[d->iScheduledIndex % iFileCount];
+      ++d->iScheduledIndex;
+
+      PrefetchTask* pTask = new PrefetchTask(d, iFileIndex, d->lstFileNames[iFileIndex]);
+      d->queTasks.enqueue(pTask);
+      QImage* pCached = d->imageCache.object(iFileIndex);
+      if (pCached != 0)
+        {
+          pTask->image = *pCached;
+          pTask->bDone = true;
+        }
+      else
+        d->pPrefetchPool->submit(pTask);
+    }
+}
 
-  // Auto-advance if no trigger
-  if (!d->bTriggered)
-    d->iCurrentIndex++;
+void PiiImageFileReader::takePrefetchedImage(QString& fileName, QImage& img)
+{
+  PII_D;
+  // Keep the pipeline full before blocking on the oldest image.
+  prefetchImages();
+  PrefetchTask* pTask = d->queTasks.dequeue();
+  d->prefetchMutex.lock();
+  while (!pTask->bDone)
+    d->prefetchCondition.wait(&d->prefetchMutex);
+  d->prefetchMutex.unlock();
+
+  fileName = pTask->strFileName;
+  img = pTask->image;
+  QString strError(pTask->strError);
+  int iFileIndex = pTask->iFileIndex;
+  delete pTask;
+
+  if (!strError.isEmpty())
+    PII_THROW(PiiExecutionException, strError);
+  cacheImage(iFileIndex, img);
+}
+
+void PiiImageFileReader::clearPrefetchQueue()
+{
+  PII_D;
+  // Tasks refer to the queue's data; wait until all of them are done
+  // before deleting.
+  QMutexLocker lock(&d->prefetchMutex);
+  while (!d->queTasks.isEmpty())
+    {
+      PrefetchTask* pTask = d->queTasks.dequeue();
+      while (!pTask->bDone)
+        d->prefetchCondition.wait(&d->prefetchMutex);
+      delete pTask;
+    }
+  d->iScheduledIndex = d->iCurrentIndex;
 }
 
 void PiiImageFileReader::sendKeys(const QImage& img)
@@ -235,8 +393,11 @@ void PiiImageFileReader::setFileNamePattern(const QString& pattern)
   foreach (QString name, names)
     d->lstFileNames << directory.path() + "/" + name;
   d->strPattern = pattern;
+  clearPrefetchQueue();
+  d->imageCache.clear();
   createIndices();
   d->iCurrentIndex = 0;
+  d->iScheduledIndex = 0;
 }
 
 int PiiImageFileReader::totalImageCount() const
@@ -266,8 +427,11 @@ void PiiImageFileReader::setFileNames(const QStringList& fileNames)
   PII_D;
   d->lstFileNames = fileNames;
   d->strPattern = "";
+  clearPrefetchQueue();
+  d->imageCache.clear();
   createIndices();
   d->iCurrentIndex = 0;
+  d->iScheduledIndex = 0;
 }
 
 QString PiiImageFileReader::fileNamePattern() const { return _d()->strPattern; }
@@ -278,6 +442,7 @@ bool PiiImageFileReader::lockFiles() const { return _d()->bLockFiles; }
 void PiiImageFileReader::setRandomizationMode(RandomizationMode mode)
 {
   _d()->randMode = mode;
+  clearPrefetchQueue();
   createIndices();
 }
 PiiImageFileReader::RandomizationMode PiiImageFileReader::randomizationMode() const { return _d()->randMode; }
@@ -338,3 +503,15 @@ QVariantList PiiImageFileReader::metaFields() const
     }
   return lstResult;
 }
+
+void PiiImageFileReader::setPrefetchDepth(int prefetchDepth)
+{
+  PII_D;
+  clearPrefetchQueue();
+  d->iPrefetchDepth = qMax(0, prefetchDepth);
+}
+int PiiImageFileReader::prefetchDepth() const { return _d()->iPrefetchDepth; }
+void PiiImageFileReader::setDecoderThreads(int decoderThreads) { _d()->iDecoderThreads = qMax(0, decoderThreads); }
+int PiiImageFileReader::decoderThreads() const { return _d()->iDecoderThreads; }
+void PiiImageFileReader::setCacheSize(int cacheSize) { _d()->imageCache.setMaxCost(qBound(0, cacheSize, 2047) << 20); }
+int PiiImageFileReader::cacheSize() const { return _d()->imageCache.maxCost() >> 20; }
@@ -20,8 +20,14 @@
 #include <PiiColor.h>
 #include <QStringList>
 #include <QVector>
+#include <QQueue>
+#include <QCache>
+#include <QMutex>
+#include <QWaitCondition>
 #include "PiiImageReaderOperation.h"
 
+class PiiThreadPool;
+
 /**
  * Reads images from files.
  *
@@ -57,6 +63,22 @@
  * [metaFields]. If there is no such meta field, uses the default
  * value.
  *
+ * Prefetching
+ * -----------
+ *
+ * By default, each file is read and decoded in [process()], which
+ * makes the reader latency-bound if the files are stored on a slow
+ * or remote file system. If [prefetchDepth] is set to a positive
+ * value, the reader loads and decodes up to that many files ahead in
+ * a private pool of [decoderThreads] threads. The images are still
+ * emitted in the order determined by [fileNames] and
+ * [randomizationMode]. Prefetching only works when file names are
+ * not dictated by the `trigger` or `filename` inputs.
+ *
+ * If [repeatCount] is not one, decoded images can be kept in memory
+ * so that subsequent rounds don't need to read the files again. The
+ * size of the cache is controlled by [cacheSize].
+ *
  */
 class PII_IMAGE_EXPORT PiiImageFileReader : public PiiImageReaderOperation
 {
@@ -133,6 +155,29 @@ class PII_IMAGE_EXPORT PiiImageFileReader : public PiiImageReaderOperation
    */
   Q_PROPERTY(QVariantList metaFields READ metaFields WRITE setMetaFields);
 
+  /**
+   * The maximum number of images loaded in advance. Zero disables
+   * prefetching. The default is zero.
+   */
+  Q_PROPERTY(int prefetchDepth READ prefetchDepth WRITE setPrefetchDepth);
+
+  /**
+   * The number of threads used for loading and decoding prefetched
+   * images. Since reading is often limited by I/O latency rather than
+   * CPU, the number may well exceed the number of processor cores.
+   * Zero means one thread per prefetched image ([prefetchDepth]). The
+   * default is zero.
+   */
+  Q_PROPERTY(int decoderThreads READ decoderThreads WRITE setDecoderThreads);
+
+  /**
+   * The maximum amount of decoded image data, in megabytes, kept in
+   * memory for reuse when [repeatCount] is not one. Zero disables
+   * caching. If all images fit into the cache, files are read only
+   * once. The default is zero.
+   */
+  Q_PROPERTY(int cacheSize READ cacheSize WRITE setCacheSize);
+
   PII_OPERATION_SERIALIZATION_FUNCTION
 public:
   /**
@@ -154,6 +199,7 @@ public:
    * given file name wildcard pattern (glob).
    */
   PiiImageFileReader(const QString& pattern = "");
+  ~PiiImageFileReader();
 
   /**
    * Read an image from the file denoted by `fileName`. The image is
@@ -197,9 +243,26 @@ protected:
   void setMetaFields(const QVariantList& metaFields);
   QVariantList metaFields() const;
 
+  void setPrefetchDepth(int prefetchDepth);
+  int prefetchDepth() const;
+
+  void setDecoderThreads(int decoderThreads);
+  int decoderThreads() const;
+
+  void setCacheSize(int cacheSize);
+  int cacheSize() const;
+
 private:
+  class PrefetchTask;
+
   void createIndices();
   void sendKeys(const QImage& img);
+  static QString loadImage(const QString& fileName, bool lockFiles, QImage& image);
+  void readImage(int fileIndex, const QString& fileName, QImage& image);
+  void prefetchImages();
+  void takePrefetchedImage(QString& fileName, QImage& image);
+  void clearPrefetchQueue();
+  void cacheImage(int fileIndex, const QImage& image);
 
   /// @internal
   class Data : public PiiImageReaderOperation::Data
@@ -220,6 +283,13 @@ private:
     PiiOutputSocket *pNameOutput, *pKeyOutput, *pValueOutput;
     QList<QPair<QString,PiiVariant> > lstMetaFields;
     bool bSendKeys;
+
+    int iPrefetchDepth, iDecoderThreads, iScheduledIndex;
+    PiiThreadPool* pPrefetchPool;
+    QQueue<PrefetchTask*> queTasks;
+    QMutex prefetchMutex;
+    QWaitCondition prefetchCondition;
+    QCache<int,QImage> imageCache;
   };
   PII_D_FUNC;
 };
@@ -17,8 +17,19 @@
 #include <PiiYdinTypes.h>
 #include <PiiColor.h>
 #include "PiiImage.h"
+#include <PiiAsyncCall.h>
+#include <PiiTimer.h>
 #include <QFileInfo>
 #include <QDir>
+#include <QFile>
+#include <QThread>
+
+#ifdef Q_OS_WIN
+#  include <io.h>
+#else
+#  include <sys/file.h>
+#  include <unistd.h>
+#endif
 
 PiiImageFileWriter::Data::Data() :
   strNamePrefix("img"),
@@ -36,7 +47,16 @@ PiiImageFileWriter::Data::Data() :
   nameObject(0),
   bStoreAlpha(false),
   bChangeExtension(false),
-  bOverwrite(true)
+  bOverwrite(true),
+  iQueueLength(0),
+  iEncoderThreads(1),
+  fullQueueBehavior(BlockWhenFull),
+  iSyncInterval(0),
+  iDiskQuota(0),
+  bEncodersRunning(false),
+  iBytesWritten(0),
+  dEncodeLatency(0),
+  iDroppedImageCount(0)
 {
 }
 
@@ -67,6 +87,17 @@ PiiImageFileWriter::PiiImageFileWriter() :
 
   d->iStaticInputCount = inputCount();
   setProtectionLevel("metaFields", WriteWhenStoppedOrPaused);
+  setProtectionLevel("queueLength", WriteWhenStopped);
+  setProtectionLevel("encoderThreads", WriteWhenStopped);
+
+  connect(this, SIGNAL(stateChanged(PiiOperation::State)),
+          SLOT(flushQueue(PiiOperation::State)),
+          Qt::DirectConnection);
+}
+
+PiiImageFileWriter::~PiiImageFileWriter()
+{
+  stopEncoders();
 }
 
 void PiiImageFileWriter::check(bool reset)
@@ -77,6 +108,9 @@ void PiiImageFileWriter::check(bool reset)
     {
       d->iNextIndex = 0;
       clearKeyValues();
+      d->iBytesWritten = 0;
+      d->iDroppedImageCount = 0;
+      d->dEncodeLatency = 0;
     }
 
   if (d->pKeyInput->isConnected() != d->pValueInput->isConnected())
@@ -191,47 +225,53 @@ void PiiImageFileWriter::processImage()
         }
     }
 
+  // Check the type here because background threads cannot throw.
   switch (d->imageObject.type())
     {
-      PII_GRAY_IMAGE_CASES_M(writeGrayImage, (d->imageObject, strFileName));
+    case UnsignedCharMatrixType:
+    case IntMatrixType:
+    case FloatMatrixType:
     case UnsignedCharColorMatrixType:
-      writeColorImage<PiiColor<unsigned char> >(d->imageObject, strFileName);
-      break;
     case UnsignedCharColor4MatrixType:
-      writeColorImage<PiiColor4<unsigned char> >(d->imageObject, strFileName);
       break;
     default:
       PII_THROW_UNKNOWN_TYPE(d->pImageInput);
     }
 
+  WriteJob job(createJob(strFileName, d->bLockFiles));
+  job.image = d->imageObject;
+
   d->iNextIndex++;
   d->imageObject = PiiVariant();
   d->nameObject = PiiVariant();
-}
 
-template <class T> void PiiImageFileWriter::writeGrayImage(const PiiVariant& obj, const QString& fileName)
-{
-  writeImage(Pii::createQImage(PiiImage::to8Bit(obj.valueAs<PiiMatrix<T> >())), fileName, _d()->bLockFiles);
-}
+  d->queueMutex.lock();
+  const bool bQuotaExceeded = d->iDiskQuota > 0 && d->iBytesWritten >= qint64(d->iDiskQuota) << 20;
+  if (bQuotaExceeded)
+    ++d->iDroppedImageCount;
+  d->queueMutex.unlock();
 
-template <class T> void PiiImageFileWriter::writeColorImage(const PiiVariant& obj, const QString& fileName)
-{
-  PII_D;
-  QImage* pImage = Pii::createQImage(obj.valueAs<PiiMatrix<T> >());
-  // If the input image has four channels and storing alpha channel is
-  // enabled, change image format.
-  if (sizeof(T) == 4 && d->bStoreAlpha)
-    Pii::setQImageFormat(pImage, QImage::Format_ARGB32);
-  writeImage(pImage, fileName, d->bLockFiles);
+  if (!bQuotaExceeded)
+    {
+      if (d->iQueueLength > 0)
+        enqueue(job);
+      else
+        encode(job);
+    }
+
+  d->pNameOutput->emitObject(strFileName);
 }
 
-void PiiImageFileWriter::writeKeyValues(QImage* image)
+PiiImageFileWriter::WriteJob PiiImageFileWriter::createJob(const QString& fileName, bool lock) const
 {
-  PII_D;
-  image->setDotsPerMeterX(static_cast<int>(1000.0 / d->pixelSize.width()));
-  image->setDotsPerMeterY(static_cast<int>(1000.0 / d->pixelSize.height()));
-  for (int i=0; i<d->lstKeys.size(); i++)
-    image->setText(d->lstKeys[i], d->lstValues[i]);
+  const PII_D;
+  WriteJob job;
+  job.strFileName = fileName;
+  job.strFormat = QFileInfo(fileName).suffix();
+  if (job.strFormat.isEmpty())
+    job.strFormat = d->strExtension;
+  job.lstKeys = d->lstKeys;
+  job.lstValues = d->lstValues;
   // If the operation was paused while processing many key/value pairs
   // and the number of meta fields was changed, lstStaticMeta may be
   // empty.
@@ -241,77 +281,237 @@ void PiiImageFileWriter::writeKeyValues(QImage* image)
       QString strValue = PiiYdin::convertToQString(d->lstStaticMeta[i]);
       if (strValue.isNull())
         PII_THROW_UNKNOWN_TYPE(inputAt(d->iStaticInputCount + i));
-      image->setText(d->lstMetaFields[i], strValue);
+      job.lstKeys << d->lstMetaFields[i];
+      job.lstValues << strValue;
     }
+  job.pixelSize = d->pixelSize;
+  job.iCompression = d->iCompression;
+  job.bLock = lock;
+  job.bOverwrite = d->bOverwrite;
+  job.bStoreAlpha = d->bStoreAlpha;
+  return job;
+}
+
+void PiiImageFileWriter::enqueue(const WriteJob& job)
+{
+  PII_D;
+  QMutexLocker lock(&d->queueMutex);
+  if (!d->bEncodersRunning)
+    startEncoders();
+
+  if (d->fullQueueBehavior == BlockWhenFull)
+    {
+      while (d->queJobs.size() >= d->iQueueLength)
+        d->spaceAvailable.wait(&d->queueMutex);
+    }
+  else if (d->queJobs.size() >= d->iQueueLength)
+    {
+      d->queJobs.dequeue();
+      ++d->iDroppedImageCount;
+    }
+
+  d->queJobs.enqueue(job);
+  d->jobAvailable.wakeOne();
+}
+
+void PiiImageFileWriter::startEncoders()
+{
+  PII_D;
+  d->bEncodersRunning = true;
+  for (int i=0; i<qMax(d->iEncoderThreads, 1); ++i)
+    {
+      QThread* pThread = Pii::createAsyncCall(this, &PiiImageFileWriter::encodeImages);
+      d->lstEncoders << pThread;
+      pThread->start();
+    }
+}
+
+void PiiImageFileWriter::stopEncoders()
+{
+  PII_D;
+  d->queueMutex.lock();
+  d->bEncodersRunning = false;
+  d->jobAvailable.wakeAll();
+  d->queueMutex.unlock();
+
+  // Images still in the queue will be written before the threads exit.
+  for (int i=0; i<d->lstEncoders.size(); ++i)
+    {
+      d->lstEncoders[i]->wait();
+      delete d->lstEncoders[i];
+    }
+  d->lstEncoders.clear();
+
+  d->syncMutex.lock();
+  QStringList lstFiles(d->lstUnsyncedFiles);
+  d->lstUnsyncedFiles.clear();
+  d->syncMutex.unlock();
+  syncFiles(lstFiles);
+}
+
+void PiiImageFileWriter::flushQueue(PiiOperation::State state)
+{
+  if (state == PiiOperation::Stopped)
+    stopEncoders();
+}
+
+void PiiImageFileWriter::encodeImages()
+{
+  PII_D;
+  forever
+    {
+      WriteJob job;
+      {
+        QMutexLocker lock(&d->queueMutex);
+        while (d->bEncodersRunning && d->queJobs.isEmpty())
+          d->jobAvailable.wait(&d->queueMutex);
+        if (d->queJobs.isEmpty())
+          return;
+        job = d->queJobs.dequeue();
+        d->spaceAvailable.wakeOne();
+      }
+      encode(job);
+    }
+}
+
+void PiiImageFileWriter::encode(const WriteJob& job)
+{
+  PII_D;
+  using namespace PiiYdin;
+  PiiTimer timer;
+  qint64 iBytes = -1;
+  switch (job.image.type())
+    {
+      PII_GRAY_IMAGE_CASES_M(iBytes = writeGrayImage, (job));
+    case UnsignedCharColorMatrixType:
+      iBytes = writeColorImage<PiiColor<unsigned char> >(job);
+      break;
+    case UnsignedCharColor4MatrixType:
+      iBytes = writeColorImage<PiiColor4<unsigned char> >(job);
+      break;
+    }
+  const double dLatency = timer.microseconds() / 1000.0;
+
+  if (iBytes >= 0 && d->iSyncInterval > 0)
+    {
+      QStringList lstFiles;
+      d->syncMutex.lock();
+      d->lstUnsyncedFiles << job.strFileName;
+      if (d->lstUnsyncedFiles.size() >= d->iSyncInterval)
+        qSwap(lstFiles, d->lstUnsyncedFiles);
+      d->syncMutex.unlock();
+      syncFiles(lstFiles);
+    }
+
+  QMutexLocker lock(&d->queueMutex);
+  if (iBytes > 0)
+    d->iBytesWritten += iBytes;
+  // Exponential moving average with a time constant of ~100 images.
+  d->dEncodeLatency = d->dEncodeLatency == 0 ? dLatency :
+    0.99 * d->dEncodeLatency + 0.01 * dLatency;
+}
+
+void PiiImageFileWriter::syncFiles(const QStringList& files)
+{
+  // Reopening a file and syncing its descriptor flushes all data
+  // written through any descriptor.
+  for (int i=0; i<files.size(); ++i)
+    {
+      QFile f(files[i]);
+      if (!f.open(QIODevice::ReadWrite))
+        continue;
+#ifdef Q_OS_WIN
+      _commit(f.handle());
+#else
+      fsync(f.handle());
+#endif
+    }
+}
+
+template <class T> qint64 PiiImageFileWriter::writeGrayImage(const WriteJob& job)
+{
+  return writeImage(Pii::createQImage(PiiImage::to8Bit(job.image.valueAs<PiiMatrix<T> >())), job);
+}
+
+template <class T> qint64 PiiImageFileWriter::writeColorImage(const WriteJob& job)
+{
+  QImage* pImage = Pii::createQImage(job.image.valueAs<PiiMatrix<T> >());
+  // If the input image has four channels and storing alpha channel is
+  // enabled, change image format.
+  if (sizeof(T) == 4 && job.bStoreAlpha)
+    Pii::setQImageFormat(pImage, QImage::Format_ARGB32);
+  return writeImage(pImage, job);
+}
+
+void PiiImageFileWriter::writeKeyValues(QImage* image, const WriteJob& job)
+{
+  image->setDotsPerMeterX(static_cast<int>(1000.0 / job.pixelSize.width()));
+  image->setDotsPerMeterY(static_cast<int>(1000.0 / job.pixelSize.height()));
+  for (int i=0; i<job.lstKeys.size(); i++)
+    image->setText(job.lstKeys[i], job.lstValues[i]);
 }
 
 // There is no advisory file locking on Windows
 #ifdef Q_OS_WIN
-bool PiiImageFileWriter::writeImage(QImage* image, const QString& fileName, bool /*lock*/)
+qint64 PiiImageFileWriter::writeImage(QImage* image, const WriteJob& job)
 {
-  PII_D;
   // Delete image on return
   PiiSmartPtr<QImage> pImage(image);
 
-  writeKeyValues(image);
-  QString format = QFileInfo(fileName).suffix();
-  if (format.isEmpty()) format = _d()->strExtension;
-  if (d->bOverwrite || !QFileInfo(fileName).exists())
-    return image->save(fileName, qPrintable(format), d->iCompression);
+  writeKeyValues(image, job);
+  if (job.bOverwrite || !QFileInfo(job.strFileName).exists())
+    {
+      if (image->save(job.strFileName, qPrintable(job.strFormat), job.iCompression))
+        return QFileInfo(job.strFileName).size();
+    }
   else
-    piiWarning(tr("Will not overwrite %1.").arg(fileName));
-  return false;
+    piiWarning(tr("Will not overwrite %1.").arg(job.strFileName));
+  return -1;
 }
 // On Unix, we can selectively protect against concurrent usage
 #else
-#include <sys/file.h>
-#include <QFile>
-
-bool PiiImageFileWriter::writeImage(QImage* image, const QString& fileName, bool lock)
+qint64 PiiImageFileWriter::writeImage(QImage* image, const WriteJob& job)
 {
-  PII_D;
   // Delete image on return
   PiiSmartPtr<QImage> pImage(image);
-  writeKeyValues(image);
-
-  QString format = QFileInfo(fileName).suffix();
-  if (format.isEmpty()) format = d->strExtension;
+  writeKeyValues(image, job);
 
   // Must manually open the file to obtain its handle
-  QFile f(fileName);
-  if (!d->bOverwrite && f.exists())
+  QFile f(job.strFileName);
+  if (!job.bOverwrite && f.exists())
     {
-      piiWarning(tr("Will not overwrite %1.").arg(fileName));
-      return false;
+      piiWarning(tr("Will not overwrite %1.").arg(job.strFileName));
+      return -1;
     }
   // Append here ensures we don't truncate the file until we get the
   // lock.
   if (!f.open(QIODevice::WriteOnly | QIODevice::Append))
-    return false;
+    return -1;
   // If locking is requested and we can't do it, fail. This probably
   // happens only with network file systems such as Samba and NFS.
-  if (lock && flock(f.handle(), LOCK_EX) == -1)
+  if (job.bLock && flock(f.handle(), LOCK_EX) == -1)
     {
       f.close();
-      return false;
+      return -1;
     }
   // Now we have the lock -> truncate the file
   if (!f.resize(0))
     {
       // Should not happen, but we never know...
       f.close();
-      return false;
+      return -1;
     }
   // Save to the locked file
-  bool result = image->save(&f, qPrintable(format), d->iCompression);
+  bool result = image->save(&f, qPrintable(job.strFormat), job.iCompression);
+  f.flush();
+  qint64 iSize = f.size();
 
   // Close the file (this also unlocks it)
   f.close();
-  return result;
+  return result ? iSize : -1;
 }
 #endif
 
-
 QString PiiImageFileWriter::outputDirectory() const { return _d()->strOutputDirectory; }
 void PiiImageFileWriter::setOutputDirectory(const QString& dirName) { _d()->strOutputDirectory = dirName; }
 QString PiiImageFileWriter::namePrefix() const { return _d()->strNamePrefix; }
@@ -348,3 +548,35 @@ void PiiImageFileWriter::setChangeExtension(bool changeExtension) { _d()->bChang
 bool PiiImageFileWriter::changeExtension() const { return _d()->bChangeExtension; }
 void PiiImageFileWriter::setOverwrite(bool overwrite) { _d()->bOverwrite = overwrite; }
 bool PiiImageFileWriter::overwrite() const { return _d()->bOverwrite; }
+
+void PiiImageFileWriter::setQueueLength(int queueLength) { _d()->iQueueLength = qMax(queueLength, 0); }
+int PiiImageFileWriter::queueLength() const { return _d()->iQueueLength; }
+void PiiImageFileWriter::setEncoderThreads(int encoderThreads) { _d()->iEncoderThreads = qMax(encoderThreads, 1); }
+int PiiImageFileWriter::encoderThreads() const { return _d()->iEncoderThreads; }
+void PiiImageFileWriter::setFullQueueBehavior(FullQueueBehavior fullQueueBehavior) { _d()->fullQueueBehavior = fullQueueBehavior; }
+PiiImageFileWriter::FullQueueBehavior PiiImageFileWriter::fullQueueBehavior() const { return _d()->fullQueueBehavior; }
+void PiiImageFileWriter::setSyncInterval(int syncInterval) { _d()->iSyncInterval = qMax(syncInterval, 0); }
+int PiiImageFileWriter::syncInterval() const { return _d()->iSyncInterval; }
+void PiiImageFileWriter::setDiskQuota(int diskQuota) { _d()->iDiskQuota = qMax(diskQuota, 0); }
+int PiiImageFileWriter::diskQuota() const { return _d()->iDiskQuota; }
+
+int PiiImageFileWriter::queuedImageCount() const
+{
+  const PII_D;
+  QMutexLocker lock(&d->queueMutex);
+  return d->queJobs.size();
+}
+
+double PiiImageFileWriter::encodeLatency() const
+{
+  const PII_D;
+  QMutexLocker lock(&d->queueMutex);
+  return d->dEncodeLatency;
+}
+
+int PiiImageFileWriter::droppedImageCount() const
+{
+  const PII_D;
+  QMutexLocker lock(&d->queueMutex);
+  return d->iDroppedImageCount;
+}
@@ -19,6 +19,9 @@
 #include <PiiDefaultOperation.h>
 #include <PiiQImage.h>
 #include <QFileInfo>
+#include <QQueue>
+#include <QMutex>
+#include <QWaitCondition>
 #include "PiiImageGlobal.h"
 
 /**
@@ -67,6 +70,19 @@
  * The path is relative unless the `filename` input or the
  * [outputDirectory] property contains an absolute path.
  *
+ * Background writing
+ * ------------------
+ *
+ * By default, images are encoded and written in [process()], which
+ * stalls the pipeline whenever encoding or the disk is slow. If
+ * [queueLength] is set to a positive value, images are instead placed
+ * into a queue that is emptied by [encoderThreads] background
+ * threads. The name of the file is determined and emitted immediately,
+ * but the file may appear later. When the queue is full, the
+ * operation either waits or discards the oldest queued image,
+ * depending on [fullQueueBehavior]. All queued images will be written
+ * before the operation stops.
+ *
  */
 class PII_IMAGE_EXPORT PiiImageFileWriter : public PiiDefaultOperation
 {
@@ -220,9 +236,78 @@ class PII_IMAGE_EXPORT PiiImageFileWriter : public PiiDefaultOperation
    */
   Q_PROPERTY(bool storeAlpha READ storeAlpha WRITE setStoreAlpha);
 
+  /**
+   * The maximum number of images waiting to be written by background
+   * threads. Zero means that images are written synchronously in
+   * [process()]. The default is zero.
+   */
+  Q_PROPERTY(int queueLength READ queueLength WRITE setQueueLength);
+
+  /**
+   * The number of background threads that encode and write images if
+   * [queueLength] is positive. Since the threads work in parallel,
+   * the order in which files appear on disk may differ from the order
+   * of input images. The default is one.
+   */
+  Q_PROPERTY(int encoderThreads READ encoderThreads WRITE setEncoderThreads);
+
+  /**
+   * The action to take when an image arrives and the queue is full.
+   * The default is `BlockWhenFull`.
+   */
+  Q_PROPERTY(FullQueueBehavior fullQueueBehavior READ fullQueueBehavior WRITE setFullQueueBehavior);
+  Q_ENUMS(FullQueueBehavior);
+
+  /**
+   * The number of files after which the written data will be flushed
+   * to the storage device with fsync(). Flushing in batches amortizes
+   * the cost of synchronization over many files. Zero disables
+   * explicit flushing and leaves it to the operating system. The
+   * default is zero.
+   */
+  Q_PROPERTY(int syncInterval READ syncInterval WRITE setSyncInterval);
+
+  /**
+   * The maximum number of megabytes the operation will write after it
+   * has been started. Once the quota has been used, incoming images
+   * will be discarded. Zero means no limit. The default is zero.
+   */
+  Q_PROPERTY(int diskQuota READ diskQuota WRITE setDiskQuota);
+
+  /**
+   * The number of images currently waiting to be written.
+   */
+  Q_PROPERTY(int queuedImageCount READ queuedImageCount);
+
+  /**
+   * The average time it takes to encode and write an image, in
+   * milliseconds. The value is an exponentially weighted moving
+   * average that mostly reflects the latest few hundred images.
+   */
+  Q_PROPERTY(double encodeLatency READ encodeLatency);
+
+  /**
+   * The number of images discarded since the operation was last
+   * started, due to either a full queue or an exceeded
+   * [diskQuota].
+   */
+  Q_PROPERTY(int droppedImageCount READ droppedImageCount);
+
   PII_OPERATION_SERIALIZATION_FUNCTION
 public:
+  /**
+   * Actions to take with a full queue.
+   *
+   * - `BlockWhenFull` - wait until a background thread has taken an
+   * image out of the queue. No images will be lost.
+   *
+   * - `DropOldest` - discard the oldest image in the queue. The
+   * processing thread will never be blocked.
+   */
+  enum FullQueueBehavior { BlockWhenFull, DropOldest };
+
   PiiImageFileWriter();
+  ~PiiImageFileWriter();
 
   /**
    * Write a matrix as an image to a file.
@@ -290,13 +375,55 @@ protected:
   void setOverwrite(bool overwrite);
   bool overwrite() const;
 
+  void setQueueLength(int queueLength);
+  int queueLength() const;
+
+  void setEncoderThreads(int encoderThreads);
+  int encoderThreads() const;
+
+  void setFullQueueBehavior(FullQueueBehavior fullQueueBehavior);
+  FullQueueBehavior fullQueueBehavior() const;
+
+  void setSyncInterval(int syncInterval);
+  int syncInterval() const;
+
+  void setDiskQuota(int diskQuota);
+  int diskQuota() const;
+
+  int queuedImageCount() const;
+  double encodeLatency() const;
+  int droppedImageCount() const;
+
+private slots:
+  void flushQueue(PiiOperation::State state);
+
 private:
+  // A snapshot of everything needed for writing an image. Background
+  // threads must not touch the operation's state, which may change
+  // while the image is waiting in the queue.
+  struct WriteJob
+  {
+    PiiVariant image;
+    QString strFileName, strFormat;
+    QStringList lstKeys, lstValues;
+    QSizeF pixelSize;
+    int iCompression;
+    bool bLock, bOverwrite, bStoreAlpha;
+  };
+
+  WriteJob createJob(const QString& fileName, bool lock) const;
   void clearKeyValues();
   void processImage();
-  void writeKeyValues(QImage* image);
-  bool writeImage(QImage* image, const QString& fileName, bool lock);
-  template <class T> void writeGrayImage(const PiiVariant& obj, const QString& fileName);
-  template <class T> void writeColorImage(const PiiVariant& obj, const QString& fileName);
+  void enqueue(const WriteJob& job);
+  void encodeImages();
+  void encode(const WriteJob& job);
+  void startEncoders();
+  void stopEncoders();
+  void syncFiles(const QStringList& files);
+  static void writeKeyValues(QImage* image, const WriteJob& job);
+  qint64 writeImage(QImage* image, const WriteJob& job);
+  template <class T> qint64 writeGrayImage(const WriteJob& job);
+  template <class T> qint64 writeColorImage(const WriteJob& job);
 
   /// @internal
   class Data : public PiiDefaultOperation::Data
@@ -327,13 +454,27 @@ private:
     bool bStoreAlpha;
     bool bChangeExtension;
     bool bOverwrite;
+
+    int iQueueLength, iEncoderThreads;
+    FullQueueBehavior fullQueueBehavior;
+    int iSyncInterval, iDiskQuota;
+    QQueue<WriteJob> queJobs;
+    mutable QMutex queueMutex;
+    QWaitCondition jobAvailable, spaceAvailable;
+    QList<QThread*> lstEncoders;
+    bool bEncodersRunning;
+    QStringList lstUnsyncedFiles;
+    QMutex syncMutex;
+    qint64 iBytesWritten;
+    double dEncodeLatency;
+    int iDroppedImageCount;
   };
   PII_D_FUNC;
 };
 
 template <class T> bool PiiImageFileWriter::writeImage(const PiiMatrix<T>& matrix, const QString& fileName, bool lock)
 {
-  return writeImage(Pii::createQImage(matrix), fileName, lock);
+  return writeImage(Pii::createQImage(matrix), createJob(fileName, lock)) >= 0;
 }
 
 #endif //_PIIIMAGEFILEWRITER_H
@@ -19,6 +19,32 @@
 #include <PiiMath.h>
 #include "PiiImage.h"
 
+namespace
+{
+  // The histogram-based median filter is used for 8 and 16 bit
+  // images with windows of this size or larger.
+  const int iHistogramMedianSize = 5;
+
+  template <class T> inline PiiMatrix<T> median(const PiiMatrix<T>& image, int size, Pii::ExtendMode mode)
+  {
+    return PiiImage::medianFilter(image, size, size, mode);
+  }
+
+  inline PiiMatrix<unsigned char> median(const PiiMatrix<unsigned char>& image, int size, Pii::ExtendMode mode)
+  {
+    return size >= iHistogramMedianSize ?
+      PiiImage::histogramMedianFilter(image, size, size, mode) :
+      PiiImage::medianFilter(image, size, size, mode);
+  }
+
+  inline PiiMatrix<unsigned short> median(const PiiMatrix<unsigned short>& image, int size, Pii::ExtendMode mode)
+  {
+    return size >= iHistogramMedianSize ?
+      PiiImage::histogramMedianFilter(image, size, size, mode) :
+      PiiImage::medianFilter(image, size, size, mode);
+  }
+}
+
 PiiImageFilterOperation::Data::Data() :
   filterType(Prebuilt), iFilterSize(3),
   borderHandling(Pii::ExtendZeros),
@@ -31,6 +57,7 @@ PiiImageFilterOperation::PiiImageFilterOperation() :
   PiiDefaultOperation(new Data)
 {
   setThreadCount(1);
+  setDeterministic(true);
   setFilterName("uniform");
 
   addSocket(new PiiInputSocket("image"));
@@ -152,7 +179,7 @@ template <class T> void PiiImageFilterOperation::intGrayFilter(const PiiVariant&
         emitObject(PiiImage::intFilter(img, d->matActiveFilter, d->borderHandling));
       break;
     case Median:
-      emitObject(PiiImage::medianFilter(img, d->iFilterSize, d->iFilterSize, d->borderHandling));
+      emitObject(median(img, d->iFilterSize, d->borderHandling));
       break;
     }
 }
@@ -205,14 +232,11 @@ template <class T> void PiiImageFilterOperation::intColorFilter(const PiiVariant
       break;
     case Median:
       {
-        PiiMatrix<PrimitiveType> ch2 = PiiImage::medianFilter(PiiImage::colorChannel(img,2),
-                                                               d->iFilterSize, d->iFilterSize, d->borderHandling);
+        PiiMatrix<PrimitiveType> ch2 = median(PiiImage::colorChannel(img,2), d->iFilterSize, d->borderHandling);
         PiiMatrix<T> matResult(ch2.rows(), ch2.columns());
         PiiImage::setColorChannel(matResult, 2, ch2);
-        PiiImage::setColorChannel(matResult, 1, PiiImage::medianFilter(PiiImage::colorChannel(img,1),
-                                                                     d->iFilterSize, d->iFilterSize, d->borderHandling));
-        PiiImage::setColorChannel(matResult, 0, PiiImage::medianFilter(PiiImage::colorChannel(img,0),
-                                                                     d->iFilterSize, d->iFilterSize, d->borderHandling));
+        PiiImage::setColorChannel(matResult, 1, median(PiiImage::colorChannel(img,1), d->iFilterSize, d->borderHandling));
+        PiiImage::setColorChannel(matResult, 0, median(PiiImage::colorChannel(img,0), d->iFilterSize, d->borderHandling));
         emitObject(matResult);
       }
       break;
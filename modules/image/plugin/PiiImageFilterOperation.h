@@ -48,7 +48,9 @@ class PiiImageFilterOperation : public PiiDefaultOperation
    * etc. There are two special values not supported by makeFilter():
    *
    * - `median` - a median filter. Median filter is non-linear and
-   * cannot be implemented with ordinary correlation masks.
+   * cannot be implemented with ordinary correlation masks. With 8
+   * and 16 bit gray-level and color images and [filterSize] of five
+   * or more, PiiImage::histogramMedianFilter() is used.
    *
    * - `custom` - [filter] will be used as the filter mask.
    *
@@ -227,10 +227,33 @@ void PiiImagePieceJoiner::joinPieces()
   d->labelList.clear();
 }
 
+// Returns true if non-overlapping sub-areas fill their bounding box
+// completely.
+static bool isCovered(const QRect& area, const QList<QRect*>& subAreas)
+{
+  qint64 iCoveredArea = 0;
+  for (int i=0; i<subAreas.size(); ++i)
+    {
+      for (int j=0; j<i; ++j)
+        if (subAreas[i]->intersects(*subAreas[j]))
+          return false;
+      iCoveredArea += qint64(subAreas[i]->width()) * subAreas[i]->height();
+    }
+  return iCoveredArea == qint64(area.width()) * area.height();
+}
+
 // For transparency
 void PiiImagePieceJoiner::emitCompound(QRect area, QList<QRect*>& subAreas)
 {
   PII_D;
+  // A rectangular compound has no transparent parts. The original
+  // image data can be shared.
+  if (isCovered(area, subAreas))
+    {
+      emitCompound(area);
+      return;
+    }
+
   QPair<QRect,QList<QRect*>* > pair(area, &subAreas);
   //qDebug("PiiImagePieceJoiner: emitting compound (%d x %d)", area.width(), area.height());
   switch (d->largeImage.type())
@@ -292,9 +315,10 @@ void PiiImagePieceJoiner::emitCompound(QRect area)
 template <class T> void PiiImagePieceJoiner::emitSubImage(QRect area)
 {
   PII_D;
-  //PiiMatrix<T>* piece = new PiiMatrix<T>(d->largeImage.valueAs<PiiMatrix<T> >(), area.y(), area.x(), area.height(), area.width());
-  //qDebug("PiiImagePieceJoiner: created sub-image (%d,%d,%d,%d).", area.y(), area.x(), area.height(), area.width());
-  d->pPieceOutput->emitObject(d->largeImage.valueAs<PiiMatrix<T> >()(area.y() - d->iTopY, area.x() - d->iLeftX, area.height(), area.width()));
+  const PiiMatrix<T>& largeImage = d->largeImage.valueAs<PiiMatrix<T> >();
+  // The const operator() returns a reference to the large image
+  // instead of a copy.
+  d->pPieceOutput->emitObject(largeImage(area.y() - d->iTopY, area.x() - d->iLeftX, area.height(), area.width()));
 }
 
 bool PiiImagePieceJoiner::isNeighbor(QRect r1, QRect r2)
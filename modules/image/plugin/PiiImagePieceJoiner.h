@@ -94,7 +94,10 @@ class PiiImagePieceJoiner : public PiiDefaultOperation
    * ~~~
    *
    * Note that transparent mode is not as efficient as the
-   * non-transparent one because original image data cannot be shared.
+   * non-transparent one because original image data cannot be shared
+   * unless the joined pieces form a rectangle. In non-transparent
+   * mode, and for rectangular compounds, the emitted images are
+   * references to the large image and no pixels are copied.
    */
   Q_PROPERTY(bool transparent READ isTransparent WRITE setTransparent);
 
@@ -26,9 +26,11 @@
 #include "PiiImageAnnotator.h"
 #include "PiiImageScaleOperation.h"
 #include "PiiImageRotationOperation.h"
+#include "PiiImagePyramidOperation.h"
 #include "PiiImageFilterOperation.h"
 #include "PiiCornerDetector.h"
 #include "PiiAdaptiveImageNormalizer.h"
+#include "PiiTileProcessor.h"
 
 //Histograms
 #include "PiiHistogramOperation.h"
@@ -48,6 +50,10 @@
 // Other
 #include "PiiImageUnwarpOperation.h"
 
+// Raw image archives
+#include "PiiRawImageArchiveReader.h"
+#include "PiiRawImageArchiveWriter.h"
+
 PII_IMPLEMENT_PLUGIN(PiiImagePlugin);
 
 //Basic image handling
@@ -61,9 +67,11 @@ PII_REGISTER_OPERATION(PiiBackgroundExtractor);
 PII_REGISTER_OPERATION(PiiImageAnnotator);
 PII_REGISTER_OPERATION(PiiImageScaleOperation);
 PII_REGISTER_OPERATION(PiiImageRotationOperation);
+PII_REGISTER_OPERATION(PiiImagePyramidOperation);
 PII_REGISTER_OPERATION(PiiImageFilterOperation);
 PII_REGISTER_OPERATION(PiiCornerDetector);
 PII_REGISTER_OPERATION(PiiAdaptiveImageNormalizer);
+PII_REGISTER_OPERATION(PiiTileProcessor);
 
 //Histograms
 PII_REGISTER_OPERATION(PiiHistogramOperation);
@@ -83,6 +91,10 @@ PII_REGISTER_OPERATION(PiiBoundaryFinderOperation);
 //Other
 PII_REGISTER_OPERATION(PiiImageUnwarpOperation);
 
+//Raw image archives
+PII_REGISTER_OPERATION(PiiRawImageArchiveReader);
+PII_REGISTER_OPERATION(PiiRawImageArchiveWriter);
+
 #include <QtPlugin>
 #if QT_VERSION < 0x050000
 Q_IMPORT_PLUGIN(piiraw)
@@ -0,0 +1,69 @@
+/* This file is part of Into.
+ * Copyright (C) Intopii 2013.
+ * All rights reserved.
+ *
+ * Licensees holding a commercial Into license may use this file in
+ * accordance with the commercial license agreement. Please see
+ * LICENSE.commercial for commercial licensing terms.
+ *
+ * Alternatively, this file may be used under the terms of the GNU
+ * Affero General Public License version 3 as published by the Free
+ * Software Foundation. In addition, Intopii gives you special rights
+ * to use Into as a part of open source software projects. Please
+ * refer to LICENSE.AGPL3 for details.
+ */
+
+
+#include "PiiImagePyramidOperation.h"
+#include "PiiImage.h"
+#include <PiiYdinTypes.h>
+
+PiiImagePyramidOperation::Data::Data() :
+  filter(GaussianPyramidFilter)
+{
+}
+
+PiiImagePyramidOperation::PiiImagePyramidOperation() :
+  PiiDefaultOperation(new Data)
+{
+  setThreadCount(1);
+  addSocket(new PiiInputSocket("image"));
+  setLevels(3);
+}
+
+void PiiImagePyramidOperation::process()
+{
+  PiiVariant obj = readInput();
+
+  switch (obj.type())
+    {
+      PII_GRAY_IMAGE_CASES(buildPyramid, obj);
+      PII_COLOR_IMAGE_CASES(buildPyramid, obj);
+    default:
+      PII_THROW_UNKNOWN_TYPE(inputAt(0));
+    }
+}
+
+template <class T> void PiiImagePyramidOperation::buildPyramid(const PiiVariant& obj)
+{
+  const int iLevels = outputCount();
+  QList<PiiMatrix<T> > lstLevels(PiiImage::buildPyramid(Pii::ParallelExecution(),
+                                                        obj.valueAs<PiiMatrix<T> >(),
+                                                        iLevels,
+                                                        (PiiImage::PyramidFilter)_d()->filter));
+  // The input image is passed as such to avoid creating a new
+  // variant.
+  emitObject(obj, 0);
+  for (int i=1; i<iLevels; ++i)
+    emitObject(lstLevels[qMin(i, lstLevels.size()-1)], i);
+}
+
+int PiiImagePyramidOperation::levels() const { return outputCount(); }
+void PiiImagePyramidOperation::setLevels(int levels)
+{
+  if (levels < 1)
+    return;
+  setNumberedOutputs(levels, 0, "level");
+}
+PiiImagePyramidOperation::PyramidFilter PiiImagePyramidOperation::filter() const { return _d()->filter; }
+void PiiImagePyramidOperation::setFilter(PyramidFilter filter) { _d()->filter = filter; }
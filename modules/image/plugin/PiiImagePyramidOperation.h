@@ -0,0 +1,90 @@
+/* This file is part of Into.
+ * Copyright (C) Intopii 2013.
+ * All rights reserved.
+ *
+ * Licensees holding a commercial Into license may use this file in
+ * accordance with the commercial license agreement. Please see
+ * LICENSE.commercial for commercial licensing terms.
+ *
+ * Alternatively, this file may be used under the terms of the GNU
+ * Affero General Public License version 3 as published by the Free
+ * Software Foundation. In addition, Intopii gives you special rights
+ * to use Into as a part of open source software projects. Please
+ * refer to LICENSE.AGPL3 for details.
+ */
+
+
+#ifndef _PIIIMAGEPYRAMIDOPERATION_H
+#define _PIIIMAGEPYRAMIDOPERATION_H
+
+#include <PiiDefaultOperation.h>
+
+/**
+ * Builds an image pyramid once per incoming image and emits it level
+ * by level. Operations that work on several scales (e.g. coarse-to-fine
+ * matching or multi-scale texture features) can connect to the levels
+ * they need instead of each downsampling the same image again. See
+ * PiiImage::buildPyramid().
+ *
+ * Inputs
+ * ------
+ *
+ * @in image - input image. Any gray-level or color image.
+ *
+ * Outputs
+ * -------
+ *
+ * @out levelX - pyramid level X, where X ranges from 0 to
+ * [levels] - 1. `level0` is the input image itself, and the size of
+ * each subsequent level is half of the previous one. If the image is
+ * reduced to a single pixel before all levels are built, the
+ * remaining outputs emit the smallest level.
+ */
+class PiiImagePyramidOperation : public PiiDefaultOperation
+{
+  Q_OBJECT
+
+  /**
+   * The number of pyramid levels, including the original image. Each
+   * level has its own output. Default is 3.
+   */
+  Q_PROPERTY(int levels READ levels WRITE setLevels);
+
+  /**
+   * The low-pass filter applied before downsampling. Default is
+   * `GaussianPyramidFilter`.
+   */
+  Q_PROPERTY(PyramidFilter filter READ filter WRITE setFilter);
+  Q_ENUMS(PyramidFilter);
+
+  PII_OPERATION_SERIALIZATION_FUNCTION
+public:
+  /**
+   * A copy of PiiImage::PyramidFilter. (Stupid moc.)
+   */
+  enum PyramidFilter { BoxPyramidFilter, GaussianPyramidFilter };
+
+  PiiImagePyramidOperation();
+
+protected:
+  void process();
+
+  int levels() const;
+  void setLevels(int levels);
+  PyramidFilter filter() const;
+  void setFilter(PyramidFilter filter);
+
+private:
+  template <class T> void buildPyramid(const PiiVariant& obj);
+
+  /// @internal
+  class Data : public PiiDefaultOperation::Data
+  {
+  public:
+    Data();
+    PyramidFilter filter;
+  };
+  PII_D_FUNC;
+};
+
+#endif //_PIIIMAGEPYRAMIDOPERATION_H
@@ -27,6 +27,7 @@ PiiImageRotationOperation::PiiImageRotationOperation() :
   PiiDefaultOperation(new Data)
 {
   setThreadCount(1);
+  setDeterministic(true);
   addSocket(new PiiInputSocket("image"));
   addSocket(new PiiInputSocket("angle"));
   inputAt(1)->setOptional(true);
@@ -95,7 +96,8 @@ template <class T> void PiiImageRotationOperation::rotate(const PiiVariant& obj)
   if (angle == 0.0 || obj.valueAs<PiiMatrix<T> >().isEmpty())
     emitObject(obj);
   else
-    emitObject(PiiImage::rotate(obj.valueAs<PiiMatrix<T> >(),
+    emitObject(PiiImage::rotate(Pii::ParallelExecution(),
+                                obj.valueAs<PiiMatrix<T> >(),
                                 angle,
                                 d->transformedSize,
                                 Background<T>::get(d->backgroundColor)));
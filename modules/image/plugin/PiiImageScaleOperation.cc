@@ -29,6 +29,7 @@ PiiImageScaleOperation::PiiImageScaleOperation() :
   PiiDefaultOperation(new Data)
 {
   setThreadCount(1);
+  setDeterministic(true);
   addSocket(new PiiInputSocket("image"));
   addSocket(new PiiOutputSocket("image"));
 }
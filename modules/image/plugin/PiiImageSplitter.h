@@ -52,7 +52,10 @@
  * input image to this output before it sends the pieces.
  *
  * @out subimage - pieces of the large image. The type of the
- * subimages is the same as that of the input images.
+ * subimages is the same as that of the input images. The pieces are
+ * references to the data of the large image; no pixels are copied.
+ * The pieces are immutable: an operation that modifies a piece
+ * detaches it from the large image first.
  *
  * @out location - the location of the corresponding sub-image as a
  * rectangle (1-by-4 PiiMatrix<int> containing x, y, width, and height
@@ -16,6 +16,7 @@
 #include "PiiLabelingOperation.h"
 #include <PiiMatrix.h>
 #include "PiiLabeling.h"
+#include "PiiObjectProperty.h"
 #include "PiiImageTraits.h"
 #include <PiiYdinTypes.h>
 
@@ -23,7 +24,8 @@ PiiLabelingOperation::Data::Data() :
   connectivity(PiiImage::Connect4),
   dThreshold(0),
   dHysteresis(0),
-  bInverse(false)
+  bInverse(false),
+  algorithm(SequentialLabeling)
 {
 }
 
@@ -35,10 +37,16 @@ PiiLabelingOperation::PiiLabelingOperation() :
   d->pBinaryImageInput = new PiiInputSocket("image");
   d->pLabeledImageOutput = new PiiOutputSocket("image");
   d->pLabelsOutput = new PiiOutputSocket("labels");
+  d->pAreasOutput = new PiiOutputSocket("areas");
+  d->pCentroidsOutput = new PiiOutputSocket("centroids");
+  d->pBoundingBoxOutput = new PiiOutputSocket("boundingboxes");
 
   addSocket(d->pBinaryImageInput);
   addSocket(d->pLabeledImageOutput);
   addSocket(d->pLabelsOutput);
+  addSocket(d->pAreasOutput);
+  addSocket(d->pCentroidsOutput);
+  addSocket(d->pBoundingBoxOutput);
 }
 
 
@@ -61,47 +69,105 @@ template <class T> void PiiLabelingOperation::operate(const PiiVariant& obj)
 {
   PII_D;
   const PiiMatrix<T> image = obj.valueAs<PiiMatrix<T> >();
+  const bool bProperties = d->pAreasOutput->isConnected() ||
+    d->pCentroidsOutput->isConnected() ||
+    d->pBoundingBoxOutput->isConnected();
+  // Labels and properties can be found in a single pass over the
+  // image if there is no hysteresis.
+  if (bProperties && d->dHysteresis == 0)
+    {
+      if (!d->bInverse)
+        measure(image, std::bind2nd(std::greater<T>(), T(d->dThreshold)));
+      else
+        measure(image, std::bind2nd(std::less_equal<T>(), T(d->dThreshold)));
+      return;
+    }
+
+  PiiMatrix<int> matLabels;
   int iLabels = 0;
-  if (d->connectivity == PiiImage::Connect4 && d->dHysteresis == 0)
+  if (d->algorithm == ParallelLabeling && d->dHysteresis == 0)
+    {
+      if (!d->bInverse)
+        matLabels = PiiImage::labelImage(Pii::ParallelExecution(),
+                                         image,
+                                         std::bind2nd(std::greater<T>(),
+                                                      T(d->dThreshold)),
+                                         d->connectivity,
+                                         &iLabels);
+      else
+        matLabels = PiiImage::labelImage(Pii::ParallelExecution(),
+                                         image,
+                                         std::bind2nd(std::less_equal<T>(),
+                                                      T(d->dThreshold)),
+                                         d->connectivity,
+                                         &iLabels);
+    }
+  else if (d->connectivity == PiiImage::Connect4 && d->dHysteresis == 0)
     {
       if (!d->bInverse)
-        d->pLabeledImageOutput->emitObject(PiiImage::labelImage(image,
-                                                                std::bind2nd(std::greater<T>(),
-                                                                             T(d->dThreshold)),
-                                                                PiiImage::DefaultLabelingLimiter(),
-                                                                &iLabels));
+        matLabels = PiiImage::labelImage(image,
+                                         std::bind2nd(std::greater<T>(),
+                                                      T(d->dThreshold)),
+                                         PiiImage::DefaultLabelingLimiter(),
+                                         &iLabels);
       else
-        d->pLabeledImageOutput->emitObject(PiiImage::labelImage(image,
-                                                                std::bind2nd(std::less_equal<T>(),
-                                                                             T(d->dThreshold)),
-                                                                PiiImage::DefaultLabelingLimiter(),
-                                                                &iLabels));
+        matLabels = PiiImage::labelImage(image,
+                                         std::bind2nd(std::less_equal<T>(),
+                                                      T(d->dThreshold)),
+                                         PiiImage::DefaultLabelingLimiter(),
+                                         &iLabels);
     }
   else if (!d->bInverse)
-    d->pLabeledImageOutput->emitObject(PiiImage::labelImage(image,
-                                                            std::bind2nd(std::greater<T>(),
-                                                                         T(qMax(0.0,
-                                                                                d->dThreshold - d->dHysteresis))),
-                                                            std::bind2nd(std::greater<T>(),
-                                                                         T(d->dThreshold)),
-                                                            d->connectivity,
-                                                            false,
-                                                            0,
-                                                            INT_MAX,
-                                                            &iLabels));
+    matLabels = PiiImage::labelImage(image,
+                                     std::bind2nd(std::greater<T>(),
+                                                  T(qMax(0.0,
+                                                         d->dThreshold - d->dHysteresis))),
+                                     std::bind2nd(std::greater<T>(),
+                                                  T(d->dThreshold)),
+                                     d->connectivity,
+                                     false,
+                                     0,
+                                     INT_MAX,
+                                     &iLabels);
   else
-    d->pLabeledImageOutput->emitObject(PiiImage::labelImage(image,
-                                                            std::bind2nd(std::less_equal<T>(),
-                                                                         T(qMin(double(PiiImage::Traits<T>::max()),
-                                                                                d->dThreshold + d->dHysteresis))),
-                                                            std::bind2nd(std::less_equal<T>(),
-                                                                         T(d->dThreshold)),
-                                                            d->connectivity,
-                                                            false,
-                                                            0,
-                                                            INT_MAX,
-                                                            &iLabels));
+    matLabels = PiiImage::labelImage(image,
+                                     std::bind2nd(std::less_equal<T>(),
+                                                  T(qMin(double(PiiImage::Traits<T>::max()),
+                                                         d->dThreshold + d->dHysteresis))),
+                                     std::bind2nd(std::less_equal<T>(),
+                                                  T(d->dThreshold)),
+                                     d->connectivity,
+                                     false,
+                                     0,
+                                     INT_MAX,
+                                     &iLabels);
+  d->pLabeledImageOutput->emitObject(matLabels);
   d->pLabelsOutput->emitObject(iLabels);
+  if (bProperties)
+    emitProperties(PiiImage::calculateMoments(matLabels, iLabels));
+}
+
+template <class T, class UnaryOp> void PiiLabelingOperation::measure(const PiiMatrix<T>& image, UnaryOp rule)
+{
+  PII_D;
+  PiiMatrix<int> matLabels;
+  QVector<PiiImage::ObjectMoments> vecObjects(PiiImage::measureObjects(image, rule, d->connectivity, &matLabels));
+  d->pLabeledImageOutput->emitObject(matLabels);
+  d->pLabelsOutput->emitObject(vecObjects.size());
+  emitProperties(vecObjects);
+}
+
+void PiiLabelingOperation::emitProperties(const QVector<PiiImage::ObjectMoments>& objects)
+{
+  PII_D;
+  PiiMatrix<int> matAreas, matCentroids, matBoundingBoxes;
+  PiiImage::calculateProperties(objects, matAreas, matCentroids, matBoundingBoxes);
+  if (d->pAreasOutput->isConnected())
+    d->pAreasOutput->emitObject(matAreas);
+  if (d->pCentroidsOutput->isConnected())
+    d->pCentroidsOutput->emitObject(matCentroids);
+  if (d->pBoundingBoxOutput->isConnected())
+    d->pBoundingBoxOutput->emitObject(matBoundingBoxes);
 }
 
 void PiiLabelingOperation::setConnectivity(PiiImage::Connectivity connectivity) { _d()->connectivity = connectivity; }
@@ -113,3 +179,5 @@ void PiiLabelingOperation::setHysteresis(double hysteresis) { _d()->dHysteresis
 double PiiLabelingOperation::hysteresis() const { return _d()->dHysteresis; }
 void PiiLabelingOperation::setInverse(bool inverse) { _d()->bInverse = inverse; }
 bool PiiLabelingOperation::inverse() const { return _d()->bInverse; }
+void PiiLabelingOperation::setAlgorithm(Algorithm algorithm) { _d()->algorithm = algorithm; }
+PiiLabelingOperation::Algorithm PiiLabelingOperation::algorithm() const { return _d()->algorithm; }
@@ -19,6 +19,9 @@
 #include <PiiDefaultOperation.h>
 #include <PiiMatrix.h>
 #include "PiiImageGlobal.h"
+#include <QVector>
+
+namespace PiiImage { struct ObjectMoments; }
 
 /**
  * Basic labeling operations.
@@ -40,6 +43,20 @@
  * @out labels - the number of distinct objects in the input image.
  * (int)
  *
+ * @out areas - the number of pixels on each object.
+ * PiiMatrix<int>(N,1).
+ *
+ * @out centroids - the center-of-mass point (x,y) for each object.
+ * PiiMatrix<int>(N,2).
+ *
+ * @out boundingboxes - the bounding box of each object
+ * (x,y,width,height). PiiMatrix<int>(N,4).
+ *
+ * The property outputs are equal to those of
+ * PiiObjectPropertyExtractor. If any of them is connected and
+ * [hysteresis] is zero, the properties are accumulated while
+ * labeling, and the image is scanned only once.
+ *
  */
 class PiiLabelingOperation : public PiiDefaultOperation
 {
@@ -73,8 +90,32 @@ class PiiLabelingOperation : public PiiDefaultOperation
    */
   Q_PROPERTY(bool inverse READ inverse WRITE setInverse);
 
+  /**
+   * The labeling algorithm. The parallel algorithm splits the image
+   * into bands that are labeled in the global thread pool. It is
+   * used only if [hysteresis] is zero; hysteresis thresholding is
+   * always sequential. Both algorithms produce the same labels. If
+   * any of the property outputs is connected, the single-pass
+   * labeling algorithm of PiiImage::measureObjects() is used instead.
+   * The default is `SequentialLabeling`.
+   */
+  Q_PROPERTY(Algorithm algorithm READ algorithm WRITE setAlgorithm);
+  Q_ENUMS(Algorithm);
+
   PII_OPERATION_SERIALIZATION_FUNCTION
 public:
+  /**
+   * Labeling algorithms.
+   *
+   * - `SequentialLabeling` - the image is labeled in the processing
+   * thread of the operation.
+   *
+   * - `ParallelLabeling` - bands of the image are labeled in
+   * parallel, and labels are joined across band borders with a
+   * concurrent union-find. Pays off with large images.
+   */
+  enum Algorithm { SequentialLabeling, ParallelLabeling };
+
   PiiLabelingOperation();
 
   void setConnectivity(PiiImage::Connectivity connectivity);
@@ -85,12 +126,16 @@ public:
   double hysteresis() const;
   void setInverse(bool inverse);
   bool inverse() const;
+  void setAlgorithm(Algorithm algorithm);
+  Algorithm algorithm() const;
 
 protected:
   void process();
 
 private:
   template <class T> void operate(const PiiVariant& obj);
+  template <class T, class UnaryOp> void measure(const PiiMatrix<T>& image, UnaryOp rule);
+  void emitProperties(const QVector<PiiImage::ObjectMoments>& objects);
 
   /// @internal
   class Data : public PiiDefaultOperation::Data
@@ -102,9 +147,13 @@ private:
     PiiInputSocket* pBinaryImageInput;
     PiiOutputSocket* pLabeledImageOutput;
     PiiOutputSocket* pLabelsOutput;
+    PiiOutputSocket* pAreasOutput;
+    PiiOutputSocket* pCentroidsOutput;
+    PiiOutputSocket* pBoundingBoxOutput;
     double dThreshold;
     double dHysteresis;
     bool bInverse;
+    Algorithm algorithm;
   };
   PII_D_FUNC;
 };
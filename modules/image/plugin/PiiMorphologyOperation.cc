@@ -30,6 +30,7 @@ PiiMorphologyOperation::PiiMorphologyOperation() :
   PiiDefaultOperation(new Data)
 {
   setThreadCount(1);
+  setDeterministic(true);
   PII_D;
   d->pImageInput = new PiiInputSocket("image");
   d->pBinaryImageOutput = new PiiOutputSocket("image");
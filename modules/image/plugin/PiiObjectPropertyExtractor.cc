@@ -73,13 +73,8 @@ template <class T> void PiiObjectPropertyExtractor::operate(const PiiVariant& im
 
   PiiMatrix<int> areas, centroids, bbox;
   if (labels > 0)
-    PiiImage::calculateProperties(image, labels, areas, centroids, bbox);
-  else
-    {
-      areas = PiiMatrix<int>();
-      centroids = PiiMatrix<int>();
-      bbox = PiiMatrix<int>();
-    }
+    // Runs of equal labels are handled at once.
+    PiiImage::calculateProperties(PiiImage::calculateMoments(image, labels), areas, centroids, bbox);
 
   if (d->pAreasOutput->isConnected())
     d->pAreasOutput->emitObject(areas);
@@ -16,6 +16,14 @@
 #include "PiiQuantizerOperation.h"
 
 #include <PiiYdinTypes.h>
+#include <PiiRandom.h>
+#include <PiiTypeTraits.h>
+#include <cmath>
+#include <climits>
+
+// The look-up table covers all signed and unsigned 8 and 16 bit
+// integers.
+static const int iLookupMinimum = -32768, iLookupMaximum = 65535;
 
 PiiQuantizerOperation::Data::Data() :
   iLevels(16),
@@ -23,7 +31,8 @@ PiiQuantizerOperation::Data::Data() :
   iTrainingPixels(100000),
   iCollectionIndex(0),
   dSelectionProbability(1.0),
-  pCollectedData(0)
+  pCollectedData(0),
+  iSkipCount(0)
 {
 }
 
@@ -32,6 +41,7 @@ PiiQuantizerOperation::PiiQuantizerOperation() :
 {
   addSocket(new PiiInputSocket("image"));
   addSocket(new PiiOutputSocket("image"));
+  updateLookupTable();
 }
 
 PiiQuantizerOperation::~PiiQuantizerOperation()
@@ -46,6 +56,13 @@ void PiiQuantizerOperation::setLimits(const QVariantList& limits)
   PiiMatrix<double> limitMat(1, limits.size());
   for (int i=limits.size(); i--; ) limitMat(i) = limits[i].toDouble();
   d->quantizer.setLimits(limitMat);
+  updateLookupTable();
+}
+
+void PiiQuantizerOperation::updateLookupTable()
+{
+  PII_D;
+  d->matLookup = d->quantizer.lookupTable(iLookupMinimum, iLookupMaximum);
 }
 
 QVariantList PiiQuantizerOperation::limits() const
@@ -78,9 +95,24 @@ void PiiQuantizerOperation::check(bool reset)
       delete[] d->pCollectedData;
       d->pCollectedData = 0;
       d->iCollectionIndex = 0;
+      d->iSkipCount = nextSkipCount();
     }
 }
 
+int PiiQuantizerOperation::nextSkipCount() const
+{
+  const PII_D;
+  if (d->dSelectionProbability >= 1)
+    return 0;
+  if (d->dSelectionProbability <= 0)
+    return INT_MAX;
+  // The number of failures before the first success is geometrically
+  // distributed.
+  double dSkip = std::floor(std::log(1.0 - Pii::uniformRandom() * (1.0 - 1e-12)) /
+                            std::log(1.0 - d->dSelectionProbability));
+  return dSkip < INT_MAX ? int(dSkip) : INT_MAX;
+}
+
 template <class T> void PiiQuantizerOperation::quantize(const PiiVariant& obj)
 {
   PII_D;
@@ -90,26 +122,28 @@ template <class T> void PiiQuantizerOperation::quantize(const PiiVariant& obj)
     {
       if (!d->pCollectedData)
         d->pCollectedData = new double[d->iTrainingPixels];
-      for (int r = img.rows(); r--; )
+      const int iColumns = img.columns();
+      for (int r = 0; r < img.rows(); ++r)
         {
           const T* row = img.row(r);
-          for (int c = img.columns(); c--; )
+          // Jump directly to the next selected pixel. The skip count
+          // carries over rows and images.
+          while (d->iSkipCount < iColumns)
             {
-              // Random number between 0 and 1
-              double rnd = (double)std::rand() / RAND_MAX;
-              if (rnd < d->dSelectionProbability)
+              d->pCollectedData[d->iCollectionIndex++] = (double)row[d->iSkipCount];
+              // All pixels collected ...
+              if (d->iCollectionIndex >= d->iTrainingPixels)
                 {
-                  d->pCollectedData[d->iCollectionIndex++] = (double)row[c];
-                  // All pixels collected ...
-                  if (d->iCollectionIndex >= d->iTrainingPixels)
-                    {
-                      d->iCollectionIndex = 0;
-                      d->bTraining = false;
-                      learnBoundaries();
-                      goto trainingFinished;
-                    }
+                  d->iCollectionIndex = 0;
+                  d->bTraining = false;
+                  learnBoundaries();
+                  goto trainingFinished;
                 }
+              int iSkip = nextSkipCount();
+              d->iSkipCount = iSkip < INT_MAX - iColumns ? d->iSkipCount + 1 + iSkip : INT_MAX;
             }
+          if (d->iSkipCount < INT_MAX)
+            d->iSkipCount -= iColumns;
         }
       if (d->iLevels > 256)
         emitObject(PiiMatrix<int>(img.rows(), img.columns()));
@@ -132,13 +166,29 @@ template <class T, class U> void PiiQuantizerOperation::quantize(const PiiMatrix
   PII_D;
   // Create an empty matrix with the same size as the input.
   PiiMatrix<T> matResult(PiiMatrix<T>::uninitialized(img.rows(), img.columns()));
-  // Quantize each pixel
-  for (int r = matResult.rows(); r--; )
+  const int iColumns = matResult.columns();
+  // Small integers are quantized through the look-up table.
+  if (Pii::IsInteger<U>::boolValue && sizeof(U) <= 2)
+    {
+      const int* pLookup = d->matLookup[0] - iLookupMinimum;
+      for (int r = matResult.rows(); r--; )
+        {
+          const U* sourceRow = img.row(r);
+          T* targetRow = matResult.row(r);
+          for (int c = 0; c < iColumns; ++c)
+            targetRow[c] = T(pLookup[int(sourceRow[c])]);
+        }
+    }
+  else
     {
-      const U* sourceRow = img.row(r);
-      T* targetRow = matResult.row(r);
-      for (int c = matResult.columns(); c--; )
-        targetRow[c] = d->quantizer.quantize(sourceRow[c]);
+      // Quantize each pixel
+      for (int r = matResult.rows(); r--; )
+        {
+          const U* sourceRow = img.row(r);
+          T* targetRow = matResult.row(r);
+          for (int c = iColumns; c--; )
+            targetRow[c] = d->quantizer.quantize(sourceRow[c]);
+        }
     }
   // Emit result
   emitObject(matResult);
@@ -152,8 +202,9 @@ void PiiQuantizerOperation::learnBoundaries()
   qDebug("Quantization limits:");
   for (int i=0; i<d->quantizer.limits().columns(); i++)
     qDebug("%lf", d->quantizer.limits()(i));
-  delete d->pCollectedData;
+  delete[] d->pCollectedData;
   d->pCollectedData = 0;
+  updateLookupTable();
 }
 
 void PiiQuantizerOperation::setLevels(int levels) { _d()->iLevels = levels; }
@@ -31,8 +31,12 @@
  * -------
  *
  * @out image - input image quantized to discrete levels.
- * PiiMatrix<int>.
+ * PiiMatrix<unsigned char> if [levels] is at most 256,
+ * PiiMatrix<int> otherwise.
  *
+ * 8 and 16 bit integer images are quantized through a look-up table
+ * that is rebuilt whenever the limits change. Other types are
+ * quantized with a binary search per pixel.
  */
 class PiiQuantizerOperation : public PiiDefaultOperation
 {
@@ -55,17 +59,26 @@ class PiiQuantizerOperation : public PiiDefaultOperation
   Q_PROPERTY(QVariantList limits READ limits WRITE setLimits);
 
   /**
-   * training description
+   * If `true`, the operation collects [trainingPixels] pixels from
+   * incoming images and learns limits that divide them into [levels]
+   * equally populated levels. Training is switched off once enough
+   * pixels have been collected. Images received during training are
+   * quantized to zeros. The default is `false`.
    */
   Q_PROPERTY(bool training READ training WRITE setTraining);
 
   /**
-   * trainingPixels description
+   * The number of pixels collected for training. The default is
+   * 100000.
    */
   Q_PROPERTY(int trainingPixels READ trainingPixels WRITE setTrainingPixels);
 
   /**
-   * selectionProbability description
+   * The probability of selecting a pixel for training. Instead of
+   * drawing a random number for each pixel, the number of pixels to
+   * skip before the next selected one is drawn from a geometric
+   * distribution. Thus, the cost of sampling depends on the number of
+   * selected pixels only. The default is 1.0.
    */
   Q_PROPERTY(double selectionProbability READ selectionProbability WRITE setSelectionProbability);
 
@@ -106,9 +119,16 @@ private:
     double dSelectionProbability;
     PiiQuantizer<double> quantizer;
     double* pCollectedData;
+    // Pixels to skip before the next training sample
+    int iSkipCount;
+    // Quantization levels for all 8 and 16 bit integers
+    PiiMatrix<int> matLookup;
   };
   PII_D_FUNC;
 
+  int nextSkipCount() const;
+  void updateLookupTable();
+
   template <class T> void quantize(const PiiVariant& obj);
   template <class T, class U> void quantize(const PiiMatrix<U>& img);
   void learnBoundaries();
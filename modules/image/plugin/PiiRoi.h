@@ -23,6 +23,7 @@
 #include <PiiInputSocket.h>
 #include <PiiYdinTypes.h>
 #include <PiiImage.h>
+#include <PiiRunLengthRoi.h>
 
 
 namespace PiiImage
@@ -47,11 +48,16 @@ namespace PiiImage
    * Reads a ROI object from *input* and handles *image* based on it
    * and *roiType*. Uses *process* to actually perform the image
    * processing operation.
+   *
+   * If *cache* is non-zero, masks are passed to *process* as a
+   * RunLengthRoi, and the conversion is reused as long as the mask
+   * does not change.
    */
   template <class T, class Processor> void handleRoiInput(PiiInputSocket* input,
                                                           RoiType roiType,
                                                           const PiiMatrix<T>& image,
-                                                          Processor& process)
+                                                          Processor& process,
+                                                          RunLengthRoiCache* cache = 0)
   {
     if (roiType == NoRoi)
       {
@@ -109,6 +115,8 @@ namespace PiiImage
                             .arg(image.columns()).arg(image.rows()));
               }
           }
+        else if (cache != 0)
+          process(image, cache->roi(createRoiMask(iRows, iColumns, matRectangles)));
         else
           process(image, createRoiMask(iRows, iColumns, matRectangles));
       }
@@ -120,7 +128,10 @@ namespace PiiImage
                     QCoreApplication::translate("PiiRoi", roiMaskSizeError)
                     .arg(matMask.columns()).arg(matMask.rows())
                     .arg(image.columns()).arg(image.rows()));
-        process(image, matMask);
+        if (cache != 0)
+          process(image, cache->roi(matMask));
+        else
+          process(image, matMask);
       }
   }
 }
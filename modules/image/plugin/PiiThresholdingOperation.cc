@@ -53,7 +53,8 @@ void PiiThresholdingOperation::check(bool reset)
   PiiDefaultOperation::check(reset);
 
   if ((d->thresholdType == RelativeToMeanAdaptiveThreshold ||
-       d->thresholdType == MeanStdAdaptiveThreshold) &&
+       d->thresholdType == MeanStdAdaptiveThreshold ||
+       d->thresholdType == SauvolaAdaptiveThreshold) &&
       (d->windowSize.width() < 1 ||
        d->windowSize.height() < 1))
     PII_THROW(PiiExecutionException, tr("Window size is too small for adaptive thresholding."));
@@ -92,6 +93,9 @@ template <class T> void PiiThresholdingOperation::threshold(const PiiMatrix<T>&
   PII_D;
   double threshold = 0;
 
+  if (!d->bThresholdConnected && thresholdLocally(image))
+    return;
+
   if (d->bThresholdConnected)
     {
       threshold = d->dRelativeThreshold * PiiYdin::primitiveAs<double>(d->pThresholdInput) + d->dAbsoluteThreshold;
@@ -135,7 +139,7 @@ template <class T> void PiiThresholdingOperation::threshold(const PiiMatrix<T>&
           break;
         case PercentageThreshold:
           {
-            PiiMatrix<int> matCumulative(PiiImage::cumulative(PiiImage::histogram(image)));
+            PiiMatrix<int> matCumulative(PiiImage::cumulativeHistogram(image));
             // Relative threshold times the number of pixels in image
             int iLimit = int(d->dRelativeThreshold * matCumulative(0, matCumulative.columns()-1));
             // Binary search for the first bin in cumulative
@@ -235,6 +239,42 @@ template <class T> void PiiThresholdingOperation::threshold(const PiiMatrix<T>&
   d->pThresholdOutput->emitObject(threshold);
 }
 
+template <class T> bool PiiThresholdingOperation::thresholdLocally(const PiiMatrix<T>&)
+{
+  return false;
+}
+
+bool PiiThresholdingOperation::thresholdLocally(const PiiMatrix<unsigned char>& image)
+{
+  return emitLocalThreshold(image);
+}
+
+bool PiiThresholdingOperation::thresholdLocally(const PiiMatrix<unsigned short>& image)
+{
+  return emitLocalThreshold(image);
+}
+
+template <class T> bool PiiThresholdingOperation::emitLocalThreshold(const PiiMatrix<T>& image)
+{
+  PII_D;
+  PiiImage::LocalThresholdMethod method;
+  switch (d->thresholdType)
+    {
+    case RelativeToMeanAdaptiveThreshold: method = PiiImage::MeanLocalThreshold; break;
+    case MeanStdAdaptiveThreshold: method = PiiImage::NiblackLocalThreshold; break;
+    case SauvolaAdaptiveThreshold: method = PiiImage::SauvolaLocalThreshold; break;
+    default: return false;
+    }
+  d->pBinaryImageOutput->emitObject(PiiImage::localThreshold(image, method,
+                                                             d->dRelativeThreshold,
+                                                             d->dAbsoluteThreshold,
+                                                             d->windowSize.height(),
+                                                             d->windowSize.width(),
+                                                             d->bInverse));
+  d->pThresholdOutput->emitObject(d->dAbsoluteThreshold);
+  return true;
+}
+
 double PiiThresholdingOperation::absoluteThreshold() const { return _d()->dAbsoluteThreshold; }
 void PiiThresholdingOperation::setAbsoluteThreshold(double absoluteThreshold) { _d()->dAbsoluteThreshold = absoluteThreshold; }
 void PiiThresholdingOperation::setRelativeThreshold(double relativeThreshold) { _d()->dRelativeThreshold = relativeThreshold; }
@@ -154,9 +154,10 @@ public:
    *
    * - `MeanStdAdaptiveThreshold` - same as `MeanStdThreshold`, but
    * the threshold is calculated separately for each pixel in a local
-   * window. The size of the local window is determined by
-   * [windowSize]. The `threshold` output will emit the value of
-   * [absoluteThreshold]. The `threshold` input will be ignored.
+   * window (Niblack's method). The size of the local window is
+   * determined by [windowSize]. The `threshold` output will emit the
+   * value of [absoluteThreshold]. The `threshold` input will be
+   * ignored.
    *
    * - `SauvolaAdaptiveThreshold` - and adaptive thresholding
    * technique that takes local variance into account. The local
@@ -169,6 +170,11 @@ public:
    * a good value for [relativeThreshold] is 0.34. [absoluteThreshold]
    * is typically zero. The `threshold` output will emit the value of
    * [absoluteThreshold]. The `threshold` input will be ignored.
+   *
+   * With `unsigned char` and `unsigned short` images, the adaptive
+   * techniques use [PiiImage::localThreshold()], which computes the
+   * local statistics and the comparison in a single pass over exact
+   * integer integral images.
    */
   enum ThresholdType
   {
@@ -211,6 +217,10 @@ private:
   template <class T> void thresholdColor(const PiiVariant& obj);
   template <class T> void thresholdGray(const PiiVariant& obj);
   template <class T> void threshold(const PiiMatrix<T>& image);
+  template <class T> bool thresholdLocally(const PiiMatrix<T>& image);
+  bool thresholdLocally(const PiiMatrix<unsigned char>& image);
+  bool thresholdLocally(const PiiMatrix<unsigned short>& image);
+  template <class T> bool emitLocalThreshold(const PiiMatrix<T>& image);
 
   /// @internal
   class Data : public PiiDefaultOperation::Data
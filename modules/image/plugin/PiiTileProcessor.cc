@@ -0,0 +1,519 @@
+/* This file is part of Into.
+ * Copyright (C) Intopii 2013.
+ * All rights reserved.
+ *
+ * Licensees holding a commercial Into license may use this file in
+ * accordance with the commercial license agreement. Please see
+ * LICENSE.commercial for commercial licensing terms.
+ *
+ * Alternatively, this file may be used under the terms of the GNU
+ * Affero General Public License version 3 as published by the Free
+ * Software Foundation. In addition, Intopii gives you special rights
+ * to use Into as a part of open source software projects. Please
+ * refer to LICENSE.AGPL3 for details.
+ */
+
+
+#include "PiiTileProcessor.h"
+
+#include <PiiYdinTypes.h>
+#include <PiiProxySocket.h>
+#include <PiiColor.h>
+#include <QThread>
+#include <complex>
+
+// Gives the pipeline the thread pool of the tile processor and
+// reports the errors of its operations directly to *receiver*. The
+// results of a worker are matched to its tiles by order, which only
+// holds if no operation processes many objects at once.
+static void configureOperations(PiiOperationCompound* compound, PiiThreadPool* pool, QObject* receiver)
+{
+  QList<PiiOperation*> lstOperations = compound->childOperations();
+  for (int i=0; i<lstOperations.size(); ++i)
+    {
+      if (PiiOperationCompound* pCompound = qobject_cast<PiiOperationCompound*>(lstOperations[i]))
+        configureOperations(pCompound, pool, receiver);
+      else
+        {
+          if (PiiDefaultOperation* pOperation = qobject_cast<PiiDefaultOperation*>(lstOperations[i]))
+            {
+              pOperation->setThreadPool(pool);
+              if (pOperation->threadCount() > 1)
+                pOperation->setThreadCount(1);
+            }
+          QObject::connect(lstOperations[i], SIGNAL(errorOccured(PiiOperation*,const QString&)),
+                           receiver, SLOT(storeError(PiiOperation*,const QString&)),
+                           Qt::DirectConnection);
+        }
+    }
+}
+
+PiiTileProcessor::Data::Data() :
+  pPipeline(0),
+  iTileWidth(1024), iTileHeight(1024), iOverlap(0), iWorkerCount(0),
+  bWorkersRunning(false),
+  iReceivedCount(0),
+  bInterrupted(false)
+{
+}
+
+PiiTileProcessor::Data::~Data()
+{
+  delete pPipeline;
+}
+
+bool PiiTileProcessor::Data::tryToReceive(PiiAbstractInputSocket* sender, const PiiVariant& object) throw ()
+{
+  if (PiiYdin::isControlType(object.type()))
+    return true;
+  QMutexLocker lock(&resultMutex);
+  vecResults[hashCollectors.value(sender)].enqueue(object);
+  ++iReceivedCount;
+  resultCondition.wakeAll();
+  return true;
+}
+
+PiiTileProcessor::PiiTileProcessor() :
+  PiiDefaultOperation(new Data)
+{
+  PII_D;
+  addSocket(d->pImageInput = new PiiInputSocket("image"));
+}
+
+PiiTileProcessor::~PiiTileProcessor()
+{
+  destroyWorkers();
+}
+
+void PiiTileProcessor::setPipeline(PiiOperationCompound* pipeline)
+{
+  PII_D;
+  if (pipeline == d->pPipeline)
+    return;
+  destroyWorkers();
+  delete d->pPipeline;
+  d->pPipeline = pipeline;
+
+  while (d->lstOutputs.size() > 0)
+    delete removeOutput(0);
+  if (pipeline != 0)
+    {
+      QStringList lstNames = pipeline->outputNames();
+      for (int i=0; i<lstNames.size(); ++i)
+        addSocket(new PiiOutputSocket(lstNames[i]));
+    }
+}
+
+PiiOperationCompound* PiiTileProcessor::pipeline() const { return _d()->pPipeline; }
+
+PiiOperation* PiiTileProcessor::clone() const
+{
+  PiiTileProcessor* pClone = qobject_cast<PiiTileProcessor*>(PiiDefaultOperation::clone());
+  if (pClone != 0 && _d()->pPipeline != 0)
+    pClone->setPipeline(_d()->pPipeline->clone());
+  return pClone;
+}
+
+void PiiTileProcessor::check(bool reset)
+{
+  PII_D;
+  if (d->pPipeline == 0)
+    PII_THROW(PiiExecutionException, tr("The pipeline has not been set."));
+  if (d->pPipeline->inputCount() < 1 || d->pPipeline->outputCount() < 1)
+    PII_THROW(PiiExecutionException, tr("The pipeline must have at least one input and one output."));
+  if (d->iTileWidth < 1 || d->iTileHeight < 1)
+    PII_THROW(PiiExecutionException, tr("Tile size must be positive."));
+
+  const int iOutputs = d->lstOutputs.size();
+  d->vecMergeFunctions.fill(Stitch, iOutputs);
+  d->vecPositionColumns.fill(-1, iOutputs);
+  for (int i=0; i<iOutputs && i<d->lstMergeFunctionNames.size(); ++i)
+    {
+      const QString& strName = d->lstMergeFunctionNames[i];
+      if (strName == "stitch")
+        d->vecMergeFunctions[i] = Stitch;
+      else if (strName == "concatenate")
+        d->vecMergeFunctions[i] = Concatenate;
+      else if (strName == "sum")
+        d->vecMergeFunctions[i] = Sum;
+      else if (strName == "min")
+        d->vecMergeFunctions[i] = Minimum;
+      else if (strName == "max")
+        d->vecMergeFunctions[i] = Maximum;
+      else
+        PII_THROW(PiiExecutionException, tr("Unknown merge function \"%1\".").arg(strName));
+    }
+  for (int i=0; i<iOutputs && i<d->lstPositionColumns.size(); ++i)
+    d->vecPositionColumns[i] = d->lstPositionColumns[i].toInt();
+
+  PiiDefaultOperation::check(reset);
+
+  if (reset || d->lstWorkers.isEmpty())
+    {
+      destroyWorkers();
+      d->bInterrupted = false;
+      d->strError.clear();
+      createWorkers();
+    }
+}
+
+void PiiTileProcessor::createWorkers()
+{
+  PII_D;
+  const int iCount = qMax(1, d->iWorkerCount > 0 ? d->iWorkerCount : QThread::idealThreadCount());
+  const int iOutputs = d->lstOutputs.size();
+  d->vecResults.resize(iCount * iOutputs);
+
+  for (int i=0; i<iCount; ++i)
+    {
+      Worker worker;
+      worker.pPipeline = d->pPipeline->clone();
+      if (worker.pPipeline == 0)
+        PII_THROW(PiiExecutionException, tr("The pipeline cannot be cloned."));
+      worker.pFeed = new PiiOutputSocket("tile");
+      worker.pFeed->connectInput(worker.pPipeline->inputAt(0));
+      for (int j=0; j<iOutputs; ++j)
+        {
+          PiiInputSocket* pCollector = new PiiInputSocket(d->lstOutputs[j]->objectName());
+          pCollector->setController(d);
+          worker.pPipeline->outputAt(j)->connectInput(pCollector);
+          d->hashCollectors.insert(pCollector, i*iOutputs + j);
+          worker.lstCollectors << pCollector;
+        }
+      // Stored first so that destroyWorkers() cleans up on error.
+      d->lstWorkers << worker;
+
+      configureOperations(worker.pPipeline, threadPool(), this);
+      // Workers can run in parallel only if the operations that
+      // receive the tiles are threaded.
+      QList<PiiAbstractInputSocket*> lstEntries = PiiProxySocket::connectedInputs(worker.pPipeline->inputAt(0));
+      for (int j=0; j<lstEntries.size(); ++j)
+        {
+          PiiDefaultOperation* pOperation = qobject_cast<PiiDefaultOperation*>(lstEntries[j]->parentOperation());
+          if (pOperation != 0 && pOperation->threadCount() < 1)
+            pOperation->setThreadCount(1);
+        }
+      worker.pPipeline->check(true);
+      worker.pFeed->setInputListener();
+    }
+}
+
+void PiiTileProcessor::destroyWorkers()
+{
+  PII_D;
+  stopWorkers();
+  for (int i=0; i<d->lstWorkers.size(); ++i)
+    {
+      delete d->lstWorkers[i].pPipeline;
+      qDeleteAll(d->lstWorkers[i].lstCollectors);
+      delete d->lstWorkers[i].pFeed;
+    }
+  d->lstWorkers.clear();
+  d->hashCollectors.clear();
+  d->vecResults.clear();
+}
+
+void PiiTileProcessor::startWorkers()
+{
+  PII_D;
+  if (d->bWorkersRunning)
+    return;
+  for (int i=0; i<d->lstWorkers.size(); ++i)
+    d->lstWorkers[i].pPipeline->start();
+  d->bWorkersRunning = true;
+}
+
+void PiiTileProcessor::stopWorkers()
+{
+  PII_D;
+  if (!d->bWorkersRunning)
+    return;
+  for (int i=0; i<d->lstWorkers.size(); ++i)
+    {
+      d->lstWorkers[i].pFeed->interrupt();
+      d->lstWorkers[i].pPipeline->interrupt();
+    }
+  for (int i=0; i<d->lstWorkers.size(); ++i)
+    d->lstWorkers[i].pPipeline->wait();
+  d->bWorkersRunning = false;
+}
+
+void PiiTileProcessor::interrupt()
+{
+  PII_D;
+  synchronized (d->resultMutex)
+    {
+      d->bInterrupted = true;
+      d->resultCondition.wakeAll();
+    }
+  for (int i=0; i<d->lstWorkers.size(); ++i)
+    d->lstWorkers[i].pFeed->interrupt();
+  PiiDefaultOperation::interrupt();
+}
+
+void PiiTileProcessor::aboutToChangeState(State state)
+{
+  if (state == Stopped)
+    stopWorkers();
+  PiiDefaultOperation::aboutToChangeState(state);
+}
+
+void PiiTileProcessor::storeError(PiiOperation* sender, const QString& message)
+{
+  PII_D;
+  QMutexLocker lock(&d->resultMutex);
+  d->strError = QString("%1: %2").arg(sender->metaObject()->className()).arg(message);
+  d->resultCondition.wakeAll();
+}
+
+void PiiTileProcessor::process()
+{
+  PII_D;
+  PiiVariant obj = d->pImageInput->firstObject();
+
+  switch (obj.type())
+    {
+      PII_ALL_MATRIX_CASES(processTiles, obj);
+      PII_COLOR_IMAGE_CASES(processTiles, obj);
+    default:
+      PII_THROW_UNKNOWN_TYPE(d->pImageInput);
+    }
+}
+
+template <class T> void PiiTileProcessor::processTiles(const PiiVariant& obj)
+{
+  PII_D;
+  const PiiMatrix<T> image = obj.valueAs<PiiMatrix<T> >();
+  if (image.isEmpty())
+    PII_THROW(PiiExecutionException, tr("Cannot split an empty image into tiles."));
+
+  createTiles(image.rows(), image.columns());
+  startWorkers();
+
+  synchronized (d->resultMutex)
+    {
+      for (int i=0; i<d->vecResults.size(); ++i)
+        d->vecResults[i].clear();
+      d->iReceivedCount = 0;
+    }
+
+  // Each worker gets every iWorkers'th tile. The tiles are
+  // references to the input image.
+  const int iWorkers = d->lstWorkers.size(), iTiles = d->lstTiles.size();
+  for (int i=0; i<iTiles; ++i)
+    {
+      const QRect& rect = d->lstTiles[i].outer;
+      d->lstWorkers[i % iWorkers].pFeed->emitObject(image(rect.y(), rect.x(), rect.height(), rect.width()));
+    }
+
+  const int iOutputs = d->lstOutputs.size();
+  waitResults(iTiles * iOutputs);
+
+  for (int i=0; i<iOutputs; ++i)
+    {
+      PiiVariantList lstResults;
+      synchronized (d->resultMutex)
+        {
+          // Workers return their results in the order they got
+          // the tiles.
+          for (int j=0; j<iTiles; ++j)
+            lstResults << d->vecResults[(j % iWorkers) * iOutputs + i].dequeue();
+        }
+      d->lstOutputs[i]->emitObject(merge(i, lstResults, image.rows(), image.columns()));
+    }
+}
+
+void PiiTileProcessor::createTiles(int rows, int columns)
+{
+  PII_D;
+  d->lstTiles.clear();
+  for (int y=0; y<rows; y += d->iTileHeight)
+    for (int x=0; x<columns; x += d->iTileWidth)
+      {
+        Tile tile;
+        tile.core = QRect(x, y, qMin(d->iTileWidth, columns - x), qMin(d->iTileHeight, rows - y));
+        const int iLeft = qMax(0, x - d->iOverlap), iTop = qMax(0, y - d->iOverlap);
+        tile.outer = QRect(iLeft, iTop,
+                           qMin(columns, x + tile.core.width() + d->iOverlap) - iLeft,
+                           qMin(rows, y + tile.core.height() + d->iOverlap) - iTop);
+        d->lstTiles << tile;
+      }
+}
+
+void PiiTileProcessor::waitResults(int count)
+{
+  PII_D;
+  QMutexLocker lock(&d->resultMutex);
+  while (d->iReceivedCount < count)
+    {
+      if (d->bInterrupted)
+        throw PiiExecutionException(PiiExecutionException::Interrupted);
+      if (!d->strError.isEmpty())
+        PII_THROW(PiiExecutionException, tr("Processing a tile failed. %1").arg(d->strError));
+      d->resultCondition.wait(&d->resultMutex);
+    }
+}
+
+PiiVariant PiiTileProcessor::merge(int output, const PiiVariantList& results, int rows, int columns)
+{
+  PII_D;
+  const unsigned int uiType = results[0].type();
+  for (int i=1; i<results.size(); ++i)
+    if (results[i].type() != uiType)
+      PII_THROW(PiiExecutionException, tr("The tiles produced objects of different types in \"%1\".")
+                .arg(d->lstOutputs[output]->objectName()));
+
+  PiiVariant varResult;
+  const MergeFunction function = d->vecMergeFunctions[output];
+  switch (function)
+    {
+    case Stitch:
+      switch (uiType)
+        {
+          PII_ALL_MATRIX_CASES_M(varResult = stitch, (results, rows, columns));
+          PII_COLOR_IMAGE_CASES_M(varResult = stitch, (results, rows, columns));
+        }
+      break;
+    case Concatenate:
+      switch (uiType)
+        {
+          PII_NUMERIC_MATRIX_CASES_M(varResult = concatenate, (results, d->vecPositionColumns[output]));
+        }
+      break;
+    default:
+      switch (uiType)
+        {
+          PII_PRIMITIVE_CASES_M(varResult = reduceScalars, (results, function));
+          PII_NUMERIC_MATRIX_CASES_M(varResult = reduceMatrices, (results, function));
+        }
+    }
+
+  if (!varResult.isValid())
+    PII_THROW(PiiExecutionException, tr("Objects of type %1 emitted through \"%2\" cannot be merged with \"%3\".")
+              .arg(results[0].typeName())
+              .arg(d->lstOutputs[output]->objectName())
+              .arg(d->lstMergeFunctionNames.value(output, "stitch")));
+  return varResult;
+}
+
+template <class T> PiiVariant PiiTileProcessor::stitch(const PiiVariantList& results, int rows, int columns)
+{
+  PII_D;
+  PiiMatrix<T> matResult(PiiMatrix<T>::uninitialized(rows, columns));
+  for (int i=0; i<results.size(); ++i)
+    {
+      const PiiMatrix<T> matTile = results[i].valueAs<PiiMatrix<T> >();
+      const Tile& tile = d->lstTiles[i];
+      if (matTile.rows() != tile.outer.height() || matTile.columns() != tile.outer.width())
+        PII_THROW(PiiExecutionException, tr("Cannot stitch a %1-by-%2 result into a %3-by-%4 tile.")
+                  .arg(matTile.rows()).arg(matTile.columns())
+                  .arg(tile.outer.height()).arg(tile.outer.width()));
+      // Only the core is taken. The overlap belongs to the neighbors.
+      matResult(tile.core.y(), tile.core.x(), tile.core.height(), tile.core.width()) <<
+        matTile(tile.core.y() - tile.outer.y(), tile.core.x() - tile.outer.x(),
+                tile.core.height(), tile.core.width());
+    }
+  return PiiVariant(matResult);
+}
+
+template <class T> PiiVariant PiiTileProcessor::concatenate(const PiiVariantList& results, int positionColumn)
+{
+  PII_D;
+  int iColumns = -1, iRows = 0;
+  for (int i=0; i<results.size(); ++i)
+    {
+      const PiiMatrix<T> mat = results[i].valueAs<PiiMatrix<T> >();
+      if (mat.rows() == 0)
+        continue;
+      if (iColumns == -1)
+        iColumns = mat.columns();
+      else if (mat.columns() != iColumns)
+        PII_THROW(PiiExecutionException, tr("Cannot concatenate matrices with %1 and %2 columns.")
+                  .arg(iColumns).arg(mat.columns()));
+      iRows += mat.rows();
+    }
+  if (iColumns == -1)
+    return PiiVariant(results[0].valueAs<PiiMatrix<T> >());
+  if (positionColumn >= 0 && positionColumn + 2 > iColumns)
+    PII_THROW(PiiExecutionException, tr("Position column %1 is out of range in a matrix with %2 columns.")
+              .arg(positionColumn).arg(iColumns));
+
+  PiiMatrix<T> matResult(0, iColumns);
+  matResult.reserve(iRows);
+  for (int i=0; i<results.size(); ++i)
+    {
+      const PiiMatrix<T> mat = results[i].valueAs<PiiMatrix<T> >();
+      const Tile& tile = d->lstTiles[i];
+      for (int r=0; r<mat.rows(); ++r)
+        {
+          if (positionColumn < 0)
+            {
+              matResult.appendRow(mat.row(r));
+              continue;
+            }
+          // Convert to image coordinates and keep only the objects
+          // whose position is in the core of this tile.
+          const double dX = double(mat(r, positionColumn)) + tile.outer.x(),
+            dY = double(mat(r, positionColumn + 1)) + tile.outer.y();
+          if (dX < tile.core.x() || dX >= tile.core.x() + tile.core.width() ||
+              dY < tile.core.y() || dY >= tile.core.y() + tile.core.height())
+            continue;
+          typename PiiMatrix<T>::row_iterator row = matResult.appendRow(mat.row(r));
+          row[positionColumn] = T(dX);
+          row[positionColumn + 1] = T(dY);
+        }
+    }
+  return PiiVariant(matResult);
+}
+
+template <class T> T PiiTileProcessor::reduce(MergeFunction function, T a, T b)
+{
+  switch (function)
+    {
+    case Minimum: return qMin(a, b);
+    case Maximum: return qMax(a, b);
+    default: return T(a + b);
+    }
+}
+
+template <class T> PiiVariant PiiTileProcessor::reduceScalars(const PiiVariantList& results, MergeFunction function)
+{
+  T result = results[0].valueAs<T>();
+  for (int i=1; i<results.size(); ++i)
+    result = reduce(function, result, results[i].valueAs<T>());
+  return PiiVariant(result);
+}
+
+template <class T> PiiVariant PiiTileProcessor::reduceMatrices(const PiiVariantList& results, MergeFunction function)
+{
+  PiiMatrix<T> matResult(results[0].valueAs<PiiMatrix<T> >());
+  for (int i=1; i<results.size(); ++i)
+    {
+      const PiiMatrix<T> mat = results[i].valueAs<PiiMatrix<T> >();
+      if (mat.rows() != matResult.rows() || mat.columns() != matResult.columns())
+        PII_THROW(PiiExecutionException, tr("Cannot reduce a %1-by-%2 matrix with a %3-by-%4 one.")
+                  .arg(mat.rows()).arg(mat.columns())
+                  .arg(matResult.rows()).arg(matResult.columns()));
+      for (int r=0; r<mat.rows(); ++r)
+        {
+          T* pResultRow = matResult.row(r);
+          const T* pRow = mat.row(r);
+          for (int c=0; c<mat.columns(); ++c)
+            pResultRow[c] = reduce(function, pResultRow[c], pRow[c]);
+        }
+    }
+  return PiiVariant(matResult);
+}
+
+void PiiTileProcessor::setTileWidth(int tileWidth) { _d()->iTileWidth = tileWidth; }
+int PiiTileProcessor::tileWidth() const { return _d()->iTileWidth; }
+void PiiTileProcessor::setTileHeight(int tileHeight) { _d()->iTileHeight = tileHeight; }
+int PiiTileProcessor::tileHeight() const { return _d()->iTileHeight; }
+void PiiTileProcessor::setOverlap(int overlap) { _d()->iOverlap = qMax(0, overlap); }
+int PiiTileProcessor::overlap() const { return _d()->iOverlap; }
+void PiiTileProcessor::setWorkerCount(int workerCount) { _d()->iWorkerCount = qMax(0, workerCount); }
+int PiiTileProcessor::workerCount() const { return _d()->iWorkerCount; }
+void PiiTileProcessor::setMergeFunctions(const QStringList& mergeFunctions) { _d()->lstMergeFunctionNames = mergeFunctions; }
+QStringList PiiTileProcessor::mergeFunctions() const { return _d()->lstMergeFunctionNames; }
+void PiiTileProcessor::setPositionColumns(const QVariantList& positionColumns) { _d()->lstPositionColumns = positionColumns; }
+QVariantList PiiTileProcessor::positionColumns() const { return _d()->lstPositionColumns; }
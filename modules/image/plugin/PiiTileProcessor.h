@@ -0,0 +1,262 @@
+/* This file is part of Into.
+ * Copyright (C) Intopii 2013.
+ * All rights reserved.
+ *
+ * Licensees holding a commercial Into license may use this file in
+ * accordance with the commercial license agreement. Please see
+ * LICENSE.commercial for commercial licensing terms.
+ *
+ * Alternatively, this file may be used under the terms of the GNU
+ * Affero General Public License version 3 as published by the Free
+ * Software Foundation. In addition, Intopii gives you special rights
+ * to use Into as a part of open source software projects. Please
+ * refer to LICENSE.AGPL3 for details.
+ */
+
+
+#ifndef _PIITILEPROCESSOR_H
+#define _PIITILEPROCESSOR_H
+
+#include <PiiDefaultOperation.h>
+#include <PiiInputController.h>
+#include <PiiOperationCompound.h>
+#include <QStringList>
+#include <QVariantList>
+#include <QVector>
+#include <QQueue>
+#include <QRect>
+#include <QMutex>
+#include <QWaitCondition>
+
+/**
+ * An operation that runs a sub-pipeline on image tiles in parallel.
+ * PiiTileProcessor splits each incoming image into tiles, sends the
+ * tiles to a number of copies of a [pipeline](setPipeline()) made of
+ * ordinary operations, and merges the per-tile results into one
+ * result per image.
+ *
+ * Each copy of the pipeline (a *worker*) runs in its own thread(s)
+ * and receives every [workerCount]th tile. The operations that
+ * receive the tiles are given a thread of their own even if their
+ * [threadCount](PiiDefaultOperation::threadCount) is zero. Since the
+ * results of a worker are matched to its tiles in the order they
+ * arrive, no operation in a worker may process many tiles at once.
+ * A thread count larger than one is therefore reduced to one in the
+ * workers; parallelism comes from the number of workers instead. The
+ * threaded operations use the same thread pool as the
+ * PiiTileProcessor.
+ *
+ * The pipeline receives tiles through its first input and must emit
+ * exactly one object from each of its outputs for each tile. The
+ * tiles are references to the input image; no pixels are copied.
+ *
+ * Objects that cross tile boundaries are handled with an [overlap]
+ * region: each tile is extended by the overlap on all sides, and the
+ * merge functions only take the results from the *core* of the tile
+ * (the area without overlap) into account. The overlap should be at
+ * least as large as the largest object to be detected, or the radius
+ * of the largest filter in the pipeline.
+ *
+ * ~~~(c++)
+ * PiiOperationCompound* pPipeline = new PiiOperationCompound;
+ * PiiOperation* pThreshold = engine.createOperation("PiiThresholdingOperation");
+ * PiiOperation* pLabeling = engine.createOperation("PiiLabelingOperation");
+ * pPipeline->addOperation(pThreshold);
+ * pPipeline->addOperation(pLabeling);
+ * pThreshold->connectOutput("image", pLabeling, "image");
+ * pPipeline->exposeInput(pThreshold->input("image"));
+ * pPipeline->exposeOutput(pLabeling->output("centroids"));
+ *
+ * PiiTileProcessor* pTiles = new PiiTileProcessor;
+ * pTiles->setPipeline(pPipeline);
+ * pTiles->setProperty("overlap", 32);
+ * pTiles->setProperty("mergeFunctions", QStringList() << "concatenate");
+ * // Centroids are (x,y) pairs in columns 0 and 1.
+ * pTiles->setProperty("positionColumns", QVariantList() << 0);
+ * ~~~
+ *
+ * Inputs
+ * ------
+ *
+ * @in image - the image to be processed. Accepts all matrix and
+ * image types.
+ *
+ * Outputs
+ * -------
+ *
+ * The outputs are named after the outputs of the pipeline. Each
+ * output emits the merged results of the corresponding pipeline
+ * output.
+ *
+ */
+class PiiTileProcessor : public PiiDefaultOperation
+{
+  Q_OBJECT
+
+  /**
+   * The width of a tile, excluding the overlap. The default value is
+   * 1024.
+   */
+  Q_PROPERTY(int tileWidth READ tileWidth WRITE setTileWidth);
+
+  /**
+   * The height of a tile, excluding the overlap. The default value
+   * is 1024.
+   */
+  Q_PROPERTY(int tileHeight READ tileHeight WRITE setTileHeight);
+
+  /**
+   * The number of pixels each tile is extended on all sides. Tiles at
+   * the image borders are clipped. The default value is zero.
+   */
+  Q_PROPERTY(int overlap READ overlap WRITE setOverlap);
+
+  /**
+   * The number of pipeline copies run in parallel. Zero means the
+   * number of processor cores. The default value is zero.
+   */
+  Q_PROPERTY(int workerCount READ workerCount WRITE setWorkerCount);
+
+  /**
+   * The merge function of each output, in the order of the pipeline
+   * outputs. Missing entries default to `stitch`. Supported merge
+   * functions:
+   *
+   * - `stitch` - the results are matrices with the same size as the
+   * tiles (including the overlap). The cores of the tiles are
+   * combined into a matrix with the size of the input image. Note
+   * that labels in stitched label images are tile-local.
+   *
+   * - `concatenate` - the results are matrices with the same number
+   * of columns. Their rows are concatenated in tile order. See
+   * [positionColumns].
+   *
+   * - `sum`, `min`, `max` - the results are numbers or equally sized
+   * matrices, which are reduced element-wise with the given
+   * function. Since the overlaps are processed twice, reduction is
+   * usually used with a zero overlap.
+   */
+  Q_PROPERTY(QStringList mergeFunctions READ mergeFunctions WRITE setMergeFunctions);
+
+  /**
+   * The first of two columns that store (x,y) coordinates in the
+   * results of each `concatenate` output, or -1. If set, the
+   * coordinates are converted from tile coordinates to image
+   * coordinates, and rows whose point lies outside of the core of
+   * the tile are dropped. Thus, an object seen by many tiles due to
+   * the overlap is reported only once. Missing entries default to
+   * -1.
+   */
+  Q_PROPERTY(QVariantList positionColumns READ positionColumns WRITE setPositionColumns);
+
+  PII_OPERATION_SERIALIZATION_FUNCTION
+public:
+  PiiTileProcessor();
+  ~PiiTileProcessor();
+
+  /**
+   * Sets the pipeline to be run on the tiles. PiiTileProcessor takes
+   * the ownership of *pipeline* and replaces its outputs with ones
+   * named after the outputs of *pipeline*. The pipeline is not
+   * serialized with the operation.
+   */
+  void setPipeline(PiiOperationCompound* pipeline);
+  /**
+   * Returns the pipeline.
+   */
+  PiiOperationCompound* pipeline() const;
+
+  /**
+   * Clones the operation and its pipeline.
+   */
+  PiiOperation* clone() const;
+
+  void check(bool reset);
+  void interrupt();
+
+  void setTileWidth(int tileWidth);
+  int tileWidth() const;
+  void setTileHeight(int tileHeight);
+  int tileHeight() const;
+  void setOverlap(int overlap);
+  int overlap() const;
+  void setWorkerCount(int workerCount);
+  int workerCount() const;
+  void setMergeFunctions(const QStringList& mergeFunctions);
+  QStringList mergeFunctions() const;
+  void setPositionColumns(const QVariantList& positionColumns);
+  QVariantList positionColumns() const;
+
+protected:
+  void process();
+  void aboutToChangeState(State state);
+
+private slots:
+  void storeError(PiiOperation* sender, const QString& message);
+
+private:
+  enum MergeFunction { Stitch, Concatenate, Sum, Minimum, Maximum };
+
+  struct Tile
+  {
+    // The tile without and with the overlap.
+    QRect core, outer;
+  };
+
+  struct Worker
+  {
+    PiiOperationCompound* pPipeline;
+    PiiOutputSocket* pFeed;
+    QList<PiiInputSocket*> lstCollectors;
+  };
+
+  template <class T> void processTiles(const PiiVariant& obj);
+  void createTiles(int rows, int columns);
+  void createWorkers();
+  void destroyWorkers();
+  void startWorkers();
+  void stopWorkers();
+  void waitResults(int count);
+  PiiVariant merge(int output, const PiiVariantList& results, int rows, int columns);
+  template <class T> PiiVariant stitch(const PiiVariantList& results, int rows, int columns);
+  template <class T> PiiVariant concatenate(const PiiVariantList& results, int positionColumn);
+  template <class T> PiiVariant reduceScalars(const PiiVariantList& results, MergeFunction function);
+  template <class T> PiiVariant reduceMatrices(const PiiVariantList& results, MergeFunction function);
+  template <class T> static T reduce(MergeFunction function, T a, T b);
+
+  /// @internal
+  class Data :
+    public PiiDefaultOperation::Data,
+    public PiiInputController
+  {
+  public:
+    Data();
+    ~Data();
+
+    bool tryToReceive(PiiAbstractInputSocket* sender, const PiiVariant& object) throw ();
+
+    PiiInputSocket* pImageInput;
+    PiiOperationCompound* pPipeline;
+    int iTileWidth, iTileHeight, iOverlap, iWorkerCount;
+    QStringList lstMergeFunctionNames;
+    QVariantList lstPositionColumns;
+    QVector<MergeFunction> vecMergeFunctions;
+    QVector<int> vecPositionColumns;
+
+    QList<Worker> lstWorkers;
+    bool bWorkersRunning;
+    QList<Tile> lstTiles;
+
+    // Results are stored per worker and output, in arrival order.
+    QMutex resultMutex;
+    QWaitCondition resultCondition;
+    QHash<PiiAbstractInputSocket*, int> hashCollectors;
+    QVector<QQueue<PiiVariant> > vecResults;
+    int iReceivedCount;
+    QString strError;
+    bool bInterrupted;
+  };
+  PII_D_FUNC;
+};
+
+#endif //_PIITILEPROCESSOR_H
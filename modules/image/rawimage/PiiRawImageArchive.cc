@@ -0,0 +1,144 @@
+/* This file is part of Into.
+ * Copyright (C) Intopii 2013.
+ * All rights reserved.
+ *
+ * Licensees holding a commercial Into license may use this file in
+ * accordance with the commercial license agreement. Please see
+ * LICENSE.commercial for commercial licensing terms.
+ *
+ * Alternatively, this file may be used under the terms of the GNU
+ * Affero General Public License version 3 as published by the Free
+ * Software Foundation. In addition, Intopii gives you special rights
+ * to use Into as a part of open source software projects. Please
+ * refer to LICENSE.AGPL3 for details.
+ */
+
+#include "PiiRawImageArchive.h"
+#include "PiiRawImageArchiveFormat.h"
+
+#include <QFile>
+#include <PiiAtomicInt.h>
+
+struct PiiRawImageArchive::Mapping
+{
+  Mapping(const QString& fileName) : file(fileName), pData(0), iRefCount(1) {}
+  ~Mapping()
+  {
+    if (pData != 0)
+      file.unmap(pData);
+  }
+
+  QFile file;
+  uchar* pData;
+  PiiAtomicInt iRefCount;
+};
+
+struct PiiRawImageArchive::Entry : PiiRawImageArchiveFormat::IndexEntry {};
+
+PiiRawImageArchive::Data::Data(const QString& fileName) :
+  strFileName(fileName), pMapping(0), pEntries(0), iCount(0)
+{
+}
+
+PiiRawImageArchive::PiiRawImageArchive(const QString& fileName) :
+  d(new Data(fileName))
+{
+}
+
+PiiRawImageArchive::~PiiRawImageArchive()
+{
+  close();
+  delete d;
+}
+
+void PiiRawImageArchive::open()
+{
+  using namespace PiiRawImageArchiveFormat;
+  close();
+
+  Mapping* pMapping = new Mapping(d->strFileName);
+  if (!pMapping->file.open(QIODevice::ReadOnly))
+    {
+      delete pMapping;
+      PII_THROW(PiiException, QString("Cannot open %1.").arg(d->strFileName));
+    }
+
+  const qint64 iFileSize = pMapping->file.size();
+  if (iFileSize < qint64(sizeof(Header)) ||
+      (pMapping->pData = pMapping->file.map(0, iFileSize)) == 0)
+    {
+      delete pMapping;
+      PII_THROW(PiiException, QString("Cannot map %1 into memory.").arg(d->strFileName));
+    }
+  // The mapping stays valid after the file is closed.
+  pMapping->file.close();
+
+  const Header* pHeader = reinterpret_cast<const Header*>(pMapping->pData);
+  const quint64 iIndexEnd = pHeader->indexOffset + quint64(pHeader->entryCount) * sizeof(IndexEntry);
+  if (pHeader->magic != Header::magicValue ||
+      pHeader->version != Header::currentVersion ||
+      pHeader->indexOffset % sizeof(quint64) != 0 ||
+      iIndexEnd > quint64(iFileSize) ||
+      pHeader->entryCount > quint32(INT_MAX))
+    {
+      delete pMapping;
+      PII_THROW(PiiException, QString("%1 is not a valid raw image archive.").arg(d->strFileName));
+    }
+
+  const Entry* pEntries = reinterpret_cast<const Entry*>(pMapping->pData + pHeader->indexOffset);
+  for (quint32 i=0; i<pHeader->entryCount; ++i)
+    {
+      const Entry& e = pEntries[i];
+      if (e.rows < 0 || e.columns < 0 ||
+          e.offset + quint64(e.rows) * e.stride > pHeader->indexOffset)
+        {
+          delete pMapping;
+          PII_THROW(PiiException, QString("Entry %1 in %2 is corrupted.").arg(i).arg(d->strFileName));
+        }
+    }
+
+  d->pMapping = pMapping;
+  d->pEntries = pEntries;
+  d->iCount = int(pHeader->entryCount);
+}
+
+void PiiRawImageArchive::close()
+{
+  if (d->pMapping != 0)
+    releaseMapping(d->pMapping);
+  d->pMapping = 0;
+  d->pEntries = 0;
+  d->iCount = 0;
+}
+
+void PiiRawImageArchive::releaseMapping(void* context)
+{
+  Mapping* pMapping = static_cast<Mapping*>(context);
+  if (pMapping->iRefCount.deref() == 0)
+    delete pMapping;
+}
+
+const PiiRawImageArchive::Entry& PiiRawImageArchive::entry(int index) const
+{
+  if (index < 0 || index >= d->iCount)
+    PII_THROW(PiiException, QString("Matrix index %1 is out of range.").arg(index));
+  return d->pEntries[index];
+}
+
+const void* PiiRawImageArchive::payload(int index, std::size_t* stride, Mapping** mapping) const
+{
+  const Entry& e = entry(index);
+  *stride = e.stride;
+  // The matrix owns a reference until it is destroyed.
+  d->pMapping->iRefCount.ref();
+  *mapping = d->pMapping;
+  return d->pMapping->pData + e.offset;
+}
+
+bool PiiRawImageArchive::isOpen() const { return d->pMapping != 0; }
+int PiiRawImageArchive::count() const { return d->iCount; }
+unsigned int PiiRawImageArchive::typeAt(int index) const { return entry(index).type; }
+int PiiRawImageArchive::rowsAt(int index) const { return entry(index).rows; }
+int PiiRawImageArchive::columnsAt(int index) const { return entry(index).columns; }
+void PiiRawImageArchive::setFileName(const QString& fileName) { d->strFileName = fileName; }
+QString PiiRawImageArchive::fileName() const { return d->strFileName; }
@@ -0,0 +1,160 @@
+/* This file is part of Into.
+ * Copyright (C) Intopii 2013.
+ * All rights reserved.
+ *
+ * Licensees holding a commercial Into license may use this file in
+ * accordance with the commercial license agreement. Please see
+ * LICENSE.commercial for commercial licensing terms.
+ *
+ * Alternatively, this file may be used under the terms of the GNU
+ * Affero General Public License version 3 as published by the Free
+ * Software Foundation. In addition, Intopii gives you special rights
+ * to use Into as a part of open source software projects. Please
+ * refer to LICENSE.AGPL3 for details.
+ */
+
+#ifndef _PIIRAWIMAGEARCHIVE_H
+#define _PIIRAWIMAGEARCHIVE_H
+
+#include <QString>
+#include <PiiMatrix.h>
+#include <PiiYdinTypes.h>
+#include <PiiException.h>
+#include <PiiImageGlobal.h>
+
+/**
+ * Read access to a *piia* raw image archive. A piia archive stores a
+ * large number of matrices into a single file as uncompressed pixel
+ * data. It is intended for data sets that consist of many small
+ * images, for which opening and decoding individual image files
+ * would be a bottleneck. Archives are created with
+ * PiiRawImageArchiveBuilder.
+ *
+ * The archive is memory-mapped. Matrices returned by [matrixAt()]
+ * refer to the mapped memory directly: nothing is decoded or copied.
+ * The matrices are immutable; modifying one makes a deep copy. The
+ * mapping stays alive until the archive and all matrices referring
+ * to it have been destroyed.
+ *
+ * ~~~(c++)
+ * PiiRawImageArchive archive("crops.piia");
+ * archive.open();
+ * for (int i=0; i<archive.count(); ++i)
+ *   {
+ *     if (archive.typeAt(i) == PiiYdin::UnsignedCharMatrixType)
+ *       process(archive.matrixAt<unsigned char>(i));
+ *   }
+ * ~~~
+ *
+ * File format
+ * -----------
+ *
+ * All integers are stored in the native byte order of the writer,
+ * which is little-endian on all supported platforms.
+ *
+ * - Header (32 bytes): magic number 0x41494950 ("PIIA"), format
+ * version (1), payload alignment, the number of entries (all 32-bit),
+ * and the 64-bit offset of the index. The rest is reserved.
+ *
+ * - Payloads: the rows of each matrix, back to back. Each payload
+ * starts at an offset that is a multiple of the alignment.
+ *
+ * - Index (32 bytes per entry): 64-bit payload offset, 32-bit
+ * PiiVariant type ID, rows, columns and the number of bytes per row.
+ */
+class PII_IMAGE_EXPORT PiiRawImageArchive
+{
+public:
+  /**
+   * Creates an archive reader for *fileName*. The file will not be
+   * opened until [open()] is called.
+   */
+  PiiRawImageArchive(const QString& fileName = "");
+  ~PiiRawImageArchive();
+
+  void setFileName(const QString& fileName);
+  QString fileName() const;
+
+  /**
+   * Opens and maps the archive file and validates its index. If the
+   * archive is already open, it will be closed first.
+   *
+   * @exception PiiException& if the file cannot be opened or mapped,
+   * or if it is not a valid archive.
+   */
+  void open();
+
+  /**
+   * Releases the archive's reference to the mapped file. Matrices
+   * that still refer to the mapping stay valid.
+   */
+  void close();
+
+  /**
+   * Returns `true` if the archive is open.
+   */
+  bool isOpen() const;
+
+  /**
+   * Returns the number of matrices in the archive.
+   */
+  int count() const;
+
+  /**
+   * Returns the PiiVariant type ID of the matrix at *index*, e.g.
+   * PiiYdin::UnsignedCharMatrixType.
+   */
+  unsigned int typeAt(int index) const;
+  /**
+   * Returns the number of rows in the matrix at *index*.
+   */
+  int rowsAt(int index) const;
+  /**
+   * Returns the number of columns in the matrix at *index*.
+   */
+  int columnsAt(int index) const;
+
+  /**
+   * Returns the matrix at *index*. The returned matrix refers to the
+   * mapped file. *T* must match the stored type.
+   *
+   * @exception PiiException& if *T* does not match [typeAt()].
+   */
+  template <class T> PiiMatrix<T> matrixAt(int index) const;
+
+private:
+  struct Mapping;
+  struct Entry;
+
+  const Entry& entry(int index) const;
+  const void* payload(int index, std::size_t* stride, Mapping** mapping) const;
+  static void releaseMapping(void* context);
+
+  /// @internal
+  class Data
+  {
+  public:
+    Data(const QString& fileName);
+
+    QString strFileName;
+    Mapping* pMapping;
+    const Entry* pEntries;
+    int iCount;
+  } *d;
+
+  PII_DISABLE_COPY(PiiRawImageArchive);
+};
+
+template <class T> PiiMatrix<T> PiiRawImageArchive::matrixAt(int index) const
+{
+  if (typeAt(index) != Pii::typeId<PiiMatrix<T> >())
+    PII_THROW(PiiException, QString("Matrix %1 in %2 is not of the requested type.")
+              .arg(index).arg(d->strFileName));
+  Mapping* pMapping = 0;
+  std::size_t iStride = 0;
+  const void* pData = payload(index, &iStride, &pMapping);
+  return PiiMatrix<T>(rowsAt(index), columnsAt(index), static_cast<const T*>(pData),
+                      releaseMapping, pMapping, iStride);
+}
+
+#endif //_PIIRAWIMAGEARCHIVE_H
@@ -0,0 +1,143 @@
+/* This file is part of Into.
+ * Copyright (C) Intopii 2013.
+ * All rights reserved.
+ *
+ * Licensees holding a commercial Into license may use this file in
+ * accordance with the commercial license agreement. Please see
+ * LICENSE.commercial for commercial licensing terms.
+ *
+ * Alternatively, this file may be used under the terms of the GNU
+ * Affero General Public License version 3 as published by the Free
+ * Software Foundation. In addition, Intopii gives you special rights
+ * to use Into as a part of open source software projects. Please
+ * refer to LICENSE.AGPL3 for details.
+ */
+
+#include "PiiRawImageArchiveBuilder.h"
+#include "PiiRawImageArchiveFormat.h"
+
+#include <QFile>
+#include <QVector>
+
+using namespace PiiRawImageArchiveFormat;
+
+class PiiRawImageArchiveBuilder::Data
+{
+public:
+  Data(const QString& fileName, int alignment) :
+    file(fileName), iAlignment(alignment), iPosition(0)
+  {}
+
+  QFile file;
+  int iAlignment;
+  quint64 iPosition;
+  QVector<IndexEntry> vecEntries;
+};
+
+PiiRawImageArchiveBuilder::PiiRawImageArchiveBuilder(const QString& fileName, int alignment) :
+  d(new Data(fileName, 16))
+{
+  setAlignment(alignment);
+}
+
+PiiRawImageArchiveBuilder::~PiiRawImageArchiveBuilder()
+{
+  try { close(); } catch (PiiException&) {}
+  delete d;
+}
+
+void PiiRawImageArchiveBuilder::open()
+{
+  close();
+  if (!d->file.open(QIODevice::WriteOnly | QIODevice::Truncate))
+    PII_THROW(PiiException, QString("Cannot create %1.").arg(d->file.fileName()));
+  d->vecEntries.clear();
+  d->iPosition = 0;
+  // Reserve space for the header. The final one will be written by
+  // close().
+  Header header;
+  write(&header, sizeof(header));
+}
+
+void PiiRawImageArchiveBuilder::close()
+{
+  if (!d->file.isOpen())
+    return;
+
+  Header header;
+  header.alignment = quint32(d->iAlignment);
+  header.entryCount = quint32(d->vecEntries.size());
+  // Index entries contain 64-bit fields.
+  static const char padding[8] = { 0 };
+  write(padding, (sizeof(quint64) - d->iPosition % sizeof(quint64)) % sizeof(quint64));
+  header.indexOffset = d->iPosition;
+  write(d->vecEntries.constData(), qint64(d->vecEntries.size()) * sizeof(IndexEntry));
+
+  bool bSuccess = d->file.seek(0) &&
+    d->file.write(reinterpret_cast<const char*>(&header), sizeof(header)) == qint64(sizeof(header));
+  d->file.close();
+  if (!bSuccess)
+    PII_THROW(PiiException, QString("Cannot write the index to %1.").arg(d->file.fileName()));
+}
+
+void PiiRawImageArchiveBuilder::append(unsigned int type, int rows, int columns,
+                                       std::size_t bytesPerRow, const void* data, std::size_t stride)
+{
+  if (!d->file.isOpen())
+    PII_THROW(PiiException, QString("Raw image archive has not been opened."));
+
+  static const char padding[64] = { 0 };
+  qint64 iPadding = (d->iAlignment - d->iPosition % d->iAlignment) % d->iAlignment;
+  while (iPadding > 0)
+    {
+      qint64 iBytes = qMin(iPadding, qint64(sizeof(padding)));
+      write(padding, iBytes);
+      iPadding -= iBytes;
+    }
+
+  IndexEntry entry;
+  entry.offset = d->iPosition;
+  entry.type = type;
+  entry.rows = rows;
+  entry.columns = columns;
+  entry.stride = quint32(bytesPerRow);
+  entry.reserved = 0;
+
+  const char* pData = static_cast<const char*>(data);
+  // Contiguous rows can be written at once.
+  if (stride == bytesPerRow)
+    write(pData, qint64(rows) * bytesPerRow);
+  else
+    for (int r=0; r<rows; ++r, pData += stride)
+      write(pData, bytesPerRow);
+
+  d->vecEntries.append(entry);
+}
+
+void PiiRawImageArchiveBuilder::write(const void* data, qint64 bytes)
+{
+  const char* pData = static_cast<const char*>(data);
+  while (bytes > 0)
+    {
+      qint64 iWritten = d->file.write(pData, bytes);
+      if (iWritten <= 0)
+        PII_THROW(PiiException, QString("Cannot write to %1.").arg(d->file.fileName()));
+      bytes -= iWritten;
+      pData += iWritten;
+      d->iPosition += iWritten;
+    }
+}
+
+void PiiRawImageArchiveBuilder::setFileName(const QString& fileName) { d->file.setFileName(fileName); }
+QString PiiRawImageArchiveBuilder::fileName() const { return d->file.fileName(); }
+void PiiRawImageArchiveBuilder::setAlignment(int alignment)
+{
+  // Round up to the next power of two.
+  int iAlignment = 1;
+  while (iAlignment < alignment && iAlignment < 4096)
+    iAlignment <<= 1;
+  d->iAlignment = iAlignment;
+}
+int PiiRawImageArchiveBuilder::alignment() const { return d->iAlignment; }
+bool PiiRawImageArchiveBuilder::isOpen() const { return d->file.isOpen(); }
+int PiiRawImageArchiveBuilder::count() const { return d->vecEntries.size(); }
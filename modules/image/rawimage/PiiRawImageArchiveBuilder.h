@@ -0,0 +1,128 @@
+/* This file is part of Into.
+ * Copyright (C) Intopii 2013.
+ * All rights reserved.
+ *
+ * Licensees holding a commercial Into license may use this file in
+ * accordance with the commercial license agreement. Please see
+ * LICENSE.commercial for commercial licensing terms.
+ *
+ * Alternatively, this file may be used under the terms of the GNU
+ * Affero General Public License version 3 as published by the Free
+ * Software Foundation. In addition, Intopii gives you special rights
+ * to use Into as a part of open source software projects. Please
+ * refer to LICENSE.AGPL3 for details.
+ */
+
+#ifndef _PIIRAWIMAGEARCHIVEBUILDER_H
+#define _PIIRAWIMAGEARCHIVEBUILDER_H
+
+#include <QString>
+#include <PiiMatrix.h>
+#include <PiiYdinTypes.h>
+#include <PiiException.h>
+#include <PiiImageGlobal.h>
+
+/**
+ * Writes *piia* raw image archives. Matrices are appended to the file
+ * as they come. The index is written when the archive is closed; an
+ * archive that has not been closed cannot be read. See
+ * PiiRawImageArchive for a description of the format.
+ *
+ * ~~~(c++)
+ * PiiRawImageArchiveBuilder builder("crops.piia");
+ * builder.open();
+ * for (int i=0; i<lstCrops.size(); ++i)
+ *   builder.append(lstCrops[i]); // PiiMatrix<unsigned char>
+ * builder.close();
+ * ~~~
+ */
+class PII_IMAGE_EXPORT PiiRawImageArchiveBuilder
+{
+public:
+  /**
+   * Creates a builder that writes to *fileName*.
+   *
+   * @param alignment the start of each payload in the file will be a
+   * multiple of this many bytes. Since the file is mapped at a page
+   * boundary, this is also the alignment of the matrices in memory.
+   * The value will be rounded up to a power of two, at most 4096.
+   * The default is 16.
+   */
+  PiiRawImageArchiveBuilder(const QString& fileName = "", int alignment = 16);
+  /**
+   * Closes the archive.
+   */
+  ~PiiRawImageArchiveBuilder();
+
+  void setFileName(const QString& fileName);
+  QString fileName() const;
+
+  void setAlignment(int alignment);
+  int alignment() const;
+
+  /**
+   * Creates the archive file. An existing file will be overwritten.
+   *
+   * @exception PiiException& if the file cannot be created.
+   */
+  void open();
+
+  /**
+   * Writes the index and closes the file. Does nothing if the
+   * archive is not open.
+   *
+   * @exception PiiException& if the index cannot be written.
+   */
+  void close();
+
+  /**
+   * Returns `true` if the archive is open for writing.
+   */
+  bool isOpen() const;
+
+  /**
+   * Returns the number of matrices appended so far.
+   */
+  int count() const;
+
+  /**
+   * Appends *matrix* to the archive. *T* must be a type registered to
+   * PiiVariant.
+   *
+   * @exception PiiException& if the data cannot be written.
+   */
+  template <class T> void append(const PiiMatrix<T>& matrix)
+  {
+    append(Pii::typeId<PiiMatrix<T> >(), matrix.rows(), matrix.columns(),
+           matrix.columns() * sizeof(T), matrix.isEmpty() ? 0 : matrix.row(0), matrix.stride());
+  }
+
+  /**
+   * Appends a raw payload to the archive.
+   *
+   * @param type the PiiVariant type ID of the matrix
+   *
+   * @param rows the number of rows
+   *
+   * @param columns the number of columns
+   *
+   * @param bytesPerRow the number of bytes to write for each row
+   *
+   * @param data a pointer to the first row
+   *
+   * @param stride the distance between the beginnings of successive
+   * rows in `data`, in bytes
+   */
+  void append(unsigned int type, int rows, int columns,
+              std::size_t bytesPerRow, const void* data, std::size_t stride);
+
+private:
+  void write(const void* data, qint64 bytes);
+
+  class Data;
+  Data* d;
+
+  PII_DISABLE_COPY(PiiRawImageArchiveBuilder);
+};
+
+#endif //_PIIRAWIMAGEARCHIVEBUILDER_H
@@ -0,0 +1,56 @@
+/* This file is part of Into.
+ * Copyright (C) Intopii 2013.
+ * All rights reserved.
+ *
+ * Licensees holding a commercial Into license may use this file in
+ * accordance with the commercial license agreement. Please see
+ * LICENSE.commercial for commercial licensing terms.
+ *
+ * Alternatively, this file may be used under the terms of the GNU
+ * Affero General Public License version 3 as published by the Free
+ * Software Foundation. In addition, Intopii gives you special rights
+ * to use Into as a part of open source software projects. Please
+ * refer to LICENSE.AGPL3 for details.
+ */
+
+#ifndef _PIIRAWIMAGEARCHIVEFORMAT_H
+#define _PIIRAWIMAGEARCHIVEFORMAT_H
+
+#include <QtGlobal>
+
+/// @hide
+// On-disk structures of the piia format. See PiiRawImageArchive for
+// a description.
+namespace PiiRawImageArchiveFormat
+{
+  struct Header
+  {
+    enum { magicValue = 0x41494950, currentVersion = 1 };
+
+    Header() :
+      magic(magicValue), version(currentVersion),
+      alignment(16), entryCount(0),
+      indexOffset(0), reserved(0)
+    {}
+
+    quint32 magic;
+    quint32 version;
+    quint32 alignment;
+    quint32 entryCount;
+    quint64 indexOffset;
+    quint64 reserved;
+  };
+
+  struct IndexEntry
+  {
+    quint64 offset;
+    quint32 type;
+    qint32 rows;
+    qint32 columns;
+    quint32 stride;
+    quint64 reserved;
+  };
+}
+/// @endhide
+
+#endif //_PIIRAWIMAGEARCHIVEFORMAT_H
@@ -0,0 +1,93 @@
+/* This file is part of Into.
+ * Copyright (C) Intopii 2013.
+ * All rights reserved.
+ *
+ * Licensees holding a commercial Into license may use this file in
+ * accordance with the commercial license agreement. Please see
+ * LICENSE.commercial for commercial licensing terms.
+ *
+ * Alternatively, this file may be used under the terms of the GNU
+ * Affero General Public License version 3 as published by the Free
+ * Software Foundation. In addition, Intopii gives you special rights
+ * to use Into as a part of open source software projects. Please
+ * refer to LICENSE.AGPL3 for details.
+ */
+
+#include "PiiRawImageArchiveReader.h"
+#include <PiiYdinTypes.h>
+
+PiiRawImageArchiveReader::Data::Data() :
+  iRepeatCount(1),
+  iCurrentIndex(0)
+{
+}
+
+PiiRawImageArchiveReader::PiiRawImageArchiveReader() :
+  PiiDefaultOperation(new Data)
+{
+  setThreadCount(1);
+  PII_D;
+  addSocket(d->pTriggerInput = new PiiInputSocket("trigger"));
+  d->pTriggerInput->setOptional(true);
+
+  addSocket(d->pImageOutput = new PiiOutputSocket("image"));
+  addSocket(d->pIndexOutput = new PiiOutputSocket("index"));
+
+  setProtectionLevel("fileName", WriteWhenStopped);
+}
+
+void PiiRawImageArchiveReader::check(bool reset)
+{
+  PII_D;
+  PiiDefaultOperation::check(reset);
+  if (reset)
+    {
+      d->iCurrentIndex = 0;
+      d->archive.setFileName(d->strFileName);
+      try
+        {
+          d->archive.open();
+        }
+      catch (PiiException& ex)
+        {
+          PII_THROW(PiiExecutionException, tr("Cannot open raw image archive: %1").arg(ex.message()));
+        }
+      if (d->archive.count() == 0)
+        PII_THROW(PiiExecutionException, tr("%1 contains no images.").arg(d->strFileName));
+    }
+}
+
+void PiiRawImageArchiveReader::process()
+{
+  PII_D;
+  using namespace PiiYdin;
+
+  const int iCount = d->archive.count();
+  if (!d->pTriggerInput->isConnected() &&
+      d->iRepeatCount > 0 && d->iCurrentIndex >= qint64(d->iRepeatCount) * iCount)
+    operationStopped();
+
+  const int iIndex = int(d->iCurrentIndex % iCount);
+  switch (d->archive.typeAt(iIndex))
+    {
+      PII_PRIMITIVE_MATRIX_CASES(emitMatrix, iIndex);
+      PII_COLOR_IMAGE_CASES(emitMatrix, iIndex);
+    default:
+      PII_THROW(PiiExecutionException, tr("Image %1 in %2 is of an unsupported type.")
+                .arg(iIndex).arg(d->strFileName));
+    }
+  d->pIndexOutput->emitObject(iIndex);
+  ++d->iCurrentIndex;
+}
+
+template <class T> void PiiRawImageArchiveReader::emitMatrix(int index)
+{
+  PII_D;
+  d->pImageOutput->emitObject(d->archive.matrixAt<T>(index));
+}
+
+void PiiRawImageArchiveReader::setFileName(const QString& fileName) { _d()->strFileName = fileName; }
+QString PiiRawImageArchiveReader::fileName() const { return _d()->strFileName; }
+void PiiRawImageArchiveReader::setRepeatCount(int repeatCount) { _d()->iRepeatCount = repeatCount; }
+int PiiRawImageArchiveReader::repeatCount() const { return _d()->iRepeatCount; }
+int PiiRawImageArchiveReader::imageCount() const { return _d()->archive.count(); }
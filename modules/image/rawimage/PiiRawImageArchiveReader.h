@@ -0,0 +1,107 @@
+/* This file is part of Into.
+ * Copyright (C) Intopii 2013.
+ * All rights reserved.
+ *
+ * Licensees holding a commercial Into license may use this file in
+ * accordance with the commercial license agreement. Please see
+ * LICENSE.commercial for commercial licensing terms.
+ *
+ * Alternatively, this file may be used under the terms of the GNU
+ * Affero General Public License version 3 as published by the Free
+ * Software Foundation. In addition, Intopii gives you special rights
+ * to use Into as a part of open source software projects. Please
+ * refer to LICENSE.AGPL3 for details.
+ */
+
+#ifndef _PIIRAWIMAGEARCHIVEREADER_H
+#define _PIIRAWIMAGEARCHIVEREADER_H
+
+#include <PiiDefaultOperation.h>
+#include "PiiImageGlobal.h"
+#include "PiiRawImageArchive.h"
+
+/**
+ * Reads matrices from a *piia* raw image archive (see
+ * PiiRawImageArchive). The archive is memory-mapped, and the emitted
+ * matrices refer to the mapped file directly. Reading an image
+ * therefore costs no more than touching its pages, which makes the
+ * operation suitable for feeding large training sets that consist of
+ * millions of small images. Use PiiRawImageArchiveWriter to create
+ * archives.
+ *
+ * Emitted matrices are immutable. An operation that modifies its
+ * input in place will transparently make a copy.
+ *
+ * Inputs
+ * ------
+ *
+ * @in trigger - an optional trigger input. The next image is emitted
+ * whenever any object is received in this input.
+ *
+ * Outputs
+ * -------
+ *
+ * @out image - the image output. The type is the same as that of the
+ * matrix stored in the archive.
+ *
+ * @out index - the index of the emitted image within the archive
+ * (int).
+ *
+ */
+class PII_IMAGE_EXPORT PiiRawImageArchiveReader : public PiiDefaultOperation
+{
+  Q_OBJECT
+
+  /**
+   * The name of the archive file.
+   */
+  Q_PROPERTY(QString fileName READ fileName WRITE setFileName);
+
+  /**
+   * The number of times the images in the archive are emitted. 1
+   * means once, < 1 means eternally. This property has effect only if
+   * the `trigger` input is not connected. The default is 1.
+   */
+  Q_PROPERTY(int repeatCount READ repeatCount WRITE setRepeatCount);
+
+  /**
+   * The number of images in the archive. Zero if the operation has
+   * not been started.
+   */
+  Q_PROPERTY(int imageCount READ imageCount);
+
+  PII_OPERATION_SERIALIZATION_FUNCTION
+public:
+  PiiRawImageArchiveReader();
+
+  void check(bool reset);
+
+  void setFileName(const QString& fileName);
+  QString fileName() const;
+  void setRepeatCount(int repeatCount);
+  int repeatCount() const;
+  int imageCount() const;
+
+protected:
+  void process();
+
+private:
+  template <class T> void emitMatrix(int index);
+
+  /// @internal
+  class Data : public PiiDefaultOperation::Data
+  {
+  public:
+    Data();
+
+    PiiInputSocket* pTriggerInput;
+    PiiOutputSocket* pImageOutput, *pIndexOutput;
+    PiiRawImageArchive archive;
+    QString strFileName;
+    int iRepeatCount;
+    qint64 iCurrentIndex;
+  };
+  PII_D_FUNC;
+};
+
+#endif //_PIIRAWIMAGEARCHIVEREADER_H
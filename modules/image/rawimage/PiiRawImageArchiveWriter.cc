@@ -0,0 +1,111 @@
+/* This file is part of Into.
+ * Copyright (C) Intopii 2013.
+ * All rights reserved.
+ *
+ * Licensees holding a commercial Into license may use this file in
+ * accordance with the commercial license agreement. Please see
+ * LICENSE.commercial for commercial licensing terms.
+ *
+ * Alternatively, this file may be used under the terms of the GNU
+ * Affero General Public License version 3 as published by the Free
+ * Software Foundation. In addition, Intopii gives you special rights
+ * to use Into as a part of open source software projects. Please
+ * refer to LICENSE.AGPL3 for details.
+ */
+
+#include "PiiRawImageArchiveWriter.h"
+#include <PiiYdinTypes.h>
+
+PiiRawImageArchiveWriter::Data::Data() :
+  iAlignment(16)
+{
+}
+
+PiiRawImageArchiveWriter::PiiRawImageArchiveWriter() :
+  PiiDefaultOperation(new Data)
+{
+  setThreadCount(1);
+  PII_D;
+  addSocket(d->pImageInput = new PiiInputSocket("image"));
+
+  setProtectionLevel("fileName", WriteWhenStopped);
+  setProtectionLevel("alignment", WriteWhenStopped);
+
+  connect(this, SIGNAL(stateChanged(PiiOperation::State)),
+          SLOT(closeArchive(PiiOperation::State)),
+          Qt::DirectConnection);
+}
+
+void PiiRawImageArchiveWriter::check(bool reset)
+{
+  PII_D;
+  PiiDefaultOperation::check(reset);
+  if (reset)
+    {
+      if (d->strFileName.isEmpty())
+        PII_THROW(PiiExecutionException, tr("Raw image archive file name has not been set."));
+      d->builder.setFileName(d->strFileName);
+      d->builder.setAlignment(d->iAlignment);
+      try
+        {
+          d->builder.open();
+        }
+      catch (PiiException& ex)
+        {
+          PII_THROW(PiiExecutionException, ex.message());
+        }
+    }
+}
+
+void PiiRawImageArchiveWriter::process()
+{
+  PII_D;
+  using namespace PiiYdin;
+  PiiVariant obj = d->pImageInput->firstObject();
+
+  try
+    {
+      switch (obj.type())
+        {
+          PII_PRIMITIVE_MATRIX_CASES(writeMatrix, obj);
+          PII_COLOR_IMAGE_CASES(writeMatrix, obj);
+        default:
+          PII_THROW_UNKNOWN_TYPE(d->pImageInput);
+        }
+    }
+  catch (PiiExecutionException&)
+    {
+      throw;
+    }
+  catch (PiiException& ex)
+    {
+      PII_THROW(PiiExecutionException, ex.message());
+    }
+}
+
+template <class T> void PiiRawImageArchiveWriter::writeMatrix(const PiiVariant& obj)
+{
+  _d()->builder.append(obj.valueAs<PiiMatrix<T> >());
+}
+
+void PiiRawImageArchiveWriter::closeArchive(PiiOperation::State state)
+{
+  PII_D;
+  if (state == PiiOperation::Stopped)
+    {
+      try
+        {
+          d->builder.close();
+        }
+      catch (PiiException& ex)
+        {
+          piiWarning(ex.message());
+        }
+    }
+}
+
+void PiiRawImageArchiveWriter::setFileName(const QString& fileName) { _d()->strFileName = fileName; }
+QString PiiRawImageArchiveWriter::fileName() const { return _d()->strFileName; }
+void PiiRawImageArchiveWriter::setAlignment(int alignment) { _d()->iAlignment = alignment; }
+int PiiRawImageArchiveWriter::alignment() const { return _d()->iAlignment; }
+int PiiRawImageArchiveWriter::imageCount() const { return _d()->builder.count(); }
@@ -0,0 +1,93 @@
+/* This file is part of Into.
+ * Copyright (C) Intopii 2013.
+ * All rights reserved.
+ *
+ * Licensees holding a commercial Into license may use this file in
+ * accordance with the commercial license agreement. Please see
+ * LICENSE.commercial for commercial licensing terms.
+ *
+ * Alternatively, this file may be used under the terms of the GNU
+ * Affero General Public License version 3 as published by the Free
+ * Software Foundation. In addition, Intopii gives you special rights
+ * to use Into as a part of open source software projects. Please
+ * refer to LICENSE.AGPL3 for details.
+ */
+
+#ifndef _PIIRAWIMAGEARCHIVEWRITER_H
+#define _PIIRAWIMAGEARCHIVEWRITER_H
+
+#include <PiiDefaultOperation.h>
+#include "PiiImageGlobal.h"
+#include "PiiRawImageArchiveBuilder.h"
+
+/**
+ * Writes incoming images into a *piia* raw image archive (see
+ * PiiRawImageArchive). All images received between starting and
+ * stopping the operation go to a single file that is finalized when
+ * the operation stops. If the file already exists, it will be
+ * overwritten. Any primitive or color matrix type is accepted, and
+ * the type of each image is stored in the archive.
+ *
+ * Inputs
+ * ------
+ *
+ * @in image - the image to store. Any primitive or color matrix.
+ *
+ */
+class PII_IMAGE_EXPORT PiiRawImageArchiveWriter : public PiiDefaultOperation
+{
+  Q_OBJECT
+
+  /**
+   * The name of the archive file.
+   */
+  Q_PROPERTY(QString fileName READ fileName WRITE setFileName);
+
+  /**
+   * The alignment of images within the archive, in bytes. The value
+   * will be rounded up to a power of two. The default is 16.
+   */
+  Q_PROPERTY(int alignment READ alignment WRITE setAlignment);
+
+  /**
+   * The number of images written since the operation was last
+   * started.
+   */
+  Q_PROPERTY(int imageCount READ imageCount);
+
+  PII_OPERATION_SERIALIZATION_FUNCTION
+public:
+  PiiRawImageArchiveWriter();
+
+  void check(bool reset);
+
+  void setFileName(const QString& fileName);
+  QString fileName() const;
+  void setAlignment(int alignment);
+  int alignment() const;
+  int imageCount() const;
+
+protected:
+  void process();
+
+private slots:
+  void closeArchive(PiiOperation::State state);
+
+private:
+  template <class T> void writeMatrix(const PiiVariant& obj);
+
+  /// @internal
+  class Data : public PiiDefaultOperation::Data
+  {
+  public:
+    Data();
+
+    PiiInputSocket* pImageInput;
+    PiiRawImageArchiveBuilder builder;
+    QString strFileName;
+    int iAlignment;
+  };
+  PII_D_FUNC;
+};
+
+#endif //_PIIRAWIMAGEARCHIVEWRITER_H
@@ -16,6 +16,7 @@
 #include "PiiModbusIoDriver.h"
 #include <PiiModbusIoChannel.h>
 #include <errno.h>
+#include <QtAlgorithms>
 
 PiiModbusIoDriver::InstanceList PiiModbusIoDriver::_lstInstances;
 QMutex PiiModbusIoDriver::_instanceMutex;
@@ -216,3 +217,65 @@ int PiiModbusIoDriver::writeBit(int addr, int status)
   PII_D;
   return d->pHandle ? modbus_write_bit(d->pHandle, addr, status) : -1;
 }
+
+void PiiModbusIoDriver::checkInputStates(const QList<PiiIoChannel*>& inputs)
+{
+  QList<QPair<int,PiiModbusIoChannel*> > lstInputBits, lstBits;
+  QList<PiiIoChannel*> lstUnaddressed;
+  for (int i=0; i<inputs.size(); ++i)
+    {
+      PiiModbusIoChannel* pChannel = static_cast<PiiModbusIoChannel*>(inputs[i]);
+      if (pChannel->address() < 0)
+        lstUnaddressed << pChannel;
+      else if (pChannel->channelMode() == PiiDefaultIoChannel::Input)
+        lstInputBits << qMakePair(pChannel->address(), pChannel);
+      else if (pChannel->channelMode() == PiiDefaultIoChannel::Output)
+        lstBits << qMakePair(pChannel->address(), pChannel);
+    }
+  readRanges(lstInputBits, true);
+  readRanges(lstBits, false);
+  PiiDefaultIoDriver::checkInputStates(lstUnaddressed);
+}
+
+void PiiModbusIoDriver::readRanges(QList<QPair<int,PiiModbusIoChannel*> >& channels, bool inputBits)
+{
+  /* Reading a few unused bits in between is much cheaper than a
+   * separate round-trip. Addresses whose distance is at most
+   * iMaxGap are read with the same request.
+   */
+  static const int iMaxGap = 32;
+
+  qSort(channels);
+  uint8_t aBits[MODBUS_MAX_READ_BITS];
+  int iFirst = 0;
+  while (iFirst < channels.size())
+    {
+      const int iStartAddress = channels[iFirst].first;
+      int iLast = iFirst;
+      while (iLast+1 < channels.size() &&
+             channels[iLast+1].first - channels[iLast].first <= iMaxGap &&
+             channels[iLast+1].first - iStartAddress < MODBUS_MAX_READ_BITS)
+        ++iLast;
+
+      const int iCount = channels[iLast].first - iStartAddress + 1;
+      int iResult = inputBits ?
+        readInputBits(iStartAddress, iCount, aBits) :
+        readBits(iStartAddress, iCount, aBits);
+
+      if (iResult == iCount)
+        {
+          for (int i=iFirst; i<=iLast; ++i)
+            channels[i].second->updateInputState(aBits[channels[i].first - iStartAddress] == 1);
+        }
+      else
+        {
+          // Fall back to reading the channels one by one. This
+          // reports errors through the normal per-channel path.
+          QList<PiiIoChannel*> lstChannels;
+          for (int i=iFirst; i<=iLast; ++i)
+            lstChannels << channels[i].second;
+          PiiDefaultIoDriver::checkInputStates(lstChannels);
+        }
+      iFirst = iLast + 1;
+    }
+}
@@ -19,6 +19,7 @@
 #include "PiiDefaultIoDriver.h"
 #include "PiiModbusIoDriverGlobal.h"
 #include <PiiIoChannel.h>
+#include <QPair>
 
 #include <modbus.h>
 
@@ -28,6 +29,10 @@ class PiiModbusIoChannel;
  * An implementation of the PiiIoChannel-interface for Modbus I/O
  * driver.
  *
+ * Polled input channels are read in batches: the addresses of all
+ * polled channels are sorted, and nearby addresses are coalesced
+ * into range requests. Reading 64 consecutive digital inputs thus
+ * takes a single Modbus transaction instead of 64.
  */
 class PII_MODBUSIODRIVER_EXPORT PiiModbusIoDriver : public PiiDefaultIoDriver
 {
@@ -80,6 +85,8 @@ protected:
    */
   PiiIoChannel* createChannel(int channel);
 
+  void checkInputStates(const QList<PiiIoChannel*>& inputs);
+
 private:
   /// @internal
   class Data : public PiiDefaultIoDriver::Data
@@ -113,6 +120,7 @@ private:
   int readInputBits(int addr, int nb, uint8_t *dest);
   int readBits(int addr, int nb, uint8_t *dest);
   int writeBit(int addr, int status);
+  void readRanges(QList<QPair<int,PiiModbusIoChannel*> >& channels, bool inputBits);
 
   typedef QList<Instance> InstanceList;
   template <class T> static InstanceList::iterator findInstance(const T& value);
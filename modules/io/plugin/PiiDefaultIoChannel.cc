@@ -15,8 +15,7 @@
 
 #include "PiiDefaultIoChannel.h"
 #include "PiiDefaultIoDriver.h"
-#include <QDateTime>
-#include <QTime>
+#include <PiiTimer.h>
 
 PiiDefaultIoChannel::Data::Data() :
   pDriver(0),
@@ -75,14 +74,19 @@ void PiiDefaultIoChannel::setChannelMode(const ChannelMode& channelMode)
 void PiiDefaultIoChannel::setSignalEnabled(bool enabled)
 {
   d->pDriver->removePollingInput(this);
-  if (enabled)
+  d->pDriver->setInputNotificationEnabled(this, false);
+  // Poll only if the driver cannot notify us.
+  if (enabled && !d->pDriver->setInputNotificationEnabled(this, true))
     d->pDriver->addPollingInput(this);
 }
 
 void PiiDefaultIoChannel::checkInputState()
 {
-  bool bState = currentState();
+  updateInputState(currentState());
+}
 
+void PiiDefaultIoChannel::updateInputState(bool bState)
+{
   if (d->iPreviousInputState == -1)
     {
       d->iPreviousInputState = int(bState);
@@ -99,12 +103,34 @@ void PiiDefaultIoChannel::checkInputState()
 }
 
 void PiiDefaultIoChannel::activate()
+{
+  activateAt(PiiTimer::currentTime() + qint64(d->iPulseDelay) * 1000);
+}
+
+void PiiDefaultIoChannel::activateAt(qint64 time)
 {
   if (d->pDriver != 0 && d->channelMode == Output)
-    {
-      qint64 time = QDateTime::currentDateTime().addMSecs(d->iPulseDelay).toMSecsSinceEpoch();
-      d->pDriver->sendSignal(this, d->bActiveState, time, d->iPulseWidth);
-    }
+    d->pDriver->sendSignal(this, d->bActiveState, time, d->iPulseWidth);
+}
+
+int PiiDefaultIoChannel::firingCount() const
+{
+  return d->pDriver->firingStatistics(const_cast<PiiDefaultIoChannel*>(this)).iFiringCount;
+}
+
+int PiiDefaultIoChannel::lateFiringCount() const
+{
+  return d->pDriver->firingStatistics(const_cast<PiiDefaultIoChannel*>(this)).iLateFiringCount;
+}
+
+int PiiDefaultIoChannel::maxLateness() const
+{
+  return int(d->pDriver->firingStatistics(const_cast<PiiDefaultIoChannel*>(this)).iMaxLateness);
+}
+
+void PiiDefaultIoChannel::resetFiringStatistics()
+{
+  d->pDriver->resetFiringStatistics(this);
 }
 
 void PiiDefaultIoChannel::initializeChannel()
@@ -90,6 +90,24 @@ class PII_IO_EXPORT PiiDefaultIoChannel : public PiiIoChannel
    */
   Q_PROPERTY(bool currentState READ currentState);
 
+  /**
+   * The number of output signals fired on this channel since the
+   * last [resetFiringStatistics()] call.
+   */
+  Q_PROPERTY(int firingCount READ firingCount);
+
+  /**
+   * The number of output signals fired more than 0.5 ms later than
+   * scheduled.
+   */
+  Q_PROPERTY(int lateFiringCount READ lateFiringCount);
+
+  /**
+   * The largest difference between the actual and the scheduled
+   * firing time of an output signal, in microseconds.
+   */
+  Q_PROPERTY(int maxLateness READ maxLateness);
+
 public:
   ~PiiDefaultIoChannel();
 
@@ -106,6 +124,16 @@ public:
 
   void checkInputState();
   void activate();
+  void activateAt(qint64 time);
+
+  /**
+   * Compares *state* to the previously known state of the channel
+   * and emits [inputStateChanged()] if needed. [checkInputState()]
+   * calls this function with the value returned by
+   * [currentState()]. Drivers that read many channels at once or
+   * get notified of input changes pass the new state directly.
+   */
+  void updateInputState(bool state);
 
   /**
    * Returns a pointer to the I/O driver that owns this channel.
@@ -132,6 +160,15 @@ public:
 
   int channelIndex() const;
 
+  int firingCount() const;
+  int lateFiringCount() const;
+  int maxLateness() const;
+
+  /**
+   * Clears the firing statistics of this channel.
+   */
+  void resetFiringStatistics();
+
   /**
    * Initialize channel. Default Implementation does nothing.
    */
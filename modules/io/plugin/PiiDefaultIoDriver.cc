@@ -97,6 +97,19 @@ void PiiDefaultIoDriver::sendSignal(PiiIoChannel *channel, bool value, qint64 ti
     _pSendingThread->sendSignal(channel,value,time,pulseWidth);
 }
 
+PiiIoThread::FiringStatistics PiiDefaultIoDriver::firingStatistics(PiiIoChannel *channel) const
+{
+  if (_pSendingThread != 0)
+    return _pSendingThread->firingStatistics(channel);
+  return PiiIoThread::FiringStatistics();
+}
+
+void PiiDefaultIoDriver::resetFiringStatistics(PiiIoChannel *channel)
+{
+  if (_pSendingThread != 0)
+    _pSendingThread->resetFiringStatistics(channel);
+}
+
 PiiIoChannel* PiiDefaultIoDriver::channel(int channel)
 {
   if (channel >= 0)
@@ -126,10 +139,29 @@ int PiiDefaultIoDriver::channelCount() const
 void PiiDefaultIoDriver::addPollingInput(PiiIoChannel *input)
 {
   if (_pSendingThread)
-    _pSendingThread->addPollingInput(input);
+    _pSendingThread->addPollingInput(this, input);
 }
 void PiiDefaultIoDriver::removePollingInput(PiiIoChannel *input)
 {
   if (_pSendingThread)
     _pSendingThread->removePollingInput(input);
 }
+
+void PiiDefaultIoDriver::checkInputStates(const QList<PiiIoChannel*>& inputs)
+{
+  for (int i=0; i<inputs.size(); ++i)
+    {
+      try
+        {
+          inputs[i]->checkInputState();
+        }
+      catch (PiiException&)
+        {
+        }
+    }
+}
+
+bool PiiDefaultIoDriver::setInputNotificationEnabled(PiiIoChannel*, bool)
+{
+  return false;
+}
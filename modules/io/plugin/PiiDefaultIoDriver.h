@@ -52,6 +52,28 @@ protected:
    */
   virtual PiiIoChannel* createChannel(int channel) = 0;
 
+  /**
+   * Checks the states of all polled *inputs* belonging to this
+   * driver. This function is called periodically by the polling
+   * thread. The default implementation calls
+   * [PiiIoChannel::checkInputState()] for each input in turn.
+   * Drivers that are able to read many channels with a single
+   * request should override this function and pass the results to
+   * [PiiDefaultIoChannel::updateInputState()].
+   */
+  virtual void checkInputStates(const QList<PiiIoChannel*>& inputs);
+
+  /**
+   * Enables or disables edge-triggered notifications for *input*.
+   * Drivers whose hardware is able to signal input changes should
+   * override this function. Once enabled, the driver must call
+   * [PiiDefaultIoChannel::updateInputState()] whenever it gets
+   * notified of a change. If this function returns `false`, the
+   * input will be polled instead. The default implementation
+   * returns `false`.
+   */
+  virtual bool setInputNotificationEnabled(PiiIoChannel* input, bool enabled);
+
   class Data
   {
   public:
@@ -69,6 +91,7 @@ private slots:
 
 private:
   friend class PiiDefaultIoChannel;
+  friend class PiiIoThread;
 
   void init();
 
@@ -77,11 +100,14 @@ private:
    *
    * @param channel - the pointer to the output-channel
    * @param value - true = on, false = off
-   * @param time - msecs from 1970-01-01T00:00:00.000
+   * @param time - usecs on the PiiTimer::currentTime() clock
    * @param pulseWidth - pulse width in msecs.
    */
   void sendSignal(PiiIoChannel *channel, bool value, qint64 time, int pulseWidth);
 
+  PiiIoThread::FiringStatistics firingStatistics(PiiIoChannel *channel) const;
+  void resetFiringStatistics(PiiIoChannel *channel);
+
   /**
    * Add the input channel in the polling input list.
    */
@@ -53,6 +53,14 @@ public:
    */
   virtual void initializeChannel() = 0;
 
+  /**
+   * Activates an output channel at *time*, given in microseconds on
+   * the [PiiTimer::currentTime()] clock. Unlike [activate()], this
+   * function ignores any configured pulse delay. May throw
+   * PiiIoDriverException.
+   */
+  virtual void activateAt(qint64 time) = 0;
+
 
 public slots:
   /**
@@ -16,9 +16,12 @@
 #include "PiiIoOutputOperation.h"
 
 #include <PiiYdinTypes.h>
+#include <PiiTimer.h>
 #include "PiiIoDriverException.h"
 
-PiiIoOutputOperation::Data::Data()
+PiiIoOutputOperation::Data::Data() :
+  timeMode(RelativeTime),
+  dTimeScale(1000)
 {
 }
 
@@ -30,6 +33,8 @@ PiiIoOutputOperation::PiiIoOutputOperation() :
   addSocket(d->pChannelInput = new PiiInputSocket("channel"));
   addSocket(d->pValueInput = new PiiInputSocket("value"));
   d->pValueInput->setOptional(true);
+  addSocket(d->pTimeInput = new PiiInputSocket("time"));
+  d->pTimeInput->setOptional(true);
 }
 
 PiiIoOutputOperation::~PiiIoOutputOperation()
@@ -45,6 +50,27 @@ QVariantList PiiIoOutputOperation::pulseWidths() const
   return lstWidths;
 }
 
+int PiiIoOutputOperation::sumProperty(const char* property) const
+{
+  const PII_D;
+  int iSum = 0;
+  for (int i=0; i<d->lstChannels.size(); ++i)
+    iSum += d->lstChannels[i]->property(property).toInt();
+  return iSum;
+}
+
+int PiiIoOutputOperation::firingCount() const { return sumProperty("firingCount"); }
+int PiiIoOutputOperation::lateFiringCount() const { return sumProperty("lateFiringCount"); }
+
+int PiiIoOutputOperation::maxLateness() const
+{
+  const PII_D;
+  int iMax = 0;
+  for (int i=0; i<d->lstChannels.size(); ++i)
+    iMax = qMax(iMax, d->lstChannels[i]->property("maxLateness").toInt());
+  return iMax;
+}
+
 void PiiIoOutputOperation::setChannelState(int channel, bool value)
 {
   // PENDING stateLock() ?
@@ -71,7 +97,7 @@ void PiiIoOutputOperation::setChannelState(int channel, bool value)
     }
 }
 
-void PiiIoOutputOperation::activateChannel(int channel)
+void PiiIoOutputOperation::activateChannel(int channel, qint64 time)
 {
   PII_D;
   if (d->bEnabled && channel >= 0 && channel < d->lstChannels.size())
@@ -81,7 +107,10 @@ void PiiIoOutputOperation::activateChannel(int channel)
         {
           try
             {
-              d->lstChannels[channel]->activate();
+              if (time < 0)
+                d->lstChannels[channel]->activate();
+              else
+                d->lstChannels[channel]->activateAt(time);
               return;
             }
           catch (PiiIoDriverException &ex)
@@ -98,10 +127,18 @@ void PiiIoOutputOperation::process()
   PII_D;
   if (!d->pValueInput->isConnected() || PiiYdin::convertPrimitiveTo<bool>(d->pValueInput))
     {
+      qint64 iTime = -1;
+      if (d->pTimeInput->isConnected())
+        {
+          iTime = qint64(PiiYdin::primitiveAs<double>(d->pTimeInput) * d->dTimeScale);
+          if (d->timeMode == RelativeTime)
+            iTime += PiiTimer::currentTime();
+        }
+
       PiiVariant obj(d->pChannelInput->firstObject());
       if (obj.type() == PiiVariant::IntType)
         {
-          activateChannel(obj.valueAs<int>());
+          activateChannel(obj.valueAs<int>(), iTime);
         }
       if (obj.type() == PiiYdin::IntMatrixType)
         {
@@ -111,12 +148,12 @@ void PiiIoOutputOperation::process()
           if (matIndices.columns() == 1)
             {
               for (int r=0; r<matIndices.rows(); ++r)
-                activateChannel(matIndices(r,0));
+                activateChannel(matIndices(r,0), iTime);
             }
           else if (matIndices.rows() == 1)
             {
               for (int c=0; c<matIndices.columns(); ++c)
-                activateChannel(matIndices(0,c));
+                activateChannel(matIndices(0,c), iTime);
             }
           else
             PII_THROW(PiiExecutionException,
@@ -124,3 +161,8 @@ void PiiIoOutputOperation::process()
         }
     }
 }
+
+void PiiIoOutputOperation::setTimeMode(TimeMode timeMode) { _d()->timeMode = timeMode; }
+PiiIoOutputOperation::TimeMode PiiIoOutputOperation::timeMode() const { return _d()->timeMode; }
+void PiiIoOutputOperation::setTimeScale(double timeScale) { _d()->dTimeScale = timeScale; }
+double PiiIoOutputOperation::timeScale() const { return _d()->dTimeScale; }
@@ -36,6 +36,16 @@
  * Connecting this input makes it possible to selectively
  * enable/disable I/O signals at run time.
  *
+ * @in time - an optional target firing time (any primitive number).
+ * If this input is connected, the channels will not be activated
+ * immediately. Instead, the I/O thread fires them at the given time
+ * independent of the timing of the processing pipeline. The value is
+ * multiplied by [timeScale] to obtain microseconds, and interpreted
+ * according to [timeMode]. The configured pulse delay of the
+ * channels is not applied. Encoder-based triggering can be
+ * implemented by converting the position of the target to a time
+ * before sending it to this input.
+ *
  */
 class PiiIoOutputOperation : public PiiIoOperation
 {
@@ -47,11 +57,59 @@ class PiiIoOutputOperation : public PiiIoOperation
    */
   Q_PROPERTY(QVariantList pulseWidths READ pulseWidths);
 
+  /**
+   * The interpretation of the values read from the `time` input. The
+   * default is `RelativeTime`.
+   */
+  Q_PROPERTY(TimeMode timeMode READ timeMode WRITE setTimeMode);
+  Q_ENUMS(TimeMode);
+
+  /**
+   * A multiplier that converts the values read from the `time` input
+   * to microseconds. The default value is 1000, which makes the
+   * input values milliseconds.
+   */
+  Q_PROPERTY(double timeScale READ timeScale WRITE setTimeScale);
+
+  /**
+   * The total number of output signals fired by the I/O thread on
+   * the configured channels.
+   */
+  Q_PROPERTY(int firingCount READ firingCount);
+
+  /**
+   * The number of output signals that were fired more than 0.5 ms
+   * after their scheduled time.
+   */
+  Q_PROPERTY(int lateFiringCount READ lateFiringCount);
+
+  /**
+   * The largest observed difference between the actual and the
+   * scheduled firing time on any configured channel, in
+   * microseconds.
+   */
+  Q_PROPERTY(int maxLateness READ maxLateness);
+
   PII_OPERATION_SERIALIZATION_FUNCTION
 public:
+  /**
+   * Ways of interpreting the `time` input.
+   *
+   * - `RelativeTime` - the value is a delay from the moment the
+   * object is processed.
+   * - `AbsoluteTime` - the value is a point of time on the monotonic
+   * clock returned by [PiiTimer::currentTime()].
+   */
+  enum TimeMode { RelativeTime, AbsoluteTime };
+
   PiiIoOutputOperation();
   ~PiiIoOutputOperation();
 
+  void setTimeMode(TimeMode timeMode);
+  TimeMode timeMode() const;
+  void setTimeScale(double timeScale);
+  double timeScale() const;
+
 public slots:
   /**
    * Sets the state of *channel* to *value*.
@@ -62,9 +120,13 @@ protected:
   void process();
 
   QVariantList pulseWidths() const;
+  int firingCount() const;
+  int lateFiringCount() const;
+  int maxLateness() const;
 
 private:
-  void activateChannel(int channel);
+  void activateChannel(int channel, qint64 time);
+  int sumProperty(const char* property) const;
 
   /// @internal
   class Data : public PiiIoOperation::Data
@@ -72,7 +134,9 @@ private:
   public:
     Data();
 
-    PiiInputSocket *pChannelInput, *pValueInput;
+    PiiInputSocket *pChannelInput, *pValueInput, *pTimeInput;
+    TimeMode timeMode;
+    double dTimeScale;
   };
   PII_D_FUNC;
 };
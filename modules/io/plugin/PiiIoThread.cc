@@ -14,9 +14,10 @@
  */
 
 #include "PiiIoThread.h"
-#include <PiiDelay.h>
-#include <QDateTime>
+#include <PiiTimer.h>
+#include <PiiSynchronized.h>
 #include "PiiIoDriverException.h"
+#include "PiiDefaultIoDriver.h"
 
 PiiIoThread::PiiIoThread(QObject *parent) : QThread(parent), _bRunning(true)
 {
@@ -25,51 +26,110 @@ PiiIoThread::PiiIoThread(QObject *parent) : QThread(parent), _bRunning(true)
 void PiiIoThread::run()
 {
   setPriority(TimeCriticalPriority);
+  qint64 iNextPollingTime = 0;
+  _mutex.lock();
   while (_bRunning)
     {
-      _mutex.lock();
+      if (PiiTimer::currentTime() >= iNextPollingTime)
+        {
+          pollInputs();
+          iNextPollingTime = PiiTimer::currentTime() + pollingInterval;
+        }
+
+      fireOutputs();
 
-      for (int i=_lstPollingInputs.size(); i--; )
+      qint64 iNextEventTime = qMin(iNextPollingTime, nextOutputTime());
+      qint64 iTimeLeft = iNextEventTime - PiiTimer::currentTime();
+      if (iTimeLeft > spinTime)
+        // Wake up a bit early and spin the rest. sendSignal() wakes
+        // us up if a new output is scheduled.
+        _eventCondition.wait(&_mutex, (unsigned long)((iTimeLeft - spinTime) / 1000));
+      else if (iTimeLeft > 0)
+        {
+          _mutex.unlock();
+          while (PiiTimer::currentTime() < iNextEventTime && _bRunning)
+            yieldCurrentThread();
+          _mutex.lock();
+        }
+    }
+  _mutex.unlock();
+}
+
+void PiiIoThread::stop()
+{
+  synchronized (_mutex)
+    {
+      _bRunning = false;
+      _eventCondition.wakeAll();
+    }
+}
+
+void PiiIoThread::pollInputs()
+{
+  for (int i=_lstPollingGroups.size(); i--; )
+    {
+      try
+        {
+          _lstPollingGroups[i].pDriver->checkInputStates(_lstPollingGroups[i].lstInputs);
+        }
+      catch (PiiException &ex)
+        {
+        }
+    }
+}
+
+void PiiIoThread::fireOutputs()
+{
+  int size = _lstWaitingOutputSignals.size();
+
+  //handle all current output structs
+  for (int i=0; i<size; i++)
+    {
+      OutputSignal& stru = _lstWaitingOutputSignals[i];
+      qint64 iLateness = PiiTimer::currentTime() - stru.time;
+      if (iLateness >= 0)
         {
           try
             {
-              _lstPollingInputs[i]->checkInputState();
+              stru.channel->setOutputState(stru.active);
             }
           catch (PiiException &ex)
             {
             }
-        }
-
-      //HANDLE OUTPUTS ->
-      qint64 currentTime = QDateTime::currentDateTime().toMSecsSinceEpoch();
-      int size = _lstWaitingOutputSignals.size();
+          stru.handled = true;
 
-      //handle all current output structs
-      for (int i=0; i<size; i++)
-        {
-          OutputSignal stru = _lstWaitingOutputSignals[i];
-          if (currentTime > stru.time)
-            {
-              try
-                {
-                  stru.channel->setOutputState(stru.active);
-                }
-              catch (PiiException &ex)
-                {
-                }
-              _lstWaitingOutputSignals[i].handled = true;
-            }
+          FiringStatistics& stats = _hashStatistics[stru.channel];
+          ++stats.iFiringCount;
+          if (iLateness > lateThreshold)
+            ++stats.iLateFiringCount;
+          if (iLateness > stats.iMaxLateness)
+            stats.iMaxLateness = iLateness;
         }
+    }
+
+  //remove all handled output structs
+  for (int i=_lstWaitingOutputSignals.size(); i--; )
+    if (_lstWaitingOutputSignals[i].handled)
+      _lstWaitingOutputSignals.removeAt(i);
+}
 
-      //remove all handled output structs
-      for (int i=_lstWaitingOutputSignals.size(); i--; )
-        if (_lstWaitingOutputSignals[i].handled)
-          _lstWaitingOutputSignals.removeAt(i);
+qint64 PiiIoThread::nextOutputTime() const
+{
+  qint64 iTime = Q_INT64_C(0x7fffffffffffffff);
+  for (int i=_lstWaitingOutputSignals.size(); i--; )
+    iTime = qMin(iTime, _lstWaitingOutputSignals[i].time);
+  return iTime;
+}
 
-      _mutex.unlock();
+PiiIoThread::FiringStatistics PiiIoThread::firingStatistics(PiiIoChannel *channel)
+{
+  synchronized (_mutex) return _hashStatistics.value(channel);
+  return FiringStatistics(); // suppresses bogus compiler warning
+}
 
-      PiiDelay::msleep(10);
-    }
+void PiiIoThread::resetFiringStatistics(PiiIoChannel *channel)
+{
+  synchronized (_mutex) _hashStatistics.remove(channel);
 }
 
 void PiiIoThread::removeOutputList(const QVector<PiiIoChannel*>& lstChannels)
@@ -98,6 +158,9 @@ void PiiIoThread::removeOutputList(const QVector<PiiIoChannel*>& lstChannels)
     if (_lstWaitingOutputSignals[i].handled)
       _lstWaitingOutputSignals.removeAt(i);
 
+  for (int i=0; i<lstChannels.size(); ++i)
+    _hashStatistics.remove(lstChannels[i]);
+
   _mutex.unlock();
 
 }
@@ -113,18 +176,33 @@ void PiiIoThread::addNewStruct(PiiIoChannel *channel, bool active, qint64 time,
   _lstWaitingOutputSignals << stru;
 }
 
-void PiiIoThread::addPollingInput(PiiIoChannel *input)
+void PiiIoThread::addPollingInput(PiiDefaultIoDriver *driver, PiiIoChannel *input)
 {
   _mutex.lock();
-  if (!_lstPollingInputs.contains(input))
-    _lstPollingInputs << input;
+  int i = 0;
+  for (; i<_lstPollingGroups.size(); ++i)
+    if (_lstPollingGroups[i].pDriver == driver)
+      break;
+  if (i == _lstPollingGroups.size())
+    {
+      PollingGroup group;
+      group.pDriver = driver;
+      _lstPollingGroups << group;
+    }
+  if (!_lstPollingGroups[i].lstInputs.contains(input))
+    _lstPollingGroups[i].lstInputs << input;
   _mutex.unlock();
 }
 
 void PiiIoThread::removePollingInput(PiiIoChannel *input)
 {
   _mutex.lock();
-  _lstPollingInputs.removeAll(input);
+  for (int i=_lstPollingGroups.size(); i--; )
+    {
+      _lstPollingGroups[i].lstInputs.removeAll(input);
+      if (_lstPollingGroups[i].lstInputs.isEmpty())
+        _lstPollingGroups.removeAt(i);
+    }
   _mutex.unlock();
 }
 
@@ -165,9 +243,9 @@ void PiiIoThread::sendSignal(PiiIoChannel *channel, bool active, qint64 time, in
                   break;
                 }
               else if(stru.time >= time &&
-                      stru.time <= (time + qint64(width)))
+                      stru.time <= (time + qint64(width)*1000))
                 {
-                  stru.time = time + qint64(width);
+                  stru.time = time + qint64(width)*1000;
                   bAddNew = false;
                   break;
                 }
@@ -177,8 +255,9 @@ void PiiIoThread::sendSignal(PiiIoChannel *channel, bool active, qint64 time, in
       if (bAddNew)
         {
           addNewStruct(channel, active, time, width);
-          addNewStruct(channel, !active, time + qint64(width), 0);
+          addNewStruct(channel, !active, time + qint64(width)*1000, 0);
         }
     }
+  _eventCondition.wakeOne();
   _mutex.unlock();
 }
@@ -19,13 +19,46 @@
 #include <QMutex>
 #include <QThread>
 #include <QVector>
+#include <QHash>
+#include <QWaitCondition>
 #include "PiiIoChannel.h"
 
+class PiiDefaultIoDriver;
+
+/**
+ * A high-priority thread that polls input channels and fires
+ * scheduled output signals. Between events, the thread sleeps on a
+ * wait condition. Once the next output is less than [spinTime]
+ * microseconds away, it yields in a busy loop instead, which keeps
+ * the firing jitter well below a millisecond.
+ */
 class PiiIoThread : public QThread
 {
   Q_OBJECT
 
 public:
+  /**
+   * Timing statistics of the signals fired on a channel. Lateness is
+   * the difference between the actual and the scheduled firing
+   * time, in microseconds.
+   */
+  struct FiringStatistics
+  {
+    FiringStatistics() : iFiringCount(0), iLateFiringCount(0), iMaxLateness(0) {}
+
+    int iFiringCount;
+    /// The number of signals fired more than [lateThreshold] late.
+    int iLateFiringCount;
+    qint64 iMaxLateness;
+  };
+
+  /// The lateness (in µs) above which a firing is considered late.
+  static const int lateThreshold = 500;
+  /// Outputs closer than this (in µs) are waited for in a busy loop.
+  static const int spinTime = 2000;
+  /// The interval (in µs) between two input polling rounds.
+  static const int pollingInterval = 10000;
+
   struct OutputSignal
   {
     bool handled;
@@ -38,11 +71,31 @@ public:
   PiiIoThread(QObject *parent = 0);
 
   void run();
-  void stop() { _bRunning = false; }
+  void stop();
 
+  /**
+   * Schedules *channel* to be set to *value* at *time*, given in
+   * microseconds on the [PiiTimer::currentTime()] clock. If
+   * *pulseWidth* (in milliseconds) is non-zero, the state will be
+   * reversed once the pulse is over.
+   */
   void sendSignal(PiiIoChannel *channel, bool value, qint64 time, int pulseWidth);
 
-  void addPollingInput(PiiIoChannel *input);
+  /**
+   * Returns the firing statistics of *channel*.
+   */
+  FiringStatistics firingStatistics(PiiIoChannel *channel);
+  /**
+   * Clears the firing statistics of *channel*.
+   */
+  void resetFiringStatistics(PiiIoChannel *channel);
+
+  /**
+   * Adds *input* to the list of polled inputs. Inputs are grouped by
+   * *driver*, which is given all of its inputs at once so that it
+   * can read them in as few requests as possible.
+   */
+  void addPollingInput(PiiDefaultIoDriver *driver, PiiIoChannel *input);
   void removePollingInput(PiiIoChannel *input);
 
   /**
@@ -54,11 +107,21 @@ public:
 private:
   bool needAppend(PiiIoChannel *channel, bool active, qint64 checkTime);
   void addNewStruct(PiiIoChannel *channel, bool active, qint64 time, int width);
+  void pollInputs();
+  void fireOutputs();
+  qint64 nextOutputTime() const;
 
-  bool _bRunning;
+  volatile bool _bRunning;
   QMutex _mutex;
+  QWaitCondition _eventCondition;
+  QHash<PiiIoChannel*,FiringStatistics> _hashStatistics;
   QList<OutputSignal> _lstWaitingOutputSignals;
-  QList<PiiIoChannel*> _lstPollingInputs;
+  struct PollingGroup
+  {
+    PiiDefaultIoDriver *pDriver;
+    QList<PiiIoChannel*> lstInputs;
+  };
+  QList<PollingGroup> _lstPollingGroups;
 };
 
 #endif //_PIIIOTHREAD_H
@@ -17,6 +17,12 @@
 # error "Never use <PiiFeaturePointMatcher-templates.h> directly; include <PiiFeaturePointMatcher.h> instead."
 #endif
 
+#include <PiiMath.h>
+#include <PiiSort.h>
+#include <QSet>
+#include <QVarLengthArray>
+#include <algorithm>
+
 template <class T, class SampleSet>
 PiiFeaturePointMatcher<T,SampleSet>::PiiFeaturePointMatcher() :
   d(new Data)
@@ -61,14 +67,26 @@ void PiiFeaturePointMatcher<T, SampleSet>::buildDatabase(const PiiMatrix<T>& poi
 
   d = d->createCleanCopy();
 
+  // Binary descriptors are searched with multi-index hashing.
+  if (PiiMatching::createHammingIndex(d->hammingIndex, features, measure))
+    {
+      d->modelFeatures = features;
+      d->pDistanceMeasure = measure;
+    }
+  // Compact features are searched linearly.
+  else if (d->bCompactFeatures)
+    {
+      storeCompactFeatures(features);
+      d->pDistanceMeasure = measure;
+    }
   // We are going to use the K-d tree only if the number of points is
   // much larger than the number of features. This limit would be way
   // too low if we performed exact search, but we won't.
-  if (measure == 0 && // K-d tree doesn't work in non-Euclidean spaces.
-      points.rows() > 2 * iFeatures)
+  else if (measure == 0 && // K-d tree doesn't work in non-Euclidean spaces.
+           points.rows() > 2 * iFeatures)
     {
       PiiSmartPtr<PiiKdTree<SampleSet> > pKdTree(new PiiKdTree<SampleSet>);
-      pKdTree->buildTree(features, controller); // may throw
+      pKdTree->buildTree(features, d->iKdTreeCount, controller); // may throw
       d->pKdTree = pKdTree.release();
     }
   else
@@ -78,6 +96,206 @@ void PiiFeaturePointMatcher<T, SampleSet>::buildDatabase(const PiiMatrix<T>& poi
     }
   d->matModelPoints = points;
   d->vecModelIndices = modelIndices;
+  storeModelSignatures(features, modelIndices);
+}
+
+template <class T, class SampleSet>
+void PiiFeaturePointMatcher<T,SampleSet>::storeCompactFeatures(const SampleSet& features)
+{
+  using namespace PiiSampleSet;
+  const int iSamples = sampleCount(features), iFeatures = featureCount(features);
+
+  d->matCompactFeatures = PiiMatrix<unsigned char>(iSamples, iFeatures);
+  d->vecFeatureOffsets.resize(iSamples);
+  d->vecFeatureScales.resize(iSamples);
+
+  for (int i=0; i<iSamples; ++i)
+    {
+      ConstFeatureIterator pFeatures = sampleAt(features, i);
+      unsigned char* pCompact = d->matCompactFeatures[i];
+      float fMin = INFINITY, fMax = -INFINITY;
+      for (int f=0; f<iFeatures; ++f)
+        {
+          fMin = qMin(fMin, float(pFeatures[f]));
+          fMax = qMax(fMax, float(pFeatures[f]));
+        }
+      // Each vector is scaled to the full 8-bit range.
+      const float fScale = (fMax - fMin) / 255;
+      d->vecFeatureOffsets[i] = fMin;
+      d->vecFeatureScales[i] = fScale;
+      if (fScale > 0)
+        for (int f=0; f<iFeatures; ++f)
+          pCompact[f] = (unsigned char)qBound(0, Pii::round<int>((float(pFeatures[f]) - fMin) / fScale), 255);
+    }
+}
+
+template <class T, class SampleSet>
+void PiiFeaturePointMatcher<T,SampleSet>::storeModelSignatures(const SampleSet& features,
+                                                               const QVector<int>& modelIndices)
+{
+  using namespace PiiSampleSet;
+  const int iSamples = sampleCount(features), iFeatures = featureCount(features);
+
+  // Assign a signature row to each distinct model index.
+  QHash<int,int> hashSignatureRows;
+  QVector<int> vecSampleRows(iSamples);
+  for (int i=0; i<iSamples; ++i)
+    {
+      const int iModelIndex = modelIndices.size() != 0 ? modelIndices[i] : 0;
+      int iRow = hashSignatureRows.value(iModelIndex, -1);
+      if (iRow == -1)
+        {
+          iRow = d->vecSignatureModels.size();
+          hashSignatureRows.insert(iModelIndex, iRow);
+          d->vecSignatureModels << iModelIndex;
+        }
+      vecSampleRows[i] = iRow;
+    }
+
+  // Signature = mean feature vector
+  d->matModelSignatures = PiiMatrix<double>(d->vecSignatureModels.size(), iFeatures);
+  QVector<int> vecCounts(d->vecSignatureModels.size());
+  for (int i=0; i<iSamples; ++i)
+    {
+      ConstFeatureIterator pFeatures = sampleAt(features, i);
+      double* pSignature = d->matModelSignatures[vecSampleRows[i]];
+      for (int f=0; f<iFeatures; ++f)
+        pSignature[f] += double(pFeatures[f]);
+      ++vecCounts[vecSampleRows[i]];
+    }
+  for (int r=0; r<vecCounts.size(); ++r)
+    Pii::mapN(d->matModelSignatures[r], iFeatures, std::bind2nd(std::multiplies<double>(), 1.0 / vecCounts[r]));
+}
+
+template <class T, class SampleSet>
+QVector<int> PiiFeaturePointMatcher<T,SampleSet>::prefilterModels(const SampleSet& features, int pointCount) const
+{
+  const int iModels = d->vecSignatureModels.size(), iFeatures = d->matModelSignatures.columns();
+  if (d->iModelPrefilterCount <= 0 || iModels <= d->iModelPrefilterCount ||
+      pointCount == 0 || PiiSampleSet::featureCount(features) != iFeatures)
+    return QVector<int>();
+
+  QVector<double> vecQuerySignature(iFeatures);
+  for (int i=0; i<pointCount; ++i)
+    {
+      ConstFeatureIterator pFeatures = PiiSampleSet::sampleAt(features, i);
+      for (int f=0; f<iFeatures; ++f)
+        vecQuerySignature[f] += double(pFeatures[f]);
+    }
+  for (int f=0; f<iFeatures; ++f)
+    vecQuerySignature[f] /= pointCount;
+
+  // Retain the models whose mean feature vector is closest to that
+  // of the query.
+  QVector<QPair<double,int> > vecDistances(iModels);
+  for (int r=0; r<iModels; ++r)
+    {
+      const double* pSignature = d->matModelSignatures[r];
+      double dDistance = 0;
+      for (int f=0; f<iFeatures; ++f)
+        {
+          const double dDiff = vecQuerySignature[f] - pSignature[f];
+          dDistance += dDiff * dDiff;
+        }
+      vecDistances[r] = qMakePair(dDistance, r);
+    }
+  Pii::selectSmallest(vecDistances.begin(), vecDistances.end(), d->iModelPrefilterCount);
+  QSet<int> setRetainedModels;
+  for (int i=0; i<d->iModelPrefilterCount; ++i)
+    setRetainedModels << d->vecSignatureModels[vecDistances[i].second];
+
+  // Collect the database points of the retained models in ascending
+  // order.
+  QVector<int> vecCandidates;
+  const int iSamples = d->matModelPoints.rows();
+  for (int i=0; i<iSamples; ++i)
+    if (setRetainedModels.contains(d->vecModelIndices.size() != 0 ? d->vecModelIndices[i] : 0))
+      vecCandidates << i;
+  return vecCandidates;
+}
+
+template <class T, class SampleSet>
+PiiClassification::MatchList PiiFeaturePointMatcher<T,SampleSet>::findClosestMatches(ConstFeatureIterator sample,
+                                                                                     const QVector<int>& candidates) const
+{
+  PiiClassification::MatchList lstMatches;
+  const bool bHashed = !d->hammingIndex.isEmpty();
+  if (d->pKdTree != 0 || bHashed)
+    {
+      if (bHashed)
+        lstMatches = PiiMatching::findHammingMatches(d->hammingIndex,
+                                                     sample,
+                                                     d->iClosestMatchCount);
+      else if (d->iMaxEvaluations > 0)
+        lstMatches = d->pKdTree->findClosestMatches(sample,
+                                                    d->iClosestMatchCount,
+                                                    d->iMaxEvaluations);
+      else
+        lstMatches = d->pKdTree->findClosestMatches(sample,
+                                                    d->iClosestMatchCount);
+      // The index cannot be limited to candidates. Drop the others.
+      if (!candidates.isEmpty())
+        {
+          QVarLengthArray<int,16> lstRetained;
+          for (int i=0; i<lstMatches.size(); ++i)
+            if (std::binary_search(candidates.begin(), candidates.end(), lstMatches[i].second))
+              lstRetained.append(i);
+          // Assigning in place keeps the ascending order.
+          PiiClassification::MatchList lstCandidateMatches;
+          lstCandidateMatches.fill(lstRetained.size(), qMakePair(0.0, -1));
+          for (int i=0; i<lstRetained.size(); ++i)
+            lstCandidateMatches[i] = lstMatches[lstRetained[i]];
+          return lstCandidateMatches;
+        }
+      return lstMatches;
+    }
+
+  const bool bCompact = !d->vecFeatureScales.isEmpty();
+  if (!bCompact && candidates.isEmpty())
+    {
+      if (d->pDistanceMeasure != 0)
+        return PiiClassification::findClosestMatches(sample,
+                                                     d->modelFeatures,
+                                                     *d->pDistanceMeasure,
+                                                     d->iClosestMatchCount);
+      return PiiClassification::findClosestMatches(sample,
+                                                   d->modelFeatures,
+                                                   d->squaredGeometricDistance,
+                                                   d->iClosestMatchCount);
+    }
+
+  // Exhaustive search among compact features and/or candidates.
+  const int iFeatures = bCompact ? d->matCompactFeatures.columns() : PiiSampleSet::featureCount(d->modelFeatures),
+    iSamples = !candidates.isEmpty() ? candidates.size() :
+    bCompact ? d->vecFeatureScales.size() : PiiSampleSet::sampleCount(d->modelFeatures);
+  lstMatches.fill(qMin(iSamples, d->iClosestMatchCount), qMakePair(double(INFINITY), -1));
+  if (lstMatches.size() == 0)
+    return lstMatches;
+
+  QVector<FeatureType> vecModel(bCompact ? iFeatures : 0);
+  for (int i=0; i<iSamples; ++i)
+    {
+      const int iSample = candidates.isEmpty() ? i : candidates[i];
+      ConstFeatureIterator pModel;
+      if (bCompact)
+        {
+          const unsigned char* pCompact = d->matCompactFeatures[iSample];
+          const float fOffset = d->vecFeatureOffsets[iSample], fScale = d->vecFeatureScales[iSample];
+          for (int f=0; f<iFeatures; ++f)
+            vecModel[f] = FeatureType(fOffset + fScale * pCompact[f]);
+          pModel = vecModel.constData();
+        }
+      else
+        pModel = PiiSampleSet::sampleAt(d->modelFeatures, iSample);
+
+      const double dDistance = d->pDistanceMeasure != 0 ?
+        PiiClassification::boundedDistance(*d->pDistanceMeasure, sample, pModel, iFeatures, lstMatches[0].first) :
+        PiiClassification::boundedDistance(d->squaredGeometricDistance, sample, pModel, iFeatures, lstMatches[0].first);
+      lstMatches.put(qMakePair(dDistance, iSample));
+    }
+  // Ascending order -> first is the best match
+  lstMatches.sort();
+  return lstMatches;
 }
 
 template <class T, class SampleSet>
@@ -85,6 +303,16 @@ template <class Matcher>
 PiiMatching::MatchList PiiFeaturePointMatcher<T,SampleSet>::findMatchingModels(const PiiMatrix<T>& points,
                                                                                const SampleSet& features,
                                                                                Matcher& matcher) const
+{
+  return findMatchingModels(Pii::ParallelExecution(1), points, features, matcher);
+}
+
+template <class T, class SampleSet>
+template <class Matcher>
+PiiMatching::MatchList PiiFeaturePointMatcher<T,SampleSet>::findMatchingModels(const Pii::ParallelExecution& policy,
+                                                                               const PiiMatrix<T>& points,
+                                                                               const SampleSet& features,
+                                                                               Matcher& matcher) const
 {
   PiiMatching::MatchList lstMatchedModels;
 
@@ -95,34 +323,21 @@ PiiMatching::MatchList PiiFeaturePointMatcher<T,SampleSet>::findMatchingModels(c
   const int iPoints = qMin(points.rows(), sampleCount(features)),
     iDimensions = points.columns();
 
+  // Reject unlikely models before searching point by point.
+  const QVector<int> vecCandidates(prefilterModels(features, iPoints));
+
+  // Find N closest matches for each point
+  QVector<PiiClassification::MatchList> vecMatches(iPoints);
+  if (iPoints > 0)
+    Pii::forEachBand(policy, iPoints, 0,
+                     ClosestMatchBand(this, features, vecCandidates, vecMatches.data()));
+
   typedef QHash<int, QList<QPair<int,int> > > MatchHash;
   MatchHash hashMatchIndices;
 
-  // Find N closest matches for each point
   for (int i=0; i<iPoints; ++i)
     {
-      PiiClassification::MatchList lstMatches;
-      if (d->pKdTree != 0)
-        {
-          if (d->iMaxEvaluations > 0)
-            lstMatches = d->pKdTree->findClosestMatches(sampleAt(features, i),
-                                                        d->iClosestMatchCount,
-                                                        d->iMaxEvaluations);
-          else
-            lstMatches = d->pKdTree->findClosestMatches(sampleAt(features, i),
-                                                        d->iClosestMatchCount);
-        }
-      else if (d->pDistanceMeasure != 0)
-        lstMatches = PiiClassification::findClosestMatches(sampleAt(features, i),
-                                                           d->modelFeatures,
-                                                           *d->pDistanceMeasure,
-                                                           d->iClosestMatchCount);
-      else
-        lstMatches = PiiClassification::findClosestMatches(sampleAt(features, i),
-                                                           d->modelFeatures,
-                                                           d->squaredGeometricDistance,
-                                                           d->iClosestMatchCount);
-
+      const PiiClassification::MatchList& lstMatches = vecMatches[i];
       // All matches that are good enough compared to the best one
       // will be accepted as candidates.
       for (int j=0; j<lstMatches.size(); ++j)
@@ -156,6 +371,8 @@ PiiMatching::MatchList PiiFeaturePointMatcher<T,SampleSet>::findMatchingModels(c
   // Sort according to match count (the candidate model with most
   // matches will be evaluated first)
   std::sort(lstCandidateModels.begin(), lstCandidateModels.end());
+  if (lstCandidateModels.isEmpty())
+    return lstMatchedModels;
 
   PiiMatrix<T> matQueryPoints(0,iDimensions), matModelPoints(0,iDimensions);
 
@@ -21,6 +21,8 @@
 #include <PiiDistanceMeasure.h>
 #include <PiiKdTree.h>
 #include <PiiClassification.h>
+#include <PiiHammingDistance.h>
+#include <PiiMultiIndexHash.h>
 #include <PiiSharedD.h>
 
 #include <QList>
@@ -175,10 +177,48 @@ namespace PiiMatching
  * ~~~
  *
  */
+/// @hide
+namespace PiiMatching
+{
+  // Binary descriptors can be indexed only if they are compared with
+  // the Hamming distance. The overloads for unsigned int descriptors
+  // are preferred over these catch-all templates.
+  template <class SampleSet, class Measure>
+  inline bool createHammingIndex(PiiMultiIndexHash&, const SampleSet&, Measure*)
+  {
+    return false;
+  }
+
+  inline bool createHammingIndex(PiiMultiIndexHash& index,
+                                 const PiiMatrix<unsigned int>& features,
+                                 PiiDistanceMeasure<const unsigned int*>* measure)
+  {
+    typedef PiiDistanceMeasure<const unsigned int*>::Impl<PiiHammingDistance<const unsigned int*> > HammingMeasure;
+    if (dynamic_cast<HammingMeasure*>(measure) == 0)
+      return false;
+    index.buildIndex(features);
+    return true;
+  }
+
+  template <class FeatureIterator>
+  inline PiiClassification::MatchList findHammingMatches(const PiiMultiIndexHash&, FeatureIterator, int)
+  {
+    return PiiClassification::MatchList();
+  }
+
+  inline PiiClassification::MatchList findHammingMatches(const PiiMultiIndexHash& index,
+                                                         const unsigned int* sample,
+                                                         int n)
+  {
+    return index.findClosestMatches(sample, n);
+  }
+}
+/// @endhide
+
 template <class T, class SampleSet> class PiiFeaturePointMatcher
 {
   friend struct PiiSerialization::Accessor;
-  template <class Archive> void serialize(Archive& archive, const unsigned int /*version*/)
+  template <class Archive> void serialize(Archive& archive, const unsigned int version)
   {
     archive & PII_NVP("points", d->matModelPoints);
     archive & PII_NVP("kdTree", d->pKdTree);
@@ -188,9 +228,20 @@ template <class T, class SampleSet> class PiiFeaturePointMatcher
     archive & PII_NVP("mode", PII_ENUM(d->matchingMode));
     archive & PII_NVP("closestMatches", d->iClosestMatchCount);
     archive & PII_NVP("maxEvaluations", d->iMaxEvaluations);
+    if (version > 0)
+      {
+        archive & PII_NVP("compactFeatures", d->matCompactFeatures);
+        archive & PII_NVP("featureOffsets", d->vecFeatureOffsets);
+        archive & PII_NVP("featureScales", d->vecFeatureScales);
+        archive & PII_NVP("compact", d->bCompactFeatures);
+        archive & PII_NVP("signatures", d->matModelSignatures);
+        archive & PII_NVP("signatureModels", d->vecSignatureModels);
+        archive & PII_NVP("prefilterCount", d->iModelPrefilterCount);
+      }
   }
 public:
   typedef typename PiiSampleSet::Traits<SampleSet>::ConstFeatureIterator ConstFeatureIterator;
+  typedef typename PiiSampleSet::Traits<SampleSet>::FeatureType FeatureType;
 
   PiiFeaturePointMatcher();
   PiiFeaturePointMatcher(const PiiFeaturePointMatcher& other);
@@ -204,7 +255,14 @@ public:
    * *features* for linear search or builds a [K-d tree](PiiKdtree),
    * which will be later used for quick queries. The most suitable
    * search technique is determined by the number of points and
-   * features.
+   * features. If [compactFeatures()] is enabled, the features are
+   * quantized and always searched linearly.
+   *
+   * The mean feature vector of each model is stored as a coarse
+   * signature of the model. The signatures are used by
+   * [findMatchingModels()] to reject unlikely models before the
+   * closest matches of each point are searched. See
+   * [setModelPrefilterCount()].
    *
    * @param points the locations of feature points with respect to the
    * model the point belongs to.
@@ -227,7 +285,11 @@ public:
    * the feature space is non-Euclidean. Note that the K-d tree will
    * not be used for queries if a custom distance measure is
    * provided. PiiFeaturePointMatcher takes the ownership of the
-   * measure.
+   * measure. If *features* is a PiiMatrix<unsigned int> containing
+   * binary descriptors (see PiiRandomLbp) and *measure* is a
+   * PiiHammingDistance, the descriptors will be indexed with a
+   * PiiMultiIndexHash, which makes exact queries sub-linear in the
+   * number of points. Compact storage is not used in this case.
    *
    * @exception PiiClassificationException& if the tree building
    * process was interrupted or if there is a non-equal number of
@@ -297,6 +359,19 @@ public:
                                             const SampleSet& features,
                                             Matcher& matcher) const;
 
+  /**
+   * Matches *points* to the database in parallel. The closest matches
+   * of the query points are searched in bands as determined by
+   * *policy*. The candidate models are verified with *matcher* in the
+   * calling thread. The result is equal to that of the serial
+   * version.
+   */
+  template <class Matcher>
+  PiiMatching::MatchList findMatchingModels(const Pii::ParallelExecution& policy,
+                                            const PiiMatrix<T>& points,
+                                            const SampleSet& features,
+                                            Matcher& matcher) const;
+
   /**
    * Sets the matching mode. If the matching mode is set to
    * `MatchOneModel`, the search for matching models will be finished
@@ -355,14 +430,86 @@ public:
    */
   int maxEvaluations() const { return d->iMaxEvaluations; }
 
+  /**
+   * Sets the number of randomized k-d trees built for approximate
+   * search. See PiiKdTree::buildTree(). A forest of trees improves the
+   * recall of the approximate search at a given [maxEvaluations()]
+   * with high-dimensional features. The value takes effect when the
+   * model database is built next time.
+   */
+  void setKdTreeCount(int kdTreeCount)
+  {
+    if (kdTreeCount != d->iKdTreeCount)
+      {
+        detach();
+        d->iKdTreeCount = qMax(1, kdTreeCount);
+      }
+  }
+  /**
+   * Returns the number of k-d trees. The default is 1.
+   */
+  int kdTreeCount() const { return d->iKdTreeCount; }
+
+  /**
+   * Enables or disables compact feature storage. If this flag is
+   * `true`, [buildDatabase()] quantizes each feature vector to 8 bits
+   * with its own offset and scale factor. With `float` features, this
+   * reduces the memory needed to store the database to about a
+   * quarter. Distances are calculated to the restored feature
+   * vectors, which differ from the original ones by at most half a
+   * quantization step. Compact storage disables the K-d tree. The
+   * value takes effect when the model database is built next time.
+   */
+  void setCompactFeatures(bool compactFeatures)
+  {
+    if (compactFeatures != d->bCompactFeatures)
+      {
+        detach();
+        d->bCompactFeatures = compactFeatures;
+      }
+  }
+  /**
+   * Returns `true` if feature vectors are stored in compact form. The
+   * default is `false`.
+   */
+  bool compactFeatures() const { return d->bCompactFeatures; }
+
+  /**
+   * Sets the number of models retained by the coarse model
+   * pre-filter. If there are more than *modelPrefilterCount* models
+   * in the database, [findMatchingModels()] first compares the mean
+   * feature vector of the query to the mean feature vector of each
+   * model and retains only the *modelPrefilterCount* closest models.
+   * The closest matches of each point are then searched only among
+   * the points of the retained models. The pre-filter works best with
+   * descriptors that are summed over the whole object, such as shape
+   * contexts, and if each query contains a single object. With a K-d
+   * tree, matches to rejected models are just discarded. Zero
+   * disables the pre-filter.
+   */
+  void setModelPrefilterCount(int modelPrefilterCount)
+  {
+    if (modelPrefilterCount != d->iModelPrefilterCount)
+      {
+        detach();
+        d->iModelPrefilterCount = qMax(0, modelPrefilterCount);
+      }
+  }
+  /**
+   * Returns the number of models retained by the pre-filter. The
+   * default is 0.
+   */
+  int modelPrefilterCount() const { return d->iModelPrefilterCount; }
+
   /**
    * Returns the stored model points.
    */
   const PiiMatrix<T>& modelPoints() const { return d->matModelPoints; }
   /**
-   * Returns the stored model features.
+   * Returns the stored model features. The returned set is empty if
+   * the features are stored in a K-d tree or in compact form.
    */
-  const SampleSet& modelFeatures() const { return d->matModelFeatures; }
+  const SampleSet& modelFeatures() const { return d->modelFeatures; }
   /**
    * Returns the stored model indices.
    */
@@ -377,7 +524,10 @@ private:
       pDistanceMeasure(0),
       matchingMode(PiiMatching::MatchAllModels),
       iClosestMatchCount(1),
-      iMaxEvaluations(0)
+      iMaxEvaluations(0),
+      iKdTreeCount(1),
+      bCompactFeatures(false),
+      iModelPrefilterCount(0)
     {}
     Data(const Data& other) :
       matModelPoints(other.matModelPoints),
@@ -387,7 +537,16 @@ private:
       pDistanceMeasure(other.pDistanceMeasure ? other.pDistanceMeasure->clone() : 0),
       matchingMode(other.matchingMode),
       iClosestMatchCount(other.iClosestMatchCount),
-      iMaxEvaluations(other.iMaxEvaluations)
+      iMaxEvaluations(other.iMaxEvaluations),
+      iKdTreeCount(other.iKdTreeCount),
+      matCompactFeatures(other.matCompactFeatures),
+      vecFeatureOffsets(other.vecFeatureOffsets),
+      vecFeatureScales(other.vecFeatureScales),
+      bCompactFeatures(other.bCompactFeatures),
+      matModelSignatures(other.matModelSignatures),
+      vecSignatureModels(other.vecSignatureModels),
+      iModelPrefilterCount(other.iModelPrefilterCount),
+      hammingIndex(other.hammingIndex)
     {}
     ~Data()
     {
@@ -401,6 +560,9 @@ private:
       d->matchingMode = matchingMode;
       d->iClosestMatchCount = iClosestMatchCount;
       d->iMaxEvaluations = iMaxEvaluations;
+      d->iKdTreeCount = iKdTreeCount;
+      d->bCompactFeatures = bCompactFeatures;
+      d->iModelPrefilterCount = iModelPrefilterCount;
       this->release();
       return d;
     }
@@ -413,11 +575,51 @@ private:
     PiiMatching::ModelMatchingMode matchingMode;
     int iClosestMatchCount;
     int iMaxEvaluations;
+    int iKdTreeCount;
     PiiSquaredGeometricDistance<ConstFeatureIterator> squaredGeometricDistance;
+    // Compact features are restored as offset + scale * value.
+    PiiMatrix<unsigned char> matCompactFeatures;
+    QVector<float> vecFeatureOffsets, vecFeatureScales;
+    bool bCompactFeatures;
+    // Mean feature vector and model index for each model
+    PiiMatrix<double> matModelSignatures;
+    QVector<int> vecSignatureModels;
+    int iModelPrefilterCount;
+    // Binary descriptors with the Hamming distance
+    PiiMultiIndexHash hammingIndex;
   } *d;
 
+  /// @internal
+  struct ClosestMatchBand
+  {
+    ClosestMatchBand(const PiiFeaturePointMatcher* matcher,
+                     const SampleSet& features,
+                     const QVector<int>& candidates,
+                     PiiClassification::MatchList* matches) :
+      matcher(matcher), features(features), candidates(candidates), matches(matches)
+    {}
+
+    void operator() (int firstPoint, int pointCount)
+    {
+      for (int i=firstPoint; i<firstPoint+pointCount; ++i)
+        matches[i] = matcher->findClosestMatches(PiiSampleSet::sampleAt(features, i), candidates);
+    }
+
+    const PiiFeaturePointMatcher* matcher;
+    const SampleSet& features;
+    const QVector<int>& candidates;
+    PiiClassification::MatchList* matches;
+  };
+  friend struct ClosestMatchBand;
+
   void detach() { d = d->detach(); }
 
+  void storeCompactFeatures(const SampleSet& features);
+  void storeModelSignatures(const SampleSet& features, const QVector<int>& modelIndices);
+  QVector<int> prefilterModels(const SampleSet& features, int pointCount) const;
+  PiiClassification::MatchList findClosestMatches(ConstFeatureIterator sample,
+                                                  const QVector<int>& candidates) const;
+
   void collectPoints(const QList<QPair<int,int> >& indices,
                      const PiiMatrix<T>& points,
                      PiiMatrix<T>& queryPoints,
@@ -430,6 +632,16 @@ private:
                                              const QList<QPair<int,int> >& matches);
 };
 
+/// @hide
+namespace PiiSerializationTraits
+{
+  template <class T, class SampleSet> struct Version<PiiFeaturePointMatcher<T,SampleSet> >
+  {
+    enum { intValue = 1 };
+  };
+}
+/// @endhide
+
 #include "PiiFeaturePointMatcher-templates.h"
 
 #endif //_PIIFEATUREPOINTMATCHER_H
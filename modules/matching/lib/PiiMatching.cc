@@ -20,12 +20,117 @@
 
 #include <iostream>
 
+namespace
+{
+  struct ShapeContextBand
+  {
+    ShapeContextBand(const PiiMatrix<int>& boundaryPoints,
+                     int boundaryPointCount,
+                     const PiiMatrix<int>& keyPoints,
+                     int angles,
+                     const double* distances,
+                     int distanceCount,
+                     double maxDistance,
+                     const QVector<double>& directions,
+                     PiiMatrix<float>& features) :
+      boundaryPoints(boundaryPoints),
+      iBoundaryPoints(boundaryPointCount),
+      keyPoints(keyPoints),
+      pDistances(distances),
+      iDistances(distanceCount),
+      iColumns(angles * distanceCount),
+      dMaxDistance(maxDistance),
+      dAngleStep(2*M_PI / qMax(1,angles)),
+      directions(directions),
+      featureRows(features)
+    {}
+
+    void operator() (int firstPoint, int pointCount)
+    {
+      for (int i=firstPoint; i<firstPoint+pointCount; ++i)
+        {
+          float* pCurrentRow = featureRows.row(i);
+
+          // Get the main point
+          int x = keyPoints(i,0);
+          int y = keyPoints(i,1);
+
+          // Loop all points
+          for (int j=0; j<iBoundaryPoints; ++j)
+            {
+              // Calculate distance
+              int dx = x-boundaryPoints(j,0);
+              int dy = y-boundaryPoints(j,1);
+              double dDistance = dx*dx + dy*dy;
+
+              if (dDistance < dMaxDistance && dDistance != 0)
+                {
+                  // Find distance bin index
+                  int iDistanceIndex = 0;
+                  for (int c=0; c<iDistances; ++c)
+                    {
+                      if (dDistance < pDistances[c])
+                        iDistanceIndex = c;
+                      else
+                        break;
+                    }
+
+                  // Calculate angle between feature point and current boundary point
+                  float dAngle = Pii::atan2((float)dy,(float)dx) + M_PI;
+
+                  // Rotate along boundary direction
+                  if (directions.size() > 0)
+                    {
+                      dAngle -= directions[i];
+                      if (dAngle < 0)
+                        dAngle += 2*M_PI;
+                      else if (dAngle > 2*M_PI)
+                        dAngle -= 2*M_PI;
+                    }
+
+                  int iBinIndex = iDistances * int(dAngle / dAngleStep) + iDistanceIndex;
+                  // Special case: dAngle == 2*M_PI
+                  if (iBinIndex >= iColumns)
+                    iBinIndex = 0;
+                  ++pCurrentRow[iBinIndex];
+                }
+            }
+          // Normalize histogram
+          float fSum = Pii::accumulateN(pCurrentRow, iColumns, std::plus<float>(), 0.0f);
+          if (fSum != 0)
+            Pii::mapN(pCurrentRow, iColumns, std::bind2nd(std::multiplies<float>(), 1.0f/fSum));
+        }
+    }
+
+    const PiiMatrix<int>& boundaryPoints;
+    const int iBoundaryPoints;
+    const PiiMatrix<int>& keyPoints;
+    const double* pDistances;
+    const int iDistances, iColumns;
+    const double dMaxDistance, dAngleStep;
+    const QVector<double>& directions;
+    const Pii::BandRows<float> featureRows;
+  };
+}
+
 PiiMatrix<float> PiiMatching::shapeContextDescriptor(const PiiMatrix<int>& boundaryPoints,
                                                      const PiiMatrix<int>& keyPoints,
                                                      int angles,
                                                      const QVector<double>& distances,
                                                      const QVector<double>& directions,
                                                      InvarianceFlags invariance)
+{
+  return shapeContextDescriptor(Pii::ParallelExecution(1),
+                                boundaryPoints, keyPoints, angles, distances, directions, invariance);
+}
+
+PiiMatrix<float> PiiMatching::shapeContextDescriptor(const Pii::ParallelExecution& policy,
+                                                     const PiiMatrix<int>& boundaryPoints,
+                                                     const PiiMatrix<int>& keyPoints,
+                                                     int angles,
+                                                     const QVector<double>& distances,
+                                                     const QVector<double>& directions,
+                                                     InvarianceFlags invariance)
 {
   const int iColumns = angles * distances.size();
   const int iKeyPoints = keyPoints.rows(), iDistances = distances.size();
@@ -45,12 +150,8 @@ PiiMatrix<float> PiiMatching::shapeContextDescriptor(const PiiMatrix<int>& bound
   if (iBoundaryPoints < 2)
     return matFeatures;
 
-  // Calculate max distance and angle step
-  double dMaxDistance = distances.last();
-  double dAngleStep = 2*M_PI / qMax(1,angles);
-
-  double* pNewDistances = 0;
-  const double* pDistances = 0;
+  QVector<double> vecScaledDistances;
+  const double* pDistances = distances.data();
   if (invariance & ScaleInvariant)
     {
       double dMeanDistance = 0;
@@ -73,69 +174,18 @@ PiiMatrix<float> PiiMatching::shapeContextDescriptor(const PiiMatrix<int>& bound
           }
       // Scale distance limits (same as dividing each distance by the
       // mean)
-      pDistances = pNewDistances = new double[iDistances];
+      vecScaledDistances.resize(iDistances);
       for (int i=0; i<iDistances; ++i)
-        pNewDistances[i] = distances[i] * dMeanDistance;
-    }
-  else
-    pDistances = distances.data();
-
-  // Calculate features for selected points
-  for (int i=0; i<iKeyPoints; ++i)
-    {
-      float* pCurrentRow = matFeatures[i];
-
-      // Get the main point
-      int x = keyPoints(i,0);
-      int y = keyPoints(i,1);
-
-      // Loop all points
-      for (int j=0; j<iBoundaryPoints; ++j)
-        {
-          // Calculate distance
-          int dx = x-boundaryPoints(j,0);
-          int dy = y-boundaryPoints(j,1);
-          double dDistance = dx*dx + dy*dy;
-
-          if (dDistance < dMaxDistance && dDistance != 0)
-            {
-              // Find distance bin index
-              int iDistanceIndex = 0;
-              for (int c=0; c<iDistances; ++c)
-                {
-                  if (dDistance < pDistances[c])
-                    iDistanceIndex = c;
-                  else
-                    break;
-                }
-
-              // Calculate angle between feature point and current boundary point
-              float dAngle = Pii::atan2((float)dy,(float)dx) + M_PI;
-
-              // Rotate along boundary direction
-              if (directions.size() > 0)
-                {
-                  dAngle -= directions[i];
-                  if (dAngle < 0)
-                    dAngle += 2*M_PI;
-                  else if (dAngle > 2*M_PI)
-                    dAngle -= 2*M_PI;
-                }
-
-              int iBinIndex = iDistances * int(dAngle / dAngleStep) + iDistanceIndex;
-              // Special case: dAngle == 2*M_PI
-              if (iBinIndex >= iColumns)
-                iBinIndex = 0;
-              ++pCurrentRow[iBinIndex];
-            }
-        }
-      // Normalize histogram and return it
-      float fSum = Pii::accumulateN(pCurrentRow, iColumns, std::plus<float>(), 0.0f);
-      if (fSum != 0)
-        Pii::mapN(pCurrentRow, iColumns, std::bind2nd(std::multiplies<float>(), 1.0f/fSum));
+        vecScaledDistances[i] = distances[i] * dMeanDistance;
+      pDistances = vecScaledDistances.constData();
     }
 
-  delete[] pNewDistances;
+  // Each key point has its own histogram. Bands of key points can
+  // thus be processed independently.
+  Pii::forEachBand(policy, iKeyPoints, 0,
+                   ShapeContextBand(boundaryPoints, iBoundaryPoints, keyPoints,
+                                    angles, pDistances, iDistances, distances.last(),
+                                    directions, matFeatures));
 
   return matFeatures;
 }
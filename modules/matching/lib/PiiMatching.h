@@ -17,6 +17,7 @@
 #define _PIIMATCHING_H
 
 #include <PiiMatrix.h>
+#include <PiiParallel.h>
 #include <QVector>
 #include <QObject>
 
@@ -126,6 +127,19 @@ public:
                                                               const QVector<double>& boundaryDirections = QVector<double>(),
                                                               InvarianceFlags invariance = NonInvariant);
 
+  /**
+   * Calculates the shape context descriptor in parallel. The key
+   * points are divided into bands as determined by *policy*. The
+   * result is equal to that of the serial version.
+   */
+  PII_MATCHING_EXPORT PiiMatrix<float> shapeContextDescriptor(const Pii::ParallelExecution& policy,
+                                                              const PiiMatrix<int>& boundaryPoints,
+                                                              const PiiMatrix<int>& keyPoints,
+                                                              int angles,
+                                                              const QVector<double>& distances,
+                                                              const QVector<double>& boundaryDirections = QVector<double>(),
+                                                              InvarianceFlags invariance = NonInvariant);
+
   /**
    * Returns the direction of the boundary for each point in
    * *boundaryPoints*. Boundary direction at a point is the angle (in
@@ -19,9 +19,36 @@
 
 PiiRandomLbp::Data::Data() :
   iPatterns(50),
-  iPairs(11)
+  iPairs(11),
+  iRows(0),
+  iColumns(0)
 {}
 
+PiiRandomLbp::PiiRandomLbp() :
+  d(new Data)
+{}
+
+PiiRandomLbp::PiiRandomLbp(const PiiRandomLbp& other) :
+  d(new Data(*other.d))
+{}
+
+PiiRandomLbp::~PiiRandomLbp()
+{
+  delete d;
+}
+
+PiiRandomLbp& PiiRandomLbp::operator= (const PiiRandomLbp& other)
+{
+  if (&other != this)
+    *d = *other.d;
+  return *this;
+}
+
+int PiiRandomLbp::descriptorLength() const
+{
+  return (d->iPatterns * d->iPairs + 31) / 32;
+}
+
 PiiMatrix<int> PiiRandomLbp::initializeHistogram() const
 {
   PiiMatrix<int> matResult(1, d->iPatterns * (1 << d->iPairs));
@@ -31,15 +58,19 @@ PiiMatrix<int> PiiRandomLbp::initializeHistogram() const
 
 void PiiRandomLbp::setParameters(int patterns, int pairs, int rows, int columns)
 {
+  if (columns <= 0)
+    columns = rows;
   d->iPatterns = patterns;
   d->iPairs = pairs;
+  d->iRows = rows;
+  d->iColumns = columns;
 
   d->vecPointPairs.clear();
   d->vecPointPairs.reserve(patterns*pairs);
 
   for (int i=0; i<patterns*pairs; ++i)
-    d->vecPointPairs << qMakePair(PiiPoint<int>(rand() % rows, rand() % columns),
-                                  PiiPoint<int>(rand() % rows, rand() % columns));
+    d->vecPointPairs << qMakePair(PiiPoint<int>(rand() % columns, rand() % rows),
+                                  PiiPoint<int>(rand() % columns, rand() % rows));
   /* PENDING
    * The pairs could be reordered to optimize cache usage.
    */
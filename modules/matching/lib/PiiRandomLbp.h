@@ -21,6 +21,9 @@
 #include <PiiBits.h>
 #include <QPair>
 #include <QVector>
+#include <cstring>
+
+#include "PiiMatchingPlugin.h"
 
 /**
  * Random Local Binary Patterns is a keypoint description technique.
@@ -46,10 +49,33 @@
  * between "random ferns" and LBP is just in the way the compared
  * pixel pairs are selected.
  *
+ * Instead of building histograms, the comparisons can also be stored
+ * as a packed binary descriptor of M * N bits (see
+ * [binaryDescriptor()]). Such descriptors are compared with the
+ * Hamming distance, which modern processors calculate with a
+ * population count instruction, and large descriptor databases can
+ * be searched with [PiiMultiIndexHash].
+ *
+ * ~~~(c++)
+ * PiiRandomLbp lbp;
+ * lbp.setParameters(16, 16, 32);
+ * PiiMatrix<unsigned int> matDescriptors(lbp.binaryDescriptors(image, matKeyPoints));
+ * typedef PiiFeaturePointMatcher<int, PiiMatrix<unsigned int> > Matcher;
+ * Matcher matcher;
+ * // The Hamming distance enables multi-index hashing
+ * matcher.buildDatabase(matKeyPoints, matDescriptors, QVector<int>(), 0,
+ *                       new PiiDistanceMeasure<const unsigned int*>::Impl<PiiHammingDistance<const unsigned int*> >);
+ * ~~~
  */
-class PiiRandomLbp
+class PII_MATCHING_EXPORT PiiRandomLbp
 {
 public:
+  PiiRandomLbp();
+  PiiRandomLbp(const PiiRandomLbp& other);
+  ~PiiRandomLbp();
+
+  PiiRandomLbp& operator= (const PiiRandomLbp& other);
+
   /**
    * Sets parameters for the RLBP and re-randomizes the selected point
    * pairs. The total length of the feature point descriptor will be
@@ -81,6 +107,39 @@ public:
    */
   template <class T> void updateHistogram(int* histogram, const PiiMatrix<T>& image);
 
+  /**
+   * Returns the number of 32-bit words in a binary descriptor:
+   * \(\lceil MN/32 \rceil\).
+   */
+  int descriptorLength() const;
+
+  /**
+   * Stores the M*N pixel comparisons in *window* as a packed bit
+   * string to *descriptor*, which must have room for
+   * [descriptorLength()] words. Comparison *j* of pattern *i* is
+   * bit \(k = iN + j\), stored in bit *k* % 32 of word *k* / 32.
+   * Unused bits in the last word are set to zero.
+   *
+   * @param window a local window whose size is at least that given
+   * in [setParameters()].
+   */
+  template <class T> void binaryDescriptor(unsigned int* descriptor, const PiiMatrix<T>& window) const;
+
+  /**
+   * Calculates a binary descriptor for each key point in *image*.
+   * The local windows are centered at the key points.
+   *
+   * @param image the input image
+   *
+   * @param keyPoints key point coordinates, one point (x, y) per row.
+   *
+   * @return a matrix with one [descriptorLength()]-word descriptor
+   * on each row. If the window around a key point does not fit in
+   * the image, the corresponding row will be all zeros.
+   */
+  template <class T> PiiMatrix<unsigned int> binaryDescriptors(const PiiMatrix<T>& image,
+                                                               const PiiMatrix<int>& keyPoints) const;
+
 private:
   typedef QPair<PiiPoint<int>, PiiPoint<int> > PointPair;
   typedef QVector<PointPair> PointPairList;
@@ -90,6 +149,7 @@ private:
     Data();
 
     int iPatterns, iPairs;
+    int iRows, iColumns;
     PointPairList vecPointPairs;
   } *d;
 };
@@ -117,4 +177,33 @@ template <class T> void PiiRandomLbp::updateHistogram(int* histogram,
     }
 }
 
+template <class T> void PiiRandomLbp::binaryDescriptor(unsigned int* descriptor,
+                                                       const PiiMatrix<T>& window) const
+{
+  const PointPair* pPair = d->vecPointPairs.constData();
+  const int iBits = d->iPatterns * d->iPairs;
+  memset(descriptor, 0, sizeof(unsigned int) * descriptorLength());
+  for (int iBit=0; iBit<iBits; ++iBit, ++pPair)
+    descriptor[iBit >> 5] |= (Pii::signBit(window(pPair->first.y,
+                                                 pPair->first.x),
+                                          window(pPair->second.y,
+                                                 pPair->second.x)) >> 31) << (iBit & 31);
+}
+
+template <class T> PiiMatrix<unsigned int> PiiRandomLbp::binaryDescriptors(const PiiMatrix<T>& image,
+                                                                          const PiiMatrix<int>& keyPoints) const
+{
+  const int iPoints = keyPoints.rows();
+  PiiMatrix<unsigned int> matResult(iPoints, descriptorLength());
+  const int iTop = d->iRows / 2, iLeft = d->iColumns / 2;
+  for (int i=0; i<iPoints; ++i)
+    {
+      const int iR = keyPoints(i,1) - iTop, iC = keyPoints(i,0) - iLeft;
+      if (iR < 0 || iC < 0 || iR + d->iRows > image.rows() || iC + d->iColumns > image.columns())
+        continue;
+      binaryDescriptor(matResult[i], image(iR, iC, d->iRows, d->iColumns));
+    }
+  return matResult;
+}
+
 #endif //_PIIRANDOMLBP_H
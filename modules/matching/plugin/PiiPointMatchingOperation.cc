@@ -32,7 +32,9 @@ PiiPointMatchingOperation::Data::Data(int pointDimensions) :
   iPointDimensions(pointDimensions),
   matchingMode(PiiMatching::MatchAllModels),
   bMustSendPoints(false),
-  iClosestMatchCount(pMatcher->closestMatchCount())
+  iClosestMatchCount(pMatcher->closestMatchCount()),
+  bCompactFeatures(pMatcher->compactFeatures()),
+  iModelPrefilterCount(pMatcher->modelPrefilterCount())
 {
 }
 
@@ -96,6 +98,8 @@ PiiPointMatchingOperation::Matcher* PiiPointMatchingOperation::createMatcher()
 {
   Matcher* pMatcher = new Matcher;
   pMatcher->setClosestMatchCount(_d()->iClosestMatchCount);
+  pMatcher->setCompactFeatures(_d()->bCompactFeatures);
+  pMatcher->setModelPrefilterCount(_d()->iModelPrefilterCount);
   return pMatcher;
 }
 
@@ -463,6 +467,8 @@ PiiPointMatchingOperation* PiiPointMatchingOperation::clone() const
   pNewData->iModelCount = d->iModelCount;
   pNewData->matchingMode = d->matchingMode;
   pNewData->iClosestMatchCount = d->iClosestMatchCount;
+  pNewData->bCompactFeatures = d->bCompactFeatures;
+  pNewData->iModelPrefilterCount = d->iModelPrefilterCount;
 
   return pNewOperation;
 }
@@ -480,3 +486,25 @@ int PiiPointMatchingOperation::closestMatchCount() const
 {
   return _d()->iClosestMatchCount;
 }
+
+void PiiPointMatchingOperation::setCompactFeatures(bool compactFeatures)
+{
+  PII_D;
+  d->pMatcher->setCompactFeatures(d->bCompactFeatures = compactFeatures);
+}
+
+bool PiiPointMatchingOperation::compactFeatures() const
+{
+  return _d()->bCompactFeatures;
+}
+
+void PiiPointMatchingOperation::setModelPrefilterCount(int modelPrefilterCount)
+{
+  PII_D;
+  d->pMatcher->setModelPrefilterCount(d->iModelPrefilterCount = modelPrefilterCount);
+}
+
+int PiiPointMatchingOperation::modelPrefilterCount() const
+{
+  return _d()->iModelPrefilterCount;
+}
@@ -152,6 +152,23 @@ class PII_MATCHING_EXPORT PiiPointMatchingOperation : public PiiClassifierOperat
    */
   Q_PROPERTY(int closestMatchCount READ closestMatchCount WRITE setClosestMatchCount);
 
+  /**
+   * Store feature vectors in compact 8-bit form. Reduces the memory
+   * needed by the model database at the cost of slightly less
+   * accurate distances. See PiiFeaturePointMatcher::setCompactFeatures().
+   * Takes effect when the database is built next time. The default is
+   * `false`.
+   */
+  Q_PROPERTY(bool compactFeatures READ compactFeatures WRITE setCompactFeatures);
+
+  /**
+   * The number of models retained by a coarse pre-filter before the
+   * closest matches of each query point are searched. See
+   * PiiFeaturePointMatcher::setModelPrefilterCount(). The default is
+   * 0, which disables the pre-filter.
+   */
+  Q_PROPERTY(int modelPrefilterCount READ modelPrefilterCount WRITE setModelPrefilterCount);
+
   friend struct PiiSerialization::Accessor;
   template <class Archive> void serialize(Archive& archive, const unsigned int)
   {
@@ -226,6 +243,8 @@ protected:
     PiiMatching::ModelMatchingMode matchingMode;
     bool bMustSendPoints;
     int iClosestMatchCount;
+    bool bCompactFeatures;
+    int iModelPrefilterCount;
   };
   PII_D_FUNC;
 
@@ -244,6 +263,10 @@ protected:
   PiiMatching::ModelMatchingMode matchingMode() const;
   void setClosestMatchCount(int closestMatchCount);
   int closestMatchCount() const;
+  void setCompactFeatures(bool compactFeatures);
+  bool compactFeatures() const;
+  void setModelPrefilterCount(int modelPrefilterCount);
+  int modelPrefilterCount() const;
 
   bool learnBatch();
   void replaceClassifier();
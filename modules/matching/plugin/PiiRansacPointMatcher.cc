@@ -44,6 +44,10 @@ void PiiRansacPointMatcher::setFittingThreshold(double fittingThreshold) { _d()-
 double PiiRansacPointMatcher::fittingThreshold() const { return _d()->pRansac->fittingThreshold(); }
 void PiiRansacPointMatcher::setSelectionProbability(double selectionProbability) { _d()->pRansac->setSelectionProbability(selectionProbability); }
 double PiiRansacPointMatcher::selectionProbability() const { return _d()->pRansac->selectionProbability(); }
+void PiiRansacPointMatcher::setEarlyRejection(bool earlyRejection) { _d()->pRansac->setEarlyRejection(earlyRejection); }
+bool PiiRansacPointMatcher::earlyRejection() const { return _d()->pRansac->earlyRejection(); }
+void PiiRansacPointMatcher::setThreadCount(int threadCount) { _d()->pRansac->setThreadCount(threadCount); }
+int PiiRansacPointMatcher::threadCount() const { return _d()->pRansac->threadCount(); }
 
 PiiRansac& PiiRansacPointMatcher::ransac() { return *_d()->pRansac; }
 const PiiRansac& PiiRansacPointMatcher::ransac() const { return *_d()->pRansac; }
@@ -37,6 +37,8 @@ class PII_MATCHING_EXPORT PiiRansacPointMatcher : public PiiPointMatchingOperati
   Q_PROPERTY(int minInliers READ minInliers WRITE setMinInliers);
   Q_PROPERTY(double fittingThreshold READ fittingThreshold WRITE setFittingThreshold);
   Q_PROPERTY(double selectionProbability READ selectionProbability WRITE setSelectionProbability);
+  Q_PROPERTY(bool earlyRejection READ earlyRejection WRITE setEarlyRejection);
+  Q_PROPERTY(int threadCount READ threadCount WRITE setThreadCount);
 
 public:
   void setMaxIterations(int maxIterations);
@@ -49,6 +51,10 @@ public:
   double fittingThreshold() const;
   void setSelectionProbability(double selectionProbability);
   double selectionProbability() const;
+  void setEarlyRejection(bool earlyRejection);
+  bool earlyRejection() const;
+  void setThreadCount(int threadCount);
+  int threadCount() const;
 
 protected:
   /// @internal
@@ -37,7 +37,7 @@ PiiMatching::MatchList PiiRigidPlaneMatcher::match(Matcher& matcher,
                                                    const PiiMatrix<float>& points,
                                                    const PiiMatrix<float>& features)
 {
-  return matcher.findMatchingModels(points, features, ransac());
+  return matcher.findMatchingModels(Pii::ParallelExecution(), points, features, ransac());
 }
 
 PiiMatrix<double> PiiRigidPlaneMatcher::toTransformMatrix(const PiiMatrix<double>& transformParams)
@@ -266,8 +266,9 @@ void PiiShapeContextOperation::processBoundary(const PiiMatrix<int>& boundary, c
   else
     matKeyPoints = reducePoints(boundary);
 
-  // Create feature matrix
-  PiiMatrix<float> matFeatures = PiiMatching::shapeContextDescriptor(boundary,
+  // Create feature matrix. Key points are described in parallel.
+  PiiMatrix<float> matFeatures = PiiMatching::shapeContextDescriptor(Pii::ParallelExecution(),
+                                                                     boundary,
                                                                      matKeyPoints,
                                                                      d->iAngles,
                                                                      d->vecDistances,
@@ -37,6 +37,7 @@ colors.depends += image
 classification.depends += image
 texture.depends += image
 transforms.depends += image
+statistics.depends += image
 camera.depends += image geometry colors
 matching.depends += geometry classification optimization
 calibration.depends += classification optimization
@@ -29,10 +29,11 @@ PiiNetworkInputOperation::Data::Data() :
   pServer(0),
   bOwnServer(false),
   bNeedToWaitResponse(false),
+  iReservedRequests(0),
   bStatusConnected(false),
-  iStatusCode(200),
   strInterruptedResponse("The operation was interrupted."),
-  strTimeoutResponse("Timed out while waiting for response")
+  strTimeoutResponse("Timed out while waiting for response"),
+  iMaxPendingRequests(1)
 {
 }
 
@@ -120,32 +121,84 @@ void PiiNetworkInputOperation::check(bool reset)
 
   d->pServer->protocol()->registerUriHandler(strUri, this);
 
-  d->strCurrentContentType = d->strContentType;
-  d->strResponseData = "";
-  d->iStatusCode = 200;
   d->bStatusConnected = d->pStatusInput->isConnected();
+
+  // Responses to requests received before a restart will never come.
+  QMutexLocker lock(&d->responseLock);
+  d->iReservedRequests -= d->queuePendingRequests.size();
+  d->queuePendingRequests.clear();
+  d->responseCondition.wakeAll();
 }
 
 void PiiNetworkInputOperation::process()
 {
   PII_D;
+  PendingRequest response;
   if (d->bBodyConnected)
     {
-      d->strResponseData = PiiYdin::convertToQString(d->pBodyInput);
-      if (d->bTypeConnected)
-        d->strCurrentContentType = PiiYdin::convertToQString(d->pTypeInput);
+      response.strResponseData = PiiYdin::convertToQString(d->pBodyInput);
+      response.strContentType = d->bTypeConnected ?
+        PiiYdin::convertToQString(d->pTypeInput) :
+        d->strContentType;
     }
   else
     {
-      d->lstResponseValues.clear();
       for (int i=0; i<d->lstInputNames.size(); ++i)
-        d->lstResponseValues << inputAt(i+d->iStaticInputCount)->firstObject();
+        response.lstResponseValues << inputAt(i+d->iStaticInputCount)->firstObject();
     }
 
   if (d->bStatusConnected)
-    d->iStatusCode = PiiYdin::primitiveAs<int>(d->pStatusInput);
+    response.iStatusCode = PiiYdin::primitiveAs<int>(d->pStatusInput);
+
+  QMutexLocker lock(&d->responseLock);
+  // The pipeline retains the order of objects. The oldest pending
+  // request is the one this response belongs to.
+  if (d->queuePendingRequests.isEmpty())
+    return;
+  PendingRequest* pRequest = d->queuePendingRequests.dequeue();
+  --d->iReservedRequests;
+  // Null means the client gave up waiting.
+  if (pRequest != 0)
+    {
+      *pRequest = response;
+      pRequest->bDone = true;
+    }
+  d->responseCondition.wakeAll();
+}
+
+bool PiiNetworkInputOperation::canKeepWaiting(PiiHttpDevice* h,
+                                              PiiHttpProtocol::TimeLimiter* controller,
+                                              const QTime& time,
+                                              bool* timedOut) const
+{
+  const PII_D;
+  if (!(d->state == Running || d->state == Pausing) ||
+      !h->isWritable() || !controller->canContinue())
+    return false;
+  if (time.elapsed() > d->iResponseTimeout)
+    {
+      *timedOut = true;
+      return false;
+    }
+  return true;
+}
 
-  d->responseCondition.wakeOne();
+void PiiNetworkInputOperation::replyToFailure(PiiHttpDevice* h, bool timedOut)
+{
+  PII_D;
+  if (!h->isWritable())
+    return;
+  // The operation is being stopped, but client is connected
+  if (d->state == Stopping || d->state == Stopped || d->state == Interrupted)
+    {
+      h->setStatus(500); // internal server error
+      h->print(d->strInterruptedResponse);
+    }
+  else if (timedOut)
+    {
+      h->setStatus(500);
+      h->print(d->strTimeoutResponse);
+    }
 }
 
 void PiiNetworkInputOperation::handleRequest(const QString& /*uri*/,
@@ -159,7 +212,87 @@ void PiiNetworkInputOperation::handleRequest(const QString& /*uri*/,
       return;
     }
 
-  QMutexLocker lock(&d->requestLock);
+  // Tell the client which content codings it may use in requests.
+  h->setHeader("Accept-Encoding", QString("%1, %2").arg(pDeflateEncoding).arg(pDeltaEncoding));
+
+  bool bTimedOut = false;
+  QTime t;
+  t.start();
+  // Wait until an earlier request has been responded to if the
+  // pipeline is full.
+  if (d->bNeedToWaitResponse)
+    {
+      QMutexLocker responseLock(&d->responseLock);
+      while (d->iReservedRequests >= d->iMaxPendingRequests)
+        {
+          if (!canKeepWaiting(h, controller, t, &bTimedOut))
+            {
+              responseLock.unlock();
+              replyToFailure(h, bTimedOut);
+              return;
+            }
+          d->responseCondition.wait(&d->responseLock, 100);
+        }
+      ++d->iReservedRequests;
+    }
+
+  PendingRequest request;
+  if (!queueRequest(h, &request))
+    {
+      if (d->bNeedToWaitResponse)
+        {
+          QMutexLocker responseLock(&d->responseLock);
+          --d->iReservedRequests;
+          d->responseCondition.wakeAll();
+        }
+      return;
+    }
+
+  if (!d->bNeedToWaitResponse)
+    return;
+
+  // Other requests may enter the pipeline while this one is waiting
+  // for its response.
+  t.restart();
+  QMutexLocker responseLock(&d->responseLock);
+  while (!request.bDone)
+    {
+      if (!canKeepWaiting(h, controller, t, &bTimedOut))
+        {
+          // Leave a placeholder so that the response still finds its
+          // way to the right request.
+          int iIndex = d->queuePendingRequests.indexOf(&request);
+          if (iIndex >= 0)
+            d->queuePendingRequests[iIndex] = 0;
+          responseLock.unlock();
+          replyToFailure(h, bTimedOut);
+          return;
+        }
+      d->responseCondition.wait(&d->responseLock, 100);
+    }
+  responseLock.unlock();
+
+  try
+    {
+      replyToClient(h, request);
+    }
+  catch (PiiException& ex)
+    {
+      piiWarning(ex.message());
+    }
+}
+
+bool PiiNetworkInputOperation::queueRequest(PiiHttpDevice* h, PendingRequest* request)
+{
+  PII_D;
+  // Requests are decoded and emitted one at a time.
+  QMutexLocker requestLock(&d->requestLock);
+
+  if (!hasDeltaReference(h->requestHeader()))
+    {
+      h->setStatus(409); // conflict, key frame needed
+      return false;
+    }
 
   try
     {
@@ -171,56 +304,42 @@ void PiiNetworkInputOperation::handleRequest(const QString& /*uri*/,
           if (!d->bIgnoreErrors)
             PII_THROW(PiiExecutionException, tr("Client sent an invalid request."));
           h->setStatus(422); // Unprocessable entity
-          return;
+          return false;
         }
       // Add query values (GET parameters)
       addToOutputMap(h->queryValues());
 
       //qDebug() << d->mapOutputValues;
 
-      // All objects are here
-      if (d->mapOutputValues.size() >= d->lstOutputNames.size())
-        {
-          d->responseCondition.wakeAll();
-          emitOutputValues();
-
-          bool bTimedOut = false;
+      // Objects are still missing
+      if (d->mapOutputValues.size() < d->lstOutputNames.size())
+        return false;
 
-          // If there are connected inputs, must wait for response now
-          if (d->bNeedToWaitResponse)
-            {
-              QTime t;
-              t.start();
-              while ((d->state == Running || d->state == Pausing) &&
-                     h->isWritable() && controller->canContinue())
-                {
-                  if (t.elapsed() > d->iResponseTimeout)
-                    {
-                      bTimedOut = true;
-                      break;
-                    }
-                  if (d->responseCondition.wait(100))
-                    {
-                      replyToClient(h);
-                      return;
-                    }
-                }
-            }
+      // The request must be queued before emission because the
+      // response may be processed before emitOutputValues() returns.
+      if (d->bNeedToWaitResponse)
+        {
+          QMutexLocker responseLock(&d->responseLock);
+          d->queuePendingRequests.enqueue(request);
+        }
 
-          if (h->isWritable())
-            {
-              // The operation is being stopped, but client is connected
-              if (d->state == Stopping || d->state == Stopped || d->state == Interrupted)
-                {
-                  h->setStatus(500); // internal server error
-                  h->print(d->strInterruptedResponse);
-                }
-              else if (bTimedOut)
-                {
-                  h->setStatus(500);
-                  h->print(d->strTimeoutResponse);
-                }
-            }
+      bool bEmitted = false;
+      try
+        {
+          bEmitted = emitOutputValues();
+        }
+      catch (PiiException&)
+        {
+          QMutexLocker responseLock(&d->responseLock);
+          d->queuePendingRequests.removeOne(request);
+          throw;
+        }
+      if (!bEmitted)
+        {
+          QMutexLocker responseLock(&d->responseLock);
+          d->queuePendingRequests.removeOne(request);
+          h->setStatus(422); // Unprocessable entity
+          return false;
         }
     }
   catch (PiiSerializationException& ex)
@@ -229,27 +348,28 @@ void PiiNetworkInputOperation::handleRequest(const QString& /*uri*/,
       h->print(ex.message());
       piiWarning(ex.message());
       piiWarning(ex.info());
-      return;
+      return false;
     }
   catch (PiiException& ex)
     {
       h->setStatus(422); // Unprocessable entity
       h->print(ex.message());
       piiWarning(ex.message());
-      return;
+      return false;
     }
+  return true;
 }
 
-void PiiNetworkInputOperation::replyToClient(PiiHttpDevice* h)
+void PiiNetworkInputOperation::replyToClient(PiiHttpDevice* h, const PendingRequest& request)
 {
   PII_D;
-  h->setStatus(d->iStatusCode);
+  h->setStatus(request.iStatusCode);
 
   if (d->bBodyConnected)
     {
       h->startOutputFiltering(new PiiStreamBuffer);
-      h->setHeader("Content-Type", d->strCurrentContentType);
-      h->print(d->strResponseData);
+      h->setHeader("Content-Type", request.strContentType);
+      h->print(request.strResponseData);
     }
   // Only one input -> serialize a single object
   else if (d->lstInputNames.size() == 1)
@@ -259,18 +379,18 @@ void PiiNetworkInputOperation::replyToClient(PiiHttpDevice* h)
 
       // Everything but QStrings are marshalled with the standard
       // serialization mechanism.
-      if (d->lstResponseValues[0].type() != PiiYdin::QStringType)
+      if (request.lstResponseValues[0].type() != PiiYdin::QStringType)
         {
           h->setHeader("Content-Type", PiiNetwork::pTextArchiveContentType);
 
           PiiGenericTextOutputArchive outputArchive(h);
-          outputArchive << d->lstResponseValues[0];
+          outputArchive << request.lstResponseValues[0];
         }
       // QStrings are just printed as such.
       else
         {
           h->setHeader("Content-Type", "text/plain");
-          h->print(d->lstResponseValues[0].valueAs<QString>());
+          h->print(request.lstResponseValues[0].valueAs<QString>());
         }
     }
   else
@@ -278,14 +398,14 @@ void PiiNetworkInputOperation::replyToClient(PiiHttpDevice* h)
       QString strBoundary("243F6A8885A308D31319");
       h->setHeader("Content-Type", "multipart/mixed; boundary=\"" + strBoundary + "\"");
 
-      for (int i=0; i<d->lstResponseValues.size(); ++i)
+      for (int i=0; i<request.lstResponseValues.size(); ++i)
         {
           PiiMultipartStreamBuffer* bfr = new PiiMultipartStreamBuffer(strBoundary);
           bfr->setHeader(pContentNameHeader, d->lstInputNames[i]);
           bfr->setHeader("Content-Type", PiiNetwork::pTextArchiveContentType);
           h->startOutputFiltering(bfr);
           PiiGenericTextOutputArchive outputArchive(h);
-          outputArchive << d->lstResponseValues[i];
+          outputArchive << request.lstResponseValues[i];
           h->endOutputFiltering();
           if (!h->isWritable())
             {
@@ -296,7 +416,6 @@ void PiiNetworkInputOperation::replyToClient(PiiHttpDevice* h)
         }
       h->print("\r\n--" + strBoundary + "--\r\n");
     }
-  d->lstResponseValues.clear();
 }
 
 void PiiNetworkInputOperation::setHttpServer(const QString& httpServer) { _d()->strHttpServer = httpServer; }
@@ -307,3 +426,5 @@ void PiiNetworkInputOperation::setInterruptedResponse(const QString& interrupted
 QString PiiNetworkInputOperation::interruptedResponse() const { return _d()->strInterruptedResponse; }
 void PiiNetworkInputOperation::setTimeoutResponse(const QString& timeoutResponse) { _d()->strTimeoutResponse = timeoutResponse; }
 QString PiiNetworkInputOperation::timeoutResponse() const { return _d()->strTimeoutResponse; }
+void PiiNetworkInputOperation::setMaxPendingRequests(int maxPendingRequests) { _d()->iMaxPendingRequests = qMax(1, maxPendingRequests); }
+int PiiNetworkInputOperation::maxPendingRequests() const { return _d()->iMaxPendingRequests; }
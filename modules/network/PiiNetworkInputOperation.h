@@ -17,9 +17,11 @@
 #define _PIINETWORKINPUTOPERATION_H
 
 #include <QMutex>
+#include <QWaitCondition>
 #include <QStringList>
+#include <QQueue>
+#include <QTime>
 #include <PiiHttpProtocol.h>
-#include <PiiWaitCondition.h>
 
 #include "PiiNetworkOperation.h"
 
@@ -99,6 +101,21 @@ class PiiHttpServer;
  * `double` will be tried next, and if that is not successful, the value
  * will be used as a string.
  *
+ * Compressed and delta-encoded objects sent by
+ * PiiNetworkOutputOperation are decoded automatically. See
+ * PiiNetworkOperation for details.
+ *
+ * Pipelined requests
+ * ------------------
+ *
+ * If the response inputs are connected, each request waits for its
+ * response to come back through the feedback loop. By default, only
+ * one request is processed at a time. Setting [maxPendingRequests]
+ * to a larger value lets many requests enter the processing pipeline
+ * before the first response arrives. Since a pipeline processes
+ * objects in the order they were emitted, responses are matched to
+ * requests in the order the requests were received.
+ *
  */
 class PiiNetworkInputOperation : public PiiNetworkOperation,
                                  public PiiHttpProtocol::UriHandler
@@ -143,6 +160,17 @@ class PiiNetworkInputOperation : public PiiNetworkOperation,
    */
   Q_PROPERTY(QString timeoutResponse READ timeoutResponse WRITE setTimeoutResponse);
 
+  /**
+   * The maximum number of requests that may wait for a response at
+   * the same time. If the limit is reached, new requests will wait
+   * until a response to an earlier request has been received. Large
+   * values increase throughput if the processing pipeline has many
+   * threaded stages. The default value is one, which means that
+   * requests are processed one at a time. This property has no
+   * effect if no response is expected.
+   */
+  Q_PROPERTY(int maxPendingRequests READ maxPendingRequests WRITE setMaxPendingRequests);
+
   PII_OPERATION_SERIALIZATION_FUNCTION
 
 public:
@@ -164,13 +192,30 @@ public:
   QString interruptedResponse() const;
   void setTimeoutResponse(const QString& timeoutResponse);
   QString timeoutResponse() const;
+  void setMaxPendingRequests(int maxPendingRequests);
+  int maxPendingRequests() const;
 
 protected:
   void process();
 
 private:
-  void replyToClient(PiiHttpDevice* h);
+  struct PendingRequest
+  {
+    PendingRequest() : bDone(false), iStatusCode(200) {}
+
+    bool bDone;
+    int iStatusCode;
+    QString strContentType;
+    QString strResponseData;
+    QList<PiiVariant> lstResponseValues;
+  };
+
+  void replyToClient(PiiHttpDevice* h, const PendingRequest& request);
   void destroyServer();
+  bool canKeepWaiting(PiiHttpDevice* h, PiiHttpProtocol::TimeLimiter* controller,
+                      const QTime& time, bool* timedOut) const;
+  void replyToFailure(PiiHttpDevice* h, bool timedOut);
+  bool queueRequest(PiiHttpDevice* h, PendingRequest* request);
 
   /// @internal
   class Data : public PiiNetworkOperation::Data
@@ -181,22 +226,27 @@ private:
     PiiHttpServer* pServer;
     bool bOwnServer;
     bool bNeedToWaitResponse;
-    PiiWaitCondition responseCondition;
+    // Serializes decoding and emission of requests.
     QMutex requestLock;
+    // Protects queuePendingRequests and iReservedRequests.
+    QMutex responseLock;
+    QWaitCondition responseCondition;
+    // The number of requests being decoded or waiting for a
+    // response.
+    int iReservedRequests;
+    // Requests waiting for a response, in emission order. Requests
+    // that gave up waiting are replaced with null pointers so that
+    // later responses still find their requests.
+    QQueue<PendingRequest*> queuePendingRequests;
 
     PiiInputSocket* pStatusInput;
     bool bStatusConnected;
-    int iStatusCode;
-
-    QList<PiiVariant> lstResponseValues;
-
-    QString strCurrentContentType;
-    QString strResponseData;
 
     QString strHttpServer;
     QString strUri;
     QString strInterruptedResponse;
     QString strTimeoutResponse;
+    int iMaxPendingRequests;
   };
   PII_D_FUNC;
 };
@@ -18,7 +18,9 @@
 #include <PiiMimeHeader.h>
 #include <PiiMultipartDecoder.h>
 #include <PiiGenericTextInputArchive.h>
+#include <PiiWireFormat.h>
 
+#include <QBuffer>
 #include <QTextCodec>
 #if QT_VERSION >= 0x050000
 #  include <QUrlQuery>
@@ -28,6 +30,10 @@
 
 // PENDING body and content type outputs
 const char* PiiNetworkOperation::pContentNameHeader = "Content-Name";
+const char* PiiNetworkOperation::pSequenceHeader = "Content-Sequence";
+const char* PiiNetworkOperation::pDeltaBaseHeader = "Delta-Base";
+const char* PiiNetworkOperation::pDeflateEncoding = "x-into-deflate";
+const char* PiiNetworkOperation::pDeltaEncoding = "x-into-delta";
 
 PiiNetworkOperation::Data::Data() :
   bIgnoreErrors(false),
@@ -100,12 +106,22 @@ bool PiiNetworkOperation::decodeObjects(PiiHttpDevice& h, const PiiMimeHeader& h
   PII_D;
   QString strContentType = header.contentType();
   //qDebug("Decoding %s", qPrintable(strContentType));
+  // text/plain uses Content-Encoding for the character set.
+  QString strEncoding = header.value("Content-Encoding");
+  if (strEncoding.startsWith("x-into-"))
+    return decodeEncodedObject(h, header, strEncoding);
+
   // The server responded with/client sent one serialized object
   if (strContentType == PiiNetwork::pTextArchiveContentType)
     {
       addToOutputMap(header.value(pContentNameHeader), h);
       return true;
     }
+  else if (strContentType == PiiWireFormat::pContentType)
+    {
+      addFrameToOutputMap(header.value(pContentNameHeader), h, h);
+      return true;
+    }
   else if (strContentType.startsWith("multipart/"))
     {
       // Decode a multipart message
@@ -113,10 +129,16 @@ bool PiiNetworkOperation::decodeObjects(PiiHttpDevice& h, const PiiMimeHeader& h
       while (decoder.nextMessage())
         {
           // PENDING Content-Disposition: form-data; name="name"
-          if (decoder.header().contentType() == PiiNetwork::pTextArchiveContentType)
-            addToOutputMap(decoder.header().value(pContentNameHeader), decoder);
+          PiiMimeHeader partHeader(decoder.header());
+          if (partHeader.contentType() == PiiNetwork::pTextArchiveContentType)
+            addToOutputMap(partHeader.value(pContentNameHeader), decoder);
+          // Frames are decoded straight into the destination matrix
+          // without buffering the body part.
+          else if (partHeader.contentType() == PiiWireFormat::pContentType &&
+                   !partHeader.hasKey("Content-Encoding"))
+            addFrameToOutputMap(partHeader.value(pContentNameHeader), decoder, h);
           else
-            decoder.readAll();
+            decoder.skipBody();
         }
       return true;
     }
@@ -152,6 +174,85 @@ bool PiiNetworkOperation::decodeObjects(PiiHttpDevice& h, const PiiMimeHeader& h
   return false;
 }
 
+bool PiiNetworkOperation::decodeEncodedObject(PiiHttpDevice& h, const PiiMimeHeader& header, const QString& encoding)
+{
+  PII_D;
+  QString strName = header.value(pContentNameHeader);
+  QByteArray aBody(h.readBody());
+  QStringList lstCodings(encoding.split(','));
+  // Codings are listed in the order they were applied.
+  for (int i=lstCodings.size(); i--; )
+    {
+      QString strCoding(lstCodings[i].trimmed());
+      if (strCoding == pDeflateEncoding)
+        {
+          if (aBody.size() < 4)
+            return false;
+          // Don't let a forged size prefix allocate arbitrary amounts of memory.
+          const uchar* pSize = reinterpret_cast<const uchar*>(aBody.constData());
+          const qint64 iSize = (qint64(pSize[0]) << 24) | (pSize[1] << 16) | (pSize[2] << 8) | pSize[3];
+          if (h.messageSizeLimit() > 0 && iSize > h.messageSizeLimit())
+            return false;
+          aBody = qUncompress(aBody);
+          if (aBody.isEmpty() && iSize != 0)
+            return false;
+        }
+      else if (strCoding == pDeltaEncoding)
+        {
+          if (!hasDeltaReference(header))
+            return false;
+          const QByteArray& aReference = d->mapDeltaReferences[strName].second;
+          if (aReference.size() != aBody.size())
+            return false;
+          aBody = xorFrames(aBody, aReference);
+        }
+      else
+        return false;
+    }
+
+  PiiVariant obj;
+  if (header.contentType() == PiiWireFormat::pContentType)
+    obj = PiiWireFormat::fromByteArray(aBody);
+  else if (header.contentType() == PiiNetwork::pTextArchiveContentType)
+    {
+      QBuffer buffer(&aBody);
+      buffer.open(QIODevice::ReadOnly);
+      PiiGenericTextInputArchive inputArchive(&buffer);
+      inputArchive >> obj;
+    }
+  else
+    return false;
+
+  // Successfully decoded frames become references for the next delta.
+  if (header.hasKey(pSequenceHeader))
+    d->mapDeltaReferences[strName] = qMakePair(header.value(pSequenceHeader).toLongLong(), aBody);
+
+  d->mapOutputValues[strName.isEmpty() ? d->lstOutputNames[0] : strName] = obj;
+  return true;
+}
+
+bool PiiNetworkOperation::hasDeltaReference(const PiiMimeHeader& header) const
+{
+  const PII_D;
+  if (!header.hasKey(pDeltaBaseHeader))
+    return true;
+  QMap<QString,QPair<qint64,QByteArray> >::const_iterator i =
+    d->mapDeltaReferences.find(header.value(pContentNameHeader));
+  return i != d->mapDeltaReferences.end() &&
+    i->first == header.value(pDeltaBaseHeader).toLongLong();
+}
+
+QByteArray PiiNetworkOperation::xorFrames(const QByteArray& frame, const QByteArray& reference)
+{
+  QByteArray aResult(frame);
+  char* pResult = aResult.data();
+  const char* pReference = reference.constData();
+  const int iSize = qMin(aResult.size(), reference.size());
+  for (int i=0; i<iSize; ++i)
+    pResult[i] ^= pReference[i];
+  return aResult;
+}
+
 void PiiNetworkOperation::addToOutputMap(const QVariantMap& variables)
 {
   for (QVariantMap::const_iterator i = variables.begin();
@@ -192,7 +293,14 @@ void PiiNetworkOperation::addToOutputMap(const QString& name, QIODevice& device)
   d->mapOutputValues[name.isEmpty() ? d->lstOutputNames[0] : name] = obj;
 }
 
-void PiiNetworkOperation::emitOutputValues()
+void PiiNetworkOperation::addFrameToOutputMap(const QString& name, QIODevice& device, PiiHttpDevice& h)
+{
+  PII_D;
+  d->mapOutputValues[name.isEmpty() ? d->lstOutputNames[0] : name] =
+    PiiWireFormat::readObject(&device, h.messageSizeLimit(), h.dataTimeout());
+}
+
+bool PiiNetworkOperation::emitOutputValues()
 {
   PII_D;
   QList<PiiVariant> lstOutputValues;
@@ -207,7 +315,7 @@ void PiiNetworkOperation::emitOutputValues()
           d->mapOutputValues.clear();
           if (!d->bIgnoreErrors)
             PII_THROW(PiiExecutionException, tr("Objects were not received for all outputs."));
-          return;
+          return false;
         }
     }
 
@@ -215,6 +323,7 @@ void PiiNetworkOperation::emitOutputValues()
     outputAt(i+d->iStaticOutputCount)->emitObject(lstOutputValues[i]);
 
   d->mapOutputValues.clear();
+  return true;
 }
 
 void PiiNetworkOperation::check(bool reset)
@@ -222,6 +331,9 @@ void PiiNetworkOperation::check(bool reset)
   PII_D;
   PiiDefaultOperation::check(reset);
 
+  if (reset)
+    d->mapDeltaReferences.clear();
+
   d->bBodyConnected = d->pBodyInput->isConnected();
   d->bTypeConnected = d->pTypeInput->isConnected();
   if (!d->bBodyConnected && d->bTypeConnected)
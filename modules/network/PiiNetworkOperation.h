@@ -62,6 +62,26 @@ class PiiMimeHeader;
  * server, whose response will be decoded and sent to the output
  * sockets. If no response is received, no output will be produced.
  *
+ * Content encoding
+ * ----------------
+ *
+ * PiiNetworkInputOperation accepts request bodies that have been
+ * compressed or delta-encoded by PiiNetworkOutputOperation (see its
+ * PiiNetworkOutputOperation::compression).
+ * The server advertises the codings it understands with an
+ * `Accept-Encoding` response header, and the client only starts
+ * encoding once it has seen one. The codings are:
+ *
+ * - `x-into-deflate` - the body has been compressed with qCompress():
+ * the uncompressed size as a 32-bit big-endian integer followed by a
+ * zlib stream.
+ *
+ * - `x-into-delta` - the body is a PiiWireFormat frame XORed with the
+ * previous frame received with the same `Content-Name`. The
+ * `Delta-Base` header identifies the reference frame by the
+ * `Content-Sequence` it was sent with. If the server does not have
+ * the reference, it responds with 409 (Conflict) and the client
+ * resends the object as a key frame.
  */
 class PII_NETWORKPLUGIN_EXPORT PiiNetworkOperation : public PiiDefaultOperation
 {
@@ -139,13 +159,24 @@ public:
   int responseTimeout() const;
 
 protected:
-  /// Emit collected output values to named output sockets.
-  void emitOutputValues();
+  /**
+   * Emit collected output values to named output sockets.
+   *
+   * @return `true` if the values were emitted, `false` if some of
+   * them were missing and [ignoreErrors] is `true`.
+   */
+  bool emitOutputValues();
   /**
    * Read and decode an object from `device` and add it to the output
    * value map with `name`.
    */
   void addToOutputMap(const QString& name, QIODevice& device);
+  /**
+   * Read a PiiWireFormat frame from `device` and add it to the output
+   * value map with `name`. The size limit and data timeout of `h`
+   * are applied to the frame.
+   */
+  void addFrameToOutputMap(const QString& name, QIODevice& device, PiiHttpDevice& h);
   /**
    * Add variables to the output map.
    */
@@ -161,6 +192,18 @@ protected:
    * value map.
    */
   bool decodeObjects(PiiHttpDevice& h, const PiiMimeHeader& header);
+  /**
+   * Returns `true` if the reference frame a delta-encoded message
+   * described by *header* refers to is available, or if the message
+   * is not delta-encoded.
+   */
+  bool hasDeltaReference(const PiiMimeHeader& header) const;
+  /**
+   * Returns the bitwise XOR of *frame* and *reference*, which must be
+   * of equal size. Applying the same reference twice restores the
+   * original frame.
+   */
+  static QByteArray xorFrames(const QByteArray& frame, const QByteArray& reference);
 
   /// @internal
   class Data : public PiiDefaultOperation::Data
@@ -192,12 +235,21 @@ protected:
     /// Map of decoded output values.
     QMap<QString,PiiVariant> mapOutputValues;
     int iResponseTimeout;
+    /// The last delta-encodable frame received for each content name.
+    QMap<QString,QPair<qint64,QByteArray> > mapDeltaReferences;
   };
   PII_D_FUNC;
   /// @internal
   PiiNetworkOperation(Data *data);
 
   static const char* pContentNameHeader;
+  static const char* pSequenceHeader;
+  static const char* pDeltaBaseHeader;
+  static const char* pDeflateEncoding;
+  static const char* pDeltaEncoding;
+
+private:
+  bool decodeEncodedObject(PiiHttpDevice& h, const PiiMimeHeader& header, const QString& encoding);
 };
 
 
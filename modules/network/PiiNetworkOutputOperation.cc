@@ -20,23 +20,44 @@
 #include <PiiStreamBuffer.h>
 #include <PiiYdinTypes.h>
 #include <PiiGenericTextOutputArchive.h>
+#include <PiiWireFormat.h>
+#include <PiiAsyncCall.h>
+#include <PiiDelay.h>
+#include <PiiLog.h>
 
+#include <QBuffer>
 #include <QUrl>
+#include <QMutexLocker>
 
 PiiNetworkOutputOperation::Data::Data() :
   pNetworkClient(0),
-  requestMethod(PostRequest)
+  requestMethod(PostRequest),
+  compression(NoCompression),
+  bEncodingAccepted(false),
+  iSequence(0),
+  iQueueLength(0),
+  iConnectionCount(1),
+  iRetryCount(0),
+  iRetryDelay(100),
+  bSendersRunning(false)
 {
 }
 
 PiiNetworkOutputOperation::PiiNetworkOutputOperation() :
   PiiNetworkOperation(new Data)
 {
+  setProtectionLevel("queueLength", WriteWhenStopped);
+  setProtectionLevel("connectionCount", WriteWhenStopped);
+
+  connect(this, SIGNAL(stateChanged(PiiOperation::State)),
+          SLOT(flushQueue(PiiOperation::State)),
+          Qt::DirectConnection);
 }
 
 PiiNetworkOutputOperation::~PiiNetworkOutputOperation()
 {
   PII_D;
+  stopSenders();
   delete d->pNetworkClient;
 }
 
@@ -48,6 +69,9 @@ void PiiNetworkOutputOperation::check(bool reset)
   if (d->requestMethod == GetRequest && d->bBodyConnected)
     PII_THROW(PiiExecutionException, tr("Cannot send GET requests with a message body."));
 
+  if (d->iQueueLength > 0 && d->lstOutputNames.size() > 0)
+    PII_THROW(PiiExecutionException, tr("Server responses cannot be received if requests are sent in the background."));
+
   QUrl url(d->strServerUri);
   if (!url.isValid())
     PII_THROW(PiiExecutionException, tr("The supplied server URI is not valid."));
@@ -58,6 +82,10 @@ void PiiNetworkOutputOperation::check(bool reset)
   delete d->pNetworkClient;
   d->pNetworkClient = new PiiNetworkClient(d->strServerUri);
   d->pNetworkClient->setConnectionTimeout(d->iResponseTimeout);
+
+  // The server may have changed; negotiate again.
+  d->bEncodingAccepted = false;
+  d->vecDeltaReferences.fill(qMakePair(qint64(0), QByteArray()), d->lstInputNames.size());
 }
 
 void PiiNetworkOutputOperation::process()
@@ -65,129 +93,339 @@ void PiiNetworkOutputOperation::process()
   PII_D;
   try
     {
-      if (d->requestMethod == PostRequest)
-        sendPostRequest();
-      else
-        sendGetRequest();
+      QList<Request> lstRequests(createRequests());
+      if (d->iQueueLength > 0)
+        {
+          for (int i=0; i<lstRequests.size(); ++i)
+            enqueue(lstRequests[i]);
+          return;
+        }
+      for (int i=0; i<lstRequests.size(); ++i)
+        sendRequest(d->pNetworkClient, lstRequests[i]);
     }
   catch (PiiSerializationException& ex)
     {
       PII_THROW(PiiExecutionException, ex.message());
     }
+
+  emitOutputValues();
 }
 
-void PiiNetworkOutputOperation::sendGetRequest()
+QList<PiiNetworkOutputOperation::Request> PiiNetworkOutputOperation::createRequests()
 {
   PII_D;
-  //qDebug("PiiNetworkOutputOperation::sendGetRequest()");
-  QIODevice *pSocket = d->pNetworkClient->openConnection();
-  if (pSocket == 0)
+  QList<Request> lstRequests;
+  Request request;
+  request.method = d->requestMethod;
+  request.iIndex = -1;
+  if (d->requestMethod == GetRequest)
+    {
+      for (int i=0; i<d->lstInputNames.size(); ++i)
+        request.lstQueryValues << qMakePair(d->lstInputNames[i],
+                                            PiiYdin::convertToQString(inputAt(i+d->iStaticInputCount)));
+      lstRequests << request;
+    }
+  else if (d->bBodyConnected)
     {
-      if (!d->bIgnoreErrors)
-        PII_THROW(PiiExecutionException, tr("Could not open connection to %1.").arg(d->strServerUri));
-      return;
+      request.strContentType = d->bTypeConnected ?
+        PiiYdin::convertToQString(d->pTypeInput) :
+        d->strContentType;
+      request.strBody = PiiYdin::convertToQString(d->pBodyInput);
+      lstRequests << request;
     }
+  else
+    {
+      // Each object is posted separately.
+      for (int i=0; i<d->lstInputNames.size(); ++i)
+        {
+          request.iIndex = i;
+          request.varObject = inputAt(i+d->iStaticInputCount)->firstObject();
+          lstRequests << request;
+        }
+    }
+  return lstRequests;
+}
+
+void PiiNetworkOutputOperation::enqueue(const Request& request)
+{
+  PII_D;
+  QMutexLocker lock(&d->queueMutex);
+  if (!d->bSendersRunning)
+    startSenders();
+
+  while (d->queRequests.size() >= d->iQueueLength)
+    d->spaceAvailable.wait(&d->queueMutex);
+
+  d->queRequests.enqueue(request);
+  d->requestAvailable.wakeOne();
+}
+
+void PiiNetworkOutputOperation::startSenders()
+{
+  PII_D;
+  d->bSendersRunning = true;
+  for (int i=0; i<qMax(d->iConnectionCount, 1); ++i)
+    {
+      QThread* pThread = Pii::createAsyncCall(this, &PiiNetworkOutputOperation::sendRequests);
+      d->lstSenders << pThread;
+      pThread->start();
+    }
+}
+
+void PiiNetworkOutputOperation::stopSenders()
+{
+  PII_D;
+  d->queueMutex.lock();
+  d->bSendersRunning = false;
+  d->requestAvailable.wakeAll();
+  d->queueMutex.unlock();
+
+  // Requests still in the queue will be sent before the threads exit.
+  for (int i=0; i<d->lstSenders.size(); ++i)
+    {
+      d->lstSenders[i]->wait();
+      delete d->lstSenders[i];
+    }
+  d->lstSenders.clear();
+}
+
+void PiiNetworkOutputOperation::flushQueue(PiiOperation::State state)
+{
+  if (state == PiiOperation::Stopped)
+    stopSenders();
+}
+
+void PiiNetworkOutputOperation::sendRequests()
+{
+  PII_D;
+  // Sockets must be used in the thread that created them. Each
+  // sender thus keeps a connection of its own.
+  PiiNetworkClient client(d->strServerUri);
+  client.setConnectionTimeout(d->iResponseTimeout);
+  forever
+    {
+      Request request;
+      {
+        QMutexLocker lock(&d->queueMutex);
+        while (d->bSendersRunning && d->queRequests.isEmpty())
+          d->requestAvailable.wait(&d->queueMutex);
+        if (d->queRequests.isEmpty())
+          return;
+        request = d->queRequests.dequeue();
+        d->spaceAvailable.wakeOne();
+      }
+      try
+        {
+          sendRequest(&client, request);
+        }
+      catch (PiiException& ex)
+        {
+          piiWarning(tr("Sending a request to %1 failed: %2").arg(d->strServerUri).arg(ex.message()));
+        }
+    }
+}
+
+void PiiNetworkOutputOperation::sendRequest(PiiNetworkClient* client, const Request& request)
+{
+  PII_D;
+  for (int iAttempt = 0; ; ++iAttempt)
+    {
+      try
+        {
+          if (request.method == GetRequest)
+            sendGetRequest(client, request);
+          else if (request.iIndex < 0)
+            postBody(client, request);
+          else
+            {
+              // A rejected encoded request is sent again with less
+              // encoding. Plain requests are never rejected this way.
+              while (!postObject(client, request.iIndex, request.varObject)) ;
+            }
+          return;
+        }
+      catch (PiiExecutionException&)
+        {
+          if (iAttempt >= d->iRetryCount)
+            throw;
+        }
+      // The connection may be in an unknown state.
+      client->closeConnection();
+      PiiDelay::msleep(d->iRetryDelay << qMin(iAttempt, 10));
+    }
+}
+
+QIODevice* PiiNetworkOutputOperation::openConnection(PiiNetworkClient* client)
+{
+  PII_D;
+  QIODevice* pSocket = client->openConnection();
+  if (pSocket == 0 && !d->bIgnoreErrors)
+    PII_THROW(PiiExecutionException, tr("Could not open connection to %1.").arg(d->strServerUri));
+  return pSocket;
+}
+
+void PiiNetworkOutputOperation::sendGetRequest(PiiNetworkClient* client, const Request& request)
+{
+  PII_D;
+  //qDebug("PiiNetworkOutputOperation::sendGetRequest()");
+  QIODevice *pSocket = openConnection(client);
+  if (pSocket == 0)
+    return;
   PiiHttpDevice h(pSocket, PiiHttpDevice::Client);
   h.setRequest("GET", d->strUri);
-  for (int i=0; i<d->lstInputNames.size(); ++i)
-    h.addQueryValue(d->lstInputNames[i], PiiYdin::convertToQString(inputAt(i+d->iStaticInputCount)));
+  for (int i=0; i<request.lstQueryValues.size(); ++i)
+    h.addQueryValue(request.lstQueryValues[i].first, request.lstQueryValues[i].second);
   if (!d->strHost.isEmpty())
     h.setHeader("Host", d->strHost);
   h.finish();
 
   readResponse(h);
-
-  emitOutputValues();
 }
 
-void PiiNetworkOutputOperation::sendPostRequest()
+void PiiNetworkOutputOperation::postBody(PiiNetworkClient* client, const Request& request)
 {
   PII_D;
-  if (d->bBodyConnected)
-    {
-      QIODevice *pSocket = d->pNetworkClient->openConnection();
-      if (pSocket == 0)
-        {
-          if (!d->bIgnoreErrors)
-            PII_THROW(PiiExecutionException, tr("Could not open connection to %1.").arg(d->strServerUri));
-          return;
-        }
-      PiiHttpDevice h(pSocket, PiiHttpDevice::Client);
-      h.setRequest("POST", d->strUri);
-      if (!d->strHost.isEmpty())
-        h.setHeader("Host", d->strHost);
-      h.setHeader("Content-Type",
-                  d->bTypeConnected ?
-                  PiiYdin::convertToQString(d->pTypeInput) :
-                  d->strContentType);
+  QIODevice *pSocket = openConnection(client);
+  if (pSocket == 0)
+    return;
+  PiiHttpDevice h(pSocket, PiiHttpDevice::Client);
+  h.setRequest("POST", d->strUri);
+  if (!d->strHost.isEmpty())
+    h.setHeader("Host", d->strHost);
+  h.setHeader("Content-Type", request.strContentType);
+
+  h.print(request.strBody);
+
+  h.finish();
 
-      h.print(PiiYdin::convertToQString(d->pBodyInput));
+  readResponse(h);
+}
+
+bool PiiNetworkOutputOperation::postObject(PiiNetworkClient* client, int index, const PiiVariant& obj)
+{
+  PII_D;
+  QIODevice *pSocket = openConnection(client);
+  if (pSocket == 0)
+    return true;
+  PiiHttpDevice h(pSocket, PiiHttpDevice::Client);
+  h.setRequest("POST", d->strUri);
+  if (!d->strHost.isEmpty())
+    h.setHeader("Host", d->strHost);
+  h.setHeader(pContentNameHeader, d->lstInputNames[index]);
 
-      h.finish();
+  d->queueMutex.lock();
+  const bool bEncodingAccepted = d->bEncodingAccepted;
+  d->queueMutex.unlock();
 
-      readResponse(h);
+  bool bEncoded = false;
+  // QStrings are just printed
+  if (obj.type() == PiiYdin::QStringType)
+    {
+      h.startOutputFiltering(new PiiStreamBuffer);
+      h.setHeader("Content-Type", "text/plain");
+      h.print(obj.valueAs<QString>());
+    }
+  else if (d->compression != NoCompression && bEncodingAccepted)
+    {
+      writeEncodedObject(h, index, obj);
+      bEncoded = true;
     }
+  // Everything else is serialized
   else
     {
-      for (int i=0; i<d->lstInputNames.size(); ++i)
-        {
-          QIODevice *pSocket = d->pNetworkClient->openConnection();
-          if (pSocket == 0)
-            {
-              if (!d->bIgnoreErrors)
-                PII_THROW(PiiExecutionException, tr("Could not open connection to %1.").arg(d->strServerUri));
-              return;
-            }
-          PiiHttpDevice h(pSocket, PiiHttpDevice::Client);
-          h.setRequest("POST", d->strUri);
-          if (!d->strHost.isEmpty())
-            h.setHeader("Host", d->strHost);
-          h.setHeader(pContentNameHeader, d->lstInputNames[i]);
-          h.startOutputFiltering(new PiiStreamBuffer);
-
-          PiiVariant obj = inputAt(i+d->iStaticInputCount)->firstObject();
-          // Everything but QStrings are serializer
-          if (obj.type() != PiiYdin::QStringType)
-            {
-              h.setHeader("Content-Type", PiiNetwork::pTextArchiveContentType);
+      h.startOutputFiltering(new PiiStreamBuffer);
+      h.setHeader("Content-Type", PiiNetwork::pTextArchiveContentType);
 
-              PiiGenericTextOutputArchive outputArchive(&h);
-              outputArchive << inputAt(i+d->iStaticInputCount)->firstObject();
+      PiiGenericTextOutputArchive outputArchive(&h);
+      outputArchive << obj;
+    }
+  h.finish();
 
-              // This if block ensures the archive flushes itself to the
-              // device before finish().
-            }
-          // QStrings are just printed
-          else
+  return readResponse(h, bEncoded);
+}
+
+void PiiNetworkOutputOperation::writeEncodedObject(PiiHttpDevice& h, int index, const PiiVariant& obj)
+{
+  PII_D;
+  QByteArray aPayload;
+  QStringList lstCodings;
+  if (PiiYdin::isMatrixType(obj.type()))
+    {
+      h.setHeader("Content-Type", PiiWireFormat::pContentType);
+      aPayload = PiiWireFormat::toByteArray(obj);
+      // Background senders cannot share reference frames.
+      if (d->compression == DeltaCompression && d->iQueueLength == 0)
+        {
+          QPair<qint64,QByteArray>& reference = d->vecDeltaReferences[index];
+          const qint64 iSequence = ++d->iSequence;
+          h.setHeader(pSequenceHeader, iSequence);
+          // The header is part of the frame. Equal sizes thus mean
+          // equal types and dimensions.
+          if (reference.second.size() == aPayload.size())
             {
-              h.setHeader("Content-Type", "text/plain");
-              h.print(obj.valueAs<QString>());
+              h.setHeader(pDeltaBaseHeader, reference.first);
+              QByteArray aDelta(xorFrames(aPayload, reference.second));
+              reference.second = aPayload;
+              aPayload = aDelta;
+              lstCodings << pDeltaEncoding;
             }
-          h.finish();
-
-          readResponse(h);
+          else
+            reference.second = aPayload;
+          reference.first = iSequence;
         }
     }
+  else
+    {
+      h.setHeader("Content-Type", PiiNetwork::pTextArchiveContentType);
+      QBuffer buffer(&aPayload);
+      buffer.open(QIODevice::WriteOnly);
+      PiiGenericTextOutputArchive outputArchive(&buffer);
+      outputArchive << obj;
+    }
 
-  emitOutputValues();
+  // The lowest level is usually the fastest way through a 100 Mbit/s link.
+  aPayload = qCompress(aPayload, 1);
+  lstCodings << pDeflateEncoding;
+
+  h.setHeader("Content-Encoding", lstCodings.join(", "));
+  h.setHeader("Content-Length", aPayload.size());
+  h.write(aPayload);
 }
 
-void PiiNetworkOutputOperation::readResponse(PiiHttpDevice& h)
+bool PiiNetworkOutputOperation::readResponse(PiiHttpDevice& h, bool encoded)
 {
   PII_D;
   if (!h.readHeader())
     {
       // Cannot ignore errors if we need outputs
       if (d->bIgnoreErrors && d->lstOutputNames.size() == 0)
-        return;
+        return true;
       PII_THROW(PiiExecutionException, tr("Error in reading HTTP response headers."));
     }
 
+  // The server announces the codings it accepts in every response.
+  const bool bEncodingAccepted = h.responseHeader().value("Accept-Encoding").contains(pDeflateEncoding);
+  d->queueMutex.lock();
+  d->bEncodingAccepted = bEncodingAccepted;
+  d->queueMutex.unlock();
+
+  if (encoded)
+    {
+      // The server lost the reference frame; send key frames.
+      if (h.status() == 409)
+        {
+          d->vecDeltaReferences.fill(qMakePair(qint64(0), QByteArray()));
+          return false;
+        }
+      if (h.status() == 415 && !bEncodingAccepted)
+        return false;
+    }
+
   if (h.status() != 200)
     {
       // Cannot ignore errors if we need outputs
       if (d->bIgnoreErrors && d->lstOutputNames.size() == 0)
-        return;
+        return true;
       PII_THROW(PiiExecutionException, tr("Server responded with status code %1.").arg(h.status()));
     }
 
@@ -195,9 +433,20 @@ void PiiNetworkOutputOperation::readResponse(PiiHttpDevice& h)
   // signal an error.
   if (d->lstOutputNames.size() > 0 && !decodeObjects(h, h.responseHeader()))
     PII_THROW(PiiExecutionException, tr("Could not decode server response."));
+  return true;
 }
 
 void PiiNetworkOutputOperation::setServerUri(const QString& serverUri) { _d()->strServerUri = serverUri; }
 QString PiiNetworkOutputOperation::serverUri() const { return _d()->strServerUri; }
 void PiiNetworkOutputOperation::setRequestMethod(const RequestMethod& requestMethod) { _d()->requestMethod = requestMethod; }
 PiiNetworkOutputOperation::RequestMethod PiiNetworkOutputOperation::requestMethod() const { return _d()->requestMethod; }
+void PiiNetworkOutputOperation::setCompression(const Compression& compression) { _d()->compression = compression; }
+PiiNetworkOutputOperation::Compression PiiNetworkOutputOperation::compression() const { return _d()->compression; }
+void PiiNetworkOutputOperation::setQueueLength(int queueLength) { _d()->iQueueLength = qMax(queueLength, 0); }
+int PiiNetworkOutputOperation::queueLength() const { return _d()->iQueueLength; }
+void PiiNetworkOutputOperation::setConnectionCount(int connectionCount) { _d()->iConnectionCount = qMax(connectionCount, 1); }
+int PiiNetworkOutputOperation::connectionCount() const { return _d()->iConnectionCount; }
+void PiiNetworkOutputOperation::setRetryCount(int retryCount) { _d()->iRetryCount = qMax(retryCount, 0); }
+int PiiNetworkOutputOperation::retryCount() const { return _d()->iRetryCount; }
+void PiiNetworkOutputOperation::setRetryDelay(int retryDelay) { _d()->iRetryDelay = qMax(retryDelay, 0); }
+int PiiNetworkOutputOperation::retryDelay() const { return _d()->iRetryDelay; }
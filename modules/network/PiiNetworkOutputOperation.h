@@ -18,7 +18,13 @@
 
 #include "PiiNetworkOperation.h"
 
+#include <QVector>
+#include <QQueue>
+#include <QMutex>
+#include <QWaitCondition>
+
 class PiiNetworkClient;
+class QThread;
 class PiiHttpDevice;
 
 /**
@@ -43,6 +49,23 @@ class PiiHttpDevice;
  * the corresponding output sockets. The number of output sockets and
  * their alias names can be configured with the [outputNames] property.
  *
+ * Background sending
+ * ------------------
+ *
+ * By default, each request is sent in [process()], and the next
+ * object can only be processed once the server has responded. Over
+ * slow links, this limits the throughput to one object per round
+ * trip. If [queueLength] is set to a positive value, requests are
+ * instead placed into a queue that is emptied by [connectionCount]
+ * background threads, each with a connection of its own. Responses
+ * are only checked for errors, which are logged, so this mode cannot
+ * be used if outputs are configured. With one connection, requests
+ * reach the server in the order they were received. All queued
+ * requests will be sent before the operation stops.
+ *
+ * Failed requests can be retried with an exponentially growing delay.
+ * See [retryCount] and [retryDelay].
+ *
  */
 class PiiNetworkOutputOperation : public PiiNetworkOperation
 {
@@ -61,6 +84,52 @@ class PiiNetworkOutputOperation : public PiiNetworkOperation
   Q_PROPERTY(RequestMethod requestMethod READ requestMethod WRITE setRequestMethod);
   Q_ENUMS(RequestMethod);
 
+  /**
+   * The coding applied to objects received in the configurable
+   * inputs before they are sent. Strings and objects sent through
+   * the `body` input are never encoded. Encoding is enabled only
+   * after the server has announced that it understands the codings;
+   * the first request is always sent as such. The default is
+   * `NoCompression`.
+   */
+  Q_PROPERTY(Compression compression READ compression WRITE setCompression);
+  Q_ENUMS(Compression);
+
+  /**
+   * The maximum number of requests waiting to be sent by background
+   * threads. Zero means that requests are sent synchronously in
+   * [process()]. If the queue is full, [process()] waits until a
+   * sender has taken a request from the queue. `DeltaCompression`
+   * falls back to `DeflateCompression` in this mode because a lost
+   * reference frame cannot be recovered once the request has left
+   * the queue. The default is zero.
+   */
+  Q_PROPERTY(int queueLength READ queueLength WRITE setQueueLength);
+
+  /**
+   * The number of concurrent connections used for sending requests
+   * if [queueLength] is positive. Since the connections work in
+   * parallel, the server may receive requests in a different order.
+   * The default is one.
+   */
+  Q_PROPERTY(int connectionCount READ connectionCount WRITE setConnectionCount);
+
+  /**
+   * The number of times a failed request is sent again before giving
+   * up. A request fails if the connection cannot be opened, the
+   * response cannot be read or the server responds with an error
+   * status that is not ignored. Note that the server may have
+   * received the request even if the response was lost. The default
+   * is zero.
+   */
+  Q_PROPERTY(int retryCount READ retryCount WRITE setRetryCount);
+
+  /**
+   * The number of milliseconds to wait before the first retry. The
+   * delay is doubled after each failed attempt. The default is 100.
+   */
+  Q_PROPERTY(int retryDelay READ retryDelay WRITE setRetryDelay);
+
   PII_OPERATION_SERIALIZATION_FUNCTION
 public:
   /**
@@ -76,6 +145,22 @@ public:
    */
   enum RequestMethod { PostRequest, GetRequest };
 
+  /**
+   * Codings for objects sent to the server.
+   *
+   * - `NoCompression` - objects are sent as text archives.
+   *
+   * - `DeflateCompression` - matrices are sent as binary PiiWireFormat
+   * frames and other objects as text archives, compressed with zlib.
+   *
+   * - `DeltaCompression` - like `DeflateCompression`, but a matrix
+   * whose type and size equal those of the previous matrix sent
+   * through the same input is XORed with it before compression.
+   * Unchanged pixels become zeros, which makes mostly static images
+   * compress to a fraction of their size.
+   */
+  enum Compression { NoCompression, DeflateCompression, DeltaCompression };
+
   PiiNetworkOutputOperation();
   ~PiiNetworkOutputOperation();
 
@@ -85,14 +170,46 @@ public:
   QString serverUri() const;
   void setRequestMethod(const RequestMethod& requestMethod);
   RequestMethod requestMethod() const;
+  void setCompression(const Compression& compression);
+  Compression compression() const;
+  void setQueueLength(int queueLength);
+  int queueLength() const;
+  void setConnectionCount(int connectionCount);
+  int connectionCount() const;
+  void setRetryCount(int retryCount);
+  int retryCount() const;
+  void setRetryDelay(int retryDelay);
+  int retryDelay() const;
 
 protected:
   void process();
 
+private slots:
+  void flushQueue(PiiOperation::State state);
+
 private:
-  void sendPostRequest();
-  void sendGetRequest();
-  void readResponse(PiiHttpDevice& h);
+  struct Request
+  {
+    RequestMethod method;
+    // The index of the configurable input, or -1 for the body.
+    int iIndex;
+    PiiVariant varObject;
+    QString strBody, strContentType;
+    QList<QPair<QString,QString> > lstQueryValues;
+  };
+
+  QList<Request> createRequests();
+  void enqueue(const Request& request);
+  void startSenders();
+  void stopSenders();
+  void sendRequests();
+  void sendRequest(PiiNetworkClient* client, const Request& request);
+  QIODevice* openConnection(PiiNetworkClient* client);
+  void sendGetRequest(PiiNetworkClient* client, const Request& request);
+  void postBody(PiiNetworkClient* client, const Request& request);
+  bool postObject(PiiNetworkClient* client, int index, const PiiVariant& obj);
+  void writeEncodedObject(PiiHttpDevice& h, int index, const PiiVariant& obj);
+  bool readResponse(PiiHttpDevice& h, bool encoded = false);
 
   /// @internal
   class Data : public PiiNetworkOperation::Data
@@ -104,6 +221,20 @@ private:
     QString strServerUri;
     QString strHost, strUri;
     RequestMethod requestMethod;
+    Compression compression;
+    bool bEncodingAccepted;
+    qint64 iSequence;
+    QVector<QPair<qint64,QByteArray> > vecDeltaReferences;
+    int iQueueLength;
+    int iConnectionCount;
+    int iRetryCount;
+    int iRetryDelay;
+    bool bSendersRunning;
+    // Protects queRequests and bEncodingAccepted.
+    QMutex queueMutex;
+    QWaitCondition requestAvailable, spaceAvailable;
+    QQueue<Request> queRequests;
+    QList<QThread*> lstSenders;
   };
   PII_D_FUNC;
 };
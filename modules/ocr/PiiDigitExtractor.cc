@@ -25,6 +25,8 @@
 #include <PiiImage.h>
 #include <functional>
 #include <PiiBinaryInputArchive.h>
+#include <PiiParallel.h>
+#include <PiiTransposedMatrix.h>
 
 using namespace Pii;
 using namespace PiiYdin;
@@ -153,28 +155,13 @@ template <class T> void PiiDigitExtractor::extractDigits(const PiiMatrix<T>& ima
   //now each row of matBB2 should contain bounding box for one digit
   Pii::sortRows(matBB2,0);
 
-  PiiMatrix<int> matScaledDigit;
+  //Classify all digits at once
+  QVector<double> vecLabels(classify(matThresholded, matBB2));
 
   int iNumber = 0;
-  //Classify each digit
   for (int nbr=0; nbr<matBB2.rows(); nbr++)
     {
-      //Extract digit from thresholded image in center of image "matDigit"
-      int size = Pii::max(matBB2(nbr,2),matBB2(nbr,3));
-      PiiMatrix<int> matDigit(size,size);
-      matDigit=0;
-      int xskip=(size-matBB2(nbr,2))/2;
-      int yskip=(size-matBB2(nbr,3))/2;
-
-      for (int y=0;y<matBB2(nbr,3);y++)
-        for (int x=0;x<matBB2(nbr,2);x++)
-          matDigit(y+yskip,x+xskip) = matThresholded(matBB2(nbr,1)+y,matBB2(nbr,0)+x)*255;
-
-      //Scale this one into 20x20 image
-      matScaledDigit = PiiImage::scale(matDigit, 20, 20);
-
-      //Classify image matScaledDigit
-      int label = classify(matScaledDigit);
+      int label = (int)vecLabels[nbr];
       sDigitsString.append(QString::number(label));
       matDigits.appendColumn(PiiMatrix<int> (1,1,label));
       iNumber += Pii::pow(10, matBB2.rows()-nbr-1) * label;
@@ -352,23 +339,73 @@ void PiiDigitExtractor::initializeKnnClassifier()
   ia >> d->matBaseDigitVectors;
 }
 
-//Converts segmented image into (PCA-reduced) feature vector, and classifies it using kNN
-int PiiDigitExtractor::classify(const PiiMatrix<int> &scaledImage)
+namespace
+{
+  // Extracts digit candidates from the thresholded image, centers and
+  // scales them, and stores each as a normalized row of a sample
+  // matrix.
+  struct DigitNormalizer
+  {
+    DigitNormalizer(const PiiMatrix<int>& thresholded, const PiiMatrix<int>& boundingBoxes,
+                    const PiiMatrix<float>& mean, PiiMatrix<float>& digits) :
+      thresholded(thresholded), boundingBoxes(boundingBoxes), mean(mean),
+      digitRows(digits)
+    {}
+
+    void operator() (int firstDigit, int digitCount)
+    {
+      for (int nbr=firstDigit; nbr<firstDigit+digitCount; ++nbr)
+        {
+          //Extract digit from thresholded image in center of image "matDigit"
+          int size = Pii::max(boundingBoxes(nbr,2),boundingBoxes(nbr,3));
+          PiiMatrix<int> matDigit(size,size);
+          int xskip=(size-boundingBoxes(nbr,2))/2;
+          int yskip=(size-boundingBoxes(nbr,3))/2;
+
+          for (int y=0;y<boundingBoxes(nbr,3);y++)
+            for (int x=0;x<boundingBoxes(nbr,2);x++)
+              matDigit(y+yskip,x+xskip) = thresholded(boundingBoxes(nbr,1)+y,boundingBoxes(nbr,0)+x)*255;
+
+          //Scale this one into 20x20 image
+          const PiiMatrix<int> matScaledDigit(PiiImage::scale(matDigit, 20, 20));
+
+          //reshapes data column by column and normalizes it
+          float* pDigit = digitRows.row(nbr);
+          for (int i=0;i<20;i++)
+            for (int j=0;j<20;j++)
+              pDigit[j*20+i] = (matScaledDigit(i,j)-127.5f)/127.5f - mean(j*20+i,0);
+        }
+    }
+
+    const PiiMatrix<int>& thresholded;
+    const PiiMatrix<int>& boundingBoxes;
+    const PiiMatrix<float>& mean;
+    const Pii::BandRows<float> digitRows;
+  };
+}
+
+//Converts the digits in the given bounding boxes into (PCA-reduced)
+//feature vectors, and classifies them using kNN
+QVector<double> PiiDigitExtractor::classify(const PiiMatrix<int>& thresholded, const PiiMatrix<int>& boundingBoxes)
 {
   PII_D;
+  const int iDigits = boundingBoxes.rows();
+  if (iDigits == 0)
+    return QVector<double>();
 
-  //reshapes data, and makes PCA transform
-  PiiMatrix<float> fFullVector(400,1);
-  for (int i=0;i<20;i++)
-    for (int j=0;j<20;j++)
-      fFullVector(j*20+i,0)=scaledImage(i,j);
+  // Scaling a candidate and matching it against all models are both
+  // worth a thread even for a handful of digits.
+  Pii::ParallelExecution policy;
+  policy.minBandRows = 2;
 
-  fFullVector = (fFullVector-127.5)/127.5;
-  fFullVector -= d->matMeanDigitVector;
+  PiiMatrix<float> matDigits(PiiMatrix<float>::uninitialized(iDigits, 400));
+  Pii::forEachBand(policy, iDigits, 0,
+                   DigitNormalizer(thresholded, boundingBoxes, d->matMeanDigitVector, matDigits));
 
-  PiiMatrix<float> matFeatureVector=d->matBaseDigitVectors*fFullVector;
+  //PCA transform for all digits at once. Each row is a feature vector.
+  PiiMatrix<float> matFeatures(matDigits * Pii::transpose(d->matBaseDigitVectors));
 
-  return (int)d->digitClassifier.classify(matFeatureVector[0]);
+  return d->digitClassifier.classify(policy, matFeatures);
 }
 
 void PiiDigitExtractor::setInverse(bool inverse) { _d()->bInverse = inverse; }
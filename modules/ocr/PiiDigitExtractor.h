@@ -76,7 +76,7 @@ private:
   void createBlob(PiiMatrix<int> &boundingBoxes);
   bool isIncorrectBlob(const PiiMatrix<int> &boundingBoxes, int index,int imageHeight);
   void initializeKnnClassifier();
-  int classify(const PiiMatrix<int> &scaledImage);
+  QVector<double> classify(const PiiMatrix<int>& thresholded, const PiiMatrix<int>& boundingBoxes);
 
   /// @internal
   class Data : public PiiDefaultOperation::Data
@@ -281,6 +281,41 @@ namespace PiiOpenCv
   {
     return PiiCvMat<T, true>(mat);
   }
+
+  /**
+   * Creates a cv::Mat header that shares the data of *mat*. No data
+   * is copied, and the row stride of the matrix is preserved. This
+   * makes it possible to pass submatrices to OpenCV functions. If
+   * an OpenCV function writes to the returned object without
+   * reallocating it, the changes are visible in *mat*. The header
+   * must not outlive *mat*.
+   *
+   * ~~~(c++)
+   * PiiMatrix<float> matResult(rows, columns);
+   * cv::Mat matResultView(PiiOpenCv::matView(matResult));
+   * cv::matchTemplate(PiiOpenCv::matView(image), PiiOpenCv::matView(templ),
+   *                   matResultView, CV_TM_CCORR);
+   * ~~~
+   */
+  template <class T> inline cv::Mat matView(PiiMatrix<T>& mat)
+  {
+    if (mat.isEmpty())
+      return cv::Mat();
+    return cv::Mat(mat.rows(), mat.columns(), CvMatTraits<T>::matrixType, mat.row(0), mat.stride());
+  }
+
+  /**
+   * Creates a cv::Mat header that shares the data of a const matrix.
+   * The returned object must only be used as an input to OpenCV
+   * functions.
+   */
+  template <class T> inline cv::Mat matView(const PiiMatrix<T>& mat)
+  {
+    if (mat.isEmpty())
+      return cv::Mat();
+    return cv::Mat(mat.rows(), mat.columns(), CvMatTraits<T>::matrixType,
+                   const_cast<T*>(mat.row(0)), mat.stride());
+  }
 }
 
 #endif //_PIIOPENCVIMAGE_H
@@ -17,6 +17,7 @@
 
 #include <PiiYdinTypes.h>
 #include "PiiOpenCv.h"
+#include <PiiTemplateMatching.h>
 #include <PiiImageFileReader.h>
 #include <PiiThresholding.h>
 #include <PiiLabeling.h>
@@ -26,7 +27,9 @@ PiiTemplateMatcher::Data::Data() :
   iMatchingMethod(CV_TM_SQDIFF),
   pTemplate(0),
   pMask(0),
-  dThreshold(1.0)
+  dThreshold(1.0),
+  iPyramidLevels(1),
+  dCoarseThreshold(0.5)
 {
 }
 
@@ -65,6 +68,7 @@ void PiiTemplateMatcher::setTemplateFile(const QString& fileName)
   delete d->pTemplate;
   d->strTemplateFile = fileName;
   d->pTemplate = PiiImageFileReader::readGrayImage(fileName)->toMatrixPointer();
+  d->matFloatTemplate = d->pTemplate != 0 ? PiiMatrix<float>(*d->pTemplate) : PiiMatrix<float>();
 }
 
 void PiiTemplateMatcher::setMaskFile(const QString& maskFile)
@@ -111,16 +115,29 @@ template <class T> void PiiTemplateMatcher::match(const PiiMatrix<T>& image)
       return;
     }
 
-  PiiMatrix<float> matResult(image.rows() - d->pTemplate->rows() + 1,
-                             image.columns() - d->pTemplate->columns() + 1);
-
-  // Cast template image to the correct type
-  const PiiMatrix<T> matTmpl(*d->pTemplate); // cast to the correct type
-
-  cvMatchTemplate(PiiOpenCv::iplImage(image),
-                  PiiOpenCv::iplImage(matTmpl),
-                  PiiOpenCv::iplImage(matResult),
-                  d->iMatchingMethod);
+  PiiMatrix<float> matResult;
+  if (d->iMatchingMethod == CV_TM_CCOEFF_NORMED)
+    {
+      // Native FFT-based correlation. Shares the input without
+      // conversion and supports coarse-to-fine search.
+      if (d->iPyramidLevels > 1)
+        matResult = PiiImage::pyramidCorrelation(Pii::ParallelExecution(), image, *d->pTemplate,
+                                                 d->iPyramidLevels, d->dCoarseThreshold);
+      else
+        matResult = PiiImage::normalizedCorrelation(Pii::ParallelExecution(), image, *d->pTemplate);
+    }
+  else
+    {
+      matResult = PiiMatrix<float>(image.rows() - d->pTemplate->rows() + 1,
+                                   image.columns() - d->pTemplate->columns() + 1);
+      // OpenCV writes directly to matResult because its size and
+      // type are already correct.
+      cv::Mat matResultView(PiiOpenCv::matView(matResult));
+      cv::matchTemplate(PiiOpenCv::matView(image),
+                        PiiOpenCv::matView(templateAs((T*)0)),
+                        matResultView,
+                        d->iMatchingMethod);
+    }
 
   emitObject(matResult);
 
@@ -155,3 +172,7 @@ QString PiiTemplateMatcher::templateFile() const { return _d()->strTemplateFile;
 QString PiiTemplateMatcher::maskFile() const { return _d()->strMaskFile; }
 void PiiTemplateMatcher::setThreshold(double threshold) { _d()->dThreshold = threshold; }
 double PiiTemplateMatcher::threshold() const { return _d()->dThreshold; }
+void PiiTemplateMatcher::setPyramidLevels(int pyramidLevels) { if (pyramidLevels > 0) _d()->iPyramidLevels = pyramidLevels; }
+int PiiTemplateMatcher::pyramidLevels() const { return _d()->iPyramidLevels; }
+void PiiTemplateMatcher::setCoarseThreshold(double coarseThreshold) { _d()->dCoarseThreshold = coarseThreshold; }
+double PiiTemplateMatcher::coarseThreshold() const { return _d()->dCoarseThreshold; }
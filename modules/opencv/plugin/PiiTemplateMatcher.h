@@ -22,9 +22,12 @@
 
 /**
  * Correlates a template against an image. This operation uses
- * cvMatchTemplate() for matching. It is mostly an illustration on how
- * to integrate OpenCV to Into and not intended for production-grade
- * applications.
+ * cv::matchTemplate() for matching. Images are passed to OpenCV as
+ * views that share the data of the input matrices (see
+ * PiiOpenCv::matView()). The `NormalizedCorrelationCoeff` method is
+ * calculated natively with PiiImage::normalizedCorrelation(), which
+ * also makes a coarse-to-fine search on an image pyramid possible
+ * (see [pyramidLevels]).
  *
  * Inputs
  * ------
@@ -81,6 +84,23 @@ class PiiTemplateMatcher : public PiiDefaultOperation
   Q_PROPERTY(MatchingMethod matchingMethod READ matchingMethod WRITE setMatchingMethod);
   Q_ENUMS(MatchingMethod);
 
+  /**
+   * The number of image pyramid levels used in coarse-to-fine
+   * search. Only used with the `NormalizedCorrelationCoeff` method.
+   * The default value is one, which means that the correlation is
+   * calculated everywhere at full resolution. With more levels, the
+   * full correlation is calculated only at the coarsest level, and
+   * the result is refined around the positions that reach
+   * [coarseThreshold]. Elsewhere, the correlation will be zero. See
+   * PiiImage::pyramidCorrelation().
+   */
+  Q_PROPERTY(int pyramidLevels READ pyramidLevels WRITE setPyramidLevels);
+  /**
+   * The minimum correlation a position must reach at coarse pyramid
+   * levels to be refined. The default is 0.5.
+   */
+  Q_PROPERTY(double coarseThreshold READ coarseThreshold WRITE setCoarseThreshold);
+
   PII_OPERATION_SERIALIZATION_FUNCTION
 public:
   /**
@@ -109,6 +129,10 @@ public:
   QString maskFile() const;
   void setThreshold(double threshold);
   double threshold() const;
+  void setPyramidLevels(int pyramidLevels);
+  int pyramidLevels() const;
+  void setCoarseThreshold(double coarseThreshold);
+  double coarseThreshold() const;
 
 protected:
   void process();
@@ -122,7 +146,11 @@ private:
 
     int iMatchingMethod;
     PiiMatrix<unsigned char> *pTemplate, *pMask;
+    // Converted once to avoid converting for each frame.
+    PiiMatrix<float> matFloatTemplate;
     double dThreshold;
+    int iPyramidLevels;
+    double dCoarseThreshold;
     QString strTemplateFile;
     QString strMaskFile;
   };
@@ -130,6 +158,8 @@ private:
 
   template <class T> void match(const PiiVariant& obj);
   template <class T> void match(const PiiMatrix<T>& image);
+  const PiiMatrix<unsigned char>& templateAs(unsigned char*) const { return *_d()->pTemplate; }
+  const PiiMatrix<float>& templateAs(float*) const { return _d()->matFloatTemplate; }
 };
 
 
@@ -17,6 +17,9 @@
 #include "lbfgs.h"
 #include "lmmin.h"
 
+#include <cmath>
+#include <algorithm>
+
 static void lbfgsCallbackFunction(ap::real_1d_array x, double& f, ap::real_1d_array& g, void* data)
 {
   PiiOptimization::GradientFunction<double>* func = reinterpret_cast<PiiOptimization::GradientFunction<double>*>(data);
@@ -30,6 +33,55 @@ namespace PiiOptimization
   {
     const ResidualFunction<double>* func;
     PiiMatrix<double>* matJacobian;
+    const Pii::ParallelExecution* policy;
+    double dStep;
+  };
+
+  /* Estimates a band of Jacobian columns (one for each parameter) by
+   * forward differences. The step size and the order of operations
+   * are the same as in lm_lmdif(), which makes the result identical
+   * to the serial estimate.
+   */
+  struct ForwardDifferenceBand
+  {
+    ForwardDifferenceBand(const ResidualFunction<double>* func, const double* params, int paramCount,
+                          const double* residuals, int residualCount, double step, double* jacobian) :
+      pFunc(func), pParams(params), iParamCount(paramCount),
+      pResiduals(residuals), iResidualCount(residualCount),
+      dStep(step), pJacobian(jacobian)
+    {}
+
+    void operator() (int firstParam, int paramCount)
+    {
+      // Each band needs its own copy of the parameters and a buffer
+      // for the residuals.
+      PiiMatrix<double> matParams(PiiMatrix<double>::uninitialized(1, iParamCount));
+      PiiMatrix<double> matResiduals(PiiMatrix<double>::uninitialized(1, iResidualCount));
+      double* pX = matParams.row(0);
+      double* pR = matResiduals.row(0);
+      std::copy(pParams, pParams + iParamCount, pX);
+      for (int j=firstParam; j<firstParam+paramCount; ++j)
+        {
+          const double dTemp = pX[j];
+          double dH = dStep * std::fabs(dTemp);
+          if (dH == 0)
+            dH = dStep;
+          pX[j] = dTemp + dH;
+          pFunc->residualValues(pX, pR);
+          pX[j] = dTemp;
+          double* pColumn = pJacobian + std::size_t(j) * iResidualCount;
+          for (int i=0; i<iResidualCount; ++i)
+            pColumn[i] = (pR[i] - pResiduals[i]) / dH;
+        }
+    }
+
+    const ResidualFunction<double>* pFunc;
+    const double* pParams;
+    int iParamCount;
+    const double* pResiduals;
+    int iResidualCount;
+    double dStep;
+    double* pJacobian;
   };
 }
 
@@ -65,6 +117,27 @@ static void lmCallbackJacobianFunction(double *par, int /*m_dat*/, double* /*fja
   funcData->func->jacobian(par, *funcData->matJacobian);
 }
 
+/*
+ * Estimates the Jacobian by forward differences in parallel. The
+ * columns of fjac (one for each parameter) are distributed to
+ * threads.
+ */
+static void lmCallbackParallelJacobianFunction(double *par, int m_dat, double* fjac, void *data)
+{
+  PiiOptimization::LmCallbackData* funcData = reinterpret_cast<PiiOptimization::LmCallbackData*>(data);
+  const int iParams = funcData->matJacobian->rows();
+  PiiMatrix<double> matResiduals(PiiMatrix<double>::uninitialized(1, m_dat));
+  funcData->func->residualValues(par, matResiduals.row(0));
+
+  // Each column takes a full evaluation of the residuals.
+  Pii::ParallelExecution policy(*funcData->policy);
+  policy.minBandRows = 1;
+  Pii::forEachBand(policy, iParams, 0,
+                   PiiOptimization::ForwardDifferenceBand(funcData->func, par, iParams,
+                                                          matResiduals.row(0), m_dat,
+                                                          funcData->dStep, fjac));
+}
+
 
 static void lmCallbackPrintFunction(int /*n_par*/, double* /*par*/, int /*m_dat*/, double* /*fvec*/,
                                     void* /*data*/, int /*iflag*/, int /*iter */, int /*nfev*/)
@@ -73,14 +146,22 @@ static void lmCallbackPrintFunction(int /*n_par*/, double* /*par*/, int /*m_dat*
 
 namespace PiiOptimization
 {
-  PiiMatrix<double> lmMinimize(const ResidualFunction<double>* function,
-                               const PiiMatrix<double>& initialParams,
-                               int maxIterations,
-                               double ftol, double xtol, double gtol,
-                               double epsilon, double stepBound)
+  static PiiMatrix<double> lmMinimize(const Pii::ParallelExecution* policy,
+                                      const ResidualFunction<double>* function,
+                                      const PiiMatrix<double>& initialParams,
+                                      int maxIterations,
+                                      double ftol, double xtol, double gtol,
+                                      double epsilon, double stepBound)
   {
-    PiiMatrix<double> matJacobian(function->functionCount(), initialParams.columns());
-    LmCallbackData data = { function, &matJacobian };
+    // lm_lmdif() expects an N-by-M Jacobian with no padding between
+    // rows.
+    const int iFunctions = function->functionCount(), iParams = initialParams.columns();
+    PiiMatrix<double> matJacobian(PiiMatrix<double>::uninitialized(iParams, iFunctions,
+                                                                   iFunctions * sizeof(double)));
+    matJacobian = 0.0;
+    // The same step as in lm_lmdif()
+    const double dStep = std::sqrt(qMax(epsilon, 0.555e-16));
+    LmCallbackData data = { function, &matJacobian, policy, dStep };
 
     PiiMatrix<double> params(initialParams);
     /*
@@ -108,11 +189,16 @@ namespace PiiOptimization
 
     // If the function is provided with a Jacobian, we don't need to
     // spend time estimating it but let the callback function do the
-    // task.
-    lm_jacobian_ftype* jacobianCallback = function->hasJacobian() ? lmCallbackJacobianFunction : 0;
+    // task. Otherwise, lm_lmdif() estimates it serially unless we
+    // are allowed to do it in parallel.
+    lm_jacobian_ftype* jacobianCallback = 0;
+    if (function->hasJacobian())
+      jacobianCallback = lmCallbackJacobianFunction;
+    else if (policy != 0 && iParams > 1)
+      jacobianCallback = lmCallbackParallelJacobianFunction;
 
-    lm_minimize(function->functionCount(),
-                initialParams.columns(),
+    lm_minimize(iFunctions,
+                iParams,
                 params.row(0),
                 lmCallbackFunction,
                 lmCallbackPrintFunction,
@@ -122,6 +208,27 @@ namespace PiiOptimization
     return params;
   }
 
+  PiiMatrix<double> lmMinimize(const ResidualFunction<double>* function,
+                               const PiiMatrix<double>& initialParams,
+                               int maxIterations,
+                               double ftol, double xtol, double gtol,
+                               double epsilon, double stepBound)
+  {
+    return lmMinimize(0, function, initialParams, maxIterations,
+                      ftol, xtol, gtol, epsilon, stepBound);
+  }
+
+  PiiMatrix<double> lmMinimize(const Pii::ParallelExecution& policy,
+                               const ResidualFunction<double>* function,
+                               const PiiMatrix<double>& initialParams,
+                               int maxIterations,
+                               double ftol, double xtol, double gtol,
+                               double epsilon, double stepBound)
+  {
+    return lmMinimize(&policy, function, initialParams, maxIterations,
+                      ftol, xtol, gtol, epsilon, stepBound);
+  }
+
   PiiMatrix<double> bfgsMinimize(const GradientFunction<double>* function,
                                  const PiiMatrix<double>& initialParams,
                                  double epsG, double epsF, double epsX,
@@ -18,6 +18,7 @@
 
 #include <PiiMathException.h>
 #include <PiiMatrix.h>
+#include <PiiParallel.h>
 #include "PiiOptimizationGlobal.h"
 
 /**
@@ -237,6 +238,34 @@ namespace PiiOptimization
                                                        double epsilon = 1.e-14,
                                                        double stepbound = 100.0);
 
+  /**
+   * Same as above, but estimates the Jacobian in parallel if the
+   * function does not provide one. Each column of the Jacobian needs
+   * a full evaluation of the residuals, and the columns are
+   * distributed to threads according to *policy*. This pays off if
+   * computing the residuals is expensive, e.g. when a camera model is
+   * fitted to hundreds of calibration images. The result is the same
+   * as with the serial version.
+   *
+   * ! [ResidualFunction::residualValues()] must be reentrant because
+   * it will be called concurrently from many threads.
+   *
+   * ~~~(c++)
+   * MyResidualFunction func;
+   * PiiMatrix<double> matParams(PiiOptimization::lmMinimize(Pii::ParallelExecution(),
+   *                                                          &func, matInitialParams));
+   * ~~~
+   */
+  PII_OPTIMIZATION_EXPORT PiiMatrix<double> lmMinimize(const Pii::ParallelExecution& policy,
+                                                       const ResidualFunction<double>* function,
+                                                       const PiiMatrix<double>& initialParams,
+                                                       int maxIterations = 100,
+                                                       double ftol = 1.e-14,
+                                                       double xtol = 1.e-14,
+                                                       double gtol = 1.e-14,
+                                                       double epsilon = 1.e-14,
+                                                       double stepbound = 100.0);
+
   /**
    * Solves the linear assignment problem. Wikipedia defines this
    * problem as follows: "There are a number of agents and a number of
@@ -19,14 +19,108 @@
 #include <PiiFunctional.h>
 #include <PiiRandom.h>
 #include <PiiMath.h>
+#include <PiiParallel.h>
 #include <QVector>
+#include <QPair>
+#include <algorithm>
+#include <climits>
+#include <cstdlib>
+
+namespace
+{
+  // The time needed to estimate a model from a minimal set of
+  // samples, in units of one fitToModel() call. Used in choosing the
+  // SPRT decision threshold.
+  const double dModelEstimationCost = 200;
+  // The number of hypotheses verified in parallel.
+  const int iHypothesisBatchSize = 16;
+  // Initial guess for the inlier fraction of a bad model.
+  const double dInitialDelta = 0.05;
+}
+
+// Sequential probability ratio test for early rejection of models.
+// See Chum & Matas: Optimal Randomized RANSAC, PAMI 2008.
+struct PiiRansac::Sprt
+{
+  Sprt() :
+    dEpsilon(0), dDelta(dInitialDelta),
+    dThreshold(INFINITY), dInlierRatio(1), dOutlierRatio(1),
+    iRejectedCount(0), dRejectedInlierFractions(0)
+  {}
+
+  bool isActive() const { return dThreshold != INFINITY; }
+
+  // Chooses the threshold for the likelihood ratio. epsilon is the
+  // inlier fraction of the best model so far and delta that of
+  // rejected models.
+  void update(double modelsPerSampling)
+  {
+    if (dEpsilon <= dDelta || dEpsilon >= 1)
+      {
+        dThreshold = INFINITY;
+        return;
+      }
+    dInlierRatio = dDelta / dEpsilon;
+    dOutlierRatio = (1 - dDelta) / (1 - dEpsilon);
+    const double dDivergence = (1 - dDelta) * Pii::log(dOutlierRatio) + dDelta * Pii::log(dInlierRatio),
+      dCostRatio = dModelEstimationCost * modelsPerSampling / dDivergence;
+    // Solve A = cost ratio + 1 + log(A) iteratively.
+    dThreshold = dCostRatio + 1;
+    for (int i=0; i<10; ++i)
+      dThreshold = dCostRatio + 1 + Pii::log(dThreshold);
+  }
+
+  void addRejected(double inlierFraction)
+  {
+    ++iRejectedCount;
+    dRejectedInlierFractions += inlierFraction;
+    // The initial guess works as a prior.
+    dDelta = (dInitialDelta + dRejectedInlierFractions) / (1 + iRejectedCount);
+  }
+
+  double dEpsilon, dDelta;
+  double dThreshold, dInlierRatio, dOutlierRatio;
+  int iRejectedCount;
+  double dRejectedInlierFractions;
+};
+
+struct PiiRansac::Score
+{
+  Score() : iEvaluatedCount(0), bRejected(false) {}
+
+  QVector<int> vecInliers;
+  int iEvaluatedCount;
+  bool bRejected;
+};
+
+struct PiiRansac::ScoringBand
+{
+  ScoringBand(PiiRansac* ransac, const PiiMatrix<double>& models, const int* pointOrder,
+              const Sprt& sprt, Score* scores) :
+    pRansac(ransac), models(models), pPointOrder(pointOrder), sprt(sprt), pScores(scores)
+  {}
+
+  void operator() (int firstModel, int modelCount)
+  {
+    for (int i=firstModel; i<firstModel+modelCount; ++i)
+      pRansac->scoreModel(models[i], pPointOrder, sprt, pScores[i]);
+  }
+
+  PiiRansac* pRansac;
+  const PiiMatrix<double>& models;
+  const int* pPointOrder;
+  const Sprt& sprt;
+  Score* pScores;
+};
 
 PiiRansac::Data::Data() :
   iMaxIterations(1000),
   iMaxSamplings(100),
   iMinInliers(0),
   dFittingThreshold(16),
-  dSelectionProbability(0.99)
+  dSelectionProbability(0.99),
+  bEarlyRejection(false),
+  iThreadCount(1)
 {
 }
 
@@ -46,11 +140,61 @@ PiiRansac::~PiiRansac()
   delete d;
 }
 
+void PiiRansac::scoreModel(const double* model, const int* pointOrder, const Sprt& sprt, Score& score)
+{
+  const int iSamples = totalSampleCount();
+  const double dFittingThreshold = fittingThreshold(model);
+  score.vecInliers.resize(0);
+  score.bRejected = false;
+
+  if (!sprt.isActive())
+    {
+      // Match all points against the model and store points that
+      // match with an error less than the threshold.
+      for (int iPoint = 0; iPoint < iSamples; ++iPoint)
+        if (fitToModel(iPoint, model) < dFittingThreshold)
+          score.vecInliers << iPoint;
+      score.iEvaluatedCount = iSamples;
+      return;
+    }
+
+  // Likelihood ratio of the model being bad vs. good
+  double dLikelihoodRatio = 1;
+  for (int i = 0; i < iSamples; ++i)
+    {
+      const int iPoint = pointOrder[i];
+      if (fitToModel(iPoint, model) < dFittingThreshold)
+        {
+          score.vecInliers << iPoint;
+          dLikelihoodRatio *= sprt.dInlierRatio;
+        }
+      else
+        dLikelihoodRatio *= sprt.dOutlierRatio;
+      if (dLikelihoodRatio > sprt.dThreshold)
+        {
+          score.bRejected = true;
+          score.iEvaluatedCount = i + 1;
+          return;
+        }
+    }
+  score.iEvaluatedCount = iSamples;
+  std::sort(score.vecInliers.begin(), score.vecInliers.end());
+}
+
+int PiiRansac::requiredIterations(double goodModelProbability) const
+{
+  if (goodModelProbability >= 1)
+    return 0;
+  const double dLogBad = Pii::log(1.0 - goodModelProbability);
+  if (dLogBad == 0)
+    return d->iMaxIterations;
+  return Pii::round<int>(qMin(Pii::log(1.0 - d->dSelectionProbability) / dLogBad, double(INT_MAX)));
+}
+
 bool PiiRansac::findBestModel()
 {
   const int iSamples = totalSampleCount();
   const int iMinSamples = minSamples();
-  const double dLogProp = Pii::log(1.0 - d->dSelectionProbability);
 
   if (iSamples < iMinSamples)
     return false;
@@ -63,81 +207,171 @@ bool PiiRansac::findBestModel()
   // This vector stores the indices of all points.
   QVector<int> vecIndices(iSamples);
   Pii::generateN(vecIndices.begin(), iSamples, Pii::CountFunction<int>());
-  // Randomize order
-  Pii::shuffleN(vecIndices.begin(), iSamples);
+
+  const bool bGuidedSampling = d->vecSampleScores.size() == iSamples;
+  // PROSAC state: minimal sets are drawn from the iPoolSize best
+  // samples. The pool grows whenever the number of samplings
+  // exceeds iPoolSamplings. See Chum & Matas: Matching with PROSAC,
+  // CVPR 2005.
+  int iPoolSize = iMinSamples, iPoolSamplings = 1, iSamplings = 0;
+  double dExpectedSamplings = 1;
+  QVector<int> vecSubset(iMinSamples);
+  if (bGuidedSampling)
+    {
+      // Best scores first
+      QVector<QPair<double,int> > vecScores(iSamples);
+      for (int i=0; i<iSamples; ++i)
+        vecScores[i] = qMakePair(-d->vecSampleScores[i], i);
+      std::sort(vecScores.begin(), vecScores.end());
+      for (int i=0; i<iSamples; ++i)
+        vecIndices[i] = vecScores[i].second;
+      // The pool covers all samples after maxIterations samplings.
+      dExpectedSamplings = qMax(1, d->iMaxIterations);
+      for (int i=0; i<iMinSamples; ++i)
+        dExpectedSamplings *= double(iMinSamples - i) / (iSamples - i);
+    }
+  else
+    // Randomize order
+    Pii::shuffleN(vecIndices.begin(), iSamples);
   int iSubsetStartIndex = 0;
 
-  while (iIterations < qMin(d->iMaxIterations, iRequiredIterations))
+  // SPRT verifies the samples in random order.
+  Sprt sprt;
+  QVector<int> vecPointOrder;
+  if (d->bEarlyRejection)
     {
-      PiiMatrix<double> matModels;
-      int iSamplingCount = 0;
+      vecPointOrder.resize(iSamples);
+      Pii::generateN(vecPointOrder.begin(), iSamples, Pii::CountFunction<int>());
+      Pii::shuffleN(vecPointOrder.begin(), iSamples);
+    }
+  int iTotalModels = 0, iTotalSamplings = 0;
 
-      // Try hard to find a non-degenerate model
-      while (matModels.isEmpty() && iSamplingCount < d->iMaxSamplings)
+  const int iBatchSize = d->iThreadCount == 1 ? 1 : iHypothesisBatchSize;
+  Pii::ParallelExecution policy(qMax(0, d->iThreadCount));
+  policy.minBandRows = 1;
+  QVector<Score> vecScores;
+
+  while (iIterations < qMin(d->iMaxIterations, iRequiredIterations))
+    {
+      // Generate a batch of hypotheses.
+      PiiMatrix<double> matBatch;
+      for (int iBatch = 0;
+           iBatch < iBatchSize && iIterations < qMin(d->iMaxIterations, iRequiredIterations);
+           ++iBatch, ++iIterations)
         {
-          // No more random orderings left -> reshuffle the samples
-          // and start over.
-          if (iSubsetStartIndex + iMinSamples > vecIndices.size())
+          PiiMatrix<double> matModels;
+          int iSamplingCount = 0;
+
+          // Try hard to find a non-degenerate model
+          while (matModels.isEmpty() && iSamplingCount < d->iMaxSamplings)
             {
-              Pii::shuffleN(vecIndices.begin(), iSamples);
-              iSubsetStartIndex = 0;
+              const int* pSubset;
+              if (bGuidedSampling)
+                {
+                  ++iSamplings;
+                  if (iSamplings > iPoolSamplings && iPoolSize < iSamples)
+                    {
+                      ++iPoolSize;
+                      const double dNextExpected = dExpectedSamplings * iPoolSize / (iPoolSize - iMinSamples);
+                      iPoolSamplings += int(std::ceil(dNextExpected - dExpectedSamplings));
+                      dExpectedSamplings = dNextExpected;
+                    }
+                  // Draw m-1 samples from the best n-1 and take the
+                  // nth one. Once the pool has stopped growing, draw
+                  // all m from the pool. Swapping within the first
+                  // n-1 samples does not change the pools.
+                  const bool bIncludeLast = iSamplings <= iPoolSamplings;
+                  const int iPoolEnd = bIncludeLast ? iPoolSize - 1 : iPoolSize,
+                    iDrawCount = bIncludeLast ? iMinSamples - 1 : iMinSamples;
+                  for (int i=0; i<iDrawCount; ++i)
+                    {
+                      qSwap(vecIndices[i], vecIndices[i + std::rand() % (iPoolEnd - i)]);
+                      vecSubset[i] = vecIndices[i];
+                    }
+                  if (bIncludeLast)
+                    vecSubset[iMinSamples-1] = vecIndices[iPoolSize-1];
+                  pSubset = vecSubset.constData();
+                }
+              else
+                {
+                  // No more random orderings left -> reshuffle the
+                  // samples and start over.
+                  if (iSubsetStartIndex + iMinSamples > vecIndices.size())
+                    {
+                      Pii::shuffleN(vecIndices.begin(), iSamples);
+                      iSubsetStartIndex = 0;
+                    }
+                  pSubset = vecIndices.constData() + iSubsetStartIndex;
+                  iSubsetStartIndex += iMinSamples;
+                }
+              matModels = findPossibleModels(pSubset);
+              ++iSamplingCount;
+              // Special case: if there is only one way to select the
+              // samples, there is no need to try again.
+              if (iSamples == iMinSamples)
+                break;
             }
-          matModels = findPossibleModels(vecIndices.data() + iSubsetStartIndex);
-          iSubsetStartIndex += iMinSamples;
-          ++iSamplingCount;
-          // Special case: if there is only one way to select the
-          // samples, there is no need to try again.
-          if (iSamples == iMinSamples)
-            break;
-        }
 
-      // We are out of luck. No model could be found.
-      if (matModels.isEmpty())
-        return false;
+          // We are out of luck. No model could be found.
+          if (matModels.isEmpty())
+            return false;
 
-      // This vector stores the indices of selected inlying points.
-      QVector<int> vecInliers;
-      vecInliers.reserve(iSamples);
+          iTotalSamplings += iSamplingCount;
+          iTotalModels += matModels.rows();
+          if (matBatch.isEmpty())
+            matBatch = matModels;
+          else
+            matBatch.appendRows(matModels);
+        }
 
       // Test all possible models
-      for (int iModel = 0; iModel < matModels.rows(); ++iModel)
-        {
-          // Clear the inlier list at the beginning of each round.
-          vecInliers.resize(0);
+      const int iModels = matBatch.rows();
+      vecScores.resize(iModels);
+      ScoringBand scoring(this, matBatch, vecPointOrder.constData(), sprt, vecScores.data());
+      if (iBatchSize == 1)
+        scoring(0, iModels);
+      else
+        Pii::forEachBand(policy, iModels, 0, scoring);
 
-          const double* pModel = matModels.constRowBegin(iModel);
-          double dFittingThreshold = fittingThreshold(pModel);
-          // Match all points against the current model
-          for (int iPoint = 0; iPoint < iSamples; ++iPoint)
+      // Collect the results in order
+      const double dModelsPerSampling = double(iTotalModels) / iTotalSamplings;
+      for (int iModel = 0; iModel < iModels; ++iModel)
+        {
+          const Score& score = vecScores[iModel];
+          if (score.bRejected)
             {
-              // Store points that match to the model with an error
-              // less than the threshold.
-              if (fitToModel(iPoint, pModel) < dFittingThreshold)
-                vecInliers << iPoint;
+              sprt.addRejected(double(score.vecInliers.size()) / score.iEvaluatedCount);
+              sprt.update(dModelsPerSampling);
+              continue;
             }
+          const double* pModel = matBatch.constRowBegin(iModel);
 
           // If the number of inliers is the best so far, store the
           // score.
-          const int iInlierCount = vecInliers.size();
+          const int iInlierCount = score.vecInliers.size();
           if (iInlierCount > d->vecBestInliers.size())
             {
               //piiDebug("Inliers: %d", iInlierCount);
               if (iInlierCount > minInliers(pModel))
                 {
-                  d->vecBestInliers = vecInliers;
-                  d->matBestModel = matModels(iModel, 0, 1, -1);
+                  d->vecBestInliers = score.vecInliers;
+                  d->matBestModel = matBatch(iModel, 0, 1, -1);
                 }
 
               // The fraction of inliers
               double dInlierFraction = double(iInlierCount) / iSamples;
-              if (dInlierFraction != 1.0)
-                iRequiredIterations = Pii::round<int>(dLogProp /
-                                                      Pii::log(1.0 - Pii::pow(dInlierFraction, iMinSamples)));
-              else
-                iRequiredIterations = 0;
+              double dGoodModelProbability = Pii::pow(dInlierFraction, iMinSamples);
+              if (d->bEarlyRejection)
+                {
+                  sprt.dEpsilon = dInlierFraction;
+                  sprt.update(dModelsPerSampling);
+                  // A good model may be rejected with probability 1/A.
+                  if (sprt.isActive())
+                    dGoodModelProbability *= 1 - 1 / sprt.dThreshold;
+                }
+              iRequiredIterations = requiredIterations(dGoodModelProbability);
             }
         }
-      ++iIterations;
     }
 
   return !d->matBestModel.isEmpty();
@@ -158,3 +392,9 @@ double PiiRansac::fittingThreshold() const { return d->dFittingThreshold; }
 double PiiRansac::fittingThreshold(const double*) const { return d->dFittingThreshold; }
 void PiiRansac::setSelectionProbability(double selectionProbability) { d->dSelectionProbability = selectionProbability; }
 double PiiRansac::selectionProbability() const { return d->dSelectionProbability; }
+void PiiRansac::setEarlyRejection(bool earlyRejection) { d->bEarlyRejection = earlyRejection; }
+bool PiiRansac::earlyRejection() const { return d->bEarlyRejection; }
+void PiiRansac::setSampleScores(const QVector<double>& sampleScores) { d->vecSampleScores = sampleScores; }
+QVector<double> PiiRansac::sampleScores() const { return d->vecSampleScores; }
+void PiiRansac::setThreadCount(int threadCount) { d->iThreadCount = threadCount; }
+int PiiRansac::threadCount() const { return d->iThreadCount; }
@@ -42,6 +42,28 @@
  * by N `doubles`. Therefore, models are represented as row matrices
  * with N columns.
  *
+ * The basic algorithm can be sped up in three independent ways:
+ *
+ * - **Early rejection** ([setEarlyRejection()]). Each model
+ * hypothesis is verified against the samples in random order, and
+ * a sequential probability ratio test (SPRT) rejects a hypothesis
+ * as soon as it is unlikely to beat the best model so far. Bad
+ * hypotheses are thus discarded after a few samples. The number of
+ * required iterations accounts for the small probability of
+ * rejecting a good model.
+ *
+ * - **Guided sampling** ([setSampleScores()]). If the quality of
+ * each sample is known in advance, e.g. as the similarity of a
+ * point correspondence, PROSAC sampling draws the minimal sets from
+ * progressively larger sets of the best samples. Good models are
+ * typically found after a handful of iterations. Eventually, the
+ * sampling becomes uniform.
+ *
+ * - **Parallel scoring** ([setThreadCount()]). Hypotheses are
+ * generated in batches in the calling thread and verified in
+ * parallel. With a fixed random seed, the result is the same with
+ * any number of threads greater than one. [fitToModel()], [fittingThreshold()] and
+ * [minInliers()] must be reentrant if more than one thread is used.
  */
 class PII_OPTIMIZATION_EXPORT PiiRansac
 {
@@ -144,6 +166,35 @@ public:
    */
   double selectionProbability() const;
 
+  /**
+   * Enables or disables early rejection of model hypotheses with a
+   * sequential probability ratio test. Early rejection is most
+   * useful when there are many samples and a large fraction of
+   * outliers. The default is `false`.
+   */
+  void setEarlyRejection(bool earlyRejection);
+  bool earlyRejection() const;
+
+  /**
+   * Sets the quality scores of the samples for guided (PROSAC)
+   * sampling. The higher the score, the more likely the sample is
+   * an inlier. Only the order of the scores matters. Guided sampling
+   * is used if the number of scores equals [totalSampleCount()];
+   * otherwise samples are selected uniformly. Set an empty vector to
+   * disable guided sampling.
+   */
+  void setSampleScores(const QVector<double>& sampleScores);
+  QVector<double> sampleScores() const;
+
+  /**
+   * Sets the maximum number of threads used in verifying model
+   * hypotheses. One means the calling thread only. Zero or a
+   * negative value uses all threads in the global thread pool. The
+   * default is one.
+   */
+  void setThreadCount(int threadCount);
+  int threadCount() const;
+
 protected:
   /// @internal
   class PII_OPTIMIZATION_EXPORT Data
@@ -157,6 +208,9 @@ protected:
     int iMinInliers;
     double dFittingThreshold;
     double dSelectionProbability;
+    bool bEarlyRejection;
+    QVector<double> vecSampleScores;
+    int iThreadCount;
     QVector<int> vecBestInliers;
     PiiMatrix<double> matBestModel;
   } *d;
@@ -247,6 +301,14 @@ protected:
    */
   virtual double fittingThreshold(const double* model) const;
 
+private:
+  struct Sprt;
+  struct Score;
+  struct ScoringBand;
+
+  void scoreModel(const double* model, const int* pointOrder, const Sprt& sprt, Score& score);
+  int requiredIterations(double goodModelProbability) const;
+
   PII_DISABLE_COPY(PiiRansac);
 };
 
@@ -0,0 +1,224 @@
+/* This file is part of Into.
+ * Copyright (C) Intopii 2013.
+ * All rights reserved.
+ *
+ * Licensees holding a commercial Into license may use this file in
+ * accordance with the commercial license agreement. Please see
+ * LICENSE.commercial for commercial licensing terms.
+ *
+ * Alternatively, this file may be used under the terms of the GNU
+ * Affero General Public License version 3 as published by the Free
+ * Software Foundation. In addition, Intopii gives you special rights
+ * to use Into as a part of open source software projects. Please
+ * refer to LICENSE.AGPL3 for details.
+ */
+
+#ifndef _PIISPARSEHISTOGRAM_H
+#define _PIISPARSEHISTOGRAM_H
+
+#include <QVector>
+#include <PiiMatrix.h>
+#include <algorithm>
+
+/**
+ * A histogram that stores only the bins that have been hit. Bins are
+ * identified by 64-bit keys, which makes it possible to index
+ * multi-dimensional histograms whose theoretical length is far too
+ * large for a dense array. The memory usage is proportional to the
+ * number of distinct bins, independent of the theoretical length.
+ *
+ * The bins are stored in an open-addressing hash table with linear
+ * probing. Adding to a bin, and thus merging two histograms, takes
+ * constant expected time per bin.
+ *
+ * ~~~(c++)
+ * PiiSparseHistogram histogram;
+ * // Fold a six-dimensional coordinate into a key
+ * histogram.add(x0 + 256 * (x1 + 256 * (x2 + 256 * (x3 + 256 * (x4 + 256 * x5)))));
+ * QVector<PiiSparseHistogram::Key> vecBins(histogram.sortedBins());
+ * PiiMatrix<double> matFrequencies(histogram.values<double>(vecBins, true));
+ * ~~~
+ */
+class PiiSparseHistogram
+{
+public:
+  typedef quint64 Key;
+
+  /**
+   * Creates an empty histogram.
+   *
+   * @param expectedBins the expected number of distinct bins. The
+   * hash table will be allocated large enough to hold this many bins
+   * without rehashing.
+   */
+  explicit PiiSparseHistogram(int expectedBins = 0) :
+    _iSize(0), _iTotal(0)
+  {
+    reserve(expectedBins);
+  }
+
+  /**
+   * Adds *count* to *bin*.
+   */
+  void add(Key bin, int count = 1)
+  {
+    if ((_iSize + 1) * 10 > _vecKeys.size() * 7)
+      rehash(qMax(_vecKeys.size() * 2, 16));
+    const int iSlot = findSlot(bin);
+    if (_vecKeys[iSlot] != bin)
+      {
+        _vecKeys[iSlot] = bin;
+        ++_iSize;
+      }
+    _vecCounts[iSlot] += count;
+    _iTotal += count;
+  }
+
+  /**
+   * Returns the value of *bin*, or zero if the bin has not been hit.
+   */
+  int value(Key bin) const
+  {
+    if (_iSize == 0)
+      return 0;
+    const int iSlot = findSlot(bin);
+    return _vecKeys[iSlot] == bin ? _vecCounts[iSlot] : 0;
+  }
+
+  /**
+   * Returns the number of distinct bins that have been hit.
+   */
+  int binCount() const { return _iSize; }
+
+  /**
+   * Returns the sum of all bins.
+   */
+  qint64 total() const { return _iTotal; }
+
+  /**
+   * Returns `true` if no bins have been hit.
+   */
+  bool isEmpty() const { return _iSize == 0; }
+
+  /**
+   * Removes all bins but retains the allocated table.
+   */
+  void clear()
+  {
+    _vecKeys.fill(emptyKey());
+    _vecCounts.fill(0);
+    _iSize = 0;
+    _iTotal = 0;
+  }
+
+  /**
+   * Makes room for at least *bins* distinct bins.
+   */
+  void reserve(int bins)
+  {
+    int iCapacity = 16;
+    while (iCapacity * 7 < bins * 10)
+      iCapacity <<= 1;
+    if (iCapacity > _vecKeys.size())
+      rehash(iCapacity);
+  }
+
+  /**
+   * Adds all bins in *other* to this histogram.
+   */
+  PiiSparseHistogram& operator+= (const PiiSparseHistogram& other)
+  {
+    reserve(_iSize + other._iSize);
+    for (int i=0; i<other._vecKeys.size(); ++i)
+      if (other._vecKeys[i] != emptyKey())
+        add(other._vecKeys[i], other._vecCounts[i]);
+    return *this;
+  }
+
+  /**
+   * Returns the keys of all bins that have been hit, in ascending
+   * order.
+   */
+  QVector<Key> sortedBins() const
+  {
+    QVector<Key> vecResult;
+    vecResult.reserve(_iSize);
+    for (int i=0; i<_vecKeys.size(); ++i)
+      if (_vecKeys[i] != emptyKey())
+        vecResult << _vecKeys[i];
+    std::sort(vecResult.begin(), vecResult.end());
+    return vecResult;
+  }
+
+  /**
+   * Returns the values of *bins* as a row matrix.
+   *
+   * @param bins a list of bin keys, typically the one returned by
+   * [sortedBins()].
+   *
+   * @param normalized if `true`, the values will be divided by
+   * [total()].
+   */
+  template <class T> PiiMatrix<T> values(const QVector<Key>& bins, bool normalized = false) const
+  {
+    PiiMatrix<T> matResult(PiiMatrix<T>::uninitialized(1, bins.size()));
+    T* pResult = matResult.row(0);
+    const double dScale = normalized && _iTotal != 0 ? 1.0 / _iTotal : 1.0;
+    for (int i=0; i<bins.size(); ++i)
+      pResult[i] = normalized ? T(value(bins[i]) * dScale) : T(value(bins[i]));
+    return matResult;
+  }
+
+  /**
+   * Converts the histogram to a dense row matrix with *length*
+   * columns. Bins whose key is larger than or equal to *length* are
+   * ignored.
+   */
+  template <class T> PiiMatrix<T> toDense(int length, bool normalized = false) const
+  {
+    PiiMatrix<T> matResult(1, length);
+    T* pResult = matResult.row(0);
+    const double dScale = normalized && _iTotal != 0 ? 1.0 / _iTotal : 1.0;
+    for (int i=0; i<_vecKeys.size(); ++i)
+      if (_vecKeys[i] < Key(length))
+        pResult[_vecKeys[i]] = normalized ? T(_vecCounts[i] * dScale) : T(_vecCounts[i]);
+    return matResult;
+  }
+
+private:
+  // No valid key can be this large. The largest folded index of a
+  // multi-dimensional histogram is one less than its length.
+  static inline Key emptyKey() { return ~Key(0); }
+
+  int findSlot(Key bin) const
+  {
+    // Fibonacci hashing spreads consecutive keys over the table.
+    const int iMask = _vecKeys.size() - 1;
+    int iSlot = int((bin * Q_UINT64_C(0x9e3779b97f4a7c15)) >> 32) & iMask;
+    while (_vecKeys[iSlot] != bin && _vecKeys[iSlot] != emptyKey())
+      iSlot = (iSlot + 1) & iMask;
+    return iSlot;
+  }
+
+  void rehash(int capacity)
+  {
+    QVector<Key> vecOldKeys(_vecKeys);
+    QVector<int> vecOldCounts(_vecCounts);
+    _vecKeys = QVector<Key>(capacity, emptyKey());
+    _vecCounts = QVector<int>(capacity, 0);
+    for (int i=0; i<vecOldKeys.size(); ++i)
+      if (vecOldKeys[i] != emptyKey())
+        {
+          const int iSlot = findSlot(vecOldKeys[i]);
+          _vecKeys[iSlot] = vecOldKeys[i];
+          _vecCounts[iSlot] = vecOldCounts[i];
+        }
+  }
+
+  QVector<Key> _vecKeys;
+  QVector<int> _vecCounts;
+  int _iSize;
+  qint64 _iTotal;
+};
+
+#endif //_PIISPARSEHISTOGRAM_H
@@ -16,6 +16,7 @@
 #include "PiiHistogramCollector.h"
 #include <PiiYdinTypes.h>
 #include <PiiMath.h>
+#include <PiiHistogram.h>
 
 PiiHistogramCollector::Data::Data() :
   iBinCount(256),
@@ -155,9 +156,20 @@ template <class T> void PiiHistogramCollector::addMatrix(const PiiVariant& obj)
 {
   PII_D;
   const PiiMatrix<T> matrix = obj.valueAs<PiiMatrix<T> >();
-  T element;
-  foreach (element, matrix)
-    addToHistogram(int(element));
+  // Integers can be binned directly in fixed-length mode. Negative
+  // values and values beyond the last bin are ignored either way.
+  if (d->outputMode == FixedLengthOutput &&
+      Pii::IsInteger<T>::boolValue && sizeof(T) <= sizeof(int))
+    {
+      if (d->matHistogram.columns() > 0)
+        d->matHistogram += PiiImage::histogram(matrix, unsigned(d->matHistogram.columns()));
+    }
+  else
+    {
+      T element;
+      foreach (element, matrix)
+        addToHistogram(int(element));
+    }
   if (!d->bSyncConnected)
     emitHistogram();
 }
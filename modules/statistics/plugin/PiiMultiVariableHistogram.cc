@@ -22,7 +22,8 @@
 
 PiiMultiVariableHistogram::Data::Data() :
   distributionType(JointDistribution),
-  bNormalized(false)
+  bNormalized(false),
+  bSparseOutput(false)
 {
 }
 
@@ -33,6 +34,7 @@ PiiMultiVariableHistogram::PiiMultiVariableHistogram() :
   setInputCount(1);
 
   addSocket(_d()->pHistogramOutput = new PiiOutputSocket("histogram"));
+  addSocket(_d()->pBinsOutput = new PiiOutputSocket("bins"));
 }
 
 PiiMultiVariableHistogram::~PiiMultiVariableHistogram()
@@ -68,31 +70,40 @@ void PiiMultiVariableHistogram::check(bool reset)
 
   PiiDefaultOperation::check(reset);
 
-  d->vecSteps.clear();
-
-  d->vecSteps << d->vecLevels[0];
-  if (d->vecSteps[0] > LENGTH_LIMIT)
-    throwTooLong();
+  if (d->pBinsOutput->isConnected() && !d->bSparseOutput)
+    PII_THROW(PiiExecutionException, tr("The bins output can only be used with sparse output."));
 
-  if (d->distributionType == JointDistribution)
-    {
-      // The first multiplier (1) is omitted. The last one tells the total
-      // length of the histogram.
-      for (int i=1; i<d->vecLevels.size(); i++)
-        {
-          d->vecSteps << d->vecSteps[i-1]*d->vecLevels[i];
-          if (d->vecLevels[i] > LENGTH_LIMIT || d->vecSteps[i] > LENGTH_LIMIT)
-            throwTooLong();
-        }
-    }
-  else
+  d->vecSteps.clear();
+  d->vecKeySteps.clear();
+
+  // Only the folded bin index needs to fit into a 64-bit key in
+  // sparse mode.
+  const bool bJoint = d->distributionType == JointDistribution;
+  const quint64 iLimit = d->bSparseOutput && bJoint ? Q_UINT64_C(1) << 62 : LENGTH_LIMIT;
+  quint64 iLength = 0;
+  // The first multiplier (1) is omitted. The last one tells the total
+  // length of the histogram.
+  for (int i=0; i<d->vecLevels.size(); i++)
     {
-      for (int i=1; i<d->vecLevels.size(); i++)
+      const quint64 iLevels = quint64(d->vecLevels[i]);
+      if (iLevels > LENGTH_LIMIT)
+        throwTooLong();
+      if (i == 0)
+        iLength = iLevels;
+      else if (bJoint)
         {
-          d->vecSteps << d->vecSteps[i-1] + d->vecLevels[i];
-          if (d->vecLevels[i] > LENGTH_LIMIT || d->vecSteps[i] > LENGTH_LIMIT)
+          if (iLevels != 0 && iLength > iLimit / iLevels)
             throwTooLong();
+          iLength *= iLevels;
         }
+      else
+        iLength += iLevels;
+      if (iLength > iLimit)
+        throwTooLong();
+      d->vecKeySteps << iLength;
+      // Integer steps are used only if the whole histogram fits into
+      // LENGTH_LIMIT. Then none of them is clamped.
+      d->vecSteps << int(qMin(iLength, quint64(LENGTH_LIMIT)));
     }
 
   if (d->vecScales.size() != 0 && d->vecScales.size() != d->vecLevels.size())
@@ -180,6 +191,12 @@ void PiiMultiVariableHistogram::process()
         }
     }
 
+  if (d->bSparseOutput)
+    {
+      emitSparse(lstMatrices, iRows, iColumns);
+      return;
+    }
+
   // Allocate size for the histogram
   PiiMatrix<int> matResult(1, d->vecSteps.last());
   if (d->distributionType == JointDistribution)
@@ -239,5 +256,99 @@ void PiiMultiVariableHistogram::marginalHistograms(const QList<PiiMatrix<int> >&
     }
 }
 
+void PiiMultiVariableHistogram::sparseJointHistogram(const QList<PiiMatrix<int> >& matrices,
+                                                     int rows, int columns,
+                                                     PiiSparseHistogram* result)
+{
+  PII_D;
+
+  typedef PiiSparseHistogram::Key Key;
+  QVector<Key> vecKeys(columns);
+  Key* pKeys = vecKeys.data();
+  for (int r=0; r<rows; ++r)
+    {
+      // Fold a row at a time, one dimension after another.
+      const int* pRow = const_cast<const PiiMatrix<int>&>(matrices[0])[r];
+      int iMaxValue = d->vecLevels[0]-1;
+      for (int c=0; c<columns; ++c)
+        pKeys[c] = Key(qBound(0, pRow[c], iMaxValue));
+      for (int k=1; k<matrices.size(); ++k)
+        {
+          pRow = const_cast<const PiiMatrix<int>&>(matrices[k])[r];
+          iMaxValue = d->vecLevels[k]-1;
+          const Key iStep = d->vecKeySteps[k-1];
+          for (int c=0; c<columns; ++c)
+            pKeys[c] += iStep * Key(qBound(0, pRow[c], iMaxValue));
+        }
+      for (int c=0; c<columns; ++c)
+        result->add(pKeys[c]);
+    }
+}
+
+void PiiMultiVariableHistogram::emitSparse(const QList<PiiMatrix<int> >& matrices, int rows, int columns)
+{
+  PII_D;
+
+  typedef PiiSparseHistogram::Key Key;
+  const bool bJoint = d->distributionType == JointDistribution;
+  const quint64 iLength = d->vecKeySteps.last(),
+    iSamples = quint64(rows) * quint64(columns);
+  QVector<Key> vecBins;
+  PiiMatrix<int> matValues;
+
+  // A dense array is faster as long as it is not much larger than
+  // the number of samples. Scanning it for non-zero bins is then
+  // cheap compared to filling it.
+  if (!bJoint || (iLength <= LENGTH_LIMIT && iLength <= qMax(4 * iSamples, quint64(4096))))
+    {
+      PiiMatrix<int> matDense(1, int(iLength));
+      if (bJoint)
+        jointHistogram(matrices, rows, columns, &matDense);
+      else
+        marginalHistograms(matrices, rows, columns, &matDense);
+      const int* pDense = matDense.row(0);
+      for (int i=0; i<matDense.columns(); ++i)
+        if (pDense[i] != 0)
+          vecBins << Key(i);
+      matValues = PiiMatrix<int>(PiiMatrix<int>::uninitialized(1, vecBins.size()));
+      int* pValues = matValues.row(0);
+      for (int i=0; i<vecBins.size(); ++i)
+        pValues[i] = pDense[vecBins[i]];
+    }
+  else
+    {
+      PiiSparseHistogram histogram;
+      sparseJointHistogram(matrices, rows, columns, &histogram);
+      vecBins = histogram.sortedBins();
+      matValues = histogram.values<int>(vecBins);
+    }
+
+  // Unfold the keys. The first coordinate is the least significant.
+  const int iDimensions = bJoint ? d->vecLevels.size() : 1;
+  PiiMatrix<int> matBins(PiiMatrix<int>::uninitialized(vecBins.size(), iDimensions));
+  for (int i=0; i<vecBins.size(); ++i)
+    {
+      int* pBin = matBins.row(i);
+      Key iKey = vecBins[i];
+      if (!bJoint)
+        pBin[0] = int(iKey);
+      else
+        for (int k=0; k<iDimensions; ++k)
+          {
+            pBin[k] = int(iKey % quint64(d->vecLevels[k]));
+            iKey /= quint64(d->vecLevels[k]);
+          }
+    }
+
+  d->pBinsOutput->emitObject(matBins);
+  if (d->bNormalized)
+    d->pHistogramOutput->emitObject(Pii::matrix(matValues.mapped(std::bind2nd(std::multiplies<double>(),
+                                                                              1.0 / Pii::sum<double>(matValues)))));
+  else
+    d->pHistogramOutput->emitObject(matValues);
+}
+
 void PiiMultiVariableHistogram::setNormalized(bool normalize) { _d()->bNormalized = normalize; }
 bool PiiMultiVariableHistogram::normalized() const { return _d()->bNormalized; }
+void PiiMultiVariableHistogram::setSparseOutput(bool sparseOutput) { _d()->bSparseOutput = sparseOutput; }
+bool PiiMultiVariableHistogram::sparseOutput() const { return _d()->bSparseOutput; }
@@ -18,6 +18,7 @@
 
 #include <PiiDefaultOperation.h>
 #include <PiiMatrix.h>
+#include <PiiSparseHistogram.h>
 
 /**
  * An operation that builds histograms out of correlated variables.
@@ -58,7 +59,18 @@
  *
  * @out histogram - a multi-dimensional histogram folded into a
  * one-dimensional row matrix, or multiple one-dimensional histograms
- * concatenated into a row matrix (PiiMatrix<int>).
+ * concatenated into a row matrix (PiiMatrix<int>). In sparse mode
+ * (see [sparseOutput]), only the bins that have been hit are emitted,
+ * in the order given by `bins`. If [normalized] is `true`, the
+ * type is PiiMatrix<double>.
+ *
+ * @out bins - the coordinates of the emitted bins in sparse mode
+ * (PiiMatrix<int>). In `JointDistribution` mode, each row holds one
+ * coordinate for each input. The rows are sorted so that the last
+ * coordinate is the most significant one. In `MarginalDistributions`
+ * mode, the matrix has one column that contains indices to the
+ * concatenated histogram. This output can only be connected in sparse
+ * mode.
  *
  */
 class PiiMultiVariableHistogram : public PiiDefaultOperation
@@ -79,10 +91,24 @@ class PiiMultiVariableHistogram : public PiiDefaultOperation
    * for practical use. In theory, this allows one to create a
    * three-dimensional color histogram out of three 8-bit color
    * channels. In `MarginalDistributions` mode, the same limit holds
-   * for the sum of levels.
+   * for the sum of levels. In sparse mode, the product of the levels
+   * can be up to 2^62.
    */
   Q_PROPERTY(QVariantList levels READ levels WRITE setLevels);
 
+  /**
+   * Enables sparse output. In sparse mode, only the bins that have
+   * been hit are emitted, and their coordinates are sent to the
+   * `bins` output. Memory usage is then proportional to the number of
+   * input samples instead of the theoretical number of bins, which
+   * makes it possible to build joint histograms of many variables.
+   *
+   * The bins are collected into a dense array if it is not much
+   * larger than the number of samples, and into a hash table
+   * (PiiSparseHistogram) otherwise. The default is `false`.
+   */
+  Q_PROPERTY(bool sparseOutput READ sparseOutput WRITE setSparseOutput);
+
   /**
    * Scaling factors for each dimension. Each element in the input
    * matrices will be multiplied by the corresponding scale factor
@@ -141,6 +167,8 @@ public:
 
   void setNormalized(bool normalize);
   bool normalized() const;
+  void setSparseOutput(bool sparseOutput);
+  bool sparseOutput() const;
 
 protected:
   void process();
@@ -152,6 +180,8 @@ private:
   void setInputCount(int cnt);
   void jointHistogram(const QList<PiiMatrix<int> >& matrices, int rows, int columns, PiiMatrix<int>* result);
   void marginalHistograms(const QList<PiiMatrix<int> >& matrices, int rows, int columns, PiiMatrix<int>* result);
+  void sparseJointHistogram(const QList<PiiMatrix<int> >& matrices, int rows, int columns, PiiSparseHistogram* result);
+  void emitSparse(const QList<PiiMatrix<int> >& matrices, int rows, int columns);
 
   /// @internal
   class Data : public PiiDefaultOperation::Data
@@ -161,10 +191,13 @@ private:
 
     QVector<int> vecLevels;
     QVector<int> vecSteps;
+    QVector<quint64> vecKeySteps;
     QVector<double> vecScales;
     PiiOutputSocket* pHistogramOutput;
+    PiiOutputSocket* pBinsOutput;
     DistributionType distributionType;
     bool bNormalized;
+    bool bSparseOutput;
   };
   PII_D_FUNC;
 };
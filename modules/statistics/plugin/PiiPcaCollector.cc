@@ -0,0 +1,136 @@
+/* This file is part of Into.
+ * Copyright (C) Intopii 2013.
+ * All rights reserved.
+ *
+ * Licensees holding a commercial Into license may use this file in
+ * accordance with the commercial license agreement. Please see
+ * LICENSE.commercial for commercial licensing terms.
+ *
+ * Alternatively, this file may be used under the terms of the GNU
+ * Affero General Public License version 3 as published by the Free
+ * Software Foundation. In addition, Intopii gives you special rights
+ * to use Into as a part of open source software projects. Please
+ * refer to LICENSE.AGPL3 for details.
+ */
+
+#include "PiiPcaCollector.h"
+#include <PiiYdinTypes.h>
+#include <PiiInvalidArgumentException.h>
+
+PiiPcaCollector::Data::Data() :
+  iComponentCount(0),
+  iEmissionInterval(1),
+  iObjectCount(0),
+  bCumulative(true),
+  bSyncConnected(false)
+{
+}
+
+PiiPcaCollector::PiiPcaCollector() :
+  PiiDefaultOperation(new Data)
+{
+  addSocket(new PiiInputSocket("sync"));
+  inputAt(0)->setOptional(true);
+  addSocket(new PiiInputSocket("features"));
+  inputAt(1)->setGroupId(1);
+
+  addSocket(new PiiOutputSocket("sync"));
+  addSocket(new PiiOutputSocket("mean"));
+  addSocket(new PiiOutputSocket("base"));
+  addSocket(new PiiOutputSocket("variances"));
+}
+
+void PiiPcaCollector::check(bool reset)
+{
+  PII_D;
+  if (d->iEmissionInterval < 1)
+    PII_THROW(PiiExecutionException, tr("Emission interval must be at least one."));
+
+  d->bSyncConnected = inputAt(0)->isConnected();
+  inputAt(1)->setGroupId(d->bSyncConnected ? 1 : 0);
+
+  PiiDefaultOperation::check(reset);
+
+  if (reset)
+    {
+      d->accumulator.clear();
+      d->iObjectCount = 0;
+    }
+}
+
+void PiiPcaCollector::emitModel()
+{
+  PII_D;
+  PiiMatrix<double> matVariances;
+  PiiMatrix<double> matBase(d->accumulator.principalComponents(&matVariances));
+  if (d->iComponentCount > 0 && d->iComponentCount < matBase.columns())
+    {
+      matBase = PiiMatrix<double>(matBase(0, 0, -1, d->iComponentCount));
+      matVariances = PiiMatrix<double>(matVariances(0, 0, 1, d->iComponentCount));
+    }
+  outputAt(1)->emitObject(d->accumulator.mean());
+  outputAt(2)->emitObject(matBase);
+  outputAt(3)->emitObject(matVariances);
+}
+
+void PiiPcaCollector::syncEvent(SyncEvent* event)
+{
+  PII_D;
+  if (event->type() == SyncEvent::EndInput)
+    {
+      emitObject(d->varSyncObject);
+      emitModel();
+      for (int i=0; i<4; ++i)
+        outputAt(i)->endDelay();
+
+      if (!d->bCumulative)
+        d->accumulator.clear();
+    }
+}
+
+void PiiPcaCollector::process()
+{
+  PII_D;
+  if (activeInputGroup() == inputAt(1)->groupId())
+    {
+      PiiVariant obj = inputAt(1)->firstObject();
+
+      switch (obj.type())
+        {
+          PII_PRIMITIVE_MATRIX_CASES(addSamples, obj);
+        default:
+          PII_THROW_UNKNOWN_TYPE(inputAt(1));
+        }
+
+      if (!d->bSyncConnected && ++d->iObjectCount >= d->iEmissionInterval)
+        {
+          d->iObjectCount = 0;
+          emitModel();
+        }
+    }
+  else
+    {
+      d->varSyncObject = readInput();
+      for (int i=0; i<4; ++i)
+        outputAt(i)->startDelay();
+    }
+}
+
+template <class T> void PiiPcaCollector::addSamples(const PiiVariant& obj)
+{
+  try
+    {
+      _d()->accumulator.addSamples(obj.valueAs<PiiMatrix<T> >());
+    }
+  catch (PiiInvalidArgumentException&)
+    {
+      PII_THROW(PiiExecutionException, tr("All feature vectors must have the same number of dimensions."));
+    }
+}
+
+void PiiPcaCollector::setComponentCount(int componentCount) { _d()->iComponentCount = componentCount; }
+int PiiPcaCollector::componentCount() const { return _d()->iComponentCount; }
+void PiiPcaCollector::setEmissionInterval(int emissionInterval) { _d()->iEmissionInterval = emissionInterval; }
+int PiiPcaCollector::emissionInterval() const { return _d()->iEmissionInterval; }
+void PiiPcaCollector::setCumulative(bool cumulative) { _d()->bCumulative = cumulative; }
+bool PiiPcaCollector::cumulative() const { return _d()->bCumulative; }
@@ -0,0 +1,124 @@
+/* This file is part of Into.
+ * Copyright (C) Intopii 2013.
+ * All rights reserved.
+ *
+ * Licensees holding a commercial Into license may use this file in
+ * accordance with the commercial license agreement. Please see
+ * LICENSE.commercial for commercial licensing terms.
+ *
+ * Alternatively, this file may be used under the terms of the GNU
+ * Affero General Public License version 3 as published by the Free
+ * Software Foundation. In addition, Intopii gives you special rights
+ * to use Into as a part of open source software projects. Please
+ * refer to LICENSE.AGPL3 for details.
+ */
+
+#ifndef _PIIPCACOLLECTOR_H
+#define _PIIPCACOLLECTOR_H
+
+#include <PiiDefaultOperation.h>
+#include <PiiCovarianceAccumulator.h>
+
+/**
+ * An operation that trains a principal component analysis (PCA)
+ * model online. Incoming feature vectors are not stored; only their
+ * mean and covariance are accumulated with PiiCovarianceAccumulator.
+ * The model is recalculated from the covariance whenever it is
+ * emitted.
+ *
+ * Inputs
+ * ------
+ *
+ * @in sync - an optional sync input. If this input is connected, the
+ * model is emitted once for each object read from this input, after
+ * all features related to it have been received. If this input is
+ * not connected, the model is emitted after every
+ * [emissionInterval] objects read from `features`.
+ *
+ * @in features - feature vectors. Any numeric matrix with one sample
+ * per row. The number of columns must be the same in all matrices.
+ *
+ * Outputs
+ * -------
+ *
+ * @out sync - the object received in the `sync` input.
+ *
+ * @out mean - the mean of all samples as a 1-by-N
+ * PiiMatrix<double>. Subtract this from the samples before
+ * projecting them to the PCA base.
+ *
+ * @out base - the principal components as columns of an N-by-M
+ * PiiMatrix<double>, in descending order of variance. M is N or
+ * [componentCount], whichever is smaller.
+ *
+ * @out variances - the variances along the components as a 1-by-M
+ * PiiMatrix<double>.
+ */
+class PiiPcaCollector : public PiiDefaultOperation
+{
+  Q_OBJECT
+
+  /**
+   * The maximum number of components to emit. Zero means all. The
+   * default is zero.
+   */
+  Q_PROPERTY(int componentCount READ componentCount WRITE setComponentCount);
+
+  /**
+   * The number of `features` objects between emissions if the `sync`
+   * input is not connected. The default is one, which emits the
+   * model after each object. Calculating the model takes
+   * \(O(N^3)\) time. With many dimensions or small batches, set a
+   * larger value.
+   */
+  Q_PROPERTY(int emissionInterval READ emissionInterval WRITE setEmissionInterval);
+
+  /**
+   * If `true`, samples are accumulated over all sync rounds. If
+   * `false`, the accumulated statistics are cleared once the model
+   * has been emitted on a sync round. This property has no effect if
+   * the `sync` input is not connected. The default is `true`.
+   */
+  Q_PROPERTY(bool cumulative READ cumulative WRITE setCumulative);
+
+  PII_OPERATION_SERIALIZATION_FUNCTION
+
+public:
+  PiiPcaCollector();
+
+  void check(bool reset);
+
+  void setComponentCount(int componentCount);
+  int componentCount() const;
+  void setEmissionInterval(int emissionInterval);
+  int emissionInterval() const;
+  void setCumulative(bool cumulative);
+  bool cumulative() const;
+
+protected:
+  void process();
+  void syncEvent(SyncEvent* event);
+
+private:
+  template <class T> void addSamples(const PiiVariant& obj);
+  void emitModel();
+
+  /// @internal
+  class Data : public PiiDefaultOperation::Data
+  {
+  public:
+    Data();
+
+    int iComponentCount;
+    int iEmissionInterval;
+    int iObjectCount;
+    bool bCumulative;
+    bool bSyncConnected;
+    PiiVariant varSyncObject;
+    PiiCovarianceAccumulator accumulator;
+  };
+  PII_D_FUNC;
+};
+
+
+#endif //_PIIPCACOLLECTOR_H
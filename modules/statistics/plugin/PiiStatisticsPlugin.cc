@@ -16,8 +16,10 @@
 #include "PiiPlugin.h"
 #include "PiiHistogramCollector.h"
 #include "PiiMultiVariableHistogram.h"
+#include "PiiPcaCollector.h"
 
 PII_IMPLEMENT_PLUGIN(PiiStatisticsPlugin);
 
 PII_REGISTER_OPERATION(PiiHistogramCollector);
 PII_REGISTER_OPERATION(PiiMultiVariableHistogram);
+PII_REGISTER_OPERATION(PiiPcaCollector);
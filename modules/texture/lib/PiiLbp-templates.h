@@ -28,6 +28,13 @@
   ++neighborPtr1[i];                                                    \
   ++neighborPtr2[i]
 
+#define INTERPOLATE_FIXED_NEIGHBOR(neighbor,i) weights = d->pPoints[i].weights; \
+  neighbor = weights[0] * int(*neighborPtr1[i]);                        \
+  if (weights[1]) neighbor += weights[1] * int(neighborPtr1[i][1]);     \
+  if (weights[2]) neighbor += weights[2] * int(*neighborPtr2[i]);       \
+  if (weights[3]) neighbor += weights[3] * int(neighborPtr2[i][1]);     \
+  ++neighborPtr1[i];                                                    \
+  ++neighborPtr2[i]
 
 template <class MatrixClass, class T, class Roi, class UnaryFunction>
 PiiMatrix<int> PiiLbp::genericLbp(const PiiMatrix<T>& image, Roi roi, UnaryFunction centerFunc)
@@ -43,6 +50,10 @@ PiiMatrix<int> PiiLbp::genericLbp(const PiiMatrix<T>& image, Roi roi, UnaryFunct
       d->dRadius == 1)
     return basicLbp<MatrixClass>(image, roi, centerFunc);
 
+  PiiMatrix<int> matResult;
+  if (fastLbp<MatrixClass>(matResult, image, roi, centerFunc))
+    return matResult;
+
   // This much free space must be ensured on all sides.
   const int iMargin = (int)std::ceil(d->dRadius);
   const int iSamples = d->iSamples;
@@ -112,10 +123,16 @@ PiiMatrix<int> PiiLbp::genericLbp(const PiiMatrix<T>& image, Roi roi, UnaryFunct
       const T** neighborPtr1 = new const T*[iSamples];
       const T** neighborPtr2 = new const T*[iSamples];
       float* coeffs;
+      short* weights;
       C center;
       float neighbor;
+      int iNeighbor;
       unsigned int value;
       int bit, r, c;
+      // Small integers are interpolated exactly in fixed point. The
+      // condition is known at compile time.
+      const bool bFixedPoint = Pii::IsInteger<T>::boolValue && sizeof(T) <= 2 &&
+        Pii::IsInteger<C>::boolValue;
       for (r=iMargin; r<image.rows()-iMargin; ++r)
         {
           // Tell our matrix that we're about to handle a new row.
@@ -140,14 +157,28 @@ PiiMatrix<int> PiiLbp::genericLbp(const PiiMatrix<T>& image, Roi roi, UnaryFunct
               if (roi(r,c))
                 {
                   center = centerFunc(*centerPtr);
-                  //the first bit doesn't need to be shifted
-                  INTERPOLATE_NEIGHBOR(neighbor, 0);
-                  value = Pii::floatSignBit(center, neighbor);
-                  //take the LBP bit for each sample
-                  for (bit=1; bit<iSamples; ++bit)
+                  if (bFixedPoint)
                     {
-                      INTERPOLATE_NEIGHBOR(neighbor, bit);
-                      value |= Pii::floatSignBit(center, neighbor) >> bit;
+                      const int iCenter = int(center) * (1 << InterpolationWeightBits);
+                      INTERPOLATE_FIXED_NEIGHBOR(iNeighbor, 0);
+                      value = Pii::signBit(iCenter, iNeighbor);
+                      for (bit=1; bit<iSamples; ++bit)
+                        {
+                          INTERPOLATE_FIXED_NEIGHBOR(iNeighbor, bit);
+                          value |= Pii::signBit(iCenter, iNeighbor) >> bit;
+                        }
+                    }
+                  else
+                    {
+                      //the first bit doesn't need to be shifted
+                      INTERPOLATE_NEIGHBOR(neighbor, 0);
+                      value = Pii::floatSignBit(center, neighbor);
+                      //take the LBP bit for each sample
+                      for (bit=1; bit<iSamples; ++bit)
+                        {
+                          INTERPOLATE_NEIGHBOR(neighbor, bit);
+                          value |= Pii::floatSignBit(center, neighbor) >> bit;
+                        }
                     }
 
                   // Update the result matrix.
@@ -182,6 +213,10 @@ template <class MatrixClass, class T, class Roi> PiiMatrix<int> PiiLbp::genericS
       d->dRadius == 1)
     return basicSymmetricLbp<MatrixClass>(image, roi);
 
+  PiiMatrix<int> matResult;
+  if (fastSymmetricLbp<MatrixClass>(matResult, image, roi))
+    return matResult;
+
   // This much free space must be ensured on all sides.
   const int iMargin = (int)std::ceil(d->dRadius);
   const int iSamples = d->iSamples;
@@ -306,6 +341,10 @@ PiiMatrix<int> PiiLbp::basicLbp(const PiiMatrix<T>& image, Roi roi, UnaryFunctio
 {
   typedef typename UnaryFunction::result_type C;
 
+  PiiMatrix<int> matResult;
+  if (fastBasicLbp<MatrixClass>(matResult, image, roi, centerFunc, false))
+    return matResult;
+
   const T *r0, *r1, *r2;
   register unsigned int value;
   int r, c;
@@ -350,6 +389,10 @@ PiiMatrix<int> PiiLbp::basicLbp(const PiiMatrix<T>& image, Roi roi, UnaryFunctio
 
 template <class MatrixClass, class T, class Roi> PiiMatrix<int> PiiLbp::basicSymmetricLbp(const PiiMatrix<T>& image, Roi roi)
 {
+  PiiMatrix<int> matResult;
+  if (fastBasicLbp<MatrixClass>(matResult, image, roi, Pii::Identity<T>(), true))
+    return matResult;
+
   const T *r0, *r1, *r2;
   register unsigned int value;
   int r, c;
@@ -382,3 +425,127 @@ template <class MatrixClass, class T, class Roi> PiiMatrix<int> PiiLbp::basicSym
     }
   return result;
 }
+
+template <class MatrixClass>
+PiiMatrix<int> PiiLbp::nearestLbp(const PiiMatrix<unsigned char>& image,
+                                  const int (*offsets)[2], int samples, int margin,
+                                  int features, const unsigned short* lookup, bool symmetric)
+{
+  MatrixClass result(image.rows(), image.columns(), margin, features);
+  const int iCount = image.columns() - 2*margin;
+  if (iCount <= 0)
+    return result;
+
+  // Codes are calculated a row at a time and passed to the matrix
+  // class. A histogram is thus collected without a code image.
+  QVarLengthArray<unsigned short, 1024> vecCodes(iCount);
+  const unsigned char* aNeighbors[16];
+  for (int r=margin; r<image.rows()-margin; ++r)
+    {
+      result.changeRow(r);
+      for (int b=0; b<samples; ++b)
+        aNeighbors[b] = image.row(r+offsets[b][1]) + (offsets[b][0] + margin);
+      if (symmetric)
+        symmetricLbpRow(vecCodes.data(), aNeighbors, samples, iCount);
+      else
+        nearestLbpRow(vecCodes.data(), image.row(r) + margin, aNeighbors, samples, iCount);
+
+      if (lookup != 0)
+        for (int c=0; c<iCount; ++c)
+          result.modify(c + margin, lookup[vecCodes[c]]);
+      else
+        for (int c=0; c<iCount; ++c)
+          result.modify(c + margin, vecCodes[c]);
+    }
+  return result;
+}
+
+template <class MatrixClass>
+bool PiiLbp::fastBasicLbp(PiiMatrix<int>& result, const PiiMatrix<unsigned char>& image,
+                          PiiImage::DefaultRoi, Pii::Identity<unsigned char>, bool symmetric)
+{
+  // The same neighbors as in basicLbp(), first sample (MSB) first.
+  static const int aOffsets[8][2] = { {1,1}, {0,1}, {-1,1}, {-1,0}, {-1,-1}, {0,-1}, {1,-1}, {1,0} };
+  result = nearestLbp<MatrixClass>(image, aOffsets, 8, 1, symmetric ? 16 : 256, 0, symmetric);
+  return true;
+}
+
+template <class MatrixClass>
+bool PiiLbp::fastLbp(PiiMatrix<int>& result, const PiiMatrix<unsigned char>& image,
+                     PiiImage::DefaultRoi, Pii::Identity<unsigned char>) const
+{
+  const int iSamples = d->iSamples;
+  if (iSamples > 16)
+    return false;
+
+  const int iMargin = (int)std::ceil(d->dRadius);
+  const int iFeatures = featureCount(iSamples, d->mode);
+  if (d->interpolation == Pii::NearestNeighborInterpolation)
+    {
+      int aOffsets[16][2];
+      for (int b=0; b<iSamples; ++b)
+        {
+          aOffsets[b][0] = d->pPoints[b].nearestX;
+          aOffsets[b][1] = d->pPoints[b].nearestY;
+        }
+      result = nearestLbp<MatrixClass>(image, aOffsets, iSamples, iMargin, iFeatures, d->pLookup, false);
+      return true;
+    }
+
+  MatrixClass matResult(image.rows(), image.columns(), iMargin, iFeatures);
+  const int iCount = image.columns() - 2*iMargin;
+  if (iCount > 0)
+    {
+      short aWeights[64];
+      for (int b=0; b<iSamples; ++b)
+        for (int i=0; i<4; ++i)
+          aWeights[4*b+i] = d->pPoints[b].weights[i];
+
+      QVarLengthArray<unsigned short, 1024> vecCodes(iCount);
+      const unsigned char *aNeighbors1[16], *aNeighbors2[16];
+      for (int r=iMargin; r<image.rows()-iMargin; ++r)
+        {
+          matResult.changeRow(r);
+          for (int b=0; b<iSamples; ++b)
+            {
+              const InterpolationPoint& point = d->pPoints[b];
+              aNeighbors1[b] = image.row(r+point.y) + (point.x + iMargin);
+              // The second row is needed only if it fits in the image.
+              // Its weights are zero otherwise.
+              aNeighbors2[b] = r+point.y+1 < image.rows() ?
+                image.row(r+point.y+1) + (point.x + iMargin) :
+                aNeighbors1[b];
+            }
+          interpolatedLbpRow(vecCodes.data(), image.row(r) + iMargin,
+                             aNeighbors1, aNeighbors2, aWeights, iSamples, iCount);
+
+          if (d->pLookup != 0)
+            for (int c=0; c<iCount; ++c)
+              matResult.modify(c + iMargin, d->pLookup[vecCodes[c]]);
+          else
+            for (int c=0; c<iCount; ++c)
+              matResult.modify(c + iMargin, vecCodes[c]);
+        }
+    }
+  result = matResult;
+  return true;
+}
+
+template <class MatrixClass>
+bool PiiLbp::fastSymmetricLbp(PiiMatrix<int>& result, const PiiMatrix<unsigned char>& image,
+                              PiiImage::DefaultRoi) const
+{
+  const int iSamples = d->iSamples;
+  if (iSamples > 16 || d->interpolation != Pii::NearestNeighborInterpolation)
+    return false;
+
+  int aOffsets[16][2];
+  for (int b=0; b<iSamples; ++b)
+    {
+      aOffsets[b][0] = d->pPoints[b].nearestX;
+      aOffsets[b][1] = d->pPoints[b].nearestY;
+    }
+  result = nearestLbp<MatrixClass>(image, aOffsets, iSamples, (int)std::ceil(d->dRadius),
+                                   1 << (iSamples >> 1), 0, true);
+  return true;
+}
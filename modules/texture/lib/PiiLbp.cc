@@ -14,9 +14,13 @@
  */
 
 #include <PiiMath.h>
+#include <PiiCpu.h>
 #include "PiiLbp.h"
 
 #include <iostream>
+#include <cstring>
+#include <algorithm>
+
 using namespace Pii;
 
 PiiLbp::Data::Data(int samples, double radius,
@@ -200,6 +204,20 @@ void PiiLbp::Data::update()
       pPoints[i].coeffs[1] = (float)(offsetX*dy);
       pPoints[i].coeffs[2] = (float)(dx*offsetY);
       pPoints[i].coeffs[3] = (float)(offsetX*offsetY);
+
+      // Fixed-point weights for integer images. The rounding error is
+      // given to the largest weight so that a flat neighborhood
+      // interpolates exactly to its own value.
+      const int iOne = 1 << InterpolationWeightBits;
+      int iSum = 0, iLargest = 0;
+      for (int j=0; j<4; ++j)
+        {
+          pPoints[i].weights[j] = (short)Pii::round<int>(pPoints[i].coeffs[j] * iOne);
+          iSum += pPoints[i].weights[j];
+          if (pPoints[i].weights[j] > pPoints[i].weights[iLargest])
+            iLargest = j;
+        }
+      pPoints[i].weights[iLargest] += iOne - iSum;
     }
 
   delete[] pLookup;
@@ -225,3 +243,416 @@ Pii::Interpolation PiiLbp::interpolation() const
 {
   return d->interpolation;
 }
+
+namespace
+{
+  // The bit of sample b in a code built from the given number of
+  // samples. The first sample goes to the MSB.
+  inline int codeBit(int samples, int b) { return samples - 1 - b; }
+
+  const int weightBits = PiiLbp::InterpolationWeightBits;
+
+#ifdef PII_X86_SIMD
+  // Unsigned byte comparison a > b. SSE2 only has a signed one.
+  PII_CPU_TARGET("sse2")
+  inline __m128i greaterU8(__m128i a, __m128i b)
+  {
+    const __m128i bias = _mm_set1_epi8(char(0x80));
+    return _mm_cmpgt_epi8(_mm_xor_si128(a, bias), _mm_xor_si128(b, bias));
+  }
+
+  PII_CPU_TARGET("sse2")
+  int nearestLbpRowSse2(unsigned short* codes, const unsigned char* centers,
+                        const unsigned char* const* neighbors, int samples, int count)
+  {
+    int i = 0;
+    for (; i + 16 <= count; i += 16)
+      {
+        const __m128i center = _mm_loadu_si128(reinterpret_cast<const __m128i*>(centers + i));
+        // The low and high bytes of 16 codes.
+        __m128i lo = _mm_setzero_si128(), hi = _mm_setzero_si128();
+        for (int b=0; b<samples; ++b)
+          {
+            const __m128i greater = greaterU8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(neighbors[b] + i)),
+                                              center);
+            const int iBit = codeBit(samples, b);
+            if (iBit < 8)
+              lo = _mm_or_si128(lo, _mm_and_si128(greater, _mm_set1_epi8(char(1 << iBit))));
+            else
+              hi = _mm_or_si128(hi, _mm_and_si128(greater, _mm_set1_epi8(char(1 << (iBit-8)))));
+          }
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(codes + i), _mm_unpacklo_epi8(lo, hi));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(codes + i + 8), _mm_unpackhi_epi8(lo, hi));
+      }
+    return i;
+  }
+
+  PII_CPU_TARGET("sse2")
+  int symmetricLbpRowSse2(unsigned short* codes, const unsigned char* const* neighbors, int samples, int count)
+  {
+    const int iHalf = samples >> 1;
+    int i = 0;
+    for (; i + 16 <= count; i += 16)
+      {
+        __m128i code = _mm_setzero_si128();
+        for (int b=0; b<iHalf; ++b)
+          {
+            const __m128i greater = greaterU8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(neighbors[b+iHalf] + i)),
+                                              _mm_loadu_si128(reinterpret_cast<const __m128i*>(neighbors[b] + i)));
+            code = _mm_or_si128(code, _mm_and_si128(greater, _mm_set1_epi8(char(1 << codeBit(iHalf, b)))));
+          }
+        const __m128i zero = _mm_setzero_si128();
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(codes + i), _mm_unpacklo_epi8(code, zero));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(codes + i + 8), _mm_unpackhi_epi8(code, zero));
+      }
+    return i;
+  }
+
+  // Weights two consecutive runs of eight pixels starting at
+  // *data*. Returns the sums for the first and the last four pixels.
+  PII_CPU_TARGET("sse2")
+  inline void weightPairs8(const unsigned char* data, const short* weights, __m128i& lo, __m128i& hi)
+  {
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i first = _mm_unpacklo_epi8(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(data)), zero);
+    const __m128i second = weights[1] != 0 ?
+      _mm_unpacklo_epi8(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(data + 1)), zero) :
+      zero;
+    const __m128i pair = _mm_set1_epi32(int((unsigned short)weights[0]) | (int(weights[1]) << 16));
+    lo = _mm_madd_epi16(_mm_unpacklo_epi16(first, second), pair);
+    hi = _mm_madd_epi16(_mm_unpackhi_epi16(first, second), pair);
+  }
+
+  PII_CPU_TARGET("sse2")
+  int interpolatedLbpRowSse2(unsigned short* codes, const unsigned char* centers,
+                             const unsigned char* const* neighbors1, const unsigned char* const* neighbors2,
+                             const short* weights, int samples, int count)
+  {
+    const __m128i zero = _mm_setzero_si128();
+    // 16-bit codes do not fit in a signed pack. Shift them to the
+    // signed range and back.
+    const __m128i bias32 = _mm_set1_epi32(32768);
+    const __m128i bias16 = _mm_set1_epi16(short(-32768));
+    int i = 0;
+    for (; i + 8 <= count; i += 8)
+      {
+        const __m128i center = _mm_unpacklo_epi8(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(centers + i)), zero);
+        const __m128i centerLo = _mm_slli_epi32(_mm_unpacklo_epi16(center, zero), weightBits),
+          centerHi = _mm_slli_epi32(_mm_unpackhi_epi16(center, zero), weightBits);
+        __m128i codeLo = zero, codeHi = zero;
+        for (int b=0; b<samples; ++b)
+          {
+            const short* pWeights = weights + 4*b;
+            __m128i lo, hi;
+            weightPairs8(neighbors1[b] + i, pWeights, lo, hi);
+            if (pWeights[2] != 0 || pWeights[3] != 0)
+              {
+                __m128i lo2, hi2;
+                weightPairs8(neighbors2[b] + i, pWeights + 2, lo2, hi2);
+                lo = _mm_add_epi32(lo, lo2);
+                hi = _mm_add_epi32(hi, hi2);
+              }
+            const __m128i bit = _mm_set1_epi32(1 << codeBit(samples, b));
+            codeLo = _mm_or_si128(codeLo, _mm_and_si128(_mm_cmplt_epi32(centerLo, lo), bit));
+            codeHi = _mm_or_si128(codeHi, _mm_and_si128(_mm_cmplt_epi32(centerHi, hi), bit));
+          }
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(codes + i),
+                         _mm_xor_si128(_mm_packs_epi32(_mm_sub_epi32(codeLo, bias32),
+                                                       _mm_sub_epi32(codeHi, bias32)),
+                                       bias16));
+      }
+    return i;
+  }
+
+  PII_CPU_TARGET("avx2")
+  int nearestLbpRowAvx2(unsigned short* codes, const unsigned char* centers,
+                        const unsigned char* const* neighbors, int samples, int count)
+  {
+    const __m256i bias = _mm256_set1_epi8(char(0x80));
+    int i = 0;
+    for (; i + 32 <= count; i += 32)
+      {
+        const __m256i center = _mm256_xor_si256(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(centers + i)), bias);
+        __m256i lo = _mm256_setzero_si256(), hi = _mm256_setzero_si256();
+        for (int b=0; b<samples; ++b)
+          {
+            const __m256i greater = _mm256_cmpgt_epi8(_mm256_xor_si256(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(neighbors[b] + i)),
+                                                                       bias),
+                                                      center);
+            const int iBit = codeBit(samples, b);
+            if (iBit < 8)
+              lo = _mm256_or_si256(lo, _mm256_and_si256(greater, _mm256_set1_epi8(char(1 << iBit))));
+            else
+              hi = _mm256_or_si256(hi, _mm256_and_si256(greater, _mm256_set1_epi8(char(1 << (iBit-8)))));
+          }
+        // Unpacking works within 128-bit lanes. Reorder the quadwords
+        // so that the results come out in pixel order.
+        lo = _mm256_permute4x64_epi64(lo, _MM_SHUFFLE(3,1,2,0));
+        hi = _mm256_permute4x64_epi64(hi, _MM_SHUFFLE(3,1,2,0));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(codes + i), _mm256_unpacklo_epi8(lo, hi));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(codes + i + 16), _mm256_unpackhi_epi8(lo, hi));
+      }
+    return i;
+  }
+
+  PII_CPU_TARGET("avx2")
+  int symmetricLbpRowAvx2(unsigned short* codes, const unsigned char* const* neighbors, int samples, int count)
+  {
+    const __m256i bias = _mm256_set1_epi8(char(0x80));
+    const int iHalf = samples >> 1;
+    int i = 0;
+    for (; i + 32 <= count; i += 32)
+      {
+        __m256i code = _mm256_setzero_si256();
+        for (int b=0; b<iHalf; ++b)
+          {
+            const __m256i greater =
+              _mm256_cmpgt_epi8(_mm256_xor_si256(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(neighbors[b+iHalf] + i)), bias),
+                                _mm256_xor_si256(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(neighbors[b] + i)), bias));
+            code = _mm256_or_si256(code, _mm256_and_si256(greater, _mm256_set1_epi8(char(1 << codeBit(iHalf, b)))));
+          }
+        code = _mm256_permute4x64_epi64(code, _MM_SHUFFLE(3,1,2,0));
+        const __m256i zero = _mm256_setzero_si256();
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(codes + i), _mm256_unpacklo_epi8(code, zero));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(codes + i + 16), _mm256_unpackhi_epi8(code, zero));
+      }
+    return i;
+  }
+
+  // Weights two consecutive runs of 16 pixels. Unpacking works within
+  // 128-bit lanes: *lo* receives pixels 0-3 and 8-11, *hi* 4-7 and
+  // 12-15.
+  PII_CPU_TARGET("avx2")
+  inline void weightPairs16(const unsigned char* data, const short* weights, __m256i& lo, __m256i& hi)
+  {
+    const __m256i first = _mm256_cvtepu8_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i*>(data)));
+    const __m256i second = weights[1] != 0 ?
+      _mm256_cvtepu8_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i*>(data + 1))) :
+      _mm256_setzero_si256();
+    const __m256i pair = _mm256_set1_epi32(int((unsigned short)weights[0]) | (int(weights[1]) << 16));
+    lo = _mm256_madd_epi16(_mm256_unpacklo_epi16(first, second), pair);
+    hi = _mm256_madd_epi16(_mm256_unpackhi_epi16(first, second), pair);
+  }
+
+  PII_CPU_TARGET("avx2")
+  int interpolatedLbpRowAvx2(unsigned short* codes, const unsigned char* centers,
+                             const unsigned char* const* neighbors1, const unsigned char* const* neighbors2,
+                             const short* weights, int samples, int count)
+  {
+    const __m256i zero = _mm256_setzero_si256();
+    int i = 0;
+    for (; i + 16 <= count; i += 16)
+      {
+        const __m256i center = _mm256_cvtepu8_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i*>(centers + i)));
+        const __m256i centerLo = _mm256_slli_epi32(_mm256_unpacklo_epi16(center, zero), weightBits),
+          centerHi = _mm256_slli_epi32(_mm256_unpackhi_epi16(center, zero), weightBits);
+        __m256i codeLo = zero, codeHi = zero;
+        for (int b=0; b<samples; ++b)
+          {
+            const short* pWeights = weights + 4*b;
+            __m256i lo, hi;
+            weightPairs16(neighbors1[b] + i, pWeights, lo, hi);
+            if (pWeights[2] != 0 || pWeights[3] != 0)
+              {
+                __m256i lo2, hi2;
+                weightPairs16(neighbors2[b] + i, pWeights + 2, lo2, hi2);
+                lo = _mm256_add_epi32(lo, lo2);
+                hi = _mm256_add_epi32(hi, hi2);
+              }
+            const __m256i bit = _mm256_set1_epi32(1 << codeBit(samples, b));
+            codeLo = _mm256_or_si256(codeLo, _mm256_and_si256(_mm256_cmpgt_epi32(lo, centerLo), bit));
+            codeHi = _mm256_or_si256(codeHi, _mm256_and_si256(_mm256_cmpgt_epi32(hi, centerHi), bit));
+          }
+        // Packing works within lanes, too, and restores pixel order.
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(codes + i), _mm256_packus_epi32(codeLo, codeHi));
+      }
+    return i;
+  }
+#endif
+
+#ifdef PII_NEON_SIMD
+  int nearestLbpRowNeon(unsigned short* codes, const unsigned char* centers,
+                        const unsigned char* const* neighbors, int samples, int count)
+  {
+    int i = 0;
+    for (; i + 16 <= count; i += 16)
+      {
+        const uint8x16_t center = vld1q_u8(centers + i);
+        uint8x16_t lo = vdupq_n_u8(0), hi = vdupq_n_u8(0);
+        for (int b=0; b<samples; ++b)
+          {
+            const uint8x16_t greater = vcgtq_u8(vld1q_u8(neighbors[b] + i), center);
+            const int iBit = codeBit(samples, b);
+            if (iBit < 8)
+              lo = vorrq_u8(lo, vandq_u8(greater, vdupq_n_u8(1 << iBit)));
+            else
+              hi = vorrq_u8(hi, vandq_u8(greater, vdupq_n_u8(1 << (iBit-8))));
+          }
+        // Interleaved low and high bytes are little-endian 16-bit codes.
+        const uint8x16x2_t words = vzipq_u8(lo, hi);
+        vst1q_u16(codes + i, vreinterpretq_u16_u8(words.val[0]));
+        vst1q_u16(codes + i + 8, vreinterpretq_u16_u8(words.val[1]));
+      }
+    return i;
+  }
+
+  int symmetricLbpRowNeon(unsigned short* codes, const unsigned char* const* neighbors, int samples, int count)
+  {
+    const int iHalf = samples >> 1;
+    int i = 0;
+    for (; i + 16 <= count; i += 16)
+      {
+        uint8x16_t code = vdupq_n_u8(0);
+        for (int b=0; b<iHalf; ++b)
+          code = vorrq_u8(code, vandq_u8(vcgtq_u8(vld1q_u8(neighbors[b+iHalf] + i), vld1q_u8(neighbors[b] + i)),
+                                         vdupq_n_u8(1 << codeBit(iHalf, b))));
+        vst1q_u16(codes + i, vmovl_u8(vget_low_u8(code)));
+        vst1q_u16(codes + i + 8, vmovl_u8(vget_high_u8(code)));
+      }
+    return i;
+  }
+
+  int interpolatedLbpRowNeon(unsigned short* codes, const unsigned char* centers,
+                             const unsigned char* const* neighbors1, const unsigned char* const* neighbors2,
+                             const short* weights, int samples, int count)
+  {
+    int i = 0;
+    for (; i + 8 <= count; i += 8)
+      {
+        const uint16x8_t center = vmovl_u8(vld1_u8(centers + i));
+        const uint32x4_t centerLo = vshll_n_u16(vget_low_u16(center), weightBits),
+          centerHi = vshll_n_u16(vget_high_u16(center), weightBits);
+        uint32x4_t codeLo = vdupq_n_u32(0), codeHi = vdupq_n_u32(0);
+        for (int b=0; b<samples; ++b)
+          {
+            const short* pWeights = weights + 4*b;
+            const uint16x8_t first = vmovl_u8(vld1_u8(neighbors1[b] + i));
+            uint32x4_t lo = vmull_n_u16(vget_low_u16(first), pWeights[0]),
+              hi = vmull_n_u16(vget_high_u16(first), pWeights[0]);
+            for (int j=1; j<4; ++j)
+              if (pWeights[j] != 0)
+                {
+                  const uint16x8_t next = vmovl_u8(vld1_u8((j < 2 ? neighbors1[b] : neighbors2[b]) + i + (j & 1)));
+                  lo = vmlal_n_u16(lo, vget_low_u16(next), pWeights[j]);
+                  hi = vmlal_n_u16(hi, vget_high_u16(next), pWeights[j]);
+                }
+            const uint32x4_t bit = vdupq_n_u32(1 << codeBit(samples, b));
+            codeLo = vorrq_u32(codeLo, vandq_u32(vcltq_u32(centerLo, lo), bit));
+            codeHi = vorrq_u32(codeHi, vandq_u32(vcltq_u32(centerHi, hi), bit));
+          }
+        vst1q_u16(codes + i, vcombine_u16(vmovn_u32(codeLo), vmovn_u32(codeHi)));
+      }
+    return i;
+  }
+#endif
+}
+
+void PiiLbp::nearestLbpRow(unsigned short* codes, const unsigned char* centers,
+                           const unsigned char* const* neighbors, int samples, int count)
+{
+  int i = 0;
+  switch (simdLevel())
+    {
+#ifdef PII_X86_SIMD
+    case Avx2Simd:
+      i = nearestLbpRowAvx2(codes, centers, neighbors, samples, count);
+      break;
+    case Sse2Simd:
+      i = nearestLbpRowSse2(codes, centers, neighbors, samples, count);
+      break;
+#endif
+#ifdef PII_NEON_SIMD
+    case NeonSimd:
+      i = nearestLbpRowNeon(codes, centers, neighbors, samples, count);
+      break;
+#endif
+    default:
+      break;
+    }
+  // The rest is done one sample at a time, which keeps the inner
+  // loop free of indirection.
+  std::fill(codes + i, codes + count, 0);
+  for (int b=0; b<samples; ++b)
+    {
+      const unsigned char* pNeighbors = neighbors[b];
+      const int iBit = codeBit(samples, b);
+      for (int j=i; j<count; ++j)
+        codes[j] |= static_cast<unsigned short>((pNeighbors[j] > centers[j]) << iBit);
+    }
+}
+
+void PiiLbp::symmetricLbpRow(unsigned short* codes, const unsigned char* const* neighbors, int samples, int count)
+{
+  int i = 0;
+  switch (simdLevel())
+    {
+#ifdef PII_X86_SIMD
+    case Avx2Simd:
+      i = symmetricLbpRowAvx2(codes, neighbors, samples, count);
+      break;
+    case Sse2Simd:
+      i = symmetricLbpRowSse2(codes, neighbors, samples, count);
+      break;
+#endif
+#ifdef PII_NEON_SIMD
+    case NeonSimd:
+      i = symmetricLbpRowNeon(codes, neighbors, samples, count);
+      break;
+#endif
+    default:
+      break;
+    }
+  const int iHalf = samples >> 1;
+  std::fill(codes + i, codes + count, 0);
+  for (int b=0; b<iHalf; ++b)
+    {
+      const unsigned char *pFirst = neighbors[b], *pSecond = neighbors[b+iHalf];
+      const int iBit = codeBit(iHalf, b);
+      for (int j=i; j<count; ++j)
+        codes[j] |= static_cast<unsigned short>((pFirst[j] < pSecond[j]) << iBit);
+    }
+}
+
+void PiiLbp::interpolatedLbpRow(unsigned short* codes, const unsigned char* centers,
+                                const unsigned char* const* neighbors1, const unsigned char* const* neighbors2,
+                                const short* weights, int samples, int count)
+{
+  int i = 0;
+  switch (simdLevel())
+    {
+#ifdef PII_X86_SIMD
+    case Avx2Simd:
+      i = interpolatedLbpRowAvx2(codes, centers, neighbors1, neighbors2, weights, samples, count);
+      break;
+    case Sse2Simd:
+      i = interpolatedLbpRowSse2(codes, centers, neighbors1, neighbors2, weights, samples, count);
+      break;
+#endif
+#ifdef PII_NEON_SIMD
+    case NeonSimd:
+      i = interpolatedLbpRowNeon(codes, centers, neighbors1, neighbors2, weights, samples, count);
+      break;
+#endif
+    default:
+      break;
+    }
+  std::fill(codes + i, codes + count, 0);
+  for (int b=0; b<samples; ++b)
+    {
+      const int iWeight0 = weights[4*b], iWeight1 = weights[4*b+1],
+        iWeight2 = weights[4*b+2], iWeight3 = weights[4*b+3];
+      const unsigned char *pRow1 = neighbors1[b], *pRow2 = neighbors2[b];
+      // Moves the sign bit to the bit of this sample.
+      const int iShift = 31 - codeBit(samples, b);
+      // Samples on the axes need no horizontal interpolation.
+      if (iWeight1 == 0 && iWeight3 == 0)
+        for (int j=i; j<count; ++j)
+          codes[j] |= static_cast<unsigned short>(Pii::signBit(int(centers[j]) << weightBits,
+                                                               iWeight0 * pRow1[j] + iWeight2 * pRow2[j]) >> iShift);
+      else
+        for (int j=i; j<count; ++j)
+          codes[j] |= static_cast<unsigned short>(Pii::signBit(int(centers[j]) << weightBits,
+                                                               iWeight0 * pRow1[j] + iWeight1 * pRow1[j+1] +
+                                                               iWeight2 * pRow2[j] + iWeight3 * pRow2[j+1]) >> iShift);
+    }
+}
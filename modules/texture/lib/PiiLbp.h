@@ -21,6 +21,7 @@
 #include <PiiImage.h>
 #include <PiiFunctional.h>
 #include <cmath>
+#include <QVarLengthArray>
 #include "PiiTextureGlobal.h"
 
 /**
@@ -171,6 +172,11 @@ public:
    * operator to create either histograms or feature images. See
    * PiiLbp::Histogram and PiiLbp::Image for details.
    *
+   * With linear interpolation, the sampling offsets and weights are
+   * calculated once in [setParameters()]. Images of 8 and 16-bit
+   * integer types are interpolated with fixed-point weights (see
+   * [InterpolationWeightBits]) and other types in floating point.
+   *
    * @param image the input image
    *
    * @param roi region-of-interest. See PiiRoi.
@@ -307,14 +313,98 @@ public:
    */
   static unsigned short* createLookupTable(int samples, Mode mode);
 
+  /**
+   * Calculates standard LBP codes for *count* consecutive pixels of
+   * an 8-bit image using nearest neighbor sampling. This is the
+   * innermost loop of [basicLbp()] and [genericLbp()] with
+   * `unsigned` `char` images. The function uses SSE2/AVX2 or NEON
+   * instructions if the CPU supports them, and processes 16 or 32
+   * pixels at a time.
+   *
+   * @param codes the output. *count* codes will be written.
+   *
+   * @param centers the center pixels
+   *
+   * @param neighbors *samples* pointers to the neighbors of the first
+   * center pixel, in the order of the bits in the code, MSB first.
+   * Bit *b* of code *i* is set if `neighbors[samples-1-b][i]` is
+   * greater than `centers[i]`.
+   *
+   * @param samples the number of neighbors, at most 16.
+   *
+   * @param count the number of pixels
+   */
+  static void nearestLbpRow(unsigned short* codes, const unsigned char* centers,
+                            const unsigned char* const* neighbors, int samples, int count);
+
+  /**
+   * Calculates symmetric LBP codes for *count* consecutive pixels
+   * using nearest neighbor sampling. Bit `samples/2-1-b` of code *i*
+   * is set if `neighbors[b][i]` is less than
+   * `neighbors[b+samples/2][i]`. See [nearestLbpRow()].
+   */
+  static void symmetricLbpRow(unsigned short* codes, const unsigned char* const* neighbors,
+                              int samples, int count);
+
+  /**
+   * The number of fractional bits in the fixed-point interpolation
+   * weights used with integer images.
+   */
+  enum { InterpolationWeightBits = 14 };
+
+  /**
+   * Calculates standard LBP codes for *count* consecutive pixels
+   * using bilinear interpolation. Each neighbor is interpolated from
+   * `neighbors1[b][i]`, `neighbors1[b][i+1]`, `neighbors2[b][i]` and
+   * `neighbors2[b][i+1]` with the four fixed-point weights starting
+   * at `weights[4*b]`, and compared to the center pixel scaled by
+   * `1 << InterpolationWeightBits`. Pixels whose weight is zero are
+   * not read. All arithmetic is exact, and the codes are therefore
+   * equal to those of [genericLbp()] with integer images. Uses
+   * SSE2/AVX2 or NEON if available. See [nearestLbpRow()].
+   */
+  static void interpolatedLbpRow(unsigned short* codes, const unsigned char* centers,
+                                 const unsigned char* const* neighbors1,
+                                 const unsigned char* const* neighbors2,
+                                 const short* weights, int samples, int count);
+
 private:
   struct InterpolationPoint
   {
     int x,y;
     int nearestX,nearestY;
     float coeffs[4];
+    // coeffs in fixed point. The weights sum up to exactly
+    // 1 << InterpolationWeightBits.
+    short weights[4];
   };
 
+  // Fast paths for 8-bit images with the default ROI and center
+  // function. The generic overloads decline; overload resolution
+  // picks the specialized ones when the types match.
+  template <class MatrixClass, class T, class Roi, class UnaryFunction>
+  bool fastLbp(PiiMatrix<int>&, const PiiMatrix<T>&, Roi, UnaryFunction) const { return false; }
+  template <class MatrixClass>
+  bool fastLbp(PiiMatrix<int>& result, const PiiMatrix<unsigned char>& image,
+               PiiImage::DefaultRoi, Pii::Identity<unsigned char>) const;
+
+  template <class MatrixClass, class T, class Roi>
+  bool fastSymmetricLbp(PiiMatrix<int>&, const PiiMatrix<T>&, Roi) const { return false; }
+  template <class MatrixClass>
+  bool fastSymmetricLbp(PiiMatrix<int>& result, const PiiMatrix<unsigned char>& image,
+                        PiiImage::DefaultRoi) const;
+
+  template <class MatrixClass, class T, class Roi, class UnaryFunction>
+  static bool fastBasicLbp(PiiMatrix<int>&, const PiiMatrix<T>&, Roi, UnaryFunction, bool) { return false; }
+  template <class MatrixClass>
+  static bool fastBasicLbp(PiiMatrix<int>& result, const PiiMatrix<unsigned char>& image,
+                           PiiImage::DefaultRoi, Pii::Identity<unsigned char>, bool symmetric);
+
+  template <class MatrixClass>
+  static PiiMatrix<int> nearestLbp(const PiiMatrix<unsigned char>& image,
+                                   const int (*offsets)[2], int samples, int margin,
+                                   int features, const unsigned short* lookup, bool symmetric);
+
   class Data
   {
   public:
@@ -0,0 +1,68 @@
+/* This file is part of Into.
+ * Copyright (C) Intopii 2013.
+ * All rights reserved.
+ *
+ * Licensees holding a commercial Into license may use this file in
+ * accordance with the commercial license agreement. Please see
+ * LICENSE.commercial for commercial licensing terms.
+ *
+ * Alternatively, this file may be used under the terms of the GNU
+ * Affero General Public License version 3 as published by the Free
+ * Software Foundation. In addition, Intopii gives you special rights
+ * to use Into as a part of open source software projects. Please
+ * refer to LICENSE.AGPL3 for details.
+ */
+
+#ifndef _PIITEXTURESTATISTICS_H
+# error "Never use <PiiTextureStatistics-templates.h> directly; include <PiiTextureStatistics.h> instead."
+#endif
+
+#include <PiiMathDefs.h>
+
+namespace PiiTexture
+{
+  template <class T> void gradients(const PiiMatrix<T>& image,
+                                    PiiMatrix<float>& gradientX,
+                                    PiiMatrix<float>& gradientY)
+  {
+    const int iRows = image.rows() - 2, iColumns = image.columns() - 2;
+    if (iRows <= 0 || iColumns <= 0)
+      {
+        gradientX = PiiMatrix<float>();
+        gradientY = PiiMatrix<float>();
+        return;
+      }
+    gradientX = PiiMatrix<float>::uninitialized(iRows, iColumns);
+    gradientY = PiiMatrix<float>::uninitialized(iRows, iColumns);
+
+    const float fDiagonal = float(M_SQRT1_2);
+    for (int r=0; r<iRows; ++r)
+      {
+        const T* pAbove = image[r], *pCenter = image[r+1], *pBelow = image[r+2];
+        float* pX = gradientX[r], *pY = gradientY[r];
+        for (int c=0; c<iColumns; ++c)
+          {
+            const float fTopLeft = float(pAbove[c]), fTopRight = float(pAbove[c+2]),
+              fBottomLeft = float(pBelow[c]), fBottomRight = float(pBelow[c+2]);
+            pX[c] = fDiagonal * (fTopRight - fTopLeft + fBottomRight - fBottomLeft) +
+              (float(pCenter[c+2]) - float(pCenter[c]));
+            pY[c] = fDiagonal * (fTopLeft + fTopRight - fBottomLeft - fBottomRight) +
+              (float(pAbove[c+1]) - float(pBelow[c+1]));
+          }
+      }
+  }
+
+  template <class T> PiiMatrix<float> localVariances(const PiiImage::IntegralImage<T>& integral, int radius)
+  {
+    const int iWindowSize = 2*radius + 1;
+    PiiMatrix<float> matResult(PiiMatrix<float>::uninitialized(integral.rows()-2*radius,
+                                                               integral.columns()-2*radius));
+    for (int r=matResult.rows(); r--; )
+      {
+        float *pResultRow = matResult.row(r);
+        for (int c=matResult.columns(); c--; )
+          pResultRow[c] = float(integral.variance(r, c, r + iWindowSize, c + iWindowSize));
+      }
+    return matResult;
+  }
+}
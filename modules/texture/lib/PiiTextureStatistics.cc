@@ -0,0 +1,70 @@
+/* This file is part of Into.
+ * Copyright (C) Intopii 2013.
+ * All rights reserved.
+ *
+ * Licensees holding a commercial Into license may use this file in
+ * accordance with the commercial license agreement. Please see
+ * LICENSE.commercial for commercial licensing terms.
+ *
+ * Alternatively, this file may be used under the terms of the GNU
+ * Affero General Public License version 3 as published by the Free
+ * Software Foundation. In addition, Intopii gives you special rights
+ * to use Into as a part of open source software projects. Please
+ * refer to LICENSE.AGPL3 for details.
+ */
+
+#include "PiiTextureStatistics.h"
+#include <PiiMath.h>
+
+namespace PiiTexture
+{
+  PiiMatrix<float> structureTensor(const PiiMatrix<float>& gradientX,
+                                   const PiiMatrix<float>& gradientY)
+  {
+    double dXX = 0, dXY = 0, dYY = 0;
+    const int iRows = qMin(gradientX.rows(), gradientY.rows()),
+      iColumns = qMin(gradientX.columns(), gradientY.columns());
+    for (int r=0; r<iRows; ++r)
+      {
+        const float* pX = gradientX[r], *pY = gradientY[r];
+        // Accumulate each row in single precision and the totals in
+        // double to keep large images accurate.
+        float fXX = 0, fXY = 0, fYY = 0;
+        for (int c=0; c<iColumns; ++c)
+          {
+            fXX += pX[c] * pX[c];
+            fXY += pX[c] * pY[c];
+            fYY += pY[c] * pY[c];
+          }
+        dXX += fXX;
+        dXY += fXY;
+        dYY += fYY;
+      }
+    PiiMatrix<float> matTensor(1,3);
+    const int iCount = iRows * iColumns;
+    if (iCount > 0)
+      {
+        matTensor(0,0) = float(dXX / iCount);
+        matTensor(0,1) = float(dXY / iCount);
+        matTensor(0,2) = float(dYY / iCount);
+      }
+    return matTensor;
+  }
+
+  PiiMatrix<std::complex<float> > spectrum(const PiiFft<float>& fft,
+                                           const PiiMatrix<float>& image,
+                                           float mean)
+  {
+    PiiMatrix<float> matZeroMean(image);
+    matZeroMean -= mean;
+    PiiMatrix<std::complex<float> > matTransformed(fft.forwardFft(matZeroMean));
+    if (!matTransformed.isEmpty())
+      matTransformed(0,0) = std::complex<float>(mean * image.rows() * image.columns(), 0);
+    return matTransformed;
+  }
+
+  PiiMatrix<float> halfMagnitude(const PiiMatrix<std::complex<float> >& spectrum)
+  {
+    return Pii::abs(spectrum(0,0,spectrum.rows()/2,-1));
+  }
+}
@@ -0,0 +1,121 @@
+/* This file is part of Into.
+ * Copyright (C) Intopii 2013.
+ * All rights reserved.
+ *
+ * Licensees holding a commercial Into license may use this file in
+ * accordance with the commercial license agreement. Please see
+ * LICENSE.commercial for commercial licensing terms.
+ *
+ * Alternatively, this file may be used under the terms of the GNU
+ * Affero General Public License version 3 as published by the Free
+ * Software Foundation. In addition, Intopii gives you special rights
+ * to use Into as a part of open source software projects. Please
+ * refer to LICENSE.AGPL3 for details.
+ */
+
+#ifndef _PIITEXTURESTATISTICS_H
+#define _PIITEXTURESTATISTICS_H
+
+#include <PiiMatrix.h>
+#include <PiiIntegralImage.h>
+#include <PiiFft.h>
+#include <complex>
+#include "PiiTextureGlobal.h"
+
+/**
+ * Low-level texture statistics shared by the texture operations.
+ * Gradients, structure tensors, local moments and spectra are needed
+ * by many texture descriptors. The functions in this namespace
+ * calculate them in one place so that the results can be computed
+ * once per image and passed to all consumers (see
+ * PiiTextureStatisticsOperation).
+ *
+ * ~~~(c++)
+ * PiiMatrix<float> matGradientX, matGradientY;
+ * PiiTexture::gradients(image, matGradientX, matGradientY);
+ * PiiMatrix<float> matTensor(PiiTexture::structureTensor(matGradientX, matGradientY));
+ * ~~~
+ */
+namespace PiiTexture
+{
+  /**
+   * Calculates the horizontal and vertical gradients of *image* with
+   * 3-by-3 masks whose diagonal weights are \(1/\sqrt{2}\):
+   *
+   * ~~~
+   * -0.71 0 0.71     0.71  1  0.71
+   * -1    0 1        0     0  0
+   * -0.71 0 0.71    -0.71 -1 -0.71
+   * ~~~
+   *
+   * Borders are not extended, and the gradient images are thus two
+   * rows and two columns smaller than the input. Both masks are
+   * applied in a single pass over the image. If the input is smaller
+   * than 3-by-3, the gradient images will be empty.
+   *
+   * @param image the input image
+   *
+   * @param gradientX output value. Horizontal gradient (positive
+   * when the intensity increases to the right).
+   *
+   * @param gradientY output value. Vertical gradient (positive when
+   * the intensity increases upwards).
+   */
+  template <class T> void gradients(const PiiMatrix<T>& image,
+                                    PiiMatrix<float>& gradientX,
+                                    PiiMatrix<float>& gradientY);
+
+  /**
+   * Returns the averaged structure tensor of a gradient field as a
+   * 1-by-3 matrix that contains the mean values of \(g_x^2\),
+   * \(g_x g_y\) and \(g_y^2\) (in this order). The eigenvectors of
+   * the tensor give the dominant orientation and its coherence. If
+   * the gradient images are empty, all elements will be zero.
+   */
+  PII_TEXTURE_EXPORT PiiMatrix<float> structureTensor(const PiiMatrix<float>& gradientX,
+                                                      const PiiMatrix<float>& gradientY);
+
+  /**
+   * Calculates the variance of pixel values in a
+   * (2*radius+1)-by-(2*radius+1) window centered at each pixel. The
+   * window is not moved over the borders, and the result is thus
+   * 2*radius rows and columns smaller than the original image.
+   *
+   * @param integral an integral image that contains the square sums
+   * of pixel values.
+   *
+   * @param radius the radius of the neighborhood.
+   */
+  template <class T> PiiMatrix<float> localVariances(const PiiImage::IntegralImage<T>& integral, int radius);
+
+  /**
+   * Calculates the Fourier transform of *image*. The mean of the
+   * image is removed before the transformation to reduce aperture
+   * effect, which prevents the large zero-frequency component from
+   * degrading the accuracy of the others. The zero-frequency
+   * component of the returned spectrum is then set to *mean* times
+   * the number of pixels. The result is thus the transform of the
+   * original image, and the mean can be retrieved as
+   * `spectrum(0,0).real() / (rows*columns)`.
+   *
+   * @param fft the transformer
+   *
+   * @param image the input image.
+   *
+   * @param mean the mean of pixel values in *image*.
+   */
+  PII_TEXTURE_EXPORT PiiMatrix<std::complex<float> > spectrum(const PiiFft<float>& fft,
+                                                              const PiiMatrix<float>& image,
+                                                              float mean);
+
+  /**
+   * Returns the magnitude of the upper half of *spectrum*. The
+   * spectrum of a real signal is symmetric, and the upper half
+   * contains all information.
+   */
+  PII_TEXTURE_EXPORT PiiMatrix<float> halfMagnitude(const PiiMatrix<std::complex<float> >& spectrum);
+}
+
+#include "PiiTextureStatistics-templates.h"
+
+#endif //_PIITEXTURESTATISTICS_H
@@ -17,6 +17,7 @@
 #include "PiiContrastOperation.h"
 #include <PiiYdinTypes.h>
 #include <PiiMath.h>
+#include <PiiTextureStatistics.h>
 
 PiiContrastOperation::Data::Data() :
   type(MaxDiff),
@@ -54,7 +55,7 @@ template <class T> void PiiContrastOperation::contrast(const PiiVariant& obj)
 {
   PII_D;
   const PiiMatrix<T> image = obj.valueAs<PiiMatrix<T> >();
-  int margin = d->iRadius, doubleMargin = margin << 1, windowSize = doubleMargin+1;
+  int margin = d->iRadius, doubleMargin = margin << 1;
 
   if (image.rows() <= doubleMargin || image.columns() <= doubleMargin)
     PII_THROW(PiiExecutionException, tr("Input image is too small"));
@@ -91,15 +92,9 @@ template <class T> void PiiContrastOperation::contrast(const PiiVariant& obj)
       break;
     case LocalVar:
       {
-        PiiMatrix<float> matResult(PiiMatrix<float>::uninitialized(image.rows()-doubleMargin,
-                                                                   image.columns()-doubleMargin));
-        for (int r=matResult.rows(); r--; )
-          {
-            float *resultRow = matResult.row(r);
-            for (int c=matResult.columns(); c--; )
-              resultRow[c] = Pii::var<float,PiiMatrix<T> >(image(r,c, windowSize, windowSize));
-          }
-        d->pImageOutput->emitObject(matResult);
+        // The integral images make the cost independent of radius.
+        d->pImageOutput->emitObject(PiiTexture::localVariances(PiiImage::IntegralImage<T>(image, true),
+                                                               d->iRadius));
       }
       break;
     }
@@ -15,25 +15,16 @@
 
 #include "PiiOrientationEstimator.h"
 #include <PiiYdinTypes.h>
-#include <PiiImage.h>
-
-PiiMatrix<float> PiiOrientationEstimator::_gradientFilterX(3, 3,
-                                                           -M_SQRT1_2, 0.0, M_SQRT1_2,
-                                                           -1.0      , 0.0, 1.0,
-                                                           -M_SQRT1_2, 0.0, M_SQRT1_2);
-
-PiiMatrix<float> PiiOrientationEstimator::_gradientFilterY(3, 3,
-                                                           M_SQRT1_2 , 1.0 , M_SQRT1_2,
-                                                           0.0       , 0.0 , 0.0,
-                                                           -M_SQRT1_2, -1.0, -M_SQRT1_2);
-
-
+#include <PiiTextureStatistics.h>
+#include <PiiMathFunctional.h>
 
 PiiOrientationEstimator::Data::Data() :
   iAngles(180),
   estimationType(UnidirectionalGradient),
   bRotateHistogram(false),
-  bNormalized(true)
+  bNormalized(true),
+  bGradientsConnected(false),
+  bSpectrumConnected(false)
 {
 }
 
@@ -43,6 +34,13 @@ PiiOrientationEstimator::PiiOrientationEstimator() :
   setThreadCount(1);
   PII_D;
   addSocket(d->pImageInput = new PiiInputSocket("image"));
+  addSocket(d->pGradientXInput = new PiiInputSocket("gradientx"));
+  addSocket(d->pGradientYInput = new PiiInputSocket("gradienty"));
+  addSocket(d->pSpectrumInput = new PiiInputSocket("spectrum"));
+  d->pImageInput->setOptional(true);
+  d->pGradientXInput->setOptional(true);
+  d->pGradientYInput->setOptional(true);
+  d->pSpectrumInput->setOptional(true);
   addSocket(d->pHistogramOutput = new PiiOutputSocket("histogram"));
 }
 
@@ -53,11 +51,43 @@ void PiiOrientationEstimator::check(bool reset)
 
   if (d->iAngles < 2) d->iAngles = 2;
   else if (d->iAngles > 3600) d->iAngles = 3600;
+
+  d->bGradientsConnected = d->pGradientXInput->isConnected();
+  if (d->bGradientsConnected != d->pGradientYInput->isConnected())
+    PII_THROW(PiiExecutionException, tr("Both gradient inputs must be connected."));
+  d->bSpectrumConnected = d->pSpectrumInput->isConnected();
+
+  if (!d->pImageInput->isConnected() &&
+      !(d->estimationType == Fourier ? d->bSpectrumConnected : d->bGradientsConnected))
+    PII_THROW(PiiExecutionException, tr("Either image or the statistics required by the estimation type must be connected."));
 }
 
 void PiiOrientationEstimator::process()
 {
   PII_D;
+  // Use precomputed statistics if available.
+  if (d->estimationType == Fourier)
+    {
+      if (d->bSpectrumConnected)
+        {
+          PiiVariant obj = d->pSpectrumInput->firstObject();
+          if (obj.type() != PiiYdin::FloatComplexMatrixType)
+            PII_THROW_UNKNOWN_TYPE(d->pSpectrumInput);
+          estimateFourierSpectrum(obj.valueAs<PiiMatrix<std::complex<float> > >());
+          return;
+        }
+    }
+  else if (d->bGradientsConnected)
+    {
+      const PiiMatrix<float> matGradientX(readGradient(d->pGradientXInput));
+      const PiiMatrix<float> matGradientY(readGradient(d->pGradientYInput));
+      if (matGradientY.rows() != matGradientX.rows() ||
+          matGradientY.columns() != matGradientX.columns())
+        PII_THROW_WRONG_SIZE(d->pGradientYInput, matGradientY, matGradientX.rows(), matGradientX.columns());
+      estimateGradient(matGradientX, matGradientY);
+      return;
+    }
+
   PiiVariant obj = d->pImageInput->firstObject();
 
   switch (obj.type())
@@ -70,6 +100,14 @@ void PiiOrientationEstimator::process()
 }
 
 
+PiiMatrix<float> PiiOrientationEstimator::readGradient(PiiInputSocket* input)
+{
+  PiiVariant obj = input->firstObject();
+  if (obj.type() != PiiYdin::FloatMatrixType)
+    PII_THROW_UNKNOWN_TYPE(input);
+  return obj.valueAs<PiiMatrix<float> >();
+}
+
 template <class ColorType> void PiiOrientationEstimator::colorOrientation(const PiiVariant& obj)
 {
   const PiiMatrix<ColorType> img = obj.valueAs<PiiMatrix<ColorType> >();
@@ -103,15 +141,19 @@ template <class T> void PiiOrientationEstimator::estimateFourier(const PiiMatrix
   estimateFourierFloat(floatImage);
 }
 
-void PiiOrientationEstimator::estimateFourierFloat(PiiMatrix<float>& img)
+void PiiOrientationEstimator::estimateFourierFloat(const PiiMatrix<float>& img)
+{
+  PII_D;
+  // The mean is removed inside spectrum() to reduce aperture effect.
+  estimateFourierSpectrum(PiiTexture::spectrum(d->fft, img, Pii::mean<float>(img)));
+}
+
+void PiiOrientationEstimator::estimateFourierSpectrum(const PiiMatrix<std::complex<float> >& transformed)
 {
   PII_D;
-  // Reduce aperture effect
-  img -= Pii::mean<float>(img);
-  PiiMatrix<std::complex<float> > transformed(d->fft.forwardFft(img));
   // Power spectrum is symmetric for real signals. We thus take only
-  // the upper half.
-  PiiMatrix<float> powerSpectrum(Pii::abs(transformed(0,0,transformed.rows()/2,-1)));
+  // the upper half. The zero frequency is not used.
+  PiiMatrix<float> powerSpectrum(PiiTexture::halfMagnitude(transformed));
 
   int halfCols = powerSpectrum.columns() / 2;
   float scale = float(d->iAngles) / M_PI;
@@ -170,8 +212,8 @@ void PiiOrientationEstimator::estimateFourierFloat(PiiMatrix<float>& img)
 template <class T> void PiiOrientationEstimator::estimateGradient(const PiiMatrix<T>& img)
 {
   // Estimate gradient with a custom gradient mask
-  PiiMatrix<float> gradientX = PiiImage::filter<float>(img, _gradientFilterX, Pii::ExtendNot);
-  PiiMatrix<float> gradientY = PiiImage::filter<float>(img, _gradientFilterY, Pii::ExtendNot);
+  PiiMatrix<float> gradientX, gradientY;
+  PiiTexture::gradients(img, gradientX, gradientY);
 
   estimateGradient(gradientX, gradientY);
 }
@@ -28,7 +28,23 @@
  * Inputs
  * ------
  *
- * @in image - input image. Any gray level or color image.
+ * @in image - input image. Any gray level or color image. Optional
+ * if the statistics needed by the selected [estimationType] are
+ * provided through the other inputs.
+ *
+ * @in gradientx - precomputed horizontal gradient (optional). If
+ * both gradient inputs are connected, the gradient-based estimators
+ * use them instead of calculating the gradient from `image`. Use
+ * PiiTextureStatisticsOperation to share the gradient between many
+ * operations. (PiiMatrix<float>)
+ *
+ * @in gradienty - precomputed vertical gradient (optional). Must be
+ * of the same size as `gradientx`. (PiiMatrix<float>)
+ *
+ * @in spectrum - precomputed Fourier transform of the image
+ * (optional). If connected, the `Fourier` estimator uses it instead
+ * of transforming `image`. See PiiTexture::spectrum().
+ * (PiiMatrix<std::complex<float> >)
  *
  * Outputs
  * -------
@@ -127,7 +143,9 @@ private:
   // Non-template implementations to reduce code bloat
   void estimateGradient(const PiiMatrix<float>& gradientX,
                         const PiiMatrix<float>& gradientY);
-  void estimateFourierFloat(PiiMatrix<float>& img);
+  void estimateFourierFloat(const PiiMatrix<float>& img);
+  void estimateFourierSpectrum(const PiiMatrix<std::complex<float> >& transformed);
+  PiiMatrix<float> readGradient(PiiInputSocket* input);
 
   // Rotate histogram if needed and emit it
   void emitHistogram(PiiMatrix<float>& histogram);
@@ -139,18 +157,20 @@ private:
     Data();
 
     PiiInputSocket* pImageInput;
+    PiiInputSocket* pGradientXInput;
+    PiiInputSocket* pGradientYInput;
+    PiiInputSocket* pSpectrumInput;
     PiiOutputSocket* pHistogramOutput;
 
     int iAngles;
     EstimationType estimationType;
     bool bRotateHistogram;
     bool bNormalized;
+    bool bGradientsConnected, bSpectrumConnected;
 
     PiiFft<float> fft;
   };
   PII_D_FUNC;
-
-  static PiiMatrix<float> _gradientFilterX, _gradientFilterY;
 };
 
 
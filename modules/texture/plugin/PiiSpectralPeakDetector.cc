@@ -18,11 +18,13 @@
 #include <PiiYdinTypes.h>
 #include <PiiMatrixUtil.h>
 #include <PiiMathDefs.h>
+#include <PiiTextureStatistics.h>
 //#include <iostream>
 
 PiiSpectralPeakDetector::Data::Data() :
   dPeakThreshold(0.4),
   bCompositionConnected(false),
+  bSpectrumConnected(false),
   dMinWaveLength(0),
   dMaxWaveLength(INFINITY)
 {
@@ -33,6 +35,9 @@ PiiSpectralPeakDetector::PiiSpectralPeakDetector() :
 {
   setThreadCount(1);
   addSocket(new PiiInputSocket("image"));
+  addSocket(new PiiInputSocket("spectrum"));
+  inputAt(0)->setOptional(true);
+  inputAt(1)->setOptional(true);
   addSocket(new PiiOutputSocket("peaks"));
   addSocket(new PiiOutputSocket("composition"));
 }
@@ -46,11 +51,28 @@ void PiiSpectralPeakDetector::check(bool reset)
     PII_THROW(PiiExecutionException, tr("Peak threshold must be greater than zero."));
 
   d->bCompositionConnected = outputAt(1)->isConnected();
+  d->bSpectrumConnected = inputAt(1)->isConnected();
+  if (!d->bSpectrumConnected && !inputAt(0)->isConnected())
+    PII_THROW(PiiExecutionException, tr("Either image or spectrum must be connected."));
 }
 
 void PiiSpectralPeakDetector::process()
 {
-  PiiVariant obj = readInput();
+  PII_D;
+  if (d->bSpectrumConnected)
+    {
+      PiiVariant obj = inputAt(1)->firstObject();
+      if (obj.type() != PiiYdin::FloatComplexMatrixType)
+        PII_THROW_UNKNOWN_TYPE(inputAt(1));
+      const PiiMatrix<std::complex<float> > matTransformed(obj.valueAs<PiiMatrix<std::complex<float> > >());
+      if (matTransformed.isEmpty())
+        PII_THROW(PiiExecutionException, tr("Input spectrum is empty."));
+      // The zero frequency holds the sum of pixel values.
+      findPeaks(matTransformed, matTransformed(0,0).real() / (matTransformed.rows() * matTransformed.columns()));
+      return;
+    }
+
+  PiiVariant obj = inputAt(0)->firstObject();
 
   switch (obj.type())
     {
@@ -113,20 +135,23 @@ void PiiSpectralPeakDetector::markPeak(PiiMatrix<float>& powerSpectrum,
 template <class T> void PiiSpectralPeakDetector::findPeaks(const PiiVariant& obj)
 {
   PII_D;
-  PiiMatrix<float> img(obj.valueAs<PiiMatrix<T> >());
+  const PiiMatrix<float> img(obj.valueAs<PiiMatrix<T> >());
+  const float fMean = Pii::mean<float>(img);
+  // The mean is removed inside spectrum() to reduce aperture effect.
+  findPeaks(PiiTexture::spectrum(d->fft, img, fMean), fMean);
+}
 
-  float fMean = Pii::mean<float>(img);
-  // Reduce aperture effect
-  img -= fMean;
-  PiiMatrix<std::complex<float> > matTransformed(d->fft.forwardFft(img));
+void PiiSpectralPeakDetector::findPeaks(const PiiMatrix<std::complex<float> >& matTransformed, float fMean)
+{
+  PII_D;
   // Power spectrum is symmetric for real signals. We thus take only
   // the upper half. In fact, this is the square root of the real
   // power spectrum, but it contains essentially the same information.
-  PiiMatrix<float> matPowerSpectrum(Pii::abs(matTransformed(0,0,matTransformed.rows()/2,-1)));
+  PiiMatrix<float> matPowerSpectrum(PiiTexture::halfMagnitude(matTransformed));
 
   int iRows = matPowerSpectrum.rows(), iCols = matPowerSpectrum.columns(), iHalfCols = iCols / 2;
-  double dAspectRatio = double(img.columns()) / img.rows();
-  double dThreshold = d->dPeakThreshold * img.columns() * img.rows();
+  double dAspectRatio = double(matTransformed.columns()) / matTransformed.rows();
+  double dThreshold = d->dPeakThreshold * matTransformed.columns() * matTransformed.rows();
   const float* pSpectrumRow = 0;
 
   PiiMatrix<double> matPeaks(0,5);
@@ -29,7 +29,15 @@
  * Inputs
  * ------
  *
- * @in image - Any gray-level image.
+ * @in image - Any gray-level image. Optional if `spectrum` is
+ * connected.
+ *
+ * @in spectrum - precomputed Fourier transform of the image
+ * (optional). If connected, the transform is not recalculated. The
+ * zero-frequency component must contain the sum of pixel values, as
+ * with PiiTexture::spectrum(). Use PiiTextureStatisticsOperation to
+ * share the spectrum between many operations.
+ * (PiiMatrix<std::complex<float> >)
  *
  * Outputs
  * -------
@@ -96,6 +104,7 @@ protected:
 
 private:
   template <class T> void findPeaks(const PiiVariant& obj);
+  void findPeaks(const PiiMatrix<std::complex<float> >& transformed, float mean);
   void markPeak(PiiMatrix<float>& powerSpectrum,
                 int row, int column, double aspectRatio,
                 PiiMatrix<double>& peaks);
@@ -108,6 +117,7 @@ private:
     PiiFft<float> fft;
     double dPeakThreshold;
     bool bCompositionConnected;
+    bool bSpectrumConnected;
     double dMinWaveLength;
     double dMaxWaveLength;
   };
@@ -19,6 +19,7 @@
 #include "PiiWaveletTextureOperation.h"
 #include "PiiOrientationEstimator.h"
 #include "PiiSpectralPeakDetector.h"
+#include "PiiTextureStatisticsOperation.h"
 
 PII_IMPLEMENT_PLUGIN(PiiTexturePlugin);
 
@@ -27,3 +28,4 @@ PII_REGISTER_OPERATION(PiiContrastOperation);
 PII_REGISTER_OPERATION(PiiWaveletTextureOperation);
 PII_REGISTER_OPERATION(PiiOrientationEstimator);
 PII_REGISTER_OPERATION(PiiSpectralPeakDetector);
+PII_REGISTER_OPERATION(PiiTextureStatisticsOperation);
@@ -0,0 +1,139 @@
+/* This file is part of Into.
+ * Copyright (C) Intopii 2013.
+ * All rights reserved.
+ *
+ * Licensees holding a commercial Into license may use this file in
+ * accordance with the commercial license agreement. Please see
+ * LICENSE.commercial for commercial licensing terms.
+ *
+ * Alternatively, this file may be used under the terms of the GNU
+ * Affero General Public License version 3 as published by the Free
+ * Software Foundation. In addition, Intopii gives you special rights
+ * to use Into as a part of open source software projects. Please
+ * refer to LICENSE.AGPL3 for details.
+ */
+
+#include "PiiTextureStatisticsOperation.h"
+#include <PiiYdinTypes.h>
+#include <PiiTextureStatistics.h>
+
+PiiTextureStatisticsOperation::Data::Data() :
+  iRadius(1),
+  bGradientsNeeded(false),
+  bMomentsNeeded(false)
+{
+  for (int i=0; i<OutputCount; ++i)
+    abConnected[i] = false;
+}
+
+PiiTextureStatisticsOperation::PiiTextureStatisticsOperation() :
+  PiiDefaultOperation(new Data)
+{
+  setThreadCount(1);
+  PII_D;
+  addSocket(d->pImageInput = new PiiInputSocket("image"));
+
+  addSocket(new PiiOutputSocket("gradientx"));
+  addSocket(new PiiOutputSocket("gradienty"));
+  addSocket(new PiiOutputSocket("tensor"));
+  addSocket(new PiiOutputSocket("spectrum"));
+  addSocket(new PiiOutputSocket("mean"));
+  addSocket(new PiiOutputSocket("variance"));
+  addSocket(new PiiOutputSocket("localvariance"));
+}
+
+void PiiTextureStatisticsOperation::check(bool reset)
+{
+  PII_D;
+  PiiDefaultOperation::check(reset);
+
+  if (d->iRadius < 1)
+    PII_THROW(PiiExecutionException, tr("Radius must be at least one."));
+
+  for (int i=0; i<OutputCount; ++i)
+    d->abConnected[i] = outputAt(i)->isConnected();
+
+  d->bGradientsNeeded = d->abConnected[GradientXOutput] ||
+    d->abConnected[GradientYOutput] ||
+    d->abConnected[TensorOutput];
+  // The spectrum needs the mean.
+  d->bMomentsNeeded = d->abConnected[SpectrumOutput] ||
+    d->abConnected[MeanOutput] ||
+    d->abConnected[VarianceOutput];
+}
+
+void PiiTextureStatisticsOperation::process()
+{
+  PII_D;
+  PiiVariant obj = d->pImageInput->firstObject();
+
+  switch (obj.type())
+    {
+      PII_GRAY_IMAGE_CASES(grayStatistics, obj);
+      PII_COLOR_IMAGE_CASES(colorStatistics, obj);
+    default:
+      PII_THROW_UNKNOWN_TYPE(d->pImageInput);
+    }
+}
+
+template <class ColorType> void PiiTextureStatisticsOperation::colorStatistics(const PiiVariant& obj)
+{
+  const PiiMatrix<ColorType> img = obj.valueAs<PiiMatrix<ColorType> >();
+  calculateStatistics(PiiMatrix<typename ColorType::Type>(img));
+}
+
+template <class T> void PiiTextureStatisticsOperation::grayStatistics(const PiiVariant& obj)
+{
+  calculateStatistics(obj.valueAs<PiiMatrix<T> >());
+}
+
+template <class T> void PiiTextureStatisticsOperation::calculateStatistics(const PiiMatrix<T>& image)
+{
+  PII_D;
+  if (d->bGradientsNeeded)
+    {
+      PiiMatrix<float> matGradientX, matGradientY;
+      PiiTexture::gradients(image, matGradientX, matGradientY);
+      if (d->abConnected[TensorOutput])
+        outputAt(TensorOutput)->emitObject(PiiTexture::structureTensor(matGradientX, matGradientY));
+      if (d->abConnected[GradientXOutput])
+        outputAt(GradientXOutput)->emitObject(matGradientX);
+      if (d->abConnected[GradientYOutput])
+        outputAt(GradientYOutput)->emitObject(matGradientY);
+    }
+
+  if (d->bMomentsNeeded)
+    {
+      if (image.isEmpty())
+        PII_THROW(PiiExecutionException, tr("Input image is empty."));
+      double dSum = 0, dSquareSum = 0;
+      for (int r=0; r<image.rows(); ++r)
+        {
+          const T* pRow = image[r];
+          for (int c=0; c<image.columns(); ++c)
+            {
+              const double dValue = double(pRow[c]);
+              dSum += dValue;
+              dSquareSum += dValue * dValue;
+            }
+        }
+      const double dCount = double(image.rows()) * image.columns(), dMean = dSum / dCount;
+      if (d->abConnected[MeanOutput])
+        outputAt(MeanOutput)->emitObject(dMean);
+      if (d->abConnected[VarianceOutput])
+        outputAt(VarianceOutput)->emitObject(qMax(0.0, dSquareSum / dCount - dMean * dMean));
+      if (d->abConnected[SpectrumOutput])
+        outputAt(SpectrumOutput)->emitObject(PiiTexture::spectrum(d->fft, PiiMatrix<float>(image), float(dMean)));
+    }
+
+  if (d->abConnected[LocalVarianceOutput])
+    {
+      if (image.rows() <= 2*d->iRadius || image.columns() <= 2*d->iRadius)
+        PII_THROW(PiiExecutionException, tr("Input image is too small"));
+      outputAt(LocalVarianceOutput)->emitObject(PiiTexture::localVariances(PiiImage::IntegralImage<T>(image, true),
+                                                                          d->iRadius));
+    }
+}
+
+int PiiTextureStatisticsOperation::radius() const { return _d()->iRadius; }
+void PiiTextureStatisticsOperation::setRadius(int radius) { _d()->iRadius = radius; }
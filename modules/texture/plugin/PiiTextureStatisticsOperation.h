@@ -0,0 +1,125 @@
+/* This file is part of Into.
+ * Copyright (C) Intopii 2013.
+ * All rights reserved.
+ *
+ * Licensees holding a commercial Into license may use this file in
+ * accordance with the commercial license agreement. Please see
+ * LICENSE.commercial for commercial licensing terms.
+ *
+ * Alternatively, this file may be used under the terms of the GNU
+ * Affero General Public License version 3 as published by the Free
+ * Software Foundation. In addition, Intopii gives you special rights
+ * to use Into as a part of open source software projects. Please
+ * refer to LICENSE.AGPL3 for details.
+ */
+
+#ifndef _PIITEXTURESTATISTICSOPERATION_H
+#define _PIITEXTURESTATISTICSOPERATION_H
+
+#include <PiiDefaultOperation.h>
+#include <PiiMatrix.h>
+#include <PiiFft.h>
+
+/**
+ * An operation that calculates low-level statistics shared by many
+ * texture descriptors. Gradients, structure tensors, moments and
+ * spectra are calculated once for each incoming image and can be
+ * passed to any number of consumers, such as
+ * PiiOrientationEstimator and PiiSpectralPeakDetector. Only the
+ * statistics needed by the connected outputs are calculated.
+ *
+ * ~~~(c++)
+ * PiiOperation* pStatistics = engine.createOperation("PiiTextureStatisticsOperation");
+ * PiiOperation* pOrientation = engine.createOperation("PiiOrientationEstimator");
+ * PiiOperation* pPeaks = engine.createOperation("PiiSpectralPeakDetector");
+ * pStatistics->connectOutput("gradientx", pOrientation, "gradientx");
+ * pStatistics->connectOutput("gradienty", pOrientation, "gradienty");
+ * pStatistics->connectOutput("spectrum", pPeaks, "spectrum");
+ * ~~~
+ *
+ * Inputs
+ * ------
+ *
+ * @in image - input image. Any gray level or color image. Color
+ * images are converted to gray levels.
+ *
+ * Outputs
+ * -------
+ *
+ * @out gradientx - horizontal gradient. Two rows and columns smaller
+ * than the input image. See PiiTexture::gradients().
+ * (PiiMatrix<float>)
+ *
+ * @out gradienty - vertical gradient. (PiiMatrix<float>)
+ *
+ * @out tensor - the mean structure tensor as a 1-by-3 matrix. See
+ * PiiTexture::structureTensor(). (PiiMatrix<float>)
+ *
+ * @out spectrum - the Fourier transform of the image. See
+ * PiiTexture::spectrum(). (PiiMatrix<std::complex<float> >)
+ *
+ * @out mean - the mean gray level. (double)
+ *
+ * @out variance - the variance of gray levels. (double)
+ *
+ * @out localvariance - the variance of gray levels in the
+ * neighborhood of each pixel. The size of the neighborhood is
+ * controlled by [radius]. The same as the `LocalVar` output of
+ * PiiContrastOperation. (PiiMatrix<float>)
+ */
+class PiiTextureStatisticsOperation : public PiiDefaultOperation
+{
+  Q_OBJECT
+
+  /**
+   * The radius of the neighborhood used for the `localvariance`
+   * output. The default value is 1.
+   */
+  Q_PROPERTY(int radius READ radius WRITE setRadius);
+
+  PII_OPERATION_SERIALIZATION_FUNCTION
+public:
+  PiiTextureStatisticsOperation();
+
+  void check(bool reset);
+
+  int radius() const;
+  void setRadius(int radius);
+
+protected:
+  void process();
+
+private:
+  template <class ColorType> void colorStatistics(const PiiVariant& obj);
+  template <class T> void grayStatistics(const PiiVariant& obj);
+  template <class T> void calculateStatistics(const PiiMatrix<T>& image);
+
+  enum Output
+  {
+    GradientXOutput,
+    GradientYOutput,
+    TensorOutput,
+    SpectrumOutput,
+    MeanOutput,
+    VarianceOutput,
+    LocalVarianceOutput,
+    OutputCount
+  };
+
+  /// @internal
+  class Data : public PiiDefaultOperation::Data
+  {
+  public:
+    Data();
+
+    PiiInputSocket* pImageInput;
+    int iRadius;
+    bool bGradientsNeeded, bMomentsNeeded;
+    bool abConnected[OutputCount];
+
+    PiiFft<float> fft;
+  };
+  PII_D_FUNC;
+};
+
+#endif //_PIITEXTURESTATISTICSOPERATION_H
@@ -22,7 +22,8 @@ PiiWaveletTextureOperation::Data::Data() :
   iFeaturesPerLevel(3),
   iNorm(1),
   waveletFamily(PiiDsp::Daubechies),
-  iWaveletIndex(2)
+  iWaveletIndex(2),
+  bPeriodicExtension(false)
 {
 }
 
@@ -103,40 +104,76 @@ template <class T> void PiiWaveletTextureOperation::waveletNorm(const PiiMatrix<
 {
   PII_D;
   PiiMatrix<float> result(1, d->iLevels * d->iFeaturesPerLevel + 1);
-  // Perform a N-level wavelet decomposition
-  QList<PiiMatrix<T> > decomposition;
-  decomposition << mat;
   int index = 0;
-  for (int i=d->iLevels; i--; )
+  PiiMatrix<T> approximation;
+  if (d->bPeriodicExtension)
     {
-      decomposition = PiiDsp::dwt(decomposition[0], d->waveletFamily, d->iWaveletIndex);
-      switch (d->iFeaturesPerLevel)
+      // All levels are stored in a single matrix.
+      PiiMatrix<T> matTransform(mat);
+      const int iLevels = PiiDsp::dwtInPlace(matTransform, d->iLevels, d->waveletFamily, d->iWaveletIndex);
+      const PiiMatrix<T>& matBands = matTransform;
+      int iRows = mat.rows(), iColumns = mat.columns();
+      for (int i=0; i<iLevels; ++i)
         {
-        case 1: // rotation invariant
-          result(0,index++) = Pii::norm(PiiMatrix<T>(decomposition[1] + decomposition[2]), d->iNorm);
-          break;
-        case 4: // all decomposition results taken
-          result(0,index++) = Pii::norm(decomposition[0], d->iNorm);
-        case 3: // all but approximation
-          result(0,index++) = Pii::norm(decomposition[3], d->iNorm);
-        case 2: // only horizontal and vertical details
-          result(0,index++) = Pii::norm(decomposition[1], d->iNorm);
-          result(0,index++) = Pii::norm(decomposition[2], d->iNorm);
-          break;
+          iRows >>= 1;
+          iColumns >>= 1;
+          storeFeatures(result, index,
+                        matBands(0, 0, iRows, iColumns),
+                        matBands(0, iColumns, iRows, iColumns),
+                        matBands(iRows, 0, iRows, iColumns),
+                        matBands(iRows, iColumns, iRows, iColumns));
         }
+      approximation = matBands(0, 0, iRows, iColumns);
+    }
+  else
+    {
+      // Perform a N-level wavelet decomposition
+      QList<PiiMatrix<T> > decomposition;
+      decomposition << mat;
+      for (int i=d->iLevels; i--; )
+        {
+          decomposition = PiiDsp::dwt(decomposition[0], d->waveletFamily, d->iWaveletIndex);
+          storeFeatures(result, index, decomposition[0], decomposition[1], decomposition[2], decomposition[3]);
+        }
+      approximation = decomposition[0];
     }
 
   // Last level approximation is always included (except for the case
   // where it already was)
   if (d->iFeaturesPerLevel != 4)
-    result(0,index) = Pii::norm(decomposition[0], d->iNorm);
+    result(0,result.columns()-1) = Pii::norm(approximation, d->iNorm);
 
   d->pFeatureOutput->emitObject(result);
 }
 
+template <class T> void PiiWaveletTextureOperation::storeFeatures(PiiMatrix<float>& result, int& index,
+                                                                  const PiiMatrix<T>& approximation,
+                                                                  const PiiMatrix<T>& vertical,
+                                                                  const PiiMatrix<T>& horizontal,
+                                                                  const PiiMatrix<T>& diagonal)
+{
+  PII_D;
+  switch (d->iFeaturesPerLevel)
+    {
+    case 1: // rotation invariant
+      result(0,index++) = Pii::norm(PiiMatrix<T>(vertical + horizontal), d->iNorm);
+      break;
+    case 4: // all decomposition results taken
+      result(0,index++) = Pii::norm(approximation, d->iNorm);
+    case 3: // all but approximation
+      result(0,index++) = Pii::norm(diagonal, d->iNorm);
+    case 2: // only horizontal and vertical details
+      result(0,index++) = Pii::norm(vertical, d->iNorm);
+      result(0,index++) = Pii::norm(horizontal, d->iNorm);
+      break;
+    }
+}
+
 int PiiWaveletTextureOperation::levels() const { return _d()->iLevels; }
 void PiiWaveletTextureOperation::setLevels(int levels) { _d()->iLevels = levels; }
 int PiiWaveletTextureOperation::featuresPerLevel() const { return _d()->iFeaturesPerLevel; }
 void PiiWaveletTextureOperation::setFeaturesPerLevel(int features) { _d()->iFeaturesPerLevel = features; }
 int PiiWaveletTextureOperation::norm() const { return _d()->iNorm; }
 void PiiWaveletTextureOperation::setNorm(int norm) { _d()->iNorm = norm; }
+bool PiiWaveletTextureOperation::periodicExtension() const { return _d()->bPeriodicExtension; }
+void PiiWaveletTextureOperation::setPeriodicExtension(bool periodicExtension) { _d()->bPeriodicExtension = periodicExtension; }
@@ -79,6 +79,15 @@ class PiiWaveletTextureOperation : public PiiDefaultOperation
    * "Daubechies1" ... "Daubechies10". The default is "Daubechies2".
    */
   Q_PROPERTY(QString wavelet READ wavelet WRITE setWavelet);
+  /**
+   * If `true`, the image is extended periodically, and the
+   * decomposition is calculated in place with
+   * PiiDsp::dwtInPlace(). This is considerably faster than the
+   * default zero-padded transform, but the features are not
+   * comparable to those calculated with zero padding. The default is
+   * `false`.
+   */
+  Q_PROPERTY(bool periodicExtension READ periodicExtension WRITE setPeriodicExtension);
 
   PII_OPERATION_SERIALIZATION_FUNCTION
 
@@ -97,6 +106,9 @@ public:
   int norm() const;
   void setNorm(int norm);
 
+  bool periodicExtension() const;
+  void setPeriodicExtension(bool periodicExtension);
+
 protected:
   void process();
 
@@ -104,6 +116,11 @@ private:
   template <class T> void waveletNormFloat(const PiiVariant& obj);
   template <class T> void waveletNormInt(const PiiVariant& obj);
   template <class T> void waveletNorm(const PiiMatrix<T>& mat);
+  template <class T> void storeFeatures(PiiMatrix<float>& result, int& index,
+                                        const PiiMatrix<T>& approximation,
+                                        const PiiMatrix<T>& vertical,
+                                        const PiiMatrix<T>& horizontal,
+                                        const PiiMatrix<T>& diagonal);
 
   /// @internal
   class Data : public PiiDefaultOperation::Data
@@ -113,6 +130,7 @@ private:
     int iLevels, iFeaturesPerLevel, iNorm;
     PiiDsp::WaveletFamily waveletFamily;
     int iWaveletIndex;
+    bool bPeriodicExtension;
 
     PiiInputSocket *pImageInput;
     PiiOutputSocket *pFeatureOutput;
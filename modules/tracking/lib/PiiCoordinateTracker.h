@@ -19,6 +19,11 @@
 #include "PiiMultiHypothesisTracker.h"
 #include "PiiCoordinateTrackerNode.h"
 #include <PiiMatrix.h>
+#include <QHash>
+#include <QVector>
+#include <QtAlgorithms>
+#include <cmath>
+#include <climits>
 
 
 /**
@@ -36,6 +41,17 @@
  * between a new measurement and the prediction works as a measure of
  * goodness.
  *
+ * To avoid comparing every measurement to every trajectory, the
+ * tracker stores the measurements into a uniform grid whose cell
+ * size equals the square root of the larger of the two thresholds
+ * ([setInitialThreshold()], [setPredictionThreshold()]). A trajectory
+ * is compared only to the measurements in the grid cells that
+ * overlap its gate, a hypersphere centered at the prediction (or at
+ * the last measurement if there is no prediction yet). With
+ * uniformly distributed objects, the cost of a time step is thus
+ * proportional to the number of trajectories, not to the number of
+ * trajectory-measurement pairs.
+ *
  */
 template <class T, int D> class PiiCoordinateTracker :
   public PiiMultiHypothesisTracker<PiiVector<T,D>, PiiCoordinateTrackerNode<T,D>*>
@@ -130,6 +146,46 @@ public:
    */
   double initialThreshold() const { return _dInitialThreshold; }
 
+  /**
+   * Enable or disable spatial gating of measurements. If gating is
+   * enabled, measurements outside of a trajectory's gate
+   * ([gatingThreshold()]) will not be evaluated against the
+   * trajectory at all. Disable gating if you override
+   * [measureFit(TrajectoryType**,const MeasurementType&,int)] so that
+   * it may give a non-zero fitness to distant measurements and don't
+   * want to override [gatingThreshold()]. The default is `true`.
+   */
+  void setGatingEnabled(bool gatingEnabled) { _bGatingEnabled = gatingEnabled; }
+  /**
+   * Returns `true` if spatial gating is enabled and `false`
+   * otherwise.
+   */
+  bool isGatingEnabled() const { return _bGatingEnabled; }
+
+  /**
+   * Prune the set of candidate trajectories (hypotheses) so that at
+   * most `beamWidth` trajectories end at the same node, i.e. at the
+   * same measurement at the same time instant. Of the competing
+   * trajectories, the ones with the highest
+   * [trajectory fitness](PiiCoordinateTrackerNode::trajectoryFitness())
+   * will be retained. The rest will be deleted. The order of the
+   * retained trajectories is not changed.
+   *
+   * Since each measurement can only be the end point of `beamWidth`
+   * hypotheses, the number of candidate trajectories is bounded by
+   * `beamWidth` times the number of measurements. Call this function
+   * after evaluating the trajectories. If `beamWidth` is less than
+   * one, the function does nothing.
+   *
+   * ~~~(c++)
+   * tracker.addMeasurements(points, t);
+   * for (int i=0; i<tracker.count(); ++i)
+   *   tracker[i]->setTrajectoryFitness(evaluate(tracker[i]));
+   * tracker.pruneTrajectories(3);
+   * ~~~
+   */
+  void pruneTrajectories(int beamWidth);
+
   /**
    * Sort trajectories using the trajectory type's LessThan comparison
    * functor. If the trajectory type is PiiCoordinateTrackerNode, the
@@ -176,6 +232,33 @@ protected:
    */
   double measureFit(TrajectoryType** trajectory, const MeasurementType& measurement, int t) const;
 
+  /**
+   * Selects the measurements that lie within the gate of
+   * `trajectory` using a uniform grid. If gating is disabled or the
+   * gate is so large that it covers more grid cells than there are
+   * measurements, all measurements will be selected.
+   */
+  void gateMeasurements(TrajectoryType** trajectory,
+                        const QList<MeasurementType>& measurements,
+                        int t,
+                        QVector<int>& indices) const;
+
+  /**
+   * Returns the squared radius of the gate of `trajectory`.
+   * [measureFit(TrajectoryType**,const MeasurementType&,int)] must
+   * return zero for all measurements whose squared distance to the
+   * center of the gate is larger than this value. The center is the
+   * prediction of the trajectory or, if there is no prediction, its
+   * last measurement. The default implementation returns the
+   * prediction threshold if there is a prediction and the initial
+   * threshold otherwise. Return a non-finite value to disable gating
+   * for a trajectory.
+   */
+  virtual double gatingThreshold(TrajectoryType* trajectory) const
+  {
+    return trajectory->prediction() ? _dPredictionThreshold : _dInitialThreshold;
+  }
+
   /**
    * Evaluate the likelihood that `measurement` is a starting point
    * of a new trajectory. The default implementation returns 1.0 when
@@ -232,13 +315,50 @@ protected:
   }
 
 private:
+  struct EndPointLessThan;
+
+  void indexMeasurements(const QList<MeasurementType>& measurements);
+  void clearIndex();
+  static uint cellHash(const int* cell);
+
   double _dInitialThreshold;
   double _dPredictionThreshold;
+  bool _bGatingEnabled;
+
+  // Spatial index of the measurements of the current time step.
+  // _hashCells maps a cell to the first measurement in it, and
+  // _vecNextMeasurement links the measurements that share a hash key.
+  double _dCellSize;
+  QHash<uint,int> _hashCells;
+  QVector<int> _vecNextMeasurement;
+  QVector<int> _vecCells;
+};
+
+/// @internal
+template <class T, int D> struct PiiCoordinateTracker<T,D>::EndPointLessThan
+{
+  EndPointLessThan(const QList<TrajectoryType*>& trajectories) : _trajectories(trajectories) {}
+
+  // Groups trajectories by their end node and puts the best ones
+  // first in each group.
+  bool operator() (int i1, int i2) const
+  {
+    const TrajectoryType* n1 = _trajectories[i1], *n2 = _trajectories[i2];
+    if (n1->time() != n2->time())
+      return n1->time() < n2->time();
+    for (int d=0; d<D; ++d)
+      if (n1->measurement()[d] != n2->measurement()[d])
+        return n1->measurement()[d] < n2->measurement()[d];
+    return n1->trajectoryFitness() > n2->trajectoryFitness();
+  }
 
+  const QList<TrajectoryType*>& _trajectories;
 };
 
 template <class T, int D> PiiCoordinateTracker<T,D>::PiiCoordinateTracker() :
-  _dInitialThreshold(1), _dPredictionThreshold(1)
+  _dInitialThreshold(1), _dPredictionThreshold(1),
+  _bGatingEnabled(true),
+  _dCellSize(0)
 {
 }
 
@@ -249,7 +369,9 @@ void PiiCoordinateTracker<T,D>::addMeasurements(const QList<MeasurementType>& me
   predict(t);
 
   // Run the algorithm
+  indexMeasurements(measurements);
   ParentType::addMeasurements(measurements, t);
+  clearIndex();
 }
 
 template <class T, int D>
@@ -316,6 +438,171 @@ double PiiCoordinateTracker<T,D>::measureFit(TrajectoryType** trajectory,
     return measureFit(measurement, t);
 }
 
+template <class T, int D> uint PiiCoordinateTracker<T,D>::cellHash(const int* cell)
+{
+  uint uiHash = 2166136261u;
+  for (int d=0; d<D; ++d)
+    uiHash = (uiHash ^ uint(cell[d])) * 16777619u;
+  return uiHash;
+}
+
+template <class T, int D> void PiiCoordinateTracker<T,D>::clearIndex()
+{
+  _hashCells.clear();
+  _vecNextMeasurement.clear();
+  _vecCells.clear();
+}
+
+template <class T, int D>
+void PiiCoordinateTracker<T,D>::indexMeasurements(const QList<MeasurementType>& measurements)
+{
+  clearIndex();
+  if (!_bGatingEnabled || measurements.isEmpty() || this->isEmpty())
+    return;
+
+  _dCellSize = std::sqrt(qMax(_dInitialThreshold, _dPredictionThreshold));
+  // Nothing can be connected anyway.
+  if (!(_dCellSize > 0))
+    return;
+
+  const int iCount = measurements.size();
+  _vecCells.resize(iCount * D);
+  _vecNextMeasurement.resize(iCount);
+  _hashCells.reserve(iCount);
+  for (int i=0; i<iCount; ++i)
+    {
+      int* pCell = _vecCells.data() + i*D;
+      for (int d=0; d<D; ++d)
+        {
+          double dCell = std::floor(double(measurements[i][d]) / _dCellSize);
+          // Cannot represent the cell. Fall back to linear search.
+          if (!(dCell > INT_MIN/2 && dCell < INT_MAX/2))
+            {
+              clearIndex();
+              return;
+            }
+          pCell[d] = int(dCell);
+        }
+      uint uiKey = cellHash(pCell);
+      _vecNextMeasurement[i] = _hashCells.value(uiKey, -1);
+      _hashCells[uiKey] = i;
+    }
+}
+
+template <class T, int D>
+void PiiCoordinateTracker<T,D>::gateMeasurements(TrajectoryType** trajectory,
+                                                 const QList<MeasurementType>& measurements,
+                                                 int t,
+                                                 QVector<int>& indices) const
+{
+  if (_vecCells.isEmpty())
+    {
+      ParentType::gateMeasurements(trajectory, measurements, t, indices);
+      return;
+    }
+
+  const MeasurementType& center = (*trajectory)->prediction() ?
+    *(*trajectory)->prediction() : (*trajectory)->measurement();
+  const double dThreshold = gatingThreshold(*trajectory);
+  if (dThreshold < 0)
+    return;
+  const double dRadius = std::sqrt(dThreshold);
+  const int iCount = measurements.size();
+  // Checking more cells than there are measurements is slower than
+  // a linear search. This also catches infinite radii.
+  if (!(dRadius <= _dCellSize * iCount))
+    {
+      ParentType::gateMeasurements(trajectory, measurements, t, indices);
+      return;
+    }
+
+  // Find the range of cells overlapped by the gate.
+  int aMin[D], aMax[D], aCell[D];
+  long lCells = 1;
+  for (int d=0; d<D; ++d)
+    {
+      double dMin = std::floor((double(center[d]) - dRadius) / _dCellSize),
+        dMax = std::floor((double(center[d]) + dRadius) / _dCellSize);
+      // Clamp the range so that it fits into an int. The clamped
+      // cells contain no measurements anyway.
+      aMin[d] = aCell[d] = int(qBound(double(INT_MIN/2), dMin, double(INT_MAX/2)));
+      aMax[d] = int(qBound(double(INT_MIN/2), dMax, double(INT_MAX/2)));
+      lCells *= aMax[d] - aMin[d] + 1;
+      if (lCells > iCount)
+        {
+          ParentType::gateMeasurements(trajectory, measurements, t, indices);
+          return;
+        }
+    }
+
+  // Go through all cells in the D-dimensional box
+  for (;;)
+    {
+      for (int i = _hashCells.value(cellHash(aCell), -1); i != -1; i = _vecNextMeasurement[i])
+        {
+          // Skip hash collisions
+          const int* pCell = _vecCells.constData() + i*D;
+          int d = 0;
+          while (d < D && pCell[d] == aCell[d]) ++d;
+          if (d == D)
+            indices.append(i);
+        }
+      int d = 0;
+      for (; d<D; ++d)
+        {
+          if (++aCell[d] <= aMax[d])
+            break;
+          aCell[d] = aMin[d];
+        }
+      if (d == D)
+        break;
+    }
+
+  // Retain the order in which the trajectories would be created
+  // without gating.
+  qSort(indices.begin(), indices.end(), qGreater<int>());
+}
+
+template <class T, int D> void PiiCoordinateTracker<T,D>::pruneTrajectories(int beamWidth)
+{
+  if (beamWidth < 1 || this->count() <= beamWidth)
+    return;
+
+  const int iCount = this->count();
+  QVector<int> vecOrder(iCount);
+  for (int i=0; i<iCount; ++i)
+    vecOrder[i] = i;
+  qSort(vecOrder.begin(), vecOrder.end(), EndPointLessThan(*this));
+
+  // Mark all but the beamWidth best trajectories in each group
+  QVector<bool> vecPruned(iCount, false);
+  int iRank = 0;
+  for (int i=0; i<iCount; ++i)
+    {
+      const TrajectoryType* pNode = this->at(vecOrder[i]);
+      if (i > 0)
+        {
+          const TrajectoryType* pPrevious = this->at(vecOrder[i-1]);
+          if (pNode->time() == pPrevious->time() && pNode->measurement() == pPrevious->measurement())
+            ++iRank;
+          else
+            iRank = 0;
+        }
+      vecPruned[vecOrder[i]] = iRank >= beamWidth;
+    }
+
+  QList<TrajectoryType*> lstRetained;
+  for (int i=0; i<iCount; ++i)
+    {
+      if (vecPruned[i])
+        delete this->at(i);
+      else
+        lstRetained << this->at(i);
+    }
+  this->clear();
+  this->append(lstRetained);
+}
+
 template <class T, int D> void PiiCoordinateTracker<T,D>::sortTrajectories()
 {
   qSort(this->begin(), this->end(), typename TrajectoryType::LessThan());
@@ -17,6 +17,7 @@
 #define _PIIMULTIHYPOTHESISTRACKER_H
 
 #include <QList>
+#include <QVector>
 
 /**
  * The tracking algorithm uses a greedy breadth-first search algorithm
@@ -29,7 +30,9 @@
  *
  * - Evaluate how well each of the N measurements fits into the
  * current set of M candidate trajectories (N x M evaluations).
- * ([measureFit()])
+ * ([measureFit()]) Subclasses can limit the number of evaluations
+ * by only offering the measurements that may possibly fit into a
+ * trajectory. ([gateMeasurements()])
  *
  * - Generate a new set of candidate trajectories by extending the
  * old ones with the measurements with non-zero probabilities. This
@@ -103,6 +106,39 @@ protected:
    */
   virtual double measureFit(TrajectoryType* trajectory, const MeasurementType& measurement, int t) const = 0;
 
+  /**
+   * Select the measurements that will be evaluated against
+   * `trajectory`. The tracker calls [measureFit()] only for the
+   * measurements whose indices are placed in `indices`. Measurements
+   * left out are treated as if their fitness was zero. The default
+   * implementation selects all measurements, which leads to N x M
+   * evaluations. Subclasses that know the support of their
+   * measurement model can override this function to find the
+   * candidates faster than in linear time (gating).
+   *
+   * @param trajectory the trajectory to be extended
+   *
+   * @param measurements all candidate measurements
+   *
+   * @param t the current time instant
+   *
+   * @param indices a list of measurement indices to be filled. The
+   * list is empty when this function is called. The indices should
+   * be in descending order to retain the order in which the new
+   * trajectories are created.
+   */
+  virtual void gateMeasurements(TrajectoryType* trajectory,
+                                const QList<MeasurementType>& measurements,
+                                int t,
+                                QVector<int>& indices) const
+  {
+    Q_UNUSED(trajectory);
+    Q_UNUSED(t);
+    indices.reserve(measurements.size());
+    for (int i=measurements.size(); i--; )
+      indices.append(i);
+  }
+
   /**
    * Get the current index of the trajectory.
    */
@@ -141,10 +177,14 @@ void PiiMultiHypothesisTracker<Measurement,Trajectory>::addMeasurements(const QL
   QList<TrajectoryType> oldTrajectories = *this;
   this->clear();
 
+  QVector<int> vecCandidates;
   for (_iTrajectoryIndex=oldTrajectories.size(); _iTrajectoryIndex--; )
     {
-      for (_iMeasurementIndex=measurements.size(); _iMeasurementIndex--; )
+      vecCandidates.clear();
+      gateMeasurements(&oldTrajectories[_iTrajectoryIndex], measurements, t, vecCandidates);
+      for (int i=0; i<vecCandidates.size(); ++i)
         {
+          _iMeasurementIndex = vecCandidates[i];
           // See how well this measurement would fit into the current
           // trajectory.
           double score = measureFit(&oldTrajectories[_iTrajectoryIndex], measurements[_iMeasurementIndex], t);
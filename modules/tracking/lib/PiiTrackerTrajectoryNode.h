@@ -16,6 +16,28 @@
 #ifndef _PIITRACKERTRAJECTORYNODE_H
 #define _PIITRACKERTRAJECTORYNODE_H
 
+#include <PiiSimpleMemoryManager.h>
+#include <PiiBits.h>
+#include <new>
+
+/**
+ * The number of trajectory nodes of each type that are allocated
+ * from a preallocated memory pool. If the pool is exhausted, nodes
+ * will be allocated from the heap.
+ */
+#ifndef PII_TRACKER_NODE_POOL_SIZE
+#  define PII_TRACKER_NODE_POOL_SIZE 8192
+#endif
+
+/**
+ * The number of free trajectory nodes each thread keeps in its
+ * private cache. Trackers running in parallel threads then rarely
+ * touch the shared pool. Set to zero to disable caching.
+ */
+#ifndef PII_TRACKER_NODE_CACHE_SIZE
+#  define PII_TRACKER_NODE_CACHE_SIZE 64
+#endif
+
 /**
  * A utility class that can be used as the `Trajectory` type with
  * PiiMultiHypothesisTracker. With this structure, trajectories are
@@ -30,6 +52,14 @@
  * };
  * ~~~
  *
+ * Trackers create and destroy nodes at a high rate. Therefore,
+ * PiiTrackerTrajectoryNode overrides `new` and `delete` so that
+ * the memory for the nodes is taken from a fixed-size pool
+ * (PiiSimpleMemoryManager) shared by all nodes of the same type. The
+ * size of the pool can be changed by defining
+ * `PII_TRACKER_NODE_POOL_SIZE` before including this file. Each
+ * thread caches up to `PII_TRACKER_NODE_CACHE_SIZE` free nodes.
+ *
  */
 template <class Measurement, class Node> class PiiTrackerTrajectoryNode
 {
@@ -78,6 +108,25 @@ public:
     return _iTime == other._iTime && _measurement == other._measurement;
   }
 
+  /**
+   * Allocates memory for a node from the node pool. Falls back to
+   * the global `new` if the pool is full.
+   */
+  static void* operator new (std::size_t size)
+  {
+    void* ptr = memoryManager()->allocate(size);
+    return ptr != 0 ? ptr : ::operator new(size);
+  }
+
+  /**
+   * Releases memory allocated with `new`.
+   */
+  static void operator delete (void* ptr)
+  {
+    if (!memoryManager()->deallocate(ptr))
+      ::operator delete(ptr);
+  }
+
 protected:
   /**
    * Create an empty trajectory node.
@@ -144,6 +193,18 @@ protected:
   NodeType* _pNext;
 
 private:
+  static PiiSimpleMemoryManager* memoryManager()
+  {
+    // Intentionally never deleted: nodes owned by static objects may be
+    // destroyed after a static manager would be.
+    static PiiSimpleMemoryManager* pManager =
+      new PiiSimpleMemoryManager(Pii::alignAddress(sizeof(Node) + sizeof(void*), 0xf) *
+                                 PII_TRACKER_NODE_POOL_SIZE + 16,
+                                 sizeof(Node),
+                                 PII_TRACKER_NODE_CACHE_SIZE);
+    return pManager;
+  }
+
   /**
    * The number of references to this node.
    */
@@ -32,7 +32,8 @@ PiiMultiPointTracker::Data::Data(PiiMultiPointTracker *parent) :
   matMeasurementCounts(1,10),
   bCumulativeStatistics(false),
   iEmissionInterval(570),
-  bAllowMerging(false)
+  bAllowMerging(false),
+  iBeamWidth(0)
 {
 }
 
@@ -586,6 +587,8 @@ void PiiMultiPointTracker::setEmissionInterval(int emissionInterval) { _d()->iEm
 int PiiMultiPointTracker::emissionInterval() const { return _d()->iEmissionInterval; }
 void PiiMultiPointTracker::setAllowMerging(bool allowMerging) { _d()->bAllowMerging = allowMerging; }
 bool PiiMultiPointTracker::allowMerging() const { return _d()->bAllowMerging; }
+void PiiMultiPointTracker::setBeamWidth(int beamWidth) { _d()->iBeamWidth = beamWidth; }
+int PiiMultiPointTracker::beamWidth() const { return _d()->iBeamWidth; }
 
 
 void PiiMultiPointTracker::setInitialThreshold(int initialThreshold)
@@ -706,6 +709,9 @@ void PiiMultiPointTracker::Tracker::addMeasurements(const QList<PiiVector<double
       node->setTrajectoryFitness(evaluateTrajectory(node));
     }
 
+  // Limit the number of hypotheses competing for the same end point
+  pruneTrajectories(d->iBeamWidth);
+
   // Puts the trajectories in descending order
   sortTrajectories();
 
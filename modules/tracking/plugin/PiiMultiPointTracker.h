@@ -128,6 +128,16 @@ class PiiMultiPointTracker : public PiiDefaultOperation
    */
   Q_PROPERTY(bool allowMerging READ allowMerging WRITE setAllowMerging);
 
+  /**
+   * The maximum number of alternative trajectories (hypotheses)
+   * retained for each measurement point after each time step. Only
+   * the best `beamWidth` trajectories ending at the same point will
+   * be considered in the next time step, which keeps the hypothesis
+   * tree from exploding when there are lots of objects close to each
+   * other. Zero means no limit. The default value is 0.
+   */
+  Q_PROPERTY(int beamWidth READ beamWidth WRITE setBeamWidth);
+
   PII_OPERATION_SERIALIZATION_FUNCTION
 public:
   PiiMultiPointTracker();
@@ -174,6 +184,9 @@ public:
   void setAllowMerging(bool allowMerging);
   bool allowMerging() const;
 
+  void setBeamWidth(int beamWidth);
+  int beamWidth() const;
+
   struct AreaStatistics
   {
     PiiMatrix<int> dwellHistogram;
@@ -260,6 +273,7 @@ private:
     QHash<int, AreaStatistics> hashAreas;
     QHash<int, LineStatistics> hashLines;
     bool bAllowMerging;
+    int iBeamWidth;
   };
   PII_D_FUNC;
 };
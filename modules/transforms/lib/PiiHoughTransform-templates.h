@@ -18,9 +18,146 @@
 #endif
 
 #include <PiiMath.h>
+#include <QVector>
+#include <QMutex>
+#include <QMutexLocker>
+
+template <class T, class Matrix, class UnaryOp> struct PiiHoughTransform::VotingBand
+{
+  VotingBand(const Matrix& img, const PiiMatrix<float>* directions, UnaryOp rule,
+             const double* cosTable, const double* sinTable,
+             double startAngle, double angleResolution, int angles, double angleWindow,
+             double distanceResolution, int startDistance,
+             PiiMatrix<T>& result, QMutex* mutex) :
+    img(img), pDirections(directions), rule(rule),
+    pCosTable(cosTable), pSinTable(sinTable),
+    dStartAngle(startAngle), dAngleResolution(angleResolution),
+    iAngles(angles), dAngleWindow(angleWindow),
+    dDistanceResolution(distanceResolution),
+    iStartDistance(startDistance), iDistances(result.rows()),
+    dCenterX(double(img.columns()-1)/2.0), dCenterY(double(img.rows()-1)/2.0),
+    result(result), pMutex(mutex)
+  {}
+
+  void operator() (int firstRow, int rowCount)
+  {
+    // A single band votes directly to the result. Otherwise, each
+    // band collects an accumulator of its own.
+    PiiMatrix<T> matBand;
+    const bool bWholeImage = firstRow == 0 && rowCount == img.rows();
+    if (!bWholeImage)
+      matBand = PiiMatrix<T>(result.rows(), result.columns());
+    PiiMatrix<T>& matAccumulator = bWholeImage ? result : matBand;
+    pAccumulator = reinterpret_cast<char*>(matAccumulator.row(0));
+    iStride = matAccumulator.stride();
+    QVector<int> vecIndices(iAngles);
+    pIndices = vecIndices.data();
+
+    const int iCols = img.columns();
+    for (int r=firstRow; r<firstRow+rowCount; ++r)
+      {
+        typename Matrix::const_row_iterator row = img[r];
+        const float* pDirectionRow = pDirections != 0 ? pDirections->row(r) : 0;
+        const double dY = double(r) - dCenterY;
+        for (int c=0; c<iCols; ++c)
+          if (rule(row[c]))
+            {
+              const double dX = double(c) - dCenterX;
+              if (pDirectionRow != 0)
+                voteWindow(dX, dY, T(row[c]), double(pDirectionRow[c]) * (180 / M_PI));
+              else
+                vote(dX, dY, T(row[c]), 0, iAngles);
+            }
+      }
+
+    if (!bWholeImage)
+      {
+        QMutexLocker lock(pMutex);
+        result += matBand;
+      }
+  }
+
+  void voteWindow(double x, double y, T value, double direction)
+  {
+    if (dAngleWindow >= 90)
+      {
+        vote(x, y, value, 0, iAngles);
+        return;
+      }
+    // The gradient may point to either side of the line. Vote around
+    // all equivalent directions that hit the angle range.
+    const double dEndAngle = dStartAngle + iAngles * dAngleResolution;
+    for (int k = int(Pii::ceil((dStartAngle - dAngleWindow - direction) / 180));
+         k <= int(Pii::floor((dEndAngle + dAngleWindow - direction) / 180)); ++k)
+      {
+        const double dCenter = direction + k * 180 - dStartAngle;
+        const int iFirst = qMax(0, int(Pii::ceil((dCenter - dAngleWindow) / dAngleResolution))),
+          iLast = qMin(iAngles-1, int(Pii::floor((dCenter + dAngleWindow) / dAngleResolution)));
+        if (iFirst <= iLast)
+          vote(x, y, value, iFirst, iLast+1);
+      }
+  }
+
+  void vote(double x, double y, T value, int firstAngle, int endAngle)
+  {
+    // Calculate the distances first to keep the loop free of
+    // branches and memory accesses to the accumulator.
+    for (int omega=firstAngle; omega<endAngle; ++omega)
+      {
+        const double dDistance = (x*pCosTable[omega] + y*pSinTable[omega]) / dDistanceResolution;
+        pIndices[omega] = int(dDistance + (dDistance >= 0 ? 0.5 : -0.5)) - iStartDistance;
+      }
+    for (int omega=firstAngle; omega<endAngle; ++omega)
+      if (unsigned(pIndices[omega]) < unsigned(iDistances))
+        reinterpret_cast<T*>(pAccumulator + pIndices[omega] * iStride)[omega] += value;
+  }
+
+  const Matrix& img;
+  const PiiMatrix<float>* pDirections;
+  UnaryOp rule;
+  const double *pCosTable, *pSinTable;
+  const double dStartAngle, dAngleResolution;
+  const int iAngles;
+  const double dAngleWindow, dDistanceResolution;
+  const int iStartDistance, iDistances;
+  const double dCenterX, dCenterY;
+  PiiMatrix<T>& result;
+  QMutex* pMutex;
+  char* pAccumulator;
+  std::size_t iStride;
+  int* pIndices;
+};
 
 template <class T, class Matrix, class UnaryOp>
 PiiMatrix<T> PiiHoughTransform::transform(const Matrix& img, UnaryOp rule)
+{
+  return vote<T>(Pii::ParallelExecution(1), img, 0, 180, rule);
+}
+
+template <class T, class Matrix, class UnaryOp>
+PiiMatrix<T> PiiHoughTransform::transform(const Pii::ParallelExecution& policy, const Matrix& img, UnaryOp rule)
+{
+  return vote<T>(policy, img, 0, 180, rule);
+}
+
+template <class T, class Matrix, class UnaryOp>
+PiiMatrix<T> PiiHoughTransform::transform(const Pii::ParallelExecution& policy,
+                                          const Matrix& img,
+                                          const PiiMatrix<float>& directions,
+                                          double angleWindow,
+                                          UnaryOp rule)
+{
+  if (directions.rows() != img.rows() || directions.columns() != img.columns())
+    PII_MATRIX_SIZE_MISMATCH;
+  return vote<T>(policy, img, &directions, angleWindow, rule);
+}
+
+template <class T, class Matrix, class UnaryOp>
+PiiMatrix<T> PiiHoughTransform::vote(const Pii::ParallelExecution& policy,
+                                     const Matrix& img,
+                                     const PiiMatrix<float>* directions,
+                                     double angleWindow,
+                                     UnaryOp rule)
 {
   const int iRows = img.rows();
   const int iCols = img.columns();
@@ -47,29 +184,17 @@ PiiMatrix<T> PiiHoughTransform::transform(const Matrix& img, UnaryOp rule)
   //qDebug("center: (%lf, %lf)", centerY, centerX);
 
   PiiMatrix<T> result(iDistances, iAngles);
+  if (result.isEmpty() || iRows == 0)
+    return result;
 
   initSinCosTables(iAngles);
 
-  const double* pCosAngleValues = cosTable();
-  const double* pSinAngleValues = sinTable();
-
-  for (typename Matrix::const_iterator it = img.begin(); it != img.end(); ++it)
-    // Is this pixel part of target?
-    if (rule(*it))
-      {
-        //qDebug("(%d, %d) matches", r, c);
-        double coordX = double(it.column()) - centerX;
-        double coordY = double(it.row()) - centerY;
-        for (int omega=0; omega<iAngles; ++omega)
-          {
-            // Calculate distance to origin
-            int d = Pii::round<int>((coordX*pCosAngleValues[omega] +
-                                     coordY*pSinAngleValues[omega])/dDistanceResolution);
-            //qDebug("Accessing (%d, %d) of %d-by-%d", d-iStartDistance, omega, iDistances, iAngles);
-            if (d >= iStartDistance && d <= iEndDistance)
-              result(d - iStartDistance, omega) += T(*it);
-          }
-      }
-
+  QMutex mutex;
+  Pii::forEachBand(policy, iRows, 0,
+                   VotingBand<T,Matrix,UnaryOp>(img, directions, rule,
+                                                cosTable(), sinTable(),
+                                                iStartAngle, dAngleResolution, iAngles, angleWindow,
+                                                dDistanceResolution, iStartDistance,
+                                                result, &mutex));
   return result;
 }
@@ -216,7 +216,7 @@ void PiiHoughTransform::initSinCosTables(int angles)
 {
   PII_D;
   if (angles == d->iPreviousAngles &&
-      d->iStartAngle && d->iPreviousStartAngle &&
+      d->iStartAngle == d->iPreviousStartAngle &&
       d->dAngleResolution == d->dPreviousAngleResolution)
     return;
 
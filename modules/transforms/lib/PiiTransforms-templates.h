@@ -20,6 +20,10 @@
 #include <PiiMatrixUtil.h>
 #include <PiiImage.h>
 
+#include <QVector>
+#include <QMutex>
+#include <QMutexLocker>
+
 namespace PiiTransforms
 {
   inline void addPixel(int magnitude, PiiMatrix<int>& result, double r, double c)
@@ -351,4 +355,286 @@ namespace PiiTransforms
       }
     return lstCircles;
   }
+
+  /// @hide
+  struct CircleEdgePoint
+  {
+    float x, y, dx, dy;
+  };
+
+  // Collects selected edge pixels and their unit gradient vectors.
+  template <class T, class Selector>
+  QVector<CircleEdgePoint> circleEdgePoints(const PiiMatrix<T>& gradientX,
+                                            const PiiMatrix<T>& gradientY,
+                                            Selector select)
+  {
+    PII_MATRIX_CHECK_EQUAL_SIZE(gradientX, gradientY);
+    QVector<CircleEdgePoint> vecPoints;
+    for (int r=0; r<gradientX.rows(); ++r)
+      {
+        const T* pX = gradientX[r];
+        const T* pY = gradientY[r];
+        for (int c=0; c<gradientX.columns(); ++c)
+          {
+            if (pX[c] == 0 && pY[c] == 0)
+              continue;
+            double dMagnitude = Pii::hypotenuse<double>(pX[c], pY[c]);
+            if (!select(dMagnitude))
+              continue;
+            CircleEdgePoint point = { float(c), float(r),
+                                      float(pX[c] / dMagnitude), float(pY[c] / dMagnitude) };
+            vecPoints.append(point);
+          }
+      }
+    return vecPoints;
+  }
+
+  // Votes for the centers of a sub-range of radii. The "rows" of
+  // forEachBand() are radii.
+  struct CircleCenterBand
+  {
+    CircleCenterBand(const QVector<CircleEdgePoint>& points, int minRadius, int radiusCount,
+                     GradientSign sign, PiiMatrix<int>& result, QMutex* mutex) :
+      points(points), iMinRadius(minRadius), iRadiusCount(radiusCount),
+      bPositive(sign member_of (PositiveGradient, IgnoreGradientSign)),
+      bNegative(sign member_of (NegativeGradient, IgnoreGradientSign)),
+      result(result), pMutex(mutex),
+      pAccumulator(0), iStride(0)
+    {}
+
+    void operator() (int firstRadius, int radiusCount)
+    {
+      // A single band votes directly to the result. Otherwise, each
+      // band collects an accumulator of its own.
+      PiiMatrix<int> matBand;
+      const bool bAllRadii = firstRadius == 0 && radiusCount == iRadiusCount;
+      if (!bAllRadii)
+        matBand = PiiMatrix<int>(result.rows(), result.columns());
+      PiiMatrix<int>& matAccumulator = bAllRadii ? result : matBand;
+      pAccumulator = reinterpret_cast<char*>(matAccumulator.row(0));
+      iStride = matAccumulator.stride();
+
+      firstRadius += iMinRadius;
+      for (int i=0; i<points.size(); ++i)
+        {
+          if (bPositive)
+            vote(points[i], 1, firstRadius, radiusCount);
+          if (bNegative)
+            vote(points[i], -1, firstRadius, radiusCount);
+        }
+
+      if (!bAllRadii)
+        {
+          QMutexLocker lock(pMutex);
+          result += matBand;
+        }
+    }
+
+    void vote(const CircleEdgePoint& point, double direction, int firstRadius, int radiusCount)
+    {
+      const double dX = point.dx * direction, dY = point.dy * direction;
+      double dCol = point.x + dX * firstRadius, dRow = point.y + dY * firstRadius;
+      const unsigned int uiRows = unsigned(result.rows()), uiCols = unsigned(result.columns());
+      for (int i=0; i<radiusCount; ++i, dCol += dX, dRow += dY)
+        {
+          // Casting would round negative values towards zero.
+          if (dCol < -0.5 || dRow < -0.5)
+            continue;
+          const unsigned int uiCol = unsigned(dCol + 0.5), uiRow = unsigned(dRow + 0.5);
+          if (uiCol < uiCols && uiRow < uiRows)
+            ++reinterpret_cast<int*>(pAccumulator + uiRow * iStride)[uiCol];
+        }
+    }
+
+    const QVector<CircleEdgePoint>& points;
+    const int iMinRadius, iRadiusCount;
+    const bool bPositive, bNegative;
+    PiiMatrix<int>& result;
+    QMutex* pMutex;
+    char* pAccumulator;
+    std::size_t iStride;
+  };
+
+  inline PiiMatrix<int> circleCenterHough(const Pii::ParallelExecution& policy,
+                                          const QVector<CircleEdgePoint>& points,
+                                          int rows, int columns,
+                                          int minRadius, int maxRadius,
+                                          GradientSign sign)
+  {
+    if (minRadius > maxRadius)
+      qSwap(minRadius, maxRadius);
+    minRadius = qMax(minRadius, 1);
+    PiiMatrix<int> matResult(rows, columns);
+    const int iRadiusCount = maxRadius - minRadius + 1;
+    if (iRadiusCount <= 0 || points.isEmpty() || matResult.isEmpty())
+      return matResult;
+    QMutex mutex;
+    Pii::forEachBand(policy, iRadiusCount, 0,
+                     CircleCenterBand(points, minRadius, iRadiusCount, sign, matResult, &mutex));
+    return matResult;
+  }
+
+  inline PiiMatrix<int> circleRadiusHistogram(const QVector<CircleEdgePoint>& points,
+                                              double centerX, double centerY,
+                                              int minRadius, int maxRadius,
+                                              double angleError, GradientSign sign)
+  {
+    if (minRadius > maxRadius)
+      qSwap(minRadius, maxRadius);
+    minRadius = qMax(minRadius, 0);
+    PiiMatrix<int> matResult(1, maxRadius - minRadius + 1);
+    int* pHistogram = matResult.row(0);
+    const double dMinCos = cos(angleError);
+    const double dMinDistance = minRadius - 0.5, dMaxDistance = maxRadius + 0.5;
+    for (int i=0; i<points.size(); ++i)
+      {
+        const CircleEdgePoint& point = points[i];
+        const double dX = centerX - point.x, dY = centerY - point.y;
+        const double dDistance = Pii::hypotenuse(dX, dY);
+        if (dDistance < dMinDistance || dDistance >= dMaxDistance || dDistance == 0)
+          continue;
+        // Cosine of the angle between the gradient and the direction
+        // to the center.
+        const double dCos = (dX * point.dx + dY * point.dy) / dDistance;
+        if ((sign == PositiveGradient && dCos < dMinCos) ||
+            (sign == NegativeGradient && -dCos < dMinCos) ||
+            (sign == IgnoreGradientSign && Pii::abs(dCos) < dMinCos))
+          continue;
+        ++pHistogram[qMin(int(dDistance - dMinDistance), matResult.columns()-1)];
+      }
+    return matResult;
+  }
+  /// @endhide
+
+  template <class T, class Selector>
+  PiiMatrix<int> circleCenterHough(const Pii::ParallelExecution& policy,
+                                   const PiiMatrix<T>& gradientX,
+                                   const PiiMatrix<T>& gradientY,
+                                   Selector select,
+                                   int minRadius,
+                                   int maxRadius,
+                                   GradientSign sign)
+  {
+    return circleCenterHough(policy, circleEdgePoints(gradientX, gradientY, select),
+                             gradientX.rows(), gradientX.columns(),
+                             minRadius, maxRadius, sign);
+  }
+
+  template <class T, class Selector>
+  PiiMatrix<int> circleRadiusHistogram(const PiiMatrix<T>& gradientX,
+                                       const PiiMatrix<T>& gradientY,
+                                       Selector select,
+                                       double centerX,
+                                       double centerY,
+                                       int minRadius,
+                                       int maxRadius,
+                                       double angleError,
+                                       GradientSign sign)
+  {
+    return circleRadiusHistogram(circleEdgePoints(gradientX, gradientY, select),
+                                 centerX, centerY, minRadius, maxRadius, angleError, sign);
+  }
+
+  template <class T, class Selector>
+  QList<HoughCircle<double> > detectCircles(const Pii::ParallelExecution& policy,
+                                            const PiiMatrix<T>& gradientX,
+                                            const PiiMatrix<T>& gradientY,
+                                            Selector select,
+                                            int minRadius,
+                                            int maxRadius,
+                                            double minDistance,
+                                            int maxCnt,
+                                            int threshold,
+                                            GradientSign sign)
+  {
+    if (minRadius > maxRadius)
+      qSwap(minRadius, maxRadius);
+    minRadius = qMax(minRadius, 1);
+
+    QList<HoughCircle<double> > lstCircles;
+    const QVector<CircleEdgePoint> vecPoints(circleEdgePoints(gradientX, gradientY, select));
+
+    // Stage 1: find center candidates for all radii at once.
+    // Quantized gradient directions scatter the votes around the
+    // true center. Summing over 3-by-3 neighborhoods collects them
+    // back.
+    const PiiMatrix<int> matRowOnes(1, 3, 1, 1, 1), matColumnOnes(3, 1, 1, 1, 1);
+    QList<PiiMatrixValue<int> > lstCenters(findPeaks(PiiImage::filter<int>(circleCenterHough(policy, vecPoints,
+                                                                                             gradientX.rows(),
+                                                                                             gradientX.columns(),
+                                                                                             minRadius, maxRadius, sign),
+                                                                           matRowOnes, matColumnOnes,
+                                                                           Pii::ExtendZeros),
+                                                     minDistance, maxCnt, threshold));
+
+    // Stage 2: find the best supported radius for each center.
+    for (int i=0; i<lstCenters.size(); ++i)
+      {
+        const double dX = lstCenters[i].column, dY = lstCenters[i].row;
+        const PiiMatrix<int> matHistogram(circleRadiusHistogram(vecPoints, dX, dY,
+                                                                minRadius, maxRadius,
+                                                                M_PI/8, sign));
+        const int* pHistogram = matHistogram[0];
+        const int iBins = matHistogram.columns();
+        // Edge thickness spreads votes to adjacent bins. The three-bin
+        // sum is compared relative to radius (i.e. circumference) so
+        // that large circles are not favored.
+        double dBestScore = 0;
+        int iBestSum = 0, iBestBin = -1;
+        for (int b=0; b<iBins; ++b)
+          {
+            const int iSum = pHistogram[b] +
+              (b > 0 ? pHistogram[b-1] : 0) +
+              (b < iBins-1 ? pHistogram[b+1] : 0);
+            const double dScore = double(iSum) / (minRadius + b);
+            if (dScore > dBestScore)
+              {
+                dBestScore = dScore;
+                iBestSum = iSum;
+                iBestBin = b;
+              }
+          }
+        if (iBestBin < 0)
+          continue;
+        // The weighted mean of the three bins gives a sub-pixel radius.
+        double dWeightedSum = 0;
+        for (int b=qMax(iBestBin-1, 0); b<=qMin(iBestBin+1, iBins-1); ++b)
+          dWeightedSum += double(minRadius + b) * pHistogram[b];
+        lstCircles << HoughCircle<double>(dX, dY, dWeightedSum / iBestSum, iBestSum);
+      }
+    qSort(lstCircles.begin(), lstCircles.end(), CircleGreater<double>());
+    return lstCircles;
+  }
+
+  template <class T, class Selector>
+  PiiMatrix<double> circleSupport(const PiiMatrix<T>& gradientX,
+                                  const PiiMatrix<T>& gradientY,
+                                  Selector select,
+                                  const HoughCircle<double>& circle,
+                                  double tolerance)
+  {
+    PII_MATRIX_CHECK_EQUAL_SIZE(gradientX, gradientY);
+    PiiMatrix<double> matPoints(0, 2);
+    matPoints.reserve(Pii::round<int>(2 * M_PI * (circle.radius + tolerance)));
+    const double dReach = circle.radius + tolerance;
+    const int iFirstRow = qMax(int(circle.y - dReach), 0),
+      iLastRow = qMin(int(circle.y + dReach) + 1, gradientX.rows() - 1),
+      iFirstCol = qMax(int(circle.x - dReach), 0),
+      iLastCol = qMin(int(circle.x + dReach) + 1, gradientX.columns() - 1);
+    for (int r=iFirstRow; r<=iLastRow; ++r)
+      {
+        const T* pX = gradientX[r];
+        const T* pY = gradientY[r];
+        for (int c=iFirstCol; c<=iLastCol; ++c)
+          {
+            if (Pii::abs(Pii::hypotenuse(c - circle.x, r - circle.y) - circle.radius) > tolerance ||
+                !select(Pii::hypotenuse<double>(pX[c], pY[c])))
+              continue;
+            double* pPoint = matPoints.appendRow();
+            pPoint[0] = c;
+            pPoint[1] = r;
+          }
+      }
+    return matPoints;
+  }
 }
@@ -20,6 +20,7 @@
 #include <PiiMath.h>
 #include <PiiMatrixValue.h>
 #include <PiiHeap.h>
+#include <PiiParallel.h>
 
 #include <QList>
 
@@ -176,6 +177,93 @@ namespace PiiTransforms
                                      U radiusStep = 1,
                                      GradientSign sign = IgnoreGradientSign);
 
+  /**
+   * Accumulates votes for circle centers for a range of radii at once.
+   * This is the first stage of a two-stage circle detector (see
+   * [detectCircles()]). Each selected edge pixel draws a line segment
+   * along its gradient. The segment covers the distances from
+   * *minRadius* to *maxRadius*. The
+   * result is a single two-dimensional accumulator whose peaks are
+   * likely circle centers, independent of radius. Since the votes are
+   * constrained by gradient direction, the amount of work is
+   * proportional to the number of edge pixels times the width of the
+   * radius range, and there is no need to keep an accumulator for
+   * each radius.
+   *
+   * The range of radii is divided into bands that are processed in
+   * parallel as determined by *policy*. Each band votes into an
+   * accumulator of its own, and the accumulators are summed at the
+   * end.
+   *
+   * @param gradientX horizontal image gradient (e.g. image filtered
+   * with `SobelXFilter`)
+   *
+   * @param gradientY vertical image gradient
+   *
+   * @param select a function that accepts or rejects pixels based
+   * on gradient magnitude. See ThresholdSelector.
+   *
+   * @param minRadius the smallest radius considered
+   *
+   * @param maxRadius the largest radius considered
+   *
+   * @param sign the sign of the gradient at the edges of the circles.
+   * `PositiveGradient` means that the gradient points towards the
+   * center.
+   *
+   * @return an accumulator whose size equals that of the gradient
+   * images. Each entry counts the number of edge pixels that may be
+   * part of a circle centered at that pixel.
+   */
+  template <class T, class Selector>
+  PiiMatrix<int> circleCenterHough(const Pii::ParallelExecution& policy,
+                                   const PiiMatrix<T>& gradientX,
+                                   const PiiMatrix<T>& gradientY,
+                                   Selector select,
+                                   int minRadius,
+                                   int maxRadius,
+                                   GradientSign sign = IgnoreGradientSign);
+
+  /**
+   * Accumulates votes for circle centers in the calling thread.
+   */
+  template <class T, class Selector>
+  PiiMatrix<int> circleCenterHough(const PiiMatrix<T>& gradientX,
+                                   const PiiMatrix<T>& gradientY,
+                                   Selector select,
+                                   int minRadius,
+                                   int maxRadius,
+                                   GradientSign sign = IgnoreGradientSign)
+  {
+    return circleCenterHough(Pii::ParallelExecution(1), gradientX, gradientY, select,
+                             minRadius, maxRadius, sign);
+  }
+
+  /**
+   * Calculates a histogram of the distances when edge pixels are
+   * seen from a pre-detected circle center. This is the second
+   * stage of [detectCircles()]. Only pixels whose gradient points
+   * towards (or away from) the center, within *angleError* radians,
+   * are taken into account.
+   *
+   * @param centerX the x coordinate of the center
+   *
+   * @param centerY the y coordinate of the center
+   *
+   * @return a 1-by-(maxRadius-minRadius+1) matrix. Column i counts the
+   * edge pixels whose distance to the center rounds to minRadius+i.
+   */
+  template <class T, class Selector>
+  PiiMatrix<int> circleRadiusHistogram(const PiiMatrix<T>& gradientX,
+                                       const PiiMatrix<T>& gradientY,
+                                       Selector select,
+                                       double centerX,
+                                       double centerY,
+                                       int minRadius,
+                                       int maxRadius,
+                                       double angleError = M_PI/16,
+                                       GradientSign sign = IgnoreGradientSign);
+
   template <class T> struct HoughCircle
   {
     HoughCircle(T xVal = 0, T yVal = 0, T r = 0, T m = 0) :
@@ -231,6 +319,101 @@ namespace PiiTransforms
                                      double tolerance,
                                      int maxCnt,
                                      T threshold);
+
+  /**
+   * Detects circles whose radii are within [*minRadius*,
+   * *maxRadius*] using a two-stage gradient Hough transform. First,
+   * [circleCenterHough()] collects center votes for all radii into a
+   * single accumulator, and peaks in the accumulator are found with
+   * [findPeaks()]. Then, a [radius
+   * histogram](circleRadiusHistogram()) is built for each candidate
+   * center. The radius is the weighted mean of the three adjacent
+   * bins with the largest sum relative to radius. This sum
+   * is also the magnitude of the circle.
+   *
+   * Compared to calling circularHough() for each radius, the two-stage
+   * algorithm needs a fraction of memory and time, especially when the
+   * radius range is wide. If a more accurate estimate is needed, pass
+   * the pixels near each detected circle ([circleSupport()]) to
+   * PiiCircleRansac.
+   *
+   * ~~~(c++)
+   * using namespace PiiTransforms;
+   * PiiMatrix<int> matGradX(PiiImage::filter<int>(image, PiiImage::SobelXFilter)),
+   *   matGradY(PiiImage::filter<int>(image, PiiImage::SobelYFilter));
+   * QList<HoughCircle<double> > lstCircles(detectCircles(Pii::ParallelExecution(),
+   *                                                      matGradX, matGradY,
+   *                                                      ThresholdSelector(100),
+   *                                                      20, 80, // radius range
+   *                                                      30, // min. distance between centers
+   *                                                      5)); // at most five circles
+   * ~~~
+   *
+   * @param minDistance the minimum distance between circle centers
+   *
+   * @param maxCnt the maximum number of circles to return. Zero
+   * means no limit.
+   *
+   * @param threshold the minimum number of votes a center candidate
+   * must receive in the first stage. Since the votes are summed over
+   * 3-by-3 neighborhoods before peak detection, the threshold
+   * applies to the sum. See [findPeaks()].
+   *
+   * @return detected circles, strongest first
+   */
+  template <class T, class Selector>
+  QList<HoughCircle<double> > detectCircles(const Pii::ParallelExecution& policy,
+                                            const PiiMatrix<T>& gradientX,
+                                            const PiiMatrix<T>& gradientY,
+                                            Selector select,
+                                            int minRadius,
+                                            int maxRadius,
+                                            double minDistance,
+                                            int maxCnt,
+                                            int threshold = 0,
+                                            GradientSign sign = IgnoreGradientSign);
+
+  /**
+   * Detects circles in the calling thread.
+   */
+  template <class T, class Selector>
+  QList<HoughCircle<double> > detectCircles(const PiiMatrix<T>& gradientX,
+                                            const PiiMatrix<T>& gradientY,
+                                            Selector select,
+                                            int minRadius,
+                                            int maxRadius,
+                                            double minDistance,
+                                            int maxCnt,
+                                            int threshold = 0,
+                                            GradientSign sign = IgnoreGradientSign)
+  {
+    return detectCircles(Pii::ParallelExecution(1), gradientX, gradientY, select,
+                         minRadius, maxRadius, minDistance, maxCnt, threshold, sign);
+  }
+
+  /**
+   * Collects the selected edge pixels that are at most *tolerance*
+   * pixels away from the circumference of *circle*. The returned
+   * N-by-2 matrix stores the (x, y) coordinates of the pixels and can
+   * be used as such to refine the circle with PiiCircleRansac.
+   *
+   * ~~~(c++)
+   * PiiCircleRansac<double> ransac(PiiTransforms::circleSupport(matGradX, matGradY,
+   *                                                             PiiTransforms::ThresholdSelector(100),
+   *                                                             lstCircles[0], 3));
+   * ransac.setFittingThreshold(1.5);
+   * if (ransac.findBestModel())
+   *   {
+   *     PiiMatrix<double> matCircle(ransac.bestModel()); // x, y, r
+   *   }
+   * ~~~
+   */
+  template <class T, class Selector>
+  PiiMatrix<double> circleSupport(const PiiMatrix<T>& gradientX,
+                                  const PiiMatrix<T>& gradientY,
+                                  Selector select,
+                                  const HoughCircle<double>& circle,
+                                  double tolerance);
 }
 
 #include "PiiTransforms-templates.h"
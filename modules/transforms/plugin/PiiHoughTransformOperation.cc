@@ -22,7 +22,8 @@ PiiHoughTransformOperation::Data::Data() :
   iMaxPeakCount(1),
   dMinPeakMagnitude(0),
   bPeaksConnected(false),
-  dMinPeakDistance(1)
+  dMinPeakDistance(1),
+  dAngleWindow(5)
 {
 }
 
@@ -31,6 +32,8 @@ PiiHoughTransformOperation::PiiHoughTransformOperation() :
 {
   setThreadCount(1);
   addSocket(new PiiInputSocket("image"));
+  addSocket(new PiiInputSocket("direction"));
+  inputAt(1)->setOptional(true);
   addSocket(new PiiOutputSocket("accumulator"));
   addSocket(new PiiOutputSocket("peaks"));
   addSocket(new PiiOutputSocket("coordinates"));
@@ -74,7 +77,19 @@ template <class T> void PiiHoughTransformOperation::transform(const PiiVariant&
   typedef typename TransformTraits<T>::Type ResultType;
   PiiMatrix<ResultType> accumulator;
 
-  accumulator = d->hough.transform<ResultType>(image, Pii::Identity<T>());
+  if (inputAt(1)->isConnected())
+    {
+      PiiVariant directionObj = inputAt(1)->firstObject();
+      if (directionObj.type() != PiiYdin::FloatMatrixType)
+        PII_THROW_UNKNOWN_TYPE(inputAt(1));
+      const PiiMatrix<float> matDirections = directionObj.valueAs<PiiMatrix<float> >();
+      if (matDirections.rows() != image.rows() || matDirections.columns() != image.columns())
+        PII_THROW_WRONG_SIZE(inputAt(1), matDirections, image.rows(), image.columns());
+      accumulator = d->hough.transform<ResultType>(Pii::ParallelExecution(), image, matDirections,
+                                                   d->dAngleWindow, Pii::Identity<T>());
+    }
+  else
+    accumulator = d->hough.transform<ResultType>(Pii::ParallelExecution(), image, Pii::Identity<T>());
 
   if (d->bPeaksConnected)
     findPeaks(accumulator);
@@ -123,3 +138,5 @@ void PiiHoughTransformOperation::setMinPeakMagnitude(double minPeakMagnitude) {
 double PiiHoughTransformOperation::minPeakMagnitude() const { return _d()->dMinPeakMagnitude; }
 void PiiHoughTransformOperation::setMinPeakDistance(double minPeakDistance) { _d()->dMinPeakDistance = qMax(1.0, minPeakDistance); }
 double PiiHoughTransformOperation::minPeakDistance() const { return _d()->dMinPeakDistance; }
+void PiiHoughTransformOperation::setAngleWindow(double angleWindow) { _d()->dAngleWindow = qMax(0.0, angleWindow); }
+double PiiHoughTransformOperation::angleWindow() const { return _d()->dAngleWindow; }
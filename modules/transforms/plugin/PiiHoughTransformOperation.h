@@ -45,6 +45,12 @@
  * values in the input image will add to the transform. Higher values
  * have higher weight.
  *
+ * @in direction - gradient direction for each pixel of `image`, in
+ * radians (PiiMatrix<float>). This input is optional. If it is
+ * connected, each pixel only votes for lines whose normal is within
+ * [angleWindow] degrees of the gradient direction. The input can be
+ * connected directly to the `direction` output of PiiEdgeDetector.
+ *
  * Outputs
  * -------
  *
@@ -109,6 +115,13 @@ class PII_TRANSFORMS_EXPORT PiiHoughTransformOperation : public PiiDefaultOperat
    */
   Q_PROPERTY(double minPeakDistance READ minPeakDistance WRITE setMinPeakDistance);
 
+  /**
+   * The maximum difference between the gradient direction of a pixel
+   * and the normal of the lines it votes for, in degrees. Used only
+   * if the `direction` input is connected. Default is 5.
+   */
+  Q_PROPERTY(double angleWindow READ angleWindow WRITE setAngleWindow);
+
   Q_PROPERTY(int startAngle READ startAngle WRITE setStartAngle);
   Q_PROPERTY(int endAngle READ endAngle WRITE setEndAngle);
   Q_PROPERTY(int startDistance READ startDistance WRITE setStartDistance);
@@ -145,6 +158,8 @@ protected:
   double minPeakMagnitude() const;
   void setMinPeakDistance(double minPeakDistance);
   double minPeakDistance() const;
+  void setAngleWindow(double angleWindow);
+  double angleWindow() const;
 
 private:
   template <class T> void transform(const PiiVariant& obj);
@@ -163,6 +178,7 @@ private:
     bool bPeaksConnected;
     PiiHoughTransform hough;
     double dMinPeakDistance;
+    double dAngleWindow;
   };
   PII_D_FUNC;
 };
@@ -23,6 +23,7 @@ PiiVideoFileReader::Data::Data() :
   pFileNameInput(0),
   iFrameStep(1),
   iVideoIndex(0),
+  iThreadCount(0),
   bFileNameConnected(false),
   bTriggered(false)
 {}
@@ -67,6 +68,7 @@ void PiiVideoFileReader::initializeVideoReader(const QString& fileName)
 {
   PII_D;
   d->pVideoReader->setFileName(fileName);
+  d->pVideoReader->setThreadCount(d->iThreadCount);
   try
     {
       d->pVideoReader->initialize();
@@ -174,3 +176,5 @@ int PiiVideoFileReader::repeatCount() const { return _d()->iRepeatCount; }
 void PiiVideoFileReader::setRepeatCount(int cnt) { _d()->iRepeatCount = cnt; }
 void PiiVideoFileReader::setFrameStep(int frameStep) { _d()->iFrameStep = frameStep; }
 int PiiVideoFileReader::frameStep() const { return _d()->iFrameStep; }
+void PiiVideoFileReader::setThreadCount(int threadCount) { _d()->iThreadCount = threadCount; }
+int PiiVideoFileReader::threadCount() const { return _d()->iThreadCount; }
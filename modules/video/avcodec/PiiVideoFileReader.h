@@ -53,10 +53,20 @@ class PII_VIDEO_EXPORT PiiVideoFileReader : public PiiImageReaderOperation
   Q_PROPERTY(int repeatCount READ repeatCount WRITE setRepeatCount);
 
   /**
-   * FrameStep description
+   * The number of frames to advance on each step. 1 emits every
+   * frame, 2 every other frame and so on. Negative values play the
+   * video backwards. Frames are skipped by seeking to the nearest key
+   * frame whenever that is faster than decoding through them.
    */
   Q_PROPERTY(int frameStep READ frameStep WRITE setFrameStep);
 
+  /**
+   * The number of threads used for decoding. Zero means one thread
+   * per processor core. The default is zero. See
+   * [PiiVideoReader::setThreadCount()].
+   */
+  Q_PROPERTY(int threadCount READ threadCount WRITE setThreadCount);
+
 
   PII_OPERATION_SERIALIZATION_FUNCTION
 
@@ -74,6 +84,9 @@ public:
   void setFrameStep(int frameStep);
   int frameStep() const;
 
+  void setThreadCount(int threadCount);
+  int threadCount() const;
+
 protected:
 
   void process();
@@ -95,7 +108,7 @@ private:
     int iRepeatCount;
     PiiVideoReader* pVideoReader;
     PiiInputSocket *pFileNameInput;
-    int iFrameStep, iVideoIndex;
+    int iFrameStep, iVideoIndex, iThreadCount;
     bool bFileNameConnected, bTriggered;
   };
   PII_D_FUNC;
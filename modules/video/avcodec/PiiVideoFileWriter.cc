@@ -16,10 +16,13 @@
 #include "PiiVideoFileWriter.h"
 #include <PiiYdinTypes.h>
 #include <PiiColor.h>
+#include <PiiAsyncCall.h>
 
 PiiVideoFileWriter::Data::Data() :
   strOutputDirectory("."), strFileName("output.mpg"), iIndex(0),
-  iWidth(0), iHeight(0), iFrameRate(25), pVideoWriter(0)
+  iWidth(0), iHeight(0), iFrameRate(25),
+  iQueueLength(16), dropPolicy(BlockWhenFull), iDroppedFrameCount(0),
+  pVideoWriter(0), pEncoderThread(0), bEncoderRunning(false)
 {}
 
 PiiVideoFileWriter::PiiVideoFileWriter() :
@@ -30,6 +33,10 @@ PiiVideoFileWriter::PiiVideoFileWriter() :
   d->pImageInput = new PiiInputSocket("image");
   addSocket(d->pImageInput);
 
+  d->pEncoderThread = Pii::createAsyncCall(this, &PiiVideoFileWriter::encodeFrames);
+
+  setProtectionLevel("encoder", WriteWhenStopped);
+
   connect(this, SIGNAL(stateChanged(PiiOperation::State)),
           SLOT(deletePiiVideoWriter(PiiOperation::State)),
           Qt::DirectConnection);
@@ -38,6 +45,8 @@ PiiVideoFileWriter::PiiVideoFileWriter() :
 PiiVideoFileWriter::~PiiVideoFileWriter()
 {
   PII_D;
+  stopEncoder();
+  delete d->pEncoderThread;
   delete d->pVideoWriter;
 }
 
@@ -47,44 +56,116 @@ void PiiVideoFileWriter::process()
   using namespace PiiYdin;
   PiiVariant obj = d->pImageInput->firstObject();
 
-  if (d->iIndex == 0 )
+  switch (obj.type())
     {
-      switch (obj.type())
-        {
-          PII_INTEGER_MATRIX_CASES(initPiiVideoWriter, obj);
-          PII_UNSIGNED_MATRIX_CASES(initPiiVideoWriter, obj);
-          PII_FLOAT_MATRIX_CASES(initPiiVideoWriter, obj);
-        case UnsignedCharColorMatrixType:
-          initPiiVideoWriter<PiiColor<unsigned char> >(obj);
-          break;
-        case UnsignedCharColor4MatrixType:
-          initPiiVideoWriter<PiiColor4<unsigned char> >(obj);
-          break;
-        default:
-          PII_THROW_UNKNOWN_TYPE(d->pImageInput);
-        }
+      PII_INTEGER_MATRIX_CASES(checkFrame, obj);
+      PII_UNSIGNED_MATRIX_CASES(checkFrame, obj);
+      PII_FLOAT_MATRIX_CASES(checkFrame, obj);
+    case UnsignedCharColorMatrixType:
+      checkFrame<PiiColor<unsigned char> >(obj);
+      break;
+    case UnsignedCharColor4MatrixType:
+      checkFrame<PiiColor4<unsigned char> >(obj);
+      break;
+    default:
+      PII_THROW_UNKNOWN_TYPE(d->pImageInput);
+    }
+
+  if (d->iIndex == 0)
+    {
+      d->iDroppedFrameCount = 0;
+      d->strEncoderError.clear();
+      d->bEncoderRunning = true;
+      d->pEncoderThread->start();
+    }
+
+  enqueueFrame(obj);
+
+  ++d->iIndex;
+}
+
+void PiiVideoFileWriter::enqueueFrame(const PiiVariant& obj)
+{
+  PII_D;
+  QMutexLocker lock(&d->queueMutex);
+  if (d->dropPolicy == BlockWhenFull)
+    {
+      while (d->bEncoderRunning && d->queFrames.size() >= d->iQueueLength)
+        d->spaceAvailable.wait(&d->queueMutex);
     }
+  else if (d->queFrames.size() >= d->iQueueLength)
+    {
+      ++d->iDroppedFrameCount;
+      if (d->dropPolicy == DropNewest)
+        return;
+      d->queFrames.dequeue();
+    }
+
+  if (!d->bEncoderRunning)
+    PII_THROW(PiiExecutionException, d->strEncoderError);
+
+  d->queFrames.enqueue(obj);
+  d->frameAvailable.wakeOne();
+}
 
-  if (d->pVideoWriter != 0 )
+void PiiVideoFileWriter::encodeFrames()
+{
+  PII_D;
+  forever
     {
-      switch (obj.type())
+      PiiVariant obj;
+      {
+        QMutexLocker lock(&d->queueMutex);
+        while (d->bEncoderRunning && d->queFrames.isEmpty())
+          d->frameAvailable.wait(&d->queueMutex);
+        // Frames still in the queue will be encoded before exiting.
+        if (d->queFrames.isEmpty())
+          return;
+        obj = d->queFrames.dequeue();
+        d->spaceAvailable.wakeOne();
+      }
+
+      try
         {
-          PII_INTEGER_MATRIX_CASES(grayImage, obj);
-          PII_UNSIGNED_MATRIX_CASES(grayImage, obj);
-          PII_FLOAT_MATRIX_CASES(floatImage, obj);
-        case UnsignedCharColorMatrixType:
-          colorImage<PiiColor<unsigned char> >(obj);
-          break;
-        case UnsignedCharColor4MatrixType:
-          colorImage<PiiColor4<unsigned char> >(obj);
-          break;
-        default:
-          PII_THROW_UNKNOWN_TYPE(d->pImageInput);
+          encodeFrame(obj);
+        }
+      catch (PiiException& ex)
+        {
+          QMutexLocker lock(&d->queueMutex);
+          d->strEncoderError = ex.message();
+          d->queFrames.clear();
+          d->bEncoderRunning = false;
+          d->spaceAvailable.wakeAll();
+          return;
         }
     }
+}
 
-  ++d->iIndex;
+void PiiVideoFileWriter::encodeFrame(const PiiVariant& obj)
+{
+  using namespace PiiYdin;
+  switch (obj.type())
+    {
+      PII_INTEGER_MATRIX_CASES(grayImage, obj);
+      PII_UNSIGNED_MATRIX_CASES(grayImage, obj);
+      PII_FLOAT_MATRIX_CASES(floatImage, obj);
+    case UnsignedCharColorMatrixType:
+      colorImage<PiiColor<unsigned char> >(obj);
+      break;
+    case UnsignedCharColor4MatrixType:
+      colorImage<PiiColor4<unsigned char> >(obj);
+      break;
+    }
+}
 
+void PiiVideoFileWriter::stopEncoder()
+{
+  PII_D;
+  d->queueMutex.lock();
+  d->bEncoderRunning = false;
+  d->frameAvailable.wakeAll();
+  d->queueMutex.unlock();
+  d->pEncoderThread->wait();
 }
 
 void PiiVideoFileWriter::deletePiiVideoWriter(PiiOperation::State state)
@@ -93,12 +174,27 @@ void PiiVideoFileWriter::deletePiiVideoWriter(PiiOperation::State state)
 
   if ( state == PiiOperation::Stopped )
     {
+      // Flush the queue before closing the file.
+      stopEncoder();
       delete d->pVideoWriter;
       d->pVideoWriter = 0;
       d->iIndex = 0;
     }
 }
 
+template <class T> void PiiVideoFileWriter::checkFrame(const PiiVariant& obj)
+{
+  PII_D;
+  if (d->iIndex == 0)
+    initPiiVideoWriter<T>(obj);
+  else
+    {
+      const PiiMatrix<T> mat = obj.valueAs<PiiMatrix<T> >();
+      if (mat.columns() != d->iWidth || mat.rows() != d->iHeight)
+        PII_THROW(PiiExecutionException, tr("Input frame might be corrupted."));
+    }
+}
+
 template <class T> void PiiVideoFileWriter::initPiiVideoWriter(const PiiVariant& obj)
 {
   PII_D;
@@ -125,6 +221,7 @@ template <class T> void PiiVideoFileWriter::initPiiVideoWriter(const PiiVariant&
        d->pVideoWriter->setHeight(d->iHeight);
        d->pVideoWriter->setFrameRate(d->iFrameRate);
      }
+   d->pVideoWriter->setEncoderName(d->strEncoder);
 
    try
      {
@@ -143,52 +240,24 @@ template <class T> void PiiVideoFileWriter::grayImage( const PiiVariant& obj )
 {
   PII_D;
   const PiiMatrix<T> mat = obj.valueAs<PiiMatrix<T> >();
-  bool bSave = false;
-  if ( mat.columns() == d->iWidth || mat.rows() == d->iHeight )
-    bSave = d->pVideoWriter->saveNextGrayFrame(PiiMatrix<unsigned char>(mat));
-  else
-    {
-      PII_THROW(PiiExecutionException, tr("Input frame might be corrupted."));
-    }
-  if(!bSave)
-    {
-      PII_THROW(PiiExecutionException, tr("Input frame was not saved correctly"));
-    }
+  if (!d->pVideoWriter->saveNextGrayFrame(PiiMatrix<unsigned char>(mat)))
+    PII_THROW(PiiExecutionException, tr("Input frame was not saved correctly"));
 }
 
 template <class T> void PiiVideoFileWriter::floatImage( const PiiVariant& obj )
 {
   PII_D;
   const PiiMatrix<T> mat = obj.valueAs<PiiMatrix<T> >();
-  bool bSave = false;
-  if ( mat.columns() == d->iWidth || mat.rows() == d->iHeight )
-    d->pVideoWriter->saveNextGrayFrame(PiiMatrix<unsigned char>(mat * 255));
-  else
-    {
-      PII_THROW(PiiExecutionException, tr("Input frame might be corrupted."));
-    }
-   if(!bSave)
-    {
-      PII_THROW(PiiExecutionException, tr("Input frame was not saved correctly"));
-    }
+  if (!d->pVideoWriter->saveNextGrayFrame(PiiMatrix<unsigned char>(mat * 255)))
+    PII_THROW(PiiExecutionException, tr("Input frame was not saved correctly"));
 }
 
 template <class T> void PiiVideoFileWriter::colorImage( const PiiVariant& obj )
 {
   PII_D;
   const PiiMatrix<T> mat = obj.valueAs<PiiMatrix<T> >();
-  bool bSave = false;
-  if ( mat.columns() == d->iWidth || mat.rows() == d->iHeight )
-    d->pVideoWriter->saveNextColorFrame(PiiMatrix<PiiColor<unsigned char> >(mat));
-  else
-    {
-      PII_THROW(PiiExecutionException, tr("Input frame might be corrupted."));
-    }
-  if(!bSave)
-    {
-      PII_THROW(PiiExecutionException, tr("Input frame was not saved correctly"));
-    }
-
+  if (!d->pVideoWriter->saveNextColorFrame(PiiMatrix<PiiColor<unsigned char> >(mat)))
+    PII_THROW(PiiExecutionException, tr("Input frame was not saved correctly"));
 }
 
 QString PiiVideoFileWriter::outputDirectory() const { return _d()->strOutputDirectory; }
@@ -197,3 +266,20 @@ QString PiiVideoFileWriter::fileName() const { return _d()->strFileName; }
 void PiiVideoFileWriter::setFileName(const QString& fileName) { _d()->strFileName = fileName; }
 int PiiVideoFileWriter::frameRate() const { return _d()->iFrameRate; }
 void PiiVideoFileWriter::setFrameRate(int frameRate) { _d()->iFrameRate = frameRate; }
+QString PiiVideoFileWriter::encoder() const { return _d()->strEncoder; }
+void PiiVideoFileWriter::setEncoder(const QString& encoder) { _d()->strEncoder = encoder; }
+int PiiVideoFileWriter::queueLength() const { return _d()->iQueueLength; }
+void PiiVideoFileWriter::setQueueLength(int queueLength)
+{
+  PII_D;
+  QMutexLocker lock(&d->queueMutex);
+  d->iQueueLength = qMax(1, queueLength);
+}
+PiiVideoFileWriter::DropPolicy PiiVideoFileWriter::dropPolicy() const { return _d()->dropPolicy; }
+void PiiVideoFileWriter::setDropPolicy(DropPolicy dropPolicy) { _d()->dropPolicy = dropPolicy; }
+int PiiVideoFileWriter::droppedFrameCount() const
+{
+  const PII_D;
+  QMutexLocker lock(&d->queueMutex);
+  return d->iDroppedFrameCount;
+}
@@ -18,6 +18,9 @@
 
 #include <PiiDefaultOperation.h>
 #include <PiiQImage.h>
+#include <QQueue>
+#include <QMutex>
+#include <QWaitCondition>
 
 #include "PiiVideoException.h"
 #include "PiiVideoGlobal.h"
@@ -28,6 +31,16 @@
  * formats. If a video with the same name already exists,
  * it will be overwritten.
  *
+ * Frames are not encoded in [process()]. Instead, incoming frames are
+ * placed into a bounded queue that is emptied by a separate encoder
+ * thread. The only work done on the processing thread is checking the
+ * type and size of the frame and appending a reference to it into the
+ * queue. Since matrices are implicitly shared, no pixel data will be
+ * copied. What happens when the encoder cannot keep up with the
+ * incoming frame rate is controlled by [dropPolicy]. Errors in the
+ * encoder thread will be reported by throwing an exception from the
+ * next call to [process()].
+ *
  * Inputs
  * ------
  *
@@ -54,10 +67,58 @@ class PII_VIDEO_EXPORT PiiVideoFileWriter : public PiiDefaultOperation
    */
   Q_PROPERTY(int frameRate READ frameRate WRITE setFrameRate);
 
+  /**
+   * The name of the libavcodec encoder to use. If this property is
+   * empty (the default), the default encoder of the output format
+   * (deduced from the [fileName] extension) will be used. Set this
+   * value to select a specific (e.g. hardware-accelerated) encoder
+   * such as "h264_nvenc" or "libx264". The encoder must accept
+   * YUV 4:2:0 frames in system memory. Encoders that only take frames
+   * in device memory (such as "h264_vaapi") are not supported. See
+   * [PiiVideoWriter::setEncoderName()].
+   */
+  Q_PROPERTY(QString encoder READ encoder WRITE setEncoder);
+
+  /**
+   * The maximum number of frames waiting for the encoder thread. The
+   * default is 16.
+   */
+  Q_PROPERTY(int queueLength READ queueLength WRITE setQueueLength);
+
+  /**
+   * The action to take when the frame queue is full. The default is
+   * `BlockWhenFull`.
+   */
+  Q_PROPERTY(DropPolicy dropPolicy READ dropPolicy WRITE setDropPolicy);
+  Q_ENUMS(DropPolicy);
+
+  /**
+   * The number of frames discarded due to a full queue since the
+   * operation was last started.
+   */
+  Q_PROPERTY(int droppedFrameCount READ droppedFrameCount);
+
 
   PII_OPERATION_SERIALIZATION_FUNCTION
 
 public:
+  /**
+   * Actions to take when the encoder cannot keep up with the incoming
+   * frame rate.
+   *
+   * - `BlockWhenFull` - wait until the encoder thread has taken a
+   * frame out of the queue. No frames will be lost, but a slow encoder
+   * will eventually stall the processing pipeline.
+   *
+   * - `DropNewest` - discard the incoming frame. The processing thread
+   * will never be blocked.
+   *
+   * - `DropOldest` - discard the oldest frame in the queue to make room
+   * for the incoming one. The processing thread will never be
+   * blocked.
+   */
+  enum DropPolicy { BlockWhenFull, DropNewest, DropOldest };
+
   PiiVideoFileWriter();
   virtual ~PiiVideoFileWriter();
 
@@ -70,6 +131,17 @@ public:
   int frameRate() const;
   void setFrameRate(int frameRate);
 
+  QString encoder() const;
+  void setEncoder(const QString& encoder);
+
+  int queueLength() const;
+  void setQueueLength(int queueLength);
+
+  DropPolicy dropPolicy() const;
+  void setDropPolicy(DropPolicy dropPolicy);
+
+  int droppedFrameCount() const;
+
 protected:
   void process();
 
@@ -77,7 +149,13 @@ private slots:
   void deletePiiVideoWriter(PiiOperation::State state);
 
 private:
+  void encodeFrames();
+  void encodeFrame(const PiiVariant& obj);
+  void enqueueFrame(const PiiVariant& obj);
+  void stopEncoder();
+
   template <class T> void initPiiVideoWriter(const PiiVariant& obj);
+  template <class T> void checkFrame(const PiiVariant& obj);
   template <class T> void grayImage(const PiiVariant& obj);
   template <class T> void floatImage(const PiiVariant& obj);
   template <class T> void colorImage(const PiiVariant& obj);
@@ -90,9 +168,20 @@ private:
 
     QString strOutputDirectory, strFileName;
     int iIndex, iWidth, iHeight, iFrameRate;
+    QString strEncoder;
+    int iQueueLength;
+    DropPolicy dropPolicy;
+    int iDroppedFrameCount;
 
     PiiVideoWriter *pVideoWriter;
     PiiInputSocket* pImageInput;
+
+    QQueue<PiiVariant> queFrames;
+    mutable QMutex queueMutex;
+    QWaitCondition frameAvailable, spaceAvailable;
+    QThread* pEncoderThread;
+    bool bEncoderRunning;
+    QString strEncoderError;
   };
   PII_D_FUNC;
 };
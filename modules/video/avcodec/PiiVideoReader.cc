@@ -17,6 +17,20 @@
 #include <PiiFraction.h>
 #include "avcodec_hacks.h"
 #include <imgconvert.h>
+#include <QThread>
+#include <algorithm>
+#include <cstring>
+
+#ifndef AV_PKT_FLAG_KEY
+#  define AV_PKT_FLAG_KEY PKT_FLAG_KEY
+#endif
+
+// Frame threading and AVFrame::pkt_pts appeared at the same time.
+// Older versions can only decode slices in parallel, and the pts of
+// a decoded frame is that of the packet that completed it.
+#if LIBAVCODEC_VERSION_INT >= AV_VERSION_INT(53, 5, 0)
+#  define PII_AVCODEC_FRAME_THREADS
+#endif
 
 PiiVideoReader::Data::Data(const QString& fileName) :
   pFormatCtx(0),
@@ -28,6 +42,7 @@ PiiVideoReader::Data::Data(const QString& fileName) :
   iLastFramePts(0),
   iTargetPts(0),
   bTargetChanged(false),
+  iThreadCount(0),
   strFileName(fileName)
 {
 }
@@ -67,6 +82,21 @@ QString PiiVideoReader::fileName() const
   return d->strFileName;
 }
 
+void PiiVideoReader::setThreadCount(int threadCount)
+{
+  d->iThreadCount = qMax(0, threadCount);
+}
+
+int PiiVideoReader::threadCount() const
+{
+  return d->iThreadCount;
+}
+
+int PiiVideoReader::keyFrameCount() const
+{
+  return d->vecKeyFrames.size();
+}
+
 void PiiVideoReader::initialize() throw(PiiVideoException&)
 {
   // Free frame.
@@ -132,6 +162,18 @@ void PiiVideoReader::initialize() throw(PiiVideoException&)
   if (pCodec->capabilities & CODEC_CAP_TRUNCATED)
     d->pCodecCtx->flags |= CODEC_FLAG_TRUNCATED;
 
+  // Let libavcodec decode in parallel.
+  if (d->iThreadCount != 1)
+    {
+      const int iThreads = d->iThreadCount > 0 ? d->iThreadCount : QThread::idealThreadCount();
+#ifdef PII_AVCODEC_FRAME_THREADS
+      d->pCodecCtx->thread_count = iThreads;
+      d->pCodecCtx->thread_type = FF_THREAD_FRAME | FF_THREAD_SLICE;
+#else
+      avcodec_thread_init(d->pCodecCtx, iThreads);
+#endif
+    }
+
   // Open codec
   if (avcodec_open(d->pCodecCtx, pCodec) < 0)
     PII_THROW(PiiVideoException, tr("Couldn't open codec."));
@@ -164,6 +206,8 @@ void PiiVideoReader::initialize() throw(PiiVideoException&)
   d->iTargetPts = 0;
   d->bTargetChanged = false;
 
+  buildKeyFrameIndex();
+
   // Allocate a video frame
   d->pFrame = avcodec_alloc_frame();
 
@@ -178,6 +222,50 @@ void PiiVideoReader::initialize() throw(PiiVideoException&)
   */
 }
 
+void PiiVideoReader::buildKeyFrameIndex()
+{
+  // Demuxing is cheap compared to decoding. Read through the packets
+  // once and remember where the key frames are.
+  d->vecKeyFrames.clear();
+  AVPacket packet;
+  while (AV_READ_FRAME(d->pFormatCtx, &packet) >= 0)
+    {
+      if (packet.stream_index == d->iVideoStream &&
+          (packet.flags & AV_PKT_FLAG_KEY) &&
+          packet.pts != int64_t(AV_NOPTS_VALUE))
+        d->vecKeyFrames << packet.pts;
+      av_free_packet(&packet);
+    }
+  std::sort(d->vecKeyFrames.begin(), d->vecKeyFrames.end());
+  av_seek_frame(d->pFormatCtx, d->iVideoStream, 0, AVSEEK_FLAG_BACKWARD);
+}
+
+int64_t PiiVideoReader::keyFrameBefore(int64_t pts) const
+{
+  // The last key frame whose pts is not larger than pts
+  QVector<int64_t>::const_iterator i = std::upper_bound(d->vecKeyFrames.begin(), d->vecKeyFrames.end(), pts);
+  return i == d->vecKeyFrames.begin() ? int64_t(AV_NOPTS_VALUE) : *(i-1);
+}
+
+bool PiiVideoReader::seekTo(int64_t targetPts)
+{
+  int64_t iKeyFrame = keyFrameBefore(targetPts);
+  // No need to seek if decoding forward reaches the target without
+  // passing a key frame.
+  if (targetPts > d->iLastFramePts &&
+      (iKeyFrame == int64_t(AV_NOPTS_VALUE) || iKeyFrame <= d->iLastFramePts) &&
+      !d->vecKeyFrames.isEmpty())
+    return true;
+
+  if (iKeyFrame == int64_t(AV_NOPTS_VALUE))
+    iKeyFrame = d->vecKeyFrames.isEmpty() ? targetPts : d->vecKeyFrames[0];
+  if (av_seek_frame(d->pFormatCtx, d->iVideoStream, iKeyFrame, AVSEEK_FLAG_BACKWARD) < 0)
+    return false;
+  // Discard frames buffered inside the decoder.
+  avcodec_flush_buffers(d->pCodecCtx);
+  return true;
+}
+
 bool PiiVideoReader::getFrame(AVFrame *frame, int frameStep = 1)
 {
   AVPacket packet;
@@ -187,7 +275,7 @@ bool PiiVideoReader::getFrame(AVFrame *frame, int frameStep = 1)
 
   /**
    * If the target of the next frame has changed OR frameStep != 1, we
-   * must to seek the stream.
+   * must find the target frame.
    */
   if (d->bTargetChanged || frameStep != 1)
     {
@@ -199,18 +287,11 @@ bool PiiVideoReader::getFrame(AVFrame *frame, int frameStep = 1)
       d->bTargetChanged = false;
       bSeeked = true;
 
-
-      // Seek the video stream to the next target
-      if (av_seek_frame(d->pFormatCtx, d->iVideoStream, d->iTargetPts, frameStep < 0 ? AVSEEK_FLAG_BACKWARD : 0) < 0)
+      if (!seekTo(d->iTargetPts))
         return false;
-
-      d->pCodecCtx->skip_frame = AVDISCARD_BIDIR;
     }
   else
-    {
-      d->pCodecCtx->skip_frame = AVDISCARD_DEFAULT;
-      d->iTargetPts = d->iLastFramePts + d->iFrameTime;
-    }
+    d->iTargetPts = d->iLastFramePts + d->iFrameTime;
 
   while (AV_READ_FRAME(d->pFormatCtx, &packet) >= 0)
     {
@@ -229,10 +310,15 @@ bool PiiVideoReader::getFrame(AVFrame *frame, int frameStep = 1)
             }
           if (iFrameFinished)
             {
-              // Full video frame received. Store the presentation
-              // time stamp of the packet as the last decoded frame
-              // time (global stream pos).
+              // Full video frame received. Store its presentation
+              // time stamp as the last decoded frame time (global
+              // stream pos). With frame threads, the packet that
+              // completes a frame is not the one it came from.
+#ifdef PII_AVCODEC_FRAME_THREADS
+              d->iLastFramePts = frame->pkt_pts != int64_t(AV_NOPTS_VALUE) ? frame->pkt_pts : packet.pts;
+#else
               d->iLastFramePts = packet.pts;
+#endif
 
               // If we weren't seeking, return now. Otherwise continue
               // until we hit the correct position.
@@ -263,10 +349,13 @@ template <> PiiMatrix<unsigned char> PiiVideoReader::getFrame(int frameStep)
   */
   if (bSuccess)
     {
-      PiiMatrix<unsigned char> matResult(d->pCodecCtx->height,
-                                         d->pCodecCtx->width,
-                                         static_cast<unsigned char*>(d->pFrame->data[0]),
-                                         d->pFrame->linesize[0]);
+      // The decoder reuses its frame buffers. Copy the luminance
+      // plane to a (pooled) buffer of our own.
+      const int iRows = d->pCodecCtx->height, iColumns = d->pCodecCtx->width;
+      PiiMatrix<unsigned char> matResult(PiiMatrix<unsigned char>::uninitialized(iRows, iColumns));
+      const unsigned char* pSource = d->pFrame->data[0];
+      for (int r=0; r<iRows; ++r, pSource += d->pFrame->linesize[0])
+        std::memcpy(matResult[r], pSource, iColumns);
       return matResult;
     }
 
@@ -287,40 +376,20 @@ template <> PiiMatrix<PiiColor4<> > PiiVideoReader::getFrame(int frameStep)
 
   if (bSuccess)
     {
-      // Allocate an AVFrame structure for conversion result
-      AVFrame *pResultFrame = avcodec_alloc_frame();
-      if (pResultFrame == 0)
+      // Convert straight into a (pooled) matrix buffer.
+      PiiMatrix<PiiColor4<> > matResult(PiiMatrix<PiiColor4<> >::uninitialized(d->pCodecCtx->height,
+                                                                               d->pCodecCtx->width));
+      AVPicture result;
+      std::memset(&result, 0, sizeof(result));
+      result.data[0] = reinterpret_cast<uint8_t*>(matResult.row(0));
+      result.linesize[0] = int(matResult.stride());
+
+      // Convert color space
+      if (IMGCONVERT(&result, PIX_FMT_RGB32, (AVPicture*)d->pFrame,
+                     d->pCodecCtx->pix_fmt, d->pCodecCtx->width, d->pCodecCtx->height) < 0)
         return PiiMatrix<PiiColor4<> >();
 
-      // Malloc ensures we can safely leave the buffer to PiiMatrix.
-      void* bfr = ::malloc(avpicture_get_size(PIX_FMT_RGB32, d->pCodecCtx->width, d->pCodecCtx->height));
-
-      if (bfr == 0)
-        {
-          av_free(pResultFrame);
-          return PiiMatrix<PiiColor4<> >();
-        }
-
-      // Assign appropriate parts of buffer to image planes in pResultFrame
-      avpicture_fill((AVPicture *)pResultFrame, (uint8_t*)bfr, PIX_FMT_RGB32,
-                     d->pCodecCtx->width, d->pCodecCtx->height);
-
-      // Convert color space (this stores the result into bfr)
-      int iResult = IMGCONVERT((AVPicture *)pResultFrame, PIX_FMT_RGB32, (AVPicture*)d->pFrame,
-                               d->pCodecCtx->pix_fmt, d->pCodecCtx->width, d->pCodecCtx->height);
-
-      // Get rid of the conversion result frame. This does not free
-      // the data buffer itself.
-      av_free(pResultFrame);
-
-      if (iResult < 0)
-        {
-          free(bfr);
-          return PiiMatrix<PiiColor4<> >();
-        }
-
-      // Let PiiMatrix take the ownership of the buffer.
-      return PiiMatrix<PiiColor4<> >(d->pCodecCtx->height, d->pCodecCtx->width, bfr, Pii::ReleaseOwnership, 0);
+      return matResult;
     }
   return PiiMatrix<PiiColor4<> >();
 }
@@ -23,6 +23,7 @@ extern "C"
 }
 
 #include <QString>
+#include <QVector>
 #include <PiiMatrix.h>
 #include <PiiColor.h>
 #include <PiiVideoException.h>
@@ -92,7 +93,14 @@ public:
    *
    * @param skipFrames skip this many frames before encoding a frame.
    * -1 seeks the video stream back one frame and essentially
-   * re-decodes the previous frame.
+   * re-decodes the previous frame. If there is a key frame between
+   * the current position and the target, the stream is sought to the
+   * last key frame before the target. Otherwise, the frames in between
+   * are decoded.
+   *
+   * The returned matrix owns its data. The frame is copied or
+   * converted into a pooled matrix buffer; it remains valid even
+   * after subsequent calls.
    *
    * @return the next video frame in the stream or an empty matrix if
    * an error occurs.
@@ -109,6 +117,26 @@ public:
    */
   QString fileName() const;
 
+  /**
+   * Set the number of threads libavcodec uses for decoding. Codecs
+   * that support it decode many frames or slices in parallel. Zero
+   * means one thread per processor core, and one disables threaded
+   * decoding. The default is zero. This function has no effect after
+   * initialize().
+   */
+  void setThreadCount(int threadCount);
+  /**
+   * Get the number of decoding threads.
+   */
+  int threadCount() const;
+
+  /**
+   * Returns the number of key frames found in the video stream. The
+   * key frames are indexed by initialize(), which makes it possible to
+   * skip frames by seeking instead of decoding through them.
+   */
+  int keyFrameCount() const;
+
   /**
    * Seek at begin of the stream.
    */
@@ -127,6 +155,9 @@ private:
    * case of a reading error.
    */
   bool getFrame(AVFrame* frame, int skipFrames);
+  void buildKeyFrameIndex();
+  bool seekTo(int64_t targetPts);
+  int64_t keyFrameBefore(int64_t pts) const;
 
   static QString tr(const char* text) { return QCoreApplication::translate("PiiVideoReader", text); }
 
@@ -156,6 +187,9 @@ private:
     // The flag which tell if iTargetPts has changed outside of the
     // getFrame()-function (for example seekToBegin() or seekToEnd())
     bool bTargetChanged;
+    // Presentation time stamps of key frames, in ascending order.
+    QVector<int64_t> vecKeyFrames;
+    int iThreadCount;
 
     QString strFileName;
   } *d;
@@ -18,7 +18,7 @@
 #include <PiiColor.h>
 
 PiiVideoWriter::Data::Data(const QString& fileName, int width, int height, int frameRate) :
-  strFileName(fileName), pFmt(0), pOc(0), iWidth(width), iHeight(height), iFrameRate(frameRate), pPicture(0),
+  strFileName(fileName), pEncoder(0), pFmt(0), pOc(0), iWidth(width), iHeight(height), iFrameRate(frameRate), pPicture(0),
   pVideost(0), dVideopts(0), pVideooutbuf(0), iFramecount(0), iVideooutbufsize(0)
 {
 }
@@ -150,8 +150,21 @@ bool PiiVideoWriter::allocateMediaContext()
 bool PiiVideoWriter::initializeCodec()
 {
   d->pVideost = 0;
-  if (d->pFmt->video_codec != CODEC_ID_NONE)
-    d->pVideost = add_video_stream(d->pOc, d->pFmt->video_codec);
+  d->pEncoder = 0;
+  CodecID codecId = d->pFmt->video_codec;
+  if (!d->strEncoderName.isEmpty())
+    {
+      d->pEncoder = avcodec_find_encoder_by_name(d->strEncoderName.toAscii().constData());
+      if (d->pEncoder == 0 || d->pEncoder->type != CODEC_TYPE_VIDEO)
+        {
+          QString message = QString("Could not find video encoder \"%1\".").arg(d->strEncoderName);
+          PII_THROW(PiiVideoException, message.toAscii().constData());
+        }
+      codecId = d->pEncoder->id;
+    }
+
+  if (codecId != CODEC_ID_NONE)
+    d->pVideost = add_video_stream(d->pOc, codecId);
 
   if (!d->pVideost)
     return false;
@@ -253,11 +266,24 @@ void PiiVideoWriter::open_video(AVFormatContext *oc, AVStream *st)
   c = st->codec;
 
   // find the video encoder
-  codec = avcodec_find_encoder(c->codec_id);
+  codec = d->pEncoder != 0 ? d->pEncoder : avcodec_find_encoder(c->codec_id);
 
   if (codec == 0)
     PII_THROW(PiiVideoException, "Could not find suitable codec");
 
+  // Frames are always converted to YUV420P in system memory.
+  if (codec->pix_fmts != 0)
+    {
+      const PixelFormat* pFormat = codec->pix_fmts;
+      while (*pFormat != -1 && *pFormat != c->pix_fmt)
+        ++pFormat;
+      if (*pFormat == -1)
+        {
+          QString message = QString("Encoder \"%1\" does not accept YUV420P frames.").arg(codec->name);
+          PII_THROW(PiiVideoException, message.toAscii().constData());
+        }
+    }
+
   // open the codec
   if (avcodec_open(c, codec) < 0)
     PII_THROW(PiiVideoException,"Could not open codec");
@@ -507,3 +533,5 @@ int PiiVideoWriter::height() const { return d->iHeight; }
 void PiiVideoWriter::setSize(int width, int height) { d->iWidth = width; d->iHeight = height; }
 void PiiVideoWriter::setFrameRate(int frameRate) { d->iFrameRate = frameRate; }
 int PiiVideoWriter::frameRate() const { return d->iFrameRate; }
+void PiiVideoWriter::setEncoderName(const QString& encoderName) { d->strEncoderName = encoderName; }
+QString PiiVideoWriter::encoderName() const { return d->strEncoderName; }
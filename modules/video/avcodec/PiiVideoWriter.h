@@ -66,6 +66,22 @@ public:
   void setFrameRate( int frameRate );
   int frameRate() const;
 
+  /**
+   * Selects the encoder by name. If *encoderName* is empty (the
+   * default), the default encoder of the output format will be used.
+   * Otherwise, the encoder is looked up with
+   * `avcodec_find_encoder_by_name()`, which makes it possible to
+   * choose between different implementations of the same codec, for
+   * example "libx264", "h264_nvenc" or "h264_qsv". The name must be
+   * set before [initialize()] is called.
+   *
+   * Frames are passed to the encoder as YUV 4:2:0 images in system
+   * memory. Encoders that do not support this pixel format, such as
+   * the VAAPI encoders that require frames in device memory, will be
+   * rejected by [initialize()].
+   */
+  void setEncoderName(const QString& encoderName);
+  QString encoderName() const;
 
 protected:
   bool allocateMediaContext();
@@ -93,7 +109,8 @@ private:
   public:
     Data(const QString& fileName, int width, int height, int frameRate);
 
-    QString         strFileName;
+    QString         strFileName, strEncoderName;
+    AVCodec         *pEncoder;
     AVOutputFormat  *pFmt;
     AVFormatContext *pOc;
     int             iWidth, iHeight, iFrameRate;
@@ -21,6 +21,7 @@
 #include <PiiYdinTypes.h>
 #include <PiiColor.h>
 #include <PiiQImage.h>
+#include <PiiTimer.h>
 
 #include <QMap>
 #include <QMutexLocker>
@@ -35,32 +36,53 @@
 struct PiiQmlImageProvider::Slot
 {
   Slot() :
+    iSerial(0),
     pProbe(0),
     pListener(0),
-    iMethodIndex(-1)
+    iMethodIndex(-1),
+    bUpdatePending(false),
+    iNotificationTime(0)
   {}
   Slot(const Slot& other) :
     varImage(other.varImage),
+    image(other.image),
+    iSerial(other.iSerial),
     pProbe(0),
     pListener(other.pListener),
-    iMethodIndex(other.iMethodIndex)
+    iMethodIndex(other.iMethodIndex),
+    bUpdatePending(other.bUpdatePending),
+    iNotificationTime(other.iNotificationTime)
   {}
 
   Slot& operator= (const Slot& other)
   {
     varImage = other.varImage;
+    image = other.image;
+    iSerial = other.iSerial;
     pProbe = other.pProbe;
     pListener = other.pListener;
     iMethodIndex = other.iMethodIndex;
+    bUpdatePending = other.bUpdatePending;
+    iNotificationTime = other.iNotificationTime;
     return *this;
   }
 
   PiiVariant varImage;
+  // varImage converted to a QImage, or a null image if not converted yet.
+  QImage image;
+  // Incremented whenever varImage changes.
+  unsigned int iSerial;
   PiiProbeInput* pProbe;
   QObject* pListener;
   int iMethodIndex;
+  // true if the listener has been notified but not fetched the image yet.
+  bool bUpdatePending;
+  qint64 iNotificationTime;
 };
 
+// Re-notify a listener that hasn't requested its image in a second.
+static const qint64 iMaxPendingTime = 1000000;
+
 class PiiQmlImageProvider::Data
 {
 public:
@@ -102,15 +124,27 @@ QImage PiiQmlImageProvider::requestImage(const QString& slot, QSize* size, const
       d->slotMutex.unlock();
       return QImage();
     }
+  it->bUpdatePending = false;
   PiiVariant varImage = it->varImage;
+  QImage qImage = it->image;
+  unsigned int iSerial = it->iSerial;
   d->slotMutex.unlock();
 
-  QImage qImage;
-  switch (varImage.type())
+  // Many views may request the same image. Convert only once.
+  if (qImage.isNull() && varImage.isValid())
     {
-      PII_ALL_IMAGE_CASES(qImage = matrixToQImage, varImage);
-    default:
-      qImage = varImage.convertTo<QImage>();
+      switch (varImage.type())
+        {
+          PII_ALL_IMAGE_CASES(qImage = matrixToQImage, varImage);
+        default:
+          qImage = varImage.convertTo<QImage>();
+        }
+      synchronized (d->slotMutex)
+        {
+          it = d->mapSlots.find(strSlot);
+          if (it != d->mapSlots.end() && it->iSerial == iSerial)
+            it->image = qImage;
+        }
     }
 
   *size = qImage.size();
@@ -122,7 +156,7 @@ QImage PiiQmlImageProvider::requestImage(const QString& slot, QSize* size, const
 
 template <class T> QImage PiiQmlImageProvider::matrixToQImage(const PiiVariant& image)
 {
-  return Pii::matrixToQImage(image.valueAs<PiiMatrix<T> >());
+  return Pii::matrixToSharedQImage(image.valueAs<PiiMatrix<T> >());
 }
 
 void PiiQmlImageProvider::removeSlot(const QString& slot)
@@ -147,6 +181,7 @@ bool PiiQmlImageProvider::setListener(const QString& slot, QObject* listener)
           Slot& s = d->mapSlots[slot];
           s.pListener = listener;
           s.iMethodIndex = iMethodIndex;
+          s.bUpdatePending = false;
         }
       connect(listener, SIGNAL(destroyed(QObject*)), SLOT(removeListener(QObject*)));
     }
@@ -242,6 +277,8 @@ bool PiiQmlImageProvider::storeImage(const QString& slot, const PiiVariant& imag
       QMutexLocker lock(&d->slotMutex);
       Slot& s = d->mapSlots[slot];
       s.varImage = image;
+      s.image = QImage();
+      ++s.iSerial;
 
       /* Always pass the signal through the event queue even if the
        * listener was in the same thread. This way the listener will
@@ -250,11 +287,21 @@ bool PiiQmlImageProvider::storeImage(const QString& slot, const PiiVariant& imag
        * function will be called from a different thread, and the call
        * would have to be queued through the main thread's event loop
        * anyway.
+       *
+       * If the listener hasn't fetched the previous image yet, it will
+       * get this one instead. There is no need to queue another call,
+       * unless the listener seems to have ignored the previous one.
        */
-      if (s.pListener)
-        s.pListener->metaObject()->method(s.iMethodIndex).invoke(s.pListener,
-                                                                 Qt::QueuedConnection,
-                                                                 Q_ARG(QVariant, slot));
+      qint64 iNow = PiiTimer::currentTime();
+      if (s.pListener &&
+          (!s.bUpdatePending || iNow - s.iNotificationTime > iMaxPendingTime))
+        {
+          s.bUpdatePending = true;
+          s.iNotificationTime = iNow;
+          s.pListener->metaObject()->method(s.iMethodIndex).invoke(s.pListener,
+                                                                   Qt::QueuedConnection,
+                                                                   Q_ARG(QVariant, slot));
+        }
       return true;
     }
   return false;
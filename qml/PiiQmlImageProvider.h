@@ -25,7 +25,13 @@ class PiiProbeInput;
 
 /**
  * An image provider that stores images coming from operations and
- * converts PiiMatrix instances to QImages.
+ * converts PiiMatrix instances to QImages. Gray-level and
+ * four-channel color images are wrapped into QImages without copying
+ * the pixel data (see [Pii::matrixToSharedQImage()]). The converted
+ * image is cached until a new image is stored into the same slot, so
+ * that many views can request the same image cheaply. If images
+ * arrive faster than a listener fetches them, the listener is
+ * notified only once per fetched image.
  *
  * ~~~(qml)
  * Image
@@ -20,6 +20,102 @@
 #include <PiiVariant.h>
 #include <PiiYdinTypes.h>
 
+template <class T> static double readMatrixElement(const char* ptr)
+{
+  return double(*reinterpret_cast<const T*>(ptr));
+}
+
+PiiVariantScriptObject::PiiVariantScriptObject(const PiiVariant& var) :
+  variant(var),
+  _pMatrixData(0),
+  _iStride(0), _iElementSize(0), _iRows(0), _iColumns(0),
+  _pElementFunc(0)
+{}
+
+template <class T> void PiiVariantScriptObject::initMatrixView()
+{
+  const PiiMatrix<T>& mat = variant.valueAs<PiiMatrix<T> >();
+  _iRows = mat.rows();
+  _iColumns = mat.columns();
+  if (_iRows * _iColumns == 0)
+    _iRows = _iColumns = 0;
+  else
+    _pMatrixData = reinterpret_cast<const char*>(mat.row(0));
+  _iStride = int(mat.stride());
+  _iElementSize = int(sizeof(T));
+  _pElementFunc = readMatrixElement<T>;
+}
+
+QScriptValue PiiVariantScriptObject::matrix()
+{
+  if (_pElementFunc == 0)
+    {
+      switch (variant.type())
+        {
+          PII_NUMERIC_MATRIX_CASES(initMatrixView, ());
+        default:
+          return engine()->nullValue();
+        }
+    }
+  PiiMatrixScriptClass* pClass = engine()->findChild<PiiMatrixScriptClass*>();
+  // The view refers to this wrapper, which keeps the matrix alive.
+  return engine()->newObject(pClass, thisObject());
+}
+
+PiiMatrixScriptClass::PiiMatrixScriptClass(QScriptEngine* engine) :
+  QObject(engine),
+  QScriptClass(engine),
+  _strLength(engine->toStringHandle("length")),
+  _strRows(engine->toStringHandle("rows")),
+  _strColumns(engine->toStringHandle("columns"))
+{}
+
+PiiVariantScriptObject* PiiMatrixScriptClass::viewedObject(const QScriptValue& object)
+{
+  return static_cast<PiiVariantScriptObject*>(object.data().toQObject());
+}
+
+PiiMatrixScriptClass::QueryFlags PiiMatrixScriptClass::queryProperty(const QScriptValue& object,
+                                                                     const QScriptString& name,
+                                                                     QueryFlags flags, uint* id)
+{
+  if (name == _strLength || name == _strRows || name == _strColumns)
+    return flags & HandlesReadAccess;
+  bool bIsIndex = false;
+  uint uiIndex = name.toArrayIndex(&bIsIndex);
+  if (!bIsIndex)
+    return 0;
+  PiiVariantScriptObject* pObject = viewedObject(object);
+  if (uiIndex >= uint(pObject->matrixRows() * pObject->matrixColumns()))
+    return 0;
+  *id = uiIndex;
+  return flags & HandlesReadAccess;
+}
+
+QScriptValue PiiMatrixScriptClass::property(const QScriptValue& object, const QScriptString& name, uint id)
+{
+  PiiVariantScriptObject* pObject = viewedObject(object);
+  if (name == _strLength)
+    return QScriptValue(pObject->matrixRows() * pObject->matrixColumns());
+  else if (name == _strRows)
+    return QScriptValue(pObject->matrixRows());
+  else if (name == _strColumns)
+    return QScriptValue(pObject->matrixColumns());
+  return QScriptValue(pObject->matrixElement(int(id)));
+}
+
+QScriptValue::PropertyFlags PiiMatrixScriptClass::propertyFlags(const QScriptValue&, const QScriptString& name, uint)
+{
+  if (name == _strLength || name == _strRows || name == _strColumns)
+    return QScriptValue::ReadOnly | QScriptValue::Undeletable | QScriptValue::SkipInEnumeration;
+  return QScriptValue::ReadOnly | QScriptValue::Undeletable;
+}
+
+QString PiiMatrixScriptClass::name() const
+{
+  return "PiiMatrixView";
+}
+
 QString PiiVariantScriptObject::toString() const
 {
   return PiiYdin::convertToQString(variant);
@@ -82,10 +178,14 @@ namespace PiiVariantWrapper
     if (pWrapper != 0)
       var = pWrapper->variant;
   }
+
+  PII_SEQUENCE_CONVERSION_FUNCTIONS(PiiVariantList)
 }
 
 void initPiiVariant(QScriptEngine* engine)
 {
   PII_REGISTER_SCRIPT_TYPE_CONVERSION(PiiVariantWrapper, PiiVariant);
+  PII_REGISTER_SCRIPT_TYPE_CONVERSION(PiiVariantWrapper, PiiVariantList);
+  new PiiMatrixScriptClass(engine);
   engine->globalObject().setProperty("PiiVariant", engine->newFunction(PiiVariantWrapper::createPiiVariant));
 }
@@ -17,19 +17,66 @@
 #define _PIIVARIANTWRAPPER_H
 
 #include <PiiVariant.h>
+#include <QScriptable>
+#include <QScriptClass>
+#include <QScriptString>
 
-class PiiVariantScriptObject : public QObject
+class PiiVariantScriptObject : public QObject, protected QScriptable
 {
   Q_OBJECT
 public:
-  PiiVariantScriptObject(const PiiVariant& var) : variant(var) {}
+  PiiVariantScriptObject(const PiiVariant& var);
 
   Q_INVOKABLE QString toString() const;
   Q_INVOKABLE int toInt() const;
   Q_INVOKABLE double toDouble() const;
   Q_INVOKABLE bool toBool() const;
+  /**
+   * Returns an array-like view to the elements of a numeric matrix,
+   * or `null` if the variant holds no such matrix. The view reads
+   * the elements directly from the matrix buffer in row-major order
+   * without copying them to a script array.
+   */
+  Q_INVOKABLE QScriptValue matrix();
+
+  double matrixElement(int index) const
+  {
+    return _pElementFunc(_pMatrixData + _iStride * (index / _iColumns) + _iElementSize * (index % _iColumns));
+  }
+  int matrixRows() const { return _iRows; }
+  int matrixColumns() const { return _iColumns; }
 
   PiiVariant variant;
+
+private:
+  template <class T> void initMatrixView();
+
+  const char* _pMatrixData;
+  int _iStride, _iElementSize, _iRows, _iColumns;
+  double (*_pElementFunc)(const char*);
+};
+
+/**
+ * A script class that exposes the elements of a matrix stored in a
+ * PiiVariantScriptObject as indexed, read-only properties. The view
+ * also has `length`, `rows`, and `columns` properties.
+ */
+class PiiMatrixScriptClass : public QObject, public QScriptClass
+{
+  Q_OBJECT
+public:
+  PiiMatrixScriptClass(QScriptEngine* engine);
+
+  QueryFlags queryProperty(const QScriptValue& object, const QScriptString& name,
+                           QueryFlags flags, uint* id);
+  QScriptValue property(const QScriptValue& object, const QScriptString& name, uint id);
+  QScriptValue::PropertyFlags propertyFlags(const QScriptValue& object, const QScriptString& name, uint id);
+  QString name() const;
+
+private:
+  static PiiVariantScriptObject* viewedObject(const QScriptValue& object);
+
+  QScriptString _strLength, _strRows, _strColumns;
 };
 
 class QScriptEngine;
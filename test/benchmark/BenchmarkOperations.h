@@ -0,0 +1,123 @@
+/* This file is part of Into.
+ * Copyright (C) Intopii 2013.
+ * All rights reserved.
+ *
+ * Licensees holding a commercial Into license may use this file in
+ * accordance with the commercial license agreement. Please see
+ * LICENSE.commercial for commercial licensing terms.
+ *
+ * Alternatively, this file may be used under the terms of the GNU
+ * Affero General Public License version 3 as published by the Free
+ * Software Foundation. In addition, Intopii gives you special rights
+ * to use Into as a part of open source software projects. Please
+ * refer to LICENSE.AGPL3 for details.
+ */
+
+
+#ifndef _BENCHMARKOPERATIONS_H
+#define _BENCHMARKOPERATIONS_H
+
+#include <PiiDefaultOperation.h>
+#include <QVector>
+#include <QMutex>
+
+/**
+ * Passes objects from `input` to `output`. The [workload] property
+ * adds a busy loop to each processing round. Concurrent processing
+ * is allowed.
+ */
+class PassOperation : public PiiDefaultOperation
+{
+  Q_OBJECT
+
+  Q_PROPERTY(int workload READ workload WRITE setWorkload);
+
+public:
+  PassOperation();
+
+  void setWorkload(int workload) { _iWorkload = workload; }
+  int workload() const { return _iWorkload; }
+
+protected:
+  void process();
+
+private:
+  int _iWorkload;
+};
+
+/**
+ * Reads `input0` and `input1` and passes the object in `input0` to
+ * `output`.
+ */
+class JoinOperation : public PiiDefaultOperation
+{
+  Q_OBJECT
+public:
+  JoinOperation();
+
+protected:
+  void process();
+};
+
+/**
+ * Records the latency of each received object. The objects are
+ * expected to contain the time they were sent as a `qint64`
+ * (PiiTimer::currentTime()).
+ */
+class LatencyRecorder : public QObject
+{
+  Q_OBJECT
+public:
+  LatencyRecorder(int capacity);
+
+  int count() const { return _vecLatencies.size(); }
+  /**
+   * Returns the *percentile*-th percentile of the recorded latencies
+   * in microseconds.
+   */
+  qint64 percentile(double percentile);
+
+  /**
+   * Adds a latency value directly.
+   */
+  void add(qint64 latency);
+
+public slots:
+  void record(const PiiVariant& obj);
+
+private:
+  QMutex _mutex;
+  QVector<qint64> _vecLatencies;
+};
+
+/**
+ * Measures end-to-end latency through an engine fed by a camera
+ * operation. The release time of each frame is read from the
+ * `timestamp` output of the camera and matched with the arrival time
+ * of the corresponding object at a sink output. The sink is assumed
+ * to emit exactly one object per frame, in order.
+ */
+class FrameLatencyRecorder : public QObject
+{
+  Q_OBJECT
+public:
+  FrameLatencyRecorder(int capacity);
+
+  int releasedCount() const { return _vecReleased.size(); }
+  int arrivedCount() const { return _vecArrived.size(); }
+
+  /**
+   * Adds the latencies of all matched frames to *recorder*.
+   */
+  void collect(LatencyRecorder& recorder) const;
+
+public slots:
+  void recordRelease(const PiiVariant& timestamp);
+  void recordArrival();
+
+private:
+  QMutex _mutex;
+  QVector<qint64> _vecReleased, _vecArrived;
+};
+
+#endif //_BENCHMARKOPERATIONS_H
@@ -0,0 +1,508 @@
+/* This file is part of Into.
+ * Copyright (C) Intopii 2013.
+ * All rights reserved.
+ *
+ * Licensees holding a commercial Into license may use this file in
+ * accordance with the commercial license agreement. Please see
+ * LICENSE.commercial for commercial licensing terms.
+ *
+ * Alternatively, this file may be used under the terms of the GNU
+ * Affero General Public License version 3 as published by the Free
+ * Software Foundation. In addition, Intopii gives you special rights
+ * to use Into as a part of open source software projects. Please
+ * refer to LICENSE.AGPL3 for details.
+ */
+
+
+/* Throughput and latency benchmarks for ydin. Each scenario builds
+ * an engine, warms it up, sends a fixed number of timestamped
+ * objects through it and reports one line of JSON:
+ *
+ * {"scenario":"passthrough","objects":100000,"objectsPerSecond":...,
+ *  "latencyP50":...,"latencyP99":...,"allocationsPerObject":...}
+ *
+ * Latencies are in microseconds. Allocations are counted only if
+ * the core library was built with "qmake ENABLE=allocationcount"
+ * (see Pii::allocationCount()); otherwise allocationsPerObject is
+ * null. The count covers the sending thread and the processing
+ * rounds of threaded operations, but not the flow control done in
+ * the worker threads outside of process().
+ *
+ * Usage: benchmark [-n objects] [-s scenario[,scenario...]] [-o file] [-l]
+ *
+ * With -e, the benchmark loads a saved engine instead, replaces the
+ * drivers of the listed camera operations with PiiLoadGenerator and
+ * runs the engine for -t seconds. Each -p pair names a camera
+ * operation and the output whose objects correspond one-to-one with
+ * its frames. The end-to-end latency of a frame is measured from its
+ * release by the driver (the camera's timestamp output) to its
+ * arrival at the sink:
+ *
+ * benchmark -e engine.cft -p camera:sink.output [-p ...] [-t seconds]
+ *           [-f fps] [-j jitter] [-o file]
+ *
+ * {"pair":"camera:sink.output","frames":250,"received":250,
+ *  "missed":0,"latencyP50":...,"latencyP99":...,"latencyMax":...}
+ */
+
+#include "BenchmarkOperations.h"
+
+#include <PiiEngine.h>
+#include <PiiProbeInput.h>
+#include <PiiYdinTypes.h>
+#include <PiiTimer.h>
+#include <PiiAllocationCounter.h>
+#include <PiiDelay.h>
+
+#include <QCoreApplication>
+#include <QStringList>
+#include <QFile>
+#include <QTextStream>
+#include <QScopedPointer>
+
+#include <algorithm>
+#include <cstdio>
+
+PassOperation::PassOperation() :
+  _iWorkload(0)
+{
+  setThreadingCapabilities(NonThreaded | SingleThreaded | MultiThreaded);
+  addSocket(new PiiInputSocket("input"));
+  addSocket(new PiiOutputSocket("output"));
+}
+
+void PassOperation::process()
+{
+  PiiVariant obj(readInput());
+  // Keep the optimizer from removing the loop.
+  volatile int iSum = 0;
+  for (int i=0; i<_iWorkload; ++i)
+    iSum += i;
+  emitObject(obj);
+}
+
+JoinOperation::JoinOperation()
+{
+  addSocket(new PiiInputSocket("input0"));
+  addSocket(new PiiInputSocket("input1"));
+  addSocket(new PiiOutputSocket("output"));
+}
+
+void JoinOperation::process()
+{
+  emitObject(readInput(0));
+}
+
+LatencyRecorder::LatencyRecorder(int capacity)
+{
+  _vecLatencies.reserve(capacity);
+}
+
+void LatencyRecorder::record(const PiiVariant& obj)
+{
+  const qint64 iLatency = PiiTimer::currentTime() - obj.valueAs<qint64>();
+  QMutexLocker lock(&_mutex);
+  _vecLatencies.append(iLatency);
+}
+
+qint64 LatencyRecorder::percentile(double percentile)
+{
+  if (_vecLatencies.isEmpty())
+    return 0;
+  const int iIndex = qBound(0, int(percentile / 100 * _vecLatencies.size()), _vecLatencies.size()-1);
+  std::nth_element(_vecLatencies.begin(), _vecLatencies.begin() + iIndex, _vecLatencies.end());
+  return _vecLatencies[iIndex];
+}
+
+void LatencyRecorder::add(qint64 latency)
+{
+  QMutexLocker lock(&_mutex);
+  _vecLatencies.append(latency);
+}
+
+FrameLatencyRecorder::FrameLatencyRecorder(int capacity)
+{
+  _vecReleased.reserve(capacity);
+  _vecArrived.reserve(capacity);
+}
+
+void FrameLatencyRecorder::recordRelease(const PiiVariant& timestamp)
+{
+  QMutexLocker lock(&_mutex);
+  _vecReleased.append(timestamp.valueAs<qint64>());
+}
+
+void FrameLatencyRecorder::recordArrival()
+{
+  const qint64 iNow = PiiTimer::currentTime();
+  QMutexLocker lock(&_mutex);
+  _vecArrived.append(iNow);
+}
+
+void FrameLatencyRecorder::collect(LatencyRecorder& recorder) const
+{
+  const int iCount = qMin(_vecReleased.size(), _vecArrived.size());
+  for (int i=0; i<iCount; ++i)
+    recorder.add(_vecArrived[i] - _vecReleased[i]);
+}
+
+namespace
+{
+  struct Setup
+  {
+    Setup() : pExit(0), iControlTags(0) {}
+
+    PiiEngine engine;
+    // Inputs fed by the benchmark. Objects are sent to each in turn.
+    QStringList lstEntries;
+    PiiAbstractOutputSocket* pExit;
+    // The number of nested start/end tag pairs around each object.
+    int iControlTags;
+  };
+
+  PassOperation* createPass(Setup& setup, const QString& name, int threadCount = 0)
+  {
+    PassOperation* pPass = new PassOperation;
+    pPass->setObjectName(name);
+    pPass->setProperty("threadCount", threadCount);
+    setup.engine.addOperation(pPass);
+    return pPass;
+  }
+
+  // Builds a chain of *length* pass-through operations.
+  void createChain(Setup& setup, int length, int threadCount)
+  {
+    PiiOperation* pPrevious = 0;
+    for (int i=0; i<length; ++i)
+      {
+        PiiOperation* pPass = createPass(setup, QString("pass%1").arg(i), threadCount);
+        if (pPrevious != 0)
+          pPrevious->connectOutput("output", pPass, "input");
+        pPrevious = pPass;
+      }
+    setup.lstEntries << "pass0.input";
+    setup.pExit = pPrevious->output("output");
+  }
+
+  void setupPassThrough(Setup& setup) { createChain(setup, 8, 0); }
+  void setupThreadedChain(Setup& setup) { createChain(setup, 4, 1); }
+
+  void setupFanOutFanIn(Setup& setup)
+  {
+    PiiOperation* pSource = createPass(setup, "source");
+    PiiOperation* pLeft = createPass(setup, "left", 1);
+    PiiOperation* pRight = createPass(setup, "right", 1);
+    JoinOperation* pJoin = new JoinOperation;
+    pJoin->setObjectName("join");
+    setup.engine.addOperation(pJoin);
+    pSource->connectOutput("output", pLeft, "input");
+    pSource->connectOutput("output", pRight, "input");
+    pLeft->connectOutput("output", pJoin, "input0");
+    pRight->connectOutput("output", pJoin, "input1");
+    setup.lstEntries << "source.input";
+    setup.pExit = pJoin->output("output");
+  }
+
+  void setupMultiThreaded(Setup& setup, bool ordered)
+  {
+    PiiOperation* pPass = createPass(setup, "pass0", 4);
+    pPass->setProperty("workload", 2000);
+    pPass->setProperty("orderedOutput", ordered);
+    setup.lstEntries << "pass0.input";
+    setup.pExit = pPass->output("output");
+  }
+
+  void setupOrdered(Setup& setup) { setupMultiThreaded(setup, true); }
+  void setupUnordered(Setup& setup) { setupMultiThreaded(setup, false); }
+
+  void setupPiso(Setup& setup)
+  {
+    PiiEngine::loadPlugin("piiflowcontrol");
+    PiiOperation* pPiso = setup.engine.createOperation("PiiPisoOperation", "piso");
+    pPiso->setProperty("groupSize", 1);
+    pPiso->setProperty("dynamicInputCount", 4);
+    for (int i=0; i<4; ++i)
+      setup.lstEntries << QString("piso.input%1").arg(i);
+    setup.pExit = pPiso->output("output0");
+  }
+
+  void setupControlStorm(Setup& setup)
+  {
+    createChain(setup, 4, 0);
+    setup.iControlTags = 4;
+  }
+
+  typedef void (*SetupFunction)(Setup&);
+
+  struct Scenario
+  {
+    const char* name;
+    SetupFunction setup;
+  };
+
+  const Scenario scenarios[] =
+    {
+      { "passthrough", setupPassThrough },
+      { "threadedchain", setupThreadedChain },
+      { "fanout-fanin", setupFanOutFanIn },
+      { "multithreaded-ordered", setupOrdered },
+      { "multithreaded-unordered", setupUnordered },
+      { "piso", setupPiso },
+      { "controlstorm", setupControlStorm }
+    };
+  const int iScenarioCount = sizeof(scenarios) / sizeof(scenarios[0]);
+
+  QString runScenario(const Scenario& scenario, int objectCount)
+  {
+    Setup setup;
+    scenario.setup(setup);
+
+    QMap<QString,PiiVariant> mapWarmUpObjects;
+    for (int i=0; i<setup.lstEntries.size(); ++i)
+      mapWarmUpObjects[setup.lstEntries[i]] = PiiVariant(PiiTimer::currentTime());
+    setup.engine.warmUp(mapWarmUpObjects, 100);
+
+    QList<PiiOutputSocket*> lstSources;
+    for (int i=0; i<setup.lstEntries.size(); ++i)
+      {
+        PiiOutputSocket* pSource = new PiiOutputSocket(QString("source%1").arg(i));
+        pSource->connectInput(setup.engine.input(setup.lstEntries[i]));
+        lstSources << pSource;
+      }
+    LatencyRecorder recorder(objectCount);
+    PiiProbeInput probe;
+    probe.setDiscardControlObjects(true);
+    QObject::connect(&probe, SIGNAL(objectReceived(PiiVariant,PiiProbeInput*)),
+                     &recorder, SLOT(record(PiiVariant)), Qt::DirectConnection);
+    setup.pExit->connectInput(&probe);
+
+    setup.engine.execute();
+    const PiiVariant startTag(PiiYdin::createStartTag()), endTag(PiiYdin::createEndTag());
+    const quint64 iStartAllocations = Pii::allocationCount();
+    PiiTimer timer;
+    for (int i=0; i<objectCount; ++i)
+      {
+        PiiOutputSocket* pSource = lstSources[i % lstSources.size()];
+        for (int j=0; j<setup.iControlTags; ++j)
+          pSource->emitObject(startTag);
+        pSource->emitObject(PiiVariant(PiiTimer::currentTime()));
+        for (int j=0; j<setup.iControlTags; ++j)
+          pSource->emitObject(endTag);
+      }
+    for (int i=0; i<lstSources.size(); ++i)
+      lstSources[i]->emitObject(PiiYdin::createStopTag());
+    if (!setup.engine.wait(PiiOperation::Stopped, 60000))
+      {
+        setup.engine.interrupt();
+        setup.engine.wait();
+      }
+    const qint64 iElapsed = timer.microseconds();
+    quint64 iAllocations = Pii::allocationCount() - iStartAllocations;
+
+    QList<PiiOperation*> lstOperations = setup.engine.childOperations();
+    for (int i=0; i<lstOperations.size(); ++i)
+      {
+        PiiDefaultOperation* pOperation = qobject_cast<PiiDefaultOperation*>(lstOperations[i]);
+        if (pOperation != 0 && pOperation->property("threadCount").toInt() > 0)
+          iAllocations += quint64(pOperation->allocationHistogram().total());
+      }
+    qDeleteAll(lstSources);
+
+    QString strResult;
+    QTextStream out(&strResult);
+    out << "{\"scenario\":\"" << scenario.name << "\""
+        << ",\"objects\":" << objectCount
+        << ",\"received\":" << recorder.count()
+        << ",\"objectsPerSecond\":" << (iElapsed > 0 ? double(objectCount) * 1e6 / iElapsed : 0.0)
+        << ",\"latencyP50\":" << recorder.percentile(50)
+        << ",\"latencyP99\":" << recorder.percentile(99)
+        << ",\"allocationsPerObject\":";
+    if (Pii::isAllocationCountingEnabled())
+      out << double(iAllocations) / objectCount;
+    else
+      out << "null";
+    out << "}";
+    out.flush();
+    return strResult;
+  }
+
+  struct EngineOptions
+  {
+    EngineOptions() : iSeconds(10), dFrameRate(-1), dJitter(-1) {}
+
+    QString strFileName;
+    // camera:sink pairs
+    QStringList lstPairs;
+    int iSeconds;
+    double dFrameRate, dJitter;
+  };
+
+  // Replaces the drivers of the cameras listed in options with
+  // PiiLoadGenerator to drive a saved engine at a known frame rate and
+  // measures end-to-end latency from each camera to its sink.
+  QStringList runEngine(const EngineOptions& options)
+  {
+    PiiEngine::loadPlugin("piicameraemulator");
+    QScopedPointer<PiiEngine> pEngine(PiiEngine::load(options.strFileName));
+
+    const int iCapacity = int(qMax(options.dFrameRate, 100.0) * options.iSeconds * 2);
+    QList<PiiOperation*> lstCameras;
+    QList<FrameLatencyRecorder*> lstRecorders;
+    QList<PiiProbeInput*> lstProbes;
+    for (int i=0; i<options.lstPairs.size(); ++i)
+      {
+        const QString strCamera(options.lstPairs[i].section(':', 0, 0)),
+          strSink(options.lstPairs[i].section(':', 1));
+        PiiOperation* pCamera = pEngine->childOperation(strCamera);
+        PiiAbstractOutputSocket* pTimestamp = pCamera != 0 ? pCamera->output("timestamp") : 0;
+        PiiAbstractOutputSocket* pSink = pEngine->output(strSink);
+        if (pTimestamp == 0 || pSink == 0)
+          PII_THROW(PiiExecutionException,
+                    QString("Cannot resolve camera \"%1\" or sink \"%2\".").arg(strCamera, strSink));
+
+        if (pCamera->property("driverName").toString() != "PiiLoadGenerator")
+          pCamera->setProperty("driverName", "PiiLoadGenerator");
+        if (options.dFrameRate > 0)
+          pCamera->setProperty("driver.frameRate", options.dFrameRate);
+        if (options.dJitter >= 0)
+          pCamera->setProperty("driver.jitter", options.dJitter);
+
+        FrameLatencyRecorder* pRecorder = new FrameLatencyRecorder(iCapacity);
+        PiiProbeInput* pReleaseProbe = new PiiProbeInput, *pArrivalProbe = new PiiProbeInput;
+        pReleaseProbe->setDiscardControlObjects(true);
+        pArrivalProbe->setDiscardControlObjects(true);
+        QObject::connect(pReleaseProbe, SIGNAL(objectReceived(PiiVariant,PiiProbeInput*)),
+                         pRecorder, SLOT(recordRelease(PiiVariant)), Qt::DirectConnection);
+        QObject::connect(pArrivalProbe, SIGNAL(objectReceived(PiiVariant,PiiProbeInput*)),
+                         pRecorder, SLOT(recordArrival()), Qt::DirectConnection);
+        pTimestamp->connectInput(pReleaseProbe);
+        pSink->connectInput(pArrivalProbe);
+        lstCameras << pCamera;
+        lstRecorders << pRecorder;
+        lstProbes << pReleaseProbe << pArrivalProbe;
+      }
+
+    pEngine->execute();
+    PiiDelay::msleep(options.iSeconds * 1000);
+    pEngine->stop();
+    if (!pEngine->wait(PiiOperation::Stopped, 10000))
+      {
+        pEngine->interrupt();
+        pEngine->wait();
+      }
+
+    QStringList lstResults;
+    for (int i=0; i<lstRecorders.size(); ++i)
+      {
+        LatencyRecorder latencies(lstRecorders[i]->releasedCount());
+        lstRecorders[i]->collect(latencies);
+        QString strResult;
+        QTextStream out(&strResult);
+        out << "{\"pair\":\"" << options.lstPairs[i] << "\""
+            << ",\"frames\":" << lstRecorders[i]->releasedCount()
+            << ",\"received\":" << lstRecorders[i]->arrivedCount()
+            << ",\"missed\":" << lstCameras[i]->property("driver.missedFrameCount").toInt()
+            << ",\"latencyP50\":" << latencies.percentile(50)
+            << ",\"latencyP99\":" << latencies.percentile(99)
+            << ",\"latencyMax\":" << latencies.percentile(100)
+            << "}";
+        out.flush();
+        lstResults << strResult;
+      }
+    // Probes must go before the engine disconnects its outputs.
+    pEngine.reset();
+    qDeleteAll(lstProbes);
+    qDeleteAll(lstRecorders);
+    return lstResults;
+  }
+}
+
+int main(int argc, char* argv[])
+{
+  QCoreApplication app(argc, argv);
+  QStringList lstArgs(app.arguments());
+
+  int iObjectCount = 100000;
+  QStringList lstScenarios;
+  QString strOutputFile;
+  EngineOptions engineOptions;
+  for (int i=1; i<lstArgs.size(); ++i)
+    {
+      if (lstArgs[i] == "-n" && i+1 < lstArgs.size())
+        iObjectCount = qMax(lstArgs[++i].toInt(), 1);
+      else if (lstArgs[i] == "-s" && i+1 < lstArgs.size())
+        lstScenarios << lstArgs[++i].split(',');
+      else if (lstArgs[i] == "-o" && i+1 < lstArgs.size())
+        strOutputFile = lstArgs[++i];
+      else if (lstArgs[i] == "-e" && i+1 < lstArgs.size())
+        engineOptions.strFileName = lstArgs[++i];
+      else if (lstArgs[i] == "-p" && i+1 < lstArgs.size())
+        engineOptions.lstPairs << lstArgs[++i];
+      else if (lstArgs[i] == "-t" && i+1 < lstArgs.size())
+        engineOptions.iSeconds = qMax(lstArgs[++i].toInt(), 1);
+      else if (lstArgs[i] == "-f" && i+1 < lstArgs.size())
+        engineOptions.dFrameRate = lstArgs[++i].toDouble();
+      else if (lstArgs[i] == "-j" && i+1 < lstArgs.size())
+        engineOptions.dJitter = lstArgs[++i].toDouble();
+      else if (lstArgs[i] == "-l")
+        {
+          for (int j=0; j<iScenarioCount; ++j)
+            std::printf("%s\n", scenarios[j].name);
+          return 0;
+        }
+      else
+        {
+          std::fprintf(stderr, "Usage: %s [-n objects] [-s scenario[,scenario...]] [-o file] [-l]\n"
+                       "       %s -e engine -p camera:sink [-p ...] [-t seconds] [-f fps] [-j jitter] [-o file]\n",
+                       qPrintable(lstArgs[0]), qPrintable(lstArgs[0]));
+          return 1;
+        }
+    }
+
+  QFile file(strOutputFile);
+  if (strOutputFile.isEmpty())
+    file.open(stdout, QIODevice::WriteOnly | QIODevice::Text);
+  else if (!file.open(QIODevice::WriteOnly | QIODevice::Text))
+    {
+      std::fprintf(stderr, "Cannot open %s for writing.\n", qPrintable(strOutputFile));
+      return 1;
+    }
+  QTextStream out(&file);
+
+  if (!engineOptions.strFileName.isEmpty())
+    {
+      if (engineOptions.lstPairs.isEmpty())
+        {
+          std::fprintf(stderr, "At least one camera:sink pair (-p) is required.\n");
+          return 1;
+        }
+      try
+        {
+          out << runEngine(engineOptions).join("\n") << "\n";
+        }
+      catch (PiiException& ex)
+        {
+          std::fprintf(stderr, "%s: %s\n", qPrintable(engineOptions.strFileName), qPrintable(ex.message()));
+          return 1;
+        }
+      return 0;
+    }
+
+  int iExitCode = 0;
+  for (int i=0; i<iScenarioCount; ++i)
+    {
+      if (!lstScenarios.isEmpty() && !lstScenarios.contains(scenarios[i].name))
+        continue;
+      try
+        {
+          out << runScenario(scenarios[i], iObjectCount) << "\n";
+          out.flush();
+        }
+      catch (PiiException& ex)
+        {
+          std::fprintf(stderr, "%s: %s\n", scenarios[i].name, qPrintable(ex.message()));
+          iExitCode = 1;
+        }
+    }
+  return iExitCode;
+}
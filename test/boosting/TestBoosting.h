@@ -24,8 +24,10 @@ class TestBoosting : public QObject
 
 private slots:
   void decisionStump();
+  void featureIndex();
   void adaBoost();
   void adaBoost_data();
+  void stumpFactory();
 };
 
 #endif //_TESTBOOSTING_H
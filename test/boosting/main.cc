@@ -18,6 +18,8 @@
 #include <PiiBoostClassifier.h>
 #include <PiiDecisionStump.h>
 #include <PiiDefaultClassifierFactory.h>
+#include <PiiDecisionStumpFactory.h>
+#include <PiiRandom.h>
 
 void TestBoosting::decisionStump()
 {
@@ -73,6 +75,67 @@ void TestBoosting::decisionStump()
   QCOMPARE(stumps.classify(PiiMatrix<int>(1,1, 2).row(0)), 1.0);
 }
 
+void TestBoosting::featureIndex()
+{
+  typedef PiiDecisionStump<PiiMatrix<int> > Stump;
+  // Few distinct values -> many ties
+  PiiMatrix<int> features(PiiMatrix<int>(Pii::uniformRandomMatrix(300, 5) * 20));
+  QVector<double> labels, weights;
+  for (int i=0; i<features.rows(); ++i)
+    {
+      labels << ((features(i,3) + features(i,1)) > 20 ? 1 : 0);
+      weights << Pii::uniformRandom(0.5, 1.0);
+    }
+
+  Stump stump;
+  stump.learn(features, labels, weights);
+  QCOMPARE(stump.selectedFeature() % 2, 1);
+
+  // Parallel search gives the same result.
+  Stump::FeatureIndex index(Pii::ParallelExecution(), features);
+  QCOMPARE(index.sampleCount(), 300);
+  QCOMPARE(index.featureCount(), 5);
+  QCOMPARE(index.binCount(), 0);
+  Stump parallelStump;
+  parallelStump.learn(Pii::ParallelExecution(3), index, features, labels, weights);
+  QCOMPARE(parallelStump.selectedFeature(), stump.selectedFeature());
+  QCOMPARE(parallelStump.threshold(), stump.threshold());
+  QCOMPARE(parallelStump.leftLabel(), stump.leftLabel());
+  QCOMPARE(parallelStump.rightLabel(), stump.rightLabel());
+
+  // With at least as many bins as there are distinct values, binning
+  // makes no difference.
+  Stump::FeatureIndex binnedIndex(Pii::ParallelExecution(), features, 64);
+  QCOMPARE(binnedIndex.binCount(), 64);
+  Stump binnedStump;
+  binnedStump.learn(Pii::ParallelExecution(), binnedIndex, features, labels, weights);
+  QCOMPARE(binnedStump.selectedFeature(), stump.selectedFeature());
+  QCOMPARE(binnedStump.threshold(), stump.threshold());
+  QCOMPARE(binnedStump.leftLabel(), stump.leftLabel());
+
+  // Coarse bins can only make the error larger.
+  binnedStump.learn(Pii::ParallelExecution(), Stump::FeatureIndex(Pii::ParallelExecution(), features, 3),
+                    features, labels, weights);
+  QVector<double> vecExact(features.rows()), vecBinned(features.rows());
+  for (int i=0; i<features.rows(); ++i)
+    {
+      vecExact[i] = stump.classify(features[i]);
+      vecBinned[i] = binnedStump.classify(features[i]);
+    }
+  QVERIFY(PiiClassification::calculateError(labels, vecBinned, weights) >=
+          PiiClassification::calculateError(labels, vecExact, weights));
+
+  // The stump tests must pass with an index, too.
+  PiiMatrix<int> features2(6,1, 0, 1, 2, 3, 4, 5);
+  QVector<double> labels3;
+  labels3 << 1 << 1 << 0 << 1 << 0 << 0;
+  QVector<double> weights2(6, 2.0/11);
+  weights2[2] = 1.0/11;
+  stump.learn(Pii::ParallelExecution(), Stump::FeatureIndex(), features2, labels3, weights2);
+  QCOMPARE(stump.threshold(), 3);
+  QCOMPARE(stump.leftLabel(), 1.0);
+}
+
 void TestBoosting::adaBoost()
 {
   QFETCH(int, algorithm);
@@ -117,4 +180,37 @@ void TestBoosting::adaBoost_data()
   //QTest::newRow("FloatBoost") << int(PiiClassification::FloatBoost);
 }
 
+void TestBoosting::stumpFactory()
+{
+  PiiMatrix<double> features(Pii::uniformRandomMatrix(200, 4));
+  QVector<double> labels;
+  for (int i=0; i<features.rows(); ++i)
+    labels << (features(i,0) + features(i,2) > 1 ? 1 : 0);
+
+  PiiDefaultClassifierFactory<PiiDecisionStump<PiiMatrix<double> > > defaultFactory;
+  PiiBoostClassifier<PiiMatrix<double> > classifier(&defaultFactory);
+  classifier.setMaxClassifiers(10);
+  classifier.learn(features, labels);
+
+  PiiDecisionStumpFactory<PiiMatrix<double> > factory;
+  PiiBoostClassifier<PiiMatrix<double> > indexedClassifier(&factory);
+  indexedClassifier.setMaxClassifiers(10);
+  indexedClassifier.learn(features, labels);
+
+  QList<PiiClassifier<PiiMatrix<double> >*> lstClassifiers = classifier.classifiers(),
+    lstIndexedClassifiers = indexedClassifier.classifiers();
+  QCOMPARE(lstIndexedClassifiers.size(), lstClassifiers.size());
+  for (int i=0; i<lstClassifiers.size(); ++i)
+    {
+      PiiDecisionStump<PiiMatrix<double> >* pStump =
+        static_cast<PiiDecisionStump<PiiMatrix<double> >*>(lstClassifiers[i]);
+      PiiDecisionStump<PiiMatrix<double> >* pIndexedStump =
+        static_cast<PiiDecisionStump<PiiMatrix<double> >*>(lstIndexedClassifiers[i]);
+      QCOMPARE(pIndexedStump->selectedFeature(), pStump->selectedFeature());
+      QCOMPARE(pIndexedStump->threshold(), pStump->threshold());
+    }
+  for (int i=0; i<features.rows(); ++i)
+    QCOMPARE(indexedClassifier.classify(features[i]), classifier.classify(features[i]));
+}
+
 QTEST_MAIN(TestBoosting)
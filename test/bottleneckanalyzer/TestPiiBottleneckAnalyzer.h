@@ -0,0 +1,57 @@
+/* This file is part of Into.
+ * Copyright (C) Intopii 2013.
+ * All rights reserved.
+ *
+ * Licensees holding a commercial Into license may use this file in
+ * accordance with the commercial license agreement. Please see
+ * LICENSE.commercial for commercial licensing terms.
+ *
+ * Alternatively, this file may be used under the terms of the GNU
+ * Affero General Public License version 3 as published by the Free
+ * Software Foundation. In addition, Intopii gives you special rights
+ * to use Into as a part of open source software projects. Please
+ * refer to LICENSE.AGPL3 for details.
+ */
+
+
+#ifndef _TESTPIIBOTTLENECKANALYZER_H
+#define _TESTPIIBOTTLENECKANALYZER_H
+
+#include <QObject>
+#include <PiiDefaultOperation.h>
+#include <PiiInputSocket.h>
+#include <PiiOutputSocket.h>
+
+class TestOperation : public PiiDefaultOperation
+{
+public:
+  TestOperation(const QString& name, ThreadingCapabilities capabilities, int threadCount)
+  {
+    setObjectName(name);
+    setThreadingCapabilities(capabilities);
+    setThreadCount(threadCount);
+    addSocket(new PiiInputSocket("input"));
+    addSocket(new PiiOutputSocket("output"));
+  }
+
+  void simulate(int rounds, int processTime)
+  {
+    PiiProfileHistogram& processTimes = const_cast<PiiProfileHistogram&>(processTimeHistogram());
+    for (int i=0; i<rounds; ++i)
+      processTimes.add(processTime);
+  }
+
+protected:
+  void process() {}
+};
+
+class TestPiiBottleneckAnalyzer : public QObject
+{
+  Q_OBJECT
+
+private slots:
+  void analyze();
+  void feedbackLoop();
+};
+
+#endif //_TESTPIIBOTTLENECKANALYZER_H
@@ -0,0 +1,105 @@
+/* This file is part of Into.
+ * Copyright (C) Intopii 2013.
+ * All rights reserved.
+ *
+ * Licensees holding a commercial Into license may use this file in
+ * accordance with the commercial license agreement. Please see
+ * LICENSE.commercial for commercial licensing terms.
+ *
+ * Alternatively, this file may be used under the terms of the GNU
+ * Affero General Public License version 3 as published by the Free
+ * Software Foundation. In addition, Intopii gives you special rights
+ * to use Into as a part of open source software projects. Please
+ * refer to LICENSE.AGPL3 for details.
+ */
+
+
+#include "TestPiiBottleneckAnalyzer.h"
+
+#include <PiiBottleneckAnalyzer.h>
+#include <PiiOperationCompound.h>
+#include <QtTest>
+
+void TestPiiBottleneckAnalyzer::analyze()
+{
+  PiiOperationCompound compound;
+  PiiOperationCompound* pSub = new PiiOperationCompound;
+  pSub->setObjectName("sub");
+  compound.addOperation(pSub);
+
+  TestOperation* pSource = new TestOperation("source", PiiDefaultOperation::SingleThreaded, 1);
+  TestOperation* pMedium = new TestOperation("medium", PiiDefaultOperation::SingleThreaded, 1);
+  TestOperation* pHeavy = new TestOperation("heavy",
+                                            PiiDefaultOperation::SingleThreaded |
+                                            PiiDefaultOperation::MultiThreaded, 1);
+  TestOperation* pSink = new TestOperation("sink",
+                                           PiiDefaultOperation::NonThreaded |
+                                           PiiDefaultOperation::SingleThreaded, 1);
+  compound.addOperation(pSource);
+  compound.addOperation(pMedium);
+  pSub->addOperation(pHeavy);
+  pSub->addOperation(pSink);
+
+  pSource->output("output")->connectInput(pHeavy->input("input"));
+  pSource->output("output")->connectInput(pMedium->input("input"));
+  pHeavy->output("output")->connectInput(pSink->input("input"));
+
+  pSource->simulate(1000, 100);
+  pMedium->simulate(1000, 300);
+  pHeavy->simulate(1000, 800);
+  pSink->simulate(1000, 5);
+
+  PiiBottleneckAnalyzer analyzer;
+  analyzer.setProcessorCount(4);
+  analyzer.analyze(&compound);
+
+  QList<PiiDefaultOperation*> lstPath(analyzer.criticalPath());
+  QCOMPARE(lstPath.size(), 3);
+  QVERIFY(lstPath[0] == pSource);
+  QVERIFY(lstPath[1] == pHeavy);
+  QVERIFY(lstPath[2] == pSink);
+  QCOMPARE(analyzer.criticalPathTime(), 905.0);
+
+  QVERIFY(analyzer.bottleneck() == pHeavy);
+  QCOMPARE(analyzer.maxThroughput(), 1250.0);
+
+  // The load is balanced against the single-threaded operations
+  // and four cores: 1205000/4 us per thread.
+  QCOMPARE(analyzer.recommendedThreadCount(pSource), 1);
+  QCOMPARE(analyzer.recommendedThreadCount(pMedium), 1);
+  QCOMPARE(analyzer.recommendedThreadCount(pHeavy), 3);
+  QCOMPARE(analyzer.recommendedThreadCount(pSink), 0);
+
+  QVariantMap mapAnalysis(analyzer.toVariantMap());
+  QCOMPARE(mapAnalysis["bottleneck"].toString(), QString("sub.heavy"));
+  QCOMPARE(mapAnalysis["criticalPath"].toStringList(),
+           QStringList() << "source" << "sub.heavy" << "sub.sink");
+  QVariantMap mapHeavy(mapAnalysis["operations"].toMap()["sub.heavy"].toMap());
+  QCOMPARE(mapHeavy["busyTime"].toLongLong(), qint64(800000));
+  QCOMPARE(mapHeavy["recommendedThreadCount"].toInt(), 3);
+
+  analyzer.applyRecommendations();
+  QCOMPARE(pHeavy->property("threadCount").toInt(), 3);
+  QCOMPARE(pSink->property("threadCount").toInt(), 0);
+}
+
+void TestPiiBottleneckAnalyzer::feedbackLoop()
+{
+  PiiOperationCompound compound;
+  TestOperation* pFirst = new TestOperation("first", PiiDefaultOperation::SingleThreaded, 1);
+  TestOperation* pSecond = new TestOperation("second", PiiDefaultOperation::SingleThreaded, 1);
+  compound.addOperation(pFirst);
+  compound.addOperation(pSecond);
+  pFirst->output("output")->connectInput(pSecond->input("input"));
+  pSecond->output("output")->connectInput(pFirst->input("input"));
+  pFirst->simulate(10, 10);
+  pSecond->simulate(10, 20);
+
+  PiiBottleneckAnalyzer analyzer;
+  analyzer.analyze(&compound);
+  QCOMPARE(analyzer.criticalPath().size(), 2);
+  QCOMPARE(analyzer.criticalPathTime(), 30.0);
+  QVERIFY(analyzer.bottleneck() == pSecond);
+}
+
+QTEST_MAIN(TestPiiBottleneckAnalyzer)
@@ -0,0 +1,45 @@
+/* This file is part of Into.
+ * Copyright (C) Intopii 2013.
+ * All rights reserved.
+ *
+ * Licensees holding a commercial Into license may use this file in
+ * accordance with the commercial license agreement. Please see
+ * LICENSE.commercial for commercial licensing terms.
+ *
+ * Alternatively, this file may be used under the terms of the GNU
+ * Affero General Public License version 3 as published by the Free
+ * Software Foundation. In addition, Intopii gives you special rights
+ * to use Into as a part of open source software projects. Please
+ * refer to LICENSE.AGPL3 for details.
+ */
+
+#ifndef _TESTPIICACHEOPERATION_H
+#define _TESTPIICACHEOPERATION_H
+
+#include <PiiOperationTest.h>
+#include <QList>
+
+class TestPiiCacheOperation : public PiiOperationTest
+{
+  Q_OBJECT
+
+private slots:
+  void initTestCase();
+  void missAndHit();
+  void ordering();
+  void leastRecentlyUsed();
+  void adaptiveReplacement();
+  void spillToDisk();
+
+protected slots:
+  void collectData(const QString& name, const PiiVariant& obj);
+
+private:
+  void request(const QString& key, int found);
+  void resolve(int value);
+
+  QList<int> _lstData;
+};
+
+
+#endif //_TESTPIICACHEOPERATION_H
@@ -0,0 +1,151 @@
+/* This file is part of Into.
+ * Copyright (C) Intopii 2013.
+ * All rights reserved.
+ *
+ * Licensees holding a commercial Into license may use this file in
+ * accordance with the commercial license agreement. Please see
+ * LICENSE.commercial for commercial licensing terms.
+ *
+ * Alternatively, this file may be used under the terms of the GNU
+ * Affero General Public License version 3 as published by the Free
+ * Software Foundation. In addition, Intopii gives you special rights
+ * to use Into as a part of open source software projects. Please
+ * refer to LICENSE.AGPL3 for details.
+ */
+
+#include "TestPiiCacheOperation.h"
+
+#include <QtTest>
+
+void TestPiiCacheOperation::initTestCase()
+{
+  QVERIFY(createOperation("piiflowcontrol", "PiiCacheOperation"));
+  connect(this, SIGNAL(objectReceived(QString,PiiVariant)), SLOT(collectData(QString,PiiVariant)), Qt::DirectConnection);
+  connectAllInputs();
+}
+
+void TestPiiCacheOperation::collectData(const QString& name, const PiiVariant& obj)
+{
+  if (name == "data")
+    _lstData << obj.valueAs<int>();
+}
+
+void TestPiiCacheOperation::request(const QString& key, int found)
+{
+  QVERIFY(sendObject("key", key));
+  QCOMPARE(outputValue("found", -1), found);
+  if (found == 0)
+    QCOMPARE(outputValue("key", QString()), key);
+}
+
+void TestPiiCacheOperation::resolve(int value)
+{
+  QVERIFY(sendObject("data", value));
+}
+
+void TestPiiCacheOperation::missAndHit()
+{
+  _lstData.clear();
+  QVERIFY(start());
+  request("a", 0);
+  QVERIFY(_lstData.isEmpty());
+  resolve(1);
+  QCOMPARE(_lstData, QList<int>() << 1);
+  QVERIFY(operation()->property("consumedMemory").toLongLong() > 0);
+  request("a", 1);
+  QCOMPARE(_lstData, QList<int>() << 1 << 1);
+  stop();
+}
+
+void TestPiiCacheOperation::ordering()
+{
+  _lstData.clear();
+  QVERIFY(start());
+  // The hit must wait for the pending miss.
+  request("b", 0);
+  request("a", 1);
+  QVERIFY(_lstData.isEmpty());
+  resolve(2);
+  QCOMPARE(_lstData, QList<int>() << 2 << 1);
+  stop();
+
+  _lstData.clear();
+  operation()->setProperty("allowOrderChanges", true);
+  QVERIFY(start());
+  request("c", 0);
+  request("a", 1);
+  QCOMPARE(_lstData, QList<int>() << 1);
+  resolve(3);
+  QCOMPARE(_lstData, QList<int>() << 1 << 3);
+  stop();
+  operation()->setProperty("allowOrderChanges", false);
+}
+
+void TestPiiCacheOperation::leastRecentlyUsed()
+{
+  operation()->setProperty("maxObjects", 2);
+  QVERIFY(start());
+  request("x", 0);
+  resolve(10);
+  request("y", 0);
+  resolve(11);
+  request("x", 1);
+  request("z", 0);
+  resolve(12);
+  // y was used least recently
+  request("y", 0);
+  resolve(11);
+  request("z", 1);
+  request("x", 0);
+  resolve(10);
+  stop();
+}
+
+void TestPiiCacheOperation::adaptiveReplacement()
+{
+  operation()->setProperty("evictionPolicy", "AdaptiveReplacement");
+  operation()->setProperty("maxObjects", 2);
+  QVERIFY(start());
+  request("p", 0);
+  resolve(20);
+  request("p", 1);
+  // A scan over objects used only once doesn't flush p.
+  request("q", 0);
+  resolve(21);
+  request("r", 0);
+  resolve(22);
+  request("s", 0);
+  resolve(23);
+  request("p", 1);
+  stop();
+  operation()->setProperty("evictionPolicy", "LeastRecentlyUsed");
+}
+
+void TestPiiCacheOperation::spillToDisk()
+{
+  operation()->setProperty("maxObjects", 1);
+  operation()->setProperty("spillToDisk", true);
+  QVERIFY(start());
+  request("u", 0);
+  resolve(30);
+  request("v", 0);
+  resolve(31);
+  QVERIFY(operation()->property("spilledBytes").toLongLong() > 0);
+  _lstData.clear();
+  request("u", 1);
+  QCOMPARE(_lstData, QList<int>() << 30);
+  request("v", 1);
+  request("u", 1);
+  QCOMPARE(_lstData, QList<int>() << 30 << 31 << 30);
+  stop();
+
+  // Disabling the disk tier drops spilled objects.
+  operation()->setProperty("spillToDisk", false);
+  QVERIFY(start());
+  QCOMPARE(operation()->property("spilledBytes").toLongLong(), qint64(0));
+  request("v", 0);
+  resolve(31);
+  stop();
+}
+
+QTEST_MAIN(TestPiiCacheOperation)
@@ -24,6 +24,10 @@ class TestPiiCamera : public QObject
 
 private slots:
   void bayerToRgb();
+  void bayerToRgbOddSize();
+  void bayerPatterns();
+  void parallelBayerToRgb();
+  void bayerToRgbBinned();
   //void bayerToRgbSpeed();
 };
 
@@ -89,6 +89,96 @@ void TestPiiCamera::bayerToRgb()
   QVERIFY(Pii::equals(gray, (red + green + blue)/3));
 }
 
+void TestPiiCamera::bayerToRgbOddSize()
+{
+  PiiMatrix<unsigned char> test(3,5,
+                                1,2,3,4,5,
+                                6,7,8,9,10,
+                                11,12,13,14,15);
+  PiiMatrix<int> red(PiiCamera::bayerToRgb(test,
+                                           PiiCamera::RggbDecoder<>(),
+                                           PiiCamera::RedPixel<int>()));
+  QVERIFY(Pii::equals(red, PiiMatrix<int>(3,5,
+                                          1,2,3,4,5,
+                                          6,7,8,9,10,
+                                          11,12,13,14,15)));
+}
+
+void TestPiiCamera::bayerPatterns()
+{
+  PiiMatrix<unsigned char> test(4,4,
+                                2,4,6,8,
+                                8,6,4,2,
+                                1,2,3,4,
+                                5,6,7,8);
+
+  PiiMatrix<PiiColor4<> > rgb(PiiCamera::bayerToRgb(test,PiiCamera::GbrgDecoder<>(),
+                                                    PiiCamera::Rgb4Pixel<>()));
+  QVERIFY(rgb(1,1) == PiiColor4<>(6,6,3));
+  QVERIFY(rgb(1,2) == PiiColor4<>(4,4,4));
+
+  // A vertical edge. Bilinear interpolation leaks the bright side
+  // to the green channel of the red pixel next to the edge.
+  PiiMatrix<unsigned char> edge(6,6);
+  for (int r=0; r<6; ++r)
+    for (int c=0; c<6; ++c)
+      edge(r,c) = c < 3 ? 0 : 200;
+  PiiMatrix<int> green(PiiCamera::bayerToRgb(edge,
+                                             PiiCamera::RggbDecoder<>(),
+                                             PiiCamera::GreenPixel<int>()));
+  QCOMPARE(green(2,2), 50);
+  green = PiiCamera::bayerToRgb(edge,
+                                PiiCamera::RggbDecoder<unsigned char, PiiCamera::EdgeSensingInterpolator<unsigned char> >(),
+                                PiiCamera::GreenPixel<int>());
+  QCOMPARE(green(2,2), 0);
+}
+
+void TestPiiCamera::parallelBayerToRgb()
+{
+  PiiMatrix<unsigned char> test(101,67);
+  for (int r=0; r<test.rows(); ++r)
+    for (int c=0; c<test.columns(); ++c)
+      test(r,c) = (unsigned char)(r*31 + c*17);
+
+  PiiMatrix<PiiColor4<> > rgb(PiiCamera::bayerToRgb(test, PiiCamera::BggrDecoder<>(),
+                                                    PiiCamera::Rgb4Pixel<>()));
+  Pii::ParallelExecution policy(4);
+  policy.minBandRows = 8;
+  QVERIFY(Pii::equals(PiiCamera::bayerToRgb(policy, test, PiiCamera::BggrDecoder<>(),
+                                            PiiCamera::Rgb4Pixel<>()),
+                      rgb));
+}
+
+void TestPiiCamera::bayerToRgbBinned()
+{
+  PiiMatrix<unsigned char> test(4,4,
+                                2,4,6,8,
+                                8,6,4,2,
+                                1,2,3,4,
+                                5,6,7,8);
+
+  PiiMatrix<PiiColor4<> > rgb(PiiCamera::bayerToRgbBinned(test, PiiCamera::RggbDecoder<>(),
+                                                          PiiCamera::Rgb4Pixel<>()));
+  QCOMPARE(rgb.rows(), 2);
+  QCOMPARE(rgb.columns(), 2);
+  QVERIFY(rgb(0,0) == PiiColor4<>(2,6,6));
+  QVERIFY(rgb(0,1) == PiiColor4<>(6,6,2));
+  QVERIFY(rgb(1,0) == PiiColor4<>(1,3,6));
+  QVERIFY(rgb(1,1) == PiiColor4<>(3,5,8));
+
+  rgb = PiiCamera::bayerToRgbBinned(test, PiiCamera::BggrDecoder<>(), PiiCamera::Rgb4Pixel<>());
+  QVERIFY(rgb(0,0) == PiiColor4<>(6,6,2));
+
+  rgb = PiiCamera::bayerToRgbBinned(test, PiiCamera::RggbDecoder<>(), PiiCamera::Rgb4Pixel<>(), 4);
+  QCOMPARE(rgb.rows(), 1);
+  QCOMPARE(rgb.columns(), 1);
+  QVERIFY(rgb(0,0) == PiiColor4<>(3,5,5));
+
+  // Extra rows and columns are ignored.
+  PiiMatrix<unsigned char> odd(5,7);
+  QCOMPARE(PiiCamera::bayerToRgbBinned(odd, PiiCamera::GrbgDecoder<>(), PiiCamera::Rgb4Pixel<>()).columns(), 3);
+}
+
 #if 0
 void TestPiiCamera::bayerToRgbSpeed()
 {
@@ -0,0 +1,125 @@
+/* This file is part of Into.
+ * Copyright (C) Intopii 2013.
+ * All rights reserved.
+ *
+ * Licensees holding a commercial Into license may use this file in
+ * accordance with the commercial license agreement. Please see
+ * LICENSE.commercial for commercial licensing terms.
+ *
+ * Alternatively, this file may be used under the terms of the GNU
+ * Affero General Public License version 3 as published by the Free
+ * Software Foundation. In addition, Intopii gives you special rights
+ * to use Into as a part of open source software projects. Please
+ * refer to LICENSE.AGPL3 for details.
+ */
+
+#include "TestPiiChunkedSampleSet.h"
+
+#include <PiiChunkedSampleSet.h>
+#include <PiiSampleSetCollector.h>
+#include <PiiSquaredGeometricDistance.h>
+#include <PiiClassification.h>
+#include <PiiRandom.h>
+#include <QtTest>
+
+void TestPiiChunkedSampleSet::append()
+{
+  PiiMatrix<double> matSamples(Pii::uniformRandomMatrix(30, 3));
+  PiiChunkedSampleSet<float> samples(3, 4);
+  for (int i=0; i<10; ++i)
+    samples.append(matSamples[i]);
+  QCOMPARE(samples.sampleCount(), 10);
+  QCOMPARE(samples.capacity(), 12);
+
+  // Samples must not move when more are added.
+  const float* pSample = samples[5];
+  for (int i=10; i<30; ++i)
+    samples.append(matSamples[i]);
+  QCOMPARE(samples.sampleCount(), 30);
+  QVERIFY(samples[5] == pSample);
+
+  PiiMatrix<float> matStored(samples.toMatrix());
+  QVERIFY(Pii::equals(matStored, PiiMatrix<float>(matSamples)));
+
+  // Copies share chunks until modified.
+  PiiChunkedSampleSet<float> copy(samples);
+  QVERIFY(copy == samples);
+  copy[29][0] = 2;
+  QVERIFY(!(copy == samples));
+  QCOMPARE(samples[29][0], float(matSamples(29,0)));
+
+  samples.remove(3);
+  QCOMPARE(samples.sampleCount(), 29);
+  QCOMPARE(samples[3][1], float(matSamples(4,1)));
+  QCOMPARE(samples[28][2], float(matSamples(29,2)));
+
+  // Generic algorithms work with the converted features.
+  PiiSquaredGeometricDistance<const float*> measure;
+  QCOMPARE(PiiClassification::findClosestMatch(samples[10], samples, measure), 10);
+}
+
+void TestPiiChunkedSampleSet::columnIterator()
+{
+  PiiChunkedSampleSet<int> samples(2, 3);
+  QVERIFY(samples.columnBegin(1) == samples.columnEnd(1));
+  for (int i=0; i<10; ++i)
+    {
+      int aFeatures[2] = { i, -i*i };
+      samples.append(aFeatures);
+    }
+  QCOMPARE(samples.columnEnd(0) - samples.columnBegin(0), 10);
+  int i = 0;
+  for (PiiChunkedSampleSet<int>::ConstColumnIterator it = PiiSampleSet::columnBegin(samples, 1);
+       it != PiiSampleSet::columnEnd(samples, 1); ++it, ++i)
+    QCOMPARE(*it, -i*i);
+  QCOMPARE(i, 10);
+  QCOMPARE(*std::max_element(samples.columnBegin(0), samples.columnEnd(0)), 9);
+
+  PiiMatrix<int> matSamples(samples.toMatrix());
+  QVERIFY(std::equal(samples.columnBegin(1), samples.columnEnd(1),
+                     PiiSampleSet::columnBegin(matSamples, 1)));
+}
+
+void TestPiiChunkedSampleSet::resize()
+{
+  PiiChunkedSampleSet<double> samples(PiiSampleSet::create<PiiChunkedSampleSet<double> >(10, 2));
+  QCOMPARE(samples.sampleCount(), 10);
+  QCOMPARE(samples.featureCount(), 2);
+  QCOMPARE(samples[9][1], 0.0);
+  samples[9][1] = 5;
+  samples[2][0] = 3;
+
+  samples.resize(3);
+  QCOMPARE(samples.sampleCount(), 3);
+  QCOMPARE(samples[2][0], 3.0);
+  samples.resize(10);
+  // Released samples come back as zeros.
+  QCOMPARE(samples[9][1], 0.0);
+
+  PiiSampleSet::reserve(samples, 100000);
+  QVERIFY(samples.capacity() >= 100000);
+  QCOMPARE(samples.sampleCount(), 10);
+
+  PiiSampleSet::resize(samples, 0, 5);
+  QCOMPARE(samples.sampleCount(), 0);
+  QCOMPARE(samples.featureCount(), 5);
+  QCOMPARE(samples.capacity(), 0);
+}
+
+void TestPiiChunkedSampleSet::collector()
+{
+  PiiMatrix<float> matSamples(Pii::uniformRandomMatrix(100, 4));
+  PiiSampleSetCollector<PiiChunkedSampleSet<float> > collector;
+  collector.setBatchSize(-1);
+  for (int i=0; i<100; ++i)
+    collector.learnOne(matSamples[i], 4, i%2, 1);
+  QCOMPARE(collector.sampleCount(), 100);
+  QCOMPARE(collector.classLabels()->size(), 100);
+  QVERIFY(Pii::equals(collector.samples()->toMatrix(), matSamples));
+
+  collector.resize(50);
+  QCOMPARE(collector.sampleCount(), 50);
+  QCOMPARE(collector.classLabels()->size(), 50);
+}
+
+QTEST_MAIN(TestPiiChunkedSampleSet)
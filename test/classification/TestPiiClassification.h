@@ -24,8 +24,16 @@ class TestPiiClassification : public QObject
 
 private slots:
   void kMeans();
+  void parallelKMeans();
+  void miniBatchKMeans();
   void calculateDistanceMatrix();
+  void parallelDistanceMatrix();
   void countLabels();
+  void findClosestMatches();
+  void distanceMeasures();
+  void multiFeatureDistance();
+  void featureStatistics();
+  void multiplyAdd();
 };
 
 
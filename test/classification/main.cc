@@ -18,6 +18,14 @@
 #include <PiiClassification.h>
 #include <PiiSquaredGeometricDistance.h>
 #include <PiiGeometricDistance.h>
+#include <PiiHistogramIntersection.h>
+#include <PiiAbsDiffDistance.h>
+#include <PiiChiSquaredDistance.h>
+#include <PiiHammingDistance.h>
+#include <PiiMultiFeatureDistance.h>
+#include <PiiFeatureStatistics.h>
+#include <PiiRandom.h>
+#include <PiiInvalidArgumentException.h>
 #include <QtTest>
 
 #include <PiiMatrixUtil.h>
@@ -47,6 +55,79 @@ void TestPiiClassification::kMeans()
   QVERIFY(centroids.isEmpty());
 }
 
+// Five well separated clusters with 200 samples each.
+static PiiMatrix<double> clusteredSamples()
+{
+  PiiMatrix<double> matSamples(1000, 3);
+  for (int i=0; i<matSamples.rows(); ++i)
+    for (int f=0; f<3; ++f)
+      matSamples(i,f) = (i % 5) * 10 * (f == 0) + Pii::uniformRandom();
+  return matSamples;
+}
+
+// Each cluster must have a centroid close to its center.
+static bool findsClusters(const PiiMatrix<double>& centroids)
+{
+  if (centroids.rows() != 5)
+    return false;
+  for (int c=0; c<5; ++c)
+    {
+      int iCentroid = PiiClassification::findClosestMatch(PiiMatrix<double>(1, 3, c * 10 + 0.5, 0.5, 0.5)[0],
+                                                          centroids,
+                                                          PiiSquaredGeometricDistance<const double*>());
+      if (Pii::abs(centroids(iCentroid,0) - (c * 10 + 0.5)) > 0.2)
+        return false;
+    }
+  return true;
+}
+
+void TestPiiClassification::parallelKMeans()
+{
+  PiiMatrix<double> matSamples(clusteredSamples());
+  PiiSquaredGeometricDistance<const double*> measure;
+
+  Pii::seedRandom(5);
+  PiiMatrix<double> matSequential(PiiClassification::kMeans(matSamples, 5, measure));
+  Pii::seedRandom(5);
+  Pii::ParallelExecution policy(4);
+  PiiMatrix<double> matParallel(PiiClassification::kMeans(policy, matSamples, 5, measure));
+  QVERIFY(findsClusters(matSequential));
+  // Means are summed in sample order in all threads.
+  QVERIFY(Pii::equals(matSequential, matParallel));
+
+  // Measures other than squared geometric distance are not bounded.
+  Pii::seedRandom(5);
+  QVERIFY(findsClusters(PiiClassification::kMeans(policy, matSamples, 5,
+                                                  PiiAbsDiffDistance<const double*>())));
+
+  // k-means++ never selects the same sample twice.
+  PiiMatrix<double> matCenters(PiiClassification::kMeansPlusPlus(policy, matSamples, 50, measure));
+  QCOMPARE(matCenters.rows(), 50);
+  for (int i=1; i<matCenters.rows(); ++i)
+    for (int j=0; j<i; ++j)
+      QVERIFY(measure(matCenters[i], matCenters[j], 3) > 0);
+}
+
+void TestPiiClassification::miniBatchKMeans()
+{
+  PiiMatrix<double> matSamples(clusteredSamples());
+  PiiSquaredGeometricDistance<const double*> measure;
+  Pii::ParallelExecution policy;
+
+  Pii::seedRandom(5);
+  PiiMatrix<double> matCentroids(PiiClassification::kMeansPlusPlus(policy, matSamples, 5, measure));
+  QVector<int> vecCounts;
+  for (int r=0; r<matSamples.rows(); r += 100)
+    PiiClassification::miniBatchKMeans(policy, matCentroids, vecCounts,
+                                       PiiMatrix<double>(matSamples(r, 0, 100, -1)), measure);
+  QCOMPARE(vecCounts.size(), 5);
+  int iTotal = 0;
+  for (int c=0; c<vecCounts.size(); ++c)
+    iTotal += vecCounts[c];
+  QCOMPARE(iTotal, matSamples.rows());
+  QVERIFY(findsClusters(matCentroids));
+}
+
 void TestPiiClassification::calculateDistanceMatrix()
 {
   /*PiiMatrix<double> matPoints(5,2, 124.0,474.0,
@@ -86,6 +167,72 @@ void TestPiiClassification::calculateDistanceMatrix()
   QCOMPARE(matDistancesSec(2,1),2.0);
 }
 
+struct DistanceRowComparator
+{
+  DistanceRowComparator(const PiiMatrix<double>& distances, int& mismatches) :
+    distances(distances), mismatches(mismatches)
+  {}
+
+  void operator() (int firstRow, const PiiMatrix<double>& rows)
+  {
+    for (int r=0; r<rows.rows(); ++r)
+      for (int c=0; c<rows.columns(); ++c)
+        if (rows(r,c) != distances(firstRow + r, c))
+          ++mismatches;
+  }
+
+  const PiiMatrix<double>& distances;
+  int& mismatches;
+};
+
+template <class Measure>
+static void compareDistanceMatrices(const PiiMatrix<float>& samples, const Measure& measure,
+                                    bool symmetric, bool calculateDiagonal, double tolerance)
+{
+  Pii::ParallelExecution policy(3);
+  policy.minBandRows = 1;
+  PiiMatrix<double> matDistances(PiiClassification::calculateDistanceMatrix(policy, samples, measure,
+                                                                            symmetric, calculateDiagonal));
+  QVERIFY(Pii::equals(matDistances,
+                      PiiClassification::calculateDistanceMatrix(samples, measure,
+                                                                 symmetric, calculateDiagonal)));
+  QCOMPARE(matDistances.rows(), samples.rows());
+  QCOMPARE(matDistances.columns(), samples.rows());
+  for (int r=0; r<samples.rows(); ++r)
+    for (int c=0; c<samples.rows(); ++c)
+      {
+        double dExpected = 0;
+        if (r != c || calculateDiagonal)
+          dExpected = symmetric && c > r ?
+            measure(samples[c], samples[r], samples.columns()) :
+            measure(samples[r], samples[c], samples.columns());
+        QVERIFY(Pii::abs(matDistances(r,c) - dExpected) <= tolerance * (1 + Pii::abs(dExpected)));
+      }
+}
+
+void TestPiiClassification::parallelDistanceMatrix()
+{
+  // Not a multiple of the block size.
+  PiiMatrix<float> matSamples(Pii::uniformRandomMatrix(103, 19));
+  PiiSquaredGeometricDistance<const float*> squaredDistance;
+  // The kernel sums float differences in another order than the
+  // vectorized measure.
+  compareDistanceMatrices(matSamples, squaredDistance, true, false, 1e-6);
+  compareDistanceMatrices(matSamples, squaredDistance, false, true, 1e-6);
+  PiiHistogramIntersection<const float*> intersection;
+  compareDistanceMatrices(matSamples, intersection, true, true, 0);
+  compareDistanceMatrices(matSamples, intersection, false, false, 0);
+  compareDistanceMatrices(PiiMatrix<float>(0, 19), squaredDistance, true, false, 0);
+
+  // Rows are streamed in blocks and equal the full matrix.
+  PiiMatrix<double> matDistances(PiiClassification::calculateDistanceMatrix(matSamples, squaredDistance,
+                                                                            false, true));
+  int iMismatches = 0;
+  PiiClassification::calculateDistanceRows(Pii::ParallelExecution(), matSamples, squaredDistance,
+                                           10, DistanceRowComparator(matDistances, iMismatches));
+  QCOMPARE(iMismatches, 0);
+}
+
 void TestPiiClassification::countLabels()
 {
   QVector<double> labels;
@@ -102,4 +249,230 @@ void TestPiiClassification::countLabels()
   QCOMPARE(counts[3].second, 1);
 }
 
+template <class T, class Measure> static void compareClosestMatches(const PiiMatrix<T>& samples,
+                                                                    const PiiMatrix<T>& models,
+                                                                    const Measure& measure)
+{
+  QVector<double> vecLabels(models.rows());
+  for (int i=0; i<vecLabels.size(); ++i)
+    vecLabels[i] = i % 3;
+
+  QVector<PiiClassification::MatchList> vecMatches(PiiClassification::findClosestMatches(samples, models, measure, 5));
+  QVector<PiiClassification::MatchList> vecParallelMatches(PiiClassification::findClosestMatches(Pii::ParallelExecution(),
+                                                                                                 samples, models, measure, 5));
+  QVector<double> vecDistances;
+  QVector<int> vecIndices;
+  QVector<double> vecClassified(PiiClassification::knnClassify(samples, models, vecLabels, measure, 3,
+                                                               &vecDistances, &vecIndices));
+  QCOMPARE(vecMatches.size(), samples.rows());
+  QCOMPARE(vecParallelMatches.size(), samples.rows());
+  QCOMPARE(vecClassified.size(), samples.rows());
+  for (int i=0; i<samples.rows(); ++i)
+    {
+      PiiClassification::MatchList lstMatches(PiiClassification::findClosestMatches(samples[i], models, measure, 5));
+      QCOMPARE(vecMatches[i].size(), lstMatches.size());
+      QCOMPARE(vecParallelMatches[i].size(), lstMatches.size());
+      for (int j=0; j<lstMatches.size(); ++j)
+        {
+          QCOMPARE(vecMatches[i][j].second, lstMatches[j].second);
+          QCOMPARE(vecMatches[i][j].first, lstMatches[j].first);
+          QCOMPARE(vecParallelMatches[i][j].second, lstMatches[j].second);
+        }
+      double dDistance;
+      int iIndex;
+      QCOMPARE(vecClassified[i], PiiClassification::knnClassify(samples[i], models, vecLabels, measure, 3,
+                                                                &dDistance, &iIndex));
+      QCOMPARE(vecDistances[i], dDistance);
+      QCOMPARE(vecIndices[i], iIndex);
+    }
+}
+
+void TestPiiClassification::findClosestMatches()
+{
+  PiiMatrix<float> matSamples(Pii::uniformRandomMatrix(70, 9)), matModels(Pii::uniformRandomMatrix(600, 9));
+  compareClosestMatches(matSamples, matModels, PiiSquaredGeometricDistance<const float*>());
+  compareClosestMatches(matSamples, matModels, PiiHistogramIntersection<const float*>());
+  // Less models than requested matches
+  compareClosestMatches(matSamples, PiiMatrix<float>(matModels(0,0,4,-1)),
+                        PiiSquaredGeometricDistance<const float*>());
+
+  PiiMatrix<unsigned char> matByteSamples(PiiMatrix<unsigned char>(matSamples * 255)),
+    matByteModels(PiiMatrix<unsigned char>(matModels * 255));
+  compareClosestMatches(matByteSamples, matByteModels, PiiSquaredGeometricDistance<const unsigned char*>());
+  // Polymorphic distance measure
+  PiiDistanceMeasure<const unsigned char*>::Impl<PiiSquaredGeometricDistance<const unsigned char*> > measure;
+  compareClosestMatches(matByteSamples, matByteModels,
+                        static_cast<const PiiDistanceMeasure<const unsigned char*>&>(measure));
+}
+
+// Compares a vectorized measure (const T*) to the generic
+// implementation (T*). Only summation order differs. If all terms
+// are integers, the results must be equal.
+template <template <class> class Measure, class T>
+static void compareDistances(PiiMatrix<T>& samples, bool bounded, bool integerTerms)
+{
+  Measure<const T*> vectorized;
+  Measure<T*> generic;
+  typename PiiDistanceMeasure<const T*>::template Impl<Measure<const T*> > polymorphic;
+  const PiiDistanceMeasure<const T*>& measure = polymorphic;
+  // Lengths that exercise both the vector loop and the tail.
+  const int aLengths[] = { 0, 1, 3, 4, 7, 8, 9, 15, 16, 17, 63, 64, 65, 130, samples.columns() };
+  for (int l=0; l<int(sizeof(aLengths)/sizeof(int)); ++l)
+    {
+      const int iLength = aLengths[l];
+      for (int i=1; i<samples.rows(); ++i)
+        {
+          double dExpected = generic(samples[i-1], samples[i], iLength);
+          double dDistance = vectorized(samples[i-1], samples[i], iLength);
+          QVERIFY(Pii::abs(dDistance - dExpected) <= 1e-12 * Pii::abs(dExpected));
+          if (Pii::IsInteger<T>::boolValue && integerTerms)
+            QCOMPARE(dDistance, dExpected);
+          QCOMPARE(measure(samples[i-1], samples[i], iLength), dDistance);
+
+          // The full distance is returned unless it exceeds the bound.
+          QCOMPARE(measure(samples[i-1], samples[i], iLength, dDistance), dDistance);
+          if (bounded && dExpected > 0)
+            QVERIFY(measure(samples[i-1], samples[i], iLength, dExpected / 2) > dExpected / 2);
+          else
+            QCOMPARE(measure(samples[i-1], samples[i], iLength, dExpected / 2), dDistance);
+        }
+    }
+}
+
+template <class T> static void compareDistances(PiiMatrix<T> samples)
+{
+  compareDistances<PiiSquaredGeometricDistance>(samples, true, true);
+  compareDistances<PiiAbsDiffDistance>(samples, true, true);
+  compareDistances<PiiChiSquaredDistance>(samples, true, false);
+  compareDistances<PiiHistogramIntersection>(samples, false, true);
+}
+
+void TestPiiClassification::distanceMeasures()
+{
+  PiiMatrix<double> matSamples(Pii::uniformRandomMatrix(20, 200) + 0.01);
+  compareDistances(matSamples);
+  compareDistances(PiiMatrix<float>(matSamples));
+  PiiMatrix<int> matIntSamples(matSamples * 1000);
+  compareDistances(matIntSamples);
+  matIntSamples = Pii::uniformRandomMatrix(20, 200) * INT_MAX;
+  compareDistances<PiiHammingDistance>(matIntSamples, true, true);
+  PiiMatrix<unsigned int> matUnsignedSamples(matIntSamples);
+  compareDistances<PiiHammingDistance>(matUnsignedSamples, true, true);
+
+  PiiMatrix<int> matBits(2, 3, 0, 0, 0, 1, -1, 6);
+  QCOMPARE(PiiHammingDistance<const int*>()(matBits[0], matBits[1], 3), 35.0);
+}
+
+void TestPiiClassification::multiFeatureDistance()
+{
+  typedef PiiDistanceMeasure<const float*> Measure;
+  Measure::Impl<PiiMultiFeatureDistance<const float*> > distance;
+  distance << new Measure::Impl<PiiSquaredGeometricDistance<const float*> >
+           << new Measure::Impl<PiiAbsDiffDistance<const float*> >
+           << new Measure::Impl<PiiChiSquaredDistance<const float*> >;
+  distance.setBoundaries(PiiMatrix<int>(1, 3, 4, 20, 36));
+  distance.setWeights(QVector<double>() << 0.5 << 2 << 1);
+
+  PiiMatrix<float> matSamples(Pii::uniformRandomMatrix(40, 36) + 0.01);
+  for (int i=1; i<matSamples.rows(); ++i)
+    {
+      const float* pSample = matSamples[i-1], *pModel = matSamples[i];
+      const double aDistances[] =
+        {
+          0.5 * (*distance[0])(pSample, pModel, 4),
+          2 * (*distance[1])(pSample + 4, pModel + 4, 16),
+          (*distance[2])(pSample + 20, pModel + 20, 16)
+        };
+      double dSum = aDistances[0] + aDistances[1] + aDistances[2];
+      double dMax = qMax(aDistances[0], qMax(aDistances[1], aDistances[2]));
+
+      distance.setCombinationMode(PiiClassification::DistanceSum);
+      distance.setNonNegativeDistances(false);
+      QCOMPARE(distance(pSample, pModel, 36), dSum);
+      // Without non-negative distances the bound is ignored.
+      QCOMPARE(distance(pSample, pModel, 36, dSum / 2), dSum);
+
+      distance.setNonNegativeDistances(true);
+      // Sub-vectors are summed in another order.
+      double dDistance = distance(pSample, pModel, 36);
+      QVERIFY(Pii::abs(dDistance - dSum) <= 1e-12 * dSum);
+      QCOMPARE(distance(pSample, pModel, 36, dDistance), dDistance);
+      QVERIFY(distance(pSample, pModel, 36, dDistance / 2) > dDistance / 2);
+
+      distance.setCombinationMode(PiiClassification::DistanceMax);
+      QCOMPARE(distance(pSample, pModel, 36), dMax);
+      QCOMPARE(distance(pSample, pModel, 36, dMax), dMax);
+      QVERIFY(distance(pSample, pModel, 36, dMax / 2) > dMax / 2);
+    }
+
+  // Early termination doesn't change the nearest neighbors.
+  distance.setCombinationMode(PiiClassification::DistanceSum);
+  compareClosestMatches(PiiMatrix<float>(matSamples(0, 0, 10, -1)), matSamples,
+                        static_cast<const Measure&>(distance));
+
+  qDeleteAll(distance);
+}
+
+void TestPiiClassification::featureStatistics()
+{
+  const PiiMatrix<float> matSamples(4, 2,
+                                    1.0, 10.0,
+                                    3.0, 30.0,
+                                    5.0, 50.0,
+                                    7.0, 70.0);
+  PiiFeatureStatistics all;
+  for (int i=0; i<matSamples.rows(); ++i)
+    all.addSample(matSamples[i], 2);
+  QCOMPARE(all.sampleCount(), qint64(4));
+  QVERIFY(Pii::almostEqual(all.mean(), PiiMatrix<double>(1, 2, 4.0, 40.0), 1e-12));
+  QVERIFY(Pii::almostEqual(all.variance(), PiiMatrix<double>(1, 2, 5.0, 500.0), 1e-12));
+  QVERIFY(Pii::equals(all.min(), PiiMatrix<double>(1, 2, 1.0, 10.0)));
+  QVERIFY(Pii::equals(all.max(), PiiMatrix<double>(1, 2, 7.0, 70.0)));
+
+  // Partial statistics merge to the same result.
+  PiiFeatureStatistics first, second;
+  first.addSamples(matSamples(0, 0, 1, -1));
+  second.addSamples(matSamples(1, 0, -1, -1));
+  first.merge(second);
+  QCOMPARE(first.sampleCount(), qint64(4));
+  QVERIFY(Pii::almostEqual(first.mean(), all.mean(), 1e-12));
+  QVERIFY(Pii::almostEqual(first.variance(), all.variance(), 1e-12));
+  QVERIFY(Pii::equals(first.min(), all.min()));
+  QVERIFY(Pii::equals(first.max(), all.max()));
+
+  try
+    {
+      int aSample[] = { 1, 2, 3 };
+      first.addSample(aSample, 3);
+      QFAIL("Feature count mismatch was not detected.");
+    }
+  catch (PiiInvalidArgumentException&) {}
+
+  first.clear();
+  QVERIFY(first.isEmpty());
+  QCOMPARE(first.featureCount(), 0);
+}
+
+void TestPiiClassification::multiplyAdd()
+{
+  for (int iLength=0; iLength<20; ++iLength)
+    {
+      PiiMatrix<float> matSource(1, iLength), matScale(1, iLength), matOffset(1, iLength), matTarget(1, iLength);
+      PiiMatrix<double> matSourceD(1, iLength), matScaleD(1, iLength), matOffsetD(1, iLength), matTargetD(1, iLength);
+      for (int i=0; i<iLength; ++i)
+        {
+          matSourceD(i) = matSource(i) = i;
+          matScaleD(i) = matScale(i) = 0.5;
+          matOffsetD(i) = matOffset(i) = -i;
+        }
+      PiiClassification::multiplyAdd(matSource[0], matScale[0], matOffset[0], matTarget[0], iLength);
+      PiiClassification::multiplyAdd(matSourceD[0], matScaleD[0], matOffsetD[0], matTargetD[0], iLength);
+      for (int i=0; i<iLength; ++i)
+        {
+          QCOMPARE(matTarget(i), float(-0.5 * i));
+          QCOMPARE(matTargetD(i), -0.5 * i);
+        }
+    }
+}
+
 QTEST_MAIN(TestPiiClassification)
@@ -30,9 +30,15 @@ private slots:
   void hsvToRgb();
   void rgbToFromHsv();
   void correctGamma();
+  void correctGammaImage();
   void rgbToFromYpbpr();
   void rgbToFromYcbcr();
+  void rgbToFromYcbcrImage();
+  void nv12toRgb();
+  void xyzToFromLab();
   void autocorrelogram();
+  void toIndexed();
+  void colorDistances();
 };
 
 
@@ -136,6 +136,18 @@ void TestPiiColors::normalizedRgb()
     QVERIFY(Pii::equals(red, PiiMatrix<unsigned char>(1,1,15)));
     QVERIFY(Pii::equals(green, PiiMatrix<unsigned char>(1,1,0)));
   }
+  {
+    PiiMatrix<PiiColor<> > clrMat(23,17);
+    for (int r=0; r<clrMat.rows(); ++r)
+      for (int c=0; c<clrMat.columns(); ++c)
+        clrMat(r,c) = PiiColor<>((r*13 + c) % 256, (c*29) % 256, (r*c) % 256);
+
+    PiiMatrix<unsigned char> red, blue, parallelRed, parallelBlue;
+    PiiColors::normalizedRgb(clrMat, red, blue, 255, 0, 2);
+    PiiColors::normalizedRgb(Pii::ParallelExecution(), clrMat, parallelRed, parallelBlue, 255, 0, 2);
+    QVERIFY(Pii::equals(red, parallelRed));
+    QVERIFY(Pii::equals(blue, parallelBlue));
+  }
 }
 
 void TestPiiColors::rgbToHsv()
@@ -224,6 +236,38 @@ void TestPiiColors::correctGamma()
     }
 }
 
+void TestPiiColors::correctGammaImage()
+{
+  PiiMatrix<unsigned char> matGray(1,256);
+  PiiMatrix<PiiColor4<> > matColor(1,256);
+  for (int i=0; i<256; ++i)
+    {
+      matGray(i) = (unsigned char)i;
+      matColor(i) = PiiColor4<>(i, 255-i, i/2, 7);
+    }
+
+  PiiMatrix<unsigned char> matCorrectedGray(PiiColors::correctGamma(matGray, 1.0/2.2, 255));
+  PiiMatrix<PiiColor4<> > matCorrectedColor(PiiColors::correctGamma(matColor, 1.0/2.2, 255));
+  for (int i=0; i<256; ++i)
+    {
+      QCOMPARE(matCorrectedGray(i), PiiColors::correctGamma(matGray(i), 1.0/2.2, 255));
+      PiiColor4<> clr(PiiColors::correctGamma(matColor(i), 1.0/2.2, 255));
+      QCOMPARE(matCorrectedColor(i).c0, clr.c0);
+      QCOMPARE(matCorrectedColor(i).c1, clr.c1);
+      QCOMPARE(matCorrectedColor(i).c2, clr.c2);
+      // The fourth channel is not touched
+      QCOMPARE(matCorrectedColor(i).c3, (unsigned char)7);
+    }
+
+  // Large enough to use a look-up table
+  PiiMatrix<unsigned short> matWide(1,65536);
+  for (int i=0; i<65536; ++i)
+    matWide(i) = (unsigned short)i;
+  PiiMatrix<unsigned short> matCorrectedWide(PiiColors::correctGamma(matWide, 2.2, 65535));
+  for (int i=0; i<65536; i += 97)
+    QCOMPARE(matCorrectedWide(i), PiiColors::correctGamma(matWide(i), 2.2, 65535));
+}
+
 void TestPiiColors::rgbToFromYpbpr()
 {
   for (int r=0; r<256; r+=16)
@@ -280,6 +324,96 @@ void TestPiiColors::rgbToFromYcbcr()
         }
 }
 
+void TestPiiColors::rgbToFromYcbcrImage()
+{
+  // Every combination of three channels, in steps of 5
+  PiiMatrix<PiiColor<> > matRgb(1, 52*52*52);
+  PiiMatrix<PiiColor4<> > matRgb4(1, 52*52*52);
+  for (int r=0; r<52; ++r)
+    for (int g=0; g<52; ++g)
+      for (int b=0; b<52; ++b)
+        {
+          matRgb((r*52+g)*52+b) = PiiColor<>(r*5, g*5, b*5);
+          matRgb4((r*52+g)*52+b) = PiiColor4<>(r*5, g*5, b*5, 1);
+        }
+
+  PiiMatrix<PiiColor<> > matYcbcr(PiiColors::rgbToYcbcr(matRgb));
+  PiiMatrix<PiiColor4<> > matYcbcr4(PiiColors::rgbToYcbcr(matRgb4));
+  PiiMatrix<PiiColor<> > matRgb2(PiiColors::ycbcrToRgb(matRgb));
+  PiiMatrix<PiiColor4<> > matRgb24(PiiColors::ycbcrToRgb(matRgb4));
+
+  // The row kernels must give exactly the same result as the
+  // per-pixel functions.
+  for (int i=0; i<matRgb.columns(); ++i)
+    {
+      PiiColor<> ybr(PiiColors::rgbToYcbcr(matRgb(i)));
+      QCOMPARE(matYcbcr(i).c0, ybr.c0);
+      QCOMPARE(matYcbcr(i).c1, ybr.c1);
+      QCOMPARE(matYcbcr(i).c2, ybr.c2);
+      QCOMPARE(matYcbcr4(i).c0, ybr.c0);
+      QCOMPARE(matYcbcr4(i).c1, ybr.c1);
+      QCOMPARE(matYcbcr4(i).c2, ybr.c2);
+      QCOMPARE(matYcbcr4(i).c3, (unsigned char)0);
+
+      PiiColor<> rgb(PiiColors::ycbcrToRgb(matRgb(i)));
+      QCOMPARE(matRgb2(i).c0, rgb.c0);
+      QCOMPARE(matRgb2(i).c1, rgb.c1);
+      QCOMPARE(matRgb2(i).c2, rgb.c2);
+      QCOMPARE(matRgb24(i).c0, rgb.c0);
+      QCOMPARE(matRgb24(i).c1, rgb.c1);
+      QCOMPARE(matRgb24(i).c2, rgb.c2);
+    }
+}
+
+void TestPiiColors::nv12toRgb()
+{
+  // 4x2 frame: two chroma pairs shared by 2x2 blocks
+  const unsigned char aNv12[] =
+    {
+      10, 20, 30, 40,
+      50, 60, 70, 80,
+      100, 150, 200, 50
+    };
+  // The same samples in YUYV order, one row at a time
+  const unsigned char aYuyv[] =
+    {
+      10, 100, 20, 150, 30, 200, 40, 50,
+      50, 100, 60, 150, 70, 200, 80, 50
+    };
+  PiiMatrix<PiiColor<> > matNv12(PiiColors::nv12toRgb<PiiColor<> >(aNv12, 4, 2));
+  PiiMatrix<PiiColor<> > matYuyv(PiiColors::yuv422toRgb<PiiColor<> >(aYuyv, 4, 2));
+  QCOMPARE(matNv12.rows(), 2);
+  QCOMPARE(matNv12.columns(), 4);
+  for (int r=0; r<2; ++r)
+    for (int c=0; c<4; ++c)
+      {
+        QCOMPARE(matNv12(r,c).c0, matYuyv(r,c).c0);
+        QCOMPARE(matNv12(r,c).c1, matYuyv(r,c).c1);
+        QCOMPARE(matNv12(r,c).c2, matYuyv(r,c).c2);
+      }
+}
+
+void TestPiiColors::xyzToFromLab()
+{
+  PiiColor<float> white(0.95047f, 1.0f, 1.08883f);
+  PiiColor<float> lab(PiiColors::xyzToLab(white, white));
+  QVERIFY(Pii::abs(lab.labL - 100) < 1e-4);
+  QVERIFY(Pii::abs(lab.labA) < 1e-4);
+  QVERIFY(Pii::abs(lab.labB) < 1e-4);
+
+  // sRGB red
+  PiiColor<float> red(0.4124f, 0.2126f, 0.0193f);
+  lab = PiiColors::xyzToLab(red, white);
+  QVERIFY(Pii::abs(lab.labL - 53.24f) < 0.01);
+  QVERIFY(Pii::abs(lab.labA - 80.09f) < 0.05);
+  QVERIFY(Pii::abs(lab.labB - 67.20f) < 0.05);
+
+  PiiColor<float> xyz(PiiColors::labToXyz(lab, white));
+  QVERIFY(Pii::abs(xyz.xyzX - red.xyzX) < 1e-4);
+  QVERIFY(Pii::abs(xyz.xyzY - red.xyzY) < 1e-4);
+  QVERIFY(Pii::abs(xyz.xyzZ - red.xyzZ) < 1e-4);
+}
+
 void TestPiiColors::autocorrelogram()
 {
   PiiMatrix<int> input1(4,4,
@@ -307,6 +441,60 @@ void TestPiiColors::autocorrelogram()
   QVERIFY(Pii::almostEqual(c1, r1, 1e-6));
   QVERIFY(Pii::almostEqual(c2, r2, 1e-6));
   QVERIFY(Pii::almostEqual(PiiColors::autocorrelogram(Pii::matrix(Pii::transpose(input2)), 4), r2, 1e-6));
+
+  // Band-parallel computation must match the sequential one.
+  PiiMatrix<int> input3(37, 29);
+  for (int r=0; r<input3.rows(); ++r)
+    for (int c=0; c<input3.columns(); ++c)
+      input3(r,c) = (r*7 + c*c*3 + r*c) % 5;
+  QList<int> lstDistances;
+  lstDistances << 1 << 2 << 5 << 9;
+  QVERIFY(Pii::almostEqual(PiiColors::autocorrelogram(Pii::ParallelExecution(), input3, lstDistances, 5),
+                           PiiColors::autocorrelogram(Pii::ParallelExecution(1), input3, lstDistances, 5),
+                           1e-4));
+  QVERIFY(Pii::almostEqual(PiiColors::autocorrelogram(Pii::ParallelExecution(), input1, QList<int>() << 1 << 2 << 3, 2),
+                           r1, 1e-6));
+}
+
+void TestPiiColors::toIndexed()
+{
+  PiiMatrix<PiiColor<> > clrMat(1,3);
+  clrMat(0,0) = PiiColor<>(0,0,0);
+  clrMat(0,1) = PiiColor<>(255,255,255);
+  clrMat(0,2) = PiiColor<>(255,64,127);
+  // The maximum value must map to the highest level.
+  QVERIFY(Pii::equals(PiiColors::toIndexed(clrMat, 4), PiiMatrix<int>(1,3, 0, 63, 3*16 + 1*4 + 1)));
+  QVERIFY(Pii::equals(PiiColors::toIndexed(clrMat, 2, 3, 4), PiiMatrix<int>(1,3, 0, 23, 12 + 0*4 + 1)));
+}
+
+void TestPiiColors::colorDistances()
+{
+  PiiMatrix<double> matBase(3,3,
+                            0.02, 0.01, 0.0,
+                            -0.01, 0.03, 0.005,
+                            0.0, 0.002, 0.04);
+  PiiMatrix<double> matCenter(1,3, 120.0, 80.0, 200.0);
+  PiiMatrix<PiiColor<> > clrImage(9, 13);
+  PiiMatrix<PiiColor4<> > clr4Image(9, 13);
+  for (int r=0; r<clrImage.rows(); ++r)
+    for (int c=0; c<clrImage.columns(); ++c)
+      {
+        clrImage(r,c) = PiiColor<>((r*31 + c*7) % 256, (r*c*5 + 60) % 256, (c*19 + 150) % 256);
+        clr4Image(r,c) = clrImage(r,c);
+      }
+
+  PiiMatrix<float> matExpected(PiiColors::matchColors(clrImage, matBase, matCenter, Pii::Identity<float>()));
+  PiiMatrix<float> matDistances(PiiColors::colorDistances(Pii::ParallelExecution(), clrImage, matBase, matCenter));
+  QVERIFY(Pii::almostEqual(matDistances, matExpected, 1e-3));
+  QVERIFY(Pii::almostEqual(PiiColors::colorDistances(Pii::ParallelExecution(1), clr4Image, matBase, matCenter),
+                           matExpected, 1e-3));
+
+  PiiMatrix<unsigned char> matMask(PiiColors::matchColors(Pii::ParallelExecution(), clrImage, matBase, matCenter, 25.0));
+  QCOMPARE(matMask.rows(), clrImage.rows());
+  QCOMPARE(matMask.columns(), clrImage.columns());
+  for (int r=0; r<matMask.rows(); ++r)
+    for (int c=0; c<matMask.columns(); ++c)
+      QCOMPARE(int(matMask(r,c)), matDistances(r,c) < 25.0f ? 1 : 0);
 }
 
 QTEST_MAIN(TestPiiColors)
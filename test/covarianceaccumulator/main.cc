@@ -0,0 +1,109 @@
+/* This file is part of Into.
+ * Copyright (C) Intopii 2013.
+ * All rights reserved.
+ *
+ * Licensees holding a commercial Into license may use this file in
+ * accordance with the commercial license agreement. Please see
+ * LICENSE.commercial for commercial licensing terms.
+ *
+ * Alternatively, this file may be used under the terms of the GNU
+ * Affero General Public License version 3 as published by the Free
+ * Software Foundation. In addition, Intopii gives you special rights
+ * to use Into as a part of open source software projects. Please
+ * refer to LICENSE.AGPL3 for details.
+ */
+
+
+#include "TestPiiCovarianceAccumulator.h"
+#include <PiiCovarianceAccumulator.h>
+#include <PiiMath.h>
+#include <PiiRandom.h>
+#include <PiiInvalidArgumentException.h>
+
+#include <QtTest>
+
+void TestPiiCovarianceAccumulator::addSamples()
+{
+  PiiCovarianceAccumulator accumulator;
+  QCOMPARE(accumulator.count(), qint64(0));
+  QCOMPARE(accumulator.dimensions(), 0);
+
+  // A large offset would destroy the precision of a sum of squares.
+  PiiMatrix<double> matSamples(Pii::normalRandomMatrix(1000, 3) + 1e8);
+  PiiMatrix<double> matMean;
+  PiiMatrix<double> matExpected(Pii::covariance(matSamples, &matMean));
+
+  for (int r=0; r<matSamples.rows(); r+=37)
+    accumulator.addSamples(PiiMatrix<double>(matSamples(r, 0, qMin(37, matSamples.rows() - r), -1)));
+  QCOMPARE(accumulator.count(), qint64(1000));
+  QCOMPARE(accumulator.dimensions(), 3);
+  QVERIFY(Pii::almostEqual(accumulator.mean(), matMean, 1e-6));
+  QVERIFY(Pii::almostEqual(accumulator.covariance(), matExpected, 1e-6));
+
+  // Other types are converted.
+  PiiCovarianceAccumulator intAccumulator;
+  intAccumulator.addSamples(PiiMatrix<int>(3, 2,
+                                           1, 2,
+                                           3, 2,
+                                           5, 8));
+  QVERIFY(Pii::almostEqual(intAccumulator.mean(), PiiMatrix<double>(1, 2, 3.0, 4.0), 1e-12));
+  QVERIFY(Pii::almostEqual(intAccumulator.scatter(), PiiMatrix<double>(2, 2, 8.0, 12.0, 12.0, 24.0), 1e-12));
+
+  try
+    {
+      intAccumulator.addSamples(PiiMatrix<int>(1, 3));
+      QFAIL("Wrong dimensions were accepted.");
+    }
+  catch (PiiInvalidArgumentException&) {}
+
+  intAccumulator.clear();
+  QCOMPARE(intAccumulator.count(), qint64(0));
+  intAccumulator.addSamples(PiiMatrix<int>(1, 3));
+  QCOMPARE(intAccumulator.dimensions(), 3);
+}
+
+void TestPiiCovarianceAccumulator::merge()
+{
+  PiiMatrix<double> matSamples(Pii::normalRandomMatrix(500, 4));
+  PiiCovarianceAccumulator all, first, second;
+  all.addSamples(matSamples);
+  first.addSamples(PiiMatrix<double>(matSamples(0, 0, 123, -1)));
+  second.addSamples(PiiMatrix<double>(matSamples(123, 0, -1, -1)));
+
+  PiiCovarianceAccumulator copy(first);
+  first.merge(second);
+  QCOMPARE(first.count(), qint64(500));
+  QVERIFY(Pii::almostEqual(first.mean(), all.mean(), 1e-12));
+  QVERIFY(Pii::almostEqual(first.scatter(), all.scatter(), 1e-10));
+  // Implicit sharing
+  QCOMPARE(copy.count(), qint64(123));
+
+  // Merging with self doubles the samples but retains the covariance.
+  PiiMatrix<double> matCovariance(all.covariance());
+  all.merge(all);
+  QCOMPARE(all.count(), qint64(1000));
+  QVERIFY(Pii::almostEqual(all.scatter(), PiiMatrix<double>(first.scatter() * 2.0), 1e-10));
+  QVERIFY(Pii::almostEqual(all.covariance(), PiiMatrix<double>(matCovariance * (998.0 / 999)), 1e-10));
+}
+
+void TestPiiCovarianceAccumulator::principalComponents()
+{
+  // Samples spread along (1,1)/sqrt(2) with a scatter of 16 and
+  // along (1,-1)/sqrt(2) with a scatter of 4.
+  PiiMatrix<double> matSamples(4, 2,
+                               2.0, 2.0,
+                               -2.0, -2.0,
+                               1.0, -1.0,
+                               -1.0, 1.0);
+  PiiCovarianceAccumulator accumulator;
+  accumulator.addSamples(PiiMatrix<double>(matSamples(0, 0, 2, -1)));
+  accumulator.addSamples(PiiMatrix<double>(matSamples(2, 0, 2, -1)));
+  PiiMatrix<double> matVariances;
+  PiiMatrix<double> matBase(accumulator.principalComponents(&matVariances));
+  QVERIFY(Pii::almostEqual(matVariances, PiiMatrix<double>(1, 2, 16.0/3, 4.0/3), 1e-12));
+  QVERIFY(Pii::abs(Pii::abs(matBase(0,0)) - M_SQRT1_2) < 1e-12);
+  QVERIFY(Pii::abs(matBase(0,0) - matBase(1,0)) < 1e-12);
+  QVERIFY(Pii::abs(matBase(0,1) + matBase(1,1)) < 1e-12);
+}
+
+QTEST_MAIN(TestPiiCovarianceAccumulator)
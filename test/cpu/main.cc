@@ -0,0 +1,95 @@
+/* This file is part of Into.
+ * Copyright (C) Intopii 2013.
+ * All rights reserved.
+ *
+ * Licensees holding a commercial Into license may use this file in
+ * accordance with the commercial license agreement. Please see
+ * LICENSE.commercial for commercial licensing terms.
+ *
+ * Alternatively, this file may be used under the terms of the GNU
+ * Affero General Public License version 3 as published by the Free
+ * Software Foundation. In addition, Intopii gives you special rights
+ * to use Into as a part of open source software projects. Please
+ * refer to LICENSE.AGPL3 for details.
+ */
+
+#include "TestPiiCpu.h"
+
+#include <QtTest>
+#include <PiiCpu.h>
+
+namespace
+{
+  typedef int (*Kernel)();
+  int genericKernel() { return 0; }
+  int sse2Kernel() { return 1; }
+  int avx2Kernel() { return 2; }
+}
+
+void TestPiiCpu::parseCpuFeatures_data()
+{
+  QTest::addColumn<QString>("names");
+  QTest::addColumn<int>("features");
+
+  QTest::newRow("empty") << "" << int(Pii::NoCpuFeatures);
+  QTest::newRow("none") << "none" << int(Pii::NoCpuFeatures);
+  QTest::newRow("single") << "avx2" << int(Pii::Avx2CpuFeature);
+  QTest::newRow("list") << "sse2, sse4.1,fma" <<
+    int(Pii::Sse2CpuFeature | Pii::Sse41CpuFeature | Pii::FmaCpuFeature);
+  QTest::newRow("unknown") << "avx,mmx,,neon " << int(Pii::AvxCpuFeature | Pii::NeonCpuFeature);
+}
+
+void TestPiiCpu::parseCpuFeatures()
+{
+  QFETCH(QString, names);
+  QFETCH(int, features);
+  QCOMPARE(Pii::parseCpuFeatures(names.toLatin1().constData()), features);
+}
+
+void TestPiiCpu::featureMask()
+{
+  const int iOldMask = Pii::cpuFeatureMask();
+  const int iDetected = Pii::detectedCpuFeatures();
+#if defined(__x86_64__) || defined(_M_X64)
+  QVERIFY(iDetected & Pii::Sse2CpuFeature);
+#elif defined(__aarch64__)
+  QVERIFY(iDetected & Pii::NeonCpuFeature);
+#endif
+
+  Pii::setCpuFeatureMask(Pii::AllCpuFeatures);
+  QCOMPARE(Pii::cpuFeatures(), iDetected);
+  Pii::setCpuFeatureMask(Pii::NoCpuFeatures);
+  QCOMPARE(Pii::cpuFeatures(), int(Pii::NoCpuFeatures));
+  QVERIFY(Pii::hasCpuFeatures(Pii::NoCpuFeatures));
+  Pii::setCpuFeatureMask(Pii::Sse2CpuFeature);
+  QCOMPARE(Pii::cpuFeatures(), iDetected & Pii::Sse2CpuFeature);
+
+  Pii::setCpuFeatureMask(iOldMask);
+}
+
+void TestPiiCpu::dispatcher()
+{
+  const int iOldMask = Pii::cpuFeatureMask();
+  const PiiCpuDispatcher<Kernel> kernel =
+    PiiCpuDispatcher<Kernel>(genericKernel)
+    .add(Pii::Sse2CpuFeature, sse2Kernel)
+    .add(Pii::Avx2CpuFeature | Pii::FmaCpuFeature, avx2Kernel)
+    .add(Pii::NeonCpuFeature, 0);
+
+  Pii::setCpuFeatureMask(Pii::NoCpuFeatures);
+  QCOMPARE(kernel.function()(), 0);
+  QCOMPARE(kernel.features(), int(Pii::NoCpuFeatures));
+
+  Pii::setCpuFeatureMask(Pii::Sse2CpuFeature | Pii::Avx2CpuFeature);
+  QCOMPARE(kernel.function()(), Pii::hasCpuFeatures(Pii::Sse2CpuFeature) ? 1 : 0);
+
+  Pii::setCpuFeatureMask(Pii::AllCpuFeatures);
+  if (Pii::hasCpuFeatures(Pii::Avx2CpuFeature | Pii::FmaCpuFeature))
+    QCOMPARE(kernel.function()(), 2);
+  // The null NEON kernel must never be chosen.
+  QVERIFY(kernel.function() != 0);
+
+  Pii::setCpuFeatureMask(iOldMask);
+}
+
+QTEST_MAIN(TestPiiCpu)
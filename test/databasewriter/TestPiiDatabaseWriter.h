@@ -25,6 +25,8 @@ class TestPiiDatabaseWriter : public PiiOperationTest
 private slots:
   void initTestCase();
   void process();
+  void batch_data();
+  void batch();
 };
 
 
@@ -52,4 +52,51 @@ void TestPiiDatabaseWriter::process()
   QCOMPARE(strCsv, QString("\"\"\"abc\"\"\",\"123\"\n"));
 }
 
+void TestPiiDatabaseWriter::batch_data()
+{
+  QTest::addColumn<int>("batchSize");
+  QTest::addColumn<bool>("backgroundWriting");
+
+  QTest::newRow("single") << 1 << false;
+  QTest::newRow("batch") << 2 << false;
+  QTest::newRow("background") << 1 << true;
+  QTest::newRow("background batch") << 2 << true;
+}
+
+void TestPiiDatabaseWriter::batch()
+{
+  QFETCH(int, batchSize);
+  QFETCH(bool, backgroundWriting);
+
+  QString strFileName("test.csv");
+  QFile file(strFileName);
+  QVERIFY(!file.exists() || file.remove());
+
+  disconnectAllInputs();
+  operation()->setProperty("columnNames", QStringList() << "test1" << "test2");
+  operation()->setProperty("databaseUri", "csv://");
+  operation()->setProperty("databaseName", strFileName);
+  operation()->setProperty("batchSize", batchSize);
+  operation()->setProperty("backgroundWriting", backgroundWriting);
+  QVERIFY(connectInput("input0"));
+  QVERIFY(connectInput("input1"));
+
+  QVERIFY(start());
+  // Three rows leave a partial batch that must be flushed on stop.
+  for (int i=0; i<3; ++i)
+    {
+      QVERIFY(sendObject("input0", QString("row%1").arg(i)));
+      QVERIFY(sendObject("input1", i));
+    }
+  QVERIFY(stop());
+
+  QVERIFY(file.open(QIODevice::ReadOnly));
+  QString strCsv(file.readAll());
+  file.close();
+
+  QCOMPARE(strCsv, QString("\"row0\",\"0\"\n"
+                           "\"row1\",\"1\"\n"
+                           "\"row2\",\"2\"\n"));
+}
+
 QTEST_MAIN(TestPiiDatabaseWriter)
@@ -17,6 +17,7 @@
 #define _TESTOPERATION_H
 
 #include <PiiDefaultOperation.h>
+#include <PiiAtomicInt.h>
 
 class CounterOperation : public PiiDefaultOperation
 {
@@ -46,6 +47,8 @@ public:
   void setProp4(int prop4) { _iProp4 = prop4; }
   int prop4() const { return _iProp4; }
 
+  PiiAtomicInt iProcessCount;
+
 private slots:
   QVariant prop1_itself() const { return _iProp1; }
 
@@ -67,6 +70,8 @@ public:
 
 protected:
   void process();
+  void saveState(PiiGenericOutputArchive& archive);
+  void loadState(PiiGenericInputArchive& archive);
 };
 
 
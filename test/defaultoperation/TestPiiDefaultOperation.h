@@ -33,8 +33,19 @@ private slots:
   void metaProperties();
   void process();
   void process_data();
+  void queueMode();
+  void queueMode_data();
+  void threadPool();
+  void threadPool_data();
+  void orderedOutput();
+  void adaptiveThreadCount();
+  void adaptiveThreadCount_data();
+  void memoization();
+  void checkpoint();
 
 private:
+  void runMemoized(int processCount);
+
   enum { sequenceLength = 2048 };
   PiiEngine _engine;
   CounterOperation* _pCounter;
@@ -18,6 +18,10 @@
 #include <QtTest>
 
 #include <PiiYdinUtil.h>
+#include <PiiResultCache.h>
+#include <PiiGenericInputArchive.h>
+#include <PiiGenericOutputArchive.h>
+#include <QDir>
 
 CounterOperation::CounterOperation() :
   _iProp1(0),
@@ -26,6 +30,7 @@ CounterOperation::CounterOperation() :
   _iProp4(0)
 {
   setObjectName("counter");
+  setDeterministic(true);
   addSocket(new PiiInputSocket("input"));
   addSocket(new PiiOutputSocket("output0"));
   addSocket(new PiiOutputSocket("output1"));
@@ -33,6 +38,7 @@ CounterOperation::CounterOperation() :
 
 void CounterOperation::process()
 {
+  ++iProcessCount;
   int iValue = readInput().valueAs<int>();
   outputAt(0)->emitObject(iValue);
   outputAt(1)->emitObject(iValue*2);
@@ -51,6 +57,27 @@ void BufferOperation::process()
                        inputAt(1)->firstObject().valueAs<int>());
 }
 
+void BufferOperation::saveState(PiiGenericOutputArchive& archive)
+{
+  const int iCount = lstData.size();
+  archive << iCount;
+  for (int i=0; i<iCount; ++i)
+    archive << lstData[i].first << lstData[i].second;
+}
+
+void BufferOperation::loadState(PiiGenericInputArchive& archive)
+{
+  int iCount;
+  archive >> iCount;
+  lstData.clear();
+  for (int i=0; i<iCount; ++i)
+    {
+      int iFirst, iSecond;
+      archive >> iFirst >> iSecond;
+      lstData << qMakePair(iFirst, iSecond);
+    }
+}
+
 void TestPiiDefaultOperation::initTestCase()
 {
   try
@@ -207,4 +234,248 @@ void TestPiiDefaultOperation::process_data()
     QTest::newRow(qPrintable(QString::number(i))) << i;
 }
 
+void TestPiiDefaultOperation::queueMode()
+{
+  QFETCH(int, queueMode);
+  QFETCH(int, threadCount);
+
+  _pBuffer->lstData.clear();
+  _pCounter->setProperty("threadCount", threadCount);
+  _pBuffer->setProperty("threadCount", 1);
+  for (int i=0; i<2; ++i)
+    _pBuffer->inputAt(i)->setQueueMode(PiiInputSocket::QueueMode(queueMode));
+  try
+    {
+      _engine.execute();
+    }
+  catch (PiiException& ex)
+    {
+      QFAIL(qPrintable(ex.message()));
+    }
+
+  QVERIFY(_engine.wait(PiiOperation::Stopped, 1000));
+
+  for (int i=0; i<2; ++i)
+    _pBuffer->inputAt(i)->setQueueMode(PiiInputSocket::LockedQueue);
+  _pBuffer->setProperty("threadCount", 0);
+
+  QCOMPARE(_pBuffer->lstData.size(), int(sequenceLength));
+  QList<QPair<int,int> > lstData(_pBuffer->lstData);
+  for (int i=0; i<sequenceLength; ++i)
+    {
+      QCOMPARE(lstData[i].first, i);
+      QCOMPARE(lstData[i].second, i*2);
+    }
+}
+
+void TestPiiDefaultOperation::queueMode_data()
+{
+  QTest::addColumn<int>("queueMode");
+  QTest::addColumn<int>("threadCount");
+
+  QTest::newRow("spsc, 0") << int(PiiInputSocket::SingleProducerQueue) << 0;
+  QTest::newRow("spsc, 1") << int(PiiInputSocket::SingleProducerQueue) << 1;
+  QTest::newRow("mpsc, 1") << int(PiiInputSocket::MultiProducerQueue) << 1;
+  QTest::newRow("mpsc, 4") << int(PiiInputSocket::MultiProducerQueue) << 4;
+}
+
+void TestPiiDefaultOperation::threadPool()
+{
+  QFETCH(int, poolSize);
+  QFETCH(int, threadCount);
+
+  _pBuffer->lstData.clear();
+  _engine.setThreadPoolSize(poolSize);
+  _pCounter->setProperty("threadCount", threadCount);
+  try
+    {
+      _engine.execute();
+    }
+  catch (PiiException& ex)
+    {
+      QFAIL(qPrintable(ex.message()));
+    }
+
+  QVERIFY(_engine.wait(PiiOperation::Stopped, 1000));
+  QVERIFY(_pCounter->threadPool() != 0);
+  _engine.setThreadPoolSize(0);
+
+  QCOMPARE(_pBuffer->lstData.size(), int(sequenceLength));
+  QList<QPair<int,int> > lstData(_pBuffer->lstData);
+  for (int i=0; i<sequenceLength; ++i)
+    {
+      QCOMPARE(lstData[i].first, i);
+      QCOMPARE(lstData[i].second, i*2);
+    }
+}
+
+void TestPiiDefaultOperation::threadPool_data()
+{
+  QTest::addColumn<int>("poolSize");
+  QTest::addColumn<int>("threadCount");
+
+  QTest::newRow("1, 2") << 1 << 2;
+  QTest::newRow("2, 4") << 2 << 4;
+  QTest::newRow("4, 2") << 4 << 2;
+  QTest::newRow("ideal, 6") << -1 << 6;
+}
+
+void TestPiiDefaultOperation::orderedOutput()
+{
+  _pBuffer->lstData.clear();
+  _pCounter->setProperty("threadCount", 4);
+  QVERIFY(_pCounter->setProperty("orderedOutput", false));
+  try
+    {
+      _engine.execute();
+    }
+  catch (PiiException& ex)
+    {
+      QFAIL(qPrintable(ex.message()));
+    }
+
+  QVERIFY(_engine.wait(PiiOperation::Stopped, 1000));
+  _pCounter->setProperty("orderedOutput", true);
+
+  // Order is not guaranteed, but nothing may be lost.
+  QCOMPARE(_pBuffer->lstData.size(), int(sequenceLength));
+  QList<int> lstFirst, lstSecond;
+  for (int i=0; i<sequenceLength; ++i)
+    {
+      lstFirst << _pBuffer->lstData[i].first;
+      lstSecond << _pBuffer->lstData[i].second;
+    }
+  qSort(lstFirst);
+  qSort(lstSecond);
+  for (int i=0; i<sequenceLength; ++i)
+    {
+      QCOMPARE(lstFirst[i], i);
+      QCOMPARE(lstSecond[i], i*2);
+    }
+}
+
+void TestPiiDefaultOperation::adaptiveThreadCount()
+{
+  QFETCH(int, poolSize);
+
+  _pBuffer->lstData.clear();
+  _engine.setThreadPoolSize(poolSize);
+  _pCounter->setProperty("threadCount", 8);
+  _pCounter->setProperty("minThreadCount", 1);
+  _pCounter->setProperty("maxThreadCount", 4);
+  try
+    {
+      _engine.execute();
+    }
+  catch (PiiException& ex)
+    {
+      QFAIL(qPrintable(ex.message()));
+    }
+
+  // The initial count is limited to maxThreadCount.
+  int iActive = _pCounter->property("activeThreadCount").toInt();
+  QVERIFY(iActive >= 1 && iActive <= 4);
+  QVERIFY(_engine.wait(PiiOperation::Stopped, 1000));
+  _engine.setThreadPoolSize(0);
+  _pCounter->setProperty("maxThreadCount", 0);
+  _pCounter->setProperty("minThreadCount", 0);
+
+  QCOMPARE(_pBuffer->lstData.size(), int(sequenceLength));
+  QList<QPair<int,int> > lstData(_pBuffer->lstData);
+  for (int i=0; i<sequenceLength; ++i)
+    {
+      QCOMPARE(lstData[i].first, i);
+      QCOMPARE(lstData[i].second, i*2);
+    }
+}
+
+void TestPiiDefaultOperation::adaptiveThreadCount_data()
+{
+  QTest::addColumn<int>("poolSize");
+
+  QTest::newRow("threads") << 0;
+  QTest::newRow("pool") << 4;
+}
+
+void TestPiiDefaultOperation::runMemoized(int processCount)
+{
+  _pBuffer->lstData.clear();
+  _pCounter->iProcessCount = 0;
+  try
+    {
+      _engine.execute();
+    }
+  catch (PiiException& ex)
+    {
+      QFAIL(qPrintable(ex.message()));
+    }
+  QVERIFY(_engine.wait(PiiOperation::Stopped, 1000));
+
+  QCOMPARE(_pCounter->iProcessCount.load(), processCount);
+  QCOMPARE(_pBuffer->lstData.size(), int(sequenceLength));
+  for (int i=0; i<sequenceLength; ++i)
+    {
+      QCOMPARE(_pBuffer->lstData[i].first, i);
+      QCOMPARE(_pBuffer->lstData[i].second, i*2);
+    }
+}
+
+void TestPiiDefaultOperation::memoization()
+{
+  _pCounter->setProperty("threadCount", 0);
+  _pCounter->setProperty("prop1", 0);
+
+  PiiResultCache memoryCache;
+  _engine.setResultCache(&memoryCache);
+  runMemoized(sequenceLength);
+  QCOMPARE(memoryCache.missCount(), int(sequenceLength));
+  // Nothing needs to be recomputed.
+  runMemoized(0);
+  QCOMPARE(memoryCache.hitCount(), int(sequenceLength));
+  // Changing a property invalidates the results.
+  _pCounter->setProperty("prop1", 1);
+  runMemoized(sequenceLength);
+  _pCounter->setProperty("prop1", 0);
+  runMemoized(0);
+
+  QDir directory(QDir::tempPath() + "/TestPiiDefaultOperation-results");
+  foreach (QString strFile, directory.entryList(QDir::Files))
+    directory.remove(strFile);
+  {
+    PiiResultCache diskCache(directory.path());
+    _engine.setResultCache(&diskCache);
+    runMemoized(sequenceLength);
+    QCOMPARE(directory.entryList(QDir::Files).size(), int(sequenceLength));
+  }
+  // The results survive the cache object.
+  {
+    PiiResultCache diskCache(directory.path());
+    _engine.setResultCache(&diskCache);
+    runMemoized(0);
+  }
+  _engine.setResultCache(0);
+  foreach (QString strFile, directory.entryList(QDir::Files))
+    directory.remove(strFile);
+}
+
+void TestPiiDefaultOperation::checkpoint()
+{
+  _pBuffer->lstData.clear();
+  _pBuffer->lstData << qMakePair(1, 2) << qMakePair(3, 6);
+  QByteArray aState(_engine.checkpoint());
+  QVERIFY(!aState.isEmpty());
+
+  _pBuffer->lstData.clear();
+  _engine.restoreCheckpoint(aState);
+  QCOMPARE(_pBuffer->lstData.size(), 2);
+  QCOMPARE(_pBuffer->lstData[1], qMakePair(3, 6));
+
+  // A single operation can be restored from its own snapshot.
+  QByteArray aBufferState(_pBuffer->checkpoint());
+  _pBuffer->lstData.clear();
+  _pBuffer->restoreCheckpoint(aBufferState);
+  QCOMPARE(_pBuffer->lstData.size(), 2);
+  _pBuffer->lstData.clear();
+}
+
 QTEST_MAIN(TestPiiDefaultOperation)
@@ -25,10 +25,19 @@ class TestPiiDsp : public QObject
 private slots:
   void fftShift();
   void fft();
+  void fftAccuracy();
+  void realFft();
+  void parallelFft();
+  void rowFft();
+  void fftButterflies();
   void correlation();
   void normalizedCorrelation();
   void convolution();
+  void convolutionKernels();
+  void fftConvolution();
+  void fastFftLength();
   void fastCorrelation();
+  void dwtInPlace();
   void findPeaks();
 };
 
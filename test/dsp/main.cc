@@ -17,7 +17,9 @@
 
 #include <PiiDsp.h>
 #include <PiiFft.h>
+#include <PiiWavelet.h>
 #include <PiiMatrixUtil.h>
+#include <PiiRandom.h>
 #include <QtTest>
 #include <iostream>
 
@@ -32,6 +34,11 @@ void TestPiiDsp::fftShift()
                       4,5,6,
                       7,8,9);
   QVERIFY(Pii::equals(PiiDsp::fftShift(PiiDsp::fftShift(mat2), true), mat2));
+  QVERIFY(Pii::equals(PiiDsp::fftShiftRows(mat2), PiiMatrix<int>(3,3,
+                                                                 3,1,2,
+                                                                 6,4,5,
+                                                                 9,7,8)));
+  QVERIFY(Pii::equals(PiiDsp::fftShiftRows(PiiDsp::fftShiftRows(mat2), true), mat2));
 }
 
 void TestPiiDsp::fft()
@@ -130,6 +137,162 @@ void TestPiiDsp::fft()
   }
 }
 
+namespace
+{
+  // Straightforward O(N^2) DFT for reference.
+  PiiMatrix<std::complex<double> > dft1d(const PiiMatrix<std::complex<double> >& input)
+  {
+    const double dPi = 4*std::atan(1.0);
+    const int iRows = input.rows(), iColumns = input.columns();
+    PiiMatrix<std::complex<double> > result(iRows, iColumns);
+    for (int r=0; r<iRows; ++r)
+      for (int k=0; k<iColumns; ++k)
+        {
+          std::complex<double> sum(0);
+          for (int n=0; n<iColumns; ++n)
+            sum += input(r,n) * std::polar(1.0, -2*dPi*(double(k)*n)/iColumns);
+          result(r,k) = sum;
+        }
+    return result;
+  }
+
+  PiiMatrix<std::complex<double> > dft(const PiiMatrix<double>& input)
+  {
+    PiiMatrix<std::complex<double> > matRows(dft1d(PiiMatrix<std::complex<double> >(input)));
+    return Pii::matrix(Pii::transpose(dft1d(Pii::matrix(Pii::transpose(matRows)))));
+  }
+
+  template <class T, class U> double maxError(const PiiMatrix<std::complex<T> >& a,
+                                              const PiiMatrix<std::complex<U> >& b)
+  {
+    double dMax = 0;
+    for (int r=0; r<a.rows(); ++r)
+      for (int c=0; c<a.columns(); ++c)
+        dMax = qMax(dMax, std::abs(std::complex<double>(a(r,c)) - std::complex<double>(b(r,c))));
+    return dMax;
+  }
+}
+
+void TestPiiDsp::fftAccuracy()
+{
+  PiiFft<double> fft;
+  // Powers of two, mixed radices and primes
+  const int aSizes[][2] = { {1,8}, {8,1}, {16,16}, {2,64}, {3,12}, {6,20}, {7,30}, {13,17}, {1,1024}, {5,96} };
+  for (unsigned i=0; i<sizeof(aSizes)/sizeof(aSizes[0]); ++i)
+    {
+      PiiMatrix<double> input(Pii::uniformRandomMatrix(aSizes[i][0], aSizes[i][1]));
+      PiiMatrix<std::complex<double> > matReference(dft(input));
+      QVERIFY(maxError(fft.forwardFft(input), matReference) < 1e-9);
+      QVERIFY(maxError(fft.forwardFft(PiiMatrix<std::complex<double> >(input)), matReference) < 1e-9);
+    }
+
+  PiiFft<float> floatFft;
+  PiiMatrix<float> input(Pii::uniformRandomMatrix(20, 32));
+  QVERIFY(maxError(floatFft.forwardFft(input), dft(PiiMatrix<double>(input))) < 1e-3);
+}
+
+void TestPiiDsp::realFft()
+{
+  PiiFft<double> fft;
+  for (int iColumns = 1; iColumns <= 20; ++iColumns)
+    {
+      PiiMatrix<double> input(Pii::uniformRandomMatrix(6, iColumns));
+      PiiMatrix<std::complex<double> > matHalf(fft.forwardRealFft(input));
+      QCOMPARE(matHalf.rows(), 6);
+      QCOMPARE(matHalf.columns(), iColumns/2 + 1);
+      QVERIFY(maxError(matHalf, Pii::matrix(dft(input)(0,0,-1,iColumns/2 + 1))) < 1e-9);
+
+      PiiMatrix<double> matInverse(fft.inverseRealFft(matHalf, iColumns));
+      QCOMPARE(matInverse.columns(), iColumns);
+      QVERIFY(Pii::almostEqual(matInverse, input, 1e-12));
+    }
+
+  // Single row
+  PiiMatrix<float> row(Pii::uniformRandomMatrix(1, 256));
+  PiiFft<float> floatFft;
+  QVERIFY(Pii::almostEqual(floatFft.inverseRealFft(floatFft.forwardRealFft(row), 256), row, 1e-5f));
+
+  try
+    {
+      fft.inverseRealFft(PiiMatrix<std::complex<double> >(2, 4), 8);
+      QFAIL("inverseRealFft() did not throw");
+    }
+  catch (PiiInvalidArgumentException&) {}
+}
+
+void TestPiiDsp::parallelFft()
+{
+  PiiFft<double> fft;
+  PiiMatrix<double> input(Pii::uniformRandomMatrix(120, 90));
+  PiiMatrix<std::complex<double> > matSequential(fft.forwardFft(input));
+  Pii::ParallelExecution policy(4);
+  QVERIFY(Pii::equals(fft.forwardFft(policy, input), matSequential));
+  QVERIFY(Pii::equals(fft.inverseFft(policy, matSequential), fft.inverseFft(matSequential)));
+  QVERIFY(maxError(fft.inverseFft(matSequential), PiiMatrix<std::complex<double> >(input)) < 1e-12);
+  QVERIFY(Pii::equals(fft.forwardRealFft(policy, input), fft.forwardRealFft(input)));
+  QVERIFY(Pii::almostEqual(fft.inverseRealFft(policy, fft.forwardRealFft(policy, input), 90), input, 1e-12));
+
+  // Plans are rebuilt if the cache is off.
+  const int iMaxPlans = PiiFft<double>::maxCachedPlans();
+  PiiFft<double>::setMaxCachedPlans(0);
+  QVERIFY(Pii::equals(fft.forwardFft(policy, input), matSequential));
+  PiiFft<double>::setMaxCachedPlans(iMaxPlans);
+  QCOMPARE(PiiFft<double>::maxCachedPlans(), iMaxPlans);
+}
+
+void TestPiiDsp::rowFft()
+{
+  PiiFft<double> fft;
+  Pii::ParallelExecution policy(4);
+  for (int iColumns = 1; iColumns <= 17; ++iColumns)
+    {
+      PiiMatrix<double> input(Pii::uniformRandomMatrix(33, iColumns));
+      PiiMatrix<std::complex<double> > matReal(fft.forwardRowFft(policy, input));
+      PiiMatrix<std::complex<double> > matComplex(fft.forwardRowFft(policy, PiiMatrix<std::complex<double> >(input)));
+      QCOMPARE(matReal.rows(), 33);
+      QCOMPARE(matReal.columns(), iColumns);
+      // Each row must match a separate transform of that row.
+      for (int r=0; r<input.rows(); r += 8)
+        {
+          PiiMatrix<std::complex<double> > matRow(fft.forwardFft(Pii::matrix(input(r,0,1,-1))));
+          QVERIFY(maxError(Pii::matrix(matReal(r,0,1,-1)), matRow) < 1e-9);
+          QVERIFY(maxError(Pii::matrix(matComplex(r,0,1,-1)), matRow) < 1e-9);
+        }
+      QVERIFY(maxError(fft.inverseRowFft(policy, matReal), PiiMatrix<std::complex<double> >(input)) < 1e-12);
+    }
+  QCOMPARE(fft.forwardRowFft(policy, PiiMatrix<double>(0, 8)).rows(), 0);
+}
+
+void TestPiiDsp::fftButterflies()
+{
+  // Odd counts exercise the scalar tail.
+  const int iCount = 37;
+  PiiMatrix<std::complex<double> > matData(Pii::uniformRandomMatrix(7, iCount)),
+    matImag(Pii::uniformRandomMatrix(7, iCount));
+  for (int r=0; r<matData.rows(); ++r)
+    for (int c=0; c<iCount; ++c)
+      matData(r,c) += std::complex<double>(0, matImag(r,c).real());
+  PiiMatrix<std::complex<float> > matFloatData(matData);
+
+  PiiMatrix<std::complex<double> > matGeneric(matData);
+  PiiDsp::fftButterfly2<double>(matGeneric[0], matGeneric[1], matGeneric[2], iCount);
+  PiiDsp::fftButterfly2(matData[0], matData[1], matData[2], iCount);
+  QVERIFY(maxError(matData, matGeneric) < 1e-14);
+
+  PiiDsp::fftButterfly4<double>(matGeneric[0], matGeneric[1], matGeneric[2], matGeneric[3],
+                                matGeneric[4], matGeneric[5], matGeneric[6], iCount);
+  PiiDsp::fftButterfly4(matData[0], matData[1], matData[2], matData[3],
+                        matData[4], matData[5], matData[6], iCount);
+  QVERIFY(maxError(matData, matGeneric) < 1e-14);
+
+  PiiMatrix<std::complex<float> > matFloatGeneric(matFloatData);
+  PiiDsp::fftButterfly4<float>(matFloatGeneric[0], matFloatGeneric[1], matFloatGeneric[2], matFloatGeneric[3],
+                               matFloatGeneric[4], matFloatGeneric[5], matFloatGeneric[6], iCount);
+  PiiDsp::fftButterfly4(matFloatData[0], matFloatData[1], matFloatData[2], matFloatData[3],
+                        matFloatData[4], matFloatData[5], matFloatData[6], iCount);
+  QVERIFY(maxError(matFloatData, matFloatGeneric) < 1e-5);
+}
+
 void TestPiiDsp::findPeaks()
 {
   try
@@ -303,6 +466,92 @@ void TestPiiDsp::convolution()
   }
 }
 
+void TestPiiDsp::convolutionKernels()
+{
+  // Odd sizes leave columns to the scalar tail of the vector kernels.
+  PiiMatrix<unsigned char> matBytes(Pii::uniformRandomMatrix(13, 37, 0, 255));
+  PiiMatrix<int> matInts(Pii::uniformRandomMatrix(13, 37, -1000, 1000));
+  PiiMatrix<float> matFloats(Pii::uniformRandomMatrix(13, 37, -1, 1));
+  PiiMatrix<int> matIntFilter(Pii::uniformRandomMatrix(3, 5, -100, 100));
+  PiiMatrix<float> matFloatFilter(Pii::uniformRandomMatrix(3, 5, -1, 1));
+
+  for (int i=0; i<2; ++i)
+    {
+      PiiDsp::FilterMode mode = i == 0 ? PiiDsp::FilterValidPart : PiiDsp::FilterFull;
+      // The double versions use the generic template.
+      QVERIFY(Pii::equals(PiiDsp::convolution<int>(matBytes, matIntFilter, mode),
+                          PiiMatrix<int>(PiiDsp::convolution<double>(PiiMatrix<double>(matBytes),
+                                                                     PiiMatrix<double>(matIntFilter), mode))));
+      QVERIFY(Pii::equals(PiiDsp::convolution<int>(matInts, matIntFilter, mode),
+                          PiiMatrix<int>(PiiDsp::convolution<double>(PiiMatrix<double>(matInts),
+                                                                     PiiMatrix<double>(matIntFilter), mode))));
+      QVERIFY(Pii::almostEqual(PiiMatrix<double>(PiiDsp::convolution<float>(matBytes, matFloatFilter, mode)),
+                               PiiDsp::convolution<double>(PiiMatrix<double>(matBytes),
+                                                           PiiMatrix<double>(matFloatFilter), mode),
+                               1e-3));
+      QVERIFY(Pii::almostEqual(PiiMatrix<double>(PiiDsp::convolution<float>(matFloats, matFloatFilter, mode)),
+                               PiiDsp::convolution<double>(PiiMatrix<double>(matFloats),
+                                                           PiiMatrix<double>(matFloatFilter), mode),
+                               1e-5));
+    }
+}
+
+void TestPiiDsp::fftConvolution()
+{
+  const PiiDsp::FilterMode aModes[] = { PiiDsp::FilterFull, PiiDsp::FilterOriginalSize, PiiDsp::FilterValidPart };
+  // Small and large images, odd and even filters, filters larger than
+  // the image.
+  const int aSizes[][4] = { {40,50,3,3}, {64,64,4,6}, {37,101,15,9}, {120,90,25,25}, {9,7,12,11}, {1,80,1,17} };
+  for (unsigned i=0; i<sizeof(aSizes)/sizeof(aSizes[0]); ++i)
+    {
+      PiiMatrix<double> a(Pii::uniformRandomMatrix(aSizes[i][0], aSizes[i][1], -1, 1));
+      PiiMatrix<double> b(Pii::uniformRandomMatrix(aSizes[i][2], aSizes[i][3], -1, 1));
+      PiiMatrix<float> fa(a), fb(b);
+      for (int m=0; m<3; ++m)
+        {
+          PiiMatrix<double> matDirect(PiiDsp::directConvolution<double>(a, b, aModes[m]));
+          PiiMatrix<double> matFft(PiiDsp::fftConvolution<double>(a, b, aModes[m]));
+          QCOMPARE(matFft.rows(), matDirect.rows());
+          QCOMPARE(matFft.columns(), matDirect.columns());
+          QVERIFY(Pii::almostEqual(matFft, matDirect, 1e-9));
+          QVERIFY(Pii::almostEqual(PiiMatrix<double>(PiiDsp::fftConvolution<float>(fa, fb, aModes[m])),
+                                   matDirect, 1e-3));
+        }
+    }
+
+  PiiMatrix<unsigned char> matImage(Pii::uniformRandomMatrix(30, 40, 0, 255));
+  PiiMatrix<float> matFilter(Pii::uniformRandomMatrix(13, 13, 0, 1));
+  PiiMatrix<float> matDirect(PiiDsp::directConvolution<float>(matImage, matFilter, PiiDsp::FilterOriginalSize));
+  const int iThreshold = PiiDsp::fftConvolutionThreshold();
+  // Everything goes through the FFT with a small threshold ...
+  PiiDsp::setFftConvolutionThreshold(1);
+  QVERIFY(Pii::almostEqual(PiiDsp::convolution<float>(matImage, matFilter, PiiDsp::FilterOriginalSize),
+                           matDirect, 1e-1));
+  QVERIFY(Pii::almostEqual(PiiDsp::filter<float>(matImage, matFilter, PiiDsp::FilterOriginalSize),
+                           PiiDsp::directConvolution<float>(matImage,
+                                                            PiiMatrix<float>(Pii::flipped(matFilter, Pii::Horizontally | Pii::Vertically)),
+                                                            PiiDsp::FilterOriginalSize),
+                           1e-1));
+  // ... but integer results are always calculated directly.
+  PiiMatrix<int> matIntFilter(Pii::uniformRandomMatrix(13, 13, -10, 10));
+  QVERIFY(Pii::equals(PiiDsp::convolution<int>(matImage, matIntFilter),
+                      PiiDsp::directConvolution<int>(matImage, matIntFilter)));
+  PiiDsp::setFftConvolutionThreshold(iThreshold);
+  QCOMPARE(PiiDsp::fftConvolutionThreshold(), iThreshold);
+}
+
+void TestPiiDsp::fastFftLength()
+{
+  QCOMPARE(PiiDsp::fastFftLength(0), 1);
+  QCOMPARE(PiiDsp::fastFftLength(1), 1);
+  QCOMPARE(PiiDsp::fastFftLength(7), 8);
+  QCOMPARE(PiiDsp::fastFftLength(11), 12);
+  QCOMPARE(PiiDsp::fastFftLength(31), 32);
+  QCOMPARE(PiiDsp::fastFftLength(97), 100);
+  QCOMPARE(PiiDsp::fastFftLength(125), 125);
+  QCOMPARE(PiiDsp::fastFftLength(257), 270);
+}
+
 void TestPiiDsp::fastCorrelation()
 {
   PiiMatrix<double> a(6,6,
@@ -332,4 +581,44 @@ void TestPiiDsp::fastCorrelation()
   QCOMPARE(peak.column, 1);
 }
 
+void TestPiiDsp::dwtInPlace()
+{
+  PiiMatrix<double> matInput(Pii::uniformRandomMatrix(16, 24, -1, 1));
+  for (int member=1; member<=3; ++member)
+    {
+      // Away from the borders, the periodic transform equals dwt().
+      QList<PiiMatrix<double> > lstBands(PiiDsp::dwt(matInput, PiiDsp::Daubechies, member));
+      PiiMatrix<double> matTransform(matInput);
+      QCOMPARE(PiiDsp::dwtInPlace(matTransform, 1, PiiDsp::Daubechies, member), 1);
+      const int iFirst = member - 1;
+      const int aOffsets[][2] = { {0,0}, {0,12}, {8,0}, {8,12} };
+      for (int b=0; b<4; ++b)
+        for (int r=iFirst; r<8; ++r)
+          for (int c=iFirst; c<12; ++c)
+            QVERIFY(Pii::abs(matTransform(aOffsets[b][0] + r, aOffsets[b][1] + c) - lstBands[b](r,c)) < 1e-9);
+    }
+
+  // Odd sizes, multiple levels and filters longer than the signal
+  PiiMatrix<double> matOdd(Pii::uniformRandomMatrix(37, 50, -1, 1));
+  const double dEnergy = Pii::sum<double>(Pii::multiplied(matOdd, matOdd));
+  for (int member=1; member<=6; ++member)
+    {
+      PiiMatrix<double> matTransform(matOdd);
+      QCOMPARE(PiiDsp::dwtInPlace(matTransform, 10, PiiDsp::Daubechies, member), 5);
+      // The transform is orthogonal.
+      QVERIFY(Pii::abs(Pii::sum<double>(Pii::multiplied(matTransform, matTransform)) - dEnergy) < 1e-8);
+      PiiDsp::inverseDwtInPlace(matTransform, 10, PiiDsp::Daubechies, member);
+      QVERIFY(Pii::almostEqual(matTransform, matOdd, 1e-9));
+    }
+
+  PiiMatrix<float> matFloat(Pii::uniformRandomMatrix(64, 64));
+  PiiMatrix<float> matTransform(matFloat);
+  QCOMPARE(PiiDsp::dwtInPlace(matTransform, 3), 3);
+  PiiDsp::inverseDwtInPlace(matTransform, 3);
+  QVERIFY(Pii::almostEqual(matTransform, matFloat, 1e-5f));
+
+  PiiMatrix<double> matTiny(1, 8);
+  QCOMPARE(PiiDsp::dwtInPlace(matTiny, 1), 0);
+}
+
 QTEST_MAIN(TestPiiDsp)
@@ -24,6 +24,9 @@ class TestPiiEngine : public QObject
 
 private slots:
   void usedPluginLibraryNames();
+  void operationFusion();
+  void pluginIndex();
+  void warmUp();
 };
 
 #endif //_TESTPIIENGINE_H
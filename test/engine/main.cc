@@ -16,8 +16,13 @@
 #include "TestPiiEngine.h"
 
 #include <QtTest>
+#include <QDir>
+#include <QFile>
 
 #include <PiiEngine.h>
+#include <PiiDefaultOperation.h>
+#include <PiiProbeInput.h>
+#include <PiiYdinTypes.h>
 
 void TestPiiEngine::usedPluginLibraryNames()
 {
@@ -31,4 +36,124 @@ void TestPiiEngine::usedPluginLibraryNames()
   QCOMPARE(e.usedPluginLibraryNames(), QStringList() << "piibase" << "piiflowcontrol");
 }
 
+void TestPiiEngine::operationFusion()
+{
+  PiiEngine::loadPlugin("piibase");
+  // Large enough to be processed in blocks of rows.
+  PiiMatrix<int> matInput(300, 100);
+  for (int r=0; r<matInput.rows(); ++r)
+    for (int c=0; c<matInput.columns(); ++c)
+      matInput(r,c) = r - c;
+
+  PiiVariant varResults[2];
+  int iAbsoluteRounds[2];
+  for (int i=0; i<2; ++i)
+    {
+      PiiEngine engine;
+      engine.setProperty("operationFusion", i == 1);
+      PiiOperation* pArithmetic = engine.createOperation("PiiArithmeticOperation");
+      pArithmetic->setProperty("constant", QVariant::fromValue(PiiVariant(5)));
+      PiiOperation* pAbsolute = engine.createOperation("PiiAbsoluteOperation");
+      PiiOperation* pCasting = engine.createOperation("PiiTypeCastingOperation");
+      pCasting->setProperty("outputType", int(PiiYdin::UnsignedCharMatrixType));
+      pArithmetic->connectOutput("output", pAbsolute, "input");
+      pAbsolute->connectOutput("output", pCasting, "input");
+
+      PiiOutputSocket source("source");
+      source.connectInput(pArithmetic->input("input0"));
+      PiiProbeInput probe;
+      pCasting->output("output")->connectInput(&probe);
+
+      engine.execute();
+      source.emitObject(PiiVariant(matInput));
+      varResults[i] = probe.savedObject();
+      iAbsoluteRounds[i] = static_cast<PiiDefaultOperation*>(pAbsolute)->processTimeHistogram().count();
+      source.emitObject(PiiYdin::createStopTag());
+      QVERIFY(engine.wait(PiiOperation::Stopped, 1000));
+    }
+
+  // The fused chain bypasses the sockets of the second operation.
+  QCOMPARE(iAbsoluteRounds[0], 1);
+  QCOMPARE(iAbsoluteRounds[1], 0);
+  QCOMPARE(varResults[1].type(), uint(PiiYdin::UnsignedCharMatrixType));
+  const PiiMatrix<unsigned char> matResult(varResults[1].valueAs<PiiMatrix<unsigned char> >());
+  QVERIFY(Pii::equals(matResult, varResults[0].valueAs<PiiMatrix<unsigned char> >()));
+  QCOMPARE(int(matResult(299,0)), 304 & 0xff);
+  QCOMPARE(int(matResult(0,99)), 94);
+}
+
+void TestPiiEngine::pluginIndex()
+{
+  PiiEngine::loadPlugin("piibase");
+  QString strIndexFile(QDir::temp().absoluteFilePath("testpiiengine.idx"));
+  PiiEngine::savePluginIndex(strIndexFile);
+  QFile file(strIndexFile);
+  QVERIFY(file.open(QIODevice::ReadOnly | QIODevice::Text));
+  QVERIFY(QString(file.readAll()).split('\n').contains("PiiClock\tpiibase"));
+  file.close();
+
+  QVERIFY(file.open(QIODevice::WriteOnly | QIODevice::Text));
+  file.write("PiiClock\tpiibase\n"
+             "PiiMissingOperation\tpiimissingplugin\n"
+             "invalid line\n");
+  file.close();
+  PiiEngine::loadPluginIndex(strIndexFile);
+  file.remove();
+
+  QVERIFY(!PiiEngine::loadPluginFor("PiiUnknownOperation"));
+  QVERIFY(!PiiEngine::loadPluginFor("invalid line"));
+  QVERIFY(PiiEngine::loadPluginFor("PiiClock"));
+  try
+    {
+      PiiEngine::loadPluginFor("PiiMissingOperation");
+      QFAIL("PiiLoadException was not thrown.");
+    }
+  catch (PiiLoadException&) {}
+  QVERIFY(PiiEngine().createOperation("PiiMissingOperation") == 0);
+}
+
+void TestPiiEngine::warmUp()
+{
+  PiiEngine::loadPlugin("piibase");
+  PiiEngine engine;
+  PiiOperation* pArithmetic = engine.createOperation("PiiArithmeticOperation", "arithmetic");
+  pArithmetic->setProperty("constant", QVariant::fromValue(PiiVariant(5)));
+  PiiOperation* pAbsolute = engine.createOperation("PiiAbsoluteOperation", "absolute");
+  PiiOperation* pClock = engine.createOperation("PiiClock", "clock");
+  pArithmetic->connectOutput("output", pAbsolute, "input");
+
+  PiiOutputSocket source("source");
+  source.connectInput(pArithmetic->input("input0"));
+  PiiProbeInput probe;
+  pAbsolute->output("output")->connectInput(&probe);
+
+  QMap<QString,PiiVariant> mapObjects;
+  mapObjects["arithmetic.input0"] = PiiVariant(-10);
+  try
+    {
+      engine.warmUp(mapObjects, 3, 1000);
+    }
+  catch (PiiExecutionException& ex)
+    {
+      QFAIL(qPrintable(ex.message()));
+    }
+
+  QCOMPARE(engine.state(), PiiOperation::Stopped);
+  QCOMPARE(probe.savedObject().valueAs<int>(), 5);
+  // Connections, activity modes and statistics are restored.
+  QVERIFY(pArithmetic->input("input0")->connectedOutput() == &source);
+  QCOMPARE(pClock->activityMode(), PiiOperation::Enabled);
+  QCOMPARE(static_cast<PiiDefaultOperation*>(pAbsolute)->processTimeHistogram().count(), 0);
+
+  mapObjects.clear();
+  mapObjects["arithmetic.noinput"] = PiiVariant(1);
+  try
+    {
+      engine.warmUp(mapObjects);
+      QFAIL("PiiExecutionException was not thrown.");
+    }
+  catch (PiiExecutionException&) {}
+  QVERIFY(pArithmetic->input("input0")->connectedOutput() == &source);
+}
+
 QTEST_MAIN(TestPiiEngine)
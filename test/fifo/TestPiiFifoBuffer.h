@@ -105,6 +105,7 @@ private slots:
   void oneThread_data();
   void twoThreads();
   void twoThreads_data();
+  void spans();
 };
 
 #endif //_TESTPIIFIFOBUFFER_H
@@ -111,4 +111,45 @@ void TestPiiFifoBuffer::twoThreads_data()
   QTest::newRow("103,103,103") << 103 << 103 << 103;
 }
 
+void TestPiiFifoBuffer::spans()
+{
+  PiiFifoBuffer bfr(10);
+  bfr.setWaitTime(0);
+  QCOMPARE(bfr.capacity(), qint64(16));
+  QIODevice& dev = bfr;
+
+  qint64 iSize = 0;
+  char* pWrite = bfr.writeSpan(&iSize);
+  QCOMPARE(iSize, qint64(16));
+  for (int i=0; i<12; ++i)
+    pWrite[i] = char(i);
+  bfr.commitWrite(12);
+  QCOMPARE(dev.bytesAvailable(), qint64(12));
+
+  const char* pRead = bfr.readSpan(&iSize);
+  QCOMPARE(iSize, qint64(12));
+  QCOMPARE(int(pRead[11]), 11);
+  bfr.commitRead(8);
+
+  // Free space wraps around the end of the ring.
+  pWrite = bfr.writeSpan(&iSize);
+  QCOMPARE(iSize, qint64(4));
+  bfr.commitWrite(4);
+  pWrite = bfr.writeSpan(&iSize);
+  QCOMPARE(iSize, qint64(8));
+  bfr.commitWrite(8);
+  pWrite = bfr.writeSpan(&iSize);
+  QCOMPARE(iSize, qint64(0));
+
+  pRead = bfr.readSpan(&iSize);
+  QCOMPARE(iSize, qint64(8));
+  QCOMPARE(int(pRead[0]), 8);
+  bfr.commitRead(8);
+  pRead = bfr.readSpan(&iSize);
+  QCOMPARE(iSize, qint64(8));
+  bfr.commitRead(8);
+  QCOMPARE(bfr.pos(), qint64(24));
+  QCOMPARE(dev.bytesAvailable(), qint64(0));
+}
+
 QTEST_MAIN(TestPiiFifoBuffer)
@@ -26,6 +26,9 @@ private slots:
   void initTestCase();
   void cleanupTestCase();
   void process();
+  void parallelScan();
+  void unsortedScan();
+  void index();
 
   void capture(const QString&, const PiiVariant& obj);
 
@@ -109,6 +109,112 @@ void TestPiiFileSystemScanner::process()
     QCOMPARE(QString(aFiles[i]), _lstFileNames[i]);
 }
 
+void TestPiiFileSystemScanner::parallelScan()
+{
+  QVERIFY(stop());
+  disconnectInput("path");
+  QVERIFY(connectInput("trigger"));
+  operation()->setProperty("nameFilters", QStringList() << "test*.txt");
+  operation()->setProperty("maxDepth", 3);
+  operation()->setProperty("scanThreadCount", 2);
+
+  // Listing folders in advance must not change the order.
+  QVERIFY(start());
+  const char* aExpected[] =
+    {
+      "root/test1.txt",
+      "root/a/test2.txt",
+      "root/a/test3.txt",
+      "root/b/test5.txt",
+      "root/c/test6.txt",
+      "root/c/test7.txt",
+      "root/a/d/test4.txt",
+      "root/test1.txt"
+    };
+  for (unsigned i=0; i<sizeof(aExpected)/sizeof(aExpected[0]); ++i)
+    {
+      QVERIFY(sendObject("trigger", true));
+      QCOMPARE(outputValue("filename", QString("")), QString(aExpected[i]));
+    }
+  QVERIFY(stop());
+  operation()->setProperty("scanThreadCount", 0);
+}
+
+void TestPiiFileSystemScanner::unsortedScan()
+{
+  disconnectInput("trigger");
+  QVERIFY(connectInput("path"));
+  operation()->setProperty("nameFilters", QStringList());
+  operation()->setProperty("sortFlags", "Unsorted");
+
+  for (int iThreads=0; iThreads<=2; iThreads += 2)
+    {
+      operation()->setProperty("scanThreadCount", iThreads);
+      _lstFileNames.clear();
+      QVERIFY(start());
+      QVERIFY(sendObject("path", QString("root")));
+      QVERIFY(stop());
+
+      // The order within a folder is not specified.
+      QStringList lstExpected;
+      for (unsigned i=0; i<sizeof(aFiles)/sizeof(aFiles[0]); ++i)
+        lstExpected << aFiles[i];
+      lstExpected.sort();
+      _lstFileNames.sort();
+      QCOMPARE(_lstFileNames, lstExpected);
+    }
+  operation()->setProperty("scanThreadCount", 0);
+  operation()->setProperty("sortFlags", "Name");
+}
+
+void TestPiiFileSystemScanner::index()
+{
+  disconnect(this, SIGNAL(objectReceived(QString,PiiVariant)), this, SLOT(capture(QString,PiiVariant)));
+  disconnectInput("path");
+  QVERIFY(connectInput("trigger"));
+  operation()->setProperty("nameFilters", QStringList() << "test*.txt");
+  operation()->setProperty("maxDepth", 2);
+  operation()->setProperty("indexFile", QString("index.dat"));
+  QFile::remove("index.dat");
+
+  QVERIFY(start());
+  QVERIFY(sendObject("trigger", true));
+  QCOMPARE(outputValue("filename", QString("")), QString("root/test1.txt"));
+  QVERIFY(sendObject("trigger", true));
+  QCOMPARE(outputValue("filename", QString("")), QString("root/a/test2.txt"));
+  QVERIFY(stop());
+  QVERIFY(QFile::exists("index.dat"));
+
+  // Emitted files are skipped after a restart.
+  QVERIFY(start());
+  QVERIFY(sendObject("trigger", true));
+  QCOMPARE(outputValue("filename", QString("")), QString("root/a/test3.txt"));
+  QVERIFY(sendObject("trigger", true));
+  QCOMPARE(outputValue("filename", QString("")), QString("root/b/test5.txt"));
+  QVERIFY(sendObject("trigger", true));
+  QCOMPARE(outputValue("filename", QString("")), QString("root/c/test6.txt"));
+  // There are no new files after this one.
+  sendObject("trigger", true);
+  QCOMPARE(outputValue("filename", QString("")), QString("root/c/test7.txt"));
+  QVERIFY(stop());
+
+  QVERIFY(start(ExpectFail));
+
+  // New files are found.
+  {
+    QFile file("root/test9.txt");
+    QVERIFY(file.open(QIODevice::WriteOnly));
+  }
+  QVERIFY(start());
+  sendObject("trigger", true);
+  QCOMPARE(outputValue("filename", QString("")), QString("root/test9.txt"));
+  QVERIFY(stop());
+
+  QFile::remove("root/test9.txt");
+  QFile::remove("index.dat");
+  operation()->setProperty("indexFile", QString());
+}
+
 void TestPiiFileSystemScanner::capture(const QString&, const PiiVariant& obj)
 {
   if (obj.type() != PiiYdin::QStringType)
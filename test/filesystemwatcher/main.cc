@@ -0,0 +1,73 @@
+/* This file is part of Into.
+ * Copyright (C) Intopii 2013.
+ * All rights reserved.
+ *
+ * Licensees holding a commercial Into license may use this file in
+ * accordance with the commercial license agreement. Please see
+ * LICENSE.commercial for commercial licensing terms.
+ *
+ * Alternatively, this file may be used under the terms of the GNU
+ * Affero General Public License version 3 as published by the Free
+ * Software Foundation. In addition, Intopii gives you special rights
+ * to use Into as a part of open source software projects. Please
+ * refer to LICENSE.AGPL3 for details.
+ */
+
+#include "TestPiiFileSystemWatcher.h"
+
+#include <QtTest>
+
+void TestPiiFileSystemWatcher::initTestCase()
+{
+  QVERIFY(createOperation("piibase", "PiiFileSystemWatcher"));
+  QVERIFY(QDir(".").mkpath("watched"));
+  operation()->setProperty("directories", QStringList() << "watched");
+}
+
+void TestPiiFileSystemWatcher::cleanupTestCase()
+{
+  stop();
+  QFile::remove("watched/a.txt");
+  QFile::remove("watched/sub/b.txt");
+  QDir(".").rmdir("watched/sub");
+  QDir(".").rmdir("watched");
+}
+
+void TestPiiFileSystemWatcher::newFiles()
+{
+  QVERIFY(start());
+  {
+    QFile file("watched/a.txt");
+    QVERIFY(file.open(QIODevice::WriteOnly));
+    file.write("a");
+  }
+  QVERIFY(waitOutput("filename", 5000));
+  QCOMPARE(outputValue("filename", QString()), QDir("watched").absoluteFilePath("a.txt"));
+  QVERIFY(stop());
+}
+
+void TestPiiFileSystemWatcher::recursive()
+{
+  operation()->setProperty("recursive", true);
+  operation()->setProperty("waitForClose", true);
+  QVERIFY(start());
+  QVERIFY(QDir(".").mkdir("watched/sub"));
+  // Let the watcher find the new directory.
+  QTest::qWait(200);
+  clearAllOutputValues();
+
+  QFile file("watched/sub/b.txt");
+  QVERIFY(file.open(QIODevice::WriteOnly));
+  file.write("b");
+  file.flush();
+#ifdef Q_OS_LINUX
+  // Incomplete files are not reported.
+  QVERIFY(!waitOutput("filename", 200));
+#endif
+  file.close();
+  QVERIFY(waitOutput("filename", 5000));
+  QCOMPARE(outputValue("filename", QString()), QDir("watched/sub").absoluteFilePath("b.txt"));
+  QVERIFY(stop());
+}
+
+QTEST_MAIN(TestPiiFileSystemWatcher)
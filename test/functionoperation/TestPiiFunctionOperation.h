@@ -18,10 +18,12 @@
 
 #include <PiiOperationTest.h>
 #include <PiiFunctionOperation.h>
+#include <PiiYdinTypes.h>
 
 #ifdef PII_CXX11
 double sum(double a, int b);
 void sum2(double a, int b, int* c);
+PiiMatrix<int> add(const PiiMatrix<int>& a, const PiiMatrix<int>& b);
 
 class SumTestOperation : public PII_FUNCTION_OP_FOR(sum)
 {
@@ -50,6 +52,19 @@ public:
   void checkSockets();
 };
 
+class MatrixSumTestOperation : public PII_FUNCTION_OP_FOR(add)
+{
+  Q_OBJECT
+public:
+  typedef PII_FUNCTION_OP_FOR(add) SuperType;
+  MatrixSumTestOperation() :
+    SuperType(add, "sum", "a", "b") {}
+
+  PiiMatrix<int> defaultB() const { return PiiMatrix<int>(1, 2, 3, 4); }
+
+  void setDefault() { setDefaultValue("b", &MatrixSumTestOperation::defaultB); }
+};
+
 #endif
 
 class TestPiiFunctionOperation : public PiiOperationTest
@@ -62,6 +77,7 @@ private slots:
 #ifdef PII_CXX11
   void sumOperation();
   void sum2Operation();
+  void matrixSumOperation();
   void setDefaultValue();
   void socketAt();
 
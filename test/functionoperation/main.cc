@@ -19,6 +19,7 @@
 
 double sum(double a, int b) { return a + b; }
 void sum2(double a, int b, int* c) { *c = a + b; }
+PiiMatrix<int> add(const PiiMatrix<int>& a, const PiiMatrix<int>& b) { return a + b; }
 
 void SumTestOperation::checkSockets()
 {
@@ -89,6 +90,30 @@ void TestPiiFunctionOperation::sum2Operation()
   QCOMPARE(outputValue("sum", 0), 3);
 }
 
+void TestPiiFunctionOperation::matrixSumOperation()
+{
+  MatrixSumTestOperation* pOp = new MatrixSumTestOperation;
+  setOperation(pOp);
+
+  QVERIFY(connectInput("a"));
+  QVERIFY(connectInput("b"));
+  QVERIFY(start());
+
+  PiiMatrix<int> matA(1, 2, 1, 2);
+  QVERIFY(sendObject("a", matA));
+  QVERIFY(sendObject("b", PiiMatrix<int>(1, 2, 10, 20)));
+  QVERIFY(Pii::equals(outputValue("sum", PiiMatrix<int>()), PiiMatrix<int>(1, 2, 11, 22)));
+  // Arguments refer to the received objects, which must not change.
+  QVERIFY(Pii::equals(matA, PiiMatrix<int>(1, 2, 1, 2)));
+
+  QVERIFY(stop());
+  disconnectInput("b");
+  pOp->setDefault();
+  QVERIFY(start());
+  QVERIFY(sendObject("a", PiiMatrix<int>(1, 2, -1, -1)));
+  QVERIFY(Pii::equals(outputValue("sum", PiiMatrix<int>()), PiiMatrix<int>(1, 2, 2, 3)));
+}
+
 void TestPiiFunctionOperation::setDefaultValue()
 {
   SumTestOperation* pOp = new SumTestOperation;
@@ -25,6 +25,7 @@ class TestPiiHoughTransformOperation : public PiiOperationTest
 private slots:
   void initTestCase();
   void process();
+  void directionInput();
 };
 
 
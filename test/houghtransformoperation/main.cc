@@ -101,4 +101,43 @@ void TestPiiHoughTransformOperation::process()
   QVERIFY(qAbs(matEndPoints(1,3) - 0) <= 1);
 }
 
+void TestPiiHoughTransformOperation::directionInput()
+{
+  QVERIFY(stop());
+  operation()->setProperty("maxPeakCount", 3);
+  operation()->setProperty("minPeakDistance", 20);
+  operation()->setProperty("angleWindow", 3.0);
+
+  PiiMatrix<uchar> matInput(301,301);
+  PiiMatrix<float> matDirections(301,301);
+  // Horizontal lines with a vertical gradient
+  for (int r=1; r<=3; ++r)
+    {
+      matInput(r*75,0,1,-1) = 255;
+      matDirections(r*75,0,1,-1) = float(M_PI/2);
+    }
+
+  QVERIFY(connectInput("image"));
+  QVERIFY(connectInput("direction"));
+  QVERIFY(start());
+
+  QVERIFY(sendObject("direction", matDirections));
+  QVERIFY(sendObject("image", matInput));
+
+  PiiMatrix<int> matEndPoints = outputValue("coordinates", PiiMatrix<int>());
+  QCOMPARE(matEndPoints.rows(), 3);
+  Pii::sortRows(matEndPoints, std::less<int>(), 1);
+  for (int r=0; r<3; ++r)
+    {
+      QCOMPARE(matEndPoints(r,0), 0);
+      QVERIFY(qAbs(matEndPoints(r,1) - (r+1)*75) <= 1);
+      QCOMPARE(matEndPoints(r,2), 300);
+      QCOMPARE(matEndPoints(r,3), matEndPoints(r,1));
+    }
+
+  // Wrong direction type
+  QVERIFY(sendObject("direction", PiiMatrix<int>(301,301)));
+  QVERIFY(!sendObject("image", matInput));
+}
+
 QTEST_MAIN(TestPiiHoughTransformOperation)
@@ -30,6 +30,7 @@ public:
 private slots:
   void httpRequest();
   void httpRequest_data();
+  void chunkedTransfer();
   void cleanup();
 
 private:
@@ -18,6 +18,7 @@
 #include <QtTest>
 
 #include <PiiHttpServer.h>
+#include <PiiHttpDevice.h>
 #include <PiiNetwork.h>
 #include <PiiException.h>
 #include <PiiFileUtil.h>
@@ -111,4 +112,26 @@ void TestPiiHttpServer::httpRequest_data()
   //QTest::newRow("local") << "local://" + _strBase + "/server.sock";
 }
 
+void TestPiiHttpServer::chunkedTransfer()
+{
+  QBuffer buffer;
+  buffer.open(QIODevice::ReadWrite);
+  {
+    PiiHttpDevice server(&buffer, PiiHttpDevice::Server);
+    server.setChunkSize(8);
+    server.print("Hello, ");
+    server.print("chunked world!");
+    server.finish();
+    QCOMPARE(server.responseHeader().value("Transfer-Encoding"), QString("chunked"));
+    QCOMPARE(server.connectionType(), PiiHttpDevice::KeepAliveConnection);
+  }
+  QVERIFY(buffer.data().endsWith("\r\n0\r\n\r\n"));
+
+  buffer.seek(0);
+  PiiHttpDevice client(&buffer, PiiHttpDevice::Client);
+  QVERIFY(client.readHeader());
+  QCOMPARE(client.bodyLength(), qint64(-1));
+  QCOMPARE(client.readBody(), QByteArray("Hello, chunked world!"));
+}
+
 QTEST_MAIN(TestPiiHttpServer)
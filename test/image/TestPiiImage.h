@@ -34,15 +34,23 @@ private slots:
   void scaleColor();
   void rotate();
   void colorChannel();
+  void channelView();
   void setColorChannel();
   void detectEdges();
+  void cannyEdges();
   void suppressNonMaxima();
   void medianFilter();
+  void rankFilter();
   void separateFilter();
   void filter();
   void intFilter();
   void maxFilter();
   void minFilter();
+  void parallelExecution();
+  void remapTable();
+  void pyramid();
+  void templateMatching();
+  void fastCorners();
 
   // Thresholding
   void threshold();
@@ -55,12 +63,15 @@ private slots:
   void inverseTwoLevelThreshold();
   void hysteresisThreshold();
   void adaptiveThreshold();
+  void localThreshold();
+  void integralImage();
 
   // Morphology
   void createMask();
 
   void erode();
   void dilate();
+  void decomposedMorphology();
   void open();
   void close();
   void hitAndMiss();
@@ -69,10 +80,15 @@ private slots:
   void bottomHat();
   void labelImage();
   void labelLargerThan();
+  void streamLabeler();
+  void parallelLabeling();
 
   // Histogram
   void equalize();
+  void adaptiveEqualize();
   void histogram();
+  void channelHistograms();
+  void runLengthRoi();
   void cumulative();
   void normalize();
   void percentile();
@@ -82,6 +98,7 @@ private slots:
   void findBoundary();
   void findNextBoundary();
   void findBoundaries();
+  void findChainCodes();
 
   // Distortions
   void unwarpCylinder();
@@ -89,10 +106,13 @@ private slots:
   // Other
   void calculateDirection();
   void calculateProperties();
+  void measureObjects();
   void sweepLine();
   void crop();
   void xorMatch();
   void fastGradient();
+  void updateBackgroundRow_data();
+  void updateBackgroundRow();
 
 private:
   template <class TernaryFunction, class T>
@@ -30,6 +30,11 @@
 #include <PiiMaskGenerator.h>
 #include <PiiColor.h>
 #include <PiiImageDistortions.h>
+#include <PiiRandom.h>
+#include <PiiThreadPool.h>
+#include <PiiIntegralImage.h>
+#include <PiiTemplateMatching.h>
+#include <PiiCpu.h>
 
 #include <functional>
 
@@ -340,6 +345,75 @@ void TestPiiImage::calculateProperties()
   }
 }
 
+void TestPiiImage::measureObjects()
+{
+  for (int i=0; i<4; ++i)
+    {
+      PiiMatrix<int> matImage(Pii::uniformRandomMatrix(61, 47, 0, 1.2 + i * 0.3));
+      for (int iConnectivity=0; iConnectivity<2; ++iConnectivity)
+        {
+          PiiImage::Connectivity connectivity = PiiImage::Connectivity(iConnectivity);
+          int iLabels = 0;
+          PiiMatrix<int> matLabels(PiiImage::labelImage(matImage,
+                                                        std::bind2nd(std::greater<int>(), 0),
+                                                        Pii::YesFunction<int>(),
+                                                        connectivity, false, 0, INT_MAX,
+                                                        &iLabels));
+          PiiMatrix<int> matMeasuredLabels;
+          QVector<PiiImage::ObjectMoments> vecObjects(PiiImage::measureObjects(matImage,
+                                                                               std::bind2nd(std::greater<int>(), 0),
+                                                                               connectivity,
+                                                                               &matMeasuredLabels));
+          QCOMPARE(vecObjects.size(), iLabels);
+          QVERIFY(Pii::equals(matMeasuredLabels, matLabels));
+
+          PiiMatrix<int> matAreas, matCentroids, matBoxes;
+          PiiImage::calculateProperties(matLabels, iLabels, matAreas, matCentroids, matBoxes);
+          PiiMatrix<int> matAreas2, matCentroids2, matBoxes2;
+          PiiImage::calculateProperties(vecObjects, matAreas2, matCentroids2, matBoxes2);
+          QVERIFY(Pii::equals(matAreas, matAreas2));
+          QVERIFY(Pii::equals(matCentroids, matCentroids2));
+          QVERIFY(Pii::equals(matBoxes, matBoxes2));
+
+          // Moments from a labeled image must be the same.
+          PiiImage::calculateProperties(PiiImage::calculateMoments(matLabels), matAreas2, matCentroids2, matBoxes2);
+          QVERIFY(Pii::equals(matAreas, matAreas2));
+          QVERIFY(Pii::equals(matCentroids, matCentroids2));
+          QVERIFY(Pii::equals(matBoxes, matBoxes2));
+
+          for (int l=0; l<iLabels; ++l)
+            {
+              double dLength, dWidth, dLength2, dWidth2;
+              PiiImage::calculateDirection(matLabels, l+1, &dLength, &dWidth);
+              vecObjects[l].direction(&dLength2, &dWidth2);
+              QVERIFY(Pii::abs(dLength - dLength2) < 1e-6);
+              QVERIFY(Pii::abs(dWidth - dWidth2) < 1e-6);
+            }
+        }
+    }
+
+  {
+    // Diagonal line
+    PiiMatrix<int> matImage(4,4,
+                            1,0,0,0,
+                            0,1,0,0,
+                            0,0,1,0,
+                            0,0,0,1);
+    QVector<PiiImage::ObjectMoments> vecObjects(PiiImage::measureObjects(matImage,
+                                                                         std::bind2nd(std::greater<int>(), 0),
+                                                                         PiiImage::Connect8));
+    QCOMPARE(vecObjects.size(), 1);
+    QCOMPARE(vecObjects[0].area, 4);
+    QCOMPARE(vecObjects[0].centroidX(), 1.5);
+    double dWidth = -1;
+    PiiMatrix<double> matDirection(vecObjects[0].direction(0, &dWidth));
+    QVERIFY(Pii::almostEqualRel(matDirection(0,0), M_SQRT1_2));
+    QVERIFY(Pii::almostEqualRel(matDirection(0,1), M_SQRT1_2));
+    QCOMPARE(dWidth, 1.0);
+    QCOMPARE(PiiImage::measureObjects(matImage, std::bind2nd(std::greater<int>(), 0)).size(), 4);
+  }
+}
+
 void TestPiiImage::sweepLine()
 {
   {
@@ -714,6 +788,61 @@ void TestPiiImage::dilate()
 
   }
 }
+
+// Brute-force binary erosion (dilate == false) or dilation with a
+// full rectangular mask.
+static PiiMatrix<int> rectangleMorphology(const PiiMatrix<int>& image, int maskRows, int maskCols, bool dilate)
+{
+  const int iTop = dilate ? maskRows - maskRows/2 - 1 : maskRows/2,
+    iLeft = dilate ? maskCols - maskCols/2 - 1 : maskCols/2;
+  PiiMatrix<int> matResult(image.rows(), image.columns());
+  for (int r=0; r<image.rows(); ++r)
+    for (int c=0; c<image.columns(); ++c)
+      {
+        bool bAll = true, bAny = false;
+        for (int mr=r-iTop; mr<r-iTop+maskRows; ++mr)
+          for (int mc=c-iLeft; mc<c-iLeft+maskCols; ++mc)
+            {
+              const bool bSet = mr >= 0 && mc >= 0 && mr < image.rows() && mc < image.columns() && image(mr,mc);
+              bAll = bAll && bSet;
+              bAny = bAny || bSet;
+            }
+        matResult(r,c) = dilate ? bAny : bAll;
+      }
+  return matResult;
+}
+
+void TestPiiImage::decomposedMorphology()
+{
+  QVERIFY(PiiImage::isDecomposableMask(PiiImage::createMask(PiiImage::RectangularMask, 31)));
+  QVERIFY(PiiImage::isDecomposableMask(PiiImage::createMask(PiiImage::EllipticalMask, 1, 15)));
+  QVERIFY(!PiiImage::isDecomposableMask(PiiImage::createMask(PiiImage::EllipticalMask, 5)));
+  QVERIFY(!PiiImage::isDecomposableMask(PiiImage::createMask(PiiImage::DiamondMask, 5)));
+  QVERIFY(!PiiImage::isDecomposableMask(PiiMatrix<int>(3,3)));
+
+  PiiMatrix<int> matSparse(Pii::uniformRandomMatrix(47, 61, 0, 1.05));
+  PiiMatrix<int> matDense(Pii::uniformRandomMatrix(47, 61, 0.98, 2));
+  const int aiSizes[][2] = { {31,31}, {1,31}, {31,1}, {4,7}, {1,1} };
+  for (int i=0; i<5; ++i)
+    {
+      PiiMatrix<int> matMask(PiiImage::createMask(PiiImage::RectangularMask, aiSizes[i][0], aiSizes[i][1]));
+      QVERIFY(Pii::equals(PiiImage::erode(matDense, matMask),
+                          rectangleMorphology(matDense, aiSizes[i][0], aiSizes[i][1], false)));
+      QVERIFY(Pii::equals(PiiImage::dilate(matSparse, matMask),
+                          rectangleMorphology(matSparse, aiSizes[i][0], aiSizes[i][1], true)));
+    }
+
+  // Large windows in the min/max filters.
+  PiiMatrix<int> matImage(Pii::uniformRandomMatrix(47, 61, 0, 255));
+  PiiMatrix<int> matMax(matImage.rows(), matImage.columns());
+  for (int r=0; r<matImage.rows(); ++r)
+    for (int c=0; c<matImage.columns(); ++c)
+      matMax(r,c) = Pii::max(matImage(qMax(r-15,0), qMax(c-10,0),
+                                      qMin(r+16,matImage.rows()) - qMax(r-15,0),
+                                      qMin(c+11,matImage.columns()) - qMax(c-10,0)));
+  QVERIFY(Pii::equals(PiiImage::maxFilter(matImage, 31, 21), matMax));
+}
+
 void TestPiiImage::scaleLinearInterpolation()
 {
   PiiMatrix<int> input(3,3,
@@ -892,6 +1021,37 @@ void TestPiiImage::colorChannel()
   QCOMPARE(ch2(3,3), static_cast<unsigned char>(3));
 }
 
+void TestPiiImage::channelView()
+{
+  // Three-byte pixels make the rows padded.
+  PiiMatrix<PiiColor<> > img(3,5);
+  for (int r=0; r<3; ++r)
+    for (int c=0; c<5; ++c)
+      img(r,c) = PiiColor<>(r*5+c, 100+r, 200+c);
+
+  for (int i=0; i<3; ++i)
+    {
+      PiiColorChannelMatrix<PiiColor<> > view(PiiImage::channelView(img, i));
+      QCOMPARE(view.rows(), 3);
+      QCOMPARE(view.columns(), 5);
+      QCOMPARE(view.channel(), i);
+      QVERIFY(Pii::equals(PiiMatrix<unsigned char>(view), PiiImage::colorChannel(img, i)));
+    }
+
+  PiiColorChannelMatrix<PiiColor<> > red(img, 0);
+  QCOMPARE(red(2,4), (unsigned char)14);
+  QCOMPARE(Pii::sum<int>(red), 105);
+  QCOMPARE(int(*(red.columnBegin(3) + 2)), 13);
+  QCOMPARE(int(red.columnEnd(3) - red.columnBegin(3)), 3);
+  QCOMPARE(int(red.end() - red.begin()), 15);
+  QCOMPARE(int(red.begin()[7]), 7);
+
+  PiiMatrix<PiiColor4<> > img4(2,2);
+  img4 = PiiColor4<>(1,2,3,4);
+  PiiColorChannelMatrix<PiiColor4<> > alpha(PiiImage::channelView(img4, 3));
+  QVERIFY(Pii::equals(PiiMatrix<unsigned char>(alpha), PiiMatrix<unsigned char>(2,2, 4,4,4,4)));
+}
+
 void TestPiiImage::setColorChannel()
 {
   PiiMatrix<PiiColor4<> > img(4,4);
@@ -962,6 +1122,46 @@ void TestPiiImage::detectEdges()
 
 }
 
+void TestPiiImage::cannyEdges()
+{
+  // A vertical step whose contrast drops in the middle, and a
+  // horizontal step between the two.
+  PiiMatrix<unsigned char> matImage(8,12);
+  matImage(0,6,4,6) = 100;
+  matImage(4,6,4,6) = 30;
+
+  PiiMatrix<int> matMagnitude;
+  // The weak bottom half is connected to the strong top half.
+  QVERIFY(Pii::equals(PiiImage::cannyEdges(matImage, 100, 300, &matMagnitude),
+                      PiiMatrix<int>(8,12,
+                                     0,0,0,0,0,0,0,0,0,0,0,0,
+                                     0,0,0,0,0,0,1,0,0,0,0,0,
+                                     0,0,0,0,0,0,1,0,0,0,0,0,
+                                     0,0,0,0,0,0,1,0,0,0,0,0,
+                                     0,0,0,0,0,0,1,1,1,1,1,0,
+                                     0,0,0,0,0,0,1,0,0,0,0,0,
+                                     0,0,0,0,0,0,1,0,0,0,0,0,
+                                     0,0,0,0,0,0,0,0,0,0,0,0)));
+  QCOMPARE(matMagnitude.rows(), 8);
+  QCOMPARE(matMagnitude.columns(), 12);
+  QCOMPARE(matMagnitude(0,5), 400);
+  QCOMPARE(matMagnitude(3,6), 540);
+  QCOMPARE(matMagnitude(7,6), 120);
+
+  QVERIFY(Pii::equals(PiiImage::cannyEdges(matImage, 200, 300),
+                      PiiMatrix<int>(8,12,
+                                     0,0,0,0,0,0,0,0,0,0,0,0,
+                                     0,0,0,0,0,0,1,0,0,0,0,0,
+                                     0,0,0,0,0,0,1,0,0,0,0,0,
+                                     0,0,0,0,0,0,1,0,0,0,0,0,
+                                     0,0,0,0,0,0,1,1,1,1,1,0,
+                                     0,0,0,0,0,0,0,0,0,0,0,0,
+                                     0,0,0,0,0,0,0,0,0,0,0,0,
+                                     0,0,0,0,0,0,0,0,0,0,0,0)));
+
+  QVERIFY(PiiImage::cannyEdges(PiiMatrix<unsigned char>()).isEmpty());
+}
+
 template <class TernaryFunction, class T>
 PiiMatrix<typename TernaryFunction::result_type> TestPiiImage::apply(const PiiMatrix<T>& mat,
                                                                      TernaryFunction func,
@@ -1052,6 +1252,95 @@ void TestPiiImage::adaptiveThreshold()
 
 }
 
+void TestPiiImage::localThreshold()
+{
+  using namespace PiiImage;
+
+  const PiiMatrix<unsigned char> source(3,3,
+                                        1,2,3,
+                                        4,5,6,
+                                        7,8,9);
+  const PiiMatrix<unsigned char> lowerRow(3,3,
+                                          0,0,0,
+                                          0,0,0,
+                                          1,1,1);
+
+  // See adaptiveThreshold() for local means and deviations.
+  QVERIFY(Pii::equals(PiiImage::localThreshold(source, MeanLocalThreshold, 1.0, 0.0, 3),
+                      PiiMatrix<unsigned char>(3,3,
+                                               0,0,0,
+                                               0,1,1,
+                                               1,1,1)));
+  // The window sums are exact: 7 >= 6 + 1
+  QVERIFY(Pii::equals(PiiImage::localThreshold(source, MeanLocalThreshold, 1.0, 1.0, 3), lowerRow));
+
+  QVERIFY(Pii::equals(PiiImage::localThreshold(source, NiblackLocalThreshold, -0.5, 0.0, 3, 3, true),
+                      PiiMatrix<unsigned char>(3,3,
+                                               1,1,1,
+                                               0,0,0,
+                                               0,0,0)));
+  QVERIFY(Pii::equals(PiiImage::localThreshold(source, NiblackLocalThreshold, 0.0, 0.0, 3),
+                      PiiImage::localThreshold(source, MeanLocalThreshold, 1.0, 0.0, 3)));
+
+  QVERIFY(Pii::equals(PiiImage::localThreshold(source, SauvolaLocalThreshold, 0.5, 0.0, 3, 3, false, 2.0),
+                      lowerRow));
+  QVERIFY(Pii::equals(PiiImage::localThreshold(source, SauvolaLocalThreshold, -0.2, 0.0, 3, 3, false, 2.0),
+                      PiiMatrix<unsigned char>(3,3,
+                                               0,0,0,
+                                               0,1,1,
+                                               1,1,1)));
+
+  const PiiMatrix<unsigned short> wideSource(PiiMatrix<unsigned short>(source) * 1000);
+  const IntegralImage<unsigned short> integral(wideSource, true);
+  QVERIFY(Pii::equals(PiiImage::localThreshold(wideSource, integral, MeanLocalThreshold, 1.0, 1000.0, 3),
+                      PiiMatrix<unsigned short>(lowerRow)));
+  QVERIFY(Pii::equals(PiiImage::localThreshold(wideSource, integral, SauvolaLocalThreshold, 0.5, 0.0, 3, 3, false, 2000.0),
+                      PiiMatrix<unsigned short>(lowerRow)));
+}
+
+void TestPiiImage::integralImage()
+{
+  const PiiMatrix<int> source(3,3,
+                              1,2,3,
+                              4,5,6,
+                              7,8,9);
+  PiiImage::IntegralImage<int> integral(source, true);
+  QCOMPARE(integral.rows(), 3);
+  QCOMPARE(integral.columns(), 3);
+  QVERIFY(integral.hasSquareSums());
+  QCOMPARE(integral.sum(0,0,3,3), qint64(45));
+  QCOMPARE(integral.sum(1,1,3,2), qint64(13));
+  QCOMPARE(integral.squareSum(0,0,2,2), 46.0);
+  QCOMPARE(integral.mean(0,0,2,2), 3.0);
+  QCOMPARE(integral.variance(0,0,2,2), 2.5);
+  QVERIFY(Pii::equals(integral.boxMeans<double>(3), PiiMatrix<double>(3,3,
+                                                                      3.0, 3.5, 4.0,
+                                                                      4.5, 5.0, 5.5,
+                                                                      6.0, 6.5, 7.0)));
+
+  PiiMatrix<float> matRandom(Pii::uniformRandomMatrix(20, 30));
+  PiiImage::IntegralImage<float> floatIntegral(matRandom, true);
+  PiiMatrix<double> matMeans(floatIntegral.boxMeans<double>(5, 7)),
+    matVariances(floatIntegral.boxVariances<double>(5, 7));
+  for (int r=0; r<matRandom.rows(); ++r)
+    for (int c=0; c<matRandom.columns(); ++c)
+      {
+        const int r1 = qMax(r-2, 0), r2 = qMin(r+3, 20), c1 = qMax(c-3, 0), c2 = qMin(c+4, 30);
+        double dMean;
+        double dVar = Pii::var<double>(matRandom(r1, c1, r2-r1, c2-c1), &dMean);
+        QVERIFY(Pii::abs(matMeans(r,c) - dMean) < 1e-6);
+        QVERIFY(Pii::abs(matVariances(r,c) - dVar) < 1e-6);
+      }
+
+  // The sum over the whole image overflows 32 bits, but box sums are
+  // still exact.
+  PiiMatrix<unsigned char> matLarge(4100, 4200);
+  matLarge = 255;
+  PiiImage::IntegralImage<unsigned char> byteIntegral(matLarge);
+  QCOMPARE(byteIntegral.sum(4090, 4190, 4100, 4200), 100u * 255u);
+  QCOMPARE(byteIntegral.mean(4000, 4000, 4100, 4200), 255.0);
+}
+
 void TestPiiImage::suppressNonMaxima()
 {
   PiiMatrix<int> source(8,8,
@@ -1233,6 +1522,8 @@ void TestPiiImage::equalize()
                                                              2,2,2,2,
                                                              3,3,3,3,
                                                              3,3,3,3)));
+  // Too few levels must not drop the brightest pixels.
+  QVERIFY(Pii::equals(PiiImage::equalize(img,3), PiiImage::equalize(img,4)));
   img += 14;
   QVERIFY(Pii::equals(PiiImage::equalize(img,32),PiiMatrix<int>(4,4,
                                                                 8,8,8,8,
@@ -1240,6 +1531,55 @@ void TestPiiImage::equalize()
                                                                 24,24,24,24,
                                                                 31,31,31,31)));
 }
+
+void TestPiiImage::adaptiveEqualize()
+{
+  PiiMatrix<int> img(4,4,
+                     0,0,0,0,
+                     1,1,1,1,
+                     2,2,2,2,
+                     3,3,3,3);
+  // A single tile is mapped through its cumulative distribution.
+  QVERIFY(Pii::equals(PiiImage::adaptiveEqualize(img, 0, 0, 0, 4),PiiMatrix<int>(4,4,
+                                                                                 1,1,1,1,
+                                                                                 2,2,2,2,
+                                                                                 2,2,2,2,
+                                                                                 3,3,3,3)));
+
+  // Every tile has a flat histogram, so all mappings are close to
+  // identity, and so is any blend of them.
+  PiiMatrix<unsigned char> matFlat(128, 96);
+  for (int r=0; r<matFlat.rows(); ++r)
+    for (int c=0; c<matFlat.columns(); ++c)
+      matFlat(r,c) = (unsigned char)(((r % 32) * 32 + c % 32) % 256);
+  PiiMatrix<unsigned char> matEqualized(PiiImage::adaptiveEqualize(matFlat, 32, 32, 2.0));
+  QCOMPARE(matEqualized.rows(), 128);
+  QCOMPARE(matEqualized.columns(), 96);
+  for (int r=0; r<matFlat.rows(); ++r)
+    for (int c=0; c<matFlat.columns(); ++c)
+      QVERIFY(qAbs(int(matEqualized(r,c)) - int(matFlat(r,c))) <= 1);
+
+  PiiMatrix<unsigned char> matBytes(Pii::uniformRandomMatrix(301, 67, 0, 255.99));
+  PiiThreadPool pool(4);
+  QVERIFY(Pii::equals(PiiImage::adaptiveEqualize(Pii::ParallelExecution(4, &pool), matBytes, 40, 30, 3.0),
+                      PiiImage::adaptiveEqualize(matBytes, 40, 30, 3.0)));
+}
+
+struct CheckerRoi
+{
+  bool operator() (int r, int c) const { return ((r + c) & 1) != 0; }
+};
+
+template <class T, class Roi> static PiiMatrix<int> naiveHistogram(const PiiMatrix<T>& image, const Roi& roi, int levels)
+{
+  PiiMatrix<int> result(1, levels);
+  for (int r=0; r<image.rows(); ++r)
+    for (int c=0; c<image.columns(); ++c)
+      if (int(image(r,c)) < levels && roi(r,c))
+        ++result(0, int(image(r,c)));
+  return result;
+}
+
 void TestPiiImage::histogram()
 {
   //Testing basic functionality of PiiHistogram-class
@@ -1260,8 +1600,145 @@ void TestPiiImage::histogram()
         }
     }
 
+  PiiMatrix<unsigned char> matBytes(Pii::uniformRandomMatrix(301, 67, 0, 255.99));
+  // Long runs of equal values
+  matBytes(10, 0, 20, -1) = 7;
+  PiiMatrix<int> matWords(matBytes);
+  for (int iLevels=100; iLevels<=300; iLevels+=100)
+    {
+      QVERIFY(Pii::equals(PiiImage::histogram(matBytes, iLevels),
+                          naiveHistogram(matBytes, PiiImage::DefaultRoi(), iLevels)));
+      QVERIFY(Pii::equals(PiiImage::histogram(matBytes, CheckerRoi(), iLevels),
+                          naiveHistogram(matBytes, CheckerRoi(), iLevels)));
+      QVERIFY(Pii::equals(PiiImage::histogram(matWords, CheckerRoi(), iLevels),
+                          naiveHistogram(matBytes, CheckerRoi(), iLevels)));
+    }
+  QCOMPARE(Pii::sum<int>(PiiImage::histogram(matBytes)), 301*67);
+
+  // A mask that is not a bool matrix counts each pixel once.
+  PiiMatrix<unsigned char> matMask(matBytes.rows(), matBytes.columns());
+  for (int r=0; r<matMask.rows(); ++r)
+    for (int c=0; c<matMask.columns(); ++c)
+      matMask(r,c) = CheckerRoi()(r,c) ? 255 : 0;
+  QVERIFY(Pii::equals(PiiImage::histogram(matBytes, matMask, 256),
+                      naiveHistogram(matBytes, CheckerRoi(), 256)));
+  QVERIFY(Pii::equals(PiiImage::histogram(matWords, matMask, 256),
+                      naiveHistogram(matBytes, CheckerRoi(), 256)));
+
+  PiiThreadPool pool(4);
+  for (int iBands=0; iBands<6; ++iBands)
+    {
+      Pii::ParallelExecution policy(iBands, &pool);
+      policy.minBandRows = 4;
+      QVERIFY(Pii::equals(PiiImage::histogram(policy, matBytes, 256),
+                          PiiImage::histogram(matBytes, 256)));
+      QVERIFY(Pii::equals(PiiImage::histogram<double>(policy, matWords, CheckerRoi(), 200),
+                          PiiImage::histogram<double>(matWords, CheckerRoi(), 200)));
+    }
+}
+
+void TestPiiImage::channelHistograms()
+{
+  PiiMatrix<unsigned char> matBytes(Pii::uniformRandomMatrix(3*97, 41, 0, 255.99));
+  matBytes(5, 0, 10, -1) = 3;
+  PiiMatrix<PiiColor<> > clrImage(97, 41);
+  PiiMatrix<PiiColor4<unsigned short> > clr4Image(97, 41);
+  for (int r=0; r<clrImage.rows(); ++r)
+    for (int c=0; c<clrImage.columns(); ++c)
+      {
+        clrImage(r,c) = PiiColor<>(matBytes(3*r,c), matBytes(3*r+1,c), matBytes(3*r+2,c));
+        clr4Image(r,c) = PiiColor4<unsigned short>(clrImage(r,c).c0, clrImage(r,c).c1, clrImage(r,c).c2);
+      }
+  PiiMatrix<unsigned char> aChannels[3];
+  PiiImage::separateChannels(clrImage, aChannels);
+
+  PiiThreadPool pool(4);
+  for (int iBands=0; iBands<4; ++iBands)
+    {
+      Pii::ParallelExecution policy(iBands, &pool);
+      policy.minBandRows = 4;
+      for (int iLevels=100; iLevels<=300; iLevels+=200)
+        {
+          PiiMatrix<int> aHistograms[3], a4Histograms[3];
+          PiiImage::channelHistograms(policy, clrImage, CheckerRoi(), iLevels, aHistograms);
+          PiiImage::channelHistograms(policy, clr4Image, CheckerRoi(), iLevels, a4Histograms);
+          for (int i=0; i<3; ++i)
+            {
+              QVERIFY(Pii::equals(aHistograms[i], naiveHistogram(aChannels[i], CheckerRoi(), iLevels)));
+              QVERIFY(Pii::equals(a4Histograms[i], aHistograms[i]));
+            }
+        }
+    }
 
+  PiiMatrix<unsigned char> matMask(clrImage.rows(), clrImage.columns());
+  for (int r=0; r<matMask.rows(); ++r)
+    for (int c=0; c<matMask.columns(); ++c)
+      matMask(r,c) = CheckerRoi()(r,c) ? 255 : 0;
+  PiiMatrix<int> aHistograms[3];
+  PiiImage::channelHistograms(Pii::ParallelExecution(1), clrImage, matMask, 256, aHistograms);
+  for (int i=0; i<3; ++i)
+    QVERIFY(Pii::equals(aHistograms[i], naiveHistogram(aChannels[i], CheckerRoi(), 256)));
 }
+void TestPiiImage::runLengthRoi()
+{
+  PiiMatrix<bool> matMask(5, 6,
+                          0, 1, 1, 0, 0, 1,
+                          0, 0, 0, 0, 0, 0,
+                          1, 1, 1, 1, 1, 1,
+                          1, 0, 1, 0, 1, 0,
+                          0, 0, 0, 0, 1, 1);
+  PiiImage::RunLengthRoi roi(matMask);
+  QCOMPARE(roi.rows(), 5);
+  QCOMPARE(roi.columns(), 6);
+  QCOMPARE(roi.runCount(), 7);
+  QCOMPARE(roi.pixelCount(), 14);
+  QCOMPARE(int(roi.runEnd(1) - roi.runBegin(1)), 0);
+  QCOMPARE(roi.runBegin(0)->start, 1);
+  QCOMPARE(roi.runBegin(0)->end, 3);
+  QCOMPARE(roi.runBegin(4)->start, 4);
+  QCOMPARE(roi.runBegin(4)->end, 6);
+  for (int r=0; r<matMask.rows(); ++r)
+    for (int c=0; c<matMask.columns(); ++c)
+      QCOMPARE(roi(r,c), matMask(r,c));
+
+  PiiMatrix<double> matRandom(Pii::uniformRandomMatrix(301, 67, 0, 1));
+  PiiMatrix<bool> matSparse(301, 67);
+  for (int r=0; r<matSparse.rows(); ++r)
+    for (int c=0; c<matSparse.columns(); ++c)
+      matSparse(r,c) = matRandom(r,c) > 0.8;
+  PiiMatrix<unsigned char> matBytes(Pii::uniformRandomMatrix(301, 67, 0, 255.99));
+  PiiMatrix<int> matWords(matBytes);
+  PiiImage::RunLengthRoi sparseRoi(matSparse);
+  QVERIFY(Pii::equals(PiiImage::histogram(matBytes, sparseRoi, 256),
+                      naiveHistogram(matBytes, matSparse, 256)));
+  QVERIFY(Pii::equals(PiiImage::histogram(matWords, sparseRoi, 200),
+                      naiveHistogram(matBytes, matSparse, 200)));
+  PiiThreadPool pool(4);
+  Pii::ParallelExecution policy(4, &pool);
+  policy.minBandRows = 4;
+  QVERIFY(Pii::equals(PiiImage::histogram<int>(policy, matBytes, sparseRoi, 256),
+                      naiveHistogram(matBytes, matSparse, 256)));
+  QCOMPARE(Pii::sum<int>(PiiImage::histogram(matBytes, sparseRoi, 256)), sparseRoi.pixelCount());
+
+  PiiMatrix<PiiColor<> > clrImage(301, 67);
+  for (int r=0; r<clrImage.rows(); ++r)
+    for (int c=0; c<clrImage.columns(); ++c)
+      clrImage(r,c) = PiiColor<>(matBytes(r,c), 255 - matBytes(r,c), matBytes(r,c) / 2);
+  PiiMatrix<int> aRunHistograms[3], aMaskHistograms[3];
+  PiiImage::channelHistograms(policy, clrImage, sparseRoi, 256, aRunHistograms);
+  PiiImage::channelHistograms(policy, clrImage, matSparse, 256, aMaskHistograms);
+  for (int i=0; i<3; ++i)
+    QVERIFY(Pii::equals(aRunHistograms[i], aMaskHistograms[i]));
+
+  // The same mask is converted only once.
+  PiiImage::RunLengthRoiCache cache;
+  const PiiImage::RunLengthRoi* pRoi = &cache.roi(matSparse);
+  QCOMPARE(pRoi->pixelCount(), sparseRoi.pixelCount());
+  PiiMatrix<bool> matCopy(matSparse(0, 0, -1, -1));
+  QCOMPARE(cache.roi(matCopy).runBegin(0), pRoi->runBegin(0));
+  QCOMPARE(cache.roi(matMask).pixelCount(), 14);
+}
+
 void TestPiiImage::cumulative()
 {
   //Testing basic functionality of PiiHistogram-class
@@ -1310,6 +1787,18 @@ void TestPiiImage::percentile()
   QCOMPARE(PiiImage::percentile(cum,13),3);
   QCOMPARE(PiiImage::percentile(cum,16),3);
   QCOMPARE(PiiImage::percentile(cum,17),-1);
+
+  PiiMatrix<int> image(4, 4,
+                       0, 1, 2, 3,
+                       0, 1, 2, 3,
+                       0, 1, 2, 3,
+                       0, 1, 2, 3);
+  QVERIFY(Pii::equals(PiiImage::cumulativeHistogram(image), cum));
+  QVERIFY(Pii::equals(PiiImage::cumulativeHistogram<int>(image, PiiImage::DefaultRoi(), 6),
+                      PiiMatrix<int>(1,6, 4,8,12,16,16,16)));
+  QVERIFY(Pii::equals(PiiImage::percentiles(image, PiiImage::DefaultRoi(), 4,
+                                            PiiMatrix<double>(1,5, 0.0, 0.25, 0.3, 0.75, 1.0)),
+                      PiiMatrix<int>(1,5, 0,0,1,2,3)));
 }
 
 void TestPiiImage::hitAndMiss()
@@ -1595,6 +2084,110 @@ void TestPiiImage::labelLargerThan()
                                      1,1,0,0,0)));
 }
 
+void TestPiiImage::streamLabeler()
+{
+  typedef std::binder2nd<std::greater<int> > Rule;
+  // 1 = candidate, 2 = seed
+  PiiMatrix<int> matImage(9,8,
+                          1,1,0,0,0,0,1,1,
+                          0,1,0,0,2,0,0,1,
+                          0,0,0,1,1,0,0,1,
+                          0,0,0,0,0,0,1,1,
+                          1,0,1,0,0,0,0,0,
+                          0,1,0,0,1,1,1,0,
+                          1,0,0,0,1,0,2,0,
+                          0,0,0,0,1,0,0,0,
+                          0,0,2,0,0,0,0,0);
+
+  {
+    PiiImage::StreamLabeler<Rule> labeler(std::bind2nd(std::greater<int>(), 0));
+    // The left object in the top-left corner is complete once the
+    // third row has been seen.
+    QCOMPARE(labeler.addBand(matImage(0,0,2,-1)).size(), 0);
+    QList<PiiImage::LabelInfo> lstObjects(labeler.addBand(matImage(2,0,2,-1)));
+    QCOMPARE(lstObjects.size(), 2);
+    QCOMPARE(lstObjects[0].label, 1);
+    QCOMPARE(lstObjects[0].pixelCount, qint64(3));
+    QCOMPARE(lstObjects[0].firstRow, qint64(0));
+    QCOMPARE(lstObjects[0].lastRow, qint64(1));
+    QCOMPARE(lstObjects[0].firstColumn, 0);
+    QCOMPARE(lstObjects[0].lastColumn, 1);
+    QCOMPARE(lstObjects[1].pixelCount, qint64(3));
+    QCOMPARE(labeler.openObjectCount(), 1);
+    lstObjects = labeler.addBand(matImage(4,0,5,-1));
+    QCOMPARE(labeler.rowCount(), qint64(9));
+    lstObjects.append(labeler.finish());
+    // Right edge, four singles, the cross and the one on the last row
+    QCOMPARE(lstObjects.size(), 7);
+    QCOMPARE(lstObjects[0].pixelCount, qint64(6));
+    QCOMPARE(labeler.openObjectCount(), 0);
+  }
+
+  {
+    // Hysteresis with 8-connectivity. The results must equal those
+    // of the batch version regardless of band boundaries.
+    PiiMatrix<int> matBatch(PiiImage::labelImage(matImage,
+                                                 std::bind2nd(std::greater<int>(), 0),
+                                                 std::bind2nd(std::greater<int>(), 1),
+                                                 PiiImage::Connect8, false, 2));
+    for (int iBandRows=1; iBandRows<=9; ++iBandRows)
+      {
+        PiiImage::StreamLabeler<Rule,Rule> labeler(std::bind2nd(std::greater<int>(), 0),
+                                                   std::bind2nd(std::greater<int>(), 1),
+                                                   PiiImage::Connect8, 2);
+        QList<PiiImage::LabelInfo> lstObjects;
+        for (int r=0; r<matImage.rows(); r+=iBandRows)
+          lstObjects.append(labeler.addBand(matImage(r,0,qMin(iBandRows, matImage.rows()-r),-1)));
+        lstObjects.append(labeler.finish());
+
+        QCOMPARE(lstObjects.size(), 2);
+        PiiMatrix<int> matStream(matImage.rows(), matImage.columns());
+        for (int i=0; i<lstObjects.size(); ++i)
+          for (int j=0; j<lstObjects[i].runs.size(); ++j)
+            {
+              const PiiImage::LabelRun& run = lstObjects[i].runs[j];
+              for (int c=run.start; c<run.end; ++c)
+                matStream(int(run.row), c) = 1;
+            }
+        QVERIFY(Pii::equals(matStream, PiiMatrix<int>(matBatch != 0)));
+      }
+  }
+}
+
+void TestPiiImage::parallelLabeling()
+{
+  PiiThreadPool pool(4);
+  for (int i=0; i<4; ++i)
+    {
+      // Different densities produce both small objects and objects
+      // that span many bands.
+      PiiMatrix<int> matImage(Pii::uniformRandomMatrix(157, 83, 0, 1.2 + i * 0.3));
+      for (int iBands=0; iBands<6; ++iBands)
+        {
+          Pii::ParallelExecution policy(iBands, &pool);
+          policy.minBandRows = 3;
+          int iSequentialCount = 0, iParallelCount = 0;
+          QVERIFY(Pii::equals(PiiImage::labelImage(policy, matImage, &iParallelCount),
+                              PiiImage::labelImage(matImage, &iSequentialCount)));
+          QCOMPARE(iParallelCount, iSequentialCount);
+
+          QVERIFY(Pii::equals(PiiImage::labelImage(policy, matImage,
+                                                   std::bind2nd(std::greater<int>(), 0),
+                                                   PiiImage::Connect8, &iParallelCount),
+                              PiiImage::labelImage(matImage,
+                                                   std::bind2nd(std::greater<int>(), 0),
+                                                   Pii::YesFunction<int>(),
+                                                   PiiImage::Connect8, false, 0, INT_MAX,
+                                                   &iSequentialCount)));
+          QCOMPARE(iParallelCount, iSequentialCount);
+
+          QVERIFY(Pii::equals(PiiImage::labelLargerThan(policy, matImage, 5, &iParallelCount),
+                              PiiImage::labelLargerThan(matImage, 5, &iSequentialCount)));
+          QCOMPARE(iParallelCount, iSequentialCount);
+        }
+    }
+}
+
 void TestPiiImage::thin()
 {
   PiiMatrix<int> source(6,6,
@@ -1990,6 +2583,43 @@ void TestPiiImage::findBoundaries()
                                                      0,0,0,0,0,0,0,0)));
 }
 
+void TestPiiImage::findChainCodes()
+{
+  PiiChainCode chain(2, 3);
+  chain.append(0);
+  chain.append(3);
+  chain.append(6);
+  QCOMPARE(chain.length(), 3);
+  QVERIFY(Pii::equals(chain.toPoints<int>(), PiiMatrix<int>(4,2,
+                                                            2,3,
+                                                            3,3,
+                                                            2,4,
+                                                            2,3)));
+
+  for (int i=0; i<4; ++i)
+    {
+      // Random blobs with holes and nested objects
+      PiiMatrix<int> matObjects(Pii::uniformRandomMatrix(83, 71, 0, 1.3 + i * 0.2));
+      std::binder2nd<std::greater<int> > rule(std::greater<int>(), 0);
+      PiiMatrix<unsigned char> matMask, matChainMask, matParallelMask;
+      QList<PiiMatrix<int> > lstBoundaries(PiiBoundaryFinder::findBoundaries<int>(matObjects, rule, &matMask));
+      QList<PiiChainCode> lstChains(PiiBoundaryFinder::findChainCodes(matObjects, rule, &matChainMask));
+      QList<PiiChainCode> lstParallel(PiiBoundaryFinder::findChainCodes(Pii::ParallelExecution(3), matObjects,
+                                                                        rule, &matParallelMask));
+      QVERIFY(lstBoundaries.size() > 10);
+      QCOMPARE(lstChains.size(), lstBoundaries.size());
+      QCOMPARE(lstParallel.size(), lstBoundaries.size());
+      for (int b=0; b<lstBoundaries.size(); ++b)
+        {
+          QCOMPARE(lstChains[b].pointCount(), lstBoundaries[b].rows());
+          QVERIFY(Pii::equals(lstChains[b].toPoints<int>(), lstBoundaries[b]));
+          QVERIFY(Pii::equals(lstParallel[b].toPoints<int>(), lstBoundaries[b]));
+        }
+      QVERIFY(Pii::equals(matChainMask, matMask));
+      QVERIFY(Pii::equals(matParallelMask, matMask));
+    }
+}
+
 void TestPiiImage::threshold()
 {
   QVERIFY(Pii::equals(PiiImage::threshold(_matThreshold, 5),
@@ -2071,6 +2701,36 @@ void TestPiiImage::zeroBelow()
   }
 }
 
+void TestPiiImage::rankFilter()
+{
+  PiiMatrix<unsigned char> mat(3,4,
+                               1, 9, 2, 8,
+                               3, 7, 4, 6,
+                               5, 0, 5, 0);
+  QVERIFY(Pii::equals(PiiImage::rankFilter(mat, 3, 3, 0, Pii::ExtendNot),
+                      PiiMatrix<unsigned char>(1,2, 0, 0)));
+  QVERIFY(Pii::equals(PiiImage::rankFilter(mat, 3, 3, 8, Pii::ExtendNot),
+                      PiiMatrix<unsigned char>(1,2, 9, 9)));
+  QVERIFY(Pii::equals(PiiImage::rankFilter(mat, 3, 3, 4, Pii::ExtendNot),
+                      PiiMatrix<unsigned char>(1,2, 4, 5)));
+
+  // The histogram-based median filter must match the sorting one
+  PiiMatrix<unsigned char> matBytes(Pii::uniformRandomMatrix(37, 53, 0, 255));
+  PiiMatrix<unsigned short> matWords(Pii::uniformRandomMatrix(37, 53, 0, 65535));
+  for (int iMode=0; iMode<2; ++iMode)
+    {
+      Pii::ExtendMode mode = iMode == 0 ? Pii::ExtendZeros : Pii::ExtendReplicate;
+      for (int iRows=1; iRows<=16; iRows+=3)
+        for (int iCols=1; iCols<=17; iCols+=4)
+          {
+            QVERIFY(Pii::equals(PiiImage::histogramMedianFilter(matBytes, iRows, iCols, mode),
+                                PiiImage::medianFilter(matBytes, iRows, iCols, mode)));
+            QVERIFY(Pii::equals(PiiImage::histogramMedianFilter(matWords, iRows, iCols, mode),
+                                PiiImage::medianFilter(matWords, iRows, iCols, mode)));
+          }
+    }
+}
+
 void TestPiiImage::separateFilter()
 {
   {
@@ -2318,6 +2978,287 @@ void TestPiiImage::minFilter()
   QVERIFY(Pii::equals(PiiImage::minFilter(img,3,5), res));
 }
 
+void TestPiiImage::parallelExecution()
+{
+  PiiMatrix<int> matImage(Pii::uniformRandomMatrix(203, 71, 0, 255));
+  PiiMatrix<int> matBinary(Pii::uniformRandomMatrix(203, 71, 0, 1.4));
+  PiiThreadPool pool(4);
+  // Zero bands means one per thread.
+  for (int iBands=0; iBands<6; ++iBands)
+    {
+      Pii::ParallelExecution policy(iBands, &pool);
+      policy.minBandRows = 4;
+      for (int iSize=3; iSize<=9; iSize+=2)
+        {
+          QVERIFY(Pii::equals(PiiImage::medianFilter(policy, matImage, iSize, iSize+2, Pii::ExtendReplicate),
+                              PiiImage::medianFilter(matImage, iSize, iSize+2, Pii::ExtendReplicate)));
+          QVERIFY(Pii::equals(PiiImage::maxFilter(policy, matImage, iSize, 3),
+                              PiiImage::maxFilter(matImage, iSize, 3)));
+          QVERIFY(Pii::equals(PiiImage::minFilter(policy, matImage, iSize),
+                              PiiImage::minFilter(matImage, iSize)));
+          PiiMatrix<int> matMask(PiiMatrix<int>::constant(iSize, 3, 1));
+          QVERIFY(Pii::equals(PiiImage::erode(policy, matBinary, matMask),
+                              PiiImage::erode(matBinary, matMask)));
+          QVERIFY(Pii::equals(PiiImage::erode(policy, matBinary, matMask, true),
+                              PiiImage::erode(matBinary, matMask, true)));
+          QVERIFY(Pii::equals(PiiImage::dilate(policy, matBinary, matMask),
+                              PiiImage::dilate(matBinary, matMask)));
+        }
+      PiiMatrix<unsigned char> matGray(matImage);
+      for (double dAngle = 0.3; dAngle < 6; dAngle += 0.9)
+        {
+          QVERIFY(Pii::equals(PiiImage::rotate(policy, matImage, dAngle),
+                              PiiImage::rotate(matImage, dAngle)));
+          QVERIFY(Pii::equals(PiiImage::rotate(policy, matGray, dAngle, PiiImage::RetainOriginalSize),
+                              PiiImage::rotate(matGray, dAngle, PiiImage::RetainOriginalSize)));
+        }
+      PiiMatrix<int> matMagnitude, matSequentialMagnitude;
+      QVERIFY(Pii::equals(PiiImage::cannyEdges(policy, matGray, 0, 0, &matMagnitude),
+                          PiiImage::cannyEdges(matGray, 0, 0, &matSequentialMagnitude)));
+      QVERIFY(Pii::equals(matMagnitude, matSequentialMagnitude));
+    }
+}
+
+void TestPiiImage::remapTable()
+{
+  PiiMatrix<float> matImage(Pii::uniformRandomMatrix(31, 43, 0, 255));
+  PiiMatrix<unsigned char> matGray(matImage);
+  PiiImage::DoubleCoordinateMap matMap(40, 50);
+  PiiImage::IntCoordinateMap matIntMap(40, 50);
+  for (int r=0; r<matMap.rows(); ++r)
+    for (int c=0; c<matMap.columns(); ++c)
+      {
+        // Some of the points will fall outside of the image.
+        matMap(r,c) = PiiPoint<double>(c * 0.9 + 0.3 * r - 2, r * 0.75 + 0.05 * c - 1);
+        matIntMap(r,c) = PiiPoint<int>(c - 3, r + 1);
+      }
+  {
+    PiiImage::RemapTable table(matMap, matImage.rows(), matImage.columns());
+    QCOMPARE(table.rows(), 40);
+    QCOMPARE(table.columns(), 50);
+    QCOMPARE(table.sourceRows(), 31);
+    QCOMPARE(table.sourceColumns(), 43);
+    PiiMatrix<float> matResult(PiiImage::remap(matImage, table));
+    QCOMPARE(matResult.rows(), 40);
+    QCOMPARE(matResult.columns(), 50);
+    PiiMatrix<float> matExpected(PiiMatrix<float>::uninitialized(40, 50));
+    for (int r=0; r<matMap.rows(); ++r)
+      for (int c=0; c<matMap.columns(); ++c)
+        {
+          PiiPoint<double> pt(matMap(r,c));
+          if (pt.x >= 0 && pt.x < matImage.columns() &&
+              pt.y >= 0 && pt.y < matImage.rows())
+            matExpected(r,c) = Pii::valueAt(matImage,
+                                            qMin(pt.y, matImage.rows() - 1.0),
+                                            qMin(pt.x, matImage.columns() - 1.0));
+          else
+            matExpected(r,c) = 0;
+        }
+    // 1/256 pixel steps
+    QVERIFY(Pii::max(Pii::abs(matResult - matExpected)) < 2);
+
+    PiiMatrix<unsigned char> matGrayResult(PiiImage::remap(matGray, table));
+    QVERIFY(Pii::max(Pii::abs(PiiMatrix<int>(matGrayResult) - PiiMatrix<int>(matExpected))) <= 3);
+
+    PiiThreadPool pool(3);
+    Pii::ParallelExecution policy(0, &pool);
+    policy.minBandRows = 4;
+    QVERIFY(Pii::equals(PiiImage::remap(policy, matImage, table), matResult));
+    QVERIFY(Pii::equals(PiiImage::remap(policy, matGray, table), matGrayResult));
+  }
+  {
+    // Without interpolation, the result must be exactly the same.
+    PiiImage::RemapTable table(matIntMap, matImage.rows(), matImage.columns());
+    PiiMatrix<float> matExpected(40, 50);
+    for (int r=0; r<matIntMap.rows(); ++r)
+      for (int c=0; c<matIntMap.columns(); ++c)
+        {
+          PiiPoint<int> pt(matIntMap(r,c));
+          if (pt.x >= 0 && pt.x < matImage.columns() &&
+              pt.y >= 0 && pt.y < matImage.rows())
+            matExpected(r,c) = matImage(pt.y, pt.x);
+        }
+    QVERIFY(Pii::equals(PiiImage::remap(matImage, table), matExpected));
+  }
+  {
+    PiiImage::RemapTable table(matMap);
+    QCOMPARE(table.sourceRows(), 40);
+    try
+      {
+        PiiImage::remap(matImage, table);
+        QFAIL("remap() did not throw an exception on size mismatch");
+      }
+    catch (PiiInvalidArgumentException&)
+      {}
+  }
+}
+
+void TestPiiImage::pyramid()
+{
+  PiiMatrix<unsigned char> matImage(5, 6,
+                                    0, 0, 0, 16, 16, 16,
+                                    0, 0, 0, 16, 16, 16,
+                                    0, 0, 0, 16, 16, 16,
+                                    0, 0, 0, 16, 16, 16,
+                                    0, 0, 0, 16, 16, 16);
+  // The last row is paired with itself.
+  QVERIFY(Pii::equals(PiiImage::pyramidDown(matImage, PiiImage::BoxPyramidFilter),
+                      PiiMatrix<unsigned char>(3, 3,
+                                               0, 8, 16,
+                                               0, 8, 16,
+                                               0, 8, 16)));
+  // Each output pixel is a weighted sum of five columns. The right
+  // edge is replicated.
+  QVERIFY(Pii::equals(PiiImage::pyramidDown(matImage),
+                      PiiMatrix<unsigned char>(3, 3,
+                                               0, 5, 15,
+                                               0, 5, 15,
+                                               0, 5, 15)));
+  QVERIFY(Pii::equals(PiiImage::pyramidDown(PiiMatrix<float>(matImage)),
+                      PiiMatrix<float>(3, 3,
+                                       0.0, 5.0, 15.0,
+                                       0.0, 5.0, 15.0,
+                                       0.0, 5.0, 15.0)));
+
+  PiiMatrix<unsigned char> matRandom(Pii::uniformRandomMatrix(77, 50, 0, 255));
+  QList<PiiMatrix<unsigned char> > lstLevels(PiiImage::buildPyramid(matRandom, 4));
+  QCOMPARE(lstLevels.size(), 4);
+  QVERIFY(Pii::equals(lstLevels[0], matRandom));
+  QCOMPARE(lstLevels[1].rows(), 39);
+  QCOMPARE(lstLevels[1].columns(), 25);
+  QCOMPARE(lstLevels[3].rows(), 10);
+  QCOMPARE(lstLevels[3].columns(), 7);
+  // Stop at a single pixel.
+  QCOMPARE(PiiImage::buildPyramid(matRandom, 20).size(), 8);
+
+  PiiThreadPool pool(3);
+  Pii::ParallelExecution policy(0, &pool);
+  policy.minBandRows = 4;
+  for (int i=0; i<2; ++i)
+    {
+      PiiImage::PyramidFilter filter = i == 0 ? PiiImage::BoxPyramidFilter : PiiImage::GaussianPyramidFilter;
+      QList<PiiMatrix<unsigned char> > lstParallel(PiiImage::buildPyramid(policy, matRandom, 4, filter));
+      QList<PiiMatrix<unsigned char> > lstSerial(PiiImage::buildPyramid(matRandom, 4, filter));
+      QCOMPARE(lstParallel.size(), lstSerial.size());
+      for (int l=0; l<lstSerial.size(); ++l)
+        QVERIFY(Pii::equals(lstParallel[l], lstSerial[l]));
+    }
+
+  PiiMatrix<PiiColor4<> > matColor(7, 7);
+  matColor = PiiColor4<>(10, 20, 30, 255);
+  PiiMatrix<PiiColor4<> > matColorResult(4, 4);
+  matColorResult = PiiColor4<>(10, 20, 30, 255);
+  QVERIFY(Pii::equals(PiiImage::pyramidDown(matColor), matColorResult));
+}
+
+static double naiveCorrelation(const PiiMatrix<unsigned char>& image,
+                               const PiiMatrix<unsigned char>& templ,
+                               int row, int column)
+{
+  const double dImageMean = Pii::mean<double>(image(row, column, templ.rows(), templ.columns())),
+    dTemplateMean = Pii::mean<double>(templ);
+  double dProduct = 0, dImageSquares = 0, dTemplateSquares = 0;
+  for (int r=0; r<templ.rows(); ++r)
+    for (int c=0; c<templ.columns(); ++c)
+      {
+        const double dImage = image(row + r, column + c) - dImageMean, dTemplate = templ(r,c) - dTemplateMean;
+        dProduct += dImage * dTemplate;
+        dImageSquares += dImage * dImage;
+        dTemplateSquares += dTemplate * dTemplate;
+      }
+  return dProduct / std::sqrt(dImageSquares * dTemplateSquares);
+}
+
+void TestPiiImage::templateMatching()
+{
+  PiiMatrix<unsigned char> matImage(Pii::uniformRandomMatrix(64, 60, 0, 255));
+  PiiMatrix<unsigned char> matTemplate(matImage(8, 12, 16, 16));
+
+  PiiMatrix<float> matFull(PiiImage::normalizedCorrelation(matImage, matTemplate));
+  QCOMPARE(matFull.rows(), 49);
+  QCOMPARE(matFull.columns(), 45);
+  for (int r=0; r<matFull.rows(); r += 3)
+    for (int c=0; c<matFull.columns(); c += 2)
+      QVERIFY(Pii::abs(matFull(r,c) - naiveCorrelation(matImage, matTemplate, r, c)) < 1e-4);
+  int iRow = 0, iColumn = 0;
+  QVERIFY(Pii::max(matFull, &iRow, &iColumn) > 0.9999);
+  QCOMPARE(iRow, 8);
+  QCOMPARE(iColumn, 12);
+
+  PiiThreadPool pool(3);
+  Pii::ParallelExecution policy(0, &pool);
+  policy.minBandRows = 4;
+  QVERIFY(Pii::equals(PiiImage::normalizedCorrelation(policy, matImage, matTemplate), matFull));
+
+  // Sparse evaluation gives the same values at marked positions and
+  // zeros elsewhere.
+  PiiMatrix<bool> matPositions(matFull.rows(), matFull.columns());
+  matPositions(8,12) = matPositions(0,0) = matPositions(48,44) = matPositions(20,7) = true;
+  PiiMatrix<float> matSparse(PiiImage::normalizedCorrelation(policy, matImage, matTemplate, matPositions));
+  for (int r=0; r<matFull.rows(); ++r)
+    for (int c=0; c<matFull.columns(); ++c)
+      {
+        if (matPositions(r,c))
+          QVERIFY(Pii::abs(matSparse(r,c) - matFull(r,c)) < 1e-4);
+        else
+          QCOMPARE(matSparse(r,c), 0.0f);
+      }
+
+  // Coarse-to-fine search finds the exact match. Noise has no
+  // structure at coarse levels; use a smooth image.
+  PiiMatrix<unsigned char> matSmooth(64, 60);
+  for (int r=0; r<matSmooth.rows(); ++r)
+    for (int c=0; c<matSmooth.columns(); ++c)
+      matSmooth(r,c) = (unsigned char)std::floor(128 + 60 * std::sin(r*0.37 + c*0.11) + 50 * std::cos(c*0.29 - r*0.07));
+  PiiMatrix<float> matPyramid(PiiImage::pyramidCorrelation(policy, matSmooth,
+                                                           PiiMatrix<unsigned char>(matSmooth(8, 12, 16, 16)),
+                                                           3, 0.3));
+  QCOMPARE(matPyramid.rows(), matFull.rows());
+  QCOMPARE(matPyramid.columns(), matFull.columns());
+  QVERIFY(Pii::max(matPyramid, &iRow, &iColumn) > 0.9999);
+  QCOMPARE(iRow, 8);
+  QCOMPARE(iColumn, 12);
+
+  // Flat windows and too large templates
+  QVERIFY(Pii::equals(PiiImage::normalizedCorrelation(PiiMatrix<unsigned char>(8, 8),
+                                                      PiiMatrix<unsigned char>(3, 3, 1,2,3, 4,5,6, 7,8,9)),
+                      PiiMatrix<float>(6, 6)));
+  QVERIFY(PiiImage::normalizedCorrelation(matTemplate, matImage).isEmpty());
+}
+
+void TestPiiImage::fastCorners()
+{
+  PiiMatrix<int> matSquares(40, 50);
+  matSquares(10,15,10,10) = 200;
+  matSquares(25,30,8,8) = 100;
+  // Smooth the edges. Corners of a binary square tie in score and
+  // suppress each other.
+  PiiMatrix<uchar> matImage(PiiImage::filter<int>(matSquares,
+                                                  PiiMatrix<int>(1,3, 1,2,1),
+                                                  PiiMatrix<int>(3,1, 1,2,1),
+                                                  Pii::ExtendZeros) / 16);
+
+  PiiMatrix<int> matCorners(8,2,
+                            16,11, 23,11,
+                            16,18, 23,18,
+                            31,26, 36,26,
+                            31,31, 36,31);
+  QVERIFY(Pii::equals(PiiImage::detectFastCorners(matImage, uchar(20)), matCorners));
+  QVERIFY(Pii::equals(PiiImage::detectFastCorners(PiiMatrix<float>(matImage), 20.0f), matCorners));
+  // No contiguous arc of 12 at a right-angled corner.
+  QCOMPARE(PiiImage::detectFastCorners(matImage, uchar(20), 12).rows(), 0);
+
+  // One corner for each square
+  PiiMatrix<int> matGridCorners(PiiImage::detectFastCorners(matImage, uchar(20), 9, 25, 1));
+  QVERIFY(Pii::equals(matGridCorners, PiiMatrix<int>(2,2, 16,11, 31,26)));
+
+  // Vectorized 8-bit detection must match the generic code.
+  PiiMatrix<uchar> matRandom(Pii::uniformRandomMatrix(61, 83, 0, 255));
+  for (int iArcLength=9; iArcLength<=12; ++iArcLength)
+    QVERIFY(Pii::equals(PiiImage::detectFastCorners(matRandom, uchar(30), iArcLength),
+                        PiiImage::detectFastCorners(PiiMatrix<int>(matRandom), 30, iArcLength)));
+}
+
 struct GradientPicker
 {
   GradientPicker(QList<QPair<int, int> >* coords) :
@@ -2359,4 +3300,66 @@ void TestPiiImage::fastGradient()
   }
 }
 
+void TestPiiImage::updateBackgroundRow_data()
+{
+  QTest::addColumn<bool>("median");
+  QTest::addColumn<bool>("selectiveUpdate");
+
+  QTest::newRow("average") << false << false;
+  QTest::newRow("average, selective") << false << true;
+  QTest::newRow("median") << true << false;
+  QTest::newRow("median, selective") << true << true;
+}
+
+void TestPiiImage::updateBackgroundRow()
+{
+  QFETCH(bool, median);
+  QFETCH(bool, selectiveUpdate);
+
+  // The SIMD path takes eight pixels at a time. The widths cover rows
+  // shorter than a vector, whole vectors and partial final vectors.
+  const int aiWidths[] = { 1, 7, 8, 9, 15, 16, 17, 31, 64, 67 };
+  const int iThreshold = 25 * 128, iMaxStillTime = 3,
+    iRate = median ? 128 : 3277,
+    iForegroundRate = selectiveUpdate ? 0 : median ? 128 : 328;
+  const int iMask = Pii::cpuFeatureMask();
+  Pii::seedRandom(3);
+
+  for (unsigned w=0; w<sizeof(aiWidths)/sizeof(aiWidths[0]); ++w)
+    {
+      const int iColumns = aiWidths[w];
+      PiiMatrix<unsigned char> matBase(Pii::uniformRandomMatrix(1, iColumns, 0, 255));
+      PiiMatrix<short> matSimdBackground(matBase);
+      matSimdBackground *= short(128);
+      PiiMatrix<short> matGenericBackground(matSimdBackground);
+      PiiMatrix<int> matSimdStill(1, iColumns), matGenericStill(1, iColumns);
+
+      for (int f=0; f<30; ++f)
+        {
+          // Every third frame is noise, which makes most pixels
+          // foreground. Three such frames in a row would reset the
+          // still counters, so a few do.
+          PiiMatrix<unsigned char> matFrame(1, iColumns);
+          for (int c=0; c<iColumns; ++c)
+            matFrame(0,c) = (uchar)(f % 3 == 2 ?
+                                    Pii::uniformRandom(0, 255) :
+                                    qBound(0.0, matBase(0,c) + Pii::uniformRandom(-8, 8), 255.0));
+
+          Pii::setCpuFeatureMask(iMask);
+          const int iSimdCount = PiiImage::updateBackgroundRow(matFrame[0], matSimdBackground[0], matSimdStill[0],
+                                                               iColumns, iThreshold, iRate, iForegroundRate,
+                                                               iMaxStillTime, median);
+          Pii::setCpuFeatureMask(Pii::NoCpuFeatures);
+          const int iGenericCount = PiiImage::updateBackgroundRow(matFrame[0], matGenericBackground[0], matGenericStill[0],
+                                                                  iColumns, iThreshold, iRate, iForegroundRate,
+                                                                  iMaxStillTime, median);
+          Pii::setCpuFeatureMask(iMask);
+          if (iSimdCount != iGenericCount ||
+              !Pii::equals(matSimdBackground, matGenericBackground) ||
+              !Pii::equals(matSimdStill, matGenericStill))
+            QFAIL(qPrintable(QString("SIMD and generic results differ at width %1, frame %2.").arg(iColumns).arg(f)));
+        }
+    }
+}
+
 QTEST_MAIN(TestPiiImage)
@@ -27,6 +27,7 @@ private slots:
   void initTestCase();
   void findClosestMatch();
   void findClosestMatches();
+  void approximateSearch();
   void cleanupTestCase();
 
 private:
@@ -15,6 +15,7 @@
 
 #include <iostream>
 #include "TestPiiKdTree.h"
+#include <PiiRandom.h>
 
 #include <QtTest>
 
@@ -74,6 +75,36 @@ void TestPiiKdTree::findClosestMatches()
     }
 }
 
+void TestPiiKdTree::approximateSearch()
+{
+  PiiMatrix<float> matModels(Pii::uniformRandomMatrix(500, 8));
+  PiiMatrix<float> matQueries(Pii::uniformRandomMatrix(20, 8));
+
+  PiiKdTree<PiiMatrix<float> > tree;
+  tree.buildTree(matModels, 4);
+  QCOMPARE(tree.treeCount(), 4);
+  PiiKdTree<PiiMatrix<float> > copy(tree);
+  QCOMPARE(copy.treeCount(), 4);
+
+  for (int i=0; i<matQueries.rows(); ++i)
+    {
+      PiiClassification::MatchList lstExact = tree.findClosestMatches(matQueries[i], 5);
+      // With a large enough budget, the result is exact.
+      PiiClassification::MatchList lstMatches = tree.findClosestMatches(matQueries[i], 5, 4*500);
+      QCOMPARE(lstMatches.size(), 5);
+      for (int j=0; j<5; ++j)
+        QCOMPARE(lstMatches[j].second, lstExact[j].second);
+      QCOMPARE(tree.findClosestMatch(matQueries[i], 4*500), lstExact[0].second);
+
+      // A sample is found in many trees, but it must be matched only
+      // once.
+      lstMatches = tree.findClosestMatches(matQueries[i], 5, 50);
+      for (int j=0; j<5; ++j)
+        for (int k=j+1; k<5; ++k)
+          QVERIFY(lstMatches[j].second == -1 || lstMatches[j].second != lstMatches[k].second);
+    }
+}
+
 void TestPiiKdTree::cleanupTestCase()
 {
   delete _pTree;
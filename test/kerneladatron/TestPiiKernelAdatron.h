@@ -24,6 +24,7 @@ class TestPiiKernelAdatron : public QObject
 
 private slots:
   void learn();
+  void learnWithSmallCache();
 };
 
 
@@ -45,4 +45,29 @@ void TestPiiKernelAdatron::learn()
     }
 }
 
+void TestPiiKernelAdatron::learnWithSmallCache()
+{
+  static const int iSamplesPerSet = 200;
+
+  PiiMatrix<double> matSamples;
+  QVector<double> vecLabels;
+  PiiClassification::createDoubleSpiral(iSamplesPerSet, 3, matSamples, vecLabels);
+
+  PiiKernelAdatron<PiiMatrix<double> > fullAdatron, cachedAdatron;
+  fullAdatron.setLearningRate(0.5);
+  cachedAdatron.setLearningRate(0.5);
+  // Room for 40 rows only
+  cachedAdatron.setCacheSize(40 * iSamplesPerSet * 2 * sizeof(double));
+  fullAdatron.learn(matSamples, vecLabels);
+  cachedAdatron.learn(matSamples, vecLabels);
+
+  QVERIFY(cachedAdatron.converged());
+  // Recalculated rows must give the same results
+  QCOMPARE(cachedAdatron.weights(), fullAdatron.weights());
+  QCOMPARE(cachedAdatron.decisionThreshold(), fullAdatron.decisionThreshold());
+
+  for (int r=0; r<iSamplesPerSet*2; ++r)
+    QCOMPARE(cachedAdatron.classify(matSamples[r]), vecLabels[r]);
+}
+
 QTEST_MAIN(TestPiiKernelAdatron)
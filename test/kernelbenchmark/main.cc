@@ -0,0 +1,433 @@
+/* This file is part of Into.
+ * Copyright (C) Intopii 2013.
+ * All rights reserved.
+ *
+ * Licensees holding a commercial Into license may use this file in
+ * accordance with the commercial license agreement. Please see
+ * LICENSE.commercial for commercial licensing terms.
+ *
+ * Alternatively, this file may be used under the terms of the GNU
+ * Affero General Public License version 3 as published by the Free
+ * Software Foundation. In addition, Intopii gives you special rights
+ * to use Into as a part of open source software projects. Please
+ * refer to LICENSE.AGPL3 for details.
+ */
+
+
+/* Benchmarks for the image processing kernels. Each kernel is run on
+ * square images of the given sizes and pixel types, sequentially and
+ * (if the kernel has a parallel version) in bands on all threads of
+ * the global thread pool. One line of JSON is printed per
+ * measurement:
+ *
+ * {"cpu":"...","kernel":"median","type":"uchar","size":1024,
+ *  "threads":1,"time":...,"megapixelsPerSecond":...}
+ *
+ * The time is the median of the repetitions in microseconds. After
+ * all measurements, a line with the crossover point is printed for
+ * each parallel kernel:
+ *
+ * {"cpu":"...","kernel":"median","type":"uchar","threads":8,"crossoverSize":256}
+ *
+ * crossoverSize is the smallest measured size at which parallel
+ * execution was faster, or null if it never was. With -d, the
+ * results are written to a file named after the CPU model in the
+ * given directory, so that baselines of different machines can be
+ * kept side by side.
+ *
+ * Usage: kernelbenchmark [-s size[,size...]] [-k kernel[,kernel...]]
+ *                        [-r repetitions] [-d directory]
+ */
+
+#include <PiiImage.h>
+#include <PiiMorphology.h>
+#include <PiiLabeling.h>
+#include <PiiHistogram.h>
+#include <PiiLbp.h>
+#include <PiiColors.h>
+#include <PiiFft.h>
+#include <PiiMatrixProduct.h>
+#include <PiiThreadPool.h>
+#include <PiiTimer.h>
+
+#include <QCoreApplication>
+#include <QStringList>
+#include <QFile>
+#include <QDir>
+#include <QTextStream>
+#include <QVector>
+#include <QMap>
+#include <QRegExp>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+
+namespace
+{
+  QString cpuModel()
+  {
+    QFile file("/proc/cpuinfo");
+    if (file.open(QIODevice::ReadOnly | QIODevice::Text))
+      {
+        QTextStream in(&file);
+        for (QString strLine = in.readLine(); !strLine.isNull(); strLine = in.readLine())
+          if (strLine.startsWith("model name"))
+            return strLine.mid(strLine.indexOf(':') + 1).trimmed();
+      }
+    return "unknown";
+  }
+
+  // A reproducible pseudo-random image.
+  template <class T> PiiMatrix<T> randomImage(int size, int maximum)
+  {
+    PiiMatrix<T> matImage(PiiMatrix<T>::uninitialized(size, size));
+    unsigned int iState = 12345;
+    for (typename PiiMatrix<T>::iterator i = matImage.begin(); i != matImage.end(); ++i)
+      {
+        iState = iState * 1103515245 + 12345;
+        *i = T((iState >> 16) % (maximum + 1));
+      }
+    return matImage;
+  }
+
+  template <class T> struct Inputs
+  {
+    Inputs(int size) :
+      matImage(randomImage<T>(size, 255)),
+      matMask(PiiImage::createMask<int>(PiiImage::RectangularMask, 5))
+    {
+      PiiImage::DoubleCoordinateMap matMap(size, size);
+      const double dAngle = 0.1, dCos = std::cos(dAngle), dSin = std::sin(dAngle);
+      for (int r=0; r<size; ++r)
+        for (int c=0; c<size; ++c)
+          matMap(r,c) = PiiPoint<double>(c * dCos - r * dSin, c * dSin + r * dCos);
+      remapTable = PiiImage::RemapTable(matMap);
+    }
+
+    PiiMatrix<T> matImage;
+    PiiMatrix<int> matMask;
+    PiiImage::RemapTable remapTable;
+  };
+
+  class Report
+  {
+  public:
+    Report(QTextStream& out, const QStringList& kernels, int repetitions) :
+      _out(out),
+      _strCpu(cpuModel()),
+      _lstKernels(kernels),
+      _iRepetitions(repetitions),
+      _iThreads(PiiThreadPool::globalInstance()->threadCount())
+    {}
+
+    bool isSelected(const char* kernel) const
+    {
+      return _lstKernels.isEmpty() || _lstKernels.contains(kernel);
+    }
+
+    // Measures *function* sequentially and, if *parallel* is true,
+    // with all threads.
+    template <class Function> void run(const char* kernel, const char* type, int size,
+                                       const Function& function, bool parallel)
+    {
+      if (!isSelected(kernel))
+        return;
+      const qint64 iSequential = measure(kernel, type, size, 1, function);
+      if (parallel && _iThreads > 1)
+        {
+          const qint64 iParallel = measure(kernel, type, size, _iThreads, function);
+          int& iCrossover = _mapCrossovers[QString("%1\t%2").arg(kernel).arg(type)];
+          if (iParallel < iSequential && iCrossover == 0)
+            iCrossover = size;
+        }
+    }
+
+    void printCrossovers()
+    {
+      for (QMap<QString,int>::const_iterator i = _mapCrossovers.constBegin(); i != _mapCrossovers.constEnd(); ++i)
+        {
+          QStringList lstParts(i.key().split('\t'));
+          _out << "{\"cpu\":\"" << _strCpu << "\",\"kernel\":\"" << lstParts[0]
+               << "\",\"type\":\"" << lstParts[1] << "\",\"threads\":" << _iThreads
+               << ",\"crossoverSize\":";
+          if (i.value() > 0)
+            _out << i.value();
+          else
+            _out << "null";
+          _out << "}\n";
+        }
+      _out.flush();
+    }
+
+    QString cpu() const { return _strCpu; }
+
+  private:
+    template <class Function> qint64 measure(const char* kernel, const char* type, int size,
+                                             int threads, const Function& function)
+    {
+      const Pii::ParallelExecution policy(threads);
+      // The first round warms up caches and the thread pool.
+      function(policy);
+      QVector<qint64> vecTimes(_iRepetitions);
+      for (int i=0; i<_iRepetitions; ++i)
+        {
+          PiiTimer timer;
+          function(policy);
+          vecTimes[i] = timer.microseconds();
+        }
+      std::nth_element(vecTimes.begin(), vecTimes.begin() + _iRepetitions/2, vecTimes.end());
+      const qint64 iTime = vecTimes[_iRepetitions/2];
+      _out << "{\"cpu\":\"" << _strCpu << "\",\"kernel\":\"" << kernel
+           << "\",\"type\":\"" << type << "\",\"size\":" << size
+           << ",\"threads\":" << threads
+           << ",\"time\":" << iTime
+           << ",\"megapixelsPerSecond\":" << (iTime > 0 ? double(size) * size / iTime : 0.0)
+           << "}\n";
+      _out.flush();
+      return iTime;
+    }
+
+    QTextStream& _out;
+    QString _strCpu;
+    QStringList _lstKernels;
+    int _iRepetitions;
+    int _iThreads;
+    // Smallest size at which parallel execution won, or zero.
+    QMap<QString,int> _mapCrossovers;
+  };
+
+  template <class T> struct FilterKernel
+  {
+    FilterKernel(const Inputs<T>& inputs) : in(inputs) {}
+    void operator() (const Pii::ParallelExecution&) const
+    {
+      PiiImage::filter<float>(in.matImage, PiiImage::GaussianFilter, Pii::ExtendReplicate, 5);
+    }
+    const Inputs<T>& in;
+  };
+
+  template <class T> struct MedianKernel
+  {
+    MedianKernel(const Inputs<T>& inputs) : in(inputs) {}
+    void operator() (const Pii::ParallelExecution& policy) const
+    {
+      PiiImage::medianFilter(policy, in.matImage, 5);
+    }
+    const Inputs<T>& in;
+  };
+
+  template <class T> struct ErodeKernel
+  {
+    ErodeKernel(const Inputs<T>& inputs) : in(inputs) {}
+    void operator() (const Pii::ParallelExecution& policy) const
+    {
+      PiiImage::erode(policy, in.matImage, in.matMask);
+    }
+    const Inputs<T>& in;
+  };
+
+  template <class T> struct LabelingKernel
+  {
+    LabelingKernel(const Inputs<T>& inputs) : in(inputs) {}
+    void operator() (const Pii::ParallelExecution& policy) const
+    {
+      PiiImage::labelImage(policy, in.matImage, std::bind2nd(std::greater<T>(), T(128)));
+    }
+    const Inputs<T>& in;
+  };
+
+  template <class T> struct LbpKernel
+  {
+    LbpKernel(const Inputs<T>& inputs) : in(inputs) {}
+    void operator() (const Pii::ParallelExecution&) const
+    {
+      PiiLbp::basicLbp<PiiLbp::Histogram>(in.matImage);
+    }
+    const Inputs<T>& in;
+  };
+
+  template <class T> struct HistogramKernel
+  {
+    HistogramKernel(const Inputs<T>& inputs) : in(inputs) {}
+    void operator() (const Pii::ParallelExecution& policy) const
+    {
+      PiiImage::histogram(policy, in.matImage, 256);
+    }
+    const Inputs<T>& in;
+  };
+
+  template <class T> struct RemapKernel
+  {
+    RemapKernel(const Inputs<T>& inputs) : in(inputs) {}
+    void operator() (const Pii::ParallelExecution& policy) const
+    {
+      PiiImage::remap(policy, in.matImage, in.remapTable);
+    }
+    const Inputs<T>& in;
+  };
+
+  struct YcbcrKernel
+  {
+    YcbcrKernel(const PiiMatrix<PiiColor4<unsigned char> >& image) : matImage(image) {}
+    void operator() (const Pii::ParallelExecution&) const
+    {
+      PiiColors::rgbToYcbcr(matImage);
+    }
+    const PiiMatrix<PiiColor4<unsigned char> >& matImage;
+  };
+
+  struct HsvKernel
+  {
+    HsvKernel(const PiiMatrix<PiiColor4<float> >& image) : matImage(image) {}
+    void operator() (const Pii::ParallelExecution& policy) const
+    {
+      PiiColors::rgbToHsv(policy, matImage);
+    }
+    const PiiMatrix<PiiColor4<float> >& matImage;
+  };
+
+  struct FftKernel
+  {
+    FftKernel(const PiiMatrix<float>& image) : matImage(image) {}
+    void operator() (const Pii::ParallelExecution& policy) const
+    {
+      fft.forwardFft(policy, matImage);
+    }
+    const PiiMatrix<float>& matImage;
+    PiiFft<float> fft;
+  };
+
+  struct GemmKernel
+  {
+    GemmKernel(const PiiMatrix<float>& image) : matImage(image) {}
+    void operator() (const Pii::ParallelExecution& policy) const
+    {
+      PiiMatrix<float> matResult(matImage.rows(), matImage.columns());
+      Pii::multiplyMatrices(policy, matImage, matImage, matResult);
+    }
+    const PiiMatrix<float>& matImage;
+  };
+
+  template <class T> PiiMatrix<PiiColor4<T> > colorImage(const PiiMatrix<T>& gray, T scale)
+  {
+    PiiMatrix<PiiColor4<T> > matColor(PiiMatrix<PiiColor4<T> >::uninitialized(gray.rows(), gray.columns()));
+    for (int r=0; r<gray.rows(); ++r)
+      for (int c=0; c<gray.columns(); ++c)
+        {
+          const T value = gray(r,c) / scale;
+          matColor(r,c) = PiiColor4<T>(value, gray(r, gray.columns()-1-c) / scale, gray(gray.rows()-1-r, c) / scale);
+        }
+    return matColor;
+  }
+
+  // Kernels available for all pixel types.
+  template <class T> void runCommonKernels(Report& report, const char* type, int size, const Inputs<T>& in)
+  {
+    report.run("filter", type, size, FilterKernel<T>(in), false);
+    report.run("median", type, size, MedianKernel<T>(in), true);
+    report.run("erode", type, size, ErodeKernel<T>(in), true);
+    report.run("labeling", type, size, LabelingKernel<T>(in), true);
+    report.run("lbp", type, size, LbpKernel<T>(in), false);
+    report.run("remap", type, size, RemapKernel<T>(in), true);
+  }
+
+  void runKernels(Report& report, int size)
+  {
+    {
+      Inputs<unsigned char> in(size);
+      runCommonKernels(report, "uchar", size, in);
+      report.run("histogram", "uchar", size, HistogramKernel<unsigned char>(in), true);
+      if (report.isSelected("ycbcr"))
+        {
+          PiiMatrix<PiiColor4<unsigned char> > matColor(colorImage(in.matImage, (unsigned char)1));
+          report.run("ycbcr", "uchar", size, YcbcrKernel(matColor), false);
+        }
+    }
+    {
+      Inputs<float> in(size);
+      runCommonKernels(report, "float", size, in);
+      if (report.isSelected("hsv"))
+        {
+          PiiMatrix<PiiColor4<float> > matColor(colorImage(in.matImage, 255.0f));
+          report.run("hsv", "float", size, HsvKernel(matColor), true);
+        }
+      report.run("fft", "float", size, FftKernel(in.matImage), true);
+      // The cubic cost makes larger products impractical.
+      if (size <= 1024)
+        report.run("gemm", "float", size, GemmKernel(in.matImage), true);
+    }
+  }
+
+  QString fileNameFor(const QString& cpu)
+  {
+    QString strName(cpu.toLower());
+    strName.replace(QRegExp("[^a-z0-9]+"), "-");
+    return strName + ".json";
+  }
+}
+
+int main(int argc, char* argv[])
+{
+  QCoreApplication app(argc, argv);
+  QStringList lstArgs(app.arguments());
+
+  QList<int> lstSizes;
+  QStringList lstKernels;
+  int iRepetitions = 5;
+  QString strDirectory;
+  for (int i=1; i<lstArgs.size(); ++i)
+    {
+      if (lstArgs[i] == "-s" && i+1 < lstArgs.size())
+        {
+          foreach (QString strSize, lstArgs[++i].split(','))
+            if (strSize.toInt() > 0)
+              lstSizes << strSize.toInt();
+        }
+      else if (lstArgs[i] == "-k" && i+1 < lstArgs.size())
+        lstKernels << lstArgs[++i].split(',');
+      else if (lstArgs[i] == "-r" && i+1 < lstArgs.size())
+        iRepetitions = qMax(lstArgs[++i].toInt(), 1);
+      else if (lstArgs[i] == "-d" && i+1 < lstArgs.size())
+        strDirectory = lstArgs[++i];
+      else
+        {
+          std::fprintf(stderr,
+                       "Usage: %s [-s size[,size...]] [-k kernel[,kernel...]] [-r repetitions] [-d directory]\n"
+                       "Kernels: filter median erode labeling lbp remap histogram ycbcr hsv fft gemm\n",
+                       qPrintable(lstArgs[0]));
+          return 1;
+        }
+    }
+  if (lstSizes.isEmpty())
+    lstSizes << 256 << 1024 << 2048;
+  // Crossovers are searched from the smallest size up.
+  qSort(lstSizes);
+
+  QFile file;
+  if (strDirectory.isEmpty())
+    file.open(stdout, QIODevice::WriteOnly | QIODevice::Text);
+  else
+    {
+      file.setFileName(QDir(strDirectory).absoluteFilePath(fileNameFor(cpuModel())));
+      if (!file.open(QIODevice::WriteOnly | QIODevice::Text))
+        {
+          std::fprintf(stderr, "Cannot open %s for writing.\n", qPrintable(file.fileName()));
+          return 1;
+        }
+    }
+  QTextStream out(&file);
+  Report report(out, lstKernels, iRepetitions);
+  try
+    {
+      for (int i=0; i<lstSizes.size(); ++i)
+        runKernels(report, lstSizes[i]);
+    }
+  catch (PiiException& ex)
+    {
+      std::fprintf(stderr, "%s\n", qPrintable(ex.message()));
+      return 1;
+    }
+  report.printCrossovers();
+  return 0;
+}
@@ -44,4 +44,28 @@ void TestPiiKernelPerceptron::learn()
     }
 }
 
+void TestPiiKernelPerceptron::learnWithSmallCache()
+{
+  static const int iSamplesInSmallSet = 100, iRatio = 5,
+    iSampleCount = (iRatio + 1) * iSamplesInSmallSet;
+
+  PiiMatrix<double> matSamples;
+  QVector<double> vecLabels;
+  PiiClassification::createDartBoard(iSamplesInSmallSet,
+                                     iRatio * iSamplesInSmallSet,
+                                     matSamples, vecLabels);
+
+  PiiKernelPerceptron<PiiMatrix<double> > fullPerceptron, cachedPerceptron;
+  // Room for 10 rows only
+  cachedPerceptron.setCacheSize(10 * iSampleCount * sizeof(double));
+  fullPerceptron.learn(matSamples, vecLabels);
+  cachedPerceptron.learn(matSamples, vecLabels);
+
+  QVERIFY(cachedPerceptron.converged());
+  QCOMPARE(cachedPerceptron.weights(), fullPerceptron.weights());
+
+  for (int r=0; r<iSampleCount; ++r)
+    QCOMPARE(cachedPerceptron.classify(matSamples[r]), vecLabels[r]);
+}
+
 QTEST_MAIN(TestPiiKernelPerceptron)
@@ -0,0 +1,103 @@
+/* This file is part of Into.
+ * Copyright (C) Intopii 2013.
+ * All rights reserved.
+ *
+ * Licensees holding a commercial Into license may use this file in
+ * accordance with the commercial license agreement. Please see
+ * LICENSE.commercial for commercial licensing terms.
+ *
+ * Alternatively, this file may be used under the terms of the GNU
+ * Affero General Public License version 3 as published by the Free
+ * Software Foundation. In addition, Intopii gives you special rights
+ * to use Into as a part of open source software projects. Please
+ * refer to LICENSE.AGPL3 for details.
+ */
+
+#include "TestPiiLatestValue.h"
+
+#include <PiiLatestValue.h>
+#include <QtTest>
+#include <QThread>
+#include <QVector>
+
+void TestPiiLatestValue::storeAndLoad()
+{
+  PiiLatestValue<QString> value;
+  QCOMPARE(value.version(), 0);
+  QVERIFY(value.load().isNull());
+  for (int i=1; i<=10; ++i)
+    {
+      value.store(QString::number(i));
+      QCOMPARE(value.version(), i);
+      QCOMPARE(value.load(), QString::number(i));
+    }
+}
+
+namespace
+{
+  typedef PiiLatestValue<QVector<int> > VectorValue;
+
+  class Reader : public QThread
+  {
+  public:
+    Reader(VectorValue* value) : _pValue(value), _bFailed(false) {}
+
+    volatile bool bRunning;
+
+    bool failed() const { return _bFailed; }
+
+  protected:
+    void run()
+    {
+      int iPrevious = 0;
+      while (bRunning)
+        {
+          QVector<int> vec(_pValue->load());
+          // A torn copy would mix elements of two stores.
+          for (int i=1; i<vec.size(); ++i)
+            if (vec[i] != vec[0])
+              _bFailed = true;
+          if (!vec.isEmpty())
+            {
+              // Values must never go backwards.
+              if (vec[0] < iPrevious)
+                _bFailed = true;
+              iPrevious = vec[0];
+            }
+        }
+    }
+
+  private:
+    VectorValue* _pValue;
+    bool _bFailed;
+  };
+}
+
+void TestPiiLatestValue::concurrentReaders()
+{
+  VectorValue value;
+  QList<Reader*> lstReaders;
+  for (int i=0; i<4; ++i)
+    {
+      Reader* pReader = new Reader(&value);
+      pReader->bRunning = true;
+      pReader->start();
+      lstReaders << pReader;
+    }
+
+  for (int i=1; i<=20000; ++i)
+    value.store(QVector<int>(16, i));
+
+  for (int i=0; i<lstReaders.size(); ++i)
+    {
+      lstReaders[i]->bRunning = false;
+      lstReaders[i]->wait();
+      QVERIFY(!lstReaders[i]->failed());
+    }
+  qDeleteAll(lstReaders);
+
+  QCOMPARE(value.version(), 20000);
+  QCOMPARE(value.load(), QVector<int>(16, 20000));
+}
+
+QTEST_MAIN(TestPiiLatestValue)
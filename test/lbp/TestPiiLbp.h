@@ -27,6 +27,7 @@ private slots:
   void basicLbp();
   void genericLbp();
   void thresholdedLbp();
+  void fastLbp();
 
 private:
   template <class T> PiiMatrix<T> createRandomImage();
@@ -17,6 +17,7 @@
 
 #include <PiiLbp.h>
 #include <PiiMath.h>
+#include <PiiRandom.h>
 #include <PiiTypeTraits.h>
 #include <QtTest>
 
@@ -47,6 +48,54 @@ void TestPiiLbp::thresholdedLbp()
   thresholdedLbp<double>();
 }
 
+namespace
+{
+  // Not PiiImage::DefaultRoi and thus forces the generic code.
+  struct FullRoi
+  {
+    bool operator() (int, int) const { return true; }
+  };
+}
+
+void TestPiiLbp::fastLbp()
+{
+  // Odd sizes leave columns for the scalar tail of the SIMD kernels.
+  PiiMatrix<unsigned char> matImage(Pii::uniformRandomMatrix(45, 77, 0, 256));
+  PiiMatrix<unsigned char> matFlat(Pii::uniformRandomMatrix(45, 77, 0, 3));
+
+  QVERIFY(Pii::equals(PiiLbp::basicLbp<PiiLbp::Image>(matImage),
+                      PiiLbp::basicLbp<PiiLbp::Image>(matImage, FullRoi())));
+  QVERIFY(Pii::equals(PiiLbp::basicSymmetricLbp<PiiLbp::Image>(matFlat),
+                      PiiLbp::basicSymmetricLbp<PiiLbp::Image>(matFlat, FullRoi())));
+
+  const int aSamples[] = { 8, 12, 16 };
+  const double aRadii[] = { 1, 1.5, 2 };
+  for (int s=0; s<3; ++s)
+    for (int r=0; r<3; ++r)
+      for (int m=PiiLbp::Standard; m<=PiiLbp::Symmetric; ++m)
+        for (int i=0; i<2; ++i)
+          {
+            PiiLbp lbp(aSamples[s], aRadii[r], PiiLbp::Mode(m),
+                       i == 0 ? Pii::NearestNeighborInterpolation : Pii::LinearInterpolation);
+            QVERIFY(Pii::equals(lbp.genericLbp<PiiLbp::Histogram>(matImage),
+                                lbp.genericLbp<PiiLbp::Histogram>(matImage, FullRoi(),
+                                                                  Pii::Identity<unsigned char>())));
+            QVERIFY(Pii::equals(lbp.genericLbp<PiiLbp::Image>(matFlat),
+                                lbp.genericLbp<PiiLbp::Image>(matFlat, FullRoi(),
+                                                              Pii::Identity<unsigned char>())));
+          }
+
+  // Fixed-point interpolation is exact: a flat neighborhood never
+  // sets a bit, and the 8-bit kernels agree with the 16-bit template.
+  PiiLbp lbp(16, 2.5, PiiLbp::Standard, Pii::LinearInterpolation);
+  PiiMatrix<unsigned char> matConstant(20, 20);
+  matConstant = 77;
+  QCOMPARE(lbp.genericLbp<PiiLbp::Histogram>(matConstant)(0), 14*14);
+  QCOMPARE(lbp.genericLbp<PiiLbp::Histogram>(PiiMatrix<short>(matConstant))(0), 14*14);
+  QVERIFY(Pii::equals(lbp.genericLbp<PiiLbp::Image>(matImage),
+                      lbp.genericLbp<PiiLbp::Image>(PiiMatrix<unsigned short>(matImage))));
+}
+
 template <class T> PiiMatrix<T> TestPiiLbp::createRandomImage()
 {
   PiiMatrix<T> image(256, 256);
@@ -0,0 +1,42 @@
+/* This file is part of Into.
+ * Copyright (C) Intopii 2013.
+ * All rights reserved.
+ *
+ * Licensees holding a commercial Into license may use this file in
+ * accordance with the commercial license agreement. Please see
+ * LICENSE.commercial for commercial licensing terms.
+ *
+ * Alternatively, this file may be used under the terms of the GNU
+ * Affero General Public License version 3 as published by the Free
+ * Software Foundation. In addition, Intopii gives you special rights
+ * to use Into as a part of open source software projects. Please
+ * refer to LICENSE.AGPL3 for details.
+ */
+
+#include "TestPiiLoadBalancer.h"
+
+#include <QtTest>
+
+void TestPiiLoadBalancer::initTestCase()
+{
+  QVERIFY(createOperation("piiflowcontrol", "PiiLoadBalancer"));
+  operation()->setProperty("dynamicOutputCount", 3);
+  QCOMPARE(operation()->outputCount(), 4);
+}
+
+void TestPiiLoadBalancer::process()
+{
+  QVERIFY(start());
+  // Probes never queue objects, so all branches are equally loaded
+  // and the objects are distributed in turns.
+  for (int i=0; i<6; ++i)
+    {
+      QVERIFY(sendObject("input", i*10));
+      QCOMPARE(outputValue("route", -1), i % 3);
+      QCOMPARE(outputValue(QString("output%1").arg(i % 3), -1), i*10);
+      clearAllOutputValues();
+    }
+  stop();
+}
+
+QTEST_MAIN(TestPiiLoadBalancer)
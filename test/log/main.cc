@@ -0,0 +1,138 @@
+/* This file is part of Into.
+ * Copyright (C) Intopii 2013.
+ * All rights reserved.
+ *
+ * Licensees holding a commercial Into license may use this file in
+ * accordance with the commercial license agreement. Please see
+ * LICENSE.commercial for commercial licensing terms.
+ *
+ * Alternatively, this file may be used under the terms of the GNU
+ * Affero General Public License version 3 as published by the Free
+ * Software Foundation. In addition, Intopii gives you special rights
+ * to use Into as a part of open source software projects. Please
+ * refer to LICENSE.AGPL3 for details.
+ */
+
+
+#include "TestPiiLog.h"
+
+#include <QtTest>
+#include <PiiAsyncCall.h>
+#include <PiiLog.h>
+
+static QMutex messageMutex;
+static QStringList lstMessages;
+
+#if QT_VERSION < 0x050000
+static void collectMessage(QtMsgType, const char* message)
+{
+  QMutexLocker lock(&messageMutex);
+  lstMessages << message;
+}
+#else
+static void collectMessage(QtMsgType, const QMessageLogContext&, const QString& message)
+{
+  QMutexLocker lock(&messageMutex);
+  lstMessages << message;
+}
+#endif
+
+static QStringList takeMessages()
+{
+  QMutexLocker lock(&messageMutex);
+  QStringList lstResult(lstMessages);
+  lstMessages.clear();
+  return lstResult;
+}
+
+void TestPiiLog::initTestCase()
+{
+  PiiLog::setLogFormat("");
+  PiiLog::setRateLimit(0);
+#if QT_VERSION < 0x050000
+  qInstallMsgHandler(collectMessage);
+#else
+  qInstallMessageHandler(collectMessage);
+#endif
+}
+
+void TestPiiLog::cleanupTestCase()
+{
+  PiiLog::setAsynchronous(false);
+#if QT_VERSION < 0x050000
+  qInstallMsgHandler(0);
+#else
+  qInstallMessageHandler(0);
+#endif
+}
+
+void TestPiiLog::logMessages(char prefix, int count)
+{
+  for (int i=0; i<count; ++i)
+    piiWarning("%c%d", prefix, i);
+}
+
+void TestPiiLog::order()
+{
+  const int iCount = 2000;
+  // Large enough that no message is dropped even if the writer never
+  // gets a chance to run.
+  PiiLog::setQueueCapacity(iCount);
+  PiiLog::setAsynchronous(true);
+  takeMessages();
+  const int iDropped = PiiLog::droppedMessageCount();
+
+  QList<QThread*> lstThreads;
+  lstThreads << Pii::createAsyncCall(this, &TestPiiLog::logMessages, 'A', iCount)
+             << Pii::createAsyncCall(this, &TestPiiLog::logMessages, 'B', iCount);
+  for (int i=0; i<lstThreads.size(); ++i)
+    lstThreads[i]->start();
+  for (int i=0; i<lstThreads.size(); ++i)
+    QVERIFY(lstThreads[i]->wait(5000));
+  qDeleteAll(lstThreads);
+  PiiLog::setAsynchronous(false);
+
+  QCOMPARE(PiiLog::droppedMessageCount(), iDropped);
+  const QStringList lstResult(takeMessages());
+  QCOMPARE(lstResult.size(), 2 * iCount);
+  // Threads may interleave, but the messages of each thread must
+  // come out in the order they were logged.
+  int aiNext[2] = { 0, 0 };
+  for (int i=0; i<lstResult.size(); ++i)
+    {
+      const int iThread = lstResult[i].at(0) == QChar('A') ? 0 : 1;
+      QCOMPARE(lstResult[i].mid(1).toInt(), aiNext[iThread]);
+      ++aiNext[iThread];
+    }
+  QCOMPARE(aiNext[0], iCount);
+  QCOMPARE(aiNext[1], iCount);
+}
+
+void TestPiiLog::flush()
+{
+  PiiLog::setQueueCapacity(1024);
+  PiiLog::setAsynchronous(true);
+  takeMessages();
+
+  logMessages('C', 100);
+  PiiLog::flush();
+  QStringList lstResult(takeMessages());
+  QCOMPARE(lstResult.size(), 100);
+  for (int i=0; i<lstResult.size(); ++i)
+    QCOMPARE(lstResult[i], QString("C%1").arg(i));
+
+  // Turning asynchronous mode off must write out everything that is
+  // still queued.
+  logMessages('D', 100);
+  PiiLog::setAsynchronous(false);
+  lstResult = takeMessages();
+  QCOMPARE(lstResult.size(), 100);
+  for (int i=0; i<lstResult.size(); ++i)
+    QCOMPARE(lstResult[i], QString("D%1").arg(i));
+
+  // Synchronous messages go straight to the handler.
+  piiWarning("E");
+  QCOMPARE(takeMessages(), QStringList() << "E");
+}
+
+QTEST_MAIN(TestPiiLog)
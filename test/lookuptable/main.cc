@@ -0,0 +1,111 @@
+/* This file is part of Into.
+ * Copyright (C) Intopii 2013.
+ * All rights reserved.
+ *
+ * Licensees holding a commercial Into license may use this file in
+ * accordance with the commercial license agreement. Please see
+ * LICENSE.commercial for commercial licensing terms.
+ *
+ * Alternatively, this file may be used under the terms of the GNU
+ * Affero General Public License version 3 as published by the Free
+ * Software Foundation. In addition, Intopii gives you special rights
+ * to use Into as a part of open source software projects. Please
+ * refer to LICENSE.AGPL3 for details.
+ */
+
+#include "TestPiiLookupTable.h"
+
+#include <PiiYdinTypes.h>
+#include <QtTest>
+
+void TestPiiLookupTable::initTestCase()
+{
+  QVERIFY(createOperation("piibase", "PiiLookupTable"));
+  connectAllInputs();
+}
+
+void TestPiiLookupTable::indices()
+{
+  operation()->setProperty("table", QVariantList() << Pii::createQVariant(QString("zero"))
+                                                   << Pii::createQVariant(QString("one")));
+  QVERIFY(start());
+  QVERIFY(sendObject("index", 1));
+  QCOMPARE(outputValue("output0", QString()), QString("one"));
+  QVERIFY(sendObject("index", 0.5));
+  QCOMPARE(outputValue("output0", QString()), QString("zero"));
+  QVERIFY(!sendObject("index", 2));
+  stop();
+
+  operation()->setProperty("defaultValue", Pii::createQVariant(QString("none")));
+  QVERIFY(start());
+  QVERIFY(sendObject("index", -1));
+  QCOMPARE(outputValue("output0", QString()), QString("none"));
+  QVERIFY(sendObject("index", 1));
+  QCOMPARE(outputValue("output0", QString()), QString("one"));
+  stop();
+  operation()->setProperty("defaultValue", QVariant());
+}
+
+void TestPiiLookupTable::multipleLists()
+{
+  operation()->setProperty("dynamicOutputCount", 3);
+  QVariantList lstTable;
+  lstTable << QVariant(QVariantList() << Pii::createQVariant(0) << Pii::createQVariant(-1));
+  lstTable << QVariant(QVariantList() << Pii::createQVariant(QString("zero")) << Pii::createQVariant(QString("one")));
+  operation()->setProperty("table", lstTable);
+  QVERIFY(start());
+  QVERIFY(sendObject("index", 1));
+  QCOMPARE(outputValue("output0", 0), -1);
+  QCOMPARE(outputValue("output1", QString()), QString("one"));
+  // The last list is used for extra outputs.
+  QCOMPARE(outputValue("output2", QString()), QString("one"));
+  stop();
+  operation()->setProperty("dynamicOutputCount", 1);
+}
+
+void TestPiiLookupTable::keys()
+{
+  operation()->setProperty("table", QVariantList() << Pii::createQVariant(QString("ten"))
+                                                   << Pii::createQVariant(QString("low"))
+                                                   << Pii::createQVariant(QString("high"))
+                                                   << Pii::createQVariant(QString("minus")));
+  operation()->setProperty("keys", QVariantList() << 10
+                                                  << QVariant(QVariantList() << 0 << 5)
+                                                  << QVariant(QVariantList() << 5.5 << 100)
+                                                  << -3);
+  QVERIFY(start());
+  QVERIFY(sendObject("index", 10));
+  QCOMPARE(outputValue("output0", QString()), QString("ten"));
+  QVERIFY(sendObject("index", 0));
+  QCOMPARE(outputValue("output0", QString()), QString("low"));
+  QVERIFY(sendObject("index", 5.0));
+  QCOMPARE(outputValue("output0", QString()), QString("low"));
+  QVERIFY(sendObject("index", 5.5));
+  QCOMPARE(outputValue("output0", QString()), QString("high"));
+  QVERIFY(sendObject("index", 100));
+  QCOMPARE(outputValue("output0", QString()), QString("high"));
+  QVERIFY(sendObject("index", -3));
+  QCOMPARE(outputValue("output0", QString()), QString("minus"));
+  QVERIFY(!sendObject("index", 5.2));
+  stop();
+}
+
+void TestPiiLookupTable::invalidKeys()
+{
+  operation()->setProperty("table", QVariantList() << Pii::createQVariant(1) << Pii::createQVariant(2));
+  operation()->setProperty("keys", QVariantList() << 1);
+  QVERIFY(start(ExpectFail));
+  operation()->setProperty("keys", QVariantList() << 1 << 1);
+  QVERIFY(start(ExpectFail));
+  operation()->setProperty("keys", QVariantList()
+                           << QVariant(QVariantList() << 0 << 5)
+                           << QVariant(QVariantList() << 5 << 6));
+  QVERIFY(start(ExpectFail));
+  operation()->setProperty("keys", QVariantList() << QVariant(QVariantList() << 5 << 0) << 1);
+  QVERIFY(start(ExpectFail));
+  operation()->setProperty("keys", QVariantList() << QVariant(QVariantList() << 0 << 5) << 6);
+  QVERIFY(start());
+  stop();
+}
+
+QTEST_MAIN(TestPiiLookupTable)
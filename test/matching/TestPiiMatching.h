@@ -25,6 +25,9 @@ class TestPiiMatching : public QObject
 private slots:
   void boundaryDirections();
   void shapeContextDescriptor();
+  void parallelShapeContext();
+  void featurePointMatcher();
+  void binaryDescriptors();
 };
 
 
@@ -16,6 +16,9 @@
 #include "TestPiiMatching.h"
 
 #include <PiiMatching.h>
+#include <PiiFeaturePointMatcher.h>
+#include <PiiRandomLbp.h>
+#include <PiiRandom.h>
 #include <PiiMath.h>
 #include <PiiMatrixUtil.h>
 
@@ -85,4 +88,167 @@ void TestPiiMatching::shapeContextDescriptor()
   }
 }
 
+void TestPiiMatching::parallelShapeContext()
+{
+  PiiMatrix<int> matPoints(0,2);
+  for (int i=0; i<200; ++i)
+    matPoints.appendRow(Pii::round<int>(60*cos(i*M_PI/100) + 10*sin(i*M_PI/10)),
+                        Pii::round<int>(40*sin(i*M_PI/100)));
+  PiiMatrix<int> matKeyPoints(matPoints(0,0,-1,-1));
+  QVector<double> vecDistances = QVector<double>() << 25 << 100 << 400 << 1600 << 6400;
+  QVector<double> vecDirections = PiiMatching::boundaryDirections(matPoints);
+
+  PiiMatrix<float> matSerial = PiiMatching::shapeContextDescriptor(matPoints, matKeyPoints, 12,
+                                                                   vecDistances, vecDirections,
+                                                                   PiiMatching::RotationInvariant);
+  PiiMatrix<float> matParallel = PiiMatching::shapeContextDescriptor(Pii::ParallelExecution(4),
+                                                                     matPoints, matKeyPoints, 12,
+                                                                     vecDistances, vecDirections,
+                                                                     PiiMatching::RotationInvariant);
+  QCOMPARE(matParallel.rows(), 200);
+  QCOMPARE(matParallel.columns(), 60);
+  QVERIFY(Pii::equals(matSerial, matParallel));
+}
+
+namespace
+{
+  // Accepts any candidate with at least three points.
+  struct AcceptingMatcher
+  {
+    bool findBestModel(const PiiMatrix<int>& modelPoints, const PiiMatrix<int>& queryPoints)
+    {
+      vecInliers.clear();
+      for (int i=0; i<queryPoints.rows(); ++i)
+        vecInliers << i;
+      return modelPoints.rows() >= 3;
+    }
+    QVector<int> inlyingPoints() const { return vecInliers; }
+    PiiMatrix<double> bestModel() const { return PiiMatrix<double>(1,1); }
+
+    QVector<int> vecInliers;
+  };
+}
+
+void TestPiiMatching::featurePointMatcher()
+{
+  // Four models, ten points each. The features of each model are
+  // concentrated around a different mean, and each point is unique.
+  const int iModels = 4, iPointsPerModel = 10, iFeatures = 8;
+  PiiMatrix<int> matPoints(iModels * iPointsPerModel, 2);
+  PiiMatrix<float> matFeatures(iModels * iPointsPerModel, iFeatures);
+  QVector<int> vecModelIndices;
+  for (int r=0; r<matPoints.rows(); ++r)
+    {
+      const int iModel = r / iPointsPerModel;
+      matPoints(r,0) = r;
+      matPoints(r,1) = iModel;
+      for (int f=0; f<iFeatures; ++f)
+        matFeatures(r,f) = 0.5f * iModel + 0.05f * (r % iPointsPerModel) + 0.01f * f;
+      vecModelIndices << iModel;
+    }
+
+  // Query = points of model 2, slightly distorted.
+  PiiMatrix<int> matQueryPoints(matPoints(2 * iPointsPerModel, 0, iPointsPerModel, -1));
+  PiiMatrix<float> matQueryFeatures(matFeatures(2 * iPointsPerModel, 0, iPointsPerModel, -1));
+  matQueryFeatures += 0.01f;
+
+  AcceptingMatcher matcher;
+  PiiFeaturePointMatcher<int, PiiMatrix<float> > pointMatcher;
+  pointMatcher.setMatchingMode(PiiMatching::MatchDifferentModels);
+  pointMatcher.buildDatabase(matPoints, matFeatures, vecModelIndices);
+
+  PiiMatching::MatchList lstMatches = pointMatcher.findMatchingModels(matQueryPoints, matQueryFeatures, matcher);
+  QCOMPARE(lstMatches.size(), 1);
+  QCOMPARE(lstMatches[0].modelIndex(), 2);
+  QCOMPARE(lstMatches[0].matchedPointCount(), iPointsPerModel);
+  for (int i=0; i<iPointsPerModel; ++i)
+    QCOMPARE(lstMatches[0].matchedPoints()[i].second, 2 * iPointsPerModel + i);
+
+  // The pre-filter retains just the right model.
+  pointMatcher.setModelPrefilterCount(1);
+  lstMatches = pointMatcher.findMatchingModels(Pii::ParallelExecution(3), matQueryPoints, matQueryFeatures, matcher);
+  QCOMPARE(lstMatches.size(), 1);
+  QCOMPARE(lstMatches[0].modelIndex(), 2);
+  QCOMPARE(lstMatches[0].matchedPointCount(), iPointsPerModel);
+
+  // Compact storage
+  pointMatcher.setCompactFeatures(true);
+  pointMatcher.buildDatabase(matPoints, matFeatures, vecModelIndices);
+  QVERIFY(pointMatcher.modelFeatures().isEmpty());
+  lstMatches = pointMatcher.findMatchingModels(Pii::ParallelExecution(2), matQueryPoints, matQueryFeatures, matcher);
+  QCOMPARE(lstMatches.size(), 1);
+  QCOMPARE(lstMatches[0].modelIndex(), 2);
+  for (int i=0; i<iPointsPerModel; ++i)
+    QCOMPARE(lstMatches[0].matchedPoints()[i].second, 2 * iPointsPerModel + i);
+}
+
+void TestPiiMatching::binaryDescriptors()
+{
+  Pii::seedRandom(5);
+  PiiMatrix<int> matImage(Pii::uniformRandomMatrix(64, 64) * 255);
+  PiiRandomLbp lbp;
+  lbp.setParameters(16, 8, 15);
+  QCOMPARE(lbp.descriptorLength(), 4);
+
+  // The descriptor stores the same comparisons as the histogram.
+  PiiMatrix<int> matWindow(matImage(11, 13, 15, 15));
+  unsigned int aDescriptor[4];
+  lbp.binaryDescriptor(aDescriptor, matWindow);
+  PiiMatrix<int> matHistogram(1, 16 * 256);
+  lbp.updateHistogram(matHistogram[0], matWindow);
+  for (int iPattern=0; iPattern<16; ++iPattern)
+    {
+      int iCode = 0;
+      for (int iPair=0; iPair<8; ++iPair)
+        {
+          const int iBit = iPattern * 8 + iPair;
+          iCode |= int((aDescriptor[iBit / 32] >> (iBit % 32)) & 1) << (7 - iPair);
+        }
+      QCOMPARE(matHistogram(0, iPattern * 256 + iCode), 1);
+    }
+
+  // Two models on a grid of key points. The last point is too close
+  // to the border.
+  const int iPoints = 40;
+  PiiMatrix<int> matKeyPoints(iPoints + 1, 2);
+  QVector<int> vecModelIndices;
+  for (int i=0; i<iPoints; ++i)
+    {
+      matKeyPoints(i,0) = 8 + (i % 8) * 6;
+      matKeyPoints(i,1) = 8 + (i / 8) * 10;
+      vecModelIndices << i * 2 / iPoints;
+    }
+  matKeyPoints(iPoints,0) = 2;
+  matKeyPoints(iPoints,1) = 30;
+  PiiMatrix<unsigned int> matDescriptors(lbp.binaryDescriptors(matImage, matKeyPoints));
+  QCOMPARE(matDescriptors.rows(), iPoints + 1);
+  QCOMPARE(matDescriptors.columns(), 4);
+  for (int i=0; i<4; ++i)
+    {
+      // Key point 10 is at (20, 18).
+      QCOMPARE(matDescriptors(10,i), aDescriptor[i]);
+      QCOMPARE(matDescriptors(iPoints,i), 0u);
+    }
+
+  // Query = the points of model 1 with one bit flipped in each.
+  const int iQueryStart = iPoints / 2;
+  PiiMatrix<int> matQueryPoints(matKeyPoints(iQueryStart, 0, iPoints / 2, -1));
+  PiiMatrix<unsigned int> matQueryDescriptors(matDescriptors(iQueryStart, 0, iPoints / 2, -1));
+  for (int i=0; i<matQueryDescriptors.rows(); ++i)
+    matQueryDescriptors(i, i % 4) ^= 1u << i;
+
+  AcceptingMatcher matcher;
+  PiiFeaturePointMatcher<int, PiiMatrix<unsigned int> > pointMatcher;
+  pointMatcher.setMatchingMode(PiiMatching::MatchDifferentModels);
+  pointMatcher.buildDatabase(matKeyPoints(0, 0, iPoints, -1), matDescriptors(0, 0, iPoints, -1),
+                             vecModelIndices, 0,
+                             new PiiDistanceMeasure<const unsigned int*>::Impl<PiiHammingDistance<const unsigned int*> >);
+  PiiMatching::MatchList lstMatches = pointMatcher.findMatchingModels(matQueryPoints, matQueryDescriptors, matcher);
+  QCOMPARE(lstMatches.size(), 1);
+  QCOMPARE(lstMatches[0].modelIndex(), 1);
+  QCOMPARE(lstMatches[0].matchedPointCount(), iPoints / 2);
+  for (int i=0; i<iPoints / 2; ++i)
+    QCOMPARE(lstMatches[0].matchedPoints()[i].second, iQueryStart + i);
+}
+
 QTEST_MAIN(TestPiiMatching)
@@ -31,6 +31,7 @@ private slots:
   void divide();
   void atan2();
   void fastAtan2();
+  void fastMath();
   void normalize();
   void combinations();
   void permutations();
@@ -57,6 +58,7 @@ private slots:
   void pivot();
   void norm();
   void multiply();
+  void matrixProduct();
   void multiplied();
   void minMax();
   void mean();
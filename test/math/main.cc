@@ -27,6 +27,7 @@ using std::endl;
 #include <PiiMatrixUtil.h>
 #include <PiiPseudoInverse.h>
 #include <PiiMath.h>
+#include <PiiParallel.h>
 #include <QtTest>
 #include <algorithm>
 #include <PiiVector.h>
@@ -197,6 +198,41 @@ void TestPiiMath::fastAtan2()
   QVERIFY(maxDiff < 4.1f/180.0f*M_PI);
 }
 
+void TestPiiMath::fastMath()
+{
+  double dMaxExp = 0, dMaxLog = 0, dMaxSin = 0, dMaxCos = 0;
+  for (double x=-700; x<700; x+=0.37)
+    dMaxExp = qMax(dMaxExp, Pii::abs(Pii::fastExp(x) / std::exp(x) - 1));
+  for (double x=1e-300; x<1e300; x*=1.7)
+    dMaxLog = qMax(dMaxLog, Pii::abs(Pii::fastLog(x) - std::log(x)) / qMax(1.0, Pii::abs(std::log(x))));
+  for (double x=-1000; x<1000; x+=0.013)
+    {
+      dMaxSin = qMax(dMaxSin, Pii::abs(Pii::fastSin(x) - std::sin(x)));
+      dMaxCos = qMax(dMaxCos, Pii::abs(Pii::fastCos(x) - std::cos(x)));
+    }
+  QVERIFY(dMaxExp < 1e-15);
+  QVERIFY(dMaxLog < 1e-15);
+  QVERIFY(dMaxSin < 1e-15);
+  QVERIFY(dMaxCos < 1e-15);
+
+  float fMaxExp = 0, fMaxSin = 0;
+  for (float x=-80; x<80; x+=0.11f)
+    fMaxExp = qMax(fMaxExp, Pii::abs(Pii::fastExp(x) / expf(x) - 1));
+  for (float x=-100; x<100; x+=0.013f)
+    fMaxSin = qMax(fMaxSin, Pii::abs(Pii::fastSin(x) - sinf(x)));
+  QVERIFY(fMaxExp < 1e-6f);
+  QVERIFY(fMaxSin < 1e-6f);
+
+  QCOMPARE(Pii::fastExp(-100.0f), 0.0f);
+  QVERIFY(Pii::isInf(Pii::fastExp(1000.0)));
+  QCOMPARE(Pii::fastLog(0.0), -std::numeric_limits<double>::infinity());
+  QVERIFY(Pii::isNan(Pii::fastLog(-1.0f)));
+
+  PiiMatrix<float> mat(2,3, 0.0, 0.5, 1.0, 2.0, -1.0, -3.0);
+  QVERIFY(Pii::almostEqual(PiiMatrix<float>(Pii::fastExp(mat)), PiiMatrix<float>(Pii::exp(mat)), 1e-6f));
+  QVERIFY(Pii::almostEqual(PiiMatrix<float>(Pii::fastSin(mat)), PiiMatrix<float>(Pii::sin(mat)), 1e-6f));
+}
+
 void TestPiiMath::normalize()
 {
   PiiMatrix<double> vector(1,4, 1.0, 2.0, -4.0, 1.5);
@@ -425,6 +461,25 @@ void TestPiiMath::sum()
   QCOMPARE(Pii::sum<int>(input), 0);
   QVERIFY(Pii::equals(Pii::sum<int>(input,Pii::Vertically), PiiMatrix<int>(1,2)));
   QVERIFY(Pii::equals(Pii::sum<int>(input,Pii::Horizontally), PiiMatrix<int>(2,1,3,-3)));
+
+  {
+    // Pairwise summation keeps the error small even with floats.
+    PiiMatrix<float> mat(3, 100001, 0.1f);
+    QVERIFY(Pii::abs(Pii::sum<float>(mat) - 30000.3f) < 0.1f);
+  }
+  {
+    PiiMatrix<int> mat(3,3,
+                       4, -2, 7,
+                       1, 0, 3,
+                       -5, 9, 2);
+    Pii::SummaryStatistics<int,double> stats(Pii::summaryStatistics<double>(mat));
+    QCOMPARE(stats.minimum, -5);
+    QCOMPARE(stats.maximum, 9);
+    QCOMPARE(stats.sum, 19.0);
+    QCOMPARE(stats.sumOfSquares, 189.0);
+    QCOMPARE(stats.count, qint64(9));
+    QVERIFY(Pii::abs(stats.var() - Pii::var<double>(mat)) < 1e-10);
+  }
 }
 
 void TestPiiMath::sqrt()
@@ -818,6 +873,44 @@ void TestPiiMath::multiply()
   }
 }
 
+void TestPiiMath::matrixProduct()
+{
+  // Small integers make the floating-point results exact. Products
+  // of int matrices are calculated with the simple algorithm and
+  // serve as a reference.
+  PiiMatrix<int> matA(260, 130), matB(130, 260);
+  for (int r=0; r<matA.rows(); ++r)
+    for (int c=0; c<matA.columns(); ++c)
+      matA(r,c) = (r*7 + c*3) % 11 - 5;
+  for (int r=0; r<matB.rows(); ++r)
+    for (int c=0; c<matB.columns(); ++c)
+      matB(r,c) = (r*5 + c) % 9 - 4;
+  const PiiMatrix<int> matExpected(matA * matB);
+
+  {
+    PiiMatrix<double> matResult(PiiMatrix<double>(matA) * PiiMatrix<double>(matB));
+    QVERIFY(Pii::equals(PiiMatrix<int>(matResult), matExpected));
+  }
+  {
+    // Expressions are evaluated before multiplication.
+    PiiMatrix<float> matResult(PiiMatrix<float>(matA) * Pii::transpose(PiiMatrix<float>(Pii::transpose(matB))));
+    QVERIFY(Pii::equals(PiiMatrix<int>(matResult), matExpected));
+  }
+  {
+    PiiMatrix<double> matResult(PiiMatrix<double>::uninitialized(matA.rows(), matB.columns()));
+    Pii::multiplyMatrices(Pii::ParallelExecution(3), PiiMatrix<double>(matA), PiiMatrix<double>(matB), matResult);
+    QVERIFY(Pii::equals(PiiMatrix<int>(matResult), matExpected));
+  }
+  {
+    // Matrix times a column vector and a row vector times a matrix
+    PiiMatrix<int> matColumn(matB(0,0,-1,1)), matRow(matA(0,0,1,-1));
+    PiiMatrix<float> matResult(PiiMatrix<float>(matA) * PiiMatrix<float>(matColumn));
+    QVERIFY(Pii::equals(PiiMatrix<int>(matResult), PiiMatrix<int>(matA * matColumn)));
+    matResult = PiiMatrix<float>(matRow) * PiiMatrix<float>(matB);
+    QVERIFY(Pii::equals(PiiMatrix<int>(matResult), PiiMatrix<int>(matRow * matB)));
+  }
+}
+
 void TestPiiMath::multiplied()
 {
   const PiiMatrix<int> mat1(2,3, -4, 6, 2,
@@ -842,6 +935,19 @@ void TestPiiMath::minMax()
   QCOMPARE( minC, 2 );
   QCOMPARE( maxR, 1 );
   QCOMPARE( maxC, 0 );
+
+  // First occurrence wins.
+  PiiMatrix<int> mat2(3,3,
+                      1, 7, 7,
+                      0, 2, 0,
+                      7, 0, 3);
+  Pii::minMax(mat2, &min, &max, &minR, &minC, &maxR, &maxC);
+  QCOMPARE( min, 0 );
+  QCOMPARE( max, 7 );
+  QCOMPARE( minR, 1 );
+  QCOMPARE( minC, 0 );
+  QCOMPARE( maxR, 0 );
+  QCOMPARE( maxC, 1 );
 }
 
 void TestPiiMath::mean()
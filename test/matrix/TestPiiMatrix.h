@@ -43,6 +43,9 @@ private slots:
   void reserve();
   void mapped();
   void map();
+  void pool();
+  void threadConfinement();
+  void contiguousAlgorithms();
 
 private:
   template <class Matrix> void setTo(Matrix& matrix, typename Matrix::value_type value);
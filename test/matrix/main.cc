@@ -34,6 +34,8 @@ template <class T> void showMatrix(const PiiMatrix<T>& mat)
     }
 }
 
+static void countRelease(void* counter) { ++*static_cast<int*>(counter); }
+
 void TestPiiMatrix::constructors()
 {
   {
@@ -93,6 +95,23 @@ void TestPiiMatrix::constructors()
     PiiMatrix<double> mat2(2, 4, data, Pii::RetainOwnership);
     QCOMPARE(mat2(1,3), 1.0);
   }
+  {
+    int values[] = { 1, 2, 3, 4 };
+    int iReleased = 0;
+    {
+      PiiMatrix<int> mat1(2, 2, values, countRelease, &iReleased);
+      PiiMatrix<int> mat2(mat1);
+      mat1 = PiiMatrix<int>();
+      QCOMPARE(iReleased, 0);
+      QCOMPARE(mat2(1,1), 4);
+      // Immutable: modification makes a deep copy and releases the
+      // buffer.
+      mat2(1,1) = 5;
+      QCOMPARE(values[3], 4);
+      QCOMPARE(iReleased, 1);
+    }
+    QCOMPARE(iReleased, 1);
+  }
   {
     // Leave padding to the right
     PiiMatrix<float> mat(PiiMatrix<float>::padded(2, 2, 4*sizeof(float)));
@@ -614,6 +633,26 @@ void TestPiiMatrix::selfAssignment()
                                         0, 4, 3, 4,
                                         1, 5, 7, 8)));
   */
+
+  // Element-wise expressions are evaluated in place.
+  a = PiiMatrix<int>(2, 2, 1, 2, 3, 4);
+  const int* pData = a.constRowBegin(0);
+  a = a*2 + 1;
+  QCOMPARE(a.constRowBegin(0), pData);
+  QVERIFY(Pii::equals(a, PiiMatrix<int>(2, 2, 3, 5, 7, 9)));
+
+  // Reading the same data in another order needs a temporary.
+  a = Pii::transpose(a);
+  QVERIFY(Pii::equals(a, PiiMatrix<int>(2, 2, 3, 7, 5, 9)));
+  a = Pii::transpose(a) - a;
+  QVERIFY(Pii::equals(a, PiiMatrix<int>(2, 2, 0, -2, 2, 0)));
+
+  // Shared data is not copied before being overwritten.
+  PiiMatrix<int> d(a);
+  a = d + 1;
+  QVERIFY(a.constRowBegin(0) != d.constRowBegin(0));
+  QVERIFY(Pii::equals(d, PiiMatrix<int>(2, 2, 0, -2, 2, 0)));
+  QVERIFY(Pii::equals(a, PiiMatrix<int>(2, 2, 1, -1, 3, 1)));
 }
 
 void TestPiiMatrix::iterators()
@@ -777,6 +816,159 @@ void TestPiiMatrix::alignment()
   QCOMPARE(long(mat1[0]) & 0x3, 0l);
   QCOMPARE(long(mat2[0]) & 0x3, 0l);
   QCOMPARE(long(mat3[0]) & 0x3, 0l);
+
+  PiiMatrix<float> mat4(PiiMatrix<float>::aligned(5, 641, 32));
+  QCOMPARE(mat4.stride(), size_t(2592));
+  for (int r=0; r<mat4.rows(); ++r)
+    QCOMPARE(long(mat4[r]) & 0x1f, 0l);
+  mat4(4,640) = 1;
+  // Reallocation must retain alignment and contents.
+  for (int i=0; i<32; ++i)
+    mat4.appendRow();
+  QCOMPARE(long(mat4[0]) & 0x1f, 0l);
+  QCOMPARE(mat4(4,640), 1.0f);
+  mat4.insertColumn(3);
+  QCOMPARE(long(mat4[1]) & 0x1f, 0l);
+  QCOMPARE(mat4.stride() & 0x1f, size_t(0));
+
+  PiiMatrixData::setDefaultAlignment(64);
+  PiiMatrix<char> mat5(3,3);
+  PiiMatrixData::setDefaultAlignment(0);
+  QCOMPARE(mat5.stride(), size_t(64));
+  QCOMPARE(long(mat5[2]) & 0x3f, 0l);
+  QCOMPARE(PiiMatrix<char>(3,3).stride(), size_t(4));
+}
+
+void TestPiiMatrix::pool()
+{
+  PiiMatrixData::setPoolCapacity(16 << 20);
+  PiiMatrixData::PoolStatistics stats = PiiMatrixData::poolStatistics();
+  QCOMPARE(stats.retainedBytes, size_t(0));
+  for (int i=0; i<10; ++i)
+    {
+      PiiMatrix<unsigned char> mat(PiiMatrix<unsigned char>::uninitialized(1024, 2048));
+      mat(1023,2047) = 1;
+    }
+  stats = PiiMatrixData::poolStatistics();
+  QCOMPARE(stats.misses, size_t(1));
+  QCOMPARE(stats.hits, size_t(9));
+  QVERIFY(stats.retainedBytes >= size_t(1024*2048));
+
+  // Too small to be pooled
+  PiiMatrix<int> small(3,3);
+  small = PiiMatrix<int>(4,4);
+  QCOMPARE(PiiMatrixData::poolStatistics().misses, size_t(1));
+
+  PiiMatrixData::setPoolCapacity(0);
+  QCOMPARE(PiiMatrixData::poolStatistics().retainedBytes, size_t(0));
+}
+
+void TestPiiMatrix::threadConfinement()
+{
+  PiiMatrix<int> mat(2, 2, 1, 2, 3, 4);
+  QVERIFY(!mat.isThreadConfined());
+  {
+    PiiMatrix<int> copy(mat);
+    // Other references exist.
+    QVERIFY(!mat.confineToThread());
+  }
+  QVERIFY(mat.confineToThread());
+  QVERIFY(mat.isThreadConfined());
+
+  {
+    PiiMatrix<int> copy1(mat), copy2(copy1);
+    QVERIFY(copy2.isThreadConfined());
+    // Detaching keeps the new data confined.
+    copy2(0,0) = 5;
+    QVERIFY(copy2.isThreadConfined());
+    QCOMPARE(mat(0,0), 1);
+    // So do references to a confined matrix.
+    PiiMatrix<int> row(copy1(0,0,1,2));
+    QVERIFY(row.isThreadConfined());
+    QCOMPARE(row(0,1), 2);
+
+    // Sharing the reference unconfines the source as well.
+    Pii::ThreadSharing<PiiMatrix<int> >::share(row);
+    QVERIFY(!row.isThreadConfined());
+    QVERIFY(!mat.isThreadConfined());
+    QVERIFY(copy2.isThreadConfined());
+  }
+  // All references are gone.
+  PiiMatrix<int> copy(mat);
+  copy(1,1) = 0;
+  QCOMPARE(mat(1,1), 4);
+
+  // Null data is shared by all empty matrices.
+  PiiMatrix<int> empty;
+  QVERIFY(!empty.confineToThread());
+}
+
+struct Summer
+{
+  Summer() : iSum(0) {}
+  void operator() (int value) { iSum += value; }
+  int iSum;
+};
+
+void TestPiiMatrix::contiguousAlgorithms()
+{
+  PiiMatrix<int> mat(3, 4,
+                     1, 2, 3, 4,
+                     5, 6, 7, 8,
+                     9, 10, 11, 12);
+  QVERIFY(Pii::FlatIterator<PiiMatrix<int>::iterator>::isFlat(mat.begin()));
+  QCOMPARE(Pii::forEach(mat.begin(), mat.end(), Summer()).iSum, 78);
+  QCOMPARE(Pii::accumulate(mat.begin(), mat.end(), std::plus<int>(), 0), 78);
+
+  // Padded rows are processed one segment at a time.
+  int aPadded[3*5];
+  for (int i=0; i<15; ++i)
+    aPadded[i] = i;
+  PiiMatrix<int> padded(3, 4, aPadded, Pii::RetainOwnership, 5 * sizeof(int));
+  QVERIFY(!Pii::FlatIterator<PiiMatrix<int>::iterator>::isFlat(padded.begin()));
+  padded << mat;
+  QVERIFY(Pii::equals(padded, mat));
+  QCOMPARE(aPadded[4], 4);
+  padded += 1;
+  QCOMPARE(aPadded[9], 9);
+  QCOMPARE(padded(2,3), 13);
+  Pii::mapMatrixIf(padded, std::bind2nd(std::greater<int>(), 10), std::negate<int>());
+  QVERIFY(Pii::equals(padded, PiiMatrix<int>(3, 4,
+                                             2, 3, 4, 5,
+                                             6, 7, 8, 9,
+                                             10, -11, -12, -13)));
+  QCOMPARE(aPadded[14], 14);
+
+  // Submatrices are flat only if they span full rows.
+  PiiSubmatrix<PiiMatrix<int> > sub(mat(1,1,2,2));
+  QVERIFY(!Pii::FlatIterator<PiiSubmatrix<PiiMatrix<int> >::iterator>::isFlat(sub.begin()));
+  sub = 0;
+  QVERIFY(Pii::equals(mat, PiiMatrix<int>(3, 4,
+                                          1, 2, 3, 4,
+                                          5, 0, 0, 8,
+                                          9, 0, 0, 12)));
+  PiiSubmatrix<PiiMatrix<int> > rows(mat(1,0,2,-1));
+  QVERIFY(Pii::FlatIterator<PiiSubmatrix<PiiMatrix<int> >::iterator>::isFlat(rows.begin()));
+  rows += PiiMatrix<int>(2, 4,
+                         1, 1, 1, 1,
+                         2, 2, 2, 2);
+  QVERIFY(Pii::equals(mat, PiiMatrix<int>(3, 4,
+                                          1, 2, 3, 4,
+                                          6, 1, 1, 9,
+                                          11, 2, 2, 14)));
+
+  // Filtered matrices
+  PiiMatrix<bool> filter(3, 4,
+                         1, 0, 0, 1,
+                         0, 1, 0, 0,
+                         0, 0, 1, 1);
+  PiiFilteredMatrix<PiiMatrix<int>, PiiMatrix<bool> > filtered(Pii::filteredMatrix(mat, filter));
+  QCOMPARE(Pii::accumulate(filtered.begin(), filtered.end(), std::plus<int>(), 0), 1 + 4 + 1 + 2 + 14);
+  filtered = -1;
+  QVERIFY(Pii::equals(mat, PiiMatrix<int>(3, 4,
+                                          -1, 2, 3, -1,
+                                          6, -1, 1, 9,
+                                          11, 2, -1, -1)));
 }
 
 void TestPiiMatrix::multiply()
@@ -37,7 +37,14 @@ void TestPiiMatrixComposer::process()
   QVERIFY(!hasOutputValue());
   QVERIFY(sendObject("input3", 6));
 
-  QVERIFY(Pii::equals(outputValue("output", PiiMatrix<int>()),PiiMatrix<int>(1,4, 1, 5, 0, 6)));
+  PiiMatrix<int> matFirst(outputValue("output", PiiMatrix<int>()));
+  QVERIFY(Pii::equals(matFirst, PiiMatrix<int>(1,4, 1, 5, 0, 6)));
+
+  // Each emitted matrix is independent of the next one.
+  QVERIFY(sendObject("input1", 7));
+  QVERIFY(sendObject("input3", 8));
+  QVERIFY(Pii::equals(outputValue("output", PiiMatrix<int>()),PiiMatrix<int>(1,4, 1, 7, 0, 8)));
+  QVERIFY(Pii::equals(matFirst, PiiMatrix<int>(1,4, 1, 5, 0, 6)));
 }
 
 
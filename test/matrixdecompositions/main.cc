@@ -303,4 +303,44 @@ void TestPiiMatrixDecompositions::svDecompose()
   }
 }
 
+void TestPiiMatrixDecompositions::truncatedSvDecompose()
+{
+  // A 300-by-80 matrix of rank 6
+  PiiMatrix<double> mat(Pii::normalRandomMatrix(300, 6) * Pii::normalRandomMatrix(6, 80));
+  PiiMatrix<double> matFullS(Pii::svDecompose(mat, 0, 0));
+
+  {
+    PiiMatrix<double> U, V;
+    PiiMatrix<double> S(Pii::truncatedSvDecompose(mat, 4, &U, &V));
+    QCOMPARE(S.columns(), 4);
+    QCOMPARE(U.rows(), 300);
+    QCOMPARE(U.columns(), 4);
+    QCOMPARE(V.rows(), 80);
+    QCOMPARE(V.columns(), 4);
+    QVERIFY(Pii::almostEqual(S, PiiMatrix<double>(matFullS(0,0,1,4)), 1e-8 * matFullS(0,0)));
+    QVERIFY(Pii::almostEqual(PiiMatrix<double>(Pii::transpose(U) * U), PiiMatrix<double>::identity(4), 1e-10));
+    QVERIFY(Pii::almostEqual(PiiMatrix<double>(Pii::transpose(V) * V), PiiMatrix<double>::identity(4), 1e-10));
+  }
+
+  {
+    // The rank is reached, so the decomposition is exact.
+    PiiMatrix<double> U, V;
+    PiiMatrix<double> S(Pii::truncatedSvDecompose(mat, 6, &U, &V));
+    PiiMatrix<double> matS(6,6);
+    Pii::setDiagonal(matS, S[0]);
+    QVERIFY(Pii::almostEqual(mat, U*matS*Pii::transpose(V), 1e-8 * matFullS(0,0)));
+  }
+
+  {
+    // The whole range is sampled; falls back to full SVD.
+    PiiMatrix<double> small(4,3,
+                            1.0, -1.0, 0.0,
+                            -2.0, -3.0, 1.0,
+                            0.0, 1.0, 2.0,
+                            -1.0, 1.0, -1.0);
+    PiiMatrix<double> S(Pii::truncatedSvDecompose(small, 2));
+    QVERIFY(Pii::almostEqual(S, PiiMatrix<double>(Pii::svDecompose(small, 0, 0)(0,0,1,2)), 1e-12));
+  }
+}
+
 QTEST_MAIN(TestPiiMatrixDecompositions)
@@ -0,0 +1,108 @@
+/* This file is part of Into.
+ * Copyright (C) Intopii 2013.
+ * All rights reserved.
+ *
+ * Licensees holding a commercial Into license may use this file in
+ * accordance with the commercial license agreement. Please see
+ * LICENSE.commercial for commercial licensing terms.
+ *
+ * Alternatively, this file may be used under the terms of the GNU
+ * Affero General Public License version 3 as published by the Free
+ * Software Foundation. In addition, Intopii gives you special rights
+ * to use Into as a part of open source software projects. Please
+ * refer to LICENSE.AGPL3 for details.
+ */
+
+#include "TestPiiMemoryPool.h"
+
+#include <PiiMemoryPool.h>
+#include <PiiVariant.h>
+#include <QtTest>
+
+void TestPiiMemoryPool::sizeClasses()
+{
+  PiiMemoryPool pool(100, 4096);
+  QCOMPARE(pool.classCount(), 4);
+  QCOMPARE(pool.maxBlockSize(), std::size_t(128 - sizeof(void*)));
+  for (int i=0; i<pool.classCount(); ++i)
+    QCOMPARE(pool.sizeClass(i)->blockSize(), std::size_t((16 << i) - sizeof(void*)));
+
+  PiiMemoryPool pool2(1, 1024);
+  QCOMPARE(pool2.classCount(), 1);
+}
+
+void TestPiiMemoryPool::allocation()
+{
+  PiiMemoryPool pool(100, 4096, 0);
+  QVERIFY(!pool.allocate(0));
+  QVERIFY(!pool.allocate(pool.maxBlockSize() + 1));
+
+  // Each request goes to the smallest class that fits.
+  for (std::size_t i=1; i<=pool.maxBlockSize(); ++i)
+    {
+      void* pBuffer = pool.allocate(i);
+      QVERIFY(pBuffer != 0);
+      QCOMPARE(long(pBuffer) & 0xf, 0l);
+      int iClass = 0;
+      while (pool.sizeClass(iClass)->blockSize() < i)
+        ++iClass;
+      QVERIFY(pool.sizeClass(iClass)->deallocate(pBuffer));
+    }
+
+  int iValue;
+  QVERIFY(!pool.deallocate(&iValue));
+  QVERIFY(pool.deallocate(0));
+
+  // The largest class gets full, others still have space.
+  ulong ulCount = 0;
+  while (pool.allocate(pool.maxBlockSize()) != 0)
+    ++ulCount;
+  QCOMPARE(ulCount, pool.sizeClass(pool.classCount()-1)->blockCount());
+  void* pBuffer = pool.allocate(1);
+  QVERIFY(pBuffer != 0);
+  QVERIFY(pool.deallocate(pBuffer));
+}
+
+struct LargeType
+{
+  template <class Archive> void serialize(Archive&, const unsigned int) {}
+
+  LargeType(int value = 0) { for (int i=0; i<8; ++i) aValues[i] = value; }
+  bool operator== (const LargeType& other) const
+  {
+    return std::memcmp(aValues, other.aValues, sizeof(aValues)) == 0;
+  }
+  double aValues[8];
+};
+
+PII_DECLARE_VARIANT_TYPE(LargeType, 0x666);
+PII_REGISTER_VARIANT_TYPE(LargeType);
+
+void TestPiiMemoryPool::variantStorage()
+{
+  PiiVariant varBefore(LargeType(1));
+  PiiMemoryPool* pPool = new PiiMemoryPool(128, 65536);
+  PiiVariant::setMemoryPool(pPool);
+  QCOMPARE(PiiVariant::memoryPool(), pPool);
+  // Only the first call has an effect.
+  PiiVariant::setMemoryPool(0);
+  QCOMPARE(PiiVariant::memoryPool(), pPool);
+
+  {
+    PiiVariant varAfter(LargeType(2));
+    PiiVariant varCopy(varAfter);
+    PiiVariant varOld(varBefore);
+    QVERIFY(varCopy.valueAs<LargeType>() == LargeType(2));
+    QVERIFY(varOld.valueAs<LargeType>() == LargeType(1));
+    // Objects created before the pool was set are released with
+    // delete.
+    varBefore = PiiVariant();
+  }
+  // Pool blocks were returned.
+  ulong ulCount = 0;
+  while (pPool->allocate(sizeof(LargeType)) != 0)
+    ++ulCount;
+  QCOMPARE(ulCount, pPool->sizeClass(3)->blockCount());
+}
+
+QTEST_MAIN(TestPiiMemoryPool)
@@ -0,0 +1,60 @@
+/* This file is part of Into.
+ * Copyright (C) Intopii 2013.
+ * All rights reserved.
+ *
+ * Licensees holding a commercial Into license may use this file in
+ * accordance with the commercial license agreement. Please see
+ * LICENSE.commercial for commercial licensing terms.
+ *
+ * Alternatively, this file may be used under the terms of the GNU
+ * Affero General Public License version 3 as published by the Free
+ * Software Foundation. In addition, Intopii gives you special rights
+ * to use Into as a part of open source software projects. Please
+ * refer to LICENSE.AGPL3 for details.
+ */
+
+#include "TestPiiMovingAverageOperation.h"
+#include <PiiMatrix.h>
+#include <QtTest>
+
+void TestPiiMovingAverageOperation::initTestCase()
+{
+  QVERIFY(createOperation("piibase", "PiiMovingAverageOperation"));
+  connectAllInputs();
+}
+
+void TestPiiMovingAverageOperation::constantImages_data()
+{
+  QTest::addColumn<int>("windowSize");
+  QTest::newRow("41") << 41;
+  QTest::newRow("47") << 47;
+  QTest::newRow("55") << 55;
+  QTest::newRow("64") << 64;
+}
+
+void TestPiiMovingAverageOperation::constantImages()
+{
+  QFETCH(int, windowSize);
+  QVERIFY(operation()->setProperty("windowSize", windowSize));
+  QVERIFY(operation()->setProperty("forceInputType", true));
+
+  // The average of identical integer images must reproduce the
+  // input exactly at every fill level of the window.
+  for (int iLevel=0; iLevel<256; ++iLevel)
+    {
+      QVERIFY(start());
+      PiiMatrix<unsigned char> matImage(3, 5);
+      matImage = (unsigned char)iLevel;
+      for (int i=0; i<windowSize+1; ++i)
+        {
+          QVERIFY(sendObject("input", matImage));
+          PiiMatrix<unsigned char> matAverage(outputValue("average", PiiMatrix<unsigned char>()));
+          if (!Pii::equals(matAverage, matImage))
+            QFAIL(qPrintable(QString("Level %1 became %2 after %3 frames.")
+                             .arg(iLevel).arg(matAverage.rows() > 0 ? int(matAverage(0,0)) : -1).arg(i+1)));
+        }
+      QVERIFY(stop());
+    }
+}
+
+QTEST_MAIN(TestPiiMovingAverageOperation)
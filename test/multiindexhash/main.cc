@@ -0,0 +1,131 @@
+/* This file is part of Into.
+ * Copyright (C) Intopii 2013.
+ * All rights reserved.
+ *
+ * Licensees holding a commercial Into license may use this file in
+ * accordance with the commercial license agreement. Please see
+ * LICENSE.commercial for commercial licensing terms.
+ *
+ * Alternatively, this file may be used under the terms of the GNU
+ * Affero General Public License version 3 as published by the Free
+ * Software Foundation. In addition, Intopii gives you special rights
+ * to use Into as a part of open source software projects. Please
+ * refer to LICENSE.AGPL3 for details.
+ */
+
+#include "TestPiiMultiIndexHash.h"
+#include <PiiMultiIndexHash.h>
+#include <PiiDistanceKernels.h>
+#include <PiiRandom.h>
+
+#include <QtTest>
+#include <algorithm>
+
+static int randomInt(int max)
+{
+  return qMin(int(Pii::uniformRandom(0, max)), max - 1);
+}
+
+static PiiMatrix<unsigned int> randomCodes(int rows, int columns)
+{
+  PiiMatrix<unsigned int> matCodes(rows, columns);
+  for (int r=0; r<rows; ++r)
+    for (int c=0; c<columns; ++c)
+      matCodes(r,c) = (unsigned(randomInt(65536)) << 16) | unsigned(randomInt(65536));
+  return matCodes;
+}
+
+void TestPiiMultiIndexHash::buildIndex()
+{
+  PiiMultiIndexHash index;
+  QVERIFY(index.isEmpty());
+  QCOMPARE(index.findClosestMatches(0, 1).size(), 0);
+
+  PiiMatrix<unsigned int> matCodes(randomCodes(1000, 4));
+  index.buildIndex(matCodes);
+  QVERIFY(!index.isEmpty());
+  QCOMPARE(index.codeCount(), 1000);
+  QCOMPARE(index.wordCount(), 4);
+  // 128 bits, about 10 bits per substring
+  QCOMPARE(index.substringCount(), 13);
+
+  // Substrings cannot be longer than 32 bits or shorter than one.
+  index.buildIndex(matCodes, 1);
+  QCOMPARE(index.substringCount(), 4);
+  index.buildIndex(matCodes, 1000);
+  QCOMPARE(index.substringCount(), 128);
+
+  // Every code is closest to itself.
+  for (int i=0; i<matCodes.rows(); i += 50)
+    {
+      PiiClassification::MatchList lstMatches = index.findClosestMatches(matCodes[i], 1);
+      QCOMPARE(lstMatches.size(), 1);
+      QCOMPARE(lstMatches[0].first, 0.0);
+      QCOMPARE(lstMatches[0].second, i);
+    }
+
+  PiiMultiIndexHash copy(index);
+  copy.buildIndex(PiiMatrix<unsigned int>());
+  QVERIFY(copy.isEmpty());
+  QCOMPARE(index.codeCount(), 1000);
+}
+
+void TestPiiMultiIndexHash::findClosestMatches_data()
+{
+  QTest::addColumn<int>("codes");
+  QTest::addColumn<int>("words");
+  QTest::addColumn<int>("substrings");
+
+  QTest::newRow("single") << 1 << 2 << 0;
+  QTest::newRow("32 bits") << 500 << 1 << 0;
+  QTest::newRow("256 bits") << 2000 << 8 << 0;
+  QTest::newRow("long substrings") << 2000 << 2 << 2;
+  QTest::newRow("short substrings") << 300 << 2 << 32;
+}
+
+void TestPiiMultiIndexHash::findClosestMatches()
+{
+  QFETCH(int, codes);
+  QFETCH(int, words);
+  QFETCH(int, substrings);
+
+  Pii::seedRandom(codes);
+  PiiMatrix<unsigned int> matCodes(randomCodes(codes, words));
+  PiiMultiIndexHash index;
+  index.buildIndex(matCodes, substrings);
+
+  QVector<unsigned int> vecQuery(words);
+  for (int q=0; q<30; ++q)
+    {
+      // Distort a random code by flipping some of its bits.
+      const int iSource = randomInt(codes);
+      for (int w=0; w<words; ++w)
+        vecQuery[w] = matCodes(iSource, w);
+      for (int i=randomInt(words * 8); i>0; --i)
+        vecQuery[randomInt(words)] ^= 1u << randomInt(32);
+
+      const int iCount = 1 + q % 5, iMaxDistance = q % 3 == 0 ? q % 17 : -1;
+      PiiClassification::MatchList lstMatches = index.findClosestMatches(vecQuery.constData(),
+                                                                         iCount, iMaxDistance);
+      QVector<double> vecExpected;
+      for (int i=0; i<codes; ++i)
+        {
+          const double dDistance = PiiClassification::hammingDistance(vecQuery.constData(), matCodes[i],
+                                                                       words, INFINITY);
+          if (iMaxDistance < 0 || dDistance <= iMaxDistance)
+            vecExpected << dDistance;
+        }
+      std::sort(vecExpected.begin(), vecExpected.end());
+
+      QCOMPARE(lstMatches.size(), qMin(iCount, vecExpected.size()));
+      for (int i=0; i<lstMatches.size(); ++i)
+        {
+          QCOMPARE(lstMatches[i].first, vecExpected[i]);
+          QCOMPARE(PiiClassification::hammingDistance(vecQuery.constData(), matCodes[lstMatches[i].second],
+                                                      words, INFINITY),
+                   lstMatches[i].first);
+        }
+    }
+}
+
+QTEST_MAIN(TestPiiMultiIndexHash)
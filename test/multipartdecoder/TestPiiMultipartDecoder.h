@@ -25,6 +25,7 @@ class TestPiiMultipartDecoder : public QObject
 private slots:
   void nestedMultiparts();
   void prefetchedHeader();
+  void partialBoundaries();
 };
 
 
@@ -116,4 +116,47 @@ X-URI: empty\r\n\
     }
 }
 
+void TestPiiMultipartDecoder::partialBoundaries()
+{
+  // Bodies with embedded dashes and prefixes of the boundary.
+  QByteArray aFirst("a-b--AaB0--AaB03-");
+  aFirst.append(QByteArray(5000, '-'));
+  aFirst.append("--AaB03");
+  QByteArray aMessage("Content-Type: multipart/mixed; boundary=AaB03x\r\n\r\n"
+                      "--AaB03x\r\nContent-Type: text/plain\r\n\r\n");
+  aMessage.append(aFirst);
+  aMessage.append("--AaB03x\r\nContent-Type: text/plain\r\n\r\n"
+                  "skipped--AaB03\r\n"
+                  "--AaB03x\r\nContent-Type: text/plain\r\n\r\n"
+                  "last\r\n"
+                  "--AaB03x--\r\n");
+  QBuffer bfr(&aMessage);
+  bfr.open(QIODevice::ReadOnly);
+  PiiMultipartDecoder decoder(&bfr);
+
+  try
+    {
+      QVERIFY(decoder.nextMessage());
+      // Read in chunks shorter than the boundary.
+      QByteArray aBody;
+      char buffer[3];
+      qint64 iBytesRead;
+      while ((iBytesRead = decoder.read(buffer, sizeof(buffer))) > 0)
+        aBody.append(buffer, iBytesRead);
+      QCOMPARE(aBody, aFirst);
+
+      QVERIFY(decoder.nextMessage());
+      QCOMPARE(decoder.skipBody(), qint64(16));
+
+      QVERIFY(decoder.nextMessage());
+      QCOMPARE(decoder.readAll(), QByteArray("last\r\n"));
+
+      QVERIFY(!decoder.nextMessage());
+    }
+  catch (PiiException& ex)
+    {
+      QFAIL(qPrintable(ex.location() + ": " + ex.message()));
+    }
+}
+
 QTEST_MAIN(TestPiiMultipartDecoder)
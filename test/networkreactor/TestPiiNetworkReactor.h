@@ -0,0 +1,53 @@
+/* This file is part of Into.
+ * Copyright (C) Intopii 2013.
+ * All rights reserved.
+ *
+ * Licensees holding a commercial Into license may use this file in
+ * accordance with the commercial license agreement. Please see
+ * LICENSE.commercial for commercial licensing terms.
+ *
+ * Alternatively, this file may be used under the terms of the GNU
+ * Affero General Public License version 3 as published by the Free
+ * Software Foundation. In addition, Intopii gives you special rights
+ * to use Into as a part of open source software projects. Please
+ * refer to LICENSE.AGPL3 for details.
+ */
+
+
+#ifndef _TESTPIINETWORKREACTOR_H
+#define _TESTPIINETWORKREACTOR_H
+
+#include <QObject>
+#include <QMutex>
+#include <QList>
+#include <PiiNetworkReactor.h>
+#include <PiiWaitCondition.h>
+
+class TestPiiNetworkReactor : public QObject, public PiiNetworkReactor::Listener
+{
+  Q_OBJECT
+
+public:
+  TestPiiNetworkReactor();
+
+  void descriptorReady(int descriptor);
+  void descriptorExpired(int descriptor);
+
+private slots:
+  void init();
+  void cleanup();
+  void registration();
+  void dispatch();
+  void unregistration();
+  void expiration();
+
+private:
+  bool waitForEvent(int timeout = 5000);
+
+  QMutex _mutex;
+  QList<int> _lstReady, _lstExpired;
+  PiiWaitCondition _eventCondition;
+  int _aSockets[2];
+};
+
+#endif //_TESTPIINETWORKREACTOR_H
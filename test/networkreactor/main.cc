@@ -0,0 +1,173 @@
+/* This file is part of Into.
+ * Copyright (C) Intopii 2013.
+ * All rights reserved.
+ *
+ * Licensees holding a commercial Into license may use this file in
+ * accordance with the commercial license agreement. Please see
+ * LICENSE.commercial for commercial licensing terms.
+ *
+ * Alternatively, this file may be used under the terms of the GNU
+ * Affero General Public License version 3 as published by the Free
+ * Software Foundation. In addition, Intopii gives you special rights
+ * to use Into as a part of open source software projects. Please
+ * refer to LICENSE.AGPL3 for details.
+ */
+
+
+#include "TestPiiNetworkReactor.h"
+
+#include <QtTest>
+#include <PiiSynchronized.h>
+
+#ifndef Q_OS_WIN
+#  include <sys/socket.h>
+#  include <unistd.h>
+#  define REACTOR_SKIP
+#elif QT_VERSION < 0x050000
+#  define REACTOR_SKIP QSKIP("PiiNetworkReactor is not supported on Windows", SkipAll)
+#else
+#  define REACTOR_SKIP QSKIP("PiiNetworkReactor is not supported on Windows")
+#endif
+
+TestPiiNetworkReactor::TestPiiNetworkReactor() :
+  _eventCondition(PiiWaitCondition::Queue)
+{
+  _aSockets[0] = _aSockets[1] = -1;
+}
+
+void TestPiiNetworkReactor::descriptorReady(int descriptor)
+{
+  synchronized (_mutex) _lstReady << descriptor;
+  _eventCondition.wakeOne();
+}
+
+void TestPiiNetworkReactor::descriptorExpired(int descriptor)
+{
+  synchronized (_mutex) _lstExpired << descriptor;
+  _eventCondition.wakeOne();
+}
+
+bool TestPiiNetworkReactor::waitForEvent(int timeout)
+{
+  return _eventCondition.wait(timeout);
+}
+
+void TestPiiNetworkReactor::init()
+{
+  REACTOR_SKIP;
+#ifndef Q_OS_WIN
+  QVERIFY(::socketpair(AF_UNIX, SOCK_STREAM, 0, _aSockets) == 0);
+#endif
+  _lstReady.clear();
+  _lstExpired.clear();
+  while (_eventCondition.wait(0)) ;
+}
+
+void TestPiiNetworkReactor::cleanup()
+{
+#ifndef Q_OS_WIN
+  for (int i=0; i<2; ++i)
+    if (_aSockets[i] != -1)
+      ::close(_aSockets[i]);
+#endif
+  _aSockets[0] = _aSockets[1] = -1;
+}
+
+void TestPiiNetworkReactor::registration()
+{
+  PiiNetworkReactor reactor(this);
+  QVERIFY(!reactor.isRunning());
+  // Nothing can be watched before the reactor runs.
+  QVERIFY(!reactor.watch(_aSockets[0]));
+  QCOMPARE(reactor.count(), 0);
+
+  QVERIFY(reactor.start());
+  QVERIFY(reactor.isRunning());
+  QVERIFY(reactor.watch(_aSockets[0]));
+  QVERIFY(reactor.watch(_aSockets[1]));
+  // Re-arming a watched descriptor doesn't add it twice.
+  QVERIFY(reactor.watch(_aSockets[0]));
+  QCOMPARE(reactor.count(), 2);
+
+  // The caller gets back whatever was still watched.
+  QList<int> lstRemaining(reactor.stop());
+  qSort(lstRemaining);
+  QList<int> lstExpected;
+  lstExpected << qMin(_aSockets[0], _aSockets[1]) << qMax(_aSockets[0], _aSockets[1]);
+  QCOMPARE(lstRemaining, lstExpected);
+  QVERIFY(!reactor.isRunning());
+  QCOMPARE(reactor.count(), 0);
+  QVERIFY(_lstReady.isEmpty());
+}
+
+void TestPiiNetworkReactor::dispatch()
+{
+#ifndef Q_OS_WIN
+  PiiNetworkReactor reactor(this);
+  QVERIFY(reactor.start());
+  QVERIFY(reactor.watch(_aSockets[0]));
+
+  QCOMPARE(::write(_aSockets[1], "x", 1), ssize_t(1));
+  QVERIFY(waitForEvent());
+  QCOMPARE(_lstReady, QList<int>() << _aSockets[0]);
+  // Reported descriptors are no longer watched.
+  QCOMPARE(reactor.count(), 0);
+
+  // One-shot: unread data doesn't cause a second report until the
+  // descriptor is re-armed.
+  QVERIFY(!waitForEvent(200));
+  QVERIFY(reactor.watch(_aSockets[0]));
+  QVERIFY(waitForEvent());
+  QCOMPARE(_lstReady, QList<int>() << _aSockets[0] << _aSockets[0]);
+
+  char c;
+  QCOMPARE(::read(_aSockets[0], &c, 1), ssize_t(1));
+  QVERIFY(reactor.watch(_aSockets[0]));
+  QVERIFY(!waitForEvent(200));
+
+  // A closed peer is reported as ready.
+  ::close(_aSockets[1]);
+  _aSockets[1] = -1;
+  QVERIFY(waitForEvent());
+  QCOMPARE(_lstReady.size(), 3);
+  QVERIFY(_lstExpired.isEmpty());
+  QVERIFY(reactor.stop().isEmpty());
+#endif
+}
+
+void TestPiiNetworkReactor::unregistration()
+{
+#ifndef Q_OS_WIN
+  PiiNetworkReactor reactor(this);
+  QVERIFY(reactor.start());
+  QVERIFY(reactor.watch(_aSockets[0]));
+  reactor.unwatch(_aSockets[0]);
+  QCOMPARE(reactor.count(), 0);
+
+  QCOMPARE(::write(_aSockets[1], "x", 1), ssize_t(1));
+  QVERIFY(!waitForEvent(200));
+  QVERIFY(_lstReady.isEmpty());
+
+  // Unwatching a reported descriptor must also work.
+  QVERIFY(reactor.watch(_aSockets[0]));
+  QVERIFY(waitForEvent());
+  reactor.unwatch(_aSockets[0]);
+  QVERIFY(reactor.stop().isEmpty());
+#endif
+}
+
+void TestPiiNetworkReactor::expiration()
+{
+  PiiNetworkReactor reactor(this);
+  reactor.setMaxIdleTime(100);
+  QCOMPARE(reactor.maxIdleTime(), 100);
+  QVERIFY(reactor.start());
+  QVERIFY(reactor.watch(_aSockets[0]));
+  QVERIFY(waitForEvent());
+  QCOMPARE(_lstExpired, QList<int>() << _aSockets[0]);
+  QVERIFY(_lstReady.isEmpty());
+  QCOMPARE(reactor.count(), 0);
+  QVERIFY(reactor.stop().isEmpty());
+}
+
+QTEST_MAIN(TestPiiNetworkReactor)
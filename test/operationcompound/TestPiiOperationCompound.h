@@ -33,6 +33,7 @@ private slots:
   void addRemoveDetachChild();
   void proxyInnerSockets();
   void disabledOperations();
+  void applyConfiguration();
   void cleanupTestCase();
 
 private:
@@ -314,6 +314,64 @@ void TestPiiOperationCompound::disabledOperations()
   QCOMPARE(e->activityMode(), PiiOperation::Disabled);
 }
 
+void TestPiiOperationCompound::applyConfiguration()
+{
+  PiiOperationCompound current, config;
+  /* current: a - b   c
+   * config:  a - c - d
+   */
+  TestOperation* a = new TestOperation;
+  TestOperation* b = new TestOperation;
+  TestOperation* c = new TestOperation;
+  a->setObjectName("a");
+  b->setObjectName("b");
+  c->setObjectName("c");
+  current.addOperation(a);
+  current.addOperation(b);
+  current.addOperation(c);
+  a->setProperty("value", 1);
+  c->setProperty("value", 3);
+  a->connectOutput("output", b, "input");
+
+  TestOperation* a2 = new TestOperation;
+  TestOperation* c2 = new TestOperation;
+  TestOperation* d2 = new TestOperation;
+  a2->setObjectName("a");
+  c2->setObjectName("c");
+  d2->setObjectName("d");
+  config.addOperation(a2);
+  config.addOperation(c2);
+  config.addOperation(d2);
+  a2->setProperty("value", 2);
+  c2->setProperty("value", 3);
+  a2->connectOutput("output", c2, "input");
+  c2->connectOutput("output", d2, "input");
+
+  current.applyConfiguration(&config);
+
+  QCOMPARE(current.childCount(), 3);
+  QVERIFY(current.childOperation("a") == a);
+  QVERIFY(current.childOperation("b") == 0);
+  QVERIFY(current.childOperation("c") == c);
+  QVERIFY(current.childOperation("d") == d2);
+  QCOMPARE(config.childCount(), 2);
+  QCOMPARE(a->property("value").toInt(), 2);
+  QCOMPARE(c->property("value").toInt(), 3);
+  QCOMPARE(a->output("output")->connectedInputs(), QList<PiiAbstractInputSocket*>() << c->input("input"));
+  QCOMPARE(c->output("output")->connectedInputs(), QList<PiiAbstractInputSocket*>() << d2->input("input"));
+  QVERIFY(c2->output("output")->connectedInputs().isEmpty());
+
+  // Exposed sockets cannot be changed incrementally.
+  config.createInputProxy("input");
+  try
+    {
+      current.applyConfiguration(&config);
+      QFAIL("PiiExecutionException was not thrown.");
+    }
+  catch (PiiExecutionException&) {}
+  QCOMPARE(current.childCount(), 3);
+}
+
 void TestPiiOperationCompound::cleanupTestCase()
 {
   setOperation(0);
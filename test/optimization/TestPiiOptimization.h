@@ -27,6 +27,7 @@ class TestPiiOptimization : public QObject
 private slots:
   void bfgsMinimize();
   void lmMinimize();
+  void lmMinimizeParallel();
   void assign();
 };
 
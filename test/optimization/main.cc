@@ -26,6 +26,7 @@
 #include <PiiMatrixUtil.h>
 #include <PiiRandom.h>
 #include <iostream>
+#include <cmath>
 
 void TestPiiOptimization::bfgsMinimize()
 {
@@ -72,6 +73,56 @@ void TestPiiOptimization::lmMinimize()
   QCOMPARE(residuals(2)+1, 1.0);
 }
 
+namespace
+{
+  // Fits y = a * exp(b * t) + c to noisy samples.
+  class ExponentialFunction : public PiiOptimization::ResidualFunction<double>
+  {
+  public:
+    ExponentialFunction(int count) : _vecT(count), _vecY(count)
+    {
+      for (int i=0; i<count; ++i)
+        {
+          _vecT[i] = i * 0.05;
+          _vecY[i] = 3.0 * std::exp(-1.5 * _vecT[i]) + 0.5 + Pii::uniformRandom(-0.01, 0.01);
+        }
+    }
+
+    int functionCount() const { return _vecT.size(); }
+    void residualValues(const double* params, double* residuals) const
+    {
+      for (int i=0; i<_vecT.size(); ++i)
+        residuals[i] = _vecY[i] - (params[0] * std::exp(params[1] * _vecT[i]) + params[2]);
+    }
+
+  private:
+    QVector<double> _vecT, _vecY;
+  };
+}
+
+void TestPiiOptimization::lmMinimizeParallel()
+{
+  {
+    TestMarquardtFunction func;
+    PiiMatrix<double> initialParams(1,3, 1.0, -1.0, 2.0);
+    PiiMatrix<double> result = PiiOptimization::lmMinimize(Pii::ParallelExecution(), &func, initialParams);
+    QVERIFY(Pii::equals(result, PiiOptimization::lmMinimize(&func, initialParams)));
+    QCOMPARE(result(0),2.0);
+    QCOMPARE(result(1),-5.0);
+    QCOMPARE(result(2),4.0);
+  }
+  {
+    // More functions than parameters
+    ExponentialFunction func(100);
+    PiiMatrix<double> initialParams(1,3, 1.0, -1.0, 0.0);
+    PiiMatrix<double> result = PiiOptimization::lmMinimize(Pii::ParallelExecution(3), &func, initialParams);
+    QVERIFY(Pii::equals(result, PiiOptimization::lmMinimize(&func, initialParams)));
+    QVERIFY(Pii::abs(result(0) - 3.0) < 0.05);
+    QVERIFY(Pii::abs(result(1) + 1.5) < 0.05);
+    QVERIFY(Pii::abs(result(2) - 0.5) < 0.05);
+  }
+}
+
 void TestPiiOptimization::assign()
 {
   PiiMatrix<int> matCost(4, 4,
@@ -0,0 +1,60 @@
+/* This file is part of Into.
+ * Copyright (C) Intopii 2013.
+ * All rights reserved.
+ *
+ * Licensees holding a commercial Into license may use this file in
+ * accordance with the commercial license agreement. Please see
+ * LICENSE.commercial for commercial licensing terms.
+ *
+ * Alternatively, this file may be used under the terms of the GNU
+ * Affero General Public License version 3 as published by the Free
+ * Software Foundation. In addition, Intopii gives you special rights
+ * to use Into as a part of open source software projects. Please
+ * refer to LICENSE.AGPL3 for details.
+ */
+
+#include "TestPiiOrderedMerger.h"
+
+#include <QtTest>
+
+void TestPiiOrderedMerger::initTestCase()
+{
+  QVERIFY(createOperation("piiflowcontrol", "PiiOrderedMerger"));
+  operation()->setProperty("dynamicInputCount", 2);
+  QCOMPARE(operation()->inputCount(), 3);
+}
+
+void TestPiiOrderedMerger::process()
+{
+  QVERIFY(start());
+
+  QVERIFY(sendObject("route", 0));
+  QVERIFY(sendObject("route", 1));
+  QVERIFY(sendObject("route", 0));
+  // Branch 1 finishes first and must wait.
+  QVERIFY(sendObject("input1", 2));
+  QVERIFY(!hasOutputValue());
+  QVERIFY(sendObject("input0", 1));
+  QCOMPARE(outputValue("output", -1), 2);
+  clearAllOutputValues();
+  QVERIFY(sendObject("input0", 3));
+  QCOMPARE(outputValue("output", -1), 3);
+  clearAllOutputValues();
+
+  // Objects may also arrive before their route.
+  QVERIFY(sendObject("input1", 4));
+  QVERIFY(!hasOutputValue());
+  QVERIFY(sendObject("route", 1));
+  QCOMPARE(outputValue("output", -1), 4);
+
+  stop();
+}
+
+void TestPiiOrderedMerger::invalidRoute()
+{
+  QVERIFY(start());
+  QVERIFY(!sendObject("route", 2));
+  stop();
+}
+
+QTEST_MAIN(TestPiiOrderedMerger)
@@ -27,19 +27,27 @@ public:
 
 protected slots:
   void count(const PiiVariant& obj, PiiProbeInput* sender);
+  void countBatch(const PiiVariantList& objects, PiiProbeInput* sender);
+  void update(const PiiVariant& obj);
 
 private slots:
   void tryToReceive();
   void savedObject();
   void discardControlObjects();
   void signalInterval();
+  void batchSize();
+  void subscribe();
 
 private:
   void sendNumbers();
   void send(const PiiVariant& obj);
+  bool waitForUpdate(int value);
 
   PiiProbeInput* _pProbe;
   int _iCount;
+  int _iUpdates;
+  PiiVariant _varUpdated;
+  QList<int> _lstBatchSizes;
   PiiVariant _varSaved;
 };
 
@@ -23,7 +23,8 @@
 
 TestPiiProbeInput::TestPiiProbeInput() :
   _pProbe(new PiiProbeInput("")),
-  _iCount(0)
+  _iCount(0),
+  _iUpdates(0)
 {
   connect(_pProbe, SIGNAL(objectReceived(PiiVariant,PiiProbeInput*)),
           SLOT(count(PiiVariant,PiiProbeInput*)), Qt::DirectConnection);
@@ -93,6 +94,90 @@ void TestPiiProbeInput::signalInterval()
   QCOMPARE(_varSaved.convertTo<int>(), 2);
 }
 
+void TestPiiProbeInput::batchSize()
+{
+  connect(_pProbe, SIGNAL(objectsReceived(PiiVariantList,PiiProbeInput*)),
+          SLOT(countBatch(PiiVariantList,PiiProbeInput*)), Qt::DirectConnection);
+  _iCount = 0;
+  _pProbe->setDiscardControlObjects(false);
+  _pProbe->setBatchSize(3);
+  for (int i=0; i<7; ++i)
+    send(PiiVariant(i));
+  QCOMPARE(_iCount, 0);
+  QCOMPARE(_lstBatchSizes, QList<int>() << 3 << 3);
+  QCOMPARE(_varSaved.convertTo<int>(), 5);
+  // Stop tag flushes the pending object and itself.
+  send(PiiYdin::createStopTag());
+  QCOMPARE(_lstBatchSizes, QList<int>() << 3 << 3 << 2);
+  QCOMPARE(_varSaved.type(), uint(PiiYdin::StopTagType));
+
+  _lstBatchSizes.clear();
+  send(PiiVariant(1));
+  _pProbe->flushBatch();
+  QCOMPARE(_lstBatchSizes, QList<int>() << 1);
+  _pProbe->flushBatch();
+  QCOMPARE(_lstBatchSizes.size(), 1);
+
+  _pProbe->setDiscardControlObjects(true);
+  send(PiiVariant(2));
+  send(PiiYdin::createStopTag());
+  QCOMPARE(_lstBatchSizes, QList<int>() << 1 << 1);
+  QCOMPARE(_varSaved.convertTo<int>(), 2);
+
+  _pProbe->setBatchSize(0);
+  _pProbe->setSignalInterval(0);
+  send(PiiVariant(3));
+  QCOMPARE(_iCount, 1);
+}
+
+void TestPiiProbeInput::subscribe()
+{
+  QVERIFY(!_pProbe->subscribe(this, SLOT(noSuchSlot())));
+  // The interval is long enough not to expire during the test.
+  QVERIFY(_pProbe->subscribe(this, SLOT(update(PiiVariant)), 600000));
+  // The current object is delivered first.
+  QCoreApplication::processEvents();
+  QCOMPARE(_iUpdates, 1);
+  QCOMPARE(_varUpdated.convertTo<int>(), 3);
+
+  // Objects received within the interval are coalesced.
+  for (int i=0; i<100; ++i)
+    send(PiiVariant(i));
+  QCoreApplication::processEvents();
+  QCOMPARE(_iUpdates, 1);
+  _pProbe->unsubscribe(this);
+
+  // With a short interval, the latest object arrives once the
+  // interval has passed.
+  QVERIFY(_pProbe->subscribe(this, SLOT(update(PiiVariant)), 50));
+  QVERIFY(waitForUpdate(99));
+  for (int i=100; i<200; ++i)
+    send(PiiVariant(i));
+  QVERIFY(waitForUpdate(199));
+
+  // Polling works without a subscription.
+  _pProbe->unsubscribe(this);
+  const int iFinalUpdates = _iUpdates;
+  send(PiiVariant(200));
+  QCoreApplication::processEvents();
+  QCOMPARE(_iUpdates, iFinalUpdates);
+  QCOMPARE(_pProbe->savedObject().convertTo<int>(), 200);
+}
+
+bool TestPiiProbeInput::waitForUpdate(int value)
+{
+  // Generous enough for a heavily loaded machine.
+  PiiTimer timer;
+  while (!_varUpdated.isValid() || _varUpdated.convertTo<int>() != value)
+    {
+      if (timer.milliseconds() > 10000)
+        return false;
+      QCoreApplication::processEvents();
+      PiiDelay::msleep(1);
+    }
+  return true;
+}
+
 void TestPiiProbeInput::sendNumbers()
 {
   for (int i=0; i<1000000; ++i)
@@ -105,4 +190,16 @@ void TestPiiProbeInput::count(const PiiVariant& obj, PiiProbeInput*)
   ++_iCount;
 }
 
+void TestPiiProbeInput::countBatch(const PiiVariantList& objects, PiiProbeInput*)
+{
+  _varSaved = objects.last();
+  _lstBatchSizes << objects.size();
+}
+
+void TestPiiProbeInput::update(const PiiVariant& obj)
+{
+  _varUpdated = obj;
+  ++_iUpdates;
+}
+
 QTEST_MAIN(TestPiiProbeInput)
@@ -0,0 +1,181 @@
+/* This file is part of Into.
+ * Copyright (C) Intopii 2013.
+ * All rights reserved.
+ *
+ * Licensees holding a commercial Into license may use this file in
+ * accordance with the commercial license agreement. Please see
+ * LICENSE.commercial for commercial licensing terms.
+ *
+ * Alternatively, this file may be used under the terms of the GNU
+ * Affero General Public License version 3 as published by the Free
+ * Software Foundation. In addition, Intopii gives you special rights
+ * to use Into as a part of open source software projects. Please
+ * refer to LICENSE.AGPL3 for details.
+ */
+
+#include "TestPiiProductQuantizer.h"
+#include <PiiProductQuantizer.h>
+#include <PiiVectorQuantizer.h>
+#include <PiiRandom.h>
+
+#include <QtTest>
+
+static PiiMatrix<float> clusteredSamples(const PiiMatrix<float>& centers, int count)
+{
+  PiiMatrix<float> matSamples(count, centers.columns());
+  for (int r=0; r<count; ++r)
+    {
+      const float* pCenter = centers[r % centers.rows()];
+      for (int c=0; c<centers.columns(); ++c)
+        matSamples(r,c) = float(pCenter[c] + 0.05 * Pii::normalRandom());
+    }
+  return matSamples;
+}
+
+void TestPiiProductQuantizer::train()
+{
+  PiiMatrix<int> matModels(4, 5,
+                           1, 2, 3, 4, 5,
+                           0, 0, 0, 0, 0,
+                           5, 4, 3, 2, 1,
+                           1, 0, 1, 0, 1);
+  PiiProductQuantizer<PiiMatrix<int> > quantizer;
+  QVERIFY(quantizer.isEmpty());
+  quantizer.train(matModels, 2);
+  QVERIFY(!quantizer.isEmpty());
+  QCOMPARE(quantizer.featureCount(), 5);
+  QCOMPARE(quantizer.subspaceCount(), 2);
+  // Less samples than centroids: samples are used as such.
+  QCOMPARE(quantizer.centroidCount(), 4);
+  QCOMPARE(quantizer.subspaceStart(1), 2);
+  QCOMPARE(quantizer.subspaceLength(0), 2);
+  QCOMPARE(quantizer.subspaceLength(1), 3);
+  QCOMPARE(quantizer.codeCount(), 0);
+
+  quantizer.encode(matModels);
+  QCOMPARE(quantizer.codeCount(), 4);
+  QCOMPARE(quantizer.codes().columns(), 2);
+  PiiMatrix<int> matDecoded(1, 5);
+  for (int i=0; i<4; ++i)
+    {
+      quantizer.decode(i, matDecoded[0]);
+      QVERIFY(Pii::equals(matDecoded, matModels(i,0,1,-1)));
+    }
+
+  PiiSquaredGeometricDistance<const int*> measure;
+  PiiMatrix<int> matSample(1, 5, 1, 1, 1, 1, 1);
+  PiiMatrix<double> matTable(quantizer.distanceTable(matSample[0], measure));
+  QCOMPARE(matTable.rows(), 2);
+  QCOMPARE(matTable.columns(), 4);
+  for (int i=0; i<4; ++i)
+    QCOMPARE(quantizer.distance(matTable, i), measure(matSample[0], matModels[i], 5));
+  double dDistance = 0;
+  QCOMPARE(quantizer.findClosestMatch(matSample[0], measure, &dDistance), 3);
+  QCOMPARE(dDistance, 2.0);
+
+  // Shared data must be detached on modification.
+  PiiProductQuantizer<PiiMatrix<int> > copy(quantizer);
+  copy.encode(matModels(0,0,2,-1));
+  QCOMPARE(copy.codeCount(), 2);
+  QCOMPARE(quantizer.codeCount(), 4);
+
+  quantizer.train(PiiMatrix<int>(), 2);
+  QVERIFY(quantizer.isEmpty());
+  QCOMPARE(quantizer.findClosestMatch(matSample[0], measure), -1);
+}
+
+void TestPiiProductQuantizer::findClosestMatches()
+{
+  Pii::seedRandom(1);
+  PiiMatrix<float> matCenters(Pii::uniformRandomMatrix(64, 16));
+  PiiMatrix<float> matModels(clusteredSamples(matCenters, 2000));
+
+  PiiProductQuantizer<PiiMatrix<float> > quantizer;
+  quantizer.train(matModels, 4, 64);
+  QCOMPARE(quantizer.centroidCount(), 64);
+  quantizer.encode(Pii::ParallelExecution(), matModels);
+  QCOMPARE(quantizer.codeCount(), 2000);
+
+  PiiProductQuantizer<PiiMatrix<float> > sequential(quantizer);
+  sequential.encode(matModels);
+  QVERIFY(Pii::equals(sequential.codes(), quantizer.codes()));
+
+  // Decoded vectors must be close to the originals.
+  PiiMatrix<float> matDecoded(1, 16);
+  PiiSquaredGeometricDistance<const float*> measure;
+  double dError = 0;
+  for (int i=0; i<matModels.rows(); ++i)
+    {
+      quantizer.decode(i, matDecoded[0]);
+      dError += measure(matDecoded[0], matModels[i], 16);
+    }
+  QVERIFY(dError / matModels.rows() < 0.2);
+
+  PiiMatrix<float> matQueries(clusteredSamples(matCenters, 100));
+  int iHits = 0;
+  for (int i=0; i<matQueries.rows(); ++i)
+    {
+      int iExact = PiiClassification::findClosestMatch(matQueries[i], matModels, measure);
+      PiiClassification::MatchList lstMatches = quantizer.findClosestMatches(matQueries[i], measure, 50);
+      QCOMPARE(lstMatches.size(), 50);
+      for (int j=1; j<lstMatches.size(); ++j)
+        QVERIFY(lstMatches[j-1].first <= lstMatches[j].first);
+      for (int j=0; j<lstMatches.size(); ++j)
+        if (lstMatches[j].second == iExact)
+          {
+            ++iHits;
+            break;
+          }
+    }
+  // The exact match should nearly always be among the top
+  // candidates.
+  QVERIFY(iHits >= 90);
+}
+
+void TestPiiProductQuantizer::vectorQuantizer()
+{
+  Pii::seedRandom(2);
+  PiiMatrix<float> matCenters(Pii::uniformRandomMatrix(32, 8));
+  PiiMatrix<float> matModels(clusteredSamples(matCenters, 500));
+  PiiMatrix<float> matQueries(clusteredSamples(matCenters, 50));
+
+  PiiVectorQuantizer<PiiMatrix<float> > exact;
+  exact.setModels(matModels);
+
+  PiiVectorQuantizer<PiiMatrix<float> > vq;
+  vq.setModels(matModels);
+  vq.compressModels(4, true);
+  QVERIFY(vq.isCompressed());
+  QCOMPARE(vq.modelCount(), 500);
+  QCOMPARE(vq.featureCount(), 8);
+  // Re-ranking all models gives exact results.
+  vq.setRerankCount(500);
+  for (int i=0; i<matQueries.rows(); ++i)
+    {
+      double dExact, dDistance;
+      int iExact = exact.findClosestMatch(matQueries[i], &dExact);
+      QCOMPARE(vq.findClosestMatch(matQueries[i], &dDistance), iExact);
+      QCOMPARE(dDistance, dExact);
+    }
+
+  vq.compressModels(4);
+  QVERIFY(vq.isCompressed());
+  QCOMPARE(vq.modelCount(), 500);
+  QCOMPARE(vq.models().rows(), 0);
+  for (int i=0; i<matQueries.rows(); ++i)
+    {
+      double dDistance;
+      int iMatch = vq.findClosestMatch(matQueries[i], &dDistance);
+      QVERIFY(iMatch >= 0 && iMatch < 500);
+      QVERIFY(dDistance < 1);
+    }
+
+  vq.setRejectThreshold(0);
+  double dDistance;
+  QCOMPARE(vq.findClosestMatch(matQueries[0], &dDistance), -1);
+
+  vq.setModels(matModels);
+  QVERIFY(!vq.isCompressed());
+}
+
+QTEST_MAIN(TestPiiProductQuantizer)
@@ -0,0 +1,85 @@
+/* This file is part of Into.
+ * Copyright (C) Intopii 2013.
+ * All rights reserved.
+ *
+ * Licensees holding a commercial Into license may use this file in
+ * accordance with the commercial license agreement. Please see
+ * LICENSE.commercial for commercial licensing terms.
+ *
+ * Alternatively, this file may be used under the terms of the GNU
+ * Affero General Public License version 3 as published by the Free
+ * Software Foundation. In addition, Intopii gives you special rights
+ * to use Into as a part of open source software projects. Please
+ * refer to LICENSE.AGPL3 for details.
+ */
+
+
+#include "TestPiiProfileHistogram.h"
+
+#include <PiiProfileHistogram.h>
+#include <QtTest>
+#include <climits>
+
+void TestPiiProfileHistogram::bins()
+{
+  QCOMPARE(PiiProfileHistogram::binIndex(0), 0);
+  QCOMPARE(PiiProfileHistogram::binIndex(1), 1);
+  QCOMPARE(PiiProfileHistogram::binIndex(2), 2);
+  QCOMPARE(PiiProfileHistogram::binIndex(3), 2);
+  QCOMPARE(PiiProfileHistogram::binIndex(4), 3);
+  QCOMPARE(PiiProfileHistogram::binIndex(INT_MAX), 31);
+
+  PiiProfileHistogram histogram;
+  histogram.add(-5);
+  histogram.add(0);
+  histogram.add(5);
+  histogram.add(7);
+  QCOMPARE(histogram.count(), 4);
+  QCOMPARE(histogram.binCount(0), 2);
+  QCOMPARE(histogram.binCount(3), 2);
+  QCOMPARE(histogram.maximum(), 7);
+
+  histogram.reset();
+  QCOMPARE(histogram.count(), 0);
+  QCOMPARE(histogram.binCount(0), 0);
+  QCOMPARE(histogram.maximum(), 0);
+}
+
+void TestPiiProfileHistogram::totals()
+{
+  PiiProfileHistogram histogram;
+  // Exercise the carry from the low part of the total to the high
+  // one.
+  qint64 iTotal = 0;
+  for (int i=0; i<1000; ++i)
+    {
+      int iValue = 123457 * (i % 97);
+      histogram.add(iValue);
+      iTotal += iValue;
+    }
+  histogram.add(qint64(1) << 40); // clamped
+  iTotal += INT_MAX;
+  QCOMPARE(histogram.total(), iTotal);
+  QCOMPARE(histogram.maximum(), INT_MAX);
+  QCOMPARE(histogram.binCount(31), 1);
+  QCOMPARE(histogram.mean(), double(iTotal) / 1001);
+}
+
+void TestPiiProfileHistogram::variantMap()
+{
+  PiiProfileHistogram histogram;
+  histogram.add(1);
+  histogram.add(3);
+  QVariantMap mapHistogram(histogram.toVariantMap());
+  QCOMPARE(mapHistogram["count"].toInt(), 2);
+  QCOMPARE(mapHistogram["total"].toLongLong(), qint64(4));
+  QCOMPARE(mapHistogram["max"].toInt(), 3);
+  QCOMPARE(mapHistogram["mean"].toDouble(), 2.0);
+  QVariantList lstBins(mapHistogram["bins"].toList());
+  QCOMPARE(lstBins.size(), 3);
+  QCOMPARE(lstBins[0].toInt(), 0);
+  QCOMPARE(lstBins[1].toInt(), 1);
+  QCOMPARE(lstBins[2].toInt(), 1);
+}
+
+QTEST_MAIN(TestPiiProfileHistogram)
@@ -102,4 +102,32 @@ void TestPiiQImage::matrixToImage()
   }
 }
 
+void TestPiiQImage::matrixToSharedImage()
+{
+#if QT_VERSION >= 0x050000
+  {
+    // Color images share data with the matrix
+    PiiMatrix<PiiColor4<unsigned char> > matrix(3, 2);
+    matrix(1,1) = PiiColor4<unsigned char>(1,2,3);
+    QImage image(Pii::matrixToSharedQImage(matrix));
+    QCOMPARE(image.constBits(), reinterpret_cast<const uchar*>(matrix.row(0)));
+    QCOMPARE(image.pixel(1,1), qRgb(1,2,3));
+    // The image keeps the data alive
+    matrix = PiiMatrix<PiiColor4<unsigned char> >();
+    QCOMPARE(image.pixel(1,1), qRgb(1,2,3));
+    // Writing detaches
+    QImage copy(image);
+    copy.setPixel(0,0, qRgb(4,5,6));
+    QCOMPARE(image.pixel(0,0), qRgb(0,0,0));
+  }
+  {
+    // Non-compatible types are copied
+    PiiMatrix<float> matrix(2, 2, 0.0, 0.0, 0.0, 1.0);
+    QImage image(Pii::matrixToSharedQImage(matrix));
+    QCOMPARE(image.width(), 2);
+    QCOMPARE(image.scanLine(1)[1], (uchar)255);
+  }
+#endif
+}
+
 QTEST_MAIN(TestPiiQImage)
@@ -24,6 +24,7 @@ class TestQuantizer : public QObject
 
 private slots:
   void divideEqually();
+  void lookupTable();
 };
 
 #endif //_TESTQUANTIZER_H
@@ -37,5 +37,20 @@ void TestQuantizer::divideEqually()
   QCOMPARE(quantizer.quantize(7),2);
 }
 
+void TestQuantizer::lookupTable()
+{
+  PiiQuantizer<double> quantizer(PiiMatrix<double>(1, 4, -3.5, 0.0, 2.0, 10.0));
+  PiiMatrix<int> lut(quantizer.lookupTable(-10, 20));
+  QCOMPARE(lut.columns(), 31);
+  for (int i=-10; i<=20; ++i)
+    QCOMPARE(lut(i+10), quantizer.quantize(i));
+
+  // No limits -> everything is at level zero.
+  lut = PiiQuantizer<double>().lookupTable(0, 3);
+  QCOMPARE(lut.columns(), 4);
+  for (int i=0; i<4; ++i)
+    QCOMPARE(lut(i), 0);
+}
+
 QTEST_MAIN(TestQuantizer)
 
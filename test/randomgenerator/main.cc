@@ -0,0 +1,156 @@
+/* This file is part of Into.
+ * Copyright (C) Intopii 2013.
+ * All rights reserved.
+ *
+ * Licensees holding a commercial Into license may use this file in
+ * accordance with the commercial license agreement. Please see
+ * LICENSE.commercial for commercial licensing terms.
+ *
+ * Alternatively, this file may be used under the terms of the GNU
+ * Affero General Public License version 3 as published by the Free
+ * Software Foundation. In addition, Intopii gives you special rights
+ * to use Into as a part of open source software projects. Please
+ * refer to LICENSE.AGPL3 for details.
+ */
+
+
+#include "TestPiiRandomGenerator.h"
+
+#include <PiiRandomGenerator.h>
+#include <PiiParallel.h>
+#include <PiiMath.h>
+#include <QtTest>
+
+void TestPiiRandomGenerator::knownAnswer()
+{
+  // Test vectors from the Random123 distribution.
+  quint32 aResult[4];
+  const quint32 aZeroKey[2] = { 0, 0 };
+  PiiRandomGenerator::generateBlock(aZeroKey, 0, 0, aResult);
+  QCOMPARE(aResult[0], 0x6627e8d5u);
+  QCOMPARE(aResult[1], 0xe169c58du);
+  QCOMPARE(aResult[2], 0xbc57ac4cu);
+  QCOMPARE(aResult[3], 0x9b00dbd8u);
+
+  const quint32 aPiKey[2] = { 0xa4093822u, 0x299f31d0u };
+  PiiRandomGenerator::generateBlock(aPiKey, Q_UINT64_C(0x85a308d3243f6a88), Q_UINT64_C(0x0370734413198a2e), aResult);
+  QCOMPARE(aResult[0], 0xd16cfe09u);
+  QCOMPARE(aResult[1], 0x94fdccebu);
+  QCOMPARE(aResult[2], 0x5001e420u);
+  QCOMPARE(aResult[3], 0x24126ea1u);
+
+  PiiRandomGenerator generator;
+  QCOMPARE(generator.next(), 0x6627e8d5u);
+  QCOMPARE(generator.next(), 0xe169c58du);
+}
+
+void TestPiiRandomGenerator::position()
+{
+  PiiRandomGenerator generator(123, 4);
+  QVector<quint32> vecWords;
+  for (int i=0; i<11; ++i)
+    vecWords << generator.next();
+  QCOMPARE(generator.position(), quint64(11));
+
+  generator.setPosition(5);
+  QCOMPARE(generator.next(), vecWords[5]);
+  generator.discard(3);
+  QCOMPARE(generator.next(), vecWords[9]);
+  generator.setPosition(0);
+  QCOMPARE(generator.next(), vecWords[0]);
+
+  // A bulk fill must consume the same words as next().
+  PiiRandomGenerator other(123, 4);
+  other.setPosition(3);
+  float aValues[7];
+  other.fillUniform(aValues, 7);
+  QCOMPARE(other.position(), quint64(10));
+  for (int i=0; i<7; ++i)
+    QCOMPARE(aValues[i], float(vecWords[i+3] >> 8) / 16777216.0f);
+}
+
+void TestPiiRandomGenerator::streams()
+{
+  PiiRandomGenerator generator1(5), generator2(5), generator3(5, 1);
+  PiiRandomGenerator generator4(generator1.substream(1));
+  QCOMPARE(generator4.seed(), quint64(5));
+  QCOMPARE(generator4.stream(), quint64(1));
+  int iEqual12 = 0, iEqual13 = 0, iEqual34 = 0;
+  for (int i=0; i<100; ++i)
+    {
+      const quint32 i1 = generator1.next(), i3 = generator3.next();
+      iEqual12 += i1 == generator2.next();
+      iEqual13 += i1 == i3;
+      iEqual34 += i3 == generator4.next();
+    }
+  QCOMPARE(iEqual12, 100);
+  QCOMPARE(iEqual13, 0);
+  QCOMPARE(iEqual34, 100);
+
+  PiiRandomGenerator& threadGenerator = PiiRandomGenerator::threadInstance();
+  QVERIFY(&threadGenerator == &PiiRandomGenerator::threadInstance());
+}
+
+void TestPiiRandomGenerator::fillUniform()
+{
+  PiiRandomGenerator generator(1);
+  const int iCount = 100001;
+  QVector<double> vecDoubles(iCount);
+  generator.fillUniform(vecDoubles.data(), iCount, -1, 3);
+  QCOMPARE(generator.position(), quint64(2 * iCount));
+  double dSum = 0, dSquareSum = 0;
+  for (int i=0; i<iCount; ++i)
+    {
+      QVERIFY(vecDoubles[i] >= -1 && vecDoubles[i] < 3);
+      dSum += vecDoubles[i];
+      dSquareSum += vecDoubles[i] * vecDoubles[i];
+    }
+  const double dMean = dSum / iCount;
+  QVERIFY(Pii::abs(dMean - 1) < 0.02);
+  QVERIFY(Pii::abs(dSquareSum / iCount - dMean * dMean - 16.0 / 12) < 0.02);
+
+  PiiMatrix<float> matFloats(PiiMatrix<float>::uninitialized(300, 301));
+  generator.fillUniform(matFloats);
+  QVERIFY(Pii::min(matFloats) >= 0 && Pii::max(matFloats) < 1);
+  QVERIFY(Pii::abs(Pii::mean<double>(matFloats) - 0.5) < 0.01);
+}
+
+void TestPiiRandomGenerator::fillNormal()
+{
+  PiiRandomGenerator generator(2);
+  PiiMatrix<double> matDoubles(PiiMatrix<double>::uninitialized(301, 300));
+  generator.fillNormal(matDoubles, 10, 2);
+  QVERIFY(Pii::abs(Pii::mean<double>(matDoubles) - 10) < 0.05);
+  QVERIFY(Pii::abs(Pii::var<double>(matDoubles) - 4) < 0.1);
+
+  // Odd column count discards one number on each row
+  PiiMatrix<float> matFloats(PiiMatrix<float>::uninitialized(300, 301));
+  generator.setPosition(0);
+  generator.fillNormal(matFloats);
+  QCOMPARE(generator.position(), quint64(300 * 151 * 2));
+  QVERIFY(Pii::abs(Pii::mean<double>(matFloats)) < 0.02);
+  QVERIFY(Pii::abs(Pii::var<double>(matFloats) - 1) < 0.02);
+}
+
+void TestPiiRandomGenerator::parallelFill()
+{
+  PiiMatrix<float> matSerial(PiiMatrix<float>::uninitialized(257, 33)),
+    matParallel(PiiMatrix<float>::uninitialized(257, 33));
+  PiiRandomGenerator generator1(7, 3), generator2(7, 3);
+  generator1.fillNormal(matSerial, 0, 1);
+  for (int iBands=1; iBands<=5; ++iBands)
+    {
+      generator2.setPosition(0);
+      generator2.fillNormal(matParallel, 0, 1, Pii::ParallelExecution(iBands));
+      QCOMPARE(generator2.position(), generator1.position());
+      QVERIFY(Pii::equals(matSerial, matParallel));
+    }
+
+  PiiMatrix<double> matSerialUniform(PiiMatrix<double>::uninitialized(100, 100)),
+    matParallelUniform(PiiMatrix<double>::uninitialized(100, 100));
+  generator1.fillUniform(matSerialUniform, 0, 1);
+  generator2.fillUniform(matParallelUniform, 0, 1, Pii::ParallelExecution());
+  QVERIFY(Pii::equals(matSerialUniform, matParallelUniform));
+}
+
+QTEST_MAIN(TestPiiRandomGenerator)
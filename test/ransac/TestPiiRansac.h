@@ -25,6 +25,9 @@ class TestPiiRansac : public QObject
 private slots:
   void RigidPlaneRansac();
   void CircleRansac();
+  void earlyRejection();
+  void guidedSampling();
+  void threadCount();
 };
 
 
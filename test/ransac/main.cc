@@ -136,4 +136,85 @@ void TestPiiRansac::CircleRansac()
   }
 }
 
+static PiiMatrix<double> noisyCircle(double cx, double cy, double r, QVector<double>* scores = 0)
+{
+  PiiMatrix<double> matPoints(0, 2);
+  matPoints.reserve(512);
+  for (double a = 0; a < 2 * M_PI; a += M_PI / 128)
+    {
+      matPoints.appendRow(cx + r * cos(a) + Pii::uniformRandom(-0.5, 0.5),
+                          cy + r * sin(a) + Pii::uniformRandom(-0.5, 0.5));
+      // Outliers
+      matPoints.appendRow(Pii::uniformRandom(-50.0, 50.0),
+                          Pii::uniformRandom(-50.0, 50.0));
+      if (scores != 0)
+        *scores << Pii::uniformRandom(0.5, 1.0) << Pii::uniformRandom(0.0, 0.5);
+    }
+  return matPoints;
+}
+
+static bool closeTo(const PiiMatrix<double>& model, double cx, double cy, double r)
+{
+  return !model.isEmpty() &&
+    Pii::hypotenuse(model(0, 0) - cx, model(0, 1) - cy) < 2 &&
+    Pii::abs(model(0, 2) - r) < 2;
+}
+
+void TestPiiRansac::earlyRejection()
+{
+  PiiMatrix<double> matPoints(noisyCircle(5, -5, 15));
+
+  PiiCircleRansac<double> ransac(matPoints);
+  ransac.setFittingThreshold(1);
+  ransac.setSelectionProbability(0.999);
+  ransac.setEarlyRejection(true);
+  QVERIFY(ransac.earlyRejection());
+  QVERIFY(ransac.findBestModel());
+  QVERIFY(closeTo(ransac.bestModel(), 5, -5, 15));
+  // The inliers of the best model are fully evaluated.
+  QVERIFY(ransac.inlierCount() > matPoints.rows() / 3);
+  QVector<int> vecInliers(ransac.inlyingPoints());
+  for (int i=1; i<vecInliers.size(); ++i)
+    QVERIFY(vecInliers[i-1] < vecInliers[i]);
+}
+
+void TestPiiRansac::guidedSampling()
+{
+  QVector<double> vecScores;
+  PiiMatrix<double> matPoints(noisyCircle(-3, 8, 12, &vecScores));
+
+  PiiCircleRansac<double> ransac(matPoints);
+  ransac.setFittingThreshold(1);
+  ransac.setSampleScores(vecScores);
+  QCOMPARE(ransac.sampleScores().size(), matPoints.rows());
+  // The best samples are all inliers. PROSAC should find the model
+  // with just a few tries.
+  ransac.setMaxIterations(20);
+  QVERIFY(ransac.findBestModel());
+  QVERIFY(closeTo(ransac.bestModel(), -3, 8, 12));
+
+  // Wrong number of scores disables guided sampling.
+  ransac.setSampleScores(QVector<double>(3, 1.0));
+  ransac.setMaxIterations(1000);
+  QVERIFY(ransac.findBestModel());
+  QVERIFY(closeTo(ransac.bestModel(), -3, 8, 12));
+}
+
+void TestPiiRansac::threadCount()
+{
+  PiiMatrix<double> matPoints(noisyCircle(0, 0, 20));
+
+  PiiCircleRansac<double> ransac(matPoints);
+  QCOMPARE(ransac.threadCount(), 1);
+  ransac.setFittingThreshold(1);
+  ransac.setThreadCount(0);
+  QVERIFY(ransac.findBestModel());
+  QVERIFY(closeTo(ransac.bestModel(), 0, 0, 20));
+
+  ransac.setEarlyRejection(true);
+  ransac.setThreadCount(4);
+  QVERIFY(ransac.findBestModel());
+  QVERIFY(closeTo(ransac.bestModel(), 0, 0, 20));
+}
+
 QTEST_MAIN(TestPiiRansac)
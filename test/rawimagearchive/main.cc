@@ -0,0 +1,115 @@
+/* This file is part of Into.
+ * Copyright (C) Intopii 2013.
+ * All rights reserved.
+ *
+ * Licensees holding a commercial Into license may use this file in
+ * accordance with the commercial license agreement. Please see
+ * LICENSE.commercial for commercial licensing terms.
+ *
+ * Alternatively, this file may be used under the terms of the GNU
+ * Affero General Public License version 3 as published by the Free
+ * Software Foundation. In addition, Intopii gives you special rights
+ * to use Into as a part of open source software projects. Please
+ * refer to LICENSE.AGPL3 for details.
+ */
+
+#include "TestPiiRawImageArchive.h"
+#include <PiiRawImageArchive.h>
+#include <PiiRawImageArchiveBuilder.h>
+#include <PiiMath.h>
+#include <PiiColor.h>
+
+#include <QtTest>
+#include <QFile>
+
+void TestPiiRawImageArchive::readWrite()
+{
+  PiiMatrix<unsigned char> matGray(3, 5);
+  for (int r=0; r<3; ++r)
+    for (int c=0; c<5; ++c)
+      matGray(r,c) = r*10 + c;
+  PiiMatrix<float> matFloat(2, 3, 1.0, 2.0, 3.0, 4.0, 5.0, 6.0);
+  PiiMatrix<PiiColor<unsigned char> > matColor(2, 2);
+  matColor(1,1) = PiiColor<unsigned char>(1,2,3);
+
+  {
+    PiiRawImageArchiveBuilder builder("readwrite.piia", 32);
+    builder.open();
+    builder.append(matGray);
+    builder.append(matFloat);
+    builder.append(PiiMatrix<unsigned char>(matGray(1,1,2,3)));
+    // The same data with non-contiguous rows
+    builder.append(PiiMatrix<unsigned char>(2, 3, matGray.row(1) + 1, Pii::RetainOwnership, matGray.stride()));
+    builder.append(matColor);
+    builder.append(PiiMatrix<unsigned char>());
+    QCOMPARE(builder.count(), 6);
+    builder.close();
+  }
+
+  PiiRawImageArchive archive("readwrite.piia");
+  archive.open();
+  QCOMPARE(archive.count(), 6);
+  QCOMPARE(archive.typeAt(1), (unsigned int)PiiYdin::FloatMatrixType);
+  QCOMPARE(archive.rowsAt(2), 2);
+  QCOMPARE(archive.columnsAt(2), 3);
+
+  const PiiMatrix<unsigned char> matGray2(archive.matrixAt<unsigned char>(0));
+  QVERIFY(Pii::equals(matGray2, matGray));
+  // Payloads are aligned within the mapping.
+  QCOMPARE(reinterpret_cast<quintptr>(matGray2.row(0)) % 32, quintptr(0));
+  const PiiMatrix<float> matFloat2(archive.matrixAt<float>(1));
+  QVERIFY(Pii::equals(matFloat2, matFloat));
+  QCOMPARE(reinterpret_cast<quintptr>(matFloat2.row(0)) % 32, quintptr(0));
+  QVERIFY(Pii::equals(archive.matrixAt<unsigned char>(2), archive.matrixAt<unsigned char>(3)));
+  QVERIFY(archive.matrixAt<PiiColor<unsigned char> >(4)(1,1) == PiiColor<unsigned char>(1,2,3));
+  QVERIFY(archive.matrixAt<unsigned char>(5).isEmpty());
+
+  try
+    {
+      archive.matrixAt<float>(0);
+      QFAIL("Type mismatch was not detected.");
+    }
+  catch (PiiException&) {}
+}
+
+void TestPiiRawImageArchive::mapping()
+{
+  {
+    PiiRawImageArchiveBuilder builder("mapping.piia");
+    builder.open();
+    builder.append(PiiMatrix<int>(1, 3, 1, 2, 3));
+    builder.close();
+  }
+
+  PiiMatrix<int> matKept;
+  {
+    PiiRawImageArchive archive("mapping.piia");
+    archive.open();
+    matKept = archive.matrixAt<int>(0);
+    PiiMatrix<int> matModified(archive.matrixAt<int>(0));
+    // Modifying an immutable matrix makes a copy.
+    matModified(0,0) = 4;
+    QCOMPARE(archive.matrixAt<int>(0)(0,0), 1);
+  }
+  // The mapping must outlive the archive.
+  QVERIFY(Pii::equals(matKept, PiiMatrix<int>(1, 3, 1, 2, 3)));
+}
+
+void TestPiiRawImageArchive::invalidFile()
+{
+  {
+    QFile file("invalid.piia");
+    QVERIFY(file.open(QIODevice::WriteOnly));
+    file.write(QByteArray(64, 'x'));
+  }
+  PiiRawImageArchive archive("invalid.piia");
+  try
+    {
+      archive.open();
+      QFAIL("Invalid file was accepted.");
+    }
+  catch (PiiException&) {}
+  QVERIFY(!archive.isOpen());
+}
+
+QTEST_MAIN(TestPiiRawImageArchive)
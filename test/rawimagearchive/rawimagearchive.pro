@@ -0,0 +1,2 @@
+include(../unit_test.pri)
+INCLUDEPATH += $$INTODIR/modules/image/rawimage
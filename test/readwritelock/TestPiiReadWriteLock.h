@@ -29,10 +29,13 @@ public:
 private slots:
   void threaded();
   void recursive();
+  void upgrade();
+  void manyLocks();
 
 private:
-  void writer(int count);
+  void writer(PiiReadWriteLock* lock, int count);
   void reader();
+  void upgrader(PiiReadWriteLock* lock);
 
   int _iCounter;
   bool _bFailure;
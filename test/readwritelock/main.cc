@@ -23,11 +23,11 @@ TestPiiReadWriteLock::TestPiiReadWriteLock() :
   _iCounter(0), _bFailure(false)
 {}
 
-void TestPiiReadWriteLock::writer(int count)
+void TestPiiReadWriteLock::writer(PiiReadWriteLock* lock, int count)
 {
   for (int i=0; i<count; ++i)
     {
-      PiiWriteLocker lock(&_lock);
+      PiiWriteLocker writeLock(lock);
       ++_iCounter;
       PiiDelay::msleep(1);
     }
@@ -47,8 +47,8 @@ void TestPiiReadWriteLock::reader()
 
 void TestPiiReadWriteLock::threaded()
 {
-  QThread* pWriter1 = Pii::asyncCall(this, &TestPiiReadWriteLock::writer, 100);
-  QThread* pWriter2 = Pii::asyncCall(this, &TestPiiReadWriteLock::writer, 200);
+  QThread* pWriter1 = Pii::asyncCall(this, &TestPiiReadWriteLock::writer, &_lock, 100);
+  QThread* pWriter2 = Pii::asyncCall(this, &TestPiiReadWriteLock::writer, &_lock, 200);
   QThread* pReader1 = Pii::asyncCall(this, &TestPiiReadWriteLock::reader);
   QThread* pReader2 = Pii::asyncCall(this, &TestPiiReadWriteLock::reader);
   QThread* pReader3 = Pii::asyncCall(this, &TestPiiReadWriteLock::reader);
@@ -82,4 +82,62 @@ void TestPiiReadWriteLock::recursive()
   lock.unlockWrite();
 }
 
+void TestPiiReadWriteLock::upgrader(PiiReadWriteLock* lock)
+{
+  for (int i=0; i<100; ++i)
+    {
+      PiiReadLocker readLock(lock);
+      int iPreviousValue = _iCounter;
+      {
+        PiiWriteLocker writeLock(lock);
+        ++_iCounter;
+      }
+      if (_iCounter <= iPreviousValue)
+        _bFailure = true;
+    }
+}
+
+void TestPiiReadWriteLock::upgrade()
+{
+  _iCounter = 0;
+  _bFailure = false;
+  // Only recursive locks can be upgraded.
+  PiiReadWriteLock lock(PiiReadWriteLock::Recursive);
+  // A single upgrading reader competes with a writer. The upgrade
+  // must not deadlock even if the writer is already waiting.
+  QThread* pWriter = Pii::asyncCall(this, &TestPiiReadWriteLock::writer, &lock, 50);
+  upgrader(&lock);
+  pWriter->wait();
+
+  QVERIFY(!_bFailure);
+  QCOMPARE(_iCounter, 150);
+}
+
+void TestPiiReadWriteLock::manyLocks()
+{
+  // More locks than fit into the thread-local bookkeeping.
+  const int iLockCount = 40;
+  QList<PiiReadWriteLock*> lstLocks;
+  for (int i=0; i<iLockCount; ++i)
+    {
+      lstLocks << new PiiReadWriteLock(PiiReadWriteLock::Recursive);
+      lstLocks[i]->lockForRead();
+      lstLocks[i]->lockForRead();
+    }
+  for (int i=0; i<iLockCount; ++i)
+    {
+      lstLocks[i]->lockForWrite();
+      lstLocks[i]->unlockWrite();
+      lstLocks[i]->unlockRead();
+      lstLocks[i]->unlockRead();
+    }
+  // All locks must be free again.
+  for (int i=0; i<iLockCount; ++i)
+    {
+      lstLocks[i]->lockForWrite();
+      lstLocks[i]->unlockWrite();
+    }
+  qDeleteAll(lstLocks);
+}
+
 QTEST_MAIN(TestPiiReadWriteLock)
@@ -27,6 +27,7 @@ private slots:
   void initTestCase();
   void select();
   void subselect();
+  void removeStatements();
 
 private:
   PiiResourceDatabase db;
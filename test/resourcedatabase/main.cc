@@ -134,4 +134,28 @@ void TestPiiResourceDatabase::subselect()
   QCOMPARE(lstResult[0], QString("PiiResourceDatabase"));
 }
 
+void TestPiiResourceDatabase::removeStatements()
+{
+  using namespace Pii;
+  PiiResourceDatabase db2;
+  QList<int> lstIds = db2.addStatements(QList<PiiResourceStatement>()
+                                        << db2.resource("A", "pii:parent", "Plugin1")
+                                        << db2.resource("B", "pii:parent", "Plugin2")
+                                        << db2.resource("C", "pii:parent", "Plugin1")
+                                        << db2.literal("A", "my:name", "Plugin1"));
+  QCOMPARE(db2.select(subject, attribute("pii:parent") == "Plugin1"), QList<QString>() << "A" << "C");
+  QCOMPARE(db2.findFirst(object == "Plugin1"), lstIds[0]);
+
+  db2.removeStatements(QList<int>() << lstIds[0] << lstIds[1]);
+  QCOMPARE(db2.statementCount(), 2);
+  QCOMPARE(db2.select(subject, attribute("pii:parent") == "Plugin1"), QList<QString>() << "C");
+  QCOMPARE(db2.select(subject, predicate == "pii:parent" && object == "Plugin2"), QList<QString>());
+  QCOMPARE(db2.findFirst(object == "Plugin1"), lstIds[2]);
+  QCOMPARE(db2.findFirst(subject == "A"), lstIds[3]);
+  QCOMPARE(db2.select(subject, object == "Plugin1" || subject == "B"), QList<QString>() << "C" << "A");
+
+  db2.addStatement(db2.resource("D", "pii:parent", "Plugin1"));
+  QCOMPARE(db2.select(subject, attribute("pii:parent") == "Plugin1"), QList<QString>() << "C" << "D");
+}
+
 QTEST_MAIN(TestPiiResourceDatabase)
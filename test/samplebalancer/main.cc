@@ -0,0 +1,82 @@
+/* This file is part of Into.
+ * Copyright (C) Intopii 2013.
+ * All rights reserved.
+ *
+ * Licensees holding a commercial Into license may use this file in
+ * accordance with the commercial license agreement. Please see
+ * LICENSE.commercial for commercial licensing terms.
+ *
+ * Alternatively, this file may be used under the terms of the GNU
+ * Affero General Public License version 3 as published by the Free
+ * Software Foundation. In addition, Intopii gives you special rights
+ * to use Into as a part of open source software projects. Please
+ * refer to LICENSE.AGPL3 for details.
+ */
+
+#include "TestPiiSampleBalancer.h"
+
+#include <QtTest>
+
+void TestPiiSampleBalancer::initTestCase()
+{
+  QVERIFY(createOperation("piiclassification", "PiiSampleBalancer"));
+}
+
+void TestPiiSampleBalancer::classWeights()
+{
+  // Feature weights stay at one until the first batch of feature
+  // values is complete. The weights are thus determined by the
+  // class counts only.
+  operation()->setProperty("mode", "WeightCalculation");
+  operation()->setProperty("learningBatchSize", 1000);
+  QVERIFY(connectInput("features"));
+  QVERIFY(connectInput("label"));
+  QVERIFY(start());
+
+  // The weight of a sample is the count of the rarest class seen so
+  // far divided by the count of the sample's own class.
+  const int aiLabels[] = { 0, 0, 1, 0, 1, 1, 2, 0, 1 };
+  const double adWeights[] = { 1, 1, 1, 1.0/3, 1, 1, 1, 0.25, 0.25 };
+  for (int i=0; i<int(sizeof(aiLabels)/sizeof(int)); ++i)
+    {
+      QVERIFY(sendObject("features", PiiMatrix<int>(1,2, 0,1)));
+      QVERIFY(sendObject("label", aiLabels[i]));
+      QCOMPARE(outputValue("weight", -1.0), adWeights[i]);
+      QCOMPARE(outputValue("select", false), true);
+    }
+  QVERIFY(stop());
+
+  // Restarting forgets the old class counts.
+  QVERIFY(start());
+  QVERIFY(sendObject("features", PiiMatrix<int>(1,2, 0,1)));
+  QVERIFY(sendObject("label", 2));
+  QCOMPARE(outputValue("weight", -1.0), 1.0);
+  QVERIFY(stop());
+
+  disconnectAllInputs();
+}
+
+void TestPiiSampleBalancer::labelLimit()
+{
+  operation()->setProperty("mode", "WeightCalculation");
+  operation()->setProperty("maxClasses", 10);
+  QVERIFY(connectInput("features"));
+  QVERIFY(connectInput("label"));
+  QVERIFY(start());
+  QVERIFY(sendObject("features", PiiMatrix<int>(1,2, 0,1)));
+  QVERIFY(sendObject("label", 9));
+  QCOMPARE(outputValue("weight", -1.0), 1.0);
+  QVERIFY(sendObject("features", PiiMatrix<int>(1,2, 0,1)));
+  QVERIFY(!sendObject("label", 10));
+  stop();
+
+  QVERIFY(start());
+  QVERIFY(sendObject("features", PiiMatrix<int>(1,2, 0,1)));
+  QVERIFY(!sendObject("label", -1));
+  stop();
+
+  disconnectAllInputs();
+  operation()->setProperty("maxClasses", 65536);
+}
+
+QTEST_MAIN(TestPiiSampleBalancer)
@@ -0,0 +1,150 @@
+/* This file is part of Into.
+ * Copyright (C) Intopii 2013.
+ * All rights reserved.
+ *
+ * Licensees holding a commercial Into license may use this file in
+ * accordance with the commercial license agreement. Please see
+ * LICENSE.commercial for commercial licensing terms.
+ *
+ * Alternatively, this file may be used under the terms of the GNU
+ * Affero General Public License version 3 as published by the Free
+ * Software Foundation. In addition, Intopii gives you special rights
+ * to use Into as a part of open source software projects. Please
+ * refer to LICENSE.AGPL3 for details.
+ */
+
+#include "TestPiiSampleRandomizer.h"
+
+#include <PiiRandom.h>
+#include <QtTest>
+
+void TestPiiSampleRandomizer::initTestCase()
+{
+  QVERIFY(createOperation("piiclassification", "PiiSampleRandomizer"));
+}
+
+QVariantList TestPiiSampleRandomizer::fillReservoirs(long seed)
+{
+  // Send 20 samples to each of 200 classes.
+  operation()->setProperty("sampleNames", QVariantList());
+  Pii::seedRandom(seed);
+  if (!start())
+    return QVariantList();
+  for (int c=0; c<200; ++c)
+    for (int i=0; i<20; ++i)
+      if (!sendObject("name", QString("%1/%2").arg(c).arg(i)) ||
+          !sendObject("label", c))
+        {
+          stop();
+          return QVariantList();
+        }
+  stop();
+  return operation()->property("sampleNames").toList();
+}
+
+void TestPiiSampleRandomizer::reservoir()
+{
+  operation()->setProperty("reservoirSize", 5);
+  operation()->setProperty("classWeights", QVariantList());
+  QVERIFY(connectInput("name"));
+  QVERIFY(start(ExpectFail));
+  QVERIFY(connectInput("label"));
+
+  QVariantList lstNames(fillReservoirs(1));
+  QCOMPARE(lstNames.size(), 200);
+  QVector<int> vecRetained(20, 0);
+  for (int c=0; c<lstNames.size(); ++c)
+    {
+      QStringList lstClass(lstNames[c].toStringList());
+      QCOMPARE(lstClass.size(), 5);
+      for (int i=0; i<lstClass.size(); ++i)
+        {
+          QStringList lstParts(lstClass[i].split('/'));
+          QCOMPARE(lstParts[0].toInt(), c);
+          ++vecRetained[lstParts[1].toInt()];
+        }
+    }
+  // Each sample stays in the reservoir with probability 5/20. Over
+  // 200 classes, the expected count is 50 for each position in the
+  // stream, with a standard deviation of about 6. Early samples must
+  // get replaced, and late ones must get in.
+  for (int i=0; i<vecRetained.size(); ++i)
+    QVERIFY2(vecRetained[i] > 25 && vecRetained[i] < 75,
+             qPrintable(QString("Sample %1 was retained %2 times.").arg(i).arg(vecRetained[i])));
+
+  // The choices depend on the seed only.
+  QCOMPARE(fillReservoirs(1), lstNames);
+  QVERIFY(fillReservoirs(2) != lstNames);
+
+  disconnectAllInputs();
+  operation()->setProperty("reservoirSize", 0);
+}
+
+void TestPiiSampleRandomizer::classWeights()
+{
+  operation()->setProperty("sampleNames", QVariantList()
+                           << (QStringList() << "a0" << "a1")
+                           << (QStringList() << "b0"));
+  operation()->setProperty("classWeights", QVariantList() << 1.0 << 3.0);
+  operation()->setProperty("randomSampling", true);
+  QVERIFY(connectInput("trigger"));
+
+  QList<int> lstFirstLabels;
+  Pii::seedRandom(3);
+  QVERIFY(start());
+  int aiClassCounts[2] = { 0, 0 }, iFirstSampleCount = 0;
+  for (int i=0; i<4000; ++i)
+    {
+      QVERIFY(sendObject("trigger", 0));
+      int iLabel = outputValue("label", -1);
+      QVERIFY(iLabel == 0 || iLabel == 1);
+      ++aiClassCounts[iLabel];
+      QString strName(outputValue("name", QString()));
+      QCOMPARE(strName.at(0), QChar(iLabel == 0 ? 'a' : 'b'));
+      if (strName == "a0")
+        ++iFirstSampleCount;
+      if (i < 100)
+        lstFirstLabels << iLabel;
+    }
+  QVERIFY(stop());
+  // Expected counts are 1000 and 3000, with a standard deviation of
+  // about 27.
+  QVERIFY2(qAbs(aiClassCounts[0] - 1000) < 150, qPrintable(QString::number(aiClassCounts[0])));
+  // Random sampling within class 0: 500 +- 16 expected.
+  QVERIFY2(qAbs(iFirstSampleCount - 500) < 100, qPrintable(QString::number(iFirstSampleCount)));
+
+  // Same seed, same sequence.
+  Pii::seedRandom(3);
+  QVERIFY(start());
+  for (int i=0; i<lstFirstLabels.size(); ++i)
+    {
+      QVERIFY(sendObject("trigger", 0));
+      QCOMPARE(outputValue("label", -1), lstFirstLabels[i]);
+    }
+  QVERIFY(stop());
+
+  disconnectAllInputs();
+  operation()->setProperty("randomSampling", false);
+}
+
+void TestPiiSampleRandomizer::labelLimit()
+{
+  operation()->setProperty("sampleNames", QVariantList());
+  operation()->setProperty("classWeights", QVariantList());
+  operation()->setProperty("maxClasses", 10);
+  QVERIFY(connectInput("name"));
+  QVERIFY(connectInput("label"));
+  QVERIFY(start());
+  QVERIFY(sendObject("name", "first"));
+  QVERIFY(sendObject("label", 9));
+  QCOMPARE(outputValue("label", -1), 9);
+  QVERIFY(sendObject("name", "second"));
+  QVERIFY(!sendObject("label", 10));
+  stop();
+  QCOMPARE(operation()->property("sampleNames").toList().size(), 10);
+
+  disconnectAllInputs();
+  operation()->setProperty("maxClasses", 65536);
+}
+
+QTEST_MAIN(TestPiiSampleRandomizer)
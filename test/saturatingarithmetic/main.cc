@@ -0,0 +1,117 @@
+/* This file is part of Into.
+ * Copyright (C) Intopii 2013.
+ * All rights reserved.
+ *
+ * Licensees holding a commercial Into license may use this file in
+ * accordance with the commercial license agreement. Please see
+ * LICENSE.commercial for commercial licensing terms.
+ *
+ * Alternatively, this file may be used under the terms of the GNU
+ * Affero General Public License version 3 as published by the Free
+ * Software Foundation. In addition, Intopii gives you special rights
+ * to use Into as a part of open source software projects. Please
+ * refer to LICENSE.AGPL3 for details.
+ */
+
+
+#include "TestPiiSaturatingArithmetic.h"
+
+#include <PiiSaturatingArithmetic.h>
+#include <PiiMath.h>
+#include <QtTest>
+
+void TestPiiSaturatingArithmetic::saturatingSum()
+{
+  PiiMatrix<unsigned char> mat1(1,4, 0, 100, 200, 255);
+  PiiMatrix<unsigned char> mat2(1,4, 10, 100, 100, 1);
+  QVERIFY(Pii::equals(PiiMatrix<unsigned char>(Pii::saturatingSum(mat1, mat2)),
+                      PiiMatrix<unsigned char>(1,4, 10, 200, 255, 255)));
+  QVERIFY(Pii::equals(PiiMatrix<unsigned char>(Pii::saturatingSum(mat1, (unsigned char)60)),
+                      PiiMatrix<unsigned char>(1,4, 60, 160, 255, 255)));
+
+  PiiMatrix<short> mat3(1,3, 32000, -32000, 5);
+  QVERIFY(Pii::equals(PiiMatrix<short>(Pii::saturatingSum(mat3, mat3)),
+                      PiiMatrix<short>(1,3, 32767, -32768, 10)));
+
+  try
+    {
+      Pii::saturatingSum(mat1, PiiMatrix<unsigned char>(2,2));
+      QFAIL("Size mismatch was accepted.");
+    }
+  catch (PiiInvalidArgumentException&) {}
+}
+
+void TestPiiSaturatingArithmetic::saturatingDifference()
+{
+  PiiMatrix<unsigned char> mat1(1,3, 0, 100, 200);
+  PiiMatrix<unsigned char> mat2(1,3, 10, 50, 100);
+  QVERIFY(Pii::equals(PiiMatrix<unsigned char>(Pii::saturatingDifference(mat1, mat2)),
+                      PiiMatrix<unsigned char>(1,3, 0, 50, 100)));
+  QVERIFY(Pii::equals(PiiMatrix<unsigned char>(Pii::saturatingDifference(mat1, (unsigned char)150)),
+                      PiiMatrix<unsigned char>(1,3, 0, 0, 50)));
+}
+
+void TestPiiSaturatingArithmetic::saturatingProduct()
+{
+  PiiMatrix<unsigned short> mat(1,3, 2, 300, 40000);
+  QVERIFY(Pii::equals(PiiMatrix<unsigned short>(Pii::saturatingProduct(mat, mat)),
+                      PiiMatrix<unsigned short>(1,3, 4, 65535, 65535)));
+  QVERIFY(Pii::equals(PiiMatrix<unsigned short>(Pii::saturatingShiftLeft(mat, 2)),
+                      PiiMatrix<unsigned short>(1,3, 8, 1200, 65535)));
+
+  // The products and shifts below overflow an int.
+  PiiMatrix<unsigned short> matLarge(1,3, 50000, 65535, 1);
+  QVERIFY(Pii::equals(PiiMatrix<unsigned short>(Pii::saturatingProduct(matLarge, matLarge)),
+                      PiiMatrix<unsigned short>(1,3, 65535, 65535, 1)));
+  QVERIFY(Pii::equals(PiiMatrix<unsigned short>(Pii::saturatingProduct(matLarge, (unsigned short)65535)),
+                      PiiMatrix<unsigned short>(1,3, 65535, 65535, 65535)));
+  QVERIFY(Pii::equals(PiiMatrix<unsigned short>(Pii::saturatingShiftLeft(matLarge, 15)),
+                      PiiMatrix<unsigned short>(1,3, 65535, 65535, 32768)));
+  QVERIFY(Pii::equals(PiiMatrix<unsigned short>(Pii::saturatingShiftLeft(matLarge, 16)),
+                      PiiMatrix<unsigned short>(1,3, 65535, 65535, 65535)));
+  QVERIFY(Pii::equals(PiiMatrix<unsigned short>(Pii::saturatingShiftLeft(matLarge, 40)),
+                      PiiMatrix<unsigned short>(1,3, 65535, 65535, 65535)));
+
+  PiiMatrix<short> matSigned(1,3, -32768, 32767, -1);
+  QVERIFY(Pii::equals(PiiMatrix<short>(Pii::saturatingProduct(matSigned, (short)-32768)),
+                      PiiMatrix<short>(1,3, 32767, -32768, 32767)));
+  QVERIFY(Pii::equals(PiiMatrix<short>(Pii::saturatingShiftLeft(matSigned, 31)),
+                      PiiMatrix<short>(1,3, -32768, 32767, -32768)));
+}
+
+void TestPiiSaturatingArithmetic::fixedPointScale()
+{
+  typedef PiiFixedPoint<12> Fixed;
+  PiiMatrix<unsigned char> mat(1,5, 0, 10, 100, 200, 255);
+  QVERIFY(Pii::equals(PiiMatrix<unsigned char>(Pii::fixedPointScale(mat, Fixed(1.5), Fixed(-10.0))),
+                      PiiMatrix<unsigned char>(1,5, 0, 5, 140, 255, 255)));
+  // Rounds to nearest
+  QVERIFY(Pii::equals(PiiMatrix<unsigned char>(Pii::fixedPointScale(mat, Fixed(0.5))),
+                      PiiMatrix<unsigned char>(1,5, 0, 5, 50, 100, 128)));
+}
+
+void TestPiiSaturatingArithmetic::fixedPointBlend()
+{
+  PiiMatrix<unsigned char> mat1(1,3, 0, 100, 255);
+  PiiMatrix<unsigned char> mat2(1,3, 255, 200, 255);
+  QVERIFY(Pii::equals(PiiMatrix<unsigned char>(Pii::fixedPointBlend(mat1, mat2, 0.75)),
+                      PiiMatrix<unsigned char>(1,3, 64, 125, 255)));
+  QVERIFY(Pii::equals(PiiMatrix<unsigned char>(Pii::fixedPointBlend(mat1, mat2, 1.0)), mat1));
+  QVERIFY(Pii::equals(PiiMatrix<unsigned char>(Pii::fixedPointBlend(mat1, mat2, 0.0)), mat2));
+}
+
+void TestPiiSaturatingArithmetic::fixedPoint()
+{
+  typedef PiiFixedPoint<16> Fixed;
+  Fixed a(1.5), b(-0.25);
+  QCOMPARE(double(a + b), 1.25);
+  QCOMPARE(double(a - b), 1.75);
+  QCOMPARE(double(a * b), -0.375);
+  QCOMPARE(double(a / b), -6.0);
+  QCOMPARE(Fixed(3).rawValue(), 3 << 16);
+  QVERIFY(Fixed::fromRawValue(1 << 15) == Fixed(0.5));
+  a *= Fixed(2);
+  QCOMPARE(double(a), 3.0);
+}
+
+QTEST_MAIN(TestPiiSaturatingArithmetic)
@@ -0,0 +1 @@
+include(../unit_test.pri)
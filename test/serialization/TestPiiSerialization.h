@@ -30,6 +30,10 @@ private slots:
   void textArchive();
   void binaryArchive();
   void derivedTypes();
+  void primitiveArrays();
+  void mappedMatrices();
+  void textNumbers();
+  void pointerGraph();
 
 private:
   PiiMatrix<double> _dMat;
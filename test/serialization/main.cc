@@ -81,9 +81,14 @@ const int iVariantTesterMetaType = qRegisterMetaType<VariantTester>("VariantTest
 #include <PiiGenericTextOutputArchive.h>
 #include <PiiGenericBinaryInputArchive.h>
 #include <PiiGenericBinaryOutputArchive.h>
+#include <PiiBinaryInputArchive.h>
+#include <PiiBinaryOutputArchive.h>
+#include <PiiTextInputArchive.h>
+#include <PiiTextOutputArchive.h>
 #include <PiiSharedPtr.h>
 
 #include <iostream>
+#include <limits>
 
 #include <QtTest>
 
@@ -280,5 +285,196 @@ void TestPiiSerialization::binaryArchive()
   anyArchive<PiiGenericBinaryInputArchive,PiiGenericBinaryOutputArchive>();
 }
 
-QTEST_MAIN(TestPiiSerialization)
+void TestPiiSerialization::primitiveArrays()
+{
+  QVector<int> vecInts;
+  for (int i=0; i<10000; ++i)
+    vecInts << i * 65537;
+  QVector<double> vecDoubles(3, 1.5);
+  QVector<float> vecFloats(2, 2.5f);
+  PiiMatrix<int> matBig(10,10);
+  Pii::generate(matBig.begin(), matBig.end(), Pii::CountFunction<int>());
+  PiiMatrix<int> matSub(matBig(2,3,4,5));
+
+  QByteArray aBulk, aElementwise;
+  try
+    {
+      {
+        QBuffer buffer(&aBulk);
+        buffer.open(QIODevice::WriteOnly);
+        PiiBinaryOutputArchive oa(&buffer);
+        oa << vecInts << vecDoubles << vecFloats << matBig << matSub;
+      }
+      {
+        // The bulk path must produce the same bytes as writing each
+        // element separately.
+        QBuffer buffer(&aElementwise);
+        buffer.open(QIODevice::WriteOnly);
+        PiiBinaryOutputArchive oa(&buffer);
+        oa << vecInts.size();
+        for (int i=0; i<vecInts.size(); ++i)
+          oa << vecInts[i];
+      }
+      QVERIFY(aBulk.startsWith(aElementwise));
+
+      QBuffer buffer(&aBulk);
+      buffer.open(QIODevice::ReadOnly);
+      PiiBinaryInputArchive ia(&buffer);
+      QVector<int> vecInts2;
+      QVector<double> vecDoubles2;
+      QVector<float> vecFloats2;
+      PiiMatrix<int> matBig2, matSub2;
+      ia >> vecInts2 >> vecDoubles2 >> vecFloats2 >> matBig2 >> matSub2;
+      QVERIFY(vecInts2 == vecInts);
+      QVERIFY(vecDoubles2 == vecDoubles);
+      QVERIFY(vecFloats2 == vecFloats);
+      QVERIFY(Pii::equals(matBig2, matBig));
+      QVERIFY(Pii::equals(matSub2, matSub));
+    }
+  catch (PiiSerializationException& ex)
+    {
+      QFAIL(qPrintable(ex.message()));
+    }
+}
+
+void TestPiiSerialization::mappedMatrices()
+{
+  PiiMatrix<double> matLarge(100,100);
+  Pii::generate(matLarge.begin(), matLarge.end(), Pii::CountFunction<double>());
+  PiiMatrix<char> matSmall(1,3, 'a', 'b', 'c');
+
+  QTemporaryFile file;
+  QVERIFY(file.open());
+  try
+    {
+      {
+        PiiBinaryOutputArchive oa(&file, 64);
+        QCOMPARE(oa.payloadAlignment(), 64);
+        oa << matSmall << matLarge << 5;
+      }
+      file.close();
+
+      for (int i=0; i<2; ++i)
+        {
+          QFile input(file.fileName());
+          QVERIFY(input.open(QIODevice::ReadOnly));
+          PiiMatrix<double> matLarge2;
+          PiiMatrix<char> matSmall2;
+          int iValue = 0;
+          {
+            PiiBinaryInputArchive ia(&input, i == 1);
+            QCOMPARE(ia.payloadAlignment(), 64);
+            ia >> matSmall2 >> matLarge2 >> iValue;
+          }
+          // The mapping must outlive the archive and the file.
+          input.close();
+          QCOMPARE(iValue, 5);
+          QVERIFY(Pii::equals(matSmall2, matSmall));
+          QVERIFY(Pii::equals(matLarge2, matLarge));
+          if (i == 1)
+            {
+              QCOMPARE(quintptr(matLarge2[0]) % 64, quintptr(0));
+              // Mapped matrices are copied on write.
+              matLarge2(0,0) = -1;
+              QCOMPARE(matLarge2(0,0), -1.0);
+            }
+        }
+    }
+  catch (PiiSerializationException& ex)
+    {
+      QFAIL(qPrintable(ex.message()));
+    }
+}
+
+void TestPiiSerialization::textNumbers()
+{
+  const double dThird = 1.0/3;
+  const double dInf = std::numeric_limits<double>::infinity();
+  QByteArray array;
+  try
+    {
+      {
+        QBuffer buffer(&array);
+        buffer.open(QIODevice::WriteOnly);
+        PiiTextOutputArchive oa(&buffer);
+        oa << 0.1 << dThird << 1e300 << -dInf << 0.1f;
+        oa << std::numeric_limits<int>::min() << std::numeric_limits<long long>::max()
+           << std::numeric_limits<unsigned long long>::max() << (unsigned char)200 << QString("a b");
+      }
+      // Shortest representations
+      QVERIFY(array.startsWith("Into Txt 1 0 0.1 0.3333333333333333 1e+300 -inf 0.1 "));
+
+      QBuffer buffer(&array);
+      buffer.open(QIODevice::ReadOnly);
+      PiiTextInputArchive ia(&buffer);
+      double d1, d2, d3, d4;
+      float f;
+      int i;
+      long long ll;
+      unsigned long long ull;
+      unsigned char uc;
+      QString str;
+      ia >> d1 >> d2 >> d3 >> d4 >> f >> i >> ll >> ull >> uc >> str;
+      QCOMPARE(d1, 0.1);
+      QVERIFY(d2 == dThird);
+      QCOMPARE(d3, 1e300);
+      QVERIFY(d4 == -dInf);
+      QCOMPARE(f, 0.1f);
+      QCOMPARE(i, std::numeric_limits<int>::min());
+      QCOMPARE(ll, std::numeric_limits<long long>::max());
+      QCOMPARE(ull, std::numeric_limits<unsigned long long>::max());
+      QCOMPARE(int(uc), 200);
+      QCOMPARE(str, QString("a b"));
+    }
+  catch (PiiSerializationException& ex)
+    {
+      QFAIL(qPrintable(ex.message()));
+    }
+}
 
+void TestPiiSerialization::pointerGraph()
+{
+  // Each object is saved twice: first by pointer, then by reference
+  // to the first occurrence.
+  QList<Base*> lstObjects;
+  for (int i=0; i<1000; ++i)
+    lstObjects << new Derived;
+  lstObjects << lstObjects;
+
+  QByteArray array;
+  QBuffer buffer(&array);
+  buffer.open(QIODevice::ReadWrite);
+  try
+    {
+      {
+        PiiGenericBinaryOutputArchive oa(&buffer);
+        oa.reservePointers(500); // forces rehashing
+        oa << lstObjects;
+      }
+      buffer.seek(0);
+      QList<Base*> lstRestored;
+      {
+        PiiGenericBinaryInputArchive ia(&buffer);
+        ia.reservePointers(1000);
+        ia >> lstRestored;
+      }
+      QCOMPARE(lstRestored.size(), 2000);
+      for (int i=0; i<1000; ++i)
+        {
+          QVERIFY(lstRestored[i] != 0);
+          QCOMPARE(lstRestored[i]->type(), 1);
+          QCOMPARE(lstRestored[i]->constructionType, Base::ConstructedBySerialization);
+          QVERIFY(lstRestored[i] == lstRestored[i+1000]);
+          if (i > 0)
+            QVERIFY(lstRestored[i] != lstRestored[i-1]);
+        }
+      qDeleteAll(lstRestored.mid(0, 1000));
+    }
+  catch (PiiSerializationException& ex)
+    {
+      QFAIL(qPrintable(ex.message() + " (" + ex.info() + ")"));
+    }
+  qDeleteAll(lstObjects.mid(0, 1000));
+}
+
+QTEST_MAIN(TestPiiSerialization)
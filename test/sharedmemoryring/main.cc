@@ -0,0 +1,153 @@
+/* This file is part of Into.
+ * Copyright (C) Intopii 2013.
+ * All rights reserved.
+ *
+ * Licensees holding a commercial Into license may use this file in
+ * accordance with the commercial license agreement. Please see
+ * LICENSE.commercial for commercial licensing terms.
+ *
+ * Alternatively, this file may be used under the terms of the GNU
+ * Affero General Public License version 3 as published by the Free
+ * Software Foundation. In addition, Intopii gives you special rights
+ * to use Into as a part of open source software projects. Please
+ * refer to LICENSE.AGPL3 for details.
+ */
+
+
+#include "TestPiiSharedMemoryRing.h"
+
+#include <PiiSharedMemoryRing.h>
+#include <PiiColor.h>
+#include <QtTest>
+
+#ifndef Q_OS_WIN
+#  include <sys/types.h>
+#  include <sys/wait.h>
+#  include <unistd.h>
+#endif
+
+void TestPiiSharedMemoryRing::storeAndLoad()
+{
+  PiiSharedMemoryRing producer("TestPiiSharedMemoryRing_storeAndLoad");
+  producer.create(2, 1000);
+  QCOMPARE(producer.slotCount(), 2);
+  QCOMPARE(producer.slotSize(), 1024);
+
+  PiiSharedMemoryRing consumer("TestPiiSharedMemoryRing_storeAndLoad");
+  consumer.attach();
+  QCOMPARE(consumer.slotCount(), 2);
+
+  PiiMatrix<int> matBig(4,5);
+  for (int i=0; i<20; ++i)
+    matBig(i/5, i%5) = i;
+  // Non-contiguous source
+  PiiMatrix<int> matSource(matBig(1,1,2,3));
+  QByteArray aHandle(producer.store(PiiVariant(matSource)));
+  QVERIFY(PiiSharedMemoryRing::isHandle(aHandle));
+
+  PiiVariant varLoaded(consumer.load(aHandle));
+  QCOMPARE(varLoaded.type(), unsigned(PiiYdin::IntMatrixType));
+  QVERIFY(Pii::equals(varLoaded.valueAs<PiiMatrix<int> >(), matSource));
+
+  PiiMatrix<PiiColor4<> > matColor(2,3);
+  matColor(1,2) = PiiColor4<>(1,2,3,4);
+  varLoaded = consumer.load(producer.store(PiiVariant(matColor)));
+  QCOMPARE(varLoaded.type(), unsigned(PiiYdin::UnsignedCharColor4MatrixType));
+  QVERIFY(varLoaded.valueAs<PiiMatrix<PiiColor4<> > >()(1,2) == PiiColor4<>(1,2,3,4));
+}
+
+void TestPiiSharedMemoryRing::slotRecycling()
+{
+  PiiSharedMemoryRing ring("TestPiiSharedMemoryRing_slotRecycling");
+  ring.create(1, 64);
+  PiiVariant varMatrix(PiiMatrix<char>(8,8));
+
+  QByteArray aHandle(ring.store(varMatrix));
+  QVERIFY(!aHandle.isEmpty());
+  // The only slot is reserved.
+  QVERIFY(ring.store(varMatrix).isEmpty());
+  {
+    PiiVariant varLoaded(ring.load(aHandle));
+    QVERIFY(varLoaded.isValid());
+    // A handle can be loaded only once.
+    QVERIFY(!ring.load(aHandle).isValid());
+    QVERIFY(ring.store(varMatrix).isEmpty());
+  }
+  // The loaded matrix has been released.
+  QVERIFY(!ring.store(varMatrix).isEmpty());
+}
+
+void TestPiiSharedMemoryRing::staleHandle()
+{
+  PiiSharedMemoryRing ring("TestPiiSharedMemoryRing_staleHandle");
+  ring.create(1, 64);
+  ring.setLeaseTime(0);
+  PiiVariant varMatrix(PiiMatrix<char>(1,1));
+
+  QByteArray aHandle(ring.store(varMatrix));
+  QTest::qWait(10);
+  // The lease has expired, and the slot can be reused.
+  QByteArray aNewHandle(ring.store(varMatrix));
+  QVERIFY(!aNewHandle.isEmpty());
+  QVERIFY(!ring.load(aHandle).isValid());
+  QVERIFY(ring.load(aNewHandle).isValid());
+}
+
+void TestPiiSharedMemoryRing::deadReceiver()
+{
+#ifdef Q_OS_WIN
+#  if QT_VERSION < 0x050000
+  QSKIP("Needs fork()", SkipAll);
+#  else
+  QSKIP("Needs fork()");
+#  endif
+#else
+  PiiSharedMemoryRing ring("TestPiiSharedMemoryRing_deadReceiver");
+  ring.create(1, 64);
+  PiiVariant varMatrix(PiiMatrix<char>(1,1));
+
+  QByteArray aHandle(ring.store(varMatrix));
+  QVERIFY(!aHandle.isEmpty());
+  // The child inherits the mapping, loads the matrix and exits
+  // without releasing it.
+  pid_t iChild = fork();
+  if (iChild == 0)
+    {
+      new PiiVariant(ring.load(aHandle));
+      _exit(0);
+    }
+  QVERIFY(iChild > 0);
+  int iStatus = 0;
+  QCOMPARE(waitpid(iChild, &iStatus, 0), iChild);
+
+  // The slot was loaded by a process that no longer exists.
+  QVERIFY(!ring.load(aHandle).isValid());
+  QByteArray aNewHandle(ring.store(varMatrix));
+  QVERIFY(!aNewHandle.isEmpty());
+  {
+    PiiVariant varLoaded(ring.load(aNewHandle));
+    QVERIFY(varLoaded.isValid());
+    // A live receiver keeps its slot.
+    QVERIFY(ring.store(varMatrix).isEmpty());
+  }
+  QVERIFY(!ring.store(varMatrix).isEmpty());
+#endif
+}
+
+void TestPiiSharedMemoryRing::rejectedObjects()
+{
+  PiiSharedMemoryRing ring("TestPiiSharedMemoryRing_rejectedObjects");
+  ring.create(1, 64);
+  QVERIFY(ring.store(PiiVariant(3)).isEmpty());
+  QVERIFY(ring.store(PiiVariant(PiiMatrix<double>(3,3))).isEmpty());
+  QVERIFY(!PiiSharedMemoryRing::isHandle("foo"));
+
+  try
+    {
+      ring.load("foo");
+      QFAIL("Loading an invalid handle did not throw.");
+    }
+  catch (PiiException&) {}
+}
+
+QTEST_MAIN(TestPiiSharedMemoryRing)
@@ -26,6 +26,8 @@ private slots:
   void allocation();
   void externalBuffer();
   void overriddenNewDelete();
+  void threadCache();
+  void concurrentAllocation();
 };
 
 
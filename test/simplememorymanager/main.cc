@@ -17,7 +17,9 @@
 
 #include <PiiSimpleMemoryManager.h>
 #include <PiiBits.h>
+#include <PiiAsyncCall.h>
 #include <QtTest>
+#include <QSet>
 #include <cstdlib>
 
 void TestPiiSimpleMemoryManager::allocation()
@@ -122,4 +124,96 @@ void TestPiiSimpleMemoryManager::overriddenNewDelete()
     }
 }
 
+void TestPiiSimpleMemoryManager::threadCache()
+{
+  PiiSimpleMemoryManager manager(64*32, 64-sizeof(void*), 4);
+  QCOMPARE(manager.cacheSize(), 4);
+  QSet<void*> setBuffers;
+  for (unsigned i=0; i<manager.blockCount(); ++i)
+    {
+      void* pBuffer = manager.allocate(10);
+      QVERIFY(pBuffer != 0);
+      setBuffers << pBuffer;
+    }
+  QCOMPARE(ulong(setBuffers.size()), manager.blockCount());
+  QVERIFY(!manager.allocate(10));
+  // Released blocks are reused in LIFO order, also through the cache.
+  void* pLast = *setBuffers.begin();
+  QVERIFY(manager.deallocate(pLast));
+  QCOMPARE(manager.allocate(10), pLast);
+  // Overflowing the cache moves blocks back to the shared stack.
+  foreach (void* pBuffer, setBuffers)
+    QVERIFY(manager.deallocate(pBuffer));
+  for (unsigned i=0; i<manager.blockCount(); ++i)
+    QVERIFY(manager.allocate(10) != 0);
+  QVERIFY(!manager.allocate(10));
+}
+
+namespace
+{
+  struct Allocator
+  {
+    Allocator(PiiSimpleMemoryManager* manager, int id) : pManager(manager), iId(id), bOk(true) {}
+
+    void run()
+    {
+      QList<int*> lstBuffers;
+      for (int i=0; i<20000; ++i)
+        {
+          if (i % 3 != 2 && lstBuffers.size() < 100)
+            {
+              int* pBuffer = static_cast<int*>(pManager->allocate(sizeof(int)));
+              if (pBuffer != 0)
+                {
+                  *pBuffer = iId;
+                  lstBuffers << pBuffer;
+                }
+            }
+          else if (!lstBuffers.isEmpty())
+            {
+              int* pBuffer = lstBuffers.takeLast();
+              // Someone else may have scribbled the block.
+              if (*pBuffer != iId)
+                bOk = false;
+              pManager->deallocate(pBuffer);
+            }
+        }
+      foreach (int* pBuffer, lstBuffers)
+        pManager->deallocate(pBuffer);
+    }
+
+    PiiSimpleMemoryManager* pManager;
+    int iId;
+    bool bOk;
+  };
+}
+
+void TestPiiSimpleMemoryManager::concurrentAllocation()
+{
+  for (int iCacheSize=0; iCacheSize<=16; iCacheSize += 16)
+    {
+      PiiSimpleMemoryManager manager(64*512, 64-sizeof(void*), iCacheSize);
+      QList<Allocator*> lstAllocators;
+      QList<QThread*> lstThreads;
+      for (int i=0; i<4; ++i)
+        {
+          lstAllocators << new Allocator(&manager, i);
+          lstThreads << Pii::createAsyncCall(lstAllocators.last(), &Allocator::run);
+          lstThreads.last()->start();
+        }
+      for (int i=0; i<lstThreads.size(); ++i)
+        {
+          lstThreads[i]->wait();
+          QVERIFY(lstAllocators[i]->bOk);
+        }
+      qDeleteAll(lstThreads);
+      qDeleteAll(lstAllocators);
+      // Exiting threads must have returned their caches.
+      QSet<void*> setBuffers;
+      while (void* pBuffer = manager.allocate(10))
+        setBuffers << pBuffer;
+      QCOMPARE(ulong(setBuffers.size()), manager.blockCount());
+    }
+}
+
 QTEST_MAIN(TestPiiSimpleMemoryManager)
@@ -33,6 +33,14 @@ private slots:
   void proxyLoop();
   void connectedInputs();
   void root();
+  void flattenedEmission();
+  void detachedProxy();
+  void latencyTags();
+  void shiftBatch();
+  void overloadPolicy_data();
+  void overloadPolicy();
+  void maxQueueTime();
+  void memoryBudget();
 
 private:
   PiiOutputSocket a;
@@ -14,6 +14,10 @@
  */
 
 #include "TestPiiSocket.h"
+#include <PiiYdinTypes.h>
+#include <PiiNullInputController.h>
+#include <PiiMemoryBudget.h>
+#include <PiiMatrix.h>
 #include <QtTest>
 
 TestPiiSocket::TestPiiSocket() :
@@ -98,4 +102,308 @@ void TestPiiSocket::root()
   QCOMPARE(PiiProxySocket::root(&a), &a);
 }
 
+namespace
+{
+  struct CountingController : PiiInputController
+  {
+    CountingController() : iCount(0) {}
+    bool tryToReceive(PiiAbstractInputSocket*, const PiiVariant&) throw () { ++iCount; return true; }
+    int iCount;
+  };
+}
+
+void TestPiiSocket::flattenedEmission()
+{
+  CountingController controller;
+  b.setController(&controller);
+  e.setController(&controller);
+  h.setController(&controller);
+
+  // Inputs behind proxies are fed and listened to directly.
+  a.emitObject(PiiVariant(1));
+  QCOMPARE(controller.iCount, 3);
+  QVERIFY(b.listener() != 0);
+  QCOMPARE(h.listener(), b.listener());
+  QCOMPARE(e.listener(), b.listener());
+
+  // Reconnecting inside a proxy chain updates the root output.
+  g.output()->disconnectInput(&h);
+  a.emitObject(PiiVariant(2));
+  QCOMPARE(controller.iCount, 5);
+  QVERIFY(h.listener() == 0);
+  g.output()->connectInput(&h);
+  a.emitObject(PiiVariant(3));
+  QCOMPARE(controller.iCount, 8);
+
+  b.setController(PiiNullInputController::instance());
+  e.setController(PiiNullInputController::instance());
+  h.setController(PiiNullInputController::instance());
+}
+
+void TestPiiSocket::detachedProxy()
+{
+  PiiOutputSocket* pRoot = new PiiOutputSocket("root");
+  PiiProxySocket proxy;
+  PiiInputSocket input("input");
+  pRoot->connectInput(proxy.input());
+  proxy.output()->connectInput(&input);
+  QVERIFY(input.listener() != 0);
+
+  // The root no longer reaches the input.
+  pRoot->disconnectInput(proxy.input());
+  QVERIFY(input.listener() == 0);
+  delete pRoot;
+  QVERIFY(input.listener() == 0);
+
+  // A new root takes over.
+  PiiOutputSocket root("root");
+  root.connectInput(proxy.input());
+  QVERIFY(input.listener() != 0);
+  proxy.output()->disconnectInput(&input);
+  QVERIFY(input.listener() == 0);
+}
+
+namespace
+{
+  struct StoringController : PiiInputController
+  {
+    bool tryToReceive(PiiAbstractInputSocket* sender, const PiiVariant& object) throw ()
+    {
+      static_cast<PiiInputSocket*>(sender)->receive(object);
+      return true;
+    }
+  };
+}
+
+void TestPiiSocket::latencyTags()
+{
+  StoringController controller;
+  PiiInputSocket* inputs[] = { &b, &e, &h };
+  for (int i=0; i<3; ++i)
+    inputs[i]->setController(&controller);
+
+  PiiLatencyTag::setEnabled(true);
+  // A source stamps a new tag, which survives the proxies.
+  a.emitObject(PiiVariant(1));
+  for (int i=0; i<3; ++i)
+    inputs[i]->shift();
+  PiiLatencyTag tag(h.firstLatencyTag());
+  QVERIFY(tag.isValid());
+  QVERIFY(tag.stageTime() >= tag.captureTime());
+  QCOMPARE(b.firstLatencyTag().sequenceId(), tag.sequenceId());
+  QCOMPARE(h.latencyHistogram().count(), 1);
+  QCOMPARE(h.stageLatencyHistogram().count(), 1);
+
+  {
+    // Objects emitted while processing inherit the current tag.
+    PiiLatencyTag::Scope scope(tag);
+    a.emitObject(PiiVariant(2));
+  }
+  for (int i=0; i<3; ++i)
+    inputs[i]->shift();
+  QCOMPARE(h.firstLatencyTag().sequenceId(), tag.sequenceId());
+  QCOMPARE(h.firstLatencyTag().captureTime(), tag.captureTime());
+  QVERIFY(h.firstLatencyTag().stageTime() >= tag.stageTime());
+  QVERIFY(!PiiLatencyTag::current().isValid());
+
+  a.emitObject(PiiVariant(3));
+  for (int i=0; i<3; ++i)
+    inputs[i]->shift();
+  QVERIFY(h.firstLatencyTag().sequenceId() != tag.sequenceId());
+  QCOMPARE(h.latencyHistogram().count(), 3);
+
+  // Control objects are tagged but not measured.
+  a.emitObject(PiiVariant(0, PiiYdin::StopTagType));
+  for (int i=0; i<3; ++i)
+    inputs[i]->shift();
+  QVERIFY(h.firstLatencyTag().isValid());
+  QCOMPARE(h.latencyHistogram().count(), 3);
+
+  PiiLatencyTag::setEnabled(false);
+  a.emitObject(PiiVariant(4));
+  for (int i=0; i<3; ++i)
+    inputs[i]->shift();
+  QVERIFY(!h.firstLatencyTag().isValid());
+  QCOMPARE(h.latencyHistogram().count(), 3);
+
+  h.resetProfile();
+  QCOMPARE(h.latencyHistogram().count(), 0);
+  for (int i=0; i<3; ++i)
+    {
+      inputs[i]->setController(PiiNullInputController::instance());
+      inputs[i]->reset();
+    }
+}
+
+void TestPiiSocket::shiftBatch()
+{
+  PiiInputSocket input("input");
+  input.setQueueCapacity(8);
+  for (int i=0; i<5; ++i)
+    input.receive(PiiVariant(i));
+  input.receive(PiiVariant(0, PiiYdin::StopTagType));
+  input.receive(PiiVariant(5));
+
+  QCOMPARE(input.shiftBatch(3), 3);
+  QCOMPARE(input.batchSize(), 3);
+  QCOMPARE(input.firstObject().valueAs<int>(), 0);
+  for (int i=0; i<3; ++i)
+    QCOMPARE(input.batchObject(i).valueAs<int>(), i);
+  QCOMPARE(input.queueLength(), 4);
+
+  // The control object ends the batch.
+  QCOMPARE(input.shiftBatch(8), 2);
+  QCOMPARE(input.batchObject(1).valueAs<int>(), 4);
+  QCOMPARE(input.queuedType(0), (unsigned int)PiiYdin::StopTagType);
+
+  input.shift();
+  QCOMPARE(input.batchSize(), 1);
+  QCOMPARE(input.shiftBatch(8), 1);
+  QCOMPARE(input.firstObject().valueAs<int>(), 5);
+  QCOMPARE(input.queueLength(), 0);
+}
+
+void TestPiiSocket::overloadPolicy_data()
+{
+  QTest::addColumn<int>("policy");
+  QTest::addColumn<bool>("accepted");
+  QTest::addColumn<QVariantList>("queue");
+  QTest::addColumn<int>("dropped");
+
+  QTest::newRow("block") << int(PiiInputSocket::BlockWhenFull) << false << (QVariantList() << 0 << -1 << 1) << 0;
+  QTest::newRow("newest") << int(PiiInputSocket::DropNewest) << true << (QVariantList() << 0 << -1 << 1) << 1;
+  QTest::newRow("oldest") << int(PiiInputSocket::DropOldest) << true << (QVariantList() << -1 << 1 << 2) << 1;
+  QTest::newRow("latest") << int(PiiInputSocket::KeepLatest) << true << (QVariantList() << -1 << 2) << 2;
+}
+
+void TestPiiSocket::overloadPolicy()
+{
+  QFETCH(int, policy);
+  QFETCH(bool, accepted);
+  QFETCH(QVariantList, queue);
+  QFETCH(int, dropped);
+
+  PiiInputSocket input("input");
+  input.setQueueCapacity(3);
+  input.setOverloadPolicy(PiiInputSocket::OverloadPolicy(policy));
+  QVERIFY(input.tryReceive(PiiVariant(0)));
+  QVERIFY(input.tryReceive(PiiVariant(0, PiiYdin::StopTagType)));
+  QVERIFY(input.tryReceive(PiiVariant(1)));
+
+  // Control objects are never dropped.
+  QVERIFY(!input.tryReceive(PiiVariant(0, PiiYdin::StopTagType)));
+  QCOMPARE(input.tryReceive(PiiVariant(2)), accepted);
+  QCOMPARE(input.droppedObjectCount(), dropped);
+  QCOMPARE(input.rejectedObjectCount(), accepted ? 1 : 2);
+
+  QCOMPARE(input.queueLength(), queue.size());
+  for (int i=0; i<queue.size(); ++i)
+    {
+      if (queue[i].toInt() == -1)
+        QCOMPARE(input.queuedType(i), (unsigned int)PiiYdin::StopTagType);
+      else
+        QCOMPARE(input.queuedObject(i).valueAs<int>(), queue[i].toInt());
+    }
+  // The queue must still work as a ring buffer.
+  for (int i=0; i<queue.size(); ++i)
+    input.shift();
+  QVERIFY(input.tryReceive(PiiVariant(3)));
+  input.shift();
+  QCOMPARE(input.firstObject().valueAs<int>(), 3);
+
+  input.resetProfile();
+  QCOMPARE(input.droppedObjectCount(), 0);
+}
+
+void TestPiiSocket::maxQueueTime()
+{
+  PiiInputSocket input("input");
+  input.setMaxQueueTime(1000);
+  QCOMPARE(input.maxQueueTime(), 1000);
+  input.receive(PiiVariant(1));
+  input.shift();
+  QVERIFY(!input.isFirstObjectLate());
+
+  input.setMaxQueueTime(10);
+  input.receive(PiiVariant(2));
+  input.receive(PiiVariant(0, PiiYdin::StopTagType));
+  QTest::qSleep(30);
+  input.shift();
+  QVERIFY(input.isFirstObjectLate());
+  QCOMPARE(input.lateObjectCount(), 1);
+  // Control objects are never late.
+  input.shift();
+  QVERIFY(!input.isFirstObjectLate());
+  QCOMPARE(input.lateObjectCount(), 1);
+}
+
+namespace
+{
+  struct CountingListener : PiiInputListener
+  {
+    CountingListener() : iCount(0) {}
+    void inputReady(PiiAbstractInputSocket*) { ++iCount; }
+    int iCount;
+  };
+}
+
+void TestPiiSocket::memoryBudget()
+{
+  PiiVariant varMatrix(PiiMatrix<int>(100, 100));
+  const qint64 lBytes = varMatrix.memoryUsage();
+  // Leave room for small control objects.
+  PiiMemoryBudget budget(2 * lBytes + 1024);
+  CountingListener listener;
+
+  PiiInputSocket input1("input1"), input2("input2");
+  input1.setQueueCapacity(4);
+  input1.setListener(&listener);
+  input1.setMemoryBudget(&budget);
+  input2.setMemoryBudget(&budget);
+
+  QVERIFY(input1.tryReceive(varMatrix));
+  QVERIFY(input2.tryReceive(varMatrix));
+  QCOMPARE(budget.usage(), 2 * lBytes);
+  QVERIFY(budget.isUnderPressure());
+
+  // The budget is exhausted: the queue has room, but the object is
+  // rejected.
+  QVERIFY(!input1.tryReceive(varMatrix));
+  QCOMPARE(input1.rejectedObjectCount(), 1);
+  QCOMPARE(budget.rejectionCount(), 1);
+  // Releasing memory in another input wakes up the waiting sender.
+  input2.shift();
+  QCOMPARE(listener.iCount, 1);
+  QCOMPARE(budget.usage(), lBytes);
+  QCOMPARE(budget.peakUsage(), 2 * lBytes);
+
+  // Control objects and objects arriving at an empty queue are
+  // always accepted.
+  QVERIFY(input1.tryReceive(PiiVariant(0, PiiYdin::StopTagType)));
+  QCOMPARE(budget.usage(), input1.queuedBytes());
+  QVERIFY(input2.tryReceive(varMatrix));
+  QVERIFY(budget.usage() > 2 * lBytes);
+  QVERIFY(!input1.tryReceive(varMatrix));
+  input2.shift();
+  QCOMPARE(listener.iCount, 2);
+  QVERIFY(input1.tryReceive(varMatrix));
+  QCOMPARE(input1.queueLength(), 3);
+
+  // Other policies drop.
+  input1.setOverloadPolicy(PiiInputSocket::DropNewest);
+  QVERIFY(input1.tryReceive(varMatrix));
+  QCOMPARE(input1.droppedObjectCount(), 1);
+  QCOMPARE(input1.queueLength(), 3);
+
+  input1.shift();
+  QCOMPARE(budget.usage(), input1.queuedBytes());
+  input1.reset();
+  QCOMPARE(budget.usage(), qint64(0));
+  QCOMPARE(input1.queuedBytes(), qint64(0));
+
+  QVERIFY(input2.tryReceive(varMatrix));
+  input2.setMemoryBudget(0);
+  QCOMPARE(budget.usage(), qint64(0));
+}
+
 QTEST_MAIN(TestPiiSocket)
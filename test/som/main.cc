@@ -0,0 +1,62 @@
+/* This file is part of Into.
+ * Copyright (C) Intopii 2013.
+ * All rights reserved.
+ *
+ * Licensees holding a commercial Into license may use this file in
+ * accordance with the commercial license agreement. Please see
+ * LICENSE.commercial for commercial licensing terms.
+ *
+ * Alternatively, this file may be used under the terms of the GNU
+ * Affero General Public License version 3 as published by the Free
+ * Software Foundation. In addition, Intopii gives you special rights
+ * to use Into as a part of open source software projects. Please
+ * refer to LICENSE.AGPL3 for details.
+ */
+
+#include "TestPiiSom.h"
+#include <PiiSom.h>
+#include <PiiRandom.h>
+
+#include <QtTest>
+
+void TestPiiSom::batchLearning()
+{
+  // Four clusters at the corners of a square
+  PiiMatrix<double> matSamples(400, 2);
+  Pii::seedRandom(1);
+  for (int i=0; i<matSamples.rows(); ++i)
+    {
+      matSamples(i,0) = (i & 1) * 10 + 0.3 * Pii::normalRandom();
+      matSamples(i,1) = (i & 2) * 5 + 0.3 * Pii::normalRandom();
+    }
+
+  PiiMatrix<double> matModels[2];
+  for (int i=0; i<2; ++i)
+    {
+      PiiSom<PiiMatrix<double> > som(4, 4);
+      som.setLearningAlgorithm(PiiClassification::SomBatchAlgorithm);
+      som.setInitialRadius(3);
+      som.setLearningLength(20 * matSamples.rows());
+      // The initial code book is selected randomly.
+      Pii::seedRandom(2);
+      som.learn(Pii::ParallelExecution(i == 0 ? 1 : 4), matSamples, QVector<double>());
+      QVERIFY(som.converged());
+      QCOMPARE(som.iterationNumber(), som.learningLength());
+      QCOMPARE(som.modelCount(), 16);
+      matModels[i] = som.models();
+    }
+  // The result must not depend on the number of threads.
+  QVERIFY(Pii::equals(matModels[0], matModels[1]));
+
+  // Each cluster must have a code vector close to its center.
+  PiiSquaredGeometricDistance<const double*> measure;
+  for (int i=0; i<4; ++i)
+    {
+      PiiMatrix<double> matCenter(1, 2, (i & 1) * 10.0, (i & 2) * 5.0);
+      double dDistance;
+      PiiClassification::findClosestMatch(matCenter[0], matModels[0], measure, &dDistance);
+      QVERIFY(dDistance < 1.0);
+    }
+}
+
+QTEST_MAIN(TestPiiSom)
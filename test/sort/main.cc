@@ -0,0 +1,127 @@
+/* This file is part of Into.
+ * Copyright (C) Intopii 2013.
+ * All rights reserved.
+ *
+ * Licensees holding a commercial Into license may use this file in
+ * accordance with the commercial license agreement. Please see
+ * LICENSE.commercial for commercial licensing terms.
+ *
+ * Alternatively, this file may be used under the terms of the GNU
+ * Affero General Public License version 3 as published by the Free
+ * Software Foundation. In addition, Intopii gives you special rights
+ * to use Into as a part of open source software projects. Please
+ * refer to LICENSE.AGPL3 for details.
+ */
+
+
+#include "TestPiiSort.h"
+
+#include <PiiSort.h>
+#include <PiiRandom.h>
+#include <QtTest>
+
+void TestPiiSort::selectSmallest()
+{
+  QVector<int> vecValues;
+  for (int i=0; i<100; ++i)
+    vecValues << (i * 37) % 100;
+  Pii::selectSmallest(vecValues.begin(), vecValues.end(), 5);
+  for (int i=0; i<5; ++i)
+    QCOMPARE(vecValues[i], i);
+
+  Pii::selectSmallest(vecValues.begin(), vecValues.end(), 3, std::greater<int>());
+  QCOMPARE(vecValues[0], 99);
+  QCOMPARE(vecValues[1], 98);
+  QCOMPARE(vecValues[2], 97);
+
+  // k larger than the range sorts everything
+  QVector<int> vecSmall;
+  vecSmall << 3 << 1 << 2;
+  Pii::selectSmallest(vecSmall.begin(), vecSmall.end(), 10);
+  QCOMPARE(vecSmall, QVector<int>() << 1 << 2 << 3);
+}
+
+void TestPiiSort::quantiles()
+{
+  PiiMatrix<float> matValues(2,5,
+                             5.0, 3.0, 9.0, 1.0, 7.0,
+                             2.0, 8.0, 4.0, 6.0, 10.0);
+  QCOMPARE(Pii::quantile(matValues, 0.5), 5.0f);
+  QCOMPARE(Pii::quantile(matValues, 0.0), 1.0f);
+  QCOMPARE(Pii::quantile(matValues, 1.0), 10.0f);
+  QVERIFY(Pii::equals(Pii::quantiles(matValues, PiiMatrix<double>(1,4, 0.91, 0.25, 0.5, 0.1)),
+                      PiiMatrix<float>(1,4, 10.0, 3.0, 5.0, 1.0)));
+  QCOMPARE(Pii::quantile(PiiMatrix<int>(), 0.5), 0);
+}
+
+template <class T> static bool radixSortsCorrectly(int count, double scale, double offset)
+{
+  std::vector<T> vecValues(count);
+  for (int i=0; i<count; ++i)
+    vecValues[i] = T(Pii::uniformRandom() * scale - offset);
+  std::vector<T> vecSorted(vecValues);
+  std::sort(vecSorted.begin(), vecSorted.end());
+  Pii::radixSort(&vecValues[0], &vecValues[0] + count);
+  return vecValues == vecSorted;
+}
+
+void TestPiiSort::radixSort()
+{
+  Pii::seedRandom(1);
+  QVERIFY(radixSortsCorrectly<unsigned char>(1001, 256, 0));
+  QVERIFY(radixSortsCorrectly<signed char>(1001, 256, 128));
+  QVERIFY(radixSortsCorrectly<short>(5000, 65535, 32768));
+  QVERIFY(radixSortsCorrectly<int>(10000, 4e9, 2e9));
+  QVERIFY(radixSortsCorrectly<unsigned int>(10000, 4e9, 0));
+  QVERIFY(radixSortsCorrectly<long long>(10000, 1e18, 5e17));
+  QVERIFY(radixSortsCorrectly<float>(10000, 2e6, 1e6));
+  QVERIFY(radixSortsCorrectly<double>(10000, 2e12, 1e12));
+  QVERIFY(radixSortsCorrectly<int>(1, 10, 0));
+}
+
+void TestPiiSort::parallelSort()
+{
+  Pii::seedRandom(2);
+  // Sizes below and above the chunking limit
+  const int aSizes[] = { 0, 1, 100, 20000, 100001 };
+  for (int s=0; s<5; ++s)
+    {
+      QVector<double> vecValues(aSizes[s]);
+      for (int i=0; i<vecValues.size(); ++i)
+        vecValues[i] = Pii::uniformRandom();
+      QVector<double> vecSorted(vecValues);
+      std::sort(vecSorted.begin(), vecSorted.end());
+      for (int iBands=0; iBands<4; ++iBands)
+        {
+          QVector<double> vecParallel(vecValues);
+          Pii::parallelSort(Pii::ParallelExecution(iBands), vecParallel.begin(), vecParallel.end());
+          QCOMPARE(vecParallel, vecSorted);
+        }
+      Pii::parallelSort(Pii::ParallelExecution(), vecValues.begin(), vecValues.end(), std::greater<double>());
+      std::reverse(vecValues.begin(), vecValues.end());
+      QCOMPARE(vecValues, vecSorted);
+    }
+}
+
+void TestPiiSort::sortRows()
+{
+  PiiMatrix<int> matRows(PiiMatrix<int>::uninitialized(50000, 2));
+  for (int r=0; r<matRows.rows(); ++r)
+    {
+      matRows(r,0) = (r * 7919) % 100;
+      matRows(r,1) = r;
+    }
+  PiiMatrix<int> matSerial(Pii::sortedRows(matRows));
+  QVERIFY(Pii::equals(Pii::sortedRows(Pii::ParallelExecution(), matRows), matSerial));
+  // Stable: equal keys retain their order.
+  for (int r=1; r<matSerial.rows(); ++r)
+    QVERIFY(matSerial(r-1,0) < matSerial(r,0) ||
+            (matSerial(r-1,0) == matSerial(r,0) && matSerial(r-1,1) < matSerial(r,1)));
+
+  PiiMatrix<int> matDescending(matRows);
+  Pii::sortRows(Pii::ParallelExecution(3), matDescending, std::greater<int>(), 1);
+  QCOMPARE(matDescending(0,1), 49999);
+  QCOMPARE(matDescending(49999,1), 0);
+}
+
+QTEST_MAIN(TestPiiSort)
@@ -0,0 +1,84 @@
+/* This file is part of Into.
+ * Copyright (C) Intopii 2013.
+ * All rights reserved.
+ *
+ * Licensees holding a commercial Into license may use this file in
+ * accordance with the commercial license agreement. Please see
+ * LICENSE.commercial for commercial licensing terms.
+ *
+ * Alternatively, this file may be used under the terms of the GNU
+ * Affero General Public License version 3 as published by the Free
+ * Software Foundation. In addition, Intopii gives you special rights
+ * to use Into as a part of open source software projects. Please
+ * refer to LICENSE.AGPL3 for details.
+ */
+
+
+#include "TestPiiSparseHistogram.h"
+#include <PiiSparseHistogram.h>
+#include <PiiMath.h>
+
+#include <QtTest>
+
+void TestPiiSparseHistogram::add()
+{
+  PiiSparseHistogram histogram;
+  QVERIFY(histogram.isEmpty());
+  QCOMPARE(histogram.value(3), 0);
+
+  // Enough distinct keys to force many rehashes. Large keys are
+  // typical of folded multi-dimensional bins.
+  const PiiSparseHistogram::Key iBase = Q_UINT64_C(1) << 40;
+  for (int i=0; i<10000; ++i)
+    histogram.add(iBase + PiiSparseHistogram::Key(i % 1000) * 4096);
+  histogram.add(7, 5);
+  QCOMPARE(histogram.binCount(), 1001);
+  QCOMPARE(histogram.total(), qint64(10005));
+  QCOMPARE(histogram.value(iBase), 10);
+  QCOMPARE(histogram.value(iBase + 999 * 4096), 10);
+  QCOMPARE(histogram.value(iBase + 1), 0);
+  QCOMPARE(histogram.value(7), 5);
+
+  histogram.clear();
+  QVERIFY(histogram.isEmpty());
+  QCOMPARE(histogram.total(), qint64(0));
+  QCOMPARE(histogram.value(7), 0);
+}
+
+void TestPiiSparseHistogram::merge()
+{
+  PiiSparseHistogram histogram1, histogram2(100);
+  for (int i=0; i<50; ++i)
+    {
+      histogram1.add(i);
+      histogram2.add(i + 25, 2);
+    }
+  histogram1 += histogram2;
+  QCOMPARE(histogram1.binCount(), 75);
+  QCOMPARE(histogram1.total(), qint64(150));
+  QCOMPARE(histogram1.value(0), 1);
+  QCOMPARE(histogram1.value(30), 3);
+  QCOMPARE(histogram1.value(74), 2);
+  QCOMPARE(histogram2.binCount(), 50);
+}
+
+void TestPiiSparseHistogram::values()
+{
+  PiiSparseHistogram histogram;
+  histogram.add(9, 2);
+  histogram.add(Q_UINT64_C(1) << 50, 1);
+  histogram.add(1, 5);
+
+  QVector<PiiSparseHistogram::Key> vecBins(histogram.sortedBins());
+  QCOMPARE(vecBins.size(), 3);
+  QCOMPARE(vecBins[0], PiiSparseHistogram::Key(1));
+  QCOMPARE(vecBins[1], PiiSparseHistogram::Key(9));
+  QCOMPARE(vecBins[2], Q_UINT64_C(1) << 50);
+
+  QVERIFY(Pii::equals(histogram.values<int>(vecBins), PiiMatrix<int>(1,3, 5,2,1)));
+  QVERIFY(Pii::equals(histogram.values<double>(vecBins, true), PiiMatrix<double>(1,3, 0.625, 0.25, 0.125)));
+  // The out-of-range bin is ignored.
+  QVERIFY(Pii::equals(histogram.toDense<int>(10), PiiMatrix<int>(1,10, 0,5,0,0,0,0,0,0,0,2)));
+}
+
+QTEST_MAIN(TestPiiSparseHistogram)
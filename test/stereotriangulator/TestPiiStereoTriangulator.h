@@ -24,6 +24,7 @@ class TestPiiStereoTriangulator : public QObject
 
 private slots:
   void calculate3DPoints();
+  void parallelTriangulation();
 };
 
 
@@ -18,6 +18,8 @@
 #include <PiiStereoTriangulator.h>
 #include <PiiCalibration.h>
 #include <PiiMatrixUtil.h>
+#include <PiiRandom.h>
+#include <PiiThreadPool.h>
 #include <iostream>
 #include <QtTest>
 
@@ -81,4 +83,51 @@ void TestPiiStereoTriangulator::calculate3DPoints()
           Pii::sum<double>(Pii::abs(calculatedWorldPoints - originalWorldPoints)));
 }
 
+void TestPiiStereoTriangulator::parallelTriangulation()
+{
+  PiiCalibration::CameraParameters intrinsic(400,400);
+  intrinsic.focalLength = PiiPoint<double>(100,100);
+  PiiCalibration::RelativePosition extrinsic1(PiiVector<double,3>(0.1, 0.1, 0.1),
+                                              PiiVector<double,3>(50.0, 50.0, 50.0));
+  PiiCalibration::RelativePosition extrinsic2(PiiVector<double,3>(-0.1, 0.1, 0.1),
+                                              PiiVector<double,3>(-50.0, 50.0, 50.0));
+  PiiCalibration::RelativePosition extrinsic3(PiiVector<double,3>(0.1, -0.1, 0.1),
+                                              PiiVector<double,3>(50.0, -50.0, 50.0));
+
+  PiiMatrix<double> matWorldPoints(Pii::uniformRandomMatrix(301, 3, 0, 10));
+  QList<PiiMatrix<double> > lstPixels;
+  lstPixels << PiiCalibration::worldToPixelCoordinates(matWorldPoints, extrinsic1, intrinsic)
+            << PiiCalibration::worldToPixelCoordinates(matWorldPoints, extrinsic2, intrinsic)
+            << PiiCalibration::worldToPixelCoordinates(matWorldPoints, extrinsic3, intrinsic);
+  // Point 7 is seen by two cameras only, point 8 by one.
+  lstPixels[1](7,0) = NAN;
+  lstPixels[0](8,1) = NAN;
+  lstPixels[2](8,0) = NAN;
+
+  PiiStereoTriangulator triangulator;
+  triangulator.addCamera(intrinsic, extrinsic1);
+  triangulator.addCamera(intrinsic, extrinsic2);
+  triangulator.addCamera(intrinsic, extrinsic3);
+
+  PiiMatrix<double> matSerial(triangulator.calculate3DPoints(lstPixels));
+  PiiThreadPool pool(3);
+  Pii::ParallelExecution policy(0, &pool);
+  policy.minBandRows = 16;
+  PiiMatrix<double> matParallel(triangulator.calculate3DPoints(policy, lstPixels));
+
+  QCOMPARE(matParallel.rows(), 301);
+  QCOMPARE(matParallel.columns(), 3);
+  QVERIFY(Pii::isNan(matSerial(8,0)));
+  QVERIFY(Pii::isNan(matParallel(8,0)));
+  for (int r=0; r<matSerial.rows(); ++r)
+    for (int c=0; c<3; ++c)
+      if (r != 8)
+        QCOMPARE(matParallel(r,c), matSerial(r,c));
+
+  PiiMatrix<double> matCalculated(PiiCalibration::cameraToWorldCoordinates(matParallel, extrinsic1));
+  for (int c=0; c<3; ++c)
+    matCalculated(8,c) = matWorldPoints(8,c);
+  QVERIFY(Pii::almostEqual(matWorldPoints, matCalculated, 1e-8));
+}
+
 QTEST_MAIN(TestPiiStereoTriangulator)
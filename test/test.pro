@@ -5,11 +5,16 @@ TEMPLATE = subdirs
 SUBDIRS = algorithm \
           bits \
           boosting \
+          bottleneckanalyzer \
+          cacheoperation \
           camera \
           calibration \
+          chunkedsampleset \
           classification \
           color \
           colors \
+          covarianceaccumulator \
+          cpu \
           databasewriter \
           defaultoperation \
           dsp \
@@ -17,6 +22,7 @@ SUBDIRS = algorithm \
           featurecombiner \
           fifo \
           filesystemscanner \
+          filesystemwatcher \
           fileutil \
           functional \
           functionoperation \
@@ -31,44 +37,77 @@ SUBDIRS = algorithm \
           kdtree \
           kerneladatron \
           kernelperceptron \
+          latestvalue \
           lbp \
           lbpoperation \
+          loadbalancer \
+          log \
+          lookuptable \
           matching \
           math \
           matrix \
           matrixcomposer \
           matrixdecompositions \
           matrixutil \
+          memorypool \
+          movingaverage \
+          multiindexhash \
           multipartdecoder \
+          networkreactor \
           operationcompound \
           optimization \
+          orderedmerger \
           perceptron \
           pisooperation \
           planerotation \
           probeinput \
+          productquantizer \
+          profilehistogram \
           qimage \
           quantizer \
+          randomgenerator \
           ransac \
+          rawimagearchive \
           readwritelock \
           remoteobject \
           resourcedatabase \
+          samplebalancer \
+          samplerandomizer \
+          saturatingarithmetic \
           serialization \
+          sharedmemoryring \
           simplememorymanager \
+          som \
+          sort \
+          sparsehistogram \
           socket \
           stereotriangulator \
           stringformatter \
+          threadplacement \
+          tileprocessor \
           timer \
           threadsafetimer \
+          tracer \
           tracking \
           transforms \
+          typedispatcher \
           typetraits \
           universalslot \
           util \
           valueset \
           variant \
+          vectorbatch \
           versionnumber \
           video \
+          waitcondition \
+          websocket \
+          wireformat \
           ydin
 
 include(../qt5.pri)
 qt5: SUBDIRS += qml
+
+# Use "qmake ENABLE=benchmark" to build the ydin throughput and
+# latency benchmarks in benchmark/ and the image kernel benchmarks in
+# kernelbenchmark/.
+contains(ENABLE,benchmark): SUBDIRS += benchmark kernelbenchmark
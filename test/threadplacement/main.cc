@@ -0,0 +1,59 @@
+/* This file is part of Into.
+ * Copyright (C) Intopii 2013.
+ * All rights reserved.
+ *
+ * Licensees holding a commercial Into license may use this file in
+ * accordance with the commercial license agreement. Please see
+ * LICENSE.commercial for commercial licensing terms.
+ *
+ * Alternatively, this file may be used under the terms of the GNU
+ * Affero General Public License version 3 as published by the Free
+ * Software Foundation. In addition, Intopii gives you special rights
+ * to use Into as a part of open source software projects. Please
+ * refer to LICENSE.AGPL3 for details.
+ */
+
+
+#include "TestPiiThreadPlacement.h"
+
+#include <QtTest>
+#include <PiiThreadPlacement.h>
+
+Q_DECLARE_METATYPE(QList<int>)
+
+void TestPiiThreadPlacement::parseCpuList_data()
+{
+  QTest::addColumn<QString>("cpus");
+  QTest::addColumn<QList<int> >("result");
+
+  QTest::newRow("empty") << "" << QList<int>();
+  QTest::newRow("single") << "3" << (QList<int>() << 3);
+  QTest::newRow("range") << "0-3" << (QList<int>() << 0 << 1 << 2 << 3);
+  QTest::newRow("mixed") << "0-1,8, 10-11\n" << (QList<int>() << 0 << 1 << 8 << 10 << 11);
+  QTest::newRow("duplicates") << "1,0-2" << (QList<int>() << 1 << 0 << 2);
+  QTest::newRow("invalid") << "a,2-,-1,4" << (QList<int>() << 4);
+}
+
+void TestPiiThreadPlacement::parseCpuList()
+{
+  QFETCH(QString, cpus);
+  QFETCH(QList<int>, result);
+  QCOMPARE(Pii::parseCpuList(cpus), result);
+}
+
+void TestPiiThreadPlacement::numaNodeCpus()
+{
+  QVERIFY(Pii::numaNodeCount() >= 1);
+  QVERIFY(Pii::numaNodeCpus(-1).isEmpty());
+  QVERIFY(Pii::numaNodeCpus(Pii::numaNodeCount()).isEmpty());
+}
+
+void TestPiiThreadPlacement::setThreadAffinity()
+{
+#ifdef Q_OS_LINUX
+  QVERIFY(Pii::setThreadAffinity(QList<int>() << 0));
+  QVERIFY(Pii::setThreadAffinity(QList<int>()));
+#endif
+}
+
+QTEST_MAIN(TestPiiThreadPlacement)
@@ -0,0 +1,104 @@
+/* This file is part of Into.
+ * Copyright (C) Intopii 2013.
+ * All rights reserved.
+ *
+ * Licensees holding a commercial Into license may use this file in
+ * accordance with the commercial license agreement. Please see
+ * LICENSE.commercial for commercial licensing terms.
+ *
+ * Alternatively, this file may be used under the terms of the GNU
+ * Affero General Public License version 3 as published by the Free
+ * Software Foundation. In addition, Intopii gives you special rights
+ * to use Into as a part of open source software projects. Please
+ * refer to LICENSE.AGPL3 for details.
+ */
+
+#include "TestPiiTileProcessor.h"
+
+#include <PiiTileProcessor.h>
+#include <PiiYdinResources.h>
+#include <QtTest>
+
+void TestPiiTileProcessor::initTestCase()
+{
+  QVERIFY(createOperation("piiimage", "PiiTileProcessor"));
+
+  // 3-by-3 objects on a 64-by-58 image. With 16-by-16 tiles, the
+  // last row of tiles is only ten pixels high, and some objects
+  // extend to two or four tiles. Each tile core contains at most one
+  // centroid, and the centroids are listed in tile order.
+  const int aiCenters[][2] = { {5,5}, {16,7}, {30,30}, {47,17}, {33,50}, {60,54} };
+  _matImage = PiiMatrix<unsigned char>(58, 64);
+  _matCentroids = PiiMatrix<int>(0, 2);
+  for (int i=0; i<6; ++i)
+    {
+      _matImage(aiCenters[i][1] - 1, aiCenters[i][0] - 1, 3, 3) = 255;
+      _matCentroids.appendRow(aiCenters[i][0], aiCenters[i][1]);
+    }
+
+  PiiOperationCompound* pPipeline = new PiiOperationCompound;
+  _pLabeling = PiiYdin::createResource<PiiOperation>("PiiLabelingOperation");
+  QVERIFY(_pLabeling != 0);
+  pPipeline->addOperation(_pLabeling);
+  QVERIFY(pPipeline->exposeInput(_pLabeling->input("image")));
+  QVERIFY(pPipeline->exposeOutput(_pLabeling->output("image")));
+  QVERIFY(pPipeline->exposeOutput(_pLabeling->output("labels")));
+  QVERIFY(pPipeline->exposeOutput(_pLabeling->output("centroids")));
+
+  PiiTileProcessor* pTiles = qobject_cast<PiiTileProcessor*>(operation());
+  QVERIFY(pTiles != 0);
+  pTiles->setPipeline(pPipeline);
+  pTiles->setProperty("tileWidth", 16);
+  pTiles->setProperty("tileHeight", 16);
+  pTiles->setProperty("overlap", 4);
+  pTiles->setProperty("mergeFunctions", QStringList() << "stitch" << "sum" << "concatenate");
+  pTiles->setProperty("positionColumns", QVariantList() << -1 << -1 << 0);
+  QVERIFY(connectInput("image"));
+}
+
+void TestPiiTileProcessor::tiles_data()
+{
+  QTest::addColumn<int>("workerCount");
+  QTest::addColumn<int>("threadCount");
+
+  QTest::newRow("one worker") << 1 << 1;
+  QTest::newRow("three workers") << 3 << 1;
+  QTest::newRow("multi-threaded pipeline") << 3 << 4;
+  QTest::newRow("eight workers") << 8 << 4;
+}
+
+void TestPiiTileProcessor::tiles()
+{
+  QFETCH(int, workerCount);
+  QFETCH(int, threadCount);
+
+  operation()->setProperty("workerCount", workerCount);
+  // Workers are cloned from the pipeline on start.
+  _pLabeling->setProperty("threadCount", threadCount);
+
+  QVERIFY(start());
+  for (int i=0; i<10; ++i)
+    {
+      QVERIFY(sendObject("image", _matImage));
+
+      // The labels are tile-local, but each core must be back in its
+      // place.
+      PiiMatrix<int> matLabels(outputValue("image", PiiMatrix<int>()));
+      QCOMPARE(matLabels.rows(), _matImage.rows());
+      QCOMPARE(matLabels.columns(), _matImage.columns());
+      for (int r=0; r<matLabels.rows(); ++r)
+        for (int c=0; c<matLabels.columns(); ++c)
+          QCOMPARE(matLabels(r,c) != 0, _matImage(r,c) != 0);
+
+      // Every tile counts the objects it sees, including those in its
+      // overlap: 1 + 2 + 4 + 4 + 4 + 1.
+      QCOMPARE(outputValue("labels", 0), 16);
+
+      // Objects seen by many tiles are reported once, by the tile
+      // whose core contains the centroid.
+      QVERIFY(Pii::equals(outputValue("centroids", PiiMatrix<int>()), _matCentroids));
+    }
+  QVERIFY(stop());
+}
+
+QTEST_MAIN(TestPiiTileProcessor)
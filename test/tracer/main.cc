@@ -0,0 +1,91 @@
+/* This file is part of Into.
+ * Copyright (C) Intopii 2013.
+ * All rights reserved.
+ *
+ * Licensees holding a commercial Into license may use this file in
+ * accordance with the commercial license agreement. Please see
+ * LICENSE.commercial for commercial licensing terms.
+ *
+ * Alternatively, this file may be used under the terms of the GNU
+ * Affero General Public License version 3 as published by the Free
+ * Software Foundation. In addition, Intopii gives you special rights
+ * to use Into as a part of open source software projects. Please
+ * refer to LICENSE.AGPL3 for details.
+ */
+
+
+#include "TestPiiTracer.h"
+
+#include <PiiTracer.h>
+#include <QtTest>
+#include <QBuffer>
+
+void TestPiiTracer::disabled()
+{
+  PiiTracer::stop();
+  PiiTracer::clear();
+  {
+    PiiTracer::Scope scope("process", this);
+  }
+  QBuffer buffer;
+  buffer.open(QIODevice::WriteOnly);
+  QCOMPARE(PiiTracer::write(&buffer), 0);
+  QVERIFY(buffer.data().startsWith("{\"traceEvents\":["));
+}
+
+void TestPiiTracer::scope()
+{
+  setObjectName("tracer");
+  PiiTracer::start();
+  QVERIFY(PiiTracer::isEnabled());
+  {
+    PiiTracer::Scope scope("process", this);
+    // Inside a sampled scope
+    PiiTracer::instant("receive", this, 3);
+    {
+      PiiTracer::Scope nested("emit", this);
+    }
+  }
+  // Outside of a scope, instants are not recorded.
+  PiiTracer::instant("receive", this, 4);
+  PiiTracer::stop();
+
+  QBuffer buffer;
+  buffer.open(QIODevice::WriteOnly);
+  QCOMPARE(PiiTracer::write(&buffer), 3);
+  QByteArray aTrace(buffer.data());
+  QVERIFY(aTrace.contains("\"ph\":\"X\""));
+  QVERIFY(aTrace.contains("\"ph\":\"i\""));
+  QVERIFY(aTrace.contains("\"cat\":\"process\""));
+  QVERIFY(aTrace.contains("\"cat\":\"emit\""));
+  QVERIFY(aTrace.contains("\"value\":3"));
+  QVERIFY(!aTrace.contains("\"value\":4"));
+  QVERIFY(aTrace.endsWith("}\n"));
+
+  PiiTracer::clear();
+  buffer.close();
+  buffer.setData(QByteArray());
+  buffer.open(QIODevice::WriteOnly);
+  QCOMPARE(PiiTracer::write(&buffer), 0);
+}
+
+void TestPiiTracer::sampling()
+{
+  PiiTracer::clear();
+  // Sample one 100 ms window out of 1000.
+  PiiTracer::start(1000);
+  int iScopes = 0;
+  QTime time;
+  time.start();
+  while (time.elapsed() < 250)
+    {
+      PiiTracer::Scope scope("process", this);
+      ++iScopes;
+    }
+  PiiTracer::stop();
+  QBuffer buffer;
+  buffer.open(QIODevice::WriteOnly);
+  QVERIFY(PiiTracer::write(&buffer) < iScopes);
+}
+
+QTEST_MAIN(TestPiiTracer)
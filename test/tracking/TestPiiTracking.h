@@ -26,6 +26,9 @@ private slots:
   void testLinkedList();
   void testConstantVelocityTracker();
   void testExtendedCoordinateTracker();
+  void testGating();
+  void testPruneTrajectories();
+  void testNodePool();
 };
 
 
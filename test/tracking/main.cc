@@ -20,6 +20,8 @@
 #include <PiiExtendedCoordinateTracker.h>
 #include <QtTest>
 #include <QtAlgorithms>
+#include <QMap>
+#include <QStringList>
 
 // Creates a branching list of nodes and deletes them.
 void TestPiiTracking::testLinkedList()
@@ -261,4 +263,127 @@ void TestPiiTracking::testExtendedCoordinateTracker()
     }
 }
 
+// Converts each trajectory to a string so that trajectory sets can be
+// compared.
+template <class Tracker> static QStringList trajectoryStrings(const Tracker& tracker)
+{
+  QStringList lstResult;
+  for (int i=0; i<tracker.count(); ++i)
+    {
+      QString strPoints;
+      for (PiiCoordinateTrackerNode<double,2>* node = tracker[i]; node; node = node->next())
+        strPoints += QString(" %1:(%2,%3)").arg(node->time()).arg(node->measurement()[0]).arg(node->measurement()[1]);
+      lstResult << strPoints;
+    }
+  return lstResult;
+}
+
+void TestPiiTracking::testGating()
+{
+  typedef PiiVector<double,2> Point;
+
+  PiiExtendedCoordinateTracker<double,2> gatedTracker, fullTracker;
+  fullTracker.setGatingEnabled(false);
+  QVERIFY(gatedTracker.isGatingEnabled());
+  QVERIFY(!fullTracker.isGatingEnabled());
+
+  PiiExtendedCoordinateTracker<double,2>* trackers[] = { &gatedTracker, &fullTracker };
+  for (int i=0; i<2; ++i)
+    {
+      trackers[i]->setInitialThreshold(30);
+      trackers[i]->setPredictionThreshold(8);
+      trackers[i]->setMaximumStopTime(2);
+    }
+
+  // A grid of objects moving diagonally at slightly different
+  // velocities, plus some missing measurements.
+  for (int t=0; t<8; ++t)
+    {
+      QList<Point> measurements;
+      for (int r=0; r<12; ++r)
+        for (int c=0; c<12; ++c)
+          if ((r*12 + c + t) % 17 != 0)
+            measurements << Point(double(c*8 + t*(2 + c%3)), double(r*8 + t*(1 + r%2)));
+
+      gatedTracker.addMeasurements(measurements, t);
+      fullTracker.addMeasurements(measurements, t);
+
+      QCOMPARE(gatedTracker.count(), fullTracker.count());
+      QCOMPARE(trajectoryStrings(gatedTracker), trajectoryStrings(fullTracker));
+    }
+  QVERIFY(gatedTracker.count() > 0);
+
+  qDeleteAll(gatedTracker);
+  qDeleteAll(fullTracker);
+}
+
+void TestPiiTracking::testPruneTrajectories()
+{
+  typedef PiiVector<int,2> Point;
+
+  PiiConstantVelocityTracker<int,2> tracker;
+  tracker.setInitialThreshold(20);
+  tracker.setPredictionThreshold(200);
+
+  tracker.addMeasurements(QList<Point>() << Point(1,1) << Point(1,2), 0);
+  tracker.addMeasurements(QList<Point>() << Point(2,1) << Point(2,2) << Point(2,3), 1);
+  tracker.addMeasurements(QList<Point>() << Point(3,1) << Point(3,3) << Point(3,5), 2);
+  QCOMPARE(tracker.count(), 2*3*3);
+
+  // Nothing to prune
+  tracker.pruneTrajectories(0);
+  QCOMPARE(tracker.count(), 2*3*3);
+  tracker.pruneTrajectories(6);
+  QCOMPARE(tracker.count(), 2*3*3);
+
+  // Make straight lines the best ones
+  for (int i=0; i<tracker.count(); ++i)
+    {
+      PiiCoordinateTrackerNode<int,2>* node = tracker[i];
+      double dFitness = 0;
+      for (; node->next(); node = node->next())
+        dFitness -= qAbs(node->measurement()[1] - node->next()->measurement()[1]);
+      tracker[i]->setTrajectoryFitness(dFitness);
+    }
+
+  tracker.pruneTrajectories(2);
+  QCOMPARE(tracker.count(), 3*2);
+
+  tracker.pruneTrajectories(1);
+  QCOMPARE(tracker.count(), 3);
+  // One trajectory for each end point, the straightest one
+  QMap<int,double> mapFitness;
+  for (int i=0; i<tracker.count(); ++i)
+    mapFitness.insert(tracker[i]->measurement()[1], tracker[i]->trajectoryFitness());
+  QCOMPARE(mapFitness.size(), 3);
+  QCOMPARE(mapFitness[1], 0.0);
+  QCOMPARE(mapFitness[3], -1.0);
+  QCOMPARE(mapFitness[5], -3.0);
+
+  qDeleteAll(tracker);
+}
+
+// Allocates more nodes than fit into the node pool.
+void TestPiiTracking::testNodePool()
+{
+  typedef PiiCoordinateTrackerNode<int,2> NodeType;
+  const int iCount = PII_TRACKER_NODE_POOL_SIZE + 100;
+  QList<NodeType*> lstNodes;
+  for (int i=0; i<iCount; ++i)
+    lstNodes << new NodeType(PiiVector<int,2>(i, -i), i, 0, i > 0 ? lstNodes[i/2] : 0);
+
+  for (int i=0; i<iCount; ++i)
+    {
+      QCOMPARE(lstNodes[i]->measurement()[0], i);
+      QCOMPARE(lstNodes[i]->time(), i);
+    }
+  QCOMPARE(lstNodes.last()->length(), 15);
+
+  // Leaves are the nodes with no branches. Deleting them releases
+  // the whole tree.
+  for (int i=0; i<iCount; ++i)
+    if (lstNodes[i]->branches() == 0)
+      delete lstNodes[i];
+}
+
 QTEST_MAIN(TestPiiTracking)
@@ -24,7 +24,10 @@ class TestPiiTransforms : public QObject
 
 private slots:
   void linearHough();
+  void linearHoughParallel();
+  void linearHoughGradient();
   void circularHough();
+  void detectCircles();
 };
 
 
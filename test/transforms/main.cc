@@ -227,6 +227,73 @@ void TestPiiTransforms::linearHough()
   */
 }
 
+void TestPiiTransforms::linearHoughParallel()
+{
+  PiiMatrix<int> img(67, 53);
+  for (int i=0; i<300; ++i)
+    img(rand() % img.rows(), rand() % img.columns()) = 1 + rand() % 3;
+
+  PiiHoughTransform hough(1.5, 0.7, 10, 170);
+  Pii::ParallelExecution policy;
+  policy.minBandRows = 4;
+  QVERIFY(Pii::equals(hough.transform<int>(policy, img, Pii::Identity<int>()),
+                      hough.transform<int>(img)));
+}
+
+void TestPiiTransforms::linearHoughGradient()
+{
+  PiiMatrix<int> img(101, 151);
+  PiiMatrix<float> matDirections(101, 151);
+  // Horizontal line, normal at 90 degrees.
+  for (int c=0; c<151; ++c)
+    {
+      img(20,c) = 1;
+      matDirections(20,c) = M_PI/2;
+    }
+  // Vertical line. The gradient points left, which is equivalent to
+  // a normal at zero degrees.
+  for (int r=0; r<101; ++r)
+    {
+      img(r,120) = 1;
+      matDirections(r,120) = -M_PI;
+    }
+
+  PiiHoughTransform hough;
+  PiiMatrix<int> matFull(hough.transform<int>(img));
+  PiiMatrix<int> matDirected(hough.transform<int>(img, matDirections, 3, Pii::Identity<int>()));
+  QCOMPARE(matDirected.rows(), matFull.rows());
+  QCOMPARE(matDirected.columns(), matFull.columns());
+  // Each pixel casts at most seven votes.
+  QVERIFY(Pii::sum<int>(matDirected) <= 251 * 7);
+
+  int r, c;
+  Pii::max(matDirected, &r, &c);
+  int iCenter = matDirected.rows()/2;
+  QCOMPARE(c, 90); // 90 degrees
+  QCOMPARE(r - iCenter, -30); // d is -30
+  // The crossing pixel belongs to the vertical line.
+  QCOMPARE(matDirected(r,c), 150);
+  Pii::max(matDirected(0,0,-1,10), &r, &c);
+  QCOMPARE(c, 0); // 0 degrees
+  QCOMPARE(r - iCenter, 45); // d is 45
+  QCOMPARE(matDirected(r,c), 101);
+
+  // A window of 90 degrees covers all angles.
+  QVERIFY(Pii::equals(hough.transform<int>(img, matDirections, 90, Pii::Identity<int>()), matFull));
+
+  Pii::ParallelExecution policy;
+  policy.minBandRows = 4;
+  QVERIFY(Pii::equals(hough.transform<int>(policy, img, matDirections, 3, Pii::Identity<int>()),
+                      matDirected));
+
+  try
+    {
+      hough.transform<int>(img, PiiMatrix<float>(2,2), 3, Pii::Identity<int>());
+      QFAIL("transform() did not throw an exception on size mismatch");
+    }
+  catch (PiiInvalidArgumentException&) {}
+}
+
 void TestPiiTransforms::circularHough()
 {
   PiiMatrix<int> matImg(9,9,
@@ -266,6 +333,58 @@ void TestPiiTransforms::circularHough()
   QCOMPARE(c, 4);
 }
 
+void TestPiiTransforms::detectCircles()
+{
+  PiiMatrix<int> matImg(100, 120);
+  for (int r=0; r<matImg.rows(); ++r)
+    for (int c=0; c<matImg.columns(); ++c)
+      if (Pii::square(c-40) + Pii::square(r-35) <= 20*20 ||
+          Pii::square(c-90) + Pii::square(r-60) <= 12*12)
+        matImg(r,c) = 255;
+  matImg = PiiImage::filter<int>(matImg, PiiImage::GaussianFilter);
+  PiiMatrix<int> matX(PiiImage::filter<int>(matImg, PiiImage::SobelXFilter)),
+    matY(PiiImage::filter<int>(matImg, PiiImage::SobelYFilter));
+  PiiTransforms::ThresholdSelector select(100);
+
+  // Parallel voting must give the same result as serial.
+  Pii::ParallelExecution policy(4);
+  policy.minBandRows = 4;
+  QVERIFY(Pii::equals(PiiTransforms::circleCenterHough(matX, matY, select, 8, 30),
+                      PiiTransforms::circleCenterHough(policy, matX, matY, select, 8, 30)));
+
+  QList<PiiTransforms::HoughCircle<double> > lstCircles(PiiTransforms::detectCircles(policy, matX, matY,
+                                                                                     select, 8, 30, 10, 2));
+  QCOMPARE(lstCircles.size(), 2);
+  // The larger circle has more support.
+  QCOMPARE(lstCircles[0].x, 40.0);
+  QCOMPARE(lstCircles[0].y, 35.0);
+  QVERIFY(Pii::abs(lstCircles[0].radius - 20) < 1);
+  QCOMPARE(lstCircles[1].x, 90.0);
+  QCOMPARE(lstCircles[1].y, 60.0);
+  QVERIFY(Pii::abs(lstCircles[1].radius - 12) < 1);
+
+  // Bright disks: gradient points towards the center.
+  lstCircles = PiiTransforms::detectCircles(matX, matY, select, 8, 30, 10, 2, 0,
+                                            PiiTransforms::PositiveGradient);
+  QCOMPARE(lstCircles.size(), 2);
+  QCOMPARE(lstCircles[0].x, 40.0);
+  QCOMPARE(lstCircles[1].x, 90.0);
+
+  PiiMatrix<int> matHistogram(PiiTransforms::circleRadiusHistogram(matX, matY, select,
+                                                                   40, 35, 15, 25));
+  QCOMPARE(matHistogram.columns(), 11);
+  int iMaxRow, iMaxColumn;
+  Pii::max(matHistogram, &iMaxRow, &iMaxColumn);
+  QVERIFY(Pii::abs(iMaxColumn + 15 - 20) <= 1);
+
+  PiiMatrix<double> matPoints(PiiTransforms::circleSupport(matX, matY, select, lstCircles[1], 2));
+  QCOMPARE(matPoints.columns(), 2);
+  QVERIFY(matPoints.rows() > 2 * M_PI * 12);
+  for (int i=0; i<matPoints.rows(); ++i)
+    QVERIFY(Pii::abs(Pii::hypotenuse(matPoints(i,0) - 90, matPoints(i,1) - 60) -
+                     lstCircles[1].radius) <= 2);
+}
+
 void TestPiiHoughTransformOperation::initTestCase()
 {
   QVERIFY(createOperation("piitransforms", "PiiHoughTransformOperation"));
@@ -288,7 +407,7 @@ void TestPiiHoughTransformOperation::hough()
   operation()->setProperty("distanceResolution", 1.0);
   operation()->setProperty("results", 2);
 
-  connectAllInputs();
+  QVERIFY(connectInput("image"));
 
   QVERIFY(start());
 
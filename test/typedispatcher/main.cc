@@ -0,0 +1,99 @@
+/* This file is part of Into.
+ * Copyright (C) Intopii 2013.
+ * All rights reserved.
+ *
+ * Licensees holding a commercial Into license may use this file in
+ * accordance with the commercial license agreement. Please see
+ * LICENSE.commercial for commercial licensing terms.
+ *
+ * Alternatively, this file may be used under the terms of the GNU
+ * Affero General Public License version 3 as published by the Free
+ * Software Foundation. In addition, Intopii gives you special rights
+ * to use Into as a part of open source software projects. Please
+ * refer to LICENSE.AGPL3 for details.
+ */
+
+
+#include "TestPiiTypeDispatcher.h"
+
+#include <PiiTypeDispatcher.h>
+#include <QtTest>
+
+typedef unsigned int (*TypeFunction)();
+
+template <class T> static unsigned int primitiveType() { return Pii::typeId<T>(); }
+template <class T> static unsigned int matrixType() { return Pii::typeId<PiiMatrix<T> >(); }
+
+static unsigned int zero() { return 0; }
+
+void TestPiiTypeDispatcher::set()
+{
+  PiiTypeDispatcher<TypeFunction> dispatcher;
+  QVERIFY(!dispatcher.contains(PiiVariant::IntType));
+  QVERIFY(dispatcher[PiiVariant::IntType] == 0);
+  dispatcher.set(PiiVariant::IntType, zero);
+  QVERIFY(dispatcher.contains(PiiVariant::IntType));
+  QVERIFY(dispatcher[PiiVariant::IntType] == zero);
+
+  // Out-of-range IDs are ignored.
+  dispatcher.set(0x666, zero);
+  QVERIFY(!dispatcher.contains(0x666));
+  QVERIFY(dispatcher[PiiVariant::InvalidType] == 0);
+
+  dispatcher.clear();
+  QVERIFY(!dispatcher.contains(PiiVariant::IntType));
+}
+
+void TestPiiTypeDispatcher::numericDispatch()
+{
+  PiiTypeDispatcher<TypeFunction> dispatcher;
+  PII_NUMERIC_DISPATCH(dispatcher, &primitiveType);
+  int iCount = 0;
+  for (unsigned int i=0; i<PiiTypeDispatcher<TypeFunction>::TableSize; ++i)
+    {
+      if (dispatcher.contains(i))
+        {
+          QCOMPARE(dispatcher[i](), i);
+          ++iCount;
+        }
+    }
+  QCOMPARE(iCount, 10);
+  QVERIFY(!dispatcher.contains(PiiVariant::BoolType));
+}
+
+void TestPiiTypeDispatcher::matrixDispatch()
+{
+  PiiTypeDispatcher<TypeFunction> dispatcher;
+  PII_NUMERIC_MATRIX_DISPATCH(dispatcher, &matrixType);
+  PII_COMPLEX_MATRIX_DISPATCH(dispatcher, &matrixType);
+  PII_COLOR_IMAGE_DISPATCH(dispatcher, &matrixType);
+  int iCount = 0;
+  for (unsigned int i=0; i<PiiTypeDispatcher<TypeFunction>::TableSize; ++i)
+    {
+      if (dispatcher.contains(i))
+        {
+          QCOMPARE(dispatcher[i](), i);
+          ++iCount;
+        }
+    }
+  QCOMPARE(iCount, 16);
+  QVERIFY(!dispatcher.contains(PiiYdin::BoolMatrixType));
+  QVERIFY(!dispatcher.contains(PiiVariant::IntType));
+}
+
+void TestPiiTypeDispatcher::converters()
+{
+  QCOMPARE(PiiYdin::primitiveConverters<double>()[PiiVariant::IntType](PiiVariant(3)), 3.0);
+  QCOMPARE(PiiYdin::primitiveConverters<int>()[PiiVariant::FloatType](PiiVariant(2.5f)), 2);
+  QVERIFY(PiiYdin::primitiveConverters<int>()[PiiVariant::BoolType] == 0);
+
+  PiiMatrix<float> matFloat(1,2, 1.5, 2.5);
+  PiiMatrix<int> matInt(PiiYdin::matrixConverters<int>()[PiiYdin::FloatMatrixType](PiiVariant(matFloat)));
+  QCOMPARE(matInt.rows(), 1);
+  QCOMPARE(matInt.columns(), 2);
+  QCOMPARE(matInt(0,0), 1);
+  QCOMPARE(matInt(0,1), 2);
+  QVERIFY(PiiYdin::matrixConverters<int>()[PiiVariant::IntType] == 0);
+}
+
+QTEST_MAIN(TestPiiTypeDispatcher)
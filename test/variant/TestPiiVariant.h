@@ -25,10 +25,16 @@ class TestPiiVariant : public QObject
 private slots:
   void construct();
   void copy();
+  void inlineStorage();
+  void memoryUsage();
+#ifdef PII_CXX11
+  void move();
+#endif
   void serialization();
   void mapType();
   void canConvert();
   void convertTo();
+  void setConverter();
   void typeName();
   void equals();
   void toQVariant();
@@ -176,6 +176,87 @@ void TestPiiVariant::copy()
   QVERIFY(!v4.isValid());
 }
 
+static bool isInline(const PiiVariant& var)
+{
+  const char* pData = static_cast<const char*>(var.data());
+  return pData >= reinterpret_cast<const char*>(&var) &&
+    pData < reinterpret_cast<const char*>(&var + 1);
+}
+
+void TestPiiVariant::inlineStorage()
+{
+  QVERIFY(isInline(PiiVariant(PiiMatrix<int>(2, 2))));
+  QVERIFY(isInline(PiiVariant(std::complex<double>(1, 2))));
+  QVERIFY(isInline(PiiVariant(QString("inline"))));
+  QVERIFY(!isInline(PiiVariant(BigType())));
+
+  PiiVariant v1(std::complex<double>(1, 2));
+  PiiVariant v2(v1);
+  QCOMPARE(v2.valueAs<std::complex<double> >(), std::complex<double>(1, 2));
+}
+
+void TestPiiVariant::memoryUsage()
+{
+  QCOMPARE(PiiVariant().memoryUsage(), qint64(sizeof(PiiVariant)));
+  QCOMPARE(PiiVariant(1.0).memoryUsage(), qint64(sizeof(PiiVariant)));
+  QCOMPARE(PiiVariant(BigType()).memoryUsage(), qint64(sizeof(PiiVariant) + sizeof(BigType)));
+
+  PiiMatrix<double> mat(100, 100);
+  qint64 lBytes = PiiVariant(mat).memoryUsage();
+  QVERIFY(lBytes >= qint64(sizeof(PiiVariant) + 100 * 100 * sizeof(double)));
+  QCOMPARE(lBytes, qint64(sizeof(PiiVariant)) + Pii::MemoryUsage<PiiMatrix<double> >::heapBytes(mat));
+  // The size follows the capacity of the matrix.
+  QVERIFY(PiiVariant(PiiMatrix<double>::uninitialized(1, 1)).memoryUsage() < lBytes);
+
+  QString str("abcdefghij");
+  QVERIFY(PiiVariant(str).memoryUsage() >= qint64(sizeof(PiiVariant) + 10 * sizeof(QChar)));
+}
+
+#ifdef PII_CXX11
+void TestPiiVariant::move()
+{
+  {
+    BigType obj;
+    for (unsigned int i=0; i<16; ++i)
+      obj.bigBuffer[i] = i;
+    PiiVariant v1(obj);
+    QCOMPARE(BigType::iCount, 2);
+    // Heap-allocated objects change owner.
+    PiiVariant v2(std::move(v1));
+    QCOMPARE(BigType::iCount, 2);
+    QVERIFY(!v1.isValid());
+    TEST_BUFFER(v2);
+
+    PiiVariant v3(1);
+    v3 = std::move(v2);
+    QCOMPARE(BigType::iCount, 2);
+    QVERIFY(!v2.isValid());
+    TEST_BUFFER(v3);
+    v3 = PiiVariant();
+    QCOMPARE(BigType::iCount, 1);
+  }
+  QCOMPARE(BigType::iCount, 0);
+
+  // Relocated matrices share the data with the original.
+  PiiMatrix<int> mat(2, 2);
+  PiiVariant v1(mat);
+  PiiVariant v2(std::move(v1));
+  QVERIFY(!v1.isValid());
+  QCOMPARE(v2.type(), Pii::typeId<PiiMatrix<int> >());
+  QVERIFY(v2.valueAs<PiiMatrix<int> >().row(0) == mat.row(0));
+
+  PiiVariant v3(QString("moved"));
+  v1 = std::move(v3);
+  QVERIFY(!v3.isValid());
+  QCOMPARE(v1.valueAs<QString>(), QString("moved"));
+
+  PiiVariant v4(5);
+  PiiVariant v5(std::move(v4));
+  QCOMPARE(v5.valueAs<int>(), 5);
+  QVERIFY(!v4.isValid());
+}
+#endif
+
 void TestPiiVariant::mapType()
 {
   QCOMPARE(BigType::iCount, 0);
@@ -219,6 +300,39 @@ void TestPiiVariant::convertTo()
   QVERIFY(!bOk);
 }
 
+static bool bigToInt(const PiiVariant* from, void* to)
+{
+  *static_cast<int*>(to) = from->valueAs<BigType>().bigBuffer[0];
+  return true;
+}
+
+void TestPiiVariant::setConverter()
+{
+  QVERIFY(PiiVariant::converter<int,double>() != 0);
+  QVERIFY(PiiVariant::converter<int,double>() ==
+          PiiVariant::converter(PiiVariant::IntType, PiiVariant::DoubleType));
+  QVERIFY(PiiVariant::converter<double,char>() == 0);
+
+  BigType t;
+  t.bigBuffer[0] = 7;
+  PiiVariant v1(t), v2(t, 0x667);
+  QVERIFY(!v1.canConvert(PiiVariant::IntType));
+  // Custom type IDs are stored outside of the flat tables.
+  PiiVariant::setConverter(0x666, PiiVariant::IntType, bigToInt);
+  PiiVariant::setConverter(0x667, PiiVariant::IntType, bigToInt);
+  QVERIFY(PiiVariant::converter<BigType,int>() == bigToInt);
+  QCOMPARE(v1.convertTo<int>(), 7);
+  QCOMPARE(v2.convertTo<int>(), 7);
+  QVERIFY(!PiiVariant::canConvert(0x666, PiiVariant::DoubleType));
+  QVERIFY(PiiVariant::canConvert(PiiVariant::IntType, PiiVariant::DoubleType));
+
+  PiiVariant::setConverter(0x666, PiiVariant::IntType, 0);
+  PiiVariant::setConverter(0x667, PiiVariant::IntType, 0);
+  QVERIFY(!v1.canConvert(PiiVariant::IntType));
+  QVERIFY(!v2.canConvert(PiiVariant::IntType));
+  QCOMPARE(v2.typeName(), "BigType");
+}
+
 void TestPiiVariant::typeName()
 {
   BigType t;
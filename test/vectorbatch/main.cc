@@ -0,0 +1,166 @@
+/* This file is part of Into.
+ * Copyright (C) Intopii 2013.
+ * All rights reserved.
+ *
+ * Licensees holding a commercial Into license may use this file in
+ * accordance with the commercial license agreement. Please see
+ * LICENSE.commercial for commercial licensing terms.
+ *
+ * Alternatively, this file may be used under the terms of the GNU
+ * Affero General Public License version 3 as published by the Free
+ * Software Foundation. In addition, Intopii gives you special rights
+ * to use Into as a part of open source software projects. Please
+ * refer to LICENSE.AGPL3 for details.
+ */
+
+#include "TestPiiVectorBatch.h"
+
+#include <PiiVectorBatch.h>
+#include <PiiCpu.h>
+#include <QtTest>
+
+void TestPiiVectorBatch::container()
+{
+  PiiVectorBatch<int,3> batch;
+  QVERIFY(batch.isEmpty());
+  for (int i=0; i<20; ++i)
+    batch.append(PiiVector<int,3>(i, 2*i, 3*i));
+  QCOMPARE(batch.size(), 20);
+  QVERIFY(batch.capacity() >= 20);
+  QCOMPARE(batch.at(7)[2], 21);
+  QCOMPARE(batch.coordinates(1)[19], 38);
+  // Coordinate arrays are aligned for SIMD loads.
+  QCOMPARE(reinterpret_cast<std::size_t>(batch.coordinates(2)) % 32, std::size_t(0));
+
+  batch.set(0, PiiVector<int,3>(-1, -2, -3));
+  PiiMatrix<int> matVectors(batch.toMatrix());
+  QCOMPARE(matVectors.rows(), 20);
+  QCOMPARE(matVectors.columns(), 3);
+  QCOMPARE(matVectors(0,1), -2);
+  QCOMPARE(matVectors(5,2), 15);
+
+  PiiVectorBatch<int,3> copy(matVectors);
+  QCOMPARE(copy.size(), 20);
+  QCOMPARE(copy.at(0)[0], -1);
+  QCOMPARE(copy.at(19)[1], 38);
+
+  // Implicit sharing
+  PiiVectorBatch<int,3> shared(copy);
+  shared.coordinates(0)[0] = 5;
+  QCOMPARE(copy.at(0)[0], -1);
+
+  copy.resize(2);
+  copy.resize(4);
+  QCOMPARE(copy.at(1)[2], 3);
+  QCOMPARE(copy.at(3)[0], 0);
+  copy.clear();
+  QVERIFY(copy.isEmpty());
+}
+
+template <class T> void TestPiiVectorBatch::testTransformPoints()
+{
+  const T aTransform[6] = { T(0.5), T(-1.25), T(3), T(2), T(0.75), T(-4) };
+  for (int n=0; n<37; ++n)
+    {
+      PiiVectorBatch<T,2> points(n);
+      for (int i=0; i<n; ++i)
+        points.set(i, PiiVector<T,2>(T(i) * T(0.3), T(n - i) * T(1.7)));
+      PiiVectorBatch<T,2> expected(n), result(n);
+      Pii::transformPoints<T>(aTransform,
+                              points.coordinates(0), points.coordinates(1),
+                              expected.coordinates(0), expected.coordinates(1), n);
+      Pii::transformPoints(aTransform,
+                           points.coordinates(0), points.coordinates(1),
+                           result.coordinates(0), result.coordinates(1), n);
+      for (int i=0; i<n; ++i)
+        {
+          QCOMPARE(result.at(i)[0], expected.at(i)[0]);
+          QCOMPARE(result.at(i)[1], expected.at(i)[1]);
+        }
+      // In place
+      Pii::transformPoints(aTransform,
+                           points.coordinates(0), points.coordinates(1),
+                           points.coordinates(0), points.coordinates(1), n);
+      for (int i=0; i<n; ++i)
+        QCOMPARE(points.at(i)[1], expected.at(i)[1]);
+    }
+
+  PiiMatrix<T> matTransform(3, 3,
+                            T(0), T(-1), T(2),
+                            T(1), T(0), T(0),
+                            T(0), T(0), T(1));
+  PiiVectorBatch<T,2> points(PiiMatrix<T>(2, 2,
+                                          T(1), T(0),
+                                          T(0), T(1)));
+  PiiVectorBatch<T,2> moved(Pii::transformPoints(matTransform, points));
+  QCOMPARE(moved.at(0)[0], T(2));
+  QCOMPARE(moved.at(0)[1], T(1));
+  QCOMPARE(moved.at(1)[0], T(1));
+  QCOMPARE(moved.at(1)[1], T(0));
+}
+
+void TestPiiVectorBatch::transformPoints()
+{
+  const int iMask = Pii::cpuFeatureMask();
+  testTransformPoints<float>();
+  testTransformPoints<double>();
+  Pii::setCpuFeatureMask(Pii::NoCpuFeatures);
+  testTransformPoints<float>();
+  testTransformPoints<double>();
+  Pii::setCpuFeatureMask(iMask);
+}
+
+template <class T> void TestPiiVectorBatch::testTransformInterleavedPoints()
+{
+  const T aTransform[6] = { T(-0.5), T(1.25), T(1), T(3), T(0.25), T(2) };
+  for (int n=0; n<23; ++n)
+    {
+      PiiMatrix<T> matPoints(PiiMatrix<T>::uninitialized(n, 2));
+      // Padded rows take the generic path.
+      PiiMatrix<T> matPadded(PiiMatrix<T>::uninitialized(n, 2, 4 * sizeof(T)));
+      for (int i=0; i<n; ++i)
+        {
+          matPoints(i,0) = matPadded(i,0) = T(i) * T(1.1);
+          matPoints(i,1) = matPadded(i,1) = T(i % 5) - T(2.5);
+        }
+      PiiMatrix<T> matExpected(PiiMatrix<T>::uninitialized(n, 2));
+      PiiMatrix<T> matResult(PiiMatrix<T>::uninitialized(n, 2));
+      PiiMatrix<T> matPaddedResult(PiiMatrix<T>::uninitialized(n, 2, 3 * sizeof(T)));
+      if (n == 0)
+        continue;
+      Pii::transformInterleavedPoints<T>(aTransform, matPoints[0], matPoints.stride(),
+                                         matExpected[0], matExpected.stride(), n);
+      Pii::transformInterleavedPoints(aTransform, matPoints[0], matPoints.stride(),
+                                      matResult[0], matResult.stride(), n);
+      Pii::transformInterleavedPoints(aTransform, matPadded[0], matPadded.stride(),
+                                      matPaddedResult[0], matPaddedResult.stride(), n);
+      QVERIFY(Pii::equals(matResult, matExpected));
+      QVERIFY(Pii::equals(matPaddedResult, matExpected));
+    }
+}
+
+void TestPiiVectorBatch::transformInterleavedPoints()
+{
+  const int iMask = Pii::cpuFeatureMask();
+  testTransformInterleavedPoints<float>();
+  testTransformInterleavedPoints<double>();
+  Pii::setCpuFeatureMask(Pii::NoCpuFeatures);
+  testTransformInterleavedPoints<float>();
+  testTransformInterleavedPoints<double>();
+  Pii::setCpuFeatureMask(iMask);
+}
+
+void TestPiiVectorBatch::squaredDistances()
+{
+  PiiVectorBatch<float,3> batch;
+  batch.append(PiiVector<float,3>(0.0f, 0.0f, 0.0f));
+  batch.append(PiiVector<float,3>(1.0f, 2.0f, 2.0f));
+  batch.append(PiiVector<float,3>(-1.0f, 0.0f, 5.0f));
+  float aDistances[3];
+  Pii::squaredDistances(batch, PiiVector<float,3>(1.0f, 0.0f, 1.0f), aDistances);
+  QCOMPARE(aDistances[0], 2.0f);
+  QCOMPARE(aDistances[1], 5.0f);
+  QCOMPARE(aDistances[2], 20.0f);
+}
+
+QTEST_MAIN(TestPiiVectorBatch)
@@ -0,0 +1,106 @@
+/* This file is part of Into.
+ * Copyright (C) Intopii 2013.
+ * All rights reserved.
+ *
+ * Licensees holding a commercial Into license may use this file in
+ * accordance with the commercial license agreement. Please see
+ * LICENSE.commercial for commercial licensing terms.
+ *
+ * Alternatively, this file may be used under the terms of the GNU
+ * Affero General Public License version 3 as published by the Free
+ * Software Foundation. In addition, Intopii gives you special rights
+ * to use Into as a part of open source software projects. Please
+ * refer to LICENSE.AGPL3 for details.
+ */
+
+
+#include "TestPiiWaitCondition.h"
+
+#include <QtTest>
+#include <PiiAsyncCall.h>
+
+void TestPiiWaitCondition::queue()
+{
+  PiiWaitCondition condition(PiiWaitCondition::Queue);
+  condition.wakeOne();
+  condition.wakeOne();
+  QCOMPARE(condition.queueLength(), 2u);
+  QVERIFY(condition.wait(0));
+  QVERIFY(condition.wait(0));
+  QVERIFY(!condition.wait(0));
+  QCOMPARE(condition.queueLength(), 0u);
+}
+
+void TestPiiWaitCondition::noQueue()
+{
+  PiiWaitCondition condition(PiiWaitCondition::NoQueue);
+  condition.wakeOne();
+  condition.wakeOne();
+  QCOMPARE(condition.queueLength(), 1u);
+  QVERIFY(condition.wait(0));
+  QVERIFY(!condition.wait(0));
+}
+
+void TestPiiWaitCondition::timeout()
+{
+  PiiWaitCondition condition;
+  QVERIFY(!condition.wait(20));
+  // A timed-out waiter must not stay registered.
+  QCOMPARE(condition.waiterCount(), 0u);
+  condition.wakeOne();
+  QCOMPARE(condition.queueLength(), 1u);
+  QVERIFY(condition.wait(20));
+}
+
+void TestPiiWaitCondition::waiter(PiiWaitCondition* condition, int count)
+{
+  for (int i=0; i<count; ++i)
+    if (condition->wait(5000))
+      ++_iWakeUps;
+}
+
+void TestPiiWaitCondition::wakeAll()
+{
+  _iWakeUps = 0;
+  PiiWaitCondition condition(PiiWaitCondition::Queue);
+  QList<QThread*> lstThreads;
+  for (int i=0; i<4; ++i)
+    {
+      lstThreads << Pii::createAsyncCall(this, &TestPiiWaitCondition::waiter, &condition, 1);
+      lstThreads.last()->start();
+    }
+  while (condition.waiterCount() < 4)
+    QThread::yieldCurrentThread();
+  condition.wakeAll();
+  for (int i=0; i<lstThreads.size(); ++i)
+    QVERIFY(lstThreads[i]->wait(5000));
+  qDeleteAll(lstThreads);
+  QCOMPARE(_iWakeUps.load(), 4);
+  QCOMPARE(condition.queueLength(), 0u);
+}
+
+void TestPiiWaitCondition::ponger(int count)
+{
+  for (int i=0; i<count; ++i)
+    {
+      _ping.wait();
+      _pong.wakeOne();
+    }
+}
+
+void TestPiiWaitCondition::pingPong()
+{
+  // Every handoff must be seen exactly once.
+  const int iRounds = 100000;
+  QThread* pPonger = Pii::createAsyncCall(this, &TestPiiWaitCondition::ponger, iRounds);
+  pPonger->start();
+  for (int i=0; i<iRounds; ++i)
+    {
+      _ping.wakeOne();
+      QVERIFY(_pong.wait(5000));
+    }
+  QVERIFY(pPonger->wait(5000));
+  delete pPonger;
+}
+
+QTEST_MAIN(TestPiiWaitCondition)
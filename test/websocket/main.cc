@@ -0,0 +1,92 @@
+/* This file is part of Into.
+ * Copyright (C) Intopii 2013.
+ * All rights reserved.
+ *
+ * Licensees holding a commercial Into license may use this file in
+ * accordance with the commercial license agreement. Please see
+ * LICENSE.commercial for commercial licensing terms.
+ *
+ * Alternatively, this file may be used under the terms of the GNU
+ * Affero General Public License version 3 as published by the Free
+ * Software Foundation. In addition, Intopii gives you special rights
+ * to use Into as a part of open source software projects. Please
+ * refer to LICENSE.AGPL3 for details.
+ */
+
+
+
+#include "TestPiiWebSocket.h"
+
+#include <PiiWebSocket.h>
+#include <QBuffer>
+#include <QtTest>
+
+void TestPiiWebSocket::acceptKey()
+{
+  // Example from RFC 6455
+  QCOMPARE(PiiWebSocket::acceptKey("dGhlIHNhbXBsZSBub25jZQ=="),
+           QByteArray("s3pPLMBiTxaQ9kYGzzhZK+xOo2w="));
+}
+
+void TestPiiWebSocket::roundTrip()
+{
+  QBuffer buffer;
+  buffer.open(QIODevice::ReadWrite);
+
+  QByteArray aLarge(70000, 'x');
+  aLarge[69999] = 'y';
+  {
+    PiiWebSocket client(&buffer, PiiWebSocket::Client);
+    QVERIFY(client.writeMessage("hello", PiiWebSocket::TextFrame));
+    QVERIFY(client.writeMessage(QByteArray(300, 'a')));
+    QVERIFY(client.writeMessage(aLarge));
+  }
+  buffer.seek(0);
+
+  PiiWebSocket server(&buffer, PiiWebSocket::Server);
+  QByteArray aMessage;
+  PiiWebSocket::Opcode opcode;
+  QVERIFY(server.readMessage(&aMessage, &opcode));
+  QCOMPARE(opcode, PiiWebSocket::TextFrame);
+  QCOMPARE(aMessage, QByteArray("hello"));
+  QVERIFY(server.readMessage(&aMessage, &opcode));
+  QCOMPARE(opcode, PiiWebSocket::BinaryFrame);
+  QCOMPARE(aMessage, QByteArray(300, 'a'));
+  QVERIFY(server.readMessage(&aMessage));
+  QCOMPARE(aMessage, aLarge);
+}
+
+void TestPiiWebSocket::fragmentedMessage()
+{
+  // Two unmasked fragments with a pong in between, as sent by a server.
+  const char aFrames[] =
+    "\x01\x03" "abc"
+    "\x8a\x01" "p"
+    "\x80\x02" "de";
+  QByteArray aData(aFrames, sizeof(aFrames) - 1);
+  QBuffer buffer(&aData);
+  buffer.open(QIODevice::ReadWrite);
+
+  PiiWebSocket client(&buffer, PiiWebSocket::Client);
+  QByteArray aMessage;
+  PiiWebSocket::Opcode opcode;
+  QVERIFY(client.readMessage(&aMessage, &opcode));
+  QCOMPARE(opcode, PiiWebSocket::TextFrame);
+  QCOMPARE(aMessage, QByteArray("abcde"));
+  QVERIFY(client.isOpen());
+}
+
+void TestPiiWebSocket::protocolViolation()
+{
+  // Servers must not accept unmasked frames.
+  QByteArray aData("\x82\x01" "a", 3);
+  QBuffer buffer(&aData);
+  buffer.open(QIODevice::ReadWrite);
+
+  PiiWebSocket server(&buffer, PiiWebSocket::Server);
+  QByteArray aMessage;
+  QVERIFY(!server.readMessage(&aMessage));
+  QVERIFY(!server.isOpen());
+}
+
+QTEST_MAIN(TestPiiWebSocket)
@@ -0,0 +1,150 @@
+/* This file is part of Into.
+ * Copyright (C) Intopii 2013.
+ * All rights reserved.
+ *
+ * Licensees holding a commercial Into license may use this file in
+ * accordance with the commercial license agreement. Please see
+ * LICENSE.commercial for commercial licensing terms.
+ *
+ * Alternatively, this file may be used under the terms of the GNU
+ * Affero General Public License version 3 as published by the Free
+ * Software Foundation. In addition, Intopii gives you special rights
+ * to use Into as a part of open source software projects. Please
+ * refer to LICENSE.AGPL3 for details.
+ */
+
+
+#include "TestPiiWireFormat.h"
+
+#include <PiiWireFormat.h>
+#include <PiiColor.h>
+#include <QtTest>
+
+static bool isRejected(const QByteArray& frame)
+{
+  try
+    {
+      PiiWireFormat::fromByteArray(frame);
+    }
+  catch (PiiSerializationException&)
+    {
+      return true;
+    }
+  return false;
+}
+
+void TestPiiWireFormat::matrix()
+{
+  PiiMatrix<int> matInput(2,3, 1,2,3, 4,5,6);
+  QByteArray aFrame(PiiWireFormat::toByteArray(PiiVariant(matInput)));
+  QCOMPARE(qint64(aFrame.size()), PiiWireFormat::frameSize(PiiVariant(matInput)));
+  QCOMPARE(aFrame.size(), 32 + 6 * int(sizeof(int)));
+  QVERIFY(PiiWireFormat::isFrame(aFrame));
+
+  PiiVariant varOutput(PiiWireFormat::fromByteArray(aFrame));
+  QCOMPARE(varOutput.type(), unsigned(PiiYdin::IntMatrixType));
+  QVERIFY(Pii::equals(varOutput.valueAs<PiiMatrix<int> >(), matInput));
+
+  PiiMatrix<double> matEmpty;
+  varOutput = PiiWireFormat::fromByteArray(PiiWireFormat::toByteArray(PiiVariant(matEmpty)));
+  QCOMPARE(varOutput.type(), unsigned(PiiYdin::DoubleMatrixType));
+  QVERIFY(varOutput.valueAs<PiiMatrix<double> >().isEmpty());
+}
+
+void TestPiiWireFormat::submatrix()
+{
+  PiiMatrix<unsigned char> matInput(3,4,
+                                    1,2,3,4,
+                                    5,6,7,8,
+                                    9,10,11,12);
+  // Rows of a submatrix are not contiguous.
+  PiiMatrix<unsigned char> matSub(matInput(1,1,2,2));
+  PiiVariant varOutput(PiiWireFormat::fromByteArray(PiiWireFormat::toByteArray(PiiVariant(matSub))));
+  QVERIFY(Pii::equals(varOutput.valueAs<PiiMatrix<unsigned char> >(),
+                      PiiMatrix<unsigned char>(2,2, 6,7, 10,11)));
+}
+
+void TestPiiWireFormat::colorMatrix()
+{
+  PiiMatrix<PiiColor<unsigned char> > matInput(1,2);
+  matInput(0,0) = PiiColor<unsigned char>(1,2,3);
+  matInput(0,1) = PiiColor<unsigned char>(4,5,6);
+  PiiVariant varOutput(PiiWireFormat::fromByteArray(PiiWireFormat::toByteArray(PiiVariant(matInput))));
+  QCOMPARE(varOutput.type(), unsigned(PiiYdin::UnsignedCharColorMatrixType));
+  PiiMatrix<PiiColor<unsigned char> > matOutput(varOutput.valueAs<PiiMatrix<PiiColor<unsigned char> > >());
+  QCOMPARE(matOutput.columns(), 2);
+  QVERIFY(matOutput(0,1) == PiiColor<unsigned char>(4,5,6));
+}
+
+void TestPiiWireFormat::archivedObject()
+{
+  PiiVariant varOutput(PiiWireFormat::fromByteArray(PiiWireFormat::toByteArray(PiiVariant(QString("frame")))));
+  QCOMPARE(varOutput.type(), unsigned(PiiYdin::QStringType));
+  QCOMPARE(varOutput.valueAs<QString>(), QString("frame"));
+
+  varOutput = PiiWireFormat::fromByteArray(PiiWireFormat::toByteArray(PiiVariant(3.5)));
+  QCOMPARE(varOutput.valueAs<double>(), 3.5);
+}
+
+void TestPiiWireFormat::controlObject()
+{
+  PiiVariant varOutput(PiiWireFormat::fromByteArray(PiiWireFormat::toByteArray(PiiYdin::createEndTag())));
+  QCOMPARE(varOutput.type(), unsigned(PiiYdin::SynchronizationTagType));
+  QCOMPARE(varOutput.valueAs<int>(), -1);
+
+  QByteArray aFrame(PiiWireFormat::toByteArray(PiiYdin::createStopTag()));
+  QCOMPARE(aFrame.size(), 32);
+  QCOMPARE(qint64(aFrame.size()), PiiWireFormat::frameSize(PiiYdin::createStopTag()));
+  QCOMPARE(PiiWireFormat::fromByteArray(aFrame).type(), unsigned(PiiYdin::StopTagType));
+
+  varOutput = PiiWireFormat::fromByteArray(PiiWireFormat::toByteArray(PiiVariant(PiiSocketState(2, 3))));
+  QCOMPARE(varOutput.type(), unsigned(PiiYdin::ResumeTagType));
+  QVERIFY(varOutput.valueAs<PiiSocketState>() == PiiSocketState(2, 3));
+
+  varOutput = PiiWireFormat::fromByteArray(PiiWireFormat::toByteArray(PiiYdin::createReconfigurationTag("night")));
+  QCOMPARE(varOutput.type(), unsigned(PiiYdin::ReconfigurationTagType));
+  QCOMPARE(varOutput.valueAs<QString>(), QString("night"));
+}
+
+void TestPiiWireFormat::corruptedFrame()
+{
+  QByteArray aFrame(PiiWireFormat::toByteArray(PiiVariant(PiiMatrix<float>(4,4))));
+
+  QByteArray aTruncated(aFrame.left(aFrame.size() - 1));
+  QVERIFY(isRejected(aTruncated));
+
+  QByteArray aBadMagic(aFrame);
+  aBadMagic[0] = 'X';
+  QVERIFY(!PiiWireFormat::isFrame(aBadMagic));
+  QVERIFY(isRejected(aBadMagic));
+
+  // The element size must match the type.
+  QByteArray aBadType(aFrame);
+  reinterpret_cast<quint32*>(aBadType.data())[2] = PiiYdin::DoubleMatrixType;
+  QVERIFY(isRejected(aBadType));
+}
+
+void TestPiiWireFormat::device()
+{
+  // Many frames back to back in a stream
+  QBuffer buffer;
+  buffer.open(QIODevice::ReadWrite);
+  PiiMatrix<short> mat1(1,3, 1,2,3);
+  PiiMatrix<float> mat2(2,1, 1.5,2.5);
+  PiiWireFormat::writeObject(&buffer, PiiVariant(mat1));
+  PiiWireFormat::writeObject(&buffer, PiiVariant(mat2));
+  buffer.seek(0);
+  QVERIFY(Pii::equals(PiiWireFormat::readObject(&buffer, 0, 0).valueAs<PiiMatrix<short> >(), mat1));
+  QVERIFY(Pii::equals(PiiWireFormat::readObject(&buffer, 0, 0).valueAs<PiiMatrix<float> >(), mat2));
+
+  // Size limit
+  buffer.seek(0);
+  try
+    {
+      PiiWireFormat::readObject(&buffer, 4, 0);
+      QFAIL("Size limit was not respected.");
+    }
+  catch (PiiSerializationException&) {}
+}
+
+QTEST_MAIN(TestPiiWireFormat)
@@ -81,6 +81,14 @@ void PiiAbstractOutputSocket::updateInput(PiiAbstractInputSocket* socket)
     {
       d->lstInputs.updateController(socket);
       d->inputUpdated(socket);
+      // The root output caches the controllers of the inputs behind
+      // proxies.
+      if (isProxy())
+        {
+          PiiAbstractOutputSocket* pRootOutput = PiiProxySocket::root(this);
+          if (pRootOutput != 0 && pRootOutput != this)
+            pRootOutput->_d()->inputUpdated(socket);
+        }
     }
 }
 
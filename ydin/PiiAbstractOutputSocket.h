@@ -154,8 +154,10 @@ protected:
     virtual void inputConnected(PiiAbstractInputSocket* input);
     /*
      * Called by #updateInput() when an input has been updated
-     * (e.g. when the controller of an input changes). The default
-     * implementation does nothing.
+     * (e.g. when the controller of an input changes). If the updated
+     * input is behind a proxy, this function is also called on the
+     * root output of the proxy chain. The default implementation
+     * does nothing.
      */
     virtual void inputUpdated(PiiAbstractInputSocket* input);
     /*
@@ -0,0 +1,343 @@
+/* This file is part of Into.
+ * Copyright (C) Intopii 2013.
+ * All rights reserved.
+ *
+ * Licensees holding a commercial Into license may use this file in
+ * accordance with the commercial license agreement. Please see
+ * LICENSE.commercial for commercial licensing terms.
+ *
+ * Alternatively, this file may be used under the terms of the GNU
+ * Affero General Public License version 3 as published by the Free
+ * Software Foundation. In addition, Intopii gives you special rights
+ * to use Into as a part of open source software projects. Please
+ * refer to LICENSE.AGPL3 for details.
+ */
+
+
+#include "PiiBottleneckAnalyzer.h"
+
+#include "PiiOperationCompound.h"
+#include "PiiDefaultOperation.h"
+#include "PiiProxySocket.h"
+
+#include <QThread>
+#include <QHash>
+#include <QVector>
+#include <QStringList>
+#include <cmath>
+
+static inline int threadCount(PiiDefaultOperation* operation)
+{
+  return operation->property("threadCount").toInt();
+}
+
+static inline PiiDefaultOperation::ThreadingCapabilities threadingCapabilities(PiiDefaultOperation* operation)
+{
+  return PiiDefaultOperation::ThreadingCapabilities(operation->property("threadingCapabilities").toInt());
+}
+
+struct PiiBottleneckNode
+{
+  PiiDefaultOperation* pOperation;
+  QString strName;
+  int iProcessCount;
+  qint64 iBusyTime;
+  double dMeanTime;
+  QList<int> lstSuccessors;
+  int iRecommendedThreadCount;
+};
+
+class PiiBottleneckAnalyzer::Data
+{
+public:
+  Data();
+
+  void collectOperations(PiiOperationCompound* compound, const QString& prefix);
+  void collectConnections();
+  double longestPath(int node, QVector<int>& states);
+  void findCriticalPath();
+  void findBottleneck();
+  void recommendThreadCounts();
+
+  int iProcessorCount, iMaxThreadCount, iNonThreadedLimit;
+  QList<PiiBottleneckNode> lstNodes;
+  QHash<PiiOperation*,int> hashIndices;
+  QVector<double> vecPathTimes;
+  QVector<int> vecNextNodes;
+  QList<int> lstCriticalPath;
+  double dCriticalPathTime;
+  int iBottleneck;
+};
+
+PiiBottleneckAnalyzer::Data::Data() :
+  iProcessorCount(qMax(QThread::idealThreadCount(), 1)),
+  iMaxThreadCount(iProcessorCount * 2),
+  iNonThreadedLimit(20),
+  dCriticalPathTime(0),
+  iBottleneck(-1)
+{
+}
+
+void PiiBottleneckAnalyzer::Data::collectOperations(PiiOperationCompound* compound, const QString& prefix)
+{
+  QList<PiiOperation*> lstOperations = compound->childOperations();
+  for (int i=0; i<lstOperations.size(); ++i)
+    {
+      QString strName(prefix + lstOperations[i]->objectName());
+      if (PiiDefaultOperation* pOperation = qobject_cast<PiiDefaultOperation*>(lstOperations[i]))
+        {
+          const PiiProfileHistogram& processTimes = pOperation->processTimeHistogram();
+          PiiBottleneckNode node;
+          node.pOperation = pOperation;
+          node.strName = strName;
+          node.iProcessCount = processTimes.count();
+          node.iBusyTime = processTimes.total();
+          node.dMeanTime = processTimes.mean();
+          node.iRecommendedThreadCount = threadCount(pOperation);
+          hashIndices.insert(pOperation, lstNodes.size());
+          lstNodes << node;
+        }
+      else if (PiiOperationCompound* pCompound = qobject_cast<PiiOperationCompound*>(lstOperations[i]))
+        collectOperations(pCompound, strName + '.');
+    }
+}
+
+void PiiBottleneckAnalyzer::Data::collectConnections()
+{
+  for (int i=0; i<lstNodes.size(); ++i)
+    {
+      QList<PiiAbstractOutputSocket*> lstOutputs = lstNodes[i].pOperation->outputs();
+      for (int o=0; o<lstOutputs.size(); ++o)
+        {
+          QList<PiiAbstractInputSocket*> lstInputs = lstOutputs[o]->connectedInputs();
+          for (int j=0; j<lstInputs.size(); ++j)
+            {
+              // Pass through proxies to the receiving operations.
+              QList<PiiAbstractInputSocket*> lstTargets = PiiProxySocket::connectedInputs(lstInputs[j]);
+              for (int t=0; t<lstTargets.size(); ++t)
+                {
+                  int iTarget = hashIndices.value(lstTargets[t]->parentOperation(), -1);
+                  if (iTarget != -1 && !lstNodes[i].lstSuccessors.contains(iTarget))
+                    lstNodes[i].lstSuccessors << iTarget;
+                }
+            }
+        }
+    }
+}
+
+double PiiBottleneckAnalyzer::Data::longestPath(int node, QVector<int>& states)
+{
+  enum { Unvisited, Visiting, Visited };
+  if (states[node] == Visited)
+    return vecPathTimes[node];
+
+  states[node] = Visiting;
+  double dLongest = 0;
+  int iNext = -1;
+  const QList<int>& lstSuccessors = lstNodes[node].lstSuccessors;
+  for (int i=0; i<lstSuccessors.size(); ++i)
+    {
+      // A successor that is being visited closes a feedback loop.
+      if (states[lstSuccessors[i]] == Visiting)
+        continue;
+      double dTime = longestPath(lstSuccessors[i], states);
+      if (dTime > dLongest || iNext == -1)
+        {
+          dLongest = dTime;
+          iNext = lstSuccessors[i];
+        }
+    }
+  states[node] = Visited;
+  vecNextNodes[node] = iNext;
+  return vecPathTimes[node] = lstNodes[node].dMeanTime + dLongest;
+}
+
+void PiiBottleneckAnalyzer::Data::findCriticalPath()
+{
+  vecPathTimes.fill(0, lstNodes.size());
+  vecNextNodes.fill(-1, lstNodes.size());
+  QVector<int> vecStates(lstNodes.size(), 0);
+
+  int iFirst = -1;
+  for (int i=0; i<lstNodes.size(); ++i)
+    {
+      double dTime = longestPath(i, vecStates);
+      if (iFirst == -1 || dTime > dCriticalPathTime)
+        {
+          dCriticalPathTime = dTime;
+          iFirst = i;
+        }
+    }
+
+  for (int i=iFirst; i != -1; i = vecNextNodes[i])
+    lstCriticalPath << i;
+}
+
+static inline int effectiveThreadCount(int threadCount)
+{
+  // Non-threaded operations run in the sender's thread.
+  return qMax(threadCount, 1);
+}
+
+void PiiBottleneckAnalyzer::Data::findBottleneck()
+{
+  double dMaxLoad = 0;
+  for (int i=0; i<lstNodes.size(); ++i)
+    {
+      double dLoad = double(lstNodes[i].iBusyTime) /
+        effectiveThreadCount(threadCount(lstNodes[i].pOperation));
+      if (lstNodes[i].iProcessCount > 0 && dLoad > dMaxLoad)
+        {
+          dMaxLoad = dLoad;
+          iBottleneck = i;
+        }
+    }
+}
+
+void PiiBottleneckAnalyzer::Data::recommendThreadCounts()
+{
+  /* The total processing time of an operation that cannot be
+   * parallelized is a lower limit to the time it takes to process
+   * the whole input. So is the total processing time of all
+   * operations divided by the number of cores. Multi-threaded
+   * operations get enough threads to finish within that time.
+   */
+  qint64 iTotalBusyTime = 0, iMaxSerialTime = 0;
+  for (int i=0; i<lstNodes.size(); ++i)
+    {
+      iTotalBusyTime += lstNodes[i].iBusyTime;
+      if (!(threadingCapabilities(lstNodes[i].pOperation) & PiiDefaultOperation::MultiThreaded))
+        iMaxSerialTime = qMax(iMaxSerialTime, lstNodes[i].iBusyTime);
+    }
+  double dTargetTime = qMax(double(iMaxSerialTime), double(iTotalBusyTime) / iProcessorCount);
+  if (dTargetTime <= 0)
+    return;
+
+  for (int i=0; i<lstNodes.size(); ++i)
+    {
+      PiiBottleneckNode& node = lstNodes[i];
+      if (node.iProcessCount == 0)
+        continue;
+      PiiDefaultOperation::ThreadingCapabilities capabilities = threadingCapabilities(node.pOperation);
+      if (capabilities & PiiDefaultOperation::MultiThreaded)
+        {
+          int iThreadCount = qMin(int(std::ceil(node.iBusyTime / dTargetTime)), iMaxThreadCount);
+          if (iThreadCount > 1)
+            {
+              node.iRecommendedThreadCount = iThreadCount;
+              continue;
+            }
+        }
+      // One thread is enough.
+      if ((capabilities & PiiDefaultOperation::NonThreaded) &&
+          (node.dMeanTime < iNonThreadedLimit || !(capabilities & PiiDefaultOperation::SingleThreaded)))
+        node.iRecommendedThreadCount = 0;
+      else if (capabilities & PiiDefaultOperation::SingleThreaded)
+        node.iRecommendedThreadCount = 1;
+      else
+        node.iRecommendedThreadCount = 2;
+    }
+}
+
+PiiBottleneckAnalyzer::PiiBottleneckAnalyzer() :
+  d(new Data)
+{
+}
+
+PiiBottleneckAnalyzer::~PiiBottleneckAnalyzer()
+{
+  delete d;
+}
+
+void PiiBottleneckAnalyzer::analyze(PiiOperationCompound* compound)
+{
+  d->lstNodes.clear();
+  d->hashIndices.clear();
+  d->lstCriticalPath.clear();
+  d->dCriticalPathTime = 0;
+  d->iBottleneck = -1;
+
+  d->collectOperations(compound, QString());
+  d->collectConnections();
+  d->findCriticalPath();
+  d->findBottleneck();
+  d->recommendThreadCounts();
+}
+
+QList<PiiDefaultOperation*> PiiBottleneckAnalyzer::criticalPath() const
+{
+  QList<PiiDefaultOperation*> lstResult;
+  for (int i=0; i<d->lstCriticalPath.size(); ++i)
+    lstResult << d->lstNodes[d->lstCriticalPath[i]].pOperation;
+  return lstResult;
+}
+
+double PiiBottleneckAnalyzer::criticalPathTime() const
+{
+  return d->dCriticalPathTime;
+}
+
+PiiDefaultOperation* PiiBottleneckAnalyzer::bottleneck() const
+{
+  return d->iBottleneck != -1 ? d->lstNodes[d->iBottleneck].pOperation : 0;
+}
+
+static double capacity(const PiiBottleneckNode& node)
+{
+  return node.dMeanTime > 0 ?
+    effectiveThreadCount(threadCount(node.pOperation)) * 1e6 / node.dMeanTime :
+    0;
+}
+
+double PiiBottleneckAnalyzer::maxThroughput() const
+{
+  return d->iBottleneck != -1 ? capacity(d->lstNodes[d->iBottleneck]) : 0;
+}
+
+int PiiBottleneckAnalyzer::recommendedThreadCount(PiiDefaultOperation* operation) const
+{
+  int iIndex = d->hashIndices.value(operation, -1);
+  return iIndex != -1 ? d->lstNodes[iIndex].iRecommendedThreadCount : -1;
+}
+
+void PiiBottleneckAnalyzer::applyRecommendations()
+{
+  for (int i=0; i<d->lstNodes.size(); ++i)
+    d->lstNodes[i].pOperation->setProperty("threadCount", d->lstNodes[i].iRecommendedThreadCount);
+}
+
+QVariantMap PiiBottleneckAnalyzer::toVariantMap() const
+{
+  QVariantMap mapResult;
+  QStringList lstPath;
+  for (int i=0; i<d->lstCriticalPath.size(); ++i)
+    lstPath << d->lstNodes[d->lstCriticalPath[i]].strName;
+  mapResult["criticalPath"] = lstPath;
+  mapResult["criticalPathTime"] = d->dCriticalPathTime;
+  if (d->iBottleneck != -1)
+    mapResult["bottleneck"] = d->lstNodes[d->iBottleneck].strName;
+  mapResult["maxThroughput"] = maxThroughput();
+
+  QVariantMap mapOperations;
+  for (int i=0; i<d->lstNodes.size(); ++i)
+    {
+      const PiiBottleneckNode& node = d->lstNodes[i];
+      QVariantMap mapOperation;
+      mapOperation["processCount"] = node.iProcessCount;
+      mapOperation["meanTime"] = node.dMeanTime;
+      mapOperation["busyTime"] = node.iBusyTime;
+      mapOperation["threadCount"] = threadCount(node.pOperation);
+      mapOperation["recommendedThreadCount"] = node.iRecommendedThreadCount;
+      mapOperation["capacity"] = capacity(node);
+      mapOperations[node.strName] = mapOperation;
+    }
+  mapResult["operations"] = mapOperations;
+  return mapResult;
+}
+
+void PiiBottleneckAnalyzer::setProcessorCount(int processorCount) { d->iProcessorCount = qMax(processorCount, 1); }
+int PiiBottleneckAnalyzer::processorCount() const { return d->iProcessorCount; }
+void PiiBottleneckAnalyzer::setMaxThreadCount(int maxThreadCount) { d->iMaxThreadCount = qMax(maxThreadCount, 2); }
+int PiiBottleneckAnalyzer::maxThreadCount() const { return d->iMaxThreadCount; }
+void PiiBottleneckAnalyzer::setNonThreadedLimit(int nonThreadedLimit) { d->iNonThreadedLimit = nonThreadedLimit; }
+int PiiBottleneckAnalyzer::nonThreadedLimit() const { return d->iNonThreadedLimit; }
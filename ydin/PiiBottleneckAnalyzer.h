@@ -0,0 +1,185 @@
+/* This file is part of Into.
+ * Copyright (C) Intopii 2013.
+ * All rights reserved.
+ *
+ * Licensees holding a commercial Into license may use this file in
+ * accordance with the commercial license agreement. Please see
+ * LICENSE.commercial for commercial licensing terms.
+ *
+ * Alternatively, this file may be used under the terms of the GNU
+ * Affero General Public License version 3 as published by the Free
+ * Software Foundation. In addition, Intopii gives you special rights
+ * to use Into as a part of open source software projects. Please
+ * refer to LICENSE.AGPL3 for details.
+ */
+
+
+#ifndef _PIIBOTTLENECKANALYZER_H
+#define _PIIBOTTLENECKANALYZER_H
+
+#include "PiiYdin.h"
+#include <QVariantMap>
+#include <QList>
+
+class PiiOperationCompound;
+class PiiDefaultOperation;
+
+/**
+ * Finds the operations that limit the throughput and latency of a
+ * processing pipeline. PiiBottleneckAnalyzer combines the connection
+ * graph of a PiiOperationCompound with the processing times
+ * collected by PiiDefaultOperation::processTimeHistogram(). The
+ * analysis should therefore be run after the compound has processed
+ * a representative amount of data.
+ *
+ * The graph consists of all PiiDefaultOperation instances found
+ * recursively in the compound. Connections through proxies are
+ * followed, but other kinds of operations are not included as
+ * nodes.
+ *
+ * The analyzer reports three things:
+ *
+ * - The *critical path*, the chain of connected operations whose
+ * mean processing times sum up to the largest per-object latency.
+ * Feedback loops are cut at the first connection that closes a
+ * cycle.
+ *
+ * - The *bottleneck*, the operation whose processing time per
+ * thread is largest. All operations process objects during the same
+ * wall-clock time. Therefore, the one that is busiest per thread is
+ * the one that limits the throughput of the whole pipeline.
+ *
+ * - A *recommended thread count* for each operation. The analyzer
+ * balances the load so that the processing time per thread of each
+ * multi-threaded operation approaches that of the slowest operation
+ * that cannot be parallelized, without exceeding the available
+ * processor cores in total. Cheap operations that allow it are
+ * recommended to be run `NonThreaded`. The recommendations always
+ * respect PiiDefaultOperation::threadingCapabilities.
+ *
+ * ~~~(c++)
+ * engine.execute();
+ * // ... process for a while
+ * engine.interrupt();
+ * engine.wait();
+ *
+ * PiiBottleneckAnalyzer analyzer;
+ * analyzer.analyze(&engine);
+ * qDebug() << analyzer.bottleneck()->objectName();
+ * analyzer.applyRecommendations();
+ * engine.resetProfile();
+ * engine.execute();
+ * ~~~
+ */
+class PII_YDIN_EXPORT PiiBottleneckAnalyzer
+{
+public:
+  PiiBottleneckAnalyzer();
+  ~PiiBottleneckAnalyzer();
+
+  /**
+   * Sets the number of processor cores that can be used for
+   * processing. The recommended thread counts are chosen so that the
+   * total load does not exceed this number of cores. The default is
+   * QThread::idealThreadCount().
+   */
+  void setProcessorCount(int processorCount);
+  int processorCount() const;
+
+  /**
+   * Sets the maximum number of threads recommended for a single
+   * operation. The default is twice the [processorCount()] at the time
+   * of construction.
+   */
+  void setMaxThreadCount(int maxThreadCount);
+  int maxThreadCount() const;
+
+  /**
+   * Sets the mean processing time in microseconds below which an
+   * operation that supports it is recommended to be run in the
+   * thread of its sender (`threadCount` = 0). Passing objects to a
+   * separate thread costs more than processing them this fast. The
+   * default is 20.
+   */
+  void setNonThreadedLimit(int nonThreadedLimit);
+  int nonThreadedLimit() const;
+
+  /**
+   * Analyzes the operations in *compound* based on the current
+   * profiling statistics. Operations that have not processed any
+   * objects are included in the graph, but their thread counts are
+   * not changed. Results of a previous analysis are discarded.
+   */
+  void analyze(PiiOperationCompound* compound);
+
+  /**
+   * Returns the operations on the critical path, in processing order.
+   */
+  QList<PiiDefaultOperation*> criticalPath() const;
+  /**
+   * Returns the sum of the mean processing times of the operations on
+   * the critical path, in microseconds.
+   */
+  double criticalPathTime() const;
+
+  /**
+   * Returns the operation that limits the throughput, or 0 if no
+   * operation has processed anything.
+   */
+  PiiDefaultOperation* bottleneck() const;
+  /**
+   * Returns an estimate of the maximum throughput of the analyzed
+   * pipeline with the current thread counts, in processing rounds of
+   * the [bottleneck()] per second. Returns zero if there is no
+   * bottleneck.
+   */
+  double maxThroughput() const;
+
+  /**
+   * Returns the recommended [threadCount]
+   * (PiiDefaultOperation::threadCount) for *operation*, or -1 if the
+   * operation was not analyzed.
+   */
+  int recommendedThreadCount(PiiDefaultOperation* operation) const;
+
+  /**
+   * Sets the thread count of each analyzed operation to the
+   * recommended value. The operations must be stopped, and
+   * PiiOperation::check() must not have been called after that.
+   */
+  void applyRecommendations();
+
+  /**
+   * Returns the analysis as a map that can be converted to JSON. The
+   * map contains the following keys:
+   *
+   * - `criticalPath` - a list of operation names along the critical
+   * path.
+   *
+   * - `criticalPathTime` - the sum of mean processing times along
+   * the critical path, in microseconds.
+   *
+   * - `bottleneck` - the name of the bottleneck operation.
+   *
+   * - `maxThroughput` - see [maxThroughput()].
+   *
+   * - `operations` - a map from operation names to maps with keys
+   * `processCount`, `meanTime`, `busyTime` (total processing time in
+   * microseconds), `threadCount`, `recommendedThreadCount` and
+   * `capacity` (processing rounds per second with the current thread
+   * count).
+   *
+   * Operation names are formed like socket names in
+   * PiiSocket::fullName(): the object names of enclosing compounds
+   * below the analyzed one are prepended with dots as separators.
+   */
+  QVariantMap toVariantMap() const;
+
+private:
+  class Data;
+  Data* d;
+
+  PII_DISABLE_COPY(PiiBottleneckAnalyzer);
+};
+
+#endif //_PIIBOTTLENECKANALYZER_H
@@ -26,7 +26,8 @@ PiiDefaultFlowController::SyncGroup::SyncGroup(int groupId) :
   _bSyncStartSent(false),
   _bSiblingsInSync(true),
   _pParentGroup(0),
-  _bStrictRelationship(false)
+  _bStrictRelationship(false),
+  _iReadyInputs(0)
 {}
 
 PiiDefaultFlowController::SyncGroup::~SyncGroup()
@@ -56,6 +57,7 @@ void PiiDefaultFlowController::SyncGroup::shiftInputs()
 {
   for (int i=size(); i--; )
     at(i)->shift();
+  _iReadyInputs = 0;
 }
 
 // Create a descriptive message of a synchronization error.
@@ -214,7 +216,7 @@ PiiFlowController::FlowState PiiDefaultFlowController::SyncGroup::prepareProcess
          _iActiveChildren);
   */
 
-  switch (PiiFlowController::inputGroupTypeMask(begin(), end()))
+  switch (PiiFlowController::inputGroupTypeMask(begin(), end(), _iReadyInputs))
     {
     case NoObject: // (Partially) empty group
       return IncompleteState;
@@ -219,6 +219,8 @@ private:
     bool _bStrictRelationship;
     QVector<SyncGroup*> _lstChildGroups;
     bool _bProcessable;
+    // The number of leading inputs known to contain an object.
+    int _iReadyInputs;
   };
 
   friend class SyncGroup;
@@ -23,12 +23,68 @@
 #include "PiiOneGroupFlowController.h"
 #include "PiiNullInputController.h"
 
+#include <PiiSerializationUtil.h>
+#include <PiiGenericBinaryOutputArchive.h>
+#include <PiiThreadPlacement.h>
+#include <QCryptographicHash>
+#include <QBuffer>
+
+namespace
+{
+  template <class T> void hashMatrix(QCryptographicHash& hash, const PiiVariant& object)
+  {
+    const PiiMatrix<T>& matrix = object.valueAs<PiiMatrix<T> >();
+    const int aSize[2] = { matrix.rows(), matrix.columns() };
+    hash.addData(reinterpret_cast<const char*>(aSize), sizeof(aSize));
+    // Padding at the end of rows is not part of the contents.
+    const int iRowBytes = matrix.columns() * int(sizeof(T));
+    for (int r=0; r<matrix.rows(); ++r)
+      hash.addData(reinterpret_cast<const char*>(matrix[r]), iRowBytes);
+  }
+
+  bool hashObject(QCryptographicHash& hash, const PiiVariant& object)
+  {
+    const unsigned int uiType = object.type();
+    hash.addData(reinterpret_cast<const char*>(&uiType), sizeof(uiType));
+    try
+      {
+        switch (uiType)
+          {
+            PII_PRIMITIVE_MATRIX_CASES_M(hashMatrix, (hash, object));
+            PII_COLOR_IMAGE_CASES_M(hashMatrix, (hash, object));
+            PII_COMPLEX_MATRIX_CASES_M(hashMatrix, (hash, object));
+          default:
+            hash.addData(PiiSerialization::toByteArray<PiiGenericBinaryOutputArchive>(object));
+          }
+      }
+    catch (PiiSerializationException&)
+      {
+        return false;
+      }
+    return true;
+  }
+}
+
 PiiDefaultOperation::Data::Data() :
   pFlowController(0), pProcessor(0),
   bChecked(false),
   processLock(PiiReadWriteLock::Recursive),
   iThreadCount(0),
-  threadingCapabilities(NonThreaded | SingleThreaded)
+  iMinThreadCount(0), iMaxThreadCount(0),
+  iActiveThreadCount(0),
+  threadingCapabilities(NonThreaded | SingleThreaded),
+  pThreadPool(0),
+  bOrderedOutput(true),
+  iMaxBatchSize(1),
+  bCountAllocations(Pii::isAllocationCountingEnabled()),
+  iMaxAllocations(-1),
+  pResultCache(0),
+  pMemoryBudget(0),
+  bDeterministic(false),
+  bMemoize(false),
+  bCheckDeadlines(false),
+  iNumaNode(-1),
+  iRealTimePriority(0)
 {
 }
 
@@ -53,6 +109,7 @@ PiiDefaultOperation::PiiDefaultOperation(Data* data) :
 void PiiDefaultOperation::init()
 {
   setProtectionLevel("threadCount", WriteWhenStoppedOrPaused);
+  setProtectionLevel("orderedOutput", WriteWhenStoppedOrPaused);
   createProcessor();
 }
 
@@ -107,6 +164,166 @@ bool PiiDefaultOperation::isAcceptableThreadCount(int threadCount) const
 }
 
 int PiiDefaultOperation::threadCount() const { return _d()->iThreadCount; }
+void PiiDefaultOperation::setMinThreadCount(int minThreadCount) { _d()->iMinThreadCount = qMax(minThreadCount, 0); }
+int PiiDefaultOperation::minThreadCount() const { return _d()->iMinThreadCount; }
+void PiiDefaultOperation::setMaxThreadCount(int maxThreadCount) { _d()->iMaxThreadCount = qMax(maxThreadCount, 0); }
+int PiiDefaultOperation::maxThreadCount() const { return _d()->iMaxThreadCount; }
+int PiiDefaultOperation::activeThreadCount() const { return _d()->iActiveThreadCount; }
+
+void PiiDefaultOperation::setThreadPool(PiiThreadPool* pool)
+{
+  PII_D;
+  // No change after check()
+  if (d->bChecked)
+    return;
+  d->pThreadPool = pool;
+}
+
+PiiThreadPool* PiiDefaultOperation::threadPool() const { return _d()->pThreadPool; }
+
+void PiiDefaultOperation::setResultCache(PiiResultCache* cache)
+{
+  PII_D;
+  // No change after check()
+  if (d->bChecked)
+    return;
+  d->pResultCache = cache;
+}
+
+PiiResultCache* PiiDefaultOperation::resultCache() const { return _d()->pResultCache; }
+
+void PiiDefaultOperation::setMemoryBudget(PiiMemoryBudget* budget)
+{
+  PII_D;
+  // No change after check()
+  if (d->bChecked)
+    return;
+  d->pMemoryBudget = budget;
+}
+
+PiiMemoryBudget* PiiDefaultOperation::memoryBudget() const { return _d()->pMemoryBudget; }
+qint64 PiiDefaultOperation::retainedMemory() const { return 0; }
+void PiiDefaultOperation::setDeterministic(bool deterministic) { _d()->bDeterministic = deterministic; }
+bool PiiDefaultOperation::isDeterministic() const { return _d()->bDeterministic; }
+
+QByteArray PiiDefaultOperation::stateKey() const
+{
+  QByteArray aState;
+  QBuffer buffer(&aState);
+  buffer.open(QIODevice::WriteOnly);
+  PiiGenericBinaryOutputArchive archive(&buffer);
+  // The properties of PiiDefaultOperation don't affect the results.
+  PiiSerialization::saveProperties(archive, *this, PiiDefaultOperation::staticMetaObject.propertyCount());
+  return aState;
+}
+
+QByteArray PiiDefaultOperation::resultKey() const
+{
+  const PII_D;
+  QCryptographicHash hash(QCryptographicHash::Sha1);
+  hash.addData(metaObject()->className());
+  hash.addData(d->aStateKey);
+  const int iGroupId = activeInputGroup();
+  hash.addData(reinterpret_cast<const char*>(&iGroupId), sizeof(iGroupId));
+  for (int i=0; i<d->lstInputs.size(); ++i)
+    {
+      PiiInputSocket* pInput = d->lstInputs[i];
+      if (!pInput->isConnected() || pInput->groupId() != iGroupId)
+        continue;
+      hash.addData(reinterpret_cast<const char*>(&i), sizeof(i));
+      if (!hashObject(hash, pInput->firstObject()))
+        return QByteArray();
+    }
+  return hash.result();
+}
+
+void PiiDefaultOperation::processMemoized()
+{
+  PII_D;
+  if (d->aStateKey.isEmpty())
+    {
+      try
+        {
+          d->aStateKey = stateKey();
+        }
+      catch (PiiSerializationException& ex)
+        {
+          piiWarning(tr("Disabling memoization in %1: %2").arg(metaObject()->className()).arg(ex.message()));
+          d->bMemoize = false;
+          process();
+          return;
+        }
+    }
+
+  QByteArray aKey(resultKey());
+  if (aKey.isEmpty())
+    {
+      process();
+      return;
+    }
+
+  PiiResultCache::Result result;
+  if (d->pResultCache->find(aKey, &result))
+    {
+      for (int i=0; i<result.size(); ++i)
+        if (result[i].first < d->lstOutputs.size())
+          d->lstOutputs[result[i].first]->emitObject(result[i].second);
+      return;
+    }
+
+  setRecording(&result);
+  try
+    {
+      process();
+    }
+  catch (...)
+    {
+      // Interrupted rounds are not stored.
+      setRecording(0);
+      throw;
+    }
+  setRecording(0);
+  d->pResultCache->insert(aKey, result);
+}
+
+void PiiDefaultOperation::setRecording(PiiResultCache::Result* result)
+{
+  PII_D;
+  for (int i=0; i<d->lstOutputs.size(); ++i)
+    {
+      if (result != 0)
+        d->lstOutputs[i]->startRecording(result, i);
+      else
+        d->lstOutputs[i]->stopRecording();
+    }
+}
+
+const PiiProfileHistogram& PiiDefaultOperation::processTimeHistogram() const { return _d()->processTimes; }
+const PiiProfileHistogram& PiiDefaultOperation::allocationHistogram() const { return _d()->allocations; }
+
+void PiiDefaultOperation::addAllocations(quint64 allocations)
+{
+  PII_D;
+  d->allocations.add(qint64(allocations));
+  if (d->iMaxAllocations >= 0 && allocations > quint64(d->iMaxAllocations))
+    {
+      piiWarning(tr("%1 (%2) made %3 heap allocations in one processing round. The limit is %4.")
+                 .arg(metaObject()->className()).arg(objectName())
+                 .arg(allocations).arg(d->iMaxAllocations));
+      Q_ASSERT_X(false, "PiiDefaultOperation::process()", "Too many heap allocations.");
+    }
+}
+
+void PiiDefaultOperation::resetProfile()
+{
+  PII_D;
+  d->processTimes.reset();
+  d->allocations.reset();
+  for (int i=0; i<d->lstInputs.size(); ++i)
+    d->lstInputs[i]->resetProfile();
+  for (int i=0; i<d->lstOutputs.size(); ++i)
+    d->lstOutputs[i]->resetProfile();
+}
 
 void PiiDefaultOperation::setPriority(int priority)
 {
@@ -115,6 +332,63 @@ void PiiDefaultOperation::setPriority(int priority)
 
 int PiiDefaultOperation::priority() const { return _d()->pProcessor->processingPriority(); }
 
+void PiiDefaultOperation::setCpuAffinity(const QString& cpuAffinity) { _d()->strCpuAffinity = cpuAffinity; }
+QString PiiDefaultOperation::cpuAffinity() const { return _d()->strCpuAffinity; }
+void PiiDefaultOperation::setNumaNode(int numaNode) { _d()->iNumaNode = qMax(numaNode, -1); }
+int PiiDefaultOperation::numaNode() const { return _d()->iNumaNode; }
+void PiiDefaultOperation::setRealTimePriority(int realTimePriority) { _d()->iRealTimePriority = qBound(0, realTimePriority, 99); }
+int PiiDefaultOperation::realTimePriority() const { return _d()->iRealTimePriority; }
+
+namespace
+{
+  // Returns the value of *name* in the closest parent that has one.
+  QVariant inheritedProperty(const QObject* obj, const char* name)
+  {
+    for (const QObject* pParent = obj->parent(); pParent != 0; pParent = pParent->parent())
+      {
+        QVariant value(pParent->property(name));
+        if (value.isValid())
+          return value;
+      }
+    return QVariant();
+  }
+}
+
+void PiiDefaultOperation::applyThreadPlacement()
+{
+  PII_D;
+  QString strCpuAffinity(d->strCpuAffinity);
+  if (strCpuAffinity.isEmpty())
+    strCpuAffinity = inheritedProperty(this, "cpuAffinity").toString();
+  int iNumaNode = d->iNumaNode;
+  if (iNumaNode < 0)
+    {
+      QVariant varNode(inheritedProperty(this, "numaNode"));
+      iNumaNode = varNode.isValid() ? varNode.toInt() : -1;
+    }
+  int iRealTimePriority = d->iRealTimePriority;
+  if (iRealTimePriority == 0)
+    iRealTimePriority = inheritedProperty(this, "realTimePriority").toInt();
+
+  QList<int> lstCpus(Pii::parseCpuList(strCpuAffinity));
+  if (lstCpus.isEmpty() && iNumaNode >= 0)
+    lstCpus = Pii::numaNodeCpus(iNumaNode);
+  if (!lstCpus.isEmpty() && !Pii::setThreadAffinity(lstCpus))
+    piiWarning(tr("%1: cannot set CPU affinity.").arg(objectName()));
+  if (iNumaNode >= 0 && !Pii::setThreadMemoryNode(iNumaNode))
+    piiWarning(tr("%1: cannot allocate memory from NUMA node %2.").arg(objectName()).arg(iNumaNode));
+  if (iRealTimePriority > 0 && !Pii::setThreadRealTimePriority(iRealTimePriority))
+    piiWarning(tr("%1: cannot set real-time priority %2.").arg(objectName()).arg(iRealTimePriority));
+}
+
+void PiiDefaultOperation::setMaxBatchSize(int maxBatchSize) { _d()->iMaxBatchSize = qMax(maxBatchSize, 1); }
+int PiiDefaultOperation::maxBatchSize() const { return _d()->iMaxBatchSize; }
+
+void PiiDefaultOperation::setOrderedOutput(bool orderedOutput) { _d()->bOrderedOutput = orderedOutput; }
+bool PiiDefaultOperation::orderedOutput() const { return _d()->bOrderedOutput; }
+void PiiDefaultOperation::setMaxAllocations(int maxAllocations) { _d()->iMaxAllocations = qMax(maxAllocations, -1); }
+int PiiDefaultOperation::maxAllocations() const { return _d()->iMaxAllocations; }
+
 void PiiDefaultOperation::syncEvent(SyncEvent* /*event*/) {}
 
 void PiiDefaultOperation::interrupt()
@@ -137,6 +411,9 @@ void PiiDefaultOperation::check(bool reset)
   // Install flow controller
   delete d->pFlowController;
   d->pFlowController = createFlowController();
+  // Concurrent rounds cannot share a batch.
+  if (d->pFlowController != 0 && d->iThreadCount <= 1)
+    d->pFlowController->setMaxBatchSize(d->iMaxBatchSize);
 
   // If the operation is disabled or there is no flow controller (no
   // connected inputs), disable input controller.
@@ -145,11 +422,28 @@ void PiiDefaultOperation::check(bool reset)
     static_cast<PiiInputController*>(d->pProcessor) :
     static_cast<PiiInputController*>(PiiNullInputController::instance());
   for (int i=0; i<d->lstInputs.size(); ++i)
-    d->lstInputs[i]->setController(pController);
+    {
+      d->lstInputs[i]->setController(pController);
+      d->lstInputs[i]->setMemoryBudget(d->pMemoryBudget);
+    }
 
   if (reset)
     PiiFlowController::SyncListener::reset();
 
+  // The processor may adjust the number of workers later.
+  if (reset)
+    d->iActiveThreadCount = d->iThreadCount;
+
+  // Memoized rounds must not overlap.
+  d->bMemoize = d->pResultCache != 0 && d->bDeterministic &&
+    d->iThreadCount <= 1 && d->iMaxBatchSize <= 1;
+  d->aStateKey.clear();
+
+  d->bCheckDeadlines = false;
+  for (int i=0; i<d->lstInputs.size(); ++i)
+    if (d->lstInputs[i]->maxQueueTime() > 0)
+      d->bCheckDeadlines = true;
+
   // Store flow controller to the processor
   d->pProcessor->setFlowController(d->pFlowController);
   d->pProcessor->check(reset);
@@ -252,6 +546,31 @@ bool PiiDefaultOperation::wait(unsigned long time)
   return _d()->pProcessor->wait(time);
 }
 
+bool PiiDefaultOperation::hasLateObjects(int group) const
+{
+  const PII_D;
+  for (int i=0; i<d->lstInputs.size(); ++i)
+    if (d->lstInputs[i]->groupId() == group && d->lstInputs[i]->isFirstObjectLate())
+      return true;
+  return false;
+}
+
+PiiLatencyTag PiiDefaultOperation::latencyTag(int group) const
+{
+  const PII_D;
+  // If the inputs were captured at different times, the oldest
+  // capture determines the latency.
+  PiiLatencyTag result;
+  for (int i=0; i<d->lstInputs.size(); ++i)
+    if (d->lstInputs[i]->groupId() == group)
+      {
+        PiiLatencyTag tag(d->lstInputs[i]->firstLatencyTag());
+        if (tag.isValid() && (!result.isValid() || tag.captureTime() < result.captureTime()))
+          result = tag;
+      }
+  return result;
+}
+
 int PiiDefaultOperation::activeInputGroup() const
 {
   return _d()->pProcessor->activeInputGroup();
@@ -267,9 +586,26 @@ PiiReadWriteLock* PiiDefaultOperation::processLock()
   return &_d()->processLock;
 }
 
+void PiiDefaultOperation::saveState(PiiGenericOutputArchive&) {}
+void PiiDefaultOperation::loadState(PiiGenericInputArchive&) {}
+
+void PiiDefaultOperation::saveCheckpoint(PiiGenericOutputArchive& archive)
+{
+  PiiWriteLocker lock(&_d()->processLock);
+  saveState(archive);
+}
+
+void PiiDefaultOperation::loadCheckpoint(PiiGenericInputArchive& archive)
+{
+  PiiWriteLocker lock(&_d()->processLock);
+  loadState(archive);
+}
+
 bool PiiDefaultOperation::setProperty(const char* name, const QVariant& value)
 {
   PiiWriteLocker lock(&_d()->processLock);
+  // The configuration may have changed.
+  _d()->aStateKey.clear();
   return PiiBasicOperation::setProperty(name, value);
 }
 
@@ -19,10 +19,18 @@
 #include <QList>
 #include <QStringList>
 #include <PiiReadWriteLock.h>
+#include <PiiTimer.h>
+#include <PiiAllocationCounter.h>
 #include "PiiBasicOperation.h"
 #include "PiiFlowController.h"
+#include "PiiProfileHistogram.h"
+#include "PiiTracer.h"
+#include "PiiLatencyTag.h"
+#include "PiiResultCache.h"
 
 class PiiOperationProcessor;
+class PiiThreadPool;
+class PiiMemoryBudget;
 
 /**
  * An easy-to-use implementation of the PiiOperation interface. This
@@ -89,6 +97,36 @@ class PII_YDIN_EXPORT PiiDefaultOperation :
    */
   Q_PROPERTY(int threadCount READ threadCount WRITE setThreadCount);
 
+  /**
+   * The upper limit of worker threads in adaptive mode. If this value
+   * is larger than [minThreadCount] and [threadCount] is greater than
+   * one, the number of worker threads is adjusted at run time. The
+   * operation starts with [threadCount] workers (clamped to the
+   * limits), monitors the occupancy of its input queues and the time
+   * its workers spend in [process()], and adds a worker if objects
+   * pile up in the input queues while the workers are busy. A worker
+   * is removed if the queues are nearly empty and the remaining
+   * workers could handle the load. With a shared thread pool (see
+   * [setThreadPool()]), the limit applies to the number of concurrent
+   * processing rounds. The default value is zero, which disables the
+   * adaptive mode. Changes take effect immediately.
+   */
+  Q_PROPERTY(int maxThreadCount READ maxThreadCount WRITE setMaxThreadCount);
+
+  /**
+   * The lower limit of worker threads in adaptive mode. Values
+   * smaller than one are treated as one. The default value is zero.
+   * See [maxThreadCount].
+   */
+  Q_PROPERTY(int minThreadCount READ minThreadCount WRITE setMinThreadCount);
+
+  /**
+   * The number of worker threads currently in use. If the adaptive
+   * mode is disabled, this value equals [threadCount] while the
+   * operation is running.
+   */
+  Q_PROPERTY(int activeThreadCount READ activeThreadCount);
+
   /**
    * The priority of the operation when [threadCount] is non-zero.
    * Threaded operations with a high priority are more likely to be
@@ -108,6 +146,66 @@ class PII_YDIN_EXPORT PiiDefaultOperation :
    */
   Q_PROPERTY(int priority READ priority WRITE setPriority);
 
+  /**
+   * The CPUs the processing threads of this operation may run on,
+   * e.g. "0-3,8" (see Pii::parseCpuList()). If empty (the default),
+   * the value is inherited from the closest parent compound that
+   * has a `cpuAffinity` (dynamic) property. If none is found and
+   * [numaNode] is set, the CPUs of the NUMA node will be used.
+   * Otherwise, the threads may run on any CPU.
+   *
+   * ~~~(c++)
+   * // All operations in the compound run on the second socket.
+   * compound->setProperty("numaNode", 1);
+   * // Except this one.
+   * compound->setProperty("reader.cpuAffinity", "0-1");
+   * ~~~
+   *
+   * Thread placement is applied when a processing thread starts.
+   * Operations with a [threadCount] of zero run in the thread of
+   * the sender, and operations that use a shared [threadPool] run
+   * in the pool's threads. Neither is affected.
+   */
+  Q_PROPERTY(QString cpuAffinity READ cpuAffinity WRITE setCpuAffinity);
+
+  /**
+   * The NUMA node the processing threads of this operation should
+   * run on. Memory allocated by the threads (e.g. the output images
+   * of a camera) will preferably be taken from this node. Setting
+   * this value to the node of the operations that consume the
+   * results keeps the data local to them. -1 (the default) means
+   * the value is inherited from a parent compound, if any.
+   */
+  Q_PROPERTY(int numaNode READ numaNode WRITE setNumaNode);
+
+  /**
+   * The real-time priority of the processing threads, in [1, 99].
+   * If this value is non-zero, the threads will be scheduled with
+   * SCHED_FIFO on Linux (time-critical priority on Windows). This
+   * requires appropriate privileges; a warning is logged if the
+   * priority cannot be set. Real-time scheduling is intended for
+   * capture and I/O operations that must never miss their deadline.
+   * Zero (the default) means the value is inherited from a parent
+   * compound, if any.
+   */
+  Q_PROPERTY(int realTimePriority READ realTimePriority WRITE setRealTimePriority);
+
+  /**
+   * Controls the order of output objects when [threadCount] is
+   * greater than one. If `true` (the default), the results of
+   * concurrent processing rounds are emitted in the order of the
+   * input objects, irrespective of the order in which the rounds
+   * finish. If `false`, the results of each round are released as
+   * soon as the round finishes. This removes the latency caused by
+   * slow rounds but should only be used if the order of objects does
+   * not matter to the receivers. Since the results of a round on
+   * different outputs may be released at different times, no
+   * receiver may synchronize objects from two or more outputs of an
+   * unordered operation. This property can only be changed when the
+   * operation is stopped or paused.
+   */
+  Q_PROPERTY(bool orderedOutput READ orderedOutput WRITE setOrderedOutput);
+
   /**
    * This property lists the threading modes the operation is allowed
    * to run in. The default value is `NonThreaded |
@@ -118,6 +216,19 @@ class PII_YDIN_EXPORT PiiDefaultOperation :
   Q_PROPERTY(ThreadingCapabilities threadingCapabilities READ threadingCapabilities);
   Q_FLAGS(ThreadingCapabilities);
 
+  /**
+   * The maximum number of heap allocations a single processing round
+   * may make. If a round exceeds the limit, a warning is printed and,
+   * in debug builds, an assertion fails. Setting the limit to zero
+   * after a warm-up phase (see PiiEngine::warmUp()) asserts that the
+   * operation has reached an allocation-free steady state. The count
+   * includes allocations made by non-threaded receivers called
+   * synchronously from [process()]. -1 (the default) disables the
+   * check. Allocations are only counted if Into was built with
+   * allocation counting (see Pii::isAllocationCountingEnabled()).
+   */
+  Q_PROPERTY(int maxAllocations READ maxAllocations WRITE setMaxAllocations);
+
 public:
   typedef PiiFlowController::SyncEvent SyncEvent;
 
@@ -213,6 +324,95 @@ public:
    */
   bool wait(unsigned long time = ULONG_MAX);
 
+  /**
+   * Sets the thread pool used for processing. If *pool* is non-zero
+   * and [threadCount] is greater than one, the operation does not
+   * create threads of its own. Instead, each processing round is
+   * submitted to *pool*, and [threadCount] limits the number of
+   * rounds that may run concurrently. Operations with no connected
+   * inputs always use threads of their own. The operation does not
+   * take the ownership of the pool. The change takes effect on the
+   * next call to [check()]. PiiEngine calls this function if its
+   * [threadPoolSize](PiiEngine::threadPoolSize) is non-zero.
+   */
+  void setThreadPool(PiiThreadPool* pool);
+  /**
+   * Returns the thread pool used for processing, or zero if the
+   * operation uses threads of its own.
+   */
+  PiiThreadPool* threadPool() const;
+
+  /**
+   * Sets the cache used for memoizing processing rounds. If *cache*
+   * is non-zero and the operation is deterministic (see
+   * [setDeterministic()]), each processing round first computes a
+   * [result key](resultKey()) and looks it up in *cache*. On a hit,
+   * the stored objects are emitted without calling [process()].
+   * Otherwise, the objects emitted by [process()] through
+   * [PiiOutputSocket::emitObject()] and
+   * [PiiOutputSocket::emitObjects()] are stored in the cache.
+   * Memoization is not used if [threadCount] is greater than one or
+   * batch mode is enabled. The operation does not take the ownership
+   * of the cache. The change takes effect on the next call to
+   * [check()]. See also PiiEngine::setResultCache().
+   */
+  void setResultCache(PiiResultCache* cache);
+  /**
+   * Returns the cache used for memoizing processing rounds, or zero
+   * if no cache has been set.
+   */
+  PiiResultCache* resultCache() const;
+
+  /**
+   * Sets the memory budget the operation's input queues and caches
+   * are accounted to. [check()] installs *budget* to all input
+   * sockets (see PiiInputSocket::setMemoryBudget()). Subclasses that
+   * hold large amounts of data, such as caches, can use
+   * [memoryBudget()] to report their memory and to shrink when the
+   * budget is under pressure. The operation does not take the
+   * ownership of the budget. The change takes effect on the next call
+   * to [check()]. See also PiiEngine::setMemoryBudget().
+   */
+  void setMemoryBudget(PiiMemoryBudget* budget);
+  /**
+   * Returns the memory budget, or zero if none has been set.
+   */
+  PiiMemoryBudget* memoryBudget() const;
+
+  /**
+   * Returns the number of bytes the operation holds in addition to
+   * its input queues, for example in a cache. The value is reported
+   * in PiiEngine::profile(). The default implementation returns
+   * zero.
+   */
+  virtual qint64 retainedMemory() const;
+
+  /**
+   * Returns `true` if the operation has declared itself
+   * deterministic, and `false` otherwise. See [setDeterministic()].
+   */
+  bool isDeterministic() const;
+
+  /**
+   * Returns a histogram of the durations of processing rounds in
+   * microseconds. Each call to [process()] that returns normally is
+   * recorded. The histogram is never cleared automatically; use
+   * [resetProfile()] to start over.
+   */
+  const PiiProfileHistogram& processTimeHistogram() const;
+  /**
+   * Returns a histogram of the number of heap allocations made by
+   * each processing round. The histogram is empty unless Into was
+   * built with allocation counting (see
+   * Pii::isAllocationCountingEnabled()).
+   */
+  const PiiProfileHistogram& allocationHistogram() const;
+  /**
+   * Clears the profiling statistics of this operation and its input
+   * and output sockets.
+   */
+  void resetProfile();
+
 protected:
   /// @internal
   class PII_YDIN_EXPORT Data : public PiiBasicOperation::Data
@@ -226,6 +426,7 @@ protected:
     friend class PiiSimpleProcessor;
     friend class PiiThreadedProcessor;
     friend class PiiMultiThreadedProcessor;
+    friend class PiiFusedChain;
 
     // Handles object flow. Synchronizes inputs etc.
     PiiFlowController* pFlowController;
@@ -240,7 +441,28 @@ protected:
 
     mutable PiiReadWriteLock processLock;
     int iThreadCount;
+    int iMinThreadCount, iMaxThreadCount;
+    int iActiveThreadCount;
     ThreadingCapabilities threadingCapabilities;
+    PiiThreadPool* pThreadPool;
+    bool bOrderedOutput;
+    int iMaxBatchSize;
+    PiiProfileHistogram processTimes;
+    PiiProfileHistogram allocations;
+    // Cached Pii::isAllocationCountingEnabled().
+    bool bCountAllocations;
+    int iMaxAllocations;
+    PiiResultCache* pResultCache;
+    PiiMemoryBudget* pMemoryBudget;
+    bool bDeterministic;
+    bool bMemoize;
+    // Cached stateKey(), cleared on property changes.
+    QByteArray aStateKey;
+    // True if any input has a maxQueueTime.
+    bool bCheckDeadlines;
+    QString strCpuAffinity;
+    int iNumaNode;
+    int iRealTimePriority;
   };
   PII_D_FUNC;
 
@@ -249,13 +471,123 @@ protected:
 
   void setThreadCount(int threadCount);
   int threadCount() const;
+  void setMinThreadCount(int minThreadCount);
+  int minThreadCount() const;
+  void setMaxThreadCount(int maxThreadCount);
+  int maxThreadCount() const;
+  int activeThreadCount() const;
 
   void setPriority(int priority);
   int priority() const;
 
+  void setCpuAffinity(const QString& cpuAffinity);
+  QString cpuAffinity() const;
+  void setNumaNode(int numaNode);
+  int numaNode() const;
+  void setRealTimePriority(int realTimePriority);
+  int realTimePriority() const;
+
+  /**
+   * Applies [cpuAffinity], [numaNode] and [realTimePriority] to the
+   * calling thread. The processors call this function whenever they
+   * start a thread. Subclasses that receive data in threads they
+   * don't own, such as the capture threads of a camera driver,
+   * can call it from those threads.
+   */
+  void applyThreadPlacement();
+
+  void setOrderedOutput(bool orderedOutput);
+  bool orderedOutput() const;
+
   void setThreadingCapabilities(ThreadingCapabilities threadingCapabilities);
   ThreadingCapabilities threadingCapabilities() const;
 
+  void setMaxAllocations(int maxAllocations);
+  int maxAllocations() const;
+
+  /**
+   * Enables batch mode. An operation whose [process()] function can
+   * handle many objects at once calls this function in its
+   * constructor. If *maxBatchSize* is greater than one, the flow
+   * controller passes up to that many consecutive queued objects to
+   * a single processing round. [process()] must then read all
+   * objects from the input with [PiiInputSocket::batchSize()] and
+   * [PiiInputSocket::batchObject()] and may send its results with
+   * [PiiOutputSocket::emitObjects()].
+   *
+   * ~~~(c++)
+   * MyOperation::MyOperation()
+   * {
+   *   addSocket(_pInput = new PiiInputSocket("input"));
+   *   addSocket(_pOutput = new PiiOutputSocket("output"));
+   *   _pInput->setQueueCapacity(64);
+   *   setMaxBatchSize(64);
+   * }
+   *
+   * void MyOperation::process()
+   * {
+   *   PiiVariantList lstResults;
+   *   for (int i=0; i<_pInput->batchSize(); ++i)
+   *     lstResults << PiiVariant(_pInput->batchObject(i).valueAs<double>() * 2);
+   *   _pOutput->emitObjects(lstResults);
+   * }
+   * ~~~
+   *
+   * Batches are formed of objects that are already in the input
+   * queue. They are thus limited by [PiiInputSocket::queueCapacity],
+   * and they only form if objects arrive faster than they are
+   * processed. This usually requires [threadCount] to be one.
+   * Control objects end a batch, so sync events and state changes
+   * are handled exactly as in the default mode.
+   *
+   * Batch mode is only used if the operation has exactly one
+   * connected input and [threadCount] is at most one. Otherwise each
+   * round gets a single object, and batchSize() returns one. The
+   * default value is one. The change takes effect on the next call to
+   * [check()].
+   */
+  void setMaxBatchSize(int maxBatchSize);
+  int maxBatchSize() const;
+
+  /**
+   * Declares the operation deterministic. A deterministic operation
+   * emits the same objects whenever it receives the same input
+   * objects with the same configuration, emits all of them in
+   * [process()], and keeps no state between processing rounds.
+   * The results of such an operation can be memoized (see
+   * [setResultCache()]). Operations that read files, use random
+   * numbers, or accumulate data over many rounds must not be flagged
+   * deterministic. The default is `false`.
+   */
+  void setDeterministic(bool deterministic);
+
+  /**
+   * Returns a serialized representation of the configuration that
+   * affects the results of [process()]. The default implementation
+   * serializes all stored, writable properties declared by
+   * subclasses of PiiDefaultOperation. Subclasses may override this
+   * function to exclude properties that don't affect the results, or
+   * to add internal configuration that is not visible as properties.
+   * The value is computed once after [check()] and after each call to
+   * [setProperty()].
+   *
+   * @exception PiiSerializationException& if the configuration
+   * cannot be serialized. Memoization will then be disabled.
+   */
+  virtual QByteArray stateKey() const;
+
+  /**
+   * Returns the key the results of the current processing round are
+   * stored with in the [result cache](setResultCache()). The key is a
+   * SHA-1 hash of the class name, [stateKey()], the
+   * [active input group](activeInputGroup()), and the contents of
+   * the objects in the connected inputs of that group. Matrices are
+   * hashed by their contents, other types through their serialized
+   * form. Returns an empty array if an input object cannot be
+   * serialized, which disables memoization for the round.
+   */
+  QByteArray resultKey() const;
+
   /**
    * Executes one round of processing. This function is invoked by the
    * processor if the necessary preconditions for a new processing
@@ -379,23 +711,80 @@ protected:
    */
   PiiReadWriteLock* processLock();
 
+  /**
+   * Writes the running state of the operation to *archive*. This
+   * function is called by [checkpoint()] with [processLock()] locked
+   * for writing, so it never overlaps [process()]. Subclasses that
+   * accumulate state over processing rounds should override this
+   * function and [loadState()]. The default implementation does
+   * nothing.
+   *
+   * ~~~(c++)
+   * void MyOperation::saveState(PiiGenericOutputArchive& archive)
+   * {
+   *   archive << _d()->matModel;
+   * }
+   *
+   * void MyOperation::loadState(PiiGenericInputArchive& archive)
+   * {
+   *   archive >> _d()->matModel;
+   * }
+   * ~~~
+   */
+  virtual void saveState(PiiGenericOutputArchive& archive);
+  /**
+   * Reads the running state written by [saveState()] from
+   * *archive*. Called by [restoreCheckpoint()] with [processLock()]
+   * locked for writing. The default implementation does nothing.
+   */
+  virtual void loadState(PiiGenericInputArchive& archive);
+
+  void saveCheckpoint(PiiGenericOutputArchive& archive);
+  void loadCheckpoint(PiiGenericInputArchive& archive);
+
 private:
   void init();
   void createProcessor();
+  void processMemoized();
+  void setRecording(PiiResultCache::Result* result);
+  bool hasLateObjects(int group) const;
+  PiiLatencyTag latencyTag(int group) const;
+  void addAllocations(quint64 allocations);
 
   friend class PiiSimpleProcessor;
   friend class PiiThreadedProcessor;
   friend class PiiMultiThreadedProcessor;
+  friend class PiiFusedChain;
 
   inline void processLocked()
   {
     PiiReadLocker lock(&_d()->processLock);
-    process();
+    PiiTracer::Scope scope("process", this);
+    // Objects emitted during the round inherit the tag of its inputs.
+    PiiLatencyTag::Scope tagScope(PiiLatencyTag::isEnabled() ? latencyTag(activeInputGroup()) : PiiLatencyTag());
+    const quint64 iStartAllocations = _d()->bCountAllocations ? Pii::allocationCount() : 0;
+    const qint64 iStartTime = PiiTimer::currentTime();
+    if (_d()->bMemoize)
+      processMemoized();
+    else
+      process();
+    _d()->processTimes.add(PiiTimer::currentTime() - iStartTime);
+    if (_d()->bCountAllocations)
+      addAllocations(Pii::allocationCount() - iStartAllocations);
+  }
+
+  // Returns true if the objects of the active round must be
+  // discarded without processing.
+  inline bool discardLateObjects(PiiFlowController* controller) const
+  {
+    return _d()->bCheckDeadlines && hasLateObjects(controller->activeInputGroup());
   }
 
   inline void sendSyncEvents(PiiFlowController* controller)
   {
     PiiReadLocker lock(&_d()->processLock);
+    PiiTracer::Scope scope("sync", this);
+    PiiLatencyTag::Scope tagScope(PiiLatencyTag::isEnabled() ? latencyTag(controller->activeInputGroup()) : PiiLatencyTag());
     controller->sendSyncEvents(this);
   }
 
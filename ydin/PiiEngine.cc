@@ -19,14 +19,26 @@
 #include <PiiUtil.h>
 #include <PiiFileUtil.h>
 #include "PiiPlugin.h"
+#include "PiiDefaultOperation.h"
+#include "PiiMemoryBudget.h"
+#include <PiiThreadPool.h>
+#include "PiiTracer.h"
+#include "PiiFusedChain.h"
+#include "PiiOutputSocket.h"
+#include "PiiProxySocket.h"
 #include <PiiGenericTextOutputArchive.h>
 #include <PiiGenericBinaryOutputArchive.h>
 #include <PiiGenericTextInputArchive.h>
 #include <PiiGenericBinaryInputArchive.h>
+#ifndef PII_NO_NETWORK
+#  include "PiiRemoteOperation.h"
+#endif
 
 #include <QLibrary>
 #include <QFile>
 #include <QFileInfo>
+#include <QTextStream>
+#include <QSet>
 
 PII_DEFINE_VIRTUAL_METAOBJECT_FUNCTION(PiiEngine)
 PII_SERIALIZABLE_EXPORT(PiiEngine);
@@ -35,6 +47,7 @@ static int iEngineMetaType = qRegisterMetaType<PiiEngine*>("PiiEngine*");
 static int iPluginMetaType = qRegisterMetaType<PiiEngine::Plugin>("PiiEngine::Plugin");
 
 PiiEngine::PluginMap PiiEngine::_pluginMap;
+QHash<QString,QString> PiiEngine::_pluginIndex;
 QMutex PiiEngine::_pluginLock;
 
 class PiiEngine::Plugin::Data
@@ -51,7 +64,24 @@ public:
 } *d;
 
 
-PiiEngine::PiiEngine()
+PiiEngine::Data::Data() :
+  iThreadPoolSize(0),
+  pThreadPool(0),
+  iTraceSamplingInterval(0),
+  bOperationFusion(true),
+  pResultCache(0),
+  pMemoryBudget(0)
+{
+}
+
+PiiEngine::Data::~Data()
+{
+  qDeleteAll(lstFusedChains);
+  delete pThreadPool;
+}
+
+PiiEngine::PiiEngine() :
+  PiiOperationCompound(new Data)
 {
   Q_UNUSED(iEngineMetaType); // suppresses compiler warning
   Q_UNUSED(iPluginMetaType);
@@ -70,7 +100,19 @@ PiiEngine::PiiEngine(Data* data) : PiiOperationCompound(data)
 {}
 
 PiiEngine::~PiiEngine()
-{}
+{
+  PII_D;
+  if (state() == Stopped)
+    undeploy();
+  else
+    {
+      // The remote operations are owned by their parents, but the
+      // originals are not owned by anyone.
+      for (int i=0; i<d->lstDeployments.size(); ++i)
+        delete d->lstDeployments[i].pOriginal;
+      d->lstDeployments.clear();
+    }
+}
 
 void PiiEngine::execute(ErrorHandling errorHandling)
 {
@@ -79,10 +121,30 @@ void PiiEngine::execute(ErrorHandling errorHandling)
   State s = state();
   if (s member_of (Stopped, Paused))
     {
+      // The thread pool can only be changed when all child
+      // operations are stopped.
+      if (s == Stopped)
+        {
+          deploy();
+          if (d->iThreadPoolSize != 0)
+            {
+              int iThreadCount = d->iThreadPoolSize > 0 ? d->iThreadPoolSize : 0;
+              if (d->pThreadPool == 0)
+                d->pThreadPool = new PiiThreadPool(iThreadCount);
+              else if (iThreadCount > 0)
+                d->pThreadPool->setThreadCount(iThreadCount);
+            }
+          setThreadPool(this, d->iThreadPoolSize != 0 ? d->pThreadPool : 0);
+          setResultCache(this, d->pResultCache);
+          setMemoryBudget(this, d->pMemoryBudget);
+          if (d->iTraceSamplingInterval > 0 && !PiiTracer::isEnabled())
+            PiiTracer::start(d->iTraceSamplingInterval);
+        }
       try
         {
           // Reset children if we were stopped
           check(s == Stopped);
+          fuseOperations();
         }
       catch (...)
         {
@@ -93,6 +155,264 @@ void PiiEngine::execute(ErrorHandling errorHandling)
     }
 }
 
+namespace
+{
+  // Restores the connections and activity modes changed by warmUp()
+  // no matter how it exits.
+  struct WarmUpState
+  {
+    ~WarmUpState()
+    {
+      for (int i=0; i<lstInputs.size(); ++i)
+        {
+          delete lstOutputs[i];
+          if (lstOriginalOutputs[i] != 0)
+            lstOriginalOutputs[i]->connectInput(lstInputs[i]);
+        }
+      for (int i=0; i<lstDisabledOperations.size(); ++i)
+        lstDisabledOperations[i]->setActivityMode(PiiOperation::Enabled);
+    }
+
+    QList<PiiAbstractInputSocket*> lstInputs;
+    QList<PiiAbstractOutputSocket*> lstOriginalOutputs;
+    QList<PiiOutputSocket*> lstOutputs;
+    QList<PiiOperation*> lstDisabledOperations;
+  };
+}
+
+void PiiEngine::warmUp(const QMap<QString,PiiVariant>& objects, int rounds, unsigned long timeout)
+{
+  if (state() != Stopped)
+    PII_THROW(PiiExecutionException, tr("The engine must be stopped before warming up."));
+
+  WarmUpState warmUpState;
+  QSet<PiiOperation*> setReached;
+  for (QMap<QString,PiiVariant>::const_iterator i = objects.constBegin(); i != objects.constEnd(); ++i)
+    {
+      PiiAbstractInputSocket* pInput = input(i.key());
+      if (pInput == 0)
+        PII_THROW(PiiExecutionException, tr("There is no input called \"%1\".").arg(i.key()));
+      PiiOutputSocket* pOutput = new PiiOutputSocket(i.key());
+      warmUpState.lstInputs << pInput;
+      warmUpState.lstOriginalOutputs << pInput->connectedOutput();
+      warmUpState.lstOutputs << pOutput;
+      pOutput->connectInput(pInput);
+      if (PiiOperation* pChild = childOf(pInput->parentOperation()))
+        setReached << pChild;
+    }
+
+  // Find all child operations that are reached from the warmed-up
+  // inputs.
+  QList<PiiOperation*> lstOperations = childOperations();
+  bool bReachedSome;
+  do
+    {
+      bReachedSome = false;
+      for (int i=0; i<lstOperations.size(); ++i)
+        {
+          if (setReached.contains(lstOperations[i]))
+            continue;
+          QList<PiiAbstractInputSocket*> lstInputs = lstOperations[i]->inputs();
+          for (int j=0; j<lstInputs.size(); ++j)
+            {
+              PiiAbstractOutputSocket* pRoot = PiiProxySocket::root(lstInputs[j]->connectedOutput());
+              if (pRoot != 0 && setReached.contains(childOf(pRoot->parentOperation())))
+                {
+                  setReached << lstOperations[i];
+                  bReachedSome = true;
+                  break;
+                }
+            }
+        }
+    }
+  while (bReachedSome);
+
+  for (int i=0; i<lstOperations.size(); ++i)
+    {
+      if (!setReached.contains(lstOperations[i]) &&
+          lstOperations[i]->activityMode() == Enabled)
+        {
+          lstOperations[i]->setActivityMode(Disabled);
+          warmUpState.lstDisabledOperations << lstOperations[i];
+        }
+    }
+
+  execute();
+  try
+    {
+      for (int iRound=0; iRound<rounds; ++iRound)
+        {
+          QMap<QString,PiiVariant>::const_iterator it = objects.constBegin();
+          for (int i=0; i<warmUpState.lstOutputs.size(); ++i, ++it)
+            warmUpState.lstOutputs[i]->emitObject(it.value());
+        }
+      for (int i=0; i<warmUpState.lstOutputs.size(); ++i)
+        warmUpState.lstOutputs[i]->emitObject(PiiYdin::createStopTag());
+    }
+  catch (PiiExecutionException&)
+    {
+      interrupt();
+      wait();
+      throw;
+    }
+
+  if (!wait(timeout))
+    {
+      interrupt();
+      wait();
+      PII_THROW(PiiExecutionException, tr("The engine did not stop within %1 ms after warm-up.").arg(timeout));
+    }
+  resetProfile();
+}
+
+PiiOperation* PiiEngine::childOf(PiiOperation* operation) const
+{
+  while (operation != 0 && operation->parent() != this)
+    operation = qobject_cast<PiiOperation*>(operation->parent());
+  return operation;
+}
+
+void PiiEngine::setThreadPool(PiiOperationCompound* compound, PiiThreadPool* pool)
+{
+  QList<PiiOperation*> lstOperations = compound->childOperations();
+  for (int i=0; i<lstOperations.size(); ++i)
+    {
+      if (PiiDefaultOperation* pOperation = qobject_cast<PiiDefaultOperation*>(lstOperations[i]))
+        pOperation->setThreadPool(pool);
+      else if (PiiOperationCompound* pCompound = qobject_cast<PiiOperationCompound*>(lstOperations[i]))
+        setThreadPool(pCompound, pool);
+    }
+}
+
+void PiiEngine::setResultCache(PiiOperationCompound* compound, PiiResultCache* cache)
+{
+  QList<PiiOperation*> lstOperations = compound->childOperations();
+  for (int i=0; i<lstOperations.size(); ++i)
+    {
+      if (PiiDefaultOperation* pOperation = qobject_cast<PiiDefaultOperation*>(lstOperations[i]))
+        pOperation->setResultCache(cache);
+      else if (PiiOperationCompound* pCompound = qobject_cast<PiiOperationCompound*>(lstOperations[i]))
+        setResultCache(pCompound, cache);
+    }
+}
+
+void PiiEngine::setMemoryBudget(PiiOperationCompound* compound, PiiMemoryBudget* budget)
+{
+  QList<PiiOperation*> lstOperations = compound->childOperations();
+  for (int i=0; i<lstOperations.size(); ++i)
+    {
+      if (PiiDefaultOperation* pOperation = qobject_cast<PiiDefaultOperation*>(lstOperations[i]))
+        pOperation->setMemoryBudget(budget);
+      else if (PiiOperationCompound* pCompound = qobject_cast<PiiOperationCompound*>(lstOperations[i]))
+        setMemoryBudget(pCompound, budget);
+    }
+}
+
+void PiiEngine::fuseOperations()
+{
+  PII_D;
+  // check() has restored the original input controllers.
+  qDeleteAll(d->lstFusedChains);
+  d->lstFusedChains.clear();
+  if (d->bOperationFusion)
+    d->lstFusedChains = PiiFusedChain::install(this);
+}
+
+void PiiEngine::deploy()
+{
+  PII_D;
+  QMutexLocker lock(&d->stateMutex);
+  if (state() != Stopped)
+    PII_THROW(PiiExecutionException, tr("The engine must be stopped before deployment."));
+  if (!d->lstDeployments.isEmpty())
+    return;
+  try
+    {
+      deploy(this);
+    }
+  catch (PiiException&)
+    {
+      undeploy();
+      throw;
+    }
+}
+
+void PiiEngine::deploy(PiiOperationCompound* compound)
+{
+  QList<PiiOperation*> lstOperations = compound->childOperations();
+  for (int i=0; i<lstOperations.size(); ++i)
+    {
+      PiiOperationCompound* pCompound = qobject_cast<PiiOperationCompound*>(lstOperations[i]);
+      if (pCompound == 0)
+        continue;
+      QString strNode = pCompound->property("node").toString();
+      if (strNode.isEmpty())
+        {
+          deploy(pCompound);
+          continue;
+        }
+#ifndef PII_NO_NETWORK
+      PiiOperation* pRemote = 0;
+      try
+        {
+          pRemote = PiiRemoteOperation::deploy(strNode, pCompound);
+        }
+      catch (PiiException& ex)
+        {
+          PII_THROW(PiiExecutionException, tr("Cannot deploy %1 to %2: %3")
+                    .arg(pCompound->objectName()).arg(strNode).arg(ex.message()));
+        }
+      if (!compound->replaceOperation(pCompound, pRemote))
+        {
+          delete pRemote;
+          PII_THROW(PiiExecutionException, tr("Cannot replace %1 with a remote operation.")
+                    .arg(pCompound->objectName()));
+        }
+      Data::Deployment deployment = { compound, pCompound, pRemote };
+      _d()->lstDeployments << deployment;
+#else
+      PII_THROW(PiiExecutionException, tr("Cannot deploy %1. Network support is disabled.")
+                .arg(pCompound->objectName()));
+#endif
+    }
+}
+
+void PiiEngine::undeploy()
+{
+  PII_D;
+  QMutexLocker lock(&d->stateMutex);
+  if (state() != Stopped)
+    PII_THROW(PiiExecutionException, tr("The engine must be stopped before undeployment."));
+  while (!d->lstDeployments.isEmpty())
+    {
+      Data::Deployment deployment = d->lstDeployments.takeLast();
+      deployment.pParent->replaceOperation(deployment.pRemote, deployment.pOriginal);
+      // Deleting the remote operation removes the deployed copy.
+      delete deployment.pRemote;
+    }
+}
+
+bool PiiEngine::isDeployed() const
+{
+  return !_d()->lstDeployments.isEmpty();
+}
+
+void PiiEngine::setThreadPoolSize(int threadPoolSize) { _d()->iThreadPoolSize = qMax(threadPoolSize, -1); }
+int PiiEngine::threadPoolSize() const { return _d()->iThreadPoolSize; }
+void PiiEngine::setTraceSamplingInterval(int traceSamplingInterval) { _d()->iTraceSamplingInterval = qMax(traceSamplingInterval, 0); }
+int PiiEngine::traceSamplingInterval() const { return _d()->iTraceSamplingInterval; }
+void PiiEngine::setOperationFusion(bool operationFusion) { _d()->bOperationFusion = operationFusion; }
+bool PiiEngine::operationFusion() const { return _d()->bOperationFusion; }
+void PiiEngine::setResultCache(PiiResultCache* cache) { _d()->pResultCache = cache; }
+PiiResultCache* PiiEngine::resultCache() const { return _d()->pResultCache; }
+void PiiEngine::setMemoryBudget(PiiMemoryBudget* budget) { _d()->pMemoryBudget = budget; }
+PiiMemoryBudget* PiiEngine::memoryBudget() const { return _d()->pMemoryBudget; }
+
+int PiiEngine::saveTrace(const QString& fileName)
+{
+  return PiiTracer::save(fileName);
+}
+
 void PiiEngine::loadPlugins(const QStringList& plugins)
 {
   for (int i=0; i<plugins.size(); ++i)
@@ -179,6 +499,65 @@ PiiEngine::Plugin PiiEngine::loadPlugin(const QString& name)
   return plugin;
 }
 
+void PiiEngine::savePluginIndex(const QString& fileName)
+{
+  QFile file(fileName);
+  if (!file.open(QIODevice::WriteOnly | QIODevice::Text))
+    PII_THROW(PiiLoadException, tr("Cannot open %1 for writing.").arg(fileName));
+
+  QMutexLocker lock(&_pluginLock);
+  QTextStream stream(&file);
+  for (PluginMap::const_iterator i = _pluginMap.constBegin(); i != _pluginMap.constEnd(); ++i)
+    {
+      // Find all subjects that satisfy <subject, "pii:parent", "PluginName">
+      QList<QString> lstClasses = PiiYdin::resourceDatabase()->
+        select(Pii::subject,
+               Pii::object == i.value().resourceName() &&
+               Pii::predicate == PiiYdin::parentPredicate);
+      for (int j=0; j<lstClasses.size(); ++j)
+        stream << lstClasses[j] << '\t' << i.key() << '\n';
+    }
+  stream.flush();
+  if (file.error() != QFile::NoError)
+    PII_THROW(PiiLoadException, tr("Cannot write plug-in index to %1.").arg(fileName));
+}
+
+void PiiEngine::loadPluginIndex(const QString& fileName)
+{
+  QFile file(fileName);
+  if (!file.open(QIODevice::ReadOnly | QIODevice::Text))
+    PII_THROW(PiiLoadException, tr("Cannot open %1 for reading.").arg(fileName));
+
+  QHash<QString,QString> hashIndex;
+  QTextStream stream(&file);
+  while (!stream.atEnd())
+    {
+      QStringList lstParts(stream.readLine().split('\t'));
+      if (lstParts.size() != 2 || lstParts[0].isEmpty() || lstParts[1].isEmpty())
+        continue;
+      hashIndex.insert(lstParts[0], lstParts[1]);
+    }
+
+  QMutexLocker lock(&_pluginLock);
+  for (QHash<QString,QString>::const_iterator i = hashIndex.constBegin(); i != hashIndex.constEnd(); ++i)
+    _pluginIndex.insert(i.key(), i.value());
+}
+
+bool PiiEngine::loadPluginFor(const QString& className)
+{
+  QMutexLocker lock(&_pluginLock);
+  QHash<QString,QString>::const_iterator i = _pluginIndex.constFind(className);
+  if (i == _pluginIndex.constEnd())
+    return false;
+  QString strPlugin(i.value());
+  if (_pluginMap.contains(strPlugin))
+    return true;
+  // loadPlugin() takes the lock again.
+  lock.unlock();
+  loadPlugin(strPlugin);
+  return true;
+}
+
 int PiiEngine::unloadPlugin(const QString& name, bool force)
 {
   QMutexLocker lock(&_pluginLock);
@@ -259,6 +638,126 @@ QStringList PiiEngine::usedPluginResourceNames()
   return usedPluginResourceNames(this);
 }
 
+QVariantMap PiiEngine::profile() const
+{
+  return profile(const_cast<PiiEngine*>(this));
+}
+
+QVariantMap PiiEngine::profile(PiiOperation* operation)
+{
+  QVariantMap mapResult;
+  mapResult["class"] = operation->metaObject()->className();
+
+  PiiDefaultOperation* pDefaultOperation = qobject_cast<PiiDefaultOperation*>(operation);
+  if (pDefaultOperation != 0)
+    {
+      mapResult["processTime"] = pDefaultOperation->processTimeHistogram().toVariantMap();
+      if (Pii::isAllocationCountingEnabled())
+        mapResult["allocations"] = pDefaultOperation->allocationHistogram().toVariantMap();
+    }
+
+  const bool bAccounted = pDefaultOperation != 0 && pDefaultOperation->memoryBudget() != 0;
+  qint64 lQueuedBytes = 0;
+
+  QVariantMap mapInputs;
+  QList<PiiAbstractInputSocket*> lstInputs = operation->inputs();
+  for (int i=0; i<lstInputs.size(); ++i)
+    {
+      if (PiiInputSocket* pInput = qobject_cast<PiiInputSocket*>(lstInputs[i]))
+        {
+          QVariantMap mapInput;
+          mapInput["queueLength"] = pInput->queueLengthHistogram().toVariantMap();
+          mapInput["currentLength"] = pInput->queueLength();
+          mapInput["capacity"] = pInput->queueCapacity();
+          mapInput["rejected"] = pInput->rejectedObjectCount();
+          mapInput["dropped"] = pInput->droppedObjectCount();
+          mapInput["late"] = pInput->lateObjectCount();
+          if (pInput->latencyHistogram().count() > 0)
+            {
+              mapInput["latency"] = pInput->latencyHistogram().toVariantMap();
+              mapInput["stageLatency"] = pInput->stageLatencyHistogram().toVariantMap();
+            }
+          if (bAccounted)
+            {
+              const qint64 lBytes = pInput->queuedBytes();
+              mapInput["queuedBytes"] = lBytes;
+              lQueuedBytes += lBytes;
+            }
+          mapInputs[pInput->objectName()] = mapInput;
+        }
+    }
+  if (!mapInputs.isEmpty())
+    mapResult["inputs"] = mapInputs;
+
+  if (bAccounted)
+    {
+      QVariantMap mapMemory;
+      mapMemory["queued"] = lQueuedBytes;
+      mapMemory["retained"] = pDefaultOperation->retainedMemory();
+      mapResult["memory"] = mapMemory;
+    }
+
+  QVariantMap mapOutputs;
+  QList<PiiAbstractOutputSocket*> lstOutputs = operation->outputs();
+  for (int i=0; i<lstOutputs.size(); ++i)
+    {
+      if (PiiOutputSocket* pOutput = qobject_cast<PiiOutputSocket*>(lstOutputs[i]))
+        {
+          QVariantMap mapOutput;
+          mapOutput["blockedEmitTime"] = pOutput->blockedEmitHistogram().toVariantMap();
+          mapOutput["queueDepth"] = pOutput->queueDepthHistogram().toVariantMap();
+          mapOutput["buffered"] = pOutput->bufferedObjectCount();
+          mapOutputs[pOutput->objectName()] = mapOutput;
+        }
+    }
+  if (!mapOutputs.isEmpty())
+    mapResult["outputs"] = mapOutputs;
+
+  if (PiiOperationCompound* pCompound = qobject_cast<PiiOperationCompound*>(operation))
+    {
+      QVariantMap mapOperations;
+      QList<PiiOperation*> lstOperations = pCompound->childOperations();
+      for (int i=0; i<lstOperations.size(); ++i)
+        mapOperations[lstOperations[i]->objectName()] = profile(lstOperations[i]);
+      mapResult["operations"] = mapOperations;
+    }
+
+  PiiEngine* pEngine = qobject_cast<PiiEngine*>(operation);
+  if (pEngine != 0 && pEngine->memoryBudget() != 0)
+    {
+      PiiMemoryBudget* pBudget = pEngine->memoryBudget();
+      QVariantMap mapBudget;
+      mapBudget["usage"] = pBudget->usage();
+      mapBudget["peakUsage"] = pBudget->peakUsage();
+      mapBudget["limit"] = pBudget->limit();
+      mapBudget["softLimit"] = pBudget->softLimit();
+      mapBudget["rejected"] = pBudget->rejectionCount();
+      mapResult["memoryBudget"] = mapBudget;
+    }
+  return mapResult;
+}
+
+void PiiEngine::resetProfile()
+{
+  resetProfile(this);
+}
+
+void PiiEngine::resetProfile(PiiOperation* operation)
+{
+  PiiEngine* pEngine = qobject_cast<PiiEngine*>(operation);
+  if (pEngine != 0 && pEngine->memoryBudget() != 0)
+    pEngine->memoryBudget()->resetStatistics();
+
+  if (PiiDefaultOperation* pOperation = qobject_cast<PiiDefaultOperation*>(operation))
+    pOperation->resetProfile();
+  else if (PiiOperationCompound* pCompound = qobject_cast<PiiOperationCompound*>(operation))
+    {
+      QList<PiiOperation*> lstOperations = pCompound->childOperations();
+      for (int i=0; i<lstOperations.size(); ++i)
+        resetProfile(lstOperations[i]);
+    }
+}
+
 QString PiiEngine::operationsUsedPlugin(PiiOperation* operation)
 {
   // In the resource database, the parent resource of an operation
@@ -339,7 +838,7 @@ void PiiEngine::save(const QString& fileName,
     }
   else
     {
-      PiiGenericBinaryOutputArchive oa(&file);
+      PiiGenericBinaryOutputArchive oa(&file, format == MappedBinaryFormat ? 64 : 0);
       oa << PII_NVP("config", mapConfig);
       oa << PII_NVP("engine", this);
     }
@@ -375,7 +874,8 @@ PiiEngine* PiiEngine::load(const QString& fileName,
     }
   else if (file.peek(PII_BINARY_ARCHIVE_ID_LEN) == PII_BINARY_ARCHIVE_ID)
     {
-      PiiGenericBinaryInputArchive ia(&file);
+      // Only aligned archives will be mapped.
+      PiiGenericBinaryInputArchive ia(&file, true);
       ia >> PII_NVP("config", mapConfig);
       ensurePlugins(mapConfig["plugins"].toStringList());
       ia >> PII_NVP("engine", pEngine);
@@ -20,11 +20,16 @@
 #include <QHash>
 #include <QList>
 #include <QMutex>
+#include <QMap>
 #include <PiiVersionNumber.h>
 #include "PiiLoadException.h"
 #include "PiiOperationCompound.h"
 
 class QLibrary;
+class PiiThreadPool;
+class PiiFusedChain;
+class PiiResultCache;
+class PiiMemoryBudget;
 
 /**
  * An execution engine. The task of PiiEngine is to handle the
@@ -73,6 +78,48 @@ class PII_YDIN_EXPORT PiiEngine : public PiiOperationCompound
 {
   Q_OBJECT
 
+  /**
+   * The number of threads in a work-stealing thread pool shared by
+   * all multi-threaded child operations. If this value is zero (the
+   * default), each child operation whose [threadCount]
+   * (PiiDefaultOperation::threadCount) is greater than one creates
+   * threads of its own. Otherwise, [execute()] creates a shared pool
+   * and assigns it to all such operations (see
+   * PiiDefaultOperation::setThreadPool()). The operations then submit
+   * their processing rounds to the pool, which avoids
+   * oversubscription when many operations are multi-threaded. The
+   * value -1 makes the pool use QThread::idealThreadCount() threads.
+   * Changes take effect when the engine is next started from
+   * `Stopped` state.
+   */
+  Q_PROPERTY(int threadPoolSize READ threadPoolSize WRITE setThreadPoolSize);
+
+  /**
+   * Enables execution tracing. If this value is greater than zero,
+   * [execute()] starts PiiTracer with this sampling interval when the
+   * engine is started from `Stopped` state, unless tracing is already
+   * enabled. The value 1 records everything; *N* records one 100 ms
+   * window out of *N*, which keeps the overhead small enough for
+   * production use. Tracing stays enabled until PiiTracer::stop() is
+   * called. The recorded trace can be written with [saveTrace()]. The
+   * default is zero (disabled).
+   */
+  Q_PROPERTY(int traceSamplingInterval READ traceSamplingInterval WRITE setTraceSamplingInterval);
+
+  /**
+   * Enables operation fusion. If this flag is `true` (the default),
+   * [execute()] looks for linear chains of operations that implement
+   * PiiFusibleOperation, such as PiiArithmeticOperation and
+   * PiiTypeCastingOperation with constant operands. Two or more
+   * such operations are fused if each is connected only to the next
+   * one and none of them has a thread of its own. Objects then pass
+   * through the whole chain at once, without queuing intermediate
+   * results in sockets, and large matrices are processed in blocks of
+   * rows that stay in the cache. The processing time of a fused chain
+   * is recorded to its first operation.
+   */
+  Q_PROPERTY(bool operationFusion READ operationFusion WRITE setOperationFusion);
+
   Q_ENUMS(FileFormat ErrorHandling)
 
   friend struct PiiSerialization::Accessor;
@@ -89,8 +136,14 @@ public:
    *
    * - `BinaryFormat` - data is saved in a raw binary format. See
    * PiiBinaryOutputArchive and PiiBinaryInputArchive.
+   *
+   * - `MappedBinaryFormat` - like `BinaryFormat`, but matrix
+   * contents are aligned in the file. When such a file is loaded,
+   * matrices (e.g. classifier models) are mapped to memory instead
+   * of being read, and loading time does not depend on their size.
+   * The file must not be modified while the loaded engine exists.
    */
-  enum FileFormat { TextFormat, BinaryFormat };
+  enum FileFormat { TextFormat, BinaryFormat, MappedBinaryFormat };
 
   /**
    * Error handling mode in execute().
@@ -201,6 +254,54 @@ public:
    */
   static void ensurePlugins(const QStringList& plugins);
 
+  /**
+   * Writes an index of the classes provided by the currently loaded
+   * plug-ins to *fileName*. The index maps the resource name of each
+   * registered operation and class to the library name of the
+   * plug-in it came from. A program can load the index at start-up
+   * with [loadPluginIndex()] instead of loading all plug-ins, which
+   * is slow if there are many of them.
+   *
+   * ~~~(c++)
+   * // Once, e.g. in an installation script
+   * PiiEngine::loadPlugins(QStringList() << "piibase" << "piiimage" << "piiflowcontrol");
+   * PiiEngine::savePluginIndex("plugins.idx");
+   *
+   * // At start-up
+   * PiiEngine::loadPluginIndex("plugins.idx");
+   * // Loads piiimage
+   * engine.createOperation("PiiImageFileReader");
+   * ~~~
+   *
+   * @exception PiiLoadException& if the file cannot be written
+   */
+  static void savePluginIndex(const QString& fileName);
+
+  /**
+   * Reads a plug-in index written by [savePluginIndex()]. Plug-ins
+   * listed in the index are not loaded. Instead,
+   * [loadPluginFor()] loads them on demand. Entries in the new index
+   * replace existing ones with the same class name.
+   *
+   * @exception PiiLoadException& if the file cannot be read
+   */
+  static void loadPluginIndex(const QString& fileName);
+
+  /**
+   * Loads the plug-in that provides *className* according to the
+   * plug-in index (see [loadPluginIndex()]), if it is not loaded yet.
+   * PiiOperationCompound::createOperation() calls this function if
+   * *className* is not registered to the resource database. Like
+   * [ensurePlugin()], this function doesn't increase the reference
+   * count of plug-ins that are already loaded.
+   *
+   * @return `true` if the class may now be available, `false` if
+   * the index does not contain *className*.
+   *
+   * @exception PiiLoadException& if the plug-in cannot be loaded
+   */
+  static bool loadPluginFor(const QString& className);
+
   /**
    * Remove the named plugin. Either the full path or the base name
    * will do as *name*.
@@ -260,6 +361,72 @@ public:
   QStringList usedPluginResourceNames();
   static QStringList usedPluginResourceNames(PiiOperation* operation);
 
+  /**
+   * Returns run-time profiling statistics of all operations in this
+   * engine. The statistics are collected all the time, and this
+   * function can be called while the engine is running. The returned
+   * map has an `operations` key that maps each child operation's
+   * object name to a map with the following keys:
+   *
+   * - `class` - the class name of the operation.
+   *
+   * - `processTime` - processing-time statistics (microseconds) of a
+   * PiiDefaultOperation. See PiiDefaultOperation::processTimeHistogram().
+   *
+   * - `allocations` - the number of heap allocations per processing
+   * round of a PiiDefaultOperation, if allocation counting is
+   * enabled. See PiiDefaultOperation::allocationHistogram().
+   *
+   * - `inputs` - a map from input names to maps with keys
+   * `queueLength` (PiiInputSocket::queueLengthHistogram()),
+   * `currentLength`, `capacity`, `rejected`
+   * (PiiInputSocket::rejectedObjectCount()), `dropped`
+   * (PiiInputSocket::droppedObjectCount()) and `late`
+   * (PiiInputSocket::lateObjectCount()). If latency tagging is
+   * enabled (see PiiLatencyTag), inputs that have received tagged
+   * objects also have `latency`
+   * (PiiInputSocket::latencyHistogram()) and `stageLatency`
+   * (PiiInputSocket::stageLatencyHistogram()). At the inputs of
+   * sinks, `latency` is the end-to-end latency of the pipeline.
+   *
+   * - `outputs` - a map from output names to maps with keys
+   * `blockedEmitTime` (PiiOutputSocket::blockedEmitHistogram()),
+   * `queueDepth` (PiiOutputSocket::queueDepthHistogram()) and
+   * `buffered`.
+   *
+   * - `memory` - the memory accounted to a PiiDefaultOperation, if
+   * it has a [memory budget](setMemoryBudget()). A map with keys
+   * `queued` (the sum of PiiInputSocket::queuedBytes() over all
+   * inputs) and `retained` (PiiDefaultOperation::retainedMemory()).
+   * Each input also has a `queuedBytes` key.
+   *
+   * - `memoryBudget` - at the top level of an engine with a memory
+   * budget, a map with keys `usage`, `peakUsage`, `limit`,
+   * `softLimit` and `rejected` (see PiiMemoryBudget).
+   *
+   * - `operations` - the profiles of child operations, if the
+   * operation is a compound.
+   *
+   * Histograms are represented as returned by
+   * PiiProfileHistogram::toVariantMap().
+   *
+   * ~~~(c++)
+   * QVariantMap mapProfile = engine.profile()["operations"].toMap();
+   * QVariantMap mapInputs = mapProfile["detector"].toMap()["inputs"].toMap();
+   * int iRejected = mapInputs["image"].toMap()["rejected"].toInt();
+   * ~~~
+   */
+  QVariantMap profile() const;
+  static QVariantMap profile(PiiOperation* operation);
+
+  /**
+   * Clears the profiling statistics of all operations in this
+   * engine. The peak usage and the rejection count of the [memory
+   * budget](setMemoryBudget()) are reset as well.
+   */
+  void resetProfile();
+  static void resetProfile(PiiOperation* operation);
+
   /**
    * Checks and executes all child operations. This function first
    * calls [PiiOperation::check()] for all child operations. If
@@ -277,11 +444,159 @@ public:
    */
   void execute(ErrorHandling erroHandling = ThrowOnError);
 
+  /**
+   * Deploys placed sub-compounds to remote nodes. Any child compound
+   * (at any depth) whose dynamic `node` property contains the URI of
+   * a PiiOperationNodeServer is serialized, sent to the node and
+   * replaced with a PiiRemoteOperation that controls the deployed
+   * copy. Compounds inside a placed compound go with it. Connections
+   * that cross node boundaries are carried over the network in
+   * PiiWireFormat frames, including control objects and flow levels,
+   * so synchronization works as if the whole engine was local.
+   *
+   * ~~~(c++)
+   * pEngine->findChild<PiiOperationCompound*>("cameras1-8")->setProperty("node", "tcp://10.0.0.11:3142/");
+   * pEngine->findChild<PiiOperationCompound*>("cameras9-16")->setProperty("node", "tcp://10.0.0.12:3142/");
+   * pEngine->execute(); // calls deploy()
+   * ~~~
+   *
+   * [execute()] calls this function automatically when the engine is
+   * started from `Stopped` state. If the engine is already deployed,
+   * this function does nothing. The engine must be stopped.
+   *
+   * @exception PiiExecutionException& if the engine is running, or
+   * if a compound cannot be deployed. Compounds deployed before the
+   * failure are undeployed.
+   */
+  void deploy();
+
+  /**
+   * Removes deployed compounds from their nodes and puts the
+   * original compounds back in place. This must be done before
+   * saving or cloning a deployed engine. The destructor undeploys
+   * automatically. The engine must be stopped.
+   */
+  void undeploy();
+
+  /**
+   * Returns `true` if any compounds have been deployed to remote
+   * nodes and `false` otherwise.
+   */
+  bool isDeployed() const;
+
+  /**
+   * Runs synthetic objects through the engine before it goes live.
+   * The first processing rounds of many operations allocate buffers,
+   * build look-up tables and fill caches. Warming up moves this cost
+   * away from the first real objects and, once finished, leaves the
+   * operations in the steady state in which [profile()] and
+   * PiiDefaultOperation::maxAllocations can be used to verify that no
+   * heap allocations are made per object.
+   *
+   * The *objects* map specifies an object for each warmed-up input.
+   * Keys are input paths relative to the engine (e.g.
+   * "detector.image"). Each input is temporarily disconnected from
+   * its source and fed by the engine. Operations that receive no
+   * objects from the warmed-up inputs, such as cameras and file
+   * readers, are disabled for the duration of the warm-up. Operations
+   * that also need objects from disabled operations are disabled as
+   * well, so all inputs an operation synchronizes must be listed. The
+   * synthetic objects are typically blank frames of the size the
+   * sources declare.
+   *
+   * The engine is started with [execute()], and each object is sent
+   * *rounds* times, followed by a stop tag. Once the engine has
+   * stopped, the original connections and activity modes are
+   * restored and profiling statistics are cleared (see
+   * [resetProfile()]). Output produced during the warm-up is
+   * delivered to the connected receivers as usual.
+   *
+   * ~~~(c++)
+   * QMap<QString,PiiVariant> mapObjects;
+   * mapObjects["detector.image"] = PiiVariant(PiiMatrix<unsigned char>(1024, 1280));
+   * engine.warmUp(mapObjects, 3);
+   * engine.execute();
+   * ~~~
+   *
+   * @param objects synthetic input objects
+   *
+   * @param rounds the number of times each object is sent
+   *
+   * @param timeout the maximum time to wait for the engine to stop,
+   * in milliseconds. If the engine does not stop in time, it is
+   * interrupted.
+   *
+   * @exception PiiExecutionException& if the engine is not stopped,
+   * an input cannot be found, the engine cannot be started or it
+   * does not stop within *timeout*.
+   */
+  void warmUp(const QMap<QString,PiiVariant>& objects,
+              int rounds = 1,
+              unsigned long timeout = ULONG_MAX);
+
   /**
    * Creates a deep copy of the engine.
    */
   PiiEngine* clone() const;
 
+  void setThreadPoolSize(int threadPoolSize);
+  int threadPoolSize() const;
+
+  void setTraceSamplingInterval(int traceSamplingInterval);
+  int traceSamplingInterval() const;
+
+  void setOperationFusion(bool operationFusion);
+  bool operationFusion() const;
+
+  /**
+   * Sets the cache used for memoizing the results of deterministic
+   * child operations. When the engine is next started from `Stopped`
+   * state, [execute()] assigns *cache* to all child operations
+   * derived from PiiDefaultOperation (see
+   * PiiDefaultOperation::setResultCache()). Zero (the default)
+   * disables memoization. The engine does not take the ownership of
+   * the cache, which may therefore outlive the engine and be shared
+   * between runs.
+   */
+  void setResultCache(PiiResultCache* cache);
+  /**
+   * Returns the result cache, or zero if memoization is disabled.
+   */
+  PiiResultCache* resultCache() const;
+
+  /**
+   * Sets the memory budget shared by all child operations. When the
+   * engine is next started from `Stopped` state, [execute()] assigns
+   * *budget* to all child operations derived from PiiDefaultOperation
+   * (see PiiDefaultOperation::setMemoryBudget()). Their input queues
+   * and caches then report the memory of the objects they hold to
+   * *budget*, which keeps the total under PiiMemoryBudget::limit() by
+   * making senders wait, dropping objects or evicting cached
+   * entries. Zero (the default) disables accounting. The engine does
+   * not take the ownership of the budget.
+   *
+   * ~~~(c++)
+   * PiiMemoryBudget budget(6LL*1024*1024*1024);
+   * engine.setMemoryBudget(&budget);
+   * engine.execute();
+   * ~~~
+   */
+  void setMemoryBudget(PiiMemoryBudget* budget);
+  /**
+   * Returns the memory budget, or zero if accounting is disabled.
+   */
+  PiiMemoryBudget* memoryBudget() const;
+
+  /**
+   * Writes the events recorded by PiiTracer to *fileName* in Chrome
+   * trace event format. The file can be opened in
+   * `chrome://tracing` or Perfetto UI. Returns the number of events
+   * written. See PiiTracer::save().
+   *
+   * @exception PiiException& if the file cannot be written.
+   */
+  static int saveTrace(const QString& fileName);
+
   /**
    * Saves the engine to *fileName*. The *format* argument specifies
    * the file format. The *config* map is used to add configuration
@@ -350,15 +665,48 @@ public:
                          QVariantMap* config = 0);
 
 protected:
+  /// @internal
+  class PII_YDIN_EXPORT Data : public PiiOperationCompound::Data
+  {
+  public:
+    Data();
+    ~Data();
+
+    int iThreadPoolSize;
+    PiiThreadPool* pThreadPool;
+    int iTraceSamplingInterval;
+    bool bOperationFusion;
+    QList<PiiFusedChain*> lstFusedChains;
+    PiiResultCache* pResultCache;
+    PiiMemoryBudget* pMemoryBudget;
+    // Deployed compounds: the parent, the original operation and the
+    // remote one that replaces it, in this order.
+    struct Deployment
+    {
+      PiiOperationCompound* pParent;
+      PiiOperation* pOriginal;
+      PiiOperation* pRemote;
+    };
+    QList<Deployment> lstDeployments;
+  };
+  PII_D_FUNC;
+
   /// @internal
   PiiEngine(Data* data);
 
 private:
   typedef QHash<QString,Plugin> PluginMap;
+  static void setThreadPool(PiiOperationCompound* compound, PiiThreadPool* pool);
+  static void setResultCache(PiiOperationCompound* compound, PiiResultCache* cache);
+  static void setMemoryBudget(PiiOperationCompound* compound, PiiMemoryBudget* budget);
+  void fuseOperations();
+  void deploy(PiiOperationCompound* compound);
+  PiiOperation* childOf(PiiOperation* operation) const;
   static QStringList compoundsUsedPlugins(PiiOperationCompound* compound);
   static QString operationsUsedPlugin(PiiOperation* operation);
 
   static PluginMap _pluginMap;
+  static QHash<QString,QString> _pluginIndex;
   static QMutex _pluginLock;
 };
 
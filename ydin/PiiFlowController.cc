@@ -16,7 +16,8 @@
 #include "PiiFlowController.h"
 
 PiiFlowController::Data::Data() :
-  iActiveInputGroup(0)
+  iActiveInputGroup(0),
+  iMaxBatchSize(1)
 {
 }
 
@@ -60,5 +61,7 @@ void PiiFlowController::sendSyncEvents(SyncListener* /*listener*/)
 
 void PiiFlowController::setPropertySetName(const QString& propertySetName) { d->strPropertySetName = propertySetName; }
 QString PiiFlowController::propertySetName() const { return d->strPropertySetName; }
+void PiiFlowController::setMaxBatchSize(int maxBatchSize) { d->iMaxBatchSize = qMax(maxBatchSize, 1); }
+int PiiFlowController::maxBatchSize() const { return d->iMaxBatchSize; }
 
 PiiFlowController::SyncListener::~SyncListener() {}
@@ -235,6 +235,40 @@ public:
    */
   template <class InputIterator> static inline int inputGroupTypeMask(InputIterator begin, InputIterator end);
 
+  /**
+   * Builds a binary mask of input object types incrementally. This
+   * function works like the two-argument version, but it only
+   * inspects inputs that are not yet known to contain an object.
+   * Since an input queue can only be emptied by shifting it, each
+   * input needs to be checked just once per processing round, and
+   * the full type mask is built only after all inputs are filled.
+   * This makes the cost of synchronization constant per received
+   * object, independent of the number of inputs in the group.
+   *
+   * @param begin an interator to the first input to be checked. The
+   * iterator must support random access.
+   *
+   * @param end an iterator the the last input to be checked
+   *
+   * @param readyInputs the number of leading inputs in the group
+   * that are known to contain an object. Initially, this value must
+   * be zero. The function updates the value as it finds new objects.
+   * The caller must reset it to zero whenever the inputs are shifted
+   * or otherwise emptied.
+   *
+   * ~~~(c++)
+   * switch (inputGroupTypeMask(vecInputs.begin(), vecInputs.end(), iReadyInputs))
+   *   {
+   *   case NormalObject:
+   *     iReadyInputs = 0;
+   *     shiftInputs();
+   *     return ProcessableState;
+   *   // ...
+   *   }
+   * ~~~
+   */
+  template <class InputIterator> static inline int inputGroupTypeMask(InputIterator begin, InputIterator end, int& readyInputs);
+
   /**
    * A utility function that creates a textual dump of incoming
    * objects in a group of sockets. Can be used to create descriptive
@@ -339,6 +373,21 @@ public:
    */
   QString propertySetName() const;
 
+  /**
+   * Sets the maximum number of objects the controller may pass to a
+   * single processing round. If *maxBatchSize* is greater than one,
+   * consecutive ordinary objects in the input queue are shifted at
+   * once with [PiiInputSocket::shiftBatch()]. Control objects always
+   * end a batch. The default value is one. Currently, only
+   * PiiOneInputFlowController supports batches; other controllers
+   * ignore this value.
+   */
+  void setMaxBatchSize(int maxBatchSize);
+  /**
+   * Returns the maximum number of objects in a batch.
+   */
+  int maxBatchSize() const;
+
 protected:
   /// @internal
   class Data
@@ -350,6 +399,7 @@ protected:
     /// The ID of the currently active sync group.
     int iActiveInputGroup;
     QString strPropertySetName;
+    int iMaxBatchSize;
   } *d;
   /// @internal
   PiiFlowController(Data* data);
@@ -467,6 +517,16 @@ int PiiFlowController::inputGroupTypeMask(InputIterator begin, InputIterator end
   return typeMask;
 }
 
+template <class InputIterator>
+int PiiFlowController::inputGroupTypeMask(InputIterator begin, InputIterator end, int& readyInputs)
+{
+  for (InputIterator i=begin+readyInputs; i != end; ++i, ++readyInputs)
+    if ((*i)->queuedType(0) == PiiVariant::InvalidType)
+      return NoObject;
+
+  return inputGroupTypeMask(begin, end);
+}
+
 template <class InputIterator>
 bool PiiFlowController::resolvePausedState(unsigned int type, InputIterator begin, InputIterator end)
 {
@@ -82,11 +82,71 @@ namespace PiiFuncOpPrivate
     static T toParam(T& val) { return val; }
   };
 
+  // Stores an input argument that is passed to the function by const
+  // reference. If the incoming variant already has the right type,
+  // the argument refers to the object stored in the variant, and the
+  // object is neither copied nor reference counted. Otherwise, the
+  // converted (or assigned) value is stored locally.
+  template <class T> class ArgumentRef
+  {
+  public:
+    ArgumentRef() : _pValue(&_value) {}
+
+    ArgumentRef& operator= (const T& value)
+    {
+      _value = value;
+      _pValue = &_value;
+      return *this;
+    }
+    ArgumentRef& operator= (T&& value)
+    {
+      _value = std::move(value);
+      _pValue = &_value;
+      return *this;
+    }
+
+    bool initialize(PiiVariant&& variant)
+    {
+      if (variant.type() == Pii::typeId<T>())
+        {
+          _variant = std::move(variant);
+          _pValue = &static_cast<const PiiVariant&>(_variant).valueAs<T>();
+          return true;
+        }
+      _pValue = &_value;
+      return variant.convertTo(_value);
+    }
+
+    operator const T& () const { return *_pValue; }
+    const T& value() const { return *_pValue; }
+
+  private:
+    ArgumentRef(const ArgumentRef&) = delete;
+    ArgumentRef& operator= (const ArgumentRef&) = delete;
+
+    PiiVariant _variant;
+    T _value;
+    const T* _pValue;
+  };
+
+  template <class T> struct ArgumentRefConverter
+  {
+    typedef ArgumentRef<T> ValueType;
+    static bool initialize(PiiVariant&& var, ValueType& val) { return val.initialize(std::move(var)); }
+    static bool initialize(const PiiVariant& var, ValueType& val) { return val.initialize(PiiVariant(var)); }
+  };
+
+  // Primitive types are cheaper to copy than to refer to.
+  template <class T> struct ConstRefInputConverter :
+    Pii::IfClass<Pii::IsPrimitive<T>, DefaultInputConverter<T>, ArgumentRefConverter<T> >::Type
+  {};
+
   template <class T> struct DefaultOutputConverter
   {
     typedef T ValueType;
     static bool initialize(T&) { return true; }
     static PiiVariant toVariant(const T& val) { return PiiVariant(val); }
+    static PiiVariant toVariant(T&& val) { return PiiVariant(std::move(val)); }
   };
 
   template <class T> struct DefaultConverter : DefaultInputConverter<T> {};
@@ -98,13 +158,15 @@ namespace PiiFuncOpPrivate
   {
     static T& toParam(T& value) { return value; }
   };
-  template <class T> struct DefaultConverter<const T*> : DefaultInputConverter<T>
+  template <class T> struct DefaultConverter<const T*> : ConstRefInputConverter<T>
   {
-    static const T* toParam(const T& value) { return &value; }
+    typedef typename ConstRefInputConverter<T>::ValueType ValueType;
+    static const T* toParam(const ValueType& value) { return &static_cast<const T&>(value); }
   };
-  template <class T> struct DefaultConverter<const T&> : DefaultInputConverter<T>
+  template <class T> struct DefaultConverter<const T&> : ConstRefInputConverter<T>
   {
-    static const T& toParam(const T& value) { return value; }
+    typedef typename ConstRefInputConverter<T>::ValueType ValueType;
+    static const T& toParam(const ValueType& value) { return value; }
   };
   template <class T> struct DefaultReturnConverter : DefaultConverter<T*> {};
 
@@ -117,6 +179,10 @@ namespace PiiFuncOpPrivate
   template <class T> struct IsInput<const T*> : Pii::True {};
   template <class T> struct IsInput<const T&> : Pii::True {};
 
+  // The type getter functions must return to initialize a temporary.
+  template <class T> struct GetterValue { typedef T Type; };
+  template <class T> struct GetterValue<ArgumentRef<T> > { typedef T Type; };
+
   // The holder type must be resolved based on function argument
   // types. At that phase, it is not possible to know whether a getter
   // function or an input socket is used to retrieve the value at run
@@ -126,6 +192,7 @@ namespace PiiFuncOpPrivate
   {
     typedef typename Converter<T>::Type Conv;
     typedef typename Conv::ValueType ValueType;
+    typedef typename GetterValue<ValueType>::Type GetterType;
 
     struct CastWrapper
     {
@@ -137,7 +204,7 @@ namespace PiiFuncOpPrivate
       CastWrapperImpl(U (Object::* getter)() const) : getter(getter) {}
       void init(Object* obj, ValueType& value) const
       {
-        value = static_cast<ValueType>((obj->*getter)());
+        value = static_cast<GetterType>((obj->*getter)());
       }
       U (Object::* getter)() const;
     };
@@ -161,10 +228,10 @@ namespace PiiFuncOpPrivate
     // ... or by calling a function. This version accepts any member
     // function pointer from a class derived from Object.
     template <class Derived>
-    InputHolder(ValueType (Derived::* getter)() const,
+    InputHolder(GetterType (Derived::* getter)() const,
                 const char* socketName = nullptr) :
       pSocket(socketName ? new PiiInputSocket(socketName) : nullptr),
-      getter(static_cast<ValueType (Object::*)() const>(getter)),
+      getter(static_cast<GetterType (Object::*)() const>(getter)),
       pWrapper(nullptr),
       initializer(&InputHolder::initByGetter)
     {
@@ -190,11 +257,11 @@ namespace PiiFuncOpPrivate
     }
 
     template <class Derived>
-    void setGetter(ValueType (Derived::* get)() const)
+    void setGetter(GetterType (Derived::* get)() const)
     {
       delete pWrapper;
       pWrapper = 0;
-      getter = static_cast<ValueType (Object::*)() const>(get);
+      getter = static_cast<GetterType (Object::*)() const>(get);
     }
 
     template <class Derived, class U>
@@ -246,7 +313,7 @@ namespace PiiFuncOpPrivate
     }
 
     PiiInputSocket* pSocket;
-    ValueType (Object::* getter)() const;
+    GetterType (Object::* getter)() const;
     CastWrapper* pWrapper;
     void (InputHolder::* initializer)(Object*, ValueType&) const;
   };
@@ -261,9 +328,10 @@ namespace PiiFuncOpPrivate
     {}
 
     void initialize(Object*, ValueType& value) { Conv::initialize(value); }
+    // The value is not needed after it has been emitted.
     void emitValue(ValueType& value)
     {
-      pSocket->emitObject(Conv::toVariant(value)); // may throw
+      pSocket->emitObject(Conv::toVariant(std::move(value))); // may throw
     }
 
     PiiOutputSocket* pSocket;
@@ -448,25 +516,33 @@ namespace PiiFuncOpPrivate
  *     uses a default-constructed value for output parameters and
  *     initializes input parameters with the value read from a socket
  *     or returned by a getter function. For pointers and references,
- *     the corresponding value type is used.
+ *     the corresponding value type is used. The only exception are
+ *     non-primitive input parameters passed by const reference or
+ *     pointer: their temporary holds either the incoming variant or a
+ *     local value and converts to a const reference to the stored
+ *     object.
  *
  *     In the example above, the `gradient` parameter would point to a
  *     default-constructed [PiiMatrix<float>] on the stack. Similarly,
- *     `image` would refer to a [PiiMatrix<uchar>] whose value would
- *     be initialized with data read from an input socket.
+ *     `image` would refer to a [PiiMatrix<uchar>] stored in the
+ *     object read from an input socket.
  *
  * 2.  The temporary variables are initialized using
  *     `converter::initialize()`. The default converters do nothing
  *     for output parameters. The value for an input parameter is
  *     copied (and converted, if needed) from an input socket or a
- *     getter function.
+ *     getter function. If an input object passed by const reference
+ *     already has the parameter type, it is referred to without a
+ *     copy.
  *
  * 3.  The temporary variables are passed to the actual function
  *     through `converter::toParam()`.
  *
- * 4.  When the function returns, all output parameters are converted
- *     to [PiiVariant]s using `converter::toVariant()` and passed to
- *     the corresponding output socket.
+ * 4.  When the function returns, the return value and all output
+ *     parameters are converted to [PiiVariant]s using
+ *     `converter::toVariant()` and passed to the corresponding output
+ *     socket. The values are passed as rvalues so that the default
+ *     converters can move them into the variants.
  *
  * ~~~(c++)
  * struct MyType
@@ -0,0 +1,241 @@
+/* This file is part of Into.
+ * Copyright (C) Intopii 2013.
+ * All rights reserved.
+ *
+ * Licensees holding a commercial Into license may use this file in
+ * accordance with the commercial license agreement. Please see
+ * LICENSE.commercial for commercial licensing terms.
+ *
+ * Alternatively, this file may be used under the terms of the GNU
+ * Affero General Public License version 3 as published by the Free
+ * Software Foundation. In addition, Intopii gives you special rights
+ * to use Into as a part of open source software projects. Please
+ * refer to LICENSE.AGPL3 for details.
+ */
+
+#include "PiiFusedChain.h"
+
+#include "PiiFusibleOperation.h"
+#include "PiiDefaultOperation.h"
+#include "PiiOperationCompound.h"
+#include "PiiYdinTypes.h"
+
+#include <QHash>
+#include <QSet>
+#include <cstring>
+
+// Matrices larger than this (in bytes) are passed through the chain
+// in blocks of rows. A block and its intermediate results stay in the
+// cache while the whole chain is applied to it.
+static const std::size_t iFusedBlockBytes = 32768;
+
+PiiFusedChain::PiiFusedChain(const QList<Stage>& stages) :
+  _lstStages(stages),
+  _pController(stages[0].pOperation->inputAt(0)->controller()),
+  _pOutput(stages.last().pOperation->outputAt(0))
+{
+  stages[0].pOperation->inputAt(0)->setController(this);
+}
+
+PiiFusedChain::~PiiFusedChain()
+{}
+
+void PiiFusedChain::collectOperations(PiiOperationCompound* compound, QList<PiiDefaultOperation*>& operations)
+{
+  QList<PiiOperation*> lstOperations = compound->childOperations();
+  for (int i=0; i<lstOperations.size(); ++i)
+    {
+      if (PiiDefaultOperation* pOperation = qobject_cast<PiiDefaultOperation*>(lstOperations[i]))
+        operations << pOperation;
+      else if (PiiOperationCompound* pCompound = qobject_cast<PiiOperationCompound*>(lstOperations[i]))
+        collectOperations(pCompound, operations);
+    }
+}
+
+bool PiiFusedChain::createStage(PiiDefaultOperation* operation, Stage* stage)
+{
+  PiiFusibleOperation* pFusible = qobject_cast<PiiFusibleOperation*>(operation);
+  // Only operations processed in the emitting thread can be fused.
+  if (pFusible == 0 ||
+      operation->activityMode() != PiiOperation::Enabled ||
+      operation->threadCount() != 0 ||
+      operation->inputCount() == 0 ||
+      operation->outputCount() == 0 ||
+      !operation->inputAt(0)->isConnected())
+    return false;
+  // The first input must be the only one connected.
+  for (int i=1; i<operation->inputCount(); ++i)
+    if (operation->inputAt(i)->isConnected())
+      return false;
+  if (!pFusible->isFusible())
+    return false;
+  stage->pOperation = operation;
+  stage->pFusible = pFusible;
+  return true;
+}
+
+QList<PiiFusedChain*> PiiFusedChain::install(PiiOperationCompound* compound)
+{
+  QList<PiiDefaultOperation*> lstOperations;
+  collectOperations(compound, lstOperations);
+
+  // Find fusible operations by their first input.
+  QHash<PiiAbstractInputSocket*, Stage> hashStages;
+  for (int i=0; i<lstOperations.size(); ++i)
+    {
+      Stage stage;
+      if (createStage(lstOperations[i], &stage))
+        hashStages.insert(lstOperations[i]->inputAt(0), stage);
+    }
+
+  // Link each fusible operation to the next one if nothing else
+  // receives its output. Proxies and probes break the chain.
+  QHash<PiiDefaultOperation*, Stage> hashNext;
+  QSet<PiiDefaultOperation*> setLinked;
+  for (QHash<PiiAbstractInputSocket*, Stage>::const_iterator i = hashStages.constBegin();
+       i != hashStages.constEnd(); ++i)
+    {
+      PiiOutputSocket* pOutput = i->pOperation->outputAt(0);
+      if (pOutput->connectedInputCount() != 1)
+        continue;
+      PiiAbstractInputSocket* pInput = pOutput->connectedInputs()[0];
+      if (hashStages.contains(pInput))
+        {
+          hashNext.insert(i->pOperation, hashStages[pInput]);
+          setLinked << hashStages[pInput].pOperation;
+        }
+    }
+
+  // Build chains starting from operations that aren't linked to. A
+  // loop of fusible operations has no start and won't be fused.
+  QList<PiiFusedChain*> lstChains;
+  for (int i=0; i<lstOperations.size(); ++i)
+    {
+      PiiDefaultOperation* pOperation = lstOperations[i];
+      if (setLinked.contains(pOperation) || !hashNext.contains(pOperation))
+        continue;
+      QList<Stage> lstStages;
+      lstStages << hashStages[pOperation->inputAt(0)];
+      while (hashNext.contains(pOperation))
+        {
+          lstStages << hashNext[pOperation];
+          pOperation = lstStages.last().pOperation;
+        }
+      lstChains << new PiiFusedChain(lstStages);
+    }
+  return lstChains;
+}
+
+bool PiiFusedChain::isRunning() const
+{
+  for (int i=0; i<_lstStages.size(); ++i)
+    if (_lstStages[i].pOperation->state() != PiiOperation::Running)
+      return false;
+  return true;
+}
+
+PiiVariant PiiFusedChain::transformStages(const PiiVariant& object)
+{
+  PiiVariant varResult(object);
+  for (int i=0; i<_lstStages.size(); ++i)
+    {
+      PiiReadLocker lock(_lstStages[i].pOperation->processLock());
+      varResult = _lstStages[i].pFusible->transform(varResult);
+    }
+  return varResult;
+}
+
+template <class T> void PiiFusedChain::copyRows(const PiiVariant& block, PiiVariant& result,
+                                                int row, int blockRows, int rows, int columns)
+{
+  const PiiMatrix<T>& matBlock = block.valueAs<PiiMatrix<T> >();
+  if (!result.isValid())
+    result = PiiVariant(PiiMatrix<T>::uninitialized(rows, columns));
+  if (result.type() != block.type() || matBlock.rows() != blockRows || matBlock.columns() != columns)
+    PII_THROW(PiiExecutionException, QString("Fused operations changed the size of a matrix."));
+  PiiMatrix<T>& matResult = result.valueAs<PiiMatrix<T> >();
+  for (int r=0; r<matBlock.rows(); ++r)
+    std::memcpy(matResult.row(row + r), matBlock.row(r), columns * sizeof(T));
+}
+
+template <class T> PiiVariant PiiFusedChain::transformRows(const PiiVariant& object)
+{
+  const PiiMatrix<T>& matrix = object.valueAs<PiiMatrix<T> >();
+  const int iRows = matrix.rows(), iColumns = matrix.columns();
+  const int iBlockRows = int(iFusedBlockBytes / qMax(std::size_t(iColumns) * sizeof(T), sizeof(T)));
+  // Small matrices fit into the cache as such.
+  if (iBlockRows == 0 || iRows < 2 * iBlockRows)
+    return transformStages(object);
+
+  PiiVariant varResult;
+  for (int r=0; r<iRows; r += iBlockRows)
+    {
+      const int iBlockSize = qMin(iBlockRows, iRows - r);
+      PiiVariant varBlock(transformStages(PiiVariant(matrix(r, 0, iBlockSize, iColumns))));
+      switch (varBlock.type())
+        {
+          PII_PRIMITIVE_MATRIX_CASES_M(copyRows, (varBlock, varResult, r, iBlockSize, iRows, iColumns));
+          PII_COMPLEX_MATRIX_CASES_M(copyRows, (varBlock, varResult, r, iBlockSize, iRows, iColumns));
+          PII_COLOR_IMAGE_CASES_M(copyRows, (varBlock, varResult, r, iBlockSize, iRows, iColumns));
+        default:
+          PII_THROW(PiiExecutionException, QString("Fused operations must produce a matrix."));
+        }
+    }
+  return varResult;
+}
+
+PiiVariant PiiFusedChain::transform(const PiiVariant& object)
+{
+  PiiVariant varResult;
+  switch (object.type())
+    {
+      PII_PRIMITIVE_MATRIX_CASES(varResult = transformRows, object);
+      PII_COMPLEX_MATRIX_CASES(varResult = transformRows, object);
+      PII_COLOR_IMAGE_CASES(varResult = transformRows, object);
+    default:
+      varResult = transformStages(object);
+    }
+  return varResult;
+}
+
+bool PiiFusedChain::tryToReceive(PiiAbstractInputSocket* sender, const PiiVariant& object) throw ()
+{
+  QMutexLocker lock(&_mutex);
+  // Control objects change the state of the operations and are
+  // always passed through the sockets, as are all objects while the
+  // chain is not running.
+  if (PiiYdin::isControlType(object.type()) || !isRunning())
+    return _pController->tryToReceive(sender, object);
+
+  PiiDefaultOperation* pFirst = _lstStages[0].pOperation;
+  PiiVariant varResult;
+  try
+    {
+      PiiTracer::Scope scope("fused", pFirst);
+      const bool bCountAllocations = pFirst->_d()->bCountAllocations;
+      const quint64 iStartAllocations = bCountAllocations ? Pii::allocationCount() : 0;
+      const qint64 iStartTime = PiiTimer::currentTime();
+      varResult = transform(object);
+      // The time and allocations taken by the whole chain are
+      // recorded to the first operation.
+      pFirst->_d()->processTimes.add(PiiTimer::currentTime() - iStartTime);
+      if (bCountAllocations)
+        pFirst->addAllocations(Pii::allocationCount() - iStartAllocations);
+    }
+  catch (...)
+    {
+      // Let the operations process the object separately and report
+      // the error.
+      return _pController->tryToReceive(sender, object);
+    }
+
+  try
+    {
+      _pOutput->emitObject(varResult);
+    }
+  catch (PiiExecutionException&)
+    {
+      // Interrupted
+    }
+  return true;
+}
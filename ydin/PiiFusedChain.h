@@ -0,0 +1,86 @@
+/* This file is part of Into.
+ * Copyright (C) Intopii 2013.
+ * All rights reserved.
+ *
+ * Licensees holding a commercial Into license may use this file in
+ * accordance with the commercial license agreement. Please see
+ * LICENSE.commercial for commercial licensing terms.
+ *
+ * Alternatively, this file may be used under the terms of the GNU
+ * Affero General Public License version 3 as published by the Free
+ * Software Foundation. In addition, Intopii gives you special rights
+ * to use Into as a part of open source software projects. Please
+ * refer to LICENSE.AGPL3 for details.
+ */
+
+#ifndef _PIIFUSEDCHAIN_H
+#define _PIIFUSEDCHAIN_H
+
+#include "PiiInputController.h"
+#include <QList>
+#include <QMutex>
+
+class PiiDefaultOperation;
+class PiiFusibleOperation;
+class PiiOperationCompound;
+class PiiOutputSocket;
+
+/**
+ * An input controller that runs a chain of fusible operations (see
+ * PiiFusibleOperation) in a single pass. The controller is installed
+ * to the first input of the first operation in the chain. It calls
+ * the [transform()](PiiFusibleOperation::transform()) function of
+ * each operation in turn in the context of the emitting thread and
+ * sends the result directly to the first output of the last
+ * operation. Large matrices are passed through the chain in blocks
+ * of rows.
+ *
+ * Control objects, and objects the chain fails to transform, are
+ * passed to the original controller of the first operation. They
+ * travel through the normal sockets so that synchronization, state
+ * changes and error reporting work as if the chain was not fused.
+ *
+ * @internal
+ */
+class PiiFusedChain : public PiiInputController
+{
+public:
+  ~PiiFusedChain();
+
+  /**
+   * Finds all linear chains of two or more fusible operations in
+   * *compound* and its child compounds, and installs a PiiFusedChain
+   * as the controller of each. This function must be called after
+   * check(), because check() replaces input controllers. The caller
+   * takes the ownership of the returned chains.
+   */
+  static QList<PiiFusedChain*> install(PiiOperationCompound* compound);
+
+  bool tryToReceive(PiiAbstractInputSocket* sender, const PiiVariant& object) throw ();
+
+private:
+  struct Stage
+  {
+    PiiDefaultOperation* pOperation;
+    PiiFusibleOperation* pFusible;
+  };
+
+  PiiFusedChain(const QList<Stage>& stages);
+
+  static void collectOperations(PiiOperationCompound* compound, QList<PiiDefaultOperation*>& operations);
+  static bool createStage(PiiDefaultOperation* operation, Stage* stage);
+
+  bool isRunning() const;
+  PiiVariant transform(const PiiVariant& object);
+  PiiVariant transformStages(const PiiVariant& object);
+  template <class T> PiiVariant transformRows(const PiiVariant& object);
+  template <class T> static void copyRows(const PiiVariant& block, PiiVariant& result,
+                                          int row, int blockRows, int rows, int columns);
+
+  QList<Stage> _lstStages;
+  PiiInputController* _pController;
+  PiiOutputSocket* _pOutput;
+  QMutex _mutex;
+};
+
+#endif //_PIIFUSEDCHAIN_H
@@ -0,0 +1,80 @@
+/* This file is part of Into.
+ * Copyright (C) Intopii 2013.
+ * All rights reserved.
+ *
+ * Licensees holding a commercial Into license may use this file in
+ * accordance with the commercial license agreement. Please see
+ * LICENSE.commercial for commercial licensing terms.
+ *
+ * Alternatively, this file may be used under the terms of the GNU
+ * Affero General Public License version 3 as published by the Free
+ * Software Foundation. In addition, Intopii gives you special rights
+ * to use Into as a part of open source software projects. Please
+ * refer to LICENSE.AGPL3 for details.
+ */
+
+#ifndef _PIIFUSIBLEOPERATION_H
+#define _PIIFUSIBLEOPERATION_H
+
+#include "PiiVariant.h"
+#include "PiiExecutionException.h"
+#include <QObject>
+
+/**
+ * An interface for element-wise operations that can be fused into a
+ * chain. If a number of fusible operations are connected in a line,
+ * PiiEngine::execute() replaces the object passing between them with
+ * a single input controller (see [PiiEngine::operationFusion]). The
+ * controller calls [transform()] of each operation in turn without
+ * queuing the intermediate results in sockets, and large matrices are
+ * processed in blocks of rows so that the intermediate results stay
+ * in the cache.
+ *
+ * An implementing class must derive from PiiDefaultOperation and
+ * declare the interface with `Q_INTERFACES(PiiFusibleOperation)`.
+ * The first input and the first output of the operation are used
+ * when chaining. [transform()] must produce the same result that
+ * process() would emit to the first output, and it must be
+ * element-wise: applying it separately to any block of rows in a
+ * matrix must give the corresponding rows of the full result.
+ *
+ * ~~~(c++)
+ * class MyNegation : public PiiDefaultOperation, public PiiFusibleOperation
+ * {
+ *   Q_OBJECT
+ *   Q_INTERFACES(PiiFusibleOperation)
+ * public:
+ *   bool isFusible() const { return true; }
+ *   PiiVariant transform(const PiiVariant& obj) { return PiiVariant(-obj.valueAs<PiiMatrix<int> >()); }
+ * protected:
+ *   void process() { emitObject(transform(readInput())); }
+ * };
+ * ~~~
+ */
+class PII_YDIN_EXPORT PiiFusibleOperation
+{
+public:
+  virtual ~PiiFusibleOperation();
+
+  /**
+   * Returns `true` if the operation can be fused with its current
+   * configuration. This function is called after check(). Typically,
+   * an operation with an optional second operand is fusible only if
+   * the corresponding input is not connected.
+   */
+  virtual bool isFusible() const = 0;
+
+  /**
+   * Returns the result of processing *object*. If the function
+   * throws an exception, the fused chain passes *object* to the
+   * operation's normal processing instead.
+   *
+   * @exception PiiExecutionException& if *object* cannot be
+   * processed.
+   */
+  virtual PiiVariant transform(const PiiVariant& object) = 0;
+};
+
+Q_DECLARE_INTERFACE(PiiFusibleOperation, "com.intopii.PiiFusibleOperation/1.0");
+
+#endif //_PIIFUSIBLEOPERATION_H
@@ -15,8 +15,12 @@
 
 #include "PiiInputSocket.h"
 #include "PiiOutputSocket.h"
+#include "PiiMemoryBudget.h"
 #include "PiiYdinTypes.h"
 #include "PiiNullInputController.h"
+#include "PiiTracer.h"
+
+#include <PiiTimer.h>
 
 #include <QStringList>
 #include <QThread>
@@ -29,8 +33,15 @@ PiiInputSocket::Data::Data() :
   bConnected(false),
   bOptional(false),
   pController(PiiNullInputController::instance()),
+  pMemoryBudget(0),
   iQueueStart(0),
-  iQueueLength(0)
+  iQueueEnd(0),
+  iQueueLength(0),
+  iProducerLock(0),
+  queueMode(PiiInputSocket::LockedQueue),
+  overloadPolicy(PiiInputSocket::BlockWhenFull),
+  iMaxQueueTime(0),
+  bFirstObjectLate(false)
 {}
 
 bool PiiInputSocket::Data::setInputConnected(bool connected)
@@ -51,7 +62,9 @@ PiiInputSocket::PiiInputSocket(const QString& name, Data* data) :
 }
 
 PiiInputSocket::~PiiInputSocket()
-{}
+{
+  setMemoryBudget(0);
+}
 
 bool PiiInputSocket::isConnected() const
 {
@@ -65,33 +78,249 @@ void PiiInputSocket::setQueueCapacity(int queueCapacity)
 {
   PII_D;
   if (queueCapacity < 1) return;
+  // Release the memory reserved by the old queue first.
+  reset();
   d->lstQueue.resize(queueCapacity);
+  d->lstArrivalTimes.resize(queueCapacity);
+  d->lstLatencyTags.resize(queueCapacity);
+  d->lstObjectBytes.resize(queueCapacity);
+  for (int i=0; i<queueCapacity; ++i)
+    d->lstObjectBytes[i] = 0;
   reset();
 }
 
+void PiiInputSocket::store(const PiiVariant& obj, qint64 bytes)
+{
+  PII_D;
+  d->lstQueue[d->iQueueEnd] = obj;
+  d->lstObjectBytes[d->iQueueEnd] = bytes;
+  if (d->iMaxQueueTime > 0)
+    d->lstArrivalTimes[d->iQueueEnd] = PiiTimer::currentTime();
+  if (PiiLatencyTag::isEnabled())
+    d->lstLatencyTags[d->iQueueEnd] = PiiLatencyTag::current();
+  d->iQueueEnd = (d->iQueueEnd+1) % d->lstQueue.size();
+  // Ordered increment publishes the slot to the consumer.
+  const int iQueueLength = ++d->iQueueLength;
+  d->queueLengths.add(iQueueLength);
+  PiiTracer::instant("receive", this, iQueueLength);
+}
+
 void PiiInputSocket::receive(const PiiVariant& obj)
 {
   PII_D;
-  d->lstQueue[queueIndex(d->iQueueLength)] = obj;
-  ++d->iQueueLength;
+  qint64 lBytes = 0;
+  if (d->pMemoryBudget != 0)
+    d->pMemoryBudget->acquire(lBytes = obj.memoryUsage());
+  store(obj, lBytes);
+}
+
+bool PiiInputSocket::reserveMemory(const PiiVariant& obj, qint64* bytes)
+{
+  PII_D;
+  if (d->pMemoryBudget == 0)
+    return true;
+  *bytes = obj.memoryUsage();
+  // Control objects must not be refused, and an empty queue accepts
+  // anything. Otherwise queued objects could take the whole budget
+  // and starve their consumers.
+  if (isControlType(obj.type()) || d->iQueueLength.loadAcquire() == 0)
+    {
+      d->pMemoryBudget->acquire(*bytes);
+      return true;
+    }
+  // Only a blocked sender needs to be woken up when memory is freed.
+  return d->overloadPolicy == BlockWhenFull ?
+    d->pMemoryBudget->tryAcquire(*bytes, this) :
+    d->pMemoryBudget->tryAcquire(*bytes);
+}
+
+void PiiInputSocket::releaseMemory(int queueIndex)
+{
+  PII_D;
+  qint64& lBytes = d->lstObjectBytes[queueIndex];
+  if (lBytes != 0)
+    {
+      d->pMemoryBudget->release(lBytes);
+      lBytes = 0;
+    }
+}
+
+bool PiiInputSocket::tryReceive(const PiiVariant& obj)
+{
+  PII_D;
+  if (d->queueMode == MultiProducerQueue)
+    {
+      while (!d->iProducerLock.testAndSetOrdered(0, 1))
+        QThread::yieldCurrentThread();
+    }
+
+  bool bAccepted = true;
+  qint64 lBytes = 0;
+  // Only the consumer decreases the length. If there is room now,
+  // there will be room when the object is stored.
+  if (d->iQueueLength.loadAcquire() < d->lstQueue.size())
+    {
+      if (reserveMemory(obj, &lBytes))
+        store(obj, lBytes);
+      // Out of memory budget. Same as a full queue.
+      else if (d->overloadPolicy == BlockWhenFull)
+        {
+          ++d->iRejectedObjects;
+          bAccepted = false;
+        }
+      else
+        ++d->iDroppedObjects;
+    }
+  else if (d->overloadPolicy == BlockWhenFull || isControlType(obj.type()))
+    {
+      ++d->iRejectedObjects;
+      bAccepted = false;
+    }
+  // Queued objects can be dropped only if the consumer is locked
+  // out. If all of them are control objects, the new one goes.
+  else if (d->overloadPolicy != DropNewest &&
+           d->queueMode == LockedQueue &&
+           dropQueued(d->overloadPolicy == KeepLatest))
+    {
+      // The replaced objects have released their memory.
+      if (d->pMemoryBudget != 0)
+        d->pMemoryBudget->acquire(lBytes = obj.memoryUsage());
+      store(obj, lBytes);
+    }
+  else
+    ++d->iDroppedObjects;
+
+  if (d->queueMode == MultiProducerQueue)
+    d->iProducerLock.storeRelease(0);
+  return bAccepted;
+}
+
+bool PiiInputSocket::dropQueued(bool all)
+{
+  PII_D;
+  const int iQueueLength = d->iQueueLength.loadAcquire();
+  int iKept = 0;
+  // Compact the queue by moving the kept objects towards the head.
+  for (int i=0; i<iQueueLength; ++i)
+    {
+      const int iFrom = queueIndex(i);
+      if ((all || iKept == i) && isNonControlType(d->lstQueue[iFrom].type()))
+        {
+          releaseMemory(iFrom);
+          continue;
+        }
+      if (iKept != i)
+        {
+          const int iTo = queueIndex(iKept);
+          d->lstQueue[iTo] = d->lstQueue[iFrom];
+          d->lstObjectBytes[iTo] = d->lstObjectBytes[iFrom];
+          d->lstArrivalTimes[iTo] = d->lstArrivalTimes[iFrom];
+          d->lstLatencyTags[iTo] = d->lstLatencyTags[iFrom];
+        }
+      ++iKept;
+    }
+  const int iDropped = iQueueLength - iKept;
+  if (iDropped == 0)
+    return false;
+
+  for (int i=iKept; i<iQueueLength; ++i)
+    {
+      d->lstQueue[queueIndex(i)] = PiiVariant();
+      d->lstLatencyTags[queueIndex(i)] = PiiLatencyTag();
+      d->lstObjectBytes[queueIndex(i)] = 0;
+    }
+  d->iQueueEnd = queueIndex(iKept);
+  d->iQueueLength -= iDropped;
+  d->iDroppedObjects += iDropped;
+  return true;
 }
 
 void PiiInputSocket::shift()
 {
   PII_D;
-  Q_ASSERT(d->iQueueLength > 0);
+  Q_ASSERT(d->iQueueLength.loadAcquire() > 0);
 
   // Move queue head to the outgoing slot.
   d->varProcessableObject = d->lstQueue[d->iQueueStart];
+  if (!d->lstBatch.isEmpty())
+    d->lstBatch.clear();
+  if (d->iMaxQueueTime > 0)
+    {
+      d->bFirstObjectLate = isNonControlType(d->varProcessableObject.type()) &&
+        PiiTimer::currentTime() - d->lstArrivalTimes[d->iQueueStart] > d->iMaxQueueTime;
+      if (d->bFirstObjectLate)
+        ++d->iLateObjects;
+    }
+  // Tags are consumed even if tagging has been disabled after the
+  // object was stored. Otherwise a stale tag could be picked up later.
+  PiiLatencyTag& tag = d->lstLatencyTags[d->iQueueStart];
+  if (tag.isValid())
+    {
+      const qint64 iNow = PiiTimer::currentTime();
+      if (isNonControlType(d->varProcessableObject.type()))
+        addLatency(tag, iNow);
+      d->processableTag = tag.stamped(iNow);
+      tag = PiiLatencyTag();
+    }
+  else if (d->processableTag.isValid())
+    d->processableTag = PiiLatencyTag();
   // Destroy the old head.
   d->lstQueue[d->iQueueStart] = PiiVariant();
+  releaseMemory(d->iQueueStart);
   // Rotate the queue
   d->iQueueStart = (d->iQueueStart+1) % d->lstQueue.size();
-  --d->iQueueLength;
-  // Signal the sender if the queue was full (there may be a thread
-  // waiting).
-  if (d->iQueueLength == d->lstQueue.size()-1 && d->pListener != 0)
+  // Give the slot back to the producer. Signal the sender if the
+  // queue was full (there may be a thread waiting). A lock-free
+  // producer that sees a full queue must have seen the length before
+  // this decrement, so the wake-up cannot be lost.
+  if (d->iQueueLength-- == d->lstQueue.size() && d->pListener != 0)
+    d->pListener->inputReady(this);
+}
+
+int PiiInputSocket::shiftBatch(int maxCount)
+{
+  PII_D;
+  shift();
+  const int iCapacity = d->lstQueue.size();
+  bool bWasFull = false;
+  while (d->lstBatch.size() + 1 < maxCount &&
+         d->iQueueLength.loadAcquire() > 0 &&
+         isNonControlType(d->lstQueue[d->iQueueStart].type()))
+    {
+      d->lstBatch.append(d->lstQueue[d->iQueueStart]);
+      d->lstQueue[d->iQueueStart] = PiiVariant();
+      releaseMemory(d->iQueueStart);
+      PiiLatencyTag& tag = d->lstLatencyTags[d->iQueueStart];
+      if (tag.isValid())
+        {
+          addLatency(tag, PiiTimer::currentTime());
+          tag = PiiLatencyTag();
+        }
+      d->iQueueStart = (d->iQueueStart+1) % iCapacity;
+      if (d->iQueueLength-- == iCapacity)
+        bWasFull = true;
+    }
+  // Signal once for the whole batch.
+  if (bWasFull && d->pListener != 0)
     d->pListener->inputReady(this);
+  return d->lstBatch.size() + 1;
+}
+
+void PiiInputSocket::addLatency(const PiiLatencyTag& tag, qint64 time)
+{
+  PII_D;
+  d->latencies.add(time - tag.captureTime());
+  d->stageLatencies.add(time - tag.stageTime());
+}
+
+int PiiInputSocket::batchSize() const
+{
+  return _d()->lstBatch.size() + 1;
+}
+
+PiiVariant PiiInputSocket::batchObject(int index) const
+{
+  return index == 0 ? firstObject() : _d()->lstBatch[index-1];
 }
 
 void PiiInputSocket::assignFirstObject(Qt::HANDLE activeThreadId)
@@ -103,12 +332,16 @@ void PiiInputSocket::assignFirstObject(Qt::HANDLE activeThreadId)
     if (d->lstProcessableObjects[i].first == 0)
       {
         d->lstProcessableObjects[i] = qMakePair(activeThreadId, d->varProcessableObject);
+        d->lstProcessableTags[i] = d->processableTag;
         d->varProcessableObject = PiiVariant();
+        d->processableTag = PiiLatencyTag();
         return;
       }
   // No empty slots found -> add a new one
   d->lstProcessableObjects.append(qMakePair(activeThreadId, d->varProcessableObject));
+  d->lstProcessableTags.append(d->processableTag);
   d->varProcessableObject = PiiVariant();
+  d->processableTag = PiiLatencyTag();
 }
 
 void PiiInputSocket::unassignFirstObject(Qt::HANDLE activeThreadId)
@@ -120,6 +353,7 @@ void PiiInputSocket::unassignFirstObject(Qt::HANDLE activeThreadId)
     if (d->lstProcessableObjects[i].first == activeThreadId)
       {
         d->lstProcessableObjects[i] = qMakePair(Qt::HANDLE(0), PiiVariant());
+        d->lstProcessableTags[i] = PiiLatencyTag();
         return;
       }
 }
@@ -128,15 +362,27 @@ void PiiInputSocket::jump(int oldIndex, int newIndex)
 {
   PII_D;
   PiiVariant tmpObj = queuedObject(oldIndex);
+  qint64 iTmpTime = d->lstArrivalTimes[queueIndex(oldIndex)];
+  PiiLatencyTag tmpTag = d->lstLatencyTags[queueIndex(oldIndex)];
+  qint64 lTmpBytes = d->lstObjectBytes[queueIndex(oldIndex)];
   for (int i=oldIndex-1; i>=newIndex; --i)
-    d->lstQueue[queueIndex(i+1)] = d->lstQueue[queueIndex(i)];
+    {
+      d->lstQueue[queueIndex(i+1)] = d->lstQueue[queueIndex(i)];
+      d->lstObjectBytes[queueIndex(i+1)] = d->lstObjectBytes[queueIndex(i)];
+      d->lstArrivalTimes[queueIndex(i+1)] = d->lstArrivalTimes[queueIndex(i)];
+      d->lstLatencyTags[queueIndex(i+1)] = d->lstLatencyTags[queueIndex(i)];
+    }
   d->lstQueue[queueIndex(newIndex)] = tmpObj;
+  d->lstArrivalTimes[queueIndex(newIndex)] = iTmpTime;
+  d->lstLatencyTags[queueIndex(newIndex)] = tmpTag;
+  d->lstObjectBytes[queueIndex(newIndex)] = lTmpBytes;
 }
 
 int PiiInputSocket::indexOf(unsigned int type, int startIndex) const
 {
   const PII_D;
-  for (int i=startIndex; i<d->iQueueLength; ++i)
+  const int iQueueLength = d->iQueueLength.loadAcquire();
+  for (int i=startIndex; i<iQueueLength; ++i)
     {
       int iQueueIndex = queueIndex(i);
       if (d->lstQueue[iQueueIndex].type() == type)
@@ -149,11 +395,20 @@ void PiiInputSocket::reset()
 {
   PII_D;
   for (int i=0; i<d->lstQueue.size(); ++i)
-    d->lstQueue[i] = PiiVariant();
+    {
+      d->lstQueue[i] = PiiVariant();
+      d->lstLatencyTags[i] = PiiLatencyTag();
+      releaseMemory(i);
+    }
   d->varProcessableObject = PiiVariant();
+  d->processableTag = PiiLatencyTag();
+  d->lstBatch.clear();
   d->lstProcessableObjects.clear();
+  d->lstProcessableTags.clear();
+  d->bFirstObjectLate = false;
   d->iQueueLength = 0;
   d->iQueueStart = 0;
+  d->iQueueEnd = 0;
 }
 
 void PiiInputSocket::setController(PiiInputController* controller)
@@ -164,6 +419,32 @@ void PiiInputSocket::setController(PiiInputController* controller)
     d->pConnectedOutput->updateInput(this);
 }
 
+void PiiInputSocket::setMemoryBudget(PiiMemoryBudget* budget)
+{
+  PII_D;
+  if (budget == d->pMemoryBudget)
+    return;
+  // Objects already in the queue are not accounted to the new
+  // budget.
+  if (d->pMemoryBudget != 0)
+    {
+      d->pMemoryBudget->removeWaiter(this);
+      for (int i=0; i<d->lstObjectBytes.size(); ++i)
+        releaseMemory(i);
+    }
+  d->pMemoryBudget = budget;
+}
+
+qint64 PiiInputSocket::queuedBytes() const
+{
+  const PII_D;
+  const int iQueueLength = d->iQueueLength.loadAcquire();
+  qint64 lBytes = 0;
+  for (int i=0; i<iQueueLength; ++i)
+    lBytes += d->lstObjectBytes[queueIndex(i)];
+  return lBytes;
+}
+
 PiiVariant PiiInputSocket::firstObject() const
 {
   const PII_D;
@@ -174,7 +455,7 @@ PiiVariant PiiInputSocket::firstObject() const
     return d->varProcessableObject;
 
   // Otherwise look for the thread id
-  Qt::HANDLE currentThreadId = QThread::currentThreadId();
+  Qt::HANDLE currentThreadId = PiiYdin::activeThreadId();
   for (int i=0; i<d->lstProcessableObjects.size(); ++i)
     if (d->lstProcessableObjects[i].first == currentThreadId)
       return d->lstProcessableObjects[i].second;
@@ -183,15 +464,54 @@ PiiVariant PiiInputSocket::firstObject() const
   return d->varProcessableObject;
 }
 
+PiiLatencyTag PiiInputSocket::firstLatencyTag() const
+{
+  const PII_D;
+  QMutexLocker lock(&d->firstObjectMutex);
+  if (d->lstProcessableObjects.isEmpty())
+    return d->processableTag;
+
+  Qt::HANDLE currentThreadId = PiiYdin::activeThreadId();
+  for (int i=0; i<d->lstProcessableObjects.size(); ++i)
+    if (d->lstProcessableObjects[i].first == currentThreadId)
+      return d->lstProcessableTags[i];
+
+  return d->processableTag;
+}
 
 PiiInputController* PiiInputSocket::controller() const { return _d()->pController; }
+PiiMemoryBudget* PiiInputSocket::memoryBudget() const { return _d()->pMemoryBudget; }
 PiiVariant PiiInputSocket::queuedObject(int index) const { return _d()->lstQueue[queueIndex(index)]; }
 unsigned int PiiInputSocket::queuedType(int index) const { return _d()->lstQueue[queueIndex(index)].type(); }
-int PiiInputSocket::queueLength() const { return _d()->iQueueLength; }
+int PiiInputSocket::queueLength() const { return _d()->iQueueLength.loadAcquire(); }
 int PiiInputSocket::queueCapacity() const { return _d()->lstQueue.size(); }
-bool PiiInputSocket::canReceive() const { return _d()->lstQueue.size() > _d()->iQueueLength; }
+bool PiiInputSocket::canReceive() const { return _d()->lstQueue.size() > _d()->iQueueLength.loadAcquire(); }
+void PiiInputSocket::setQueueMode(QueueMode queueMode) { _d()->queueMode = queueMode; }
+PiiInputSocket::QueueMode PiiInputSocket::queueMode() const { return _d()->queueMode; }
 void PiiInputSocket::setOptional(bool optional) { _d()->bOptional = optional; }
 bool PiiInputSocket::isOptional() const { return _d()->bOptional; }
+const PiiProfileHistogram& PiiInputSocket::queueLengthHistogram() const { return _d()->queueLengths; }
+int PiiInputSocket::rejectedObjectCount() const { return _d()->iRejectedObjects.load(); }
+int PiiInputSocket::droppedObjectCount() const { return _d()->iDroppedObjects.load(); }
+int PiiInputSocket::lateObjectCount() const { return _d()->iLateObjects.load(); }
+const PiiProfileHistogram& PiiInputSocket::latencyHistogram() const { return _d()->latencies; }
+const PiiProfileHistogram& PiiInputSocket::stageLatencyHistogram() const { return _d()->stageLatencies; }
+void PiiInputSocket::setOverloadPolicy(OverloadPolicy overloadPolicy) { _d()->overloadPolicy = overloadPolicy; }
+PiiInputSocket::OverloadPolicy PiiInputSocket::overloadPolicy() const { return _d()->overloadPolicy; }
+void PiiInputSocket::setMaxQueueTime(int maxQueueTime) { _d()->iMaxQueueTime = qint64(qMax(0, maxQueueTime)) * 1000; }
+int PiiInputSocket::maxQueueTime() const { return int(_d()->iMaxQueueTime / 1000); }
+bool PiiInputSocket::isFirstObjectLate() const { return _d()->bFirstObjectLate; }
+
+void PiiInputSocket::resetProfile()
+{
+  PII_D;
+  d->queueLengths.reset();
+  d->iRejectedObjects.store(0);
+  d->iDroppedObjects.store(0);
+  d->iLateObjects.store(0);
+  d->latencies.reset();
+  d->stageLatencies.reset();
+}
 
 
 namespace PiiYdin
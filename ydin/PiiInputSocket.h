@@ -19,11 +19,16 @@
 #include "PiiSocket.h"
 #include "PiiAbstractInputSocket.h"
 #include "PiiInputController.h"
+#include "PiiProfileHistogram.h"
+#include "PiiLatencyTag.h"
+
+#include <PiiAtomicInt.h>
 
 #include <QVarLengthArray>
 #include <QPair>
 
 class PiiOutputSocket;
+class PiiMemoryBudget;
 
 
 /**
@@ -84,7 +89,96 @@ class PII_YDIN_EXPORT PiiInputSocket : public PiiAbstractInputSocket
    */
   Q_PROPERTY(int queueCapacity READ queueCapacity WRITE setQueueCapacity);
 
+  /**
+   * The way concurrent access to the input queue is synchronized.
+   * The default value is `LockedQueue`. Like [queueCapacity], the
+   * queue mode can safely be changed only if the parent operation is
+   * stopped.
+   */
+  Q_PROPERTY(QueueMode queueMode READ queueMode WRITE setQueueMode);
+  Q_ENUMS(QueueMode);
+
+  /**
+   * What to do when an object arrives at a full queue. The default
+   * value is `BlockWhenFull`, which makes the sender wait. Control
+   * objects are never dropped.
+   */
+  Q_PROPERTY(OverloadPolicy overloadPolicy READ overloadPolicy WRITE setOverloadPolicy);
+  Q_ENUMS(OverloadPolicy);
+
+  /**
+   * The maximum time, in milliseconds, an object may wait in the
+   * input queue. An object that has waited longer is late, and
+   * PiiDefaultOperation discards it without calling process(). Late
+   * objects are counted in [lateObjectCount()]. Zero disables the
+   * check. The default value is zero.
+   *
+   * Since the operation skips the whole processing round, all
+   * inputs in the same group lose their current object. Other
+   * groups and downstream operations are not told about the
+   * discarded objects. Therefore, deadlines should only be set on
+   * inputs whose objects need not be paired with objects that went
+   * through another branch.
+   */
+  Q_PROPERTY(int maxQueueTime READ maxQueueTime WRITE setMaxQueueTime);
+
 public:
+  /**
+   * Input queue synchronization modes.
+   *
+   * - `LockedQueue` - all access to the queue is serialized by the
+   * input controller. This is the traditional mode and works with
+   * any controller.
+   *
+   * - `SingleProducerQueue` - the queue works as a lock-free
+   * single-producer, single-consumer ring buffer. Objects can be
+   * passed to the queue with [tryReceive()] without holding any
+   * lock, provided that only one thread emits objects at a time.
+   * This is the case with all output sockets unless objects are
+   * emitted concurrently from custom threads.
+   *
+   * - `MultiProducerQueue` - like `SingleProducerQueue`, but
+   * concurrent producers are allowed. Producers are serialized with
+   * an atomic flag that is held only for the time it takes to store
+   * the object. The consumer side remains lock-free.
+   *
+   * Senders block only if the queue is full, and receivers only if
+   * it is empty. Currently, PiiDefaultOperation makes use of the
+   * lock-free modes when [PiiDefaultOperation::threadCount] is one.
+   * In other threading modes, the processor needs to run flow
+   * control in the sending thread, and a lock is taken anyway.
+   */
+  enum QueueMode { LockedQueue, SingleProducerQueue, MultiProducerQueue };
+
+  /**
+   * Overload policies.
+   *
+   * - `BlockWhenFull` - the sender waits until there is room in the
+   * queue. Nothing is lost, but a slow consumer stalls its
+   * producers.
+   *
+   * - `DropNewest` - the incoming object is discarded.
+   *
+   * - `DropOldest` - the oldest queued object is discarded to make
+   * room for the incoming one.
+   *
+   * - `KeepLatest` - all queued objects are discarded, and only the
+   * incoming one is kept. The consumer always gets the most recent
+   * object.
+   *
+   * `DropOldest` and `KeepLatest` modify objects that belong to the
+   * consumer side of the queue and require the `LockedQueue` mode.
+   * In the lock-free modes, they work like `DropNewest`. Dropped
+   * objects are counted in [droppedObjectCount()].
+   *
+   * Dropping an object in one input breaks its pairing with the
+   * objects in the other synchronized inputs. The policies are thus
+   * best suited to operations with a single input per group, such as
+   * the first operation after a camera.
+   */
+  enum OverloadPolicy { BlockWhenFull, DropNewest, DropOldest, KeepLatest };
+
+
   /**
    * Constructs a new input socket with the given name.
    */
@@ -140,6 +234,42 @@ public:
    */
   void shift();
 
+  /**
+   * Moves up to *maxCount* objects out of the queue at once. The
+   * first object must be an ordinary (non-control) object. The
+   * following objects are shifted as long as they are ordinary
+   * objects and the queue is not empty. The first object can be
+   * retrieved with [firstObject()] as usual, and all of them with
+   * [batchObject()]. Batches are used by PiiDefaultOperation in batch
+   * mode (see [PiiDefaultOperation::setMaxBatchSize()]).
+   *
+   * Batches cannot be used with [assignFirstObject()].
+   *
+   * @return the number of objects in the batch, at least one.
+   */
+  int shiftBatch(int maxCount);
+
+  /**
+   * Returns the number of objects moved out of the queue by the last
+   * [shift()] or [shiftBatch()]. After [shift()], the batch size is
+   * one.
+   */
+  int batchSize() const;
+
+  /**
+   * Returns the object at *index* in the last batch. Index zero
+   * returns the same object as [firstObject()].
+   *
+   * ~~~(c++)
+   * void MyOperation::process()
+   * {
+   *   for (int i=0; i<_pInput->batchSize(); ++i)
+   *     _pOutput->emitObject(PiiVariant(_pInput->batchObject(i).valueAs<int>() * 2));
+   * }
+   * ~~~
+   */
+  PiiVariant batchObject(int index) const;
+
   /**
    * Assigns the first object in the input queue to the specified
    * thread. If the input object is assigned to a thread,
@@ -181,6 +311,25 @@ public:
    */
   void receive(const PiiVariant& obj);
 
+  /**
+   * Puts `obj` into the incoming queue if there is room for it.
+   * Unlike [receive()], this function may be called concurrently
+   * with the consumer ([shift()], [queuedObject()] etc.) if
+   * [queueMode] is not `LockedQueue`. If the queue is full, the
+   * [overloadPolicy] decides what happens. With `BlockWhenFull`,
+   * returns `false`, and the next [shift()] will signal the
+   * listener.
+   *
+   * If a [memory budget](setMemoryBudget()) has been set and storing
+   * the object would exceed it, the object is handled as if the queue
+   * was full, and the budget signals the listener once memory is
+   * released.
+   *
+   * @return `true` if the object was accepted (stored or dropped),
+   * `false` otherwise
+   */
+  bool tryReceive(const PiiVariant& obj);
+
   /**
    * Checks if the input queue in this socket still has room for a new
    * object. This function is a shorthand for queueCapacity() >
@@ -197,6 +346,66 @@ public:
    */
   int queueCapacity() const;
 
+  /**
+   * Sets the queue synchronization mode.
+   */
+  void setQueueMode(QueueMode queueMode);
+  /**
+   * Returns the queue synchronization mode.
+   */
+  QueueMode queueMode() const;
+
+  /**
+   * Sets the overload policy.
+   */
+  void setOverloadPolicy(OverloadPolicy overloadPolicy);
+  /**
+   * Returns the overload policy.
+   */
+  OverloadPolicy overloadPolicy() const;
+
+  /**
+   * Sets the memory budget queued objects are accounted to. Each
+   * object stored into the queue reserves its
+   * [memory usage](PiiVariant::memoryUsage()) from *budget*, and the
+   * reservation is released when the object is shifted out. If the
+   * reservation fails, [tryReceive()] rejects the object under
+   * `BlockWhenFull` and drops it under the other
+   * [overload policies](overloadPolicy). Control objects and objects
+   * arriving at an empty queue are always accepted. This is done
+   * automatically by PiiDefaultOperation::check() (see
+   * PiiDefaultOperation::setMemoryBudget()). Zero (the default)
+   * disables accounting. The socket does not take the ownership of
+   * the budget.
+   */
+  void setMemoryBudget(PiiMemoryBudget* budget);
+  /**
+   * Returns the memory budget, or zero if none has been set.
+   */
+  PiiMemoryBudget* memoryBudget() const;
+  /**
+   * Returns the number of bytes reserved by the objects currently in
+   * the queue. Always zero if there is no [memory
+   * budget](setMemoryBudget()).
+   */
+  qint64 queuedBytes() const;
+
+  /**
+   * Sets the maximum queueing time in milliseconds.
+   */
+  void setMaxQueueTime(int maxQueueTime);
+  /**
+   * Returns the maximum queueing time.
+   */
+  int maxQueueTime() const;
+
+  /**
+   * Returns `true` if the object last moved out of the queue by
+   * [shift()] or [shiftBatch()] waited longer than [maxQueueTime].
+   * In a batch, only the first object is inspected.
+   */
+  bool isFirstObjectLate() const;
+
   /**
    * Returns the number of objects currently in the input queue.
    */
@@ -227,6 +436,14 @@ public:
    */
   PiiVariant firstObject() const;
 
+  /**
+   * Returns the latency tag of [firstObject()], restamped with the
+   * time it was shifted out of the queue. If latency tagging is
+   * disabled or the object was not tagged, an invalid tag will be
+   * returned. See PiiLatencyTag.
+   */
+  PiiLatencyTag firstLatencyTag() const;
+
   /**
    * Sets the input controller. The controller must be set before the
    * input can receive objects. This is done automatically by
@@ -239,6 +456,50 @@ public:
 
   PiiInputController* controller() const;
 
+  /**
+   * Returns a histogram of the input queue length, sampled whenever
+   * an object is stored into the queue. The sample includes the new
+   * object. An input whose queue is constantly full belongs to an
+   * operation that cannot keep up with its senders.
+   */
+  const PiiProfileHistogram& queueLengthHistogram() const;
+  /**
+   * Returns the number of times [tryReceive()] rejected an object
+   * because the queue was full or the [memory budget](setMemoryBudget())
+   * was exhausted. A sender retries until the object is
+   * accepted, so one object may be rejected many times.
+   */
+  int rejectedObjectCount() const;
+  /**
+   * Returns the number of objects discarded due to the
+   * [overloadPolicy].
+   */
+  int droppedObjectCount() const;
+  /**
+   * Returns the number of objects that exceeded [maxQueueTime].
+   */
+  int lateObjectCount() const;
+  /**
+   * Returns a histogram of end-to-end latencies (in microseconds) of
+   * tagged objects, measured from capture to the moment the object
+   * was shifted out of the queue. Only collected when latency
+   * tagging is enabled. See PiiLatencyTag.
+   */
+  const PiiProfileHistogram& latencyHistogram() const;
+  /**
+   * Returns a histogram of the latencies (in microseconds) caused by
+   * the previous stage: the time from the moment the upstream
+   * operation shifted the object out of its own queue to the moment
+   * this input shifted the derived object out. This includes the
+   * processing time of the upstream operation and the time spent in
+   * this queue.
+   */
+  const PiiProfileHistogram& stageLatencyHistogram() const;
+  /**
+   * Clears the profiling statistics.
+   */
+  void resetProfile();
+
 protected:
   /// @internal
   class Data : public PiiAbstractInputSocket::Data
@@ -253,10 +514,38 @@ protected:
     bool bOptional;
     PiiInputController* pController;
     QVarLengthArray<PiiVariant, 4> lstQueue;
+    // Arrival times of the queued objects, only if iMaxQueueTime > 0.
+    QVarLengthArray<qint64, 4> lstArrivalTimes;
+    // Latency tags of the queued objects, only if tagging is enabled.
+    QVarLengthArray<PiiLatencyTag, 4> lstLatencyTags;
+    // Bytes reserved from pMemoryBudget by the queued objects.
+    QVarLengthArray<qint64, 4> lstObjectBytes;
+    PiiMemoryBudget* pMemoryBudget;
     PiiVariant varProcessableObject;
+    PiiLatencyTag processableTag;
+    // The objects shifted after varProcessableObject by shiftBatch().
+    PiiVariantList lstBatch;
     QVarLengthArray<QPair<Qt::HANDLE, PiiVariant> > lstProcessableObjects;
-    int iQueueStart, iQueueLength;
+    // The tags of lstProcessableObjects.
+    QVarLengthArray<PiiLatencyTag> lstProcessableTags;
+    int iQueueStart, iQueueEnd;
+    // Modified by both the producer and the consumer. All other
+    // queue indices are owned by one side only.
+    PiiAtomicInt iQueueLength;
+    // Serializes producers in MultiProducerQueue mode.
+    PiiAtomicInt iProducerLock;
+    QueueMode queueMode;
+    OverloadPolicy overloadPolicy;
+    // In microseconds
+    qint64 iMaxQueueTime;
+    bool bFirstObjectLate;
     mutable QMutex firstObjectMutex;
+    PiiProfileHistogram queueLengths;
+    PiiAtomicInt iRejectedObjects;
+    PiiAtomicInt iDroppedObjects;
+    PiiAtomicInt iLateObjects;
+    PiiProfileHistogram latencies;
+    PiiProfileHistogram stageLatencies;
   };
   PII_D_FUNC;
 
@@ -264,6 +553,11 @@ protected:
   PiiInputSocket(const QString& name, Data* data);
 
 private:
+  void store(const PiiVariant& obj, qint64 bytes);
+  bool reserveMemory(const PiiVariant& obj, qint64* bytes);
+  void releaseMemory(int queueIndex);
+  bool dropQueued(bool all);
+  void addLatency(const PiiLatencyTag& tag, qint64 time);
   inline int queueIndex(int index) const { return (_d()->iQueueStart+index) % _d()->lstQueue.size(); }
 };
 
@@ -0,0 +1,51 @@
+/* This file is part of Into.
+ * Copyright (C) Intopii 2013.
+ * All rights reserved.
+ *
+ * Licensees holding a commercial Into license may use this file in
+ * accordance with the commercial license agreement. Please see
+ * LICENSE.commercial for commercial licensing terms.
+ *
+ * Alternatively, this file may be used under the terms of the GNU
+ * Affero General Public License version 3 as published by the Free
+ * Software Foundation. In addition, Intopii gives you special rights
+ * to use Into as a part of open source software projects. Please
+ * refer to LICENSE.AGPL3 for details.
+ */
+
+#include "PiiLatencyTag.h"
+
+#include <PiiTimer.h>
+
+#include <QThreadStorage>
+
+PiiAtomicInt PiiLatencyTag::_iEnabled(0);
+PiiAtomicInt PiiLatencyTag::_iNextSequenceId(0);
+
+static QThreadStorage<PiiLatencyTag*> currentLatencyTags;
+
+void PiiLatencyTag::setEnabled(bool enabled)
+{
+  _iEnabled.storeRelease(enabled ? 1 : 0);
+}
+
+PiiLatencyTag PiiLatencyTag::start()
+{
+  PiiLatencyTag tag;
+  tag._iCaptureTime = tag._iStageTime = PiiTimer::currentTime();
+  tag._uiSequenceId = (unsigned int)_iNextSequenceId++;
+  return tag;
+}
+
+PiiLatencyTag PiiLatencyTag::current()
+{
+  return currentLatencyTags.hasLocalData() ? *currentLatencyTags.localData() : PiiLatencyTag();
+}
+
+void PiiLatencyTag::setCurrent(const PiiLatencyTag& tag)
+{
+  if (!currentLatencyTags.hasLocalData())
+    currentLatencyTags.setLocalData(new PiiLatencyTag(tag));
+  else
+    *currentLatencyTags.localData() = tag;
+}
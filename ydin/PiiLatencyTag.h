@@ -0,0 +1,169 @@
+/* This file is part of Into.
+ * Copyright (C) Intopii 2013.
+ * All rights reserved.
+ *
+ * Licensees holding a commercial Into license may use this file in
+ * accordance with the commercial license agreement. Please see
+ * LICENSE.commercial for commercial licensing terms.
+ *
+ * Alternatively, this file may be used under the terms of the GNU
+ * Affero General Public License version 3 as published by the Free
+ * Software Foundation. In addition, Intopii gives you special rights
+ * to use Into as a part of open source software projects. Please
+ * refer to LICENSE.AGPL3 for details.
+ */
+
+#ifndef _PIILATENCYTAG_H
+#define _PIILATENCYTAG_H
+
+#include "PiiYdin.h"
+
+#include <PiiAtomicInt.h>
+
+/**
+ * A lightweight trace tag that follows objects through the engine.
+ * When latency tagging is enabled, each object emitted by a source
+ * operation is stamped with the time of capture and a running
+ * sequence number. The tag is stored alongside the object in input
+ * queues and passed on to everything emitted while the object is
+ * being processed. Compound proxies, PiiPisoOperation and
+ * demultiplexers pass objects synchronously, so the tag survives
+ * them without any special handling.
+ *
+ * Each PiiInputSocket measures the latency of tagged objects when
+ * they are taken from the queue. The end-to-end latency (since
+ * capture) is collected to
+ * PiiInputSocket::latencyHistogram(), and the latency
+ * attributable to the previous stage (the time since the upstream
+ * operation took the object from its own queue) is collected to
+ * PiiInputSocket::stageLatencyHistogram(). At the inputs of sink
+ * operations, the former is the end-to-end latency of the pipeline.
+ * Summing stage latencies along a path gives the same total, split
+ * to processing stages. The histograms are included in
+ * PiiEngine::profile().
+ *
+ * ~~~(c++)
+ * PiiLatencyTag::setEnabled(true);
+ * engine.execute();
+ * // ... let it run ...
+ * QVariantMap mapProfile = engine.profile();
+ * ~~~
+ *
+ * When tagging is disabled, the overhead is a single atomic load per
+ * emission and received object.
+ */
+class PII_YDIN_EXPORT PiiLatencyTag
+{
+public:
+  class Scope;
+  friend class Scope;
+
+  /**
+   * Creates an invalid tag.
+   */
+  PiiLatencyTag() : _iCaptureTime(-1), _iStageTime(-1), _uiSequenceId(0) {}
+
+  /**
+   * Returns `true` if the tag has been stamped with a capture time.
+   */
+  bool isValid() const { return _iCaptureTime >= 0; }
+  /**
+   * Returns the time (PiiTimer::currentTime()) at which the tagged
+   * object was first emitted.
+   */
+  qint64 captureTime() const { return _iCaptureTime; }
+  /**
+   * Returns the time at which the latest processing stage took the
+   * object from its input queue, or the capture time if the object
+   * has not been queued yet.
+   */
+  qint64 stageTime() const { return _iStageTime; }
+  /**
+   * Returns the running sequence number of the tag. Objects derived
+   * from the same captured object share the sequence number.
+   */
+  unsigned int sequenceId() const { return _uiSequenceId; }
+  /**
+   * Returns a copy of this tag with the stage time set to *time*.
+   */
+  PiiLatencyTag stamped(qint64 time) const
+  {
+    PiiLatencyTag tag(*this);
+    tag._iStageTime = time;
+    return tag;
+  }
+
+  /**
+   * Enables or disables latency tagging. Tagging is disabled by
+   * default.
+   */
+  static void setEnabled(bool enabled);
+  /**
+   * Returns `true` if latency tagging is enabled.
+   */
+  static bool isEnabled() { return _iEnabled.load() != 0; }
+  /**
+   * Returns a new tag stamped with the current time and the next
+   * sequence number.
+   */
+  static PiiLatencyTag start();
+  /**
+   * Returns the tag current in the calling thread, or an invalid
+   * tag if there is none.
+   */
+  static PiiLatencyTag current();
+
+private:
+  static void setCurrent(const PiiLatencyTag& tag);
+
+  qint64 _iCaptureTime, _iStageTime;
+  unsigned int _uiSequenceId;
+
+  static PiiAtomicInt _iEnabled, _iNextSequenceId;
+};
+
+/**
+ * Scoped current tag. The constructor makes a tag current for the
+ * calling thread, and the destructor restores the previous one.
+ * Objects emitted while a tag is current inherit it.
+ */
+class PiiLatencyTag::Scope
+{
+public:
+  /**
+   * Makes *tag* current, if it is valid.
+   */
+  Scope(const PiiLatencyTag& tag) :
+    _bActive(tag.isValid())
+  {
+    if (_bActive)
+      {
+        _previous = PiiLatencyTag::current();
+        PiiLatencyTag::setCurrent(tag);
+      }
+  }
+
+  /**
+   * Starts a new tag if tagging is enabled but the calling thread
+   * has no current tag. Output sockets use this to stamp objects
+   * emitted by sources.
+   */
+  Scope() :
+    _bActive(PiiLatencyTag::isEnabled() && !PiiLatencyTag::current().isValid())
+  {
+    if (_bActive)
+      PiiLatencyTag::setCurrent(PiiLatencyTag::start());
+  }
+
+  ~Scope()
+  {
+    if (_bActive)
+      PiiLatencyTag::setCurrent(_previous);
+  }
+
+private:
+  bool _bActive;
+  PiiLatencyTag _previous;
+};
+
+#endif //_PIILATENCYTAG_H
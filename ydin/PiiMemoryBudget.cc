@@ -0,0 +1,227 @@
+/* This file is part of Into.
+ * Copyright (C) Intopii 2013.
+ * All rights reserved.
+ *
+ * Licensees holding a commercial Into license may use this file in
+ * accordance with the commercial license agreement. Please see
+ * LICENSE.commercial for commercial licensing terms.
+ *
+ * Alternatively, this file may be used under the terms of the GNU
+ * Affero General Public License version 3 as published by the Free
+ * Software Foundation. In addition, Intopii gives you special rights
+ * to use Into as a part of open source software projects. Please
+ * refer to LICENSE.AGPL3 for details.
+ */
+
+#include "PiiMemoryBudget.h"
+#include "PiiAbstractInputSocket.h"
+
+#include <PiiAtomicInt.h>
+
+#include <QMutex>
+#include <QList>
+
+#ifdef PII_CXX11
+#  include <atomic>
+#endif
+
+class PiiMemoryBudget::Data
+{
+public:
+  Data(qint64 limit) :
+    lLimit(limit), lSoftLimit(0),
+    lUsage(0), lPeakUsage(0),
+#ifdef PII_CXX11
+    iWaiterCount(0),
+#endif
+    iRejections(0)
+  {}
+
+#ifdef PII_CXX11
+  void updatePeak(qint64 usage)
+  {
+    qint64 lPeak = lPeakUsage.load();
+    while (lPeak < usage && !lPeakUsage.compare_exchange_weak(lPeak, usage)) ;
+  }
+
+  std::atomic<qint64> lLimit, lSoftLimit, lUsage, lPeakUsage;
+  // The size of lstWaiters. Lets release() skip the mutex if nobody
+  // waits.
+  std::atomic<int> iWaiterCount;
+#else
+  // Protected by counterMutex.
+  qint64 lLimit, lSoftLimit, lUsage, lPeakUsage;
+  mutable QMutex counterMutex;
+#endif
+  PiiAtomicInt iRejections;
+  QMutex waiterMutex;
+  QList<PiiAbstractInputSocket*> lstWaiters;
+};
+
+PiiMemoryBudget::PiiMemoryBudget(qint64 limit) :
+  d(new Data(qMax(limit, qint64(0))))
+{}
+
+PiiMemoryBudget::~PiiMemoryBudget()
+{
+  delete d;
+}
+
+bool PiiMemoryBudget::reserve(qint64 bytes)
+{
+#ifdef PII_CXX11
+  const qint64 lLimit = d->lLimit.load();
+  qint64 lUsage = d->lUsage.load();
+  do
+    {
+      if (lLimit > 0 && lUsage + bytes > lLimit)
+        return false;
+    }
+  while (!d->lUsage.compare_exchange_weak(lUsage, lUsage + bytes));
+  d->updatePeak(lUsage + bytes);
+#else
+  QMutexLocker lock(&d->counterMutex);
+  if (d->lLimit > 0 && d->lUsage + bytes > d->lLimit)
+    return false;
+  d->lUsage += bytes;
+  d->lPeakUsage = qMax(d->lPeakUsage, d->lUsage);
+#endif
+  return true;
+}
+
+bool PiiMemoryBudget::tryAcquire(qint64 bytes)
+{
+  if (reserve(bytes))
+    return true;
+  ++d->iRejections;
+  return false;
+}
+
+bool PiiMemoryBudget::tryAcquire(qint64 bytes, PiiAbstractInputSocket* waiter)
+{
+  if (reserve(bytes))
+    return true;
+  if (waiter->listener() == 0)
+    {
+      ++d->iRejections;
+      return false;
+    }
+
+  QMutexLocker lock(&d->waiterMutex);
+  const bool bAdded = !d->lstWaiters.contains(waiter);
+  if (bAdded)
+    {
+      d->lstWaiters << waiter;
+#ifdef PII_CXX11
+      d->iWaiterCount.store(d->lstWaiters.size());
+#endif
+    }
+  // Memory may have been released after the first attempt but before
+  // the waiter was visible to release(). Now that it is visible,
+  // either this retry sees the release or release() sees the waiter.
+  if (reserve(bytes))
+    {
+      if (bAdded)
+        {
+          d->lstWaiters.removeOne(waiter);
+#ifdef PII_CXX11
+          d->iWaiterCount.store(d->lstWaiters.size());
+#endif
+        }
+      return true;
+    }
+  ++d->iRejections;
+  return false;
+}
+
+void PiiMemoryBudget::acquire(qint64 bytes)
+{
+#ifdef PII_CXX11
+  d->updatePeak(d->lUsage.fetch_add(bytes) + bytes);
+#else
+  QMutexLocker lock(&d->counterMutex);
+  d->lUsage += bytes;
+  d->lPeakUsage = qMax(d->lPeakUsage, d->lUsage);
+#endif
+}
+
+void PiiMemoryBudget::release(qint64 bytes)
+{
+  if (bytes == 0)
+    return;
+#ifdef PII_CXX11
+  d->lUsage.fetch_sub(bytes);
+  if (d->iWaiterCount.load() > 0)
+    wakeWaiters();
+#else
+  {
+    QMutexLocker lock(&d->counterMutex);
+    d->lUsage -= bytes;
+  }
+  wakeWaiters();
+#endif
+}
+
+void PiiMemoryBudget::wakeWaiters()
+{
+  QMutexLocker lock(&d->waiterMutex);
+  // All waiters retry. Those that still don't fit register again.
+  for (int i=0; i<d->lstWaiters.size(); ++i)
+    {
+      PiiAbstractInputSocket* pInput = d->lstWaiters[i];
+      if (PiiInputListener* pListener = pInput->listener())
+        pListener->inputReady(pInput);
+    }
+  d->lstWaiters.clear();
+#ifdef PII_CXX11
+  d->iWaiterCount.store(0);
+#endif
+}
+
+void PiiMemoryBudget::removeWaiter(PiiAbstractInputSocket* waiter)
+{
+  QMutexLocker lock(&d->waiterMutex);
+  d->lstWaiters.removeOne(waiter);
+#ifdef PII_CXX11
+  d->iWaiterCount.store(d->lstWaiters.size());
+#endif
+}
+
+bool PiiMemoryBudget::isUnderPressure(qint64 bytes) const
+{
+  const qint64 lLimit = limit();
+  if (lLimit == 0)
+    return false;
+  const qint64 lSoftLimit = softLimit();
+  return usage() + bytes > (lSoftLimit > 0 ? lSoftLimit : lLimit / 10 * 9);
+}
+
+void PiiMemoryBudget::resetStatistics()
+{
+#ifdef PII_CXX11
+  d->lPeakUsage.store(d->lUsage.load());
+#else
+  {
+    QMutexLocker lock(&d->counterMutex);
+    d->lPeakUsage = d->lUsage;
+  }
+#endif
+  d->iRejections.store(0);
+}
+
+#ifdef PII_CXX11
+void PiiMemoryBudget::setLimit(qint64 limit) { d->lLimit.store(qMax(limit, qint64(0))); }
+qint64 PiiMemoryBudget::limit() const { return d->lLimit.load(); }
+void PiiMemoryBudget::setSoftLimit(qint64 softLimit) { d->lSoftLimit.store(qMax(softLimit, qint64(0))); }
+qint64 PiiMemoryBudget::softLimit() const { return d->lSoftLimit.load(); }
+qint64 PiiMemoryBudget::usage() const { return d->lUsage.load(); }
+qint64 PiiMemoryBudget::peakUsage() const { return d->lPeakUsage.load(); }
+#else
+void PiiMemoryBudget::setLimit(qint64 limit) { QMutexLocker lock(&d->counterMutex); d->lLimit = qMax(limit, qint64(0)); }
+qint64 PiiMemoryBudget::limit() const { QMutexLocker lock(&d->counterMutex); return d->lLimit; }
+void PiiMemoryBudget::setSoftLimit(qint64 softLimit) { QMutexLocker lock(&d->counterMutex); d->lSoftLimit = qMax(softLimit, qint64(0)); }
+qint64 PiiMemoryBudget::softLimit() const { QMutexLocker lock(&d->counterMutex); return d->lSoftLimit; }
+qint64 PiiMemoryBudget::usage() const { QMutexLocker lock(&d->counterMutex); return d->lUsage; }
+qint64 PiiMemoryBudget::peakUsage() const { QMutexLocker lock(&d->counterMutex); return d->lPeakUsage; }
+#endif
+int PiiMemoryBudget::rejectionCount() const { return d->iRejections.load(); }
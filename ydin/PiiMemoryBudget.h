@@ -0,0 +1,160 @@
+/* This file is part of Into.
+ * Copyright (C) Intopii 2013.
+ * All rights reserved.
+ *
+ * Licensees holding a commercial Into license may use this file in
+ * accordance with the commercial license agreement. Please see
+ * LICENSE.commercial for commercial licensing terms.
+ *
+ * Alternatively, this file may be used under the terms of the GNU
+ * Affero General Public License version 3 as published by the Free
+ * Software Foundation. In addition, Intopii gives you special rights
+ * to use Into as a part of open source software projects. Please
+ * refer to LICENSE.AGPL3 for details.
+ */
+
+#ifndef _PIIMEMORYBUDGET_H
+#define _PIIMEMORYBUDGET_H
+
+#include "PiiYdin.h"
+
+class PiiAbstractInputSocket;
+
+/**
+ * A limit for the memory held by the objects in an engine. Without a
+ * budget, the peak memory consumption of an engine is roughly the
+ * sum of all input queue capacities times the object size, plus the
+ * contents of caches. Short bursts may thus use much more memory than
+ * the steady state. A memory budget bounds the total, regardless of
+ * how the memory is distributed.
+ *
+ * Holders of objects report their live bytes to the budget. The
+ * budget itself allocates nothing; it only keeps count and tells the
+ * holders when to back off:
+ *
+ * - Input queues (PiiInputSocket) reserve the memory of each queued
+ * object as measured by PiiVariant::memoryUsage() and release it
+ * once the object has been shifted out of the queue. If the
+ * reservation would exceed [limit()], the object is treated as if the
+ * queue was full: with PiiInputSocket::BlockWhenFull, the sender
+ * waits until memory is released anywhere in the engine. Other
+ * overload policies drop the object. An empty queue and control
+ * objects are always accepted, so every operation can make progress.
+ *
+ * - Caches such as PiiCacheOperation report the memory of their
+ * entries and evict entries while the budget [is under
+ * pressure](isUnderPressure()).
+ *
+ * ~~~(c++)
+ * PiiMemoryBudget budget(6LL*1024*1024*1024);
+ * engine.setMemoryBudget(&budget);
+ * engine.execute();
+ * // ...
+ * qDebug("%lld bytes at peak", budget.peakUsage());
+ * ~~~
+ *
+ * Shared data is counted once for each holder. An image sent to two
+ * inputs thus counts twice, which overestimates the real usage. All
+ * functions are thread-safe.
+ */
+class PII_YDIN_EXPORT PiiMemoryBudget
+{
+public:
+  /**
+   * Creates a budget with the given limit in bytes. Zero means no
+   * limit, in which case the budget only keeps count.
+   */
+  PiiMemoryBudget(qint64 limit = 0);
+  ~PiiMemoryBudget();
+
+  /**
+   * Sets the maximum number of bytes the holders may reserve. Zero
+   * means no limit. Lowering the limit does not release anything but
+   * makes new reservations fail until enough memory has been
+   * released.
+   */
+  void setLimit(qint64 limit);
+  qint64 limit() const;
+
+  /**
+   * Sets the soft limit. Once [usage()] exceeds the soft limit, the
+   * budget [is under pressure](isUnderPressure()), and caches start
+   * evicting entries to leave room for the queues. Zero (the default)
+   * sets the soft limit to 90% of [limit()].
+   */
+  void setSoftLimit(qint64 softLimit);
+  qint64 softLimit() const;
+
+  /**
+   * Reserves *bytes* if the reservation does not exceed [limit()].
+   *
+   * @return `true` if the memory was reserved, `false` otherwise
+   */
+  bool tryAcquire(qint64 bytes);
+
+  /**
+   * Reserves *bytes* like [tryAcquire()]. If the reservation fails,
+   * *waiter* will be registered and its listener will be notified
+   * with PiiInputListener::inputReady() when memory is released. The
+   * registration and the retry are ordered so that a release cannot
+   * go unnoticed. An input socket must call [removeWaiter()] before
+   * it is destroyed.
+   */
+  bool tryAcquire(qint64 bytes, PiiAbstractInputSocket* waiter);
+
+  /**
+   * Reserves *bytes* even if the reservation exceeds [limit()]. Used
+   * for objects that cannot be refused.
+   */
+  void acquire(qint64 bytes);
+
+  /**
+   * Releases *bytes* reserved earlier and wakes up the waiters, if
+   * any.
+   */
+  void release(qint64 bytes);
+
+  /**
+   * Removes *waiter* from the list of inputs to be notified.
+   */
+  void removeWaiter(PiiAbstractInputSocket* waiter);
+
+  /**
+   * Returns the number of bytes currently reserved.
+   */
+  qint64 usage() const;
+
+  /**
+   * Returns the largest value [usage()] has had since construction or
+   * the last call to [resetStatistics()].
+   */
+  qint64 peakUsage() const;
+
+  /**
+   * Returns the number of failed reservations.
+   */
+  int rejectionCount() const;
+
+  /**
+   * Returns `true` if [usage()] + *bytes* exceeds the [soft
+   * limit](softLimit()). Always returns `false` if there is no limit.
+   */
+  bool isUnderPressure(qint64 bytes = 0) const;
+
+  /**
+   * Sets [peakUsage()] to the current usage and clears
+   * [rejectionCount()].
+   */
+  void resetStatistics();
+
+private:
+  class Data;
+  Data* d;
+
+  bool reserve(qint64 bytes);
+  void wakeWaiters();
+
+  PII_DISABLE_COPY(PiiMemoryBudget);
+};
+
+#endif //_PIIMEMORYBUDGET_H
@@ -14,8 +14,10 @@
  */
 
 #include "PiiMultiThreadedProcessor.h"
+#include "PiiTracer.h"
 
 #include <PiiTimer.h>
+#include <PiiThreadPool.h>
 
 class PiiMultiProcessorThread : public QThread
 {
@@ -24,7 +26,8 @@ public:
     _pProcessor(processor),
     _threadId(0),
     _iGroupId(0),
-    _bFreeRun(false)
+    _bFreeRun(false),
+    _bRetiring(false)
   {}
 
   void process(int groupId)
@@ -40,6 +43,15 @@ public:
     _processCondition.wakeOne();
   }
 
+  // Stops a surplus thread in adaptive mode.
+  void retire()
+  {
+    _bRetiring = true;
+    stop();
+  }
+
+  bool isRetiring() const { return _bRetiring; }
+
   void start(Priority priority, bool freeRun = false)
   {
     QMutexLocker lock(&_startMutex);
@@ -61,6 +73,7 @@ protected:
         _threadId = QThread::currentThreadId();
         _threadStartedCondition.wakeOne();
       }
+    _pProcessor->_pParentOp->applyThreadPlacement();
     QMutex* pThreadMutex = &_pProcessor->_threadMutex;
     try
       {
@@ -79,7 +92,10 @@ protected:
             long iWaitTime = 0, iProcessTime = 0, iEndEmitTime = 0, iUnassignTime = 0;
             forever
               {
-                _processCondition.wait();
+                {
+                  PiiTracer::Scope scope("wait", _pProcessor->_pParentOp);
+                  _processCondition.wait();
+                }
                 iWaitTime += tmr.restart();
 
                 // Each wake consumes one process round. Stop()
@@ -120,16 +136,74 @@ private:
   Qt::HANDLE _threadId;
   int _iGroupId;
   bool _bFreeRun;
+  bool _bRetiring;
   QAtomicInt _iProcessCounter;
 };
 
+/* A processing round executed in a shared thread pool. The address
+ * of the round object is used as a thread id in input and output
+ * sockets. A round is reused only after its previous run has
+ * finished, which makes the id unique among concurrent rounds.
+ */
+class PiiMultiProcessorRound : public PiiThreadPool::Task
+{
+public:
+  PiiMultiProcessorRound(PiiMultiThreadedProcessor* processor) :
+    _pProcessor(processor),
+    _iGroupId(0)
+  {}
+
+  Qt::HANDLE id() const { return (Qt::HANDLE)this; }
+
+  int group() const { return _iGroupId; }
+  void setGroup(int groupId) { _iGroupId = groupId; }
+
+  void run()
+  {
+    PiiYdin::setActiveThreadId(id());
+    PiiMultiThreadedProcessor* pProcessor = _pProcessor;
+    try
+      {
+        // No startEmit() here; emission turns are assigned in tryToReceive()
+        pProcessor->process(); // may throw
+        pProcessor->endEmit(id()); // may throw
+      }
+    catch (PiiExecutionException& ex)
+      {
+        pProcessor->roundFailed(ex);
+      }
+    bool bLastRound = false;
+    synchronized (pProcessor->_threadMutex)
+      {
+        pProcessor->unassignInputs(_iGroupId, id());
+        bLastRound = pProcessor->roundFinished(this);
+      }
+    // The round may be reused or deleted from now on. The state
+    // mutex cannot be locked while holding _threadMutex because
+    // interrupt() locks them in the opposite order.
+    if (bLastRound)
+      pProcessor->stopIfInterrupted();
+    PiiYdin::setActiveThreadId(0);
+    --pProcessor->_iRunningRounds;
+  }
+
+private:
+  PiiMultiThreadedProcessor* _pProcessor;
+  int _iGroupId;
+};
+
 PiiMultiThreadedProcessor::PiiMultiThreadedProcessor(PiiDefaultOperation* parent) :
   PiiOperationProcessor(parent),
   _bReset(false), _bBlocked(false),
   _pStateMutex(&(parent->_d()->stateMutex)),
   _priority(QThread::InheritPriority),
+  _iRetiringThreads(0),
+  _pThreadPool(0),
   _bSingleInputGroup(false),
-  _iSingleInputGroupId(0)
+  _iSingleInputGroupId(0),
+  _iLastAdaptTime(0), _iLastBusyTime(0),
+  _dQueueFillSum(0),
+  _iQueueFillSamples(0)
 {
 }
 
@@ -137,6 +211,23 @@ PiiMultiThreadedProcessor::~PiiMultiThreadedProcessor()
 {
   QMutexLocker lock(&_threadMutex);
   destroyAllThreads();
+  // Finished rounds may still be returning from run().
+  while (_iRunningRounds.loadAcquire() != 0)
+    QThread::yieldCurrentThread();
+  qDeleteAll(_lstAllRounds);
+}
+
+// Blocking a pool worker makes the pool start a spare one.
+void PiiMultiThreadedProcessor::beginBlocking()
+{
+  if (_pThreadPool != 0)
+    _pThreadPool->beginBlocking();
+}
+
+void PiiMultiThreadedProcessor::endBlocking()
+{
+  if (_pThreadPool != 0)
+    _pThreadPool->endBlocking();
 }
 
 // _threadMutex must be held when calling this function
@@ -163,7 +254,12 @@ void PiiMultiThreadedProcessor::endEmit(Qt::HANDLE threadId)
   // Retry emission to the outputs that haven't finished yet.
   while (!bAllCompleted && _bReset)
     {
-      _freeInputCondition.wait();
+      beginBlocking();
+      {
+        PiiTracer::Scope scope("blocked", _pParentOp);
+        _freeInputCondition.wait();
+      }
+      endBlocking();
       bAllCompleted = true;
 
       for (int i=0; i<iCnt; ++i)
@@ -203,6 +299,8 @@ void PiiMultiThreadedProcessor::unassignInputs(int groupId, Qt::HANDLE threadId)
 // _threadMutex must be held when calling this function
 void PiiMultiThreadedProcessor::threadFinished(PiiMultiProcessorThread* thread)
 {
+  if (thread->isRetiring())
+    --_iRetiringThreads;
   _lstFinishedThreads << thread;
   _lstAllThreads.removeOne(thread);
   _lstFreeThreads.removeOne(thread);
@@ -228,7 +326,14 @@ void PiiMultiThreadedProcessor::threadFinished(PiiMultiProcessorThread* thread)
 // _threadMutex must be held when calling this function
 void PiiMultiThreadedProcessor::processFinished(PiiMultiProcessorThread* thread)
 {
-  _lstFreeThreads << thread;
+  // Retire surplus threads once they become free.
+  if (_lstAllThreads.size() - _iRetiringThreads > activeThreadCount())
+    {
+      ++_iRetiringThreads;
+      thread->retire();
+    }
+  else
+    _lstFreeThreads << thread;
   _freeThreadCondition.wakeOne();
 }
 
@@ -246,28 +351,93 @@ void PiiMultiThreadedProcessor::threadFinished(PiiMultiProcessorThread* thread,
 
 // _threadMutex must be held when calling this function
 PiiMultiProcessorThread* PiiMultiThreadedProcessor::reserveThread()
+{
+  while (_bReset)
+    {
+      // Add new threads until the pool is full
+      if (_lstAllThreads.size() - _iRetiringThreads < activeThreadCount())
+        {
+          reapFinishedThreads();
+          PiiMultiProcessorThread* pThread = new PiiMultiProcessorThread(this);
+          pThread->setObjectName(_pParentOp->objectName());
+          _lstAllThreads << pThread;
+          // If there is no flow controller, let the thread run freely
+          pThread->start(_priority, _pFlowController == 0);
+          return pThread;
+        }
+      else if (!_lstFreeThreads.isEmpty())
+        return _lstFreeThreads.takeFirst();
+
+      {
+        PiiTracer::Scope scope("wait", _pParentOp);
+        _freeThreadCondition.wait(&_threadMutex);
+      }
+      // This may happen if a thread fails. A retiring thread wakes
+      // us up without becoming free.
+      if (_lstFreeThreads.isEmpty() && _pParentOp->state() != PiiOperation::Running)
+        return 0;
+    }
+  return 0;
+}
+
+// _threadMutex must be held when calling this function
+PiiMultiProcessorRound* PiiMultiThreadedProcessor::reserveRound()
 {
   if (!_bReset)
     return 0;
 
-  // Add new threads until the pool is full
-  if (_lstAllThreads.size() < _pParentOp->threadCount())
+  // In adaptive mode, there may be more rounds than allowed to run.
+  while (_lstAllRounds.size() - _lstFreeRounds.size() >= activeThreadCount())
+    {
+      if (!_bReset)
+        return 0;
+      beginBlocking();
+      {
+        PiiTracer::Scope scope("wait", _pParentOp);
+        _freeThreadCondition.wait(&_threadMutex);
+      }
+      endBlocking();
+    }
+  if (_lstFreeRounds.isEmpty())
+    {
+      PiiMultiProcessorRound* pRound = new PiiMultiProcessorRound(this);
+      _lstAllRounds << pRound;
+      return pRound;
+    }
+  return _lstFreeRounds.takeFirst();
+}
+
+// _threadMutex must be held when calling this function. Returns
+// true if no other round is running.
+bool PiiMultiThreadedProcessor::roundFinished(PiiMultiProcessorRound* round)
+{
+  _lstFreeRounds << round;
+  // There may be many waiters: reserveRound() and the functions
+  // that wait for all rounds to finish.
+  _freeThreadCondition.wakeAll();
+  return !hasActiveRounds();
+}
+
+// _threadMutex MUST NOT be held when calling this function
+void PiiMultiThreadedProcessor::roundFailed(const PiiExecutionException& ex)
+{
+  if (ex.code() != PiiExecutionException::Finished)
     {
-      PiiMultiProcessorThread* pThread = new PiiMultiProcessorThread(this);
-      pThread->setObjectName(_pParentOp->objectName());
-      _lstAllThreads << pThread;
-      // If there is no flow controller, let the thread run freely
-      pThread->start(_priority, _pFlowController == 0);
-      return pThread;
+      synchronized (_pStateMutex)
+        {
+          _bReset = false;
+          _pParentOp->setState(PiiOperation::Interrupted);
+        }
+      emit _pParentOp->errorOccured(_pParentOp, ex.message());
     }
-  else if (!_lstFreeThreads.isEmpty())
-    return _lstFreeThreads.takeFirst();
+}
 
-  _freeThreadCondition.wait(&_threadMutex);
-  // This may happen if a thread fails
-  if (_lstFreeThreads.size() == 0)
-    return 0;
-  return _lstFreeThreads.takeFirst();
+// An interrupted processor stops once the last round is done.
+void PiiMultiThreadedProcessor::stopIfInterrupted()
+{
+  synchronized (_pStateMutex)
+    if (_pParentOp->state() == PiiOperation::Interrupted)
+      _pParentOp->setState(PiiOperation::Stopped);
 }
 
 // _threadMutex must be held when calling this function
@@ -281,7 +451,7 @@ void PiiMultiThreadedProcessor::stopAllThreads()
 void PiiMultiThreadedProcessor::startAllThreads()
 {
   // Start all threads
-  for (int i=_pParentOp->threadCount(); i--; )
+  for (int i=activeThreadCount(); i--; )
     {
       PiiMultiProcessorThread* pThread = reserveThread();
       if (pThread == 0)
@@ -301,7 +471,7 @@ void PiiMultiThreadedProcessor::destroyAllThreads()
 bool PiiMultiThreadedProcessor::waitAllThreadsToExit(unsigned long time)
 {
   PiiTimer timer;
-  while (_lstAllThreads.size() > 0)
+  while (_lstAllThreads.size() > 0 || hasActiveRounds())
     {
       _freeThreadCondition.wait(&_threadMutex, qMin((unsigned long)100, time));
       if ((unsigned long)timer.milliseconds() > time)
@@ -322,12 +492,101 @@ bool PiiMultiThreadedProcessor::waitAllThreadsToExit(unsigned long time)
   return true;
 }
 
+// Deletes threads that have retired in adaptive mode.
+// _threadMutex must be held when calling this function
+void PiiMultiThreadedProcessor::reapFinishedThreads()
+{
+  for (ThreadList::iterator i=_lstFinishedThreads.begin(); i!=_lstFinishedThreads.end(); )
+    {
+      if ((*i)->isFinished())
+        {
+          delete *i;
+          i = _lstFinishedThreads.erase(i);
+        }
+      else
+        ++i;
+    }
+}
+
+bool PiiMultiThreadedProcessor::isAdaptive() const
+{
+  const PiiDefaultOperation::Data* d = _pParentOp->_d();
+  return d->iMaxThreadCount > qMax(d->iMinThreadCount, 1);
+}
+
+void PiiMultiThreadedProcessor::initAdaptation()
+{
+  PiiDefaultOperation::Data* d = _pParentOp->_d();
+  if (isAdaptive())
+    d->iActiveThreadCount = qBound(qMax(d->iMinThreadCount, 1), d->iThreadCount, d->iMaxThreadCount);
+  _iLastAdaptTime = PiiTimer::currentTime();
+  _iLastBusyTime = d->processTimes.total();
+  _dQueueFillSum = 0;
+  _iQueueFillSamples = 0;
+}
+
+/* Adjusts the number of workers based on the occupancy of input
+ * queues and the utilization of the workers during the last
+ * observation period. More workers help only if objects are waiting
+ * and the workers are busy processing them; if they are blocked
+ * emitting the results, a new worker would just block as well.
+ *
+ * _threadMutex must be held when calling this function
+ */
+void PiiMultiThreadedProcessor::adaptThreadCount()
+{
+  static const qint64 iAdaptationPeriod = 250000;
+
+  double dQueueFill = 0;
+  for (int i=0; i<_lstConnectedInputs.size(); ++i)
+    {
+      PiiInputSocket* pInput = _lstConnectedInputs.at(i);
+      dQueueFill = qMax(dQueueFill, double(pInput->queueLength()) / qMax(pInput->queueCapacity(), 1));
+    }
+  _dQueueFillSum += dQueueFill;
+  ++_iQueueFillSamples;
+
+  const qint64 iNow = PiiTimer::currentTime();
+  const qint64 iElapsed = iNow - _iLastAdaptTime;
+  if (iElapsed < iAdaptationPeriod)
+    return;
+
+  PiiDefaultOperation::Data* d = _pParentOp->_d();
+  qint64 iBusyTime = d->processTimes.total();
+  // The histogram may have been reset in between.
+  const qint64 iPeriodBusyTime = iBusyTime >= _iLastBusyTime ? iBusyTime - _iLastBusyTime : iBusyTime;
+  const int iActive = d->iActiveThreadCount;
+  const double dUtilization = double(iPeriodBusyTime) / (double(iElapsed) * iActive);
+  const double dMeanQueueFill = _dQueueFillSum / _iQueueFillSamples;
+  _iLastAdaptTime = iNow;
+  _iLastBusyTime = iBusyTime;
+  _dQueueFillSum = 0;
+  _iQueueFillSamples = 0;
+
+  const int iMin = qMax(d->iMinThreadCount, 1), iMax = d->iMaxThreadCount;
+  if (iActive < iMax && dMeanQueueFill > 0.5 && dUtilization > 0.75)
+    d->iActiveThreadCount = iActive + 1;
+  else if (iActive > iMin && dMeanQueueFill < 0.1 &&
+           dUtilization * iActive < 0.75 * (iActive - 1))
+    d->iActiveThreadCount = iActive - 1;
+  // Limits may have been changed while running.
+  else if (iActive > iMax || iActive < iMin)
+    d->iActiveThreadCount = qBound(iMin, iActive, iMax);
+}
+
 // Waits all threads to finish process().
 // _threadMutex must be held when calling this function
 void PiiMultiThreadedProcessor::waitAllThreadsToStop()
 {
-  while (_lstFreeThreads.size() < _lstAllThreads.size())
-    _freeThreadCondition.wait(&_threadMutex);
+  while (_lstFreeThreads.size() < _lstAllThreads.size() || hasActiveRounds())
+    {
+      beginBlocking();
+      {
+        PiiTracer::Scope scope("wait", _pParentOp);
+        _freeThreadCondition.wait(&_threadMutex);
+      }
+      endBlocking();
+    }
 }
 
 // _threadMutex must be held when calling this function
@@ -343,6 +602,9 @@ void PiiMultiThreadedProcessor::finish(Qt::HANDLE callingThreadId, PiiOperation:
     }
   else
     {
+      // Rounds submitted to a thread pool must be done before the
+      // final tags are emitted.
+      waitAllThreadsToStop();
       startEmit(callingThreadId);
       try
         {
@@ -391,10 +653,11 @@ bool PiiMultiThreadedProcessor::tryToReceive(PiiAbstractInputSocket* sender, con
       QMutexLocker lock(&_threadMutex);
 
       PiiInputSocket* pInput = static_cast<PiiInputSocket*>(sender);
-      if (!pInput->canReceive())
+      if (!pInput->tryReceive(object))
         return false;
 
-      pInput->receive(object);
+      if (isAdaptive())
+        adaptThreadCount();
 
       /*PiiInputSocket* pInput = static_cast<PiiInputSocket*>(sender);
       qDebug("%s: %d objects in queue",
@@ -403,7 +666,7 @@ bool PiiMultiThreadedProcessor::tryToReceive(PiiAbstractInputSocket* sender, con
       if (_bBlocked)
         return true;
 
-      Qt::HANDLE callingThreadId = QThread::currentThreadId();
+      Qt::HANDLE callingThreadId = PiiYdin::activeThreadId();
       do
         {
           PiiFlowController::FlowState state;
@@ -442,19 +705,36 @@ bool PiiMultiThreadedProcessor::tryToReceive(PiiAbstractInputSocket* sender, con
           switch (state)
             {
             case PiiFlowController::ProcessableState:
-              {
-                PiiMultiProcessorThread* pThread = reserveThread();
-                iReserveThreadTime += tmr.restart();
-                if (pThread == 0)
-                  PII_THROW(PiiExecutionException, _pParentOp->tr("Could not reserve a thread."));
-                int iGroup = _pFlowController->activeInputGroup();
-                assignInputs(iGroup, pThread->id());
-                iAssignInputsTime += tmr.restart();
-                startEmit(pThread->id());
-                iStartEmitTime += tmr.restart();
-                pThread->process(iGroup); // starts processing in another thread
-                iStartProcessTime += tmr.restart();
-              }
+              // Late objects are discarded before a thread is
+              // reserved. The worker only sees its assigned objects.
+              if (_pParentOp->discardLateObjects(_pFlowController))
+                break;
+              if (_pThreadPool != 0)
+                {
+                  PiiMultiProcessorRound* pRound = reserveRound();
+                  if (pRound == 0)
+                    PII_THROW(PiiExecutionException, _pParentOp->tr("Could not reserve a processing round."));
+                  int iGroup = _pFlowController->activeInputGroup();
+                  pRound->setGroup(iGroup);
+                  assignInputs(iGroup, pRound->id());
+                  startEmit(pRound->id());
+                  ++_iRunningRounds;
+                  _pThreadPool->submit(pRound); // starts processing in a pool thread
+                }
+              else
+                {
+                  PiiMultiProcessorThread* pThread = reserveThread();
+                  iReserveThreadTime += tmr.restart();
+                  if (pThread == 0)
+                    PII_THROW(PiiExecutionException, _pParentOp->tr("Could not reserve a thread."));
+                  int iGroup = _pFlowController->activeInputGroup();
+                  assignInputs(iGroup, pThread->id());
+                  iAssignInputsTime += tmr.restart();
+                  startEmit(pThread->id());
+                  iStartEmitTime += tmr.restart();
+                  pThread->process(iGroup); // starts processing in another thread
+                  iStartProcessTime += tmr.restart();
+                }
             case PiiFlowController::SynchronizedState:
             case PiiFlowController::IncompleteState:
               break;
@@ -543,6 +823,7 @@ void PiiMultiThreadedProcessor::check(bool reset)
       if (pOutput->isConnected())
         {
           _lstConnectedOutputs << pOutput;
+          pOutput->setOrderedEmission(_pParentOp->_d()->bOrderedOutput);
           // Make this the listener for all connected inputs.
           pOutput->setInputListener(this);
         }
@@ -550,6 +831,18 @@ void PiiMultiThreadedProcessor::check(bool reset)
 
   qDeleteAll(_lstFinishedThreads);
   _lstFinishedThreads.clear();
+  _iRetiringThreads = 0;
+  if (reset)
+    initAdaptation();
+
+  // Threads are still needed for free-running producers.
+  _pThreadPool = _pFlowController != 0 ? _pParentOp->_d()->pThreadPool : 0;
+  if (reset)
+    {
+      qDeleteAll(_lstAllRounds);
+      _lstAllRounds.clear();
+      _lstFreeRounds.clear();
+    }
 }
 
 void PiiMultiThreadedProcessor::start()
@@ -594,7 +887,7 @@ void PiiMultiThreadedProcessor::interrupt()
   synchronized (_threadMutex)
     {
       // If there are threads running, kill them immediately.
-      if (_lstAllThreads.size() > 0)
+      if (_lstAllThreads.size() > 0 || hasActiveRounds())
         {
           _pParentOp->setState(PiiOperation::Interrupted);
           // This may leave some dead threads in _lstFinishedThreads.
@@ -682,9 +975,12 @@ int PiiMultiThreadedProcessor::activeInputGroup() const
     return _iSingleInputGroupId;
 
   // Otherwise scan all threads and see which one is calling us.
-  Qt::HANDLE currentThreadId = QThread::currentThreadId();
+  Qt::HANDLE currentThreadId = PiiYdin::activeThreadId();
   synchronized (_threadMutex)
     {
+      for (RoundList::const_iterator i=_lstAllRounds.begin(); i!=_lstAllRounds.end(); ++i)
+        if ((*i)->id() == currentThreadId)
+          return (*i)->group();
       for (ThreadList::const_iterator i=_lstAllThreads.begin(); i!=_lstAllThreads.end(); ++i)
         if ((*i)->id() == currentThreadId)
           return (*i)->group();
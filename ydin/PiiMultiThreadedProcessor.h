@@ -18,12 +18,18 @@
 
 #include "PiiOperationProcessor.h"
 #include "PiiInputListener.h"
+#include <PiiAtomicInt.h>
 
 class PiiMultiProcessorThread;
+class PiiMultiProcessorRound;
+class PiiThreadPool;
 
 /**
  * A processor that creates a user-defined number of threads into a
- * pool and calls process() concurrently from them.
+ * pool and calls process() concurrently from them. If the parent
+ * operation has a [thread pool](PiiDefaultOperation::setThreadPool())
+ * and connected inputs, processing rounds are submitted to the
+ * shared pool instead.
  *
  * @internal
  */
@@ -51,6 +57,7 @@ public:
 
 private:
   friend class PiiMultiProcessorThread;
+  friend class PiiMultiProcessorRound;
 
   void finish(Qt::HANDLE callingThreadId, PiiOperation::State finalState);
 
@@ -62,11 +69,23 @@ private:
   void processFinished(PiiMultiProcessorThread* thread);
   void threadFinished(PiiMultiProcessorThread* thread, const PiiExecutionException& ex);
   PiiMultiProcessorThread* reserveThread();
+  PiiMultiProcessorRound* reserveRound();
+  bool roundFinished(PiiMultiProcessorRound* round);
+  void roundFailed(const PiiExecutionException& ex);
+  void stopIfInterrupted();
+  bool hasActiveRounds() const { return _lstFreeRounds.size() < _lstAllRounds.size(); }
+  void beginBlocking();
+  void endBlocking();
   void startAllThreads();
   void stopAllThreads();
   void destroyAllThreads();
   bool waitAllThreadsToExit(unsigned long time = ULONG_MAX);
   void waitAllThreadsToStop();
+  void reapFinishedThreads();
+  bool isAdaptive() const;
+  void initAdaptation();
+  void adaptThreadCount();
+  int activeThreadCount() const { return _pParentOp->_d()->iActiveThreadCount; }
 
   inline void process() { _pParentOp->processLocked(); }
 
@@ -76,6 +95,11 @@ private:
   QThread::Priority _priority;
   typedef QLinkedList<PiiMultiProcessorThread*> ThreadList;
   ThreadList _lstAllThreads, _lstFinishedThreads, _lstFreeThreads;
+  int _iRetiringThreads;
+  typedef QLinkedList<PiiMultiProcessorRound*> RoundList;
+  RoundList _lstAllRounds, _lstFreeRounds;
+  PiiThreadPool* _pThreadPool;
+  PiiAtomicInt _iRunningRounds;
   QWaitCondition _freeThreadCondition;
   PiiWaitCondition _freeInputCondition;
   QMutex _threadMutex;
@@ -83,6 +107,10 @@ private:
   int _iSingleInputGroupId;
   QList<PiiInputSocket*> _lstConnectedInputs;
   QList<PiiOutputSocket*> _lstConnectedOutputs;
+  // Adaptive thread count
+  qint64 _iLastAdaptTime, _iLastBusyTime;
+  double _dQueueFillSum;
+  int _iQueueFillSamples;
 };
 
 #endif //_PIIMULTITHREADEDPROCESSOR_H
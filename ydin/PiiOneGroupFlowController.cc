@@ -17,7 +17,8 @@
 #include "PiiOutputSocket.h"
 
 PiiOneGroupFlowController::Data::Data(const QList<PiiInputSocket*>& inputs,
-                                      const QList<PiiOutputSocket*>& outputs)
+                                      const QList<PiiOutputSocket*>& outputs) :
+  iReadyInputs(0)
 {
   // Store connected inputs
   for (int i=0; i<inputs.size(); ++i)
@@ -44,12 +45,13 @@ void PiiOneGroupFlowController::shiftInputs()
   PII_D;
   for (int i=0; i<d->vecInputs.size(); ++i)
     d->vecInputs[i]->shift();
+  d->iReadyInputs = 0;
 }
 
 PiiFlowController::FlowState PiiOneGroupFlowController::prepareProcess()
 {
   PII_D;
-  int typeMask = inputGroupTypeMask(d->vecInputs.begin(), d->vecInputs.end());
+  int typeMask = inputGroupTypeMask(d->vecInputs.begin(), d->vecInputs.end(), d->iReadyInputs);
 
   switch (typeMask)
     {
@@ -53,6 +53,8 @@ private:
          const QList<PiiOutputSocket*>& outputs);
     QVector<PiiInputSocket*> vecInputs;
     QVector<PiiOutputSocket*> vecOutputs;
+    // The number of leading inputs known to contain an object.
+    int iReadyInputs;
   };
 
   PII_D_FUNC;
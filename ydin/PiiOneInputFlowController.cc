@@ -47,7 +47,10 @@ PiiFlowController::FlowState PiiOneInputFlowController::prepareProcess()
   else if (isNonControlType(uiType))
     {
       // The input is now free and we are ready to process
-      d->pInput->shift();
+      if (d->iMaxBatchSize > 1)
+        d->pInput->shiftBatch(d->iMaxBatchSize);
+      else
+        d->pInput->shift();
       return ProcessableState;
     }
   else
@@ -18,9 +18,13 @@
 #include <PiiUtil.h>
 #include <PiiSerializationFactory.h>
 #include <PiiSerializableExport.h>
+#include <PiiGenericBinaryInputArchive.h>
+#include <PiiGenericBinaryOutputArchive.h>
 #include "PiiYdinResources.h"
 #include <PiiMath.h>
 
+#include <QBuffer>
+
 PII_DEFINE_VIRTUAL_METAOBJECT_FUNCTION(PiiOperation);
 PII_SERIALIZABLE_EXPORT(PiiOperation);
 PII_SERIALIZABLE_EXPORT(PiiQVariantWrapper::Template<PiiOperation*>);
@@ -511,6 +515,27 @@ PiiOperation* PiiOperation::clone() const
   return op;
 }
 
+QByteArray PiiOperation::checkpoint()
+{
+  QByteArray aState;
+  QBuffer buffer(&aState);
+  buffer.open(QIODevice::WriteOnly);
+  PiiGenericBinaryOutputArchive archive(&buffer);
+  saveCheckpoint(archive);
+  return aState;
+}
+
+void PiiOperation::restoreCheckpoint(const QByteArray& state)
+{
+  QBuffer buffer(const_cast<QByteArray*>(&state));
+  buffer.open(QIODevice::ReadOnly);
+  PiiGenericBinaryInputArchive archive(&buffer);
+  loadCheckpoint(archive);
+}
+
+void PiiOperation::saveCheckpoint(PiiGenericOutputArchive&) {}
+void PiiOperation::loadCheckpoint(PiiGenericInputArchive&) {}
+
 void PiiOperation::disconnectAllInputs()
 {
   QList<PiiAbstractInputSocket*> lstInputs = inputs();
@@ -27,6 +27,8 @@
 #include <QMutex>
 
 class PiiOperationCompound;
+class PiiGenericOutputArchive;
+class PiiGenericInputArchive;
 
 /**
  * Declares a virtual piiMetaObject() function and implements a
@@ -560,6 +562,44 @@ public:
    */
   Q_INVOKABLE virtual PiiOperation* clone() const;
 
+  /**
+   * Takes a snapshot of the running state of the operation, such as
+   * a learnt background model or a history of samples. Properties
+   * are not included; they are saved with the configuration. The
+   * engine does not need to be stopped: PiiDefaultOperation takes the
+   * snapshot between processing rounds, and compounds collect the
+   * snapshots of their child operations. Each operation is
+   * consistent in itself, but different operations may be captured at
+   * slightly different points of the stream.
+   *
+   * The snapshot is stored in a binary archive, which makes
+   * [restoreCheckpoint()] fast enough for hot standby.
+   *
+   * ~~~(c++)
+   * // In the primary process
+   * QByteArray aState = engine.checkpoint();
+   * // In a standby process running the same configuration
+   * standbyEngine.restoreCheckpoint(aState);
+   * ~~~
+   *
+   * @exception PiiSerializationException& if the state cannot be
+   * stored.
+   */
+  Q_INVOKABLE QByteArray checkpoint();
+
+  /**
+   * Restores a state returned by [checkpoint()]. The configuration
+   * must be the same as that of the operation the checkpoint was taken
+   * from. Child operations of compounds are matched by object name,
+   * and checkpoints of missing children are ignored. Since
+   * `check(true)` resets the running state, restore the checkpoint
+   * after the engine has been started.
+   *
+   * @exception PiiSerializationException& if *state* cannot be
+   * decoded.
+   */
+  Q_INVOKABLE void restoreCheckpoint(const QByteArray& state);
+
   /**
    * Disconnects all inputs.
    */
@@ -712,6 +752,19 @@ protected:
    */
   virtual void updateActivityMode(ActivityMode activityMode);
 
+  /**
+   * Writes the running state of the operation to *archive*. Called by
+   * [checkpoint()]. The default implementation does nothing.
+   * PiiDefaultOperation overrides this function to synchronize with
+   * processing; see PiiDefaultOperation::saveState().
+   */
+  virtual void saveCheckpoint(PiiGenericOutputArchive& archive);
+  /**
+   * Reads the running state written by [saveCheckpoint()] from
+   * *archive*. The default implementation does nothing.
+   */
+  virtual void loadCheckpoint(PiiGenericInputArchive& archive);
+
 private:
   int indexOf(const char* property) const;
   static void addPropertyToList(PropertyList& properties,
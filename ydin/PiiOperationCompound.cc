@@ -14,15 +14,19 @@
  */
 
 #include "PiiOperationCompound.h"
+#include "PiiEngine.h"
 
 #include <PiiSerializationFactory.h>
 #include <PiiUtil.h>
 #include <PiiDelay.h>
 #include <QTime>
+#include <QSet>
 #include <QCoreApplication>
 #include <PiiYdinUtil.h>
 #include <PiiYdinResources.h>
 #include <PiiSerializableExport.h>
+#include <PiiGenericInputArchive.h>
+#include <PiiGenericOutputArchive.h>
 
 
 PII_DEFINE_VIRTUAL_METAOBJECT_FUNCTION(PiiOperationCompound);
@@ -182,6 +186,49 @@ void PiiOperationCompound::updateActivityMode(ActivityMode mode)
     setState(Stopped);
 }
 
+void PiiOperationCompound::saveCheckpoint(PiiGenericOutputArchive& archive)
+{
+  QList<PiiOperation*> lstOperations = childOperations();
+  const int iCount = lstOperations.size();
+  archive << iCount;
+  for (int i=0; i<iCount; ++i)
+    {
+      // Nested archives let a restoring compound skip children it
+      // doesn't have.
+      archive << lstOperations[i]->objectName();
+      archive << lstOperations[i]->checkpoint();
+    }
+}
+
+void PiiOperationCompound::loadCheckpoint(PiiGenericInputArchive& archive)
+{
+  QList<PiiOperation*> lstOperations = childOperations();
+  int iCount;
+  archive >> iCount;
+  for (int i=0; i<iCount; ++i)
+    {
+      QString strName;
+      QByteArray aState;
+      archive >> strName;
+      archive >> aState;
+      // Usually the children are in the same order.
+      PiiOperation* pChild = 0;
+      if (i < lstOperations.size() && lstOperations[i]->objectName() == strName)
+        pChild = lstOperations[i];
+      else if (!strName.isEmpty())
+        {
+          for (int j=0; j<lstOperations.size(); ++j)
+            if (lstOperations[j]->objectName() == strName)
+              {
+                pChild = lstOperations[j];
+                break;
+              }
+        }
+      if (pChild != 0)
+        pChild->restoreCheckpoint(aState);
+    }
+}
+
 void PiiOperationCompound::start()
 {
   PII_D;
@@ -784,7 +831,7 @@ bool PiiOperationCompound::replaceOperation(PiiOperation *oldOp, PiiOperation* n
           lstOldOutputs[i]->disconnectInputs();
 
           PiiAbstractOutputSocket* pOutput = newOp->output(lstOldOutputs[i]->objectName());
-          if (pOutput != 0 && i < lstNewOutputs.size())
+          if (pOutput == 0 && i < lstNewOutputs.size())
             pOutput = lstNewOutputs[i];
           if (pOutput != 0)
             for (int j=0; j<lstInputs.size(); ++j)
@@ -945,6 +992,202 @@ void PiiOperationCompound::reconfigure(const QString& name)
   commandChildren(std::bind2nd(Reconfigure(), name));
 }
 
+void PiiOperationCompound::applyConfiguration(PiiOperationCompound* configuration, const QString& propertySetName)
+{
+  if (configuration == 0 || configuration == this)
+    return;
+  if (!canUpdateFrom(configuration))
+    PII_THROW(PiiExecutionException, tr("The configuration cannot be applied incrementally because its class or exposed sockets differ."));
+  if (state() != Stopped && updateFrom(configuration, false))
+    PII_THROW(PiiExecutionException, tr("The structure of the configuration differs. Stop the compound before applying it."));
+
+  // Values from an earlier update have been applied by now.
+  removePropertySet(propertySetName);
+  startPropertySet(propertySetName);
+  try
+    {
+      updateFrom(configuration, true);
+    }
+  catch (...)
+    {
+      endPropertySet();
+      removePropertySet(propertySetName);
+      throw;
+    }
+  endPropertySet();
+  reconfigure(propertySetName);
+  // A running operation applies the set when the reconfiguration
+  // tag reaches it.
+  if (state() == Stopped)
+    removePropertySet(propertySetName);
+}
+
+bool PiiOperationCompound::canUpdateFrom(const PiiOperationCompound* configuration) const
+{
+  return qstrcmp(PiiYdin::resourceName(this), PiiYdin::resourceName(configuration)) == 0 &&
+    inputNames().toSet() == configuration->inputNames().toSet() &&
+    outputNames().toSet() == configuration->outputNames().toSet();
+}
+
+bool PiiOperationCompound::updateFrom(PiiOperationCompound* configuration, bool apply)
+{
+  PII_D;
+  // Pair child operations with the same name and class.
+  QList<QPair<PiiOperation*,PiiOperation*> > lstMatched;
+  QList<PiiOperation*> lstAdded, lstRemoved;
+  QSet<PiiOperation*> setKept;
+  QList<PiiOperation*> lstNewOperations(configuration->childOperations());
+  for (int i=0; i<lstNewOperations.size(); ++i)
+    {
+      PiiOperation* pNew = lstNewOperations[i];
+      PiiOperation* pOld = findChildOperation(pNew->objectName());
+      if (pOld != 0 &&
+          qstrcmp(pOld->metaObject()->className(), pNew->metaObject()->className()) == 0 &&
+          qstrcmp(PiiYdin::resourceName(pOld), PiiYdin::resourceName(pNew)) == 0 &&
+          (!pOld->isCompound() ||
+           static_cast<PiiOperationCompound*>(pOld)->canUpdateFrom(static_cast<PiiOperationCompound*>(pNew))))
+        {
+          lstMatched << qMakePair(pOld, pNew);
+          setKept << pOld;
+        }
+      else
+        lstAdded << pNew;
+    }
+  for (int i=0; i<d->lstOperations.size(); ++i)
+    if (!setKept.contains(d->lstOperations[i]))
+      lstRemoved << d->lstOperations[i];
+
+  QSet<ConnectionType> setNewConnections(configuration->connectionList().toSet());
+
+  if (!apply)
+    {
+      if (!lstAdded.isEmpty() || !lstRemoved.isEmpty() ||
+          connectionList().toSet() != setNewConnections)
+        return true;
+      for (int i=0; i<lstMatched.size(); ++i)
+        if (lstMatched[i].first->isCompound() &&
+            static_cast<PiiOperationCompound*>(lstMatched[i].first)->
+            updateFrom(static_cast<PiiOperationCompound*>(lstMatched[i].second), false))
+          return true;
+      return false;
+    }
+
+  // Aliases must be located before operations are moved.
+  QStringList lstInputAliases, lstOutputAliases;
+  for (int i=0; i<configuration->_d()->lstInputs.size(); ++i)
+    if (!configuration->_d()->lstInputs[i]->isProxy())
+      lstInputAliases << locateSocket(configuration->_d()->lstInputs[i], configuration).second;
+  for (int i=0; i<configuration->_d()->lstOutputs.size(); ++i)
+    if (!configuration->_d()->lstOutputs[i]->isProxy())
+      lstOutputAliases << locateSocket(configuration->_d()->lstOutputs[i], configuration).second;
+
+  for (int i=0; i<lstRemoved.size(); ++i)
+    {
+      removeOperation(lstRemoved[i]);
+      delete lstRemoved[i];
+    }
+  for (int i=0; i<lstAdded.size(); ++i)
+    {
+      // Also breaks connections to the operations left in configuration.
+      configuration->removeOperation(lstAdded[i]);
+      addOperation(lstAdded[i]);
+    }
+
+  for (int i=0; i<lstMatched.size(); ++i)
+    {
+      if (lstMatched[i].first->isCompound())
+        static_cast<PiiOperationCompound*>(lstMatched[i].first)->
+          updateFrom(static_cast<PiiOperationCompound*>(lstMatched[i].second), true);
+      else
+        updateProperties(lstMatched[i].first, lstMatched[i].second);
+    }
+
+  // Restore aliases to sockets of replaced operations.
+  QStringList lstInputNames(inputNames()), lstOutputNames(outputNames());
+  for (int i=0; i<lstInputAliases.size(); ++i)
+    if (!lstInputNames.contains(lstInputAliases[i].mid(lstInputAliases[i].lastIndexOf('.') + 1)))
+      exposeInput(lstInputAliases[i]);
+  for (int i=0; i<lstOutputAliases.size(); ++i)
+    if (!lstOutputNames.contains(lstOutputAliases[i].mid(lstOutputAliases[i].lastIndexOf('.') + 1)))
+      exposeOutput(lstOutputAliases[i]);
+
+  QSet<ConnectionType> setOldConnections(connectionList().toSet());
+  foreach (const ConnectionType& connection, setOldConnections - setNewConnections)
+    {
+      PiiAbstractOutputSocket* pSource = connectionSource(connection.first);
+      PiiAbstractInputSocket* pTarget = input(connection.second);
+      if (pSource != 0 && pTarget != 0)
+        pSource->disconnectInput(pTarget);
+    }
+  foreach (const ConnectionType& connection, setNewConnections - setOldConnections)
+    {
+      PiiAbstractOutputSocket* pSource = connectionSource(connection.first);
+      PiiAbstractInputSocket* pTarget = input(connection.second);
+      if (pSource != 0 && pTarget != 0)
+        pSource->connectInput(pTarget);
+    }
+  return true;
+}
+
+/* Lists internal connections as (source, target) name pairs. Sources
+   are either "child.output" or the name of an input proxy. Targets
+   are named as in serialization (see buildEndPointList()).
+*/
+PiiOperationCompound::ConnectionListType PiiOperationCompound::connectionList() const
+{
+  const PII_D;
+  ConnectionListType lstConnections;
+  for (int i=0; i<d->lstOperations.size(); ++i)
+    {
+      QList<PiiAbstractOutputSocket*> lstOutputs = d->lstOperations[i]->outputs();
+      for (int j=0; j<lstOutputs.size(); ++j)
+        {
+          QString strSource(d->lstOperations[i]->objectName() + '.' + lstOutputs[j]->objectName());
+          EndPointListType lstTargets = buildEndPointList(lstOutputs[j], this);
+          for (int k=0; k<lstTargets.size(); ++k)
+            lstConnections << ConnectionType(strSource, lstTargets[k].second);
+        }
+    }
+  for (int i=0; i<d->lstInputs.size(); ++i)
+    {
+      if (d->lstInputs[i]->isProxy())
+        {
+          EndPointListType lstTargets = buildEndPointList(PiiProxySocket::output(d->lstInputs[i]), this);
+          for (int k=0; k<lstTargets.size(); ++k)
+            lstConnections << ConnectionType(d->lstInputs[i]->objectName(), lstTargets[k].second);
+        }
+    }
+  return lstConnections;
+}
+
+PiiAbstractOutputSocket* PiiOperationCompound::connectionSource(const QString& name) const
+{
+  const PII_D;
+  int iDotIndex = name.indexOf('.');
+  if (iDotIndex != -1)
+    {
+      PiiOperation* pChild = findChildOperation(name.left(iDotIndex));
+      return pChild != 0 ? pChild->output(name.mid(iDotIndex + 1)) : 0;
+    }
+  for (int i=0; i<d->lstInputs.size(); ++i)
+    if (d->lstInputs[i]->isProxy() && d->lstInputs[i]->objectName() == name)
+      return PiiProxySocket::output(d->lstInputs[i]);
+  return 0;
+}
+
+void PiiOperationCompound::updateProperties(PiiOperation* target, PiiOperation* source)
+{
+  QList<QPair<QString,QVariant> > lstProperties(Pii::propertyList(source, 0,
+                                                                  Pii::WritableProperties |
+                                                                  Pii::DynamicProperties));
+  for (int i=0; i<lstProperties.size(); ++i)
+    {
+      const QString& strName = lstProperties[i].first;
+      if (strName != "objectName" && target->property(strName) != lstProperties[i].second)
+        target->setProperty(strName, lstProperties[i].second);
+    }
+}
+
 bool PiiOperationCompound::setProperty(const char* name, const QVariant& value)
 {
   return find(SetPropertyFinder(this, value), name);
@@ -1026,6 +1269,19 @@ PiiOperation::State PiiOperationCompound::state() const
 PiiOperation* PiiOperationCompound::createOperation(const QString& className, const QString& objectName)
 {
   PiiOperation* op = PiiYdin::createResource<PiiOperation>(qPrintable(className));
+  // Load the plug-in on demand if it is listed in the plug-in index.
+  if (op == 0)
+    {
+      try
+        {
+          if (PiiEngine::loadPluginFor(className))
+            op = PiiYdin::createResource<PiiOperation>(qPrintable(className));
+        }
+      catch (PiiLoadException& ex)
+        {
+          piiWarning(ex.message());
+        }
+    }
 
   // We got the pointer -> set objectName and add to operation list
   if (op != 0)
@@ -586,7 +586,9 @@ public:
   /**
    * A convenience function that creates an instance of the named
    * class and adds it as a child to this compound. If the operation
-   * cannot be created, 0 will be returned.
+   * cannot be created, 0 will be returned. If the class is not
+   * registered but listed in the plug-in index, the plug-in will be
+   * loaded first (see PiiEngine::loadPluginIndex()).
    *
    * @param className the name of the operation to create.
    *
@@ -624,6 +626,41 @@ public:
    */
   void reconfigure(const QString& propertySetName = QString());
 
+  /**
+   * Makes this compound match *configuration* by changing only what
+   * differs between them. This makes it possible to switch to a new
+   * saved configuration without recreating the operations that did
+   * not change, which retain their internal state.
+   *
+   * Child operations are matched by their `objectName` and class.
+   * Matching compounds are updated recursively. Operations that exist
+   * only in this compound are deleted. Operations that exist only in
+   * *configuration* are moved from *configuration* to this compound.
+   * Connections between child operations are compared by socket
+   * names, and only the ones that differ are changed. Properties
+   * whose values differ are collected into the property set
+   * *propertySetName* and applied with [reconfigure()], so that they
+   * take effect simultaneously with respect to the processed data.
+   * Properties of the compounds themselves are not changed.
+   *
+   * Structural changes (adding or removing operations or connections)
+   * are only possible when the compound is stopped. If the compound
+   * is running and only property values differ, the new values
+   * will be applied without interrupting processing.
+   *
+   * ~~~(c++)
+   * PiiEngine* pNewEngine = PiiEngine::load("changeover.cft");
+   * engine.applyConfiguration(pNewEngine);
+   * delete pNewEngine;
+   * ~~~
+   *
+   * @exception PiiExecutionException& if structural changes are needed
+   * but the compound is not stopped, or if the exposed sockets of
+   * this compound differ from those of *configuration*. In either
+   * case, this compound is not changed.
+   */
+  void applyConfiguration(PiiOperationCompound* configuration, const QString& propertySetName = QString());
+
   /**
    * Sets a property in this compound. This function supports the "dot
    * syntax" for setting properties. If the compound has a child
@@ -731,6 +768,13 @@ protected:
 
   void updateActivityMode(ActivityMode mode);
 
+  /**
+   * Stores the checkpoints of all child operations, keyed by their
+   * object names.
+   */
+  void saveCheckpoint(PiiGenericOutputArchive& archive);
+  void loadCheckpoint(PiiGenericInputArchive& archive);
+
 private slots:
   void updateChildStates(PiiOperation::State state);
   void childDestroyed(QObject* op);
@@ -772,6 +816,15 @@ private:
   bool checkSteadyStateChange(State newState, State intermediateState, State steadyState);
   bool checkChildStates(State state);
 
+  // Incremental reconfiguration
+  typedef QPair<QString, QString> ConnectionType;
+  typedef QList<ConnectionType> ConnectionListType;
+  bool canUpdateFrom(const PiiOperationCompound* configuration) const;
+  bool updateFrom(PiiOperationCompound* configuration, bool apply);
+  ConnectionListType connectionList() const;
+  PiiAbstractOutputSocket* connectionSource(const QString& name) const;
+  static void updateProperties(PiiOperation* target, PiiOperation* source);
+
   // Serialization stuff
   typedef QPair<PiiOperation*, QString> EndPointType;
   typedef QList<EndPointType> EndPointListType;
@@ -15,11 +15,14 @@
 
 #include "PiiOutputSocket.h"
 #include "PiiInputSocket.h"
+#include "PiiProxySocket.h"
 #include "PiiYdinTypes.h"
 #include "PiiOperation.h"
+#include "PiiTracer.h"
 
 #include <PiiUtil.h>
 #include <PiiSerializableExport.h> // MSVC
+#include <PiiTimer.h>
 
 #include <QThread>
 
@@ -31,9 +34,14 @@ PiiOutputSocket::Data::Data() :
   freeInputCondition(PiiWaitCondition::NoQueue),
   pFirstInput(0),
   pFirstController(0),
+  pInputListener(0),
   bInterrupted(false),
   pbInputCompleted(0),
-  activeThreadId(0)
+  uiFirstTurn(0),
+  iTurnCount(0),
+  bOrderedEmission(true),
+  pRecording(0),
+  iRecordingIndex(0)
 {}
 
 PiiOutputSocket::Data::~Data()
@@ -44,33 +52,57 @@ PiiOutputSocket::Data::~Data()
 
 bool PiiOutputSocket::Data::setOutputConnected(bool connected)
 {
+  // Called on the root output whenever a connection changes anywhere
+  // in the proxy chains that start from it.
+  flattenInputs();
   return bConnected = PiiAbstractOutputSocket::Data::setOutputConnected(connected);
 }
 
 void PiiOutputSocket::Data::inputUpdated(PiiAbstractInputSocket*)
 {
-  if (lstInputs.size() > 0)
-    pFirstController = lstInputs.controllerAt(0);
+  flattenInputs();
 }
 
-void PiiOutputSocket::Data::inputConnected(PiiAbstractInputSocket* input)
+void PiiOutputSocket::Data::inputConnected(PiiAbstractInputSocket*)
 {
-  input->setListener(this);
-  // Run-time optimization
-  if (lstInputs.size() == 1)
-    {
-      pFirstInput = input;
-      pFirstController = input->controller();
-    }
-  createFlagArray();
+  flattenInputs();
 }
 
 void PiiOutputSocket::Data::inputDisconnected(PiiAbstractInputSocket*)
 {
-  if (lstInputs.size() > 0)
+  flattenInputs();
+}
+
+void PiiOutputSocket::Data::flattenInputs()
+{
+  // Bypass proxies: bind this output directly to the inputs at the
+  // ends of the chains. The proxies stay connected for introspection.
+  InputList lstOldInputs(lstFlatInputs);
+  lstFlatInputs.clear();
+  PiiInputListener* pListener = pInputListener != 0 ? pInputListener : this;
+  for (int i=0; i<lstInputs.size(); ++i)
     {
-      pFirstInput = lstInputs.inputAt(0);
-      pFirstController = lstInputs.controllerAt(0);
+      QList<PiiAbstractInputSocket*> lstTargets = PiiProxySocket::connectedInputs(lstInputs.inputAt(i));
+      for (int j=0; j<lstTargets.size(); ++j)
+        {
+          lstTargets[j]->setListener(pListener);
+          lstFlatInputs.append(lstTargets[j]);
+        }
+    }
+  // Inputs behind a detached proxy must not keep pointing to this
+  // output, which may be deleted before them.
+  for (int i=0; i<lstOldInputs.size(); ++i)
+    {
+      PiiAbstractInputSocket* pInput = lstOldInputs.inputAt(i);
+      if (lstFlatInputs.indexOf(pInput) == -1 && pInput->listener() == pListener)
+        pInput->setListener(0);
+    }
+
+  // Run-time optimization
+  if (lstFlatInputs.size() > 0)
+    {
+      pFirstInput = lstFlatInputs.inputAt(0);
+      pFirstController = lstFlatInputs.controllerAt(0);
     }
   else
     {
@@ -82,12 +114,11 @@ void PiiOutputSocket::Data::inputDisconnected(PiiAbstractInputSocket*)
 
 void PiiOutputSocket::Data::createFlagArray()
 {
-  //qDebug("PiiOutputSocket: creating flag array for %d connections.", d->lstInputs.size());
   delete[] pbInputCompleted;
-  if (lstInputs.size() > 0)
+  if (lstFlatInputs.size() > 0)
     {
-      pbInputCompleted = new bool[lstInputs.size()];
-      Pii::fillN(pbInputCompleted, lstInputs.size(), false);
+      pbInputCompleted = new bool[lstFlatInputs.size()];
+      Pii::fillN(pbInputCompleted, lstFlatInputs.size(), false);
     }
   else
     pbInputCompleted = 0;
@@ -128,75 +159,86 @@ void PiiOutputSocket::reset()
   d->bInterrupted = false;
   d->freeInputCondition.wakeAll();
   d->lstBuffer.clear();
-  d->activeThreadId = 0;
+  d->iBufferedObjects.store(0);
+  d->vecTurns.clear();
+  d->uiFirstTurn = 0;
+  d->iTurnCount = 0;
+  d->hashTurns.clear();
+}
+
+bool PiiOutputSocket::flushObjects(OutputBuffer& objects, const PiiLatencyTag& tag)
+{
+  // Objects may be flushed by a thread other than the emitter.
+  PiiLatencyTag::Scope tagScope(tag);
+  while (!objects.isEmpty())
+    {
+      if (!tryEmit(objects.first()))
+        return false;
+      objects.removeFirst();
+      --_d()->iBufferedObjects;
+    }
+  return true;
 }
 
 bool PiiOutputSocket::flushBuffer()
 {
   PII_D;
 
-  while (!d->lstThreads.isEmpty())
+  while (d->iTurnCount > 0)
     {
       // Flush every object belonging to the thread that currently has
       // emission turn.
-      Qt::HANDLE activeThreadId = d->lstThreads[0].id;
-      for (OutputBuffer::iterator i=d->lstBuffer.begin(); i!=d->lstBuffer.end(); )
-        {
-          if (i->first == activeThreadId)
-            {
-              if (!tryEmit(i->second))
-                return false;
-              i = d->lstBuffer.erase(i);
-            }
-          else
-            ++i;
-        }
-      // If this thread is already done, we can safely remove it.
-      if (d->lstThreads[0].bFinished)
-        {
-          d->lstThreads.remove(0);
-          d->endEmitCondition.wakeAll();
-        }
+      PiiOutputSocket::EmissionTurn& firstTurn = d->turn(d->uiFirstTurn);
+      if (!flushObjects(firstTurn.lstObjects, firstTurn.tag))
+        return false;
       // Otherwise stop flushing.
-      else
+      if (!firstTurn.bFinished)
         return true;
+      // If this thread is already done, we can safely release its turn.
+      ++d->uiFirstTurn;
+      --d->iTurnCount;
     }
-  // If the last thread was removed from emission queue and there are
-  // still buffered objects, flush everything.
-  if (d->lstThreads.isEmpty() && !d->lstBuffer.isEmpty())
-    {
-      for (OutputBuffer::iterator i=d->lstBuffer.begin(); i!=d->lstBuffer.end(); )
-        {
-          if (!tryEmit(i->second))
-            return false;
-          i = d->lstBuffer.erase(i);
-        }
-    }
-  return true;
+  // If the last turn was released and there are still buffered
+  // objects, flush everything.
+  return flushObjects(d->lstBuffer);
 }
 
 void PiiOutputSocket::emitThreaded(const PiiVariant& object)
 {
   PII_D;
   QMutexLocker lock(&d->emitLock);
-  d->lstBuffer.append(qMakePair(QThread::currentThreadId(), object));
+  d->threadBuffer().append(object);
+  d->queueDepths.add(++d->iBufferedObjects);
 }
 
-int PiiOutputSocket::Data::queueIndex(Qt::HANDLE threadId) const
+#ifdef PII_CXX11
+void PiiOutputSocket::emitThreaded(PiiVariant&& object)
 {
-  for (int i=0; i<lstThreads.size(); ++i)
-    if (lstThreads[i].id == threadId)
-      return i;
-  return -1;
+  PII_D;
+  QMutexLocker lock(&d->emitLock);
+  OutputBuffer& buffer = d->threadBuffer();
+  // QList cannot append an rvalue. Moving into an invalid variant
+  // costs no reference counting.
+  buffer.append(PiiVariant());
+  buffer.last() = std::move(object);
+  d->queueDepths.add(++d->iBufferedObjects);
 }
+#endif
 
-bool PiiOutputSocket::Data::hasBufferedObjects(Qt::HANDLE activeThreadId) const
+void PiiOutputSocket::Data::growTurns()
 {
-  // See if there are any buffered objects for this thread
-  for (OutputBuffer::const_iterator i=lstBuffer.begin(); i!=lstBuffer.end(); ++i)
-    if (i->first == activeThreadId)
-      return true;
-  return false;
+  QVector<EmissionTurn> vecNewTurns(qMax(vecTurns.size() * 2, 8));
+  const unsigned int uiMask = vecNewTurns.size() - 1;
+  for (int i=0; i<iTurnCount; ++i)
+    {
+      EmissionTurn& oldTurn = turn(uiFirstTurn + i);
+      EmissionTurn& newTurn = vecNewTurns[(uiFirstTurn + i) & uiMask];
+      newTurn.id = oldTurn.id;
+      newTurn.bFinished = oldTurn.bFinished;
+      newTurn.lstObjects.swap(oldTurn.lstObjects);
+      newTurn.tag = oldTurn.tag;
+    }
+  vecTurns = vecNewTurns;
 }
 
 void PiiOutputSocket::startEmit(Qt::HANDLE activeThreadId)
@@ -204,25 +246,37 @@ void PiiOutputSocket::startEmit(Qt::HANDLE activeThreadId)
   // Put the thread to the tail of the emission queue.
   PII_D;
   QMutexLocker lock(&d->emitLock);
-  //piiDebug("Start %p (%d)", (void*)activeThreadId, d->lstThreads.size());
-  // Must check that the thread isn't already in queue. If it is, wait
-  // until it is finished.
-  while (d->queueIndex(activeThreadId) != -1 && !d->bInterrupted)
+  // Must check that the thread doesn't already have an unfinished
+  // turn. If it does, wait until it is finished.
+  while (d->hashTurns.contains(activeThreadId) && !d->bInterrupted)
     d->endEmitCondition.wait(&d->emitLock, 100);
 
-  d->lstThreads.append(ThreadInfo(activeThreadId));
+  if (d->iTurnCount == d->vecTurns.size())
+    d->growTurns();
+  const unsigned int uiSequence = d->uiFirstTurn + d->iTurnCount++;
+  EmissionTurn& newTurn = d->turn(uiSequence);
+  newTurn.id = activeThreadId;
+  newTurn.bFinished = false;
+  newTurn.tag = PiiLatencyTag();
+  d->hashTurns.insert(activeThreadId, uiSequence);
 }
 
 void PiiOutputSocket::endEmit(Qt::HANDLE activeThreadId)
 {
   PII_D;
-  do
+  if (tryEndEmit(activeThreadId))
+    return;
+  // Only blocked flushes are timed.
+  const qint64 iBlockStart = PiiTimer::currentTime();
+  while (!d->bInterrupted)
     {
-      if (tryEndEmit(activeThreadId))
-        return;
       d->freeInputCondition.wait();
+      if (tryEndEmit(activeThreadId))
+        {
+          d->blockedEmitTimes.add(PiiTimer::currentTime() - iBlockStart);
+          return;
+        }
     }
-  while (!d->bInterrupted);
   throw PiiExecutionException(PiiExecutionException::Interrupted);
 }
 
@@ -231,45 +285,102 @@ bool PiiOutputSocket::tryEndEmit(Qt::HANDLE activeThreadId)
   PII_D;
   QMutexLocker lock(&d->emitLock);
 
-  int iQueueIndex = d->queueIndex(activeThreadId);
-
-  //piiDebug("End %p (%d)", (void*)activeThreadId, iQueueIndex);
-
-  switch (iQueueIndex)
-    {
-    case 0:
-      // This is the blocking thread
-      d->lstThreads[iQueueIndex].bFinished = true;
-    case -1:
-      // The thread is no longer in queue -> last call ended with an
-      // incomplete flush.
-      return flushBuffer(); // may throw
-    default:
-      // If there are buffered objects, cannot yet remove the thread from queue.
-      if (d->hasBufferedObjects(activeThreadId))
-        d->lstThreads[iQueueIndex].bFinished = true;
-      else // This thread wasn't blocking -> no signal needed, just remove.
-        d->lstThreads.remove(iQueueIndex);
-      break;
-    }
+  QHash<Qt::HANDLE,unsigned int>::iterator i = d->hashTurns.find(activeThreadId);
+  // The thread is no longer in queue -> last call ended with an
+  // incomplete flush.
+  if (i == d->hashTurns.end())
+    return flushBuffer(); // may throw
+
+  const unsigned int uiSequence = i.value();
+  EmissionTurn& finishedTurn = d->turn(uiSequence);
+  finishedTurn.bFinished = true;
+  // In unordered mode, the turn keeps its place in the queue until
+  // its own objects have been passed.
+  if (!d->bOrderedEmission && !flushObjects(finishedTurn.lstObjects, finishedTurn.tag)) // may throw
+    return false;
+
+  d->hashTurns.erase(i);
+  d->endEmitCondition.wakeAll();
+
+  // If this thread was blocking others, flush the queue. Otherwise
+  // the objects will be passed once the turn reaches the head.
+  if (uiSequence == d->uiFirstTurn)
+    return flushBuffer(); // may throw
   return true;
 }
 
+void PiiOutputSocket::setOrderedEmission(bool ordered) { _d()->bOrderedEmission = ordered; }
+bool PiiOutputSocket::orderedEmission() const { return _d()->bOrderedEmission; }
+
 void PiiOutputSocket::emitObject(const PiiVariant& object)
 {
-  if (_d()->lstThreads.isEmpty())
+  PiiTracer::Scope scope("emit", this);
+  // Stamps a new tag if this is a source.
+  PiiLatencyTag::Scope tagScope;
+  if (_d()->pRecording != 0)
+    _d()->pRecording->append(qMakePair(_d()->iRecordingIndex, object));
+  if (_d()->iTurnCount == 0)
     emitNonThreaded(object);
   else
     emitThreaded(object);
 }
 
+#ifdef PII_CXX11
+void PiiOutputSocket::emitObject(PiiVariant&& object)
+{
+  PiiTracer::Scope scope("emit", this);
+  // Stamps a new tag if this is a source.
+  PiiLatencyTag::Scope tagScope;
+  if (_d()->pRecording != 0)
+    _d()->pRecording->append(qMakePair(_d()->iRecordingIndex, object));
+  if (_d()->iTurnCount == 0)
+    emitNonThreaded(object);
+  else
+    emitThreaded(std::move(object));
+}
+#endif
+
+void PiiOutputSocket::emitObjects(const PiiVariantList& objects)
+{
+  PiiTracer::Scope scope("emit", this);
+  // Stamps a new tag if this is a source.
+  PiiLatencyTag::Scope tagScope;
+  if (_d()->pRecording != 0)
+    {
+      for (int i=0; i<objects.size(); ++i)
+        _d()->pRecording->append(qMakePair(_d()->iRecordingIndex, objects[i]));
+    }
+  if (_d()->iTurnCount == 0)
+    {
+      for (int i=0; i<objects.size(); ++i)
+        emitNonThreaded(objects[i]);
+    }
+  else
+    {
+      for (int i=0; i<objects.size(); ++i)
+        emitThreaded(objects[i]);
+    }
+}
+
+void PiiOutputSocket::startRecording(PiiResultCache::Result* result, int index)
+{
+  PII_D;
+  d->pRecording = result;
+  d->iRecordingIndex = index;
+}
+
+void PiiOutputSocket::stopRecording()
+{
+  _d()->pRecording = 0;
+}
+
 bool PiiOutputSocket::tryEmit(const PiiVariant& object)
 {
   if (!object.isValid())
     PII_THROW(PiiExecutionException, tr("Trying to send an invalid object."));
 
   PII_D;
-  const int iCnt = d->lstInputs.size();
+  const int iCnt = d->lstFlatInputs.size();
 
   // Optimized emission for a single connected input
   if (iCnt == 1)
@@ -282,11 +393,11 @@ bool PiiOutputSocket::tryEmit(const PiiVariant& object)
     {
       if (!d->pbInputCompleted[i])
         bAllCompleted &= d->pbInputCompleted[i] =
-          d->lstInputs.controllerAt(i)->tryToReceive(d->lstInputs.inputAt(i), object);
+          d->lstFlatInputs.controllerAt(i)->tryToReceive(d->lstFlatInputs.inputAt(i), object);
     }
   if (bAllCompleted)
     {
-      Pii::fillN(d->pbInputCompleted, d->lstInputs.size(), false);
+      Pii::fillN(d->pbInputCompleted, iCnt, false);
       d->freeInputCondition.wakeAll();
     }
 
@@ -296,14 +407,20 @@ bool PiiOutputSocket::tryEmit(const PiiVariant& object)
 void PiiOutputSocket::emitNonThreaded(const PiiVariant& object)
 {
   PII_D;
-  // Try to send until the object is successfully received.
-  do
+  if (tryEmit(object))
+    return;
+  // Try to send until the object is successfully received. Only
+  // blocked emissions are timed.
+  const qint64 iBlockStart = PiiTimer::currentTime();
+  while (!d->bInterrupted)
     {
-      if (tryEmit(object))
-        return;
       d->freeInputCondition.wait();
+      if (tryEmit(object))
+        {
+          d->blockedEmitTimes.add(PiiTimer::currentTime() - iBlockStart);
+          return;
+        }
     }
-  while (!d->bInterrupted);
   throw PiiExecutionException(PiiExecutionException::Interrupted);
 }
 
@@ -353,8 +470,20 @@ void PiiOutputSocket::endMany()
 
 void PiiOutputSocket::setInputListener(PiiInputListener* listener)
 {
-  if (listener == 0) listener = _d();
   PII_D;
-  for (int i=0; i<d->lstInputs.size(); ++i)
-    d->lstInputs.inputAt(i)->setListener(listener);
+  d->pInputListener = listener;
+  if (listener == 0) listener = d;
+  for (int i=0; i<d->lstFlatInputs.size(); ++i)
+    d->lstFlatInputs.inputAt(i)->setListener(listener);
+}
+
+const PiiProfileHistogram& PiiOutputSocket::blockedEmitHistogram() const { return _d()->blockedEmitTimes; }
+const PiiProfileHistogram& PiiOutputSocket::queueDepthHistogram() const { return _d()->queueDepths; }
+int PiiOutputSocket::bufferedObjectCount() const { return _d()->iBufferedObjects.load(); }
+
+void PiiOutputSocket::resetProfile()
+{
+  PII_D;
+  d->blockedEmitTimes.reset();
+  d->queueDepths.reset();
 }
@@ -21,6 +21,9 @@
 #include "PiiSocketState.h"
 #include "PiiExecutionException.h"
 #include "PiiInputListener.h"
+#include "PiiProfileHistogram.h"
+#include "PiiLatencyTag.h"
+#include "PiiResultCache.h"
 
 #include <PiiVariant.h>
 #include <PiiMatrix.h>
@@ -28,6 +31,9 @@
 
 #include <QLinkedList>
 #include <QVarLengthArray>
+#include <QList>
+#include <QVector>
+#include <QHash>
 #include <QPair>
 
 class PiiAbstractInputSocket;
@@ -76,6 +82,12 @@ namespace PiiYdin
 /**
  * An output socket.
  *
+ * If the output is connected to proxy sockets (see
+ * PiiOperationCompound), objects are passed directly to the inputs
+ * at the ends of the proxy chains. The proxies remain connected and
+ * can be inspected as usual, but emission cost does not depend on
+ * how deeply the receivers are nested in compounds.
+ *
  */
 class PII_YDIN_EXPORT PiiOutputSocket : public PiiAbstractOutputSocket
 {
@@ -235,6 +247,27 @@ public:
    */
   void emitObject(const PiiVariant& obj);
 
+#ifdef PII_CXX11
+  /**
+   * Sends a temporary object through this output. If the operation
+   * is multi-threaded, *obj* is moved to the reorder buffer instead
+   * of being copied. Otherwise works like the const version.
+   */
+  void emitObject(PiiVariant&& obj);
+#endif
+
+  /**
+   * Sends all *objects* through this output in order. The result is
+   * the same as calling [emitObject()] for each object, but the
+   * emission is traced as one event. Operations running in batch mode
+   * (see [PiiDefaultOperation::setMaxBatchSize()]) can collect their
+   * results and pass them at once.
+   *
+   * @exception PiiExecutionException& if the emission was interrupted
+   * by an external signal.
+   */
+  void emitObjects(const PiiVariantList& objects);
+
   /**
    * Tries to sends an object through this output to all connected
    * inputs. If any of the inputs is unable to receive the object,
@@ -338,28 +371,87 @@ public:
    */
   bool tryEndEmit(Qt::HANDLE activeThreadId);
 
+  /**
+   * Enables or disables ordered emission. If *ordered* is `true`
+   * (the default), objects emitted by threads in the emission order
+   * queue are passed in the order the threads were put to the queue
+   * with [startEmit()]. If *ordered* is `false`, the objects emitted
+   * by a thread are passed as soon as the thread calls
+   * [tryEndEmit()], irrespective of the threads before it in the
+   * queue. Objects emitted by a single thread always retain their
+   * relative order.
+   */
+  void setOrderedEmission(bool ordered);
+  /**
+   * Returns `true` if ordered emission is enabled, `false`
+   * otherwise.
+   */
+  bool orderedEmission() const;
+
   /**
    * Sets *listener* as the input listener for all connected inputs.
    * If *listener* is zero, uses a default listener.
    */
   void setInputListener(PiiInputListener* listener = 0);
 
+  /**
+   * Returns a histogram of the times, in microseconds, [emitObject()]
+   * and [endEmit()] were blocked waiting for a receiver to free space
+   * in its input queue. Emissions that pass without blocking are not
+   * recorded. A large total indicates that a receiver is the
+   * bottleneck.
+   */
+  const PiiProfileHistogram& blockedEmitHistogram() const;
+  /**
+   * Returns a histogram of the number of objects buffered for
+   * ordered emission (see [startEmit()]), sampled whenever an object
+   * is buffered.
+   */
+  const PiiProfileHistogram& queueDepthHistogram() const;
+  /**
+   * Returns the number of objects currently buffered for ordered
+   * emission.
+   */
+  int bufferedObjectCount() const;
+  /**
+   * Clears the profiling statistics.
+   */
+  void resetProfile();
+
+  /**
+   * Starts recording emitted objects. Until [stopRecording()] is
+   * called, each object passed to [emitObject()] or [emitObjects()]
+   * is also appended to *result*, paired with *index*. Many outputs
+   * may record to the same list. PiiDefaultOperation uses this
+   * function to collect the results of a processing round for a
+   * PiiResultCache. The caller must ensure that no other thread emits
+   * through this output while recording.
+   */
+  void startRecording(PiiResultCache::Result* result, int index);
+  /**
+   * Stops recording emitted objects.
+   */
+  void stopRecording();
+
 protected:
   /// @hide
-  struct ThreadInfo
+  typedef QList<PiiVariant> OutputBuffer;
+
+  /* An emission turn in the reorder buffer. Each call to
+   * startEmit() reserves a turn with a running sequence number.
+   * Objects emitted by the thread are collected to the turn and
+   * released once all earlier turns have been flushed.
+   */
+  struct EmissionTurn
   {
-    ThreadInfo(Qt::HANDLE i=0, bool f = false) : id(i), bFinished(f) {}
+    EmissionTurn() : id(0), bFinished(false) {}
     Qt::HANDLE id;
     bool bFinished;
+    OutputBuffer lstObjects;
+    // The latency tag of the round that emitted lstObjects.
+    PiiLatencyTag tag;
   };
 
-#if (QT_VERSION < 0x040800)
-  typedef QVector<ThreadInfo> ThreadList;
-#else
-  typedef QVarLengthArray<ThreadInfo,16> ThreadList;
-#endif
-  typedef QLinkedList<QPair<Qt::HANDLE,PiiVariant> > OutputBuffer;
-
   class Data :
     public PiiAbstractOutputSocket::Data,
     public PiiInputListener
@@ -371,11 +463,28 @@ protected:
     void inputReady(PiiAbstractInputSocket* input);
     bool setOutputConnected(bool connected);
 
-    inline int queueIndex(Qt::HANDLE threadId) const;
-    inline bool hasBufferedObjects(Qt::HANDLE activeThreadId) const;
+    inline EmissionTurn& turn(unsigned int sequence) { return vecTurns[sequence & (vecTurns.size() - 1)]; }
+    // Returns the unfinished turn of the active thread, or 0.
+    inline EmissionTurn* threadTurn()
+    {
+      QHash<Qt::HANDLE,unsigned int>::const_iterator i = hashTurns.constFind(PiiYdin::activeThreadId());
+      return i != hashTurns.constEnd() ? &turn(i.value()) : 0;
+    }
+    // Returns the buffer for objects emitted by the active thread.
+    inline OutputBuffer& threadBuffer()
+    {
+      EmissionTurn* pTurn = threadTurn();
+      if (pTurn == 0)
+        return lstBuffer;
+      if (PiiLatencyTag::isEnabled())
+        pTurn->tag = PiiLatencyTag::current();
+      return pTurn->lstObjects;
+    }
+    void growTurns();
     void inputConnected(PiiAbstractInputSocket* input);
     void inputDisconnected(PiiAbstractInputSocket* input);
     void inputUpdated(PiiAbstractInputSocket* input);
+    void flattenInputs();
     void createFlagArray();
 
     int iGroupId;
@@ -383,16 +492,34 @@ protected:
     // A wait condition that is used when some inputs aren't ready to
     // receive new objects.
     PiiWaitCondition freeInputCondition, *pFreeInputCondition;
+    // The non-proxy inputs reached through all proxy chains starting
+    // at this output. Objects are passed directly to these, so
+    // emission cost does not depend on the depth of compounds.
+    InputList lstFlatInputs;
     PiiAbstractInputSocket* pFirstInput;
     PiiInputController* pFirstController;
+    // The listener set with setInputListener(), or 0 for this.
+    PiiInputListener* pInputListener;
     bool bInterrupted;
     bool *pbInputCompleted;
     PiiSocketState state;
-    Qt::HANDLE activeThreadId;
+    // Objects emitted by threads that have no emission turn.
     OutputBuffer lstBuffer;
-    ThreadList lstThreads;
+    // A ring buffer of emission turns. The size is a power of two.
+    QVector<EmissionTurn> vecTurns;
+    // The sequence number of the oldest turn, and the number of turns.
+    unsigned int uiFirstTurn;
+    int iTurnCount;
+    // Maps thread ids to the sequence numbers of unfinished turns.
+    QHash<Qt::HANDLE,unsigned int> hashTurns;
+    bool bOrderedEmission;
     QMutex emitLock;
     QWaitCondition endEmitCondition;
+    PiiProfileHistogram blockedEmitTimes;
+    PiiProfileHistogram queueDepths;
+    PiiAtomicInt iBufferedObjects;
+    PiiResultCache::Result* pRecording;
+    int iRecordingIndex;
   };
   PII_UNSAFE_D_FUNC;
 
@@ -401,7 +528,11 @@ protected:
 
 private:
   bool flushBuffer();
+  bool flushObjects(OutputBuffer& objects, const PiiLatencyTag& tag = PiiLatencyTag());
   void emitThreaded(const PiiVariant& object);
+#ifdef PII_CXX11
+  void emitThreaded(PiiVariant&& object);
+#endif
   void emitNonThreaded(const PiiVariant& object);
 };
 
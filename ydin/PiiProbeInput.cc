@@ -17,11 +17,86 @@
 
 #include <QMutex>
 #include <QTime>
+#include <QCoreApplication>
+#include <QMetaMethod>
+#include <QTimerEvent>
 #include <PiiThreadSafeTimer.h>
+#include <PiiLatestValue.h>
+#include <PiiTimer.h>
+#include <PiiLog.h>
 
 #include "PiiYdinTypes.h"
 
 static int iProbeInputMetaType = qRegisterMetaType<PiiProbeInput*>("PiiProbeInput*");
+static const QEvent::Type probeUpdateEvent = QEvent::Type(QEvent::registerEventType());
+
+/* Delivers coalesced updates to a subscriber. Lives in the thread of
+ * the receiver. The producer posts at most one event at a time; the
+ * latest object is read when the event is handled.
+ */
+class PiiProbeInput::Subscriber : public QObject
+{
+public:
+  Subscriber(PiiProbeInput* probe, QObject* receiver, const QMetaMethod& slot, int interval) :
+    pProbe(probe),
+    pReceiver(receiver),
+    method(slot),
+    iInterval(qint64(qMax(interval, 0)) * 1000),
+    iLastDelivery(0),
+    iDeliveredVersion(-1),
+    iTimerId(0)
+  {
+    moveToThread(receiver->thread());
+  }
+
+  // Called by the producer.
+  void notify()
+  {
+    if (iPending.testAndSetOrdered(0, 1))
+      QCoreApplication::postEvent(this, new QEvent(probeUpdateEvent));
+  }
+
+  // Called by the probe before the subscriber is deleted.
+  void detach()
+  {
+    QMutexLocker lock(&mutex);
+    pProbe = 0;
+    pReceiver = 0;
+  }
+
+  bool event(QEvent* e)
+  {
+    if (e->type() != probeUpdateEvent)
+      return QObject::event(e);
+    const qint64 iRemaining = iLastDelivery + iInterval - PiiTimer::currentTime();
+    if (iRemaining > 0 && iLastDelivery != 0)
+      iTimerId = startTimer(int((iRemaining + 999) / 1000));
+    else
+      deliver();
+    return true;
+  }
+
+  PiiProbeInput* pProbe;
+  QObject* pReceiver;
+
+protected:
+  void timerEvent(QTimerEvent*)
+  {
+    killTimer(iTimerId);
+    iTimerId = 0;
+    deliver();
+  }
+
+private:
+  void deliver();
+
+  QMutex mutex;
+  QMetaMethod method;
+  qint64 iInterval, iLastDelivery;
+  int iDeliveredVersion;
+  int iTimerId;
+  PiiAtomicInt iPending;
+};
 
 class PiiProbeInput::Data :
   public PiiAbstractInputSocket::Data,
@@ -33,24 +108,67 @@ public:
     bDiscardControlObjects(false),
     bEnoughTimeElapsed(true),
     bObjectPending(false),
-    iSignalInterval(0)
+    iSignalInterval(0),
+    iBatchSize(0)
   {
     emissionTimer.setSingleShot(true);
   }
 
   // Emits [objectReceived()] and saves the received object.
   bool tryToReceive(PiiAbstractInputSocket* sender, const PiiVariant& object) throw ();
+  // Collects objects in batch mode.
+  void receiveBatched(const PiiVariant& object);
+  // Publishes the latest object and notifies subscribers. Called
+  // with mutex locked.
+  void save(const PiiVariant& object)
+  {
+    savedObject.store(object);
+    for (int i=0; i<lstSubscribers.size(); ++i)
+      lstSubscribers[i]->notify();
+  }
 
   PiiProbeInput* q;
-  PiiVariant varSavedObject;
+  // Written with mutex locked, read without locking.
+  PiiLatestValue<PiiVariant> savedObject;
+  QList<Subscriber*> lstSubscribers;
   bool bDiscardControlObjects;
   bool bEnoughTimeElapsed;
   bool bObjectPending;
   int iSignalInterval;
+  int iBatchSize;
+  PiiVariantList lstBatch;
   PiiThreadSafeTimer emissionTimer;
   QMutex mutex;
 };
 
+void PiiProbeInput::Subscriber::deliver()
+{
+  // Objects saved after this point will post a new event.
+  iPending.storeRelease(0);
+  mutex.lock();
+  PiiProbeInput* pSender = pProbe;
+  QObject* pTarget = pReceiver;
+  const int iVersion = pSender != 0 ? pSender->_d()->savedObject.version() : 0;
+  if (pSender == 0 || iVersion == iDeliveredVersion)
+    {
+      mutex.unlock();
+      return;
+    }
+  PiiVariant obj(pSender->_d()->savedObject.load());
+  mutex.unlock();
+
+  iDeliveredVersion = iVersion;
+  iLastDelivery = PiiTimer::currentTime();
+  // The receiver lives in this thread and cannot be destroyed
+  // concurrently.
+  switch (method.parameterTypes().size())
+    {
+    case 0: method.invoke(pTarget, Qt::DirectConnection); break;
+    case 1: method.invoke(pTarget, Qt::DirectConnection, Q_ARG(PiiVariant, obj)); break;
+    default: method.invoke(pTarget, Qt::DirectConnection, Q_ARG(PiiVariant, obj), Q_ARG(PiiProbeInput*, pSender));
+    }
+}
+
 PiiProbeInput::PiiProbeInput(const QString& name) :
   PiiAbstractInputSocket(name, new Data(this))
 {
@@ -68,7 +186,56 @@ PiiProbeInput::PiiProbeInput(PiiAbstractOutputSocket* output, const QObject* rec
 }
 
 PiiProbeInput::~PiiProbeInput()
-{}
+{
+  PII_D;
+  QMutexLocker lock(&d->mutex);
+  for (int i=0; i<d->lstSubscribers.size(); ++i)
+    {
+      d->lstSubscribers[i]->detach();
+      d->lstSubscribers[i]->deleteLater();
+    }
+}
+
+bool PiiProbeInput::subscribe(QObject* receiver, const char* slot, int interval)
+{
+  // Skip the code prepended by SLOT().
+  if (receiver == 0 || slot == 0 || *slot == 0)
+    return false;
+  const int iIndex = receiver->metaObject()->indexOfMethod(QMetaObject::normalizedSignature(slot + 1));
+  if (iIndex < 0)
+    {
+      piiWarning(tr("%1 has no slot called %2.").arg(receiver->metaObject()->className()).arg(slot + 1));
+      return false;
+    }
+  Subscriber* pSubscriber = new Subscriber(this, receiver, receiver->metaObject()->method(iIndex), interval);
+  connect(receiver, SIGNAL(destroyed(QObject*)), SLOT(removeSubscriber(QObject*)), Qt::DirectConnection);
+  PII_D;
+  QMutexLocker lock(&d->mutex);
+  d->lstSubscribers << pSubscriber;
+  // Deliver the current object, if any.
+  if (d->savedObject.version() > 0)
+    pSubscriber->notify();
+  return true;
+}
+
+void PiiProbeInput::unsubscribe(QObject* receiver)
+{
+  disconnect(receiver, SIGNAL(destroyed(QObject*)), this, SLOT(removeSubscriber(QObject*)));
+  removeSubscriber(receiver);
+}
+
+void PiiProbeInput::removeSubscriber(QObject* receiver)
+{
+  PII_D;
+  QMutexLocker lock(&d->mutex);
+  for (int i=d->lstSubscribers.size(); i--; )
+    if (d->lstSubscribers[i]->pReceiver == receiver)
+      {
+        Subscriber* pSubscriber = d->lstSubscribers.takeAt(i);
+        pSubscriber->detach();
+        pSubscriber->deleteLater();
+      }
+}
 
 void PiiProbeInput::emitPendingObject()
 {
@@ -81,7 +248,7 @@ void PiiProbeInput::emitPendingObject()
       d->mutex.unlock();
       return;
     }
-  PiiVariant varSavedObject = d->varSavedObject;
+  PiiVariant varSavedObject = d->savedObject.load();
   d->bObjectPending = false;
   d->mutex.unlock();
 
@@ -90,12 +257,37 @@ void PiiProbeInput::emitPendingObject()
   d->emissionTimer.start();
 }
 
+void PiiProbeInput::Data::receiveBatched(const PiiVariant& object)
+{
+  mutex.lock();
+  if (!(bDiscardControlObjects && PiiYdin::isControlType(object.type())))
+    {
+      save(object);
+      lstBatch << object;
+    }
+  if (lstBatch.size() >= iBatchSize ||
+      (object.type() == PiiYdin::StopTagType && !lstBatch.isEmpty()))
+    {
+      PiiVariantList lstObjects(lstBatch);
+      lstBatch.clear();
+      mutex.unlock();
+      emit q->objectsReceived(lstObjects, q);
+      return;
+    }
+  mutex.unlock();
+}
+
 bool PiiProbeInput::Data::tryToReceive(PiiAbstractInputSocket*, const PiiVariant& object) throw ()
 {
+  if (iBatchSize > 0)
+    {
+      receiveBatched(object);
+      return true;
+    }
   if (!(bDiscardControlObjects && PiiYdin::isControlType(object.type())))
     {
       mutex.lock();
-      varSavedObject = object;
+      save(object);
 
       if (iSignalInterval > 0)
         {
@@ -124,9 +316,15 @@ bool PiiProbeInput::Data::tryToReceive(PiiAbstractInputSocket*, const PiiVariant
 
 PiiInputController* PiiProbeInput::controller() const { return const_cast<Data*>(_d()); }
 
-PiiVariant PiiProbeInput::savedObject() const { return _d()->varSavedObject; }
-void PiiProbeInput::setSavedObject(const PiiVariant& obj) { _d()->varSavedObject = obj; }
-bool PiiProbeInput::hasSavedObject() const { return _d()->varSavedObject.isValid(); }
+PiiVariant PiiProbeInput::savedObject() const { return _d()->savedObject.load(); }
+bool PiiProbeInput::hasSavedObject() const { return _d()->savedObject.load().isValid(); }
+
+void PiiProbeInput::setSavedObject(const PiiVariant& obj)
+{
+  PII_D;
+  QMutexLocker lock(&d->mutex);
+  d->save(obj);
+}
 
 void PiiProbeInput::setDiscardControlObjects(bool discardControlObjects) { _d()->bDiscardControlObjects = discardControlObjects; }
 bool PiiProbeInput::discardControlObjects() const { return _d()->bDiscardControlObjects; }
@@ -138,3 +336,25 @@ void PiiProbeInput::setSignalInterval(int signalInterval)
   d->emissionTimer.setInterval(signalInterval);
 }
 int PiiProbeInput::signalInterval() const { return _d()->iSignalInterval; }
+
+void PiiProbeInput::setBatchSize(int batchSize)
+{
+  flushBatch();
+  _d()->iBatchSize = batchSize;
+}
+int PiiProbeInput::batchSize() const { return _d()->iBatchSize; }
+
+void PiiProbeInput::flushBatch()
+{
+  PII_D;
+  d->mutex.lock();
+  if (d->lstBatch.isEmpty())
+    {
+      d->mutex.unlock();
+      return;
+    }
+  PiiVariantList lstObjects(d->lstBatch);
+  d->lstBatch.clear();
+  d->mutex.unlock();
+  emit objectsReceived(lstObjects, this);
+}
@@ -24,6 +24,12 @@
  * socket works like a measurement probe that emits the
  * [objectReceived()] signal whenever a new object is received. It
  * also saves the last received object.
+ *
+ * Monitoring clients that only need the latest object should either
+ * poll [savedObject] or [subscribe()] to updates instead of
+ * connecting to [objectReceived()]. The saved object is kept in a
+ * PiiLatestValue, so reading it never blocks the operation that
+ * emits the objects.
  */
 class PII_YDIN_EXPORT PiiProbeInput :
   public PiiAbstractInputSocket
@@ -32,7 +38,8 @@ class PII_YDIN_EXPORT PiiProbeInput :
 
   /**
    * The last received object. If no object has been received,
-   * contains an invalid variant.
+   * contains an invalid variant. Reading the property is lock-free
+   * and safe from any thread.
    */
   Q_PROPERTY(PiiVariant savedObject READ savedObject WRITE setSavedObject);
 
@@ -56,6 +63,18 @@ class PII_YDIN_EXPORT PiiProbeInput :
    */
   Q_PROPERTY(int signalInterval READ signalInterval WRITE setSignalInterval);
 
+  /**
+   * The number of objects collected into a batch before
+   * [objectsReceived()] is emitted. Batching reduces the per-object
+   * overhead of receivers, such as script functions, that are
+   * expensive to call. A partial batch is emitted when a stop tag is
+   * received and when [flushBatch()] is called. If *batchSize* is
+   * positive, [objectReceived()] will not be emitted and
+   * [signalInterval] has no effect. The default value is zero, which
+   * disables batching. Changing the value flushes pending objects.
+   */
+  Q_PROPERTY(int batchSize READ batchSize WRITE setBatchSize);
+
 public:
   /**
    * Constructs a new probe input and sets its `objectName` property
@@ -98,6 +117,41 @@ public:
   void setSignalInterval(int signalInterval);
   int signalInterval() const;
 
+  void setBatchSize(int batchSize);
+  int batchSize() const;
+
+  /**
+   * Emits [objectsReceived()] with the objects collected so far, if
+   * any.
+   */
+  Q_INVOKABLE void flushBatch();
+
+  /**
+   * Subscribes *receiver* to updates of [savedObject]. Whenever a new
+   * object is saved, *slot* will be invoked in the thread of
+   * *receiver* with the latest object, but at most once every
+   * *interval* milliseconds. Updates received in between are
+   * coalesced: only the latest object is delivered, and at most one
+   * notification is queued to the receiver's event loop at a time.
+   * Unlike the [signalInterval] of [objectReceived()], the interval
+   * is specific to each subscriber. The subscription ends
+   * automatically when *receiver* is destroyed.
+   *
+   * *slot* may take the object (`PiiVariant`) and the sender
+   * (`PiiProbeInput*`) as parameters.
+   *
+   * ~~~(c++)
+   * probe->subscribe(display, SLOT(setImage(PiiVariant)), 40);
+   * ~~~
+   *
+   * @return `true` if the slot was found, `false` otherwise
+   */
+  bool subscribe(QObject* receiver, const char* slot, int interval = 0);
+  /**
+   * Cancels the subscriptions of *receiver*.
+   */
+  void unsubscribe(QObject* receiver);
+
   PiiInputController* controller() const;
 
 signals:
@@ -112,10 +166,18 @@ signals:
    */
   void objectReceived(const PiiVariant& obj, PiiProbeInput* sender);
 
+  /**
+   * Emitted in batch mode (see [batchSize]) whenever a batch is
+   * full. The *objects* are in the order they were received.
+   */
+  void objectsReceived(const PiiVariantList& objects, PiiProbeInput* sender);
+
 private slots:
   void emitPendingObject();
+  void removeSubscriber(QObject* receiver);
 
 private:
+  class Subscriber;
   class Data;
   PII_UNSAFE_D_FUNC;
 };
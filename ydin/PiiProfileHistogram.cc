@@ -0,0 +1,101 @@
+/* This file is part of Into.
+ * Copyright (C) Intopii 2013.
+ * All rights reserved.
+ *
+ * Licensees holding a commercial Into license may use this file in
+ * accordance with the commercial license agreement. Please see
+ * LICENSE.commercial for commercial licensing terms.
+ *
+ * Alternatively, this file may be used under the terms of the GNU
+ * Affero General Public License version 3 as published by the Free
+ * Software Foundation. In addition, Intopii gives you special rights
+ * to use Into as a part of open source software projects. Please
+ * refer to LICENSE.AGPL3 for details.
+ */
+
+
+#include "PiiProfileHistogram.h"
+
+#include <QVariantList>
+#include <climits>
+
+PiiProfileHistogram::PiiProfileHistogram()
+{}
+
+int PiiProfileHistogram::binIndex(int value)
+{
+  int iBin = 0;
+  for (; value > 0; value >>= 1)
+    ++iBin;
+  return iBin;
+}
+
+void PiiProfileHistogram::add(qint64 value)
+{
+  const int iValue = value < 0 ? 0 : int(qMin(value, qint64(INT_MAX)));
+  ++_iCount;
+  ++_aBins[binIndex(iValue)];
+
+  // Anything that does not fit into the low part goes directly to the
+  // high part.
+  int iLow = iValue;
+  if (iLow > LowMask)
+    {
+      _iTotalHigh += iLow >> LowBits;
+      iLow &= LowMask;
+    }
+  for (;;)
+    {
+      int iOldLow = _iTotalLow.load();
+      int iNewLow = iOldLow + iLow;
+      if (_iTotalLow.testAndSetOrdered(iOldLow, iNewLow & LowMask))
+        {
+          if (iNewLow > LowMask)
+            _iTotalHigh += iNewLow >> LowBits;
+          break;
+        }
+    }
+
+  for (int iOldMax = _iMaximum.load(); iValue > iOldMax; iOldMax = _iMaximum.load())
+    if (_iMaximum.testAndSetOrdered(iOldMax, iValue))
+      break;
+}
+
+qint64 PiiProfileHistogram::total() const
+{
+  return (qint64(_iTotalHigh.load()) << LowBits) + _iTotalLow.load();
+}
+
+double PiiProfileHistogram::mean() const
+{
+  const int iCount = count();
+  return iCount != 0 ? double(total()) / iCount : 0.0;
+}
+
+void PiiProfileHistogram::reset()
+{
+  _iCount.store(0);
+  _iTotalLow.store(0);
+  _iTotalHigh.store(0);
+  _iMaximum.store(0);
+  for (int i=0; i<BinCount; ++i)
+    _aBins[i].store(0);
+}
+
+QVariantMap PiiProfileHistogram::toVariantMap() const
+{
+  int iLastBin = BinCount;
+  while (iLastBin > 0 && binCount(iLastBin-1) == 0)
+    --iLastBin;
+  QVariantList lstBins;
+  for (int i=0; i<iLastBin; ++i)
+    lstBins << binCount(i);
+
+  QVariantMap mapResult;
+  mapResult["count"] = count();
+  mapResult["total"] = total();
+  mapResult["mean"] = mean();
+  mapResult["max"] = maximum();
+  mapResult["bins"] = lstBins;
+  return mapResult;
+}
@@ -0,0 +1,102 @@
+/* This file is part of Into.
+ * Copyright (C) Intopii 2013.
+ * All rights reserved.
+ *
+ * Licensees holding a commercial Into license may use this file in
+ * accordance with the commercial license agreement. Please see
+ * LICENSE.commercial for commercial licensing terms.
+ *
+ * Alternatively, this file may be used under the terms of the GNU
+ * Affero General Public License version 3 as published by the Free
+ * Software Foundation. In addition, Intopii gives you special rights
+ * to use Into as a part of open source software projects. Please
+ * refer to LICENSE.AGPL3 for details.
+ */
+
+
+#ifndef _PIIPROFILEHISTOGRAM_H
+#define _PIIPROFILEHISTOGRAM_H
+
+#include "PiiYdin.h"
+
+#include <PiiAtomicInt.h>
+#include <QVariantMap>
+
+/**
+ * A lock-free histogram for run-time profiling. Operations and
+ * sockets use PiiProfileHistogram to collect statistics such as
+ * processing times and queue lengths while the engine is running.
+ * Values can be added from any number of threads concurrently
+ * without locking, and the statistics can be read at any time. Since
+ * the counters are updated independently, a snapshot taken during
+ * updates may be slightly inconsistent.
+ *
+ * Values are collected to logarithmic bins: bin 0 counts zeros, and
+ * bin *i* > 0 counts values in [2^(i-1), 2^i). Negative values are
+ * treated as zeros.
+ */
+class PII_YDIN_EXPORT PiiProfileHistogram
+{
+public:
+  enum { BinCount = 32 };
+
+  PiiProfileHistogram();
+
+  /**
+   * Adds *value* to the histogram. Values larger than INT_MAX are
+   * clamped.
+   */
+  void add(qint64 value);
+
+  /**
+   * Returns the number of values added.
+   */
+  int count() const { return _iCount.load(); }
+  /**
+   * Returns the sum of all values added.
+   */
+  qint64 total() const;
+  /**
+   * Returns the mean value, or zero if no values have been added.
+   */
+  double mean() const;
+  /**
+   * Returns the largest value added.
+   */
+  int maximum() const { return _iMaximum.load(); }
+  /**
+   * Returns the number of values in *bin*.
+   */
+  int binCount(int bin) const { return _aBins[bin].load(); }
+
+  /**
+   * Returns the bin *value* falls into.
+   */
+  static int binIndex(int value);
+
+  /**
+   * Zeroes all counters.
+   */
+  void reset();
+
+  /**
+   * Returns the statistics as a map with the keys `count`, `total`,
+   * `mean`, `max` and `bins`. `bins` is a list of bin counts with
+   * trailing empty bins removed.
+   */
+  QVariantMap toVariantMap() const;
+
+private:
+  enum { LowBits = 24, LowMask = (1 << LowBits) - 1 };
+
+  PiiAtomicInt _iCount;
+  // The total is split to two counters, because there is no portable
+  // 64-bit atomic integer. The low part carries into the high one.
+  PiiAtomicInt _iTotalLow, _iTotalHigh;
+  PiiAtomicInt _iMaximum;
+  PiiAtomicInt _aBins[BinCount];
+
+  PII_DISABLE_COPY(PiiProfileHistogram);
+};
+
+#endif //_PIIPROFILEHISTOGRAM_H
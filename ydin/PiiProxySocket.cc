@@ -172,8 +172,10 @@ bool PiiProxyInputSocket::Data::tryToReceive(PiiAbstractInputSocket* /*sender*/,
 
 void PiiProxyOutputSocket::Data::inputReady(PiiAbstractInputSocket*)
 {
-  // Pass this signal to the proxied output
-  pInputData->pListener->inputReady(pInput);
+  // Pass this signal to the proxied output. Normally, the root
+  // output listens to the inputs behind proxies directly.
+  if (pInputData->pListener != 0)
+    pInputData->pListener->inputReady(pInput);
 }
 
 void PiiProxyOutputSocket::Data::inputConnected(PiiAbstractInputSocket*)
@@ -0,0 +1,206 @@
+/* This file is part of Into.
+ * Copyright (C) Intopii 2013.
+ * All rights reserved.
+ *
+ * Licensees holding a commercial Into license may use this file in
+ * accordance with the commercial license agreement. Please see
+ * LICENSE.commercial for commercial licensing terms.
+ *
+ * Alternatively, this file may be used under the terms of the GNU
+ * Affero General Public License version 3 as published by the Free
+ * Software Foundation. In addition, Intopii gives you special rights
+ * to use Into as a part of open source software projects. Please
+ * refer to LICENSE.AGPL3 for details.
+ */
+
+
+#include "PiiResultCache.h"
+
+#include <PiiSerializationUtil.h>
+#include <PiiGenericBinaryInputArchive.h>
+#include <PiiGenericBinaryOutputArchive.h>
+
+#include <QMutex>
+#include <QHash>
+#include <QLinkedList>
+#include <QFile>
+#include <QDir>
+
+class PiiResultCache::Data
+{
+public:
+  Data(const QString& directory) :
+    strDirectory(directory),
+    lMaxMemory(64*1024*1024),
+    lMemoryUsage(0),
+    iHitCount(0), iMissCount(0)
+  {}
+
+  struct Entry
+  {
+    Entry() : lBytes(0) {}
+    Entry(const Result& result, qint64 bytes, QLinkedList<QByteArray>::iterator position) :
+      result(result), lBytes(bytes), itPosition(position)
+    {}
+    Result result;
+    qint64 lBytes;
+    QLinkedList<QByteArray>::iterator itPosition;
+  };
+
+  QMutex mutex;
+  QString strDirectory;
+  qint64 lMaxMemory, lMemoryUsage;
+  QHash<QByteArray, Entry> hashResults;
+  // Least recently used first
+  QLinkedList<QByteArray> lstKeys;
+  int iHitCount, iMissCount;
+};
+
+PiiResultCache::PiiResultCache() :
+  d(new Data(QString()))
+{}
+
+PiiResultCache::PiiResultCache(const QString& directory) :
+  d(new Data(directory))
+{
+  QDir().mkpath(directory);
+}
+
+PiiResultCache::~PiiResultCache()
+{
+  delete d;
+}
+
+bool PiiResultCache::find(const QByteArray& key, Result* result)
+{
+  QMutexLocker lock(&d->mutex);
+  QHash<QByteArray, Data::Entry>::iterator i = d->hashResults.find(key);
+  if (i != d->hashResults.end())
+    {
+      d->lstKeys.erase(i->itPosition);
+      i->itPosition = d->lstKeys.insert(d->lstKeys.end(), key);
+      *result = i->result;
+      ++d->iHitCount;
+      return true;
+    }
+
+  if (!d->strDirectory.isEmpty())
+    {
+      QFile file(fileName(key));
+      if (file.open(QIODevice::ReadOnly))
+        {
+          try
+            {
+              Result diskResult;
+              PiiSerialization::fromByteArray<PiiGenericBinaryInputArchive>(file.readAll(), diskResult);
+              storeInMemory(key, diskResult);
+              *result = diskResult;
+              ++d->iHitCount;
+              return true;
+            }
+          catch (PiiSerializationException& ex)
+            {
+              piiWarning(tr("Ignoring a corrupted result file %1: %2").arg(file.fileName()).arg(ex.message()));
+            }
+        }
+    }
+  ++d->iMissCount;
+  return false;
+}
+
+void PiiResultCache::insert(const QByteArray& key, const Result& result)
+{
+  QMutexLocker lock(&d->mutex);
+  storeInMemory(key, result);
+
+  if (d->strDirectory.isEmpty())
+    return;
+
+  QByteArray aData;
+  try
+    {
+      aData = PiiSerialization::toByteArray<PiiGenericBinaryOutputArchive>(result);
+    }
+  catch (PiiSerializationException&)
+    {
+      return;
+    }
+
+  // Write to a temporary file first so that a concurrent reader never
+  // sees a partial result.
+  QString strFileName(fileName(key));
+  QFile file(strFileName + ".tmp");
+  if (!file.open(QIODevice::WriteOnly) || file.write(aData) != aData.size())
+    {
+      piiWarning(tr("Cannot write result file %1.").arg(file.fileName()));
+      file.remove();
+      return;
+    }
+  file.close();
+  if (!file.rename(strFileName))
+    file.remove();
+}
+
+void PiiResultCache::storeInMemory(const QByteArray& key, const Result& result)
+{
+  qint64 lBytes = key.size();
+  for (int i=0; i<result.size(); ++i)
+    lBytes += result[i].second.memoryUsage();
+  if (d->lMaxMemory > 0 && lBytes > d->lMaxMemory)
+    return;
+
+  QHash<QByteArray, Data::Entry>::iterator i = d->hashResults.find(key);
+  if (i != d->hashResults.end())
+    {
+      d->lMemoryUsage -= i->lBytes;
+      d->lstKeys.erase(i->itPosition);
+      d->hashResults.erase(i);
+    }
+
+  while (d->lMaxMemory > 0 && !d->lstKeys.isEmpty() && d->lMemoryUsage + lBytes > d->lMaxMemory)
+    d->lMemoryUsage -= d->hashResults.take(d->lstKeys.takeFirst()).lBytes;
+
+  d->hashResults.insert(key, Data::Entry(result, lBytes, d->lstKeys.insert(d->lstKeys.end(), key)));
+  d->lMemoryUsage += lBytes;
+}
+
+QString PiiResultCache::fileName(const QByteArray& key) const
+{
+  return d->strDirectory + "/" + QString::fromLatin1(key.toHex()) + ".result";
+}
+
+void PiiResultCache::clear()
+{
+  QMutexLocker lock(&d->mutex);
+  d->hashResults.clear();
+  d->lstKeys.clear();
+  d->lMemoryUsage = 0;
+}
+
+QString PiiResultCache::directory() const { return d->strDirectory; }
+
+void PiiResultCache::setMaxMemory(qint64 maxMemory)
+{
+  QMutexLocker lock(&d->mutex);
+  d->lMaxMemory = maxMemory;
+}
+
+qint64 PiiResultCache::maxMemory() const { return d->lMaxMemory; }
+
+qint64 PiiResultCache::memoryUsage() const
+{
+  QMutexLocker lock(&d->mutex);
+  return d->lMemoryUsage;
+}
+
+int PiiResultCache::hitCount() const
+{
+  QMutexLocker lock(&d->mutex);
+  return d->iHitCount;
+}
+
+int PiiResultCache::missCount() const
+{
+  QMutexLocker lock(&d->mutex);
+  return d->iMissCount;
+}
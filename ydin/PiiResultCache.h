@@ -0,0 +1,135 @@
+/* This file is part of Into.
+ * Copyright (C) Intopii 2013.
+ * All rights reserved.
+ *
+ * Licensees holding a commercial Into license may use this file in
+ * accordance with the commercial license agreement. Please see
+ * LICENSE.commercial for commercial licensing terms.
+ *
+ * Alternatively, this file may be used under the terms of the GNU
+ * Affero General Public License version 3 as published by the Free
+ * Software Foundation. In addition, Intopii gives you special rights
+ * to use Into as a part of open source software projects. Please
+ * refer to LICENSE.AGPL3 for details.
+ */
+
+
+#ifndef _PIIRESULTCACHE_H
+#define _PIIRESULTCACHE_H
+
+#include "PiiYdin.h"
+
+#include <PiiVariant.h>
+#include <QPair>
+#include <QList>
+#include <QByteArray>
+#include <QString>
+#include <QCoreApplication>
+
+/**
+ * A content-addressed store for the results of deterministic
+ * operations. PiiDefaultOperation uses a result cache to memoize
+ * processing rounds: if an operation has been flagged deterministic
+ * (see PiiDefaultOperation::setDeterministic()), the objects it
+ * emits in a round are stored under a hash of its input objects and
+ * properties (see PiiDefaultOperation::resultKey()). If the same
+ * inputs are received again with the same configuration, the stored
+ * objects are emitted without calling process().
+ *
+ * The cache always keeps recently used results in memory, bounded by
+ * [maxMemory()]. If a directory is given, results are also written
+ * to disk and survive the cache object. This makes it possible to
+ * re-run an engine on the same data with only late-stage properties
+ * changed: the unchanged upstream part of the graph will find its
+ * results from the disk.
+ *
+ * ~~~(c++)
+ * PiiResultCache cache("/var/cache/into");
+ * engine.setResultCache(&cache);
+ * engine.execute();
+ * ~~~
+ *
+ * All functions are thread-safe.
+ */
+class PII_YDIN_EXPORT PiiResultCache
+{
+public:
+  /**
+   * The objects emitted in a processing round. Each pair stores the
+   * index of an output socket and the object emitted through it, in
+   * emission order.
+   */
+  typedef QList<QPair<int,PiiVariant> > Result;
+
+  /**
+   * Creates a cache that holds the results in memory only.
+   */
+  PiiResultCache();
+  /**
+   * Creates a cache that stores the results in *directory*. The
+   * directory will be created if it doesn't exist.
+   */
+  PiiResultCache(const QString& directory);
+  ~PiiResultCache();
+
+  /**
+   * Looks up the result stored with *key*. If the result is found,
+   * stores it to *result* and returns `true`. Otherwise returns
+   * `false`.
+   */
+  bool find(const QByteArray& key, Result* result);
+
+  /**
+   * Stores *result* with *key*. If the result contains objects that
+   * cannot be serialized, it will only be held in memory.
+   */
+  void insert(const QByteArray& key, const Result& result);
+
+  /**
+   * Removes all results from memory. Results stored on disk are not
+   * removed.
+   */
+  void clear();
+
+  /**
+   * Returns the directory the results are stored in, or an empty
+   * string if the cache is memory-only.
+   */
+  QString directory() const;
+
+  /**
+   * Sets the maximum number of bytes the results kept in memory may
+   * occupy. The size of an object is measured with
+   * PiiVariant::memoryUsage(). If the limit is exceeded, the least
+   * recently used results will be dropped from memory. The default is
+   * 64 Mb.
+   */
+  void setMaxMemory(qint64 maxMemory);
+  qint64 maxMemory() const;
+
+  /**
+   * Returns the number of bytes currently used by results in memory.
+   */
+  qint64 memoryUsage() const;
+
+  /**
+   * Returns the number of successful lookups.
+   */
+  int hitCount() const;
+  /**
+   * Returns the number of failed lookups.
+   */
+  int missCount() const;
+
+private:
+  class Data;
+  Data* d;
+
+  void storeInMemory(const QByteArray& key, const Result& result);
+  QString fileName(const QByteArray& key) const;
+  static QString tr(const char* message) { return QCoreApplication::translate("PiiResultCache", message); }
+
+  PII_DISABLE_COPY(PiiResultCache);
+};
+
+#endif //_PIIRESULTCACHE_H
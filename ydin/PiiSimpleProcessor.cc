@@ -38,9 +38,8 @@ bool PiiSimpleProcessor::tryToReceive(PiiAbstractInputSocket* sender, const PiiV
     _pParentOp->setState(PiiOperation::Running);
 
   PiiInputSocket* pInput = static_cast<PiiInputSocket*>(sender);
-  if (pInput->canReceive())
+  if (pInput->tryReceive(object))
     {
-      pInput->receive(object);
       /*PiiInputSocket* pInput = static_cast<PiiInputSocket*>(sender);
       qDebug("%s: %d objects in queue",
              qPrintable(pInput->objectName()), pInput->queueLength());
@@ -83,7 +82,8 @@ bool PiiSimpleProcessor::tryToReceive(PiiAbstractInputSocket* sender, const PiiV
               switch (state)
                 {
                 case PiiFlowController::ProcessableState:
-                  _pParentOp->processLocked(); // may throw
+                  if (!_pParentOp->discardLateObjects(_pFlowController))
+                    _pParentOp->processLocked(); // may throw
                 case PiiFlowController::SynchronizedState:
                 case PiiFlowController::IncompleteState:
                   break;
@@ -133,7 +133,7 @@ bool PiiSimpleProcessor::tryToReceive(PiiAbstractInputSocket* sender, const PiiV
           _bReset = false;
           _pParentOp->setState(PiiOperation::Stopped);
         }
-    } // if (sender->canReceive())
+    } // if (pInput->tryReceive(object))
   else
     return false;
 
@@ -124,11 +124,21 @@ bool PiiThreadedProcessor::wait(unsigned long time)
 bool PiiThreadedProcessor::tryToReceive(PiiAbstractInputSocket* sender,
                                         const PiiVariant& object) throw ()
 {
-  QMutexLocker inputLock(_pStateMutex);
   PiiInputSocket* pInput = static_cast<PiiInputSocket*>(sender);
-  if (pInput->canReceive())
+  // Lock-free queues need no mutex. prepareAndProcess() resets
+  // _inputCondition before it inspects the queues, so a wake-up
+  // that follows a successful store is never lost.
+  if (pInput->queueMode() != PiiInputSocket::LockedQueue)
+    {
+      if (!pInput->tryReceive(object))
+        return false;
+      _inputCondition.wakeOne();
+      return true;
+    }
+
+  QMutexLocker inputLock(_pStateMutex);
+  if (pInput->tryReceive(object))
     {
-      pInput->receive(object);
       // Send a signal to start the next round of processing and
       // return immediately.
       _inputCondition.wakeOne();
@@ -162,7 +172,8 @@ void PiiThreadedProcessor::prepareAndProcess()
       switch (state)
         {
         case PiiFlowController::ProcessableState:
-          _pParentOp->processLocked();
+          if (!_pParentOp->discardLateObjects(_pFlowController))
+            _pParentOp->processLocked();
         case PiiFlowController::SynchronizedState:
         case PiiFlowController::IncompleteState:
           break;
@@ -183,6 +194,8 @@ void PiiThreadedProcessor::prepareAndProcess()
 
 void PiiThreadedProcessor::run()
 {
+  _pParentOp->applyThreadPlacement();
+
   synchronized (_pStateMutex)
     {
       // State may have changed before we could even start. In such a
@@ -200,7 +213,10 @@ void PiiThreadedProcessor::run()
           // received.
           if (_pFlowController != 0)
             {
-              _inputCondition.wait();
+              {
+                PiiTracer::Scope scope("wait", _pParentOp);
+                _inputCondition.wait();
+              }
               // If the waiting was terminated by interrupt(), kill
               // the thread.
               if (_pParentOp->state() == PiiOperation::Interrupted)
@@ -0,0 +1,259 @@
+/* This file is part of Into.
+ * Copyright (C) Intopii 2013.
+ * All rights reserved.
+ *
+ * Licensees holding a commercial Into license may use this file in
+ * accordance with the commercial license agreement. Please see
+ * LICENSE.commercial for commercial licensing terms.
+ *
+ * Alternatively, this file may be used under the terms of the GNU
+ * Affero General Public License version 3 as published by the Free
+ * Software Foundation. In addition, Intopii gives you special rights
+ * to use Into as a part of open source software projects. Please
+ * refer to LICENSE.AGPL3 for details.
+ */
+
+
+#include "PiiTracer.h"
+
+#include <PiiTimer.h>
+#include <PiiUtil.h>
+#include <PiiException.h>
+
+#include <QCoreApplication>
+#include <QFile>
+#include <QList>
+#include <QMutex>
+#include <QObject>
+#include <QThread>
+#include <QThreadStorage>
+#include <QVector>
+
+struct PiiTraceEvent
+{
+  PiiTraceEvent() : iTime(0), iDuration(-1), pCategory(0), iValue(0) {}
+
+  qint64 iTime;
+  // A negative duration marks an instantaneous event.
+  qint64 iDuration;
+  const char* pCategory;
+  QString strName, strOwner;
+  int iValue;
+};
+
+struct PiiTraceBuffer
+{
+  PiiTraceBuffer(int threadId, const QString& threadName, int size) :
+    iThreadId(threadId),
+    strThreadName(threadName),
+    vecEvents(size),
+    uiCount(0),
+    bOrphaned(false)
+  {}
+
+  void record(qint64 time, qint64 duration, const char* category, const QObject* object, int value)
+  {
+    QMutexLocker lock(&mutex);
+    PiiTraceEvent& event = vecEvents[int(uiCount % quint64(vecEvents.size()))];
+    event.iTime = time;
+    event.iDuration = duration;
+    event.pCategory = category;
+    if (object != 0)
+      {
+        event.strName = object->objectName();
+        event.strOwner = object->parent() != 0 ? object->parent()->objectName() : QString();
+      }
+    else
+      {
+        event.strName = QString();
+        event.strOwner = QString();
+      }
+    event.iValue = value;
+    ++uiCount;
+  }
+
+  // Protects the events against concurrent reads. Only the owning
+  // thread writes, so the lock is never contended while running.
+  QMutex mutex;
+  int iThreadId;
+  QString strThreadName;
+  QVector<PiiTraceEvent> vecEvents;
+  // The total number of events recorded. The next event goes to
+  // uiCount % size.
+  quint64 uiCount;
+  // Set when the thread exits. Orphaned buffers are deleted by
+  // start() and clear().
+  bool bOrphaned;
+};
+
+struct PiiTraceThreadState
+{
+  PiiTraceThreadState(PiiTraceBuffer* buffer) :
+    pBuffer(buffer), iDepth(0), bSampled(false)
+  {}
+
+  ~PiiTraceThreadState()
+  {
+    QMutexLocker lock(&pBuffer->mutex);
+    pBuffer->bOrphaned = true;
+  }
+
+  PiiTraceBuffer* pBuffer;
+  // Nesting level of scoped events.
+  int iDepth;
+  // Whether the current top-level event is recorded.
+  bool bSampled;
+};
+
+PiiAtomicInt PiiTracer::_iEnabled(0);
+
+static QMutex traceMutex;
+static QList<PiiTraceBuffer*> lstTraceBuffers;
+static const qint64 iTraceWindowLength = 100000;
+static int iTraceSamplingInterval = 1;
+static int iTraceBufferSize = 16384;
+static int iNextTraceThreadId = 0;
+static QThreadStorage<PiiTraceThreadState*> traceThreadStates;
+
+static PiiTraceThreadState* localTraceState()
+{
+  if (!traceThreadStates.hasLocalData())
+    {
+      QMutexLocker lock(&traceMutex);
+      QString strThreadName;
+      if (QThread::currentThread() != 0)
+        strThreadName = QThread::currentThread()->objectName();
+      if (strThreadName.isEmpty())
+        strThreadName = QString("Thread %1").arg(iNextTraceThreadId);
+      PiiTraceBuffer* pBuffer = new PiiTraceBuffer(iNextTraceThreadId++, strThreadName, iTraceBufferSize);
+      lstTraceBuffers << pBuffer;
+      traceThreadStates.setLocalData(new PiiTraceThreadState(pBuffer));
+    }
+  return traceThreadStates.localData();
+}
+
+// traceMutex must be held when calling this function.
+static void clearTraceBuffers(int bufferSize)
+{
+  for (int i=lstTraceBuffers.size(); i--; )
+    {
+      PiiTraceBuffer* pBuffer = lstTraceBuffers[i];
+      pBuffer->mutex.lock();
+      if (pBuffer->bOrphaned)
+        {
+          pBuffer->mutex.unlock();
+          delete lstTraceBuffers.takeAt(i);
+          continue;
+        }
+      pBuffer->vecEvents = QVector<PiiTraceEvent>(bufferSize);
+      pBuffer->uiCount = 0;
+      pBuffer->mutex.unlock();
+    }
+}
+
+void PiiTracer::start(int samplingInterval, int bufferSize)
+{
+  QMutexLocker lock(&traceMutex);
+  iTraceSamplingInterval = qMax(samplingInterval, 1);
+  iTraceBufferSize = qMax(bufferSize, 1);
+  clearTraceBuffers(iTraceBufferSize);
+  _iEnabled.storeRelease(1);
+}
+
+void PiiTracer::stop()
+{
+  _iEnabled.storeRelease(0);
+}
+
+void PiiTracer::clear()
+{
+  QMutexLocker lock(&traceMutex);
+  clearTraceBuffers(iTraceBufferSize);
+}
+
+PiiTraceThreadState* PiiTracer::enter()
+{
+  PiiTraceThreadState* pState = localTraceState();
+  if (pState->iDepth++ == 0)
+    pState->bSampled = iTraceSamplingInterval == 1 ||
+      PiiTimer::currentTime() / iTraceWindowLength % iTraceSamplingInterval == 0;
+  return pState;
+}
+
+qint64 PiiTracer::timeIfSampled(PiiTraceThreadState* state)
+{
+  return state->bSampled ? PiiTimer::currentTime() : -1;
+}
+
+void PiiTracer::leave(PiiTraceThreadState* state, const char* category, const QObject* object, qint64 startTime)
+{
+  if (startTime >= 0)
+    state->pBuffer->record(startTime, PiiTimer::currentTime() - startTime, category, object, 0);
+  --state->iDepth;
+}
+
+void PiiTracer::recordInstant(const char* category, const QObject* object, int value)
+{
+  PiiTraceThreadState* pState = localTraceState();
+  if (pState->iDepth > 0 && pState->bSampled)
+    pState->pBuffer->record(PiiTimer::currentTime(), -1, category, object, value);
+}
+
+static QByteArray traceString(const QString& str)
+{
+  return '"' + Pii::escape(str).toUtf8() + '"';
+}
+
+int PiiTracer::write(QIODevice* device)
+{
+  QMutexLocker lock(&traceMutex);
+  const QByteArray aPid(QByteArray::number(QCoreApplication::applicationPid()));
+  int iEventCount = 0;
+
+  device->write("{\"traceEvents\":[\n");
+  for (int b=0; b<lstTraceBuffers.size(); ++b)
+    {
+      PiiTraceBuffer* pBuffer = lstTraceBuffers[b];
+      QMutexLocker bufferLock(&pBuffer->mutex);
+      const QByteArray aIds(",\"pid\":" + aPid + ",\"tid\":" + QByteArray::number(pBuffer->iThreadId));
+
+      device->write((b != 0 ? ",\n" : "") +
+                    QByteArray("{\"ph\":\"M\",\"name\":\"thread_name\"") + aIds +
+                    ",\"args\":{\"name\":" + traceString(pBuffer->strThreadName) + "}}");
+
+      // Oldest events first
+      const quint64 uiSize = quint64(pBuffer->vecEvents.size());
+      const quint64 uiFirst = pBuffer->uiCount > uiSize ? pBuffer->uiCount - uiSize : 0;
+      for (quint64 i=uiFirst; i<pBuffer->uiCount; ++i)
+        {
+          const PiiTraceEvent& event = pBuffer->vecEvents[int(i % uiSize)];
+          QString strName(event.strOwner.isEmpty() ?
+                          event.strName :
+                          event.strOwner + '.' + event.strName);
+          QByteArray aEvent(",\n{\"ph\":");
+          aEvent += event.iDuration >= 0 ? "\"X\"" : "\"i\",\"s\":\"t\"";
+          aEvent += ",\"cat\":\"";
+          aEvent += event.pCategory;
+          aEvent += "\",\"name\":" + traceString(strName);
+          aEvent += ",\"ts\":" + QByteArray::number(event.iTime);
+          if (event.iDuration >= 0)
+            aEvent += ",\"dur\":" + QByteArray::number(event.iDuration);
+          aEvent += aIds;
+          if (event.iDuration < 0)
+            aEvent += ",\"args\":{\"value\":" + QByteArray::number(event.iValue) + "}";
+          aEvent += '}';
+          device->write(aEvent);
+          ++iEventCount;
+        }
+    }
+  device->write("\n],\"displayTimeUnit\":\"ms\"}\n");
+  return iEventCount;
+}
+
+int PiiTracer::save(const QString& fileName)
+{
+  QFile file(fileName);
+  if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate))
+    PII_THROW(PiiException, QCoreApplication::translate("PiiTracer", "Cannot open %1 for writing.").arg(fileName));
+  return write(&file);
+}
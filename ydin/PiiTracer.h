@@ -0,0 +1,165 @@
+/* This file is part of Into.
+ * Copyright (C) Intopii 2013.
+ * All rights reserved.
+ *
+ * Licensees holding a commercial Into license may use this file in
+ * accordance with the commercial license agreement. Please see
+ * LICENSE.commercial for commercial licensing terms.
+ *
+ * Alternatively, this file may be used under the terms of the GNU
+ * Affero General Public License version 3 as published by the Free
+ * Software Foundation. In addition, Intopii gives you special rights
+ * to use Into as a part of open source software projects. Please
+ * refer to LICENSE.AGPL3 for details.
+ */
+
+
+#ifndef _PIITRACER_H
+#define _PIITRACER_H
+
+#include "PiiYdin.h"
+
+#include <PiiAtomicInt.h>
+
+class QIODevice;
+class QObject;
+/// @internal
+struct PiiTraceThreadState;
+
+/**
+ * Records execution timelines. When tracing is enabled, operations,
+ * sockets and processors record the start and duration of
+ * processing rounds, emissions, sync events and waits. The events
+ * are collected to a fixed-size ring buffer for each thread, so only
+ * the most recent events are retained. The collected trace can be
+ * written in the Chrome trace event format, which can be viewed in
+ * chrome://tracing or the Perfetto UI.
+ *
+ * ~~~(c++)
+ * // Trace one 100 ms window out of every ten.
+ * PiiTracer::start(10);
+ * engine.execute();
+ * // ... let it run ...
+ * PiiTracer::stop();
+ * PiiTracer::save("engine-trace.json");
+ * ~~~
+ *
+ * To keep the overhead low in production, tracing can be sampled.
+ * Time is divided into windows of 100 milliseconds, and only events
+ * that start in every *samplingInterval*th window are recorded. The
+ * decision is made when a top-level event, such as a processing
+ * round, starts. Events nested inside it (such as emissions during
+ * the round) follow the same decision, so each recorded window
+ * contains complete timelines of all threads. When tracing is
+ * disabled, the overhead of a trace point is a single atomic load.
+ */
+class PII_YDIN_EXPORT PiiTracer
+{
+public:
+  class Scope;
+  friend class Scope;
+
+  /**
+   * Scoped trace event. The constructor marks the start of an event,
+   * and the destructor records it. The name of the event is *object*'s
+   * object name, prefixed with that of its parent, if any. *category*
+   * must be a string literal.
+   *
+   * ~~~(c++)
+   * void MyOperation::process()
+   * {
+   *   PiiTracer::Scope scope("my-phase", this);
+   *   doSomethingExpensive();
+   * }
+   * ~~~
+   */
+  class Scope
+  {
+  public:
+    Scope(const char* category, const QObject* object) :
+      _pState(PiiTracer::isEnabled() ? PiiTracer::enter() : 0)
+    {
+      if (_pState != 0)
+        {
+          _pCategory = category;
+          _pObject = object;
+          _iStartTime = PiiTracer::timeIfSampled(_pState);
+        }
+    }
+
+    ~Scope()
+    {
+      if (_pState != 0)
+        PiiTracer::leave(_pState, _pCategory, _pObject, _iStartTime);
+    }
+
+  private:
+    PiiTraceThreadState* _pState;
+    const char* _pCategory;
+    const QObject* _pObject;
+    qint64 _iStartTime;
+  };
+
+  /**
+   * Starts tracing and discards previously collected events.
+   *
+   * @param samplingInterval record events in every
+   * *samplingInterval*th 100 ms window. 1 records everything.
+   *
+   * @param bufferSize the number of events retained for each
+   * thread.
+   */
+  static void start(int samplingInterval = 1, int bufferSize = 16384);
+
+  /**
+   * Stops tracing. Collected events are retained until [start()] or
+   * [clear()] is called.
+   */
+  static void stop();
+
+  /**
+   * Returns `true` if tracing is enabled.
+   */
+  static bool isEnabled() { return _iEnabled.load() != 0; }
+
+  /**
+   * Discards all collected events.
+   */
+  static void clear();
+
+  /**
+   * Records an instantaneous event with an integer *value*, for
+   * example the length of a queue after an object has been received.
+   * The event is recorded only if it happens inside a sampled scoped
+   * event.
+   */
+  static void instant(const char* category, const QObject* object, int value)
+  {
+    if (isEnabled())
+      recordInstant(category, object, value);
+  }
+
+  /**
+   * Writes the collected events to *device* in the Chrome trace
+   * event (JSON) format. Returns the number of events written.
+   */
+  static int write(QIODevice* device);
+
+  /**
+   * Writes the collected events to *fileName*.
+   *
+   * @exception PiiException& if the file cannot be opened for
+   * writing.
+   */
+  static int save(const QString& fileName);
+
+private:
+  static PiiTraceThreadState* enter();
+  static qint64 timeIfSampled(PiiTraceThreadState* state);
+  static void leave(PiiTraceThreadState* state, const char* category, const QObject* object, qint64 startTime);
+  static void recordInstant(const char* category, const QObject* object, int value);
+
+  static PiiAtomicInt _iEnabled;
+};
+
+#endif //_PIITRACER_H
@@ -0,0 +1,234 @@
+/* This file is part of Into.
+ * Copyright (C) Intopii 2013.
+ * All rights reserved.
+ *
+ * Licensees holding a commercial Into license may use this file in
+ * accordance with the commercial license agreement. Please see
+ * LICENSE.commercial for commercial licensing terms.
+ *
+ * Alternatively, this file may be used under the terms of the GNU
+ * Affero General Public License version 3 as published by the Free
+ * Software Foundation. In addition, Intopii gives you special rights
+ * to use Into as a part of open source software projects. Please
+ * refer to LICENSE.AGPL3 for details.
+ */
+
+
+#ifndef _PIITYPEDISPATCHER_H
+#define _PIITYPEDISPATCHER_H
+
+#include "PiiYdinTypes.h"
+
+/**
+ * A table of functions indexed by variant type ID. PiiTypeDispatcher
+ * replaces the switch statements generated by the case macros in
+ * PiiYdinTypes.h when the same dispatch is done repeatedly. The table
+ * is filled once, typically in [PiiOperation::check()] or in a
+ * function-local static variable, and each object is then dispatched
+ * with a single indexed load.
+ *
+ * The benefit is greatest with multiple inputs or a configurable
+ * output type. A nested switch instantiates and branches through
+ * every combination on each call. With a dispatcher, the part of the
+ * selection that depends on configuration is done once, and only the
+ * type of the incoming object needs to be looked up.
+ *
+ * ~~~(c++)
+ * // MyOperation.h
+ * typedef void (MyOperation::*ProcessFunction)(const PiiVariant&);
+ * template <class T> void operate(const PiiVariant& obj);
+ *
+ * // MyOperation.cc
+ * void MyOperation::check(bool reset)
+ * {
+ *   PiiDefaultOperation::check(reset);
+ *   PII_D;
+ *   d->processors.clear();
+ *   PII_NUMERIC_MATRIX_DISPATCH(d->processors, &MyOperation::operate);
+ * }
+ *
+ * void MyOperation::process()
+ * {
+ *   PiiVariant obj = readInput();
+ *   ProcessFunction pProcess = _d()->processors[obj.type()];
+ *   if (pProcess == 0)
+ *     PII_THROW_UNKNOWN_TYPE(inputAt(0));
+ *   (this->*pProcess)(obj);
+ * }
+ * ~~~
+ *
+ * Only the type IDs reserved by Ydin (below 0x100) can be stored in
+ * the table. Lookups with larger IDs return zero.
+ *
+ * @ingroup Ydin
+ */
+template <class Function> class PiiTypeDispatcher
+{
+public:
+  enum { TableSize = 0x100 };
+
+  /**
+   * Creates an empty table.
+   */
+  PiiTypeDispatcher() { clear(); }
+
+  /**
+   * Sets all functions to zero.
+   */
+  void clear()
+  {
+    for (int i=0; i<TableSize; ++i)
+      _functions[i] = 0;
+  }
+
+  /**
+   * Sets the function that handles objects of the given *type*. If
+   * *type* is out of range, does nothing.
+   */
+  void set(unsigned int type, Function function)
+  {
+    if (type < TableSize)
+      _functions[type] = function;
+  }
+
+  /**
+   * Returns `true` if there is a function for *type*, `false`
+   * otherwise.
+   */
+  bool contains(unsigned int type) const { return operator[] (type) != 0; }
+
+  /**
+   * Returns the function that handles objects of the given *type*,
+   * or zero if there is no such function.
+   */
+  Function operator[] (unsigned int type) const
+  {
+    return type < TableSize ? _functions[type] : Function(0);
+  }
+
+private:
+  Function _functions[TableSize];
+};
+
+/// @internal
+#define PII_DO_DISPATCH(dispatcher, func, type, TYPE) (dispatcher).set(type, func<TYPE >)
+
+/// @internal
+#define PII_DO_NUMERIC_DISPATCH(dispatcher, func, offset)                                 \
+  PII_DO_DISPATCH(dispatcher, func, (offset) + PiiVariant::CharType, char);               \
+  PII_DO_DISPATCH(dispatcher, func, (offset) + PiiVariant::ShortType, short);             \
+  PII_DO_DISPATCH(dispatcher, func, (offset) + PiiVariant::IntType, int);                 \
+  PII_DO_DISPATCH(dispatcher, func, (offset) + PiiVariant::Int64Type, qint64);            \
+  PII_DO_DISPATCH(dispatcher, func, (offset) + PiiVariant::UnsignedCharType, unsigned char); \
+  PII_DO_DISPATCH(dispatcher, func, (offset) + PiiVariant::UnsignedShortType, unsigned short); \
+  PII_DO_DISPATCH(dispatcher, func, (offset) + PiiVariant::UnsignedIntType, unsigned int); \
+  PII_DO_DISPATCH(dispatcher, func, (offset) + PiiVariant::UnsignedInt64Type, quint64);   \
+  PII_DO_DISPATCH(dispatcher, func, (offset) + PiiVariant::FloatType, float);             \
+  PII_DO_DISPATCH(dispatcher, func, (offset) + PiiVariant::DoubleType, double)
+
+/**
+ * Stores `func<T>` to *dispatcher* for all numeric primitive types.
+ * The table entries are the same as the case clauses generated by
+ * [PII_NUMERIC_CASES].
+ *
+ * ~~~(c++)
+ * template <class T> void print(const PiiVariant& obj)
+ * {
+ *   qDebug() << obj.valueAs<T>();
+ * }
+ *
+ * PiiTypeDispatcher<void (*)(const PiiVariant&)> dispatcher;
+ * PII_NUMERIC_DISPATCH(dispatcher, &print);
+ * ~~~
+ *
+ * @param dispatcher a PiiTypeDispatcher
+ *
+ * @param func the address of a function template with one template
+ * parameter. To pass a member function template of a class template,
+ * use the `template` keyword:
+ * `&MyClass<T>::template function`.
+ */
+#define PII_NUMERIC_DISPATCH(dispatcher, func) PII_DO_NUMERIC_DISPATCH(dispatcher, func, 0)
+
+/**
+ * Stores `func<T>` to *dispatcher* for all numeric matrix types. *T*
+ * is the element type of the matrix as in [PII_NUMERIC_MATRIX_CASES].
+ */
+#define PII_NUMERIC_MATRIX_DISPATCH(dispatcher, func) PII_DO_NUMERIC_DISPATCH(dispatcher, func, 0x40)
+
+/**
+ * Stores `func<T>` to *dispatcher* for all complex matrix types. *T*
+ * is the element type of the matrix as in [PII_COMPLEX_MATRIX_CASES].
+ */
+#define PII_COMPLEX_MATRIX_DISPATCH(dispatcher, func)                               \
+  PII_DO_DISPATCH(dispatcher, func, PiiYdin::FloatComplexMatrixType, std::complex<float>); \
+  PII_DO_DISPATCH(dispatcher, func, PiiYdin::DoubleComplexMatrixType, std::complex<double>)
+
+/**
+ * Stores `func<T>` to *dispatcher* for all color image types. *T* is
+ * the pixel type as in [PII_COLOR_IMAGE_CASES].
+ */
+#define PII_COLOR_IMAGE_DISPATCH(dispatcher, func)                                  \
+  PII_DO_DISPATCH(dispatcher, func, PiiYdin::UnsignedCharColorMatrixType, PiiColor<unsigned char>); \
+  PII_DO_DISPATCH(dispatcher, func, PiiYdin::UnsignedCharColor4MatrixType, PiiColor4<unsigned char>); \
+  PII_DO_DISPATCH(dispatcher, func, PiiYdin::UnsignedShortColorMatrixType, PiiColor<unsigned short>); \
+  PII_DO_DISPATCH(dispatcher, func, PiiYdin::FloatColorMatrixType, PiiColor<float>)
+
+namespace PiiYdin
+{
+  /// @internal
+  template <class T> struct NumericConverter
+  {
+    template <class U> static T primitive(const PiiVariant& obj)
+    {
+      return T(obj.valueAs<U>());
+    }
+    template <class U> static PiiMatrix<T> matrix(const PiiVariant& obj)
+    {
+      return PiiMatrix<T>(obj.valueAs<PiiMatrix<U> >());
+    }
+
+    static PiiTypeDispatcher<T (*)(const PiiVariant&)> createPrimitiveConverters()
+    {
+      PiiTypeDispatcher<T (*)(const PiiVariant&)> dispatcher;
+      PII_NUMERIC_DISPATCH(dispatcher, &NumericConverter::template primitive);
+      return dispatcher;
+    }
+    static PiiTypeDispatcher<PiiMatrix<T> (*)(const PiiVariant&)> createMatrixConverters()
+    {
+      PiiTypeDispatcher<PiiMatrix<T> (*)(const PiiVariant&)> dispatcher;
+      PII_NUMERIC_MATRIX_DISPATCH(dispatcher, &NumericConverter::template matrix);
+      return dispatcher;
+    }
+  };
+
+  /**
+   * Returns a table of functions that convert any numeric primitive
+   * type to *T*. The table is created on first use.
+   *
+   * ~~~(c++)
+   * double (*convert)(const PiiVariant&) = PiiYdin::primitiveConverters<double>()[obj.type()];
+   * if (convert != 0)
+   *   dValue = convert(obj);
+   * ~~~
+   */
+  template <class T> const PiiTypeDispatcher<T (*)(const PiiVariant&)>& primitiveConverters()
+  {
+    static const PiiTypeDispatcher<T (*)(const PiiVariant&)>
+      dispatcher(NumericConverter<T>::createPrimitiveConverters());
+    return dispatcher;
+  }
+
+  /**
+   * Returns a table of functions that convert any numeric matrix to
+   * `PiiMatrix<T>`. The table is created on first use.
+   */
+  template <class T> const PiiTypeDispatcher<PiiMatrix<T> (*)(const PiiVariant&)>& matrixConverters()
+  {
+    static const PiiTypeDispatcher<PiiMatrix<T> (*)(const PiiVariant&)>
+      dispatcher(NumericConverter<T>::createMatrixConverters());
+    return dispatcher;
+  }
+}
+
+#endif //_PIITYPEDISPATCHER_H
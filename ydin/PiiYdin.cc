@@ -19,6 +19,10 @@
 #include "PiiProbeInput.h"
 #include "PiiDefaultOperation.h"
 
+#include <QThread>
+
+static PII_THREAD_LOCAL Qt::HANDLE pActiveThreadId = 0;
+
 namespace PiiYdin
 {
   const char* classPredicate = "pii:class";
@@ -33,6 +37,17 @@ namespace PiiYdin
     return &database;
   }
 
+  Qt::HANDLE activeThreadId()
+  {
+    Qt::HANDLE id = pActiveThreadId;
+    return id != 0 ? id : QThread::currentThreadId();
+  }
+
+  void setActiveThreadId(Qt::HANDLE id)
+  {
+    pActiveThreadId = id;
+  }
+
   template <class T> inline const char* resourceName();
   template <> inline const char* resourceName<PiiSocket>()
   {
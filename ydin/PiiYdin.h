@@ -146,6 +146,25 @@ namespace PiiYdin
    * repeating the string literal to save memory.
    */
   extern PII_YDIN_EXPORT const char* metaObjectPredicate;
+
+  /**
+   * Returns an id that identifies the calling thread in the emission
+   * queues of output sockets (see PiiOutputSocket::startEmit()) and
+   * in the object assignments of input sockets (see
+   * PiiInputSocket::assignFirstObject()). Usually, the id is the same
+   * as QThread::currentThreadId(). When a processing round is
+   * executed in a shared thread pool, the thread takes the id of the
+   * round for the duration of the round.
+   */
+  PII_YDIN_EXPORT Qt::HANDLE activeThreadId();
+
+  /**
+   * Sets the id returned by [activeThreadId()] in the calling thread.
+   * Setting the id to zero restores the default.
+   *
+   * @internal
+   */
+  PII_YDIN_EXPORT void setActiveThreadId(Qt::HANDLE id);
 }
 
 #endif //_PIIYDIN_H
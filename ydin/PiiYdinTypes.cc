@@ -85,6 +85,11 @@ PII_REGISTER_VARIANT_TYPE(PiiSocketState);
 
 PII_MAP_VARIANT_ID_TO_TYPE(PiiYdin::ReconfigurationTagType, QString);
 
+qint64 Pii::MemoryUsage<QImage>::heapBytes(const QImage& image)
+{
+  return qint64(image.byteCount());
+}
+
 
 namespace PiiYdin
 {
@@ -971,6 +971,44 @@ public:
 
 }; // namespace PiiYdin
 
+/// @hide
+namespace Pii
+{
+  // The buffer of a matrix is allocated in one block with its header.
+  template <class T> struct MemoryUsage<PiiMatrix<T> >
+  {
+    static qint64 heapBytes(const PiiMatrix<T>& matrix)
+    {
+      return qint64(PiiMatrixData::headerSize() + std::size_t(matrix.capacity()) * matrix.stride());
+    }
+  };
+
+  template <> struct MemoryUsage<QString>
+  {
+    static qint64 heapBytes(const QString& str)
+    {
+      return qint64(sizeof(QString)) + qint64(str.capacity() + 1) * qint64(sizeof(QChar));
+    }
+  };
+
+  template <> struct MemoryUsage<QStringList>
+  {
+    static qint64 heapBytes(const QStringList& lst)
+    {
+      qint64 lBytes = qint64(sizeof(QStringList)) + qint64(lst.size()) * qint64(sizeof(void*));
+      for (int i=0; i<lst.size(); ++i)
+        lBytes += MemoryUsage<QString>::heapBytes(lst[i]);
+      return lBytes;
+    }
+  };
+
+  template <> struct MemoryUsage<QImage>
+  {
+    static PII_YDIN_EXPORT qint64 heapBytes(const QImage& image);
+  };
+}
+/// @endhide
+
 #ifndef Q_MOC_RUN // moc fails
 
 // Declares both PiiVariant and QVariant
@@ -0,0 +1,176 @@
+/* This file is part of Into.
+ * Copyright (C) Intopii 2013.
+ * All rights reserved.
+ *
+ * Licensees holding a commercial Into license may use this file in
+ * accordance with the commercial license agreement. Please see
+ * LICENSE.commercial for commercial licensing terms.
+ *
+ * Alternatively, this file may be used under the terms of the GNU
+ * Affero General Public License version 3 as published by the Free
+ * Software Foundation. In addition, Intopii gives you special rights
+ * to use Into as a part of open source software projects. Please
+ * refer to LICENSE.AGPL3 for details.
+ */
+
+#include "PiiOperationNodeServer.h"
+
+#include "PiiOperationServer.h"
+#include "PiiEngine.h"
+
+#include <PiiHttpDevice.h>
+#include <PiiHttpException.h>
+#include <PiiStreamBuffer.h>
+#include <PiiSerializationUtil.h>
+#include <PiiGenericTextInputArchive.h>
+#include <PiiSynchronized.h>
+
+#include <QBuffer>
+#include <QHash>
+#include <QMutex>
+#include <QSharedPointer>
+#include <QStringList>
+#include <QUuid>
+
+class PiiOperationNodeServer::Instance
+{
+public:
+  Instance(PiiOperation* operation) :
+    pOperation(operation),
+    pServer(new PiiOperationServer(operation))
+  {}
+
+  ~Instance()
+  {
+    pOperation->interrupt();
+    pOperation->wait(5000);
+    delete pServer;
+    delete pOperation;
+  }
+
+  PiiOperation* pOperation;
+  PiiOperationServer* pServer;
+
+private:
+  PII_DISABLE_COPY(Instance);
+};
+
+class PiiOperationNodeServer::Data
+{
+public:
+  Data() : iMaxDeploymentSize(64 << 20) {}
+
+  mutable QMutex instanceMutex;
+  // Requests in progress keep their instance alive even if it is
+  // removed meanwhile.
+  QHash<QString,QSharedPointer<Instance> > hashInstances;
+  qint64 iMaxDeploymentSize;
+};
+
+PiiOperationNodeServer::PiiOperationNodeServer() :
+  d(new Data)
+{}
+
+PiiOperationNodeServer::~PiiOperationNodeServer()
+{
+  delete d;
+}
+
+int PiiOperationNodeServer::operationCount() const
+{
+  QMutexLocker lock(&d->instanceMutex);
+  return d->hashInstances.size();
+}
+
+void PiiOperationNodeServer::setMaxDeploymentSize(qint64 maxDeploymentSize) { d->iMaxDeploymentSize = maxDeploymentSize; }
+qint64 PiiOperationNodeServer::maxDeploymentSize() const { return d->iMaxDeploymentSize; }
+
+void PiiOperationNodeServer::handleRequest(const QString& uri, PiiHttpDevice* dev,
+                                           PiiHttpProtocol::TimeLimiter* controller)
+{
+  QString strRequestPath = dev->requestPath(uri);
+
+  if (strRequestPath.isEmpty())
+    {
+      PII_REQUIRE_HTTP_METHOD("GET");
+      dev->startOutputFiltering(new PiiStreamBuffer);
+      QMutexLocker lock(&d->instanceMutex);
+      dev->print(QStringList(d->hashInstances.keys()).join("\n"));
+    }
+  else if (strRequestPath == "deploy")
+    {
+      PII_REQUIRE_HTTP_METHOD("POST");
+      dev->startOutputFiltering(new PiiStreamBuffer);
+      dev->print(deploy(dev));
+    }
+  else if (strRequestPath == "remove")
+    {
+      PII_REQUIRE_HTTP_METHOD("POST");
+      dev->startOutputFiltering(new PiiStreamBuffer);
+      remove(QString::fromUtf8(dev->readBody()).trimmed());
+    }
+  else
+    {
+      int iSlashIndex = strRequestPath.indexOf('/');
+      if (iSlashIndex == -1)
+        PII_THROW_HTTP_ERROR(NotFoundStatus);
+      QString strInstanceId = strRequestPath.left(iSlashIndex);
+      QSharedPointer<Instance> pInstance;
+      synchronized (d->instanceMutex)
+        pInstance = d->hashInstances.value(strInstanceId);
+      if (pInstance.isNull())
+        PII_THROW_HTTP_ERROR(NotFoundStatus);
+      // Channels may stay in this call for a long time. The instance
+      // mutex must not be held.
+      pInstance->pServer->handleRequest(uri + strInstanceId + "/", dev, controller);
+    }
+}
+
+QString PiiOperationNodeServer::deploy(PiiHttpDevice* dev)
+{
+  dev->setMessageSizeLimit(d->iMaxDeploymentSize);
+  QByteArray aArchive(dev->readBody());
+  PiiOperation* pOperation = 0;
+  try
+    {
+      QBuffer buffer(&aArchive);
+      buffer.open(QIODevice::ReadOnly);
+      PiiGenericTextInputArchive ia(&buffer);
+      QVariantMap mapConfig;
+      ia >> PII_NVP("config", mapConfig);
+      PiiEngine::ensurePlugins(mapConfig["plugins"].toStringList());
+      ia >> PII_NVP("operation", pOperation);
+    }
+  catch (PiiSerializationException& ex)
+    {
+      PII_THROW_HTTP_ERROR_MSG(BadRequestStatus, ex.message() + " (" + ex.info() + ")");
+    }
+  catch (PiiException& ex)
+    {
+      PII_THROW_HTTP_ERROR_MSG(InternalServerErrorStatus, ex.message());
+    }
+  if (pOperation == 0)
+    PII_THROW_HTTP_ERROR(BadRequestStatus);
+
+  // The operation was created in a server thread that may exit soon.
+  pOperation->moveToThread(thread());
+
+  // Remove curly braces around the uuid
+  QString strId = QUuid::createUuid().toString().mid(1);
+  strId.chop(1);
+  QSharedPointer<Instance> pInstance(new Instance(pOperation));
+  synchronized (d->instanceMutex)
+    d->hashInstances.insert(strId, pInstance);
+  return strId;
+}
+
+void PiiOperationNodeServer::remove(const QString& instanceId)
+{
+  QSharedPointer<Instance> pInstance;
+  synchronized (d->instanceMutex)
+    pInstance = d->hashInstances.take(instanceId);
+  if (pInstance.isNull())
+    PII_THROW_HTTP_ERROR(NotFoundStatus);
+  // The instance will be deleted once the last request to it
+  // finishes.
+}
@@ -0,0 +1,97 @@
+/* This file is part of Into.
+ * Copyright (C) Intopii 2013.
+ * All rights reserved.
+ *
+ * Licensees holding a commercial Into license may use this file in
+ * accordance with the commercial license agreement. Please see
+ * LICENSE.commercial for commercial licensing terms.
+ *
+ * Alternatively, this file may be used under the terms of the GNU
+ * Affero General Public License version 3 as published by the Free
+ * Software Foundation. In addition, Intopii gives you special rights
+ * to use Into as a part of open source software projects. Please
+ * refer to LICENSE.AGPL3 for details.
+ */
+
+#ifndef _PIIOPERATIONNODESERVER_H
+#define _PIIOPERATIONNODESERVER_H
+
+#include <PiiHttpProtocol.h>
+#include <PiiYdin.h>
+
+#include <QObject>
+
+/**
+ * A server that runs operations deployed by remote engines. A node
+ * server makes it possible to partition a processing graph to
+ * many computers: the engine serializes a part of the graph, posts
+ * it to a node, and controls it through a PiiRemoteOperation. Each
+ * deployed operation is served by a PiiOperationServer of its own.
+ *
+ * ~~~(c++)
+ * // On each node
+ * PiiHttpServer* pServer = PiiHttpServer::addServer("node", "tcp://0.0.0.0:3142");
+ * PiiOperationNodeServer nodeServer;
+ * pServer->protocol()->registerUriHandler("/node/", &nodeServer);
+ * pServer->start();
+ * ~~~
+ *
+ * The server handles the following requests:
+ *
+ * - `POST deploy` - the body of the request is a text archive that
+ * contains a configuration map and an operation. The plugins listed
+ * in the "plugins" entry of the map are loaded before the operation
+ * is created. The response body is the ID of the new instance.
+ *
+ * - `POST remove` - the body contains the ID of an instance to be
+ * interrupted and deleted.
+ *
+ * - `GET ` - lists the IDs of deployed instances.
+ *
+ * All other requests are passed to the instance whose ID matches
+ * the first component of the path. For example, the inputs of a
+ * deployed operation are listed at "/node/<id>/inputs/".
+ *
+ * Deployed operations are deleted when the node server is
+ * destroyed.
+ *
+ * @see PiiRemoteOperation::deploy()
+ */
+class PII_YDIN_EXPORT PiiOperationNodeServer :
+  public QObject,
+  public PiiHttpProtocol::UriHandler
+{
+  Q_OBJECT
+  Q_INTERFACES(PiiHttpProtocol::UriHandler)
+
+public:
+  PiiOperationNodeServer();
+  ~PiiOperationNodeServer();
+
+  void handleRequest(const QString& uri, PiiHttpDevice* dev,
+                     PiiHttpProtocol::TimeLimiter* controller);
+
+  /**
+   * Returns the number of operations currently deployed to this
+   * node.
+   */
+  int operationCount() const;
+
+  /**
+   * Sets the maximum size of a deployment request in bytes. The
+   * default is 64 MiB.
+   */
+  void setMaxDeploymentSize(qint64 maxDeploymentSize);
+  qint64 maxDeploymentSize() const;
+
+private:
+  class Instance;
+  class Data;
+  Data* d;
+
+  QString deploy(PiiHttpDevice* dev);
+  void remove(const QString& instanceId);
+  PII_DISABLE_COPY(PiiOperationNodeServer);
+};
+
+#endif //_PIIOPERATIONNODESERVER_H
@@ -18,17 +18,26 @@
 #include "PiiHttpDevice.h"
 #include "PiiHttpException.h"
 #include "PiiStreamBuffer.h"
+#include "PiiWireFormat.h"
+#include "PiiSharedMemoryRing.h"
+#include "PiiEngine.h"
+
+#include <PiiDelay.h>
 
 #include <PiiSerializationUtil.h>
 #include <PiiGenericTextInputArchive.h>
 #include <PiiGenericTextOutputArchive.h>
 
+static const int iMaxPushRetries = 400;
+
 PiiOperationServer::Data::Data(PiiOperation* operation) :
   PiiQObjectServer::Data(operation,
                          PiiQObjectServer::ExposeSignals |
                          PiiQObjectServer::ExposeSlots |
                          PiiQObjectServer::ExposeProperties |
-                         PiiQObjectServer::ExposeDynamicProperties)
+                         PiiQObjectServer::ExposeDynamicProperties),
+  pushFormat(FramedBinaryFormat),
+  pSharedMemoryRing(0)
 {}
 
 PiiOperationServer::Data::~Data()
@@ -50,8 +59,12 @@ PiiOperationServer::PiiOperationServer(PiiOperation* operation) :
   addFunction("endPropertySet", operation, &PiiOperation::endPropertySet);
   addFunction("removePropertySet", operation, &PiiOperation::removePropertySet);
   addFunction("reconfigure", operation, &PiiOperation::reconfigure);
+  addFunction("checkpoint", operation, &PiiOperation::checkpoint);
+  addFunction("restoreCheckpoint", operation, &PiiOperation::restoreCheckpoint);
 
   addFunction("connectInput", this, &PiiOperationServer::connectInput);
+  addFunction("profile", this, &PiiOperationServer::profile);
+  addFunction("resetProfile", this, &PiiOperationServer::resetProfile);
 }
 
 QStringList PiiOperationServer::listRoot() const
@@ -95,20 +108,44 @@ void PiiOperationServer::disconnectFromChannel(Channel* channel, const QString&
 void PiiOperationServer::sendToInput(const QString& inputName, PiiHttpDevice* dev,
                                      PiiHttpProtocol::TimeLimiter*)
 {
+  PII_D;
   PII_REQUIRE_HTTP_METHOD("POST");
-  PiiOutputSocket* pOutput = _d()->hashConnectedInputs[inputName];
+  PiiOutputSocket* pOutput = d->hashConnectedInputs[inputName];
   if (pOutput == 0)
     PII_THROW_HTTP_ERROR(NotFoundStatus);
   try
     {
       PiiVariant varObject;
-      PiiSerialization::fromByteArray<PiiGenericTextInputArchive>(dev->readBody(), varObject);
+      QString strContentType(dev->requestHeader().contentType());
+      // Frames are decoded straight from the socket without
+      // buffering the body.
+      if (strContentType == PiiWireFormat::pContentType)
+        varObject = PiiWireFormat::readObject(dev, dev->messageSizeLimit(), dev->dataTimeout());
+      else if (strContentType == PiiSharedMemoryRing::pContentType)
+        {
+          if (d->pSharedMemoryRing == 0)
+            PII_THROW_HTTP_ERROR(UnsupportedMediaTypeStatus);
+          varObject = d->pSharedMemoryRing->load(dev->readBody());
+          // The slot has been recycled or loaded already.
+          if (!varObject.isValid())
+            PII_THROW_HTTP_ERROR(GoneStatus);
+        }
+      else
+        PiiSerialization::fromByteArray<PiiGenericTextInputArchive>(dev->readBody(), varObject);
       pOutput->emitObject(varObject);
     }
   catch (PiiSerializationException& ex)
     {
       PII_THROW_HTTP_ERROR_MSG(BadRequestStatus, ex.message() + " (" + ex.info() + ")");
     }
+  catch (PiiHttpException&)
+    {
+      throw;
+    }
+  catch (PiiException& ex)
+    {
+      PII_THROW_HTTP_ERROR_MSG(BadRequestStatus, ex.message());
+    }
 }
 
 void PiiOperationServer::connectInput(const QString& inputName)
@@ -125,6 +162,16 @@ void PiiOperationServer::connectInput(const QString& inputName)
     }
 }
 
+QVariantMap PiiOperationServer::profile() const
+{
+  return PiiEngine::profile(operation());
+}
+
+void PiiOperationServer::resetProfile()
+{
+  PiiEngine::resetProfile(operation());
+}
+
 void PiiOperationServer::handleRequest(const QString& uri, PiiHttpDevice* dev,
                                        PiiHttpProtocol::TimeLimiter* controller)
 {
@@ -150,8 +197,11 @@ void PiiOperationServer::handleRequest(const QString& uri, PiiHttpDevice* dev,
     PiiQObjectServer::handleRequest(uri, dev, controller);
 }
 
-PiiOperationServer::ChannelImpl::ChannelImpl(const QString& clientId) :
-  PiiQObjectServer::ChannelImpl(clientId)
+PiiOperationServer::ChannelImpl::ChannelImpl(const QString& clientId, ObjectFormat pushFormat,
+                                             PiiSharedMemoryRing* sharedMemoryRing) :
+  PiiQObjectServer::ChannelImpl(clientId),
+  _pushFormat(pushFormat),
+  _pSharedMemoryRing(sharedMemoryRing)
 {}
 
 PiiOperationServer::ChannelImpl::~ChannelImpl()
@@ -176,8 +226,26 @@ bool PiiOperationServer::ChannelImpl::tryToReceive(PiiAbstractInputSocket* sende
 {
   try
     {
-      QByteArray aData(PiiSerialization::toByteArray<PiiGenericTextOutputArchive>(object));
-      return enqueuePushData("outputs/" + sender->objectName(), aData);
+      QByteArray aData;
+      if (_pushFormat == SharedMemoryFormat && _pSharedMemoryRing != 0)
+        aData = _pSharedMemoryRing->store(object);
+      // Fall back to frames if the object cannot be stored.
+      if (aData.isEmpty())
+        aData = _pushFormat == TextArchiveFormat ?
+          PiiSerialization::toByteArray<PiiGenericTextOutputArchive>(object) :
+          PiiWireFormat::toByteArray(object);
+      QString strSourceId("outputs/" + sender->objectName());
+      // Control objects must not be lost and a rejected object would
+      // block the emitting output forever. Give the client a moment
+      // to catch up before dropping the object.
+      for (int i=0; i<iMaxPushRetries; ++i)
+        {
+          if (enqueuePushData(strSourceId, aData))
+            return true;
+          PiiDelay::msleep(5);
+        }
+      piiWarning(PiiOperationServer::tr("Push queue of %1 is full. Dropping an object.").arg(strSourceId));
+      return true;
     }
   catch (PiiSerializationException& ex)
     {
@@ -188,5 +256,10 @@ bool PiiOperationServer::ChannelImpl::tryToReceive(PiiAbstractInputSocket* sende
 
 PiiQObjectServer::ChannelImpl* PiiOperationServer::createChannel(const QString& clientId) const
 {
-  return new ChannelImpl(clientId);
+  return new ChannelImpl(clientId, _d()->pushFormat, _d()->pSharedMemoryRing);
 }
+
+void PiiOperationServer::setPushFormat(ObjectFormat pushFormat) { _d()->pushFormat = pushFormat; }
+PiiOperationServer::ObjectFormat PiiOperationServer::pushFormat() const { return _d()->pushFormat; }
+void PiiOperationServer::setSharedMemoryRing(PiiSharedMemoryRing* ring) { _d()->pSharedMemoryRing = ring; }
+PiiSharedMemoryRing* PiiOperationServer::sharedMemoryRing() const { return _d()->pSharedMemoryRing; }
@@ -23,6 +23,8 @@
 
 #include <QHash>
 
+class PiiSharedMemoryRing;
+
 PII_MAP_METATYPE(PiiOperation::State, int);
 
 /**
@@ -35,12 +37,68 @@ PII_MAP_METATYPE(PiiOperation::State, int);
  * the server. A request to these URIs returns a list of input and
  * output names, respectively.
  *
+ * Objects are posted to "/inputs/name" either as text archives or,
+ * if the Content-Type of the request is PiiWireFormat::pContentType,
+ * as PiiWireFormat frames. Framed matrices are read directly from the
+ * connection into the matrix that is sent to the input. Objects
+ * emitted by the operation's outputs are pushed to clients in the
+ * format specified by [setPushFormat()]. The receiver can recognize
+ * the format with PiiWireFormat::isFrame().
+ *
+ * If the server and its clients run on the same host, matrices can
+ * be passed through a PiiSharedMemoryRing (see
+ * [setSharedMemoryRing()]). In this case, only a short handle to a
+ * slot in the shared segment is sent through the connection. Handles
+ * are posted to inputs with PiiSharedMemoryRing::pContentType as the
+ * Content-Type.
+ *
+ * The functions "profile" and "resetProfile" return and clear the
+ * run-time profiling statistics of the operation and its children.
+ * See PiiEngine::profile() for the structure of the returned map.
+ * "checkpoint" and "restoreCheckpoint" transfer the running state of
+ * the operation to a hot standby. See PiiOperation::checkpoint().
  */
 class PII_YDIN_EXPORT PiiOperationServer : public PiiQObjectServer
 {
 public:
+  /**
+   * Encoding formats for objects pushed to clients.
+   *
+   * - `TextArchiveFormat` - objects are serialized with
+   * PiiGenericTextOutputArchive.
+   *
+   * - `FramedBinaryFormat` - objects are encoded as PiiWireFormat
+   * frames. This is the default.
+   *
+   * - `SharedMemoryFormat` - matrices are stored into the
+   * [sharedMemoryRing()], and only their handles are pushed. Objects
+   * that cannot be stored, such as non-matrices and matrices that are
+   * larger than a slot, are sent as PiiWireFormat frames. The
+   * receiver can recognize a handle with
+   * PiiSharedMemoryRing::isHandle().
+   */
+  enum ObjectFormat { TextArchiveFormat, FramedBinaryFormat, SharedMemoryFormat };
+
   PiiOperationServer(PiiOperation* operation);
 
+  /**
+   * Sets the format of objects pushed to clients. The format is fixed
+   * when a channel is created; existing channels are not affected.
+   */
+  void setPushFormat(ObjectFormat pushFormat);
+  ObjectFormat pushFormat() const;
+
+  /**
+   * Sets the shared memory ring used for passing matrices between
+   * processes. The ring is used for pushing objects with
+   * `SharedMemoryFormat` and for loading handles posted to inputs.
+   * The server does not take the ownership of *ring*, which must be
+   * attached and stay alive as long as the server and its channels
+   * exist.
+   */
+  void setSharedMemoryRing(PiiSharedMemoryRing* ring);
+  PiiSharedMemoryRing* sharedMemoryRing() const;
+
   void handleRequest(const QString& uri, PiiHttpDevice* dev,
                      PiiHttpProtocol::TimeLimiter* controller);
 protected:
@@ -60,6 +118,8 @@ private:
     ~Data();
 
     QHash<QString,PiiOutputSocket*> hashConnectedInputs;
+    ObjectFormat pushFormat;
+    PiiSharedMemoryRing* pSharedMemoryRing;
   };
   PII_D_FUNC;
 
@@ -68,7 +128,8 @@ private:
     public PiiInputController
   {
   public:
-    ChannelImpl(const QString& clientId);
+    ChannelImpl(const QString& clientId, ObjectFormat pushFormat,
+                PiiSharedMemoryRing* sharedMemoryRing);
     ~ChannelImpl();
 
     PiiAbstractInputSocket* createInput(const QString& outputName);
@@ -78,11 +139,15 @@ private:
 
   private:
     QHash<QString,PiiAbstractInputSocket*> _hashInputs;
+    ObjectFormat _pushFormat;
+    PiiSharedMemoryRing* _pSharedMemoryRing;
   };
 
   inline PiiOperation* operation() const { return static_cast<PiiOperation*>(_d()->pObject); }
   PiiAbstractOutputSocket* findOutput(const QString& name) const;
   void connectInput(const QString& inputName);
+  QVariantMap profile() const;
+  void resetProfile();
   void sendToInput(const QString& inputName, PiiHttpDevice* dev,
                    PiiHttpProtocol::TimeLimiter* controller);
 };
@@ -13,89 +13,418 @@
  * refer to LICENSE.AGPL3 for details.
  */
 
-#if 0
 #include "PiiRemoteOperation.h"
 
-PiiRemoteOperation::Data::Data() :
-  bConfigured(false)
-{}
+#include "PiiInputSocket.h"
+#include "PiiOutputSocket.h"
+#include "PiiNullInputController.h"
+#include "PiiWireFormat.h"
+#include "PiiEngine.h"
+
+#include <PiiRemoteObject.h>
+#include <PiiNetworkClient.h>
+#include <PiiNetworkException.h>
+#include <PiiHttpDevice.h>
+#include <PiiStreamBuffer.h>
+#include <PiiAsyncCall.h>
+#include <PiiDelay.h>
+#include <PiiTimer.h>
+#include <PiiInvalidArgumentException.h>
+#include <PiiSerializationUtil.h>
+#include <PiiGenericTextInputArchive.h>
+#include <PiiGenericTextOutputArchive.h>
+
+#include <QBuffer>
+#include <QRegExp>
 
-PiiRemoteOperation::PiiRemoteOperation()
+namespace
 {
+  // The number of milliseconds between state queries while the
+  // remote operation is running.
+  const int iStatePollInterval = 100;
+
+  void checkResponse(PiiHttpDevice* dev)
+  {
+    if (!dev->isReadable())
+      PII_THROW(PiiNetworkException, PiiRemoteOperation::tr(PiiNetwork::pDeviceIsNotConnectedMessage));
+    if (!dev->readHeader())
+      PII_THROW(PiiNetworkException, PiiRemoteOperation::tr(PiiNetwork::pErrorReadingResponseHeader));
+    if (dev->status() != PiiHttpProtocol::OkStatus)
+      {
+        dev->discardBody();
+        PII_THROW(PiiNetworkException, PiiRemoteOperation::tr(PiiNetwork::pServerRepliedWithStatus).arg(dev->status()));
+      }
+  }
 }
 
+class PiiRemoteOperation::Client : public PiiRemoteObject
+{
+public:
+  Client(PiiRemoteOperation* owner, const QString& serverUri) :
+    PiiRemoteObject(serverUri),
+    _pOwner(owner)
+  {}
+
+  using PiiRemoteObject::connectToChannel;
+  using PiiRemoteObject::disconnectFromChannel;
+
+  void setRemoteProperty(const char* name, const QVariant& value)
+  {
+    HttpDevicePtr pDev = openConnection();
+    pDev->setRequest("POST", d->strPath + "properties/" + name);
+    pDev->startOutputFiltering(new PiiStreamBuffer);
+    pDev->write(pDev->encode(value));
+    finishRequest(pDev);
+    checkResponse(pDev);
+    pDev->discardBody();
+  }
+
+  QVariant remoteProperty(const char* name)
+  {
+    HttpDevicePtr pDev = openConnection();
+    pDev->setRequest("GET", d->strPath + "properties/" + name);
+    finishRequest(pDev);
+    checkResponse(pDev);
+    return pDev->decodeVariant(pDev->readBody());
+  }
+
+protected:
+  void decodePushedData(const QString& sourceId, const QByteArray& data)
+  {
+    if (sourceId.startsWith("outputs/"))
+      _pOwner->receiveObject(sourceId.mid(8), data);
+    else
+      PiiRemoteObject::decodePushedData(sourceId, data);
+  }
+
+private:
+  PiiRemoteOperation* _pOwner;
+};
+
+// Passes objects received by a local input to the corresponding
+// input of the remote operation. Each input has a connection of its
+// own so that a full remote input won't block the others.
+class PiiRemoteOperation::Sender :
+  public PiiRemoteObject,
+  public PiiInputController
+{
+public:
+  Sender(PiiRemoteOperation* owner, const QString& serverUri, const QString& inputName) :
+    PiiRemoteObject(serverUri),
+    _pOwner(owner),
+    _strInputName(inputName)
+  {}
+
+  bool tryToReceive(PiiAbstractInputSocket*, const PiiVariant& object) throw ()
+  {
+    try
+      {
+        HttpDevicePtr pDev = openConnection();
+        pDev->setRequest("POST", d->strPath + "inputs/" + _strInputName);
+        pDev->setHeader("Content-Type", PiiWireFormat::pContentType);
+        pDev->setHeader("Content-Length", PiiWireFormat::frameSize(object));
+        // The frame goes straight to the connection without buffering.
+        PiiWireFormat::writeObject(pDev, object);
+        finishRequest(pDev);
+        // The server replies once the remote input has accepted the
+        // object.
+        checkResponse(pDev);
+        pDev->discardBody();
+      }
+    catch (PiiException& ex)
+      {
+        _pOwner->reportError(PiiRemoteOperation::tr("Cannot send an object to %1: %2")
+                             .arg(_strInputName).arg(ex.message()));
+      }
+    // Failed objects are dropped. Retrying would block the sender
+    // indefinitely.
+    return true;
+  }
+
+private:
+  PiiRemoteOperation* _pOwner;
+  QString _strInputName;
+};
+
+PiiRemoteOperation::Data::Data() :
+  pClient(0),
+  state(PiiOperation::Stopped),
+  pMonitorThread(0),
+  bMonitoring(false)
+{}
+
+PiiRemoteOperation::Data::~Data()
+{}
+
 PiiRemoteOperation::PiiRemoteOperation(const QString& serverUri) :
-  PiiRemoteObject(serverUri)
+  PiiOperation(new Data)
 {
-  configure(); // may throw
+  PII_D;
+  QList<QByteArray> lstInputNames, lstOutputNames;
+  try
+    {
+      d->pClient = new Client(this, serverUri); // may throw
+      lstInputNames = d->pClient->readDirectoryList("inputs/"); // may throw
+      lstOutputNames = d->pClient->readDirectoryList("outputs/"); // may throw
+      for (int i=0; i<lstInputNames.size(); ++i)
+        if (!lstInputNames[i].isEmpty())
+          d->lstSenders << new Sender(this, serverUri, lstInputNames[i]); // may throw
+    }
+  catch (...)
+    {
+      qDeleteAll(d->lstSenders);
+      delete d->pClient;
+      throw;
+    }
+
+  for (int i=0; i<d->lstSenders.size(); ++i)
+    {
+      PiiInputSocket* pInput = new PiiInputSocket(lstInputNames[i]);
+      pInput->setParent(this);
+      pInput->setController(d->lstSenders[i]);
+      d->lstInputs << pInput;
+    }
+  for (int i=0; i<lstOutputNames.size(); ++i)
+    if (!lstOutputNames[i].isEmpty())
+      {
+        PiiOutputSocket* pOutput = new PiiOutputSocket(lstOutputNames[i]);
+        pOutput->setParent(this);
+        d->lstOutputs << pOutput;
+      }
 }
 
 PiiRemoteOperation::~PiiRemoteOperation()
 {
+  PII_D;
+  stopMonitoring();
+  // Release the channel thread if it is blocked in emission.
+  for (int i=0; i<d->lstOutputs.size(); ++i)
+    d->lstOutputs[i]->interrupt();
+  delete d->pClient;
+  for (int i=0; i<d->lstInputs.size(); ++i)
+    d->lstInputs[i]->setController(PiiNullInputController::instance());
+  qDeleteAll(d->lstSenders);
+
+  if (!d->strInstanceId.isEmpty())
+    {
+      try
+        {
+          postToNode(d->strNodeUri, "remove", d->strInstanceId.toUtf8());
+        }
+      catch (PiiException& ex)
+        {
+          piiWarning(tr("Cannot remove %1 from %2: %3").arg(d->strInstanceId).arg(d->strNodeUri).arg(ex.message()));
+        }
+    }
 }
 
-void PiiRemoteOperation::serverUriChanged(const QString& uri)
+PiiRemoteOperation* PiiRemoteOperation::deploy(const QString& nodeUri, PiiOperation* operation)
 {
-  PiiRemoteMetaObject::serverUriChanged(uri);
-  configure(); // may throw
+  QByteArray aArchive;
+  {
+    QBuffer buffer(&aArchive);
+    buffer.open(QIODevice::WriteOnly);
+    PiiGenericTextOutputArchive oa(&buffer);
+    QVariantMap mapConfig;
+    mapConfig["plugins"] = PiiEngine::usedPluginLibraryNames(operation);
+    oa << PII_NVP("config", mapConfig);
+    oa << PII_NVP("operation", operation);
+  }
+
+  QString strNodeUri(nodeUri);
+  if (!strNodeUri.endsWith('/'))
+    strNodeUri.append('/');
+  QString strId(QString::fromUtf8(postToNode(strNodeUri, "deploy", aArchive)).trimmed());
+
+  PiiRemoteOperation* pRemote = 0;
+  try
+    {
+      pRemote = new PiiRemoteOperation(strNodeUri + strId + "/");
+    }
+  catch (...)
+    {
+      try { postToNode(strNodeUri, "remove", strId.toUtf8()); } catch (...) {}
+      throw;
+    }
+  pRemote->_d()->strNodeUri = strNodeUri;
+  pRemote->_d()->strInstanceId = strId;
+  pRemote->setObjectName(operation->objectName());
+  return pRemote;
 }
 
-void PiiRemoteOperation::configure()
+QByteArray PiiRemoteOperation::postToNode(const QString& nodeUri, const QString& path, const QByteArray& body)
 {
-  PII_D;
-  if (d->bConfigured)
-    return;
-  d->bConfigured = true;
+  QRegExp uriExp("([^:]+://[^/]+)(/[^ ]*)");
+  if (!uriExp.exactMatch(nodeUri))
+    PII_THROW(PiiInvalidArgumentException, tr("The provided node URI (%1) is invalid.").arg(nodeUri));
 
-  QList<QByteArray> lstInputNames = readDirectoryList("inputs/"); // may throw
-  QList<QByteArray> lstOutputNames = readDirectoryList("outputs/"); // may throw
+  PiiNetworkClient client(uriExp.cap(1));
+  QIODevice* pSocket = client.openConnection();
+  if (pSocket == 0)
+    PII_THROW(PiiNetworkException, tr("Connection to the node at %1 could not be established.").arg(nodeUri));
 
-  for (int i=0; i<lstInputNames.size(); ++i)
-    d->lstInputs << new PiiRemoteInputSocket(lstInputNames[i]);
-
-  for (int i=0; i<lstOutputNames.size(); ++i)
-    d->lstOutputs << new PiiRemoteOutputSocket(lstOutputNames[i]);
+  PiiHttpDevice dev(pSocket, PiiHttpDevice::Client);
+  dev.setRequest("POST", uriExp.cap(2) + path);
+  dev.setHeader("Content-Type", PiiNetwork::pTextArchiveContentType);
+  dev.setHeader("Content-Length", body.size());
+  dev.write(body);
+  dev.finish();
+  checkResponse(&dev);
+  return dev.readBody();
 }
 
+QString PiiRemoteOperation::serverUri() const { return _d()->pClient->serverUri(); }
+
 void PiiRemoteOperation::check(bool reset)
 {
-  call("check", reset);
+  PII_D;
+  // The sockets on the server side must be connected before the
+  // remote operation is checked.
+  for (int i=0; i<d->lstOutputs.size(); ++i)
+    {
+      d->lstOutputs[i]->reset();
+      QString strSource("outputs/" + d->lstOutputs[i]->objectName());
+      if (d->lstOutputs[i]->connectedInputCount() > 0 &&
+          !d->lstChannelSources.contains(strSource))
+        {
+          d->pClient->connectToChannel(strSource);
+          d->lstChannelSources << strSource;
+        }
+    }
+  for (int i=0; i<d->lstInputs.size(); ++i)
+    if (d->lstInputs[i]->connectedOutput() != 0)
+      d->pClient->call<void>("connectInput", d->lstInputs[i]->objectName());
+
+  d->pClient->call<void>("check", reset);
 }
 
-void PiiRemoteOperation::start() { call("start"); }
+void PiiRemoteOperation::start()
+{
+  PII_D;
+  d->pClient->call<void>("start");
+  // Follow the state of the remote operation until it stops.
+  stopMonitoring();
+  setState(State(d->pClient->call<int>("state")));
+  d->bMonitoring = true;
+  d->pMonitorThread = Pii::createAsyncCall(this, &PiiRemoteOperation::monitorState);
+  d->pMonitorThread->start();
+}
 
-void PiiRemoteOperation::pause() { call("pause"); }
+void PiiRemoteOperation::pause() { _d()->pClient->call<void>("pause"); }
 
-void PiiRemoteOperation::stop() { call("stop"); }
+void PiiRemoteOperation::stop() { _d()->pClient->call<void>("stop"); }
 
-void PiiRemoteOperation::interrupt() { call("interrupt"); }
+void PiiRemoteOperation::interrupt()
+{
+  PII_D;
+  for (int i=0; i<d->lstOutputs.size(); ++i)
+    d->lstOutputs[i]->interrupt();
+  d->pClient->call<void>("interrupt");
+}
 
 bool PiiRemoteOperation::wait(unsigned long time)
 {
-  return call<bool>("wait", time);
+  PII_D;
+  PiiTimer timer;
+  QMutexLocker lock(&d->stateLock);
+  while (d->state != Stopped)
+    {
+      if (time == ULONG_MAX)
+        d->stateCondition.wait(&d->stateLock);
+      else
+        {
+          qint64 iRemaining = qint64(time) - timer.milliseconds();
+          if (iRemaining <= 0)
+            return false;
+          d->stateCondition.wait(&d->stateLock, (unsigned long)iRemaining);
+        }
+    }
+  return true;
 }
 
 PiiOperation::State PiiRemoteOperation::state() const
 {
-  return static_cast<PiiOperation::State>(call("state").toInt());
+  QMutexLocker lock(&_d()->stateLock);
+  return _d()->state;
 }
 
-PiiAbstractInputSocket* PiiRemoteOperation::input(const QString& name) const
+void PiiRemoteOperation::setState(State state)
 {
-  const PII_D;
-  for (int i=0; i<d->lstInputs.size(); ++i)
-    if (d->lstInputs[i].objectName() == name)
-      return d->lstInputs[i];
-  return 0;
+  PII_D;
+  {
+    QMutexLocker lock(&d->stateLock);
+    if (d->state == state)
+      return;
+    d->state = state;
+    d->stateCondition.wakeAll();
+  }
+  emit stateChanged(state);
 }
 
-PiiAbstractOutputSocket* PiiRemoteOperation::output(const QString& name) const
+void PiiRemoteOperation::monitorState()
 {
-  const PII_D;
+  PII_D;
+  while (d->bMonitoring)
+    {
+      try
+        {
+          State remoteState = State(d->pClient->call<int>("state"));
+          setState(remoteState);
+          if (remoteState == Stopped)
+            break;
+        }
+      catch (PiiException& ex)
+        {
+          reportError(tr("Lost connection to %1: %2").arg(serverUri()).arg(ex.message()));
+          setState(Stopped);
+          break;
+        }
+      PiiDelay::msleep(iStatePollInterval);
+    }
+  d->bMonitoring = false;
+}
+
+void PiiRemoteOperation::stopMonitoring()
+{
+  PII_D;
+  if (d->pMonitorThread != 0)
+    {
+      d->bMonitoring = false;
+      d->pMonitorThread->wait();
+      delete d->pMonitorThread;
+      d->pMonitorThread = 0;
+    }
+}
+
+void PiiRemoteOperation::receiveObject(const QString& outputName, const QByteArray& data)
+{
+  PII_D;
   for (int i=0; i<d->lstOutputs.size(); ++i)
-    if (d->lstOutputs[i].objectName() == name)
-      return d->lstOutputs[i];
-  return 0;
+    if (d->lstOutputs[i]->objectName() == outputName)
+      {
+        PiiVariant varObject;
+        if (PiiWireFormat::isFrame(data))
+          varObject = PiiWireFormat::fromByteArray(data); // may throw
+        else
+          PiiSerialization::fromByteArray<PiiGenericTextInputArchive>(data, varObject); // may throw
+        try
+          {
+            // Blocks the channel if the receivers are full. The
+            // server will then block the remote emitter.
+            d->lstOutputs[i]->emitObject(varObject);
+          }
+        catch (PiiExecutionException&)
+          {
+            // Interrupted
+          }
+        return;
+      }
+}
+
+void PiiRemoteOperation::reportError(const QString& message)
+{
+  piiWarning(message);
+  emit errorOccured(this, message);
 }
 
 QList<PiiAbstractInputSocket*> PiiRemoteOperation::inputs() const
@@ -103,7 +432,7 @@ QList<PiiAbstractInputSocket*> PiiRemoteOperation::inputs() const
   const PII_D;
   QList<PiiAbstractInputSocket*> lstResult;
   for (int i=0; i<d->lstInputs.size(); ++i)
-    lstResult << lstInputs[i];
+    lstResult << d->lstInputs[i];
   return lstResult;
 }
 
@@ -112,53 +441,48 @@ QList<PiiAbstractOutputSocket*> PiiRemoteOperation::outputs() const
   const PII_D;
   QList<PiiAbstractOutputSocket*> lstResult;
   for (int i=0; i<d->lstOutputs.size(); ++i)
-    lstResult << lstOutputs[i];
+    lstResult << d->lstOutputs[i];
   return lstResult;
 }
 
-int PiiRemoteOperation::inputCount() const { return _d()->lstInputs.size(); }
-int PiiRemoteOperation::outputCount() const { return _d()->lstOutputs.size(); }
-
-void PiiRemoteOperation::startPropertySet(const QString& name)
-{
-  call("startPropertySet", name);
-}
-
-void PiiRemoteOperation::endPropertySet() { call("endPropertySet"); }
-
-void PiiRemoteOperation::removePropertySet(const QString& name)
-{
-  call("removePropertySet", name);
-}
-
 void PiiRemoteOperation::reconfigure(const QString& propertySetName)
 {
-  call("reconfigure", propertySetName);
+  _d()->pClient->call<void>("reconfigure", propertySetName);
 }
 
-PiiRemoteOperation* PiiRemoteOperation::clone() const
+bool PiiRemoteOperation::setProperty(const char* name, const QVariant& value)
 {
-  return new PiiRemoteOperation(serverUri());
+  // The name identifies the local stand-in.
+  if (!strcmp(name, "objectName"))
+    return PiiOperation::setProperty(name, value);
+  try
+    {
+      _d()->pClient->setRemoteProperty(name, value);
+      return true;
+    }
+  catch (PiiException& ex)
+    {
+      piiWarning(ex.message());
+    }
+  return false;
 }
 
-void PiiRemoteOperation::decodePushedData(const QString& sourceId, const QByteArray& data)
+QVariant PiiRemoteOperation::property(const char* name) const
 {
-  PII_D;
-  //piiDebug(QString("Received %1 bytes to %2.").arg(data.size()).arg(strId));
-  if (sourceId.startsWith("outputs/"))
+  if (!strcmp(name, "objectName"))
+    return PiiOperation::property(name);
+  try
     {
-      QString strName = sourceId.mid(8);
-      for (int i=0; i<d->lstOutputs.size(); ++i)
-        if (d->lstOutputs[i]->socket()->objectName() == strName)
-          {
-            //...
-            return;
-          }
+      return _d()->pClient->remoteProperty(name);
+    }
+  catch (PiiException& ex)
+    {
+      piiWarning(ex.message());
     }
+  return QVariant();
 }
 
-bool PiiRemoteInputSocket::tryToReceive(PiiAbstractInputSocket*, const PiiVariant& object) throw ()
+PiiRemoteOperation* PiiRemoteOperation::clone() const
 {
-  call(d->strUri, object);
+  return new PiiRemoteOperation(serverUri());
 }
-#endif
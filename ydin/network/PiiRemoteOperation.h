@@ -16,54 +16,137 @@
 #ifndef _PIIREMOTEOPERATION_H
 #define _PIIREMOTEOPERATION_H
 
-#include <PiiRemoteQObject.h>
-
 #include "PiiOperation.h"
 
+#include <QWaitCondition>
+
+class PiiInputSocket;
+class PiiOutputSocket;
+
 /**
  * An operation that is executed on another computer. This operation
  * works just like an ordinary operation but transparently passes data
- * to and from a remote object server. The inputs and outputs of the
+ * to and from a PiiOperationServer. The inputs and outputs of the
  * operation are defined by the server object.
  *
+ * Objects are passed in both directions as PiiWireFormat frames,
+ * including synchronization tags, stop and pause tags and socket
+ * states. Therefore, the remote operation takes part in the flow
+ * control of the local pipeline just like a local one. Each input
+ * uses a connection of its own. An object sent to an input is
+ * accepted once the server has passed it to the remote input. If the
+ * remote input is full, the sending thread will block until there is
+ * room. Objects emitted by the remote outputs are pushed back through
+ * a channel (see PiiObjectServer) and emitted through the
+ * corresponding local outputs in the order they were received.
+ *
+ * The state of the remote operation is polled while it is running.
+ * Properties are read and written through the server, and a property
+ * set to the local object is thus immediately visible to the remote.
+ *
+ * ~~~(c++)
+ * // Place a compound on another node
+ * PiiRemoteOperation* pRemote =
+ *   PiiRemoteOperation::deploy("tcp://192.168.1.2:3142/node/", pCompound);
+ * engine.replaceOperation(pCompound, pRemote);
+ * ~~~
+ *
+ * PiiEngine::deploy() does the same for all compounds whose `node`
+ * property is set. If two deployed compounds are connected to each
+ * other, the objects are relayed through the local engine.
+ *
+ * @see PiiOperationNodeServer
  */
-class PII_YDIN_EXPORT PiiRemoteOperation :
-  public PiiRemoteQObject<PiiOperation>
+class PII_YDIN_EXPORT PiiRemoteOperation : public PiiOperation
 {
+  Q_OBJECT
+
 public:
-  PiiRemoteOperation();
+  /**
+   * Creates a new remote operation that connects to the operation
+   * server at *serverUri*, e.g. "tcp://192.168.1.2:3142/operation/".
+   * The inputs and outputs of the operation are read from the server.
+   *
+   * @exception PiiNetworkException& if the server cannot be connected
+   *
+   * @exception PiiInvalidArgumentException& if *serverUri* is
+   * incorrecly formatted
+   */
   PiiRemoteOperation(const QString& serverUri);
+  /**
+   * Destroys the operation. If the remote operation was created with
+   * [deploy()], it will be removed from the node.
+   */
   ~PiiRemoteOperation();
 
+  /**
+   * Deploys *operation* to the PiiOperationNodeServer at *nodeUri*
+   * and returns a new PiiRemoteOperation that controls the deployed
+   * copy. The operation is serialized with its children and internal
+   * connections, and the node loads the plugins it needs. The
+   * original operation is not modified. The caller takes the
+   * ownership of the returned pointer.
+   *
+   * @exception PiiNetworkException& if the node cannot be connected
+   *
+   * @exception PiiException& if the node cannot create the
+   * operation.
+   */
+  static PiiRemoteOperation* deploy(const QString& nodeUri, PiiOperation* operation);
+
+  /**
+   * Returns the URI of the remote operation server.
+   */
+  QString serverUri() const;
+
   void check(bool reset);
   void start();
   void pause();
   void stop();
   void interrupt();
-  bool wait(unsigned long time=ULONG_MAX);
-
+  bool wait(unsigned long time = ULONG_MAX);
   State state() const;
-  PiiAbstractInputSocket* input(const QString& name) const;
-  PiiAbstractOutputSocket* output(const QString& name) const;
+
   QList<PiiAbstractInputSocket*> inputs() const;
   QList<PiiAbstractOutputSocket*> outputs() const;
-  void startPropertySet(const QString& name = QString());
-  void endPropertySet();
-  void removePropertySet(const QString& name = QString());
+
   void reconfigure(const QString& propertySetName = QString());
-  int inputCount() const;
-  int outputCount() const;
+
+  bool setProperty(const char* name, const QVariant& value);
+  QVariant property(const char* name) const;
+
   PiiRemoteOperation* clone() const;
 
 private:
-  class Data : public PiiRemoteMetaObject::Data
+  class Client;
+  class Sender;
+  class Data : public PiiOperation::Data
   {
   public:
-    bool bConfigured;
-    QList<PiiRemoteInputSocket*> lstInputs;
-    QList<PiiRemoteOutputSocket*> lstOutputs;
+    Data();
+    ~Data();
+
+    Client* pClient;
+    QList<Sender*> lstSenders;
+    QList<PiiInputSocket*> lstInputs;
+    QList<PiiOutputSocket*> lstOutputs;
+    QStringList lstChannelSources;
+    State state;
+    // stateMutex is recursive and cannot be used with a wait condition.
+    QMutex stateLock;
+    QWaitCondition stateCondition;
+    QThread* pMonitorThread;
+    volatile bool bMonitoring;
+    QString strNodeUri, strInstanceId;
   };
   PII_D_FUNC;
+
+  void setState(State state);
+  void monitorState();
+  void stopMonitoring();
+  void receiveObject(const QString& outputName, const QByteArray& data);
+  void reportError(const QString& message);
+  static QByteArray postToNode(const QString& nodeUri, const QString& path, const QByteArray& body);
 };
 
 #endif //_PIIREMOTEOPERATION_H
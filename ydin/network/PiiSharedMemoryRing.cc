@@ -0,0 +1,367 @@
+/* This file is part of Into.
+ * Copyright (C) Intopii 2013.
+ * All rights reserved.
+ *
+ * Licensees holding a commercial Into license may use this file in
+ * accordance with the commercial license agreement. Please see
+ * LICENSE.commercial for commercial licensing terms.
+ *
+ * Alternatively, this file may be used under the terms of the GNU
+ * Affero General Public License version 3 as published by the Free
+ * Software Foundation. In addition, Intopii gives you special rights
+ * to use Into as a part of open source software projects. Please
+ * refer to LICENSE.AGPL3 for details.
+ */
+
+
+#include "PiiSharedMemoryRing.h"
+
+#include <PiiAtomicInt.h>
+
+#include <QSharedMemory>
+#include <QDateTime>
+#include <QCoreApplication>
+#include <cstring>
+#include <climits>
+
+#ifdef Q_OS_WIN
+#  include <windows.h>
+#else
+#  include <sys/types.h>
+#  include <signal.h>
+#  include <errno.h>
+#endif
+
+const char* PiiSharedMemoryRing::pContentType = "application/x-into-shm-handle";
+
+namespace
+{
+  struct RingHeader
+  {
+    enum { magicValue = 0x52494950, currentVersion = 2 }; // "PIIR"
+
+    quint32 magic;
+    quint32 version;
+    quint32 slotCount;
+    quint32 slotSize;
+    quint32 nextSlot;
+    quint32 dataOffset;
+    quint32 reserved[2];
+  };
+
+  struct SlotState
+  {
+    enum State { Free, Stored, Loaded };
+
+    quint32 state;
+    quint32 generation;
+    qint64 storeTime;
+    // The id of the process that loaded the slot.
+    qint64 owner;
+  };
+
+  // Slots are aligned to cache lines.
+  const int iSlotAlignment = 64;
+
+  inline qint64 alignedSize(qint64 size)
+  {
+    return (size + iSlotAlignment - 1) / iSlotAlignment * iSlotAlignment;
+  }
+
+  // Returns false only if the process is known to have exited.
+  bool isProcessAlive(qint64 pid)
+  {
+#ifdef Q_OS_WIN
+    HANDLE hProcess = OpenProcess(PROCESS_QUERY_INFORMATION, FALSE, DWORD(pid));
+    if (hProcess == 0)
+      return GetLastError() != ERROR_INVALID_PARAMETER;
+    DWORD iExitCode = STILL_ACTIVE;
+    GetExitCodeProcess(hProcess, &iExitCode);
+    CloseHandle(hProcess);
+    return iExitCode == STILL_ACTIVE;
+#else
+    return kill(pid_t(pid), 0) == 0 || errno != ESRCH;
+#endif
+  }
+}
+
+struct PiiSharedMemoryRing::Handle
+{
+  enum { magicValue = 0x48494950 }; // "PIIH"
+
+  quint32 magic;
+  quint32 slot;
+  quint32 generation;
+  quint32 type;
+  qint32 rows;
+  qint32 columns;
+  quint32 stride;
+  quint32 reserved;
+};
+
+struct PiiSharedMemoryRing::Segment
+{
+  Segment(const QString& key) : memory(key), iRefCount(1) {}
+
+  RingHeader* header() const { return static_cast<RingHeader*>(const_cast<void*>(memory.constData())); }
+  SlotState* slots() const { return reinterpret_cast<SlotState*>(header() + 1); }
+
+  QSharedMemory memory;
+  PiiAtomicInt iRefCount;
+};
+
+// Keeps a loaded slot and the local attachment alive.
+struct PiiSharedMemoryRing::Lease
+{
+  Segment* pSegment;
+  int iSlot;
+};
+
+PiiSharedMemoryRing::Data::Data(const QString& key) :
+  strKey(key), pSegment(0), iLeaseTime(10000)
+{
+}
+
+PiiSharedMemoryRing::PiiSharedMemoryRing(const QString& key) :
+  d(new Data(key))
+{
+}
+
+PiiSharedMemoryRing::~PiiSharedMemoryRing()
+{
+  detach();
+  delete d;
+}
+
+void PiiSharedMemoryRing::create(int slotCount, int slotSize)
+{
+  if (d->pSegment != 0)
+    PII_THROW(PiiException, QString("Shared memory ring %1 is already attached.").arg(d->strKey));
+  if (slotCount <= 0 || slotSize <= 0)
+    PII_THROW(PiiException, QString("Invalid shared memory ring dimensions."));
+
+  const qint64 iSlotSize = alignedSize(slotSize);
+  const qint64 iDataOffset = alignedSize(qint64(sizeof(RingHeader)) + qint64(slotCount) * sizeof(SlotState));
+  const qint64 iTotalSize = iDataOffset + slotCount * iSlotSize;
+  if (iTotalSize > INT_MAX)
+    PII_THROW(PiiException, QString("Shared memory ring %1 would be too large.").arg(d->strKey));
+
+  Segment* pSegment = new Segment(d->strKey);
+  bool bCreated = pSegment->memory.create(int(iTotalSize));
+  // On Unix, a segment left behind by a crashed process must be
+  // attached to and detached from to get rid of it.
+  if (!bCreated && pSegment->memory.error() == QSharedMemory::AlreadyExists &&
+      pSegment->memory.attach())
+    {
+      pSegment->memory.detach();
+      bCreated = pSegment->memory.create(int(iTotalSize));
+    }
+  if (!bCreated)
+    {
+      QString strError(pSegment->memory.errorString());
+      delete pSegment;
+      PII_THROW(PiiException, QString("Cannot create shared memory ring %1: %2").arg(d->strKey).arg(strError));
+    }
+
+  pSegment->memory.lock();
+  RingHeader* pHeader = pSegment->header();
+  std::memset(pHeader, 0, std::size_t(iDataOffset));
+  pHeader->magic = RingHeader::magicValue;
+  pHeader->version = RingHeader::currentVersion;
+  pHeader->slotCount = quint32(slotCount);
+  pHeader->slotSize = quint32(iSlotSize);
+  pHeader->dataOffset = quint32(iDataOffset);
+  pSegment->memory.unlock();
+
+  d->pSegment = pSegment;
+}
+
+void PiiSharedMemoryRing::attach()
+{
+  if (d->pSegment != 0)
+    PII_THROW(PiiException, QString("Shared memory ring %1 is already attached.").arg(d->strKey));
+
+  Segment* pSegment = new Segment(d->strKey);
+  if (!pSegment->memory.attach())
+    {
+      QString strError(pSegment->memory.errorString());
+      delete pSegment;
+      PII_THROW(PiiException, QString("Cannot attach to shared memory ring %1: %2").arg(d->strKey).arg(strError));
+    }
+
+  const RingHeader* pHeader = pSegment->header();
+  if (pSegment->memory.size() < int(sizeof(RingHeader)) ||
+      pHeader->magic != RingHeader::magicValue ||
+      pHeader->version != RingHeader::currentVersion ||
+      qint64(pHeader->dataOffset) + qint64(pHeader->slotCount) * pHeader->slotSize > pSegment->memory.size())
+    {
+      delete pSegment;
+      PII_THROW(PiiException, QString("%1 is not a valid shared memory ring.").arg(d->strKey));
+    }
+
+  d->pSegment = pSegment;
+}
+
+void PiiSharedMemoryRing::detach()
+{
+  if (d->pSegment != 0 && d->pSegment->iRefCount.deref() == 0)
+    delete d->pSegment;
+  d->pSegment = 0;
+}
+
+int PiiSharedMemoryRing::reserveSlot(quint32* generation)
+{
+  Segment* pSegment = d->pSegment;
+  const qint64 iNow = QDateTime::currentMSecsSinceEpoch();
+  int iSlot = -1;
+
+  pSegment->memory.lock();
+  RingHeader* pHeader = pSegment->header();
+  SlotState* pSlots = pSegment->slots();
+  for (quint32 i=0; i<pHeader->slotCount; ++i)
+    {
+      const quint32 iIndex = (pHeader->nextSlot + i) % pHeader->slotCount;
+      SlotState& slot = pSlots[iIndex];
+      // A receiver that exits without destroying its matrices leaves
+      // the slot loaded.
+      if (slot.state == SlotState::Free ||
+          (slot.state == SlotState::Stored && iNow - slot.storeTime > d->iLeaseTime) ||
+          (slot.state == SlotState::Loaded && !isProcessAlive(slot.owner)))
+        {
+          slot.state = SlotState::Stored;
+          slot.storeTime = iNow;
+          *generation = ++slot.generation;
+          pHeader->nextSlot = (iIndex + 1) % pHeader->slotCount;
+          iSlot = int(iIndex);
+          break;
+        }
+    }
+  pSegment->memory.unlock();
+
+  return iSlot;
+}
+
+char* PiiSharedMemoryRing::slotData(int slot) const
+{
+  const RingHeader* pHeader = d->pSegment->header();
+  return reinterpret_cast<char*>(d->pSegment->header()) + pHeader->dataOffset + qint64(slot) * pHeader->slotSize;
+}
+
+template <class T> QByteArray PiiSharedMemoryRing::storeMatrix(const PiiVariant& object)
+{
+  const PiiMatrix<T>& matrix = object.valueAs<PiiMatrix<T> >();
+  const std::size_t iRowBytes = matrix.columns() * sizeof(T);
+  if (quint64(iRowBytes) * matrix.rows() > quint64(slotSize()))
+    return QByteArray();
+
+  Handle handle = { Handle::magicValue, 0, 0, object.type(),
+                    matrix.rows(), matrix.columns(), quint32(iRowBytes), 0 };
+  const int iSlot = reserveSlot(&handle.generation);
+  if (iSlot < 0)
+    return QByteArray();
+  handle.slot = quint32(iSlot);
+
+  char* pTarget = slotData(iSlot);
+  if (matrix.rows() > 0 && matrix.stride() == iRowBytes)
+    std::memcpy(pTarget, matrix.row(0), iRowBytes * matrix.rows());
+  else
+    for (int r=0; r<matrix.rows(); ++r, pTarget += iRowBytes)
+      std::memcpy(pTarget, matrix.row(r), iRowBytes);
+
+  return QByteArray(reinterpret_cast<const char*>(&handle), sizeof(handle));
+}
+
+QByteArray PiiSharedMemoryRing::store(const PiiVariant& object)
+{
+  if (d->pSegment == 0)
+    return QByteArray();
+
+  QByteArray aHandle;
+  switch (object.type())
+    {
+      PII_PRIMITIVE_MATRIX_CASES(aHandle = storeMatrix, object);
+      PII_COLOR_IMAGE_CASES(aHandle = storeMatrix, object);
+      PII_COMPLEX_MATRIX_CASES(aHandle = storeMatrix, object);
+    default:
+      break;
+    }
+  return aHandle;
+}
+
+template <class T> PiiVariant PiiSharedMemoryRing::loadMatrix(const Handle& handle)
+{
+  if (handle.rows < 0 || handle.columns < 0 ||
+      handle.stride != quint32(handle.columns) * sizeof(T) ||
+      quint64(handle.stride) * quint64(handle.rows) > quint64(slotSize()))
+    PII_THROW(PiiException, QString("Invalid shared memory handle."));
+
+  Segment* pSegment = d->pSegment;
+  pSegment->memory.lock();
+  SlotState& slot = pSegment->slots()[handle.slot];
+  const bool bValid = slot.state == SlotState::Stored && slot.generation == handle.generation;
+  if (bValid)
+    {
+      slot.state = SlotState::Loaded;
+      slot.owner = QCoreApplication::applicationPid();
+    }
+  pSegment->memory.unlock();
+  if (!bValid)
+    return PiiVariant();
+
+  pSegment->iRefCount.ref();
+  Lease* pLease = new Lease;
+  pLease->pSegment = pSegment;
+  pLease->iSlot = int(handle.slot);
+  return PiiVariant(PiiMatrix<T>(handle.rows, handle.columns,
+                                 reinterpret_cast<const T*>(slotData(int(handle.slot))),
+                                 release, pLease, handle.stride));
+}
+
+PiiVariant PiiSharedMemoryRing::load(const QByteArray& handle)
+{
+  if (d->pSegment == 0)
+    PII_THROW(PiiException, QString("Shared memory ring %1 is not attached.").arg(d->strKey));
+  if (!isHandle(handle))
+    PII_THROW(PiiException, QString("Invalid shared memory handle."));
+
+  Handle h;
+  std::memcpy(&h, handle.constData(), sizeof(h));
+  if (h.slot >= quint32(slotCount()))
+    PII_THROW(PiiException, QString("Invalid shared memory handle."));
+
+  PiiVariant varResult;
+  switch (h.type)
+    {
+      PII_PRIMITIVE_MATRIX_CASES(varResult = loadMatrix, h);
+      PII_COLOR_IMAGE_CASES(varResult = loadMatrix, h);
+      PII_COMPLEX_MATRIX_CASES(varResult = loadMatrix, h);
+    default:
+      PII_THROW(PiiException, QString("Invalid shared memory handle."));
+    }
+  return varResult;
+}
+
+void PiiSharedMemoryRing::release(void* context)
+{
+  Lease* pLease = static_cast<Lease*>(context);
+  Segment* pSegment = pLease->pSegment;
+  pSegment->memory.lock();
+  pSegment->slots()[pLease->iSlot].state = SlotState::Free;
+  pSegment->memory.unlock();
+  if (pSegment->iRefCount.deref() == 0)
+    delete pSegment;
+  delete pLease;
+}
+
+bool PiiSharedMemoryRing::isHandle(const QByteArray& data)
+{
+  return data.size() == int(sizeof(Handle)) &&
+    reinterpret_cast<const Handle*>(data.constData())->magic == Handle::magicValue;
+}
+
+QString PiiSharedMemoryRing::key() const { return d->strKey; }
+bool PiiSharedMemoryRing::isAttached() const { return d->pSegment != 0; }
+int PiiSharedMemoryRing::slotCount() const { return d->pSegment != 0 ? int(d->pSegment->header()->slotCount) : 0; }
+int PiiSharedMemoryRing::slotSize() const { return d->pSegment != 0 ? int(d->pSegment->header()->slotSize) : 0; }
+void PiiSharedMemoryRing::setLeaseTime(int leaseTime) { d->iLeaseTime = leaseTime; }
+int PiiSharedMemoryRing::leaseTime() const { return d->iLeaseTime; }
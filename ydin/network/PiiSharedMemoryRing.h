@@ -0,0 +1,178 @@
+/* This file is part of Into.
+ * Copyright (C) Intopii 2013.
+ * All rights reserved.
+ *
+ * Licensees holding a commercial Into license may use this file in
+ * accordance with the commercial license agreement. Please see
+ * LICENSE.commercial for commercial licensing terms.
+ *
+ * Alternatively, this file may be used under the terms of the GNU
+ * Affero General Public License version 3 as published by the Free
+ * Software Foundation. In addition, Intopii gives you special rights
+ * to use Into as a part of open source software projects. Please
+ * refer to LICENSE.AGPL3 for details.
+ */
+
+
+#ifndef _PIISHAREDMEMORYRING_H
+#define _PIISHAREDMEMORYRING_H
+
+#include <PiiYdinTypes.h>
+#include <PiiException.h>
+
+#include <QString>
+#include <QByteArray>
+
+/**
+ * A ring of fixed-size matrix buffers in a shared memory segment.
+ * PiiSharedMemoryRing makes it possible to pass matrices between
+ * processes on the same host without sending their contents through
+ * a socket. The sender copies a matrix into a free slot with
+ * [store()] and sends the returned handle, a 32-byte QByteArray,
+ * through any connection, e.g. a PiiLocalServer socket. The receiver
+ * turns the handle back into a matrix with [load()]. The loaded
+ * matrix refers to the shared segment directly, and the slot is
+ * recycled once the matrix and all of its copies have been
+ * destroyed.
+ *
+ * ~~~(c++)
+ * // Processing engine
+ * PiiSharedMemoryRing ring("into-images");
+ * ring.create(8, 1920*1080*4);
+ * pOperationServer->setSharedMemoryRing(&ring);
+ * pOperationServer->setPushFormat(PiiOperationServer::SharedMemoryFormat);
+ *
+ * // User interface
+ * PiiSharedMemoryRing ring("into-images");
+ * ring.attach();
+ * // aData received from the operation server's channel
+ * if (PiiSharedMemoryRing::isHandle(aData))
+ *   showImage(ring.load(aData).valueAs<PiiMatrix<PiiColor4<> > >());
+ * ~~~
+ *
+ * A handle that is never loaded would keep its slot reserved
+ * forever. Therefore, a slot whose handle has not been loaded within
+ * [leaseTime()] milliseconds can be reused by [store()]. Loading such
+ * a stale handle fails. Likewise, [store()] reuses a loaded slot if
+ * the process that loaded it has exited without destroying the
+ * matrix, e.g. because it crashed.
+ *
+ * Slot reservations are synchronized with the system semaphore of
+ * the QSharedMemory segment. Matrix data itself is never locked:
+ * once stored, a slot is only read until it is released.
+ */
+class PII_YDIN_EXPORT PiiSharedMemoryRing
+{
+public:
+  /**
+   * The MIME type of a serialized handle,
+   * "application/x-into-shm-handle".
+   */
+  static const char* pContentType;
+
+  /**
+   * Creates a ring that uses the shared memory segment identified by
+   * *key*. The segment must be created with [create()] or attached to
+   * with [attach()] before use.
+   */
+  PiiSharedMemoryRing(const QString& key);
+  /**
+   * Detaches from the segment. Matrices loaded from the ring remain
+   * valid until they are destroyed.
+   */
+  ~PiiSharedMemoryRing();
+
+  QString key() const;
+
+  /**
+   * Creates the shared segment with *slotCount* slots of at least
+   * *slotSize* bytes each, and attaches to it.
+   *
+   * @exception PiiException& if the ring is already attached or the
+   * segment cannot be created.
+   */
+  void create(int slotCount, int slotSize);
+
+  /**
+   * Attaches to an existing segment created by another ring.
+   *
+   * @exception PiiException& if the segment does not exist or is not
+   * a valid ring.
+   */
+  void attach();
+
+  /**
+   * Detaches from the segment.
+   */
+  void detach();
+
+  bool isAttached() const;
+
+  /**
+   * Returns the number of slots in the ring, or zero if the ring is
+   * not attached.
+   */
+  int slotCount() const;
+  /**
+   * Returns the size of a slot in bytes, or zero if the ring is not
+   * attached.
+   */
+  int slotSize() const;
+
+  /**
+   * Sets the number of milliseconds a stored slot is reserved for
+   * the receiver. The default is 10000.
+   */
+  void setLeaseTime(int leaseTime);
+  int leaseTime() const;
+
+  /**
+   * Copies the matrix in *object* into a free slot and returns a
+   * handle to it. Returns an empty array if *object* is not a
+   * matrix, if the matrix does not fit into a slot, or if all slots
+   * are in use.
+   */
+  QByteArray store(const PiiVariant& object);
+
+  /**
+   * Returns the matrix identified by *handle*. The matrix refers to
+   * the shared segment and is immutable; modifying it makes a deep
+   * copy. Each handle can be loaded once. Returns an invalid variant
+   * if the handle is not valid any more.
+   *
+   * @exception PiiException& if the ring is not attached or if
+   * *handle* is not a handle.
+   */
+  PiiVariant load(const QByteArray& handle);
+
+  /**
+   * Returns `true` if *data* is a handle returned by [store()].
+   */
+  static bool isHandle(const QByteArray& data);
+
+private:
+  struct Segment;
+  struct Handle;
+  struct Lease;
+
+  template <class T> QByteArray storeMatrix(const PiiVariant& object);
+  template <class T> PiiVariant loadMatrix(const Handle& handle);
+  int reserveSlot(quint32* generation);
+  char* slotData(int slot) const;
+  static void release(void* context);
+
+  /// @internal
+  class Data
+  {
+  public:
+    Data(const QString& key);
+
+    QString strKey;
+    Segment* pSegment;
+    int iLeaseTime;
+  } *d;
+
+  PII_DISABLE_COPY(PiiSharedMemoryRing);
+};
+
+#endif //_PIISHAREDMEMORYRING_H
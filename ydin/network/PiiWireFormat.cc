@@ -0,0 +1,289 @@
+/* This file is part of Into.
+ * Copyright (C) Intopii 2013.
+ * All rights reserved.
+ *
+ * Licensees holding a commercial Into license may use this file in
+ * accordance with the commercial license agreement. Please see
+ * LICENSE.commercial for commercial licensing terms.
+ *
+ * Alternatively, this file may be used under the terms of the GNU
+ * Affero General Public License version 3 as published by the Free
+ * Software Foundation. In addition, Intopii gives you special rights
+ * to use Into as a part of open source software projects. Please
+ * refer to LICENSE.AGPL3 for details.
+ */
+
+
+#include "PiiWireFormat.h"
+
+#include <QIODevice>
+#include <QBuffer>
+
+#include <PiiSerializationUtil.h>
+#include <PiiGenericBinaryInputArchive.h>
+#include <PiiGenericBinaryOutputArchive.h>
+
+namespace PiiWireFormat
+{
+  const char* pContentType = "application/x-into-frame";
+
+  struct Header
+  {
+    enum { magicValue = 0x46494950, currentVersion = 2, controlVersion = 2 };
+    enum PayloadType { MatrixPayload, ArchivePayload, ControlPayload };
+
+    quint32 magic;
+    quint16 version;
+    quint16 payloadType;
+    quint32 type;
+    qint32 rows;
+    qint32 columns;
+    quint32 elementSize;
+    quint64 payloadLength;
+  };
+
+  static Header createHeader(Header::PayloadType payloadType, unsigned int type,
+                             int rows, int columns, std::size_t elementSize,
+                             quint64 payloadLength)
+  {
+    // Only control frames need version 2. Data frames stay readable
+    // for older receivers.
+    Header header = { Header::magicValue,
+                      quint16(payloadType == Header::ControlPayload ? Header::controlVersion : 1),
+                      quint16(payloadType), quint32(type),
+                      qint32(rows), qint32(columns), quint32(elementSize),
+                      payloadLength };
+    return header;
+  }
+
+  static void writeBytes(QIODevice* device, const void* data, qint64 bytes)
+  {
+    if (device->write(static_cast<const char*>(data), bytes) != bytes)
+      PII_SERIALIZATION_ERROR(StreamError);
+  }
+
+  static void readBytes(QIODevice* device, void* data, qint64 bytes, int waitTime)
+  {
+    char* pData = static_cast<char*>(data);
+    while (bytes > 0)
+      {
+        qint64 iBytesRead = device->read(pData, bytes);
+        if (iBytesRead < 0 ||
+            (iBytesRead == 0 && !device->waitForReadyRead(waitTime)))
+          PII_SERIALIZATION_ERROR(StreamError);
+        pData += iBytesRead;
+        bytes -= iBytesRead;
+      }
+  }
+
+  template <class T> static qint64 matrixPayloadLength(const PiiVariant& object)
+  {
+    const PiiMatrix<T>& matrix = object.valueAs<PiiMatrix<T> >();
+    return qint64(matrix.rows()) * matrix.columns() * sizeof(T);
+  }
+
+  template <class T> static void writeMatrix(QIODevice* device, const PiiVariant& object)
+  {
+    const PiiMatrix<T>& matrix = object.valueAs<PiiMatrix<T> >();
+    const std::size_t iRowBytes = matrix.columns() * sizeof(T);
+    Header header(createHeader(Header::MatrixPayload, object.type(),
+                               matrix.rows(), matrix.columns(), sizeof(T),
+                               quint64(matrix.rows()) * iRowBytes));
+    writeBytes(device, &header, sizeof(header));
+    if (header.payloadLength == 0)
+      return;
+
+    // Contiguous matrices can be written at once.
+    if (matrix.stride() == iRowBytes)
+      writeBytes(device, matrix.row(0), qint64(header.payloadLength));
+    else
+      for (int r=0; r<matrix.rows(); ++r)
+        writeBytes(device, matrix.row(r), qint64(iRowBytes));
+  }
+
+  template <class T> static PiiVariant readMatrix(QIODevice* device, const Header& header, int waitTime)
+  {
+    const std::size_t iRowBytes = std::size_t(header.columns) * sizeof(T);
+    if (header.elementSize != sizeof(T) ||
+        header.payloadLength != quint64(header.rows) * iRowBytes)
+      PII_SERIALIZATION_ERROR(InvalidDataFormat);
+
+    PiiMatrix<T> matResult(PiiMatrix<T>::uninitialized(header.rows, header.columns));
+    if (header.payloadLength != 0)
+      {
+        // Read the payload straight into the matrix.
+        if (matResult.stride() == iRowBytes)
+          readBytes(device, matResult.row(0), qint64(header.payloadLength), waitTime);
+        else
+          for (int r=0; r<matResult.rows(); ++r)
+            readBytes(device, matResult.row(r), qint64(iRowBytes), waitTime);
+      }
+    return PiiVariant(matResult);
+  }
+
+  static bool isControlType(unsigned int type)
+  {
+    return type >= PiiYdin::SynchronizationTagType && type <= PiiYdin::ReconfigurationTagType;
+  }
+
+  static QByteArray controlPayload(const PiiVariant& object)
+  {
+    return object.type() == PiiYdin::ReconfigurationTagType ?
+      object.valueAs<QString>().toUtf8() :
+      QByteArray();
+  }
+
+  static void writeControl(QIODevice* device, const PiiVariant& object)
+  {
+    // The values of tags are stored in the rows and columns fields.
+    qint32 iFirst = 0, iSecond = 0;
+    if (object.type() == PiiYdin::ResumeTagType)
+      {
+        const PiiSocketState& state = object.valueAs<PiiSocketState>();
+        iFirst = state.flowLevel.load();
+        iSecond = state.delay.load();
+      }
+    else if (object.type() != PiiYdin::ReconfigurationTagType)
+      iFirst = object.valueAs<int>();
+    QByteArray aPayload(controlPayload(object));
+    Header header(createHeader(Header::ControlPayload, object.type(),
+                               iFirst, iSecond, 0, quint64(aPayload.size())));
+    writeBytes(device, &header, sizeof(header));
+    if (!aPayload.isEmpty())
+      writeBytes(device, aPayload.constData(), aPayload.size());
+  }
+
+  static PiiVariant readControl(QIODevice* device, const Header& header, int waitTime)
+  {
+    switch (header.type)
+      {
+      case PiiYdin::SynchronizationTagType:
+      case PiiYdin::StopTagType:
+      case PiiYdin::PauseTagType:
+        if (header.payloadLength != 0)
+          break;
+        return PiiVariant(int(header.rows), header.type);
+      case PiiYdin::ResumeTagType:
+        if (header.payloadLength != 0)
+          break;
+        return PiiVariant(PiiSocketState(header.rows, header.columns));
+      case PiiYdin::ReconfigurationTagType:
+        {
+          // A property set name.
+          if (header.payloadLength > 0xffff)
+            break;
+          QByteArray aName;
+          aName.resize(int(header.payloadLength));
+          readBytes(device, aName.data(), aName.size(), waitTime);
+          return PiiYdin::createReconfigurationTag(QString::fromUtf8(aName));
+        }
+      }
+    PII_SERIALIZATION_ERROR(InvalidDataFormat);
+  }
+
+  qint64 frameSize(const PiiVariant& object)
+  {
+    if (isControlType(object.type()))
+      return qint64(sizeof(Header)) + controlPayload(object).size();
+
+    qint64 iPayloadLength = -1;
+    switch (object.type())
+      {
+        PII_PRIMITIVE_MATRIX_CASES(iPayloadLength = matrixPayloadLength, object);
+        PII_COLOR_IMAGE_CASES(iPayloadLength = matrixPayloadLength, object);
+        PII_COMPLEX_MATRIX_CASES(iPayloadLength = matrixPayloadLength, object);
+      default:
+        iPayloadLength = PiiSerialization::toByteArray<PiiGenericBinaryOutputArchive>(object).size();
+      }
+    return qint64(sizeof(Header)) + iPayloadLength;
+  }
+
+  void writeObject(QIODevice* device, const PiiVariant& object)
+  {
+    if (isControlType(object.type()))
+      {
+        writeControl(device, object);
+        return;
+      }
+
+    switch (object.type())
+      {
+        PII_PRIMITIVE_MATRIX_CASES_M(writeMatrix, (device, object));
+        PII_COLOR_IMAGE_CASES_M(writeMatrix, (device, object));
+        PII_COMPLEX_MATRIX_CASES_M(writeMatrix, (device, object));
+      default:
+        {
+          QByteArray aData(PiiSerialization::toByteArray<PiiGenericBinaryOutputArchive>(object));
+          Header header(createHeader(Header::ArchivePayload, object.type(), 0, 0, 0, quint64(aData.size())));
+          writeBytes(device, &header, sizeof(header));
+          writeBytes(device, aData.constData(), aData.size());
+        }
+      }
+  }
+
+  PiiVariant readObject(QIODevice* device, qint64 maxSize, int waitTime)
+  {
+    Header header;
+    readBytes(device, &header, sizeof(header), waitTime);
+    if (header.magic != Header::magicValue)
+      PII_SERIALIZATION_ERROR(UnrecognizedArchiveFormat);
+    if (header.version > Header::currentVersion)
+      PII_SERIALIZATION_ERROR(ArchiveVersionMismatch);
+    // Tag values may be negative.
+    if (header.payloadType == Header::ControlPayload)
+      return readControl(device, header, waitTime);
+    if (header.rows < 0 || header.columns < 0 ||
+        (maxSize > 0 && header.payloadLength > quint64(maxSize)))
+      PII_SERIALIZATION_ERROR(InvalidDataFormat);
+
+    if (header.payloadType == Header::ArchivePayload)
+      {
+        if (header.payloadLength > quint64(INT_MAX))
+          PII_SERIALIZATION_ERROR(InvalidDataFormat);
+        QByteArray aData;
+        aData.resize(int(header.payloadLength));
+        readBytes(device, aData.data(), aData.size(), waitTime);
+        PiiVariant varResult;
+        PiiSerialization::fromByteArray<PiiGenericBinaryInputArchive>(aData, varResult);
+        return varResult;
+      }
+    else if (header.payloadType != Header::MatrixPayload)
+      PII_SERIALIZATION_ERROR(InvalidDataFormat);
+
+    PiiVariant varResult;
+    switch (header.type)
+      {
+        PII_PRIMITIVE_MATRIX_CASES_M(varResult = readMatrix, (device, header, waitTime));
+        PII_COLOR_IMAGE_CASES_M(varResult = readMatrix, (device, header, waitTime));
+        PII_COMPLEX_MATRIX_CASES_M(varResult = readMatrix, (device, header, waitTime));
+      default:
+        PII_SERIALIZATION_ERROR(InvalidDataFormat);
+      }
+    return varResult;
+  }
+
+  QByteArray toByteArray(const PiiVariant& object)
+  {
+    QByteArray aResult;
+    // Reserve space for the whole frame to avoid reallocations.
+    if (PiiYdin::isMatrixType(object.type()))
+      aResult.reserve(int(frameSize(object)));
+    QBuffer buffer(&aResult);
+    buffer.open(QIODevice::WriteOnly);
+    writeObject(&buffer, object);
+    return aResult;
+  }
+
+  PiiVariant fromByteArray(const QByteArray& data)
+  {
+    QBuffer buffer(const_cast<QByteArray*>(&data));
+    buffer.open(QIODevice::ReadOnly);
+    return readObject(&buffer, 0, 0);
+  }
+
+  bool isFrame(const QByteArray& data)
+  {
+    return data.size() >= int(sizeof(Header)) &&
+      reinterpret_cast<const Header*>(data.constData())->magic == quint32(Header::magicValue);
+  }
+}
@@ -0,0 +1,131 @@
+/* This file is part of Into.
+ * Copyright (C) Intopii 2013.
+ * All rights reserved.
+ *
+ * Licensees holding a commercial Into license may use this file in
+ * accordance with the commercial license agreement. Please see
+ * LICENSE.commercial for commercial licensing terms.
+ *
+ * Alternatively, this file may be used under the terms of the GNU
+ * Affero General Public License version 3 as published by the Free
+ * Software Foundation. In addition, Intopii gives you special rights
+ * to use Into as a part of open source software projects. Please
+ * refer to LICENSE.AGPL3 for details.
+ */
+
+
+#ifndef _PIIWIREFORMAT_H
+#define _PIIWIREFORMAT_H
+
+#include <PiiYdinTypes.h>
+#include <PiiSerializationException.h>
+
+class QIODevice;
+
+/**
+ * A framed binary format for passing objects over network
+ * connections. Compared to the generic serialization archives, the
+ * format avoids intermediate copies of large payloads: the rows of a
+ * matrix are written straight from the matrix buffer, and the
+ * receiver allocates the destination matrix once, based on the frame
+ * header, and reads the payload directly into it.
+ *
+ * ~~~(c++)
+ * // Client side
+ * PiiHttpDevice dev(client.openConnection(), PiiHttpDevice::Client);
+ * dev.setRequest("POST", "/operation/inputs/image");
+ * dev.setHeader("Content-Type", PiiWireFormat::pContentType);
+ * dev.setHeader("Content-Length", PiiWireFormat::frameSize(varImage));
+ * PiiWireFormat::writeObject(&dev, varImage);
+ * dev.finish();
+ *
+ * // Server side
+ * PiiVariant varImage = PiiWireFormat::readObject(dev);
+ * ~~~
+ *
+ * Frame format
+ * ------------
+ *
+ * All integers are stored in the native byte order of the writer,
+ * which is little-endian on all supported platforms.
+ *
+ * - Header (32 bytes): magic number 0x46494950 ("PIIF"), format
+ * version (1) and payload type (0 = matrix, 1 = archive) as 16-bit
+ * integers, PiiVariant type ID, rows, columns and element size (all
+ * 32-bit), and the 64-bit length of the payload.
+ *
+ * - Matrix payload: the rows of the matrix, back to back, without
+ * padding.
+ *
+ * - Archive payload: other types are serialized with
+ * PiiGenericBinaryOutputArchive. Rows, columns and element size are
+ * zero.
+ *
+ * - Control payload (payload type 2, format version 2): flow control
+ * objects such as synchronization, stop and pause tags and
+ * PiiSocketState. The value of a tag is stored in the rows field;
+ * the flow level and delay of a socket state in rows and columns.
+ * The payload of a reconfiguration tag is the UTF-8 encoded name of
+ * the property set; other tags have no payload. Control frames make
+ * it possible to pass the synchronization of a processing pipeline
+ * over network connections.
+ */
+namespace PiiWireFormat
+{
+  /**
+   * The MIME type of a framed object, "application/x-into-frame".
+   */
+  extern PII_YDIN_EXPORT const char* pContentType;
+
+  /**
+   * Returns the number of bytes [writeObject()] will write for
+   * *object*, including the header.
+   *
+   * @exception PiiSerializationException& if *object* is not a
+   * matrix and cannot be serialized.
+   */
+  PII_YDIN_EXPORT qint64 frameSize(const PiiVariant& object);
+
+  /**
+   * Writes *object* to *device* as a single frame.
+   *
+   * @exception PiiSerializationException& if the object cannot be
+   * serialized or the device cannot be written to.
+   */
+  PII_YDIN_EXPORT void writeObject(QIODevice* device, const PiiVariant& object);
+
+  /**
+   * Reads a frame from *device*.
+   *
+   * @param device the input device
+   *
+   * @param maxSize the maximum number of payload bytes accepted. The
+   * frame will be rejected before allocating memory if it is larger.
+   * Zero means no limit.
+   *
+   * @param waitTime the maximum number of milliseconds to wait for
+   * more data if the device has nothing to read.
+   *
+   * @exception PiiSerializationException& if the frame is corrupted
+   * or cannot be read completely.
+   */
+  PII_YDIN_EXPORT PiiVariant readObject(QIODevice* device, qint64 maxSize = 0, int waitTime = 5000);
+
+  /**
+   * Returns *object* as a frame in a byte array. The array is
+   * allocated once and the payload copied into it directly.
+   */
+  PII_YDIN_EXPORT QByteArray toByteArray(const PiiVariant& object);
+
+  /**
+   * Decodes a frame created with [toByteArray()].
+   */
+  PII_YDIN_EXPORT PiiVariant fromByteArray(const QByteArray& data);
+
+  /**
+   * Returns `true` if *data* starts with a frame header.
+   */
+  PII_YDIN_EXPORT bool isFrame(const QByteArray& data);
+}
+
+#endif //_PIIWIREFORMAT_H
@@ -6,6 +6,8 @@ SOURCES         = *.cc
 !contains(DISABLE,network) {
   HEADERS += network/*.h
   SOURCES += network/*.cc
+} else {
+  DEFINES += PII_NO_NETWORK
 }
 
 INTODIR = ..